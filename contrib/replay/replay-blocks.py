@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+#
+# replay-blocks.py: Connect a recorded range of blocks on top of a chainstate snapshot and report the time spent
+# in each stage of connecting them.
+#
+# Copyright (c) 2021 The Dash Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+
+import argparse
+import csv
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+# The stages of -blocktimingslog, in the order they happen
+STAGES = [
+    'load', 'prefetch', 'checks', 'specialtxs', 'quorums', 'mnlist', 'cbtx_merkle', 'connect', 'scripts', 'dash',
+    'index', 'flush', 'chainstate', 'postconnect', 'total',
+]
+
+NETWORK_DIRS = {'main': '', 'testnet': 'testnet3', 'regtest': 'regtest'}
+
+
+def run_replay(args, run):
+    """Copy the snapshot, connect the blocks on top of it and return the rows of the timings log"""
+    workdir = tempfile.mkdtemp(prefix='replay-blocks-')
+    try:
+        datadir = os.path.join(workdir, 'datadir')
+        shutil.copytree(args.snapshot, datadir)
+        timings_path = os.path.join(workdir, 'timings.csv')
+        cmd = [
+            args.dashd,
+            '-datadir=' + datadir,
+            '-blocktimingslog=' + timings_path,
+            '-stopafterblockimport',
+            '-connect=0',
+            '-listen=0',
+            '-dnsseed=0',
+            '-server=0',
+            '-disablewallet',
+            '-printtoconsole=0',
+        ]
+        if args.network != 'main':
+            cmd.append('-' + args.network)
+        if args.check_scripts:
+            cmd.append('-assumevalid=0')
+        cmd += ['-loadblock=' + os.path.abspath(f) for f in args.blocks]
+        cmd += args.dashd_args
+        print('Run %d: %s' % (run + 1, ' '.join(cmd)), file=sys.stderr)
+        subprocess.check_call(cmd)
+
+        if not os.path.exists(timings_path):
+            return []
+        with open(timings_path, newline='') as f:
+            rows = list(csv.DictReader(f))
+        if args.output:
+            name = args.output if args.runs == 1 else '%s.%d' % (args.output, run + 1)
+            shutil.copyfile(timings_path, name)
+        return rows
+    finally:
+        shutil.rmtree(workdir)
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+
+def print_summary(rows):
+    if not rows:
+        print('No blocks were connected, check that the blocks extend the tip of the snapshot')
+        return
+    heights = [int(r['height']) for r in rows]
+    print('%d blocks (%d-%d), %d txs, %d inputs' % (len(rows), min(heights), max(heights),
+                                                    sum(int(r['txs']) for r in rows), sum(int(r['inputs']) for r in rows)))
+    print('%-12s %12s %10s %10s %10s %10s %7s' % ('stage', 'total ms', 'mean ms', 'median ms', 'p90 ms', 'max ms', 'share'))
+    total = sum(int(r['total_us']) for r in rows) or 1
+    for stage in STAGES:
+        values = [int(r[stage + '_us']) / 1000.0 for r in rows]
+        print('%-12s %12.1f %10.2f %10.2f %10.2f %10.2f %6.1f%%' % (
+            stage, sum(values), sum(values) / len(values), percentile(values, 0.5), percentile(values, 0.9),
+            max(values), 100.0 * sum(values) * 1000 / total))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Connect blocks on top of a chainstate snapshot and report the time spent in each stage.',
+                                     epilog='Unknown arguments are passed on to dashd.')
+    parser.add_argument('--dashd', default='dashd', help='the dashd binary to run (default: dashd)')
+    parser.add_argument('--snapshot', required=True,
+                        help='data directory of a stopped node with the chainstate, evodb and llmq databases to start from, it is copied for each run')
+    parser.add_argument('--network', choices=sorted(NETWORK_DIRS.keys()), default='main', help='network of the snapshot (default: main)')
+    parser.add_argument('--runs', type=int, default=1, help='number of times to replay the blocks (default: 1)')
+    parser.add_argument('--check-scripts', action='store_true', help='verify the scripts of all blocks (-assumevalid=0)')
+    parser.add_argument('--output', help='write the timings of each block to this CSV file (suffixed with the run for more than one run)')
+    parser.add_argument('blocks', nargs='+', help='blk????.dat or bootstrap.dat files with the blocks to connect, see contrib/linearize')
+    # everything else, like -par=<n> or -dbcache=<n>, is passed on to dashd
+    args, args.dashd_args = parser.parse_known_args()
+
+    if not os.path.isdir(os.path.join(args.snapshot, NETWORK_DIRS[args.network], 'chainstate')):
+        parser.error('%s contains no %s chainstate' % (args.snapshot, args.network))
+
+    for run in range(args.runs):
+        rows = run_replay(args, run)
+        print('Run %d:' % (run + 1))
+        print_summary(rows)
+        print()
+
+
+if __name__ == '__main__':
+    main()
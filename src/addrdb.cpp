@@ -19,12 +19,14 @@ namespace {
 template <typename Stream, typename Data>
 bool SerializeDB(Stream& stream, const Data& data)
 {
-    // Write and commit header, data
+    // Serialize header and data only once and into memory, so that data (e.g. CAddrMan, which holds its lock while
+    // serializing) isn't locked while the file is written, then append the checksum of it
     try {
-        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
-        stream << Params().MessageStart() << data;
-        hasher << Params().MessageStart() << data;
-        stream << hasher.GetHash();
+        CDataStream ssData(SER_DISK, CLIENT_VERSION);
+        ssData << Params().MessageStart() << data;
+        uint256 hash = Hash(ssData.begin(), ssData.end());
+        stream.write(ssData.data(), ssData.size());
+        stream << hash;
     } catch (const std::exception& e) {
         return error("%s: Serialize or I/O error - %s", __func__, e.what());
     }
@@ -13,6 +13,7 @@
 #include <timedata.h>
 #include <util.h>
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include <stdint.h>
@@ -182,6 +183,48 @@ public:
 //! the maximum number of tried addr collisions to store
 #define ADDRMAN_SET_TRIED_COLLISION_SIZE 10
 
+/**
+ * Dense list of the occupied positions of a bucket table. This allows Select to pick a random occupied position
+ * directly, instead of probing random positions of a mostly empty table while holding the lock.
+ */
+class CAddrManOccupiedPositions
+{
+private:
+    //! the occupied positions, in no particular order
+    std::vector<int> vPositions;
+    //! index into vPositions for each position of the table, -1 if it's not occupied
+    std::vector<int> vIndex;
+
+public:
+    explicit CAddrManOccupiedPositions(size_t nTableSize) : vIndex(nTableSize, -1) {}
+
+    void Set(int nPos, bool fOccupied)
+    {
+        int& nIndex = vIndex[nPos];
+        if (fOccupied && nIndex == -1) {
+            nIndex = vPositions.size();
+            vPositions.push_back(nPos);
+        } else if (!fOccupied && nIndex != -1) {
+            // move the last position into the freed slot
+            int nLast = vPositions.back();
+            vPositions[nIndex] = nLast;
+            vIndex[nLast] = nIndex;
+            vPositions.pop_back();
+            nIndex = -1;
+        }
+    }
+
+    void Clear()
+    {
+        vPositions.clear();
+        std::fill(vIndex.begin(), vIndex.end(), -1);
+    }
+
+    bool IsOccupied(int nPos) const { return vIndex[nPos] != -1; }
+    size_t size() const { return vPositions.size(); }
+    int operator[](size_t i) const { return vPositions[i]; }
+};
+
 /**
  * Stochastical (IP) address manager
  */
@@ -215,6 +258,11 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! occupied positions of vvTried and vvNew, as bucket * ADDRMAN_BUCKET_SIZE + position. Only ever updated together
+    //! with the tables themselves through SetTried/SetNew.
+    CAddrManOccupiedPositions occupiedTried{ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE};
+    CAddrManOccupiedPositions occupiedNew{ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE};
+
     //! last time Good was called (memory only)
     int64_t nLastGood;
 
@@ -241,6 +289,18 @@ protected:
     //! Swap two elements in vRandom.
     void SwapRandom(unsigned int nRandomPos1, unsigned int nRandomPos2);
 
+    //! Set a position in the "tried" or "new" table to nId, or clear it with -1.
+    void SetTried(int nKBucket, int nKBucketPos, int nId)
+    {
+        vvTried[nKBucket][nKBucketPos] = nId;
+        occupiedTried.Set(nKBucket * ADDRMAN_BUCKET_SIZE + nKBucketPos, nId != -1);
+    }
+    void SetNew(int nUBucket, int nUBucketPos, int nId)
+    {
+        vvNew[nUBucket][nUBucketPos] = nId;
+        occupiedNew.Set(nUBucket * ADDRMAN_BUCKET_SIZE + nUBucketPos, nId != -1);
+    }
+
     //! Move an entry from the "new" table(s) to the "tried" table
     void MakeTried(CAddrInfo& info, int nId);
 
@@ -410,7 +470,7 @@ public:
                 int nUBucket = info.GetNewBucket(nKey);
                 int nUBucketPos = info.GetBucketPosition(nKey, true, nUBucket);
                 if (vvNew[nUBucket][nUBucketPos] == -1) {
-                    vvNew[nUBucket][nUBucketPos] = n;
+                    SetNew(nUBucket, nUBucketPos, n);
                     info.nRefCount++;
                 }
             }
@@ -430,7 +490,7 @@ public:
                 vRandom.push_back(nIdCount);
                 mapInfo[nIdCount] = info;
                 mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
+                SetTried(nKBucket, nKBucketPos, nIdCount);
                 nIdCount++;
             } else {
                 nLost++;
@@ -450,7 +510,7 @@ public:
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                     if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
-                        vvNew[bucket][nUBucketPos] = nIndex;
+                        SetNew(bucket, nUBucketPos, nIndex);
                     }
                 }
             }
@@ -489,6 +549,8 @@ public:
                 vvTried[bucket][entry] = -1;
             }
         }
+        occupiedNew.Clear();
+        occupiedTried.Clear();
 
         nIdCount = 0;
         nTried = 0;
@@ -175,6 +175,8 @@ public:
     base_uint& operator*=(uint32_t b32);
     base_uint& operator*=(const base_uint& b);
     base_uint& operator/=(const base_uint& b);
+    /** Same as /= base_uint(b32), but word by word instead of bit by bit */
+    base_uint& DivideBy(uint32_t b32);
 
     base_uint& operator++()
     {
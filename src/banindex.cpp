@@ -0,0 +1,156 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <banindex.h>
+
+#include <string.h>
+
+static inline int GetKeyBit(const uint8_t (&key)[17], int n)
+{
+    return (key[n >> 3] >> (7 - (n & 7))) & 1;
+}
+
+void CBanIndex::GetKey(const CNetAddr& addr, uint8_t (&key)[17])
+{
+    // the network is part of the key as CSubNet::Match also compares it
+    key[0] = (uint8_t)addr.m_net;
+    memcpy(key + 1, addr.ip, 16);
+}
+
+int CBanIndex::GetPrefix(const CSubNet& subNet, uint8_t (&key)[17])
+{
+    if (!subNet.IsValid()) {
+        // never matches, it is kept with the other subnets so that it still expires
+        return -1;
+    }
+    GetKey(subNet.network, key);
+    int nBits = 8;
+    int n = 0;
+    for (; n < 16 && subNet.netmask[n] == 0xff; n++) {
+        nBits += 8;
+    }
+    if (n < 16) {
+        uint8_t mask = subNet.netmask[n];
+        for (; mask & 0x80; mask <<= 1) {
+            nBits++;
+        }
+        if (mask != 0) {
+            return -1;
+        }
+        for (n++; n < 16; n++) {
+            if (subNet.netmask[n] != 0) {
+                return -1;
+            }
+        }
+    }
+    return nBits;
+}
+
+void CBanIndex::SetTrie(const uint8_t (&key)[17], int nBits, int64_t nBanUntil)
+{
+    if (nodes.empty()) {
+        nodes.emplace_back();
+    }
+    uint32_t nNode = 0;
+    for (int i = 0; i < nBits; i++) {
+        int bit = GetKeyBit(key, i);
+        if (nodes[nNode].children[bit] == 0) {
+            nodes[nNode].children[bit] = nodes.size();
+            nodes.emplace_back();
+        }
+        nNode = nodes[nNode].children[bit];
+    }
+    nodes[nNode].nBanUntil = nBanUntil;
+}
+
+void CBanIndex::Insert(const CSubNet& subNet, int64_t nBanUntil)
+{
+    uint8_t key[17];
+    int nBits = GetPrefix(subNet, key);
+    if (nBits < 0) {
+        mapOtherSubnets[subNet] = nBanUntil;
+    } else {
+        SetTrie(key, nBits, nBanUntil);
+    }
+    setByExpiry.emplace(nBanUntil, subNet);
+}
+
+void CBanIndex::Erase(const CSubNet& subNet, int64_t nBanUntil)
+{
+    if (!setByExpiry.erase(std::make_pair(nBanUntil, subNet))) {
+        return;
+    }
+    uint8_t key[17];
+    int nBits = GetPrefix(subNet, key);
+    if (nBits < 0) {
+        mapOtherSubnets.erase(subNet);
+        return;
+    }
+    SetTrie(key, nBits, 0);
+
+    nErased++;
+    if (nErased > 1000 && nErased > setByExpiry.size()) {
+        Rebuild();
+    }
+}
+
+void CBanIndex::Rebuild()
+{
+    nodes.clear();
+    nErased = 0;
+    uint8_t key[17];
+    for (const auto& p : setByExpiry) {
+        int nBits = GetPrefix(p.second, key);
+        if (nBits >= 0) {
+            SetTrie(key, nBits, p.first);
+        }
+    }
+}
+
+void CBanIndex::Clear()
+{
+    std::vector<Node>().swap(nodes);
+    mapOtherSubnets.clear();
+    setByExpiry.clear();
+    nErased = 0;
+}
+
+bool CBanIndex::IsBanned(const CNetAddr& addr, int64_t nNow) const
+{
+    if (!addr.IsValid()) {
+        return false;
+    }
+    if (!nodes.empty()) {
+        uint8_t key[17];
+        GetKey(addr, key);
+        uint32_t nNode = 0;
+        for (int i = 0; ; i++) {
+            if (nNow < nodes[nNode].nBanUntil) {
+                return true;
+            }
+            if (i == KEY_BITS) {
+                break;
+            }
+            nNode = nodes[nNode].children[GetKeyBit(key, i)];
+            if (nNode == 0) {
+                break;
+            }
+        }
+    }
+    for (const auto& p : mapOtherSubnets) {
+        if (nNow < p.second && p.first.Match(addr)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::pair<int64_t, CSubNet>> CBanIndex::GetExpired(int64_t nNow) const
+{
+    std::vector<std::pair<int64_t, CSubNet>> result;
+    for (auto it = setByExpiry.begin(); it != setByExpiry.end() && it->first < nNow; ++it) {
+        result.emplace_back(*it);
+    }
+    return result;
+}
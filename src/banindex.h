@@ -0,0 +1,65 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BANINDEX_H
+#define BITCOIN_BANINDEX_H
+
+#include <netaddress.h>
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Index of the banned subnets for IsBanned lookups and for finding the expired bans.
+ *
+ * Subnets which are a prefix of the address (all CIDR subnets) are kept in a binary trie over the network type and
+ * the 16 address bytes, so checking an address walks at most 136 nodes no matter how many bans there are. The rare
+ * subnets with other netmasks are checked one by one. The bans are also kept ordered by their expiry time, so that
+ * sweeping only touches the expired ones.
+ *
+ * Erased bans leave their trie nodes behind until enough of them accumulated, then the trie is rebuilt.
+ */
+class CBanIndex
+{
+public:
+    /** Add a subnet which is not in the index yet, changing its ban time is an Erase and an Insert */
+    void Insert(const CSubNet& subNet, int64_t nBanUntil);
+    /** Remove the subnet, which must have been inserted with nBanUntil */
+    void Erase(const CSubNet& subNet, int64_t nBanUntil);
+    void Clear();
+
+    /** Whether the address is in a subnet which is banned after nNow */
+    bool IsBanned(const CNetAddr& addr, int64_t nNow) const;
+    /** The subnets which were banned until before nNow, sorted by their expiry time */
+    std::vector<std::pair<int64_t, CSubNet>> GetExpired(int64_t nNow) const;
+
+    size_t size() const { return setByExpiry.size(); }
+
+private:
+    static const int KEY_BITS = 8 + 128;
+
+    struct Node {
+        uint32_t children[2]{0, 0};
+        // 0 when no subnet ends at this node
+        int64_t nBanUntil{0};
+    };
+
+    // nodes[0] is the root, 0 as a child means there is none
+    std::vector<Node> nodes;
+    std::map<CSubNet, int64_t> mapOtherSubnets;
+    std::set<std::pair<int64_t, CSubNet>> setByExpiry;
+    // bans erased from the trie since it was built
+    size_t nErased{0};
+
+    /** The key bits of the subnet and their count, or -1 if it is invalid or the netmask is not a prefix */
+    static int GetPrefix(const CSubNet& subNet, uint8_t (&key)[17]);
+    static void GetKey(const CNetAddr& addr, uint8_t (&key)[17]);
+    void SetTrie(const uint8_t (&key)[17], int nBits, int64_t nBanUntil);
+    void Rebuild();
+};
+
+#endif // BITCOIN_BANINDEX_H
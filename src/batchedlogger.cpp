@@ -6,7 +6,7 @@
 #include <util.h>
 
 CBatchedLogger::CBatchedLogger(uint64_t _category, const std::string& _header) :
-    accept(LogAcceptCategory(_category)), header(_header)
+    accept(LogAcceptCategory(_category)), category(_category), header(_header)
 {
 }
 
@@ -20,6 +20,6 @@ void CBatchedLogger::Flush()
     if (!accept || msg.empty()) {
         return;
     }
-    LogPrintStr(strprintf("%s:\n%s", header, msg));
+    LogPrintStr(strprintf("%s:\n%s", header, msg), category);
     msg.clear();
 }
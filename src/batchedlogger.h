@@ -11,6 +11,7 @@ class CBatchedLogger
 {
 private:
     bool accept;
+    uint64_t category;
     std::string header;
     std::string msg;
 public:
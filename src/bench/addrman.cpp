@@ -0,0 +1,106 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <addrman.h>
+#include <bench/bench.h>
+#include <random.h>
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+/* A "source" is a source address from which we have received a bunch of other addresses. */
+
+static const size_t NUM_SOURCES = 392;
+static const size_t NUM_ADDRESSES_PER_SOURCE = 256;
+
+static std::vector<CAddress> g_sources;
+static std::vector<std::vector<CAddress>> g_addresses;
+
+static CAddress RandomAddress(FastRandomContext& rng)
+{
+    while (true) {
+        in6_addr addr;
+        std::vector<unsigned char> bytes = rng.randbytes(sizeof(addr));
+        memcpy(&addr, bytes.data(), sizeof(addr));
+        CAddress ret(CService(addr, rng.randrange(65535) + 1), NODE_NETWORK);
+        if (ret.IsRoutable()) {
+            return ret;
+        }
+    }
+}
+
+static void CreateAddresses()
+{
+    if (!g_sources.empty()) {
+        return;
+    }
+
+    FastRandomContext rng(uint256S("0x7b9c3f5dbe3e2f41"));
+    for (size_t s = 0; s < NUM_SOURCES; ++s) {
+        g_sources.emplace_back(RandomAddress(rng));
+        g_addresses.emplace_back();
+        for (size_t a = 0; a < NUM_ADDRESSES_PER_SOURCE; ++a) {
+            g_addresses[s].emplace_back(RandomAddress(rng));
+        }
+    }
+}
+
+static void AddAddressesToAddrMan(CAddrMan& addrman)
+{
+    for (size_t source_i = 0; source_i < NUM_SOURCES; ++source_i) {
+        addrman.Add(g_addresses[source_i], g_sources[source_i]);
+    }
+}
+
+static void AddrManAdd(benchmark::State& state)
+{
+    CreateAddresses();
+
+    while (state.KeepRunning()) {
+        CAddrMan addrman;
+        AddAddressesToAddrMan(addrman);
+    }
+}
+
+static void AddrManSelect(benchmark::State& state)
+{
+    CreateAddresses();
+
+    CAddrMan addrman;
+    AddAddressesToAddrMan(addrman);
+    // Move a part of the addresses to tried, so that both tables are exercised
+    for (size_t source_i = 0; source_i < NUM_SOURCES; source_i += 4) {
+        for (const CAddress& addr : g_addresses[source_i]) {
+            addrman.Good(addr, false);
+        }
+    }
+
+    while (state.KeepRunning()) {
+        const CAddress& address = addrman.Select();
+        assert(address.GetPort() > 0);
+    }
+}
+
+static void AddrManGood(benchmark::State& state)
+{
+    CreateAddresses();
+
+    CAddrMan addrman;
+    AddAddressesToAddrMan(addrman);
+
+    size_t source_i = 0;
+    size_t addr_i = 0;
+    while (state.KeepRunning()) {
+        addrman.Good(g_addresses[source_i][addr_i], false);
+        if (++addr_i == NUM_ADDRESSES_PER_SOURCE) {
+            addr_i = 0;
+            source_i = (source_i + 1) % NUM_SOURCES;
+        }
+    }
+}
+
+BENCHMARK(AddrManAdd, 5);
+BENCHMARK(AddrManSelect, 1000000);
+BENCHMARK(AddrManGood, 100000);
@@ -0,0 +1,63 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <crypto/aes.h>
+
+#include <vector>
+
+/* Number of bytes to process per iteration, the size of an encrypted wallet key and of a large blob */
+static const size_t BUFFER_SIZE_SMALL = 48;
+static const size_t BUFFER_SIZE_LARGE = 1024*1024;
+
+static void AES256CBC_ENCRYPT(benchmark::State& state, size_t buffersize)
+{
+    std::vector<uint8_t> key(AES256_KEYSIZE, 0);
+    std::vector<uint8_t> iv(AES_BLOCKSIZE, 0);
+    std::vector<uint8_t> in(buffersize, 0);
+    std::vector<uint8_t> out(buffersize + AES_BLOCKSIZE, 0);
+    while (state.KeepRunning()) {
+        AES256CBCEncrypt enc(key.data(), iv.data(), true);
+        enc.Encrypt(in.data(), in.size(), out.data());
+    }
+}
+
+static void AES256CBC_DECRYPT(benchmark::State& state, size_t buffersize)
+{
+    std::vector<uint8_t> key(AES256_KEYSIZE, 0);
+    std::vector<uint8_t> iv(AES_BLOCKSIZE, 0);
+    std::vector<uint8_t> in(buffersize, 0);
+    std::vector<uint8_t> out(buffersize + AES_BLOCKSIZE, 0);
+    int size = AES256CBCEncrypt(key.data(), iv.data(), true).Encrypt(in.data(), in.size(), out.data());
+    std::vector<uint8_t> dec(size, 0);
+    while (state.KeepRunning()) {
+        AES256CBCDecrypt d(key.data(), iv.data(), true);
+        d.Decrypt(out.data(), size, dec.data());
+    }
+}
+
+static void AES256CBC_ENCRYPT_48BYTES(benchmark::State& state)
+{
+    AES256CBC_ENCRYPT(state, BUFFER_SIZE_SMALL);
+}
+
+static void AES256CBC_ENCRYPT_1MB(benchmark::State& state)
+{
+    AES256CBC_ENCRYPT(state, BUFFER_SIZE_LARGE);
+}
+
+static void AES256CBC_DECRYPT_48BYTES(benchmark::State& state)
+{
+    AES256CBC_DECRYPT(state, BUFFER_SIZE_SMALL);
+}
+
+static void AES256CBC_DECRYPT_1MB(benchmark::State& state)
+{
+    AES256CBC_DECRYPT(state, BUFFER_SIZE_LARGE);
+}
+
+BENCHMARK(AES256CBC_ENCRYPT_48BYTES, 200000);
+BENCHMARK(AES256CBC_ENCRYPT_1MB, 80);
+BENCHMARK(AES256CBC_DECRYPT_48BYTES, 200000);
+BENCHMARK(AES256CBC_DECRYPT_1MB, 80);
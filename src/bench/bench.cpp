@@ -4,13 +4,98 @@
 
 #include <bench/bench.h>
 
+#include <tinyformat.h>
+
 #include <assert.h>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
 #include <regex>
 #include <numeric>
 
+// value at the fraction p of the sorted values, the nearest rank is used
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+static double Median(const std::vector<double>& sorted)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t mid = sorted.size() / 2;
+    return sorted.size() % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+}
+
+benchmark::Result::Result(const State& state) :
+    name(state.m_name),
+    num_evals(state.m_num_evals),
+    num_iters(state.m_num_iters)
+{
+    auto results = state.m_elapsed_results;
+    if (results.empty()) {
+        return;
+    }
+    std::sort(results.begin(), results.end());
+
+    double sum = std::accumulate(results.begin(), results.end(), 0.0);
+    total = state.m_num_iters * sum;
+    min = results.front();
+    max = results.back();
+    median = Median(results);
+    p99 = Percentile(results, 0.99);
+    mean = sum / results.size();
+    if (results.size() > 1) {
+        double sq_sum = 0;
+        for (double r : results) {
+            sq_sum += (r - mean) * (r - mean);
+        }
+        stddev = std::sqrt(sq_sum / (results.size() - 1));
+    }
+
+    auto cycles = state.m_cycles_results;
+    std::sort(cycles.begin(), cycles.end());
+    cycles_median = Median(cycles);
+}
+
+benchmark::Result::Result(const UniValue& obj) :
+    name(find_value(obj, "name").get_str()),
+    num_evals(find_value(obj, "evals").get_int64()),
+    num_iters(find_value(obj, "iterations").get_int64()),
+    total(find_value(obj, "total").get_real()),
+    min(find_value(obj, "min").get_real()),
+    median(find_value(obj, "median").get_real()),
+    p99(find_value(obj, "p99").get_real()),
+    max(find_value(obj, "max").get_real()),
+    mean(find_value(obj, "mean").get_real()),
+    stddev(find_value(obj, "stddev").get_real()),
+    cycles_median(find_value(obj, "cycles_median").get_real())
+{
+}
+
+UniValue benchmark::Result::ToJson() const
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("name", name);
+    obj.pushKV("evals", num_evals);
+    obj.pushKV("iterations", num_iters);
+    obj.pushKV("total", total);
+    obj.pushKV("min", min);
+    obj.pushKV("median", median);
+    obj.pushKV("p99", p99);
+    obj.pushKV("max", max);
+    obj.pushKV("mean", mean);
+    obj.pushKV("stddev", stddev);
+    obj.pushKV("cycles_median", cycles_median);
+    return obj;
+}
+
 void benchmark::ConsolePrinter::header()
 {
     std::cout << "# Benchmark, evals, iterations, total, min, max, median" << std::endl;
@@ -81,6 +166,71 @@ void benchmark::PlotlyPrinter::footer()
               << "</script></body></html>";
 }
 
+void benchmark::JsonPrinter::header() {}
+
+void benchmark::JsonPrinter::result(const State& state)
+{
+    m_results.push_back(Result(state).ToJson());
+}
+
+void benchmark::JsonPrinter::footer()
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("unit", "seconds per iteration");
+    obj.pushKV("cycles_counted", PERF_CPUCYCLES_SUPPORTED);
+    obj.pushKV("benchmarks", m_results);
+    std::cout << obj.write(2) << std::endl;
+}
+
+benchmark::ComparePrinter::ComparePrinter(Printer& printer, const UniValue& base, double threshold) :
+    m_printer(printer),
+    m_threshold(threshold)
+{
+    for (const auto& obj : find_value(base, "benchmarks").getValues()) {
+        Result result(obj);
+        m_base.emplace(result.name, result);
+    }
+}
+
+void benchmark::ComparePrinter::header()
+{
+    m_printer.header();
+}
+
+void benchmark::ComparePrinter::result(const State& state)
+{
+    m_printer.result(state);
+    if (state.m_elapsed_results.empty()) {
+        return;
+    }
+
+    Result current(state);
+    auto it = m_base.find(current.name);
+    if (it == m_base.end() || it->second.median <= 0) {
+        m_report.emplace_back(strprintf("%s: not in the base results", current.name));
+        return;
+    }
+    double change = current.median / it->second.median - 1;
+    std::string verdict;
+    if (change > m_threshold) {
+        verdict = " REGRESSION";
+        m_num_regressions++;
+    } else if (change < -m_threshold) {
+        verdict = " improvement";
+    }
+    m_report.emplace_back(strprintf("%s: median %g -> %g (%+.1f%%)%s", current.name, it->second.median, current.median,
+                                    change * 100, verdict));
+}
+
+void benchmark::ComparePrinter::footer()
+{
+    m_printer.footer();
+    std::cerr << strprintf("# Comparison of the medians with the base results, threshold %.1f%%", m_threshold * 100) << std::endl;
+    for (const auto& line : m_report) {
+        std::cerr << line << std::endl;
+    }
+    std::cerr << strprintf("# %u regression(s)", m_num_regressions) << std::endl;
+}
 
 benchmark::BenchRunner::BenchmarkMap& benchmark::BenchRunner::benchmarks()
 {
@@ -131,6 +281,9 @@ bool benchmark::State::UpdateTimer(const benchmark::time_point current_time)
     if (m_start_time != time_point()) {
         std::chrono::duration<double> diff = current_time - m_start_time;
         m_elapsed_results.push_back(diff.count() / m_num_iters);
+        if (PERF_CPUCYCLES_SUPPORTED) {
+            m_cycles_results.push_back(double(m_finish_cycles - m_start_cycles) / m_num_iters);
+        }
 
         if (m_elapsed_results.size() == m_num_evals) {
             return false;
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_BENCH_BENCH_H
 #define BITCOIN_BENCH_BENCH_H
 
+#include <bench/perf.h>
+
 #include <functional>
 #include <limits>
 #include <map>
@@ -12,6 +14,8 @@
 #include <vector>
 #include <chrono>
 
+#include <univalue.h>
+
 #include <boost/preprocessor/cat.hpp>
 #include <boost/preprocessor/stringize.hpp>
 
@@ -59,7 +63,10 @@ public:
     const uint64_t m_num_iters;
     const uint64_t m_num_evals;
     std::vector<double> m_elapsed_results;
+    // CPU cycles per iteration of each evaluation, if PERF_CPUCYCLES_SUPPORTED
+    std::vector<double> m_cycles_results;
     time_point m_start_time;
+    uint64_t m_start_cycles{0};
 
     bool UpdateTimer(time_point finish_time);
 
@@ -73,11 +80,16 @@ public:
             return true;
         }
 
+        m_finish_cycles = perf_cpucycles();
         bool result = UpdateTimer(clock::now());
         // measure again so runtime of UpdateTimer is not included
         m_start_time = clock::now();
+        m_start_cycles = perf_cpucycles();
         return result;
     }
+
+private:
+    uint64_t m_finish_cycles{0};
 };
 
 typedef std::function<void(State&)> BenchFunction;
@@ -107,6 +119,27 @@ public:
     virtual void footer() = 0;
 };
 
+/** Summary of the evaluations of one benchmark, elapsed values are in seconds per iteration */
+struct Result
+{
+    std::string name;
+    uint64_t num_evals{0};
+    uint64_t num_iters{0};
+    double total{0};
+    double min{0};
+    double median{0};
+    double p99{0};
+    double max{0};
+    double mean{0};
+    double stddev{0};
+    // median CPU cycles per iteration, 0 if they aren't counted
+    double cycles_median{0};
+
+    explicit Result(const State& state);
+    explicit Result(const UniValue& obj);
+    UniValue ToJson() const;
+};
+
 // default printer to console, shows min, max, median.
 class ConsolePrinter : public Printer
 {
@@ -130,6 +163,38 @@ private:
     int64_t m_width;
     int64_t m_height;
 };
+
+// prints a JSON document with the statistics of all benchmarks, which -compare can read back
+class JsonPrinter : public Printer
+{
+public:
+    void header();
+    void result(const State& state);
+    void footer();
+
+private:
+    UniValue m_results{UniValue::VARR};
+};
+
+// forwards to another printer and compares the medians to the ones of an earlier JSON output, the regressions
+// above the threshold (a fraction, 0.05 = 5% slower) are reported on stderr after the footer
+class ComparePrinter : public Printer
+{
+public:
+    ComparePrinter(Printer& printer, const UniValue& base, double threshold);
+    void header();
+    void result(const State& state);
+    void footer();
+
+    bool HasRegressions() const { return m_num_regressions > 0; }
+
+private:
+    Printer& m_printer;
+    std::map<std::string, Result> m_base;
+    const double m_threshold;
+    std::vector<std::string> m_report;
+    size_t m_num_regressions{0};
+};
 }
 
 
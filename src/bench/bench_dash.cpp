@@ -4,7 +4,11 @@
 
 #include <bench/bench.h>
 
+#include <crypto/aes.h>
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
 #include <crypto/sha256.h>
+#include <hash.h>
 #include <key.h>
 #include <stacktraces.h>
 #include <validation.h>
@@ -13,7 +17,9 @@
 
 #include <boost/lexical_cast.hpp>
 
+#include <fstream>
 #include <memory>
+#include <sstream>
 
 #include <bls/bls.h>
 
@@ -24,6 +30,7 @@ static const char* DEFAULT_BENCH_PRINTER = "console";
 static const char* DEFAULT_PLOT_PLOTLYURL = "https://cdn.plot.ly/plotly-latest.min.js";
 static const int64_t DEFAULT_PLOT_WIDTH = 1024;
 static const int64_t DEFAULT_PLOT_HEIGHT = 768;
+static const char* DEFAULT_COMPARE_THRESHOLD = "5.0";
 
 void InitBLSTests();
 void CleanupBLSTests();
@@ -44,7 +51,9 @@ static void SetupBenchArgs()
     gArgs.AddArg("-evals=<n>", strprintf("Number of measurement evaluations to perform. (default: %u)", DEFAULT_BENCH_EVALUATIONS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-filter=<regex>", strprintf("Regular expression filter to select benchmark by name (default: %s)", DEFAULT_BENCH_FILTER), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-scaling=<n>", strprintf("Scaling factor for benchmark's runtime (default: %u)", DEFAULT_BENCH_SCALING), false, OptionsCategory::OPTIONS);
-    gArgs.AddArg("-printer=(console|plot)", strprintf("Choose printer format. console: print data to console. plot: Print results as HTML graph (default: %s)", DEFAULT_BENCH_PRINTER), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-printer=(console|plot|json)", strprintf("Choose printer format. console: print data to console. plot: Print results as HTML graph. json: Print min, median, p99, max and CPU cycles as JSON (default: %s)", DEFAULT_BENCH_PRINTER), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-compare=<file>", "Compare the medians to the ones in <file>, the output of an earlier run with -printer=json. The comparison is printed to stderr and the exit code is 1 if a benchmark regressed by more than -compare-threshold", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-compare-threshold=<n>", strprintf("Percentage by which a median has to be slower than the one of -compare to count as regression (default: %s)", DEFAULT_COMPARE_THRESHOLD), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-plotlyurl=<uri>", strprintf("URL to use for plotly.js (default: %s)", DEFAULT_PLOT_PLOTLYURL), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-width=<x>", strprintf("Plot width in pixel (default: %u)", DEFAULT_PLOT_WIDTH), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-plot-height=<x>", strprintf("Plot height in pixel (default: %u)", DEFAULT_PLOT_HEIGHT), false, OptionsCategory::OPTIONS);
@@ -61,10 +70,26 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    // Read the results to compare with before setting anything up, so a bad file doesn't need any cleanup
+    UniValue compare_base;
+    if (gArgs.IsArgSet("-compare")) {
+        std::ifstream file(gArgs.GetArg("-compare", ""));
+        std::stringstream ss;
+        ss << file.rdbuf();
+        if (!file.is_open() || !compare_base.read(ss.str()) || !find_value(compare_base, "benchmarks").isArray()) {
+            fprintf(stderr, "Error: can't read the benchmark results of %s\n", gArgs.GetArg("-compare", "").c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
     // Set the datadir after parsing the bench options
     const fs::path bench_datadir{SetDataDir()};
 
     SHA256AutoDetect();
+    ChaCha20AutoDetect();
+    Poly1305AutoDetect();
+    SipHashAutoDetect();
+    AESAutoDetect();
 
     RegisterPrettySignalHandlers();
     RegisterPrettyTerminateHander();
@@ -93,9 +118,17 @@ int main(int argc, char** argv)
             gArgs.GetArg("-plot-plotlyurl", DEFAULT_PLOT_PLOTLYURL),
             gArgs.GetArg("-plot-width", DEFAULT_PLOT_WIDTH),
             gArgs.GetArg("-plot-height", DEFAULT_PLOT_HEIGHT)));
+    } else if ("json" == printer_arg) {
+        printer.reset(new benchmark::JsonPrinter());
     }
 
-    benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only);
+    std::unique_ptr<benchmark::ComparePrinter> compare_printer;
+    if (!compare_base.isNull()) {
+        double threshold = boost::lexical_cast<double>(gArgs.GetArg("-compare-threshold", DEFAULT_COMPARE_THRESHOLD));
+        compare_printer.reset(new benchmark::ComparePrinter(*printer, compare_base, threshold / 100));
+    }
+
+    benchmark::BenchRunner::RunAll(compare_printer ? *compare_printer : *printer, evaluations, scaling_factor, regex_filter, is_list_only);
 
     fs::remove_all(bench_datadir);
 
@@ -104,4 +137,6 @@ int main(int argc, char** argv)
     CleanupBLSTests();
 
     ECC_Stop();
+
+    return compare_printer && compare_printer->HasRegressions() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -5,6 +5,10 @@
 #include <bench/bench.h>
 #include <random.h>
 #include <bls/bls_worker.h>
+#include <version.h>
+
+#include <algorithm>
+#include <list>
 
 extern CBLSWorker blsWorker;
 
@@ -111,6 +115,69 @@ struct DKG
             memberIdx = (memberIdx + 1) % members.size();
         }
     }
+
+    // Simulates the contribution phase of a session which receives the shares in batches of batchSize. Every batch
+    // is verified in the background while the next one is received, the result of all batches is waited for at the end
+    void Bench_VerifyContributionSharesStreamed(benchmark::State& state, size_t batchSize)
+    {
+        ReceiveVvecs();
+
+        size_t memberIdx = 0;
+        while (state.KeepRunning()) {
+            ReceiveShares(memberIdx);
+
+            struct Job {
+                std::vector<BLSVerificationVectorPtr> vvecs;
+                BLSSecretKeyVector skShares;
+                std::future<std::vector<bool>> result;
+            };
+            std::list<Job> jobs;
+            for (size_t i = 0; i < receivedVvecs.size(); i += batchSize) {
+                size_t end = std::min(i + batchSize, receivedVvecs.size());
+                jobs.emplace_back();
+                auto& job = jobs.back();
+                job.vvecs.assign(receivedVvecs.begin() + i, receivedVvecs.begin() + end);
+                job.skShares.assign(receivedSkShares.begin() + i, receivedSkShares.begin() + end);
+                job.result = blsWorker.AsyncVerifyContributionShares(members[memberIdx].id, job.vvecs, job.skShares, true, true);
+            }
+            for (auto& job : jobs) {
+                for (bool valid : job.result.get()) {
+                    assert(valid);
+                }
+            }
+
+            memberIdx = (memberIdx + 1) % members.size();
+        }
+    }
+
+    void Bench_DecryptContributionShares(benchmark::State& state, bool parallel)
+    {
+        // every member encrypts its share for member 0
+        CBLSSecretKey sk;
+        sk.MakeNewKey();
+        std::vector<std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey>>> encryptedContributions;
+        for (const auto& m : members) {
+            auto enc = std::make_shared<CBLSIESMultiRecipientObjects<CBLSSecretKey>>();
+            enc->InitEncrypt(1);
+            enc->Encrypt(0, sk.GetPublicKey(), m.skShares[0], PROTOCOL_VERSION);
+            encryptedContributions.emplace_back(std::move(enc));
+        }
+
+        while (state.KeepRunning()) {
+            if (parallel) {
+                auto skShares = blsWorker.DecryptContributionShares(encryptedContributions, 0, sk);
+                for (const auto& skShare : skShares) {
+                    assert(skShare.IsValid());
+                }
+            } else {
+                for (const auto& enc : encryptedContributions) {
+                    CBLSSecretKey skShare;
+                    bool ok = enc->Decrypt(0, sk, skShare, PROTOCOL_VERSION);
+                    assert(ok);
+                }
+            }
+        }
+    }
 };
 
 std::shared_ptr<DKG> dkg10;
@@ -181,3 +248,34 @@ BENCH_VerifyContributionShares(parallel, 400, 5, true, false, 1)
 BENCH_VerifyContributionShares(parallel_aggregated, 10, 5, true, true, 150)
 BENCH_VerifyContributionShares(parallel_aggregated, 100, 5, true, true, 4)
 BENCH_VerifyContributionShares(parallel_aggregated, 400, 5, true, true, 1)
+
+///////////////////////////////
+
+#define BENCH_VerifyContributionSharesStreamed(quorumSize, batchSize, num_iters_for_one_second) \
+    static void BLSDKG_VerifyContributionSharesStreamed_##batchSize##_##quorumSize(benchmark::State& state) \
+    { \
+        InitIfNeeded(); \
+        dkg##quorumSize->Bench_VerifyContributionSharesStreamed(state, batchSize); \
+    } \
+    BENCHMARK(BLSDKG_VerifyContributionSharesStreamed_##batchSize##_##quorumSize, num_iters_for_one_second)
+
+BENCH_VerifyContributionSharesStreamed(10, 32, 150)
+BENCH_VerifyContributionSharesStreamed(100, 32, 4)
+BENCH_VerifyContributionSharesStreamed(400, 32, 1)
+
+///////////////////////////////
+
+#define BENCH_DecryptContributionShares(name, quorumSize, parallel, num_iters_for_one_second) \
+    static void BLSDKG_DecryptContributionShares_##name##_##quorumSize(benchmark::State& state) \
+    { \
+        InitIfNeeded(); \
+        dkg##quorumSize->Bench_DecryptContributionShares(state, parallel); \
+    } \
+    BENCHMARK(BLSDKG_DecryptContributionShares_##name##_##quorumSize, num_iters_for_one_second)
+
+BENCH_DecryptContributionShares(simple, 10, false, 100)
+BENCH_DecryptContributionShares(simple, 100, false, 10)
+BENCH_DecryptContributionShares(simple, 400, false, 2)
+BENCH_DecryptContributionShares(parallel, 10, true, 200)
+BENCH_DecryptContributionShares(parallel, 100, true, 30)
+BENCH_DecryptContributionShares(parallel, 400, true, 8)
@@ -50,5 +50,45 @@ static void DeserializeAndCheckBlockTest(benchmark::State& state)
     }
 }
 
+// The size checks of CheckBlock, AcceptToMemoryPool and CTxMemPoolEntry: the size of the block and of each of its
+// transactions. "Uncached" serializes CMutableTransactions for that, like GetSerializeSize() did for CTransactions
+// before they cached their size.
+static void BlockTxSizes(benchmark::State& state, bool fCached)
+{
+    CDataStream stream((const char*)raw_bench::block813851,
+            (const char*)&raw_bench::block813851[sizeof(raw_bench::block813851)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+    std::vector<CMutableTransaction> vMtx;
+    for (const auto& tx : block.vtx) {
+        vMtx.emplace_back(*tx);
+    }
+
+    while (state.KeepRunning()) {
+        size_t nSize = 0;
+        if (fCached) {
+            nSize += ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+            for (const auto& tx : block.vtx) {
+                nSize += ::GetSerializeSize(*tx, SER_NETWORK, PROTOCOL_VERSION);
+            }
+        } else {
+            nSize += ::GetSerializeSize(block.GetBlockHeader(), SER_NETWORK, PROTOCOL_VERSION) + GetSizeOfCompactSize(vMtx.size());
+            for (const auto& mtx : vMtx) {
+                nSize += ::GetSerializeSize(mtx, SER_NETWORK, PROTOCOL_VERSION);
+            }
+            for (const auto& mtx : vMtx) {
+                nSize += ::GetSerializeSize(mtx, SER_NETWORK, PROTOCOL_VERSION);
+            }
+        }
+        assert(nSize == 2 * sizeof(raw_bench::block813851) - ::GetSerializeSize(block.GetBlockHeader(), SER_NETWORK, PROTOCOL_VERSION) - GetSizeOfCompactSize(vMtx.size()));
+    }
+}
+
+static void BlockTxSizes_Cached(benchmark::State& state) { BlockTxSizes(state, true); }
+static void BlockTxSizes_Uncached(benchmark::State& state) { BlockTxSizes(state, false); }
+
 BENCHMARK(DeserializeBlockTest, 130);
 BENCHMARK(DeserializeAndCheckBlockTest, 160);
+BENCHMARK(BlockTxSizes_Cached, 5000);
+BENCHMARK(BlockTxSizes_Uncached, 500);
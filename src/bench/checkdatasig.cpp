@@ -0,0 +1,78 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <crypto/sha256.h>
+#include <key.h>
+#include <policy/policy.h>
+#include <primitives/transaction.h>
+#include <script/interpreter.h>
+#include <script/sigcache.h>
+#include <script/script.h>
+
+#include <vector>
+
+// A script which checks 20 oracle signatures over different messages, like a contract settling on oracle data
+static CScript BuildCheckDataSigScript(std::vector<std::vector<unsigned char>>& stack)
+{
+    CScript script;
+    for (int i = 0; i < 20; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        std::vector<unsigned char> vchMessage(32, (unsigned char)i);
+        uint256 hash;
+        CSHA256().Write(vchMessage.data(), vchMessage.size()).Finalize(hash.begin());
+        std::vector<unsigned char> vchSig;
+        key.Sign(hash, vchSig);
+        CPubKey pubkey = key.GetPubKey();
+        stack.push_back(vchSig);
+        script << vchMessage << std::vector<unsigned char>(pubkey.begin(), pubkey.end()) << OP_CHECKDATASIGVERIFY;
+    }
+    script << OP_TRUE;
+    return script;
+}
+
+// Verifying the signatures every time, as without a signature cache
+static void CheckDataSigScript(benchmark::State& state)
+{
+    std::vector<std::vector<unsigned char>> vSigs;
+    const CScript script = BuildCheckDataSigScript(vSigs);
+    const unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS | SCRIPT_ENABLE_DIP0020_OPCODES;
+
+    BaseSignatureChecker checker;
+    while (state.KeepRunning()) {
+        // The first signature has to be on top
+        std::vector<std::vector<unsigned char>> stack(vSigs.rbegin(), vSigs.rend());
+        ScriptError err;
+        bool ret = EvalScript(stack, script, flags, checker, SigVersion::BASE, &err);
+        assert(ret);
+    }
+}
+
+// The same script again after it was verified once, e.g. when the transaction was accepted to the mempool before
+static void CheckDataSigScript_Cached(benchmark::State& state)
+{
+    InitSignatureCache();
+
+    std::vector<std::vector<unsigned char>> vSigs;
+    const CScript script = BuildCheckDataSigScript(vSigs);
+    const unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS | SCRIPT_ENABLE_DIP0020_OPCODES;
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vout.resize(1);
+    const CTransaction tx(mtx);
+    PrecomputedTransactionData txdata(tx);
+    CachingTransactionSignatureChecker checker(&tx, 0, 0, txdata);
+
+    while (state.KeepRunning()) {
+        std::vector<std::vector<unsigned char>> stack(vSigs.rbegin(), vSigs.rend());
+        ScriptError err;
+        bool ret = EvalScript(stack, script, flags, checker, SigVersion::BASE, &err);
+        assert(ret);
+    }
+}
+
+BENCHMARK(CheckDataSigScript, 150);
+BENCHMARK(CheckDataSigScript_Cached, 5000);
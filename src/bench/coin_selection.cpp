@@ -104,5 +104,36 @@ static void BnBExhaustion(benchmark::State& state)
     }
 }
 
+// Selection from a wallet with 100k UTXOs of 1000 different values, with BnB and with the knapsack solver
+static void CoinSelectionLargePool(benchmark::State& state, bool use_bnb)
+{
+    const CWallet wallet(WalletLocation(), WalletDatabase::CreateDummy());
+    std::vector<COutput> vCoins;
+    LOCK(wallet.cs_wallet);
+
+    for (int i = 0; i < 100000; i++)
+        addCoin((i % 1000 + 1) * CENT, wallet, vCoins);
+
+    std::set<CInputCoin> setCoinsRet;
+    CAmount nValueRet;
+    bool bnb_used;
+    CoinEligibilityFilter filter_standard(1, 6, 0);
+    CoinSelectionParams coin_selection_params(use_bnb, 34, 148, CFeeRate(0), 0);
+    while (state.KeepRunning()) {
+        bool success = wallet.SelectCoinsMinConf(2500 * COIN + 17 * CENT, filter_standard, vCoins, setCoinsRet, nValueRet, coin_selection_params, bnb_used);
+        assert(success);
+        assert(nValueRet >= 2500 * COIN + 17 * CENT);
+    }
+
+    for (COutput& output : vCoins) {
+        delete output.tx;
+    }
+}
+
+static void CoinSelectionLargePoolBnB(benchmark::State& state) { CoinSelectionLargePool(state, true); }
+static void CoinSelectionLargePoolKnapsack(benchmark::State& state) { CoinSelectionLargePool(state, false); }
+
 BENCHMARK(CoinSelection, 650);
 BENCHMARK(BnBExhaustion, 650);
+BENCHMARK(CoinSelectionLargePoolBnB, 5);
+BENCHMARK(CoinSelectionLargePoolKnapsack, 1);
@@ -77,6 +77,33 @@ static void HASH_SHA256D64_1024(benchmark::State& state)
     }
 }
 
+// The txids of a block of 1000 transactions of 200-300 bytes, one by one and in one batch
+static void HASH_DSHA256_1000tx(benchmark::State& state, bool fBatch)
+{
+    FastRandomContext rng(true);
+    std::vector<std::vector<unsigned char>> txs(1000);
+    std::vector<const unsigned char*> inputs;
+    std::vector<size_t> lengths;
+    for (auto& tx : txs) {
+        tx = rng.randbytes(200 + rng.randrange(100));
+        inputs.emplace_back(tx.data());
+        lengths.emplace_back(tx.size());
+    }
+    std::vector<uint256> hashes(txs.size());
+    while (state.KeepRunning()) {
+        if (fBatch) {
+            SHA256DMulti(hashes[0].begin(), inputs.data(), lengths.data(), txs.size());
+        } else {
+            for (size_t i = 0; i < txs.size(); i++) {
+                CHash256().Write(txs[i].data(), txs[i].size()).Finalize(hashes[i].begin());
+            }
+        }
+    }
+}
+
+static void HASH_DSHA256_1000tx_single(benchmark::State& state) { HASH_DSHA256_1000tx(state, false); }
+static void HASH_DSHA256_1000tx_batch(benchmark::State& state) { HASH_DSHA256_1000tx(state, true); }
+
 static void HASH_SHA512(benchmark::State& state)
 {
     uint8_t hash[CSHA512::OUTPUT_SIZE];
@@ -94,6 +121,34 @@ static void HASH_SipHash_0032b(benchmark::State& state)
     }
 }
 
+/* The short IDs of a compact block of 8 transactions, one at a time or with the batch API */
+static void HASH_SipHash_0032b_x8(benchmark::State& state, bool fBatch)
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> vals(8);
+    std::vector<const uint256*> inputs;
+    for (auto& val : vals) {
+        val = rng.rand256();
+        inputs.emplace_back(&val);
+    }
+    uint64_t out[8];
+    uint64_t k1 = 0;
+    while (state.KeepRunning()) {
+        ++k1;
+        if (fBatch) {
+            SipHashUint256Batch(0, k1, inputs.data(), inputs.size(), out);
+        } else {
+            for (size_t i = 0; i < vals.size(); i++) {
+                out[i] = SipHashUint256(0, k1, vals[i]);
+            }
+        }
+        *((uint64_t*)vals[0].begin()) ^= out[7];
+    }
+}
+
+static void HASH_SipHash_0032b_x8_single(benchmark::State& state) { HASH_SipHash_0032b_x8(state, false); }
+static void HASH_SipHash_0032b_x8_batch(benchmark::State& state) { HASH_SipHash_0032b_x8(state, true); }
+
 static void FastRandom_32bit(benchmark::State& state)
 {
     FastRandomContext rng(true);
@@ -220,7 +275,11 @@ BENCHMARK(HASH_X11, 500);
 BENCHMARK(HASH_SHA256_0032b, 4 * 1000 * 1000);
 BENCHMARK(HASH_DSHA256_0032b, 2 * 1000 * 1000);
 BENCHMARK(HASH_SipHash_0032b, 35 * 1000 * 1000);
+BENCHMARK(HASH_SipHash_0032b_x8_single, 4 * 1000 * 1000);
+BENCHMARK(HASH_SipHash_0032b_x8_batch, 4 * 1000 * 1000);
 BENCHMARK(HASH_SHA256D64_1024, 7400);
+BENCHMARK(HASH_DSHA256_1000tx_single, 2000);
+BENCHMARK(HASH_DSHA256_1000tx_batch, 2000);
 
 BENCHMARK(HASH_DSHA256_0032b_single, 2000 * 1000);
 BENCHMARK(HASH_DSHA256_0080b_single, 1500 * 1000);
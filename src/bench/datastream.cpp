@@ -0,0 +1,65 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <clientversion.h>
+#include <random.h>
+#include <streams.h>
+#include <uint256.h>
+#include <version.h>
+
+#include <utility>
+#include <vector>
+
+// The temporary streams of a database lookup, like CDBWrapper::Read creates them: the key is serialized into one stream,
+// the value is copied into another one and deserialized from it. "Zeroing" are the streams which clear their buffers
+// when freed, "Pooled" the ones which take them from the thread local pool.
+template<typename Stream>
+static void DataStreamDBLookup(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<uint256> vecHashes;
+    for (int i = 0; i < 1000; i++) {
+        vecHashes.emplace_back(rng.rand256());
+    }
+    std::vector<char> vchValue(200, 0x42);
+
+    while (state.KeepRunning()) {
+        for (const auto& hash : vecHashes) {
+            Stream ssKey(SER_DISK, CLIENT_VERSION);
+            ssKey.reserve(64);
+            ssKey << std::make_pair('b', hash);
+            Stream ssValue(vchValue.data(), vchValue.data() + vchValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue.Xor({0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08});
+            std::vector<char> vchRead(ssValue.size());
+            ssValue.read(vchRead.data(), vchRead.size());
+            assert(ssKey.size() == 33);
+        }
+    }
+}
+
+// Serializing a relayed transaction sized message for publishing, e.g. by the ZMQ notifiers
+template<typename Stream>
+static void DataStreamSerializeMessage(benchmark::State& state)
+{
+    std::vector<unsigned char> vchPayload(400, 0x42);
+
+    while (state.KeepRunning()) {
+        for (int i = 0; i < 1000; i++) {
+            Stream ss(SER_NETWORK, PROTOCOL_VERSION);
+            ss << vchPayload;
+            assert(ss.size() == 402);
+        }
+    }
+}
+
+static void DataStreamDBLookup_Zeroing(benchmark::State& state) { DataStreamDBLookup<CDataStream>(state); }
+static void DataStreamDBLookup_Pooled(benchmark::State& state) { DataStreamDBLookup<CPooledDataStream>(state); }
+static void DataStreamSerializeMessage_Zeroing(benchmark::State& state) { DataStreamSerializeMessage<CDataStream>(state); }
+static void DataStreamSerializeMessage_Pooled(benchmark::State& state) { DataStreamSerializeMessage<CPooledDataStream>(state); }
+
+BENCHMARK(DataStreamDBLookup_Zeroing, 500);
+BENCHMARK(DataStreamDBLookup_Pooled, 500);
+BENCHMARK(DataStreamSerializeMessage_Zeroing, 500);
+BENCHMARK(DataStreamSerializeMessage_Pooled, 500);
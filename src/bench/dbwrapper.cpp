@@ -0,0 +1,131 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <random.h>
+#include <util.h>
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// Entries added per iteration, each followed by as many random point reads
+static const uint32_t BATCH_ENTRIES = 1000;
+
+// Writes coin-sized values (a random part followed by repetitive data, like scripts and amounts), so that block size,
+// compression and the bloom filter all make a difference. The size of the database on disk is printed to stderr.
+static void DBWrapperWriteRead(benchmark::State& state, const std::string& name, const CDBTuning& tuning)
+{
+    const fs::path path = GetDataDir() / ("bench_dbwrapper_" + name);
+    FastRandomContext rng(true);
+    {
+        CDBWrapper db(path, 8 << 20, false, true, false, tuning);
+        std::vector<unsigned char> value(100, 0x76);
+        uint32_t n = 0;
+        while (state.KeepRunning()) {
+            CDBBatch batch(db);
+            for (uint32_t i = 0; i < BATCH_ENTRIES; i++, n++) {
+                for (size_t j = 0; j < 32; j++) {
+                    value[j] = rng.randbits(8);
+                }
+                batch.Write(std::make_pair('c', n), value);
+            }
+            db.WriteBatch(batch);
+            for (uint32_t i = 0; i < BATCH_ENTRIES; i++) {
+                // Half of the reads miss, which is what the bloom filter is for
+                db.Read(std::make_pair('c', (uint32_t)rng.randrange(2 * n)), value);
+            }
+        }
+        db.CompactFull();
+    }
+
+    uint64_t nSize = 0;
+    for (fs::recursive_directory_iterator it(path), end; it != end; ++it) {
+        if (fs::is_regular_file(*it)) {
+            nSize += fs::file_size(*it);
+        }
+    }
+    std::cerr << "# DBWrapper " << name << ": " << nSize << " bytes on disk" << std::endl;
+    fs::remove_all(path);
+}
+
+static void DBWrapperDefault(benchmark::State& state)
+{
+    DBWrapperWriteRead(state, "default", CDBTuning());
+}
+
+static void DBWrapperLargeBlocks(benchmark::State& state)
+{
+    CDBTuning tuning;
+    tuning.nBlockSize = 16 * 1024;
+    tuning.nMaxFileSize = 8 * 1024 * 1024;
+    DBWrapperWriteRead(state, "largeblocks", tuning);
+}
+
+static void DBWrapperCompression(benchmark::State& state)
+{
+    CDBTuning tuning;
+    tuning.nBlockSize = 16 * 1024;
+    tuning.fCompression = true;
+    DBWrapperWriteRead(state, "compression", tuning);
+}
+
+static void DBWrapperNoBloom(benchmark::State& state)
+{
+    CDBTuning tuning;
+    tuning.nBloomBits = 0;
+    DBWrapperWriteRead(state, "nobloom", tuning);
+}
+
+// Looks up the inputs of a block worth of transactions in a database of 200k coin-sized entries, half of them missing
+static void DBWrapperReadBatch(benchmark::State& state, bool fMulti)
+{
+    const fs::path path = GetDataDir() / (fMulti ? "bench_dbwrapper_readmulti" : "bench_dbwrapper_readperkey");
+    FastRandomContext rng(true);
+    CDBWrapper db(path, 8 << 20, false, true, false, GetDBTuning("chainstate"));
+    static const uint32_t ENTRIES = 200000;
+    std::vector<unsigned char> value(100, 0x76);
+    for (uint32_t n = 0; n < ENTRIES;) {
+        CDBBatch batch(db);
+        for (uint32_t i = 0; i < 10000; i++, n++) {
+            batch.Write(std::make_pair('c', n), value);
+        }
+        db.WriteBatch(batch);
+    }
+    db.CompactFull();
+
+    std::vector<std::pair<char, uint32_t>> keys(5000);
+    std::vector<std::vector<unsigned char>> values;
+    std::vector<bool> found;
+    while (state.KeepRunning()) {
+        for (auto& key : keys) {
+            key = std::make_pair('c', (uint32_t)rng.randrange(2 * ENTRIES));
+        }
+        if (fMulti) {
+            db.ReadMulti(keys, values, found);
+        } else {
+            for (const auto& key : keys) {
+                db.Read(key, value);
+            }
+        }
+    }
+}
+
+static void DBWrapperReadPerKey(benchmark::State& state)
+{
+    DBWrapperReadBatch(state, false);
+}
+
+static void DBWrapperReadMulti(benchmark::State& state)
+{
+    DBWrapperReadBatch(state, true);
+}
+
+BENCHMARK(DBWrapperDefault, 20);
+BENCHMARK(DBWrapperLargeBlocks, 20);
+BENCHMARK(DBWrapperCompression, 20);
+BENCHMARK(DBWrapperNoBloom, 20);
+BENCHMARK(DBWrapperReadPerKey, 50);
+BENCHMARK(DBWrapperReadMulti, 50);
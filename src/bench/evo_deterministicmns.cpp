@@ -0,0 +1,113 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/evo_util.h>
+#include <evo/simplifiedmns.h>
+#include <random.h>
+
+// 5000 MNs, every 20th of them has a PoSe penalty which has to be decreased in each block
+static CDeterministicMNList CreatePenalizedMNList()
+{
+    FastRandomContext rng(true);
+    auto mnList = CreateBenchMNList(5000);
+    std::vector<uint256> toPunish;
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        if (dmn->GetInternalId() % 20 == 0) {
+            toPunish.emplace_back(dmn->proTxHash);
+        }
+    });
+    for (const auto& proTxHash : toPunish) {
+        auto newState = std::make_shared<CDeterministicMNState>(*mnList.GetMN(proTxHash)->pdmnState);
+        newState->nPoSePenalty = 1 + rng.randrange(100);
+        mnList.UpdateMN(proTxHash, newState);
+    }
+    return mnList;
+}
+
+// The list transition CDeterministicMNManager::BuildNewListFromBlock does for a block without ProTxes besides two
+// ProUpServTxes: copy the list, decrease the PoSe penalties, apply the service updates and pay the payee. The diff
+// that is stored for the block is built from it afterwards, like in ProcessBlock.
+static void DeterministicMNListBlockTransition(benchmark::State& state)
+{
+    const auto oldList = CreatePenalizedMNList();
+    std::vector<uint256> vProTxHashes;
+    oldList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        vProTxHashes.emplace_back(dmn->proTxHash);
+    });
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        CDeterministicMNList newList = oldList;
+        newList.SetBlockHash(uint256());
+        newList.SetHeight(oldList.GetHeight() + 1);
+
+        auto payee = oldList.GetMNPayee();
+
+        std::vector<uint256> toDecrease;
+        newList.ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
+            if (dmn->pdmnState->nPoSePenalty > 0 && !dmn->pdmnState->IsBanned()) {
+                toDecrease.emplace_back(dmn->proTxHash);
+            }
+        });
+        for (const auto& proTxHash : toDecrease) {
+            newList.PoSeDecrease(proTxHash);
+        }
+
+        for (size_t j = 0; j < 2; j++) {
+            const uint256& proTxHash = vProTxHashes[i++ % vProTxHashes.size()];
+            auto newState = std::make_shared<CDeterministicMNState>(*newList.GetMN(proTxHash)->pdmnState);
+            newState->addr = CService(newState->addr, newState->addr.GetPort() + 1);
+            newList.UpdateMN(proTxHash, newState);
+        }
+
+        assert(payee);
+        auto payeeState = std::make_shared<CDeterministicMNState>(*newList.GetMN(payee->proTxHash)->pdmnState);
+        payeeState->nLastPaidHeight = newList.GetHeight();
+        newList.UpdateMN(payee->proTxHash, payeeState);
+
+        auto diff = oldList.BuildDiff(newList);
+        assert(!diff.updatedMNs.empty());
+    }
+}
+
+// The merkle root of the SML CalcCbTxMerkleRootMNList verifies for each block, once the block of the previous
+// benchmark has been applied. "full" builds the SML of all 5000 MNs and hashes it from scratch, "tree" copies the tree
+// of the previous block and only rehashes the paths of the changed entries.
+static void SimplifiedMNListMerkleRoot(benchmark::State& state, bool fTree)
+{
+    const auto oldList = CreatePenalizedMNList();
+    CDeterministicMNList newList = oldList;
+    newList.SetHeight(oldList.GetHeight() + 1);
+    size_t nUpdates = 0;
+    oldList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        if (nUpdates++ < 3) {
+            auto newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+            newState->addr = CService(newState->addr, newState->addr.GetPort() + 1);
+            newList.UpdateMN(dmn->proTxHash, newState);
+        }
+    });
+    const auto diff = oldList.BuildDiff(newList);
+    const CSimplifiedMNListMerkleTree oldTree(oldList);
+    const uint256 expectedRoot = CSimplifiedMNList(newList).CalcMerkleRoot();
+
+    while (state.KeepRunning()) {
+        uint256 merkleRoot;
+        if (fTree) {
+            CSimplifiedMNListMerkleTree tree(oldTree);
+            tree.ApplyDiff(oldList, newList, diff);
+            merkleRoot = tree.GetMerkleRoot();
+        } else {
+            merkleRoot = CSimplifiedMNList(newList).CalcMerkleRoot();
+        }
+        assert(merkleRoot == expectedRoot);
+    }
+}
+
+static void SimplifiedMNListMerkleRootFull_5000(benchmark::State& state) { SimplifiedMNListMerkleRoot(state, false); }
+static void SimplifiedMNListMerkleRootTree_5000(benchmark::State& state) { SimplifiedMNListMerkleRoot(state, true); }
+
+BENCHMARK(DeterministicMNListBlockTransition, 100);
+BENCHMARK(SimplifiedMNListMerkleRootFull_5000, 20);
+BENCHMARK(SimplifiedMNListMerkleRootTree_5000, 200);
@@ -0,0 +1,53 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bench/evo_util.h>
+#include <streams.h>
+
+static void MNListSnapshotSerialize(benchmark::State& state, bool fCompact)
+{
+    auto mnList = CreateBenchMNList(5000);
+    while (state.KeepRunning()) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        if (fCompact) {
+            ss << CDeterministicMNListCompactSnapshot(mnList);
+        } else {
+            ss << mnList;
+        }
+    }
+}
+
+static void MNListSnapshotLoad(benchmark::State& state, bool fCompact)
+{
+    auto mnList = CreateBenchMNList(5000);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    if (fCompact) {
+        ss << CDeterministicMNListCompactSnapshot(mnList);
+    } else {
+        ss << mnList;
+    }
+    while (state.KeepRunning()) {
+        CDataStream ss2(ss);
+        if (fCompact) {
+            CDeterministicMNListCompactSnapshot snapshot;
+            ss2 >> snapshot;
+            assert(snapshot.mnList.GetAllMNsCount() == mnList.GetAllMNsCount());
+        } else {
+            CDeterministicMNList snapshot;
+            ss2 >> snapshot;
+            assert(snapshot.GetAllMNsCount() == mnList.GetAllMNsCount());
+        }
+    }
+}
+
+static void MNListSnapshotSerializeLegacy_5000(benchmark::State& state) { MNListSnapshotSerialize(state, false); }
+static void MNListSnapshotSerializeCompact_5000(benchmark::State& state) { MNListSnapshotSerialize(state, true); }
+static void MNListSnapshotLoadLegacy_5000(benchmark::State& state) { MNListSnapshotLoad(state, false); }
+static void MNListSnapshotLoadCompact_5000(benchmark::State& state) { MNListSnapshotLoad(state, true); }
+
+BENCHMARK(MNListSnapshotSerializeLegacy_5000, 20);
+BENCHMARK(MNListSnapshotSerializeCompact_5000, 20);
+BENCHMARK(MNListSnapshotLoadLegacy_5000, 5);
+BENCHMARK(MNListSnapshotLoadCompact_5000, 5);
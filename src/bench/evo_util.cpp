@@ -0,0 +1,40 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/evo_util.h>
+#include <netbase.h>
+#include <random.h>
+#include <script/standard.h>
+
+CDeterministicMNList CreateBenchMNList(size_t count)
+{
+    FastRandomContext rng(true);
+    CDeterministicMNList mnList(uint256(), 1000000, 0);
+    std::vector<CScript> vPoolPayouts;
+    for (size_t i = 0; i < 20; i++) {
+        vPoolPayouts.emplace_back(GetScriptForDestination(CKeyID(uint160(rng.randbytes(20)))));
+    }
+    for (size_t i = 0; i < count; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>(i);
+        dmn->proTxHash = rng.rand256();
+        dmn->collateralOutpoint = COutPoint(rng.rand256(), rng.randrange(4));
+
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->nRegisteredHeight = 900000 + rng.randrange(100000);
+        state->nLastPaidHeight = 995000 + rng.randrange(5000);
+        state->UpdateConfirmedHash(dmn->proTxHash, rng.rand256());
+        state->keyIDOwner = CKeyID(uint160(rng.randbytes(20)));
+        state->keyIDVoting = rng.randbool() ? state->keyIDOwner : CKeyID(uint160(rng.randbytes(20)));
+        CBLSSecretKey sk;
+        sk.MakeNewKey();
+        state->pubKeyOperator.Set(sk.GetPublicKey());
+        Lookup(strprintf("10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff).c_str(), state->addr, 9999, false);
+        // a part of the MNs is hosted by services sharing the same payout script
+        state->scriptPayout = i % 3 ? GetScriptForDestination(CKeyID(uint160(rng.randbytes(20)))) : vPoolPayouts[rng.randrange(vPoolPayouts.size())];
+        dmn->pdmnState = state;
+
+        mnList.AddMN(dmn);
+    }
+    return mnList;
+}
@@ -0,0 +1,16 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_EVO_UTIL_H
+#define BITCOIN_BENCH_EVO_UTIL_H
+
+#include <evo/deterministicmns.h>
+
+/**
+ * Create a deterministic list of count registered and confirmed masternodes at height 1000000, with distinct
+ * addresses and keys. A third of them shares the payout scripts of a few hosting services, like on mainnet.
+ */
+CDeterministicMNList CreateBenchMNList(size_t count);
+
+#endif // BITCOIN_BENCH_EVO_UTIL_H
@@ -0,0 +1,76 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bls/bls_batchverifier.h>
+#include <chainparams.h>
+#include <governance/governance-vote.h>
+#include <governance/governance-votedb.h>
+#include <key.h>
+#include <random.h>
+
+// The votes of 1000 masternodes on one governance object as CGovernanceManager::ProcessPendingVotes handles them: the
+// signatures are verified and each vote is added to the vote file of the object. "ECDSA" are funding votes on a
+// proposal, signed with the voting keys and verified one by one, "BLS" are trigger votes signed with the operator keys
+// and verified in one batch.
+static void GovernanceVoteIngest(benchmark::State& state, bool fBLS)
+{
+    SelectParams(CBaseChainParams::MAIN);
+
+    FastRandomContext rng(true);
+    const uint256 nParentHash = rng.rand256();
+    const int64_t nTime = 1600000000;
+    std::vector<CGovernanceVote> vecVotes;
+    std::vector<CKeyID> vecKeyIDs;
+    std::vector<CBLSPublicKey> vecPubKeys;
+    for (size_t i = 0; i < 1000; i++) {
+        CGovernanceVote vote(COutPoint(rng.rand256(), 1), nParentHash, VOTE_SIGNAL_FUNDING, rng.randbool() ? VOTE_OUTCOME_YES : VOTE_OUTCOME_NO);
+        vote.SetTime(nTime + rng.randrange(3600));
+        if (fBLS) {
+            CBLSSecretKey sk;
+            sk.MakeNewKey();
+            bool fSigned = vote.Sign(sk);
+            assert(fSigned);
+            vecPubKeys.emplace_back(sk.GetPublicKey());
+        } else {
+            CKey key;
+            key.MakeNewKey(true);
+            bool fSigned = vote.Sign(key, key.GetPubKey().GetID());
+            assert(fSigned);
+            vecKeyIDs.emplace_back(key.GetPubKey().GetID());
+        }
+        vecVotes.emplace_back(vote);
+    }
+
+    while (state.KeepRunning()) {
+        std::vector<bool> vecVerified(vecVotes.size());
+        if (fBLS) {
+            CBLSBatchVerifier<int, size_t> batchVerifier(false, true, 8);
+            for (size_t i = 0; i < vecVotes.size(); i++) {
+                batchVerifier.PushMessage(i % 8, i, vecVotes[i].GetSignatureHash(), CBLSSignature(vecVotes[i].GetSignature()), vecPubKeys[i]);
+            }
+            batchVerifier.Verify();
+            for (size_t i = 0; i < vecVotes.size(); i++) {
+                vecVerified[i] = !batchVerifier.badMessages.count(i);
+            }
+        } else {
+            for (size_t i = 0; i < vecVotes.size(); i++) {
+                vecVerified[i] = vecVotes[i].CheckSignature(vecKeyIDs[i]);
+            }
+        }
+
+        CGovernanceObjectVoteFile fileVotes;
+        for (size_t i = 0; i < vecVotes.size(); i++) {
+            assert(vecVerified[i]);
+            fileVotes.AddVote(vecVotes[i]);
+        }
+        assert(fileVotes.GetVoteCount() == (int)vecVotes.size());
+    }
+}
+
+static void GovernanceVoteIngest_ECDSA_1000(benchmark::State& state) { GovernanceVoteIngest(state, false); }
+static void GovernanceVoteIngest_BLS_1000(benchmark::State& state) { GovernanceVoteIngest(state, true); }
+
+BENCHMARK(GovernanceVoteIngest_ECDSA_1000, 2);
+BENCHMARK(GovernanceVoteIngest_BLS_1000, 2);
@@ -0,0 +1,108 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <consensus/merkle.h>
+#include <hash.h>
+#include <llmq/quorums_commitment.h>
+#include <llmq/quorums_utils.h>
+#include <random.h>
+
+#include <algorithm>
+#include <tuple>
+
+// A final commitment of a quorum with quorumSize members of which all but 5% signed and are valid, with the
+// signatures actually made by the members and the recovered quorum key
+static llmq::CFinalCommitment CreateCommitment(FastRandomContext& rng, Consensus::LLMQType llmqType, size_t quorumSize,
+                                               std::vector<CBLSPublicKey>& memberPubKeysRet)
+{
+    llmq::CFinalCommitment qc;
+    qc.llmqType = llmqType;
+    qc.quorumHash = rng.rand256();
+    qc.quorumVvecHash = rng.rand256();
+    CBLSSecretKey quorumSecretKey;
+    quorumSecretKey.MakeNewKey();
+    qc.quorumPublicKey = quorumSecretKey.GetPublicKey();
+    qc.signers.resize(quorumSize);
+    qc.validMembers.resize(quorumSize);
+    for (size_t i = 0; i < quorumSize; i++) {
+        qc.validMembers[i] = qc.signers[i] = (i % 20) != 0;
+    }
+
+    uint256 commitmentHash = llmq::CLLMQUtils::BuildCommitmentHash(llmqType, qc.quorumHash, qc.validMembers, qc.quorumPublicKey, qc.quorumVvecHash);
+    std::vector<CBLSSignature> memberSigs;
+    memberPubKeysRet.clear();
+    for (size_t i = 0; i < quorumSize; i++) {
+        if (!qc.signers[i]) {
+            continue;
+        }
+        CBLSSecretKey sk;
+        sk.MakeNewKey();
+        memberSigs.emplace_back(sk.Sign(commitmentHash));
+        memberPubKeysRet.emplace_back(sk.GetPublicKey());
+    }
+    qc.membersSig.Set(CBLSSignature::AggregateSecure(memberSigs, memberPubKeysRet, commitmentHash));
+    qc.quorumSig.Set(quorumSecretKey.Sign(commitmentHash));
+    return qc;
+}
+
+// The signature checks of CFinalCommitment::Verify, which CQuorumBlockProcessor::ProcessBlock does for each mined
+// commitment. These dominate the cost of connecting a block with a commitment, the member lookup isn't included.
+static void QuorumCommitmentVerify(benchmark::State& state, Consensus::LLMQType llmqType, size_t quorumSize)
+{
+    FastRandomContext rng(true);
+    std::vector<CBLSPublicKey> memberPubKeys;
+    const auto qc = CreateCommitment(rng, llmqType, quorumSize, memberPubKeys);
+
+    while (state.KeepRunning()) {
+        uint256 commitmentHash = llmq::CLLMQUtils::BuildCommitmentHash(llmqType, qc.quorumHash, qc.validMembers, qc.quorumPublicKey, qc.quorumVvecHash);
+        bool valid = qc.membersSig.Get().VerifySecureAggregated(memberPubKeys, commitmentHash) &&
+                     qc.quorumSig.Get().VerifyInsecure(qc.quorumPublicKey, commitmentHash);
+        assert(valid);
+    }
+}
+
+// The quorum merkle root of CalcCbTxMerkleRootQuorums for the active quorums of mainnet (24 LLMQ_50_60, 4 LLMQ_400_60,
+// 4 LLMQ_400_85 and 24 LLMQ_100_67), once their commitment hashes have been collected
+static void CbTxMerkleRootQuorums(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    const std::vector<std::tuple<Consensus::LLMQType, size_t, size_t>> vecActiveQuorums{
+        {Consensus::LLMQ_50_60, 50, 24},
+        {Consensus::LLMQ_400_60, 400, 4},
+        {Consensus::LLMQ_400_85, 400, 4},
+        {Consensus::LLMQ_100_67, 100, 24},
+    };
+    std::vector<llmq::CFinalCommitment> vecCommitments;
+    for (const auto& t : vecActiveQuorums) {
+        for (size_t i = 0; i < std::get<2>(t); i++) {
+            llmq::CFinalCommitment qc;
+            qc.llmqType = std::get<0>(t);
+            qc.quorumHash = rng.rand256();
+            qc.quorumVvecHash = rng.rand256();
+            qc.signers.assign(std::get<1>(t), true);
+            qc.validMembers.assign(std::get<1>(t), true);
+            vecCommitments.emplace_back(qc);
+        }
+    }
+
+    while (state.KeepRunning()) {
+        std::vector<uint256> qcHashesVec;
+        qcHashesVec.reserve(vecCommitments.size());
+        for (const auto& qc : vecCommitments) {
+            qcHashesVec.emplace_back(::SerializeHash(qc));
+        }
+        std::sort(qcHashesVec.begin(), qcHashesVec.end());
+        bool mutated = false;
+        uint256 merkleRoot = ComputeMerkleRoot(qcHashesVec, &mutated);
+        assert(!merkleRoot.IsNull() && !mutated);
+    }
+}
+
+static void QuorumCommitmentVerify_50(benchmark::State& state) { QuorumCommitmentVerify(state, Consensus::LLMQ_50_60, 50); }
+static void QuorumCommitmentVerify_400(benchmark::State& state) { QuorumCommitmentVerify(state, Consensus::LLMQ_400_60, 400); }
+
+BENCHMARK(QuorumCommitmentVerify_50, 20);
+BENCHMARK(QuorumCommitmentVerify_400, 5);
+BENCHMARK(CbTxMerkleRootQuorums, 1000);
@@ -0,0 +1,108 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bls/bls_batchverifier.h>
+#include <chainparams.h>
+#include <dbwrapper.h>
+#include <llmq/quorums_instantsend.h>
+#include <llmq/quorums_utils.h>
+#include <random.h>
+
+// Simulates the conflict checks done while reconnecting blocks after a large reorg. The reconnected blocks contain 10k
+// TXs with 2 inputs each, a quarter of them is locked by islocks in the db, everything else spends unlocked outputs.
+// There are no conflicts, which is the common case. "index" goes through the in-memory outpoint index of
+// CInstantSendDb, "db" does the per input db lookup that was done for every input before the index existed.
+static void InstantSendReorgConflicts(benchmark::State& state, bool useIndex)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+
+    FastRandomContext rng(true);
+    CDBWrapper dbw(fs::path(), 64 << 20, true);
+    llmq::CInstantSendDb db(dbw, 1 << 20);
+
+    std::vector<CTransaction> txs;
+    std::vector<std::tuple<uint256, llmq::CInstantSendLockPtr, int>> islocks;
+    for (size_t i = 0; i < 10000; i++) {
+        CMutableTransaction mtx;
+        mtx.vin.emplace_back(COutPoint(rng.rand256(), 0));
+        mtx.vin.emplace_back(COutPoint(rng.rand256(), 1));
+        txs.emplace_back(mtx);
+
+        if (i % 4 == 0) {
+            auto islock = std::make_shared<llmq::CInstantSendLock>();
+            islock->txid = txs.back().GetHash();
+            for (const auto& in : mtx.vin) {
+                islock->inputs.emplace_back(in.prevout);
+            }
+            islocks.emplace_back(::SerializeHash(*islock), islock, -1);
+        }
+    }
+    db.WriteNewInstantSendLocks(islocks);
+
+    while (state.KeepRunning()) {
+        for (const auto& tx : txs) {
+            bool conflict = false;
+            if (useIndex) {
+                conflict = !db.GetConflictingLockHash(tx).IsNull();
+            } else {
+                for (const auto& in : tx.vin) {
+                    uint256 islockHash;
+                    if (dbw.Read(std::make_tuple(std::string("is_in"), in.prevout), islockHash)) {
+                        conflict |= db.GetInstantSendLockByHash(islockHash)->txid != tx.GetHash();
+                    }
+                }
+            }
+            assert(!conflict);
+        }
+    }
+}
+
+// The verification of a batch of pending islocks in CInstantSendManager::ProcessPendingInstantSendLocks. 1000
+// islocks with 2 inputs each, received from 8 peers and signed by the 24 active LLMQ_50_60 quorums. The request ids and
+// sign hashes are computed for each lock and all signatures are verified with one batched verification. The quorum
+// selection is left out, each islock is assigned to one of the quorums up front.
+static void InstantSendVerifyPendingLocks(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    const auto llmqType = Consensus::LLMQ_50_60;
+    std::vector<std::pair<uint256, CBLSSecretKey>> quorums(24);
+    std::vector<CBLSPublicKey> quorumPubKeys;
+    for (auto& p : quorums) {
+        p.first = rng.rand256();
+        p.second.MakeNewKey();
+        quorumPubKeys.emplace_back(p.second.GetPublicKey());
+    }
+
+    std::vector<std::pair<size_t, llmq::CInstantSendLock>> islocks;
+    for (size_t i = 0; i < 1000; i++) {
+        const size_t quorumIdx = rng.randrange(quorums.size());
+        llmq::CInstantSendLock islock;
+        islock.txid = rng.rand256();
+        islock.inputs.emplace_back(rng.rand256(), 0);
+        islock.inputs.emplace_back(rng.rand256(), 1);
+        uint256 signHash = llmq::CLLMQUtils::BuildSignHash(llmqType, quorums[quorumIdx].first, islock.GetRequestId(), islock.txid);
+        islock.sig.Set(quorums[quorumIdx].second.Sign(signHash));
+        islocks.emplace_back(quorumIdx, islock);
+    }
+
+    while (state.KeepRunning()) {
+        CBLSBatchVerifier<NodeId, uint256> batchVerifier(false, true, 8);
+        for (size_t i = 0; i < islocks.size(); i++) {
+            const auto& islock = islocks[i].second;
+            const size_t quorumIdx = islocks[i].first;
+            uint256 signHash = llmq::CLLMQUtils::BuildSignHash(llmqType, quorums[quorumIdx].first, islock.GetRequestId(), islock.txid);
+            batchVerifier.PushMessage(i % 8, ::SerializeHash(islock), signHash, islock.sig.Get(), quorumPubKeys[quorumIdx]);
+        }
+        batchVerifier.Verify();
+        assert(batchVerifier.badMessages.empty());
+    }
+}
+
+static void InstantSendReorgConflicts_index(benchmark::State& state) { InstantSendReorgConflicts(state, true); }
+static void InstantSendReorgConflicts_db(benchmark::State& state) { InstantSendReorgConflicts(state, false); }
+
+BENCHMARK(InstantSendReorgConflicts_index, 100);
+BENCHMARK(InstantSendReorgConflicts_db, 5);
+BENCHMARK(InstantSendVerifyPendingLocks, 2);
@@ -0,0 +1,108 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <llmq/quorums_chainlocks.h>
+#include <llmq/quorums_commitment.h>
+#include <random.h>
+#include <saltedhasher.h>
+#include <streams.h>
+
+#include <unordered_set>
+
+// A CLSIG with the signature decoded on deserialization, like CChainLockSig was before it used CBLSLazySignature
+struct EagerChainLockSig
+{
+    int32_t nHeight{-1};
+    uint256 blockHash;
+    CBLSSignature sig;
+
+    ADD_SERIALIZE_METHODS
+
+    template<typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nHeight);
+        READWRITE(blockHash);
+        READWRITE(sig);
+    }
+};
+
+// An inv storm of CLSIGs: 100 CLSIGs are each received from 8 peers. Every copy is deserialized and hashed, the
+// duplicates are dropped by their hash and only the first copy goes on to be verified (which isn't included).
+// "eager" decodes the signature of each copy, "lazy" only keeps the bytes until the signature is needed.
+template<typename T>
+static void ChainLockSigInvStorm(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CBLSSecretKey sk;
+    sk.MakeNewKey();
+    std::vector<CDataStream> vecMessages;
+    for (int i = 0; i < 100; i++) {
+        llmq::CChainLockSig clsig;
+        clsig.nHeight = 1000000 + i;
+        clsig.blockHash = rng.rand256();
+        clsig.sig.Set(sk.Sign(clsig.blockHash));
+        CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+        ds << clsig;
+        for (int j = 0; j < 8; j++) {
+            vecMessages.emplace_back(ds);
+        }
+    }
+
+    while (state.KeepRunning()) {
+        std::unordered_set<uint256, StaticSaltedHasher> seen;
+        for (const auto& msg : vecMessages) {
+            CDataStream ds(msg);
+            T clsig;
+            ds >> clsig;
+            seen.emplace(::SerializeHash(clsig));
+        }
+        assert(seen.size() == 100);
+    }
+}
+
+// The same for the final commitments of LLMQ_400_60 quorums, relayed as QFCOMMIT by the members during the mining
+// phase of the DKG. CQuorumBlockProcessor drops the ones it already has by their hash.
+static void FinalCommitmentInvStorm(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    CBLSSecretKey sk;
+    sk.MakeNewKey();
+    std::vector<CDataStream> vecMessages;
+    for (int i = 0; i < 4; i++) {
+        llmq::CFinalCommitment qc;
+        qc.llmqType = Consensus::LLMQ_400_60;
+        qc.quorumHash = rng.rand256();
+        qc.signers.assign(400, true);
+        qc.validMembers.assign(400, true);
+        qc.quorumPublicKey = sk.GetPublicKey();
+        qc.quorumVvecHash = rng.rand256();
+        qc.quorumSig.Set(sk.Sign(qc.quorumHash));
+        qc.membersSig.Set(sk.Sign(qc.quorumVvecHash));
+        CDataStream ds(SER_NETWORK, PROTOCOL_VERSION);
+        ds << qc;
+        for (int j = 0; j < 25; j++) {
+            vecMessages.emplace_back(ds);
+        }
+    }
+
+    while (state.KeepRunning()) {
+        std::unordered_set<uint256, StaticSaltedHasher> seen;
+        for (const auto& msg : vecMessages) {
+            CDataStream ds(msg);
+            llmq::CFinalCommitment qc;
+            ds >> qc;
+            seen.emplace(::SerializeHash(qc));
+        }
+        assert(seen.size() == 4);
+    }
+}
+
+static void ChainLockSigInvStorm_Eager(benchmark::State& state) { ChainLockSigInvStorm<EagerChainLockSig>(state); }
+static void ChainLockSigInvStorm_Lazy(benchmark::State& state) { ChainLockSigInvStorm<llmq::CChainLockSig>(state); }
+
+BENCHMARK(ChainLockSigInvStorm_Eager, 5);
+BENCHMARK(ChainLockSigInvStorm_Lazy, 50);
+BENCHMARK(FinalCommitmentInvStorm, 20);
@@ -0,0 +1,42 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <evo/deterministicmns.h>
+#include <random.h>
+
+static CDeterministicMNList CreateMNList(size_t count)
+{
+    FastRandomContext rng(true);
+    CDeterministicMNList mnList(uint256(), 0, 0);
+    for (size_t i = 0; i < count; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>(i);
+        dmn->proTxHash = rng.rand256();
+        dmn->collateralOutpoint = COutPoint(rng.rand256(), 0);
+
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->keyIDOwner = CKeyID(uint160(rng.randbytes(20)));
+        state->UpdateConfirmedHash(dmn->proTxHash, rng.rand256());
+        dmn->pdmnState = state;
+
+        mnList.AddMN(dmn);
+    }
+    return mnList;
+}
+
+static void CalculateQuorum(benchmark::State& state, size_t mnCount, size_t quorumSize)
+{
+    auto mnList = CreateMNList(mnCount);
+    FastRandomContext rng(true);
+    while (state.KeepRunning()) {
+        auto members = mnList.CalculateQuorum(quorumSize, rng.rand256());
+        assert(members.size() == quorumSize);
+    }
+}
+
+static void CalculateQuorum_5000_50(benchmark::State& state) { CalculateQuorum(state, 5000, 50); }
+static void CalculateQuorum_5000_400(benchmark::State& state) { CalculateQuorum(state, 5000, 400); }
+
+BENCHMARK(CalculateQuorum_5000_50, 100);
+BENCHMARK(CalculateQuorum_5000_400, 100);
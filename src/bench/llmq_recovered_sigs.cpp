@@ -0,0 +1,53 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <dbwrapper.h>
+#include <llmq/quorums_signing.h>
+#include <random.h>
+
+// Simulates a storm of qsigrec invs for unknown recovered sigs, which is what AlreadyHave() sees most of the time.
+// The db holds 20k recovered sigs. "filter" goes through CRecoveredSigsDb, "nofilter" does the plain db lookup that
+// was done for every such inv before the filter was put in front of it.
+static void RecoveredSigsInvStorm(benchmark::State& state, bool useFilter)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+
+    FastRandomContext rng(true);
+    CDBWrapper dbw(fs::path(), 64 << 20, true);
+    llmq::CRecoveredSigsDb db(dbw);
+    for (size_t i = 0; i < 20000; i++) {
+        llmq::CRecoveredSig recSig;
+        recSig.llmqType = Consensus::LLMQ_50_60;
+        recSig.quorumHash = rng.rand256();
+        recSig.id = rng.rand256();
+        recSig.msgHash = rng.rand256();
+        recSig.UpdateHash();
+        db.WriteRecoveredSig(recSig);
+    }
+
+    std::vector<uint256> invHashes;
+    for (size_t i = 0; i < 1000; i++) {
+        invHashes.emplace_back(rng.rand256());
+    }
+
+    while (state.KeepRunning()) {
+        for (const auto& hash : invHashes) {
+            bool have;
+            if (useFilter) {
+                have = db.HasRecoveredSigForHash(hash);
+            } else {
+                have = dbw.Exists(std::make_tuple(std::string("rs_h"), hash));
+            }
+            assert(!have);
+        }
+    }
+}
+
+static void RecoveredSigsInvStorm_filter(benchmark::State& state) { RecoveredSigsInvStorm(state, true); }
+static void RecoveredSigsInvStorm_nofilter(benchmark::State& state) { RecoveredSigsInvStorm(state, false); }
+
+BENCHMARK(RecoveredSigsInvStorm_filter, 1000);
+BENCHMARK(RecoveredSigsInvStorm_nofilter, 10);
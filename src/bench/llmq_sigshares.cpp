@@ -0,0 +1,56 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bls/bls_worker.h>
+#include <llmq/quorums_utils.h>
+#include <random.h>
+
+extern CBLSWorker blsWorker;
+
+// The verification of a batch of pending sig shares in CSigSharesManager::ProcessPendingSigShares. 32 signing sessions
+// of a LLMQ_400_60 quorum get 32 shares each, from members picked at random. With fBad one share of the batch is
+// invalid, which costs the bisection of the failing batch to find it.
+static void SigSharesVerifyPending(benchmark::State& state, bool fBad)
+{
+    FastRandomContext rng(true);
+    const auto llmqType = Consensus::LLMQ_400_60;
+    const uint256 quorumHash = rng.rand256();
+    std::vector<CBLSSecretKey> skShares(400);
+    std::vector<CBLSPublicKey> pkShares;
+    for (auto& sk : skShares) {
+        sk.MakeNewKey();
+        pkShares.emplace_back(sk.GetPublicKey());
+    }
+
+    BLSSignatureVector sigs;
+    BLSPublicKeyVector pubKeys;
+    std::vector<uint256> msgHashes;
+    for (size_t i = 0; i < 32; i++) {
+        uint256 signHash = llmq::CLLMQUtils::BuildSignHash(llmqType, quorumHash, rng.rand256(), rng.rand256());
+        for (size_t j = 0; j < 32; j++) {
+            size_t member = rng.randrange(skShares.size());
+            sigs.emplace_back(skShares[member].Sign(signHash));
+            pubKeys.emplace_back(pkShares[member]);
+            msgHashes.emplace_back(signHash);
+        }
+    }
+    const size_t badIdx = rng.randrange(sigs.size());
+    if (fBad) {
+        sigs[badIdx] = skShares[0].Sign(rng.rand256());
+    }
+
+    while (state.KeepRunning()) {
+        auto valid = blsWorker.VerifySignatures(sigs, pubKeys, msgHashes);
+        for (size_t i = 0; i < valid.size(); i++) {
+            assert(valid[i] == (!fBad || i != badIdx));
+        }
+    }
+}
+
+static void SigSharesVerifyPending_1024(benchmark::State& state) { SigSharesVerifyPending(state, false); }
+static void SigSharesVerifyPending_1024_OneBad(benchmark::State& state) { SigSharesVerifyPending(state, true); }
+
+BENCHMARK(SigSharesVerifyPending_1024, 5);
+BENCHMARK(SigSharesVerifyPending_1024_OneBad, 5);
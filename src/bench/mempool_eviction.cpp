@@ -4,6 +4,7 @@
 
 #include <bench/bench.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <txmempool.h>
 
 #include <list>
@@ -113,3 +114,128 @@ static void MempoolEviction(benchmark::State& state)
 }
 
 BENCHMARK(MempoolEviction, 41000);
+
+// Adds a chain of 25 TXs, each spending the previous one, and then removes
+// the chain again starting at its root. This repeatedly walks all ancestors
+// when adding and all descendants when removing.
+static void MempoolChain(benchmark::State& state)
+{
+    std::vector<CTransactionRef> chain;
+    uint256 prevHash;
+    for (int i = 0; i < 25; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(prevHash, 0);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        chain.emplace_back(MakeTransactionRef(tx));
+        prevHash = chain.back()->GetHash();
+    }
+
+    CTxMemPool pool;
+    LOCK(pool.cs);
+
+    while (state.KeepRunning()) {
+        for (const auto& tx : chain) {
+            AddTx(*tx, 1000LL, pool);
+        }
+        pool.removeRecursive(*chain.front());
+    }
+}
+
+// Adds a TX with 500 outputs and a child for each of them, then removes the
+// parent like it is done when it's included in a block. This has to update
+// the ancestor state of all of the children.
+static void MempoolFanOut(benchmark::State& state)
+{
+    CMutableTransaction parent;
+    parent.vin.resize(1);
+    parent.vin[0].scriptSig = CScript() << OP_1;
+    parent.vout.resize(500);
+    for (auto& out : parent.vout) {
+        out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        out.nValue = COIN;
+    }
+    const CTransactionRef parentRef = MakeTransactionRef(parent);
+
+    std::vector<CTransactionRef> children;
+    for (uint32_t i = 0; i < parent.vout.size(); i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(parentRef->GetHash(), i);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = COIN;
+        children.emplace_back(MakeTransactionRef(tx));
+    }
+
+    CTxMemPool pool;
+    LOCK(pool.cs);
+
+    while (state.KeepRunning()) {
+        AddTx(*parentRef, 10000LL, pool);
+        for (const auto& tx : children) {
+            AddTx(*tx, 1000LL, pool);
+        }
+        CTxMemPool::setEntries stage;
+        stage.insert(pool.mapTx.find(parentRef->GetHash()));
+        pool.RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+        pool.clear();
+    }
+}
+
+// Fills the mempool to 300MB with single TXs and chains of up to 5 TXs with
+// random fees, then evicts 30MB of it like a spam wave pushing the mempool
+// over -maxmempool would, and adds the evicted TXs again for the next run.
+static void MempoolMassEviction(benchmark::State& state, bool fBatched)
+{
+    const size_t nMaxUsage = 300 * 1000 * 1000;
+    FastRandomContext rng(true);
+    CTxMemPool pool;
+    LOCK(pool.cs);
+
+    // Ordered so that parents come before their children
+    std::vector<std::pair<CTransactionRef, CAmount>> txs;
+    uint256 prevHash;
+    int nChainLength = 0;
+    while (pool.DynamicMemoryUsage() < nMaxUsage) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        if (nChainLength != 0 && nChainLength < 5 && rng.randbool()) {
+            tx.vin[0].prevout = COutPoint(prevHash, 0);
+            nChainLength++;
+        } else {
+            tx.vin[0].prevout = COutPoint(rng.rand256(), 0);
+            nChainLength = 1;
+        }
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vout.resize(2);
+        for (auto& out : tx.vout) {
+            out.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+            out.nValue = COIN;
+        }
+        txs.emplace_back(MakeTransactionRef(tx), 1000 + rng.randrange(100000));
+        prevHash = txs.back().first->GetHash();
+        AddTx(*txs.back().first, txs.back().second, pool);
+    }
+
+    while (state.KeepRunning()) {
+        pool.TrimToSize(nMaxUsage - 30 * 1000 * 1000, nullptr, fBatched);
+        for (const auto& p : txs) {
+            if (!pool.exists(p.first->GetHash())) {
+                AddTx(*p.first, p.second, pool);
+            }
+        }
+    }
+}
+
+static void MempoolMassEviction_batched(benchmark::State& state) { MempoolMassEviction(state, true); }
+static void MempoolMassEviction_single(benchmark::State& state) { MempoolMassEviction(state, false); }
+
+BENCHMARK(MempoolChain, 1000);
+BENCHMARK(MempoolFanOut, 50);
+BENCHMARK(MempoolMassEviction_batched, 1);
+BENCHMARK(MempoolMassEviction_single, 1);
@@ -0,0 +1,56 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <bls/bls.h>
+#include <evo/providertx.h>
+#include <evo/specialtx.h>
+#include <netbase.h>
+#include <random.h>
+#include <tinyformat.h>
+#include <txmempool.h>
+
+// Simulates a burst of 1000 MN registrations: every ProRegTx is checked for conflicts and added to the mempool, then
+// all of them are mined in one block.
+static void MempoolProRegTxBurst(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < 1000; i++) {
+        CBLSSecretKey sk;
+        sk.MakeNewKey();
+
+        CProRegTx proTx;
+        proTx.collateralOutpoint = COutPoint(uint256(), 0);
+        proTx.addr = LookupNumeric(strprintf("1.1.%d.%d", i / 256, i % 256).c_str(), 9999);
+        proTx.keyIDOwner = CKeyID(uint160(rng.randbytes(20)));
+        proTx.pubKeyOperator = sk.GetPublicKey();
+        proTx.keyIDVoting = proTx.keyIDOwner;
+        proTx.scriptPayout = CScript() << OP_1;
+
+        CMutableTransaction tx;
+        tx.nVersion = 3;
+        tx.nType = TRANSACTION_PROVIDER_REGISTER;
+        tx.vin.emplace_back(COutPoint(rng.rand256(), 0));
+        tx.vout.emplace_back(1000 * COIN, CScript() << OP_1);
+        SetTxPayload(tx, proTx);
+        txs.emplace_back(MakeTransactionRef(tx));
+    }
+
+    CTxMemPool pool;
+    LOCK(pool.cs);
+
+    while (state.KeepRunning()) {
+        for (const auto& tx : txs) {
+            bool conflict = pool.existsProviderTxConflict(*tx);
+            assert(!conflict);
+            pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 1000, 0, 1, false, 1, LockPoints()));
+        }
+        pool.removeForBlock(txs, 1);
+        assert(pool.size() == 0);
+    }
+}
+
+BENCHMARK(MempoolProRegTxBurst, 20);
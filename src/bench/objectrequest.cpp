@@ -0,0 +1,54 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <objectrequest.h>
+#include <random.h>
+
+#include <vector>
+
+static std::chrono::microseconds ExpiryInterval(int type)
+{
+    return std::chrono::minutes{10};
+}
+
+// 100 peers announce the same 1000 transactions, 100k announcements per run. Every transaction is requested from the
+// first peer for which it is due, the other peers requeue it, then all of them are received.
+static void ObjectRequestTracker(benchmark::State& state)
+{
+    const int PEERS = 100;
+    FastRandomContext rng(true);
+    std::vector<CInv> vInvs;
+    for (int i = 0; i < 1000; i++) {
+        vInvs.emplace_back(MSG_TX, rng.rand256());
+    }
+
+    CObjectRequestTracker tracker;
+    std::chrono::microseconds now{std::chrono::seconds{1000000}};
+    while (state.KeepRunning()) {
+        for (NodeId peer = 0; peer < PEERS; peer++) {
+            for (const auto& inv : vInvs) {
+                tracker.ReceivedInv(peer, inv, now + std::chrono::microseconds{rng.randrange(2000000)}, 100000);
+            }
+        }
+        now += std::chrono::seconds{3};
+        for (NodeId peer = 0; peer < PEERS; peer++) {
+            CInv inv;
+            while (tracker.GetNextDue(peer, now, inv)) {
+                if (tracker.GetLastRequestTime(inv.hash).count() == 0) {
+                    tracker.RequestedObject(peer, inv, now);
+                } else {
+                    tracker.Requeue(peer, inv, now + std::chrono::seconds{60});
+                }
+            }
+            tracker.ExpireRequests(peer, now, ExpiryInterval);
+        }
+        for (const auto& inv : vInvs) {
+            tracker.ForgetHash(inv.hash);
+        }
+        assert(tracker.Size() == 0);
+    }
+}
+
+BENCHMARK(ObjectRequestTracker, 5);
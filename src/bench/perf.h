@@ -0,0 +1,33 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_PERF_H
+#define BITCOIN_BENCH_PERF_H
+
+#include <stdint.h>
+
+/** Whether perf_cpucycles() counts CPU cycles on this platform */
+#if defined(__i386__) || defined(__x86_64__) || defined(__amd64__)
+static const bool PERF_CPUCYCLES_SUPPORTED = true;
+#else
+static const bool PERF_CPUCYCLES_SUPPORTED = false;
+#endif
+
+/** Read the time stamp counter of the CPU, 0 where there is none (see PERF_CPUCYCLES_SUPPORTED) */
+static inline uint64_t perf_cpucycles()
+{
+#if defined(__i386__)
+    uint64_t r = 0;
+    __asm__ volatile ("rdtsc" : "=A"(r)); // Constrain the r variable to the eax:edx pair.
+    return r;
+#elif defined(__x86_64__) || defined(__amd64__)
+    uint64_t r1 = 0, r2 = 0;
+    __asm__ volatile ("rdtsc" : "=a"(r1), "=d"(r2)); // Constrain r1 to rax and r2 to rdx.
+    return (r2 << 32) | r1;
+#else
+    return 0;
+#endif
+}
+
+#endif // BITCOIN_BENCH_PERF_H
@@ -0,0 +1,39 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <pow.h>
+#include <random.h>
+
+#include <vector>
+
+// The difficulty checks of a headers only sync of 1M mainnet headers: the target of every header is computed from its
+// predecessors with DarkGravityWave, like ContextualCheckBlockHeader does it.
+static void PowHeadersSync(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    const Consensus::Params& params = Params().GetConsensus();
+
+    static const int HEADERS = 1000000;
+    FastRandomContext rng(true);
+    std::vector<CBlockIndex> vIndex(HEADERS);
+    for (int i = 0; i < HEADERS; i++) {
+        vIndex[i].nHeight = 100000 + i;
+        vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : nullptr;
+        vIndex[i].nTime = 1420000000 + i * params.nPowTargetSpacing + rng.randrange(120);
+        vIndex[i].nBits = 0x1b104be1;
+    }
+
+    while (state.KeepRunning()) {
+        for (int i = 1; i < HEADERS; i++) {
+            CBlockHeader header;
+            header.nTime = vIndex[i].nTime;
+            vIndex[i].nBits = GetNextWorkRequired(&vIndex[i - 1], &header, params);
+        }
+    }
+}
+
+BENCHMARK(PowHeadersSync, 1);
@@ -0,0 +1,87 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <chainparams.h>
+#include <core_io.h>
+#include <primitives/block.h>
+#include <streams.h>
+#include <utilstrencodings.h>
+#include <version.h>
+
+#include <bench/data/block813851.raw.h>
+
+#include <univalue.h>
+
+// The parts of the RPC server which every request and response passes through: the JSON of a getblock verbosity 2
+// response, and a sendrawtransaction/submitblock like request carrying one large hex string
+
+static UniValue BlockToJSON()
+{
+    SelectParams(CBaseChainParams::MAIN);
+    CDataStream stream((const char*)raw_bench::block813851,
+            (const char*)&raw_bench::block813851[sizeof(raw_bench::block813851)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    UniValue txs(UniValue::VARR);
+    for (const auto& tx : block.vtx) {
+        UniValue objTx(UniValue::VOBJ);
+        TxToUniv(*tx, uint256(), objTx, true);
+        txs.push_back(objTx);
+    }
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("hash", block.GetHash().GetHex());
+    result.pushKV("tx", txs);
+    return result;
+}
+
+static std::string HexRequest()
+{
+    std::string hex = HexStr(raw_bench::block813851, raw_bench::block813851 + sizeof(raw_bench::block813851));
+    UniValue params(UniValue::VARR);
+    params.push_back(hex);
+    UniValue request(UniValue::VOBJ);
+    request.pushKV("method", "submitblock");
+    request.pushKV("params", params);
+    request.pushKV("id", 1);
+    return request.write();
+}
+
+static void JSON_WriteBlock(benchmark::State& state)
+{
+    UniValue block = BlockToJSON();
+    while (state.KeepRunning()) {
+        std::string str = block.write();
+        assert(!str.empty());
+    }
+}
+
+static void JSON_ReadBlock(benchmark::State& state)
+{
+    std::string str = BlockToJSON().write();
+    while (state.KeepRunning()) {
+        UniValue block;
+        bool ok = block.read(str);
+        assert(ok);
+    }
+}
+
+static void JSON_ReadHexRequest(benchmark::State& state)
+{
+    std::string str = HexRequest();
+    while (state.KeepRunning()) {
+        UniValue request;
+        bool ok = request.read(str);
+        assert(ok);
+        std::vector<unsigned char> data = ParseHex(request["params"][0].get_str());
+        assert(data.size() == sizeof(raw_bench::block813851));
+    }
+}
+
+BENCHMARK(JSON_WriteBlock, 50);
+BENCHMARK(JSON_ReadBlock, 50);
+BENCHMARK(JSON_ReadHexRequest, 200);
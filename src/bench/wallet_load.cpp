@@ -0,0 +1,50 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <key.h>
+#include <random.h>
+#include <script/standard.h>
+#include <utiltime.h>
+#include <wallet/wallet.h>
+#include <wallet/walletdb.h>
+
+#include <cassert>
+
+// Loads a wallet with 2000 keys and 2000 transactions from an in-memory database
+static void WalletLoad(benchmark::State& state)
+{
+    std::unique_ptr<WalletDatabase> database = WalletDatabase::CreateMock();
+    {
+        WalletBatch batch(*database);
+        for (int i = 0; i < 2000; i++) {
+            CKey key;
+            key.MakeNewKey(true);
+            CPubKey pubkey = key.GetPubKey();
+            assert(batch.WriteKey(pubkey, key.GetPrivKey(), CKeyMetadata(GetTime())));
+
+            CMutableTransaction tx;
+            tx.vin.resize(2);
+            tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+            tx.vin[1].prevout = COutPoint(GetRandHash(), 1);
+            tx.vout.resize(2);
+            tx.vout[0].nValue = COIN;
+            tx.vout[0].scriptPubKey = GetScriptForDestination(pubkey.GetID());
+            tx.vout[1].nValue = COIN;
+            tx.vout[1].scriptPubKey = GetScriptForDestination(pubkey.GetID());
+            CWalletTx wtx(nullptr, MakeTransactionRef(std::move(tx)));
+            wtx.nOrderPos = i;
+            assert(batch.WriteTx(wtx));
+        }
+    }
+
+    while (state.KeepRunning()) {
+        CWallet wallet(WalletLocation(), WalletDatabase::CreateDummy());
+        DBErrors ret = WalletBatch(*database).LoadWallet(&wallet);
+        assert(ret == DBErrors::LOAD_OK);
+        assert(wallet.mapWallet.size() == 2000);
+    }
+}
+
+BENCHMARK(WalletLoad, 20);
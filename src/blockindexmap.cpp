@@ -0,0 +1,96 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockindexmap.h>
+
+#include <memusage.h>
+
+#include <assert.h>
+#include <limits>
+
+CBlockIndexMap::~CBlockIndexMap()
+{
+    clear();
+}
+
+size_t CBlockIndexMap::FindSlot(const uint256& hash) const
+{
+    // block hashes are random, so their first bytes are good enough to spread them over the table
+    const size_t nMask = slots.size() - 1;
+    size_t i = hash.GetCheapHash() & nMask;
+    while (slots[i] != 0 && entries[slots[i] - 1].first != hash) {
+        i = (i + 1) & nMask;
+    }
+    return i;
+}
+
+void CBlockIndexMap::Grow()
+{
+    std::vector<uint32_t> newSlots(slots.empty() ? 1024 : slots.size() * 2, 0);
+    const size_t nMask = newSlots.size() - 1;
+    for (size_t n = 0; n < entries.size(); n++) {
+        size_t i = entries[n].first.GetCheapHash() & nMask;
+        while (newSlots[i] != 0) {
+            i = (i + 1) & nMask;
+        }
+        newSlots[i] = n + 1;
+    }
+    slots.swap(newSlots);
+}
+
+CBlockIndexMap::iterator CBlockIndexMap::find(const uint256& hash)
+{
+    if (slots.empty()) {
+        return end();
+    }
+    uint32_t nPos = slots[FindSlot(hash)];
+    return nPos != 0 ? entries.begin() + (nPos - 1) : end();
+}
+
+CBlockIndexMap::const_iterator CBlockIndexMap::find(const uint256& hash) const
+{
+    if (slots.empty()) {
+        return end();
+    }
+    uint32_t nPos = slots[FindSlot(hash)];
+    return nPos != 0 ? entries.begin() + (nPos - 1) : end();
+}
+
+std::pair<CBlockIndexMap::iterator, bool> CBlockIndexMap::insert(const value_type& value)
+{
+    // keep the load factor below 3/4
+    if ((entries.size() + 1) * 4 > slots.size() * 3) {
+        Grow();
+    }
+    size_t i = FindSlot(value.first);
+    if (slots[i] != 0) {
+        return std::make_pair(entries.begin() + (slots[i] - 1), false);
+    }
+    assert(entries.size() < std::numeric_limits<uint32_t>::max());
+    entries.emplace_back(value);
+    slots[i] = entries.size();
+    return std::make_pair(entries.end() - 1, true);
+}
+
+void CBlockIndexMap::clear()
+{
+    entries.clear();
+    std::vector<uint32_t>().swap(slots);
+
+    for (size_t n = 0; n < vArenaChunks.size(); n++) {
+        size_t nUsed = n + 1 == vArenaChunks.size() ? nLastChunkUsed : ARENA_CHUNK_SIZE;
+        for (size_t i = 0; i < nUsed; i++) {
+            vArenaChunks[n][i].~CBlockIndex();
+        }
+        ::operator delete(vArenaChunks[n]);
+    }
+    vArenaChunks.clear();
+    nLastChunkUsed = 0;
+}
+
+size_t CBlockIndexMap::DynamicMemoryUsage() const
+{
+    return memusage::MallocUsage(entries.size() * sizeof(value_type)) + memusage::DynamicUsage(slots) +
+           vArenaChunks.size() * memusage::MallocUsage(sizeof(CBlockIndex) * ARENA_CHUNK_SIZE) + memusage::DynamicUsage(vArenaChunks);
+}
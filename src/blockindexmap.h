@@ -0,0 +1,91 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKINDEXMAP_H
+#define BITCOIN_BLOCKINDEXMAP_H
+
+#include <chain.h>
+#include <uint256.h>
+
+#include <deque>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Map from block hash to CBlockIndex, with the interface of the std::unordered_map it replaces, and an arena for the
+ * CBlockIndex objects it points to.
+ *
+ * The entries are kept in a deque in insertion order, so that the hash referenced by CBlockIndex::phashBlock stays in
+ * place. The lookup is an open addressing table with linear probing which only holds the 32 bit positions of the
+ * entries. Together this takes about 46 bytes per block instead of the ~80 bytes of a node based map.
+ *
+ * The CBlockIndex objects created with NewIndex() are placed in large chunks instead of one heap object each, and are
+ * all freed by clear(). Entries can't be erased.
+ */
+class CBlockIndexMap
+{
+public:
+    typedef uint256 key_type;
+    typedef CBlockIndex* mapped_type;
+    typedef std::pair<const uint256, CBlockIndex*> value_type;
+    typedef std::deque<value_type>::iterator iterator;
+    typedef std::deque<value_type>::const_iterator const_iterator;
+
+    static const size_t ARENA_CHUNK_SIZE = 4096;
+
+private:
+    std::deque<value_type> entries;
+    // Position in entries + 1, 0 for an empty slot. The size is 0 or a power of two.
+    std::vector<uint32_t> slots;
+
+    std::vector<CBlockIndex*> vArenaChunks;
+    size_t nLastChunkUsed{0};
+
+    size_t FindSlot(const uint256& hash) const;
+    void Grow();
+
+public:
+    CBlockIndexMap() = default;
+    CBlockIndexMap(const CBlockIndexMap&) = delete;
+    CBlockIndexMap& operator=(const CBlockIndexMap&) = delete;
+    ~CBlockIndexMap();
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    iterator find(const uint256& hash);
+    const_iterator find(const uint256& hash) const;
+    size_t count(const uint256& hash) const { return find(hash) != end(); }
+
+    std::pair<iterator, bool> insert(const value_type& value);
+    std::pair<iterator, bool> emplace(const uint256& hash, CBlockIndex* pindex) { return insert(value_type(hash, pindex)); }
+    CBlockIndex*& operator[](const uint256& hash) { return insert(value_type(hash, nullptr)).first->second; }
+
+    /** Create a CBlockIndex in the arena, it lives until clear() */
+    template <typename... Args>
+    CBlockIndex* NewIndex(Args&&... args)
+    {
+        if (vArenaChunks.empty() || nLastChunkUsed == ARENA_CHUNK_SIZE) {
+            vArenaChunks.emplace_back(static_cast<CBlockIndex*>(::operator new(sizeof(CBlockIndex) * ARENA_CHUNK_SIZE)));
+            nLastChunkUsed = 0;
+        }
+        CBlockIndex* pindex = new (vArenaChunks.back() + nLastChunkUsed) CBlockIndex(std::forward<Args>(args)...);
+        nLastChunkUsed++;
+        return pindex;
+    }
+
+    /** Remove all entries and free the CBlockIndex objects of the arena */
+    void clear();
+
+    /** Approximate heap usage of the map and the arena */
+    size_t DynamicMemoryUsage() const;
+};
+
+#endif // BITCOIN_BLOCKINDEXMAP_H
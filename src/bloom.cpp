@@ -4,6 +4,9 @@
 
 #include <bloom.h>
 
+#include <crypto/common.h>
+#include <prevector.h>
+#include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <evo/specialtx.h>
 #include <evo/providertx.h>
@@ -15,13 +18,60 @@
 #include <random.h>
 #include <streams.h>
 
+#include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 #define LN2SQUARED 0.4804530139182014246671025263266649717305529515945455
 #define LN2 0.6931471805599453094172321214581765680755001343602552
 
+void CBloomElements::push_back(const unsigned char* pbegin, const unsigned char* pend)
+{
+    vData.insert(vData.end(), pbegin, pend);
+    vEnds.push_back(vData.size());
+}
+
+void CBloomElements::AddScript(const CScript& script)
+{
+    // The same elements as CBloomFilter::CheckScript checks
+    CScript::const_iterator pc = script.begin();
+    std::vector<unsigned char> data;
+    while (pc < script.end()) {
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode, data))
+            break;
+        if (data.size() != 0)
+            push_back(data.data(), data.data() + data.size());
+    }
+}
+
+CBloomTxElements::CBloomTxElements(const CTransaction& tx)
+{
+    vOutputs.resize(tx.vout.size());
+    for (size_t i = 0; i < tx.vout.size(); i++) {
+        vOutputs[i].AddScript(tx.vout[i].scriptPubKey);
+    }
+    vScriptSigs.resize(tx.vin.size());
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        // Serialized like CBloomFilter::contains(const COutPoint&) does it
+        unsigned char vchOutPoint[36];
+        memcpy(vchOutPoint, tx.vin[i].prevout.hash.begin(), 32);
+        WriteLE32(vchOutPoint + 32, tx.vin[i].prevout.n);
+        prevouts.push_back(vchOutPoint, vchOutPoint + sizeof(vchOutPoint));
+        vScriptSigs[i].AddScript(tx.vin[i].scriptSig);
+    }
+}
+
+CBloomBlockElements::CBloomBlockElements(const CBlock& block)
+{
+    vtx.reserve(block.vtx.size());
+    for (const auto& tx : block.vtx) {
+        vtx.emplace_back(*tx);
+    }
+}
+
 CBloomFilter::CBloomFilter(const unsigned int nElements, const double nFPRate, const unsigned int nTweakIn, unsigned char nFlagsIn) :
     /**
      * The ideal size for a bloom filter with a given number of elements and false positive rate is:
@@ -53,7 +103,7 @@ CBloomFilter::CBloomFilter(const unsigned int nElements, const double nFPRate, c
 {
 }
 
-inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const
+inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, Span<const unsigned char> vDataToHash) const
 {
     // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
     return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) % (vData.size() * 8);
@@ -65,7 +115,7 @@ void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
         return;
     for (unsigned int i = 0; i < nHashFuncs; i++)
     {
-        unsigned int nIndex = Hash(i, vKey);
+        unsigned int nIndex = Hash(i, Span<const unsigned char>(vKey.data(), vKey.size()));
         // Sets bit nIndex of vData
         vData[nIndex >> 3] |= (1 << (7 & nIndex));
     }
@@ -87,6 +137,11 @@ void CBloomFilter::insert(const uint256& hash)
 }
 
 bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return contains(Span<const unsigned char>(vKey.data(), vKey.size()));
+}
+
+bool CBloomFilter::contains(Span<const unsigned char> vKey) const
 {
     if (isFull)
         return true;
@@ -112,14 +167,41 @@ bool CBloomFilter::contains(const COutPoint& outpoint) const
 
 bool CBloomFilter::contains(const uint256& hash) const
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    return contains(Span<const unsigned char>(hash.begin(), hash.size()));
 }
 
 bool CBloomFilter::contains(const uint160& hash) const
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    return contains(Span<const unsigned char>(hash.begin(), hash.size()));
+}
+
+bool CBloomFilter::containsAny(const CBloomElements& elements) const
+{
+    if (elements.size() == 0)
+        return false;
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    if (nHashFuncs == 0)
+        return true;
+
+    prevector<8, uint32_t> vCandidates;
+    for (size_t i = 0; i < elements.size(); i++) {
+        unsigned int nIndex = Hash(0, elements[i]);
+        if (vData[nIndex >> 3] & (1 << (7 & nIndex)))
+            vCandidates.push_back(i);
+    }
+    for (uint32_t i : vCandidates) {
+        bool fMatch = true;
+        for (unsigned int n = 1; n < nHashFuncs && fMatch; n++) {
+            unsigned int nIndex = Hash(n, elements[i]);
+            fMatch = vData[nIndex >> 3] & (1 << (7 & nIndex));
+        }
+        if (fMatch)
+            return true;
+    }
+    return false;
 }
 
 void CBloomFilter::clear()
@@ -255,16 +337,7 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
         if(CheckScript(txout.scriptPubKey)) {
             fFound = true;
-            if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
-                insert(COutPoint(hash, i));
-            else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
-            {
-                txnouttype type;
-                std::vector<std::vector<unsigned char> > vSolutions;
-                if (Solver(txout.scriptPubKey, type, vSolutions) &&
-                        (type == TX_PUBKEY || type == TX_MULTISIG))
-                    insert(COutPoint(hash, i));
-            }
+            InsertMatchedOutput(hash, i, txout.scriptPubKey);
         }
     }
 
@@ -285,6 +358,58 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     return false;
 }
 
+bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx, const CBloomTxElements& elements)
+{
+    // Must match exactly what IsRelevantAndUpdate(tx) does, including the order in which the filter is updated
+    assert(elements.vOutputs.size() == tx.vout.size() && elements.prevouts.size() == tx.vin.size());
+
+    bool fFound = false;
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    const uint256& hash = tx.GetHash();
+    if (contains(hash))
+        fFound = true;
+
+    fFound = fFound || CheckSpecialTransactionMatchesAndUpdate(tx);
+
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        if (containsAny(elements.vOutputs[i])) {
+            fFound = true;
+            InsertMatchedOutput(hash, i, tx.vout[i].scriptPubKey);
+        }
+    }
+
+    if (fFound)
+        return true;
+
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        if (contains(elements.prevouts[i]))
+            return true;
+        if (containsAny(elements.vScriptSigs[i]))
+            return true;
+    }
+
+    return false;
+}
+
+void CBloomFilter::InsertMatchedOutput(const uint256& hash, unsigned int nOut, const CScript& scriptPubKey)
+{
+    if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
+        insert(COutPoint(hash, nOut));
+    else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
+    {
+        txnouttype type;
+        std::vector<std::vector<unsigned char> > vSolutions;
+        if (Solver(scriptPubKey, type, vSolutions) &&
+                (type == TX_PUBKEY || type == TX_MULTISIG))
+            insert(COutPoint(hash, nOut));
+    }
+}
+
 void CBloomFilter::UpdateEmptyFull()
 {
     bool full = true;
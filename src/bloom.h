@@ -6,9 +6,11 @@
 #define BITCOIN_BLOOM_H
 
 #include <serialize.h>
+#include <span.h>
 
 #include <vector>
 
+class CBlock;
 class COutPoint;
 class CScript;
 class CTransaction;
@@ -32,6 +34,57 @@ enum bloomflags
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * A list of data elements to match against a bloom filter, stored in a single buffer
+ */
+class CBloomElements
+{
+private:
+    std::vector<unsigned char> vData;
+    // End of each element in vData
+    std::vector<uint32_t> vEnds;
+
+public:
+    void push_back(const unsigned char* pbegin, const unsigned char* pend);
+    //! Add the non-empty data elements pushed by the script
+    void AddScript(const CScript& script);
+
+    size_t size() const { return vEnds.size(); }
+    Span<const unsigned char> operator[](size_t i) const
+    {
+        uint32_t nBegin = i == 0 ? 0 : vEnds[i - 1];
+        return Span<const unsigned char>(vData.data() + nBegin, vEnds[i] - nBegin);
+    }
+};
+
+/**
+ * The data elements of a transaction which IsRelevantAndUpdate checks, extracted once so that they don't have to be
+ * parsed and serialized again for every filter
+ */
+struct CBloomTxElements
+{
+    //! The data elements of the scriptPubKey of each output
+    std::vector<CBloomElements> vOutputs;
+    //! The serialized outpoint spent by each input
+    CBloomElements prevouts;
+    //! The data elements of the scriptSig of each input
+    std::vector<CBloomElements> vScriptSigs;
+
+    explicit CBloomTxElements(const CTransaction& tx);
+};
+
+/**
+ * The CBloomTxElements of all transactions of a block. They don't depend on the filter, so a block which is requested
+ * filtered by multiple peers only has to be prepared once.
+ */
+class CBloomBlockElements
+{
+public:
+    std::vector<CBloomTxElements> vtx;
+
+    explicit CBloomBlockElements(const CBlock& block);
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we send them.
@@ -53,7 +106,7 @@ private:
     unsigned int nTweak;
     unsigned char nFlags;
 
-    unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
+    unsigned int Hash(unsigned int nHashNum, Span<const unsigned char> vDataToHash) const;
 
     // Private constructor for CRollingBloomFilter, no restrictions on size
     CBloomFilter(const unsigned int nElements, const double nFPRate, const unsigned int nTweak);
@@ -61,6 +114,8 @@ private:
 
     // Check matches for arbitrary script data elements
     bool CheckScript(const CScript& script) const;
+    // Add the outpoint of a matched output, depending on nFlags
+    void InsertMatchedOutput(const uint256& hash, unsigned int nOut, const CScript& scriptPubKey);
     // Check additional matches for special transactions
     bool CheckSpecialTransactionMatchesAndUpdate(const CTransaction& tx);
 public:
@@ -94,6 +149,11 @@ public:
     bool contains(const COutPoint& outpoint) const;
     bool contains(const uint256& hash) const;
     bool contains(const uint160& hash) const;
+    bool contains(Span<const unsigned char> vKey) const;
+
+    //! True if the filter contains any of the elements. The first hash function is evaluated for all elements
+    //! before the others, which skips most of the remaining work in a tight loop without data dependencies.
+    bool containsAny(const CBloomElements& elements) const;
 
     void clear();
     void reset(const unsigned int nNewTweak);
@@ -104,6 +164,8 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    //! Same as above with the data elements of tx taken from elements
+    bool IsRelevantAndUpdate(const CTransaction& tx, const CBloomTxElements& elements);
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
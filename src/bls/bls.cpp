@@ -155,6 +155,13 @@ CBLSPublicKey CBLSPublicKey::AggregateInsecure(const std::vector<CBLSPublicKey>&
     return ret;
 }
 
+void CBLSPublicKey::MulInsecure(const CBLSSecretKey& scalar)
+{
+    assert(IsValid() && scalar.IsValid());
+    impl = scalar.impl * impl;
+    cachedHash.SetNull();
+}
+
 bool CBLSPublicKey::PublicKeyShare(const std::vector<CBLSPublicKey>& mpk, const CBLSId& _id)
 {
     fValid = false;
@@ -259,6 +266,13 @@ void CBLSSignature::SubInsecure(const CBLSSignature& o)
     cachedHash.SetNull();
 }
 
+void CBLSSignature::MulInsecure(const CBLSSecretKey& scalar)
+{
+    assert(IsValid() && scalar.IsValid());
+    impl = scalar.impl * impl;
+    cachedHash.SetNull();
+}
+
 bool CBLSSignature::VerifyInsecure(const CBLSPublicKey& pubKey, const uint256& hash) const
 {
     if (!IsValid() || !pubKey.IsValid()) {
@@ -20,6 +20,7 @@
 #include <bls-dash/threshold.hpp>
 #undef DOUBLE
 
+#include <algorithm>
 #include <array>
 #include <mutex>
 #include <unistd.h>
@@ -260,6 +261,9 @@ public:
     void AggregateInsecure(const CBLSPublicKey& o);
     static CBLSPublicKey AggregateInsecure(const std::vector<CBLSPublicKey>& pks, bool fLegacy = fLegacyDefault);
 
+    // Multiplies the key with a scalar, which is passed as a secret key
+    void MulInsecure(const CBLSSecretKey& scalar);
+
     bool PublicKeyShare(const std::vector<CBLSPublicKey>& mpk, const CBLSId& id);
     bool DHKeyExchange(const CBLSSecretKey& sk, const CBLSPublicKey& pk);
 
@@ -283,6 +287,8 @@ public:
     static CBLSSignature AggregateSecure(const std::vector<CBLSSignature>& sigs, const std::vector<CBLSPublicKey>& pks, const uint256& hash, bool fLegacy = fLegacyDefault);
 
     void SubInsecure(const CBLSSignature& o);
+    // Multiplies the signature with a scalar, which is passed as a secret key
+    void MulInsecure(const CBLSSecretKey& scalar);
 
     bool VerifyInsecure(const CBLSPublicKey& pubKey, const uint256& hash) const;
     bool VerifyInsecureAggregated(const std::vector<CBLSPublicKey>& pubKeys, const std::vector<uint256>& hashes) const;
@@ -299,7 +305,9 @@ class CBLSLazyWrapper
 private:
     mutable std::mutex mutex;
 
-    mutable std::vector<uint8_t> vecBytes;
+    // Fixed size, so that copying a wrapper (e.g. when a CDeterministicMNState is copied for an update) doesn't
+    // need a heap allocation
+    mutable std::array<uint8_t, BLSObject::SerSize> buf{};
     mutable bool bufValid{false};
 
     mutable BLSObject obj;
@@ -308,8 +316,7 @@ private:
     mutable uint256 hash;
 
 public:
-    CBLSLazyWrapper() :
-        vecBytes(BLSObject::SerSize, 0)
+    CBLSLazyWrapper()
     {
         // the all-zero buf is considered a valid buf, but the resulting object will return false for IsValid
         bufValid = true;
@@ -325,9 +332,9 @@ public:
         std::unique_lock<std::mutex> l(r.mutex);
         bufValid = r.bufValid;
         if (r.bufValid) {
-            vecBytes = r.vecBytes;
+            buf = r.buf;
         } else {
-            std::fill(vecBytes.begin(), vecBytes.end(), 0);
+            buf.fill(0);
         }
         objInitialized = r.objInitialized;
         if (r.objInitialized) {
@@ -352,18 +359,16 @@ public:
             throw std::ios_base::failure("obj and buf not initialized");
         }
         if (!bufValid) {
-            vecBytes = obj.ToByteVector();
-            bufValid = true;
-            hash.SetNull();
+            UpdateBuf();
         }
-        s.write((const char*)vecBytes.data(), vecBytes.size());
+        s.write((const char*)buf.data(), buf.size());
     }
 
     template<typename Stream>
     inline void Unserialize(Stream& s)
     {
         std::unique_lock<std::mutex> l(mutex);
-        s.read((char*)vecBytes.data(), BLSObject::SerSize);
+        s.read((char*)buf.data(), BLSObject::SerSize);
         bufValid = true;
         objInitialized = false;
         hash.SetNull();
@@ -385,6 +390,7 @@ public:
             return invalidObj;
         }
         if (!objInitialized) {
+            std::vector<uint8_t> vecBytes(buf.begin(), buf.end());
             obj.SetByteVector(vecBytes);
             if (!obj.CheckMalleable(vecBytes)) {
                 bufValid = false;
@@ -400,7 +406,7 @@ public:
     bool operator==(const CBLSLazyWrapper& r) const
     {
         if (bufValid && r.bufValid) {
-            return vecBytes == r.vecBytes;
+            return buf == r.buf;
         }
         if (objInitialized && r.objInitialized) {
             return obj == r.obj;
@@ -417,17 +423,28 @@ public:
     {
         std::unique_lock<std::mutex> l(mutex);
         if (!bufValid) {
-            vecBytes = obj.ToByteVector();
-            bufValid = true;
-            hash.SetNull();
+            UpdateBuf();
         }
         if (hash.IsNull()) {
             CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-            ss.write((const char*)vecBytes.data(), vecBytes.size());
+            ss.write((const char*)buf.data(), buf.size());
             hash = ss.GetHash();
         }
         return hash;
     }
+
+private:
+    // requires mutex to be held
+    void UpdateBuf() const
+    {
+        auto vecBytes = obj.ToByteVector();
+        if (vecBytes.size() != buf.size()) {
+            throw std::ios_base::failure("unexpected size of serialized BLS object");
+        }
+        std::copy(vecBytes.begin(), vecBytes.end(), buf.begin());
+        bufValid = true;
+        hash.SetNull();
+    }
 };
 typedef CBLSLazyWrapper<CBLSSignature> CBLSLazySignature;
 typedef CBLSLazyWrapper<CBLSPublicKey> CBLSLazyPublicKey;
@@ -6,6 +6,7 @@
 #define DASH_CRYPTO_BLS_BATCHVERIFIER_H
 
 #include <bls/bls.h>
+#include <bls/bls_sigcache.h>
 
 #include <map>
 #include <vector>
@@ -48,6 +49,11 @@ public:
     {
         assert(sig.IsValid() && pubKey.IsValid());
 
+        if (BLSSignatureCacheContains(pubKey, msgHash, sig)) {
+            // verified before, e.g. by another subsystem
+            return;
+        }
+
         auto it = messages.emplace(msgId, Message{msgId, msgHash, sig, pubKey}).first;
         messagesBySource[sourceId].emplace_back(it);
 
@@ -70,14 +76,24 @@ public:
 
     void Verify()
     {
+        if (messages.empty()) {
+            // nothing pushed or all of it was in the BLS signature cache
+            return;
+        }
+
         std::map<uint256, std::vector<MessageMapIterator>> byMessageHash;
 
         for (auto it = messages.begin(); it != messages.end(); ++it) {
             byMessageHash[it->second.msgHash].emplace_back(it);
         }
 
+        // The messages of valid batches are added to the BLS signature cache. The callers treat them as verified
+        // already, so the cache doesn't make anything valid for them which wasn't before
         if (VerifyBatch(byMessageHash)) {
             // full batch is valid
+            for (const auto& p : messages) {
+                BLSSignatureCacheAdd(p.second.pubKey, p.second.msgHash, p.second.sig);
+            }
             return;
         }
 
@@ -93,7 +109,11 @@ public:
                 }
                 batchValid = VerifyBatch(byMessageHash);
             }
-            if (!batchValid) {
+            if (batchValid) {
+                for (const auto& msgIt : p.second) {
+                    BLSSignatureCacheAdd(msgIt->second.pubKey, msgIt->second.msgHash, msgIt->second.sig);
+                }
+            } else {
                 badSources.emplace(p.first);
 
                 if (perMessageFallback) {
@@ -109,7 +129,7 @@ public:
                             }
 
                             const auto& msg = msgIt->second;
-                            if (!msg.sig.VerifyInsecure(msg.pubKey, msg.msgHash)) {
+                            if (!BLSCachedVerifyInsecure(msg.sig, msg.pubKey, msg.msgHash)) {
                                 badMessages.emplace(msg.msgId);
                             }
                         }
@@ -0,0 +1,140 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bls/bls_sigcache.h>
+
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
+#include <hash.h>
+#include <random.h>
+#include <script/sigcache.h>
+#include <util.h>
+
+#include <atomic>
+
+#include <boost/thread.hpp>
+
+namespace {
+class CBLSSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || message hash || hash of the public key || hash of the signature)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+    std::atomic<uint64_t> nInserts{0};
+
+    CBLSSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        // Usable before InitBLSSignatureCache, e.g. by tools and tests which don't call it
+        setValid.setup_bytes(0);
+    }
+
+    uint256 ComputeEntry(const uint256& pubKeyHash, const uint256& hash, const CBLSSignature& sig) const
+    {
+        uint256 entry;
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(pubKeyHash.begin(), 32).Write(sig.GetHash().begin(), 32).Finalize(entry.begin());
+        return entry;
+    }
+
+    bool Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        bool fFound = setValid.contains(entry, false);
+        (fFound ? nHits : nMisses)++;
+        return fFound;
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid.insert(entry);
+        nInserts++;
+    }
+
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CBLSSignatureCache blsSignatureCache;
+
+// The public keys of a secure aggregation are part of the entry as one hash of all of them
+uint256 HashPubKeys(const std::vector<CBLSPublicKey>& pubKeys)
+{
+    CHashWriter hw(SER_GETHASH, 0);
+    for (const auto& pubKey : pubKeys) {
+        hw << pubKey.GetHash();
+    }
+    return hw.GetHash();
+}
+} // namespace
+
+void InitBLSSignatureCache()
+{
+    // If -maxblssigcachesize is set to zero, setup_bytes creates the minimum possible cache (2 elements).
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxblssigcachesize", DEFAULT_MAX_BLS_SIG_CACHE_SIZE)), MAX_MAX_BLS_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = blsSignatureCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for BLS signature cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+bool BLSSignatureCacheContains(const CBLSPublicKey& pubKey, const uint256& hash, const CBLSSignature& sig)
+{
+    return blsSignatureCache.Get(blsSignatureCache.ComputeEntry(pubKey.GetHash(), hash, sig));
+}
+
+void BLSSignatureCacheAdd(const CBLSPublicKey& pubKey, const uint256& hash, const CBLSSignature& sig)
+{
+    uint256 entry = blsSignatureCache.ComputeEntry(pubKey.GetHash(), hash, sig);
+    blsSignatureCache.Set(entry);
+}
+
+bool BLSCachedVerifyInsecure(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& hash)
+{
+    if (!sig.IsValid() || !pubKey.IsValid()) {
+        return false;
+    }
+    uint256 entry = blsSignatureCache.ComputeEntry(pubKey.GetHash(), hash, sig);
+    if (blsSignatureCache.Get(entry)) {
+        return true;
+    }
+    if (!sig.VerifyInsecure(pubKey, hash)) {
+        return false;
+    }
+    blsSignatureCache.Set(entry);
+    return true;
+}
+
+bool BLSCachedVerifySecureAggregated(const CBLSSignature& sig, const std::vector<CBLSPublicKey>& pubKeys, const uint256& hash)
+{
+    if (!sig.IsValid() || pubKeys.empty()) {
+        return false;
+    }
+    uint256 entry = blsSignatureCache.ComputeEntry(HashPubKeys(pubKeys), hash, sig);
+    if (blsSignatureCache.Get(entry)) {
+        return true;
+    }
+    if (!sig.VerifySecureAggregated(pubKeys, hash)) {
+        return false;
+    }
+    blsSignatureCache.Set(entry);
+    return true;
+}
+
+CBLSSignatureCacheStats GetBLSSignatureCacheStats()
+{
+    CBLSSignatureCacheStats stats;
+    stats.nHits = blsSignatureCache.nHits;
+    stats.nMisses = blsSignatureCache.nMisses;
+    stats.nInserts = blsSignatureCache.nInserts;
+    return stats;
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DASH_CRYPTO_BLS_SIGCACHE_H
+#define DASH_CRYPTO_BLS_SIGCACHE_H
+
+#include <bls/bls.h>
+
+#include <vector>
+
+// Limit the cache of valid BLS signatures to 8MB, which holds more than 250000 entries
+static const unsigned int DEFAULT_MAX_BLS_SIG_CACHE_SIZE = 8;
+// Maximum BLS sig cache size allowed
+static const int64_t MAX_MAX_BLS_SIG_CACHE_SIZE = 1024;
+
+/**
+ * Cache of the (public key, message hash, signature) triples known to be valid. The same recovered and quorum
+ * signatures are verified by several subsystems (e.g. when a recovered sig arrives as part of a ISLOCK or CLSIG after
+ * it was recovered locally, or a final commitment is mined after it was received via P2P), which only have to do the
+ * pairings once with it. The entries are salted with a random nonce, so they can't be predicted by peers.
+ */
+void InitBLSSignatureCache();
+
+/** Whether sig was verified to be valid for pubKey and hash before, counts a hit or miss */
+bool BLSSignatureCacheContains(const CBLSPublicKey& pubKey, const uint256& hash, const CBLSSignature& sig);
+/** Remember that sig is valid for pubKey and hash */
+void BLSSignatureCacheAdd(const CBLSPublicKey& pubKey, const uint256& hash, const CBLSSignature& sig);
+
+/** Same as CBLSSignature::VerifyInsecure(), but valid signatures are only verified once */
+bool BLSCachedVerifyInsecure(const CBLSSignature& sig, const CBLSPublicKey& pubKey, const uint256& hash);
+/** Same as CBLSSignature::VerifySecureAggregated(), but valid signatures are only verified once */
+bool BLSCachedVerifySecureAggregated(const CBLSSignature& sig, const std::vector<CBLSPublicKey>& pubKeys, const uint256& hash);
+
+struct CBLSSignatureCacheStats
+{
+    uint64_t nHits{0};
+    uint64_t nMisses{0};
+    uint64_t nInserts{0};
+};
+
+CBLSSignatureCacheStats GetBLSSignatureCacheStats();
+
+#endif // DASH_CRYPTO_BLS_SIGCACHE_H
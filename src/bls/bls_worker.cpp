@@ -4,7 +4,9 @@
 
 #include <bls/bls_worker.h>
 #include <hash.h>
+#include <random.h>
 #include <serialize.h>
+#include <version.h>
 
 #include <util.h>
 
@@ -58,18 +60,16 @@ CBLSWorker::~CBLSWorker()
     Stop();
 }
 
-void CBLSWorker::Start()
+void CBLSWorker::Start(int workerCount)
 {
-    int workerCount = std::thread::hardware_concurrency() / 2;
-    workerCount = std::max(std::min(1, workerCount), 4);
-    workerPool.resize(workerCount);
-    RenameThreadPool(workerPool, "dash-bls-work");
+    // The work runs on the shared executor, workerCount only limits how many tasks it's split into. 0 means as many
+    // as the executor has threads
+    workerPool.Start(std::max(0, std::min(workerCount, MAX_BLS_WORKER_THREADS)));
 }
 
 void CBLSWorker::Stop()
 {
-    workerPool.clear_queue();
-    workerPool.stop(true);
+    workerPool.Stop();
 }
 
 bool CBLSWorker::GenerateContributions(int quorumThreshold, const BLSIdVector& ids, BLSVerificationVectorPtr& vvecRet, BLSSecretKeyVector& skSharesRet)
@@ -134,7 +134,7 @@ struct Aggregator {
     std::shared_ptr<std::vector<const T*> > inputVec;
 
     bool parallel;
-    ctpl::thread_pool& workerPool;
+    CExecutorClient& workerPool;
 
     std::mutex m;
     // items in the queue are all intermediate aggregation results of finished batches.
@@ -153,7 +153,7 @@ struct Aggregator {
     Aggregator(const std::vector<TP>& _inputVec,
                size_t start, size_t count,
                bool _parallel,
-               ctpl::thread_pool& _workerPool,
+               CExecutorClient& _workerPool,
                DoneCallback _doneCallback) :
             workerPool(_workerPool),
             parallel(_parallel),
@@ -342,7 +342,7 @@ struct VectorAggregator {
     size_t start;
     size_t count;
     bool parallel;
-    ctpl::thread_pool& workerPool;
+    CExecutorClient& workerPool;
 
     std::atomic<size_t> doneCount;
 
@@ -351,7 +351,7 @@ struct VectorAggregator {
 
     VectorAggregator(const VectorVectorType& _vecs,
                      size_t _start, size_t _count,
-                     bool _parallel, ctpl::thread_pool& _workerPool,
+                     bool _parallel, CExecutorClient& _workerPool,
                      DoneCallback _doneCallback) :
             vecs(_vecs),
             parallel(_parallel),
@@ -422,7 +422,7 @@ struct ContributionVerifier {
     bool parallel;
     bool aggregated;
 
-    ctpl::thread_pool& workerPool;
+    CExecutorClient& workerPool;
 
     size_t batchCount;
     size_t verifyCount;
@@ -433,7 +433,7 @@ struct ContributionVerifier {
 
     ContributionVerifier(const CBLSId& _forId, const std::vector<BLSVerificationVectorPtr>& _vvecs,
                          const BLSSecretKeyVector& _skShares, size_t _batchSize,
-                         bool _parallel, bool _aggregated, ctpl::thread_pool& _workerPool,
+                         bool _parallel, bool _aggregated, CExecutorClient& _workerPool,
                          std::function<void(const std::vector<bool>&)> _doneCallback) :
         forId(_forId),
         vvecs(_vvecs),
@@ -632,7 +632,7 @@ BLSVerificationVectorPtr CBLSWorker::BuildQuorumVerificationVector(const std::ve
 }
 
 template <typename T>
-void AsyncAggregateHelper(ctpl::thread_pool& workerPool,
+void AsyncAggregateHelper(CExecutorClient& workerPool,
                           const std::vector<T>& vec, size_t start, size_t count, bool parallel,
                           std::function<void(const T&)> doneCallback)
 {
@@ -773,6 +773,46 @@ std::future<bool> CBLSWorker::AsyncVerifyContributionShare(const CBLSId& forId,
     return workerPool.push(f);
 }
 
+BLSSecretKeyVector CBLSWorker::DecryptContributionShares(const std::vector<std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey>>>& encryptedContributions,
+                                                          size_t idx, const CBLSSecretKey& sk)
+{
+    BLSSecretKeyVector ret(encryptedContributions.size());
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(encryptedContributions.size());
+    for (size_t i = 0; i < encryptedContributions.size(); i++) {
+        futures.emplace_back(workerPool.push([&, i](int threadId) {
+            if (!encryptedContributions[i]->Decrypt(idx, sk, ret[i], PROTOCOL_VERSION)) {
+                ret[i] = CBLSSecretKey();
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    return ret;
+}
+
+BLSSecretKeyVector CBLSWorker::DecryptContributionShares(const std::vector<CBLSIESEncryptedObject<CBLSSecretKey>>& encryptedShares,
+                                                          size_t idx, const CBLSSecretKey& sk)
+{
+    BLSSecretKeyVector ret(encryptedShares.size());
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(encryptedShares.size());
+    for (size_t i = 0; i < encryptedShares.size(); i++) {
+        futures.emplace_back(workerPool.push([&, i](int threadId) {
+            if (!encryptedShares[i].Decrypt(idx, sk, ret[i], PROTOCOL_VERSION)) {
+                ret[i] = CBLSSecretKey();
+            }
+        }));
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    return ret;
+}
+
 bool CBLSWorker::VerifyContributionShare(const CBLSId& forId, const BLSVerificationVectorPtr& vvec,
                                          const CBLSSecretKey& skContribution)
 {
@@ -830,6 +870,138 @@ bool CBLSWorker::VerifySignatureVector(const BLSSignatureVector& sigs, size_t st
     return VerifyVectorHelper(sigs, start, count);
 }
 
+// See comment of VerifySignatures for a description on what this does
+struct RandomizedSigVerifier {
+    // signatures and public keys multiplied with the same random scalar per entry
+    BLSSignatureVector sigs;
+    BLSPublicKeyVector pubKeys;
+    const std::vector<uint256>& msgHashes;
+
+    // we can't directly update a vector<bool> in parallel, see ContributionVerifier
+    std::vector<char> verifyResults;
+
+    RandomizedSigVerifier(const BLSSignatureVector& _sigs, const BLSPublicKeyVector& _pubKeys, const std::vector<uint256>& _msgHashes) :
+        sigs(_sigs),
+        pubKeys(_pubKeys),
+        msgHashes(_msgHashes),
+        verifyResults(_sigs.size(), 0)
+    {
+    }
+
+    void Randomize(size_t start, size_t count, const uint256& seed)
+    {
+        FastRandomContext rng(seed);
+        std::vector<uint8_t> buf(CBLSSecretKey::SerSize, 0);
+        for (size_t i = start; i < start + count; i++) {
+            if (!sigs[i].IsValid() || !pubKeys[i].IsValid()) {
+                continue;
+            }
+            // 128 bit scalars are enough to make the chance of invalid signatures cancelling each other out
+            // negligible, while keeping the multiplications cheaper than full size scalars would be
+            CBLSSecretKey scalar;
+            while (!scalar.IsValid()) {
+                std::vector<uint8_t> r = rng.randbytes(16);
+                std::copy(r.begin(), r.end(), buf.begin() + 16);
+                scalar.SetByteVector(buf);
+            }
+            sigs[i].MulInsecure(scalar);
+            pubKeys[i].MulInsecure(scalar);
+        }
+    }
+
+    bool VerifyRange(size_t start, size_t count) const
+    {
+        CBLSSignature aggSig;
+        std::map<uint256, CBLSPublicKey> aggPubKeys;
+        for (size_t i = start; i < start + count; i++) {
+            if (!sigs[i].IsValid() || !pubKeys[i].IsValid()) {
+                return false;
+            }
+            if (!aggSig.IsValid()) {
+                aggSig = sigs[i];
+            } else {
+                aggSig.AggregateInsecure(sigs[i]);
+            }
+            // aggregated verification requires distinct message hashes, so keys for the same hash are aggregated
+            auto it = aggPubKeys.emplace(msgHashes[i], pubKeys[i]);
+            if (!it.second) {
+                it.first->second.AggregateInsecure(pubKeys[i]);
+            }
+        }
+
+        std::vector<CBLSPublicKey> vecPubKeys;
+        std::vector<uint256> vecMsgHashes;
+        vecPubKeys.reserve(aggPubKeys.size());
+        vecMsgHashes.reserve(aggPubKeys.size());
+        for (const auto& p : aggPubKeys) {
+            vecMsgHashes.emplace_back(p.first);
+            vecPubKeys.emplace_back(p.second);
+        }
+        return aggSig.VerifyInsecureAggregated(vecPubKeys, vecMsgHashes);
+    }
+
+    // Marks all entries of the range as valid if the range verifies, otherwise bisects it until the invalid entries are
+    // found. knownInvalid is passed when the range is already known to fail, which is the case for the second half of
+    // a failing range if the first half turned out to be valid
+    void VerifyAndBisect(size_t start, size_t count, bool knownInvalid)
+    {
+        if (!knownInvalid && VerifyRange(start, count)) {
+            std::fill(verifyResults.begin() + start, verifyResults.begin() + start + count, 1);
+            return;
+        }
+        if (count == 1) {
+            return;
+        }
+
+        size_t leftCount = count / 2;
+        if (VerifyRange(start, leftCount)) {
+            std::fill(verifyResults.begin() + start, verifyResults.begin() + start + leftCount, 1);
+            VerifyAndBisect(start + leftCount, count - leftCount, true);
+        } else {
+            VerifyAndBisect(start, leftCount, true);
+            VerifyAndBisect(start + leftCount, count - leftCount, false);
+        }
+    }
+};
+
+std::vector<bool> CBLSWorker::VerifySignatures(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes, bool parallel)
+{
+    assert(sigs.size() == pubKeys.size() && sigs.size() == msgHashes.size());
+    if (sigs.empty()) {
+        return std::vector<bool>();
+    }
+
+    RandomizedSigVerifier verifier(sigs, pubKeys, msgHashes);
+
+    size_t batchCount = parallel ? std::min((size_t)workerPool.size(), (sigs.size() + MIN_SIG_VERIFY_RANDOMIZED_BATCH_SIZE - 1) / MIN_SIG_VERIFY_RANDOMIZED_BATCH_SIZE) : 1;
+    batchCount = std::max(batchCount, (size_t)1);
+    size_t batchSize = (sigs.size() + batchCount - 1) / batchCount;
+
+    auto f = [&](size_t start, const uint256& seed) {
+        size_t count = std::min(batchSize, sigs.size() - start);
+        verifier.Randomize(start, count, seed);
+        verifier.VerifyAndBisect(start, count, false);
+    };
+
+    std::vector<std::future<void>> futures;
+    for (size_t start = batchSize; start < sigs.size(); start += batchSize) {
+        futures.emplace_back(workerPool.push([&f, start](int threadId, const uint256& seed) {
+            f(start, seed);
+        }, GetRandHash()));
+    }
+    // the first batch is done by the calling thread
+    f(0, GetRandHash());
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    std::vector<bool> result(sigs.size());
+    for (size_t i = 0; i < sigs.size(); i++) {
+        result[i] = verifier.verifyResults[i] != 0;
+    }
+    return result;
+}
+
 void CBLSWorker::AsyncSign(const CBLSSecretKey& secKey, const uint256& msgHash, CBLSWorker::SignDoneCallback doneCallback)
 {
     workerPool.push([secKey, msgHash, doneCallback](int threadId) {
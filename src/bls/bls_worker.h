@@ -6,8 +6,10 @@
 #define DASH_CRYPTO_BLS_WORKER_H
 
 #include <bls/bls.h>
+#include <bls/bls_ies.h>
 
-#include <ctpl.h>
+#include <executor.h>
+#include <memusage.h>
 
 #include <future>
 #include <mutex>
@@ -18,6 +20,10 @@
 // The worker tries to parallelize as much as possible and utilizes a few properties of BLS aggregation to speed up things
 // For example, public key vectors can be aggregated in parallel if they are split into batches and the batched aggregations are
 // aggregated to a final public key. This utilizes that when aggregating keys (a+b+c+d) gives the same result as (a+b)+(c+d)
+
+//! -blsworkerthreads default, 0 means to pick a number based on the available cores
+static const int DEFAULT_BLS_WORKER_THREADS = 0;
+static const int MAX_BLS_WORKER_THREADS = 16;
 class CBLSWorker
 {
 public:
@@ -26,9 +32,11 @@ public:
     typedef std::function<bool()> CancelCond;
 
 private:
-    ctpl::thread_pool workerPool;
+    CExecutorClient workerPool{ExecutorPriority::LLMQ};
 
     static const int SIG_VERIFY_BATCH_SIZE = 8;
+    // don't split VerifySignatures inputs into batches smaller than this, as each batch costs an additional pairing
+    static const size_t MIN_SIG_VERIFY_RANDOMIZED_BATCH_SIZE = 16;
     struct SigVerifyJob {
         SigVerifyDoneCallback doneCallback;
         CancelCond cancelCond;
@@ -53,7 +61,7 @@ public:
     CBLSWorker();
     ~CBLSWorker();
 
-    void Start();
+    void Start(int workerCount = DEFAULT_BLS_WORKER_THREADS);
     void Stop();
 
     bool GenerateContributions(int threshold, const BLSIdVector& ids, BLSVerificationVectorPtr& vvecRet, BLSSecretKeyVector& skSharesRet);
@@ -123,6 +131,14 @@ public:
 
     std::future<bool> AsyncVerifyContributionShare(const CBLSId& forId, const BLSVerificationVectorPtr& vvec, const CBLSSecretKey& skContribution);
 
+    // Decrypts the share at index idx of each of the encrypted contributions in parallel. Shares which can't be
+    // decrypted are returned as invalid keys
+    BLSSecretKeyVector DecryptContributionShares(const std::vector<std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey>>>& encryptedContributions,
+                                                 size_t idx, const CBLSSecretKey& sk);
+    // The same for the shares of one member, as they are sent in QDATA
+    BLSSecretKeyVector DecryptContributionShares(const std::vector<CBLSIESEncryptedObject<CBLSSecretKey>>& encryptedShares,
+                                                 size_t idx, const CBLSSecretKey& sk);
+
     // Non paralellized verification of a single contribution
     bool VerifyContributionShare(const CBLSId& forId, const BLSVerificationVectorPtr& vvec, const CBLSSecretKey& skContribution);
 
@@ -132,6 +148,16 @@ public:
     bool VerifySecretKeyVector(const BLSSecretKeyVector& secKeys, size_t start = 0, size_t count = 0);
     bool VerifySignatureVector(const BLSSignatureVector& sigs, size_t start = 0, size_t count = 0);
 
+    // Verifies a large number of signatures at once, no matter which messages, keys or quorums they belong to.
+    // Every signature and public key is multiplied with the same random scalar first, so that invalid signatures can't
+    // cancel each other out in the aggregate (randomized linear combination). This allows to use insecure aggregation
+    // even for signatures which come from different sources. The entries are split into one batch per worker and each
+    // batch is verified with one aggregated verification. Failing batches are bisected until the invalid signatures are
+    // found, so a few invalid signatures only cost a few additional aggregated verifications each.
+    // Returns one entry per signature, set to true if it's valid. Blocks until done, so don't call it from a worker.
+    std::vector<bool> VerifySignatures(const BLSSignatureVector& sigs, const BLSPublicKeyVector& pubKeys, const std::vector<uint256>& msgHashes,
+                                       bool parallel = true);
+
     // Internally batched signature signing and verification
     void AsyncSign(const CBLSSecretKey& secKey, const uint256& msgHash, SignDoneCallback doneCallback);
     std::future<CBLSSignature> AsyncSign(const CBLSSecretKey& secKey, const uint256& msgHash);
@@ -180,6 +206,15 @@ public:
         });
     }
 
+    // The shared state of each future is counted as a plain allocation of its value
+    size_t DynamicMemoryUsage()
+    {
+        std::unique_lock<std::mutex> l(cacheCs);
+        return memusage::DynamicUsage(vvecCache) + vvecCache.size() * memusage::MallocUsage(sizeof(BLSVerificationVectorPtr)) +
+               memusage::DynamicUsage(secretKeyShareCache) + secretKeyShareCache.size() * memusage::MallocUsage(sizeof(CBLSSecretKey)) +
+               memusage::DynamicUsage(publicKeyShareCache) + publicKeyShareCache.size() * memusage::MallocUsage(sizeof(CBLSPublicKey));
+    }
+
 private:
     template <typename T, typename Builder>
     T GetOrBuild(const uint256& cacheKey, std::map<uint256, std::shared_future<T> >& cache, Builder&& builder)
@@ -10,6 +10,7 @@
 #include <list>
 #include <set>
 
+#include <memusage.h>
 #include <serialize.h>
 
 #include <cachemap.h>
@@ -84,6 +85,15 @@ public:
         return listItems.size();
     }
 
+    /** The memory used by the items and the index, not counting memory owned by the keys and values */
+    size_t DynamicMemoryUsage() const {
+        size_t ret = memusage::DynamicUsage(listItems) + memusage::DynamicUsage(mapIndex);
+        for (const auto& p : mapIndex) {
+            ret += memusage::DynamicUsage(p.second);
+        }
+        return ret;
+    }
+
     bool Insert(const K& key, const V& value)
     {
         map_it mit = mapIndex.find(key);
@@ -160,6 +160,8 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_CONFLICT_CHAINLOCK =   128, //!< conflicts with chainlock system
+
+    BLOCK_UNDO_COMPACT       =   256, //!< undo data uses the compact serialization (see -compactundo)
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -526,6 +526,11 @@ public:
                         //   (the tx=... number in the SetBestChain debug.log lines)
             0.3         // * estimated number of transactions per second after that timestamp
         };
+
+        // UTXO snapshots accepted by loadtxoutset, the values are reported by dumptxoutset
+        m_assumeutxo_data = MapAssumeutxo{
+            // To be added for a recent height with each release
+        };
     }
 };
 
@@ -707,6 +712,10 @@ public:
             0.01        // * estimated number of transactions per second after that timestamp
         };
 
+        // UTXO snapshots accepted by loadtxoutset, the values are reported by dumptxoutset
+        m_assumeutxo_data = MapAssumeutxo{
+            // To be added for a recent height with each release
+        };
     }
 };
 
@@ -37,6 +37,19 @@ struct ChainTxData {
     double dTxRate;
 };
 
+/**
+ * Holds what is needed to trust a UTXO snapshot that is loaded with loadtxoutset, instead of connecting all the
+ * blocks until the snapshot's base block.
+ */
+struct AssumeutxoData {
+    //! CCoinsStats::hashSerialized of the snapshot, which includes the hash of its base block
+    uint256 hashSerialized;
+    //! Number of transactions until and including the base block, see CBlockIndex::nChainTx
+    unsigned int nChainTx;
+};
+
+typedef std::map<int, const AssumeutxoData> MapAssumeutxo;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Dash system. There are three: the main network on which people trade goods
@@ -87,6 +100,8 @@ public:
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
     const ChainTxData& TxData() const { return chainTxData; }
+    /** UTXO snapshots that can be loaded, by the height of their base block */
+    const MapAssumeutxo& Assumeutxo() const { return m_assumeutxo_data; }
     void UpdateVersionBitsParameters(Consensus::DeploymentPos d, int64_t nStartTime, int64_t nTimeout, int64_t nWindowSize, int64_t nThresholdStart, int64_t nThresholdMin, int64_t nFalloffCoeff);
     void UpdateDIP3Parameters(int nActivationHeight, int nEnforcementHeight);
     void UpdateDIP8Parameters(int nActivationHeight);
@@ -125,6 +140,7 @@ protected:
     int nLLMQConnectionRetryTimeout;
     CCheckpointData checkpointData;
     ChainTxData chainTxData;
+    MapAssumeutxo m_assumeutxo_data;
     int nPoolMinParticipants;
     int nPoolMaxParticipants;
     int nFulfilledRequestExpireTime;
@@ -5,9 +5,13 @@
 #ifndef BITCOIN_CHECKQUEUE_H
 #define BITCOIN_CHECKQUEUE_H
 
+#include <executor.h>
 #include <sync.h>
 
 #include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <stdint.h>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,12 +29,15 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Instead of dedicated worker threads, the queue can use helpers on an
+  * executor (see SetExecutor), which only stay on it while there is work.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Mutex to protect the inner state, only taken to go idle, to wake up idle workers and to add work
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,87 +46,158 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    /**
+     * The elements to be processed are stored in segments which are allocated once and never move, so that the
+     * workers can take elements out of them without holding mutex while the master appends new ones. Segment k holds
+     * FIRST_SEGMENT_SIZE << k elements, enough for any block.
+     */
+    static const int FIRST_SEGMENT_BITS = 6;
+    static const size_t FIRST_SEGMENT_SIZE = 1 << FIRST_SEGMENT_BITS;
+    static const int MAX_SEGMENTS = 32;
+    T* segments[MAX_SEGMENTS] = {};
+
+    /**
+     * Counts of elements added and handed out to workers so far. They only ever grow, also across verifications,
+     * so that a worker which looked at the queue during an earlier verification can't claim elements of a later one.
+     * Elements with a position below nBase (the total at the end of the last verification) are done.
+     */
+    std::atomic<uint64_t> nAdded{0};
+    std::atomic<uint64_t> nNext{0};
+    uint64_t nBase{0};
 
     //! The number of workers (including the master) that are idle.
-    int nIdle;
+    std::atomic<int> nIdle{0};
 
     //! The total number of workers (including the master).
-    int nTotal;
+    std::atomic<int> nTotal{0};
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk{true};
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo{0};
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! When set, Add() starts up to nMaxHelpers helpers on it, which return once the queue is empty
+    CExecutor* pexecutor{nullptr};
+    int nMaxHelpers{0};
+    int nHelpers{0};
+
+    //! The segment holding the element at position pos of the current verification, and its index in there
+    static int Segment(uint64_t pos, uint64_t& indexRet)
+    {
+        uint64_t p = pos + FIRST_SEGMENT_SIZE;
+        int k = 63 - CountLeadingZeros(p) - FIRST_SEGMENT_BITS;
+        indexRet = p - (FIRST_SEGMENT_SIZE << k);
+        return k;
+    }
+
+    T& At(uint64_t pos)
+    {
+        uint64_t index;
+        int k = Segment(pos, index);
+        return segments[k][index];
+    }
+
+    static int CountLeadingZeros(uint64_t x)
+    {
+#if defined(__GNUC__)
+        return __builtin_clzll(x);
+#else
+        int n = 64;
+        while (x) {
+            x >>= 1;
+            n--;
+        }
+        return n;
+#endif
+    }
+
+    /**
+     * Claim a batch of elements without taking mutex. Returns the number of elements claimed starting at posRet, 0 if
+     * there are none left right now.
+     * Do not try to do everything at once, but aim for increasingly smaller batches so all workers finish
+     * approximately simultaneously. Try to account for idle workers which will instantly start helping, and don't do
+     * batches smaller than 1 (duh), or larger than nBatchSize.
+     */
+    unsigned int Claim(uint64_t& posRet)
+    {
+        uint64_t next = nNext.load(std::memory_order_relaxed);
+        while (true) {
+            uint64_t added = nAdded.load(std::memory_order_acquire);
+            if (next >= added) {
+                return 0;
+            }
+            uint64_t nQueued = added - next;
+            unsigned int nNow = std::max<uint64_t>(1, std::min<uint64_t>(nBatchSize, nQueued / (nTotal.load(std::memory_order_relaxed) + nIdle.load(std::memory_order_relaxed) + 1)));
+            if (nNext.compare_exchange_weak(next, next + nNow, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                posRet = next;
+                return nNow;
+            }
+        }
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(bool fMaster = false, bool fHelper = false)
     {
         boost::condition_variable& cond = fMaster ? condMaster : condWorker;
-        std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nTotal++;
+        }
         do {
-            {
+            uint64_t pos;
+            unsigned int nNow = Claim(pos);
+            if (nNow == 0) {
                 boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
+                // Add() only wakes up idle workers after publishing new elements with mutex held, so check again
+                // with the lock held before going idle
+                while ((nNow = Claim(pos)) == 0) {
+                    if (fMaster && nTodo.load(std::memory_order_acquire) == 0) {
                         nTotal--;
                         bool fRet = fAllOk;
                         // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
+                        fAllOk = true;
+                        nBase = nAdded;
                         // return the current status
                         return fRet;
                     }
+                    if (fHelper) {
+                        // give the executor thread back, Add() starts new helpers for new work
+                        nTotal--;
+                        nHelpers--;
+                        return true;
+                    }
                     nIdle++;
                     cond.wait(lock); // wait
                     nIdle--;
                 }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
+
+            // Check whether we need to do work at all
+            bool fOk = fAllOk.load(std::memory_order_relaxed);
+            for (unsigned int i = 0; i < nNow; i++) {
+                // Swap the job out of the queue so that it is destroyed before the verification counts as done
+                T check;
+                check.swap(At(pos - nBase + i));
+                if (fOk) {
                     fOk = check();
-            vChecks.clear();
+                }
+            }
+            if (!fOk) {
+                fAllOk = false;
+            }
+            if (nTodo.fetch_sub(nNow, std::memory_order_acq_rel) == nNow && !fMaster) {
+                // We processed the last element; inform the master it can exit and return the result
+                boost::unique_lock<boost::mutex> lock(mutex);
+                condMaster.notify_one();
+            }
         } while (true);
     }
 
@@ -128,7 +206,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
@@ -142,23 +220,54 @@ public:
         return Loop(true);
     }
 
-    //! Add a batch of checks to the queue
-    void Add(std::vector<T>& vChecks)
+    //! Use up to nMaxHelpersIn helpers on executor instead of Thread() workers
+    void SetExecutor(CExecutor* executor, int nMaxHelpersIn)
     {
         boost::unique_lock<boost::mutex> lock(mutex);
+        pexecutor = executor;
+        nMaxHelpers = nMaxHelpersIn;
+    }
+
+    //! Add a batch of checks to the queue. Only the holder of ControlMutex may add checks
+    void Add(std::vector<T>& vChecks)
+    {
+        if (vChecks.empty()) {
+            return;
+        }
+        // Only the master writes behind nAdded, so the elements can be filled in before taking mutex
+        uint64_t added = nAdded.load(std::memory_order_relaxed);
         for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+            uint64_t index;
+            int k = Segment(added - nBase, index);
+            assert(k < MAX_SEGMENTS);
+            if (segments[k] == nullptr) {
+                segments[k] = new T[FIRST_SEGMENT_SIZE << k];
+            }
+            check.swap(segments[k][index]);
+            added++;
         }
-        nTodo += vChecks.size();
+        nTodo.fetch_add(vChecks.size(), std::memory_order_relaxed);
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nAdded.store(added, std::memory_order_release);
         if (vChecks.size() == 1)
             condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        else
             condWorker.notify_all();
+        if (pexecutor != nullptr) {
+            int nNewHelpers = std::min<int>(nMaxHelpers - nHelpers, vChecks.size());
+            for (int i = 0; i < nNewHelpers; i++) {
+                nHelpers++;
+                pexecutor->Push(ExecutorPriority::CONSENSUS, [this](int threadId) { Loop(false, true); });
+            }
+        }
     }
 
     ~CCheckQueue()
     {
+        for (T* segment : segments) {
+            delete[] segment;
+        }
     }
 
 };
@@ -53,22 +53,8 @@ void CCoinJoinClientQueueManager::ProcessMessage(CNode* pfrom, const std::string
         CCoinJoinQueue dsq;
         vRecv >> dsq;
 
-        {
-            TRY_LOCK(cs_vecqueue, lockRecv);
-            if (!lockRecv) return;
-
-            // process every dsq only once
-            for (const auto& q : vecCoinJoinQueue) {
-                if (q == dsq) {
-                    return;
-                }
-                if (q.fReady == dsq.fReady && q.masternodeOutpoint == dsq.masternodeOutpoint) {
-                    // no way the same mn can send another dsq with the same readiness this soon
-                    LogPrint(BCLog::COINJOIN, "DSQUEUE -- Peer %s is sending WAY too many dsq messages for a masternode with collateral %s\n", pfrom->GetLogString(), dsq.masternodeOutpoint.ToStringShort());
-                    return;
-                }
-            }
-        } // cs_vecqueue
+        // process every dsq only once
+        if (IsQueueKnown(dsq, pfrom)) return;
 
         LogPrint(BCLog::COINJOIN, "DSQUEUE -- %s new\n", dsq.ToString());
 
@@ -78,46 +64,47 @@ void CCoinJoinClientQueueManager::ProcessMessage(CNode* pfrom, const std::string
         auto dmn = mnList.GetValidMNByCollateral(dsq.masternodeOutpoint);
         if (!dmn) return;
 
-        if (!dsq.CheckSignature(dmn->pdmnState->pubKeyOperator.Get())) {
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), 10);
-            return;
-        }
+        AsyncVerifyQueue(dsq, dmn->pdmnState->pubKeyOperator.Get(), pfrom->GetId(), [this, mnList, dmn, &connman](const CCoinJoinQueue& dsq) {
+            ProcessVerifiedQueue(dsq, mnList, dmn, connman);
+        });
+    }
+}
 
-        // if the queue is ready, submit if we can
-        if (dsq.fReady) {
-            for (auto& pair : coinJoinClientManagers) {
-                if (pair.second->TrySubmitDenominate(dmn->pdmnState->addr, connman)) {
-                    LogPrint(BCLog::COINJOIN, "DSQUEUE -- CoinJoin queue (%s) is ready on masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
-                    return;
-                }
-            }
-        } else {
-            int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
-            int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
-            LogPrint(BCLog::COINJOIN, "DSQUEUE -- nLastDsq: %d  nDsqThreshold: %d  nDsqCount: %d\n", nLastDsq, nDsqThreshold, mmetaman.GetDsqCount());
-            // don't allow a few nodes to dominate the queuing process
-            if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
-                LogPrint(BCLog::COINJOIN, "DSQUEUE -- Masternode %s is sending too many dsq messages\n", dmn->proTxHash.ToString());
+void CCoinJoinClientQueueManager::ProcessVerifiedQueue(CCoinJoinQueue dsq, const CDeterministicMNList& mnList, const CDeterministicMNCPtr& dmn, CConnman& connman)
+{
+    // if the queue is ready, submit if we can
+    if (dsq.fReady) {
+        for (auto& pair : coinJoinClientManagers) {
+            if (pair.second->TrySubmitDenominate(dmn->pdmnState->addr, dsq.nDenom, connman)) {
+                LogPrint(BCLog::COINJOIN, "DSQUEUE -- CoinJoin queue (%s) is ready on masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
                 return;
             }
+        }
+    } else {
+        int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
+        int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- nLastDsq: %d  nDsqThreshold: %d  nDsqCount: %d\n", nLastDsq, nDsqThreshold, mmetaman.GetDsqCount());
+        // don't allow a few nodes to dominate the queuing process
+        if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
+            LogPrint(BCLog::COINJOIN, "DSQUEUE -- Masternode %s is sending too many dsq messages\n", dmn->proTxHash.ToString());
+            return;
+        }
 
-            mmetaman.AllowMixing(dmn->proTxHash);
+        mmetaman.AllowMixing(dmn->proTxHash);
 
-            LogPrint(BCLog::COINJOIN, "DSQUEUE -- new CoinJoin queue (%s) from masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- new CoinJoin queue (%s) from masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
 
-            for (const auto& pair : coinJoinClientManagers) {
-                if (pair.second->MarkAlreadyJoinedQueueAsTried(dsq)) {
-                    break;
-                }
+        for (const auto& pair : coinJoinClientManagers) {
+            if (pair.second->MarkAlreadyJoinedQueueAsTried(dsq)) {
+                break;
             }
-
-            TRY_LOCK(cs_vecqueue, lockRecv);
-            if (!lockRecv) return;
-            vecCoinJoinQueue.push_back(dsq);
-            dsq.Relay(connman);
         }
 
+        LOCK(cs_vecqueue);
+        // another peer's copy may have been verified in the meantime
+        if (coinJoinQueues.HasFromMasternode(dsq.masternodeOutpoint, dsq.nDenom, dsq.fReady)) return;
+        coinJoinQueues.Add(dsq);
+        dsq.Relay(connman);
     }
 }
 
@@ -278,6 +265,7 @@ void CCoinJoinClientSession::SetNull()
     // Client side
     mixingMasternode = nullptr;
     pendingDsaRequest = CPendingDsaRequest();
+    vecTxDSInReserved.clear();
 
     CCoinJoinBaseSession::SetNull();
 }
@@ -766,130 +754,35 @@ bool CCoinJoinClientManager::CheckAutomaticBackup()
 //
 // Passively run mixing in the background to mix funds based on the given configuration.
 //
-bool CCoinJoinClientSession::DoAutomaticDenominating(CConnman& connman, bool fDryRun)
+bool CCoinJoinClientSession::DoAutomaticDenominating(CCoinJoinClientPlan& plan, CConnman& connman, bool fDryRun)
 {
     if (fMasternodeMode) return false; // no client-side mixing on masternodes
     if (nState != POOL_STATE_IDLE) return false;
 
-    if (!masternodeSync.IsBlockchainSynced()) {
-        strAutoDenomResult = _("Can't mix while sync in progress.");
+    if (!plan.fReady) {
+        if (!plan.strResult.empty()) {
+            strAutoDenomResult = plan.strResult;
+        }
         return false;
     }
 
-    if (!CCoinJoinClientOptions::IsEnabled()) return false;
-
-    CAmount nBalanceNeedsAnonymized;
+    if (GetEntriesCount() > 0) {
+        strAutoDenomResult = _("Mixing in progress...");
+        return false;
+    }
 
     {
-        LOCK2(cs_main, mempool.cs);
-        LOCK(mixingWallet.cs_wallet);
-
-        if (!fDryRun && mixingWallet.IsLocked(true)) {
-            strAutoDenomResult = _("Wallet is locked.");
-            return false;
-        }
-
-        if (GetEntriesCount() > 0) {
-            strAutoDenomResult = _("Mixing in progress...");
-            return false;
-        }
-
         TRY_LOCK(cs_coinjoin, lockDS);
         if (!lockDS) {
             strAutoDenomResult = _("Lock is already in place.");
             return false;
         }
 
-        if (deterministicMNManager->GetListAtChainTip().GetValidMNsCount() == 0 &&
-            Params().NetworkIDString() != CBaseChainParams::REGTEST) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::DoAutomaticDenominating -- No Masternodes detected\n");
-            strAutoDenomResult = _("No Masternodes detected.");
-            return false;
-        }
-
-        // check if there is anything left to do
-        CAmount nBalanceAnonymized = mixingWallet.GetAnonymizedBalance();
-        nBalanceNeedsAnonymized = CCoinJoinClientOptions::GetAmount() * COIN - nBalanceAnonymized;
-
-        if (nBalanceNeedsAnonymized < 0) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::DoAutomaticDenominating -- Nothing to do\n");
-            // nothing to do, just keep it in idle mode
-            return false;
-        }
-
-        CAmount nValueMin = CCoinJoin::GetSmallestDenomination();
-
-        // if there are no confirmed DS collateral inputs yet
-        if (!mixingWallet.HasCollateralInputs()) {
-            // should have some additional amount for them
-            nValueMin += CCoinJoin::GetMaxCollateralAmount();
-        }
-
-        // including denoms but applying some restrictions
-        CAmount nBalanceAnonymizable = mixingWallet.GetAnonymizableBalance();
-
-        // mixable balance is way too small
-        if (nBalanceAnonymizable < nValueMin) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::DoAutomaticDenominating -- Not enough funds to mix\n");
-            strAutoDenomResult = _("Not enough funds to mix.");
-            return false;
-        }
-
-        // excluding denoms
-        CAmount nBalanceAnonimizableNonDenom = mixingWallet.GetAnonymizableBalance(true);
-        // denoms
-        CAmount nBalanceDenominatedConf = mixingWallet.GetDenominatedBalance();
-        CAmount nBalanceDenominatedUnconf = mixingWallet.GetDenominatedBalance(true);
-        CAmount nBalanceDenominated = nBalanceDenominatedConf + nBalanceDenominatedUnconf;
-        CAmount nBalanceToDenominate = CCoinJoinClientOptions::GetAmount() * COIN - nBalanceDenominated;
-
-        // adjust nBalanceNeedsAnonymized to consume final denom
-        if (nBalanceDenominated - nBalanceAnonymized > nBalanceNeedsAnonymized) {
-            auto denoms = CCoinJoin::GetStandardDenominations();
-            CAmount nAdditionalDenom{0};
-            for (const auto& denom : denoms) {
-                if (nBalanceNeedsAnonymized < denom) {
-                    nAdditionalDenom = denom;
-                } else {
-                    break;
-                }
-            }
-            nBalanceNeedsAnonymized += nAdditionalDenom;
-        }
-
-        LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::DoAutomaticDenominating -- current stats:\n"
-            "    nValueMin: %s\n"
-            "    nBalanceAnonymizable: %s\n"
-            "    nBalanceAnonymized: %s\n"
-            "    nBalanceNeedsAnonymized: %s\n"
-            "    nBalanceAnonimizableNonDenom: %s\n"
-            "    nBalanceDenominatedConf: %s\n"
-            "    nBalanceDenominatedUnconf: %s\n"
-            "    nBalanceDenominated: %s\n"
-            "    nBalanceToDenominate: %s\n",
-            FormatMoney(nValueMin),
-            FormatMoney(nBalanceAnonymizable),
-            FormatMoney(nBalanceAnonymized),
-            FormatMoney(nBalanceNeedsAnonymized),
-            FormatMoney(nBalanceAnonimizableNonDenom),
-            FormatMoney(nBalanceDenominatedConf),
-            FormatMoney(nBalanceDenominatedUnconf),
-            FormatMoney(nBalanceDenominated),
-            FormatMoney(nBalanceToDenominate)
-            );
-
         if (fDryRun) return true;
 
-        // Check if we have should create more denominated inputs i.e.
-        // there are funds to denominate and denominated balance does not exceed
-        // max amount to mix yet.
-        if (nBalanceAnonimizableNonDenom >= nValueMin + CCoinJoin::GetCollateralAmount() && nBalanceToDenominate > 0) {
-            CreateDenominated(nBalanceToDenominate);
-        }
-
         //check if we have the collateral sized inputs
-        if (!mixingWallet.HasCollateralInputs()) {
-            return !mixingWallet.HasCollateralInputs(false) && MakeCollateralAmounts();
+        if (!plan.fHasCollateralInputs) {
+            return plan.fCollateralsCreated;
         }
 
         if (nSessionID) {
@@ -901,10 +794,11 @@ bool CCoinJoinClientSession::DoAutomaticDenominating(CConnman& connman, bool fDr
         // Clean if there is anything left from previous session
         UnlockCoins();
         keyHolderStorage.ReturnAll();
+        ReleaseInputs(plan);
         SetNull();
 
         // should be no unconfirmed denoms in non-multi-session mode
-        if (!CCoinJoinClientOptions::IsMultiSessionEnabled() && nBalanceDenominatedUnconf > 0) {
+        if (!CCoinJoinClientOptions::IsMultiSessionEnabled() && plan.nBalanceDenominatedUnconf > 0) {
             LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::DoAutomaticDenominating -- Found unconfirmed denominated outputs, will wait till they confirm to continue.\n");
             strAutoDenomResult = _("Found unconfirmed denominated outputs, will wait till they confirm to continue.");
             return false;
@@ -927,24 +821,138 @@ bool CCoinJoinClientSession::DoAutomaticDenominating(CConnman& connman, bool fDr
             }
         }
         // lock the funds we're going to use for our collateral
+        LOCK(mixingWallet.cs_wallet);
         for (const auto& txin : txMyCollateral.vin) {
             mixingWallet.LockCoin(txin.prevout);
             vecOutPointLocked.push_back(txin.prevout);
         }
-    } // LOCK2(cs_main, mixingWallet.cs_wallet);
+    }
 
     // Always attempt to join an existing queue
-    if (JoinExistingQueue(nBalanceNeedsAnonymized, connman)) {
+    if (JoinExistingQueue(plan, connman)) {
         return true;
     }
 
     // If we were unable to find/join an existing queue then start a new one.
-    if (StartNewQueue(nBalanceNeedsAnonymized, connman)) return true;
+    if (StartNewQueue(plan, connman)) return true;
 
     strAutoDenomResult = _("No compatible Masternode found.");
     return false;
 }
 
+void CCoinJoinClientManager::MakePlan(CCoinJoinClientPlan& plan, bool fDryRun)
+{
+    LOCK2(cs_main, mempool.cs);
+    LOCK(mixingWallet.cs_wallet);
+
+    if (deterministicMNManager->GetListAtChainTip().GetValidMNsCount() == 0 &&
+        Params().NetworkIDString() != CBaseChainParams::REGTEST) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::DoAutomaticDenominating -- No Masternodes detected\n");
+        plan.strResult = _("No Masternodes detected.");
+        return;
+    }
+
+    // check if there is anything left to do
+    CAmount nBalanceAnonymized = mixingWallet.GetAnonymizedBalance();
+    CAmount nBalanceNeedsAnonymized = CCoinJoinClientOptions::GetAmount() * COIN - nBalanceAnonymized;
+
+    if (nBalanceNeedsAnonymized < 0) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::DoAutomaticDenominating -- Nothing to do\n");
+        // nothing to do, just keep it in idle mode
+        return;
+    }
+
+    CAmount nValueMin = CCoinJoin::GetSmallestDenomination();
+
+    // if there are no confirmed DS collateral inputs yet
+    if (!mixingWallet.HasCollateralInputs()) {
+        // should have some additional amount for them
+        nValueMin += CCoinJoin::GetMaxCollateralAmount();
+    }
+
+    // including denoms but applying some restrictions
+    CAmount nBalanceAnonymizable = mixingWallet.GetAnonymizableBalance();
+
+    // mixable balance is way too small
+    if (nBalanceAnonymizable < nValueMin) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::DoAutomaticDenominating -- Not enough funds to mix\n");
+        plan.strResult = _("Not enough funds to mix.");
+        return;
+    }
+
+    // excluding denoms
+    CAmount nBalanceAnonimizableNonDenom = mixingWallet.GetAnonymizableBalance(true);
+    // denoms
+    CAmount nBalanceDenominatedConf = mixingWallet.GetDenominatedBalance();
+    CAmount nBalanceDenominatedUnconf = mixingWallet.GetDenominatedBalance(true);
+    CAmount nBalanceDenominated = nBalanceDenominatedConf + nBalanceDenominatedUnconf;
+    CAmount nBalanceToDenominate = CCoinJoinClientOptions::GetAmount() * COIN - nBalanceDenominated;
+
+    // adjust nBalanceNeedsAnonymized to consume final denom
+    if (nBalanceDenominated - nBalanceAnonymized > nBalanceNeedsAnonymized) {
+        auto denoms = CCoinJoin::GetStandardDenominations();
+        CAmount nAdditionalDenom{0};
+        for (const auto& denom : denoms) {
+            if (nBalanceNeedsAnonymized < denom) {
+                nAdditionalDenom = denom;
+            } else {
+                break;
+            }
+        }
+        nBalanceNeedsAnonymized += nAdditionalDenom;
+    }
+
+    LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::DoAutomaticDenominating -- current stats:\n"
+        "    nValueMin: %s\n"
+        "    nBalanceAnonymizable: %s\n"
+        "    nBalanceAnonymized: %s\n"
+        "    nBalanceNeedsAnonymized: %s\n"
+        "    nBalanceAnonimizableNonDenom: %s\n"
+        "    nBalanceDenominatedConf: %s\n"
+        "    nBalanceDenominatedUnconf: %s\n"
+        "    nBalanceDenominated: %s\n"
+        "    nBalanceToDenominate: %s\n",
+        FormatMoney(nValueMin),
+        FormatMoney(nBalanceAnonymizable),
+        FormatMoney(nBalanceAnonymized),
+        FormatMoney(nBalanceNeedsAnonymized),
+        FormatMoney(nBalanceAnonimizableNonDenom),
+        FormatMoney(nBalanceDenominatedConf),
+        FormatMoney(nBalanceDenominatedUnconf),
+        FormatMoney(nBalanceDenominated),
+        FormatMoney(nBalanceToDenominate)
+        );
+
+    plan.nBalanceNeedsAnonymized = nBalanceNeedsAnonymized;
+    plan.nBalanceDenominatedUnconf = nBalanceDenominatedUnconf;
+    plan.fReady = true;
+
+    if (fDryRun) return;
+
+    // Check if we have should create more denominated inputs i.e.
+    // there are funds to denominate and denominated balance does not exceed
+    // max amount to mix yet.
+    if (nBalanceAnonimizableNonDenom >= nValueMin + CCoinJoin::GetCollateralAmount() && nBalanceToDenominate > 0) {
+        CreateDenominated(nBalanceToDenominate);
+    }
+
+    //check if we have the collateral sized inputs
+    plan.fHasCollateralInputs = mixingWallet.HasCollateralInputs();
+    if (!plan.fHasCollateralInputs) {
+        plan.fCollateralsCreated = !mixingWallet.HasCollateralInputs(false) && MakeCollateralAmounts();
+        return;
+    }
+
+    // The inputs which could be mixed, the caller adds the ones which are reserved by the sessions already
+    for (const auto& nDenomAmount : CCoinJoin::GetStandardDenominations()) {
+        int nDenom = CCoinJoin::AmountToDenomination(nDenomAmount);
+        std::vector<CTxDSIn> vecTxDSIn;
+        if (mixingWallet.SelectTxDSInsByDenomination(nDenom, MAX_MONEY, vecTxDSIn)) {
+            plan.mapDenomInputs.emplace(nDenom, std::move(vecTxDSIn));
+        }
+    }
+}
+
 bool CCoinJoinClientManager::DoAutomaticDenominating(CConnman& connman, bool fDryRun)
 {
     if (fMasternodeMode) return false; // no client-side mixing on masternodes
@@ -977,16 +985,37 @@ bool CCoinJoinClientManager::DoAutomaticDenominating(CConnman& connman, bool fDr
     if ((int)deqSessions.size() < CCoinJoinClientOptions::GetSessions()) {
         deqSessions.emplace_back(mixingWallet);
     }
-    for (auto& session : deqSessions) {
-        if (!CheckAutomaticBackup()) return false;
 
+    if (!CheckAutomaticBackup()) return false;
+
+    if (WaitForAnotherBlock()) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::DoAutomaticDenominating -- Last successful action was too recent\n");
+        strAutoDenomResult = _("Last successful action was too recent.");
+        return false;
+    }
+
+    // Plan once for all sessions, they only take the wallet lock for the few steps that change it. There is nothing
+    // to plan when all of them are busy already.
+    CCoinJoinClientPlan plan;
+    bool fAnyIdle{false};
+    for (const auto& session : deqSessions) {
+        fAnyIdle |= session.GetState() == POOL_STATE_IDLE;
+        for (const auto& txdsin : session.GetReservedInputs()) {
+            plan.setReservedOutpoints.emplace(txdsin.prevout);
+        }
+    }
+    if (!fAnyIdle) return false;
+    MakePlan(plan, fDryRun);
+
+    for (auto& session : deqSessions) {
+        // creating denominations counts as a successful action too
         if (WaitForAnotherBlock()) {
             LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::DoAutomaticDenominating -- Last successful action was too recent\n");
             strAutoDenomResult = _("Last successful action was too recent.");
             return false;
         }
 
-        fResult &= session.DoAutomaticDenominating(connman, fDryRun);
+        fResult &= session.DoAutomaticDenominating(plan, connman, fDryRun);
     }
 
     return fResult;
@@ -1035,7 +1064,33 @@ CDeterministicMNCPtr CCoinJoinClientManager::GetRandomNotUsedMasternode()
     return nullptr;
 }
 
-bool CCoinJoinClientSession::JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CConnman& connman)
+bool CCoinJoinClientSession::ReserveInputs(CCoinJoinClientPlan& plan, int nDenom)
+{
+    vecTxDSInReserved.clear();
+
+    auto it = plan.mapDenomInputs.find(nDenom);
+    if (it == plan.mapDenomInputs.end()) return false;
+
+    CAmount nDenomAmount = CCoinJoin::DenominationToAmount(nDenom);
+    CAmount nValueTotal{0};
+    for (const auto& txdsin : it->second) {
+        if (nValueTotal + nDenomAmount > CCoinJoin::GetMaxPoolAmount()) break;
+        if (!plan.setReservedOutpoints.emplace(txdsin.prevout).second) continue;
+        vecTxDSInReserved.emplace_back(txdsin);
+        nValueTotal += nDenomAmount;
+    }
+    return !vecTxDSInReserved.empty();
+}
+
+void CCoinJoinClientSession::ReleaseInputs(CCoinJoinClientPlan& plan)
+{
+    for (const auto& txdsin : vecTxDSInReserved) {
+        plan.setReservedOutpoints.erase(txdsin.prevout);
+    }
+    vecTxDSInReserved.clear();
+}
+
+bool CCoinJoinClientSession::JoinExistingQueue(CCoinJoinClientPlan& plan, CConnman& connman)
 {
     if (!CCoinJoinClientOptions::IsEnabled()) return false;
 
@@ -1058,15 +1113,13 @@ bool CCoinJoinClientSession::JoinExistingQueue(CAmount nBalanceNeedsAnonymized,
         }
 
         // mixing rate limit i.e. nLastDsq check should already pass in DSQUEUE ProcessMessage
-        // in order for dsq to get into vecCoinJoinQueue, so we should be safe to mix already,
+        // in order for dsq to get into coinJoinQueues, so we should be safe to mix already,
         // no need for additional verification here
 
         LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::JoinExistingQueue -- trying queue: %s\n", dsq.ToString());
 
-        std::vector<CTxDSIn> vecTxDSInTmp;
-
-        // Try to match their denominations if possible, select exact number of denominations
-        if (!mixingWallet.SelectTxDSInsByDenomination(dsq.nDenom, nBalanceNeedsAnonymized, vecTxDSInTmp)) {
+        // Try to match their denominations if possible with inputs no other session uses
+        if (CCoinJoin::DenominationToAmount(dsq.nDenom) > plan.nBalanceNeedsAnonymized || !ReserveInputs(plan, dsq.nDenom)) {
             LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::JoinExistingQueue -- Couldn't match denomination %d (%s)\n", dsq.nDenom, CCoinJoin::DenominationToString(dsq.nDenom));
             continue;
         }
@@ -1075,6 +1128,7 @@ bool CCoinJoinClientSession::JoinExistingQueue(CAmount nBalanceNeedsAnonymized,
 
         if (connman.IsMasternodeOrDisconnectRequested(dmn->pdmnState->addr)) {
             LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::JoinExistingQueue -- skipping masternode connection, addr=%s\n", dmn->pdmnState->addr.ToString());
+            ReleaseInputs(plan);
             continue;
         }
 
@@ -1094,18 +1148,35 @@ bool CCoinJoinClientSession::JoinExistingQueue(CAmount nBalanceNeedsAnonymized,
     return false;
 }
 
-bool CCoinJoinClientSession::StartNewQueue(CAmount nBalanceNeedsAnonymized, CConnman& connman)
+bool CCoinJoinClientSession::StartNewQueue(CCoinJoinClientPlan& plan, CConnman& connman)
 {
     if (!CCoinJoinClientOptions::IsEnabled()) return false;
-    if (nBalanceNeedsAnonymized <= 0) return false;
+    if (plan.nBalanceNeedsAnonymized <= 0) return false;
 
     int nTries = 0;
     auto mnList = deterministicMNManager->GetListAtChainTip();
     int nMnCount = mnList.GetValidMNsCount();
 
-    // find available denominated amounts
+    // find available denominated amounts, larger denoms first, only counting as many unreserved inputs of each
+    // denomination as still fit
     std::set<CAmount> setAmounts;
-    if (!mixingWallet.SelectDenominatedAmounts(nBalanceNeedsAnonymized, setAmounts)) {
+    CAmount nValueTotal{0};
+    for (const auto& nDenomAmount : CCoinJoin::GetStandardDenominations()) {
+        if (nValueTotal + nDenomAmount > plan.nBalanceNeedsAnonymized) continue;
+        auto it = plan.mapDenomInputs.find(CCoinJoin::AmountToDenomination(nDenomAmount));
+        if (it == plan.mapDenomInputs.end()) continue;
+        CAmount nMaxCount = (plan.nBalanceNeedsAnonymized - nValueTotal) / nDenomAmount;
+        CAmount nCount{0};
+        for (const auto& txdsin : it->second) {
+            if (nCount == nMaxCount) break;
+            if (!plan.setReservedOutpoints.count(txdsin.prevout)) ++nCount;
+        }
+        if (nCount > 0) {
+            nValueTotal += nDenomAmount * nCount;
+            setAmounts.emplace(nDenomAmount);
+        }
+    }
+    if (nValueTotal < CCoinJoin::GetSmallestDenomination()) {
         // this should never happen
         LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::StartNewQueue -- Can't mix: no compatible inputs found!\n");
         strAutoDenomResult = _("Can't mix: no compatible inputs found!");
@@ -1158,6 +1229,7 @@ bool CCoinJoinClientSession::StartNewQueue(CAmount nBalanceNeedsAnonymized, CCon
                 break;
             }
         }
+        ReserveInputs(plan, nSessionDenom);
 
         mixingMasternode = dmn;
         connman.AddPendingMasternode(dmn->proTxHash);
@@ -1208,12 +1280,14 @@ void CCoinJoinClientManager::ProcessPendingDsaRequest(CConnman& connman)
     }
 }
 
-bool CCoinJoinClientManager::TrySubmitDenominate(const CService& mnAddr, CConnman& connman)
+bool CCoinJoinClientManager::TrySubmitDenominate(const CService& mnAddr, int nDenom, CConnman& connman)
 {
     LOCK(cs_deqsessions);
     for (auto& session : deqSessions) {
         CDeterministicMNCPtr mnMixing;
-        if (session.GetMixingMasternodeInfo(mnMixing) && mnMixing->pdmnState->addr == mnAddr && session.GetState() == POOL_STATE_QUEUE) {
+        // masternodes can run sessions of different denominations at once, only submit to the one that is ready
+        if (session.GetMixingMasternodeInfo(mnMixing) && mnMixing->pdmnState->addr == mnAddr && session.GetState() == POOL_STATE_QUEUE &&
+            session.nSessionDenom == nDenom) {
             session.SubmitDenominate(connman);
             return true;
         }
@@ -1236,9 +1310,6 @@ bool CCoinJoinClientManager::MarkAlreadyJoinedQueueAsTried(CCoinJoinQueue& dsq)
 
 bool CCoinJoinClientSession::SubmitDenominate(CConnman& connman)
 {
-    LOCK2(cs_main, mempool.cs);
-    LOCK(mixingWallet.cs_wallet);
-
     std::string strError;
     std::vector<CTxDSIn> vecTxDSIn;
     std::vector<std::pair<CTxDSIn, CTxOut> > vecPSInOutPairsTmp;
@@ -1250,6 +1321,8 @@ bool CCoinJoinClientSession::SubmitDenominate(CConnman& connman)
 
     std::vector<std::pair<int, size_t> > vecInputsByRounds;
 
+    // Dry runs only look at the selected inputs, the wallet is locked just for the final attempts which reserve keys
+    // and lock the coins
     for (int i = 0; i < CCoinJoinClientOptions::GetRounds() + CCoinJoinClientOptions::GetRandomRounds(); i++) {
         if (PrepareDenominate(i, i, strError, vecTxDSIn, vecPSInOutPairsTmp, true)) {
             LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::SubmitDenominate -- Running CoinJoin denominate for %d rounds, success\n", i);
@@ -1269,6 +1342,9 @@ bool CCoinJoinClientSession::SubmitDenominate(CConnman& connman)
         LogPrint(BCLog::COINJOIN, "vecInputsByRounds: rounds: %d, inputs: %d\n", pair.first, pair.second);
     }
 
+    LOCK2(cs_main, mempool.cs);
+    LOCK(mixingWallet.cs_wallet);
+
     int nRounds = vecInputsByRounds.begin()->first;
     if (PrepareDenominate(nRounds, nRounds, strError, vecTxDSIn, vecPSInOutPairsTmp)) {
         LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::SubmitDenominate -- Running CoinJoin denominate for %d rounds, success\n", nRounds);
@@ -1303,8 +1379,17 @@ bool CCoinJoinClientSession::SelectDenominate(std::string& strErrorRet, std::vec
 
     vecTxDSInRet.clear();
 
-    bool fSelected = mixingWallet.SelectTxDSInsByDenomination(nSessionDenom, CCoinJoin::GetMaxPoolAmount(), vecTxDSInRet);
-    if (!fSelected) {
+    // The reserved inputs were ready to mix when the session started, skip those which were spent or locked since then
+    {
+        LOCK2(cs_main, mixingWallet.cs_wallet);
+        for (const auto& txdsin : vecTxDSInReserved) {
+            if (mixingWallet.IsSpent(txdsin.prevout.hash, txdsin.prevout.n) || mixingWallet.IsLockedCoin(txdsin.prevout.hash, txdsin.prevout.n)) {
+                continue;
+            }
+            vecTxDSInRet.emplace_back(txdsin);
+        }
+    }
+    if (vecTxDSInRet.empty()) {
         strErrorRet = "Can't select current denominated inputs";
         return false;
     }
@@ -1314,8 +1399,10 @@ bool CCoinJoinClientSession::SelectDenominate(std::string& strErrorRet, std::vec
 
 bool CCoinJoinClientSession::PrepareDenominate(int nMinRounds, int nMaxRounds, std::string& strErrorRet, const std::vector<CTxDSIn>& vecTxDSIn, std::vector<std::pair<CTxDSIn, CTxOut> >& vecPSInOutPairsRet, bool fDryRun)
 {
-    AssertLockHeld(cs_main);
-    AssertLockHeld(mixingWallet.cs_wallet);
+    if (!fDryRun) {
+        AssertLockHeld(cs_main);
+        AssertLockHeld(mixingWallet.cs_wallet);
+    }
 
     if (!CCoinJoin::IsValidDenomination(nSessionDenom)) {
         strErrorRet = "Incorrect session denom";
@@ -1376,7 +1463,7 @@ bool CCoinJoinClientSession::PrepareDenominate(int nMinRounds, int nMaxRounds, s
 }
 
 // Create collaterals by looping through inputs grouped by addresses
-bool CCoinJoinClientSession::MakeCollateralAmounts()
+bool CCoinJoinClientManager::MakeCollateralAmounts()
 {
     if (!CCoinJoinClientOptions::IsEnabled()) return false;
 
@@ -1389,7 +1476,7 @@ bool CCoinJoinClientSession::MakeCollateralAmounts()
     // This still leaves more than enough room for another data of typical MakeCollateralAmounts tx.
     std::vector<CompactTallyItem> vecTally;
     if (!mixingWallet.SelectCoinsGroupedByAddresses(vecTally, false, false, true, 400)) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::MakeCollateralAmounts -- SelectCoinsGroupedByAddresses can't find any inputs!\n");
+        LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::MakeCollateralAmounts -- SelectCoinsGroupedByAddresses can't find any inputs!\n");
         return false;
     }
 
@@ -1411,12 +1498,12 @@ bool CCoinJoinClientSession::MakeCollateralAmounts()
     }
 
     // If we got here then something is terribly broken actually
-    LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::MakeCollateralAmounts -- ERROR: Can't make collaterals!\n");
+    LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::MakeCollateralAmounts -- ERROR: Can't make collaterals!\n");
     return false;
 }
 
 // Split up large inputs or create fee sized inputs
-bool CCoinJoinClientSession::MakeCollateralAmounts(const CompactTallyItem& tallyItem, bool fTryDenominated)
+bool CCoinJoinClientManager::MakeCollateralAmounts(const CompactTallyItem& tallyItem, bool fTryDenominated)
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(mempool.cs);
@@ -1503,7 +1590,7 @@ bool CCoinJoinClientSession::MakeCollateralAmounts(const CompactTallyItem& tally
         return false;
     }
 
-    coinJoinClientManagers.at(mixingWallet.GetName())->UpdatedSuccessBlock();
+    UpdatedSuccessBlock();
 
     LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::%s -- txid: %s\n", __func__, strResult);
 
@@ -1560,7 +1647,7 @@ bool CCoinJoinClientSession::CreateCollateralTransaction(CMutableTransaction& tx
 }
 
 // Create denominations by looping through inputs grouped by addresses
-bool CCoinJoinClientSession::CreateDenominated(CAmount nBalanceToDenominate)
+bool CCoinJoinClientManager::CreateDenominated(CAmount nBalanceToDenominate)
 {
     if (!CCoinJoinClientOptions::IsEnabled()) return false;
 
@@ -1573,7 +1660,7 @@ bool CCoinJoinClientSession::CreateDenominated(CAmount nBalanceToDenominate)
     // This still leaves more than enough room for another data of typical CreateDenominated tx.
     std::vector<CompactTallyItem> vecTally;
     if (!mixingWallet.SelectCoinsGroupedByAddresses(vecTally, true, true, true, 400)) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::CreateDenominated -- SelectCoinsGroupedByAddresses can't find any inputs!\n");
+        LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::CreateDenominated -- SelectCoinsGroupedByAddresses can't find any inputs!\n");
         return false;
     }
 
@@ -1589,12 +1676,12 @@ bool CCoinJoinClientSession::CreateDenominated(CAmount nBalanceToDenominate)
         return true;
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::CreateDenominated -- failed!\n");
+    LogPrint(BCLog::COINJOIN, "CCoinJoinClientManager::CreateDenominated -- failed!\n");
     return false;
 }
 
 // Create denominations
-bool CCoinJoinClientSession::CreateDenominated(CAmount nBalanceToDenominate, const CompactTallyItem& tallyItem, bool fCreateMixingCollaterals)
+bool CCoinJoinClientManager::CreateDenominated(CAmount nBalanceToDenominate, const CompactTallyItem& tallyItem, bool fCreateMixingCollaterals)
 {
     AssertLockHeld(cs_main);
     AssertLockHeld(mempool.cs);
@@ -1782,7 +1869,7 @@ bool CCoinJoinClientSession::CreateDenominated(CAmount nBalanceToDenominate, con
     }
 
     // use the same nCachedLastSuccessBlock as for DS mixing to prevent race
-    coinJoinClientManagers.at(mixingWallet.GetName())->UpdatedSuccessBlock();
+    UpdatedSuccessBlock();
 
     LogPrint(BCLog::COINJOIN, "CCoinJoinClientSession::%s -- txid: %s\n", __func__, strResult);
 
@@ -66,10 +66,29 @@ public:
     }
 };
 
+/** What the sessions of a manager can mix, it is prepared once per run of DoAutomaticDenominating under the wallet
+ *  lock so that the sessions plan their next step without taking it
+ */
+struct CCoinJoinClientPlan
+{
+    // The reason why the sessions can't go on, when fReady is false
+    std::string strResult;
+    bool fReady{false};
+    CAmount nBalanceNeedsAnonymized{0};
+    CAmount nBalanceDenominatedUnconf{0};
+    bool fHasCollateralInputs{false};
+    bool fCollateralsCreated{false};
+    // Denominated inputs which are ready to mix by denomination, and those that sessions reserved for themselves
+    std::map<int, std::vector<CTxDSIn>> mapDenomInputs;
+    std::set<COutPoint> setReservedOutpoints;
+};
+
 class CCoinJoinClientSession : public CCoinJoinBaseSession
 {
 private:
     std::vector<COutPoint> vecOutPointLocked;
+    // Inputs of nSessionDenom set aside for this session, no other session of the wallet mixes them
+    std::vector<CTxDSIn> vecTxDSInReserved;
 
     std::string strLastMessage;
     std::string strAutoDenomResult;
@@ -82,20 +101,16 @@ private:
 
     CWallet& mixingWallet;
 
-    /// Create denominations
-    bool CreateDenominated(CAmount nBalanceToDenominate);
-    bool CreateDenominated(CAmount nBalanceToDenominate, const CompactTallyItem& tallyItem, bool fCreateMixingCollaterals);
-
-    /// Split up large inputs or make fee sized inputs
-    bool MakeCollateralAmounts();
-    bool MakeCollateralAmounts(const CompactTallyItem& tallyItem, bool fTryDenominated);
-
     bool CreateCollateralTransaction(CMutableTransaction& txCollateral, std::string& strReason);
 
-    bool JoinExistingQueue(CAmount nBalanceNeedsAnonymized, CConnman& connman);
-    bool StartNewQueue(CAmount nBalanceNeedsAnonymized, CConnman& connman);
+    /// Reserve the inputs of nDenom from the plan which aren't reserved by other sessions yet
+    bool ReserveInputs(CCoinJoinClientPlan& plan, int nDenom);
+    void ReleaseInputs(CCoinJoinClientPlan& plan);
+
+    bool JoinExistingQueue(CCoinJoinClientPlan& plan, CConnman& connman);
+    bool StartNewQueue(CCoinJoinClientPlan& plan, CConnman& connman);
 
-    /// step 0: select denominated inputs and txouts
+    /// step 0: select the reserved denominated inputs which can still be mixed
     bool SelectDenominate(std::string& strErrorRet, std::vector<CTxDSIn>& vecTxDSInRet);
     /// step 1: prepare denominated inputs and outputs
     bool PrepareDenominate(int nMinRounds, int nMaxRounds, std::string& strErrorRet, const std::vector<CTxDSIn>& vecTxDSIn, std::vector<std::pair<CTxDSIn, CTxOut> >& vecPSInOutPairsRet, bool fDryRun = false);
@@ -119,6 +134,7 @@ private:
 public:
     CCoinJoinClientSession(CWallet& pwallet) :
         vecOutPointLocked(),
+        vecTxDSInReserved(),
         strLastMessage(),
         strAutoDenomResult(),
         mixingMasternode(),
@@ -138,9 +154,10 @@ public:
     std::string GetStatus(bool fWaitForBlock);
 
     bool GetMixingMasternodeInfo(CDeterministicMNCPtr& ret) const;
+    const std::vector<CTxDSIn>& GetReservedInputs() const { return vecTxDSInReserved; }
 
-    /// Passively run mixing in the background according to the configuration in settings
-    bool DoAutomaticDenominating(CConnman& connman, bool fDryRun = false);
+    /// Find a queue to mix the inputs of the plan in, the plan is shared with the other sessions of the wallet
+    bool DoAutomaticDenominating(CCoinJoinClientPlan& plan, CConnman& connman, bool fDryRun = false);
 
     /// As a client, submit part of a future mixing transaction to a Masternode to start the process
     bool SubmitDenominate(CConnman& connman);
@@ -156,6 +173,10 @@ public:
  */
 class CCoinJoinClientQueueManager : public CCoinJoinBaseManager
 {
+private:
+    /// The part of DSQUEUE processing which happens once the signature of dsq was verified
+    void ProcessVerifiedQueue(CCoinJoinQueue dsq, const CDeterministicMNList& mnList, const CDeterministicMNCPtr& dmn, CConnman& connman);
+
 public:
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
 
@@ -194,6 +215,17 @@ private:
     // Make sure we have enough keys since last backup
     bool CheckAutomaticBackup();
 
+    /// Check the balances and create denominations and collaterals once for all sessions
+    void MakePlan(CCoinJoinClientPlan& plan, bool fDryRun);
+
+    /// Create denominations
+    bool CreateDenominated(CAmount nBalanceToDenominate);
+    bool CreateDenominated(CAmount nBalanceToDenominate, const CompactTallyItem& tallyItem, bool fCreateMixingCollaterals);
+
+    /// Split up large inputs or make fee sized inputs
+    bool MakeCollateralAmounts();
+    bool MakeCollateralAmounts(const CompactTallyItem& tallyItem, bool fTryDenominated);
+
 public:
     int nCachedNumBlocks;    // used for the overview screen
     bool fCreateAutoBackups; // builtin support for automatic backups
@@ -226,7 +258,7 @@ public:
     /// Passively run mixing in the background according to the configuration in settings
     bool DoAutomaticDenominating(CConnman& connman, bool fDryRun = false);
 
-    bool TrySubmitDenominate(const CService& mnAddr, CConnman& connman);
+    bool TrySubmitDenominate(const CService& mnAddr, int nDenom, CConnman& connman);
     bool MarkAlreadyJoinedQueueAsTried(CCoinJoinQueue& dsq) const;
 
     void CheckTimeout();
@@ -23,6 +23,8 @@
 
 #include <univalue.h>
 
+#include <algorithm>
+
 CCoinJoinServer coinJoinServer;
 
 void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61)
@@ -42,16 +44,19 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
             return;
         }
 
-        if (IsSessionReady()) {
+        CCoinJoinAccept dsa;
+        vRecv >> dsa;
+
+        LOCK(cs_sessions);
+
+        auto itSession = mapSessions.find(dsa.nDenom);
+        if (itSession != mapSessions.end() && itSession->second->IsSessionReady()) {
             // too many users in this session already, reject new ones
             LogPrint(BCLog::COINJOIN, "DSACCEPT -- queue is already full!\n");
-            PushStatus(pfrom, STATUS_REJECTED, ERR_QUEUE_FULL, connman);
+            itSession->second->PushStatus(pfrom, STATUS_REJECTED, ERR_QUEUE_FULL, connman);
             return;
         }
 
-        CCoinJoinAccept dsa;
-        vRecv >> dsa;
-
         LogPrint(BCLog::COINJOIN, "DSACCEPT -- nDenom %d (%s)  txCollateral %s", dsa.nDenom, CCoinJoin::DenominationToString(dsa.nDenom), dsa.txCollateral.ToString()); /* Continued */
 
         auto mnList = deterministicMNManager->GetListAtChainTip();
@@ -61,45 +66,73 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
             return;
         }
 
-        if (vecSessionCollaterals.empty()) {
+        // the same collateral (or any of its inputs) can't be used in two sessions at once
+        if (IsAnyInputUsed(dsa.txCollateral.vin)) {
+            LogPrint(BCLog::COINJOIN, "DSACCEPT -- collateral is already used in a session\n");
+            PushStatus(pfrom, STATUS_REJECTED, ERR_INVALID_COLLATERAL, connman);
+            return;
+        }
+
+        if (itSession == mapSessions.end()) {
+            const int nMaxSessions = std::min(std::max((int)gArgs.GetArg("-coinjoinserversessions", DEFAULT_COINJOIN_SERVER_SESSIONS), MIN_COINJOIN_SERVER_SESSIONS), MAX_COINJOIN_SERVER_SESSIONS);
+            if ((int)mapSessions.size() >= nMaxSessions) {
+                LogPrint(BCLog::COINJOIN, "DSACCEPT -- already running %d sessions\n", mapSessions.size());
+                PushStatus(pfrom, STATUS_REJECTED, ERR_QUEUE_FULL, connman);
+                return;
+            }
+
             {
                 TRY_LOCK(cs_vecqueue, lockRecv);
                 if (!lockRecv) return;
 
-                for (const auto& q : vecCoinJoinQueue) {
-                    if (q.masternodeOutpoint == activeMasternodeInfo.outpoint) {
-                        // refuse to create another queue this often
-                        LogPrint(BCLog::COINJOIN, "DSACCEPT -- last dsq is still in queue, refuse to mix\n");
-                        PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT, connman);
-                        return;
-                    }
+                if (coinJoinQueues.HasFromMasternode(activeMasternodeInfo.outpoint, dsa.nDenom)) {
+                    // refuse to create another queue this often
+                    LogPrint(BCLog::COINJOIN, "DSACCEPT -- last dsq is still in queue, refuse to mix\n");
+                    PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT, connman);
+                    return;
                 }
             }
 
-            int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
-            int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
-            if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
-                if (fLogIPs) {
-                    LogPrint(BCLog::COINJOIN, "DSACCEPT -- last dsq too recent, must wait: peer=%d, addr=%s\n", pfrom->GetId(), pfrom->addr.ToString());
-                } else {
-                    LogPrint(BCLog::COINJOIN, "DSACCEPT -- last dsq too recent, must wait: peer=%d\n", pfrom->GetId());
+            // the sessions running in parallel to the first one don't make us dominate the queuing process any more
+            // than the first one does, the rest of the network only relays as many of our queues as it allows
+            if (mapSessions.empty()) {
+                int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
+                int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
+                if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
+                    if (fLogIPs) {
+                        LogPrint(BCLog::COINJOIN, "DSACCEPT -- last dsq too recent, must wait: peer=%d, addr=%s\n", pfrom->GetId(), pfrom->addr.ToString());
+                    } else {
+                        LogPrint(BCLog::COINJOIN, "DSACCEPT -- last dsq too recent, must wait: peer=%d\n", pfrom->GetId());
+                    }
+                    PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT, connman);
+                    return;
                 }
-                PushStatus(pfrom, STATUS_REJECTED, ERR_RECENT, connman);
-                return;
             }
         }
 
         PoolMessage nMessageID = MSG_NOERR;
 
-        bool fResult = nSessionID == 0 ? CreateNewSession(dsa, nMessageID, connman)
-                                       : AddUserToExistingSession(dsa, nMessageID);
+        std::unique_ptr<CCoinJoinServerSession> newSession;
+        CCoinJoinServerSession* pSession;
+        bool fResult;
+        if (itSession == mapSessions.end()) {
+            newSession.reset(new CCoinJoinServerSession(*this));
+            pSession = newSession.get();
+            fResult = pSession->CreateNewSession(dsa, nMessageID, connman);
+            if (fResult) {
+                mapSessions.emplace(dsa.nDenom, std::move(newSession));
+            }
+        } else {
+            pSession = itSession->second.get();
+            fResult = pSession->AddUserToExistingSession(dsa, nMessageID);
+        }
         if (fResult) {
             LogPrint(BCLog::COINJOIN, "DSACCEPT -- is compatible, please submit!\n");
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
+            pSession->PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
             return;
         } else {
             LogPrint(BCLog::COINJOIN, "DSACCEPT -- not compatible with existing transactions!\n");
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
+            pSession->PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
             return;
         }
 
@@ -117,22 +150,8 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
         CCoinJoinQueue dsq;
         vRecv >> dsq;
 
-        {
-            TRY_LOCK(cs_vecqueue, lockRecv);
-            if (!lockRecv) return;
-
-            // process every dsq only once
-            for (const auto& q : vecCoinJoinQueue) {
-                if (q == dsq) {
-                    return;
-                }
-                if (q.fReady == dsq.fReady && q.masternodeOutpoint == dsq.masternodeOutpoint) {
-                    // no way the same mn can send another dsq with the same readiness this soon
-                    LogPrint(BCLog::COINJOIN, "DSQUEUE -- Peer %s is sending WAY too many dsq messages for a masternode with collateral %s\n", pfrom->GetLogString(), dsq.masternodeOutpoint.ToStringShort());
-                    return;
-                }
-            }
-        } // cs_vecqueue
+        // process every dsq only once
+        if (IsQueueKnown(dsq, pfrom)) return;
 
         LogPrint(BCLog::COINJOIN, "DSQUEUE -- %s new\n", dsq.ToString());
 
@@ -142,30 +161,9 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
         auto dmn = mnList.GetValidMNByCollateral(dsq.masternodeOutpoint);
         if (!dmn) return;
 
-        if (!dsq.CheckSignature(dmn->pdmnState->pubKeyOperator.Get())) {
-            LOCK(cs_main);
-            Misbehaving(pfrom->GetId(), 10);
-            return;
-        }
-
-        if (!dsq.fReady) {
-            int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
-            int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
-            LogPrint(BCLog::COINJOIN, "DSQUEUE -- nLastDsq: %d  nDsqThreshold: %d  nDsqCount: %d\n", nLastDsq, nDsqThreshold, mmetaman.GetDsqCount());
-            //don't allow a few nodes to dominate the queuing process
-            if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
-                LogPrint(BCLog::COINJOIN, "DSQUEUE -- Masternode %s is sending too many dsq messages\n", dmn->pdmnState->addr.ToString());
-                return;
-            }
-            mmetaman.AllowMixing(dmn->proTxHash);
-
-            LogPrint(BCLog::COINJOIN, "DSQUEUE -- new CoinJoin queue (%s) from masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
-
-            TRY_LOCK(cs_vecqueue, lockRecv);
-            if (!lockRecv) return;
-            vecCoinJoinQueue.push_back(dsq);
-            dsq.Relay(connman);
-        }
+        AsyncVerifyQueue(dsq, dmn->pdmnState->pubKeyOperator.Get(), pfrom->GetId(), [this, mnList, dmn, &connman](const CCoinJoinQueue& dsq) {
+            ProcessVerifiedQueue(dsq, mnList, dmn, connman);
+        });
 
     } else if (strCommand == NetMsgType::DSVIN) {
         if (pfrom->nVersion < MIN_COINJOIN_PEER_PROTO_VERSION) {
@@ -179,27 +177,47 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
             return;
         }
 
+        CCoinJoinEntry entry;
+        vRecv >> entry;
+
+        LOCK(cs_sessions);
+
+        // the client submits the collateral it joined the session with
+        CCoinJoinServerSession* pSession = GetSessionByCollateral(*entry.txCollateral);
+        if (!pSession && mapSessions.size() == 1) {
+            pSession = mapSessions.begin()->second.get();
+        }
+
         //do we have enough users in the current session?
-        if (!IsSessionReady()) {
+        if (!pSession || !pSession->IsSessionReady()) {
             LogPrint(BCLog::COINJOIN, "DSVIN -- session not complete!\n");
             PushStatus(pfrom, STATUS_REJECTED, ERR_SESSION, connman);
             return;
         }
 
-        CCoinJoinEntry entry;
-        vRecv >> entry;
-
         LogPrint(BCLog::COINJOIN, "DSVIN -- txCollateral %s", entry.txCollateral->ToString()); /* Continued */
 
         PoolMessage nMessageID = MSG_NOERR;
 
+        // inputs that are used in another session would make one of the final transactions fail
+        for (const auto& pair : mapSessions) {
+            if (pair.second.get() == pSession) continue;
+            for (const auto& txin : entry.vecTxDSIn) {
+                if (!pair.second->HasInput(txin.prevout)) continue;
+                LogPrint(BCLog::COINJOIN, "DSVIN -- input %s is already used in another session\n", txin.prevout.ToStringShort());
+                pSession->PushStatus(pfrom, STATUS_REJECTED, ERR_ALREADY_HAVE, connman);
+                return;
+            }
+        }
+
         entry.addr = pfrom->addr;
-        if (AddEntry(connman, entry, nMessageID)) {
-            PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
-            CheckPool(connman);
-            RelayStatus(STATUS_ACCEPTED, connman);
+        if (pSession->AddEntry(connman, entry, nMessageID)) {
+            pSession->PushStatus(pfrom, STATUS_ACCEPTED, nMessageID, connman);
+            pSession->CheckPool(connman);
+            pSession->RelayStatus(STATUS_ACCEPTED, connman);
+            RemoveFinishedSessions();
         } else {
-            PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
+            pSession->PushStatus(pfrom, STATUS_REJECTED, nMessageID, connman);
         }
 
     } else if (strCommand == NetMsgType::DSSIGNFINALTX) {
@@ -218,51 +236,83 @@ void CCoinJoinServer::ProcessMessage(CNode* pfrom, const std::string& strCommand
 
         LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- vecTxIn.size() %s\n", vecTxIn.size());
 
-        int nTxInIndex = 0;
-        int nTxInsCount = (int)vecTxIn.size();
+        if (vecTxIn.empty()) return;
 
-        for (const auto& txin : vecTxIn) {
-            nTxInIndex++;
-            if (!AddScriptSig(txin)) {
-                LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSig() failed at %d/%d, session: %d\n", nTxInIndex, nTxInsCount, nSessionID);
-                RelayStatus(STATUS_REJECTED, connman);
-                return;
-            }
-            LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSig() %d/%d success\n", nTxInIndex, nTxInsCount);
+        LOCK(cs_sessions);
+
+        // all inputs a client signs belong to the same session
+        CCoinJoinServerSession* pSession = GetSessionByInput(vecTxIn[0].prevout);
+        if (!pSession) {
+            LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- no session for input %s\n", vecTxIn[0].prevout.ToStringShort());
+            return;
         }
+
+        // the signatures of all inputs are verified at once, on the script check threads
+        if (!pSession->AddScriptSigs(vecTxIn)) {
+            LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSigs() failed for %d inputs\n", vecTxIn.size());
+            pSession->RelayStatus(STATUS_REJECTED, connman);
+            RemoveFinishedSessions();
+            return;
+        }
+        LogPrint(BCLog::COINJOIN, "DSSIGNFINALTX -- AddScriptSigs() %d inputs success\n", vecTxIn.size());
         // all is good
-        CheckPool(connman);
+        pSession->CheckPool(connman);
+        RemoveFinishedSessions();
     }
 }
 
-void CCoinJoinServer::SetNull()
+void CCoinJoinServer::ProcessVerifiedQueue(const CCoinJoinQueue& dsq, const CDeterministicMNList& mnList, const CDeterministicMNCPtr& dmn, CConnman& connman)
+{
+    // ready queues are only of interest to the clients mixing on the masternode
+    if (dsq.fReady) return;
+
+    int64_t nLastDsq = mmetaman.GetMetaInfo(dmn->proTxHash)->GetLastDsq();
+    int64_t nDsqThreshold = mmetaman.GetDsqThreshold(dmn->proTxHash, mnList.GetValidMNsCount());
+    LogPrint(BCLog::COINJOIN, "DSQUEUE -- nLastDsq: %d  nDsqThreshold: %d  nDsqCount: %d\n", nLastDsq, nDsqThreshold, mmetaman.GetDsqCount());
+    //don't allow a few nodes to dominate the queuing process
+    if (nLastDsq != 0 && nDsqThreshold > mmetaman.GetDsqCount()) {
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- Masternode %s is sending too many dsq messages\n", dmn->pdmnState->addr.ToString());
+        return;
+    }
+    mmetaman.AllowMixing(dmn->proTxHash);
+
+    LogPrint(BCLog::COINJOIN, "DSQUEUE -- new CoinJoin queue (%s) from masternode %s\n", dsq.ToString(), dmn->pdmnState->addr.ToString());
+
+    LOCK(cs_vecqueue);
+    // another peer's copy may have been verified in the meantime
+    if (coinJoinQueues.HasFromMasternode(dsq.masternodeOutpoint, dsq.nDenom, dsq.fReady)) return;
+    coinJoinQueues.Add(dsq);
+    dsq.Relay(connman);
+}
+
+void CCoinJoinServerSession::SetNull()
 {
     // MN side
     vecSessionCollaterals.clear();
 
+    server.RemoveOwnQueues(nSessionDenom);
     CCoinJoinBaseSession::SetNull();
-    CCoinJoinBaseManager::SetNull();
 }
 
 //
 // Check the mixing progress and send client updates if a Masternode
 //
-void CCoinJoinServer::CheckPool(CConnman& connman)
+void CCoinJoinServerSession::CheckPool(CConnman& connman)
 {
     if (!fMasternodeMode) return;
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CheckPool -- entries count %lu\n", GetEntriesCount());
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CheckPool -- entries count %lu\n", GetEntriesCount());
 
     // If we have an entry for each collateral, then create final tx
     if (nState == POOL_STATE_ACCEPTING_ENTRIES && GetEntriesCount() == vecSessionCollaterals.size()) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CheckPool -- FINALIZE TRANSACTIONS\n");
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CheckPool -- FINALIZE TRANSACTIONS\n");
         CreateFinalTransaction(connman);
         return;
     }
 
     // Check for Time Out
     // If we timed out while accepting entries, then if we have more than minimum, create final tx
-    if (nState == POOL_STATE_ACCEPTING_ENTRIES && CCoinJoinServer::HasTimedOut()
+    if (nState == POOL_STATE_ACCEPTING_ENTRIES && CCoinJoinServerSession::HasTimedOut()
             && GetEntriesCount() >= CCoinJoin::GetMinPoolParticipants()) {
         // Punish misbehaving participants
         ChargeFees(connman);
@@ -273,15 +323,15 @@ void CCoinJoinServer::CheckPool(CConnman& connman)
 
     // If we have all of the signatures, try to compile the transaction
     if (nState == POOL_STATE_SIGNING && IsSignaturesComplete()) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CheckPool -- SIGNING\n");
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CheckPool -- SIGNING\n");
         CommitFinalTransaction(connman);
         return;
     }
 }
 
-void CCoinJoinServer::CreateFinalTransaction(CConnman& connman)
+void CCoinJoinServerSession::CreateFinalTransaction(CConnman& connman)
 {
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CreateFinalTransaction -- FINALIZE TRANSACTIONS\n");
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CreateFinalTransaction -- FINALIZE TRANSACTIONS\n");
 
     CMutableTransaction txNew;
 
@@ -299,21 +349,21 @@ void CCoinJoinServer::CreateFinalTransaction(CConnman& connman)
     sort(txNew.vout.begin(), txNew.vout.end(), CompareOutputBIP69());
 
     finalMutableTransaction = txNew;
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CreateFinalTransaction -- finalMutableTransaction=%s", txNew.ToString()); /* Continued */
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CreateFinalTransaction -- finalMutableTransaction=%s", txNew.ToString()); /* Continued */
 
     // request signatures from clients
     SetState(POOL_STATE_SIGNING);
     RelayFinalTransaction(finalMutableTransaction, connman);
 }
 
-void CCoinJoinServer::CommitFinalTransaction(CConnman& connman)
+void CCoinJoinServerSession::CommitFinalTransaction(CConnman& connman)
 {
     if (!fMasternodeMode) return; // check and relay final tx only on masternode
 
     CTransactionRef finalTransaction = MakeTransactionRef(finalMutableTransaction);
     uint256 hashTx = finalTransaction->GetHash();
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CommitFinalTransaction -- finalTransaction=%s", finalTransaction->ToString()); /* Continued */
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CommitFinalTransaction -- finalTransaction=%s", finalTransaction->ToString()); /* Continued */
 
     {
         // See if the transaction is valid
@@ -321,7 +371,7 @@ void CCoinJoinServer::CommitFinalTransaction(CConnman& connman)
         CValidationState validationState;
         mempool.PrioritiseTransaction(hashTx, 0.1 * COIN);
         if (!lockMain || !AcceptToMemoryPool(mempool, validationState, finalTransaction, nullptr /* pfMissingInputs */, false /* bypass_limits */, maxTxFee /* nAbsurdFee */)) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CommitFinalTransaction -- AcceptToMemoryPool() error: Transaction not valid\n");
+            LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CommitFinalTransaction -- AcceptToMemoryPool() error: Transaction not valid\n");
             SetNull();
             // not much we can do in this case, just notify clients
             RelayCompletedTransaction(ERR_INVALID_TX, connman);
@@ -329,7 +379,7 @@ void CCoinJoinServer::CommitFinalTransaction(CConnman& connman)
         }
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CommitFinalTransaction -- CREATING DSTX\n");
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CommitFinalTransaction -- CREATING DSTX\n");
 
     // create and sign masternode dstx transaction
     if (!CCoinJoin::GetDSTX(hashTx)) {
@@ -338,7 +388,7 @@ void CCoinJoinServer::CommitFinalTransaction(CConnman& connman)
         CCoinJoin::AddDSTX(dstxNew);
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CommitFinalTransaction -- TRANSMITTING DSTX\n");
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CommitFinalTransaction -- TRANSMITTING DSTX\n");
 
     CInv inv(MSG_DSTX, hashTx);
     connman.RelayInv(inv);
@@ -350,7 +400,7 @@ void CCoinJoinServer::CommitFinalTransaction(CConnman& connman)
     ChargeRandomFees(connman);
 
     // Reset
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CommitFinalTransaction -- COMPLETED -- RESETTING\n");
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CommitFinalTransaction -- COMPLETED -- RESETTING\n");
     SetNull();
 }
 
@@ -366,7 +416,7 @@ void CCoinJoinServer::CommitFinalTransaction(CConnman& connman)
 // transaction for the client to be able to enter the pool. This transaction is kept by the Masternode
 // until the transaction is either complete or fails.
 //
-void CCoinJoinServer::ChargeFees(CConnman& connman)
+void CCoinJoinServerSession::ChargeFees(CConnman& connman)
 {
     if (!fMasternodeMode) return;
 
@@ -387,7 +437,7 @@ void CCoinJoinServer::ChargeFees(CConnman& connman)
 
             // This queue entry didn't send us the promised transaction
             if (!fFound) {
-                LogPrint(BCLog::COINJOIN, "CCoinJoinServer::ChargeFees -- found uncooperative node (didn't send transaction), found offence\n");
+                LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::ChargeFees -- found uncooperative node (didn't send transaction), found offence\n");
                 vecOffendersCollaterals.push_back(txCollateral);
             }
         }
@@ -398,7 +448,7 @@ void CCoinJoinServer::ChargeFees(CConnman& connman)
         for (const auto& entry : vecEntries) {
             for (const auto& txdsin : entry.vecTxDSIn) {
                 if (!txdsin.fHasSig) {
-                    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::ChargeFees -- found uncooperative node (didn't sign), found offence\n");
+                    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::ChargeFees -- found uncooperative node (didn't sign), found offence\n");
                     vecOffendersCollaterals.push_back(entry.txCollateral);
                 }
             }
@@ -418,7 +468,7 @@ void CCoinJoinServer::ChargeFees(CConnman& connman)
     Shuffle(vecOffendersCollaterals.begin(), vecOffendersCollaterals.end(), FastRandomContext());
 
     if (nState == POOL_STATE_ACCEPTING_ENTRIES || nState == POOL_STATE_SIGNING) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::ChargeFees -- found uncooperative node (didn't %s transaction), charging fees: %s", /* Continued */
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::ChargeFees -- found uncooperative node (didn't %s transaction), charging fees: %s", /* Continued */
             (nState == POOL_STATE_SIGNING) ? "sign" : "send", vecOffendersCollaterals[0]->ToString());
         ConsumeCollateral(connman, vecOffendersCollaterals[0]);
     }
@@ -436,18 +486,18 @@ void CCoinJoinServer::ChargeFees(CConnman& connman)
     stop these kinds of attacks 1 in 10 successful transactions are charged. This
     adds up to a cost of 0.001DRK per transaction on average.
 */
-void CCoinJoinServer::ChargeRandomFees(CConnman& connman)
+void CCoinJoinServerSession::ChargeRandomFees(CConnman& connman)
 {
     if (!fMasternodeMode) return;
 
     for (const auto& txCollateral : vecSessionCollaterals) {
         if (GetRandInt(100) > 10) return;
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::ChargeRandomFees -- charging random fees, txCollateral=%s", txCollateral->ToString()); /* Continued */
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::ChargeRandomFees -- charging random fees, txCollateral=%s", txCollateral->ToString()); /* Continued */
         ConsumeCollateral(connman, txCollateral);
     }
 }
 
-void CCoinJoinServer::ConsumeCollateral(CConnman& connman, const CTransactionRef& txref)
+void CCoinJoinServerSession::ConsumeCollateral(CConnman& connman, const CTransactionRef& txref)
 {
     LOCK(cs_main);
     CValidationState validationState;
@@ -459,7 +509,7 @@ void CCoinJoinServer::ConsumeCollateral(CConnman& connman, const CTransactionRef
     }
 }
 
-bool CCoinJoinServer::HasTimedOut()
+bool CCoinJoinServerSession::HasTimedOut()
 {
     if (!fMasternodeMode) return false;
 
@@ -473,16 +523,14 @@ bool CCoinJoinServer::HasTimedOut()
 //
 // Check for extraneous timeout
 //
-void CCoinJoinServer::CheckTimeout(CConnman& connman)
+void CCoinJoinServerSession::CheckTimeout(CConnman& connman)
 {
     if (!fMasternodeMode) return;
 
-    CheckQueue();
-
     // Too early to do anything
-    if (!CCoinJoinServer::HasTimedOut()) return;
+    if (!CCoinJoinServerSession::HasTimedOut()) return;
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CheckTimeout -- %s timed out -- resetting\n",
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CheckTimeout -- %s timed out -- resetting\n",
         (nState == POOL_STATE_SIGNING) ? "Signing" : "Session");
     ChargeFees(connman);
     SetNull();
@@ -493,7 +541,7 @@ void CCoinJoinServer::CheckTimeout(CConnman& connman)
     After receiving multiple dsa messages, the queue will switch to "accepting entries"
     which is the active state right before merging the transaction
 */
-void CCoinJoinServer::CheckForCompleteQueue(CConnman& connman)
+void CCoinJoinServerSession::CheckForCompleteQueue(CConnman& connman)
 {
     if (!fMasternodeMode) return;
 
@@ -501,77 +549,88 @@ void CCoinJoinServer::CheckForCompleteQueue(CConnman& connman)
         SetState(POOL_STATE_ACCEPTING_ENTRIES);
 
         CCoinJoinQueue dsq(nSessionDenom, activeMasternodeInfo.outpoint, GetAdjustedTime(), true);
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CheckForCompleteQueue -- queue is ready, signing and relaying (%s) " /* Continued */
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CheckForCompleteQueue -- queue is ready, signing and relaying (%s) " /* Continued */
                                      "with %d participants\n", dsq.ToString(), vecSessionCollaterals.size());
         dsq.Sign();
         dsq.Relay(connman);
     }
 }
 
-// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-bool CCoinJoinServer::IsInputScriptSigValid(const CTxIn& txin)
+// Check to make sure the given inputs match inputs in the pool and their scriptSigs are valid
+bool CCoinJoinServerSession::AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn)
 {
-    CMutableTransaction txNew;
-    txNew.vin.clear();
-    txNew.vout.clear();
-
-    int i = 0;
-    int nTxInIndex = -1;
-    CScript sigPubKey = CScript();
-
-    for (const auto& entry : vecEntries) {
-        for (const auto& txout : entry.vecTxOut) {
-            txNew.vout.push_back(txout);
-        }
-        for (const auto& txdsin : entry.vecTxDSIn) {
-            txNew.vin.push_back(txdsin);
-
-            if (txdsin.prevout == txin.prevout) {
+    // Verify against the final transaction which the clients sign and which is committed in the end. The scriptSig
+    // of an input is not committed to by the signatures of the others, so all of them can be checked at once.
+    CMutableTransaction txNew(finalMutableTransaction);
+    std::vector<std::pair<int, CScript>> vecInputs;
+
+    for (const auto& txin : vecTxIn) {
+        int nTxInIndex = -1;
+        for (int i = 0; i < (int)txNew.vin.size(); i++) {
+            if (txNew.vin[i].prevout == txin.prevout) {
                 nTxInIndex = i;
-                sigPubKey = txdsin.prevPubKey;
+                break;
+            }
+        }
+        CScript sigPubKey;
+        for (const auto& entry : vecEntries) {
+            for (const auto& txdsin : entry.vecTxDSIn) {
+                if (txdsin.prevout == txin.prevout) {
+                    sigPubKey = txdsin.prevPubKey;
+                }
             }
-            i++;
         }
+        if (nTxInIndex < 0 || sigPubKey.empty()) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AreInputScriptSigsValid -- Failed to find matching input in pool, %s\n", txin.ToString());
+            return false;
+        }
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AreInputScriptSigsValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
+        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
+        vecInputs.emplace_back(nTxInIndex, sigPubKey);
     }
 
-    if (nTxInIndex >= 0) { //might have to do this one input at a time?
-        txNew.vin[nTxInIndex].scriptSig = txin.scriptSig;
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- verifying scriptSig %s\n", ScriptToAsmStr(txin.scriptSig).substr(0, 24));
+    const CTransaction tx(txNew);
+    PrecomputedTransactionData txdata(tx);
+    std::vector<CScriptCheck> vChecks;
+    vChecks.reserve(vecInputs.size());
+    for (const auto& p : vecInputs) {
         // TODO we're using amount=0 here but we should use the correct amount. This works because Dash ignores the amount while signing/verifying (only used in Bitcoin/Segwit)
-        if (!VerifyScript(txNew.vin[nTxInIndex].scriptSig, sigPubKey, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, MutableTransactionSignatureChecker(&txNew, nTxInIndex, 0))) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- VerifyScript() failed on input %d\n", nTxInIndex);
-            return false;
-        }
-    } else {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- Failed to find matching input in pool, %s\n", txin.ToString());
+        // The signatures go into the signature cache, so they don't have to be verified again when the final
+        // transaction is accepted to the mempool
+        CScriptCheck check(CTxOut(0, p.second), tx, p.first, SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_STRICTENC, true, &txdata);
+        vChecks.emplace_back();
+        check.swap(vChecks.back());
+    }
+    if (!RunScriptChecks(vChecks)) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AreInputScriptSigsValid -- VerifyScript() failed on one of %d inputs\n", vecInputs.size());
         return false;
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::IsInputScriptSigValid -- Successfully validated input and scriptSig\n");
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AreInputScriptSigsValid -- Successfully validated %d inputs and scriptSigs\n", vecInputs.size());
     return true;
 }
 
 //
 // Add a client's transaction inputs/outputs to the pool
 //
-bool CCoinJoinServer::AddEntry(CConnman& connman, const CCoinJoinEntry& entry, PoolMessage& nMessageIDRet)
+bool CCoinJoinServerSession::AddEntry(CConnman& connman, const CCoinJoinEntry& entry, PoolMessage& nMessageIDRet)
 {
     if (!fMasternodeMode) return false;
 
     if (GetEntriesCount() >= vecSessionCollaterals.size()) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- ERROR: entries is full!\n", __func__);
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- ERROR: entries is full!\n", __func__);
         nMessageIDRet = ERR_ENTRIES_FULL;
         return false;
     }
 
     if (!CCoinJoin::IsCollateralValid(*entry.txCollateral)) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- ERROR: collateral not valid!\n", __func__);
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- ERROR: collateral not valid!\n", __func__);
         nMessageIDRet = ERR_INVALID_COLLATERAL;
         return false;
     }
 
     if (entry.vecTxDSIn.size() > COINJOIN_ENTRY_MAX_SIZE) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- ERROR: too many inputs! %d/%d\n", __func__, entry.vecTxDSIn.size(), COINJOIN_ENTRY_MAX_SIZE);
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- ERROR: too many inputs! %d/%d\n", __func__, entry.vecTxDSIn.size(), COINJOIN_ENTRY_MAX_SIZE);
         nMessageIDRet = ERR_MAXIMUM;
         ConsumeCollateral(connman, entry.txCollateral);
         return false;
@@ -579,12 +638,12 @@ bool CCoinJoinServer::AddEntry(CConnman& connman, const CCoinJoinEntry& entry, P
 
     std::vector<CTxIn> vin;
     for (const auto& txin : entry.vecTxDSIn) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- txin=%s\n", __func__, txin.ToString());
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- txin=%s\n", __func__, txin.ToString());
 
         for (const auto& entry : vecEntries) {
             for (const auto& txdsin : entry.vecTxDSIn) {
                 if (txdsin.prevout == txin.prevout) {
-                    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- ERROR: already have this txin in entries\n", __func__);
+                    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- ERROR: already have this txin in entries\n", __func__);
                     nMessageIDRet = ERR_ALREADY_HAVE;
                     // Two peers sent the same input? Can't really say who is the malicious one here,
                     // could be that someone is picking someone else's inputs randomly trying to force
@@ -598,7 +657,7 @@ bool CCoinJoinServer::AddEntry(CConnman& connman, const CCoinJoinEntry& entry, P
 
     bool fConsumeCollateral{false};
     if (!IsValidInOuts(vin, entry.vecTxOut, nMessageIDRet, &fConsumeCollateral)) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- ERROR! IsValidInOuts() failed: %s\n", __func__, CCoinJoin::GetMessageByID(nMessageIDRet));
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- ERROR! IsValidInOuts() failed: %s\n", __func__, CCoinJoin::GetMessageByID(nMessageIDRet));
         if (fConsumeCollateral) {
             ConsumeCollateral(connman, entry.txCollateral);
         }
@@ -607,51 +666,67 @@ bool CCoinJoinServer::AddEntry(CConnman& connman, const CCoinJoinEntry& entry, P
 
     vecEntries.push_back(entry);
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- adding entry %d of %d required\n", __func__, GetEntriesCount(), CCoinJoin::GetMaxPoolParticipants());
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- adding entry %d of %d required\n", __func__, GetEntriesCount(), CCoinJoin::GetMaxPoolParticipants());
     nMessageIDRet = MSG_ENTRIES_ADDED;
 
     return true;
 }
 
-bool CCoinJoinServer::AddScriptSig(const CTxIn& txinNew)
+bool CCoinJoinServerSession::AddScriptSigs(const std::vector<CTxIn>& vecTxIn)
 {
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+    for (size_t i = 0; i < vecTxIn.size(); i++) {
+        const CTxIn& txinNew = vecTxIn[i];
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddScriptSigs -- scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
-    for (const auto& entry : vecEntries) {
-        for (const auto& txdsin : entry.vecTxDSIn) {
-            if (txdsin.scriptSig == txinNew.scriptSig) {
-                LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- already exists\n");
+        for (const auto& entry : vecEntries) {
+            for (const auto& txdsin : entry.vecTxDSIn) {
+                if (txdsin.scriptSig == txinNew.scriptSig) {
+                    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddScriptSigs -- already exists\n");
+                    return false;
+                }
+            }
+        }
+        for (size_t j = 0; j < i; j++) {
+            if (vecTxIn[j].scriptSig == txinNew.scriptSig || vecTxIn[j].prevout == txinNew.prevout) {
+                LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddScriptSigs -- duplicate input\n");
                 return false;
             }
         }
     }
 
-    if (!IsInputScriptSigValid(txinNew)) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- Invalid scriptSig\n");
+    if (!AreInputScriptSigsValid(vecTxIn)) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddScriptSigs -- Invalid scriptSig\n");
         return false;
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+    for (const auto& txinNew : vecTxIn) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddScriptSigs -- scriptSig=%s new\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
 
-    for (auto& txin : finalMutableTransaction.vin) {
-        if (txin.prevout == txinNew.prevout && txin.nSequence == txinNew.nSequence) {
-            txin.scriptSig = txinNew.scriptSig;
-            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- adding to finalMutableTransaction, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+        for (auto& txin : finalMutableTransaction.vin) {
+            if (txin.prevout == txinNew.prevout && txin.nSequence == txinNew.nSequence) {
+                txin.scriptSig = txinNew.scriptSig;
+                LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddScriptSigs -- adding to finalMutableTransaction, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+            }
         }
-    }
-    for (int i = 0; i < GetEntriesCount(); i++) {
-        if (vecEntries[i].AddScriptSig(txinNew)) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- adding to entries, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
-            return true;
+        bool fAdded = false;
+        for (int i = 0; i < GetEntriesCount(); i++) {
+            if (vecEntries[i].AddScriptSig(txinNew)) {
+                LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddScriptSigs -- adding to entries, scriptSig=%s\n", ScriptToAsmStr(txinNew.scriptSig).substr(0, 24));
+                fAdded = true;
+                break;
+            }
+        }
+        if (!fAdded) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddScriptSigs -- Couldn't set sig!\n");
+            return false;
         }
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddScriptSig -- Couldn't set sig!\n");
-    return false;
+    return true;
 }
 
 // Check to make sure everything is signed
-bool CCoinJoinServer::IsSignaturesComplete()
+bool CCoinJoinServerSession::IsSignaturesComplete()
 {
     for (const auto& entry : vecEntries) {
         for (const auto& txdsin : entry.vecTxDSIn) {
@@ -662,20 +737,43 @@ bool CCoinJoinServer::IsSignaturesComplete()
     return true;
 }
 
-bool CCoinJoinServer::IsAcceptableDSA(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet)
+bool CCoinJoinServerSession::HasCollateral(const CTransaction& txCollateral) const
+{
+    for (const auto& txref : vecSessionCollaterals) {
+        if (*txref == txCollateral) return true;
+    }
+    return false;
+}
+
+bool CCoinJoinServerSession::HasInput(const COutPoint& outpoint) const
+{
+    for (const auto& txref : vecSessionCollaterals) {
+        for (const auto& txin : txref->vin) {
+            if (txin.prevout == outpoint) return true;
+        }
+    }
+    for (const auto& entry : vecEntries) {
+        for (const auto& txdsin : entry.vecTxDSIn) {
+            if (txdsin.prevout == outpoint) return true;
+        }
+    }
+    return false;
+}
+
+bool CCoinJoinServerSession::IsAcceptableDSA(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet)
 {
     if (!fMasternodeMode) return false;
 
     // is denom even something legit?
     if (!CCoinJoin::IsValidDenomination(dsa.nDenom)) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- denom not valid!\n", __func__);
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- denom not valid!\n", __func__);
         nMessageIDRet = ERR_DENOM;
         return false;
     }
 
     // check collateral
-    if (!fUnitTest && !CCoinJoin::IsCollateralValid(dsa.txCollateral)) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- collateral not valid!\n", __func__);
+    if (!server.fUnitTest && !CCoinJoin::IsCollateralValid(dsa.txCollateral)) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- collateral not valid!\n", __func__);
         nMessageIDRet = ERR_INVALID_COLLATERAL;
         return false;
     }
@@ -683,14 +781,14 @@ bool CCoinJoinServer::IsAcceptableDSA(const CCoinJoinAccept& dsa, PoolMessage& n
     return true;
 }
 
-bool CCoinJoinServer::CreateNewSession(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet, CConnman& connman)
+bool CCoinJoinServerSession::CreateNewSession(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet, CConnman& connman)
 {
     if (!fMasternodeMode || nSessionID != 0) return false;
 
     // new session can only be started in idle mode
     if (nState != POOL_STATE_IDLE) {
         nMessageIDRet = ERR_MODE;
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CreateNewSession -- incompatible mode: nState=%d\n", nState);
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CreateNewSession -- incompatible mode: nState=%d\n", nState);
         return false;
     }
 
@@ -705,23 +803,23 @@ bool CCoinJoinServer::CreateNewSession(const CCoinJoinAccept& dsa, PoolMessage&
 
     SetState(POOL_STATE_QUEUE);
 
-    if (!fUnitTest) {
+    if (!server.fUnitTest) {
         //broadcast that I'm accepting entries, only if it's the first entry through
         CCoinJoinQueue dsq(nSessionDenom, activeMasternodeInfo.outpoint, GetAdjustedTime(), false);
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CreateNewSession -- signing and relaying new queue: %s\n", dsq.ToString());
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CreateNewSession -- signing and relaying new queue: %s\n", dsq.ToString());
         dsq.Sign();
         dsq.Relay(connman);
-        vecCoinJoinQueue.push_back(dsq);
+        server.AddOwnQueue(dsq);
     }
 
     vecSessionCollaterals.push_back(MakeTransactionRef(dsa.txCollateral));
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::CreateNewSession -- new session created, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d  CCoinJoin::GetMaxPoolParticipants(): %d\n",
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::CreateNewSession -- new session created, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d  CCoinJoin::GetMaxPoolParticipants(): %d\n",
         nSessionID, nSessionDenom, CCoinJoin::DenominationToString(nSessionDenom), vecSessionCollaterals.size(), CCoinJoin::GetMaxPoolParticipants());
 
     return true;
 }
 
-bool CCoinJoinServer::AddUserToExistingSession(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet)
+bool CCoinJoinServerSession::AddUserToExistingSession(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet)
 {
     if (!fMasternodeMode || nSessionID == 0 || IsSessionReady()) return false;
 
@@ -732,12 +830,12 @@ bool CCoinJoinServer::AddUserToExistingSession(const CCoinJoinAccept& dsa, PoolM
     // we only add new users to an existing session when we are in queue mode
     if (nState != POOL_STATE_QUEUE) {
         nMessageIDRet = ERR_MODE;
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddUserToExistingSession -- incompatible mode: nState=%d\n", nState);
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddUserToExistingSession -- incompatible mode: nState=%d\n", nState);
         return false;
     }
 
     if (dsa.nDenom != nSessionDenom) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddUserToExistingSession -- incompatible denom %d (%s) != nSessionDenom %d (%s)\n",
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddUserToExistingSession -- incompatible denom %d (%s) != nSessionDenom %d (%s)\n",
             dsa.nDenom, CCoinJoin::DenominationToString(dsa.nDenom), nSessionDenom, CCoinJoin::DenominationToString(nSessionDenom));
         nMessageIDRet = ERR_DENOM;
         return false;
@@ -748,20 +846,20 @@ bool CCoinJoinServer::AddUserToExistingSession(const CCoinJoinAccept& dsa, PoolM
     nMessageIDRet = MSG_NOERR;
     vecSessionCollaterals.push_back(MakeTransactionRef(dsa.txCollateral));
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::AddUserToExistingSession -- new user accepted, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d  CCoinJoin::GetMaxPoolParticipants(): %d\n",
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::AddUserToExistingSession -- new user accepted, nSessionID: %d  nSessionDenom: %d (%s)  vecSessionCollaterals.size(): %d  CCoinJoin::GetMaxPoolParticipants(): %d\n",
         nSessionID, nSessionDenom, CCoinJoin::DenominationToString(nSessionDenom), vecSessionCollaterals.size(), CCoinJoin::GetMaxPoolParticipants());
 
     return true;
 }
 
 // Returns true if either max size has been reached or if the mix timed out and min size was reached
-bool CCoinJoinServer::IsSessionReady()
+bool CCoinJoinServerSession::IsSessionReady()
 {
     if (nState == POOL_STATE_QUEUE) {
         if ((int)vecSessionCollaterals.size() >= CCoinJoin::GetMaxPoolParticipants()) {
             return true;
         }
-        if (CCoinJoinServer::HasTimedOut() && (int)vecSessionCollaterals.size() >= CCoinJoin::GetMinPoolParticipants()) {
+        if (CCoinJoinServerSession::HasTimedOut() && (int)vecSessionCollaterals.size() >= CCoinJoin::GetMinPoolParticipants()) {
             return true;
         }
     }
@@ -771,9 +869,9 @@ bool CCoinJoinServer::IsSessionReady()
     return false;
 }
 
-void CCoinJoinServer::RelayFinalTransaction(const CTransaction& txFinal, CConnman& connman)
+void CCoinJoinServerSession::RelayFinalTransaction(const CTransaction& txFinal, CConnman& connman)
 {
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
         __func__, nSessionID, nSessionDenom, CCoinJoin::DenominationToString(nSessionDenom));
 
     // final mixing tx with empty signatures should be relayed to mixing participants only
@@ -791,14 +889,14 @@ void CCoinJoinServer::RelayFinalTransaction(const CTransaction& txFinal, CConnma
     }
 }
 
-void CCoinJoinServer::PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman)
+void CCoinJoinServerSession::PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman)
 {
     if (!pnode) return;
     CCoinJoinStatusUpdate psssup(nSessionID, nState, 0, nStatusUpdate, nMessageID);
     connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::DSSTATUSUPDATE, psssup));
 }
 
-void CCoinJoinServer::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID)
+void CCoinJoinServerSession::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID)
 {
     unsigned int nDisconnected{};
     // status updates should be relayed to mixing participants only
@@ -816,7 +914,7 @@ void CCoinJoinServer::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& conn
     if (nDisconnected == 0) return; // all is clear
 
     // something went wrong
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- can't continue, %llu client(s) disconnected, nSessionID: %d  nSessionDenom: %d (%s)\n",
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- can't continue, %llu client(s) disconnected, nSessionID: %d  nSessionDenom: %d (%s)\n",
         __func__, nDisconnected, nSessionID, nSessionDenom, CCoinJoin::DenominationToString(nSessionDenom));
 
     // notify everyone else that this session should be terminated
@@ -834,9 +932,9 @@ void CCoinJoinServer::RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& conn
     }
 }
 
-void CCoinJoinServer::RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman)
+void CCoinJoinServerSession::RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman)
 {
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::%s -- nSessionID: %d  nSessionDenom: %d (%s)\n",
         __func__, nSessionID, nSessionDenom, CCoinJoin::DenominationToString(nSessionDenom));
 
     // final mixing tx with empty signatures should be relayed to mixing participants only
@@ -854,20 +952,127 @@ void CCoinJoinServer::RelayCompletedTransaction(PoolMessage nMessageID, CConnman
     }
 }
 
-void CCoinJoinServer::SetState(PoolState nStateNew)
+void CCoinJoinServerSession::SetState(PoolState nStateNew)
 {
     if (!fMasternodeMode) return;
 
     if (nStateNew == POOL_STATE_ERROR) {
-        LogPrint(BCLog::COINJOIN, "CCoinJoinServer::SetState -- Can't set state to ERROR as a Masternode. \n");
+        LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::SetState -- Can't set state to ERROR as a Masternode. \n");
         return;
     }
 
-    LogPrint(BCLog::COINJOIN, "CCoinJoinServer::SetState -- nState: %d, nStateNew: %d\n", nState, nStateNew);
+    LogPrint(BCLog::COINJOIN, "CCoinJoinServerSession::SetState -- nState: %d, nStateNew: %d\n", nState, nStateNew);
     nTimeLastSuccessfulStep = GetTime();
     nState = nStateNew;
 }
 
+void CCoinJoinServerSession::GetJsonInfo(UniValue& obj) const
+{
+    obj.clear();
+    obj.setObject();
+    obj.pushKV("denomination",  ValueFromAmount(CCoinJoin::DenominationToAmount(nSessionDenom)));
+    obj.pushKV("state",         GetStateString());
+    obj.pushKV("entries_count", GetEntriesCount());
+}
+
+CCoinJoinServerSession* CCoinJoinServer::GetSessionByCollateral(const CTransaction& txCollateral)
+{
+    AssertLockHeld(cs_sessions);
+    for (const auto& pair : mapSessions) {
+        if (pair.second->HasCollateral(txCollateral)) {
+            return pair.second.get();
+        }
+    }
+    return nullptr;
+}
+
+CCoinJoinServerSession* CCoinJoinServer::GetSessionByInput(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_sessions);
+    for (const auto& pair : mapSessions) {
+        if (pair.second->HasInput(outpoint)) {
+            return pair.second.get();
+        }
+    }
+    return nullptr;
+}
+
+bool CCoinJoinServer::IsAnyInputUsed(const std::vector<CTxIn>& vin) const
+{
+    AssertLockHeld(cs_sessions);
+    for (const auto& pair : mapSessions) {
+        for (const auto& txin : vin) {
+            if (pair.second->HasInput(txin.prevout)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void CCoinJoinServer::AddOwnQueue(const CCoinJoinQueue& dsq)
+{
+    LOCK(cs_vecqueue);
+    coinJoinQueues.Add(dsq);
+}
+
+void CCoinJoinServer::RemoveOwnQueues(int nDenom)
+{
+    // Allow a new session of this denomination right away, the queues of other masternodes and of our other
+    // sessions stay
+    LOCK(cs_vecqueue);
+    coinJoinQueues.RemoveFromMasternode(activeMasternodeInfo.outpoint, nDenom);
+}
+
+void CCoinJoinServer::RemoveFinishedSessions()
+{
+    AssertLockHeld(cs_sessions);
+    for (auto it = mapSessions.begin(); it != mapSessions.end(); ) {
+        if (it->second->IsFinished()) {
+            it = mapSessions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CCoinJoinServer::PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman)
+{
+    if (!pnode) return;
+    CCoinJoinStatusUpdate psssup(0, POOL_STATE_IDLE, 0, nStatusUpdate, nMessageID);
+    connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::DSSTATUSUPDATE, psssup));
+}
+
+void CCoinJoinServer::CheckTimeout(CConnman& connman)
+{
+    if (!fMasternodeMode) return;
+
+    CheckQueue();
+
+    LOCK(cs_sessions);
+    for (const auto& pair : mapSessions) {
+        pair.second->CheckTimeout(connman);
+    }
+    RemoveFinishedSessions();
+}
+
+void CCoinJoinServer::CheckForCompleteQueue(CConnman& connman)
+{
+    LOCK(cs_sessions);
+    for (const auto& pair : mapSessions) {
+        pair.second->CheckForCompleteQueue(connman);
+    }
+}
+
+void CCoinJoinServer::CheckPool(CConnman& connman)
+{
+    LOCK(cs_sessions);
+    for (const auto& pair : mapSessions) {
+        pair.second->CheckPool(connman);
+    }
+    RemoveFinishedSessions();
+}
+
 void CCoinJoinServer::DoMaintenance(CConnman& connman)
 {
     if (!fMasternodeMode) return; // only run on masternodes
@@ -881,10 +1086,25 @@ void CCoinJoinServer::DoMaintenance(CConnman& connman)
 
 void CCoinJoinServer::GetJsonInfo(UniValue& obj) const
 {
+    LOCK(cs_sessions);
+
+    UniValue sessions(UniValue::VARR);
+    for (const auto& pair : mapSessions) {
+        UniValue session;
+        pair.second->GetJsonInfo(session);
+        sessions.push_back(session);
+    }
+
     obj.clear();
     obj.setObject();
     obj.pushKV("queue_size",    GetQueueSize());
-    obj.pushKV("denomination",  ValueFromAmount(CCoinJoin::DenominationToAmount(nSessionDenom)));
-    obj.pushKV("state",         GetStateString());
-    obj.pushKV("entries_count", GetEntriesCount());
+    // The first session, kept for compatibility with the time the server could only run one
+    if (mapSessions.empty()) {
+        obj.pushKV("denomination",  ValueFromAmount(CCoinJoin::DenominationToAmount(0)));
+        obj.pushKV("state",         "IDLE");
+        obj.pushKV("entries_count", 0);
+    } else {
+        obj.pushKVs(sessions[0]);
+    }
+    obj.pushKV("sessions",      sessions);
 }
@@ -6,76 +6,135 @@
 #define BITCOIN_COINJOIN_COINJOIN_SERVER_H
 
 #include <coinjoin/coinjoin.h>
+#include <evo/deterministicmns.h>
 #include <net.h>
 
+#include <map>
+#include <memory>
+
 class CCoinJoinServer;
 class UniValue;
 
 // The main object for accessing mixing
 extern CCoinJoinServer coinJoinServer;
 
-/** Used to keep track of current status of mixing pool
+/** Default for -coinjoinserversessions, the number of mixing sessions (of different denominations) a masternode runs at once */
+static const int DEFAULT_COINJOIN_SERVER_SESSIONS = 4;
+static const int MIN_COINJOIN_SERVER_SESSIONS = 1;
+static const int MAX_COINJOIN_SERVER_SESSIONS = 5;
+
+/** Used to keep track of current status of a mixing session of one denomination
  */
-class CCoinJoinServer : public CCoinJoinBaseSession, public CCoinJoinBaseManager
+class CCoinJoinServerSession : public CCoinJoinBaseSession
 {
 private:
+    CCoinJoinServer& server;
+
     // Mixing uses collateral transactions to trust parties entering the pool
     // to behave honestly. If they don't it takes their money.
     std::vector<CTransactionRef> vecSessionCollaterals;
 
-    bool fUnitTest;
-
-    /// Add a clients entry to the pool
-    bool AddEntry(CConnman& connman, const CCoinJoinEntry& entry, PoolMessage& nMessageIDRet);
-    /// Add signature to a txin
-    bool AddScriptSig(const CTxIn& txin);
-
     /// Charge fees to bad actors (Charge clients a fee if they're abusive)
     void ChargeFees(CConnman& connman);
     /// Rarely charge fees to pay miners
     void ChargeRandomFees(CConnman& connman);
-    /// Consume collateral in cases when peer misbehaved
-    void ConsumeCollateral(CConnman& connman, const CTransactionRef& txref);
-
-    /// Check for process
-    void CheckPool(CConnman& connman);
 
     void CreateFinalTransaction(CConnman& connman);
     void CommitFinalTransaction(CConnman& connman);
 
     /// Is this nDenom and txCollateral acceptable?
     bool IsAcceptableDSA(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet);
-    bool CreateNewSession(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet, CConnman& connman);
-    bool AddUserToExistingSession(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet);
-    /// Do we have enough users to take entries?
-    bool IsSessionReady();
 
     /// Check that all inputs are signed. (Are all inputs signed?)
     bool IsSignaturesComplete();
-    /// Check to make sure a given input matches an input in the pool and its scriptSig is valid
-    bool IsInputScriptSigValid(const CTxIn& txin);
+    /// Check to make sure the given inputs match inputs in the pool and their scriptSigs are valid
+    bool AreInputScriptSigsValid(const std::vector<CTxIn>& vecTxIn);
 
     // Set the 'state' value, with some logging and capturing when the state changed
     void SetState(PoolState nStateNew);
 
     /// Relay mixing Messages
     void RelayFinalTransaction(const CTransaction& txFinal, CConnman& connman);
-    void PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman);
-    void RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID = MSG_NOERR);
     void RelayCompletedTransaction(PoolMessage nMessageID, CConnman& connman);
 
     void SetNull();
 
+public:
+    explicit CCoinJoinServerSession(CCoinJoinServer& serverIn) :
+        server(serverIn),
+        vecSessionCollaterals() {}
+
+    /// Consume collateral in cases when peer misbehaved
+    static void ConsumeCollateral(CConnman& connman, const CTransactionRef& txref);
+
+    bool CreateNewSession(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet, CConnman& connman);
+    bool AddUserToExistingSession(const CCoinJoinAccept& dsa, PoolMessage& nMessageIDRet);
+    /// Do we have enough users to take entries?
+    bool IsSessionReady();
+    /// Whether the session was reset after it completed or failed
+    bool IsFinished() const { return nState == POOL_STATE_IDLE; }
+
+    /// Add a clients entry to the pool
+    bool AddEntry(CConnman& connman, const CCoinJoinEntry& entry, PoolMessage& nMessageIDRet);
+    /// Add signatures to txins, none of them are added if one is invalid
+    bool AddScriptSigs(const std::vector<CTxIn>& vecTxIn);
+
+    /// Whether a participant of this session entered it with this collateral
+    bool HasCollateral(const CTransaction& txCollateral) const;
+    /// Whether an outpoint is spent by a collateral or an entry of this session
+    bool HasInput(const COutPoint& outpoint) const;
+
+    /// Check for process
+    void CheckPool(CConnman& connman);
+
+    bool HasTimedOut();
+    void CheckTimeout(CConnman& connman);
+    void CheckForCompleteQueue(CConnman& connman);
+
+    void PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman);
+    void RelayStatus(PoolStatusUpdate nStatusUpdate, CConnman& connman, PoolMessage nMessageID = MSG_NOERR);
+
+    void GetJsonInfo(UniValue& obj) const;
+};
+
+/** Runs up to -coinjoinserversessions mixing sessions in parallel, one per denomination. Clients are matched to their
+ *  session by the denomination they ask for, their collateral and the inputs they sign.
+ */
+class CCoinJoinServer : public CCoinJoinBaseManager
+{
+private:
+    friend class CCoinJoinServerSession;
+
+    mutable CCriticalSection cs_sessions;
+    // The sessions in progress, by denomination
+    std::map<int, std::unique_ptr<CCoinJoinServerSession>> mapSessions;
+
+    bool fUnitTest;
+
+    CCoinJoinServerSession* GetSessionByCollateral(const CTransaction& txCollateral);
+    CCoinJoinServerSession* GetSessionByInput(const COutPoint& outpoint);
+    /// Whether any of the sessions already uses one of the inputs
+    bool IsAnyInputUsed(const std::vector<CTxIn>& vin) const;
+
+    /// Add our own queue, or remove our queues of a denomination once its session is over
+    void AddOwnQueue(const CCoinJoinQueue& dsq);
+    void RemoveOwnQueues(int nDenom);
+    void RemoveFinishedSessions();
+
+    /// The part of DSQUEUE processing which happens once the signature of dsq was verified
+    void ProcessVerifiedQueue(const CCoinJoinQueue& dsq, const CDeterministicMNList& mnList, const CDeterministicMNCPtr& dmn, CConnman& connman);
+
+    static void PushStatus(CNode* pnode, PoolStatusUpdate nStatusUpdate, PoolMessage nMessageID, CConnman& connman);
+
 public:
     CCoinJoinServer() :
-        vecSessionCollaterals(),
         fUnitTest(false) {}
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
 
-    bool HasTimedOut();
     void CheckTimeout(CConnman& connman);
     void CheckForCompleteQueue(CConnman& connman);
+    void CheckPool(CConnman& connman);
 
     void DoMaintenance(CConnman& connman);
 
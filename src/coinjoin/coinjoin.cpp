@@ -5,6 +5,7 @@
 #include <coinjoin/coinjoin.h>
 
 #include <core_io.h>
+#include <core_memusage.h>
 #include <consensus/validation.h>
 #include <messagesigner.h>
 #include <netmessagemaker.h>
@@ -14,11 +15,17 @@
 #include <utilmoneystr.h>
 #include <validation.h>
 
+#include <init.h>
+#include <net_processing.h>
+
+#include <bls/bls_worker.h>
+
 #include <masternode/activemasternode.h>
 #include <masternode/masternode-sync.h>
 
 #include <llmq/quorums_instantsend.h>
 #include <llmq/quorums_chainlocks.h>
+#include <llmq/quorums_init.h>
 
 #include <string>
 
@@ -68,7 +75,7 @@ bool CCoinJoinQueue::CheckSignature(const CBLSPublicKey& blsPubKey) const
     return true;
 }
 
-bool CCoinJoinQueue::Relay(CConnman& connman)
+bool CCoinJoinQueue::Relay(CConnman& connman) const
 {
     connman.ForEachNode([&connman, this](CNode* pnode) {
         CNetMsgMaker msgMaker(pnode->GetSendVersion());
@@ -118,7 +125,7 @@ bool CCoinJoinBroadcastTx::IsExpired(const CBlockIndex* pindex) const
 {
     // expire confirmed DSTXes after ~1h since confirmation or chainlocked confirmation
     if (nConfirmedHeight == -1 || pindex->nHeight < nConfirmedHeight) return false; // not mined yet
-    if (pindex->nHeight - nConfirmedHeight > 24) return true; // mined more then an hour ago
+    if (pindex->nHeight - nConfirmedHeight > COINJOIN_DSTX_EXPIRY_BLOCKS) return true; // mined more then an hour ago
     return llmq::chainLocksHandler->HasChainLock(pindex->nHeight, *pindex->phashBlock);
 }
 
@@ -158,10 +165,77 @@ void CCoinJoinBaseSession::SetNull()
     nTimeLastSuccessfulStep = GetTime();
 }
 
+bool CCoinJoinQueueSet::Add(const CCoinJoinQueue& dsq)
+{
+    return queues.push_back({dsq, dsq.GetSignatureHash()}).second;
+}
+
+bool CCoinJoinQueueSet::HasFromMasternode(const COutPoint& outpoint, int nDenom) const
+{
+    auto range = queues.get<2>().equal_range(outpoint.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->dsq.masternodeOutpoint == outpoint && it->dsq.nDenom == nDenom) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CCoinJoinQueueSet::HasFromMasternode(const COutPoint& outpoint, int nDenom, bool fReady) const
+{
+    auto range = queues.get<2>().equal_range(outpoint.hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->dsq.masternodeOutpoint == outpoint && it->dsq.nDenom == nDenom && it->dsq.fReady == fReady) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CCoinJoinQueueSet::RemoveFromMasternode(const COutPoint& outpoint, int nDenom)
+{
+    auto& index = queues.get<2>();
+    auto range = index.equal_range(outpoint.hash);
+    for (auto it = range.first; it != range.second; ) {
+        if (it->dsq.masternodeOutpoint == outpoint && it->dsq.nDenom == nDenom) {
+            it = index.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void CCoinJoinQueueSet::RemoveExpired(int64_t nNow)
+{
+    auto& index = queues.get<3>();
+    // the queues which are too old are at the front of the time index, the ones too far into the future at its back
+    while (!index.empty() && nNow - index.begin()->dsq.nTime > COINJOIN_QUEUE_TIMEOUT) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinQueueSet::%s -- Removing a queue (%s)\n", __func__, index.begin()->dsq.ToString());
+        index.erase(index.begin());
+    }
+    while (!index.empty() && std::prev(index.end())->dsq.nTime - nNow > COINJOIN_QUEUE_TIMEOUT) {
+        LogPrint(BCLog::COINJOIN, "CCoinJoinQueueSet::%s -- Removing a queue (%s)\n", __func__, std::prev(index.end())->dsq.ToString());
+        index.erase(std::prev(index.end()));
+    }
+}
+
+bool CCoinJoinQueueSet::TryNext(CCoinJoinQueue& dsqRet)
+{
+    for (auto it = queues.begin(); it != queues.end(); ++it) {
+        // only try each queue once
+        if (it->dsq.fTried || it->dsq.IsTimeOutOfBounds()) continue;
+        queues.modify(it, [](Entry& e) { e.dsq.fTried = true; });
+        dsqRet = it->dsq;
+        return true;
+    }
+    return false;
+}
+
 void CCoinJoinBaseManager::SetNull()
 {
     LOCK(cs_vecqueue);
-    vecCoinJoinQueue.clear();
+    coinJoinQueues.clear();
+    setPendingQueues.clear();
 }
 
 void CCoinJoinBaseManager::CheckQueue()
@@ -170,15 +244,7 @@ void CCoinJoinBaseManager::CheckQueue()
     if (!lockDS) return; // it's ok to fail here, we run this quite frequently
 
     // check mixing queue objects for timeouts
-    auto it = vecCoinJoinQueue.begin();
-    while (it != vecCoinJoinQueue.end()) {
-        if ((*it).IsTimeOutOfBounds()) {
-            LogPrint(BCLog::COINJOIN, "CCoinJoinBaseManager::%s -- Removing a queue (%s)\n", __func__, (*it).ToString());
-            it = vecCoinJoinQueue.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    coinJoinQueues.RemoveExpired(GetAdjustedTime());
 }
 
 bool CCoinJoinBaseManager::GetQueueItemAndTry(CCoinJoinQueue& dsqRet)
@@ -186,17 +252,55 @@ bool CCoinJoinBaseManager::GetQueueItemAndTry(CCoinJoinQueue& dsqRet)
     TRY_LOCK(cs_vecqueue, lockDS);
     if (!lockDS) return false; // it's ok to fail here, we run this quite frequently
 
-    for (auto& dsq : vecCoinJoinQueue) {
-        // only try each queue once
-        if (dsq.fTried || dsq.IsTimeOutOfBounds()) continue;
-        dsq.fTried = true;
-        dsqRet = dsq;
+    return coinJoinQueues.TryNext(dsqRet);
+}
+
+bool CCoinJoinBaseManager::IsQueueKnown(const CCoinJoinQueue& dsq, const CNode* pfrom)
+{
+    TRY_LOCK(cs_vecqueue, lockRecv);
+    if (!lockRecv) return true;
+
+    uint256 hash = dsq.GetSignatureHash();
+    if (coinJoinQueues.Has(hash) || setPendingQueues.count(hash)) {
+        return true;
+    }
+    if (coinJoinQueues.HasFromMasternode(dsq.masternodeOutpoint, dsq.nDenom, dsq.fReady)) {
+        // no way the same mn can send another dsq with the same readiness and denomination this soon
+        LogPrint(BCLog::COINJOIN, "DSQUEUE -- Peer %s is sending WAY too many dsq messages for a masternode with collateral %s\n", pfrom->GetLogString(), dsq.masternodeOutpoint.ToStringShort());
         return true;
     }
-
     return false;
 }
 
+void CCoinJoinBaseManager::AsyncVerifyQueue(const CCoinJoinQueue& dsq, const CBLSPublicKey& pubKey, NodeId nodeId, std::function<void(const CCoinJoinQueue&)> onValid)
+{
+    uint256 hash = dsq.GetSignatureHash();
+    auto onDone = [this, dsq, hash, nodeId, onValid](bool fValid) {
+        {
+            LOCK(cs_vecqueue);
+            setPendingQueues.erase(hash);
+        }
+        if (!fValid) {
+            LogPrint(BCLog::COINJOIN, "CCoinJoinBaseManager::AsyncVerifyQueue -- invalid signature for dsq (%s) from peer=%d\n", dsq.ToString(), nodeId);
+            LOCK(cs_main);
+            Misbehaving(nodeId, 10);
+            return;
+        }
+        onValid(dsq);
+    };
+
+    if (!llmq::blsWorker) {
+        onDone(dsq.CheckSignature(pubKey));
+        return;
+    }
+
+    {
+        LOCK(cs_vecqueue);
+        setPendingQueues.emplace(hash);
+    }
+    llmq::blsWorker->AsyncVerifySig(CBLSSignature(dsq.vchSig), pubKey, hash, onDone, [] { return ShutdownRequested(); });
+}
+
 std::string CCoinJoinBaseSession::GetStateString() const
 {
     switch (nState) {
@@ -303,7 +407,8 @@ bool CCoinJoinBaseSession::IsValidInOuts(const std::vector<CTxIn>& vin, const st
 
 // Definitions for static data members
 std::vector<CAmount> CCoinJoin::vecStandardDenominations;
-std::map<uint256, CCoinJoinBroadcastTx> CCoinJoin::mapDSTX;
+std::unordered_map<uint256, CCoinJoinBroadcastTx, StaticSaltedHasher> CCoinJoin::mapDSTX;
+std::set<std::pair<int, uint256>> CCoinJoin::setDSTXByConfirmedHeight;
 CCriticalSection CCoinJoin::cs_mapdstx;
 
 void CCoinJoin::InitStandardDenominations()
@@ -524,7 +629,10 @@ std::string CCoinJoin::GetMessageByID(PoolMessage nMessageID)
 void CCoinJoin::AddDSTX(const CCoinJoinBroadcastTx& dstx)
 {
     LOCK(cs_mapdstx);
-    mapDSTX.insert(std::make_pair(dstx.tx->GetHash(), dstx));
+    auto res = mapDSTX.emplace(dstx.tx->GetHash(), dstx);
+    if (res.second && dstx.GetConfirmedHeight() != -1) {
+        setDSTXByConfirmedHeight.emplace(dstx.GetConfirmedHeight(), res.first->first);
+    }
 }
 
 CCoinJoinBroadcastTx CCoinJoin::GetDSTX(const uint256& hash)
@@ -534,16 +642,39 @@ CCoinJoinBroadcastTx CCoinJoin::GetDSTX(const uint256& hash)
     return (it == mapDSTX.end()) ? CCoinJoinBroadcastTx() : it->second;
 }
 
+void CCoinJoin::GetDSTXTransactions(std::vector<std::pair<uint256, CTransactionRef>>& vtx)
+{
+    LOCK(cs_mapdstx);
+    vtx.reserve(vtx.size() + mapDSTX.size());
+    for (const auto& pair : mapDSTX) {
+        vtx.emplace_back(pair.first, pair.second.tx);
+    }
+}
+
+size_t CCoinJoin::DynamicMemoryUsage()
+{
+    LOCK(cs_mapdstx);
+    size_t ret = memusage::DynamicUsage(mapDSTX) + memusage::DynamicUsage(setDSTXByConfirmedHeight);
+    for (const auto& pair : mapDSTX) {
+        ret += RecursiveDynamicUsage(pair.second.tx) + memusage::DynamicUsage(pair.second.vchSig);
+    }
+    return ret;
+}
+
 void CCoinJoin::CheckDSTXes(const CBlockIndex* pindex)
 {
+    // Same as calling CCoinJoinBroadcastTx::IsExpired for every DSTX: a chainlock on pindex covers all confirmations
+    // up to its height, otherwise only the ones older than COINJOIN_DSTX_EXPIRY_BLOCKS expire
+    int nExpireHeight = pindex->nHeight - COINJOIN_DSTX_EXPIRY_BLOCKS - 1;
+    if (llmq::chainLocksHandler->HasChainLock(pindex->nHeight, *pindex->phashBlock)) {
+        nExpireHeight = pindex->nHeight;
+    }
+
     LOCK(cs_mapdstx);
-    auto it = mapDSTX.begin();
-    while (it != mapDSTX.end()) {
-        if (it->second.IsExpired(pindex)) {
-            mapDSTX.erase(it++);
-        } else {
-            ++it;
-        }
+    auto it = setDSTXByConfirmedHeight.begin();
+    while (it != setDSTXByConfirmedHeight.end() && it->first <= nExpireHeight) {
+        mapDSTX.erase(it->second);
+        it = setDSTXByConfirmedHeight.erase(it);
     }
     LogPrint(BCLog::COINJOIN, "CCoinJoin::CheckDSTXes -- mapDSTX.size()=%llu\n", mapDSTX.size());
 }
@@ -571,7 +702,13 @@ void CCoinJoin::UpdateDSTXConfirmedHeight(const CTransactionRef& tx, int nHeight
         return;
     }
 
+    if (it->second.GetConfirmedHeight() != -1) {
+        setDSTXByConfirmedHeight.erase(std::make_pair(it->second.GetConfirmedHeight(), it->first));
+    }
     it->second.SetConfirmedHeight(nHeight);
+    if (nHeight != -1) {
+        setDSTXByConfirmedHeight.emplace(nHeight, it->first);
+    }
     LogPrint(BCLog::COINJOIN, "CCoinJoin::%s -- txid=%s, nHeight=%d\n", __func__, tx->GetHash().ToString(), nHeight);
 }
 
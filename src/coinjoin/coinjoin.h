@@ -10,13 +10,25 @@
 #include <chainparams.h>
 #include <primitives/transaction.h>
 #include <pubkey.h>
+#include <saltedhasher.h>
 #include <sync.h>
 #include <spork.h>
 #include <timedata.h>
 #include <tinyformat.h>
 
+#include <functional>
+#include <unordered_set>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
 class CCoinJoin;
 class CConnman;
+class CNode;
+
+typedef int64_t NodeId;
 
 // timeouts
 static const int COINJOIN_AUTO_TIMEOUT_MIN = 5;
@@ -26,6 +38,9 @@ static const int COINJOIN_SIGNING_TIMEOUT = 15;
 
 static const size_t COINJOIN_ENTRY_MAX_SIZE = 9;
 
+// confirmed DSTXes are forgotten this many blocks after their confirmation (or earlier once it's chainlocked)
+static const int COINJOIN_DSTX_EXPIRY_BLOCKS = 24;
+
 // pool responses
 enum PoolMessage : int32_t {
     ERR_ALREADY_HAVE,
@@ -269,7 +284,7 @@ public:
     /// Check if we have a valid Masternode address
     bool CheckSignature(const CBLSPublicKey& blsPubKey) const;
 
-    bool Relay(CConnman& connman);
+    bool Relay(CConnman& connman) const;
 
     /// Check if a queue is too old or too far into the future
     bool IsTimeOutOfBounds() const;
@@ -351,6 +366,7 @@ public:
     bool CheckSignature(const CBLSPublicKey& blsPubKey) const;
 
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
+    int GetConfirmedHeight() const { return nConfirmedHeight; }
     bool IsExpired(const CBlockIndex* pindex) const;
     bool IsValidStructure();
 };
@@ -393,6 +409,61 @@ public:
     int GetEntriesCount() const { return vecEntries.size(); }
 };
 
+/**
+ * The known queues, in the order they arrived, indexed by their hash for duplicate checks, by masternode for the
+ * per-masternode rate limits and by time for expiring them
+ */
+class CCoinJoinQueueSet
+{
+private:
+    struct Entry {
+        CCoinJoinQueue dsq;
+        uint256 hash;
+    };
+    struct ByHash {
+        typedef uint256 result_type;
+        const uint256& operator()(const Entry& e) const { return e.hash; }
+    };
+    /** Collateral txid of the masternode, its outputs are distinguished when looking up by masternode */
+    struct ByMasternode {
+        typedef uint256 result_type;
+        const uint256& operator()(const Entry& e) const { return e.dsq.masternodeOutpoint.hash; }
+    };
+    struct ByTime {
+        typedef int64_t result_type;
+        int64_t operator()(const Entry& e) const { return e.dsq.nTime; }
+    };
+
+    typedef boost::multi_index_container<
+        Entry,
+        boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>,
+            boost::multi_index::hashed_unique<ByHash, StaticSaltedHasher>,
+            boost::multi_index::hashed_non_unique<ByMasternode, StaticSaltedHasher>,
+            boost::multi_index::ordered_non_unique<ByTime>
+        >
+    > queue_set_t;
+
+    queue_set_t queues;
+
+public:
+    /** Returns false if the queue is already known */
+    bool Add(const CCoinJoinQueue& dsq);
+    bool Has(const uint256& hash) const { return queues.get<1>().count(hash) != 0; }
+    /** Whether there is a queue of the masternode for nDenom */
+    bool HasFromMasternode(const COutPoint& outpoint, int nDenom) const;
+    /** Whether there is a queue of the masternode for nDenom with the given readiness */
+    bool HasFromMasternode(const COutPoint& outpoint, int nDenom, bool fReady) const;
+    void RemoveFromMasternode(const COutPoint& outpoint, int nDenom);
+    /** Remove the queues which are out of bounds of COINJOIN_QUEUE_TIMEOUT around nNow */
+    void RemoveExpired(int64_t nNow);
+    /** Mark the oldest untried queue which isn't out of bounds as tried and return it */
+    bool TryNext(CCoinJoinQueue& dsqRet);
+
+    size_t size() const { return queues.size(); }
+    void clear() { queues.clear(); }
+};
+
 // base class
 class CCoinJoinBaseManager
 {
@@ -400,16 +471,29 @@ protected:
     mutable CCriticalSection cs_vecqueue;
 
     // The current mixing sessions in progress on the network
-    std::vector<CCoinJoinQueue> vecCoinJoinQueue;
+    CCoinJoinQueueSet coinJoinQueues GUARDED_BY(cs_vecqueue);
+    /// Hashes of the received queues which are waiting for their signature to be verified
+    std::unordered_set<uint256, StaticSaltedHasher> setPendingQueues GUARDED_BY(cs_vecqueue);
 
     void SetNull();
     void CheckQueue();
 
+    /** Whether a received dsq was seen already, is waiting for verification, or its masternode sent one for the
+     *  same denomination and readiness too recently. Also true if cs_vecqueue is busy, so the dsq is dropped */
+    bool IsQueueKnown(const CCoinJoinQueue& dsq, const CNode* pfrom);
+
+    /**
+     * Verify the signature of a received dsq against pubKey on the BLS worker, in a batch with the other signature
+     * checks waiting there, so that floods of dsq don't keep the message handler busy with pairings. onValid is
+     * called with the queue from the worker thread if the signature is correct. Peers sending invalid signatures
+     * are punished.
+     */
+    void AsyncVerifyQueue(const CCoinJoinQueue& dsq, const CBLSPublicKey& pubKey, NodeId nodeId, std::function<void(const CCoinJoinQueue&)> onValid);
+
 public:
-    CCoinJoinBaseManager() :
-        vecCoinJoinQueue() {}
+    CCoinJoinBaseManager() = default;
 
-    int GetQueueSize() const { return vecCoinJoinQueue.size(); }
+    int GetQueueSize() const { LOCK(cs_vecqueue); return coinJoinQueues.size(); }
     bool GetQueueItemAndTry(CCoinJoinQueue& dsqRet);
 };
 
@@ -425,7 +509,9 @@ private:
 
     // static members
     static std::vector<CAmount> vecStandardDenominations;
-    static std::map<uint256, CCoinJoinBroadcastTx> mapDSTX;
+    static std::unordered_map<uint256, CCoinJoinBroadcastTx, StaticSaltedHasher> mapDSTX;
+    // <nConfirmedHeight, txid> of all confirmed DSTXes, so that expiring them doesn't need to scan mapDSTX
+    static std::set<std::pair<int, uint256>> setDSTXByConfirmedHeight;
 
     static CCriticalSection cs_mapdstx;
 
@@ -460,6 +546,10 @@ public:
 
     static void AddDSTX(const CCoinJoinBroadcastTx& dstx);
     static CCoinJoinBroadcastTx GetDSTX(const uint256& hash);
+    /// Append all known DSTX transactions in <hash, reference> form
+    static void GetDSTXTransactions(std::vector<std::pair<uint256, CTransactionRef>>& vtx);
+    /// The memory used by the known DSTX, including their transactions even when the mempool holds them as well
+    static size_t DynamicMemoryUsage();
 
     static void UpdatedBlockTip(const CBlockIndex* pindex);
     static void NotifyChainLock(const CBlockIndex* pindex);
@@ -6,6 +6,9 @@
 
 #include <consensus/consensus.h>
 #include <random.h>
+#include <utiltrace.h>
+
+#include <thread>
 
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
@@ -31,27 +34,141 @@ size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) :
+    CCoinsViewBacked(baseIn),
+    cacheCoins(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &cacheCoinsMemoryResource),
+    cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
 }
 
+uint64_t CCoinsPrefetchCache::GetGeneration() const
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return generation;
+}
+
+void CCoinsPrefetchCache::Add(std::vector<std::pair<COutPoint, Coin>>&& vCoins, uint64_t nGeneration)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    if (nGeneration != generation) {
+        // The database was written to while these were read
+        return;
+    }
+    for (auto& p : vCoins) {
+        if (coins.size() >= maxSize) {
+            break;
+        }
+        coins.emplace(p.first, std::move(p.second));
+    }
+}
+
+bool CCoinsPrefetchCache::Take(const COutPoint& outpoint, Coin& coin)
+{
+    std::lock_guard<std::mutex> lock(cs);
+    auto it = coins.find(outpoint);
+    if (it == coins.end()) {
+        return false;
+    }
+    coin = std::move(it->second);
+    coins.erase(it);
+    return true;
+}
+
+void CCoinsPrefetchCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(cs);
+    coins.clear();
+    generation++;
+}
+
+size_t CCoinsPrefetchCache::Size() const
+{
+    std::lock_guard<std::mutex> lock(cs);
+    return coins.size();
+}
+
+CCoinsMap::iterator CCoinsViewCache::InsertFetchedCoin(const COutPoint &outpoint, Coin&& coin) const {
+    CCoinsMap::iterator ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin))).first;
+    if (ret->second.coin.IsSpent()) {
+        // The parent only has an empty entry for this outpoint; we can consider our
+        // version as fresh.
+        ret->second.flags = CCoinsCacheEntry::FRESH;
+    }
+    cachedCoinsUsage += ret->second.coin.DynamicMemoryUsage();
+    return ret;
+}
+
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
     if (it != cacheCoins.end())
         return it;
     Coin tmp;
+    if (prefetchCache && prefetchCache->Take(outpoint, tmp))
+        return InsertFetchedCoin(outpoint, std::move(tmp));
     if (!base->GetCoin(outpoint, tmp))
         return cacheCoins.end();
-    CCoinsMap::iterator ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(tmp))).first;
-    if (ret->second.coin.IsSpent()) {
-        // The parent only has an empty entry for this outpoint; we can consider our
-        // version as fresh.
-        ret->second.flags = CCoinsCacheEntry::FRESH;
+    return InsertFetchedCoin(outpoint, std::move(tmp));
+}
+
+size_t CCoinsViewCache::PrefetchCoins(const std::vector<COutPoint>& outpoints, int nThreads) const {
+    std::vector<COutPoint> missing;
+    missing.reserve(outpoints.size());
+    size_t nAdded = 0;
+    for (const COutPoint& outpoint : outpoints) {
+        if (cacheCoins.count(outpoint)) {
+            continue;
+        }
+        Coin coin;
+        if (prefetchCache && prefetchCache->Take(outpoint, coin)) {
+            InsertFetchedCoin(outpoint, std::move(coin));
+            nAdded++;
+        } else {
+            missing.push_back(outpoint);
+        }
     }
-    cachedCoinsUsage += ret->second.coin.DynamicMemoryUsage();
-    return ret;
+    if (missing.empty()) {
+        return nAdded;
+    }
+
+    // Don't bother spinning up threads for a handful of lookups
+    static const size_t MIN_PREFETCH_PER_THREAD = 16;
+    size_t nShards = std::max<size_t>(1, std::min<size_t>(std::max(nThreads, 1), missing.size() / MIN_PREFETCH_PER_THREAD));
+
+    std::vector<std::vector<size_t>> shards(nShards);
+    const SaltedOutpointHasher& hasher = cacheCoins.hash_function();
+    for (size_t i = 0; i < missing.size(); i++) {
+        shards[hasher(missing[i]) % nShards].push_back(i);
+    }
+
+    std::vector<Coin> coins(missing.size());
+    std::vector<char> found(missing.size(), 0);
+    auto fetchShard = [&](size_t shard) {
+        for (size_t i : shards[shard]) {
+            found[i] = base->GetCoin(missing[i], coins[i]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(nShards - 1);
+    for (size_t shard = 1; shard < nShards; shard++) {
+        threads.emplace_back(fetchShard, shard);
+    }
+    fetchShard(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < missing.size(); i++) {
+        // skip duplicate outpoints in the input
+        if (!found[i] || cacheCoins.count(missing[i])) {
+            continue;
+        }
+        InsertFetchedCoin(missing[i], std::move(coins[i]));
+        nAdded++;
+    }
+    return nAdded;
 }
 
 bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
@@ -201,9 +318,14 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 }
 
 bool CCoinsViewCache::Flush() {
+    TRACE2(utxocache, flush_start, cacheCoins.size(), cachedCoinsUsage);
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
-    cacheCoins.clear();
-    cachedCoinsUsage = 0;
+    TRACE1(utxocache, flush_done, fOk);
+    ReallocateCache();
+    if (prefetchCache) {
+        // The base view changed, anything read ahead from it may be outdated now
+        prefetchCache->Clear();
+    }
     return fOk;
 }
 
@@ -216,6 +338,16 @@ void CCoinsViewCache::Uncache(const COutPoint& hash)
     }
 }
 
+void CCoinsViewCache::ReallocateCache()
+{
+    // Destroy the map before the resource its nodes are allocated from
+    cacheCoins.~CCoinsMap();
+    cacheCoinsMemoryResource.~CCoinsMapMemoryResource();
+    ::new (&cacheCoinsMemoryResource) CCoinsMapMemoryResource();
+    ::new (&cacheCoins) CCoinsMap(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &cacheCoinsMemoryResource);
+    cachedCoinsUsage = 0;
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const {
     return cacheCoins.size();
 }
@@ -12,11 +12,13 @@
 #include <hash.h>
 #include <memusage.h>
 #include <serialize.h>
+#include <support/allocators/pool.h>
 #include <uint256.h>
 
 #include <assert.h>
 #include <stdint.h>
 
+#include <mutex>
 #include <unordered_map>
 
 /**
@@ -119,7 +121,16 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The nodes of CCoinsMap are allocated from a pool resource which is owned by the cache and released
+ * as a whole when the cache is flushed. The block size leaves room for the node overhead of the
+ * standard library (next pointer and cached hash) on top of the value.
+ */
+typedef PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                      sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>
+    CCoinsMapAllocator;
+typedef CCoinsMapAllocator::ResourceType CCoinsMapMemoryResource;
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -197,6 +208,32 @@ public:
 };
 
 
+/**
+ * Thread-safe side cache of unspent coins that were read ahead of time from the database backing
+ * a CCoinsViewCache. Entries mirror the database state at the time they were read, so the cache must
+ * be cleared whenever that database is written to. Readers tag results with the generation they
+ * started at and results of an outdated generation are dropped.
+ */
+class CCoinsPrefetchCache
+{
+private:
+    mutable std::mutex cs;
+    std::unordered_map<COutPoint, Coin, SaltedOutpointHasher> coins;
+    uint64_t generation{0};
+    const size_t maxSize;
+
+public:
+    explicit CCoinsPrefetchCache(size_t _maxSize) : maxSize(_maxSize) {}
+
+    uint64_t GetGeneration() const;
+    //! Add coins read from the database at the given generation, unless the cache was cleared since
+    void Add(std::vector<std::pair<COutPoint, Coin>>&& vCoins, uint64_t nGeneration);
+    //! Remove a coin from the cache and return it
+    bool Take(const COutPoint& outpoint, Coin& coin);
+    void Clear();
+    size_t Size() const;
+};
+
 /** CCoinsView that adds a memory cache for transactions to another CCoinsView */
 class CCoinsViewCache : public CCoinsViewBacked
 {
@@ -206,11 +243,16 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    /* Backs the nodes of cacheCoins, must be declared before it. */
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource{};
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /* Optional read-ahead cache of the base view, consulted before base on cache misses. */
+    CCoinsPrefetchCache* prefetchCache{nullptr};
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
 
@@ -293,8 +335,32 @@ public:
     //! Check whether all prevouts of the transaction are present in the UTXO set represented by this view
     bool HaveInputs(const CTransaction& tx) const;
 
+    /**
+     * Pull the given outpoints into this cache ahead of time. Outpoints that are not cached yet are
+     * partitioned into nThreads shards by their salted hash and the shards are looked up in the base
+     * view concurrently, then added to the cache. The base view's GetCoin must be safe to call from
+     * multiple threads at once (as it is for CCoinsViewDB), this cache itself is only modified by the
+     * calling thread.
+     *
+     * @return the number of coins that were added to the cache
+     */
+    size_t PrefetchCoins(const std::vector<COutPoint>& outpoints, int nThreads) const;
+
+    /**
+     * Attach a read-ahead cache of the base view (or detach it by passing nullptr). It is cleared
+     * every time this cache is flushed into the base view.
+     */
+    void SetPrefetchCache(CCoinsPrefetchCache* cache) { prefetchCache = cache; }
+
 private:
     CCoinsMap::iterator FetchCoin(const COutPoint &outpoint) const;
+    CCoinsMap::iterator InsertFetchedCoin(const COutPoint &outpoint, Coin&& coin) const;
+
+    /**
+     * Drop cacheCoins together with its memory resource and start over with empty ones, handing all
+     * the chunks back to the system at once. cacheCoins must not contain anything worth keeping.
+     */
+    void ReallocateCache();
 };
 
 //! Utility function to add all of a transaction's outputs to a cache.
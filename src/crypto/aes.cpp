@@ -4,6 +4,7 @@
 
 #include <crypto/aes.h>
 #include <crypto/common.h>
+#include <crypto/cpuid.h>
 
 #include <assert.h>
 #include <string.h>
@@ -12,64 +13,162 @@ extern "C" {
 #include <crypto/ctaes/ctaes.c>
 }
 
-AES128Encrypt::AES128Encrypt(const unsigned char key[16])
+namespace aes_aesni
 {
-    AES128_init(&ctx, key);
+void Init128(const unsigned char key[16], unsigned char enc[11 * 16], unsigned char dec[11 * 16]);
+void Init256(const unsigned char key[32], unsigned char enc[15 * 16], unsigned char dec[15 * 16]);
+void Encrypt128(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks);
+void Decrypt128(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks);
+void Encrypt256(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks);
+void Decrypt256(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks);
+}
+
+namespace
+{
+/** Expand key into the encryption round keys enc and, unless dec is nullptr, the decryption round keys dec */
+typedef void (*InitFn)(const unsigned char* key, unsigned char* enc, unsigned char* dec);
+/** Encrypt or decrypt blocks independent blocks with the round keys rk */
+typedef void (*BlocksFn)(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks);
+
+InitFn Init128 = nullptr;
+InitFn Init256 = nullptr;
+BlocksFn Encrypt128 = nullptr;
+BlocksFn Decrypt128 = nullptr;
+BlocksFn Encrypt256 = nullptr;
+BlocksFn Decrypt256 = nullptr;
+} // namespace
+
+std::string AESAutoDetect()
+{
+    std::string ret = "ctaes";
+#if defined(HAVE_CRYPTO_CPUID)
+    crypto_cpuid::Features features = crypto_cpuid::Detect();
+    (void)features;
+
+#if defined(ENABLE_AESNI) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (features.have_aesni) {
+        Init128 = aes_aesni::Init128;
+        Init256 = aes_aesni::Init256;
+        Encrypt128 = aes_aesni::Encrypt128;
+        Decrypt128 = aes_aesni::Decrypt128;
+        Encrypt256 = aes_aesni::Encrypt256;
+        Decrypt256 = aes_aesni::Decrypt256;
+        ret = "aesni";
+    }
+#endif
+#endif
+
+    return ret;
+}
+
+AES128Encrypt::AES128Encrypt(const unsigned char key[16]) : hw(Init128 != nullptr)
+{
+    if (hw) {
+        Init128(key, rk, nullptr);
+    } else {
+        AES128_init(&ctx, key);
+    }
 }
 
 AES128Encrypt::~AES128Encrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES128Encrypt::Encrypt(unsigned char ciphertext[16], const unsigned char plaintext[16]) const
 {
-    AES128_encrypt(&ctx, 1, ciphertext, plaintext);
+    if (hw) {
+        Encrypt128(rk, ciphertext, plaintext, 1);
+    } else {
+        AES128_encrypt(&ctx, 1, ciphertext, plaintext);
+    }
 }
 
-AES128Decrypt::AES128Decrypt(const unsigned char key[16])
+AES128Decrypt::AES128Decrypt(const unsigned char key[16]) : hw(Init128 != nullptr)
 {
-    AES128_init(&ctx, key);
+    if (hw) {
+        unsigned char enc[sizeof(rk)];
+        Init128(key, enc, rk);
+        memset(enc, 0, sizeof(enc));
+    } else {
+        AES128_init(&ctx, key);
+    }
 }
 
 AES128Decrypt::~AES128Decrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES128Decrypt::Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const
 {
-    AES128_decrypt(&ctx, 1, plaintext, ciphertext);
+    Decrypt(plaintext, ciphertext, 1);
 }
 
-AES256Encrypt::AES256Encrypt(const unsigned char key[32])
+void AES128Decrypt::Decrypt(unsigned char* plaintext, const unsigned char* ciphertext, size_t blocks) const
 {
-    AES256_init(&ctx, key);
+    if (hw) {
+        Decrypt128(rk, plaintext, ciphertext, blocks);
+    } else {
+        AES128_decrypt(&ctx, blocks, plaintext, ciphertext);
+    }
+}
+
+AES256Encrypt::AES256Encrypt(const unsigned char key[32]) : hw(Init256 != nullptr)
+{
+    if (hw) {
+        Init256(key, rk, nullptr);
+    } else {
+        AES256_init(&ctx, key);
+    }
 }
 
 AES256Encrypt::~AES256Encrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES256Encrypt::Encrypt(unsigned char ciphertext[16], const unsigned char plaintext[16]) const
 {
-    AES256_encrypt(&ctx, 1, ciphertext, plaintext);
+    if (hw) {
+        Encrypt256(rk, ciphertext, plaintext, 1);
+    } else {
+        AES256_encrypt(&ctx, 1, ciphertext, plaintext);
+    }
 }
 
-AES256Decrypt::AES256Decrypt(const unsigned char key[32])
+AES256Decrypt::AES256Decrypt(const unsigned char key[32]) : hw(Init256 != nullptr)
 {
-    AES256_init(&ctx, key);
+    if (hw) {
+        unsigned char enc[sizeof(rk)];
+        Init256(key, enc, rk);
+        memset(enc, 0, sizeof(enc));
+    } else {
+        AES256_init(&ctx, key);
+    }
 }
 
 AES256Decrypt::~AES256Decrypt()
 {
     memset(&ctx, 0, sizeof(ctx));
+    memset(rk, 0, sizeof(rk));
 }
 
 void AES256Decrypt::Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const
 {
-    AES256_decrypt(&ctx, 1, plaintext, ciphertext);
+    Decrypt(plaintext, ciphertext, 1);
+}
+
+void AES256Decrypt::Decrypt(unsigned char* plaintext, const unsigned char* ciphertext, size_t blocks) const
+{
+    if (hw) {
+        Decrypt256(rk, plaintext, ciphertext, blocks);
+    } else {
+        AES256_decrypt(&ctx, blocks, plaintext, ciphertext);
+    }
 }
 
 
@@ -122,9 +221,10 @@ static int CBCDecrypt(const T& dec, const unsigned char iv[AES_BLOCKSIZE], const
     if (size % AES_BLOCKSIZE != 0)
         return 0;
 
-    // Decrypt all data. Padding will be checked in the output.
+    // Decrypt all data at once, the blocks are independent before the chaining is undone. Padding will be checked
+    // in the output.
+    dec.Decrypt(out, data, size / AES_BLOCKSIZE);
     while (written != size) {
-        dec.Decrypt(out, data + written);
         for (int i = 0; i != AES_BLOCKSIZE; i++)
             *out++ ^= prev[i];
         prev = data + written;
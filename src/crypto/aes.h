@@ -11,6 +11,9 @@ extern "C" {
 #include <crypto/ctaes/ctaes.h>
 }
 
+#include <stddef.h>
+#include <string>
+
 static const int AES_BLOCKSIZE = 16;
 static const int AES128_KEYSIZE = 16;
 static const int AES256_KEYSIZE = 32;
@@ -20,6 +23,9 @@ class AES128Encrypt
 {
 private:
     AES128_ctx ctx;
+    /** The round keys of the AES-NI implementation, used instead of ctx when it was detected */
+    unsigned char rk[11 * 16];
+    bool hw;
 
 public:
     explicit AES128Encrypt(const unsigned char key[16]);
@@ -32,11 +38,15 @@ class AES128Decrypt
 {
 private:
     AES128_ctx ctx;
+    unsigned char rk[11 * 16];
+    bool hw;
 
 public:
     explicit AES128Decrypt(const unsigned char key[16]);
     ~AES128Decrypt();
     void Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const;
+    /** Decrypt blocks independent blocks */
+    void Decrypt(unsigned char* plaintext, const unsigned char* ciphertext, size_t blocks) const;
 };
 
 /** An encryption class for AES-256. */
@@ -44,6 +54,8 @@ class AES256Encrypt
 {
 private:
     AES256_ctx ctx;
+    unsigned char rk[15 * 16];
+    bool hw;
 
 public:
     explicit AES256Encrypt(const unsigned char key[32]);
@@ -56,11 +68,15 @@ class AES256Decrypt
 {
 private:
     AES256_ctx ctx;
+    unsigned char rk[15 * 16];
+    bool hw;
 
 public:
     explicit AES256Decrypt(const unsigned char key[32]);
     ~AES256Decrypt();
     void Decrypt(unsigned char plaintext[16], const unsigned char ciphertext[16]) const;
+    /** Decrypt blocks independent blocks */
+    void Decrypt(unsigned char* plaintext, const unsigned char* ciphertext, size_t blocks) const;
 };
 
 class AES256CBCEncrypt
@@ -115,4 +131,9 @@ private:
     unsigned char iv[AES_BLOCKSIZE];
 };
 
+/** Autodetect whether the AES-NI implementation can be used instead of ctaes.
+ *  Returns the name of the implementation.
+ */
+std::string AESAutoDetect();
+
 #endif // BITCOIN_CRYPTO_AES_H
@@ -0,0 +1,172 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Based on the key expansion in Intel's "Advanced Encryption Standard (AES) New Instructions Set" white paper.
+
+#ifdef ENABLE_AESNI
+
+#include <stddef.h>
+#include <stdint.h>
+#include <wmmintrin.h>
+
+namespace aes_aesni {
+namespace {
+
+__m128i inline Load(const unsigned char* p) { return _mm_loadu_si128((const __m128i*)p); }
+void inline Store(unsigned char* p, __m128i x) { _mm_storeu_si128((__m128i*)p, x); }
+
+/** Xor each word of the previous round key with all the words below it, as the key schedule chains them */
+__m128i inline ShiftXor(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+    x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+    return _mm_xor_si128(x, _mm_slli_si128(x, 4));
+}
+
+template<int rcon>
+__m128i inline ExpandEven(__m128i prev, __m128i last)
+{
+    return _mm_xor_si128(ShiftXor(prev), _mm_shuffle_epi32(_mm_aeskeygenassist_si128(last, rcon), 0xff));
+}
+
+__m128i inline ExpandOdd(__m128i prev, __m128i last)
+{
+    return _mm_xor_si128(ShiftXor(prev), _mm_shuffle_epi32(_mm_aeskeygenassist_si128(last, 0), 0xaa));
+}
+
+/** The decryption round keys of the equivalent inverse cipher, from the nr + 1 encryption round keys */
+void InvertKeys(const unsigned char* enc, unsigned char* dec, int nr)
+{
+    Store(dec, Load(enc + 16 * nr));
+    for (int i = 1; i < nr; i++) {
+        Store(dec + 16 * i, _mm_aesimc_si128(Load(enc + 16 * (nr - i))));
+    }
+    Store(dec + 16 * nr, Load(enc));
+}
+
+template<int nr>
+void inline __attribute__((always_inline)) Encrypt4(const __m128i rk[nr + 1], __m128i& a, __m128i& b, __m128i& c, __m128i& d)
+{
+    a = _mm_xor_si128(a, rk[0]);
+    b = _mm_xor_si128(b, rk[0]);
+    c = _mm_xor_si128(c, rk[0]);
+    d = _mm_xor_si128(d, rk[0]);
+    for (int i = 1; i < nr; i++) {
+        a = _mm_aesenc_si128(a, rk[i]);
+        b = _mm_aesenc_si128(b, rk[i]);
+        c = _mm_aesenc_si128(c, rk[i]);
+        d = _mm_aesenc_si128(d, rk[i]);
+    }
+    a = _mm_aesenclast_si128(a, rk[nr]);
+    b = _mm_aesenclast_si128(b, rk[nr]);
+    c = _mm_aesenclast_si128(c, rk[nr]);
+    d = _mm_aesenclast_si128(d, rk[nr]);
+}
+
+template<int nr>
+void inline __attribute__((always_inline)) Decrypt4(const __m128i rk[nr + 1], __m128i& a, __m128i& b, __m128i& c, __m128i& d)
+{
+    a = _mm_xor_si128(a, rk[0]);
+    b = _mm_xor_si128(b, rk[0]);
+    c = _mm_xor_si128(c, rk[0]);
+    d = _mm_xor_si128(d, rk[0]);
+    for (int i = 1; i < nr; i++) {
+        a = _mm_aesdec_si128(a, rk[i]);
+        b = _mm_aesdec_si128(b, rk[i]);
+        c = _mm_aesdec_si128(c, rk[i]);
+        d = _mm_aesdec_si128(d, rk[i]);
+    }
+    a = _mm_aesdeclast_si128(a, rk[nr]);
+    b = _mm_aesdeclast_si128(b, rk[nr]);
+    c = _mm_aesdeclast_si128(c, rk[nr]);
+    d = _mm_aesdeclast_si128(d, rk[nr]);
+}
+
+/** Encrypt or decrypt independent blocks (ECB), 4 at a time so the latency of the AES rounds overlaps */
+template<int nr, bool encrypt>
+void Blocks(const unsigned char* rkIn, unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    __m128i rk[nr + 1];
+    for (int i = 0; i <= nr; i++) {
+        rk[i] = Load(rkIn + 16 * i);
+    }
+    for (; blocks >= 4; blocks -= 4) {
+        __m128i a = Load(in), b = Load(in + 16), c = Load(in + 32), d = Load(in + 48);
+        if (encrypt) {
+            Encrypt4<nr>(rk, a, b, c, d);
+        } else {
+            Decrypt4<nr>(rk, a, b, c, d);
+        }
+        Store(out, a);
+        Store(out + 16, b);
+        Store(out + 32, c);
+        Store(out + 48, d);
+        in += 64;
+        out += 64;
+    }
+    for (; blocks > 0; blocks--) {
+        __m128i a = _mm_xor_si128(Load(in), rk[0]);
+        for (int i = 1; i < nr; i++) {
+            a = encrypt ? _mm_aesenc_si128(a, rk[i]) : _mm_aesdec_si128(a, rk[i]);
+        }
+        a = encrypt ? _mm_aesenclast_si128(a, rk[nr]) : _mm_aesdeclast_si128(a, rk[nr]);
+        Store(out, a);
+        in += 16;
+        out += 16;
+    }
+}
+
+} // namespace
+
+void Init128(const unsigned char key[16], unsigned char enc[11 * 16], unsigned char dec[11 * 16])
+{
+    __m128i k = Load(key);
+    Store(enc, k);
+    k = ExpandEven<0x01>(k, k); Store(enc + 16, k);
+    k = ExpandEven<0x02>(k, k); Store(enc + 32, k);
+    k = ExpandEven<0x04>(k, k); Store(enc + 48, k);
+    k = ExpandEven<0x08>(k, k); Store(enc + 64, k);
+    k = ExpandEven<0x10>(k, k); Store(enc + 80, k);
+    k = ExpandEven<0x20>(k, k); Store(enc + 96, k);
+    k = ExpandEven<0x40>(k, k); Store(enc + 112, k);
+    k = ExpandEven<0x80>(k, k); Store(enc + 128, k);
+    k = ExpandEven<0x1b>(k, k); Store(enc + 144, k);
+    k = ExpandEven<0x36>(k, k); Store(enc + 160, k);
+    if (dec) {
+        InvertKeys(enc, dec, 10);
+    }
+}
+
+void Init256(const unsigned char key[32], unsigned char enc[15 * 16], unsigned char dec[15 * 16])
+{
+    __m128i k0 = Load(key);
+    __m128i k1 = Load(key + 16);
+    Store(enc, k0);
+    Store(enc + 16, k1);
+    k0 = ExpandEven<0x01>(k0, k1); Store(enc + 32, k0);
+    k1 = ExpandOdd(k1, k0); Store(enc + 48, k1);
+    k0 = ExpandEven<0x02>(k0, k1); Store(enc + 64, k0);
+    k1 = ExpandOdd(k1, k0); Store(enc + 80, k1);
+    k0 = ExpandEven<0x04>(k0, k1); Store(enc + 96, k0);
+    k1 = ExpandOdd(k1, k0); Store(enc + 112, k1);
+    k0 = ExpandEven<0x08>(k0, k1); Store(enc + 128, k0);
+    k1 = ExpandOdd(k1, k0); Store(enc + 144, k1);
+    k0 = ExpandEven<0x10>(k0, k1); Store(enc + 160, k0);
+    k1 = ExpandOdd(k1, k0); Store(enc + 176, k1);
+    k0 = ExpandEven<0x20>(k0, k1); Store(enc + 192, k0);
+    k1 = ExpandOdd(k1, k0); Store(enc + 208, k1);
+    k0 = ExpandEven<0x40>(k0, k1); Store(enc + 224, k0);
+    if (dec) {
+        InvertKeys(enc, dec, 14);
+    }
+}
+
+void Encrypt128(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks) { Blocks<10, true>(rk, out, in, blocks); }
+void Decrypt128(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks) { Blocks<10, false>(rk, out, in, blocks); }
+void Encrypt256(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks) { Blocks<14, true>(rk, out, in, blocks); }
+void Decrypt256(const unsigned char* rk, unsigned char* out, const unsigned char* in, size_t blocks) { Blocks<14, false>(rk, out, in, blocks); }
+
+} // namespace aes_aesni
+
+#endif
@@ -7,9 +7,81 @@
 
 #include <crypto/common.h>
 #include <crypto/chacha20.h>
+#include <crypto/cpuid.h>
 
 #include <string.h>
 
+namespace chacha20_sse41
+{
+void Crypt_4way(const uint32_t input[16], const unsigned char* m, unsigned char* c, size_t groups);
+}
+
+namespace chacha20_avx2
+{
+void Crypt_8way(const uint32_t input[16], const unsigned char* m, unsigned char* c, size_t groups);
+}
+
+namespace
+{
+/** Crypt (or with m == nullptr output the keystream of) groups times 4 or 8 blocks, starting at the block counter of
+ *  input, without updating it */
+typedef void (*CryptMultiFn)(const uint32_t input[16], const unsigned char* m, unsigned char* c, size_t groups);
+
+CryptMultiFn CryptMulti_4way = nullptr;
+CryptMultiFn CryptMulti_8way = nullptr;
+
+void inline AdvanceCounter(uint32_t input[16], uint64_t blocks)
+{
+    uint64_t counter = (input[12] | ((uint64_t)input[13] << 32)) + blocks;
+    input[12] = counter;
+    input[13] = counter >> 32;
+}
+
+/** Process as many whole blocks as the multi-block implementations can, returns the number of bytes processed */
+size_t CryptMultiBlock(uint32_t input[16], const unsigned char* m, unsigned char* c, size_t bytes)
+{
+    size_t done = 0;
+    if (CryptMulti_8way && bytes >= 512) {
+        size_t groups = bytes / 512;
+        CryptMulti_8way(input, m, c, groups);
+        AdvanceCounter(input, groups * 8);
+        done += groups * 512;
+    }
+    if (CryptMulti_4way && bytes - done >= 256) {
+        size_t groups = (bytes - done) / 256;
+        CryptMulti_4way(input, m ? m + done : nullptr, c + done, groups);
+        AdvanceCounter(input, groups * 4);
+        done += groups * 256;
+    }
+    return done;
+}
+} // namespace
+
+std::string ChaCha20AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(HAVE_CRYPTO_CPUID)
+    crypto_cpuid::Features features = crypto_cpuid::Detect();
+    (void)features;
+
+#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (features.have_sse41) {
+        CryptMulti_4way = chacha20_sse41::Crypt_4way;
+        ret = "sse41(4way)";
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (features.have_avx2) {
+        CryptMulti_8way = chacha20_avx2::Crypt_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
+#endif
+
+    return ret;
+}
+
 constexpr static inline uint32_t rotl32(uint32_t v, int c) { return (v << c) | (v >> (32 - c)); }
 
 #define QUARTERROUND(a,b,c,d) \
@@ -79,6 +151,10 @@ void ChaCha20::Keystream(unsigned char* c, size_t bytes)
     unsigned char tmp[64];
     unsigned int i;
 
+    size_t done = CryptMultiBlock(input, nullptr, c, bytes);
+    c += done;
+    bytes -= done;
+
     if (!bytes) return;
 
     j0 = input[0];
@@ -187,6 +263,11 @@ void ChaCha20::Crypt(const unsigned char* m, unsigned char* c, size_t bytes)
     unsigned char tmp[64];
     unsigned int i;
 
+    size_t done = CryptMultiBlock(input, m, c, bytes);
+    m += done;
+    c += done;
+    bytes -= done;
+
     if (!bytes) return;
 
     j0 = input[0];
@@ -0,0 +1,114 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/chacha20.h>
+
+namespace chacha20_avx2 {
+namespace {
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline RotL16(__m256i x) { return _mm256_shuffle_epi8(x, _mm256_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2, 13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2)); }
+__m256i inline RotL8(__m256i x) { return _mm256_shuffle_epi8(x, _mm256_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3, 14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3)); }
+template<int n> __m256i inline RotL(__m256i x) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+void inline __attribute__((always_inline)) QuarterRound(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = Add(a, b); d = RotL16(Xor(d, a));
+    c = Add(c, d); b = RotL<12>(Xor(b, c));
+    a = Add(a, b); d = RotL8(Xor(d, a));
+    c = Add(c, d); b = RotL<7>(Xor(b, c));
+}
+
+/** Transpose 4 words of the 8 blocks within each 128 bit half: the lower half of out[i] holds the words of block i,
+ *  the upper half those of block i + 4 */
+void inline __attribute__((always_inline)) Transpose4(__m256i x0, __m256i x1, __m256i x2, __m256i x3, __m256i out[4])
+{
+    __m256i t0 = _mm256_unpacklo_epi32(x0, x1);
+    __m256i t1 = _mm256_unpacklo_epi32(x2, x3);
+    __m256i t2 = _mm256_unpackhi_epi32(x0, x1);
+    __m256i t3 = _mm256_unpackhi_epi32(x2, x3);
+    out[0] = _mm256_unpacklo_epi64(t0, t1);
+    out[1] = _mm256_unpackhi_epi64(t0, t1);
+    out[2] = _mm256_unpacklo_epi64(t2, t3);
+    out[3] = _mm256_unpackhi_epi64(t2, t3);
+}
+
+void inline __attribute__((always_inline)) Write32(const unsigned char* m, unsigned char* c, int offset, __m256i v)
+{
+    if (m) {
+        v = Xor(v, _mm256_loadu_si256((const __m256i*)(m + offset)));
+    }
+    _mm256_storeu_si256((__m256i*)(c + offset), v);
+}
+
+/** Write the words 8 * half .. 8 * half + 7 of the 8 blocks from the transposed words of a and b */
+void inline __attribute__((always_inline)) Write8(const unsigned char* m, unsigned char* c, int half, const __m256i a[4], const __m256i b[4])
+{
+    for (int i = 0; i < 4; i++) {
+        Write32(m, c, 64 * i + 32 * half, _mm256_permute2x128_si256(a[i], b[i], 0x20));
+        Write32(m, c, 64 * (i + 4) + 32 * half, _mm256_permute2x128_si256(a[i], b[i], 0x31));
+    }
+}
+
+} // namespace
+
+void Crypt_8way(const uint32_t input[16], const unsigned char* m, unsigned char* c, size_t groups)
+{
+    __m256i j[16];
+    for (int i = 0; i < 16; i++) {
+        j[i] = _mm256_set1_epi32(input[i]);
+    }
+    uint64_t counter = input[12] | ((uint64_t)input[13] << 32);
+
+    for (; groups > 0; groups--) {
+        // the 64 bit block counter of each lane
+        uint32_t lo[8], hi[8];
+        for (int i = 0; i < 8; i++) {
+            lo[i] = counter + i;
+            hi[i] = (counter + i) >> 32;
+        }
+        j[12] = _mm256_loadu_si256((const __m256i*)lo);
+        j[13] = _mm256_loadu_si256((const __m256i*)hi);
+        counter += 8;
+
+        __m256i x[16];
+        for (int i = 0; i < 16; i++) {
+            x[i] = j[i];
+        }
+        for (int i = 20; i > 0; i -= 2) {
+            QuarterRound(x[0], x[4], x[8], x[12]);
+            QuarterRound(x[1], x[5], x[9], x[13]);
+            QuarterRound(x[2], x[6], x[10], x[14]);
+            QuarterRound(x[3], x[7], x[11], x[15]);
+            QuarterRound(x[0], x[5], x[10], x[15]);
+            QuarterRound(x[1], x[6], x[11], x[12]);
+            QuarterRound(x[2], x[7], x[8], x[13]);
+            QuarterRound(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++) {
+            x[i] = Add(x[i], j[i]);
+        }
+
+        __m256i t0[4], t1[4];
+        Transpose4(x[0], x[1], x[2], x[3], t0);
+        Transpose4(x[4], x[5], x[6], x[7], t1);
+        Write8(m, c, 0, t0, t1);
+        Transpose4(x[8], x[9], x[10], x[11], t0);
+        Transpose4(x[12], x[13], x[14], x[15], t1);
+        Write8(m, c, 1, t0, t1);
+
+        if (m) m += 512;
+        c += 512;
+    }
+}
+
+} // namespace chacha20_avx2
+
+#endif
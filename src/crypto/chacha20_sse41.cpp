@@ -0,0 +1,92 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/chacha20.h>
+
+namespace chacha20_sse41 {
+namespace {
+
+__m128i inline Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+__m128i inline RotL16(__m128i x) { return _mm_shuffle_epi8(x, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2)); }
+__m128i inline RotL8(__m128i x) { return _mm_shuffle_epi8(x, _mm_set_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3)); }
+template<int n> __m128i inline RotL(__m128i x) { return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n)); }
+
+void inline __attribute__((always_inline)) QuarterRound(__m128i& a, __m128i& b, __m128i& c, __m128i& d)
+{
+    a = Add(a, b); d = RotL16(Xor(d, a));
+    c = Add(c, d); b = RotL<12>(Xor(b, c));
+    a = Add(a, b); d = RotL8(Xor(d, a));
+    c = Add(c, d); b = RotL<7>(Xor(b, c));
+}
+
+/** Transpose the words w0..w3 of the 4 blocks in x0..x3 and xor them into the output at offset of each block */
+void inline __attribute__((always_inline)) Write4(const unsigned char* m, unsigned char* c, int offset, __m128i x0, __m128i x1, __m128i x2, __m128i x3)
+{
+    __m128i t0 = _mm_unpacklo_epi32(x0, x1);
+    __m128i t1 = _mm_unpacklo_epi32(x2, x3);
+    __m128i t2 = _mm_unpackhi_epi32(x0, x1);
+    __m128i t3 = _mm_unpackhi_epi32(x2, x3);
+    __m128i b[4] = {_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1), _mm_unpacklo_epi64(t2, t3), _mm_unpackhi_epi64(t2, t3)};
+    for (int i = 0; i < 4; i++) {
+        __m128i v = b[i];
+        if (m) {
+            v = Xor(v, _mm_loadu_si128((const __m128i*)(m + 64 * i + offset)));
+        }
+        _mm_storeu_si128((__m128i*)(c + 64 * i + offset), v);
+    }
+}
+
+} // namespace
+
+void Crypt_4way(const uint32_t input[16], const unsigned char* m, unsigned char* c, size_t groups)
+{
+    __m128i j[16];
+    for (int i = 0; i < 16; i++) {
+        j[i] = _mm_set1_epi32(input[i]);
+    }
+    uint64_t counter = input[12] | ((uint64_t)input[13] << 32);
+
+    for (; groups > 0; groups--) {
+        // the 64 bit block counter of each lane
+        j[12] = _mm_set_epi32(counter + 3, counter + 2, counter + 1, counter);
+        j[13] = _mm_set_epi32((counter + 3) >> 32, (counter + 2) >> 32, (counter + 1) >> 32, counter >> 32);
+        counter += 4;
+
+        __m128i x[16];
+        for (int i = 0; i < 16; i++) {
+            x[i] = j[i];
+        }
+        for (int i = 20; i > 0; i -= 2) {
+            QuarterRound(x[0], x[4], x[8], x[12]);
+            QuarterRound(x[1], x[5], x[9], x[13]);
+            QuarterRound(x[2], x[6], x[10], x[14]);
+            QuarterRound(x[3], x[7], x[11], x[15]);
+            QuarterRound(x[0], x[5], x[10], x[15]);
+            QuarterRound(x[1], x[6], x[11], x[12]);
+            QuarterRound(x[2], x[7], x[8], x[13]);
+            QuarterRound(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++) {
+            x[i] = Add(x[i], j[i]);
+        }
+
+        Write4(m, c, 0, x[0], x[1], x[2], x[3]);
+        Write4(m, c, 16, x[4], x[5], x[6], x[7]);
+        Write4(m, c, 32, x[8], x[9], x[10], x[11]);
+        Write4(m, c, 48, x[12], x[13], x[14], x[15]);
+
+        if (m) m += 256;
+        c += 256;
+    }
+}
+
+} // namespace chacha20_sse41
+
+#endif
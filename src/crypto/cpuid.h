@@ -0,0 +1,65 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_CPUID_H
+#define BITCOIN_CRYPTO_CPUID_H
+
+#if defined(HAVE_CONFIG_H)
+#include <config/dash-config.h>
+#endif
+
+#include <stdint.h>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+
+#define HAVE_CRYPTO_CPUID 1
+
+namespace crypto_cpuid {
+
+// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
+void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+#ifdef __GNUC__
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+#else
+  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+#endif
+}
+
+/** Check whether the OS has enabled AVX registers. */
+bool inline AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+
+/** The vector extensions the intrinsics based implementations of the multi-block primitives use */
+struct Features {
+    bool have_sse41{false};
+    bool have_avx2{false};
+    bool have_aesni{false};
+};
+
+Features inline Detect()
+{
+    Features ret;
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    ret.have_sse41 = (ecx >> 19) & 1;
+    ret.have_aesni = (ecx >> 25) & 1;
+    bool enabled_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && AVXEnabled();
+    if (ret.have_sse41) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        ret.have_avx2 = ((ebx >> 5) & 1) && enabled_avx;
+    }
+    return ret;
+}
+
+} // namespace crypto_cpuid
+
+#endif
+
+#endif // BITCOIN_CRYPTO_CPUID_H
@@ -0,0 +1,249 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/muhash.h>
+
+#include <crypto/chacha20.h>
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+
+#include <limits>
+
+namespace {
+
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+const int LIMB_SIZE = Num3072::LIMB_SIZE;
+const int LIMBS = Num3072::LIMBS;
+const limb_t LIMB_MAX = std::numeric_limits<limb_t>::max();
+/** 2^3072 - 1103717 is the largest 3072 bit safe prime, so 2^3072 is congruent to MAX_PRIME_DIFF */
+const limb_t MAX_PRIME_DIFF = 1103717;
+
+limb_t ReadLimb(const unsigned char* data)
+{
+    return LIMB_SIZE == 64 ? (limb_t)ReadLE64(data) : (limb_t)ReadLE32(data);
+}
+
+void WriteLimb(unsigned char* data, limb_t limb)
+{
+    if (LIMB_SIZE == 64) {
+        WriteLE64(data, (uint64_t)limb);
+    } else {
+        WriteLE32(data, (uint32_t)limb);
+    }
+}
+
+} // namespace
+
+Num3072::Num3072(const unsigned char (&data)[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        limbs[i] = ReadLimb(data + i * LIMB_SIZE / 8);
+    }
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i) {
+        limbs[i] = 0;
+    }
+}
+
+void Num3072::ToBytes(unsigned char (&out)[BYTE_SIZE]) const
+{
+    for (int i = 0; i < LIMBS; ++i) {
+        WriteLimb(out + i * LIMB_SIZE / 8, limbs[i]);
+    }
+}
+
+bool Num3072::IsOverflow() const
+{
+    // The lowest limb of the prime is LIMB_MAX + 1 - MAX_PRIME_DIFF, all others are LIMB_MAX
+    if (limbs[0] <= LIMB_MAX - MAX_PRIME_DIFF) {
+        return false;
+    }
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != LIMB_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtracting the prime is the same as adding MAX_PRIME_DIFF and dropping the 2^3072 bit
+    double_limb_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += limbs[i];
+        limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Full 6144 bit product
+    limb_t tmp[LIMBS * 2];
+    for (int j = 0; j < LIMBS; ++j) {
+        tmp[j] = 0;
+    }
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)limbs[i] * a.limbs[j] + tmp[i + j] + carry;
+            tmp[i + j] = (limb_t)t;
+            carry = (limb_t)(t >> LIMB_SIZE);
+        }
+        tmp[i + LIMBS] = carry;
+    }
+    Reduce(tmp);
+}
+
+void Num3072::Square()
+{
+    // Products of distinct limbs, each pair only once
+    limb_t tmp[LIMBS * 2];
+    for (int j = 0; j < LIMBS; ++j) {
+        tmp[j] = 0;
+    }
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = i + 1; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)limbs[i] * limbs[j] + tmp[i + j] + carry;
+            tmp[i + j] = (limb_t)t;
+            carry = (limb_t)(t >> LIMB_SIZE);
+        }
+        tmp[i + LIMBS] = carry;
+    }
+
+    // Double them and add the squares of the limbs
+    limb_t top = 0;
+    for (int k = 0; k < LIMBS * 2; ++k) {
+        const limb_t v = tmp[k];
+        tmp[k] = (v << 1) | top;
+        top = v >> (LIMB_SIZE - 1);
+    }
+    double_limb_t c = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        const double_limb_t sq = (double_limb_t)limbs[i] * limbs[i];
+        c += (double_limb_t)tmp[2 * i] + (limb_t)sq;
+        tmp[2 * i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+        c += (double_limb_t)tmp[2 * i + 1] + (limb_t)(sq >> LIMB_SIZE);
+        tmp[2 * i + 1] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+    Reduce(tmp);
+}
+
+void Num3072::Reduce(const limb_t (&tmp)[LIMBS * 2])
+{
+    // Fold the upper half into the lower one, as high * 2^3072 + low is congruent to high * MAX_PRIME_DIFF + low
+    limb_t carry = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        double_limb_t t = (double_limb_t)tmp[i + LIMBS] * MAX_PRIME_DIFF + tmp[i] + carry;
+        limbs[i] = (limb_t)t;
+        carry = (limb_t)(t >> LIMB_SIZE);
+    }
+    while (carry) {
+        double_limb_t t = (double_limb_t)carry * MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS; ++i) {
+            t += limbs[i];
+            limbs[i] = (limb_t)t;
+            t >>= LIMB_SIZE;
+        }
+        carry = (limb_t)t;
+    }
+
+    if (IsOverflow()) {
+        FullReduce();
+    }
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // By Fermat's little theorem the inverse is *this^(p - 2), computed with a fixed window of 4 bits
+    Num3072 table[16];
+    table[1] = *this;
+    for (int k = 2; k < 16; ++k) {
+        table[k] = table[k - 1];
+        table[k].Multiply(*this);
+    }
+
+    Num3072 out;
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        // All limbs of p - 2 but the lowest are LIMB_MAX
+        const limb_t e = i == 0 ? LIMB_MAX - MAX_PRIME_DIFF - 1 : LIMB_MAX;
+        for (int j = LIMB_SIZE - 4; j >= 0; j -= 4) {
+            if (i != LIMBS - 1 || j != LIMB_SIZE - 4) {
+                for (int k = 0; k < 4; ++k) {
+                    out.Square();
+                }
+            }
+            const int window = (e >> j) & 15;
+            if (window) {
+                out.Multiply(table[window]);
+            }
+        }
+    }
+    return out;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+Num3072 MuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char hashed_in[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(hashed_in);
+    unsigned char tmp[Num3072::BYTE_SIZE];
+    ChaCha20(hashed_in, sizeof(hashed_in)).Keystream(tmp, sizeof(tmp));
+    return Num3072(tmp);
+}
+
+MuHash3072::MuHash3072(const unsigned char* data, size_t len)
+{
+    m_numerator = ToNum3072(data, len);
+}
+
+MuHash3072& MuHash3072::operator*=(const MuHash3072& mul)
+{
+    m_numerator.Multiply(mul.m_numerator);
+    m_denominator.Multiply(mul.m_denominator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::operator/=(const MuHash3072& div)
+{
+    m_numerator.Multiply(div.m_denominator);
+    m_denominator.Multiply(div.m_numerator);
+    return *this;
+}
+
+MuHash3072& MuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    m_numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+MuHash3072& MuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    m_denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+void MuHash3072::Finalize(uint256& out)
+{
+    m_numerator.Divide(m_denominator);
+    m_denominator.SetToOne();
+
+    unsigned char data[Num3072::BYTE_SIZE];
+    m_numerator.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(out.begin());
+}
@@ -0,0 +1,113 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the prime 2^3072 - 1103717, stored as little endian limbs */
+class Num3072
+{
+public:
+    static const size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static const int LIMBS = 48;
+    static const int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static const int LIMBS = 96;
+    static const int LIMB_SIZE = 32;
+#endif
+    limb_t limbs[LIMBS];
+
+    static_assert(LIMB_SIZE * LIMBS == 3072, "Num3072 isn't 3072 bits");
+    static_assert(sizeof(double_limb_t) == sizeof(limb_t) * 2, "bad size for double_limb_t");
+    static_assert(sizeof(limb_t) * 8 == LIMB_SIZE, "LIMB_SIZE is incorrect");
+
+private:
+    void FullReduce();
+    bool IsOverflow() const;
+    /** Set *this to the reduced value of a 6144 bit product */
+    void Reduce(const limb_t (&tmp)[LIMBS * 2]);
+    void Square();
+    Num3072 GetInverse() const;
+
+public:
+
+    Num3072() { SetToOne(); }
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]) const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        for (limb_t& limb : limbs) {
+            READWRITE(limb);
+        }
+    }
+};
+
+/**
+ * A rolling hash of a set of byte strings (MuHash3072, see https://cseweb.ucsd.edu/~mihir/papers/inchash.pdf).
+ *
+ * Every element is mapped to a number modulo a 3072 bit prime by keying ChaCha20 with its SHA256, the hash of a set
+ * is the product of the numbers of its elements. Elements can be added and removed in any order, and the hashes of
+ * disjoint sets can be combined by multiplication, so the hash of a large set can be computed in parts and updated
+ * as the set changes. Removals are multiplied into a separate denominator, only Finalize() needs the (comparatively
+ * expensive) inverse.
+ */
+class MuHash3072
+{
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    /** The hash of the empty set */
+    MuHash3072() {}
+
+    /** The hash of a set with a single element */
+    MuHash3072(const unsigned char* data, size_t len);
+
+    /** Add the elements of the set that mul is the hash of */
+    MuHash3072& operator*=(const MuHash3072& mul);
+
+    /** Remove the elements of the set that div is the hash of */
+    MuHash3072& operator/=(const MuHash3072& div);
+
+    MuHash3072& Insert(const unsigned char* data, size_t len);
+    MuHash3072& Remove(const unsigned char* data, size_t len);
+
+    /** The SHA256 of the normalized product, this also resets the denominator to one */
+    void Finalize(uint256& out);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(m_numerator);
+        READWRITE(m_denominator);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -6,12 +6,47 @@
 // poly1305-donna-unrolled.c from https://github.com/floodyberry/poly1305-donna
 
 #include <crypto/common.h>
+#include <crypto/cpuid.h>
 #include <crypto/poly1305.h>
 
 #include <string.h>
 
 #define mul32x32_64(a,b) ((uint64_t)(a) * (b))
 
+namespace poly1305_avx2
+{
+void Blocks_4way(const uint32_t r[5], const unsigned char* m, size_t groups, uint32_t hout[5]);
+}
+
+namespace
+{
+/** Minimum message length for the multi-block implementation, below it computing the powers of r doesn't pay off */
+const size_t POLY1305_MULTI_MIN_LEN = 256;
+
+/** Hash groups times 4 full blocks from an empty state into the 26 bit limbs of hout */
+typedef void (*BlocksMultiFn)(const uint32_t r[5], const unsigned char* m, size_t groups, uint32_t hout[5]);
+
+BlocksMultiFn Blocks_4way = nullptr;
+} // namespace
+
+std::string Poly1305AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(HAVE_CRYPTO_CPUID)
+    crypto_cpuid::Features features = crypto_cpuid::Detect();
+    (void)features;
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (features.have_avx2) {
+        Blocks_4way = poly1305_avx2::Blocks_4way;
+        ret = "avx2(4way)";
+    }
+#endif
+#endif
+
+    return ret;
+}
+
 void poly1305_auth(unsigned char out[POLY1305_TAGLEN], const unsigned char *m, size_t inlen, const unsigned char key[POLY1305_KEYLEN]) {
     uint32_t t0,t1,t2,t3;
     uint32_t h0,h1,h2,h3,h4;
@@ -50,6 +85,21 @@ void poly1305_auth(unsigned char out[POLY1305_TAGLEN], const unsigned char *m, s
     h3 = 0;
     h4 = 0;
 
+    /* leading blocks, four at a time */
+    if (Blocks_4way && inlen >= POLY1305_MULTI_MIN_LEN) {
+        const uint32_t r[5] = {r0, r1, r2, r3, r4};
+        uint32_t h[5];
+        size_t groups = inlen / 64;
+        Blocks_4way(r, m, groups, h);
+        h0 = h[0];
+        h1 = h[1];
+        h2 = h[2];
+        h3 = h[3];
+        h4 = h[4];
+        m += groups * 64;
+        inlen -= groups * 64;
+    }
+
     /* full blocks */
     if (inlen < 16) goto poly1305_donna_atmost15bytes;
 poly1305_donna_16bytes:
@@ -0,0 +1,143 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+#include <crypto/poly1305.h>
+
+namespace poly1305_avx2 {
+namespace {
+
+const uint32_t MASK26 = 0x3ffffff;
+
+/** h = h * r mod 2^130 - 5, in 26 bit limbs */
+void MulR(uint32_t h[5], const uint32_t r[5])
+{
+    uint64_t t[5];
+    t[0] = (uint64_t)h[0] * r[0] + (uint64_t)h[1] * (r[4] * 5) + (uint64_t)h[2] * (r[3] * 5) + (uint64_t)h[3] * (r[2] * 5) + (uint64_t)h[4] * (r[1] * 5);
+    t[1] = (uint64_t)h[0] * r[1] + (uint64_t)h[1] * r[0] + (uint64_t)h[2] * (r[4] * 5) + (uint64_t)h[3] * (r[3] * 5) + (uint64_t)h[4] * (r[2] * 5);
+    t[2] = (uint64_t)h[0] * r[2] + (uint64_t)h[1] * r[1] + (uint64_t)h[2] * r[0] + (uint64_t)h[3] * (r[4] * 5) + (uint64_t)h[4] * (r[3] * 5);
+    t[3] = (uint64_t)h[0] * r[3] + (uint64_t)h[1] * r[2] + (uint64_t)h[2] * r[1] + (uint64_t)h[3] * r[0] + (uint64_t)h[4] * (r[4] * 5);
+    t[4] = (uint64_t)h[0] * r[4] + (uint64_t)h[1] * r[3] + (uint64_t)h[2] * r[2] + (uint64_t)h[3] * r[1] + (uint64_t)h[4] * r[0];
+
+    uint64_t c = 0;
+    for (int i = 0; i < 5; i++) {
+        t[i] += c;
+        h[i] = t[i] & MASK26;
+        c = t[i] >> 26;
+    }
+    c = h[0] + c * 5;
+    h[0] = c & MASK26;
+    h[1] += c >> 26;
+}
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi64(x, y); }
+__m256i inline Mul(__m256i x, __m256i y) { return _mm256_mul_epu32(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+
+/** h = h * r for each of the 4 lanes, s holds the limbs of r times 5 */
+void inline __attribute__((always_inline)) Mul4(__m256i h[5], const __m256i r[5], const __m256i s[5])
+{
+    const __m256i mask = _mm256_set1_epi64x(MASK26);
+    __m256i d[5];
+    d[0] = Add(Add(Add(Mul(h[0], r[0]), Mul(h[1], s[4])), Add(Mul(h[2], s[3]), Mul(h[3], s[2]))), Mul(h[4], s[1]));
+    d[1] = Add(Add(Add(Mul(h[0], r[1]), Mul(h[1], r[0])), Add(Mul(h[2], s[4]), Mul(h[3], s[3]))), Mul(h[4], s[2]));
+    d[2] = Add(Add(Add(Mul(h[0], r[2]), Mul(h[1], r[1])), Add(Mul(h[2], r[0]), Mul(h[3], s[4]))), Mul(h[4], s[3]));
+    d[3] = Add(Add(Add(Mul(h[0], r[3]), Mul(h[1], r[2])), Add(Mul(h[2], r[1]), Mul(h[3], r[0]))), Mul(h[4], s[4]));
+    d[4] = Add(Add(Add(Mul(h[0], r[4]), Mul(h[1], r[3])), Add(Mul(h[2], r[2]), Mul(h[3], r[1]))), Mul(h[4], r[0]));
+
+    __m256i c = _mm256_srli_epi64(d[0], 26);
+    h[0] = And(d[0], mask);
+    for (int i = 1; i < 5; i++) {
+        d[i] = Add(d[i], c);
+        c = _mm256_srli_epi64(d[i], 26);
+        h[i] = And(d[i], mask);
+    }
+    h[0] = Add(h[0], Add(c, _mm256_slli_epi64(c, 2)));
+    c = _mm256_srli_epi64(h[0], 26);
+    h[0] = And(h[0], mask);
+    h[1] = Add(h[1], c);
+}
+
+} // namespace
+
+void Blocks_4way(const uint32_t r[5], const unsigned char* m, size_t groups, uint32_t hout[5])
+{
+    // lane i ends up with the blocks i, 4 + i, 8 + i, ... each multiplied by r^4 per later group
+    uint32_t rpow[4][5];
+    for (int i = 0; i < 5; i++) {
+        rpow[0][i] = r[i];
+        rpow[1][i] = r[i];
+    }
+    MulR(rpow[1], r);
+    for (int i = 0; i < 5; i++) {
+        rpow[2][i] = rpow[1][i];
+    }
+    MulR(rpow[2], r);
+    for (int i = 0; i < 5; i++) {
+        rpow[3][i] = rpow[2][i];
+    }
+    MulR(rpow[3], r);
+
+    __m256i r4[5], s4[5];
+    for (int i = 0; i < 5; i++) {
+        r4[i] = _mm256_set1_epi64x(rpow[3][i]);
+        s4[i] = _mm256_set1_epi64x(rpow[3][i] * 5);
+    }
+
+    const __m256i mask = _mm256_set1_epi64x(MASK26);
+    const __m256i hibit = _mm256_set1_epi64x(1 << 24);
+    __m256i h[5];
+    for (int i = 0; i < 5; i++) {
+        h[i] = _mm256_setzero_si256();
+    }
+    for (size_t g = 0; g < groups; g++) {
+        if (g > 0) {
+            Mul4(h, r4, s4);
+        }
+        // the low and high 64 bits of the 4 blocks, in the order 0, 2, 1, 3 after the unpacks
+        __m256i a = _mm256_loadu_si256((const __m256i*)(m + 0));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(m + 32));
+        __m256i lo = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xd8);
+        __m256i hi = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xd8);
+        h[0] = Add(h[0], And(lo, mask));
+        h[1] = Add(h[1], And(_mm256_srli_epi64(lo, 26), mask));
+        h[2] = Add(h[2], And(_mm256_or_si256(_mm256_srli_epi64(lo, 52), _mm256_slli_epi64(hi, 12)), mask));
+        h[3] = Add(h[3], And(_mm256_srli_epi64(hi, 14), mask));
+        h[4] = Add(h[4], _mm256_or_si256(_mm256_srli_epi64(hi, 40), hibit));
+        m += 64;
+    }
+
+    // multiply lane i by r^(4 - i) and sum the lanes
+    __m256i rfin[5], sfin[5];
+    for (int i = 0; i < 5; i++) {
+        rfin[i] = _mm256_set_epi64x(rpow[0][i], rpow[1][i], rpow[2][i], rpow[3][i]);
+        sfin[i] = _mm256_set_epi64x(rpow[0][i] * 5, rpow[1][i] * 5, rpow[2][i] * 5, rpow[3][i] * 5);
+    }
+    Mul4(h, rfin, sfin);
+
+    uint64_t t[5];
+    for (int i = 0; i < 5; i++) {
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256((__m256i*)lanes, h[i]);
+        t[i] = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    uint64_t c = 0;
+    for (int i = 0; i < 5; i++) {
+        t[i] += c;
+        hout[i] = t[i] & MASK26;
+        c = t[i] >> 26;
+    }
+    c = hout[0] + c * 5;
+    hout[0] = c & MASK26;
+    hout[1] += c >> 26;
+}
+
+} // namespace poly1305_avx2
+
+#endif
@@ -22,11 +22,13 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 namespace sha256d64_sse41
 {
 void Transform_4way(unsigned char* out, const unsigned char* in);
+void TransformMulti_4way(uint32_t* const* s, const unsigned char* const* chunks);
 }
 
 namespace sha256d64_avx2
 {
 void Transform_8way(unsigned char* out, const unsigned char* in);
+void TransformMulti_8way(uint32_t* const* s, const unsigned char* const* chunks);
 }
 
 namespace sha256d64_shani
@@ -416,6 +418,8 @@ void TransformD64(unsigned char* out, const unsigned char* in)
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
 typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+//! Transforms one block for each of N independent states (N being the number of lanes of the implementation)
+typedef void (*TransformMultiType)(uint32_t* const*, const unsigned char* const*);
 
 template<TransformType tr>
 void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
@@ -461,6 +465,8 @@ TransformD64Type TransformD64 = sha256::TransformD64;
 TransformD64Type TransformD64_2way = nullptr;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
+TransformMultiType TransformMulti_4way = nullptr;
+TransformMultiType TransformMulti_8way = nullptr;
 
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
@@ -544,6 +550,27 @@ bool SelfTest() {
         if (!std::equal(out, out + 256, result_d64)) return false;
     }
 
+    // Test TransformMulti_4way and TransformMulti_8way, if available. Lane i transforms block i from the state of the
+    // first i blocks.
+    for (size_t lanes : {4, 8}) {
+        TransformMultiType tr = lanes == 4 ? TransformMulti_4way : TransformMulti_8way;
+        if (!tr) continue;
+        for (size_t first = 0; first < 8; first += lanes) {
+            uint32_t states[8][8];
+            uint32_t* s[8];
+            const unsigned char* chunks[8];
+            for (size_t i = 0; i < lanes; ++i) {
+                std::copy(result[first + i], result[first + i] + 8, states[i]);
+                s[i] = states[i];
+                chunks[i] = data + 1 + 64 * (first + i);
+            }
+            tr(s, chunks);
+            for (size_t i = 0; i < lanes; ++i) {
+                if (!std::equal(states[i], states[i] + 8, result[first + i + 1])) return false;
+            }
+        }
+    }
+
     return true;
 }
 
@@ -622,6 +649,7 @@ std::string SHA256AutoDetect()
 #endif
 #if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
         TransformD64_4way = sha256d64_sse41::Transform_4way;
+        TransformMulti_4way = sha256d64_sse41::TransformMulti_4way;
         ret += ",sse41(4way)";
 #endif
     }
@@ -629,6 +657,7 @@ std::string SHA256AutoDetect()
 #if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
     if (have_avx2 && have_avx && enabled_avx) {
         TransformD64_8way = sha256d64_avx2::Transform_8way;
+        TransformMulti_8way = sha256d64_avx2::TransformMulti_8way;
         ret += ",avx2(8way)";
     }
 #endif
@@ -728,3 +757,145 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+namespace
+{
+/** The state of one message of SHA256DMulti: its full blocks are read from the input, the padded rest from tail. */
+struct MultiLane
+{
+    bool fActive{false};
+    bool fSecond{false};
+    size_t nMsg{0};
+    const unsigned char* pData{nullptr};
+    size_t nBlocks{0};
+    unsigned char tail[128];
+    size_t nTailBlocks{0};
+    size_t nTailPos{0};
+    uint32_t s[8];
+
+    void Start(size_t nMsgIn, const unsigned char* data, size_t len)
+    {
+        fActive = true;
+        fSecond = false;
+        nMsg = nMsgIn;
+        pData = data;
+        nBlocks = len / 64;
+        size_t nRest = len % 64;
+        nTailBlocks = nRest + 9 > 64 ? 2 : 1;
+        nTailPos = 0;
+        memset(tail, 0, sizeof(tail));
+        if (nRest) memcpy(tail, data + 64 * nBlocks, nRest);
+        tail[nRest] = 0x80;
+        WriteBE64(tail + 64 * nTailBlocks - 8, ((uint64_t)len) << 3);
+        sha256::Initialize(s);
+    }
+
+    const unsigned char* Next()
+    {
+        if (nBlocks) {
+            const unsigned char* ret = pData;
+            pData += 64;
+            --nBlocks;
+            return ret;
+        }
+        return tail + 64 * nTailPos++;
+    }
+
+    bool Done() const { return nBlocks == 0 && nTailPos == nTailBlocks; }
+
+    /** Once Done(), starts the second SHA256 or writes the result. Returns true when the message is finished. */
+    bool Finish(unsigned char* out)
+    {
+        if (!fSecond) {
+            fSecond = true;
+            memset(tail, 0, 64);
+            for (int i = 0; i < 8; ++i) {
+                WriteBE32(tail + 4 * i, s[i]);
+            }
+            tail[32] = 0x80;
+            WriteBE64(tail + 56, 256);
+            pData = nullptr;
+            nBlocks = 0;
+            nTailBlocks = 1;
+            nTailPos = 0;
+            sha256::Initialize(s);
+            return false;
+        }
+        for (int i = 0; i < 8; ++i) {
+            WriteBE32(out + 32 * nMsg + 4 * i, s[i]);
+        }
+        fActive = false;
+        return true;
+    }
+
+    /** Hashes the rest of the message with the 1-way Transform. */
+    void Complete(unsigned char* out)
+    {
+        do {
+            if (nBlocks) {
+                Transform(s, pData, nBlocks);
+                pData += 64 * nBlocks;
+                nBlocks = 0;
+            }
+            Transform(s, tail + 64 * nTailPos, nTailBlocks - nTailPos);
+            nTailPos = nTailBlocks;
+        } while (!Finish(out));
+    }
+};
+
+template<size_t N>
+void SHA256DMultiWay(TransformMultiType tr, unsigned char* out, const unsigned char* const* in, const size_t* lens, size_t count)
+{
+    MultiLane lanes[N];
+    uint32_t idle_state[8] = {0};
+    static const unsigned char idle_block[64] = {0};
+    uint32_t* s[N];
+    const unsigned char* chunks[N];
+    size_t next = 0;
+    while (true) {
+        size_t active = 0;
+        for (auto& lane : lanes) {
+            if (!lane.fActive && next < count) {
+                lane.Start(next, in[next], lens[next]);
+                ++next;
+            }
+            active += lane.fActive;
+        }
+        // When only a few (long) messages are left, the idle lanes would cost more than the parallel ones save
+        if (next == count && active * 2 <= N) {
+            for (auto& lane : lanes) {
+                if (lane.fActive) lane.Complete(out);
+            }
+            return;
+        }
+        for (size_t i = 0; i < N; ++i) {
+            if (lanes[i].fActive) {
+                s[i] = lanes[i].s;
+                chunks[i] = lanes[i].Next();
+            } else {
+                s[i] = idle_state;
+                chunks[i] = idle_block;
+            }
+        }
+        tr(s, chunks);
+        for (auto& lane : lanes) {
+            if (lane.fActive && lane.Done()) lane.Finish(out);
+        }
+    }
+}
+} // namespace
+
+void SHA256DMulti(unsigned char* out, const unsigned char* const* in, const size_t* lens, size_t count)
+{
+    if (TransformMulti_8way) {
+        SHA256DMultiWay<8>(TransformMulti_8way, out, in, lens, count);
+    } else if (TransformMulti_4way) {
+        SHA256DMultiWay<4>(TransformMulti_4way, out, in, lens, count);
+    } else {
+        MultiLane lane;
+        for (size_t i = 0; i < count; ++i) {
+            lane.Start(i, in[i], lens[i]);
+            lane.Complete(out);
+        }
+    }
+}
@@ -6,6 +6,7 @@
 
 #include <memory>
 #include <random.h>
+#include <replica.h>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -13,6 +14,7 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <sstream>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -97,13 +99,91 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+CDBTuning GetDBTuning(const std::string& name)
+{
+    CDBTuning tuning;
+    if (name == "index") {
+        // The block index is small, but the transaction and address indexes are mostly read by range scans
+        tuning.nBlockSize = 16 * 1024;
+        tuning.nMaxFileSize = 8 * 1024 * 1024;
+    } else if (name == "evodb" || name == "llmq" || name == "governance") {
+        // Few, but large and repetitive entries (masternode lists, quorum data, recovered signatures, votes)
+        tuning.nBlockSize = 16 * 1024;
+        tuning.fCompression = true;
+    } else if (name == "blocktree" || name == "basic") {
+        // The background indexes write in large batches and are read by height ranges
+        tuning.nMaxFileSize = 8 * 1024 * 1024;
+    }
+    // The chainstate keeps the defaults: small coins that are looked up at random, where the bloom filter matters most
+
+    for (const std::string& arg : gArgs.GetArgs("-dbtuning")) {
+        std::string strError;
+        if (!ParseDBTuning(arg, name, tuning, strError)) {
+            // Checked on startup already
+            LogPrintf("%s: %s\n", __func__, strError);
+        }
+    }
+    return tuning;
+}
+
+bool ParseDBTuning(const std::string& arg, const std::string& name, CDBTuning& tuning, std::string& strError)
+{
+    size_t pos = arg.find(':');
+    if (pos == std::string::npos || pos == 0) {
+        strError = strprintf("Invalid -dbtuning argument, expected <db>:<setting>=<value>: %s", arg);
+        return false;
+    }
+    const bool fApply = arg.substr(0, pos) == name;
+    CDBTuning parsed = tuning;
+
+    std::string settings = arg.substr(pos + 1);
+    while (true) {
+        size_t end = settings.find(',');
+        const std::string setting = settings.substr(0, end);
+        size_t eq = setting.find('=');
+        const std::string key = setting.substr(0, eq);
+        int32_t value;
+        if (eq == std::string::npos || !ParseInt32(setting.substr(eq + 1), &value)) {
+            strError = strprintf("Invalid -dbtuning setting, expected <setting>=<number>: %s", setting);
+            return false;
+        }
+        if (key == "blocksize" && value >= 1 && value <= 1024) {
+            parsed.nBlockSize = value * 1024;
+        } else if (key == "compression" && (value == 0 || value == 1)) {
+            parsed.fCompression = value;
+        } else if (key == "writebuffer" && value >= 1 && value <= 45) {
+            parsed.nWriteBufferPercent = value;
+        } else if (key == "maxfilesize" && value >= 1 && value <= 256) {
+            parsed.nMaxFileSize = value * 1024 * 1024;
+        } else if (key == "bloombits" && value >= 0 && value <= 32) {
+            parsed.nBloomBits = value;
+        } else {
+            strError = strprintf("Unknown -dbtuning setting or value out of range: %s", setting);
+            return false;
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        settings = settings.substr(end + 1);
+    }
+
+    if (fApply) {
+        tuning = parsed;
+    }
+    return true;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBTuning& tuning)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    // Up to two write buffers may be held in memory simultaneously
+    const size_t nWriteBufferSize = nCacheSize * tuning.nWriteBufferPercent / 100;
+    options.block_cache = leveldb::NewLRUCache(nCacheSize - 2 * nWriteBufferSize);
+    options.write_buffer_size = nWriteBufferSize;
+    options.block_size = tuning.nBlockSize;
+    options.max_file_size = tuning.nMaxFileSize;
+    options.filter_policy = tuning.nBloomBits > 0 ? leveldb::NewBloomFilterPolicy(tuning.nBloomBits) : nullptr;
+    options.compression = tuning.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -115,6 +195,11 @@ static leveldb::Options GetOptions(size_t nCacheSize)
 }
 
 CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+    : CDBWrapper(path, nCacheSize, fMemory, fWipe, obfuscate, GetDBTuning(fs::basename(path)))
+{
+}
+
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBTuning& tuning)
     : m_name(fs::basename(path))
 {
     penv = nullptr;
@@ -122,8 +207,10 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, tuning);
     options.create_if_missing = true;
+    LogPrint(BCLog::LEVELDB, "LevelDB tuning for %s: blocksize=%u compression=%d writebuffer=%d%% maxfilesize=%u bloombits=%d\n",
+             m_name, tuning.nBlockSize, tuning.fCompression, tuning.nWriteBufferPercent, tuning.nMaxFileSize, tuning.nBloomBits);
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
         options.env = penv;
@@ -135,6 +222,9 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
         }
         TryCreateDirectories(path);
         LogPrintf("Opening LevelDB in %s\n", path.string());
+        if (fReadOnlyReplica) {
+            options.env = GetReplicaEnv();
+        }
     }
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     dbwrapper_private::HandleError(status);
@@ -184,8 +274,10 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
     const bool log_memory = LogAcceptCategory(BCLog::LEVELDB);
     double mem_before = 0;
+    CDBWriteStallStats stalls_before;
     if (log_memory) {
         mem_before = DynamicMemoryUsage() / 1024.0 / 1024;
+        stalls_before = GetWriteStallStats();
     }
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
     dbwrapper_private::HandleError(status);
@@ -193,6 +285,14 @@ bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
         double mem_after = DynamicMemoryUsage() / 1024.0 / 1024;
         LogPrint(BCLog::LEVELDB, "WriteBatch memory usage: db=%s, before=%.1fMiB, after=%.1fMiB\n",
                  m_name, mem_before, mem_after);
+        CDBWriteStallStats stalls_after = GetWriteStallStats();
+        if (stalls_after.nStallMicros != stalls_before.nStallMicros) {
+            LogPrint(BCLog::LEVELDB, "WriteBatch stalled: db=%s, slowdowns=%u, memtable=%u, l0=%u, %.2fms\n",
+                     m_name, stalls_after.nSlowdowns - stalls_before.nSlowdowns,
+                     stalls_after.nMemtableWaits - stalls_before.nMemtableWaits,
+                     stalls_after.nL0Waits - stalls_before.nL0Waits,
+                     (stalls_after.nStallMicros - stalls_before.nStallMicros) / 1000.0);
+        }
     }
     return true;
 }
@@ -206,6 +306,23 @@ size_t CDBWrapper::DynamicMemoryUsage() const {
     return stoul(memory);
 }
 
+CDBWriteStallStats CDBWrapper::GetWriteStallStats() const {
+    CDBWriteStallStats stats;
+    std::string value;
+    if (!pdb->GetProperty("leveldb.write-stalls", &value)) {
+        LogPrint(BCLog::LEVELDB, "Failed to get write-stalls property\n");
+        return stats;
+    }
+    std::istringstream ss(value);
+    ss >> stats.nSlowdowns >> stats.nMemtableWaits >> stats.nL0Waits >> stats.nStallMicros;
+    return stats;
+}
+
+void SetDBCompactionThreads(int n)
+{
+    leveldb::Env::Default()->SetBackgroundThreads(n);
+}
+
 // Prefixed with null character to avoid collisions with other keys
 //
 // We must use a string constructor which specifies length so that we copy
@@ -233,10 +350,15 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+CDBSnapshot::CDBSnapshot(const CDBWrapper &_parent) : parent(_parent), snapshot(_parent.pdb->GetSnapshot()) {}
+CDBSnapshot::~CDBSnapshot() { parent.pdb->ReleaseSnapshot(snapshot); }
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
+void CDBIterator::SeekToLast() { piter->SeekToLast(); }
 void CDBIterator::Next() { piter->Next(); }
+void CDBIterator::Prev() { piter->Prev(); }
 
 namespace dbwrapper_private {
 
@@ -255,4 +377,14 @@ const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w)
     return w.obfuscate_key;
 }
 
+std::string& GetReadBuffer()
+{
+    static thread_local std::string buffer;
+    // Don't keep the memory of a large value around on every thread which once read one
+    if (buffer.capacity() > 1024 * 1024) {
+        std::string().swap(buffer);
+    }
+    return buffer;
+}
+
 } // namespace dbwrapper_private
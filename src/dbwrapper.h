@@ -13,6 +13,8 @@
 #include <utilstrencodings.h>
 #include <version.h>
 
+#include <algorithm>
+#include <memory>
 #include <typeindex>
 
 #include <leveldb/db.h>
@@ -20,6 +22,8 @@
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
+//! -dbcompactionthreads default
+static const int DEFAULT_DB_COMPACTION_THREADS = 2;
 
 class dbwrapper_error : public std::runtime_error
 {
@@ -27,6 +31,52 @@ public:
     explicit dbwrapper_error(const std::string& msg) : std::runtime_error(msg) {}
 };
 
+/**
+ * LevelDB settings of a database. Every database starts out with the defaults for its workload (see GetDBTuning),
+ * which can be overridden with -dbtuning.
+ */
+struct CDBTuning
+{
+    /** Approximate size of the uncompressed data per table block */
+    size_t nBlockSize{4 * 1024};
+    /** Compress table blocks with Snappy, has no effect if LevelDB was built without it */
+    bool fCompression{false};
+    /** Share of the cache used for each of the (up to two) write buffers in percent, the rest is block cache */
+    int nWriteBufferPercent{25};
+    /** Size at which LevelDB starts a new table file */
+    size_t nMaxFileSize{2 * 1024 * 1024};
+    /** Bits per key of the bloom filter, 0 to disable it */
+    int nBloomBits{10};
+};
+
+/** Settings for the database in a directory called name, i.e. the workload defaults and the -dbtuning overrides */
+CDBTuning GetDBTuning(const std::string& name);
+
+/**
+ * Parse a -dbtuning=<db>:<setting>=<value>[,<setting>=<value>...] argument, applying it to tuning if it is for the
+ * database name.
+ */
+bool ParseDBTuning(const std::string& arg, const std::string& name, CDBTuning& tuning, std::string& strError);
+
+/**
+ * Let LevelDB compact up to n databases at the same time. The databases share the background threads of the default
+ * LevelDB environment, each of them is still compacted by one thread at a time.
+ */
+void SetDBCompactionThreads(int n);
+
+/** Writes LevelDB delayed to let compactions catch up, see MakeRoomForWrite */
+struct CDBWriteStallStats
+{
+    /** 1ms delays because level 0 is about to fill up */
+    uint64_t nSlowdowns{0};
+    /** Waits for the compaction of the previous write buffer */
+    uint64_t nMemtableWaits{0};
+    /** Waits because level 0 is full */
+    uint64_t nL0Waits{0};
+    /** Total time writes were delayed */
+    uint64_t nStallMicros{0};
+};
+
 class CDBWrapper;
 
 /** These should be considered an implementation detail of the specific database.
@@ -43,6 +93,64 @@ void HandleError(const leveldb::Status& status);
  */
 const std::vector<unsigned char>& GetObfuscateKey(const CDBWrapper &w);
 
+/** Buffer of the calling thread for the values read by CDBWrapper::Read, which keeps its capacity between reads */
+std::string& GetReadBuffer();
+
+/**
+ * Stream for deserializing a value in place from a buffer owned by someone else (a block of LevelDB's cache or the read
+ * buffer), undoing the obfuscation while reading. The buffer and the key must stay valid for the lifetime of the reader.
+ */
+class CValueReader
+{
+private:
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos{0};
+    const std::vector<unsigned char>& m_key;
+
+public:
+    CValueReader(const leveldb::Slice& slValue, const std::vector<unsigned char>& key) :
+        m_data(slValue.data()), m_size(slValue.size()), m_key(key) {}
+
+    template<typename T>
+    CValueReader& operator>>(T&& obj)
+    {
+        ::Unserialize(*this, obj);
+        return *this;
+    }
+
+    int GetVersion() const { return CLIENT_VERSION; }
+    int GetType() const { return SER_DISK; }
+
+    size_t size() const { return m_size - m_pos; }
+    bool empty() const { return m_size == m_pos; }
+
+    void read(char* dst, size_t n)
+    {
+        if (n > m_size - m_pos) {
+            throw std::ios_base::failure("CValueReader::read(): end of data");
+        }
+        memcpy(dst, m_data + m_pos, n);
+        if (!m_key.empty()) {
+            for (size_t i = 0, j = m_pos % m_key.size(); i < n; i++) {
+                dst[i] ^= m_key[j++];
+                if (j == m_key.size()) {
+                    j = 0;
+                }
+            }
+        }
+        m_pos += n;
+    }
+
+    void ignore(size_t n)
+    {
+        if (n > m_size - m_pos) {
+            throw std::ios_base::failure("CValueReader::ignore(): end of data");
+        }
+        m_pos += n;
+    }
+};
+
 };
 
 /** Batch of changes queued to be written to a CDBWrapper */
@@ -54,8 +162,8 @@ private:
     const CDBWrapper &parent;
     leveldb::WriteBatch batch;
 
-    CDataStream ssKey;
-    CDataStream ssValue;
+    CPooledDataStream ssKey;
+    CPooledDataStream ssValue;
 
     size_t size_estimate;
 
@@ -80,8 +188,8 @@ public:
         ssKey.clear();
     }
 
-    template <typename V>
-    void Write(const CDataStream& _ssKey, const V& value)
+    template <typename SerializeData, typename V>
+    void Write(const CBaseDataStream<SerializeData>& _ssKey, const V& value)
     {
         leveldb::Slice slKey(_ssKey.data(), _ssKey.size());
 
@@ -109,7 +217,8 @@ public:
         ssKey.clear();
     }
 
-    void Erase(const CDataStream& _ssKey) {
+    template <typename SerializeData>
+    void Erase(const CBaseDataStream<SerializeData>& _ssKey) {
         leveldb::Slice slKey(_ssKey.data(), _ssKey.size());
 
         batch.Delete(slKey);
@@ -142,24 +251,27 @@ public:
     bool Valid() const;
 
     void SeekToFirst();
+    void SeekToLast();
 
     template<typename K> void Seek(const K& key) {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CPooledDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         Seek(ssKey);
     }
 
-    void Seek(const CDataStream& ssKey) {
+    template<typename SerializeData> void Seek(const CBaseDataStream<SerializeData>& ssKey) {
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
         piter->Seek(slKey);
     }
 
     void Next();
+    void Prev();
 
     template<typename K> bool GetKey(K& key) {
+        leveldb::Slice slKey = piter->key();
         try {
-            CDataStream ssKey = GetKey();
+            SpanReader ssKey(SER_DISK, CLIENT_VERSION, Span<const unsigned char>((const unsigned char*)slKey.data(), slKey.size()));
             ssKey >> key;
         } catch (const std::exception&) {
             return false;
@@ -177,10 +289,8 @@ public:
     }
 
     template<typename V> bool GetValue(V& value) {
-        leveldb::Slice slValue = piter->value();
         try {
-            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-            ssValue.Xor(dbwrapper_private::GetObfuscateKey(parent));
+            dbwrapper_private::CValueReader ssValue(piter->value(), dbwrapper_private::GetObfuscateKey(parent));
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -194,9 +304,27 @@ public:
 
 };
 
+/** A consistent, read-only view of the database, e.g. for reads spread over several iterators or threads */
+class CDBSnapshot
+{
+    friend class CDBWrapper;
+
+private:
+    const CDBWrapper &parent;
+    const leveldb::Snapshot* snapshot;
+
+public:
+    explicit CDBSnapshot(const CDBWrapper &_parent);
+    ~CDBSnapshot();
+
+    CDBSnapshot(const CDBSnapshot&) = delete;
+    CDBSnapshot& operator=(const CDBSnapshot&) = delete;
+};
+
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend class CDBSnapshot;
 private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
@@ -243,18 +371,21 @@ public:
      *                        with a zero'd byte array.
      */
     CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    /** @param[in] tuning  LevelDB settings to use instead of GetDBTuning() */
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBTuning& tuning);
     ~CDBWrapper();
 
-    template <typename K>
-    bool ReadDataStream(const K& key, CDataStream& ssValue) const
+    template <typename K, typename ValueData>
+    bool ReadDataStream(const K& key, CBaseDataStream<ValueData>& ssValue) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CPooledDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         return ReadDataStream(ssKey, ssValue);
     }
 
-    bool ReadDataStream(const CDataStream& ssKey, CDataStream& ssValue) const
+    template <typename KeyData, typename ValueData>
+    bool ReadDataStream(const CBaseDataStream<KeyData>& ssKey, CBaseDataStream<ValueData>& ssValue) const
     {
         leveldb::Slice slKey(ssKey.data(), ssKey.size());
 
@@ -266,7 +397,7 @@ public:
             LogPrintf("LevelDB read failure: %s\n", status.ToString());
             dbwrapper_private::HandleError(status);
         }
-        CDataStream ssValueTmp(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
+        CBaseDataStream<ValueData> ssValueTmp(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
         ssValueTmp.Xor(obfuscate_key);
         ssValue = std::move(ssValueTmp);
         return true;
@@ -275,21 +406,29 @@ public:
     template <typename K, typename V>
     bool Read(const K& key, V& value) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CPooledDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         return Read(ssKey, value);
     }
 
-    template <typename V>
-    bool Read(const CDataStream& ssKey, V& value) const
+    template <typename KeyData, typename V>
+    bool Read(const CBaseDataStream<KeyData>& ssKey, V& value) const
     {
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        if (!ReadDataStream(ssKey, ssValue)) {
-            return false;
+        leveldb::Slice slKey(ssKey.data(), ssKey.size());
+
+        // The value is deserialized right from the buffer LevelDB copied it into
+        std::string& strValue = dbwrapper_private::GetReadBuffer();
+        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        if (!status.ok()) {
+            if (status.IsNotFound())
+                return false;
+            LogPrintf("LevelDB read failure: %s\n", status.ToString());
+            dbwrapper_private::HandleError(status);
         }
 
         try {
+            dbwrapper_private::CValueReader ssValue(strValue, obfuscate_key);
             ssValue >> value;
         } catch (const std::exception&) {
             return false;
@@ -297,6 +436,59 @@ public:
         return true;
     }
 
+    /**
+     * Read the values of many keys at once. Instead of one Get() per key, the keys are looked up in sorted order by a
+     * single iterator, which sees one consistent state of the database and moves forward through the table blocks.
+     * found[i] tells whether values[i] was read. Returns the number of keys found.
+     */
+    template <typename K, typename V>
+    size_t ReadMulti(const std::vector<K>& keys, std::vector<V>& values, std::vector<bool>& found) const
+    {
+        std::vector<std::string> vKeys(keys.size());
+        std::vector<size_t> order(keys.size());
+        CPooledDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
+        for (size_t i = 0; i < keys.size(); i++) {
+            ssKey << keys[i];
+            vKeys[i].assign(ssKey.data(), ssKey.size());
+            ssKey.clear();
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return leveldb::Slice(vKeys[a]).compare(vKeys[b]) < 0;
+        });
+
+        values.resize(keys.size());
+        found.assign(keys.size(), false);
+        size_t nFound = 0;
+        std::unique_ptr<leveldb::Iterator> it(pdb->NewIterator(readoptions));
+        for (size_t i : order) {
+            const leveldb::Slice slKey(vKeys[i]);
+            // The iterator is at the first entry not before the previous key, no need to seek if that is not before
+            // this key either (e.g. duplicates)
+            if (!it->Valid() || it->key().compare(slKey) < 0) {
+                it->Seek(slKey);
+                if (!it->Valid()) {
+                    // Past the last entry, so are all remaining keys
+                    break;
+                }
+            }
+            if (it->key().compare(slKey) != 0) {
+                continue;
+            }
+            try {
+                dbwrapper_private::CValueReader ssValue(it->value(), obfuscate_key);
+                ssValue >> values[i];
+            } catch (const std::exception&) {
+                continue;
+            }
+            found[i] = true;
+            nFound++;
+        }
+        dbwrapper_private::HandleError(it->status());
+        return nFound;
+    }
+
     template <typename K, typename V>
     bool Write(const K& key, const V& value, bool fSync = false)
     {
@@ -308,13 +500,14 @@ public:
     template <typename K>
     bool Exists(const K& key) const
     {
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CPooledDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey << key;
         return Exists(ssKey);
     }
 
-    bool Exists(const CDataStream& key) const
+    template <typename SerializeData>
+    bool Exists(const CBaseDataStream<SerializeData>& key) const
     {
         leveldb::Slice slKey(key.data(), key.size());
 
@@ -342,6 +535,9 @@ public:
     // Get an estimate of LevelDB memory usage (in bytes).
     size_t DynamicMemoryUsage() const;
 
+    // Get the number of writes delayed by LevelDB since the database was opened.
+    CDBWriteStallStats GetWriteStallStats() const;
+
     // not available for LevelDB; provide for compatibility with BDB
     bool Flush()
     {
@@ -354,11 +550,20 @@ public:
         return WriteBatch(batch, true);
     }
 
-    CDBIterator *NewIterator()
+    CDBIterator *NewIterator() const
     {
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /** Iterate over the database as it was when the snapshot was taken */
+    CDBIterator *NewIterator(const CDBSnapshot& snapshot) const
+    {
+        assert(&snapshot.parent == this);
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = snapshot.snapshot;
+        return new CDBIterator(*this, pdb->NewIterator(options));
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -367,7 +572,7 @@ public:
     template<typename K>
     size_t EstimateSize(const K& key_begin, const K& key_end) const
     {
-        CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
+        CPooledDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
         ssKey1.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey1 << key_begin;
@@ -386,7 +591,7 @@ public:
     template<typename K>
     void CompactRange(const K& key_begin, const K& key_end) const
     {
-        CDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
+        CPooledDataStream ssKey1(SER_DISK, CLIENT_VERSION), ssKey2(SER_DISK, CLIENT_VERSION);
         ssKey1.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey2.reserve(DBWRAPPER_PREALLOC_KEY_SIZE);
         ssKey1 << key_begin;
@@ -475,8 +680,7 @@ public:
 
         if (curIsParent) {
             try {
-                // TODO try to avoid this copy (we need a stream that allows reading from external buffers)
-                CDataStream ssKey = parentKey;
+                SpanReader ssKey(SER_DISK, CLIENT_VERSION, Span<const unsigned char>((const unsigned char*)parentKey.data(), parentKey.size()));
                 ssKey >> key;
             } catch (const std::exception&) {
                 return false;
@@ -484,8 +688,7 @@ public:
             return true;
         } else {
             try {
-                // TODO try to avoid this copy (we need a stream that allows reading from external buffers)
-                CDataStream ssKey = transactionIt->first;
+                SpanReader ssKey(SER_DISK, CLIENT_VERSION, Span<const unsigned char>((const unsigned char*)transactionIt->first.data(), transactionIt->first.size()));
                 ssKey >> key;
             } catch (const std::exception&) {
                 return false;
@@ -579,6 +782,7 @@ protected:
         ValueHolder(size_t _memoryUsage) : memoryUsage(_memoryUsage) {}
         virtual ~ValueHolder() = default;
         virtual void Write(const CDataStream& ssKey, CommitTarget &parent) = 0;
+        virtual void WriteCopy(const CDataStream& ssKey, CommitTarget &parent) const = 0;
     };
     typedef std::unique_ptr<ValueHolder> ValueHolderPtr;
 
@@ -591,6 +795,9 @@ protected:
             // ValueHolderImpl instance. Commit() clears the write maps, so this ok.
             commitTarget.Write(ssKey, std::move(value));
         }
+        virtual void WriteCopy(const CDataStream& ssKey, CommitTarget &commitTarget) const {
+            commitTarget.Write(ssKey, value);
+        }
         V value;
     };
 
@@ -705,6 +912,16 @@ public:
         Clear();
     }
 
+    // Same as Commit(), but the writes and deletes stay in place (and readable) until Clear() is called
+    void CommitWithoutClear() {
+        for (const auto &k : deletes) {
+            commitTarget.Erase(k);
+        }
+        for (const auto &p : writes) {
+            p.second->WriteCopy(p.first, commitTarget);
+        }
+    }
+
     bool IsClean() {
         return writes.empty() && deletes.empty();
     }
@@ -15,6 +15,7 @@
 
 #include <evo/deterministicmns.h>
 #include <evo/mnauth.h>
+#include <evo/simplifiedmns.h>
 
 #include <llmq/quorums.h>
 #include <llmq/quorums_chainlocks.h>
@@ -73,6 +74,8 @@ void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, con
     llmq::quorumManager->UpdatedBlockTip(pindexNew, fInitialDownload);
     llmq::quorumDKGSessionManager->UpdatedBlockTip(pindexNew, fInitialDownload);
 
+    mnListDiffCache.UpdatedBlockTip(pindexNew);
+
     if (!fDisableGovernance) governance.UpdatedBlockTip(pindexNew, connman);
 }
 
@@ -88,6 +91,11 @@ void CDSNotificationInterface::TransactionRemovedFromMempool(const CTransactionR
     llmq::quorumInstantSendManager->TransactionRemovedFromMempool(ptx);
 }
 
+void CDSNotificationInterface::NotifyTransactionLock(const CTransactionRef& tx, const std::shared_ptr<const llmq::CInstantSendLock>& islock)
+{
+    llmq::chainLocksHandler->TransactionLocked(tx->GetHash());
+}
+
 void CDSNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted)
 {
     // TODO: Tempoarily ensure that mempool removals are notified before
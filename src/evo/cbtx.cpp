@@ -103,7 +103,7 @@ bool CalcCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindexPrev
     LOCK(deterministicMNManager->cs);
 
     static int64_t nTimeDMN = 0;
-    static int64_t nTimeSMNL = 0;
+    static int64_t nTimeDiff = 0;
     static int64_t nTimeMerkle = 0;
 
     int64_t nTime1 = GetTimeMicros();
@@ -118,32 +118,31 @@ bool CalcCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindexPrev
         int64_t nTime2 = GetTimeMicros(); nTimeDMN += nTime2 - nTime1;
         LogPrint(BCLog::BENCHMARK, "            - BuildNewListFromBlock: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeDMN * 0.000001);
 
-        CSimplifiedMNList sml(tmpMNList);
+        // The tree always represents mnListCached, so moving it to the new list only rehashes the leaves (and their
+        // paths) of MNs which were added or changed in a way that is visible in the SML
+        static CDeterministicMNList mnListCached;
+        static CSimplifiedMNListMerkleTree smlTreeCached;
 
-        int64_t nTime3 = GetTimeMicros(); nTimeSMNL += nTime3 - nTime2;
-        LogPrint(BCLog::BENCHMARK, "            - CSimplifiedMNList: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeSMNL * 0.000001);
+        auto diff = mnListCached.BuildDiff(tmpMNList);
 
-        static CSimplifiedMNList smlCached;
-        static uint256 merkleRootCached;
-        static bool mutatedCached{false};
+        int64_t nTime3 = GetTimeMicros(); nTimeDiff += nTime3 - nTime2;
+        LogPrint(BCLog::BENCHMARK, "            - BuildDiff: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeDiff * 0.000001);
 
-        if (sml.mnList == smlCached.mnList) {
-            merkleRootRet = merkleRootCached;
-            if (mutatedCached) {
-                return state.DoS(100, false, REJECT_INVALID, "mutated-cached-calc-cb-mnmerkleroot");
-            }
-            return true;
+        try {
+            smlTreeCached.ApplyDiff(mnListCached, tmpMNList, diff);
+            mnListCached = tmpMNList;
+        } catch (...) {
+            // don't leave the tree and the list it's supposed to represent out of sync
+            mnListCached = CDeterministicMNList();
+            smlTreeCached = CSimplifiedMNListMerkleTree();
+            throw;
         }
 
         bool mutated = false;
-        merkleRootRet = sml.CalcMerkleRoot(&mutated);
+        merkleRootRet = smlTreeCached.GetMerkleRoot(&mutated);
 
         int64_t nTime4 = GetTimeMicros(); nTimeMerkle += nTime4 - nTime3;
-        LogPrint(BCLog::BENCHMARK, "            - CalcMerkleRoot: %.2fms [%.2fs]\n", 0.001 * (nTime4 - nTime3), nTimeMerkle * 0.000001);
-
-        smlCached = std::move(sml);
-        merkleRootCached = merkleRootRet;
-        mutatedCached = mutated;
+        LogPrint(BCLog::BENCHMARK, "            - CSimplifiedMNListMerkleTree::ApplyDiff: %.2fms [%.2fs]\n", 0.001 * (nTime4 - nTime3), nTimeMerkle * 0.000001);
 
         if (mutated) {
             return state.DoS(100, false, REJECT_INVALID, "mutated-calc-cb-mnmerkleroot");
@@ -159,44 +158,24 @@ bool CalcCbTxMerkleRootMNList(const CBlock& block, const CBlockIndex* pindexPrev
 bool CalcCbTxMerkleRootQuorums(const CBlock& block, const CBlockIndex* pindexPrev, uint256& merkleRootRet, CValidationState& state)
 {
     static int64_t nTimeMinedAndActive = 0;
-    static int64_t nTimeMined = 0;
     static int64_t nTimeLoop = 0;
     static int64_t nTimeMerkle = 0;
 
     int64_t nTime1 = GetTimeMicros();
 
-    static std::map<Consensus::LLMQType, std::vector<const CBlockIndex*>> quorumsCached;
-    static std::map<Consensus::LLMQType, std::vector<uint256>> qcHashesCached;
-
-    // The returned quorums are in reversed order, so the most recent one is at index 0
-    auto quorums = llmq::quorumBlockProcessor->GetMinedAndActiveCommitmentsUntilBlock(pindexPrev);
+    // The returned hashes are in reversed order, so the most recent one is at index 0. These are usually just taken
+    // from the set which CQuorumBlockProcessor keeps up to date while connecting blocks
     std::map<Consensus::LLMQType, std::vector<uint256>> qcHashes;
+    if (!llmq::quorumBlockProcessor->GetMinedAndActiveCommitmentHashesUntilBlock(pindexPrev, qcHashes)) {
+        return state.DoS(100, false, REJECT_INVALID, "commitment-not-found");
+    }
     size_t hashCount = 0;
-
-    int64_t nTime2 = GetTimeMicros(); nTimeMinedAndActive += nTime2 - nTime1;
-    LogPrint(BCLog::BENCHMARK, "            - GetMinedAndActiveCommitmentsUntilBlock: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeMinedAndActive * 0.000001);
-
-    if (quorums == quorumsCached) {
-        qcHashes = qcHashesCached;
-    } else {
-        for (const auto& p : quorums) {
-            auto& v = qcHashes[p.first];
-            v.reserve(p.second.size());
-            for (const auto& p2 : p.second) {
-                llmq::CFinalCommitment qc;
-                uint256 minedBlockHash;
-                bool found = llmq::quorumBlockProcessor->GetMinedCommitment(p.first, p2->GetBlockHash(), qc, minedBlockHash);
-                if (!found) return state.DoS(100, false, REJECT_INVALID, "commitment-not-found");
-                v.emplace_back(::SerializeHash(qc));
-                hashCount++;
-            }
-        }
-        quorumsCached = quorums;
-        qcHashesCached = qcHashes;
+    for (const auto& p : qcHashes) {
+        hashCount += p.second.size();
     }
 
-    int64_t nTime3 = GetTimeMicros(); nTimeMined += nTime3 - nTime2;
-    LogPrint(BCLog::BENCHMARK, "            - GetMinedCommitment: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime2), nTimeMined * 0.000001);
+    int64_t nTime3 = GetTimeMicros(); nTimeMinedAndActive += nTime3 - nTime1;
+    LogPrint(BCLog::BENCHMARK, "            - GetMinedAndActiveCommitmentHashesUntilBlock: %.2fms [%.2fs]\n", 0.001 * (nTime3 - nTime1), nTimeMinedAndActive * 0.000001);
 
     // now add the commitments from the current block, which are not returned by GetMinedAndActiveCommitmentsUntilBlock
     // due to the use of pindexPrev (we don't have the tip index here)
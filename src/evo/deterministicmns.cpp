@@ -8,6 +8,8 @@
 #include <base58.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <memaccounting.h>
+#include <memusage.h>
 #include <script/standard.h>
 #include <ui_interface.h>
 #include <validation.h>
@@ -19,7 +21,9 @@
 #include <univalue.h>
 
 static const std::string DB_LIST_SNAPSHOT = "dmn_S";
+static const std::string DB_LIST_SNAPSHOT_COMPACT = "dmn_SC";
 static const std::string DB_LIST_DIFF = "dmn_D";
+static const std::string DB_LIST_PRUNED_HEIGHT = "dmn_PH";
 
 std::unique_ptr<CDeterministicMNManager> deterministicMNManager;
 
@@ -186,7 +190,7 @@ CDeterministicMNCPtr CDeterministicMNList::GetMNByInternalId(uint64_t internalId
     return GetMN(*proTxHash);
 }
 
-static int CompareByLastPaid_GetHeight(const CDeterministicMN& dmn)
+CDeterministicMNList::MnPaymentKey CDeterministicMNList::GetPaymentKey(const CDeterministicMN& dmn)
 {
     int height = dmn.pdmnState->nLastPaidHeight;
     if (dmn.pdmnState->nPoSeRevivedHeight != -1 && dmn.pdmnState->nPoSeRevivedHeight > height) {
@@ -194,57 +198,190 @@ static int CompareByLastPaid_GetHeight(const CDeterministicMN& dmn)
     } else if (height == 0) {
         height = dmn.pdmnState->nRegisteredHeight;
     }
-    return height;
+    return MnPaymentKey(height, dmn.proTxHash);
 }
 
-static bool CompareByLastPaid(const CDeterministicMN& _a, const CDeterministicMN& _b)
+/**
+ * immer's containers keep their entries inline in nodes of up to 32 entries, so an immer container of n entries is
+ * estimated as the entries themselves plus a node allocation with a pointer per entry for each 32 of them.
+ */
+template<typename T>
+static size_t ImmerUsage(size_t nEntries)
 {
-    int ah = CompareByLastPaid_GetHeight(_a);
-    int bh = CompareByLastPaid_GetHeight(_b);
-    if (ah == bh) {
-        return _a.proTxHash < _b.proTxHash;
-    } else {
-        return ah < bh;
+    return nEntries * sizeof(T) + memusage::MallocUsage(32 * sizeof(void*)) * ((nEntries + 31) / 32);
+}
+
+static size_t MNUsage(const CDeterministicMN& dmn)
+{
+    const CDeterministicMNState& state = *dmn.pdmnState;
+    return memusage::DynamicUsage(dmn.pdmnState) + memusage::DynamicUsage(state.scriptPayout) +
+           memusage::DynamicUsage(state.scriptOperatorPayout);
+}
+
+size_t CDeterministicMNList::DynamicMemoryUsage() const
+{
+    size_t ret = 0;
+    ret += ImmerUsage<MnMap::value_type>(mnMap.size());
+    for (const auto& p : mnMap) {
+        ret += memusage::DynamicUsage(p.second) + MNUsage(*p.second);
+    }
+    ret += ImmerUsage<MnInternalIdMap::value_type>(mnInternalIdMap.size());
+    ret += ImmerUsage<MnUniquePropertyMap::value_type>(mnUniquePropertyMap.size());
+    ret += ImmerUsage<MnPropertyIndex::value_type>(mnPropertyIndex.size());
+    for (const auto& p : mnPropertyIndex) {
+        ret += ImmerUsage<uint256>(p.second.size());
     }
+    ret += ImmerUsage<MnPaymentKey>(mnPaymentQueue.size());
+    auto validMNs = validMNsCache.Get();
+    if (validMNs) {
+        ret += memusage::DynamicUsage(validMNs) + memusage::DynamicUsage(*validMNs);
+    }
+    return ret;
 }
-static bool CompareByLastPaid(const CDeterministicMNCPtr& _a, const CDeterministicMNCPtr& _b)
+
+size_t CDeterministicMNListDiff::DynamicMemoryUsage() const
 {
-    return CompareByLastPaid(*_a, *_b);
+    size_t ret = memusage::DynamicUsage(addedMNs) + memusage::DynamicUsage(updatedMNs) + memusage::DynamicUsage(removedMns);
+    for (const auto& dmn : addedMNs) {
+        ret += memusage::DynamicUsage(dmn) + MNUsage(*dmn);
+    }
+    return ret;
 }
 
-CDeterministicMNCPtr CDeterministicMNList::GetMNPayee() const
+void CDeterministicMNList::AddToPaymentQueue(const CDeterministicMNCPtr& dmn)
 {
-    if (mnMap.size() == 0) {
-        return nullptr;
+    if (!IsMNValid(dmn)) {
+        return;
     }
+    auto key = GetPaymentKey(*dmn);
+    auto it = std::lower_bound(mnPaymentQueue.begin(), mnPaymentQueue.end(), key);
+    mnPaymentQueue = mnPaymentQueue.insert(it - mnPaymentQueue.begin(), key);
+}
 
-    CDeterministicMNCPtr best;
-    ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
-        if (!best || CompareByLastPaid(dmn, best)) {
-            best = dmn;
+void CDeterministicMNList::RemoveFromPaymentQueue(const CDeterministicMNCPtr& dmn)
+{
+    if (!IsMNValid(dmn)) {
+        return;
+    }
+    auto key = GetPaymentKey(*dmn);
+    auto it = std::lower_bound(mnPaymentQueue.begin(), mnPaymentQueue.end(), key);
+    assert(it != mnPaymentQueue.end() && *it == key);
+    mnPaymentQueue = mnPaymentQueue.erase(it - mnPaymentQueue.begin());
+}
+
+std::shared_ptr<const std::vector<CDeterministicMNCPtr>> CDeterministicMNList::GetValidMNs() const
+{
+    auto validMNs = validMNsCache.Get();
+    if (validMNs) {
+        return validMNs;
+    }
+
+    // Two threads might build it at the same time, both results are the same
+    auto newValidMNs = std::make_shared<std::vector<CDeterministicMNCPtr>>();
+    newValidMNs->reserve(mnPaymentQueue.size());
+    for (const auto& p : mnMap) {
+        if (IsMNValid(p.second)) {
+            newValidMNs->emplace_back(p.second);
         }
+    }
+    std::sort(newValidMNs->begin(), newValidMNs->end(), [](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
+        return a->proTxHash < b->proTxHash;
     });
+    validMNsCache.Set(newValidMNs);
+    return newValidMNs;
+}
 
-    return best;
+void CDeterministicMNList::AddToPropertyIndex(const uint256& hash, const uint256& proTxHash)
+{
+    auto oldSet = mnPropertyIndex.find(hash);
+    auto newSet = oldSet ? oldSet->insert(proTxHash) : immer::set<uint256>().insert(proTxHash);
+    mnPropertyIndex = mnPropertyIndex.set(hash, newSet);
 }
 
-std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetProjectedMNPayees(int nCount) const
+void CDeterministicMNList::RemoveFromPropertyIndex(const uint256& hash, const uint256& proTxHash)
 {
-    if (nCount > GetValidMNsCount()) {
-        nCount = GetValidMNsCount();
+    auto oldSet = mnPropertyIndex.find(hash);
+    assert(oldSet && oldSet->count(proTxHash));
+    if (oldSet->size() == 1) {
+        mnPropertyIndex = mnPropertyIndex.erase(hash);
+    } else {
+        mnPropertyIndex = mnPropertyIndex.set(hash, oldSet->erase(proTxHash));
     }
+}
 
-    std::vector<CDeterministicMNCPtr> result;
-    result.reserve(nCount);
+void CDeterministicMNList::AddToPropertyIndex(const CDeterministicMN& dmn)
+{
+    AddToPropertyIndex(GetPropertyIndexHash(PropertyIndexType::PAYOUT_SCRIPT, dmn.pdmnState->scriptPayout), dmn.proTxHash);
+    // most MNs have no operator payout, there is no point in one entry with all of them
+    if (dmn.pdmnState->scriptOperatorPayout != CScript()) {
+        AddToPropertyIndex(GetPropertyIndexHash(PropertyIndexType::OPERATOR_PAYOUT_SCRIPT, dmn.pdmnState->scriptOperatorPayout), dmn.proTxHash);
+    }
+    AddToPropertyIndex(GetPropertyIndexHash(PropertyIndexType::VOTING_KEY, dmn.pdmnState->keyIDVoting), dmn.proTxHash);
+}
 
-    ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
-        result.emplace_back(dmn);
-    });
-    std::sort(result.begin(), result.end(), [&](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
-        return CompareByLastPaid(a, b);
+void CDeterministicMNList::RemoveFromPropertyIndex(const CDeterministicMN& dmn)
+{
+    RemoveFromPropertyIndex(GetPropertyIndexHash(PropertyIndexType::PAYOUT_SCRIPT, dmn.pdmnState->scriptPayout), dmn.proTxHash);
+    if (dmn.pdmnState->scriptOperatorPayout != CScript()) {
+        RemoveFromPropertyIndex(GetPropertyIndexHash(PropertyIndexType::OPERATOR_PAYOUT_SCRIPT, dmn.pdmnState->scriptOperatorPayout), dmn.proTxHash);
+    }
+    RemoveFromPropertyIndex(GetPropertyIndexHash(PropertyIndexType::VOTING_KEY, dmn.pdmnState->keyIDVoting), dmn.proTxHash);
+}
+
+std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetMNsByPropertyHash(const uint256& hash) const
+{
+    std::vector<CDeterministicMNCPtr> result;
+    auto proTxHashes = mnPropertyIndex.find(hash);
+    if (!proTxHashes) {
+        return result;
+    }
+    result.reserve(proTxHashes->size());
+    for (const auto& proTxHash : *proTxHashes) {
+        result.emplace_back(GetMN(proTxHash));
+    }
+    std::sort(result.begin(), result.end(), [](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
+        return a->proTxHash < b->proTxHash;
     });
+    return result;
+}
 
-    result.resize(nCount);
+std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetMNsByPayoutScript(const CScript& script) const
+{
+    return GetMNsByPropertyHash(GetPropertyIndexHash(PropertyIndexType::PAYOUT_SCRIPT, script));
+}
+
+std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetMNsByOperatorPayoutScript(const CScript& script) const
+{
+    if (script == CScript()) {
+        return {};
+    }
+    return GetMNsByPropertyHash(GetPropertyIndexHash(PropertyIndexType::OPERATOR_PAYOUT_SCRIPT, script));
+}
+
+std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetMNsByVotingKey(const CKeyID& keyID) const
+{
+    return GetMNsByPropertyHash(GetPropertyIndexHash(PropertyIndexType::VOTING_KEY, keyID));
+}
+
+CDeterministicMNCPtr CDeterministicMNList::GetMNPayee() const
+{
+    if (mnPaymentQueue.empty()) {
+        return nullptr;
+    }
+    return GetMN(mnPaymentQueue.front().second);
+}
+
+std::vector<CDeterministicMNCPtr> CDeterministicMNList::GetProjectedMNPayees(int nCount) const
+{
+    if (nCount > (int)mnPaymentQueue.size()) {
+        nCount = mnPaymentQueue.size();
+    }
+
+    std::vector<CDeterministicMNCPtr> result;
+    result.reserve(nCount);
+    for (const auto& key : mnPaymentQueue.take(nCount)) {
+        result.emplace_back(GetMN(key.second));
+    }
 
     return result;
 }
@@ -253,18 +390,21 @@ std::vector<CDeterministicMNCPtr> CDeterministicMNList::CalculateQuorum(size_t m
 {
     auto scores = CalculateScores(modifier);
 
-    // sort is descending order
-    std::sort(scores.rbegin(), scores.rend(), [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
+    // descending order. Only the top maxSize entries need to be in order, so a partial sort is enough, which is
+    // considerably cheaper when the quorum is much smaller than the MN list
+    auto cmp = [](const std::pair<arith_uint256, CDeterministicMNCPtr>& a, const std::pair<arith_uint256, CDeterministicMNCPtr>& b) {
         if (a.first == b.first) {
             // this should actually never happen, but we should stay compatible with how the non deterministic MNs did the sorting
-            return a.second->collateralOutpoint < b.second->collateralOutpoint;
+            return b.second->collateralOutpoint < a.second->collateralOutpoint;
         }
-        return a.first < b.first;
-    });
+        return b.first < a.first;
+    };
+    size_t resultSize = std::min(maxSize, scores.size());
+    std::partial_sort(scores.begin(), scores.begin() + resultSize, scores.end(), cmp);
 
     // take top maxSize entries and return it
     std::vector<CDeterministicMNCPtr> result;
-    result.resize(std::min(maxSize, scores.size()));
+    result.resize(resultSize);
     for (size_t i = 0; i < result.size(); i++) {
         result[i] = std::move(scores[i].second);
     }
@@ -475,6 +615,9 @@ void CDeterministicMNList::AddMN(const CDeterministicMNCPtr& dmn, bool fBumpTota
 
     mnMap = mnMap.set(dmn->proTxHash, dmn);
     mnInternalIdMap = mnInternalIdMap.set(dmn->GetInternalId(), dmn->proTxHash);
+    AddToPaymentQueue(dmn);
+    AddToPropertyIndex(*dmn);
+    validMNsCache.Clear();
     if (fBumpTotalCount) {
         // nTotalRegisteredCount acts more like a checkpoint, not as a limit,
         nTotalRegisteredCount = std::max(dmn->GetInternalId() + 1, (uint64_t)nTotalRegisteredCount);
@@ -509,7 +652,19 @@ void CDeterministicMNList::UpdateMN(const CDeterministicMNCPtr& oldDmn, const CD
                 oldDmn->proTxHash.ToString(), pdmnState->pubKeyOperator.Get().ToString())));
     }
 
+    if (IsMNValid(oldDmn) != IsMNValid(dmn) || GetPaymentKey(*oldDmn) != GetPaymentKey(*dmn)) {
+        RemoveFromPaymentQueue(oldDmn);
+        AddToPaymentQueue(dmn);
+    }
+    if (oldState->scriptPayout != pdmnState->scriptPayout ||
+        oldState->scriptOperatorPayout != pdmnState->scriptOperatorPayout ||
+        oldState->keyIDVoting != pdmnState->keyIDVoting) {
+        RemoveFromPropertyIndex(*oldDmn);
+        AddToPropertyIndex(*dmn);
+    }
+
     mnMap = mnMap.set(oldDmn->proTxHash, dmn);
+    validMNsCache.Clear();
 }
 
 void CDeterministicMNList::UpdateMN(const uint256& proTxHash, const CDeterministicMNStateCPtr& pdmnState)
@@ -562,13 +717,23 @@ void CDeterministicMNList::RemoveMN(const uint256& proTxHash)
                 proTxHash.ToString(), dmn->pdmnState->pubKeyOperator.Get().ToString())));
     }
 
+    RemoveFromPaymentQueue(dmn);
+    RemoveFromPropertyIndex(*dmn);
     mnMap = mnMap.erase(proTxHash);
+    validMNsCache.Clear();
     mnInternalIdMap = mnInternalIdMap.erase(dmn->GetInternalId());
 }
 
 CDeterministicMNManager::CDeterministicMNManager(CEvoDB& _evoDb) :
     evoDb(_evoDb)
 {
+    evoDb.GetRawDB().Read(DB_LIST_PRUNED_HEIGHT, nListsPrunedHeight);
+    g_memory_accounting.Register("mnlists", this, [this]() { return DynamicMemoryUsage(); });
+}
+
+CDeterministicMNManager::~CDeterministicMNManager()
+{
+    g_memory_accounting.Unregister("mnlists", this);
 }
 
 bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& _state, const CCoinsViewCache& view, bool fJustCheck)
@@ -609,7 +774,7 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
 
         evoDb.Write(std::make_pair(DB_LIST_DIFF, newList.GetBlockHash()), diff);
         if ((nHeight % DISK_SNAPSHOT_PERIOD) == 0 || oldList.GetHeight() == -1) {
-            evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT, newList.GetBlockHash()), newList);
+            evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, newList.GetBlockHash()), CDeterministicMNListCompactSnapshot(newList));
             mnListsCache.emplace(newList.GetBlockHash(), newList);
             LogPrintf("CDeterministicMNManager::%s -- Wrote snapshot. nHeight=%d, mapCurMNs.allMNsCount=%d\n",
                 __func__, nHeight, newList.GetAllMNsCount());
@@ -617,6 +782,9 @@ bool CDeterministicMNManager::ProcessBlock(const CBlock& block, const CBlockInde
 
         diff.nHeight = pindex->nHeight;
         mnListDiffsCache.emplace(pindex->GetBlockHash(), diff);
+
+        // The next block will need it for its payment checks
+        mnPayeeCache.insert(newList.GetBlockHash(), newList.GetMNPayee());
     } catch (const std::exception& e) {
         LogPrintf("CDeterministicMNManager::%s -- internal error: %s\n", __func__, e.what());
         return _state.DoS(100, false, REJECT_INVALID, "failed-dmn-block");
@@ -663,6 +831,7 @@ bool CDeterministicMNManager::UndoBlock(const CBlock& block, const CBlockIndex*
 
         mnListsCache.erase(blockHash);
         mnListDiffsCache.erase(blockHash);
+        mnListCheckpoints.erase(blockHash);
     }
 
     if (diff.HasChanges()) {
@@ -954,6 +1123,14 @@ void CDeterministicMNManager::DecreasePoSePenalties(CDeterministicMNList& mnList
     }
 }
 
+void CDeterministicMNManager::AddSnapshotList(const CDeterministicMNList& mnList)
+{
+    LOCK(cs);
+
+    evoDb.Write(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, mnList.GetBlockHash()), CDeterministicMNListCompactSnapshot(mnList));
+    mnListsCache.emplace(mnList.GetBlockHash(), mnList);
+}
+
 CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex* pindex)
 {
     LOCK(cs);
@@ -961,6 +1138,8 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
     CDeterministicMNList snapshot;
     std::list<const CBlockIndex*> listDiffIndexes;
 
+    listCacheStats.nLookups++;
+
     while (true) {
         // try using cache before reading from disk
         auto itLists = mnListsCache.find(pindex->GetBlockHash());
@@ -969,8 +1148,23 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
             break;
         }
 
+        if (mnListCheckpoints.get(pindex->GetBlockHash(), snapshot)) {
+            listCacheStats.nCheckpointHits++;
+            break;
+        }
+
+        CDeterministicMNListCompactSnapshot compactSnapshot;
+        if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, pindex->GetBlockHash()), compactSnapshot)) {
+            snapshot = std::move(compactSnapshot.mnList);
+            mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+            listCacheStats.nSnapshotLoads++;
+            break;
+        }
+
+        // snapshots written by older versions
         if (evoDb.Read(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), snapshot)) {
             mnListsCache.emplace(pindex->GetBlockHash(), snapshot);
+            listCacheStats.nSnapshotLoads++;
             break;
         }
 
@@ -996,6 +1190,9 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
         pindex = pindex->pprev;
     }
 
+    // Long walks only happen for historic lists (e.g. protx diff or quorum queries), keep some of the intermediate
+    // lists so that the next lookup nearby only needs a few diffs
+    const bool fKeepCheckpoints = (int)listDiffIndexes.size() > LIST_CHECKPOINT_INTERVAL;
     for (const auto& diffIndex : listDiffIndexes) {
         const auto& diff = mnListDiffsCache.at(diffIndex->GetBlockHash());
         if (diff.HasChanges()) {
@@ -1004,7 +1201,11 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
             snapshot.SetBlockHash(diffIndex->GetBlockHash());
             snapshot.SetHeight(diffIndex->nHeight);
         }
+        if (fKeepCheckpoints && (diffIndex->nHeight % LIST_CHECKPOINT_INTERVAL) == 0) {
+            mnListCheckpoints.insert(diffIndex->GetBlockHash(), snapshot);
+        }
     }
+    listCacheStats.nDiffsApplied += listDiffIndexes.size();
 
     if (tipIndex) {
         // always keep a snapshot for the tip
@@ -1024,6 +1225,106 @@ CDeterministicMNList CDeterministicMNManager::GetListForBlock(const CBlockIndex*
     return snapshot;
 }
 
+size_t CDeterministicMNManager::PruneLists(const CBlockIndex* pindexKeep)
+{
+    AssertLockHeld(cs_main);
+
+    // the lists from pindexKeep on are built from the last disk snapshot at or below it, it and its diff stay
+    const CBlockIndex* pindexSnapshot = pindexKeep->GetAncestor(pindexKeep->nHeight - pindexKeep->nHeight % DISK_SNAPSHOT_PERIOD);
+
+    LOCK(cs);
+    if (pindexSnapshot == nullptr || pindexSnapshot->nHeight <= nListsPrunedHeight) {
+        return 0;
+    }
+    auto& db = evoDb.GetRawDB();
+    if (!db.Exists(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, pindexSnapshot->GetBlockHash())) &&
+        !db.Exists(std::make_pair(DB_LIST_SNAPSHOT, pindexSnapshot->GetBlockHash()))) {
+        // e.g. the snapshot period was changed, keep everything rather than losing the base of the lists
+        return 0;
+    }
+
+    size_t nCount = 0;
+    CDBBatch batch(db);
+    // stop at the first block without a diff, it's either below a previous prune or below the first processed block
+    for (const CBlockIndex* pindex = pindexSnapshot->pprev; pindex != nullptr; pindex = pindex->pprev) {
+        auto diffKey = std::make_pair(DB_LIST_DIFF, pindex->GetBlockHash());
+        if (!db.Exists(diffKey)) {
+            break;
+        }
+        batch.Erase(diffKey);
+        batch.Erase(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, pindex->GetBlockHash()));
+        batch.Erase(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()));
+        if (batch.SizeEstimate() >= (1 << 24)) {
+            db.WriteBatch(batch);
+            batch.Clear();
+        }
+        nCount++;
+    }
+    nListsPrunedHeight = pindexSnapshot->nHeight;
+    batch.Write(DB_LIST_PRUNED_HEIGHT, nListsPrunedHeight);
+    db.WriteBatch(batch);
+
+    for (auto it = mnListsCache.begin(); it != mnListsCache.end(); ) {
+        it = it->second.GetHeight() < nListsPrunedHeight ? mnListsCache.erase(it) : std::next(it);
+    }
+    for (auto it = mnListDiffsCache.begin(); it != mnListDiffsCache.end(); ) {
+        it = it->second.nHeight < nListsPrunedHeight ? mnListDiffsCache.erase(it) : std::next(it);
+    }
+    mnListCheckpoints.clear();
+
+    // the diffs are keyed by block hash, so the removed ones are spread over the whole range
+    nPrunedDiffsSinceCompaction += nCount;
+    if (nPrunedDiffsSinceCompaction >= PRUNED_DIFFS_COMPACT_THRESHOLD) {
+        db.CompactRange(std::make_pair(DB_LIST_DIFF, uint256()), std::make_pair(DB_LIST_DIFF, uint256S(std::string(64, 'f'))));
+        nPrunedDiffsSinceCompaction = 0;
+    }
+
+    LogPrintf("CDeterministicMNManager::%s -- removed %d diffs below height %d\n", __func__, nCount, nListsPrunedHeight);
+    return nCount;
+}
+
+bool CDeterministicMNManager::IsListPruned(const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    // the lists before DIP3 are empty and never had diffs
+    return pindex->nHeight < nListsPrunedHeight && pindex->nHeight >= Params().GetConsensus().DIP0003Height;
+}
+
+CDeterministicMNListCacheStats CDeterministicMNManager::GetListCacheStats()
+{
+    LOCK(cs);
+    CDeterministicMNListCacheStats stats = listCacheStats;
+    stats.nCachedLists = mnListsCache.size();
+    stats.nCheckpoints = mnListCheckpoints.size();
+    return stats;
+}
+
+size_t CDeterministicMNManager::DynamicMemoryUsage()
+{
+    // Each cached list shares all but the nodes touched by its diff with the list it was built from. So only the tip
+    // list is counted in full and for every other list the nodes of its changes, each of which copies a path of
+    // about 3 nodes of the list's main maps and the payment queue
+    static const size_t LIST_CHANGE_BYTES = 3 * 3 * memusage::MallocUsage(32 * sizeof(void*));
+
+    LOCK(cs);
+    size_t ret = memusage::DynamicUsage(mnListsCache) + memusage::DynamicUsage(mnListDiffsCache);
+    if (tipIndex != nullptr) {
+        auto it = mnListsCache.find(tipIndex->GetBlockHash());
+        if (it != mnListsCache.end()) {
+            ret += it->second.DynamicMemoryUsage();
+        }
+    }
+    for (const auto& p : mnListDiffsCache) {
+        const CDeterministicMNListDiff& diff = p.second;
+        ret += diff.DynamicMemoryUsage();
+        ret += (diff.addedMNs.size() + diff.updatedMNs.size() + diff.removedMns.size()) * LIST_CHANGE_BYTES;
+    }
+    // the checkpoints and payees are shared with the cached lists
+    ret += mnListCheckpoints.DynamicMemoryUsage([](const CDeterministicMNList&) { return 0; });
+    ret += mnPayeeCache.DynamicMemoryUsage([](const CDeterministicMNCPtr&) { return 0; });
+    return ret;
+}
+
 CDeterministicMNList CDeterministicMNManager::GetListAtChainTip()
 {
     LOCK(cs);
@@ -1033,6 +1334,30 @@ CDeterministicMNList CDeterministicMNManager::GetListAtChainTip()
     return GetListForBlock(tipIndex);
 }
 
+CDeterministicMNCPtr CDeterministicMNManager::GetMNPayee(const CBlockIndex* pindex)
+{
+    if (!pindex) {
+        return nullptr;
+    }
+
+    CDeterministicMNList mnList;
+    {
+        LOCK(cs);
+        CDeterministicMNCPtr dmnPayee;
+        if (mnPayeeCache.get(pindex->GetBlockHash(), dmnPayee)) {
+            return dmnPayee;
+        }
+        mnList = GetListForBlock(pindex);
+    }
+
+    // This walks the whole list, other lookups don't have to wait for it
+    CDeterministicMNCPtr dmnPayee = mnList.GetMNPayee();
+
+    LOCK(cs);
+    mnPayeeCache.insert(pindex->GetBlockHash(), dmnPayee);
+    return dmnPayee;
+}
+
 bool CDeterministicMNManager::IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n)
 {
     if (tx->nVersion != 3 || tx->nType != TRANSACTION_PROVIDER_REGISTER) {
@@ -1207,7 +1532,7 @@ bool CDeterministicMNManager::UpgradeDBIfNeeded()
         UpgradeDiff(batch, pindex, curMNList, newMNList);
 
         if ((nHeight % DISK_SNAPSHOT_PERIOD) == 0) {
-            batch.Write(std::make_pair(DB_LIST_SNAPSHOT, pindex->GetBlockHash()), newMNList);
+            batch.Write(std::make_pair(DB_LIST_SNAPSHOT_COMPACT, pindex->GetBlockHash()), CDeterministicMNListCompactSnapshot(newMNList));
             evoDb.GetRawDB().WriteBatch(batch);
             batch.Clear();
         }
@@ -13,10 +13,16 @@
 #include <evo/simplifiedmns.h>
 #include <saltedhasher.h>
 #include <sync.h>
+#include <unordered_lru_cache.h>
 
+#include <immer/flex_vector.hpp>
 #include <immer/map.hpp>
 #include <immer/map_transient.hpp>
+#include <immer/set.hpp>
 
+#include <algorithm>
+#include <map>
+#include <memory>
 #include <unordered_map>
 
 class CBlock;
@@ -34,6 +40,7 @@ private:
     int nPoSeBanHeight{-1};
 
     friend class CDeterministicMNStateDiff;
+    friend class CDeterministicMNListCompactSnapshot;
 
 public:
     int nRegisteredHeight{-1};
@@ -309,6 +316,10 @@ public:
     typedef immer::map<uint256, CDeterministicMNCPtr> MnMap;
     typedef immer::map<uint64_t, uint256> MnInternalIdMap;
     typedef immer::map<uint256, std::pair<uint256, uint32_t> > MnUniquePropertyMap;
+    typedef immer::map<uint256, immer::set<uint256> > MnPropertyIndex;
+    /** Height from which a MN waits for its next payment, then its proTxHash */
+    typedef std::pair<int, uint256> MnPaymentKey;
+    typedef immer::flex_vector<MnPaymentKey> MnPaymentQueue;
 
 private:
     uint256 blockHash;
@@ -321,6 +332,39 @@ private:
     // we keep track of this as checking for duplicates would otherwise be painfully slow
     MnUniquePropertyMap mnUniquePropertyMap;
 
+    // secondary index of the properties which are shared by multiple MNs, from the hash of a typed property (see
+    // GetPropertyIndexHash) to the proTxHashes of the MNs which have it
+    MnPropertyIndex mnPropertyIndex;
+
+    // The valid MNs in the order in which they get paid, sorted by MnPaymentKey. Like the maps it shares its
+    // structure with the lists it was copied from, so keeping it up to date costs O(log n) per changed MN.
+    MnPaymentQueue mnPaymentQueue;
+
+    /**
+     * The valid MNs sorted by proTxHash, built on the first ForEachMN(true, ...) and dropped when the list changes.
+     * Copies of the list share it until one of them changes. As const lists are read from multiple threads, the
+     * pointer is only accessed atomically.
+     */
+    class CValidMNsCache
+    {
+    private:
+        mutable std::shared_ptr<const std::vector<CDeterministicMNCPtr>> ptr;
+
+    public:
+        CValidMNsCache() = default;
+        CValidMNsCache(const CValidMNsCache& other) : ptr(other.Get()) {}
+        CValidMNsCache& operator=(const CValidMNsCache& other)
+        {
+            Set(other.Get());
+            return *this;
+        }
+
+        std::shared_ptr<const std::vector<CDeterministicMNCPtr>> Get() const { return std::atomic_load(&ptr); }
+        void Set(std::shared_ptr<const std::vector<CDeterministicMNCPtr>> p) const { std::atomic_store(&ptr, std::move(p)); }
+        void Clear() { Set(nullptr); }
+    };
+    CValidMNsCache validMNsCache;
+
 public:
     CDeterministicMNList() = default;
     explicit CDeterministicMNList(const uint256& _blockHash, int _height, uint32_t _totalRegisteredCount) :
@@ -354,6 +398,9 @@ public:
         mnMap = MnMap();
         mnUniquePropertyMap = MnUniquePropertyMap();
         mnInternalIdMap = MnInternalIdMap();
+        mnPaymentQueue = MnPaymentQueue();
+        mnPropertyIndex = MnPropertyIndex();
+        validMNsCache.Clear();
 
         SerializationOpBase(s, CSerActionUnserialize());
 
@@ -371,22 +418,31 @@ public:
 
     size_t GetValidMNsCount() const
     {
-        size_t count = 0;
-        for (const auto& p : mnMap) {
-            if (IsMNValid(p.second)) {
-                count++;
-            }
-        }
-        return count;
+        return mnPaymentQueue.size();
     }
 
+    /**
+     * Estimate of the memory used by the list and its MNs as if it shared nothing with other lists. Copies of a list
+     * share all of it until they are modified.
+     */
+    size_t DynamicMemoryUsage() const;
+
+    /**
+     * Calls cb for all MNs or only for the valid ones. The valid ones are visited in the order of their proTxHash, from
+     * a contiguous vector which is shared by the copies of this list.
+     */
     template <typename Callback>
     void ForEachMN(bool onlyValid, Callback&& cb) const
     {
-        for (const auto& p : mnMap) {
-            if (!onlyValid || IsMNValid(p.second)) {
-                cb(p.second);
+        if (onlyValid) {
+            auto validMNs = GetValidMNs();
+            for (const auto& dmn : *validMNs) {
+                cb(dmn);
             }
+            return;
+        }
+        for (const auto& p : mnMap) {
+            cb(p.second);
         }
     }
 
@@ -513,6 +569,13 @@ public:
         return GetMN(p->first);
     }
 
+    /** @name Lookups through the secondary index, the MNs are sorted by proTxHash
+        @{*/
+    std::vector<CDeterministicMNCPtr> GetMNsByPayoutScript(const CScript& script) const;
+    std::vector<CDeterministicMNCPtr> GetMNsByOperatorPayoutScript(const CScript& script) const;
+    std::vector<CDeterministicMNCPtr> GetMNsByVotingKey(const CKeyID& keyID) const;
+    /*@}*/
+
 private:
     template <typename T>
     NODISCARD bool AddUniqueProperty(const CDeterministicMNCPtr& dmn, const T& v)
@@ -571,6 +634,224 @@ private:
         }
         return true;
     }
+
+    static MnPaymentKey GetPaymentKey(const CDeterministicMN& dmn);
+    void AddToPaymentQueue(const CDeterministicMNCPtr& dmn);
+    void RemoveFromPaymentQueue(const CDeterministicMNCPtr& dmn);
+
+    std::shared_ptr<const std::vector<CDeterministicMNCPtr>> GetValidMNs() const;
+
+    enum class PropertyIndexType : uint8_t {
+        PAYOUT_SCRIPT = 0,
+        OPERATOR_PAYOUT_SCRIPT = 1,
+        VOTING_KEY = 2,
+    };
+    template <typename T>
+    static uint256 GetPropertyIndexHash(PropertyIndexType type, const T& v)
+    {
+        // the type is part of the hash as e.g. payout and operator payout are both scripts
+        return ::SerializeHash(std::make_pair((uint8_t)type, v));
+    }
+    void AddToPropertyIndex(const CDeterministicMN& dmn);
+    void RemoveFromPropertyIndex(const CDeterministicMN& dmn);
+    void AddToPropertyIndex(const uint256& hash, const uint256& proTxHash);
+    void RemoveFromPropertyIndex(const uint256& hash, const uint256& proTxHash);
+    std::vector<CDeterministicMNCPtr> GetMNsByPropertyHash(const uint256& hash) const;
+};
+
+/**
+ * Compact on-disk format for CDeterministicMNList snapshots.
+ *
+ * Payout scripts are stored once in a dictionary and referenced by index, MNs are ordered by internalId which is
+ * then delta encoded, integers are varints, keyIDVoting is omitted when it equals keyIDOwner and
+ * confirmedHashWithProRegTxHash is recalculated on load. Starts with a version byte, unknown versions fail to load.
+ */
+class CDeterministicMNListCompactSnapshot
+{
+public:
+    static const uint8_t CURRENT_VERSION = 1;
+
+    enum Flags : uint8_t {
+        FLAG_VOTING_IS_OWNER = 0x01,
+        FLAG_EXPLICIT_CONFIRMED_HASH_WITH_PRO_REG_TX_HASH = 0x02,
+    };
+
+    CDeterministicMNList mnList;
+
+public:
+    CDeterministicMNListCompactSnapshot() = default;
+    explicit CDeterministicMNListCompactSnapshot(const CDeterministicMNList& _mnList) : mnList(_mnList) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        std::vector<CDeterministicMNCPtr> vMNs;
+        vMNs.reserve(mnList.GetAllMNsCount());
+        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+            vMNs.emplace_back(dmn);
+        });
+        std::sort(vMNs.begin(), vMNs.end(), [](const CDeterministicMNCPtr& a, const CDeterministicMNCPtr& b) {
+            return a->GetInternalId() < b->GetInternalId();
+        });
+
+        std::map<CScript, uint32_t> mapScriptIndexes;
+        std::vector<CScript> vScripts;
+        for (const auto& dmn : vMNs) {
+            for (const auto* script : {&dmn->pdmnState->scriptPayout, &dmn->pdmnState->scriptOperatorPayout}) {
+                if (mapScriptIndexes.emplace(*script, (uint32_t)vScripts.size()).second) {
+                    vScripts.emplace_back(*script);
+                }
+            }
+        }
+
+        s << CURRENT_VERSION;
+        s << mnList.GetBlockHash();
+        s << mnList.GetHeight();
+        s << mnList.GetTotalRegisteredCount();
+        s << vScripts;
+
+        WriteCompactSize(s, vMNs.size());
+        uint64_t nPrevInternalId = 0;
+        for (const auto& dmn : vMNs) {
+            const auto& state = *dmn->pdmnState;
+
+            uint8_t nFlags = 0;
+            if (state.keyIDVoting == state.keyIDOwner) {
+                nFlags |= FLAG_VOTING_IS_OWNER;
+            }
+            if (state.confirmedHashWithProRegTxHash != CalcConfirmedHashWithProRegTxHash(dmn->proTxHash, state.confirmedHash)) {
+                nFlags |= FLAG_EXPLICIT_CONFIRMED_HASH_WITH_PRO_REG_TX_HASH;
+            }
+            s << nFlags;
+
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint64_t>(s, dmn->GetInternalId() - nPrevInternalId);
+            nPrevInternalId = dmn->GetInternalId();
+            s << dmn->proTxHash;
+            s << dmn->collateralOutpoint.hash;
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s, dmn->collateralOutpoint.n);
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint16_t>(s, dmn->nOperatorReward);
+
+            WriteHeight(s, state.nRegisteredHeight);
+            WriteHeight(s, state.nLastPaidHeight);
+            WriteHeight(s, state.nPoSePenalty);
+            WriteHeight(s, state.nPoSeRevivedHeight);
+            WriteHeight(s, state.nPoSeBanHeight);
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint16_t>(s, state.nRevocationReason);
+            s << state.confirmedHash;
+            if (nFlags & FLAG_EXPLICIT_CONFIRMED_HASH_WITH_PRO_REG_TX_HASH) {
+                s << state.confirmedHashWithProRegTxHash;
+            }
+            s << state.keyIDOwner;
+            s << state.pubKeyOperator;
+            if (!(nFlags & FLAG_VOTING_IS_OWNER)) {
+                s << state.keyIDVoting;
+            }
+            s << state.addr;
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s, mapScriptIndexes.at(state.scriptPayout));
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s, mapScriptIndexes.at(state.scriptOperatorPayout));
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint8_t nVersion;
+        s >> nVersion;
+        if (nVersion != CURRENT_VERSION) {
+            throw std::ios_base::failure(strprintf("unsupported compact MN list snapshot version %d", nVersion));
+        }
+
+        uint256 blockHash;
+        int nHeight;
+        uint32_t nTotalRegisteredCount;
+        std::vector<CScript> vScripts;
+        s >> blockHash;
+        s >> nHeight;
+        s >> nTotalRegisteredCount;
+        s >> vScripts;
+
+        auto readScript = [&]() -> const CScript& {
+            uint32_t nIndex = ReadVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s);
+            if (nIndex >= vScripts.size()) {
+                throw std::ios_base::failure("invalid script index in compact MN list snapshot");
+            }
+            return vScripts[nIndex];
+        };
+
+        mnList = CDeterministicMNList(blockHash, nHeight, nTotalRegisteredCount);
+
+        size_t cnt = ReadCompactSize(s);
+        uint64_t nInternalId = 0;
+        for (size_t i = 0; i < cnt; i++) {
+            uint8_t nFlags;
+            s >> nFlags;
+
+            nInternalId += ReadVarInt<Stream, VarIntMode::DEFAULT, uint64_t>(s);
+            auto dmn = std::make_shared<CDeterministicMN>(nInternalId);
+            s >> dmn->proTxHash;
+            s >> dmn->collateralOutpoint.hash;
+            dmn->collateralOutpoint.n = ReadVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s);
+            dmn->nOperatorReward = ReadVarInt<Stream, VarIntMode::DEFAULT, uint16_t>(s);
+
+            auto state = std::make_shared<CDeterministicMNState>();
+            state->nRegisteredHeight = ReadHeight(s);
+            state->nLastPaidHeight = ReadHeight(s);
+            state->nPoSePenalty = ReadHeight(s);
+            state->nPoSeRevivedHeight = ReadHeight(s);
+            state->nPoSeBanHeight = ReadHeight(s);
+            state->nRevocationReason = ReadVarInt<Stream, VarIntMode::DEFAULT, uint16_t>(s);
+            s >> state->confirmedHash;
+            if (nFlags & FLAG_EXPLICIT_CONFIRMED_HASH_WITH_PRO_REG_TX_HASH) {
+                s >> state->confirmedHashWithProRegTxHash;
+            } else {
+                state->confirmedHashWithProRegTxHash = CalcConfirmedHashWithProRegTxHash(dmn->proTxHash, state->confirmedHash);
+            }
+            s >> state->keyIDOwner;
+            s >> state->pubKeyOperator;
+            if (nFlags & FLAG_VOTING_IS_OWNER) {
+                state->keyIDVoting = state->keyIDOwner;
+            } else {
+                s >> state->keyIDVoting;
+            }
+            s >> state->addr;
+            state->scriptPayout = readScript();
+            state->scriptOperatorPayout = readScript();
+            dmn->pdmnState = state;
+
+            mnList.AddMN(dmn, false);
+        }
+    }
+
+private:
+    static uint256 CalcConfirmedHashWithProRegTxHash(const uint256& proTxHash, const uint256& confirmedHash)
+    {
+        if (confirmedHash.IsNull()) {
+            return uint256();
+        }
+        CDeterministicMNState tmp;
+        tmp.UpdateConfirmedHash(proTxHash, confirmedHash);
+        return tmp.confirmedHashWithProRegTxHash;
+    }
+
+    // Heights (and the PoSe penalty) are >= -1, so these are stored with an offset of 1
+    template<typename Stream>
+    static void WriteHeight(Stream& s, int nHeight)
+    {
+        if (nHeight < -1) {
+            throw std::ios_base::failure(strprintf("can't store %d in compact MN list snapshot", nHeight));
+        }
+        WriteVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s, (uint32_t)(nHeight + 1));
+    }
+
+    template<typename Stream>
+    static int ReadHeight(Stream& s)
+    {
+        uint32_t n = ReadVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s);
+        if (n > (uint32_t)std::numeric_limits<int>::max()) {
+            throw std::ios_base::failure("invalid height in compact MN list snapshot");
+        }
+        return (int)n - 1;
+    }
 };
 
 class CDeterministicMNListDiff
@@ -627,6 +908,8 @@ public:
     {
         return !addedMNs.empty() || !updatedMNs.empty() || !removedMns.empty();
     }
+
+    size_t DynamicMemoryUsage() const;
 };
 
 // TODO can be removed in a future version
@@ -663,11 +946,30 @@ public:
     }
 };
 
+struct CDeterministicMNListCacheStats {
+    uint64_t nLookups{0};
+    // lookups which had to start from a snapshot on disk
+    uint64_t nSnapshotLoads{0};
+    // lookups which could start from a checkpoint instead of the snapshot
+    uint64_t nCheckpointHits{0};
+    uint64_t nDiffsApplied{0};
+    size_t nCachedLists{0};
+    size_t nCheckpoints{0};
+};
+
 class CDeterministicMNManager
 {
     static const int DISK_SNAPSHOT_PERIOD = 576; // once per day
     static const int DISK_SNAPSHOTS = 3; // keep cache for 3 disk snapshots to have 2 full days covered
     static const int LIST_DIFFS_CACHE_SIZE = DISK_SNAPSHOT_PERIOD * DISK_SNAPSHOTS;
+    // when a list has to be rebuilt from more diffs than this, the intermediate lists at heights that are a multiple
+    // of it are kept as checkpoints for later lookups
+    static const int LIST_CHECKPOINT_INTERVAL = 32;
+    // lists share most of their data with their neighbours, so this is much less than a full list per checkpoint
+    static const size_t MAX_LIST_CHECKPOINTS = 512;
+    static const size_t MN_PAYEE_CACHE_SIZE = 1024;
+    // PruneLists compacts the diffs once it removed this many since the last compaction
+    static const size_t PRUNED_DIFFS_COMPACT_THRESHOLD = DISK_SNAPSHOT_PERIOD * 30;
 
 public:
     CCriticalSection cs;
@@ -677,10 +979,18 @@ private:
 
     std::unordered_map<uint256, CDeterministicMNList, StaticSaltedHasher> mnListsCache;
     std::unordered_map<uint256, CDeterministicMNListDiff, StaticSaltedHasher> mnListDiffsCache;
+    unordered_lru_cache<uint256, CDeterministicMNList, StaticSaltedHasher, MAX_LIST_CHECKPOINTS> mnListCheckpoints;
+    // payees of the lists of blocks, i.e. the masternodes the blocks after them have to pay
+    unordered_lru_cache<uint256, CDeterministicMNCPtr, StaticSaltedHasher, MN_PAYEE_CACHE_SIZE> mnPayeeCache;
+    CDeterministicMNListCacheStats listCacheStats;
     const CBlockIndex* tipIndex{nullptr};
+    // the diffs and snapshots of the lists below this height were removed by PruneLists
+    int nListsPrunedHeight{-1};
+    size_t nPrunedDiffsSinceCompaction{0};
 
 public:
     explicit CDeterministicMNManager(CEvoDB& _evoDb);
+    ~CDeterministicMNManager();
 
     bool ProcessBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, const CCoinsViewCache& view, bool fJustCheck);
     bool UndoBlock(const CBlock& block, const CBlockIndex* pindex);
@@ -694,6 +1004,20 @@ public:
 
     CDeterministicMNList GetListForBlock(const CBlockIndex* pindex);
     CDeterministicMNList GetListAtChainTip();
+    // Same as GetListForBlock(pindex).GetMNPayee(), but cached. Can be called from several threads at once
+    CDeterministicMNCPtr GetMNPayee(const CBlockIndex* pindex);
+    CDeterministicMNListCacheStats GetListCacheStats();
+    // Estimate of the memory used by the cached lists, diffs and payees
+    size_t DynamicMemoryUsage();
+
+    // Store a list loaded from a UTXO snapshot, the blocks before it were never processed. The caller must hold an evoDb transaction
+    void AddSnapshotList(const CDeterministicMNList& mnList);
+
+    // Removes the diffs and snapshots which are only needed for the lists of the blocks below pindexKeep. Works on the
+    // committed DB, so the current evoDb transaction must not have pending changes. Returns the number of removed diffs
+    size_t PruneLists(const CBlockIndex* pindexKeep);
+    // True if the list of pindex can't be rebuilt anymore as its diffs were pruned
+    bool IsListPruned(const CBlockIndex* pindex);
 
     // Test if given TX is a ProRegTx which also contains the collateral at index n
     static bool IsProTxWithCollateral(const CTransactionRef& tx, uint32_t n);
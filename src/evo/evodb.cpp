@@ -34,7 +34,8 @@ void CEvoDBScopedCommitter::Rollback()
 CEvoDB::CEvoDB(size_t nCacheSize, bool fMemory, bool fWipe) :
     db(fMemory ? "" : (GetDataDir() / "evodb"), nCacheSize, fMemory, fWipe),
     rootBatch(db),
-    rootDBTransaction(db, rootBatch),
+    committingDBTransaction(db, rootBatch),
+    rootDBTransaction(committingDBTransaction, committingDBTransaction),
     curDBTransaction(rootDBTransaction, rootDBTransaction)
 {
 }
@@ -53,11 +54,23 @@ void CEvoDB::RollbackCurTransaction()
 
 bool CEvoDB::CommitRootTransaction()
 {
-    LOCK(cs);
-    assert(curDBTransaction.IsClean());
-    rootDBTransaction.Commit();
+    LOCK(csCommit);
+
+    {
+        LOCK(cs);
+        assert(curDBTransaction.IsClean());
+        assert(committingDBTransaction.IsClean());
+        rootDBTransaction.Commit();
+        committingDBTransaction.CommitWithoutClear();
+    }
+
+    // Writing to disk is the slow part, don't block readers meanwhile. Everything in rootBatch can still be read
+    // from committingDBTransaction until it's on disk
     bool ret = db.WriteBatch(rootBatch);
     rootBatch.Clear();
+
+    LOCK(cs);
+    committingDBTransaction.Clear();
     return ret;
 }
 
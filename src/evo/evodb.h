@@ -36,10 +36,15 @@ public:
 private:
     CDBWrapper db;
 
-    typedef CDBTransaction<CDBWrapper, CDBBatch> RootTransaction;
+    typedef CDBTransaction<CDBWrapper, CDBBatch> CommittingTransaction;
+    typedef CDBTransaction<CommittingTransaction, CommittingTransaction> RootTransaction;
     typedef CDBTransaction<RootTransaction, RootTransaction> CurTransaction;
 
+    // Serializes CommitRootTransaction() calls, which write to disk without holding cs
+    CCriticalSection csCommit;
     CDBBatch rootBatch;
+    // Holds the root transaction while CommitRootTransaction() writes it to disk, so that it stays readable
+    CommittingTransaction committingDBTransaction;
     RootTransaction rootDBTransaction;
     CurTransaction curDBTransaction;
 
@@ -93,7 +98,7 @@ public:
 
     size_t GetMemoryUsage()
     {
-        return rootDBTransaction.GetMemoryUsage();
+        return rootDBTransaction.GetMemoryUsage() + committingDBTransaction.GetMemoryUsage();
     }
 
     bool CommitRootTransaction();
@@ -4,7 +4,9 @@
 
 #include <evo/mnauth.h>
 
+#include <bls/bls_worker.h>
 #include <evo/deterministicmns.h>
+#include <llmq/quorums_init.h>
 #include <llmq/quorums_utils.h>
 #include <masternode/activemasternode.h>
 #include <masternode/masternode-meta.h>
@@ -123,82 +125,97 @@ void CMNAuth::ProcessMessage(CNode* pnode, const std::string& strCommand, CDataS
             LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- constructed signHash for nVersion %d, peer=%d\n", __func__, pnode->nVersion, pnode->GetId());
         }
 
-        if (!mnauth.sig.VerifyInsecure(dmn->pdmnState->pubKeyOperator.Get(), signHash)) {
-            LOCK(cs_main);
-            // Same as above, MN seems to not know its fate yet, so give it a chance to update. If this is a
-            // malicious node (DoSing us), it'll get banned soon.
-            Misbehaving(pnode->GetId(), 10, "mnauth signature verification failed");
+        // Verified on the BLS worker, where the MNAUTHs of many new connections (e.g. at the start of a DKG) are
+        // checked in batches. The node's next messages wait for the result, they might need it
+        const uint256 proRegTxHash = mnauth.proRegTxHash;
+        const uint256 pubKeyHash = dmn->pdmnState->pubKeyOperator.GetHash();
+        pnode->fPendingMNAuth = true;
+        pnode->AddRef();
+        llmq::blsWorker->AsyncVerifySig(mnauth.sig, dmn->pdmnState->pubKeyOperator.Get(), signHash, [pnode, proRegTxHash, pubKeyHash, &connman](bool fValid) {
+            ProcessVerifiedMNAUTH(pnode, proRegTxHash, pubKeyHash, fValid, connman);
+            pnode->fPendingMNAuth = false;
+            pnode->Release();
+            connman.WakeMessageHandler();
+        });
+    }
+}
+
+void CMNAuth::ProcessVerifiedMNAUTH(CNode* pnode, const uint256& proRegTxHash, const uint256& pubKeyHash, bool fValid, CConnman& connman)
+{
+    // the results come in on several worker threads, the check for an existing connection of the same MN and the
+    // verification of this one must not interleave with the ones of another connection
+    static CCriticalSection cs_verified;
+    LOCK(cs_verified);
+
+    if (!fValid) {
+        LOCK(cs_main);
+        // Same as for a missing MN, it seems to not know its fate yet, so give it a chance to update. If this is a
+        // malicious node (DoSing us), it'll get banned soon.
+        Misbehaving(pnode->GetId(), 10, "mnauth signature verification failed");
+        return;
+    }
+
+    if (!pnode->fInbound) {
+        mmetaman.GetMetaInfo(proRegTxHash)->SetLastOutboundSuccess(GetAdjustedTime());
+        if (pnode->m_masternode_probe_connection) {
+            LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- Masternode probe successful for %s, disconnecting. peer=%d\n", __func__,
+                     proRegTxHash.ToString(), pnode->GetId());
+            pnode->fDisconnect = true;
             return;
         }
+    }
 
-        if (!pnode->fInbound) {
-            mmetaman.GetMetaInfo(mnauth.proRegTxHash)->SetLastOutboundSuccess(GetAdjustedTime());
-            if (pnode->m_masternode_probe_connection) {
-                LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode probe successful for %s, disconnecting. peer=%d\n",
-                         mnauth.proRegTxHash.ToString(), pnode->GetId());
-                pnode->fDisconnect = true;
-                return;
-            }
+    connman.ForEachVerifiedMasternodeNode(proRegTxHash, [&](CNode* pnode2) {
+        if (pnode->fDisconnect) {
+            // we've already disconnected the new peer
+            return;
         }
 
-        connman.ForEachNode([&](CNode* pnode2) {
-            if (pnode->fDisconnect) {
-                // we've already disconnected the new peer
-                return;
-            }
-
-            if (pnode2->verifiedProRegTxHash == mnauth.proRegTxHash) {
-                if (fMasternodeMode) {
-                    auto deterministicOutbound = llmq::CLLMQUtils::DeterministicOutboundConnection(activeMasternodeInfo.proTxHash, mnauth.proRegTxHash);
-                    LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode %s has already verified as peer %d, deterministicOutbound=%s. peer=%d\n",
-                             mnauth.proRegTxHash.ToString(), pnode2->GetId(), deterministicOutbound.ToString(), pnode->GetId());
-                    if (deterministicOutbound == activeMasternodeInfo.proTxHash) {
-                        if (pnode2->fInbound) {
-                            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping old inbound, peer=%d\n", pnode2->GetId());
-                            pnode2->fDisconnect = true;
-                        } else if (pnode->fInbound) {
-                            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping new inbound, peer=%d\n", pnode->GetId());
-                            pnode->fDisconnect = true;
-                        }
-                    } else {
-                        if (!pnode2->fInbound) {
-                            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping old outbound, peer=%d\n", pnode2->GetId());
-                            pnode2->fDisconnect = true;
-                        } else if (!pnode->fInbound) {
-                            LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- dropping new outbound, peer=%d\n", pnode->GetId());
-                            pnode->fDisconnect = true;
-                        }
-                    }
-                } else {
-                    LogPrint(BCLog::NET_NETCONN, "CMNAuth::ProcessMessage -- Masternode %s has already verified as peer %d, dropping new connection. peer=%d\n",
-                            mnauth.proRegTxHash.ToString(), pnode2->GetId(), pnode->GetId());
+        if (fMasternodeMode) {
+            auto deterministicOutbound = llmq::CLLMQUtils::DeterministicOutboundConnection(activeMasternodeInfo.proTxHash, proRegTxHash);
+            LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- Masternode %s has already verified as peer %d, deterministicOutbound=%s. peer=%d\n", __func__,
+                     proRegTxHash.ToString(), pnode2->GetId(), deterministicOutbound.ToString(), pnode->GetId());
+            if (deterministicOutbound == activeMasternodeInfo.proTxHash) {
+                if (pnode2->fInbound) {
+                    LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- dropping old inbound, peer=%d\n", __func__, pnode2->GetId());
+                    pnode2->fDisconnect = true;
+                } else if (pnode->fInbound) {
+                    LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- dropping new inbound, peer=%d\n", __func__, pnode->GetId());
+                    pnode->fDisconnect = true;
+                }
+            } else {
+                if (!pnode2->fInbound) {
+                    LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- dropping old outbound, peer=%d\n", __func__, pnode2->GetId());
+                    pnode2->fDisconnect = true;
+                } else if (!pnode->fInbound) {
+                    LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- dropping new outbound, peer=%d\n", __func__, pnode->GetId());
                     pnode->fDisconnect = true;
                 }
             }
-        });
-
-        if (pnode->fDisconnect) {
-            return;
+        } else {
+            LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- Masternode %s has already verified as peer %d, dropping new connection. peer=%d\n", __func__,
+                    proRegTxHash.ToString(), pnode2->GetId(), pnode->GetId());
+            pnode->fDisconnect = true;
         }
+    });
 
-        {
-            LOCK(pnode->cs_mnauth);
-            pnode->verifiedProRegTxHash = mnauth.proRegTxHash;
-            pnode->verifiedPubKeyHash = dmn->pdmnState->pubKeyOperator.GetHash();
-        }
+    if (pnode->fDisconnect) {
+        return;
+    }
 
-        if (!pnode->m_masternode_iqr_connection && connman.IsMasternodeQuorumRelayMember(pnode->verifiedProRegTxHash)) {
-            // Tell our peer that we're interested in plain LLMQ recovered signatures.
-            // Otherwise the peer would only announce/send messages resulting from QRECSIG,
-            // e.g. InstantSend locks or ChainLocks. SPV and regular full nodes should not send
-            // this message as they are usually only interested in the higher level messages.
-            const CNetMsgMaker msgMaker(pnode->GetSendVersion());
-            connman.PushMessage(pnode, msgMaker.Make(NetMsgType::QSENDRECSIGS, true));
-            pnode->m_masternode_iqr_connection = true;
-        }
+    connman.SetMasternodeVerified(pnode, proRegTxHash, pubKeyHash);
 
-        LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- Valid MNAUTH for %s, peer=%d\n", __func__, mnauth.proRegTxHash.ToString(), pnode->GetId());
+    if (!pnode->m_masternode_iqr_connection && connman.IsMasternodeQuorumRelayMember(proRegTxHash)) {
+        // Tell our peer that we're interested in plain LLMQ recovered signatures.
+        // Otherwise the peer would only announce/send messages resulting from QRECSIG,
+        // e.g. InstantSend locks or ChainLocks. SPV and regular full nodes should not send
+        // this message as they are usually only interested in the higher level messages.
+        const CNetMsgMaker msgMaker(pnode->GetSendVersion());
+        connman.PushMessage(pnode, msgMaker.Make(NetMsgType::QSENDRECSIGS, true));
+        pnode->m_masternode_iqr_connection = true;
     }
+
+    LogPrint(BCLog::NET_NETCONN, "CMNAuth::%s -- Valid MNAUTH for %s, peer=%d\n", __func__, proRegTxHash.ToString(), pnode->GetId());
 }
 
 void CMNAuth::NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff)
@@ -208,31 +225,33 @@ void CMNAuth::NotifyMasternodeListChanged(bool undo, const CDeterministicMNList&
         return;
     }
 
-    g_connman->ForEachNode([&](CNode* pnode) {
-        LOCK(pnode->cs_mnauth);
-        if (pnode->verifiedProRegTxHash.IsNull()) {
-            return;
-        }
-        auto verifiedDmn = oldMNList.GetMN(pnode->verifiedProRegTxHash);
-        if (!verifiedDmn) {
-            return;
-        }
-        bool doRemove = false;
-        if (diff.removedMns.count(verifiedDmn->GetInternalId())) {
-            doRemove = true;
-        } else {
-            auto it = diff.updatedMNs.find(verifiedDmn->GetInternalId());
-            if (it != diff.updatedMNs.end()) {
-                if ((it->second.fields & CDeterministicMNStateDiff::Field_pubKeyOperator) && it->second.state.pubKeyOperator.GetHash() != pnode->verifiedPubKeyHash) {
-                    doRemove = true;
-                }
+    // only the nodes of the removed MNs and of the MNs with a new operator key are affected
+    auto disconnectNodes = [&](const CDeterministicMNCPtr& dmn, const uint256* pNewPubKeyHash) {
+        g_connman->ForEachVerifiedMasternodeNode(dmn->proTxHash, [&](CNode* pnode) {
+            LOCK(pnode->cs_mnauth);
+            if (pNewPubKeyHash != nullptr && *pNewPubKeyHash == pnode->verifiedPubKeyHash) {
+                return;
             }
-        }
-
-        if (doRemove) {
             LogPrint(BCLog::NET_NETCONN, "CMNAuth::NotifyMasternodeListChanged -- Disconnecting MN %s due to key changed/removed, peer=%d\n",
                      pnode->verifiedProRegTxHash.ToString(), pnode->GetId());
             pnode->fDisconnect = true;
+        });
+    };
+
+    for (const auto& id : diff.removedMns) {
+        auto dmn = oldMNList.GetMNByInternalId(id);
+        if (dmn) {
+            disconnectNodes(dmn, nullptr);
         }
-    });
+    }
+    for (const auto& p : diff.updatedMNs) {
+        if (!(p.second.fields & CDeterministicMNStateDiff::Field_pubKeyOperator)) {
+            continue;
+        }
+        auto dmn = oldMNList.GetMNByInternalId(p.first);
+        if (dmn) {
+            const uint256 newPubKeyHash = p.second.state.pubKeyOperator.GetHash();
+            disconnectNodes(dmn, &newPubKeyHash);
+        }
+    }
 }
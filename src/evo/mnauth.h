@@ -7,9 +7,9 @@
 
 #include <bls/bls.h>
 #include <serialize.h>
+#include <streams.h>
 
 class CConnman;
-class CDataStream;
 class CDeterministicMN;
 class CDeterministicMNList;
 class CDeterministicMNListDiff;
@@ -52,6 +52,10 @@ public:
     static void PushMNAUTH(CNode* pnode, CConnman& connman);
     static void ProcessMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv, CConnman& connman);
     static void NotifyMasternodeListChanged(bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff);
+
+private:
+    // Called by the BLS worker with the result of the signature check of ProcessMessage
+    static void ProcessVerifiedMNAUTH(CNode* pnode, const uint256& proRegTxHash, const uint256& pubKeyHash, bool fValid, CConnman& connman);
 };
 
 
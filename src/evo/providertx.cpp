@@ -40,33 +40,41 @@ static bool CheckService(const uint256& proTxHash, const ProTx& proTx, CValidati
     return true;
 }
 
-template <typename ProTx>
-static bool CheckHashSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state)
+static bool CheckSig(CSpecialTxSigChecks::Check&& check, CValidationState& state, CSpecialTxSigChecks* pSigChecks)
 {
+    if (pSigChecks) {
+        pSigChecks->Add(std::move(check));
+        return true;
+    }
     std::string strError;
-    if (!CHashSigner::VerifyHash(::SerializeHash(proTx), keyID, proTx.vchSig, strError)) {
+    if (!check(strError)) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, strError);
     }
     return true;
 }
 
 template <typename ProTx>
-static bool CheckStringSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state)
+static bool CheckHashSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state, CSpecialTxSigChecks* pSigChecks)
 {
-    std::string strError;
-    if (!CMessageSigner::VerifyMessage(keyID, proTx.vchSig, proTx.MakeSignString(), strError)) {
-        return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, strError);
-    }
-    return true;
+    return CheckSig([hash = ::SerializeHash(proTx), keyID, vchSig = proTx.vchSig](std::string& strError) {
+        return CHashSigner::VerifyHash(hash, keyID, vchSig, strError);
+    }, state, pSigChecks);
 }
 
 template <typename ProTx>
-static bool CheckHashSig(const ProTx& proTx, const CBLSPublicKey& pubKey, CValidationState& state)
+static bool CheckStringSig(const ProTx& proTx, const CKeyID& keyID, CValidationState& state, CSpecialTxSigChecks* pSigChecks)
 {
-    if (!proTx.sig.VerifyInsecure(pubKey, ::SerializeHash(proTx))) {
-        return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false);
-    }
-    return true;
+    return CheckSig([strMessage = proTx.MakeSignString(), keyID, vchSig = proTx.vchSig](std::string& strError) {
+        return CMessageSigner::VerifyMessage(keyID, vchSig, strMessage, strError);
+    }, state, pSigChecks);
+}
+
+template <typename ProTx>
+static bool CheckHashSig(const ProTx& proTx, const CBLSPublicKey& pubKey, CValidationState& state, CSpecialTxSigChecks* pSigChecks)
+{
+    return CheckSig([hash = ::SerializeHash(proTx), pubKey, sig = proTx.sig](std::string& strError) {
+        return sig.VerifyInsecure(pubKey, hash);
+    }, state, pSigChecks);
 }
 
 template <typename ProTx>
@@ -80,7 +88,7 @@ static bool CheckInputsHash(const CTransaction& tx, const ProTx& proTx, CValidat
     return true;
 }
 
-bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view)
+bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, CSpecialTxSigChecks* pSigChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_REGISTER) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -198,7 +206,7 @@ bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValid
 
     if (keyForPayloadSig) {
         // collateral is not part of this ProRegTx, so we must verify ownership of the collateral
-        if (!CheckStringSig(ptx, *keyForPayloadSig, state)) {
+        if (!CheckStringSig(ptx, *keyForPayloadSig, state, pSigChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -212,7 +220,7 @@ bool CheckProRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValid
     return true;
 }
 
-bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigChecks* pSigChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_SERVICE) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -259,7 +267,7 @@ bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVa
             // pass the state returned by the function above
             return false;
         }
-        if (!CheckHashSig(ptx, mn->pdmnState->pubKeyOperator.Get(), state)) {
+        if (!CheckHashSig(ptx, mn->pdmnState->pubKeyOperator.Get(), state, pSigChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -268,7 +276,7 @@ bool CheckProUpServTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVa
     return true;
 }
 
-bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view)
+bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, CSpecialTxSigChecks* pSigChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_REGISTRAR) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -343,7 +351,7 @@ bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
             // pass the state returned by the function above
             return false;
         }
-        if (!CheckHashSig(ptx, dmn->pdmnState->keyIDOwner, state)) {
+        if (!CheckHashSig(ptx, dmn->pdmnState->keyIDOwner, state, pSigChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -352,7 +360,7 @@ bool CheckProUpRegTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
     return true;
 }
 
-bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigChecks* pSigChecks)
 {
     if (tx.nType != TRANSACTION_PROVIDER_UPDATE_REVOKE) {
         return state.DoS(100, false, REJECT_INVALID, "bad-protx-type");
@@ -383,7 +391,7 @@ bool CheckProUpRevTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVal
             // pass the state returned by the function above
             return false;
         }
-        if (!CheckHashSig(ptx, dmn->pdmnState->pubKeyOperator.Get(), state)) {
+        if (!CheckHashSig(ptx, dmn->pdmnState->pubKeyOperator.Get(), state, pSigChecks)) {
             // pass the state returned by the function above
             return false;
         }
@@ -13,6 +13,8 @@
 #include <base58.h>
 #include <chainparams.h>
 #include <consensus/merkle.h>
+#include <crypto/sha256.h>
+#include <hash.h>
 #include <univalue.h>
 #include <validation.h>
 
@@ -79,12 +81,205 @@ CSimplifiedMNList::CSimplifiedMNList(const CDeterministicMNList& dmnList)
 
 uint256 CSimplifiedMNList::CalcMerkleRoot(bool* pmutated) const
 {
-    std::vector<uint256> leaves;
-    leaves.reserve(mnList.size());
+    // same as CalcHash() for each entry, but hashed in one batch
+    CHash256Batch batch(SER_GETHASH, CLIENT_VERSION);
     for (const auto& e : mnList) {
-        leaves.emplace_back(e->CalcHash());
+        batch.Add(*e);
+    }
+    return ComputeMerkleRoot(batch.Finalize(), pmutated);
+}
+
+CSimplifiedMNListMerkleTree::CSimplifiedMNListMerkleTree(const CDeterministicMNList& mnList)
+{
+    // the leaf hashes are the CalcHash() of the entries, hashed in one batch
+    std::vector<uint256> vUnsortedProTxHashes;
+    vUnsortedProTxHashes.reserve(mnList.GetAllMNsCount());
+    CHash256Batch batch(SER_GETHASH, CLIENT_VERSION);
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        vUnsortedProTxHashes.emplace_back(dmn->proTxHash);
+        batch.Add(CSimplifiedMNListEntry(*dmn));
+    });
+    auto vHashes = batch.Finalize();
+
+    std::vector<std::pair<uint256, uint256>> leaves;
+    leaves.reserve(vHashes.size());
+    for (size_t i = 0; i < vHashes.size(); i++) {
+        leaves.emplace_back(vUnsortedProTxHashes[i], vHashes[i]);
+    }
+    std::sort(leaves.begin(), leaves.end());
+
+    vLevels.resize(1);
+    vProTxHashes.reserve(leaves.size());
+    vLevels[0].reserve(leaves.size());
+    for (const auto& p : leaves) {
+        vProTxHashes.emplace_back(p.first);
+        vLevels[0].emplace_back(p.second);
+    }
+    BuildLevels();
+}
+
+void CSimplifiedMNListMerkleTree::ApplyDiff(const CDeterministicMNList& oldList, const CDeterministicMNList& newList, const CDeterministicMNListDiff& diff)
+{
+    // Only these end up in CSimplifiedMNListEntry, changes to anything else (e.g. nLastPaidHeight) don't touch the tree
+    static const uint32_t SML_FIELDS = CDeterministicMNStateDiff::Field_nPoSeBanHeight |
+                                       CDeterministicMNStateDiff::Field_confirmedHash |
+                                       CDeterministicMNStateDiff::Field_pubKeyOperator |
+                                       CDeterministicMNStateDiff::Field_keyIDVoting |
+                                       CDeterministicMNStateDiff::Field_addr;
+
+    if (vLevels.empty()) {
+        vLevels.resize(1);
+    }
+
+    // proTxHash -> new leaf hash, for updated and added MNs
+    std::map<uint256, uint256> mapChangedLeaves;
+    for (const auto& p : diff.updatedMNs) {
+        if ((p.second.fields & SML_FIELDS) == 0) {
+            continue;
+        }
+        auto dmn = newList.GetMNByInternalId(p.first);
+        if (!dmn) {
+            throw std::runtime_error(strprintf("%s: can't find an updated MN with internalId=%d", __func__, p.first));
+        }
+        mapChangedLeaves.emplace(dmn->proTxHash, CSimplifiedMNListEntry(*dmn).CalcHash());
+    }
+
+    if (diff.addedMNs.empty() && diff.removedMns.empty()) {
+        // All leaves keep their positions, so only the paths of the changed ones need to be rehashed
+        std::vector<size_t> vChangedLeaves;
+        vChangedLeaves.reserve(mapChangedLeaves.size());
+        for (const auto& p : mapChangedLeaves) {
+            auto it = std::lower_bound(vProTxHashes.begin(), vProTxHashes.end(), p.first);
+            if (it == vProTxHashes.end() || *it != p.first) {
+                throw std::runtime_error(strprintf("%s: updated MN %s is not in the tree", __func__, p.first.ToString()));
+            }
+            size_t nLeaf = it - vProTxHashes.begin();
+            if (vLevels[0][nLeaf] != p.second) {
+                vLevels[0][nLeaf] = p.second;
+                vChangedLeaves.emplace_back(nLeaf);
+            }
+        }
+        // mapChangedLeaves is ordered by proTxHash, so vChangedLeaves is sorted already
+        UpdatePaths(std::move(vChangedLeaves));
+        return;
+    }
+
+    std::set<uint256> setRemoved;
+    for (const auto& internalId : diff.removedMns) {
+        auto dmn = oldList.GetMNByInternalId(internalId);
+        if (!dmn) {
+            throw std::runtime_error(strprintf("%s: can't find a removed MN with internalId=%d", __func__, internalId));
+        }
+        setRemoved.emplace(dmn->proTxHash);
+    }
+    for (const auto& dmn : diff.addedMNs) {
+        mapChangedLeaves.emplace(dmn->proTxHash, CSimplifiedMNListEntry(*dmn).CalcHash());
+    }
+
+    // Merge the old leaves with the changed ones, both are ordered by proTxHash
+    std::vector<uint256> vNewProTxHashes;
+    std::vector<uint256> vNewLeaves;
+    vNewProTxHashes.reserve(newList.GetAllMNsCount());
+    vNewLeaves.reserve(newList.GetAllMNsCount());
+    auto itChanged = mapChangedLeaves.begin();
+    for (size_t i = 0; i < vProTxHashes.size(); i++) {
+        const uint256& proTxHash = vProTxHashes[i];
+        for (; itChanged != mapChangedLeaves.end() && itChanged->first < proTxHash; ++itChanged) {
+            vNewProTxHashes.emplace_back(itChanged->first);
+            vNewLeaves.emplace_back(itChanged->second);
+        }
+        if (itChanged != mapChangedLeaves.end() && itChanged->first == proTxHash) {
+            vNewProTxHashes.emplace_back(itChanged->first);
+            vNewLeaves.emplace_back(itChanged->second);
+            ++itChanged;
+            continue;
+        }
+        if (setRemoved.count(proTxHash)) {
+            continue;
+        }
+        vNewProTxHashes.emplace_back(proTxHash);
+        vNewLeaves.emplace_back(vLevels[0][i]);
+    }
+    for (; itChanged != mapChangedLeaves.end(); ++itChanged) {
+        vNewProTxHashes.emplace_back(itChanged->first);
+        vNewLeaves.emplace_back(itChanged->second);
+    }
+
+    vProTxHashes = std::move(vNewProTxHashes);
+    vLevels.resize(1);
+    vLevels[0] = std::move(vNewLeaves);
+    BuildLevels();
+}
+
+uint256 CSimplifiedMNListMerkleTree::GetMerkleRoot(bool* pmutated) const
+{
+    if (pmutated) {
+        *pmutated = fMutated;
+    }
+    if (vLevels.empty() || vLevels[0].empty()) {
+        return uint256();
+    }
+    return vLevels.back()[0];
+}
+
+void CSimplifiedMNListMerkleTree::BuildLevels()
+{
+    // Same as ComputeMerkleRoot, but keeps every intermediate level
+    while (vLevels.back().size() > 1) {
+        std::vector<uint256> level = vLevels.back();
+        if (level.size() & 1) {
+            level.push_back(level.back());
+        }
+        SHA256D64(level[0].begin(), level[0].begin(), level.size() / 2);
+        level.resize(level.size() / 2);
+        vLevels.emplace_back(std::move(level));
+    }
+    UpdateMutated();
+}
+
+void CSimplifiedMNListMerkleTree::UpdatePaths(std::vector<size_t>&& vChangedLeaves)
+{
+    if (vChangedLeaves.empty()) {
+        return;
+    }
+
+    // vChanged holds the sorted indexes of the changed nodes of the current level and is turned into the indexes of
+    // their parents in-place
+    auto& vChanged = vChangedLeaves;
+    for (size_t l = 0; l + 1 < vLevels.size(); l++) {
+        const auto& level = vLevels[l];
+        auto& parents = vLevels[l + 1];
+        size_t n = 0;
+        for (size_t i = 0; i < vChanged.size(); i++) {
+            size_t nParent = vChanged[i] / 2;
+            if (n != 0 && vChanged[n - 1] == nParent) {
+                continue;
+            }
+            const uint256& left = level[nParent * 2];
+            const uint256& right = nParent * 2 + 1 < level.size() ? level[nParent * 2 + 1] : left;
+            parents[nParent] = Hash(left.begin(), left.end(), right.begin(), right.end());
+            vChanged[n++] = nParent;
+        }
+        vChanged.resize(n);
+    }
+    UpdateMutated();
+}
+
+void CSimplifiedMNListMerkleTree::UpdateMutated()
+{
+    // Same check as in ComputeMerkleRoot. This only compares hashes, so it's cheap compared to rehashing the tree
+    fMutated = false;
+    for (const auto& level : vLevels) {
+        if (level.size() <= 1) {
+            break;
+        }
+        for (size_t pos = 0; pos + 1 < level.size(); pos += 2) {
+            if (level[pos] == level[pos + 1]) {
+                fMutated = true;
+                return;
+            }
+        }
     }
-    return ComputeMerkleRoot(leaves, pmutated);
 }
 
 CSimplifiedMNListDiff::CSimplifiedMNListDiff() = default;
@@ -180,12 +375,13 @@ void CSimplifiedMNListDiff::ToJson(UniValue& obj) const
     }
 }
 
-bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+CSimplifiedMNListDiffCache mnListDiffCache;
+
+static bool LookupMNListDiffBlocks(const uint256& baseBlockHash, const uint256& blockHash, const CBlockIndex*& baseBlockIndex, const CBlockIndex*& blockIndex, std::string& errorRet)
 {
     AssertLockHeld(cs_main);
-    mnListDiffRet = CSimplifiedMNListDiff();
 
-    const CBlockIndex* baseBlockIndex = chainActive.Genesis();
+    baseBlockIndex = chainActive.Genesis();
     if (!baseBlockHash.IsNull()) {
         baseBlockIndex = LookupBlockIndex(baseBlockHash);
         if (!baseBlockIndex) {
@@ -194,7 +390,7 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
         }
     }
 
-    const CBlockIndex* blockIndex = LookupBlockIndex(blockHash);
+    blockIndex = LookupBlockIndex(blockHash);
     if (!blockIndex) {
         errorRet = strprintf("block %s not found", blockHash.ToString());
         return false;
@@ -208,9 +404,27 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
         errorRet = strprintf("base block %s is higher then block %s", baseBlockHash.ToString(), blockHash.ToString());
         return false;
     }
+    return true;
+}
+
+bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+    mnListDiffRet = CSimplifiedMNListDiff();
+
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    if (!LookupMNListDiffBlocks(baseBlockHash, blockHash, baseBlockIndex, blockIndex, errorRet)) {
+        return false;
+    }
 
     LOCK(deterministicMNManager->cs);
 
+    if (deterministicMNManager->IsListPruned(baseBlockIndex) || deterministicMNManager->IsListPruned(blockIndex)) {
+        errorRet = strprintf("masternode list of block %s was pruned", deterministicMNManager->IsListPruned(baseBlockIndex) ? baseBlockHash.ToString() : blockHash.ToString());
+        return false;
+    }
+
     auto baseDmnList = deterministicMNManager->GetListForBlock(baseBlockIndex);
     auto dmnList = deterministicMNManager->GetListForBlock(blockIndex);
     mnListDiffRet = baseDmnList.BuildSimplifiedDiff(dmnList);
@@ -244,3 +458,55 @@ bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& bloc
 
     return true;
 }
+
+bool CSimplifiedMNListDiffCache::GetSerializedDiff(const uint256& baseBlockHash, const uint256& blockHash, int nVersion, Payload& ret, std::string& errorRet)
+{
+    AssertLockHeld(cs_main);
+
+    // the blocks must still be checked, a reorg might have happened since the diff was cached
+    const CBlockIndex* baseBlockIndex;
+    const CBlockIndex* blockIndex;
+    if (!LookupMNListDiffBlocks(baseBlockHash, blockHash, baseBlockIndex, blockIndex, errorRet)) {
+        return false;
+    }
+
+    // the quorums are only serialized for newer peers
+    bool fQuorums = nVersion >= LLMQS_PROTO_VERSION;
+    uint256 key = (CHashWriter(SER_GETHASH, 0) << baseBlockHash << blockHash << fQuorums).GetHash();
+    {
+        LOCK(cs);
+        if (cache.get(key, ret)) {
+            return true;
+        }
+    }
+
+    CSimplifiedMNListDiff mnListDiff;
+    if (!BuildSimplifiedMNListDiff(baseBlockHash, blockHash, mnListDiff, errorRet)) {
+        return false;
+    }
+    auto payload = std::make_shared<std::vector<unsigned char>>();
+    CVectorWriter(SER_NETWORK, nVersion, *payload, 0, mnListDiff);
+    ret = std::move(payload);
+
+    LOCK(cs);
+    cache.insert(key, ret);
+    return true;
+}
+
+void CSimplifiedMNListDiffCache::UpdatedBlockTip(const CBlockIndex* pindexNew)
+{
+    for (int i = 1; i <= MNLISTDIFF_PREWARM_COUNT && i <= pindexNew->nHeight; i++) {
+        // don't hold cs_main for all of them
+        LOCK(cs_main);
+        if (chainActive.Tip() != pindexNew) {
+            // the tip moved on, the next call does the new one
+            return;
+        }
+        Payload payload;
+        std::string strError;
+        if (!GetSerializedDiff(pindexNew->GetAncestor(pindexNew->nHeight - i)->GetBlockHash(), pindexNew->GetBlockHash(), PROTOCOL_VERSION, payload, strError)) {
+            LogPrintf("CSimplifiedMNListDiffCache::%s -- failed to build diff: %s\n", __func__, strError);
+            return;
+        }
+    }
+}
@@ -9,11 +9,18 @@
 #include <merkleblock.h>
 #include <netaddress.h>
 #include <pubkey.h>
+#include <saltedhasher.h>
 #include <serialize.h>
+#include <sync.h>
+#include <unordered_lru_cache.h>
 #include <version.h>
 
+#include <memory>
+
+class CBlockIndex;
 class UniValue;
 class CDeterministicMNList;
+class CDeterministicMNListDiff;
 class CDeterministicMN;
 
 namespace llmq
@@ -84,6 +91,42 @@ public:
     uint256 CalcMerkleRoot(bool* pmutated = nullptr) const;
 };
 
+/**
+ * Keeps the full merkle tree of a simplified MN list (leaves ordered by proTxHash) around, so that moving it to the
+ * next list only requires rehashing the leaves that actually changed and their paths up to the root. The resulting
+ * root (and mutation flag) is identical to CSimplifiedMNList::CalcMerkleRoot() for the same list.
+ *
+ * When MNs were added or removed, the positions of the following leaves shift and all levels above the leaves are
+ * rebuilt, but the hashes of unchanged leaves are still reused. This class is NOT thread safe.
+ */
+class CSimplifiedMNListMerkleTree
+{
+private:
+    // sorted, vProTxHashes[i] belongs to vLevels[0][i]
+    std::vector<uint256> vProTxHashes;
+    // vLevels[0] holds the leaves, vLevels.back() the root (if there is at least one leaf)
+    std::vector<std::vector<uint256>> vLevels;
+    bool fMutated{false};
+
+public:
+    CSimplifiedMNListMerkleTree() = default;
+    explicit CSimplifiedMNListMerkleTree(const CDeterministicMNList& mnList);
+
+    /**
+     * Move the tree from oldList (which it must currently represent) to newList.
+     * diff must be the result of oldList.BuildDiff(newList).
+     */
+    void ApplyDiff(const CDeterministicMNList& oldList, const CDeterministicMNList& newList, const CDeterministicMNListDiff& diff);
+
+    uint256 GetMerkleRoot(bool* pmutated = nullptr) const;
+    size_t GetLeafCount() const { return vProTxHashes.size(); }
+
+private:
+    void BuildLevels();
+    void UpdatePaths(std::vector<size_t>&& vChangedLeaves);
+    void UpdateMutated();
+};
+
 /// P2P messages
 
 class CGetSimplifiedMNListDiff
@@ -147,4 +190,33 @@ public:
 
 bool BuildSimplifiedMNListDiff(const uint256& baseBlockHash, const uint256& blockHash, CSimplifiedMNListDiff& mnListDiffRet, std::string& errorRet);
 
+//! Number of serialized diffs kept by CSimplifiedMNListDiffCache
+static const size_t MNLISTDIFF_CACHE_SIZE = 32;
+//! The diffs from the MNLISTDIFF_PREWARM_COUNT blocks before a new tip to it are built when the tip changes
+static const int MNLISTDIFF_PREWARM_COUNT = 8;
+
+/**
+ * The MNLISTDIFF payloads of the most recently requested (baseBlockHash, blockHash) pairs, as serialized for the
+ * requesting peers. SPV clients ask for the same pairs over and over, and the diff between two blocks of the active
+ * chain never changes, so only the blocks need to be checked for each request.
+ */
+class CSimplifiedMNListDiffCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<unsigned char>> Payload;
+
+private:
+    CCriticalSection cs;
+    unordered_lru_cache<uint256, Payload, StaticSaltedHasher, MNLISTDIFF_CACHE_SIZE> cache GUARDED_BY(cs);
+
+public:
+    //! Gets the payload of a MNLISTDIFF message for a peer with nVersion
+    bool GetSerializedDiff(const uint256& baseBlockHash, const uint256& blockHash, int nVersion, Payload& ret, std::string& errorRet);
+
+    //! Builds the diffs from the blocks right before pindexNew for version PROTOCOL_VERSION peers
+    void UpdatedBlockTip(const CBlockIndex* pindexNew);
+};
+
+extern CSimplifiedMNListDiffCache mnListDiffCache;
+
 #endif // BITCOIN_EVO_SIMPLIFIEDMNS_H
@@ -4,6 +4,7 @@
 
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <executor.h>
 #include <hash.h>
 #include <primitives/block.h>
 #include <validation.h>
@@ -14,8 +15,84 @@
 
 #include <llmq/quorums_commitment.h>
 #include <llmq/quorums_blockprocessor.h>
+#include <llmq/quorums_dkgsessionmgr.h>
+#include <llmq/quorums_utils.h>
 
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view)
+void CSpecialTxSigChecks::Add(Check&& check)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->check = std::move(check);
+    AddEntry(std::move(entry));
+}
+
+void CSpecialTxSigChecks::AddPrefetch(Check&& check)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->check = std::move(check);
+    entry->fPrefetch = true;
+    AddEntry(std::move(entry));
+}
+
+void CSpecialTxSigChecks::AddEntry(std::shared_ptr<Entry>&& entry)
+{
+    vEntries.emplace_back(entry);
+    auto s = sync;
+    GetExecutor().Push(ExecutorPriority::CONSENSUS, [s, entry](int) {
+        Run(*s, *entry);
+    });
+}
+
+void CSpecialTxSigChecks::Run(Sync& sync, Entry& entry)
+{
+    {
+        std::unique_lock<std::mutex> l(sync.mutex);
+        if (entry.fClaimed) {
+            return;
+        }
+        entry.fClaimed = true;
+    }
+
+    std::string strError;
+    bool fOk;
+    try {
+        fOk = entry.check(strError);
+    } catch (const std::exception& e) {
+        fOk = false;
+        strError = e.what();
+    }
+
+    {
+        std::unique_lock<std::mutex> l(sync.mutex);
+        entry.fOk = fOk;
+        entry.strError = std::move(strError);
+        entry.fDone = true;
+        entry.check = nullptr;
+    }
+    sync.cond.notify_all();
+}
+
+bool CSpecialTxSigChecks::Wait(CValidationState& state)
+{
+    // help out with the ones which didn't start yet, so that this doesn't depend on idle executor threads
+    for (const auto& entry : vEntries) {
+        Run(*sync, *entry);
+    }
+
+    std::vector<std::shared_ptr<Entry>> vDone;
+    vDone.swap(vEntries);
+    std::unique_lock<std::mutex> l(sync->mutex);
+    for (const auto& entry : vDone) {
+        sync->cond.wait(l, [&]() { return entry->fDone; });
+    }
+    for (const auto& entry : vDone) {
+        if (!entry->fPrefetch && !entry->fOk) {
+            return state.DoS(100, false, REJECT_INVALID, "bad-protx-sig", false, entry->strError);
+        }
+    }
+    return true;
+}
+
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, CSpecialTxSigChecks* pSigChecks)
 {
     if (tx.nVersion != 3 || tx.nType == TRANSACTION_NORMAL)
         return true;
@@ -27,17 +104,17 @@ bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CVali
     try {
         switch (tx.nType) {
         case TRANSACTION_PROVIDER_REGISTER:
-            return CheckProRegTx(tx, pindexPrev, state, view);
+            return CheckProRegTx(tx, pindexPrev, state, view, pSigChecks);
         case TRANSACTION_PROVIDER_UPDATE_SERVICE:
-            return CheckProUpServTx(tx, pindexPrev, state);
+            return CheckProUpServTx(tx, pindexPrev, state, pSigChecks);
         case TRANSACTION_PROVIDER_UPDATE_REGISTRAR:
-            return CheckProUpRegTx(tx, pindexPrev, state, view);
+            return CheckProUpRegTx(tx, pindexPrev, state, view, pSigChecks);
         case TRANSACTION_PROVIDER_UPDATE_REVOKE:
-            return CheckProUpRevTx(tx, pindexPrev, state);
+            return CheckProUpRevTx(tx, pindexPrev, state, pSigChecks);
         case TRANSACTION_COINBASE:
             return CheckCbTx(tx, pindexPrev, state);
         case TRANSACTION_QUORUM_COMMITMENT:
-            return llmq::CheckLLMQCommitment(tx, pindexPrev, state);
+            return llmq::CheckLLMQCommitment(tx, pindexPrev, state, pSigChecks);
         }
     } catch (const std::exception& e) {
         LogPrintf("%s -- failed: %s\n", __func__, e.what());
@@ -89,7 +166,8 @@ bool UndoSpecialTx(const CTransaction& tx, const CBlockIndex* pindex)
     return false;
 }
 
-bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, const CCoinsViewCache& view, bool fJustCheck, bool fCheckCbTxMerleRoots)
+bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, const CCoinsViewCache& view, bool fJustCheck, bool fCheckCbTxMerleRoots,
+                              CBlockConnectTimings* pTimings)
 {
     static int64_t nTimeLoop = 0;
     static int64_t nTimeQuorum = 0;
@@ -99,17 +177,23 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
     try {
         int64_t nTime1 = GetTimeMicros();
 
+        // The payload signatures are verified in parallel while the txs are checked, before any state transitions
+        CSpecialTxSigChecks sigChecks;
         for (int i = 0; i < (int)block.vtx.size(); i++) {
             const CTransaction& tx = *block.vtx[i];
-            if (!CheckSpecialTx(tx, pindex->pprev, state, view)) {
-                // pass the state returned by the function above
-                return false;
-            }
-            if (!ProcessSpecialTx(tx, pindex, state)) {
-                // pass the state returned by the function above
+            if (!CheckSpecialTx(tx, pindex->pprev, state, view, &sigChecks) || !ProcessSpecialTx(tx, pindex, state)) {
+                // a bad signature of an earlier tx is what the checks would have failed on when run one by one
+                CValidationState sigState;
+                if (!sigChecks.Wait(sigState)) {
+                    state = sigState;
+                }
                 return false;
             }
         }
+        if (!sigChecks.Wait(state)) {
+            // pass the state returned by the function above
+            return false;
+        }
 
         int64_t nTime2 = GetTimeMicros(); nTimeLoop += nTime2 - nTime1;
         LogPrint(BCLog::BENCHMARK, "        - Loop: %.2fms [%.2fs]\n", 0.001 * (nTime2 - nTime1), nTimeLoop * 0.000001);
@@ -137,6 +221,13 @@ bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CV
 
         int64_t nTime5 = GetTimeMicros(); nTimeMerkle += nTime5 - nTime4;
         LogPrint(BCLog::BENCHMARK, "        - CheckCbTxMerkleRoots: %.2fms [%.2fs]\n", 0.001 * (nTime5 - nTime4), nTimeMerkle * 0.000001);
+
+        if (pTimings) {
+            pTimings->nSpecialTxs += nTime2 - nTime1;
+            pTimings->nQuorums += nTime3 - nTime2;
+            pTimings->nMNList += nTime4 - nTime3;
+            pTimings->nCbTxMerkleRoots += nTime5 - nTime4;
+        }
     } catch (const std::exception& e) {
         LogPrintf("%s -- failed: %s\n", __func__, e.what());
         return state.DoS(100, false, REJECT_INVALID, "failed-procspectxsinblock");
@@ -169,6 +260,34 @@ bool UndoSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex)
     return true;
 }
 
+int GetSpecialTxDataRetentionDepth()
+{
+    int nQuorumDepth = 0;
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        const auto& params = p.second;
+        nQuorumDepth = std::max(nQuorumDepth, params.dkgInterval * (std::max(params.signingActiveQuorumCount, params.keepOldConnections) + 1));
+    }
+    return MIN_BLOCKS_TO_KEEP + nQuorumDepth;
+}
+
+void PruneSpecialTxData(const CBlockIndex* pindexTip)
+{
+    AssertLockHeld(cs_main);
+
+    int nKeepHeight = pindexTip->nHeight - GetSpecialTxDataRetentionDepth();
+    if (nKeepHeight <= Params().GetConsensus().DIP0003Height) {
+        return;
+    }
+
+    int64_t nTimeStart = GetTimeMicros();
+    size_t nLists = deterministicMNManager->PruneLists(pindexTip->GetAncestor(nKeepHeight));
+    size_t nCommitments = llmq::quorumBlockProcessor->PruneMinedCommitments(nKeepHeight);
+    size_t nMembers = llmq::CLLMQUtils::PruneQuorumMembers(nKeepHeight);
+    size_t nContributions = llmq::quorumDKGSessionManager->PruneContributions(nKeepHeight);
+    LogPrint(BCLog::BENCHMARK, "%s -- pruned below height %d: %d lists, %d commitments, %d quorum members, %d contributions (%.2fms)\n", __func__,
+             nKeepHeight, nLists, nCommitments, nMembers, nContributions, (GetTimeMicros() - nTimeStart) * 0.001);
+}
+
 uint256 CalcTxInputsHash(const CTransaction& tx)
 {
     CHashWriter hw(CLIENT_VERSION, SER_GETHASH);
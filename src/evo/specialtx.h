@@ -9,15 +9,81 @@
 #include <streams.h>
 #include <version.h>
 
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
 class CBlock;
 class CBlockIndex;
 class CCoinsViewCache;
 class CValidationState;
+struct CBlockConnectTimings;
+
+/**
+ * The payload signature checks of the special txs of a block. They run on the executor while the txs are checked,
+ * they are independent of each other as the keys come from the MN list of the previous block. Wait() lets the caller
+ * run the ones which didn't start yet and reports the first failing one in the order they were added.
+ */
+class CSpecialTxSigChecks
+{
+public:
+    //! Returns false and may set strError if the signature is invalid
+    typedef std::function<bool(std::string& strError)> Check;
+
+    //! A check which fails the tx with "bad-protx-sig"
+    void Add(Check&& check);
+    /**
+     * A check whose result doesn't count, e.g. because it's repeated by a later, sequential stage which then gets it
+     * from a signature cache
+     */
+    void AddPrefetch(Check&& check);
+
+    //! Waits for the checks, returns false and sets state if one of the non-prefetch checks failed
+    bool Wait(CValidationState& state);
 
-bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view);
-bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, const CCoinsViewCache& view, bool fJustCheck, bool fCheckCbTxMerleRoots);
+    size_t size() const { return vEntries.size(); }
+
+private:
+    struct Sync
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+    };
+    struct Entry
+    {
+        Check check;
+        bool fPrefetch{false};
+        bool fClaimed{false};
+        bool fDone{false};
+        bool fOk{true};
+        std::string strError;
+    };
+
+    std::shared_ptr<Sync> sync{std::make_shared<Sync>()};
+    std::vector<std::shared_ptr<Entry>> vEntries;
+
+    void AddEntry(std::shared_ptr<Entry>&& entry);
+    static void Run(Sync& sync, Entry& entry);
+};
+
+/** The signature checks are added to pSigChecks instead of being run, if set */
+bool CheckSpecialTx(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, const CCoinsViewCache& view, CSpecialTxSigChecks* pSigChecks = nullptr);
+/** The time spent in the stages is added to pTimings, if set */
+bool ProcessSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex, CValidationState& state, const CCoinsViewCache& view, bool fJustCheck, bool fCheckCbTxMerleRoots,
+                              CBlockConnectTimings* pTimings = nullptr);
 bool UndoSpecialTxsInBlock(const CBlock& block, const CBlockIndex* pindex);
 
+/**
+ * How far below the tip the MN lists, mined commitments and DKG data are kept in pruned mode: the reorg window of the
+ * block files plus the age of the oldest quorum which can still be active or connected to
+ */
+int GetSpecialTxDataRetentionDepth();
+/** Removes the evo and LLMQ data which only the blocks further than GetSpecialTxDataRetentionDepth below pindexTip need */
+void PruneSpecialTxData(const CBlockIndex* pindexTip);
+
 template <typename T>
 inline bool GetTxPayload(const std::vector<unsigned char>& payload, T& obj)
 {
@@ -0,0 +1,306 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <executor.h>
+
+#include <tinyformat.h>
+#include <util.h>
+#include <utiltime.h>
+
+#include <algorithm>
+#include <atomic>
+
+// The executor and worker of the current thread, if it's a worker thread
+static thread_local const CExecutor* g_current_executor = nullptr;
+static thread_local int g_current_worker = -1;
+static thread_local ExecutorPriority g_current_priority = ExecutorPriority::BACKGROUND;
+
+const char* ExecutorPriorityName(ExecutorPriority priority)
+{
+    switch (priority) {
+    case ExecutorPriority::CONSENSUS: return "consensus";
+    case ExecutorPriority::LLMQ: return "llmq";
+    case ExecutorPriority::RPC: return "rpc";
+    case ExecutorPriority::BACKGROUND: return "background";
+    case ExecutorPriority::COUNT: break;
+    }
+    return "unknown";
+}
+
+CExecutor::CExecutor(int nThreadsIn) :
+    nThreads(std::max(1, std::min(nThreadsIn, MAX_EXECUTOR_THREADS))),
+    localQueues(nThreads)
+{
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back([this, i]() {
+            RenameThread(strprintf("dash-exec-%d", i).c_str());
+            Loop(i);
+        });
+    }
+}
+
+CExecutor::~CExecutor()
+{
+    Stop();
+}
+
+void CExecutor::Push(ExecutorPriority priority, Task task)
+{
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        if (fStop) {
+            return;
+        }
+        if (g_current_executor == this) {
+            localQueues[g_current_worker].emplace_back(Entry{g_current_priority, std::move(task)});
+            stats[(size_t)g_current_priority].nPending++;
+        } else {
+            queues[(size_t)priority].emplace_back(Entry{priority, std::move(task)});
+            stats[(size_t)priority].nPending++;
+        }
+    }
+    cond.notify_one();
+}
+
+void CExecutor::ParallelFor(ExecutorPriority priority, size_t nCount, const std::function<void(size_t)>& f)
+{
+    struct State
+    {
+        std::atomic<size_t> nNext{0};
+        std::mutex mutex;
+        std::condition_variable cond;
+        size_t nDone{0};
+    };
+    auto state = std::make_shared<State>();
+    const auto* pf = &f;
+
+    // tasks which only start after all items were taken return without touching f
+    auto run = [state, nCount, pf]() {
+        size_t nRun = 0;
+        for (size_t i = state->nNext++; i < nCount; i = state->nNext++) {
+            (*pf)(i);
+            nRun++;
+        }
+        if (nRun != 0) {
+            std::unique_lock<std::mutex> l(state->mutex);
+            state->nDone += nRun;
+            if (state->nDone == nCount) {
+                state->cond.notify_all();
+            }
+        }
+    };
+
+    size_t nTasks = std::min<size_t>(nThreads, nCount > 0 ? nCount - 1 : 0);
+    for (size_t i = 0; i < nTasks; i++) {
+        Push(priority, [run](int) { run(); });
+    }
+    run();
+
+    std::unique_lock<std::mutex> l(state->mutex);
+    state->cond.wait(l, [&]() { return state->nDone == nCount; });
+}
+
+void CExecutor::Stop()
+{
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        if (fStop) {
+            return;
+        }
+        fStop = true;
+        for (auto& q : queues) {
+            q.clear();
+        }
+        for (auto& q : localQueues) {
+            q.clear();
+        }
+        for (auto& s : stats) {
+            s.nPending = 0;
+        }
+    }
+    cond.notify_all();
+    for (auto& t : threads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+}
+
+bool CExecutor::IsStopped() const
+{
+    std::unique_lock<std::mutex> l(mutex);
+    return fStop;
+}
+
+std::array<CExecutorStats, (size_t)ExecutorPriority::COUNT> CExecutor::GetStats() const
+{
+    std::unique_lock<std::mutex> l(mutex);
+    return stats;
+}
+
+bool CExecutor::PopTask(int nId, Entry& entryRet)
+{
+    // The own local queue (newest first), unless a task of a higher class is waiting in the global queues
+    auto& local = localQueues[nId];
+    for (size_t i = 0; i < queues.size(); i++) {
+        if (!local.empty() && (size_t)local.back().priority <= i) {
+            entryRet = std::move(local.back());
+            local.pop_back();
+            return true;
+        }
+        if (!queues[i].empty()) {
+            entryRet = std::move(queues[i].front());
+            queues[i].pop_front();
+            return true;
+        }
+    }
+    if (!local.empty()) {
+        entryRet = std::move(local.back());
+        local.pop_back();
+        return true;
+    }
+    // Steal the oldest task of the local queue of another worker, the one of the highest class
+    std::deque<Entry>* pVictim = nullptr;
+    for (int i = 1; i < nThreads; i++) {
+        auto& q = localQueues[(nId + i) % nThreads];
+        if (!q.empty() && (pVictim == nullptr || q.front().priority < pVictim->front().priority)) {
+            pVictim = &q;
+        }
+    }
+    if (pVictim != nullptr) {
+        entryRet = std::move(pVictim->front());
+        pVictim->pop_front();
+        return true;
+    }
+    return false;
+}
+
+void CExecutor::Loop(int nId)
+{
+    g_current_executor = this;
+    g_current_worker = nId;
+
+    std::unique_lock<std::mutex> l(mutex);
+    while (true) {
+        Entry entry;
+        while (!fStop && !PopTask(nId, entry)) {
+            cond.wait(l);
+        }
+        if (fStop) {
+            return;
+        }
+        auto& s = stats[(size_t)entry.priority];
+        s.nPending--;
+        s.nRunning++;
+        l.unlock();
+
+        g_current_priority = entry.priority;
+        int64_t nStart = GetTimeMicros();
+        try {
+            entry.task(nId);
+        } catch (...) {
+            PrintExceptionContinue(std::current_exception(), "CExecutor::Loop()");
+        }
+        int64_t nTime = GetTimeMicros() - nStart;
+        // Destroy the task (and what it captured) before relocking
+        entry.task = nullptr;
+
+        l.lock();
+        s.nRunning--;
+        s.nTasks++;
+        s.nBusyMicros += nTime;
+    }
+}
+
+CExecutorClient::CExecutorClient(ExecutorPriority priorityIn) :
+    priority(priorityIn),
+    state(std::make_shared<State>())
+{
+}
+
+CExecutorClient::~CExecutorClient()
+{
+    Stop();
+}
+
+void CExecutorClient::Start(int nConcurrencyIn)
+{
+    std::unique_lock<std::mutex> l(state->mutex);
+    state->fActive = true;
+    nConcurrency = nConcurrencyIn;
+}
+
+void CExecutorClient::Stop()
+{
+    std::unique_lock<std::mutex> l(state->mutex);
+    state->fActive = false;
+    state->cond.wait(l, [this]() { return state->nRunning == 0; });
+}
+
+int CExecutorClient::size() const
+{
+    return nConcurrency > 0 ? nConcurrency : GetExecutor().size();
+}
+
+void CExecutorClient::PushTask(std::function<void(int)> task)
+{
+    auto s = state;
+    {
+        std::unique_lock<std::mutex> l(s->mutex);
+        if (!s->fActive) {
+            return;
+        }
+    }
+    GetExecutor().Push(priority, [s, task](int nId) {
+        {
+            std::unique_lock<std::mutex> l(s->mutex);
+            if (!s->fActive) {
+                return;
+            }
+            s->nRunning++;
+        }
+        task(nId);
+        {
+            std::unique_lock<std::mutex> l(s->mutex);
+            s->nRunning--;
+        }
+        s->cond.notify_all();
+    });
+}
+
+static std::mutex g_executor_mutex;
+static std::unique_ptr<CExecutor> g_executor_holder;
+static std::atomic<CExecutor*> g_executor{nullptr};
+
+void InitExecutor(int nThreads)
+{
+    std::unique_lock<std::mutex> l(g_executor_mutex);
+    if (g_executor_holder && !g_executor_holder->IsStopped()) {
+        return;
+    }
+    // a stopped one is only replaced on a restart of the node, when nothing uses it anymore
+    if (nThreads <= 0) {
+        nThreads = GetNumCores();
+    }
+    g_executor_holder.reset(new CExecutor(nThreads));
+    g_executor = g_executor_holder.get();
+}
+
+CExecutor& GetExecutor()
+{
+    CExecutor* pexecutor = g_executor;
+    if (pexecutor == nullptr) {
+        InitExecutor(DEFAULT_EXECUTOR_THREADS);
+        pexecutor = g_executor;
+    }
+    return *pexecutor;
+}
+
+void StopExecutor()
+{
+    CExecutor* pexecutor = g_executor;
+    if (pexecutor != nullptr) {
+        pexecutor->Stop();
+    }
+}
@@ -0,0 +1,151 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_EXECUTOR_H
+#define BITCOIN_EXECUTOR_H
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! -executorthreads default, 0 means one thread per core
+static const int DEFAULT_EXECUTOR_THREADS = 0;
+static const int MAX_EXECUTOR_THREADS = 64;
+
+/**
+ * Priority classes of the tasks run by CExecutor. A worker only starts a task of a class when no task of a higher
+ * class is waiting.
+ */
+enum class ExecutorPriority : int {
+    CONSENSUS = 0, // script checks of the blocks being connected
+    LLMQ,          // BLS work of the DKG, signing, InstantSend and ChainLocks
+    RPC,
+    BACKGROUND,
+    COUNT,
+};
+
+const char* ExecutorPriorityName(ExecutorPriority priority);
+
+struct CExecutorStats
+{
+    size_t nPending{0};
+    size_t nRunning{0};
+    uint64_t nTasks{0};
+    int64_t nBusyMicros{0};
+};
+
+/**
+ * Pool of worker threads shared by the compute heavy subsystems, so that they don't oversubscribe the cores with pools
+ * of their own and can use each other's idle capacity.
+ *
+ * Tasks pushed from outside of the pool go to the queue of their priority class. Tasks pushed by a task which runs on
+ * the pool (e.g. the recursive aggregations of CBLSWorker) inherit its priority and go to the local queue of that
+ * worker, which runs them LIFO while their inputs are still in its caches. Idle workers steal the oldest ones.
+ *
+ * Tasks must not block on the results of other tasks of the pool, as all workers could end up waiting then.
+ */
+class CExecutor
+{
+public:
+    //! Gets the id of the worker thread, like the tasks of ctpl::thread_pool
+    typedef std::function<void(int)> Task;
+
+    explicit CExecutor(int nThreadsIn);
+    ~CExecutor();
+
+    int size() const { return nThreads; }
+
+    void Push(ExecutorPriority priority, Task task);
+
+    /**
+     * Calls f(i) for each i in [0, nCount) on the workers and on the calling thread, returns when all calls returned.
+     * The calling thread takes the items which no worker took yet, so this doesn't depend on idle workers and can be
+     * called by a task. f must not throw.
+     */
+    void ParallelFor(ExecutorPriority priority, size_t nCount, const std::function<void(size_t)>& f);
+
+    //! Drops the tasks which didn't start yet and waits for the running ones
+    void Stop();
+    bool IsStopped() const;
+
+    //! Indexed by ExecutorPriority
+    std::array<CExecutorStats, (size_t)ExecutorPriority::COUNT> GetStats() const;
+
+private:
+    struct Entry
+    {
+        ExecutorPriority priority;
+        Task task;
+    };
+
+    const int nThreads;
+
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    bool fStop{false};
+    std::array<std::deque<Entry>, (size_t)ExecutorPriority::COUNT> queues;
+    std::vector<std::deque<Entry>> localQueues;
+    std::array<CExecutorStats, (size_t)ExecutorPriority::COUNT> stats;
+    std::vector<std::thread> threads;
+
+    void Loop(int nId);
+    // requires mutex
+    bool PopTask(int nId, Entry& entryRet);
+};
+
+/**
+ * The tasks of one subsystem on the shared executor, with the interface of ctpl::thread_pool. Stop() drops the tasks
+ * of this client which didn't start yet and waits for the running ones, the futures of the dropped tasks get a
+ * broken_promise.
+ */
+class CExecutorClient
+{
+private:
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool fActive{true};
+        int nRunning{0};
+    };
+
+    const ExecutorPriority priority;
+    std::shared_ptr<State> state;
+    int nConcurrency{0};
+
+    void PushTask(std::function<void(int)> task);
+
+public:
+    explicit CExecutorClient(ExecutorPriority priorityIn);
+    ~CExecutorClient();
+
+    //! nConcurrencyIn is the number of tasks it should split its work into, 0 for the size of the executor
+    void Start(int nConcurrencyIn = 0);
+    void Stop();
+
+    int size() const;
+
+    template<typename F, typename... Rest>
+    auto push(F&& f, Rest&&... rest) -> std::future<decltype(f(0, rest...))>
+    {
+        auto pck = std::make_shared<std::packaged_task<decltype(f(0, rest...))(int)>>(
+            std::bind(std::forward<F>(f), std::placeholders::_1, std::forward<Rest>(rest)...));
+        PushTask([pck](int nId) { (*pck)(nId); });
+        return pck->get_future();
+    }
+};
+
+/** The process-wide executor, created on first use with one thread per core unless InitExecutor was called before */
+CExecutor& GetExecutor();
+/** Creates the executor with nThreads threads (0 = one per core), does nothing if it's in use and not stopped */
+void InitExecutor(int nThreads);
+void StopExecutor();
+
+#endif // BITCOIN_EXECUTOR_H
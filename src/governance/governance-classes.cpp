@@ -120,6 +120,7 @@ bool CGovernanceTriggerManager::AddNewTrigger(uint256 nHash)
     pSuperblock->SetStatus(SEEN_OBJECT_IS_VALID);
 
     mapTrigger.insert(std::make_pair(nHash, pSuperblock));
+    mapTriggersByHeight[pSuperblock->GetBlockHeight()].insert(nHash);
 
     return true;
 }
@@ -184,6 +185,15 @@ void CGovernanceTriggerManager::CleanAndRemove()
             }
             LogPrint(BCLog::GOBJECT, "CGovernanceTriggerManager::CleanAndRemove -- Removing trigger object %s\n", strDataAsPlainString);
             // delete the trigger
+            if (pSuperblock) {
+                auto itHeight = mapTriggersByHeight.find(pSuperblock->GetBlockHeight());
+                if (itHeight != mapTriggersByHeight.end()) {
+                    itHeight->second.erase(it->first);
+                    if (itHeight->second.empty()) {
+                        mapTriggersByHeight.erase(itHeight);
+                    }
+                }
+            }
             mapTrigger.erase(it++);
         } else {
             ++it;
@@ -192,22 +202,28 @@ void CGovernanceTriggerManager::CleanAndRemove()
 }
 
 /**
-*   Get Active Triggers
+*   Get Active Triggers At Height
 *
-*   - Look through triggers and scan for active ones
+*   - Look through the triggers for a superblock height and scan for active ones
 *   - Return the triggers in a list
 */
 
-std::vector<CSuperblock_sptr> CGovernanceTriggerManager::GetActiveTriggers()
+std::vector<CSuperblock_sptr> CGovernanceTriggerManager::GetActiveTriggersAtHeight(int nBlockHeight)
 {
     AssertLockHeld(governance.cs);
     std::vector<CSuperblock_sptr> vecResults;
 
+    auto itHeight = mapTriggersByHeight.find(nBlockHeight);
+    if (itHeight == mapTriggersByHeight.end()) {
+        return vecResults;
+    }
+
     // LOOK AT THESE OBJECTS AND COMPILE A VALID LIST OF TRIGGERS
-    for (const auto& pair : mapTrigger) {
-        CGovernanceObject* pObj = governance.FindGovernanceObject(pair.first);
-        if (pObj) {
-            vecResults.push_back(pair.second);
+    for (const uint256& nHash : itHeight->second) {
+        CGovernanceObject* pObj = governance.FindGovernanceObject(nHash);
+        auto it = mapTrigger.find(nHash);
+        if (pObj && it != mapTrigger.end()) {
+            vecResults.push_back(it->second);
         }
     }
 
@@ -228,8 +244,8 @@ bool CSuperblockManager::IsSuperblockTriggered(int nBlockHeight)
     }
 
     LOCK(governance.cs);
-    // GET ALL ACTIVE TRIGGERS
-    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
+    // GET ALL ACTIVE TRIGGERS FOR THIS HEIGHT
+    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggersAtHeight(nBlockHeight);
 
     LogPrint(BCLog::GOBJECT, "CSuperblockManager::IsSuperblockTriggered -- vecTriggers.size() = %d\n", vecTriggers.size());
 
@@ -259,7 +275,7 @@ bool CSuperblockManager::IsSuperblockTriggered(int nBlockHeight)
 
         // MAKE SURE THIS TRIGGER IS ACTIVE VIA FUNDING CACHE FLAG
 
-        pObj->UpdateSentinelVariables();
+        pObj->UpdateSentinelVariablesIfChanged();
 
         if (pObj->IsSetCachedFunding()) {
             LogPrint(BCLog::GOBJECT, "CSuperblockManager::IsSuperblockTriggered -- fCacheFunding = true, returning true\n");
@@ -280,7 +296,7 @@ bool CSuperblockManager::GetBestSuperblock(CSuperblock_sptr& pSuperblockRet, int
     }
 
     AssertLockHeld(governance.cs);
-    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggers();
+    std::vector<CSuperblock_sptr> vecTriggers = triggerman.GetActiveTriggersAtHeight(nBlockHeight);
     int nYesCount = 0;
 
     for (const auto& pSuperblock : vecTriggers) {
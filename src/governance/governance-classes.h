@@ -33,14 +33,17 @@ class CGovernanceTriggerManager
 
 private:
     std::map<uint256, CSuperblock_sptr> mapTrigger;
+    // hashes of the triggers in mapTrigger by the height of their superblock
+    std::map<int, std::set<uint256> > mapTriggersByHeight;
 
-    std::vector<CSuperblock_sptr> GetActiveTriggers();
+    std::vector<CSuperblock_sptr> GetActiveTriggersAtHeight(int nBlockHeight);
     bool AddNewTrigger(uint256 nHash);
     void CleanAndRemove();
 
 public:
     CGovernanceTriggerManager() :
-        mapTrigger() {}
+        mapTrigger(),
+        mapTriggersByHeight() {}
 };
 
 /**
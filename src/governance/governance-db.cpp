@@ -0,0 +1,249 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance-db.h>
+
+#include <governance/governance.h>
+#include <util.h>
+
+static const std::string DB_MANAGER = "gov_m";
+static const std::string DB_OBJECT = "gov_o";
+static const std::string DB_CURRENT_VOTES = "gov_c";
+static const std::string DB_VOTE = "gov_v";
+
+static const std::string DB_VERSION = "gov_version";
+
+const int CGovernanceDb::CURRENT_VERSION;
+
+std::unique_ptr<CGovernanceDb> governanceDb;
+
+namespace {
+
+/** (De)serializes the part of an object or the manager that is stored as a single record */
+template <typename T>
+class RecordWrapper
+{
+private:
+    T& obj;
+
+public:
+    explicit RecordWrapper(T& objIn) : obj(objIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        obj.SerializeRecord(s);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        obj.UnserializeRecord(s);
+    }
+};
+
+template <typename T>
+RecordWrapper<T> MakeRecordWrapper(T& obj)
+{
+    return RecordWrapper<T>(obj);
+}
+
+} // namespace
+
+CGovernanceDb::CGovernanceDb(size_t nCacheSize, bool fMemory, bool fWipe) :
+    db(fMemory ? "" : (GetDataDir() / "governance"), nCacheSize, fMemory, fWipe)
+{
+    int nVersion = 0;
+    if (!db.Read(DB_VERSION, nVersion) || nVersion != CURRENT_VERSION) {
+        // Nothing to upgrade from yet, an unknown version is treated like an empty database
+        CDBBatch batch(db);
+        batch.Erase(DB_MANAGER);
+        batch.Write(DB_VERSION, CURRENT_VERSION);
+        db.WriteBatch(batch);
+    }
+}
+
+bool CGovernanceDb::HasData()
+{
+    return db.Exists(DB_MANAGER);
+}
+
+void CGovernanceDb::WriteObjectRecord(CDBBatch& batch, const CGovernanceObject& govobj)
+{
+    batch.Write(std::make_tuple(DB_OBJECT, govobj.GetHash()), MakeRecordWrapper(govobj));
+}
+
+void CGovernanceDb::WriteRecords(const CGovernanceManager& governance, const std::map<uint256, CGovernanceObject>& mapObjects)
+{
+    CDBBatch batch(db);
+    for (const auto& p : mapObjects) {
+        WriteObjectRecord(batch, p.second);
+    }
+    batch.Write(DB_MANAGER, MakeRecordWrapper(governance));
+    db.WriteBatch(batch);
+}
+
+bool CGovernanceDb::ReadManager(CGovernanceManager& governance)
+{
+    auto wrapper = MakeRecordWrapper(governance);
+    return db.Read(DB_MANAGER, wrapper);
+}
+
+void CGovernanceDb::WriteObject(const CGovernanceObject& govobj)
+{
+    LOCK(govobj.cs);
+
+    const uint256 nHash = govobj.GetHash();
+    CDBBatch batch(db);
+    WriteObjectRecord(batch, govobj);
+    for (const auto& p : govobj.mapCurrentMNVotes) {
+        batch.Write(std::make_tuple(DB_CURRENT_VOTES, nHash, p.first), p.second);
+    }
+    if (govobj.fVoteFileLoaded) {
+        for (const auto& vote : govobj.fileVotes.GetVotes()) {
+            batch.Write(std::make_tuple(DB_VOTE, nHash, vote.GetHash()), vote);
+        }
+    }
+    db.WriteBatch(batch);
+}
+
+void CGovernanceDb::EraseObject(const uint256& nHash)
+{
+    CDBBatch batch(db);
+    batch.Erase(std::make_tuple(DB_OBJECT, nHash));
+
+    std::unique_ptr<CDBIterator> it(db.NewIterator());
+    auto firstKey = std::make_tuple(DB_CURRENT_VOTES, nHash, COutPoint(uint256(), 0));
+    it->Seek(firstKey);
+    while (it->Valid()) {
+        decltype(firstKey) curKey;
+        if (!it->GetKey(curKey) || std::get<0>(curKey) != DB_CURRENT_VOTES || std::get<1>(curKey) != nHash) {
+            break;
+        }
+        batch.Erase(curKey);
+        it->Next();
+    }
+
+    for (const uint256& nVoteHash : ReadVoteHashes(nHash)) {
+        batch.Erase(std::make_tuple(DB_VOTE, nHash, nVoteHash));
+    }
+    db.WriteBatch(batch);
+}
+
+bool CGovernanceDb::ReadObjects(std::map<uint256, CGovernanceObject>& mapObjects)
+{
+    mapObjects.clear();
+
+    std::unique_ptr<CDBIterator> it(db.NewIterator());
+    auto firstKey = std::make_tuple(DB_OBJECT, uint256());
+    it->Seek(firstKey);
+    while (it->Valid()) {
+        decltype(firstKey) curKey;
+        if (!it->GetKey(curKey) || std::get<0>(curKey) != DB_OBJECT) {
+            break;
+        }
+        CGovernanceObject govobj;
+        auto wrapper = MakeRecordWrapper(govobj);
+        if (!it->GetValue(wrapper)) {
+            return error("CGovernanceDb::%s -- failed to read object %s", __func__, std::get<1>(curKey).ToString());
+        }
+        govobj.fVoteFileLoaded = false;
+        mapObjects.emplace(std::get<1>(curKey), govobj);
+        it->Next();
+    }
+
+    // The current votes of all objects, sorted by object
+    auto firstVotesKey = std::make_tuple(DB_CURRENT_VOTES, uint256(), COutPoint(uint256(), 0));
+    it->Seek(firstVotesKey);
+    while (it->Valid()) {
+        decltype(firstVotesKey) curKey;
+        if (!it->GetKey(curKey) || std::get<0>(curKey) != DB_CURRENT_VOTES) {
+            break;
+        }
+        vote_rec_t voteRecord;
+        if (!it->GetValue(voteRecord)) {
+            return error("CGovernanceDb::%s -- failed to read votes of %s for %s", __func__,
+                std::get<2>(curKey).ToStringShort(), std::get<1>(curKey).ToString());
+        }
+        auto objIt = mapObjects.find(std::get<1>(curKey));
+        if (objIt != mapObjects.end()) {
+            objIt->second.mapCurrentMNVotes.emplace(std::get<2>(curKey), voteRecord);
+        }
+        it->Next();
+    }
+    for (auto& p : mapObjects) {
+        p.second.RebuildVoteTally();
+    }
+    return true;
+}
+
+void CGovernanceDb::WriteVote(const CGovernanceVote& vote, const std::vector<uint256>& vecReplacedVotes, const vote_rec_t& voteRecord)
+{
+    const uint256& nParentHash = vote.GetParentHash();
+    CDBBatch batch(db);
+    batch.Write(std::make_tuple(DB_VOTE, nParentHash, vote.GetHash()), vote);
+    for (const uint256& nVoteHash : vecReplacedVotes) {
+        batch.Erase(std::make_tuple(DB_VOTE, nParentHash, nVoteHash));
+    }
+    batch.Write(std::make_tuple(DB_CURRENT_VOTES, nParentHash, vote.GetMasternodeOutpoint()), voteRecord);
+    db.WriteBatch(batch);
+}
+
+void CGovernanceDb::EraseVotes(const uint256& nParentHash, const COutPoint& mnOutpoint, const std::set<uint256>& setVoteHashes, const vote_rec_t& voteRecord)
+{
+    CDBBatch batch(db);
+    for (const uint256& nVoteHash : setVoteHashes) {
+        batch.Erase(std::make_tuple(DB_VOTE, nParentHash, nVoteHash));
+    }
+    if (voteRecord.mapInstances.empty()) {
+        batch.Erase(std::make_tuple(DB_CURRENT_VOTES, nParentHash, mnOutpoint));
+    } else {
+        batch.Write(std::make_tuple(DB_CURRENT_VOTES, nParentHash, mnOutpoint), voteRecord);
+    }
+    db.WriteBatch(batch);
+}
+
+bool CGovernanceDb::ReadVoteFile(const uint256& nParentHash, CGovernanceObjectVoteFile& fileVotes)
+{
+    CGovernanceObjectVoteFile::vote_l_t listVotes;
+
+    std::unique_ptr<CDBIterator> it(db.NewIterator());
+    auto firstKey = std::make_tuple(DB_VOTE, nParentHash, uint256());
+    it->Seek(firstKey);
+    bool fOk = true;
+    while (it->Valid()) {
+        decltype(firstKey) curKey;
+        if (!it->GetKey(curKey) || std::get<0>(curKey) != DB_VOTE || std::get<1>(curKey) != nParentHash) {
+            break;
+        }
+        CGovernanceVote vote;
+        if (it->GetValue(vote)) {
+            listVotes.push_back(vote);
+        } else {
+            fOk = false;
+        }
+        it->Next();
+    }
+
+    fileVotes.SetVotes(std::move(listVotes));
+    return fOk;
+}
+
+std::vector<uint256> CGovernanceDb::ReadVoteHashes(const uint256& nParentHash)
+{
+    std::vector<uint256> vecResult;
+
+    std::unique_ptr<CDBIterator> it(db.NewIterator());
+    auto firstKey = std::make_tuple(DB_VOTE, nParentHash, uint256());
+    it->Seek(firstKey);
+    while (it->Valid()) {
+        decltype(firstKey) curKey;
+        if (!it->GetKey(curKey) || std::get<0>(curKey) != DB_VOTE || std::get<1>(curKey) != nParentHash) {
+            break;
+        }
+        vecResult.push_back(std::get<2>(curKey));
+        it->Next();
+    }
+    return vecResult;
+}
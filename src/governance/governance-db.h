@@ -0,0 +1,76 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
+#define BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
+
+#include <dbwrapper.h>
+#include <governance/governance-object.h>
+#include <governance/governance-vote.h>
+#include <governance/governance-votedb.h>
+#include <uint256.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+class CGovernanceManager;
+
+/** Default for -governancedat */
+static const bool DEFAULT_GOVERNANCE_DAT = false;
+
+/**
+ * LevelDB-backed store of the governance objects and their votes, so they don't have to be written and loaded
+ * in full (governance.dat, which is still used to import and export the data) on every shutdown and start.
+ *
+ * Objects are written when they are accepted and every vote is written on its own, along with the current votes
+ * of its masternode for the object. The vote files of the objects are only read when they are needed. Changes to
+ * the objects themselves (deletion and expiration) and the other data of the manager are written periodically.
+ */
+class CGovernanceDb
+{
+private:
+    static const int CURRENT_VERSION = 1;
+
+    CDBWrapper db;
+
+    void WriteObjectRecord(CDBBatch& batch, const CGovernanceObject& govobj);
+
+public:
+    CGovernanceDb(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    /** Whether the data of the manager was written before, if not it still has to be imported from governance.dat */
+    bool HasData();
+
+    /** Write the data of the manager and the records of all of its objects (but not their votes) */
+    void WriteRecords(const CGovernanceManager& governance, const std::map<uint256, CGovernanceObject>& mapObjects);
+    bool ReadManager(CGovernanceManager& governance);
+
+    /** Write an object with its current masternode votes and, if loaded, its vote file */
+    void WriteObject(const CGovernanceObject& govobj);
+    /** Erase an object with all its votes */
+    void EraseObject(const uint256& nHash);
+    /** Read all objects with their current masternode votes, but without their vote files */
+    bool ReadObjects(std::map<uint256, CGovernanceObject>& mapObjects);
+
+    /**
+     * Add a vote, erasing the older votes it replaced, and update the current votes of its masternode for the
+     * object.
+     */
+    void WriteVote(const CGovernanceVote& vote, const std::vector<uint256>& vecReplacedVotes, const vote_rec_t& voteRecord);
+    /**
+     * Erase votes of a masternode for an object and update its current votes, which are erased too if voteRecord
+     * has no instances left.
+     */
+    void EraseVotes(const uint256& nParentHash, const COutPoint& mnOutpoint, const std::set<uint256>& setVoteHashes, const vote_rec_t& voteRecord);
+    bool ReadVoteFile(const uint256& nParentHash, CGovernanceObjectVoteFile& fileVotes);
+    /** Hashes of the votes of an object, without reading the votes */
+    std::vector<uint256> ReadVoteHashes(const uint256& nParentHash);
+};
+
+/** The governance database, nullptr with -disablegovernance (and in unit tests), where all votes stay in memory */
+extern std::unique_ptr<CGovernanceDb> governanceDb;
+
+#endif // BITCOIN_GOVERNANCE_GOVERNANCE_DB_H
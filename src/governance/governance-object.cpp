@@ -4,12 +4,15 @@
 
 #include <governance/governance-object.h>
 #include <core_io.h>
+#include <governance/governance-db.h>
 #include <governance/governance-validators.h>
 #include <governance/governance.h>
 #include <masternode/masternode-meta.h>
 #include <masternode/masternode-sync.h>
+#include <memusage.h>
 #include <messagesigner.h>
 #include <spork.h>
+#include <timedata.h>
 #include <validation.h>
 #include <validationinterface.h>
 
@@ -34,9 +37,16 @@ CGovernanceObject::CGovernanceObject() :
     fCachedEndorsed(false),
     fDirtyCache(true),
     fExpired(false),
+    nSentinelMNListBlockHash(),
     fUnparsable(false),
+    proposalValidity(),
+    pubKeySigVerified(),
+    fSigVerified(false),
     mapCurrentMNVotes(),
-    fileVotes()
+    voteTally(),
+    fileVotes(),
+    fVoteFileLoaded(true),
+    nTimeVoteFileUsed(0)
 {
     // PARSE JSON DATA STORAGE (VCHDATA)
     LoadData();
@@ -61,9 +71,16 @@ CGovernanceObject::CGovernanceObject(const uint256& nHashParentIn, int nRevision
     fCachedEndorsed(false),
     fDirtyCache(true),
     fExpired(false),
+    nSentinelMNListBlockHash(),
     fUnparsable(false),
+    proposalValidity(),
+    pubKeySigVerified(),
+    fSigVerified(false),
     mapCurrentMNVotes(),
-    fileVotes()
+    voteTally(),
+    fileVotes(),
+    fVoteFileLoaded(true),
+    nTimeVoteFileUsed(0)
 {
     // PARSE JSON DATA STORAGE (VCHDATA)
     LoadData();
@@ -88,19 +105,99 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other) :
     fCachedEndorsed(other.fCachedEndorsed),
     fDirtyCache(other.fDirtyCache),
     fExpired(other.fExpired),
+    nSentinelMNListBlockHash(other.nSentinelMNListBlockHash),
     fUnparsable(other.fUnparsable),
+    fSigVerified(false),
     mapCurrentMNVotes(other.mapCurrentMNVotes),
-    fileVotes(other.fileVotes)
+    voteTally(other.voteTally),
+    fileVotes(other.fileVotes),
+    fVoteFileLoaded(other.fVoteFileLoaded),
+    nTimeVoteFileUsed(other.nTimeVoteFileUsed)
 {
+    LOCK(other.cs);
+    proposalValidity = other.proposalValidity;
+    pubKeySigVerified = other.pubKeySigVerified;
+    fSigVerified = other.fSigVerified;
+}
+
+void CGovernanceObject::EnsureVoteFileLoaded() const
+{
+    LOCK(cs);
+
+    nTimeVoteFileUsed = GetTime();
+    if (fVoteFileLoaded || !governanceDb) {
+        return;
+    }
+    if (!governanceDb->ReadVoteFile(GetHash(), fileVotes)) {
+        LogPrintf("CGovernanceObject::%s -- failed to read vote file of %s\n", __func__, GetHash().ToString());
+    }
+    fVoteFileLoaded = true;
+}
+
+void CGovernanceObject::UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta)
+{
+    // Out of range values can only come from old records, they were never counted
+    if (nSignal < 0 || nSignal > MAX_SUPPORTED_VOTE_SIGNAL || eOutcome < VOTE_OUTCOME_NONE || eOutcome > VOTE_OUTCOME_ABSTAIN) {
+        return;
+    }
+    voteTally[nSignal][eOutcome] += nDelta;
+}
+
+void CGovernanceObject::RebuildVoteTally()
+{
+    LOCK(cs);
+
+    voteTally = {};
+    for (const auto& votepair : mapCurrentMNVotes) {
+        for (const auto& instancepair : votepair.second.mapInstances) {
+            UpdateVoteTally(instancepair.first, instancepair.second.eOutcome, 1);
+        }
+    }
+}
+
+std::vector<uint256> CGovernanceObject::GetVoteHashes() const
+{
+    LOCK(cs);
+
+    if (!fVoteFileLoaded && governanceDb) {
+        return governanceDb->ReadVoteHashes(GetHash());
+    }
+    return fileVotes.GetVoteHashes();
+}
+
+bool CGovernanceObject::UnloadVoteFile(int64_t nUnusedSince)
+{
+    LOCK(cs);
+
+    // All votes are written to the database as they are added
+    if (!fVoteFileLoaded || !governanceDb || nTimeVoteFileUsed > nUnusedSince) {
+        return false;
+    }
+    fileVotes.SetVotes(CGovernanceObjectVoteFile::vote_l_t());
+    fVoteFileLoaded = false;
+    return true;
+}
+
+size_t CGovernanceObject::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    size_t ret = memusage::DynamicUsage(vchData) + memusage::DynamicUsage(vchSig) + memusage::DynamicUsage(mapCurrentMNVotes);
+    for (const auto& p : mapCurrentMNVotes) {
+        ret += memusage::DynamicUsage(p.second.mapInstances);
+    }
+    return ret + fileVotes.DynamicMemoryUsage();
 }
 
 bool CGovernanceObject::ProcessVote(CNode* pfrom,
     const CGovernanceVote& vote,
     CGovernanceException& exception,
-    CConnman& connman)
+    CConnman& connman,
+    bool fSignatureVerified)
 {
     LOCK(cs);
 
+    EnsureVoteFileLoaded();
+
     // do not process already known valid votes twice
     if (fileVotes.HasVote(vote.GetHash())) {
         // nothing to do here, not an error
@@ -138,8 +235,11 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         exception = CGovernanceException(ostr.str(), GOVERNANCE_EXCEPTION_PERMANENT_ERROR, 20);
         return false;
     }
-    auto it2 = voteRecordRef.mapInstances.emplace(vote_instance_m_t::value_type(int(eSignal), vote_instance_t())).first;
-    vote_instance_t& voteInstanceRef = it2->second;
+    auto ret = voteRecordRef.mapInstances.emplace(vote_instance_m_t::value_type(int(eSignal), vote_instance_t()));
+    if (ret.second) {
+        UpdateVoteTally(eSignal, VOTE_OUTCOME_NONE, 1);
+    }
+    vote_instance_t& voteInstanceRef = ret.first->second;
 
     // Reject obsolete votes
     if (vote.GetTimestamp() < voteInstanceRef.nCreationTime) {
@@ -185,7 +285,7 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     bool onlyVotingKeyAllowed = nObjectType == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
     // Finally check that the vote is actually valid (done last because of cost of signature verification)
-    if (!vote.IsValid(onlyVotingKeyAllowed)) {
+    if (!vote.IsValid(onlyVotingKeyAllowed, !fSignatureVerified)) {
         std::ostringstream ostr;
         ostr << "CGovernanceObject::ProcessVote -- Invalid vote"
              << ", MN outpoint = " << vote.GetMasternodeOutpoint().ToStringShort()
@@ -207,8 +307,13 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
         return false;
     }
 
+    UpdateVoteTally(eSignal, voteInstanceRef.eOutcome, -1);
     voteInstanceRef = vote_instance_t(vote.GetOutcome(), nVoteTimeUpdate, vote.GetTimestamp());
-    fileVotes.AddVote(vote);
+    UpdateVoteTally(eSignal, voteInstanceRef.eOutcome, 1);
+    std::vector<uint256> vecReplacedVotes = fileVotes.AddVote(vote);
+    if (governanceDb) {
+        governanceDb->WriteVote(vote, vecReplacedVotes, voteRecordRef);
+    }
     fDirtyCache = true;
     // SEND NOTIFICATION TO SCRIPT/ZMQ
     GetMainSignals().NotifyGovernanceVote(std::make_shared<const CGovernanceVote>(vote));
@@ -224,7 +329,14 @@ void CGovernanceObject::ClearMasternodeVotes()
     auto it = mapCurrentMNVotes.begin();
     while (it != mapCurrentMNVotes.end()) {
         if (!mnList.HasMNByCollateral(it->first)) {
-            fileVotes.RemoveVotesFromMasternode(it->first);
+            EnsureVoteFileLoaded();
+            auto removedVotes = fileVotes.RemoveVotesFromMasternode(it->first);
+            if (governanceDb) {
+                governanceDb->EraseVotes(GetHash(), it->first, removedVotes, vote_rec_t());
+            }
+            for (const auto& instancepair : it->second.mapInstances) {
+                UpdateVoteTally(instancepair.first, instancepair.second.eOutcome, -1);
+            }
             mapCurrentMNVotes.erase(it++);
             fDirtyCache = true;
         } else {
@@ -243,6 +355,7 @@ std::set<uint256> CGovernanceObject::RemoveInvalidVotes(const COutPoint& mnOutpo
         return {};
     }
 
+    EnsureVoteFileLoaded();
     auto removedVotes = fileVotes.RemoveInvalidVotes(mnOutpoint, nObjectType == GOVERNANCE_OBJECT_PROPOSAL);
     if (removedVotes.empty()) {
         return {};
@@ -253,11 +366,15 @@ std::set<uint256> CGovernanceObject::RemoveInvalidVotes(const COutPoint& mnOutpo
         CGovernanceVote tmpVote(mnOutpoint, nParentHash, (vote_signal_enum_t)jt->first, jt->second.eOutcome);
         tmpVote.SetTime(jt->second.nCreationTime);
         if (removedVotes.count(tmpVote.GetHash())) {
+            UpdateVoteTally(jt->first, jt->second.eOutcome, -1);
             jt = it->second.mapInstances.erase(jt);
         } else {
             ++jt;
         }
     }
+    if (governanceDb) {
+        governanceDb->EraseVotes(nParentHash, mnOutpoint, removedVotes, it->second);
+    }
     if (it->second.mapInstances.empty()) {
         mapCurrentMNVotes.erase(it);
     }
@@ -300,6 +417,8 @@ uint256 CGovernanceObject::GetSignatureHash() const
 void CGovernanceObject::SetMasternodeOutpoint(const COutPoint& outpoint)
 {
     masternodeOutpoint = outpoint;
+    LOCK(cs);
+    fSigVerified = false;
 }
 
 bool CGovernanceObject::Sign(const CBLSSecretKey& key)
@@ -309,6 +428,8 @@ bool CGovernanceObject::Sign(const CBLSSecretKey& key)
         return false;
     }
     vchSig = sig.ToByteVector();
+    LOCK(cs);
+    fSigVerified = false;
     return true;
 }
 
@@ -321,6 +442,23 @@ bool CGovernanceObject::CheckSignature(const CBLSPublicKey& pubKey) const
     return true;
 }
 
+bool CGovernanceObject::CheckSignatureCached(const CBLSPublicKey& pubKey) const
+{
+    {
+        LOCK(cs);
+        if (fSigVerified && pubKeySigVerified == pubKey) {
+            return true;
+        }
+    }
+    if (!CheckSignature(pubKey)) {
+        return false;
+    }
+    LOCK(cs);
+    pubKeySigVerified = pubKey;
+    fSigVerified = true;
+    return true;
+}
+
 /**
    Return the actual object from the vchData JSON structure.
 
@@ -463,12 +601,12 @@ bool CGovernanceObject::IsValidLocally(std::string& strError, bool& fMissingConf
 
     switch (nObjectType) {
     case GOVERNANCE_OBJECT_PROPOSAL: {
-        CProposalValidator validator(GetDataAsHexString(), true);
         // Note: It's ok to have expired proposals
         // they are going to be cleared by CGovernanceManager::UpdateCachesAndClean()
         // TODO: should they be tagged as "expired" to skip vote downloading?
-        if (!validator.Validate(false)) {
-            strError = strprintf("Invalid proposal data, error messages: %s", validator.GetErrorMessages());
+        std::string strProposalError;
+        if (!ValidateProposal(strProposalError, false)) {
+            strError = strprintf("Invalid proposal data, error messages: %s", strProposalError);
             return false;
         }
         if (fCheckCollateral && !IsCollateralValid(strError, fMissingConfirmations)) {
@@ -493,7 +631,7 @@ bool CGovernanceObject::IsValidLocally(std::string& strError, bool& fMissingConf
         }
 
         // Check that we have a valid MN signature
-        if (!CheckSignature(dmn->pdmnState->pubKeyOperator.Get())) {
+        if (!CheckSignatureCached(dmn->pdmnState->pubKeyOperator.Get())) {
             strError = "Invalid masternode signature for: " + strOutpoint + ", pubkey = " + dmn->pdmnState->pubKeyOperator.Get().ToString();
             return false;
         }
@@ -507,6 +645,27 @@ bool CGovernanceObject::IsValidLocally(std::string& strError, bool& fMissingConf
     }
 }
 
+bool CGovernanceObject::ValidateProposal(std::string& strError, bool fCheckExpiration) const
+{
+    LOCK(cs);
+    if (!proposalValidity.fValidated) {
+        CProposalValidator validator(GetDataAsHexString(), true);
+        proposalValidity.fValid = validator.Validate(false);
+        proposalValidity.nEndEpoch = validator.GetEndEpoch();
+        proposalValidity.strErrorMessages = validator.GetErrorMessages();
+        proposalValidity.fValidated = true;
+    }
+    if (!proposalValidity.fValid) {
+        strError = proposalValidity.strErrorMessages;
+        return false;
+    }
+    if (fCheckExpiration && proposalValidity.nEndEpoch <= GetAdjustedTime()) {
+        strError = "expired;";
+        return false;
+    }
+    return true;
+}
+
 CAmount CGovernanceObject::GetMinCollateralFee() const
 {
     // Only 1 type has a fee for the moment but switch statement allows for future object types
@@ -610,15 +769,11 @@ int CGovernanceObject::CountMatchingVotes(vote_signal_enum_t eVoteSignalIn, vote
 {
     LOCK(cs);
 
-    int nCount = 0;
-    for (const auto& votepair : mapCurrentMNVotes) {
-        const vote_rec_t& recVote = votepair.second;
-        auto it2 = recVote.mapInstances.find(eVoteSignalIn);
-        if (it2 != recVote.mapInstances.end() && it2->second.eOutcome == eVoteOutcomeIn) {
-            ++nCount;
-        }
+    if (eVoteSignalIn < VOTE_SIGNAL_NONE || eVoteSignalIn > MAX_SUPPORTED_VOTE_SIGNAL ||
+        eVoteOutcomeIn < VOTE_OUTCOME_NONE || eVoteOutcomeIn > VOTE_OUTCOME_ABSTAIN) {
+        return 0;
     }
-    return nCount;
+    return voteTally[eVoteSignalIn][eVoteOutcomeIn];
 }
 
 /**
@@ -678,8 +833,10 @@ void CGovernanceObject::UpdateSentinelVariables()
 {
     // CALCULATE MINIMUM SUPPORT LEVELS REQUIRED
 
-    int nMnCount = (int)deterministicMNManager->GetListAtChainTip().GetValidMNsCount();
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+    int nMnCount = (int)mnList.GetValidMNsCount();
     if (nMnCount == 0) return;
+    nSentinelMNListBlockHash = mnList.GetBlockHash();
 
     // CALCULATE THE MINIMUM VOTE COUNT REQUIRED FOR FULL SIGNAL
 
@@ -707,3 +864,10 @@ void CGovernanceObject::UpdateSentinelVariables()
 
     if (GetAbsoluteNoCount(VOTE_SIGNAL_VALID) >= nAbsVoteReq) fCachedValid = false;
 }
+
+void CGovernanceObject::UpdateSentinelVariablesIfChanged()
+{
+    if (fDirtyCache || deterministicMNManager->GetListAtChainTip().GetBlockHash() != nSentinelMNListBlockHash) {
+        UpdateSentinelVariables();
+    }
+}
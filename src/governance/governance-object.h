@@ -18,12 +18,18 @@
 
 #include <univalue.h>
 
+#include <array>
+
+class CGovernanceDb;
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
 class CGovernanceVote;
 
 static const double GOVERNANCE_FILTER_FP_RATE = 0.001;
+// vote reconciliation tables are sized for a difference of 1/GOVERNANCE_RECON_DIFF_DIVISOR of the votes we have
+static const unsigned int GOVERNANCE_RECON_DIFF_DIVISOR = 10;
+static const unsigned int GOVERNANCE_RECON_MIN_DIFF = 50;
 
 static const int GOVERNANCE_OBJECT_UNKNOWN = 0;
 static const int GOVERNANCE_OBJECT_PROPOSAL = 1;
@@ -36,6 +42,8 @@ static const int64_t GOVERNANCE_MIN_RELAY_FEE_CONFIRMATIONS = 1;
 static const int64_t GOVERNANCE_UPDATE_MIN = 60 * 60;
 static const int64_t GOVERNANCE_DELETION_DELAY = 10 * 60;
 static const int64_t GOVERNANCE_ORPHAN_EXPIRATION_TIME = 10 * 60;
+/** Vote files that weren't used for this long are dropped from memory, if they can be read from the governance database */
+static const int64_t GOVERNANCE_VOTE_FILE_UNLOAD_TIME = 30 * 60;
 
 // FOR SEEN MAP ARRAYS - GOVERNANCE OBJECTS AND VOTES
 static const int SEEN_OBJECT_IS_VALID = 0;
@@ -91,6 +99,17 @@ struct vote_rec_t {
     }
 };
 
+/**
+ * The outcome of validating the data of a proposal, which only depends on the object itself so it's parsed and
+ * checked once. Only the expiration has to be rechecked against the time.
+ */
+struct CProposalValidity {
+    bool fValidated{false};
+    bool fValid{false};
+    int64_t nEndEpoch{0};
+    std::string strErrorMessages;
+};
+
 /**
 * Governance Object
 *
@@ -98,6 +117,8 @@ struct vote_rec_t {
 
 class CGovernanceObject
 {
+    friend class CGovernanceDb;
+
 public: // Types
     typedef std::map<COutPoint, vote_rec_t> vote_m_t;
 
@@ -156,12 +177,73 @@ private:
     /// Object is no longer of interest
     bool fExpired;
 
+    /// Block hash of the masternode list the sentinel variables were last calculated with
+    uint256 nSentinelMNListBlockHash;
+
     /// Failed to parse object data
     bool fUnparsable;
 
+    /// Cached result of validating the proposal data, see ValidateProposal
+    mutable CProposalValidity proposalValidity GUARDED_BY(cs);
+
+    /// Operator key the signature was last verified against, so MN list changes don't verify it again
+    mutable CBLSPublicKey pubKeySigVerified GUARDED_BY(cs);
+    mutable bool fSigVerified GUARDED_BY(cs);
+
     vote_m_t mapCurrentMNVotes;
 
-    CGovernanceObjectVoteFile fileVotes;
+    /// Number of vote instances in mapCurrentMNVotes for every signal and outcome, updated along with it
+    std::array<std::array<int, VOTE_OUTCOME_ABSTAIN + 1>, MAX_SUPPORTED_VOTE_SIGNAL + 1> voteTally;
+
+    /// Only read from the governance database when needed, see EnsureVoteFileLoaded
+    mutable CGovernanceObjectVoteFile fileVotes;
+    mutable bool fVoteFileLoaded;
+    mutable int64_t nTimeVoteFileUsed;
+
+    void EnsureVoteFileLoaded() const;
+
+    void UpdateVoteTally(int nSignal, vote_outcome_enum_t eOutcome, int nDelta);
+    void RebuildVoteTally();
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOpImpl(Stream& s, Operation ser_action, bool fIncludeVotes)
+    {
+        // SERIALIZE DATA FOR SAVING/LOADING OR NETWORK FUNCTIONS
+        READWRITE(nHashParent);
+        READWRITE(nRevision);
+        READWRITE(nTime);
+        READWRITE(nCollateralHash);
+        READWRITE(vchData);
+        READWRITE(nObjectType);
+        READWRITE(masternodeOutpoint);
+        if (!(s.GetType() & SER_GETHASH)) {
+            READWRITE(vchSig);
+        }
+        if (ser_action.ForRead()) {
+            LOCK(cs);
+            proposalValidity = CProposalValidity();
+            fSigVerified = false;
+        }
+        if (s.GetType() & SER_DISK) {
+            // Only include these for the disk file format
+            READWRITE(nDeletionTime);
+            READWRITE(fExpired);
+            if (fIncludeVotes) {
+                LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp Reading/writing votes from/to disk\n");
+                if (!ser_action.ForRead()) {
+                    EnsureVoteFileLoaded();
+                }
+                READWRITE(mapCurrentMNVotes);
+                if (ser_action.ForRead()) {
+                    RebuildVoteTally();
+                }
+                READWRITE(fileVotes);
+                LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
+            }
+        }
+
+        // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
+    }
 
 public:
     CGovernanceObject();
@@ -234,14 +316,26 @@ public:
 
     const CGovernanceObjectVoteFile& GetVoteFile() const
     {
+        EnsureVoteFileLoaded();
         return fileVotes;
     }
 
+    /** Hashes of all votes, read from the governance database without loading the vote file if it isn't loaded */
+    std::vector<uint256> GetVoteHashes() const;
+
+    /** Drop the vote file from memory if it wasn't used since nUnusedSince and can be read back later */
+    bool UnloadVoteFile(int64_t nUnusedSince);
+
+    /** Estimate the heap memory used by the object, without loading its vote file */
+    size_t DynamicMemoryUsage() const;
+
     // Signature related functions
 
     void SetMasternodeOutpoint(const COutPoint& outpoint);
     bool Sign(const CBLSSecretKey& key);
     bool CheckSignature(const CBLSPublicKey& pubKey) const;
+    /** CheckSignature, skipped if the signature was already verified against pubKey */
+    bool CheckSignatureCached(const CBLSPublicKey& pubKey) const;
 
     uint256 GetSignatureHash() const;
 
@@ -251,12 +345,18 @@ public:
 
     bool IsValidLocally(std::string& strError, bool& fMissingConfirmations, bool fCheckCollateral) const;
 
+    /** Validate the data of a proposal, which is only parsed the first time. With fCheckExpiration, proposals whose
+     *  end_epoch has passed are invalid too */
+    bool ValidateProposal(std::string& strError, bool fCheckExpiration) const;
+
     /// Check the collateral transaction for the budget proposal/finalized budget
     bool IsCollateralValid(std::string& strError, bool& fMissingConfirmations) const;
 
     void UpdateLocalValidity();
 
     void UpdateSentinelVariables();
+    /** UpdateSentinelVariables if a vote or the masternode list changed since they were calculated */
+    void UpdateSentinelVariablesIfChanged();
 
     void PrepareDeletion(int64_t nDeletionTime_)
     {
@@ -298,28 +398,20 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
-        // SERIALIZE DATA FOR SAVING/LOADING OR NETWORK FUNCTIONS
-        READWRITE(nHashParent);
-        READWRITE(nRevision);
-        READWRITE(nTime);
-        READWRITE(nCollateralHash);
-        READWRITE(vchData);
-        READWRITE(nObjectType);
-        READWRITE(masternodeOutpoint);
-        if (!(s.GetType() & SER_GETHASH)) {
-            READWRITE(vchSig);
-        }
-        if (s.GetType() & SER_DISK) {
-            // Only include these for the disk file format
-            LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp Reading/writing votes from/to disk\n");
-            READWRITE(nDeletionTime);
-            READWRITE(fExpired);
-            READWRITE(mapCurrentMNVotes);
-            READWRITE(fileVotes);
-            LogPrint(BCLog::GOBJECT, "CGovernanceObject::SerializationOp hash = %s, vote count = %d\n", GetHash().ToString(), fileVotes.GetVoteCount());
-        }
+        SerializationOpImpl(s, ser_action, true);
+    }
 
-        // AFTER DESERIALIZATION OCCURS, CACHED VARIABLES MUST BE CALCULATED MANUALLY
+    /** The disk format without the votes, which the governance database stores separately */
+    template <typename Stream>
+    void SerializeRecord(Stream& s) const
+    {
+        const_cast<CGovernanceObject*>(this)->SerializationOpImpl(s, CSerActionSerialize(), false);
+    }
+
+    template <typename Stream>
+    void UnserializeRecord(Stream& s)
+    {
+        SerializationOpImpl(s, CSerActionUnserialize(), false);
     }
 
     UniValue ToJson() const;
@@ -331,7 +423,8 @@ public:
     bool ProcessVote(CNode* pfrom,
         const CGovernanceVote& vote,
         CGovernanceException& exception,
-        CConnman& connman);
+        CConnman& connman,
+        bool fSignatureVerified = false);
 
     /// Called when MN's which have voted on this object have been removed
     void ClearMasternodeVotes();
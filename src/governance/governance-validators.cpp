@@ -129,6 +129,7 @@ bool CProposalValidator::ValidateStartEndEpoch(bool fCheckExpiration)
         strErrorMessages += "end_epoch <= start_epoch;";
         return false;
     }
+    nValidatedEndEpoch = nEndEpoch;
 
     if (fCheckExpiration && nEndEpoch <= GetAdjustedTime()) {
         strErrorMessages += "expired;";
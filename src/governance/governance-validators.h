@@ -16,6 +16,7 @@ private:
     bool fJSONValid;
     bool fAllowLegacyFormat;
     std::string strErrorMessages;
+    int64_t nValidatedEndEpoch{0};
 
 public:
     explicit CProposalValidator(const std::string& strDataHexIn = std::string(), bool fAllowLegacyFormat = true);
@@ -27,6 +28,12 @@ public:
         return strErrorMessages;
     }
 
+    /// The end_epoch field, valid once Validate got past the start/end range check
+    int64_t GetEndEpoch() const
+    {
+        return nValidatedEndEpoch;
+    }
+
 private:
     void ParseStrHexData(const std::string& strHexData);
     void ParseJSONData(const std::string& strJSONData);
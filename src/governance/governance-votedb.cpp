@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <governance/governance-votedb.h>
+#include <memusage.h>
 
 CGovernanceObjectVoteFile::CGovernanceObjectVoteFile() :
     nMemoryVotes(0),
@@ -19,16 +20,22 @@ CGovernanceObjectVoteFile::CGovernanceObjectVoteFile(const CGovernanceObjectVote
     RebuildIndex();
 }
 
-void CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
+std::vector<uint256> CGovernanceObjectVoteFile::AddVote(const CGovernanceVote& vote)
 {
     uint256 nHash = vote.GetHash();
     // make sure to never add/update already known votes
     if (HasVote(nHash))
-        return;
+        return {};
     listVotes.push_front(vote);
     mapVoteIndex.emplace(nHash, listVotes.begin());
     ++nMemoryVotes;
-    RemoveOldVotes(vote);
+    return RemoveOldVotes(vote);
+}
+
+void CGovernanceObjectVoteFile::SetVotes(vote_l_t&& listVotesIn)
+{
+    listVotes = std::move(listVotesIn);
+    RebuildIndex();
 }
 
 bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
@@ -36,6 +43,15 @@ bool CGovernanceObjectVoteFile::HasVote(const uint256& nHash) const
     return mapVoteIndex.find(nHash) != mapVoteIndex.end();
 }
 
+size_t CGovernanceObjectVoteFile::DynamicMemoryUsage() const
+{
+    size_t ret = memusage::DynamicUsage(listVotes) + memusage::DynamicUsage(mapVoteIndex);
+    for (const auto& vote : listVotes) {
+        ret += memusage::DynamicUsage(vote.GetSignature());
+    }
+    return ret;
+}
+
 bool CGovernanceObjectVoteFile::SerializeVoteToStream(const uint256& nHash, CDataStream& ss) const
 {
     auto it = mapVoteIndex.find(nHash);
@@ -55,11 +71,24 @@ std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
     return vecResult;
 }
 
-void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
+std::vector<uint256> CGovernanceObjectVoteFile::GetVoteHashes() const
 {
+    std::vector<uint256> vecResult;
+    vecResult.reserve(mapVoteIndex.size());
+    for (const auto& p : mapVoteIndex) {
+        vecResult.push_back(p.first);
+    }
+    return vecResult;
+}
+
+std::set<uint256> CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpointMasternode)
+{
+    std::set<uint256> removedVotes;
+
     auto it = listVotes.begin();
     while (it != listVotes.end()) {
         if (it->GetMasternodeOutpoint() == outpointMasternode) {
+            removedVotes.emplace(it->GetHash());
             --nMemoryVotes;
             mapVoteIndex.erase(it->GetHash());
             listVotes.erase(it++);
@@ -67,6 +96,8 @@ void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const COutPoint& outpo
             ++it;
         }
     }
+
+    return removedVotes;
 }
 
 std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint& outpointMasternode, bool fProposal)
@@ -91,8 +122,10 @@ std::set<uint256> CGovernanceObjectVoteFile::RemoveInvalidVotes(const COutPoint&
     return removedVotes;
 }
 
-void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
+std::vector<uint256> CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
 {
+    std::vector<uint256> vecRemoved;
+
     auto it = listVotes.begin();
     while (it != listVotes.end()) {
         if (it->GetMasternodeOutpoint() == vote.GetMasternodeOutpoint() // same masternode
@@ -100,6 +133,7 @@ void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
             && it->GetSignal() == vote.GetSignal() // same signal (e.g. "funding", "delete", etc.)
             && it->GetTimestamp() < vote.GetTimestamp()) // older than new vote
         {
+            vecRemoved.push_back(it->GetHash());
             --nMemoryVotes;
             mapVoteIndex.erase(it->GetHash());
             listVotes.erase(it++);
@@ -107,6 +141,8 @@ void CGovernanceObjectVoteFile::RemoveOldVotes(const CGovernanceVote& vote)
             ++it;
         }
     }
+
+    return vecRemoved;
 }
 
 void CGovernanceObjectVoteFile::RebuildIndex()
@@ -7,6 +7,8 @@
 
 #include <list>
 #include <map>
+#include <set>
+#include <vector>
 
 #include <governance/governance-vote.h>
 #include <serialize.h>
@@ -41,9 +43,14 @@ public:
     CGovernanceObjectVoteFile(const CGovernanceObjectVoteFile& other);
 
     /**
-     * Add a vote to the file
+     * Add a vote to the file, returns the hashes of the older votes of the masternode for the same signal it replaced
      */
-    void AddVote(const CGovernanceVote& vote);
+    std::vector<uint256> AddVote(const CGovernanceVote& vote);
+
+    /**
+     * Replace all votes with ones that are known to be unique and current, e.g. read from the governance database
+     */
+    void SetVotes(vote_l_t&& listVotesIn);
 
     /**
      * Return true if the vote with this hash is currently cached in memory
@@ -61,8 +68,11 @@ public:
     }
 
     std::vector<CGovernanceVote> GetVotes() const;
+    std::vector<uint256> GetVoteHashes() const;
+
+    size_t DynamicMemoryUsage() const;
 
-    void RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
+    std::set<uint256> RemoveVotesFromMasternode(const COutPoint& outpointMasternode);
     std::set<uint256> RemoveInvalidVotes(const COutPoint& outpointMasternode, bool fProposal);
 
     ADD_SERIALIZE_METHODS;
@@ -79,7 +89,7 @@ public:
 
 private:
     // Drop older votes for the same gobject from the same masternode
-    void RemoveOldVotes(const CGovernanceVote& vote);
+    std::vector<uint256> RemoveOldVotes(const CGovernanceVote& vote);
 
     void RebuildIndex();
 };
@@ -3,12 +3,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <governance/governance.h>
+#include <bls/bls_batchverifier.h>
 #include <consensus/validation.h>
+#include <ctpl.h>
 #include <governance/governance-classes.h>
-#include <governance/governance-validators.h>
+#include <governance/governance-db.h>
 #include <init.h>
 #include <masternode/masternode-meta.h>
 #include <masternode/masternode-sync.h>
+#include <memusage.h>
 #include <messagesigner.h>
 #include <net_processing.h>
 #include <netfulfilledman.h>
@@ -23,6 +26,22 @@ int nSubmittedFinalBudget;
 const std::string CGovernanceManager::SERIALIZATION_VERSION_STRING = "CGovernanceManager-Version-15";
 const int CGovernanceManager::MAX_TIME_FUTURE_DEVIATION = 60 * 60;
 const int CGovernanceManager::RELIABLE_PROPAGATION_TIME = 60;
+const size_t CGovernanceManager::MAX_PENDING_VOTES;
+const size_t CGovernanceManager::MAX_VOTES_PER_BATCH;
+
+static const int MAX_VOTE_VERIFY_THREADS = 4;
+
+/** Threads that verify the ECDSA signatures of pending votes, started on first use */
+static ctpl::thread_pool& GetVoteVerifyPool()
+{
+    static std::once_flag init;
+    static std::unique_ptr<ctpl::thread_pool> pool;
+    std::call_once(init, [] {
+        pool.reset(new ctpl::thread_pool(std::max(1, std::min(GetNumCores(), MAX_VOTE_VERIFY_THREADS))));
+        RenameThreadPool(*pool, "dash-govsig");
+    });
+    return *pool;
+}
 
 CGovernanceManager::CGovernanceManager() :
     nTimeLastDiff(0),
@@ -73,6 +92,31 @@ int CGovernanceManager::GetVoteCount() const
     return (int)cmapVoteToObject.GetSize();
 }
 
+size_t CGovernanceManager::DynamicMemoryUsage() const
+{
+    size_t ret = 0;
+    {
+        LOCK(cs);
+        ret += memusage::DynamicUsage(mapObjects) + memusage::DynamicUsage(mapPostponedObjects);
+        for (const auto& p : mapObjects) {
+            ret += p.second.DynamicMemoryUsage();
+        }
+        for (const auto& p : mapPostponedObjects) {
+            ret += p.second.DynamicMemoryUsage();
+        }
+        ret += memusage::DynamicUsage(mapErasedGovernanceObjects) + memusage::DynamicUsage(setAdditionalRelayObjects) +
+               memusage::DynamicUsage(mapLastMasternodeObject) + memusage::DynamicUsage(setRequestedObjects) +
+               memusage::DynamicUsage(setRequestedVotes);
+        ret += cmapVoteToObject.DynamicMemoryUsage() + cmapInvalidVotes.DynamicMemoryUsage() + cmmapOrphanVotes.DynamicMemoryUsage();
+    }
+    {
+        // the deque's blocks are counted as one allocation per pending vote
+        LOCK(cs_pendingVotes);
+        ret += pendingVotes.size() * memusage::MallocUsage(sizeof(pendingVotes.front()));
+    }
+    return ret;
+}
+
 bool CGovernanceManager::SerializeVoteForHash(const uint256& nHash, CDataStream& ss) const
 {
     LOCK(cs);
@@ -119,6 +163,27 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
         LogPrint(BCLog::GOBJECT, "MNGOVERNANCESYNC -- syncing governance objects to our peer %s\n", pfrom->GetLogString());
     }
 
+    // A PEER WANTS THE VOTES OF AN OBJECT THAT ARE MISSING FROM ITS TABLE
+    else if (strCommand == NetMsgType::MNGOVERNANCERECON) {
+        // Same as MNGOVERNANCESYNC for a single object
+        if (pfrom->nVersion < GOVERNANCE_RECON_VERSION || !masternodeSync.IsSynced()) return;
+
+        uint256 nProp;
+        CInvertibleBloomLookupTable iblt;
+        vRecv >> nProp >> iblt;
+
+        ReconcileSingleObjVotes(pfrom, nProp, iblt, connman);
+    }
+
+    // THE DIFFERENCE TO OUR VOTES WAS TOO LARGE FOR THE TABLE WE SENT
+    else if (strCommand == NetMsgType::MNGOVERNANCERECONFAIL) {
+        uint256 nProp;
+        vRecv >> nProp;
+
+        LogPrint(BCLog::GOBJECT, "MNGOVERNANCERECONFAIL -- falling back to a bloom filter for %s, peer=%d\n", nProp.ToString(), pfrom->GetId());
+        RequestGovernanceObject(pfrom, nProp, connman, true, false);
+    }
+
     // A NEW GOVERNANCE OBJECT HAS ARRIVED
     else if (strCommand == NetMsgType::MNGOVERNANCEOBJECT) {
         // MAKE SURE WE HAVE A VALID REFERENCE TO THE TIP BEFORE CONTINUING
@@ -237,6 +302,15 @@ void CGovernanceManager::ProcessMessage(CNode* pfrom, const std::string& strComm
             return;
         }
 
+        // Votes for unknown objects are processed right away, so the object is requested from this peer
+        if (workThread.joinable()) {
+            LOCK2(cs, cs_pendingVotes);
+            if (mapObjects.count(vote.GetParentHash()) && pendingVotes.size() < MAX_PENDING_VOTES) {
+                pendingVotes.emplace_back(pfrom->GetId(), vote);
+                return;
+            }
+        }
+
         CGovernanceException exception;
         if (ProcessVote(pfrom, vote, exception, connman)) {
             LogPrint(BCLog::GOBJECT, "MNGOVERNANCEOBJECTVOTE -- %s new\n", strHash);
@@ -308,6 +382,10 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
         return;
     }
 
+    if (governanceDb) {
+        governanceDb->WriteObject(objpair.first->second);
+    }
+
     // SHOULD WE ADD THIS OBJECT TO ANY OTHER MANAGERS?
 
     LogPrint(BCLog::GOBJECT, "CGovernanceManager::AddGovernanceObject -- Before trigger block, GetDataAsPlainString = %s, nObjectType = %d\n",
@@ -423,12 +501,15 @@ void CGovernanceManager::UpdateCachesAndClean()
             }
 
             mapErasedGovernanceObjects.insert(std::make_pair(nHash, nTimeExpired));
+            if (governanceDb) {
+                governanceDb->EraseObject(nHash);
+            }
             mapObjects.erase(it++);
         } else {
             // NOTE: triggers are handled via triggerman
             if (pObj->GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL) {
-                CProposalValidator validator(pObj->GetDataAsHexString(), true);
-                if (!validator.Validate()) {
+                std::string strError;
+                if (!pObj->ValidateProposal(strError, true)) {
                     LogPrintf("CGovernanceManager::UpdateCachesAndClean -- set for deletion expired obj %s\n", strHash);
                     pObj->PrepareDeletion(nNow);
                 }
@@ -447,6 +528,19 @@ void CGovernanceManager::UpdateCachesAndClean()
         }
     }
 
+    // drop vote files nobody asked for in a while, they are read back from the governance database when needed
+    int nUnloaded = 0;
+    for (auto& objPair : mapObjects) {
+        if (objPair.second.UnloadVoteFile(GetTime() - GOVERNANCE_VOTE_FILE_UNLOAD_TIME)) {
+            ++nUnloaded;
+        }
+    }
+    if (nUnloaded) {
+        LogPrint(BCLog::GOBJECT, "CGovernanceManager::UpdateCachesAndClean -- unloaded %d vote files\n", nUnloaded);
+    }
+
+    WriteRecordsToDb();
+
     LogPrintf("CGovernanceManager::UpdateCachesAndClean -- %s\n", ToString());
 }
 
@@ -603,6 +697,44 @@ bool CGovernanceManager::ConfirmInventoryRequest(const CInv& inv)
 }
 
 void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman)
+{
+    SyncSingleObjVotes(pnode, nProp, [&](const uint256& nVoteHash) { return filter.contains(nVoteHash); }, connman);
+}
+
+void CGovernanceManager::ReconcileSingleObjVotes(CNode* pnode, const uint256& nProp, const CInvertibleBloomLookupTable& iblt, CConnman& connman)
+{
+    // do not provide any data until our node is synced
+    if (!masternodeSync.IsSynced()) return;
+
+    // Erasing our votes from the peer's table leaves the difference, the erased short ids are the votes it lacks
+    std::set<uint64_t> setPeerOnly, setMissing;
+    bool fDecoded;
+    {
+        LOCK(cs);
+        auto it = mapObjects.find(nProp);
+        if (it == mapObjects.end()) {
+            LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- no matching object for hash %s, peer=%d\n", __func__, nProp.ToString(), pnode->GetId());
+            return;
+        }
+        CInvertibleBloomLookupTable ibltDiff(iblt);
+        for (const uint256& nVoteHash : it->second.GetVoteHashes()) {
+            ibltDiff.Erase(nVoteHash);
+        }
+        fDecoded = ibltDiff.Decode(setPeerOnly, setMissing);
+    }
+
+    if (!fDecoded) {
+        LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- failed to reconcile votes for %s, peer=%d\n", __func__, nProp.ToString(), pnode->GetId());
+        connman.PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::MNGOVERNANCERECONFAIL, nProp));
+        return;
+    }
+
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- peer=%d lacks %d votes for %s and has %d we don't have\n", __func__,
+        pnode->GetId(), setMissing.size(), nProp.ToString(), setPeerOnly.size());
+    SyncSingleObjVotes(pnode, nProp, [&](const uint256& nVoteHash) { return !setMissing.count(iblt.GetShortId(nVoteHash)); }, connman);
+}
+
+void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const std::function<bool(const uint256&)>& fnPeerHasVote, CConnman& connman)
 {
     // do not provide any data until our node is synced
     if (!masternodeSync.IsSynced()) return;
@@ -632,14 +764,12 @@ void CGovernanceManager::SyncSingleObjVotes(CNode* pnode, const uint256& nProp,
         return;
     }
 
-    auto fileVotes = govobj.GetVoteFile();
-
-    for (const auto& vote : fileVotes.GetVotes()) {
+    for (const auto& vote : govobj.GetVoteFile().GetVotes()) {
         uint256 nVoteHash = vote.GetHash();
 
         bool onlyVotingKeyAllowed = govobj.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING;
 
-        if (filter.contains(nVoteHash) || !vote.IsValid(onlyVotingKeyAllowed)) {
+        if (fnPeerHasVote(nVoteHash) || !vote.IsValid(onlyVotingKeyAllowed)) {
             continue;
         }
         pnode->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, nVoteHash));
@@ -790,7 +920,7 @@ bool CGovernanceManager::MasternodeRateCheck(const CGovernanceObject& govobj, bo
     return false;
 }
 
-bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman)
+bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman, bool fSignatureVerified)
 {
     ENTER_CRITICAL_SECTION(cs);
     uint256 nHashVote = vote.GetHash();
@@ -839,11 +969,147 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
         return false;
     }
 
-    bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman) && cmapVoteToObject.Insert(nHashVote, &govobj);
+    bool fOk = govobj.ProcessVote(pfrom, vote, exception, connman, fSignatureVerified) && cmapVoteToObject.Insert(nHashVote, &govobj);
     LEAVE_CRITICAL_SECTION(cs);
     return fOk;
 }
 
+void CGovernanceManager::StartWorkerThread(CConnman& connman)
+{
+    // can't start new thread if we have one running already
+    if (workThread.joinable()) {
+        assert(false);
+    }
+
+    workThread = std::thread(&TraceThread<std::function<void()> >, "govvote", std::function<void()>(std::bind(&CGovernanceManager::WorkThreadMain, this, std::ref(connman))));
+}
+
+void CGovernanceManager::InterruptWorkerThread()
+{
+    workInterrupt();
+}
+
+void CGovernanceManager::StopWorkerThread()
+{
+    if (workThread.joinable()) {
+        // make sure to call InterruptWorkerThread() first
+        assert(workInterrupt);
+        workThread.join();
+    }
+}
+
+void CGovernanceManager::WorkThreadMain(CConnman& connman)
+{
+    while (!workInterrupt) {
+        bool fMoreWork = ProcessPendingVotes(connman);
+
+        if (!fMoreWork && !workInterrupt.sleep_for(std::chrono::milliseconds(100))) {
+            return;
+        }
+    }
+}
+
+bool CGovernanceManager::ProcessPendingVotes(CConnman& connman)
+{
+    std::vector<std::pair<NodeId, CGovernanceVote> > vecVotes;
+    bool fMoreWork;
+    {
+        LOCK(cs_pendingVotes);
+        while (!pendingVotes.empty() && vecVotes.size() < MAX_VOTES_PER_BATCH) {
+            vecVotes.emplace_back(pendingVotes.front());
+            pendingVotes.pop_front();
+        }
+        fMoreWork = !pendingVotes.empty();
+    }
+
+    if (vecVotes.empty()) {
+        return false;
+    }
+
+    // Collect the signatures with the keys they have to be made with (see CGovernanceObject::ProcessVote), votes
+    // that fail here are left to ProcessVote, which verifies them on its own and rejects them with the usual error
+    auto mnList = deterministicMNManager->GetListAtChainTip();
+    std::vector<std::tuple<size_t, CBLSSignature, CBLSPublicKey> > vecBLSVotes;
+    std::vector<std::pair<size_t, CKeyID> > vecECDSAVotes;
+    {
+        LOCK(cs);
+        for (size_t i = 0; i < vecVotes.size(); i++) {
+            const CGovernanceVote& vote = vecVotes[i].second;
+            auto it = mapObjects.find(vote.GetParentHash());
+            if (it == mapObjects.end() || cmapVoteToObject.HasKey(vote.GetHash())) {
+                continue;
+            }
+            auto dmn = mnList.GetMNByCollateral(vote.GetMasternodeOutpoint());
+            if (!dmn) {
+                continue;
+            }
+            if (it->second.GetObjectType() == GOVERNANCE_OBJECT_PROPOSAL && vote.GetSignal() == VOTE_SIGNAL_FUNDING) {
+                vecECDSAVotes.emplace_back(i, dmn->pdmnState->keyIDVoting);
+                continue;
+            }
+            CBLSSignature sig(vote.GetSignature());
+            if (!sig.IsValid() || !dmn->pdmnState->pubKeyOperator.Get().IsValid()) {
+                continue;
+            }
+            vecBLSVotes.emplace_back(i, sig, dmn->pdmnState->pubKeyOperator.Get());
+        }
+    }
+
+    // The ECDSA signatures can't be batched, verify them on the pool while the BLS batch is verified here
+    std::vector<char> vecECDSAValid(vecECDSAVotes.size(), 0);
+    std::vector<std::future<void> > futures;
+    const size_t nTasks = std::min<size_t>(GetVoteVerifyPool().size(), vecECDSAVotes.size());
+    for (size_t nTask = 0; nTask < nTasks; nTask++) {
+        futures.emplace_back(GetVoteVerifyPool().push([&, nTask](int) {
+            for (size_t j = nTask; j < vecECDSAVotes.size(); j += nTasks) {
+                vecECDSAValid[j] = vecVotes[vecECDSAVotes[j].first].second.CheckSignature(vecECDSAVotes[j].second);
+            }
+        }));
+    }
+
+    CBLSBatchVerifier<NodeId, size_t> batchVerifier(false, true, 8);
+    for (const auto& t : vecBLSVotes) {
+        const size_t i = std::get<0>(t);
+        batchVerifier.PushMessage(vecVotes[i].first, i, vecVotes[i].second.GetSignatureHash(), std::get<1>(t), std::get<2>(t));
+    }
+    batchVerifier.Verify();
+
+    for (auto& future : futures) {
+        future.wait();
+    }
+
+    std::vector<bool> vecVerified(vecVotes.size(), false);
+    for (const auto& t : vecBLSVotes) {
+        vecVerified[std::get<0>(t)] = !batchVerifier.badMessages.count(std::get<0>(t));
+    }
+    for (size_t j = 0; j < vecECDSAVotes.size(); j++) {
+        vecVerified[vecECDSAVotes[j].first] = vecECDSAValid[j] != 0;
+    }
+
+    LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- verified %d BLS and %d ECDSA signatures of %d votes\n", __func__,
+        vecBLSVotes.size(), vecECDSAVotes.size(), vecVotes.size());
+
+    for (size_t i = 0; i < vecVotes.size(); i++) {
+        NodeId nodeId = vecVotes[i].first;
+        const CGovernanceVote& vote = vecVotes[i].second;
+
+        CGovernanceException exception;
+        if (ProcessVote(nullptr, vote, exception, connman, vecVerified[i])) {
+            LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- %s new\n", __func__, vote.GetHash().ToString());
+            masternodeSync.BumpAssetLastTime("MNGOVERNANCEOBJECTVOTE");
+            vote.Relay(connman);
+        } else {
+            LogPrint(BCLog::GOBJECT, "CGovernanceManager::%s -- Rejected vote, error = %s\n", __func__, exception.what());
+            if ((exception.GetNodePenalty() != 0) && masternodeSync.IsSynced()) {
+                LOCK(cs_main);
+                Misbehaving(nodeId, exception.GetNodePenalty());
+            }
+        }
+    }
+
+    return fMoreWork;
+}
+
 void CGovernanceManager::CheckPostponedObjects(CConnman& connman)
 {
     if (!masternodeSync.IsSynced()) return;
@@ -909,7 +1175,7 @@ void CGovernanceManager::CheckPostponedObjects(CConnman& connman)
     }
 }
 
-void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter)
+void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter, bool fUseRecon)
 {
     if (!pfrom) {
         return;
@@ -928,11 +1194,23 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
         CGovernanceObject* pObj = FindGovernanceObject(nHash);
 
         if (pObj) {
+            std::vector<uint256> vecVoteHashes = pObj->GetVoteHashes();
+            nVoteCount = vecVoteHashes.size();
+
+            // The table only has to hold the difference to the votes of the peer, the peer tells us if it didn't fit
+            if (fUseRecon && nVoteCount > 0 && pfrom->nVersion >= GOVERNANCE_RECON_VERSION) {
+                CInvertibleBloomLookupTable iblt(std::max((unsigned int)nVoteCount / GOVERNANCE_RECON_DIFF_DIVISOR, GOVERNANCE_RECON_MIN_DIFF), GetRand(std::numeric_limits<uint64_t>::max()));
+                for (const uint256& nVoteHash : vecVoteHashes) {
+                    iblt.Insert(nVoteHash);
+                }
+                LogPrint(BCLog::GOBJECT, "CGovernanceManager::RequestGovernanceObject -- nHash %s nVoteCount %d peer=%d (reconciliation)\n", nHash.ToString(), nVoteCount, pfrom->GetId());
+                connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCERECON, nHash, iblt));
+                return;
+            }
+
             filter = CBloomFilter(Params().GetConsensus().nGovernanceFilterElements, GOVERNANCE_FILTER_FP_RATE, GetRandInt(999999), BLOOM_UPDATE_ALL);
-            std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
-            nVoteCount = vecVotes.size();
-            for (const auto& vote : vecVotes) {
-                filter.insert(vote.GetHash());
+            for (const uint256& nVoteHash : vecVoteHashes) {
+                filter.insert(nVoteHash);
             }
         }
     }
@@ -941,15 +1219,15 @@ void CGovernanceManager::RequestGovernanceObject(CNode* pfrom, const uint256& nH
     connman.PushMessage(pfrom, msgMaker.Make(NetMsgType::MNGOVERNANCESYNC, nHash, filter));
 }
 
-int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman)
+int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman, int nPartition, int nPartitions)
 {
     if (pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) return -3;
     std::vector<CNode*> vNodesCopy;
     vNodesCopy.push_back(pnode);
-    return RequestGovernanceObjectVotes(vNodesCopy, connman);
+    return RequestGovernanceObjectVotes(vNodesCopy, connman, nPartition, nPartitions);
 }
 
-int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman)
+int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman, int nPartition, int nPartitions)
 {
     static std::map<uint256, std::map<CService, int64_t> > mapAskedRecently;
 
@@ -961,6 +1239,8 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
 
     std::vector<uint256> vTriggerObjHashes;
     std::vector<uint256> vOtherObjHashes;
+    // objects that are left to ask but belong to the partition of another peer
+    size_t nOtherPartitions = 0;
 
     // This should help us to get some idea about an impact this can bring once deployed on mainnet.
     // Testnet is ~40 times smaller in masternode count, but only ~1000 masternodes usually vote,
@@ -992,6 +1272,12 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
                 if (mapAskedRecently[nHash].size() >= nPeersPerHashMax) continue;
             }
 
+            if (nPartitions > 1 && (!mapAskedRecently.count(nHash) || mapAskedRecently[nHash].empty()) &&
+                int(nHash.GetCheapHash() % nPartitions) != nPartition) {
+                nOtherPartitions++;
+                continue;
+            }
+
             if (objPair.second.GetObjectType() == GOVERNANCE_OBJECT_TRIGGER) {
                 vTriggerObjHashes.push_back(nHash);
             } else {
@@ -1050,7 +1336,7 @@ int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>&
     LogPrint(BCLog::GOBJECT, "CGovernanceManager::RequestGovernanceObjectVotes -- end: vTriggerObjHashes %d vOtherObjHashes %d mapAskedRecently %d\n",
         vTriggerObjHashes.size(), vOtherObjHashes.size(), mapAskedRecently.size());
 
-    return int(vTriggerObjHashes.size() + vOtherObjHashes.size());
+    return int(vTriggerObjHashes.size() + vOtherObjHashes.size() + nOtherPartitions);
 }
 
 bool CGovernanceManager::AcceptObjectMessage(const uint256& nHash)
@@ -1084,13 +1370,47 @@ void CGovernanceManager::RebuildIndexes()
     cmapVoteToObject.Clear();
     for (auto& objPair : mapObjects) {
         CGovernanceObject& govobj = objPair.second;
-        std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-        for (size_t i = 0; i < vecVotes.size(); ++i) {
-            cmapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+        for (const uint256& nVoteHash : govobj.GetVoteHashes()) {
+            cmapVoteToObject.Insert(nVoteHash, &govobj);
         }
     }
 }
 
+bool CGovernanceManager::LoadFromDb()
+{
+    LOCK(cs);
+
+    int64_t nStart = GetTimeMillis();
+    Clear();
+    if (!governanceDb->ReadManager(*this) || !governanceDb->ReadObjects(mapObjects)) {
+        return false;
+    }
+    LogPrintf("Loaded %d governance objects from the governance database  %dms\n", mapObjects.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
+void CGovernanceManager::WriteToDb()
+{
+    LOCK(cs);
+
+    if (!governanceDb) {
+        return;
+    }
+    for (const auto& objPair : mapObjects) {
+        governanceDb->WriteObject(objPair.second);
+    }
+    governanceDb->WriteRecords(*this, mapObjects);
+}
+
+void CGovernanceManager::WriteRecordsToDb()
+{
+    LOCK(cs);
+
+    if (governanceDb) {
+        governanceDb->WriteRecords(*this, mapObjects);
+    }
+}
+
 void CGovernanceManager::AddCachedTriggers()
 {
     LOCK(cs);
@@ -12,8 +12,10 @@
 #include <governance/governance-exceptions.h>
 #include <governance/governance-object.h>
 #include <governance/governance-vote.h>
+#include <iblt.h>
 #include <net.h>
 #include <sync.h>
+#include <threadinterrupt.h>
 #include <timedata.h>
 #include <util.h>
 
@@ -21,6 +23,10 @@
 
 #include <univalue.h>
 
+#include <deque>
+#include <functional>
+#include <thread>
+
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
@@ -171,6 +177,10 @@ public: // Types
 private:
     static const int MAX_CACHE_SIZE = 1000000;
 
+    // votes received after the queue is full are processed right away
+    static const size_t MAX_PENDING_VOTES = 100000;
+    static const size_t MAX_VOTES_PER_BATCH = 1000;
+
     static const std::string SERIALIZATION_VERSION_STRING;
 
     static const int MAX_TIME_FUTURE_DEVIATION;
@@ -209,6 +219,13 @@ private:
     // used to check for changed voting keys
     CDeterministicMNList lastMNListForVotingKeys;
 
+    // votes of peers for known objects, verified and processed in batches by the worker thread
+    mutable CCriticalSection cs_pendingVotes;
+    std::deque<std::pair<NodeId, CGovernanceVote> > pendingVotes;
+
+    std::thread workThread;
+    CThreadInterrupt workInterrupt;
+
     class ScopedLockBool
     {
         bool& ref;
@@ -245,6 +262,8 @@ public:
     bool ConfirmInventoryRequest(const CInv& inv);
 
     void SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const CBloomFilter& filter, CConnman& connman);
+    /** Like SyncSingleObjVotes, but for a peer that sent a table of its votes reconcilable with ours */
+    void ReconcileSingleObjVotes(CNode* pnode, const uint256& nProp, const CInvertibleBloomLookupTable& iblt, CConnman& connman);
     void SyncObjects(CNode* pnode, CConnman& connman) const;
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman, bool enable_bip61);
@@ -305,6 +324,28 @@ public:
         READWRITE(lastMNListForVotingKeys);
     }
 
+    /** Everything but the objects, stored as a single record in the governance database */
+    template <typename Stream>
+    void SerializeRecord(Stream& s) const
+    {
+        LOCK(cs);
+        s << mapErasedGovernanceObjects << cmapInvalidVotes << cmmapOrphanVotes << mapLastMasternodeObject << lastMNListForVotingKeys;
+    }
+
+    template <typename Stream>
+    void UnserializeRecord(Stream& s)
+    {
+        LOCK(cs);
+        s >> mapErasedGovernanceObjects >> cmapInvalidVotes >> cmmapOrphanVotes >> mapLastMasternodeObject >> lastMNListForVotingKeys;
+    }
+
+    /** Replace all data with the one in the governance database, InitOnLoad has to be called afterwards */
+    bool LoadFromDb();
+    /** Write all data to the governance database, e.g. after it was imported from governance.dat */
+    void WriteToDb();
+    /** Write all data but the votes, which are written as they are accepted, to the governance database */
+    void WriteRecordsToDb();
+
     void UpdatedBlockTip(const CBlockIndex* pindex, CConnman& connman);
     int64_t GetLastDiffTime() const { return nTimeLastDiff; }
     void UpdateLastDiffTime(int64_t nTimeIn) { nTimeLastDiff = nTimeIn; }
@@ -318,6 +359,8 @@ public:
 
     int GetVoteCount() const;
 
+    size_t DynamicMemoryUsage() const;
+
     bool SerializeObjectForHash(const uint256& nHash, CDataStream& ss) const;
 
     bool SerializeVoteForHash(const uint256& nHash, CDataStream& ss) const;
@@ -353,18 +396,43 @@ public:
 
     void InitOnLoad();
 
-    int RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman);
-    int RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman);
+    /** Start the thread that processes the votes of peers, which are processed by the message handler without it */
+    void StartWorkerThread(CConnman& connman);
+    void InterruptWorkerThread();
+    void StopWorkerThread();
+
+    /**
+     * Request the votes of objects we haven't asked enough peers for yet, returns the number of objects left to ask.
+     * With nPartitions > 1 an object is only asked for the first time if its hash falls into nPartition, so peers
+     * that are synced from in parallel start with different objects.
+     */
+    int RequestGovernanceObjectVotes(CNode* pnode, CConnman& connman, int nPartition = 0, int nPartitions = 1);
+    int RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy, CConnman& connman, int nPartition = 0, int nPartitions = 1);
 
 private:
-    void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter = false);
+    /**
+     * Request an object with its votes, with fUseFilter only the votes we don't have. Peers that support it are sent
+     * a reconciliation table instead of a bloom filter unless fUseRecon is false.
+     */
+    void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, CConnman& connman, bool fUseFilter = false, bool fUseRecon = true);
+
+    /** Send the valid votes for an object, for which fnPeerHasVote is false, to a peer */
+    void SyncSingleObjVotes(CNode* pnode, const uint256& nProp, const std::function<bool(const uint256&)>& fnPeerHasVote, CConnman& connman);
 
     void AddInvalidVote(const CGovernanceVote& vote)
     {
         cmapInvalidVotes.Insert(vote.GetHash(), vote);
     }
 
-    bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman);
+    bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception, CConnman& connman, bool fSignatureVerified = false);
+
+    void WorkThreadMain(CConnman& connman);
+
+    /**
+     * Verify the signatures of the next pending votes together, the BLS ones with a batch verifier and the ECDSA ones
+     * in parallel, then process and relay the votes. Returns whether there are more pending votes.
+     */
+    bool ProcessPendingVotes(CConnman& connman);
 
     /// Called to indicate a requested object has been received
     bool AcceptObjectMessage(const uint256& nHash);
@@ -4,6 +4,7 @@
 
 #include <hash.h>
 #include <crypto/common.h>
+#include <crypto/cpuid.h>
 #include <crypto/hmac_sha512.h>
 
 
@@ -12,7 +13,7 @@ inline uint32_t ROTL32(uint32_t x, int8_t r)
     return (x << r) | (x >> (32 - r));
 }
 
-unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash)
+unsigned int MurmurHash3(unsigned int nHashSeed, Span<const unsigned char> vDataToHash)
 {
     // The following is MurmurHash3 (x86_32), see http://code.google.com/p/smhasher/source/browse/trunk/MurmurHash3.cpp
     uint32_t h1 = nHashSeed;
@@ -68,6 +69,11 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
     return h1;
 }
 
+unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash)
+{
+    return MurmurHash3(nHashSeed, Span<const unsigned char>(vDataToHash.data(), vDataToHash.size()));
+}
+
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64])
 {
     unsigned char num[4];
@@ -245,3 +251,64 @@ uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint3
     SIPROUND;
     return v0 ^ v1 ^ v2 ^ v3;
 }
+
+namespace siphash_avx2
+{
+void Uint256_4way(uint64_t k0, uint64_t k1, const unsigned char* const vals[4], uint64_t out[4]);
+}
+
+namespace
+{
+typedef void (*SipHashUint256MultiFn)(uint64_t k0, uint64_t k1, const unsigned char* const vals[4], uint64_t out[4]);
+
+SipHashUint256MultiFn SipHashUint256_4way = nullptr;
+} // namespace
+
+std::string SipHashAutoDetect()
+{
+    std::string ret = "standard";
+#if defined(HAVE_CRYPTO_CPUID) && defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    if (crypto_cpuid::Detect().have_avx2) {
+        SipHashUint256_4way = siphash_avx2::Uint256_4way;
+        ret = "avx2(4way)";
+    }
+#endif
+    return ret;
+}
+
+void SipHashUint256Batch(uint64_t k0, uint64_t k1, const uint256* const* vals, size_t count, uint64_t* out)
+{
+    size_t i = 0;
+    if (SipHashUint256_4way) {
+        for (; i + 4 <= count; i += 4) {
+            const unsigned char* inputs[4] = {vals[i]->begin(), vals[i + 1]->begin(), vals[i + 2]->begin(), vals[i + 3]->begin()};
+            SipHashUint256_4way(k0, k1, inputs, out + i);
+        }
+    }
+    for (; i < count; i++) {
+        out[i] = SipHashUint256(k0, k1, *vals[i]);
+    }
+}
+
+std::vector<uint256> CHash256Batch::Finalize() const
+{
+    std::vector<const unsigned char*> vInputs(vEnds.size());
+    std::vector<size_t> vLengths(vEnds.size());
+    size_t nBegin = 0;
+    for (size_t i = 0; i < vEnds.size(); ++i) {
+        vInputs[i] = vData.data() + nBegin;
+        vLengths[i] = vEnds[i] - nBegin;
+        nBegin = vEnds[i];
+    }
+    std::vector<uint256> vHashes(vEnds.size());
+    SHA256DMulti(vHashes.empty() ? nullptr : vHashes[0].begin(), vInputs.data(), vLengths.data(), vEnds.size());
+    return vHashes;
+}
+
+void HashX11Batch(uint256* output, const unsigned char* input, size_t len, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        output[i] = HashX11(input, input + len);
+        input += len;
+    }
+}
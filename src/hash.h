@@ -11,6 +11,7 @@
 #include <crypto/sha256.h>
 #include <prevector.h>
 #include <serialize.h>
+#include <span.h>
 #include <uint256.h>
 #include <version.h>
 
@@ -26,6 +27,7 @@
 #include <crypto/sph_simd.h>
 #include <crypto/sph_echo.h>
 
+#include <string>
 #include <vector>
 
 typedef uint256 ChainCode;
@@ -258,6 +260,56 @@ uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL
     return ss.GetHash();
 }
 
+/**
+ * Computes the double-SHA256 of many independent messages, e.g. of all transactions of a block, several at a time with
+ * the multi-way SHA256 implementations (see SHA256DMulti). The messages are serialized into one buffer by Add() and
+ * hashed together by Finalize().
+ */
+class CHash256Batch
+{
+private:
+    std::vector<unsigned char> vData;
+    std::vector<size_t> vEnds;
+
+    const int nType;
+    const int nVersion;
+public:
+
+    explicit CHash256Batch(int nTypeIn = SER_GETHASH, int nVersionIn = PROTOCOL_VERSION) : nType(nTypeIn), nVersion(nVersionIn) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    void write(const char *pch, size_t size) {
+        vData.insert(vData.end(), (const unsigned char*)pch, (const unsigned char*)pch + size);
+    }
+
+    //! Adds the serialization of obj as the next message, its hash equals SerializeHash(obj, nType, nVersion)
+    template<typename T>
+    void Add(const T& obj) {
+        ::Serialize(*this, obj);
+        vEnds.emplace_back(vData.size());
+    }
+
+    void Add(const unsigned char* data, size_t len) {
+        write((const char*)data, len);
+        vEnds.emplace_back(vData.size());
+    }
+
+    size_t size() const { return vEnds.size(); }
+
+    template<typename T>
+    CHash256Batch& operator<<(const T& obj) {
+        // Serialize into the current message
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+
+    //! The hashes of the messages in the order they were added
+    std::vector<uint256> Finalize() const;
+};
+
+unsigned int MurmurHash3(unsigned int nHashSeed, Span<const unsigned char> vDataToHash);
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
@@ -297,6 +349,12 @@ public:
 uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 uint64_t SipHashUint256Extra(uint64_t k0, uint64_t k1, const uint256& val, uint32_t extra);
 
+/** Compute out[i] = SipHashUint256(k0, k1, *vals[i]) for count values, four at a time if the CPU supports it. */
+void SipHashUint256Batch(uint64_t k0, uint64_t k1, const uint256* const* vals, size_t count, uint64_t* out);
+
+/** Autodetect the best available batch SipHash implementation. Returns the name of the implementation. */
+std::string SipHashAutoDetect();
+
 /* ----------- Dash Hash ------------------------------------------------ */
 template<typename T1>
 inline uint256 HashX11(const T1 pbegin, const T1 pend)
@@ -364,4 +422,12 @@ inline uint256 HashX11(const T1 pbegin, const T1 pend)
     return hash[10].trim256();
 }
 
+/** Compute the X11 hashes of multiple fixed-size blobs.
+ *  output:  pointer to a count-element output array
+ *  input:   pointer to a count*len byte input buffer
+ *  len:     the size of each blob (80 for block headers)
+ *  count:   the number of hashes to compute.
+ */
+void HashX11Batch(uint256* output, const unsigned char* input, size_t len, size_t count);
+
 #endif // BITCOIN_HASH_H
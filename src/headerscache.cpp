@@ -0,0 +1,52 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <headerscache.h>
+
+#include <chain.h>
+#include <streams.h>
+#include <version.h>
+
+CHeadersCache g_headers_cache;
+
+void CHeadersCache::SetEnabled(bool fEnabledIn)
+{
+    AssertLockHeld(cs_main);
+    fEnabled = fEnabledIn;
+    if (!fEnabled) {
+        Clear();
+    }
+}
+
+bool CHeadersCache::Sync(const CChain& chain)
+{
+    AssertLockHeld(cs_main);
+    if (!fEnabled) {
+        return false;
+    }
+    if (pindexTip == chain.Tip()) {
+        return true;
+    }
+
+    // Keep everything up to the last block the chain still shares with the old tip
+    const CBlockIndex* pindexFork = pindexTip ? chain.FindFork(pindexTip) : nullptr;
+    int nKeep = pindexFork ? pindexFork->nHeight + 1 : 0;
+    vData.resize(nKeep * HEADER_SIZE);
+
+    CVectorWriter writer(SER_NETWORK, PROTOCOL_VERSION, vData, vData.size());
+    for (int nHeight = nKeep; nHeight <= chain.Height(); nHeight++) {
+        writer << chain[nHeight]->GetBlockHeader();
+    }
+    assert(vData.size() == (size_t)(chain.Height() + 1) * HEADER_SIZE);
+    pindexTip = chain.Tip();
+    return true;
+}
+
+void CHeadersCache::Clear()
+{
+    AssertLockHeld(cs_main);
+    pindexTip = nullptr;
+    vData.clear();
+    vData.shrink_to_fit();
+}
@@ -0,0 +1,79 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_HEADERSCACHE_H
+#define BITCOIN_HEADERSCACHE_H
+
+#include <serialize.h>
+#include <sync.h>
+
+#include <assert.h>
+#include <vector>
+
+class CBlockIndex;
+class CChain;
+
+extern CCriticalSection cs_main;
+
+/** Default for -headerscache */
+static const bool DEFAULT_HEADERS_CACHE = true;
+
+/**
+ * The serialized headers of the active chain, stored back to back by height, so that getheaders and REST headers
+ * requests are answered by copying a slice instead of building and serializing a CBlockHeader per height.
+ * It is brought in line with the chain lazily by Sync: appended to when the tip advanced and truncated to the fork
+ * point after a reorg.
+ */
+class CHeadersCache
+{
+public:
+    static const size_t HEADER_SIZE = 80;
+
+private:
+    bool fEnabled GUARDED_BY(cs_main){false};
+    /** The tip the cache was last synced with */
+    const CBlockIndex* pindexTip GUARDED_BY(cs_main){nullptr};
+    std::vector<unsigned char> vData GUARDED_BY(cs_main);
+
+public:
+    void SetEnabled(bool fEnabledIn) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Bring the cache in line with chain. Returns false if the cache is disabled */
+    bool Sync(const CChain& chain) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Forget everything, for when the block index is unloaded */
+    void Clear() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
+    /** Number of cached headers, the height of the synced tip plus one */
+    int Size() const EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return vData.size() / HEADER_SIZE; }
+
+    size_t DynamicMemoryUsage() const EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return vData.capacity(); }
+
+    /** Write the headers of the heights nStart .. nStart + nCount - 1 as a sequence of CBlockHeaders */
+    template<typename Stream>
+    void WriteHeaders(Stream& s, int nStart, int nCount) const EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        assert(nStart >= 0 && nCount >= 0 && nStart + nCount <= Size());
+        if (nCount > 0) {
+            s.write((const char*)&vData[nStart * HEADER_SIZE], nCount * HEADER_SIZE);
+        }
+    }
+
+    /** Write the headers of the heights nStart .. nStart + nCount - 1 as the vector of CBlocks without transactions
+     *  a headers message consists of */
+    template<typename Stream>
+    void WriteHeadersMessage(Stream& s, int nStart, int nCount) const EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+    {
+        assert(nStart >= 0 && nCount >= 0 && nStart + nCount <= Size());
+        WriteCompactSize(s, nCount);
+        for (int i = 0; i < nCount; i++) {
+            s.write((const char*)&vData[(nStart + i) * HEADER_SIZE], HEADER_SIZE);
+            ser_writedata8(s, 0); // no transactions
+        }
+    }
+};
+
+extern CHeadersCache g_headers_cache;
+
+#endif // BITCOIN_HEADERSCACHE_H
@@ -7,6 +7,7 @@
 #include <chainparams.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <rpc/jsonstream.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <random.h>
@@ -191,10 +192,59 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
-            UniValue result = tableRPC.execute(jreq);
-
-            // Send reply
-            strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+            // Replies that get large are sent in chunks while they are produced, see JSONRPCRequest::resultWriter
+            JSONStreamWriter writer([req](const std::string& chunk) {
+                if (!req->IsReplyStarted()) {
+                    req->WriteHeader("Content-Type", "application/json");
+                    req->StartReplyChunks(HTTP_OK);
+                }
+                req->WriteReplyChunk(chunk);
+            });
+            writer.BeginObject();
+            writer.Key("result");
+            jreq.resultWriter = &writer;
+
+            // Blocks and transactions are sent serialized instead of hex encoded, see JSONRPCRequest::binaryResult
+            std::string strBinaryResult;
+            std::pair<bool, std::string> acceptHeader = req->GetHeader("accept");
+            if (acceptHeader.first && acceptHeader.second.find("application/octet-stream") != std::string::npos) {
+                jreq.binaryResult = &strBinaryResult;
+            }
+
+            UniValue result;
+            try {
+                result = tableRPC.execute(jreq);
+            } catch (...) {
+                if (writer.IsFlushed()) {
+                    // Too late for an error reply, cut the reply short so that the client fails to parse it
+                    LogPrintf("%s: %s failed while its result was being sent\n", __func__, jreq.strMethod);
+                    req->EndReplyChunks();
+                    return false;
+                }
+                throw;
+            }
+            if (!strBinaryResult.empty()) {
+                req->WriteHeader("Content-Type", "application/octet-stream");
+                req->WriteReply(HTTP_OK, strBinaryResult);
+                return true;
+            }
+            if (writer.ExpectsValue()) {
+                // Not streamed by the handler
+                writer.Value(result);
+            }
+            writer.Key("error");
+            writer.Value(NullUniValue);
+            writer.Key("id");
+            writer.Value(jreq.id);
+            writer.EndObject();
+
+            if (writer.IsFlushed()) {
+                writer.Flush();
+                req->WriteReplyChunk("\n");
+                req->EndReplyChunks();
+                return true;
+            }
+            strReply = writer.TakeBuffer() + "\n";
 
         // array of requests
         } else if (valRequest.isArray())
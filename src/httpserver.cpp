@@ -29,6 +29,7 @@
 #include <event2/bufferevent.h>
 #include <event2/util.h>
 #include <event2/keyvalq_struct.h>
+#include <event2/listener.h>
 
 #include <support/events.h>
 
@@ -67,7 +68,9 @@ private:
 };
 
 /** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
+ * Work items are simply callable objects, they are run by priority and then in order.
+ * Once more than maxDepth items are queued the queue is overloaded, up to maxOverflow
+ * more are accepted while the overload callback applies back-pressure.
  */
 template <typename WorkItem>
 class WorkQueue
@@ -76,13 +79,20 @@ private:
     /** Mutex protects entire object */
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    std::deque<std::unique_ptr<WorkItem>> queues[HTTP_PRIORITY_COUNT];
+    size_t depth;
     bool running;
     size_t maxDepth;
+    size_t maxOverflow;
+    /** Called without the lock whenever the queue becomes overloaded or stops being overloaded */
+    std::function<void()> overloadCallback;
 
 public:
-    explicit WorkQueue(size_t _maxDepth) : running(true),
-                                 maxDepth(_maxDepth)
+    WorkQueue(size_t _maxDepth, size_t _maxOverflow, std::function<void()> _overloadCallback) : depth(0),
+                                 running(true),
+                                 maxDepth(_maxDepth),
+                                 maxOverflow(_maxOverflow),
+                                 overloadCallback(std::move(_overloadCallback))
     {
     }
     /** Precondition: worker threads have all stopped (they have been joined).
@@ -91,29 +101,52 @@ public:
     {
     }
     /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    bool Enqueue(WorkItem* item, HTTPPriority priority)
     {
-        std::unique_lock<std::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
-            return false;
+        bool overloaded;
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            if (depth >= maxDepth + maxOverflow) {
+                return false;
+            }
+            queues[priority].emplace_back(std::unique_ptr<WorkItem>(item));
+            overloaded = ++depth == maxDepth + 1;
+            cond.notify_one();
+        }
+        if (overloaded) {
+            overloadCallback();
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
-        cond.notify_one();
         return true;
     }
+    /** Whether more than maxDepth items are queued */
+    bool IsOverloaded()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        return running && depth > maxDepth;
+    }
     /** Thread function */
     void Run()
     {
         while (true) {
             std::unique_ptr<WorkItem> i;
+            bool relieved;
             {
                 std::unique_lock<std::mutex> lock(cs);
-                while (running && queue.empty())
+                while (running && depth == 0)
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
-                queue.pop_front();
+                for (auto& queue : queues) {
+                    if (!queue.empty()) {
+                        i = std::move(queue.front());
+                        queue.pop_front();
+                        break;
+                    }
+                }
+                relieved = depth-- == maxDepth + 1;
+            }
+            if (relieved) {
+                overloadCallback();
             }
             (*i)();
         }
@@ -130,13 +163,14 @@ public:
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPPriority _priority):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), priority(_priority)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPPriority priority;
 };
 
 /** HTTP module state */
@@ -153,6 +187,32 @@ static WorkQueue<HTTPClosure>* workQueue = nullptr;
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
 std::vector<evhttp_bound_socket *> boundSockets;
+//! Guards pausing the listening sockets while the work queue is overloaded
+static std::mutex cs_listenPaused;
+static bool fListenPaused = false;
+
+/** Stop accepting connections while the work queue is overloaded, so that clients wait instead of getting errors */
+static void UpdateListenBackPressure()
+{
+    std::lock_guard<std::mutex> lock(cs_listenPaused);
+    // Reevaluated under the lock, the callbacks of the workers and the event thread may arrive out of order
+    const bool fPause = workQueue->IsOverloaded();
+    if (fPause == fListenPaused) {
+        return;
+    }
+    fListenPaused = fPause;
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+    for (evhttp_bound_socket* socket : boundSockets) {
+        evconnlistener* listener = evhttp_bound_socket_get_listener(socket);
+        if (fPause) {
+            evconnlistener_disable(listener);
+        } else {
+            evconnlistener_enable(listener);
+        }
+    }
+#endif
+    LogPrint(BCLog::HTTP, "%s accepting connections, the work queue is %s\n", fPause ? "Stopped" : "Resumed", fPause ? "full" : "no longer full");
+}
 
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr& netaddr)
@@ -214,6 +274,22 @@ static std::string RequestMethodString(HTTPRequest::RequestMethod m)
     }
 }
 
+/** Re-enable reading from the socket after the reply was sent. This is the second part of the libevent
+ * workaround in http_request_cb.
+ */
+static void http_reenable_reading(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 /** HTTP request callback */
 static void http_request_cb(struct evhttp_request* req, void* arg)
 {
@@ -265,10 +341,10 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
     if (i != iend) {
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
         assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        if (workQueue->Enqueue(item.get(), i->priority))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: request rejected because http work queue depth and its overflow exceeded, it can be increased with the -rpcworkqueue= setting\n");
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -408,7 +484,7 @@ bool InitHTTPServer()
     int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth, workQueueDepth * HTTP_WORKQUEUE_OVERFLOW_FACTOR, UpdateListenBackPressure);
     // transfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -521,11 +597,15 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
+    if (replyStarted && !replySent) {
+        EndReplyChunks();
+    }
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
@@ -590,17 +670,54 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
-        }
+        http_reenable_reading(req_copy);
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+void HTTPRequest::StartReplyChunks(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    if (ShutdownRequested()) {
+        WriteHeader("Connection", "close");
+    }
+    // The events are handled in the order they were triggered, so the chunks follow the start of the reply
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+    replyStarted = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& chunk)
+{
+    assert(replyStarted && !replySent && req);
+    if (chunk.empty()) {
+        // An empty chunk would terminate the reply
+        return;
+    }
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, chunk.data(), chunk.size());
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, evb]{
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::EndReplyChunks()
+{
+    assert(replyStarted && !replySent && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        // Before ending the reply, which may free the request right away
+        http_reenable_reading(req_copy);
+        evhttp_send_reply_end(req_copy);
     });
     ev->trigger(nullptr);
     replySent = true;
@@ -647,10 +764,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, HTTPPriority priority)
 {
-    LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d, priority %d)\n", prefix, exactMatch, priority);
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, priority));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -12,6 +12,15 @@
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Once the work queue is full, up to this many times its depth of requests wait while no new connections are accepted */
+static const int HTTP_WORKQUEUE_OVERFLOW_FACTOR=4;
+
+/** Priority of the requests of a handler, the workers take the queued requests of a higher priority first */
+enum HTTPPriority {
+    HTTP_PRIORITY_HIGH,
+    HTTP_PRIORITY_LOW,
+    HTTP_PRIORITY_COUNT,
+};
 
 struct evhttp_request;
 struct event_base;
@@ -42,7 +51,7 @@ typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHa
  * If multiple handlers match a prefix, the first-registered one will
  * be invoked.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, HTTPPriority priority = HTTP_PRIORITY_HIGH);
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -59,6 +68,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -114,6 +124,26 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for bodies that are sent while they are produced.
+     * The body is sent with WriteReplyChunk() and completed by EndReplyChunks().
+     *
+     * @note Call WriteHeader before, and don't call WriteReply afterwards.
+     */
+    void StartReplyChunks(int nStatus);
+
+    /** Send the next piece of a reply started with StartReplyChunks */
+    void WriteReplyChunk(const std::string& chunk);
+
+    /**
+     * Complete a chunked reply.
+     *
+     * @note Like WriteReply, this gives the request back to the main thread.
+     */
+    void EndReplyChunks();
+
+    bool IsReplyStarted() const { return replyStarted; }
 };
 
 /** Event handler closure.
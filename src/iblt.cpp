@@ -0,0 +1,105 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <iblt.h>
+
+#include <hash.h>
+#include <uint256.h>
+
+#include <algorithm>
+
+const int CInvertibleBloomLookupTable::NUM_HASH_FUNCS;
+const unsigned int CInvertibleBloomLookupTable::MAX_CELLS;
+
+CInvertibleBloomLookupTable::CInvertibleBloomLookupTable(unsigned int nElements, uint64_t nTweakIn) :
+    nTweak(nTweakIn)
+{
+    // With 3 hash functions peeling needs about 1.23 cells per element for large tables and more for small ones
+    unsigned int nCellsPerPart = (nElements * 2 + NUM_HASH_FUNCS - 1) / NUM_HASH_FUNCS + 4;
+    vCells.resize(std::min(nCellsPerPart * NUM_HASH_FUNCS, MAX_CELLS));
+}
+
+size_t CInvertibleBloomLookupTable::GetCellIndex(uint64_t nShortId, int nHashNum) const
+{
+    const size_t nCellsPerPart = vCells.size() / NUM_HASH_FUNCS;
+    return nHashNum * nCellsPerPart + CSipHasher(nTweak, nHashNum + 1).Write(nShortId).Finalize() % nCellsPerPart;
+}
+
+uint32_t CInvertibleBloomLookupTable::GetCheckSum(uint64_t nShortId) const
+{
+    return (uint32_t)CSipHasher(nTweak, NUM_HASH_FUNCS + 1).Write(nShortId).Finalize();
+}
+
+void CInvertibleBloomLookupTable::Update(std::vector<Cell>& vCellsIn, uint64_t nShortId, int32_t nDelta) const
+{
+    const uint32_t nCheckSum = GetCheckSum(nShortId);
+    for (int i = 0; i < NUM_HASH_FUNCS; i++) {
+        Cell& cell = vCellsIn[GetCellIndex(nShortId, i)];
+        cell.nCount += nDelta;
+        cell.nKeySum ^= nShortId;
+        cell.nCheckSum ^= nCheckSum;
+    }
+}
+
+bool CInvertibleBloomLookupTable::IsPure(const Cell& cell) const
+{
+    return (cell.nCount == 1 || cell.nCount == -1) && cell.nCheckSum == GetCheckSum(cell.nKeySum);
+}
+
+uint64_t CInvertibleBloomLookupTable::GetShortId(const uint256& hash) const
+{
+    return SipHashUint256(nTweak, 0, hash);
+}
+
+void CInvertibleBloomLookupTable::Insert(const uint256& hash)
+{
+    Update(vCells, GetShortId(hash), 1);
+}
+
+void CInvertibleBloomLookupTable::Erase(const uint256& hash)
+{
+    Update(vCells, GetShortId(hash), -1);
+}
+
+bool CInvertibleBloomLookupTable::Decode(std::set<uint64_t>& setInserted, std::set<uint64_t>& setErased) const
+{
+    setInserted.clear();
+    setErased.clear();
+
+    std::vector<Cell> vPeeled(vCells);
+    std::vector<size_t> vPure;
+    for (size_t i = 0; i < vPeeled.size(); i++) {
+        if (IsPure(vPeeled[i])) {
+            vPure.push_back(i);
+        }
+    }
+
+    while (!vPure.empty()) {
+        const Cell cell = vPeeled[vPure.back()];
+        vPure.pop_back();
+        if (!IsPure(cell)) {
+            // Another short id was removed from this cell since it was found
+            continue;
+        }
+        std::set<uint64_t>& setFound = cell.nCount == 1 ? setInserted : setErased;
+        if (!setFound.insert(cell.nKeySum).second) {
+            return false;
+        }
+        Update(vPeeled, cell.nKeySum, -cell.nCount);
+        for (int i = 0; i < NUM_HASH_FUNCS; i++) {
+            size_t nIndex = GetCellIndex(cell.nKeySum, i);
+            if (IsPure(vPeeled[nIndex])) {
+                vPure.push_back(nIndex);
+            }
+        }
+    }
+
+    // Only a completely peeled table gives the whole difference
+    for (const Cell& cell : vPeeled) {
+        if (cell.nCount != 0 || cell.nKeySum != 0 || cell.nCheckSum != 0) {
+            return false;
+        }
+    }
+    return true;
+}
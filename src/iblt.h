@@ -0,0 +1,89 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_IBLT_H
+#define BITCOIN_IBLT_H
+
+#include <serialize.h>
+
+#include <ios>
+#include <set>
+#include <vector>
+
+class uint256;
+
+static const unsigned int MAX_IBLT_SIZE = 36000; // bytes, same as MAX_BLOOM_FILTER_SIZE
+
+/**
+ * Invertible bloom lookup table over salted 64-bit short ids of hashes, used to reconcile two sets of hashes.
+ *
+ * One side inserts the hashes it has and sends the table, the other side erases the hashes it has from it. If the
+ * sets differ by at most about the number of elements the table was created for, Decode then returns the short ids
+ * that are only in one of the two sets. Every short id is added to NUM_HASH_FUNCS cells, one in each part of the
+ * table, and a cell with a single short id left can be recognized by its checksum and removed from the others.
+ */
+class CInvertibleBloomLookupTable
+{
+private:
+    static const int NUM_HASH_FUNCS = 3;
+
+    struct Cell {
+        int32_t nCount{0};
+        uint64_t nKeySum{0};
+        uint32_t nCheckSum{0};
+
+        ADD_SERIALIZE_METHODS;
+
+        template <typename Stream, typename Operation>
+        inline void SerializationOp(Stream& s, Operation ser_action)
+        {
+            READWRITE(nCount);
+            READWRITE(nKeySum);
+            READWRITE(nCheckSum);
+        }
+    };
+
+    static const unsigned int MAX_CELLS = MAX_IBLT_SIZE / 16 / NUM_HASH_FUNCS * NUM_HASH_FUNCS;
+
+    uint64_t nTweak;
+    std::vector<Cell> vCells;
+
+    size_t GetCellIndex(uint64_t nShortId, int nHashNum) const;
+    uint32_t GetCheckSum(uint64_t nShortId) const;
+    void Update(std::vector<Cell>& vCellsIn, uint64_t nShortId, int32_t nDelta) const;
+    bool IsPure(const Cell& cell) const;
+
+public:
+    CInvertibleBloomLookupTable() : nTweak(0) {}
+    /** Create a table that can be decoded w.h.p. if the sets differ by up to nElements, within the size limit */
+    CInvertibleBloomLookupTable(unsigned int nElements, uint64_t nTweakIn);
+
+    uint64_t GetShortId(const uint256& hash) const;
+
+    void Insert(const uint256& hash);
+    void Erase(const uint256& hash);
+
+    /**
+     * Find the short ids that were inserted but not erased (setInserted) and the other way around (setErased).
+     * Returns false if the difference is too large to be decoded from this table.
+     */
+    bool Decode(std::set<uint64_t>& setInserted, std::set<uint64_t>& setErased) const;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s << nTweak << vCells;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        s >> nTweak >> vCells;
+        if (vCells.empty() || vCells.size() > MAX_CELLS || vCells.size() % NUM_HASH_FUNCS != 0) {
+            throw std::ios_base::failure("Invalid IBLT size");
+        }
+    }
+};
+
+#endif // BITCOIN_IBLT_H
@@ -0,0 +1,193 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/base.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+#include <boost/thread.hpp>
+
+static const char DB_BEST_BLOCK = 'B';
+
+/** Commit to disk at least every this many blocks while catching up */
+static const unsigned int COMMIT_INTERVAL_BLOCKS = 1000;
+/** ...or when this many milliseconds passed since the last commit */
+static const int64_t COMMIT_INTERVAL_MS = 30 * 1000;
+
+BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate) :
+    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate)
+{}
+
+bool BaseIndex::DB::ReadBestBlock(CBlockLocator& locator) const
+{
+    bool success = Read(DB_BEST_BLOCK, locator);
+    if (!success) {
+        locator.SetNull();
+    }
+    return success;
+}
+
+void BaseIndex::DB::WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator)
+{
+    batch.Write(DB_BEST_BLOCK, locator);
+}
+
+bool BaseIndex::Init()
+{
+    CBlockLocator locator;
+    GetDB().ReadBestBlock(locator);
+
+    const CBlockIndex* best_block = nullptr;
+    if (!locator.IsNull()) {
+        LOCK(cs_main);
+        best_block = FindForkInGlobalIndex(chainActive, locator);
+    }
+    if (!InitInternal(best_block)) {
+        return false;
+    }
+
+    m_batch.reset(new CDBBatch(GetDB()));
+    m_best_block_index = best_block;
+    m_committed_height = best_block ? best_block->nHeight : -1;
+    m_last_commit_time = GetTimeMillis();
+    return true;
+}
+
+bool BaseIndex::Rewind(const CBlockIndex* pindex)
+{
+    // Make everything up to pindex readable first
+    if (!Commit()) {
+        return false;
+    }
+    if (!RewindInternal(pindex)) {
+        return false;
+    }
+    m_best_block_index = pindex;
+    return Commit();
+}
+
+bool BaseIndex::Commit()
+{
+    if (!m_batch) {
+        return true;
+    }
+    if (!CommitInternal(*m_batch)) {
+        return false;
+    }
+
+    CBlockLocator locator;
+    if (m_best_block_index) {
+        LOCK(cs_main);
+        locator = chainActive.GetLocator(m_best_block_index);
+    }
+    GetDB().WriteBestBlock(*m_batch, locator);
+    if (!GetDB().WriteBatch(*m_batch, true)) {
+        return error("%s: Failed to write to the %s database", __func__, GetName());
+    }
+    m_batch->Clear();
+    m_batch_blocks = 0;
+    m_last_commit_time = GetTimeMillis();
+    m_committed_height = m_best_block_index ? m_best_block_index->nHeight : -1;
+    return true;
+}
+
+bool BaseIndex::Sync()
+{
+    if (!m_init) {
+        if (!Init()) {
+            return false;
+        }
+        m_init = true;
+    }
+
+    while (true) {
+        boost::this_thread::interruption_point();
+
+        const CBlockIndex* pindexFork = nullptr;
+        const CBlockIndex* pindex;
+        {
+            LOCK(cs_main);
+            if (m_best_block_index && !chainActive.Contains(m_best_block_index)) {
+                pindexFork = chainActive.FindFork(m_best_block_index);
+                pindex = chainActive.Next(pindexFork);
+            } else {
+                pindex = m_best_block_index ? chainActive.Next(m_best_block_index) : chainActive.Genesis();
+            }
+        }
+        if (pindexFork && !Rewind(pindexFork)) {
+            return false;
+        }
+        if (!pindex) {
+            break;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            return error("%s: failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        CBlockUndo block_undo;
+        if (NeedsUndo() && pindex->nHeight > 0 && !UndoReadFromDisk(block_undo, pindex)) {
+            return error("%s: failed to read undo data of block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!WriteBlock(block, block_undo, pindex, *m_batch)) {
+            return false;
+        }
+        m_best_block_index = pindex;
+        m_batch_blocks++;
+
+        if (m_batch_blocks >= COMMIT_INTERVAL_BLOCKS || GetTimeMillis() - m_last_commit_time >= COMMIT_INTERVAL_MS) {
+            if (!Commit()) {
+                return false;
+            }
+            if (!m_synced) {
+                LogPrintf("Syncing %s with block chain from height %d\n", GetName(), pindex->nHeight);
+            }
+        }
+    }
+
+    if (!Commit()) {
+        return false;
+    }
+    if (!m_synced) {
+        LogPrintf("%s is enabled at height %d\n", GetName(), m_committed_height);
+        m_synced = true;
+    }
+    return true;
+}
+
+void BaseIndex::ThreadMain()
+{
+    RenameThread("dash-index");
+
+    try {
+        while (true) {
+            {
+                boost::unique_lock<boost::mutex> lock(m_mutex);
+                while (!m_tip_changed) {
+                    m_cond.wait(lock);
+                }
+                m_tip_changed = false;
+            }
+            if (!Sync()) {
+                LogPrintf("%s: failed to update the %s, it won't be updated anymore\n", __func__, GetName());
+                return;
+            }
+        }
+    } catch (const boost::thread_interrupted&) {
+        // Don't lose what was indexed since the last commit
+        Commit();
+        throw;
+    }
+}
+
+void BaseIndex::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    m_tip_changed = true;
+    m_cond.notify_one();
+}
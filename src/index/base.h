@@ -0,0 +1,116 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BASE_H
+#define BITCOIN_INDEX_BASE_H
+
+#include <dbwrapper.h>
+#include <primitives/block.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CBlockIndex;
+class CBlockUndo;
+
+/**
+ * Base class for indexes of the active chain that are built in the background.
+ *
+ * Every index has its own database, which also keeps the locator of the last indexed block. A dedicated thread
+ * (ThreadMain) is woken up through the validation interface whenever the tip changes, then reads the blocks (and undo
+ * data, if needed) it is missing from disk and hands them to WriteBlock(). Nothing is done on the block connection
+ * path, so an index can be enabled on an existing node and catches up while the node keeps running. After a reorg
+ * the index is moved back to the fork point before the blocks of the new chain are added.
+ *
+ * Writes are batched up and committed every COMMIT_INTERVAL_BLOCKS blocks or COMMIT_INTERVAL_MS milliseconds, and
+ * whenever the index caught up with the tip. Lookups should only serve blocks up to GetCommittedHeight().
+ */
+class BaseIndex : public CValidationInterface
+{
+protected:
+    class DB : public CDBWrapper
+    {
+    public:
+        DB(const fs::path& path, size_t n_cache_size, bool f_memory = false, bool f_wipe = false, bool f_obfuscate = false);
+
+        /** Read block locator of the chain that the index is in sync with. */
+        bool ReadBestBlock(CBlockLocator& locator) const;
+
+        /** Write block locator of the chain that the index is in sync with. */
+        void WriteBestBlock(CDBBatch& batch, const CBlockLocator& locator);
+    };
+
+private:
+    /** Batches up DB writes until the next Commit(), created on the first Sync() */
+    std::unique_ptr<CDBBatch> m_batch;
+    unsigned int m_batch_blocks{0};
+    int64_t m_last_commit_time{0};
+
+    /** Last block added to the index, only accessed by the index thread */
+    const CBlockIndex* m_best_block_index{nullptr};
+    /** Height of m_best_block_index as of the last Commit() */
+    std::atomic<int> m_committed_height{-1};
+    std::atomic<bool> m_synced{false};
+    bool m_init{false};
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_cond;
+    bool m_tip_changed{true};
+
+    bool Init();
+    /** Move the index back to pindex, which must be an ancestor of m_best_block_index */
+    bool Rewind(const CBlockIndex* pindex);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+
+    /**
+     * Called once before the first block is indexed, with the last indexed block found in the active chain (or
+     * nullptr). Set best_block to nullptr to rebuild the index from scratch.
+     */
+    virtual bool InitInternal(const CBlockIndex*& best_block) { return true; }
+
+    /** Whether WriteBlock() needs the undo data of the blocks */
+    virtual bool NeedsUndo() const { return false; }
+
+    /** Add a block of the active chain to the index, block_undo is empty if NeedsUndo() is false */
+    virtual bool WriteBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, CDBBatch& batch) = 0;
+
+    /** Called right before the batch and the best block are written to the DB, e.g. to flush other files */
+    virtual bool CommitInternal(CDBBatch& batch) { return true; }
+
+    /** Called after the block connected on top of pindex was disconnected and all pending writes were committed */
+    virtual bool RewindInternal(const CBlockIndex* pindex) { return true; }
+
+    virtual DB& GetDB() const = 0;
+
+    /** Name of the index for log messages */
+    virtual const char* GetName() const = 0;
+
+    /** Write pending changes and the best block to disk */
+    bool Commit();
+
+    int GetCommittedHeight() const { return m_committed_height; }
+
+public:
+    virtual ~BaseIndex() {}
+
+    void ThreadMain();
+
+    /**
+     * Index all blocks up to the current tip of the active chain. Returns false on a fatal error, in which case the
+     * index stops being updated. Only called by the index thread and tests.
+     */
+    bool Sync();
+
+    /** True once the index caught up with the active chain after startup */
+    bool IsSynced() const { return m_synced; }
+};
+
+#endif // BITCOIN_INDEX_BASE_H
@@ -0,0 +1,325 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blockfilterindex.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <hash.h>
+#include <streams.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+/* Besides the best block locator kept by BaseIndex, the database stores the position where the next filter is
+ * written to (DB_FILTER_POS) and a DBVal per height (DB_HEIGHT). Heights are serialized big-endian, so that ranges
+ * of entries can be read through an iterator.
+ */
+static const char DB_FILTER_POS = 'P';
+static const char DB_HEIGHT = 't';
+
+std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+struct BlockFilterIndex::DBVal {
+    uint256 hash;
+    uint256 filter_hash;
+    uint256 header;
+    CDiskBlockPos pos;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(filter_hash);
+        READWRITE(header);
+        READWRITE(pos);
+    }
+};
+
+namespace {
+
+struct DBHeightKey {
+    int height;
+
+    explicit DBHeightKey(int height_in = 0) : height(height_in) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_HEIGHT);
+        ser_writedata32be(s, height);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for block filter index DB height key");
+        }
+        height = ser_readdata32be(s);
+    }
+};
+
+fs::path GetIndexPath(BlockFilterType filter_type)
+{
+    const std::string& filter_name = BlockFilterTypeName(filter_type);
+    if (filter_name.empty()) {
+        throw std::invalid_argument("unknown filter_type");
+    }
+    return GetDataDir() / "indexes" / "blockfilter" / filter_name;
+}
+
+} // namespace
+
+BlockFilterIndex::BlockFilterIndex(BlockFilterType filter_type, size_t n_cache_size, bool f_memory, bool f_wipe) :
+    m_filter_type(filter_type),
+    m_name(BlockFilterTypeName(filter_type) + " block filter index"),
+    m_path(GetIndexPath(filter_type)),
+    m_db(new BaseIndex::DB(m_path / "db", n_cache_size, f_memory, f_wipe))
+{
+}
+
+fs::path BlockFilterIndex::GetFilterFilename(int nFile) const
+{
+    return m_path / strprintf("fltr%05u.dat", nFile);
+}
+
+FILE* BlockFilterIndex::OpenFilterFile(const CDiskBlockPos& pos, bool fReadOnly) const
+{
+    if (pos.IsNull())
+        return nullptr;
+    fs::path path = GetFilterFilename(pos.nFile);
+    fs::create_directories(path.parent_path());
+    FILE* file = fsbridge::fopen(path, fReadOnly ? "rb": "rb+");
+    if (!file && !fReadOnly)
+        file = fsbridge::fopen(path, "wb+");
+    if (!file) {
+        LogPrintf("Unable to open file %s\n", path.string());
+        return nullptr;
+    }
+    if (pos.nPos) {
+        if (fseek(file, pos.nPos, SEEK_SET)) {
+            LogPrintf("Unable to seek to position %u of %s\n", pos.nPos, path.string());
+            fclose(file);
+            return nullptr;
+        }
+    }
+    return file;
+}
+
+bool BlockFilterIndex::ReadFilterFromDisk(const DBVal& entry, const uint256& block_hash, BlockFilter& filter) const
+{
+    CAutoFile filein(OpenFilterFile(entry.pos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return false;
+    }
+
+    std::vector<unsigned char> encoded_filter;
+    try {
+        filein >> encoded_filter;
+    } catch (const std::exception& e) {
+        return error("%s: Failed to deserialize block filter from disk: %s", __func__, e.what());
+    }
+
+    uint256 filter_hash;
+    CHash256().Write(encoded_filter.data(), encoded_filter.size()).Finalize(filter_hash.begin());
+    if (filter_hash != entry.filter_hash) {
+        return error("%s: Checksum mismatch in filtered block data", __func__);
+    }
+
+    filter = BlockFilter(m_filter_type, block_hash, std::move(encoded_filter));
+    return true;
+}
+
+bool BlockFilterIndex::WriteFilterToDisk(CDiskBlockPos& pos, const BlockFilter& filter)
+{
+    const std::vector<unsigned char>& encoded_filter = filter.GetEncodedFilter();
+    const unsigned int data_size = GetSerializeSize(encoded_filter, SER_DISK, CLIENT_VERSION);
+
+    if (m_next_filter_pos.nPos != 0 && m_next_filter_pos.nPos + data_size > MAX_FLTR_FILE_SIZE) {
+        // Commit() only flushes the file that is currently written to
+        FILE* file = OpenFilterFile(CDiskBlockPos(m_next_filter_pos.nFile, 0), false);
+        if (!file) {
+            return error("%s: Failed to open filter file %d", __func__, m_next_filter_pos.nFile);
+        }
+        bool fCommitted = FileCommit(file);
+        fclose(file);
+        if (!fCommitted) {
+            return error("%s: Failed to commit filter file %d", __func__, m_next_filter_pos.nFile);
+        }
+        m_next_filter_pos = CDiskBlockPos(m_next_filter_pos.nFile + 1, 0);
+    }
+
+    CAutoFile fileout(OpenFilterFile(m_next_filter_pos, false), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        return error("%s: Failed to open filter file %d", __func__, m_next_filter_pos.nFile);
+    }
+    try {
+        fileout << encoded_filter;
+    } catch (const std::exception& e) {
+        return error("%s: Failed to write block filter to disk: %s", __func__, e.what());
+    }
+
+    pos = m_next_filter_pos;
+    m_next_filter_pos.nPos += data_size;
+    return true;
+}
+
+bool BlockFilterIndex::ReadEntry(const CBlockIndex* pindex, DBVal& entry) const
+{
+    if (pindex->nHeight > GetCommittedHeight()) {
+        return false;
+    }
+    return m_db->Read(DBHeightKey(pindex->nHeight), entry) && entry.hash == pindex->GetBlockHash();
+}
+
+bool BlockFilterIndex::ReadEntries(int start_height, const CBlockIndex* stop_index, std::vector<DBVal>& entries) const
+{
+    if (start_height < 0 || start_height > stop_index->nHeight || stop_index->nHeight > GetCommittedHeight()) {
+        return false;
+    }
+
+    entries.resize(stop_index->nHeight - start_height + 1);
+
+    std::unique_ptr<CDBIterator> it(m_db->NewIterator());
+    it->Seek(DBHeightKey(start_height));
+    for (int height = start_height; height <= stop_index->nHeight; height++) {
+        DBHeightKey key;
+        if (!it->Valid() || !it->GetKey(key) || key.height != height) {
+            return false;
+        }
+        if (!it->GetValue(entries[height - start_height])) {
+            return error("%s: unable to read value in %s at key (%c, %d)", __func__, m_path.string(), DB_HEIGHT, height);
+        }
+        it->Next();
+    }
+
+    // Make sure the entries belong to the requested chain and not to blocks that were disconnected since then
+    const CBlockIndex* pindex = stop_index;
+    for (auto rit = entries.rbegin(); rit != entries.rend(); ++rit, pindex = pindex->pprev) {
+        if (rit->hash != pindex->GetBlockHash()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlockFilterIndex::InitInternal(const CBlockIndex*& best_block)
+{
+    if (!m_db->Read(DB_FILTER_POS, m_next_filter_pos)) {
+        m_next_filter_pos = CDiskBlockPos(0, 0);
+    }
+
+    if (best_block) {
+        DBVal entry;
+        if (m_db->Read(DBHeightKey(best_block->nHeight), entry) && entry.hash == best_block->GetBlockHash()) {
+            m_best_header = entry.header;
+        } else {
+            LogPrintf("%s: best block %s of the %s not found, rebuilding it\n", __func__, best_block->GetBlockHash().ToString(), GetName());
+            best_block = nullptr;
+        }
+    }
+    return true;
+}
+
+bool BlockFilterIndex::WriteBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, CDBBatch& batch)
+{
+    BlockFilter filter(m_filter_type, block, block_undo);
+
+    DBVal entry;
+    if (!WriteFilterToDisk(entry.pos, filter)) {
+        return false;
+    }
+    entry.hash = pindex->GetBlockHash();
+    entry.filter_hash = filter.GetHash();
+    entry.header = filter.ComputeHeader(m_best_header);
+    batch.Write(DBHeightKey(pindex->nHeight), entry);
+
+    m_best_header = entry.header;
+    m_dirty = true;
+    return true;
+}
+
+bool BlockFilterIndex::RewindInternal(const CBlockIndex* pindex)
+{
+    DBVal entry;
+    if (!m_db->Read(DBHeightKey(pindex->nHeight), entry) || entry.hash != pindex->GetBlockHash()) {
+        return error("%s: fork block %s not found in the %s", __func__, pindex->GetBlockHash().ToString(), GetName());
+    }
+    m_best_header = entry.header;
+    return true;
+}
+
+bool BlockFilterIndex::CommitInternal(CDBBatch& batch)
+{
+    if (m_dirty) {
+        FILE* file = OpenFilterFile(CDiskBlockPos(m_next_filter_pos.nFile, 0), false);
+        if (!file) {
+            return error("%s: Failed to open filter file %d", __func__, m_next_filter_pos.nFile);
+        }
+        bool fCommitted = FileCommit(file);
+        fclose(file);
+        if (!fCommitted) {
+            return error("%s: Failed to commit filter file %d", __func__, m_next_filter_pos.nFile);
+        }
+        m_dirty = false;
+    }
+
+    batch.Write(DB_FILTER_POS, m_next_filter_pos);
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const
+{
+    DBVal entry;
+    if (!ReadEntry(block_index, entry)) {
+        return false;
+    }
+    return ReadFilterFromDisk(entry, block_index->GetBlockHash(), filter_out);
+}
+
+bool BlockFilterIndex::LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const
+{
+    DBVal entry;
+    if (!ReadEntry(block_index, entry)) {
+        return false;
+    }
+    header_out = entry.header;
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterRange(int start_height, const CBlockIndex* stop_index,
+                                         std::vector<BlockFilter>& filters_out) const
+{
+    std::vector<DBVal> entries;
+    if (!ReadEntries(start_height, stop_index, entries)) {
+        return false;
+    }
+
+    filters_out.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (!ReadFilterFromDisk(entries[i], entries[i].hash, filters_out[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BlockFilterIndex::LookupFilterHashRange(int start_height, const CBlockIndex* stop_index,
+                                             std::vector<uint256>& hashes_out) const
+{
+    std::vector<DBVal> entries;
+    if (!ReadEntries(start_height, stop_index, entries)) {
+        return false;
+    }
+
+    hashes_out.clear();
+    hashes_out.reserve(entries.size());
+    for (const DBVal& entry : entries) {
+        hashes_out.emplace_back(entry.filter_hash);
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BLOCKFILTERINDEX_H
+#define BITCOIN_INDEX_BLOCKFILTERINDEX_H
+
+#include <blockfilter.h>
+#include <chain.h>
+#include <fs.h>
+#include <index/base.h>
+
+#include <memory>
+
+/** Default for -blockfilterindex */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** Default for -peerblockfilters */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+
+/** Maximum size of a single fltr?????.dat file */
+static const unsigned int MAX_FLTR_FILE_SIZE = 0x1000000; // 16 MiB
+
+/**
+ * BlockFilterIndex keeps BIP 157 compact block filters and filter headers for all blocks of the active chain.
+ *
+ * Filters are appended to flat files (fltr?????.dat), a LevelDB keyed by height stores the block hash, the filter
+ * hash, the filter header and the position of the filter in the flat files. Entries of blocks that got disconnected
+ * are simply overwritten once the new chain is indexed. The Lookup* methods can be called from any thread.
+ */
+class BlockFilterIndex final : public BaseIndex
+{
+private:
+    const BlockFilterType m_filter_type;
+    const std::string m_name;
+    const fs::path m_path;
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    /** Filter header of the last indexed block, only accessed by the index thread */
+    uint256 m_best_header;
+    /** Where the next filter is written to */
+    CDiskBlockPos m_next_filter_pos;
+    /** Whether filters were written since the last commit */
+    bool m_dirty{false};
+
+    struct DBVal;
+
+    fs::path GetFilterFilename(int nFile) const;
+    FILE* OpenFilterFile(const CDiskBlockPos& pos, bool fReadOnly) const;
+    bool ReadFilterFromDisk(const DBVal& entry, const uint256& block_hash, BlockFilter& filter) const;
+    bool WriteFilterToDisk(CDiskBlockPos& pos, const BlockFilter& filter);
+
+    bool ReadEntry(const CBlockIndex* pindex, DBVal& entry) const;
+    /** Read the entries of stop_index and its ancestors, starting at start_height */
+    bool ReadEntries(int start_height, const CBlockIndex* stop_index, std::vector<DBVal>& entries) const;
+
+protected:
+    bool InitInternal(const CBlockIndex*& best_block) override;
+    bool NeedsUndo() const override { return true; }
+    bool WriteBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, CDBBatch& batch) override;
+    bool CommitInternal(CDBBatch& batch) override;
+    bool RewindInternal(const CBlockIndex* pindex) override;
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+    const char* GetName() const override { return m_name.c_str(); }
+
+public:
+    explicit BlockFilterIndex(BlockFilterType filter_type, size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    BlockFilterType GetFilterType() const { return m_filter_type; }
+
+    /** Get a single filter by block. */
+    bool LookupFilter(const CBlockIndex* block_index, BlockFilter& filter_out) const;
+
+    /** Get a single filter header by block. */
+    bool LookupFilterHeader(const CBlockIndex* block_index, uint256& header_out) const;
+
+    /** Get a range of filters between two heights on a chain. */
+    bool LookupFilterRange(int start_height, const CBlockIndex* stop_index,
+                           std::vector<BlockFilter>& filters_out) const;
+
+    /** Get a range of filter hashes between two heights on a chain. */
+    bool LookupFilterHashRange(int start_height, const CBlockIndex* stop_index,
+                               std::vector<uint256>& hashes_out) const;
+};
+
+/** The basic block filter index, nullptr if -blockfilterindex is not set */
+extern std::unique_ptr<BlockFilterIndex> g_blockfilterindex;
+
+#endif // BITCOIN_INDEX_BLOCKFILTERINDEX_H
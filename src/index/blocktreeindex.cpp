@@ -0,0 +1,289 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blocktreeindex.h>
+
+#include <chain.h>
+#include <txdb.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+#include <algorithm>
+
+#include <boost/thread.hpp>
+
+static const char DB_BUILDS = 'b';
+static const char DB_DROPS = 'd';
+
+std::unique_ptr<BlockTreeIndexBuilder> g_blocktreeindexbuilder;
+
+namespace {
+
+struct BlockTreeIndex {
+    const char* name;
+    bool* pfEnabled;
+    bool fDefault;
+};
+
+const BlockTreeIndex BLOCK_TREE_INDEXES[] = {
+    {"txindex", &fTxIndex, DEFAULT_TXINDEX},
+    {"addressindex", &fAddressIndex, DEFAULT_ADDRESSINDEX},
+    {"timestampindex", &fTimestampIndex, DEFAULT_TIMESTAMPINDEX},
+    {"spentindex", &fSpentIndex, DEFAULT_SPENTINDEX},
+};
+
+} // namespace
+
+BlockTreeIndexBuilder::BlockTreeIndexBuilder(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    m_db(new BaseIndex::DB(GetDataDir() / "indexes" / "blocktree", n_cache_size, f_memory, f_wipe))
+{
+    m_db->Read(DB_BUILDS, m_builds);
+    m_db->Read(DB_DROPS, m_drops);
+}
+
+void BlockTreeIndexBuilder::WriteState(CDBBatch& batch) const
+{
+    LOCK(m_cs);
+    batch.Write(DB_BUILDS, m_builds);
+    batch.Write(DB_DROPS, m_drops);
+}
+
+bool BlockTreeIndexBuilder::Configure(std::string& strError)
+{
+    std::vector<const BlockTreeIndex*> vChanged;
+    bool fRebuild = false;
+    {
+        LOCK(m_cs);
+        for (const BlockTreeIndex& index : BLOCK_TREE_INDEXES) {
+            const bool fEnable = gArgs.GetBoolArg(std::string("-") + index.name, index.fDefault);
+            if (*index.pfEnabled == fEnable) {
+                continue;
+            }
+            if (fEnable) {
+                // The blocks needed to build the index are gone
+                if (fHavePruned) {
+                    strError = strprintf(_("You need to rebuild the database using -reindex to change -%s"), index.name);
+                    return false;
+                }
+                LogPrintf("%s: -%s was enabled, building it in the background\n", __func__, index.name);
+                m_builds.insert(index.name);
+                fRebuild = true;
+                if (m_drops.count(index.name)) {
+                    // Finish erasing the old entries first, the index is turned on by ThreadBuild() afterwards
+                    continue;
+                }
+            } else {
+                LogPrintf("%s: -%s was disabled, erasing it in the background\n", __func__, index.name);
+                m_builds.erase(index.name);
+                m_drops.insert(index.name);
+            }
+            vChanged.emplace_back(&index);
+        }
+    }
+    if (!fRebuild && vChanged.empty()) {
+        return true;
+    }
+
+    // Persist what needs to be done before the flags change, so that it is picked up again after a crash
+    CDBBatch batch(*m_db);
+    WriteState(batch);
+    if (fRebuild) {
+        // Start over from the genesis block, the indexes that were built already don't mind
+        m_db->WriteBestBlock(batch, CBlockLocator());
+    }
+    if (!m_db->WriteBatch(batch, true)) {
+        strError = _("Error writing to the block tree index builder database");
+        return false;
+    }
+
+    for (const BlockTreeIndex* index : vChanged) {
+        *index->pfEnabled = !*index->pfEnabled;
+        if (!pblocktree->WriteFlag(index->name, *index->pfEnabled)) {
+            strError = _("Error writing to the block tree database");
+            return false;
+        }
+    }
+    // The address summaries are only complete once the address index is built
+    if ((IsBuilding("addressindex") || !fAddressIndex) && !pblocktree->WriteFlag("addresssummary", false)) {
+        strError = _("Error writing to the block tree database");
+        return false;
+    }
+    return true;
+}
+
+bool BlockTreeIndexBuilder::EnableBuilds()
+{
+    LOCK2(cs_main, m_cs);
+    for (const BlockTreeIndex& index : BLOCK_TREE_INDEXES) {
+        if (m_builds.count(index.name) && !*index.pfEnabled) {
+            *index.pfEnabled = true;
+            if (!pblocktree->WriteFlag(index.name, true)) {
+                return error("%s: failed to write %s flag", __func__, index.name);
+            }
+        }
+    }
+    return true;
+}
+
+bool BlockTreeIndexBuilder::IsBuilding(const std::string& name) const
+{
+    LOCK(m_cs);
+    return m_builds.count(name) > 0;
+}
+
+bool BlockTreeIndexBuilder::HasPendingWork() const
+{
+    LOCK(m_cs);
+    return !m_builds.empty() || !m_drops.empty();
+}
+
+bool BlockTreeIndexBuilder::WriteBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, CDBBatch& batch)
+{
+    bool fTx, fAddress, fTimestamp, fSpent;
+    {
+        LOCK(m_cs);
+        fTx = m_builds.count("txindex");
+        fAddress = m_builds.count("addressindex");
+        fTimestamp = m_builds.count("timestampindex");
+        fSpent = m_builds.count("spentindex");
+    }
+
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
+    if (fTx) {
+        GetTxIndexDataForBlock(block, pindex, vPos);
+    }
+    if (fAddress || fSpent) {
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const CTransaction& tx = *block.vtx[i];
+            if (!tx.IsCoinBase()) {
+                const CTxUndo& txundo = block_undo.vtxundo[i - 1];
+                for (size_t j = 0; j < tx.vin.size(); j++) {
+                    AddInputIndexData(tx, i, j, txundo.vprevout[j].out, pindex->nHeight, fAddress, fSpent, addressIndex, addressUnspentIndex, spentIndex);
+                }
+            }
+            if (fAddress) {
+                for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                    AddOutputIndexData(tx, i, k, pindex->nHeight, addressIndex, addressUnspentIndex);
+                }
+            }
+        }
+    }
+
+    // Don't race with ConnectBlock()/DisconnectBlock(), which write the same indexes for the tip
+    LOCK(cs_main);
+    if (!chainActive.Contains(pindex)) {
+        // Disconnected in the meantime, Sync() moves back to the fork point next
+        return true;
+    }
+
+    if (fAddress) {
+        // Outputs that got spent by blocks connected after the index was enabled must not be added to the unspent
+        // index again, their removal was already written. Outputs spent by blocks that are still to be indexed are
+        // removed once we get there.
+        auto it = std::remove_if(addressUnspentIndex.begin(), addressUnspentIndex.end(), [](const std::pair<CAddressUnspentKey, CAddressUnspentValue>& entry) {
+            return !entry.second.IsNull() && !pcoinsTip->HaveCoin(COutPoint(entry.first.txhash, entry.first.index));
+        });
+        addressUnspentIndex.erase(it, addressUnspentIndex.end());
+
+        if (!pblocktree->WriteAddressIndex(addressIndex) || !pblocktree->UpdateAddressUnspentIndex(addressUnspentIndex)) {
+            return error("%s: failed to write address index", __func__);
+        }
+    }
+    if (fSpent && !pblocktree->UpdateSpentIndex(spentIndex)) {
+        return error("%s: failed to write spent index", __func__);
+    }
+    if (fTimestamp && !pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()))) {
+        return error("%s: failed to write timestamp index", __func__);
+    }
+    if (fTx && !pblocktree->WriteTxIndex(vPos)) {
+        return error("%s: failed to write transaction index", __func__);
+    }
+    return true;
+}
+
+bool BlockTreeIndexBuilder::CommitInternal(CDBBatch& batch)
+{
+    // The entries must be on disk before the best block moves past them
+    if (!pblocktree->Sync()) {
+        return error("%s: failed to sync the block tree database", __func__);
+    }
+    WriteState(batch);
+    return true;
+}
+
+bool BlockTreeIndexBuilder::RunDrops()
+{
+    std::set<std::string> drops;
+    {
+        LOCK(m_cs);
+        drops = m_drops;
+    }
+
+    for (const std::string& name : drops) {
+        LogPrintf("%s: erasing %s\n", __func__, name);
+        bool fDone = false;
+        while (!fDone) {
+            boost::this_thread::interruption_point();
+            if (!pblocktree->EraseIndex(name, INDEX_ERASE_BATCH_SIZE, fDone)) {
+                return error("%s: failed to erase %s", __func__, name);
+            }
+        }
+        {
+            LOCK(m_cs);
+            m_drops.erase(name);
+        }
+        CDBBatch batch(*m_db);
+        WriteState(batch);
+        if (!m_db->WriteBatch(batch, true)) {
+            return error("%s: failed to write to the block tree index builder database", __func__);
+        }
+        LogPrintf("%s: %s erased\n", __func__, name);
+    }
+    return true;
+}
+
+void BlockTreeIndexBuilder::ThreadBuild()
+{
+    RenameThread("dash-idxbuild");
+
+    try {
+        if (!RunDrops() || !EnableBuilds()) {
+            LogPrintf("%s: failed to erase disabled indexes\n", __func__);
+            return;
+        }
+        bool fBuild;
+        {
+            LOCK(m_cs);
+            fBuild = !m_builds.empty();
+        }
+        if (fBuild) {
+            // Everything connected after the first Sync() is written by ConnectBlock()
+            if (!Sync()) {
+                LogPrintf("%s: failed to build the %s, they won't be complete\n", __func__, GetName());
+                return;
+            }
+            bool fAddressIndexBuilt;
+            {
+                LOCK(m_cs);
+                for (const std::string& name : m_builds) {
+                    LogPrintf("%s: %s is built\n", __func__, name);
+                }
+                fAddressIndexBuilt = m_builds.count("addressindex");
+                m_builds.clear();
+            }
+            if (Commit() && fAddressIndexBuilt) {
+                pblocktree->WriteFlag("addresssummary", true);
+            }
+        }
+    } catch (const boost::thread_interrupted&) {
+        // Don't lose what was built since the last commit
+        Commit();
+        throw;
+    }
+}
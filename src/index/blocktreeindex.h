@@ -0,0 +1,71 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BLOCKTREEINDEX_H
+#define BITCOIN_INDEX_BLOCKTREEINDEX_H
+
+#include <index/base.h>
+#include <sync.h>
+
+#include <memory>
+#include <set>
+#include <string>
+
+/** Number of entries erased per batch when an index was disabled */
+static const size_t INDEX_ERASE_BATCH_SIZE = 10000;
+
+/**
+ * Builds and erases the txindex, addressindex, timestampindex and spentindex in the background.
+ *
+ * These indexes live in the block tree database and are written by ConnectBlock() as soon as they are enabled, as
+ * governance and InstantSend rely on them being up to date with the tip. When one of them is enabled on a node that
+ * already has a chain, the entries of the blocks connected before are added by this builder, which reads the blocks
+ * and undo data from disk like any other BaseIndex. Disabled indexes are erased by it as well, so neither requires a
+ * -reindex anymore. Pending builds and erasures are kept in the builder's own database and resumed after a restart.
+ *
+ * Lookups of historical entries fail until the build is done, IsBuilding() tells whether this is the case.
+ */
+class BlockTreeIndexBuilder final : public BaseIndex
+{
+private:
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    mutable CCriticalSection m_cs;
+    /** Indexes whose historical entries are still being added */
+    std::set<std::string> m_builds;
+    /** Indexes whose entries are still being erased */
+    std::set<std::string> m_drops;
+
+    void WriteState(CDBBatch& batch) const;
+    bool RunDrops();
+    /** Turn on the indexes that had to wait for their old entries to be erased */
+    bool EnableBuilds();
+
+protected:
+    bool NeedsUndo() const override { return true; }
+    bool WriteBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, CDBBatch& batch) override;
+    bool CommitInternal(CDBBatch& batch) override;
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+    const char* GetName() const override { return "block tree indexes"; }
+
+public:
+    explicit BlockTreeIndexBuilder(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /**
+     * Compare the flags loaded by LoadBlockIndex() with the -txindex/-addressindex/-timestampindex/-spentindex
+     * options and schedule the builds and erasures needed to apply them. Updates the flags in the block tree database
+     * and the globals, so that ConnectBlock() writes the enabled indexes from now on.
+     */
+    bool Configure(std::string& strError);
+
+    bool IsBuilding(const std::string& name) const;
+    bool HasPendingWork() const;
+
+    /** Erase the disabled indexes, then add all blocks of the active chain to the ones being built */
+    void ThreadBuild();
+};
+
+extern std::unique_ptr<BlockTreeIndexBuilder> g_blocktreeindexbuilder;
+
+#endif // BITCOIN_INDEX_BLOCKTREEINDEX_H
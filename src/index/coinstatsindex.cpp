@@ -0,0 +1,228 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/coinstatsindex.h>
+
+#include <chainparams.h>
+#include <coins.h>
+#include <node/coinstats.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+/* Besides the best block locator kept by BaseIndex, the database stores the running MuHash3072 as of the best block
+ * (DB_MUHASH) and a DBVal per height (DB_HEIGHT). Heights are serialized big-endian like in the block filter index.
+ */
+static const char DB_MUHASH = 'M';
+static const char DB_HEIGHT = 't';
+
+std::unique_ptr<CoinStatsIndex> g_coinstatsindex;
+
+struct CoinStatsIndex::DBVal {
+    uint256 hash;
+    uint256 muhash;
+    uint64_t transaction_output_count;
+    uint64_t bogo_size;
+    CAmount total_amount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(muhash);
+        READWRITE(transaction_output_count);
+        READWRITE(bogo_size);
+        READWRITE(total_amount);
+    }
+};
+
+namespace {
+
+struct DBHeightKey {
+    int height;
+
+    explicit DBHeightKey(int height_in = 0) : height(height_in) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ser_writedata8(s, DB_HEIGHT);
+        ser_writedata32be(s, height);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        char prefix = ser_readdata8(s);
+        if (prefix != DB_HEIGHT) {
+            throw std::ios_base::failure("Invalid format for coinstatsindex DB height key");
+        }
+        height = ser_readdata32be(s);
+    }
+};
+
+} // namespace
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    m_path(GetDataDir() / "indexes" / "coinstats"),
+    m_db(new BaseIndex::DB(m_path / "db", n_cache_size, f_memory, f_wipe))
+{
+}
+
+void CoinStatsIndex::ApplyBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, bool fReverse)
+{
+    // The outputs of the genesis block are not spendable
+    if (pindex->nHeight == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = *block.vtx[i];
+
+        // Coins created and spent in the same block cancel each other out, so the order doesn't matter
+        for (uint32_t j = 0; j < tx.vout.size(); j++) {
+            const CTxOut& out = tx.vout[j];
+            if (out.scriptPubKey.IsUnspendable()) {
+                continue;
+            }
+            const COutPoint outpoint(tx.GetHash(), j);
+            const Coin coin(out, pindex->nHeight, tx.IsCoinBase());
+            if (fReverse) {
+                RemoveCoinHash(m_muhash, outpoint, coin);
+                m_transaction_output_count--;
+                m_bogo_size -= GetBogoSize(out.scriptPubKey);
+                m_total_amount -= out.nValue;
+            } else {
+                ApplyCoinHash(m_muhash, outpoint, coin);
+                m_transaction_output_count++;
+                m_bogo_size += GetBogoSize(out.scriptPubKey);
+                m_total_amount += out.nValue;
+            }
+        }
+
+        if (tx.IsCoinBase()) {
+            continue;
+        }
+        const CTxUndo& tx_undo = block_undo.vtxundo[i - 1];
+        for (size_t j = 0; j < tx.vin.size(); j++) {
+            const COutPoint& outpoint = tx.vin[j].prevout;
+            const Coin& coin = tx_undo.vprevout[j];
+            if (fReverse) {
+                ApplyCoinHash(m_muhash, outpoint, coin);
+                m_transaction_output_count++;
+                m_bogo_size += GetBogoSize(coin.out.scriptPubKey);
+                m_total_amount += coin.out.nValue;
+            } else {
+                RemoveCoinHash(m_muhash, outpoint, coin);
+                m_transaction_output_count--;
+                m_bogo_size -= GetBogoSize(coin.out.scriptPubKey);
+                m_total_amount -= coin.out.nValue;
+            }
+        }
+    }
+}
+
+bool CoinStatsIndex::InitInternal(const CBlockIndex*& best_block)
+{
+    if (best_block) {
+        DBVal entry;
+        uint256 muhash;
+        if (m_db->Read(DB_MUHASH, m_muhash) && m_db->Read(DBHeightKey(best_block->nHeight), entry) &&
+            entry.hash == best_block->GetBlockHash()) {
+            m_muhash.Finalize(muhash);
+        }
+        if (!muhash.IsNull() && muhash == entry.muhash) {
+            m_transaction_output_count = entry.transaction_output_count;
+            m_bogo_size = entry.bogo_size;
+            m_total_amount = entry.total_amount;
+        } else {
+            LogPrintf("%s: best block %s of the %s not found, rebuilding it\n", __func__, best_block->GetBlockHash().ToString(), GetName());
+            best_block = nullptr;
+        }
+    }
+    if (!best_block) {
+        m_muhash = MuHash3072();
+        m_transaction_output_count = 0;
+        m_bogo_size = 0;
+        m_total_amount = 0;
+    }
+    m_tip = best_block;
+    return true;
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, CDBBatch& batch)
+{
+    ApplyBlock(block, block_undo, pindex, false);
+
+    DBVal entry;
+    entry.hash = pindex->GetBlockHash();
+    // Normalizing the running hash doesn't change the set it represents
+    m_muhash.Finalize(entry.muhash);
+    entry.transaction_output_count = m_transaction_output_count;
+    entry.bogo_size = m_bogo_size;
+    entry.total_amount = m_total_amount;
+    batch.Write(DBHeightKey(pindex->nHeight), entry);
+
+    m_tip = pindex;
+    return true;
+}
+
+bool CoinStatsIndex::RewindInternal(const CBlockIndex* pindex)
+{
+    DBVal entry;
+    if (!m_db->Read(DBHeightKey(pindex->nHeight), entry) || entry.hash != pindex->GetBlockHash()) {
+        return error("%s: fork block %s not found in the %s", __func__, pindex->GetBlockHash().ToString(), GetName());
+    }
+
+    // The disconnected blocks are still on disk, as the index can't be used with pruning
+    for (const CBlockIndex* pindexUndo = m_tip; pindexUndo && pindexUndo != pindex; pindexUndo = pindexUndo->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindexUndo, Params().GetConsensus())) {
+            return error("%s: failed to read block %s from disk", __func__, pindexUndo->GetBlockHash().ToString());
+        }
+        CBlockUndo block_undo;
+        if (pindexUndo->nHeight > 0 && !UndoReadFromDisk(block_undo, pindexUndo)) {
+            return error("%s: failed to read undo data of block %s", __func__, pindexUndo->GetBlockHash().ToString());
+        }
+        ApplyBlock(block, block_undo, pindexUndo, true);
+    }
+
+    uint256 muhash;
+    m_muhash.Finalize(muhash);
+    if (muhash != entry.muhash) {
+        return error("%s: MuHash of the %s doesn't match fork block %s", __func__, GetName(), pindex->GetBlockHash().ToString());
+    }
+    m_transaction_output_count = entry.transaction_output_count;
+    m_bogo_size = entry.bogo_size;
+    m_total_amount = entry.total_amount;
+    m_tip = pindex;
+    return true;
+}
+
+bool CoinStatsIndex::CommitInternal(CDBBatch& batch)
+{
+    batch.Write(DB_MUHASH, m_muhash);
+    return true;
+}
+
+bool CoinStatsIndex::LookupStats(const CBlockIndex* block_index, CCoinsStats& stats) const
+{
+    if (block_index->nHeight > GetCommittedHeight()) {
+        return false;
+    }
+    DBVal entry;
+    if (!m_db->Read(DBHeightKey(block_index->nHeight), entry) || entry.hash != block_index->GetBlockHash()) {
+        return false;
+    }
+
+    stats = CCoinsStats();
+    stats.nHeight = block_index->nHeight;
+    stats.hashBlock = entry.hash;
+    stats.hashMuHash = entry.muhash;
+    stats.nTransactionOutputs = entry.transaction_output_count;
+    stats.nBogoSize = entry.bogo_size;
+    stats.nTotalAmount = entry.total_amount;
+    return true;
+}
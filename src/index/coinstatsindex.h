@@ -0,0 +1,73 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_COINSTATSINDEX_H
+#define BITCOIN_INDEX_COINSTATSINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <crypto/muhash.h>
+#include <fs.h>
+#include <index/base.h>
+
+#include <memory>
+
+struct CCoinsStats;
+
+/** Default for -coinstatsindex */
+static const bool DEFAULT_COINSTATSINDEX = false;
+
+/**
+ * CoinStatsIndex maintains the statistics of gettxoutsetinfo for every block of the active chain, so they can be
+ * looked up at any height instead of scanning the coin database.
+ *
+ * The UTXO set is hashed with MuHash3072, which is updated with the outputs that every block creates and the coins
+ * it spends (from the undo data). A LevelDB keyed by height stores the block hash, the finalized MuHash and the
+ * totals after each block, the running MuHash3072 itself is stored on every commit. To go back to the fork point of
+ * a reorg the disconnected blocks are applied in reverse. The Lookup* methods can be called from any thread.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+private:
+    const fs::path m_path;
+    std::unique_ptr<BaseIndex::DB> m_db;
+
+    /** State after the last indexed block, only accessed by the index thread */
+    const CBlockIndex* m_tip{nullptr};
+    MuHash3072 m_muhash;
+    uint64_t m_transaction_output_count{0};
+    uint64_t m_bogo_size{0};
+    CAmount m_total_amount{0};
+
+    struct DBVal;
+
+    /** Add (or with fReverse remove) the effects of a block on the UTXO set */
+    void ApplyBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, bool fReverse);
+
+protected:
+    bool InitInternal(const CBlockIndex*& best_block) override;
+    bool NeedsUndo() const override { return true; }
+    bool WriteBlock(const CBlock& block, const CBlockUndo& block_undo, const CBlockIndex* pindex, CDBBatch& batch) override;
+    bool CommitInternal(CDBBatch& batch) override;
+    bool RewindInternal(const CBlockIndex* pindex) override;
+    BaseIndex::DB& GetDB() const override { return *m_db; }
+    const char* GetName() const override { return "coin stats index"; }
+
+public:
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    /** Height of the last block that can be looked up */
+    int GetIndexedHeight() const { return GetCommittedHeight(); }
+
+    /**
+     * Get the UTXO set statistics after a block, hashMuHash instead of hashSerialized. The number of transactions
+     * and the disk size are not kept by the index and left at 0.
+     */
+    bool LookupStats(const CBlockIndex* block_index, CCoinsStats& stats) const;
+};
+
+/** The coin stats index, nullptr if -coinstatsindex is not set */
+extern std::unique_ptr<CoinStatsIndex> g_coinstatsindex;
+
+#endif // BITCOIN_INDEX_COINSTATSINDEX_H
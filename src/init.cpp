@@ -19,9 +19,18 @@
 #include <node/coinstats.h>
 #include <compat/sanity.h>
 #include <consensus/validation.h>
+#include <crypto/aes.h>
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
+#include <dbwrapper.h>
 #include <fs.h>
+#include <hash.h>
+#include <headerscache.h>
 #include <httpserver.h>
 #include <httprpc.h>
+#include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
+#include <index/blocktreeindex.h>
 #include <key.h>
 #include <validation.h>
 #include <miner.h>
@@ -31,11 +40,14 @@
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
+#include <replica.h>
 #include <rpc/server.h>
 #include <rpc/register.h>
 #include <rpc/blockchain.h>
 #include <script/standard.h>
 #include <script/sigcache.h>
+#include <bls/bls_sigcache.h>
+#include <executor.h>
 #include <scheduler.h>
 #include <timedata.h>
 #include <txdb.h>
@@ -51,10 +63,12 @@
 #include <dsnotificationinterface.h>
 #include <flat-database.h>
 #include <governance/governance.h>
+#include <governance/governance-db.h>
 #include <masternode/masternode-meta.h>
 #include <masternode/masternode-payments.h>
 #include <masternode/masternode-sync.h>
 #include <masternode/masternode-utils.h>
+#include <memaccounting.h>
 #include <messagesigner.h>
 #include <netfulfilledman.h>
 #include <spork.h>
@@ -64,15 +78,19 @@
 #include <evo/deterministicmns.h>
 #include <llmq/quorums_init.h>
 #include <llmq/quorums_blockprocessor.h>
+#include <llmq/quorums_instantsend.h>
 #include <llmq/quorums_signing.h>
+#include <llmq/quorums_signing_shares.h>
 #include <llmq/quorums_utils.h>
 
 #include <statsd_client.h>
 
+#include <future>
 #include <stdint.h>
 #include <stdio.h>
 
 #include <bls/bls.h>
+#include <bls/bls_worker.h>
 
 #ifndef WIN32
 #include <signal.h>
@@ -95,6 +113,7 @@ bool fFeeEstimatesInitialized = false;
 static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
+static const bool DEFAULT_STARTUPPROFILE = false;
 
 
 std::unique_ptr<CConnman> g_connman;
@@ -208,6 +227,8 @@ static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 
 static boost::thread_group threadGroup;
 static CScheduler scheduler;
+// Runs the background callbacks of the validation interface
+static CScheduler validationScheduler;
 
 void Interrupt()
 {
@@ -217,6 +238,7 @@ void Interrupt()
     InterruptREST();
     InterruptTorControl();
     llmq::InterruptLLMQSystem();
+    governance.InterruptWorkerThread();
     InterruptMapPort();
     if (g_connman)
         g_connman->Interrupt();
@@ -241,7 +263,11 @@ void PrepareShutdown()
     StopREST();
     StopRPC();
     StopHTTPServer();
+    if (peerLogic) peerLogic->StopLLMQMessageThread();
+    if (peerLogic) peerLogic->StopBlockProcessingThread();
     llmq::StopLLMQSystem();
+    governance.StopWorkerThread();
+    StopBackgroundVerifyDB();
 
     // fRPCInWarmup should be `false` if we completed the loading sequence
     // before a shutdown request was received
@@ -255,6 +281,8 @@ void PrepareShutdown()
     // using the other before destroying them.
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
     if (g_connman) g_connman->Stop();
+    if (g_blockfilterindex) UnregisterValidationInterface(g_blockfilterindex.get());
+    if (g_coinstatsindex) UnregisterValidationInterface(g_coinstatsindex.get());
     // if (g_txindex) g_txindex->Stop(); //TODO watch out when backporting bitcoin#13033 (don't accidently put the reset here, as we've already backported bitcoin#13894)
 
     StopTorControl();
@@ -276,16 +304,26 @@ void PrepareShutdown()
         flatdb4.Dump(netfulfilledman);
         CFlatDB<CSporkManager> flatdb6("sporks.dat", "magicSporkCache");
         flatdb6.Dump(sporkManager);
-        if (!fDisableGovernance) {
-            CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
-            flatdb3.Dump(governance);
+        if (governanceDb) {
+            governance.WriteRecordsToDb();
+            if (gArgs.GetBoolArg("-governancedat", DEFAULT_GOVERNANCE_DAT)) {
+                CFlatDB<CGovernanceManager> flatdb3("governance.dat", "magicGovernanceCache");
+                flatdb3.Dump(governance);
+            }
         }
     }
 
+    g_memory_accounting.Unregister("mempool", &mempool);
+    g_memory_accounting.Unregister("governance", &governance);
+    g_memory_accounting.Unregister("coinjoin", nullptr);
+
     // After the threads that potentially access these pointers have been stopped,
     // destruct and reset all to nullptr.
     peerLogic.reset();
     g_connman.reset();
+    g_blockfilterindex.reset();
+    g_coinstatsindex.reset();
+    g_blocktreeindexbuilder.reset();
     //g_txindex.reset(); //TODO watch out when backporting bitcoin#13033 (re-enable this, was backported via bitcoin#13894)
 
     if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
@@ -328,10 +366,14 @@ void PrepareShutdown()
         pcoinscatcher.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
+        CloseBlockTimingsLog();
         llmq::DestroyLLMQSystem();
         deterministicMNManager.reset();
         evoDb.reset();
     }
+    // The script check queue and the LLMQ are stopped, nothing uses the executor anymore
+    StopExecutor();
+    governanceDb.reset();
     g_wallet_init_interface.Stop();
 
 #if ENABLE_ZMQ
@@ -347,6 +389,10 @@ void PrepareShutdown()
         delete pdsNotificationInterface;
         pdsNotificationInterface = nullptr;
     }
+    if (g_block_template_cache) {
+        UnregisterValidationInterface(g_block_template_cache.get());
+        g_block_template_cache.reset();
+    }
     if (fMasternodeMode) {
         UnregisterValidationInterface(activeMasternodeManager);
     }
@@ -386,7 +432,10 @@ void Shutdown()
     g_wallet_init_interface.Close();
     globalVerifyHandle.reset();
     ECC_Stop();
+    // send the last metrics before gArgs goes away
+    statsClient.stop();
     LogPrintf("%s: done\n", __func__);
+    StopAsyncLogging();
 }
 
 /**
@@ -468,39 +517,57 @@ void SetupServerArgs()
     // Set all of the args and their help
     // When adding new options to the categories, please keep and ensure alphabetical ordering.
     gArgs.AddArg("-?", "Print this help message and exit", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-adaptiveblockdownload", strprintf("Size the number of blocks requested from each peer by its measured download speed and ping, and request blocks which hold up the download from faster peers (default: %u)", DEFAULT_ADAPTIVE_BLOCK_DOWNLOAD), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-alertnotify=<cmd>", "Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-assumevalid=<hex>", strprintf("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)", defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-asynccoinsflush", strprintf("Write the UTXO set to disk in the background when flushing the cache periodically (default: %u)", DEFAULT_ASYNC_COINS_FLUSH), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksdir=<dir>", "Specify blocks directory (default: <datadir>/blocks)", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-readonlyreplica=<dir>", "Serve the chain of the node with the datadir <dir> through the read RPCs and REST, without connecting to the network. The databases of the primary are snapshotted into our own datadir at startup, which must be on the same filesystem", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to operate in a blocks only mode (default: %u)", DEFAULT_BLOCKSONLY), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-cmpctblockprefermasternodes", strprintf("Prefer verified masternode peers, and among the others the ones announcing new blocks the fastest, as high-bandwidth compact block peers (default: %u)", DEFAULT_CMPCTBLOCK_PREFER_MASTERNODES), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-compactundo", strprintf("Write the undo data of new blocks in a smaller, compact format. Undo data written this way can't be read by older versions, so don't downgrade without -reindex (default: %u)", DEFAULT_COMPACT_UNDO), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Set database cache size in megabytes (%d to %d, default: %d)", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (0 to disable; default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-governancedat", strprintf("Also write the governance data to governance.dat on shutdown, which older versions read and which is imported when the governance database is empty (default: %u)", DEFAULT_GOVERNANCE_DAT), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-iscachesize=<n>", strprintf("Maximum memory used by the InstantSend lock caches in megabytes, taken from -dbcache (default: %u)", llmq::DEFAULT_INSTANTSEND_CACHE_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantxsize=<n>", strprintf("Maximum total size of all orphan transactions in megabytes (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxrecsigsage=<n>", strprintf("Number of seconds to keep LLMQ recovery sigs (default: %u)", llmq::DEFAULT_MAX_RECOVERED_SIGS_AGE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-mempoolbatchedeviction", strprintf("When the mempool is full, pick all transaction packages to evict in a single pass instead of one package at a time (default: %u)", DEFAULT_MEMPOOL_BATCHED_EVICTION), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-mempoolsnapshotinterval=<n>", strprintf("Serve read-only mempool RPC and REST calls from a snapshot of the mempool, republished every <n> milliseconds, instead of locking the mempool (0 to disable, default: %d)", DEFAULT_MEMPOOL_SNAPSHOT_INTERVAL), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-minimumchainwork=<hex>", strprintf("Minimum work assumed to exist on a valid chain in hex (default: %s, testnet: %s)", defaultChainParams->GetConsensus().nMinimumChainWork.GetHex(), testnetChainParams->GetConsensus().nMinimumChainWork.GetHex()), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-coinsprefetch=<n>", strprintf("Number of queued blocks whose inputs are read ahead from the chainstate database while blocks are connected (0 to disable, default: %d)", DEFAULT_COINS_PREFETCH_BLOCKS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-par=<n>", strprintf("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)",
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-headerscache", strprintf("Keep the serialized headers of the active chain in memory, about 80 bytes per block, to answer getheaders and REST headers requests from it (default: %u)", DEFAULT_HEADERS_CACHE), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-mmapblocks", strprintf("Memory map finalized block and undo files and read blocks and undo data straight from the mapping (default: %u)", DEFAULT_MMAP_BLOCKS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-parallelreindex", strprintf("With -reindex, scan all block files for their headers in parallel and build the header index before loading the blocks, which are read ahead (default: %u)", DEFAULT_PARALLEL_REINDEX), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-persistmempool", strprintf("Whether to save the mempool on shutdown and load on restart (default: %u)", DEFAULT_PERSIST_MEMPOOL), false, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-pid=<file>", strprintf("Specify pid file. Relative paths will be prefixed by a net-specific datadir location. (default: %s)", BITCOIN_PID_FILENAME), false, OptionsCategory::OPTIONS);
 #endif
-    gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex, -rescan and -disablegovernance=false. "
+    gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. The masternode lists and quorum data only needed for the pruned blocks are removed as well. This mode is incompatible with -txindex, -rescan and -disablegovernance=false. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-syncmempool", strprintf("Sync mempool from other nodes on start (default: %u)", DEFAULT_SYNC_MEMPOOL), false, OptionsCategory::OPTIONS);
 #ifndef WIN32
     gArgs.AddArg("-sysperms", "Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)", false, OptionsCategory::OPTIONS);
 #endif
+    gArgs.AddArg("-executorthreads=<n>", strprintf("Set the number of threads shared by script verification, BLS operations and the other compute heavy work (0 = one per core, up to %d, default: %d)", MAX_EXECUTOR_THREADS, DEFAULT_EXECUTOR_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-schedulerthreads=<n>", strprintf("Set the number of threads which run the periodic maintenance tasks, tasks of the same kind never run at the same time (1 to %d, default: %d)", MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-validationthreads=<n>", strprintf("Set the number of threads which run the background validation callbacks of the wallet, ZMQ and the other listeners, each listener is run by one of them at a time (1 to %d, default: %d)", MAX_VALIDATION_INTERFACE_THREADS, DEFAULT_VALIDATION_INTERFACE_THREADS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-version", "Print version and exit", false, OptionsCategory::OPTIONS);
 
     gArgs.AddArg("-addressindex", strprintf("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)", DEFAULT_ADDRESSINDEX), false, OptionsCategory::INDEXING);
+    gArgs.AddArg("-blockfilterindex=<type>", strprintf("Maintain an index of compact filters by block (default: %u, values: %s). If <type> is not supplied or if <type> = 1, the basic filter index is enabled.", DEFAULT_BLOCKFILTERINDEX, BlockFilterTypeName(BlockFilterType::BASIC_FILTER)), false, OptionsCategory::INDEXING);
+    gArgs.AddArg("-coinstatsindex", strprintf("Maintain the statistics of gettxoutsetinfo, including a MuHash of the UTXO set, for every block (default: %u)", DEFAULT_COINSTATSINDEX), false, OptionsCategory::INDEXING);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", false, OptionsCategory::INDEXING);
     gArgs.AddArg("-reindex-chainstate", "Rebuild chain state from the currently indexed blocks", false, OptionsCategory::INDEXING);
     gArgs.AddArg("-spentindex", strprintf("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)", DEFAULT_SPENTINDEX), false, OptionsCategory::INDEXING);
@@ -521,13 +588,16 @@ void SetupServerArgs()
     gArgs.AddArg("-forcednsseed", strprintf("Always query for peer addresses via DNS lookup (default: %u)", DEFAULT_FORCEDNSSEED), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-listen", "Accept connections from outside (default: 1 if no -proxy or -connect)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-listenonion", strprintf("Automatically create Tor hidden service (default: %d)", DEFAULT_LISTEN_ONION), false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-maxconnectattempts=<n>", strprintf("Maximum number of outbound connection attempts to make in parallel (1 to %d, default: %d)", MAX_CONNECT_ATTEMPTS_LIMIT, DEFAULT_MAX_CONNECT_ATTEMPTS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxconnections=<n>", strprintf("Maintain at most <n> connections to peers (temporary service connections excluded) (default: %u)", DEFAULT_MAX_PEER_CONNECTIONS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxreceivebuffer=<n>", strprintf("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXRECEIVEBUFFER), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxsendbuffer=<n>", strprintf("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)", DEFAULT_MAXSENDBUFFER), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxtimeadjustment", strprintf("Maximum allowed median peer time offset adjustment. Local perspective of time may be influenced by peers forward or backward by this amount. (default: %u seconds)", DEFAULT_MAX_TIME_ADJUSTMENT), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-maxuploadtarget=<n>", strprintf("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)", DEFAULT_MAX_UPLOAD_TARGET), false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-msghandlerthreads=<n>", strprintf("Number of threads to process peer messages with, each peer is always handled by the same thread (1 to %d, default: %d)", MAX_MSG_HANDLER_THREADS, DEFAULT_MSG_HANDLER_THREADS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onion=<ip:port>", "Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: -proxy)", false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-onlynet=<net>", "Make outgoing connections only through network <net> (ipv4, ipv6 or onion). Incoming connections are not affected by this option. This option can be specified multiple times to allow multiple networks.", false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-peerblockfilters", strprintf("Serve compact block filters to peers per BIP 157 (default: %u)", DEFAULT_PEERBLOCKFILTERS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peerbloomfilters", strprintf("Support filtering of blocks and transaction with bloom filters (default: %u)", DEFAULT_PEERBLOOMFILTERS), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-peertimeout=<n>", strprintf("Specify p2p connection timeout in seconds. This option determines the amount of time a peer may be inactive before the connection to it is dropped. (minimum: 1, default: %d)", DEFAULT_PEER_CONNECT_TIMEOUT), false, OptionsCategory::CONNECTION);
     gArgs.AddArg("-permitbaremultisig", strprintf("Relay non-P2SH multisig (default: %u)", DEFAULT_PERMIT_BAREMULTISIG), false, OptionsCategory::CONNECTION);
@@ -554,31 +624,51 @@ void SetupServerArgs()
 
 #if ENABLE_ZMQ
     gArgs.AddArg("-zmqpubhashblock=<address>", "Enable publish hash block in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashblockhwm=<n>", strprintf("Set publish hash block outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashgovernanceobject=<address>", "Enable publish hash of governance objects (like proposals) in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashgovernanceobjecthwm=<n>", strprintf("Set publish hash of governance objects (like proposals) outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashgovernancevote=<address>", "Enable publish hash of governance votes in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashgovernancevotehwm=<n>", strprintf("Set publish hash of governance votes outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashinstantsenddoublespend=<address>", "Enable publish transaction hashes of attempted InstantSend double spend in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashinstantsenddoublespendhwm=<n>", strprintf("Set publish transaction hashes of attempted InstantSend double spend outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashrecoveredsig=<address>", "Enable publish message hash of recovered signatures (recovered by LLMQs) in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashrecoveredsighwm=<n>", strprintf("Set publish message hash of recovered signatures (recovered by LLMQs) outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtx=<address>", "Enable publish hash transaction in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashtxhwm=<n>", strprintf("Set publish hash transaction outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubhashtxlock=<address>", "Enable publish hash transaction (locked via InstantSend) in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubhashtxlockhwm=<n>", strprintf("Set publish hash transaction (locked via InstantSend) outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawblock=<address>", "Enable publish raw block in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawblockhwm=<n>", strprintf("Set publish raw block outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawinstantsenddoublespend=<address>", "Enable publish raw transactions of attempted InstantSend double spend in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawinstantsenddoublespendhwm=<n>", strprintf("Set publish raw transactions of attempted InstantSend double spend outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawrecoveredsig=<address>", "Enable publish raw recovered signatures (recovered by LLMQs) in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawrecoveredsighwm=<n>", strprintf("Set publish raw recovered signatures (recovered by LLMQs) outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtx=<address>", "Enable publish raw transaction in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawtxhwm=<n>", strprintf("Set publish raw transaction outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
     gArgs.AddArg("-zmqpubrawtxlock=<address>", "Enable publish raw transaction (locked via InstantSend) in <address>", false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqpubrawtxlockhwm=<n>", strprintf("Set publish raw transaction (locked via InstantSend) outbound message high water mark (default: %d)", DEFAULT_ZMQ_SNDHWM), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqqueueblock", strprintf("Wait for space in a full ZMQ notification queue instead of dropping notifications, this may delay other validation callbacks (default: %u)", DEFAULT_ZMQ_QUEUE_BLOCK), false, OptionsCategory::ZMQ);
+    gArgs.AddArg("-zmqqueuesize=<n>", strprintf("Maximum number of ZMQ notifications waiting to be published (default: %u)", DEFAULT_ZMQ_QUEUE_SIZE), false, OptionsCategory::ZMQ);
 #endif
 
-    gArgs.AddArg("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. (default: %u)", defaultChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-blocktimingslog=<file>", "Append the time each stage of connecting a block took to <file>, one CSV line per connected block (relative to the network specific data directory)", true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also re-verifies stored block hashes when loading the block index. (default: %u)", defaultChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-backgroundcheckblocks=<n>", strprintf("How many blocks below the ones of -checkblocks to check in the background once the node is started, at up to check level %d (default: %d, -1 = all)", MAX_BACKGROUND_CHECKLEVEL, DEFAULT_BACKGROUND_CHECKBLOCKS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkblocks=<n>", strprintf("How many blocks to check at startup (default: %u, 0 = all)", DEFAULT_CHECKBLOCKS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checklevel=<n>", strprintf("How thorough the block verification of -checkblocks is (0-4, default: %u)", DEFAULT_CHECKLEVEL), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-dbcompactionthreads=<n>", strprintf("Number of threads LevelDB compacts the databases with, each database is compacted by one thread at a time (default: %u)", DEFAULT_DB_COMPACTION_THREADS), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-dbtuning=<db>:<setting>=<n>[,...]", "Override the LevelDB settings of the database in directory <db> (e.g. chainstate, index, evodb, llmq). Settings are blocksize (in KiB), compression (0 or 1, only effective if LevelDB was built with Snappy), writebuffer (in percent of the cache), maxfilesize (in MiB) and bloombits (0 to disable the bloom filter). Can be specified multiple times", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-dropmessagestest=<n>", "Randomly drop 1 of every <n> network messages", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitancestorcount=<n>", strprintf("Do not accept transactions if number of in-mempool ancestors is <n> or more (default: %u)", DEFAULT_ANCESTOR_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitancestorsize=<n>", strprintf("Do not accept transactions whose size with all in-mempool ancestors exceeds <n> kilobytes (default: %u)", DEFAULT_ANCESTOR_SIZE_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitdescendantcount=<n>", strprintf("Do not accept transactions if any ancestor would have <n> or more in-mempool descendants (default: %u)", DEFAULT_DESCENDANT_LIMIT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-limitdescendantsize=<n>", strprintf("Do not accept transactions if any ancestor would have more than <n> kilobytes of in-mempool descendants (default: %u).", DEFAULT_DESCENDANT_SIZE_LIMIT), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-schedulerwarnms=<n>", strprintf("Log scheduler tasks which run longer than <n> milliseconds, 0 to disable (default: %d)", DEFAULT_SCHEDULER_WARN_MS), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-stopafterblockimport", strprintf("Stop running after importing blocks from disk (default: %u)", DEFAULT_STOPAFTERBLOCKIMPORT), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-startupprofile", strprintf("Log how long each stage of loading the block index and chainstate takes (default: %u)", DEFAULT_STARTUPPROFILE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-stopatheight", strprintf("Stop running after reaching the given height in the main chain (default: %u)", DEFAULT_STOPATHEIGHT), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-vbparams=<deployment>:<start>:<end>(:<window>:<threshold>)", "Use given start/end times for specified version bits deployment (regtest-only). Specifying window and threshold is optional.", true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-watchquorums=<n>", strprintf("Watch and validate quorum communication (default: %u)", llmq::DEFAULT_WATCH_QUORUMS), true, OptionsCategory::DEBUG_TEST);
@@ -595,9 +685,14 @@ void SetupServerArgs()
     gArgs.AddArg("-llmqdevnetparams=<size:threshold>", strprintf("Override the default LLMQ size for the LLMQ_DEVNET quorum (default: %u:%u)", devnetLLMQ.size, devnetLLMQ.threshold), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-llmqinstantsend=<quorum name>", strprintf("Override the default LLMQ type used for InstantSend on a devnet. Allows using InstantSend with smaller LLMQs. (default: %s)", devnetConsensus.llmqs.at(devnetConsensus.llmqTypeInstantSend).name), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-llmqtestparams=<size:threshold>", strprintf("Override the default LLMQ size for the LLMQ_TEST quorum (default: %u:%u)", regtestLLMQ.size, regtestLLMQ.threshold), false, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-lockprofile", strprintf("Record how long locks are waited for and held, see getlockstats (default: %u)", DEFAULT_LOCK_PROFILE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logips", strprintf("Include IP addresses in debug output (default: %u)", DEFAULT_LOGIPS), false, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logthreadnames", strprintf("Add thread names to debug messages (default: %u)", DEFAULT_LOGTHREADNAMES), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-logjson", strprintf("Write debug messages as JSON objects, one per line, with their time, thread and category (default: %u)", DEFAULT_LOGJSON), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-asynclogging", strprintf("Write debug messages on a background thread, messages queued at the time of a crash are lost (default: %u)", DEFAULT_ASYNCLOGGING), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-logdroponoverflow", strprintf("With -asynclogging, drop debug messages instead of waiting when a thread logs faster than they can be written (default: %u)", DEFAULT_LOGDROPONOVERFLOW), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS), true, OptionsCategory::DEBUG_TEST);
+    gArgs.AddArg("-maxblssigcachesize=<n>", strprintf("Limit the size of the cache of valid BLS signatures to <n> MiB (default: %u)", DEFAULT_MAX_BLS_SIG_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE), true, OptionsCategory::DEBUG_TEST);
     gArgs.AddArg("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)", true, OptionsCategory::DEBUG_TEST);
@@ -616,10 +711,14 @@ void SetupServerArgs()
 
     SetupChainParamsBaseOptions();
 
+    gArgs.AddArg("-blsworkerthreads=<n>", strprintf("Number of parallel tasks for BLS operations like DKG contributions and sig share verification, they run on the threads of -executorthreads (0 = one per executor thread, up to %d, default: %d)", MAX_BLS_WORKER_THREADS, DEFAULT_BLS_WORKER_THREADS), false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-coinjoinserversessions=<n>", strprintf("Number of CoinJoin mixing sessions of different denominations to run at once (%d-%d, default: %d)", MIN_COINJOIN_SERVER_SESSIONS, MAX_COINJOIN_SERVER_SESSIONS, DEFAULT_COINJOIN_SERVER_SESSIONS), false, OptionsCategory::MASTERNODE);
     gArgs.AddArg("-llmq-data-recovery=<n>", strprintf("Enable automated quorum data recovery (default: %u)", llmq::DEFAULT_ENABLE_QUORUM_DATA_RECOVERY), false, OptionsCategory::MASTERNODE);
     gArgs.AddArg("-llmq-qvvec-sync=<quorum_name>:<mode>", strprintf("Defines from which LLMQ type the masternode should sync quorum verification vectors. Can be used multiple times with different LLMQ types. <mode>: %d (sync always from all quorums of the type defined by <quorum_name>), %d (sync from all quorums of the type defined by <quorum_name> if a member of any of the quorums)", (int32_t)llmq::QvvecSyncMode::Always, (int32_t)llmq::QvvecSyncMode::OnlyIfTypeMember), false, OptionsCategory::MASTERNODE);
     gArgs.AddArg("-masternodeblsprivkey=<hex>", "Set the masternode BLS private key and enable the client to act as a masternode", false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-mnsyncpeers=<n>", strprintf("Number of peers governance objects and votes are synced from in parallel (1 to %d, default: %d)", MAX_MNSYNC_PEERS, DEFAULT_MNSYNC_PEERS), false, OptionsCategory::MASTERNODE);
     gArgs.AddArg("-platform-user=<user>", "Set the username for the \"platform user\", a restricted user intended to be used by Dash Platform, to the specified username.", false, OptionsCategory::MASTERNODE);
+    gArgs.AddArg("-sigsharesworkerthreads=<n>", strprintf("Number of threads which process and recover sig shares, sharded by signing session (0 = auto, up to %d, default: %d)", llmq::MAX_SIGSHARES_WORKER_THREADS, llmq::DEFAULT_SIGSHARES_WORKER_THREADS), false, OptionsCategory::MASTERNODE);
 
     gArgs.AddArg("-acceptnonstdtxn", strprintf("Relay and mine \"non-standard\" transactions (%sdefault: %u)", "testnet/regtest only; ", !testnetChainParams->RequireStandard()), true, OptionsCategory::NODE_RELAY);
     gArgs.AddArg("-dustrelayfee=<amt>", strprintf("Fee rate (in %s/kB) used to defined dust, the value of an output such that it will cost more than its value in fees at this fee rate to spend it. (default: %s)", CURRENCY_UNIT, FormatMoney(DUST_RELAY_TX_FEE)), true, OptionsCategory::NODE_RELAY);
@@ -634,11 +733,14 @@ void SetupServerArgs()
 
     gArgs.AddArg("-blockmaxsize=<n>", strprintf("Set maximum block size in bytes (default: %d)", DEFAULT_BLOCK_MAX_SIZE), false, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockmintxfee=<amt>", strprintf("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)", CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)), false, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-blocktemplatefastcheck", strprintf("Only re-check block-level rules and the coinbase of new block templates instead of fully connecting them, relying on the validation already done when their transactions entered the mempool (default: %u)", DEFAULT_BLOCKTEMPLATE_FASTCHECK), false, OptionsCategory::BLOCK_CREATION);
+    gArgs.AddArg("-blocktemplateprecompute", strprintf("Keep a block template for getblocktemplate ready in the background, rebuilt on every new tip and at most every %dms for mempool changes (default: %u)", BLOCKTEMPLATE_PRECOMPUTE_INTERVAL, DEFAULT_BLOCKTEMPLATE_PRECOMPUTE), false, OptionsCategory::BLOCK_CREATION);
     gArgs.AddArg("-blockversion=<n>", "Override block version to test forking scenarios", true, OptionsCategory::BLOCK_CREATION);
 
     gArgs.AddArg("-rest", strprintf("Accept public REST requests (default: %u)", DEFAULT_REST_ENABLE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcallowip=<ip>", "Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcauth=<userpw>", "Username and hashed password for JSON-RPC connections. The field <userpw> comes in the format: <USERNAME>:<SALT>$<HASH>. A canonical python script is included in share/rpcuser. The client then connects normally using the rpcuser=<USERNAME>/rpcpassword=<PASSWORD> pair of arguments. This option can be specified multiple times", false, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcblockcache=<n>", strprintf("Keep the decoded transactions of the last <n> blocks requested through getblock with verbosity 2 or REST, so that repeated requests for them skip decoding (default: %u)", DEFAULT_RPC_BLOCK_CACHE), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcbind=<addr>[:port]", "Bind to given address to listen for JSON-RPC connections. Do not expose the RPC server to untrusted networks such as the public internet! This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost, or if -rpcallowip has been specified, 0.0.0.0 and :: i.e., all addresses)", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpccookiefile=<loc>", "Location of the auth cookie. Relative paths will be prefixed by a net-specific datadir location. (default: data dir)", false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcpassword=<pw>", "Password for JSON-RPC connections", false, OptionsCategory::RPC);
@@ -646,7 +748,7 @@ void SetupServerArgs()
     gArgs.AddArg("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT), true, OptionsCategory::RPC);
     gArgs.AddArg("-rpcthreads=<n>", strprintf("Set the number of threads to service RPC calls (default: %d)", DEFAULT_HTTP_THREADS), false, OptionsCategory::RPC);
     gArgs.AddArg("-rpcuser=<user>", "Username for JSON-RPC connections", false, OptionsCategory::RPC);
-    gArgs.AddArg("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE), true, OptionsCategory::RPC);
+    gArgs.AddArg("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls, once it is full no new connections are accepted until it drains and up to %d times as many requests wait (default: %d)", HTTP_WORKQUEUE_OVERFLOW_FACTOR, DEFAULT_HTTP_WORKQUEUE), true, OptionsCategory::RPC);
     gArgs.AddArg("-server", "Accept command line and JSON-RPC commands", false, OptionsCategory::RPC);
 
     gArgs.AddArg("-statsenabled", strprintf("Publish internal stats to statsd (default: %u)", DEFAULT_STATSD_ENABLE), false, OptionsCategory::STATSD);
@@ -692,6 +794,15 @@ static void BlockNotifyCallback(bool initialSync, const CBlockIndex *pBlockIndex
     }
 }
 
+static bool fStartupProfile = DEFAULT_STARTUPPROFILE;
+
+static void LogStartupStage(const char* stage, int64_t start_time)
+{
+    if (fStartupProfile) {
+        LogPrintf("Startup stage %-24s %15dms\n", stage, GetTimeMillis() - start_time);
+    }
+}
+
 static bool fHaveGenesis = false;
 static CWaitableCriticalSection cs_GenesisWait;
 static CConditionVariable condvar_GenesisWait;
@@ -773,17 +884,21 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
-            CDiskBlockPos pos(nFile, 0);
-            if (!fs::exists(GetBlockPosFilename(pos, "blk")))
-                break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
+        if (gArgs.GetBoolArg("-parallelreindex", DEFAULT_PARALLEL_REINDEX)) {
+            ReindexBlockFiles(chainparams);
+        } else {
+            int nFile = 0;
+            while (true) {
+                CDiskBlockPos pos(nFile, 0);
+                if (!fs::exists(GetBlockPosFilename(pos, "blk")))
+                    break; // No block files left to reindex
+                FILE *file = OpenBlockFile(pos, true);
+                if (!file)
+                    break; // This error is logged in OpenBlockFile
+                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
+                LoadExternalBlockFile(chainparams, file, &pos);
+                nFile++;
+            }
         }
         pblocktree->WriteReindexing(false);
         fReindex = false;
@@ -869,6 +984,39 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
     g_is_mempool_loaded = !fRequestShutdown;
 }
 
+/** Send the profiles of -lockprofile, summed up over the call sites of each lock */
+static void PeriodicLockStats()
+{
+    std::map<std::string, LockProfileStats> mapLocks;
+    for (const LockProfileStats& site : GetLockProfileStats()) {
+        std::string strKey = site.strName;
+        for (char& c : strKey) {
+            // Names are the expressions passed to LOCK, e.g. pwallet->cs_wallet
+            if (!IsDigit(c) && !(c >= 'a' && c <= 'z') && !(c >= 'A' && c <= 'Z') && c != '_') c = '_';
+        }
+        LockProfileStats& stats = mapLocks[strKey];
+        stats.nContentions += site.nContentions;
+        stats.nWaitMicros += site.nWaitMicros;
+        stats.nMaxWaitMicros = std::max(stats.nMaxWaitMicros, site.nMaxWaitMicros);
+        stats.nHoldSamples += site.nHoldSamples;
+        stats.nHoldMicros += site.nHoldMicros;
+        stats.nMaxHoldMicros = std::max(stats.nMaxHoldMicros, site.nMaxHoldMicros);
+        for (int i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+            stats.waitHistogram[i] += site.waitHistogram[i];
+            stats.holdHistogram[i] += site.holdHistogram[i];
+        }
+    }
+    for (const auto& p : mapLocks) {
+        const LockProfileStats& stats = p.second;
+        const std::string strPrefix = "locks." + p.first + ".";
+        statsClient.gauge(strPrefix + "contentions", stats.nContentions, 1.0f);
+        statsClient.gauge(strPrefix + "waitTotalMs", stats.nWaitMicros / 1000, 1.0f);
+        statsClient.gauge(strPrefix + "waitP99Us", LockProfileStats::GetPercentile(stats.waitHistogram, 99), 1.0f);
+        statsClient.gauge(strPrefix + "holdP50Us", LockProfileStats::GetPercentile(stats.holdHistogram, 50), 1.0f);
+        statsClient.gauge(strPrefix + "holdP99Us", LockProfileStats::GetPercentile(stats.holdHistogram, 99), 1.0f);
+    }
+}
+
 void PeriodicStats()
 {
     assert(gArgs.GetBoolArg("-statsenabled", DEFAULT_STATSD_ENABLE));
@@ -913,12 +1061,87 @@ void PeriodicStats()
     statsClient.gaugeDouble("network.difficulty", (double)GetDifficulty(tip));
 
     statsClient.gauge("transactions.txCacheSize", pcoinsTip->GetCacheSize(), 1.0f);
+
+    CDBWriteStallStats stalls = pcoinsdbview->GetWriteStallStats();
+    statsClient.gauge("leveldb.chainstate.writeStalls", stalls.nSlowdowns + stalls.nMemtableWaits + stalls.nL0Waits, 1.0f);
+    statsClient.gauge("leveldb.chainstate.writeStallMillis", stalls.nStallMicros / 1000, 1.0f);
+    if (evoDb) {
+        stalls = evoDb->GetRawDB().GetWriteStallStats();
+        statsClient.gauge("leveldb.evodb.writeStalls", stalls.nSlowdowns + stalls.nMemtableWaits + stalls.nL0Waits, 1.0f);
+        statsClient.gauge("leveldb.evodb.writeStallMillis", stalls.nStallMicros / 1000, 1.0f);
+    }
     statsClient.gauge("transactions.totalTransactions", tip->nChainTx, 1.0f);
 
     statsClient.gauge("transactions.mempool.totalTransactions", mempool.size(), 1.0f);
     statsClient.gauge("transactions.mempool.totalTxBytes", (int64_t) mempool.GetTotalTxSize(), 1.0f);
     statsClient.gauge("transactions.mempool.memoryUsageBytes", (int64_t) mempool.DynamicMemoryUsage(), 1.0f);
     statsClient.gauge("transactions.mempool.minFeePerKb", mempool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFeePerK(), 1.0f);
+
+    for (const auto& p : g_memory_accounting.GetUsages()) {
+        statsClient.gauge("memory." + p.first + ".usageBytes", p.second, 1.0f);
+    }
+
+    if (g_connman) {
+        for (const auto& p : g_connman->GetMsgProcessingStats()) {
+            statsClient.gauge("message.processing." + p.first + ".count", p.second.nCount, 1.0f);
+            statsClient.gauge("message.processing." + p.first + ".timeUs", p.second.nTimeMicros, 1.0f);
+        }
+    }
+
+    for (const auto& stats : GetMainSignals().GetListenerStats()) {
+        std::string strName = stats.strName;
+        std::replace_if(strName.begin(), strName.end(), [](char c) { return !IsDigit(c) && !((c | 0x20) >= 'a' && (c | 0x20) <= 'z'); }, '_');
+        statsClient.gauge("validationinterface." + strName + ".pending", stats.nPending, 1.0f);
+        statsClient.gauge("validationinterface." + strName + ".callbacks", stats.nCallbacks, 1.0f);
+        statsClient.gauge("validationinterface." + strName + ".lastLagMs", stats.nLastLagMicros / 1000, 1.0f);
+        statsClient.gauge("validationinterface." + strName + ".maxLagMs", stats.nMaxLagMicros / 1000, 1.0f);
+    }
+
+    auto blsSigCacheStats = GetBLSSignatureCacheStats();
+    statsClient.gauge("bls.sigcache.hits", blsSigCacheStats.nHits, 1.0f);
+    statsClient.gauge("bls.sigcache.misses", blsSigCacheStats.nMisses, 1.0f);
+    statsClient.gauge("bls.sigcache.inserts", blsSigCacheStats.nInserts, 1.0f);
+
+    // The utilization of a class is the share of the executor's thread time it used since the last run
+    static int64_t nLastExecutorStatsTime = GetTimeMicros();
+    static std::array<int64_t, (size_t)ExecutorPriority::COUNT> vecLastBusyMicros{};
+    int64_t nExecutorStatsTime = GetTimeMicros();
+    int64_t nExecutorCapacity = std::max<int64_t>(1, (nExecutorStatsTime - nLastExecutorStatsTime) * GetExecutor().size());
+    auto executorStats = GetExecutor().GetStats();
+    for (size_t i = 0; i < executorStats.size(); i++) {
+        std::string strClass = ExecutorPriorityName((ExecutorPriority)i);
+        statsClient.gauge("executor." + strClass + ".pending", executorStats[i].nPending, 1.0f);
+        statsClient.gauge("executor." + strClass + ".running", executorStats[i].nRunning, 1.0f);
+        statsClient.gauge("executor." + strClass + ".tasks", executorStats[i].nTasks, 1.0f);
+        statsClient.gauge("executor." + strClass + ".busyUs", executorStats[i].nBusyMicros, 1.0f);
+        statsClient.gaugeDouble("executor." + strClass + ".utilization", 100.0 * (executorStats[i].nBusyMicros - vecLastBusyMicros[i]) / nExecutorCapacity);
+        vecLastBusyMicros[i] = executorStats[i].nBusyMicros;
+    }
+    nLastExecutorStatsTime = nExecutorStatsTime;
+
+    for (const auto& p : scheduler.GetQueueStats()) {
+        std::string strQueue = p.first.empty() ? "other" : p.first;
+        statsClient.gauge("scheduler." + strQueue + ".pending", p.second.nPending, 1.0f);
+        statsClient.gauge("scheduler." + strQueue + ".tasks", p.second.nTasks, 1.0f);
+        statsClient.gauge("scheduler." + strQueue + ".timeUs", p.second.nTotalMicros, 1.0f);
+        statsClient.gauge("scheduler." + strQueue + ".maxTimeUs", p.second.nMaxMicros, 1.0f);
+    }
+
+#if ENABLE_ZMQ
+    if (g_zmq_notification_interface) {
+        size_t nSize;
+        int64_t nLagMicros;
+        uint64_t nDropped;
+        g_zmq_notification_interface->GetQueueStats(nSize, nLagMicros, nDropped);
+        statsClient.gauge("zmq.queue.size", nSize, 1.0f);
+        statsClient.gauge("zmq.queue.lagMs", nLagMicros / 1000, 1.0f);
+        statsClient.gauge("zmq.queue.dropped", nDropped, 1.0f);
+    }
+#endif
+
+    if (g_lock_profile) {
+        PeriodicLockStats();
+    }
 }
 
 /** Sanity checks
@@ -967,6 +1190,20 @@ bool AppInitServers()
 // Parameter interaction based on rules
 void InitParameterInteraction()
 {
+    if (gArgs.IsArgSet("-readonlyreplica")) {
+        // the chain of a replica is the one of the primary, it doesn't download or relay anything
+        if (gArgs.SoftSetArg("-blocksdir", gArgs.GetArg("-readonlyreplica", "")))
+            LogPrintf("%s: parameter interaction: -readonlyreplica set -> setting -blocksdir=%s\n", __func__, gArgs.GetArg("-blocksdir", ""));
+        if (gArgs.SoftSetArg("-connect", "0"))
+            LogPrintf("%s: parameter interaction: -readonlyreplica set -> setting -connect=0\n", __func__);
+        if (gArgs.SoftSetBoolArg("-listen", false))
+            LogPrintf("%s: parameter interaction: -readonlyreplica set -> setting -listen=0\n", __func__);
+        if (gArgs.SoftSetBoolArg("-disablewallet", true))
+            LogPrintf("%s: parameter interaction: -readonlyreplica set -> setting -disablewallet=1\n", __func__);
+        if (gArgs.SoftSetBoolArg("-persistmempool", false))
+            LogPrintf("%s: parameter interaction: -readonlyreplica set -> setting -persistmempool=0\n", __func__);
+    }
+
     // when specifying an explicit binding address, you want to listen on it
     // even when -connect or -proxy is specified
     if (gArgs.IsArgSet("-bind")) {
@@ -1078,6 +1315,7 @@ void InitLogging()
     fLogTimeMicros = gArgs.GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     fLogThreadNames = gArgs.GetBoolArg("-logthreadnames", DEFAULT_LOGTHREADNAMES);
     fLogIPs = gArgs.GetBoolArg("-logips", DEFAULT_LOGIPS);
+    fLogJSON = gArgs.GetBoolArg("-logjson", DEFAULT_LOGJSON);
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     std::string version_string = FormatFullVersion();
@@ -1096,6 +1334,7 @@ int nUserMaxConnections;
 int nFD;
 ServiceFlags nLocalServices = ServiceFlags(NODE_NETWORK | NODE_NETWORK_LIMITED);
 int64_t peer_connect_timeout;
+bool fBlockFilterIndex = false;
 
 } // namespace
 
@@ -1173,10 +1412,38 @@ bool AppInitParameterInteraction()
         return InitError(strprintf(_("Specified blocks directory \"%s\" does not exist."), gArgs.GetArg("-blocksdir", "").c_str()));
     }
 
+    const std::string strBlockFilterIndex = gArgs.GetArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX ? "1" : "0");
+    if (strBlockFilterIndex == "" || strBlockFilterIndex == "1" || strBlockFilterIndex == BlockFilterTypeName(BlockFilterType::BASIC_FILTER)) {
+        fBlockFilterIndex = true;
+    } else if (strBlockFilterIndex != "0") {
+        return InitError(strprintf(_("Unknown -blockfilterindex value %s."), strBlockFilterIndex));
+    }
+
+    for (const std::string& arg : gArgs.GetArgs("-dbtuning")) {
+        CDBTuning tuning;
+        std::string strError;
+        if (!ParseDBTuning(arg, "", tuning, strError)) {
+            return InitError(strError);
+        }
+    }
+    SetDBCompactionThreads(std::max<int>(gArgs.GetArg("-dbcompactionthreads", DEFAULT_DB_COMPACTION_THREADS), 1));
+
+    // Signal NODE_COMPACT_FILTERS if peerblockfilters and basic filters index are both enabled.
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS)) {
+        if (!fBlockFilterIndex) {
+            return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
+        }
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
+    }
+
     // if using block pruning, then disallow txindex and require disabling governance validation
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (fBlockFilterIndex)
+            return InitError(_("Prune mode is incompatible with -blockfilterindex."));
+        if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+            return InitError(_("Prune mode is incompatible with -coinstatsindex."));
         if (!gArgs.GetBoolArg("-disablegovernance", false)) {
             return InitError(_("Prune mode is incompatible with -disablegovernance=false."));
         }
@@ -1275,6 +1542,13 @@ bool AppInitParameterInteraction()
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    g_lock_profile = gArgs.GetBoolArg("-lockprofile", DEFAULT_LOCK_PROFILE);
+    fMapBlockFiles = gArgs.GetBoolArg("-mmapblocks", DEFAULT_MMAP_BLOCKS);
+    {
+        LOCK(cs_main);
+        g_headers_cache.SetEnabled(gArgs.GetBoolArg("-headerscache", DEFAULT_HEADERS_CACHE));
+    }
+    fCompactUndo = gArgs.GetBoolArg("-compactundo", DEFAULT_COMPACT_UNDO);
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
@@ -1321,6 +1595,8 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nCoinsPrefetchBlocks = std::max<int64_t>(0, gArgs.GetArg("-coinsprefetch", DEFAULT_COINS_PREFETCH_BLOCKS));
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1346,6 +1622,22 @@ bool AppInitParameterInteraction()
         fPruneMode = true;
     }
 
+    fReadOnlyReplica = gArgs.IsArgSet("-readonlyreplica");
+    if (fReadOnlyReplica) {
+        if (fPruneMode) {
+            return InitError(_("Pruning can't be used on a read-only replica."));
+        }
+        if (gArgs.GetBoolArg("-reindex", false) || gArgs.GetBoolArg("-reindex-chainstate", false)) {
+            return InitError(_("A read-only replica can't reindex, reindex the primary instead."));
+        }
+        if (gArgs.IsArgSet("-masternodeblsprivkey")) {
+            return InitError(_("A read-only replica can't run a masternode."));
+        }
+        if (gArgs.GetBoolArg("-listen", DEFAULT_LISTEN) || gArgs.GetArgs("-connect") != std::vector<std::string>{"0"}) {
+            return InitError(_("A read-only replica can't connect to the network."));
+        }
+    }
+
     nConnectTimeout = gArgs.GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0) {
         nConnectTimeout = DEFAULT_CONNECT_TIMEOUT;
@@ -1652,6 +1944,13 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string chacha20_algo = ChaCha20AutoDetect();
+    std::string poly1305_algo = Poly1305AutoDetect();
+    LogPrintf("Using the '%s' ChaCha20 and '%s' Poly1305 implementations\n", chacha20_algo, poly1305_algo);
+    std::string siphash_algo = SipHashAutoDetect();
+    LogPrintf("Using the '%s' batch SipHash implementation\n", siphash_algo);
+    std::string aes_algo = AESAutoDetect();
+    LogPrintf("Using the '%s' AES implementation\n", aes_algo);
     RandomInit();
     ECC_Start();
     globalVerifyHandle.reset(new ECCVerifyHandle());
@@ -1696,6 +1995,9 @@ bool AppInitMain()
             return InitError(strprintf("Could not open debug log file %s", GetDebugLogPath().string()));
         }
     }
+    if (gArgs.GetBoolArg("-asynclogging", DEFAULT_ASYNCLOGGING)) {
+        StartAsyncLogging(gArgs.GetBoolArg("-logdroponoverflow", DEFAULT_LOGDROPONOVERFLOW));
+    }
 
     if (!fLogTimestamps)
         LogPrintf("Startup time: %s\n", FormatISO8601DateTime(GetTime()));
@@ -1715,11 +2017,15 @@ bool AppInitMain()
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitBLSSignatureCache();
+
+    InitExecutor(gArgs.GetArg("-executorthreads", DEFAULT_EXECUTOR_THREADS));
+    LogPrintf("Using %d threads for the shared executor\n", GetExecutor().size());
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
-            threadGroup.create_thread(&ThreadScriptCheck);
+        // the master thread does its share, the others run on the executor
+        UseExecutorForScriptChecks(nScriptCheckThreads - 1);
     }
 
     std::vector<std::string> vSporkAddresses;
@@ -1746,11 +2052,24 @@ bool AppInitMain()
         }
     }
 
-    // Start the lightweight task scheduler thread
+    // Start the lightweight task scheduler threads, a slow task only blocks one of them
+    int nSchedulerThreads = std::max(1, std::min<int>(gArgs.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), MAX_SCHEDULER_THREADS));
+    LogPrintf("Using %d threads for the scheduler\n", nSchedulerThreads);
+    scheduler.SetWarnTime(gArgs.GetArg("-schedulerwarnms", DEFAULT_SCHEDULER_WARN_MS));
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    for (int i = 0; i < nSchedulerThreads; i++) {
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    }
+
+    // Start the threads of the validation interface listeners, a slow listener only blocks one of them
+    int nValidationThreads = std::max(1, std::min<int>(gArgs.GetArg("-validationthreads", DEFAULT_VALIDATION_INTERFACE_THREADS), MAX_VALIDATION_INTERFACE_THREADS));
+    LogPrintf("Using %d threads for validation callbacks\n", nValidationThreads);
+    CScheduler::Function validationServiceLoop = boost::bind(&CScheduler::serviceQueue, &validationScheduler);
+    for (int i = 0; i < nValidationThreads; i++) {
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "valqueue", validationServiceLoop));
+    }
 
-    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    GetMainSignals().RegisterBackgroundSignalScheduler(validationScheduler);
     GetMainSignals().RegisterWithMempoolSignals(mempool);
 
     tableRPC.InitPlatformRestrictions();
@@ -1926,6 +2245,13 @@ bool AppInitMain()
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nBlockFilterIndexCache = fBlockFilterIndex ? std::min(nTotalCache / 8, nMaxBlockFilterIndexCache << 20) : 0;
+    nTotalCache -= nBlockFilterIndexCache;
+    int64_t nCoinStatsIndexCache = gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX) ? std::min(nTotalCache / 8, nMaxCoinStatsIndexCache << 20) : 0;
+    nTotalCache -= nCoinStatsIndexCache;
+    int64_t nInstantSendCache = std::max<int64_t>(0, gArgs.GetArg("-iscachesize", llmq::DEFAULT_INSTANTSEND_CACHE_SIZE) << 20);
+    nInstantSendCache = std::min(nInstantSendCache, nTotalCache / 4); // never take more than a quarter of what's left
+    nTotalCache -= nInstantSendCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1934,11 +2260,27 @@ bool AppInitMain()
     int64_t nEvoDbCache = 1024 * 1024 * 16; // TODO
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (fBlockFilterIndex) {
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nBlockFilterIndexCache * (1.0 / 1024 / 1024));
+    }
+    if (nCoinStatsIndexCache) {
+        LogPrintf("* Using %.1fMiB for coin stats index database\n", nCoinStatsIndexCache * (1.0 / 1024 / 1024));
+    }
+    LogPrintf("* Using %.1fMiB for InstantSend caches\n", nInstantSendCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
     int64_t nStart = GetTimeMillis();
+    fStartupProfile = gArgs.GetBoolArg("-startupprofile", DEFAULT_STARTUPPROFILE);
+
+    if (fReadOnlyReplica) {
+        uiInterface.InitMessage(_("Snapshotting the databases of the primary..."));
+        std::string strError;
+        if (!SnapshotReplicaDatabases(strError)) {
+            return InitError(strprintf(_("Unable to snapshot the databases of the primary: %s"), strError));
+        }
+    }
 
     while (!fLoaded && !fRequestShutdown) {
         bool fReset = fReindex;
@@ -1958,15 +2300,32 @@ bool AppInitMain()
                 // new CBlockTreeDB tries to delete the existing file, which
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
-                pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
                 llmq::DestroyLLMQSystem();
                 // Same logic as above with pblocktree
+                deterministicMNManager.reset();
                 evoDb.reset();
+
+                // The block tree database is independent of evodb and the llmq database, so open it
+                // (which includes replaying its LevelDB log) on a separate thread while evodb and the
+                // llmq system, which depends on evodb, are opened here. The future is waited for
+                // before anything touches pblocktree, also when an exception is thrown below.
+                std::future<void> open_blocktree = std::async(std::launch::async, [&] {
+                    RenameThread("dash-loadblktree");
+                    const int64_t start_time = GetTimeMillis();
+                    pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
+                    LogStartupStage("open blocktree db", start_time);
+                });
+
+                int64_t stage_start_time = GetTimeMillis();
                 evoDb.reset(new CEvoDB(nEvoDbCache, false, fReset || fReindexChainState));
-                deterministicMNManager.reset();
                 deterministicMNManager.reset(new CDeterministicMNManager(*evoDb));
+                LogStartupStage("open evodb", stage_start_time);
+
+                stage_start_time = GetTimeMillis();
+                llmq::InitLLMQSystem(*evoDb, nInstantSendCache, false, fReset || fReindexChainState);
+                LogStartupStage("open llmq db", stage_start_time);
 
-                llmq::InitLLMQSystem(*evoDb, false, fReset || fReindexChainState);
+                open_blocktree.get();
 
                 if (fReset) {
                     pblocktree->WriteReindexing(true);
@@ -1982,12 +2341,21 @@ bool AppInitMain()
                 // ever removed a block file from disk.
                 // Note that it also sets fReindex based on the disk flag!
                 // From here on out fReindex and fReset mean something different!
+                stage_start_time = GetTimeMillis();
                 if (!LoadBlockIndex(chainparams)) {
                     strLoadError = _("Error loading block database");
                     break;
                 }
+                LogStartupStage("load block index", stage_start_time);
+
+                // Apply changed -txindex/-addressindex/-timestampindex/-spentindex settings, the indexes are built or
+                // erased in the background
+                g_blocktreeindexbuilder = std::make_unique<BlockTreeIndexBuilder>(1 << 20, false, fReset);
+                if (!g_blocktreeindexbuilder->Configure(strLoadError)) {
+                    break;
+                }
 
-                if (!fDisableGovernance && !fTxIndex
+                if (!fDisableGovernance && !fTxIndex && !g_blocktreeindexbuilder->IsBuilding("txindex")
                    && chainparams.NetworkIDString() != CBaseChainParams::REGTEST) { // TODO remove this when pruning is fixed. See https://github.com/dashpay/dash/pull/1817 and https://github.com/dashpay/dash/pull/1743
                     return InitError(_("Transaction index can't be disabled with governance validation enabled. Either start with -disablegovernance command line switch or enable transaction index."));
                 }
@@ -2001,33 +2369,10 @@ bool AppInitMain()
                 if (!chainparams.GetConsensus().hashDevnetGenesisBlock.IsNull() && !mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus().hashDevnetGenesisBlock) == 0)
                     return InitError(_("Incorrect or no devnet genesis block found. Wrong datadir for devnet specified?"));
 
-                // Check for changed -txindex state
-                if (fTxIndex != gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -txindex");
-                    break;
-                }
-
-                // Check for changed -addressindex state
-                if (fAddressIndex != gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -addressindex");
-                    break;
-                }
-
-                // Check for changed -timestampindex state
-                if (fTimestampIndex != gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -timestampindex");
-                    break;
-                }
-
-                // Check for changed -spentindex state
-                if (fSpentIndex != gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
-                    strLoadError = _("You need to rebuild the database using -reindex to change -spentindex");
-                    break;
-                }
-
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks
-                // in the past, but is now trying to run unpruned.
-                if (fHavePruned && !fPruneMode) {
+                // in the past, but is now trying to run unpruned. Nodes that were started from a UTXO snapshot never had
+                // the blocks before it, they keep all blocks after it when not pruning.
+                if (fHavePruned && !fPruneMode && !fSnapshotChainstate) {
                     strLoadError = _("You need to rebuild the database using -reindex to go back to unpruned mode.  This will redownload the entire blockchain");
                     break;
                 }
@@ -2044,6 +2389,7 @@ bool AppInitMain()
                 // At this point we're either in reindex or we've loaded a useful
                 // block tree into mapBlockIndex!
 
+                stage_start_time = GetTimeMillis();
                 pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
                 pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
 
@@ -2062,6 +2408,7 @@ bool AppInitMain()
 
                 // The on-disk coinsdb is now in a good state, create the cache
                 pcoinsTip.reset(new CCoinsViewCache(pcoinscatcher.get()));
+                LogStartupStage("load chainstate", stage_start_time);
 
                 // flush evodb
                 if (!evoDb->CommitRootTransaction()) {
@@ -2085,10 +2432,12 @@ bool AppInitMain()
                     break;
                 }
 
+                stage_start_time = GetTimeMillis();
                 if (!deterministicMNManager->UpgradeDBIfNeeded() || !llmq::quorumBlockProcessor->UpgradeDB()) {
                     strLoadError = _("Error upgrading evo database");
                     break;
                 }
+                LogStartupStage("upgrade evodb", stage_start_time);
 
                 if (!is_coinsview_empty) {
                     uiInterface.InitMessage(_("Verifying blocks..."));
@@ -2106,11 +2455,13 @@ bool AppInitMain()
                         break;
                     }
 
+                    stage_start_time = GetTimeMillis();
                     if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
                                   gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
                         strLoadError = _("Corrupted block database detected");
                         break;
                     }
+                    LogStartupStage("verify blocks", stage_start_time);
 
                     ResetBlockFailureFlags(nullptr);
                 }
@@ -2120,6 +2471,9 @@ bool AppInitMain()
                 break;
             }
 
+            // Periodic flushes of the chainstate may be finished in the background from now on
+            pcoinsdbview->SetAsyncWrite(gArgs.GetBoolArg("-asynccoinsflush", DEFAULT_ASYNC_COINS_FLUSH));
+
             fLoaded = true;
             LogPrintf(" block index %15dms\n", GetTimeMillis() - load_block_index_start_time);
         } while(false);
@@ -2175,6 +2529,10 @@ bool AppInitMain()
 
     // if pruning, unset the service bit and perform the initial blockstore prune
     // after any wallet rescanning has taken place.
+    if (fSnapshotChainstate && !fPruneMode) {
+        LogPrintf("Unsetting NODE_NETWORK, the chainstate was loaded from a UTXO snapshot\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+    }
     if (fPruneMode) {
         LogPrintf("Unsetting NODE_NETWORK on prune mode\n");
         nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
@@ -2258,9 +2616,20 @@ bool AppInitMain()
     strDBName = "governance.dat";
     uiInterface.InitMessage(_("Loading governance cache..."));
     CFlatDB<CGovernanceManager> flatdb3(strDBName, "magicGovernanceCache");
+    if (!fDisableGovernance) {
+        governanceDb.reset(new CGovernanceDb(8 << 20, false, !fLoadCacheFiles));
+    }
     if (fLoadCacheFiles && !fDisableGovernance) {
-        if(!flatdb3.Load(governance)) {
-            return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
+        if (governanceDb->HasData()) {
+            if (!governance.LoadFromDb()) {
+                return InitError(_("Failed to load governance database from") + "\n" + (GetDataDir() / "governance").string());
+            }
+        } else {
+            // First start with the database, or an import of governance.dat after it was removed
+            if(!flatdb3.Load(governance)) {
+                return InitError(_("Failed to load governance cache from") + "\n" + (pathDB / strDBName).string());
+            }
+            governance.WriteToDb();
         }
         governance.InitOnLoad();
     } else {
@@ -2284,23 +2653,35 @@ bool AppInitMain()
         }
     }
 
+    // The global singletons, the LLMQ and evo managers register themselves when they are created
+    g_memory_accounting.Register("mempool", &mempool, []() { return mempool.DynamicMemoryUsage(); });
+    g_memory_accounting.Register("governance", &governance, []() { return governance.DynamicMemoryUsage(); });
+    g_memory_accounting.Register("coinjoin", nullptr, []() { return CCoinJoin::DynamicMemoryUsage(); });
+
     // ********************************************************* Step 10c: schedule Dash-specific tasks
 
-    scheduler.scheduleEvery(std::bind(&CNetFulfilledRequestManager::DoMaintenance, std::ref(netfulfilledman)), 60 * 1000);
-    scheduler.scheduleEvery(std::bind(&CMasternodeSync::DoMaintenance, std::ref(masternodeSync), std::ref(*g_connman)), 1 * 1000);
-    scheduler.scheduleEvery(std::bind(&CMasternodeUtils::DoMaintenance, std::ref(*g_connman)), 1 * 1000);
+    // Each task has a queue of its own, so a slow one (e.g. governance maintenance) doesn't delay the others
+    scheduler.scheduleEvery(std::bind(&CNetFulfilledRequestManager::DoMaintenance, std::ref(netfulfilledman)), 60 * 1000, "netfulfilled");
+    scheduler.scheduleEvery(std::bind(&CMasternodeSync::DoMaintenance, std::ref(masternodeSync), std::ref(*g_connman)), 1 * 1000, "mnsync");
+    scheduler.scheduleEvery(std::bind(&CMasternodeUtils::DoMaintenance, std::ref(*g_connman)), 1 * 1000, "mnutils");
 
     if (!fDisableGovernance) {
-        scheduler.scheduleEvery(std::bind(&CGovernanceManager::DoMaintenance, std::ref(governance), std::ref(*g_connman)), 60 * 5 * 1000);
+        scheduler.scheduleEvery(std::bind(&CGovernanceManager::DoMaintenance, std::ref(governance), std::ref(*g_connman)), 60 * 5 * 1000, "governance");
     }
 
     if (fMasternodeMode) {
-        scheduler.scheduleEvery(std::bind(&CCoinJoinServer::DoMaintenance, std::ref(coinJoinServer), std::ref(*g_connman)), 1 * 1000);
+        scheduler.scheduleEvery(std::bind(&CCoinJoinServer::DoMaintenance, std::ref(coinJoinServer), std::ref(*g_connman)), 1 * 1000, "coinjoin");
     }
 
     if (gArgs.GetBoolArg("-statsenabled", DEFAULT_STATSD_ENABLE)) {
         int nStatsPeriod = std::min(std::max((int)gArgs.GetArg("-statsperiod", DEFAULT_STATSD_PERIOD), MIN_STATSD_PERIOD), MAX_STATSD_PERIOD);
-        scheduler.scheduleEvery(PeriodicStats, nStatsPeriod * 1000);
+        scheduler.scheduleEvery(PeriodicStats, nStatsPeriod * 1000, "stats");
+    }
+
+    int64_t nMempoolSnapshotInterval = gArgs.GetArg("-mempoolsnapshotinterval", DEFAULT_MEMPOOL_SNAPSHOT_INTERVAL);
+    if (nMempoolSnapshotInterval > 0) {
+        mempool.UpdateSnapshot();
+        scheduler.scheduleEvery(std::bind(&CTxMemPool::UpdateSnapshot, std::ref(mempool)), nMempoolSnapshotInterval, "mempoolsnapshot");
     }
 
     llmq::StartLLMQSystem();
@@ -2321,11 +2702,42 @@ bool AppInitMain()
     if (gArgs.IsArgSet("-blocknotify"))
         uiInterface.NotifyBlockTip.connect(BlockNotifyCallback);
 
+    if (gArgs.IsArgSet("-blocktimingslog")) {
+        fs::path pathBlockTimings = AbsPathForConfigVal(fs::path(gArgs.GetArg("-blocktimingslog", "")));
+        if (!OpenBlockTimingsLog(pathBlockTimings)) {
+            return InitError(strprintf(_("Unable to open %s for writing"), pathBlockTimings.string()));
+        }
+    }
+
     std::vector<fs::path> vImportFiles;
     for (const std::string& strFile : gArgs.GetArgs("-loadblock")) {
         vImportFiles.push_back(strFile);
     }
 
+    if (nCoinsPrefetchBlocks > 0) {
+        threadGroup.create_thread(&ThreadCoinsPrefetch);
+    }
+    // Keep fee estimator updates off the block connection path
+    threadGroup.create_thread(boost::bind(&CBlockPolicyEstimator::ThreadMain, &::feeEstimator));
+    if (gArgs.GetBoolArg("-blocktemplateprecompute", DEFAULT_BLOCKTEMPLATE_PRECOMPUTE)) {
+        g_block_template_cache.reset(new CBlockTemplateCache());
+        RegisterValidationInterface(g_block_template_cache.get());
+        threadGroup.create_thread(boost::bind(&CBlockTemplateCache::ThreadMain, g_block_template_cache.get()));
+    }
+    if (fBlockFilterIndex) {
+        // Catches up with the chain in the background, wiped when the whole block index is rebuilt
+        g_blockfilterindex = std::make_unique<BlockFilterIndex>(BlockFilterType::BASIC_FILTER, nBlockFilterIndexCache, false, fReindex);
+        RegisterValidationInterface(g_blockfilterindex.get());
+        threadGroup.create_thread(boost::bind(&BlockFilterIndex::ThreadMain, g_blockfilterindex.get()));
+    }
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coinstatsindex = std::make_unique<CoinStatsIndex>(nCoinStatsIndexCache, false, fReindex);
+        RegisterValidationInterface(g_coinstatsindex.get());
+        threadGroup.create_thread(boost::bind(&CoinStatsIndex::ThreadMain, g_coinstatsindex.get()));
+    }
+    if (g_blocktreeindexbuilder->HasPendingWork()) {
+        threadGroup.create_thread(boost::bind(&BlockTreeIndexBuilder::ThreadBuild, g_blocktreeindexbuilder.get()));
+    }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
 
     // Wait for genesis block to be processed
@@ -2441,6 +2853,20 @@ bool AppInitMain()
         return InitError(strprintf(_("Invalid -socketevents ('%s') specified. Only these modes are supported: %s"), strSocketEventsMode, GetSupportedSocketEventsStr()));
     }
 
+    connOptions.nMsgHandlerThreads = gArgs.GetArg("-msghandlerthreads", DEFAULT_MSG_HANDLER_THREADS);
+    if (connOptions.nMsgHandlerThreads < 1 || connOptions.nMsgHandlerThreads > MAX_MSG_HANDLER_THREADS) {
+        return InitError(strprintf(_("Invalid -msghandlerthreads (%d), must be between 1 and %d"), connOptions.nMsgHandlerThreads, MAX_MSG_HANDLER_THREADS));
+    }
+
+    connOptions.nMaxConnectAttempts = gArgs.GetArg("-maxconnectattempts", DEFAULT_MAX_CONNECT_ATTEMPTS);
+    if (connOptions.nMaxConnectAttempts < 1 || connOptions.nMaxConnectAttempts > MAX_CONNECT_ATTEMPTS_LIMIT) {
+        return InitError(strprintf(_("Invalid -maxconnectattempts (%d), must be between 1 and %d"), connOptions.nMaxConnectAttempts, MAX_CONNECT_ATTEMPTS_LIMIT));
+    }
+
+    if (!fDisableGovernance) {
+        governance.StartWorkerThread(connman);
+    }
+
     if (!connman.Start(scheduler, connOptions)) {
         return false;
     }
@@ -2450,6 +2876,13 @@ bool AppInitMain()
     SetRPCWarmupFinished();
     uiInterface.InitMessage(_("Done loading"));
 
+    // Verify the older blocks without keeping the node from starting, the reindex rewrites them anyway
+    int nBackgroundCheckBlocks = gArgs.GetArg("-backgroundcheckblocks", DEFAULT_BACKGROUND_CHECKBLOCKS);
+    if (nBackgroundCheckBlocks != 0 && !fReindex && !fReindexChainState) {
+        StartBackgroundVerifyDB(chainparams, gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
+                                gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS), nBackgroundCheckBlocks);
+    }
+
     g_wallet_init_interface.Start(scheduler);
 
     return true;
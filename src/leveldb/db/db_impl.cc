@@ -1334,10 +1334,13 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // individual write by 1ms to reduce latency variance.  Also,
       // this delay hands over some CPU to the compaction thread in
       // case it is sharing the same core as the writer.
+      const uint64_t start = env_->NowMicros();
       mutex_.Unlock();
       env_->SleepForMicroseconds(1000);
       allow_delay = false;  // Do not delay a single write more than once
       mutex_.Lock();
+      write_stalls_.slowdowns++;
+      write_stalls_.micros += env_->NowMicros() - start;
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
@@ -1346,11 +1349,17 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // We have filled up the current memtable, but the previous
       // one is still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
+      const uint64_t start = env_->NowMicros();
       bg_cv_.Wait();
+      write_stalls_.memtable_waits++;
+      write_stalls_.micros += env_->NowMicros() - start;
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
+      const uint64_t start = env_->NowMicros();
       bg_cv_.Wait();
+      write_stalls_.l0_waits++;
+      write_stalls_.micros += env_->NowMicros() - start;
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1424,6 +1433,15 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
       }
     }
     return true;
+  } else if (in == "write-stalls") {
+    char buf[100];
+    snprintf(buf, sizeof(buf), "%llu %llu %llu %llu",
+             static_cast<unsigned long long>(write_stalls_.slowdowns),
+             static_cast<unsigned long long>(write_stalls_.memtable_waits),
+             static_cast<unsigned long long>(write_stalls_.l0_waits),
+             static_cast<unsigned long long>(write_stalls_.micros));
+    *value = buf;
+    return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
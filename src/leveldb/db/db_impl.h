@@ -190,6 +190,19 @@ class DBImpl : public DB {
   };
   CompactionStats stats_[config::kNumLevels];
 
+  // Writes delayed by MakeRoomForWrite(), by cause, and the total time
+  // spent delayed.
+  struct WriteStallStats {
+    uint64_t slowdowns;         // 1ms delays near the L0 slowdown trigger
+    uint64_t memtable_waits;    // waits for the immutable memtable compaction
+    uint64_t l0_waits;          // waits at the L0 stop trigger
+    uint64_t micros;
+
+    WriteStallStats()
+        : slowdowns(0), memtable_waits(0), l0_waits(0), micros(0) { }
+  };
+  WriteStallStats write_stalls_;
+
   // No copying allowed
   DBImpl(const DBImpl&);
   void operator=(const DBImpl&);
@@ -117,6 +117,10 @@ class DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.write-stalls" - returns the number of writes delayed by the L0
+  //     slowdown trigger, delayed waiting for a memtable compaction and
+  //     delayed at the L0 stop trigger, followed by the total number of
+  //     microseconds spent delayed, separated by spaces.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
@@ -140,6 +140,13 @@ class Env {
       void (*function)(void* arg),
       void* arg) = 0;
 
+  // Allow up to "n" background threads to run the functions passed to
+  // Schedule().  With more than one thread, work items scheduled by
+  // different DBs sharing this Env no longer wait on each other.
+  // The default implementation ignores the request and keeps whatever
+  // threading the Env uses.
+  virtual void SetBackgroundThreads(int n) { }
+
   // Start a new thread, invoking "function(arg)" within the new thread.
   // When "function(arg)" returns, the thread will be destroyed.
   virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -336,6 +343,9 @@ class EnvWrapper : public Env {
   void Schedule(void (*f)(void*), void* a) {
     return target_->Schedule(f, a);
   }
+  void SetBackgroundThreads(int n) {
+    return target_->SetBackgroundThreads(n);
+  }
   void StartThread(void (*f)(void*), void* a) {
     return target_->StartThread(f, a);
   }
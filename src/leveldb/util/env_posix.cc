@@ -17,9 +17,11 @@
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
+#include <algorithm>
 #include <deque>
 #include <limits>
 #include <set>
+#include <vector>
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
 #include "port/port.h"
@@ -506,6 +508,8 @@ class PosixEnv : public Env {
 
   virtual void Schedule(void (*function)(void*), void* arg);
 
+  virtual void SetBackgroundThreads(int n);
+
   virtual void StartThread(void (*function)(void* arg), void* arg);
 
   virtual Status GetTestDirectory(std::string* result) {
@@ -567,8 +571,10 @@ class PosixEnv : public Env {
 
   pthread_mutex_t mu_;
   pthread_cond_t bgsignal_;
-  pthread_t bgthread_;
-  bool started_bgthread_;
+  std::vector<pthread_t> bgthreads_;
+  int max_bgthreads_;
+  // Number of background threads waiting for work
+  size_t idle_bgthreads_;
 
   // Entry per Schedule() call
   struct BGItem { void* arg; void (*function)(void*); };
@@ -609,7 +615,8 @@ static intptr_t MaxOpenFiles() {
 }
 
 PosixEnv::PosixEnv()
-    : started_bgthread_(false),
+    : max_bgthreads_(1),
+      idle_bgthreads_(0),
       mmap_limit_(MaxMmaps()),
       fd_limit_(MaxOpenFiles()) {
   PthreadCall("mutex_init", pthread_mutex_init(&mu_, NULL));
@@ -619,19 +626,22 @@ PosixEnv::PosixEnv()
 void PosixEnv::Schedule(void (*function)(void*), void* arg) {
   PthreadCall("lock", pthread_mutex_lock(&mu_));
 
-  // Start background thread if necessary
-  if (!started_bgthread_) {
-    started_bgthread_ = true;
+  // Start another background thread if none is left to pick up this item.
+  // Each Schedule() call adds at most one thread, so the pool only grows as
+  // far as the concurrent work requires.
+  if (static_cast<int>(bgthreads_.size()) < max_bgthreads_ &&
+      idle_bgthreads_ <= queue_.size()) {
+    pthread_t t;
     PthreadCall(
         "create thread",
-        pthread_create(&bgthread_, NULL,  &PosixEnv::BGThreadWrapper, this));
+        pthread_create(&t, NULL,  &PosixEnv::BGThreadWrapper, this));
+    bgthreads_.push_back(t);
   }
 
-  // If the queue is currently empty, the background thread may currently be
-  // waiting.
-  if (queue_.empty()) {
-    PthreadCall("signal", pthread_cond_signal(&bgsignal_));
-  }
+  // Wake up one of the background threads which may currently be waiting.
+  // With several threads the queue may be non-empty while some are idle,
+  // so always signal.
+  PthreadCall("signal", pthread_cond_signal(&bgsignal_));
 
   // Add to priority queue
   queue_.push_back(BGItem());
@@ -641,12 +651,21 @@ void PosixEnv::Schedule(void (*function)(void*), void* arg) {
   PthreadCall("unlock", pthread_mutex_unlock(&mu_));
 }
 
+void PosixEnv::SetBackgroundThreads(int n) {
+  PthreadCall("lock", pthread_mutex_lock(&mu_));
+  // Threads which were already started keep running
+  max_bgthreads_ = std::max(n, 1);
+  PthreadCall("unlock", pthread_mutex_unlock(&mu_));
+}
+
 void PosixEnv::BGThread() {
   while (true) {
     // Wait until there is an item that is ready to run
     PthreadCall("lock", pthread_mutex_lock(&mu_));
     while (queue_.empty()) {
+      idle_bgthreads_++;
       PthreadCall("wait", pthread_cond_wait(&bgsignal_, &mu_));
+      idle_bgthreads_--;
     }
 
     void (*function)(void*) = queue_.front().function;
@@ -66,6 +66,10 @@ public:
     {
         map.erase(k);
     }
+    void clear()
+    {
+        map.clear();
+    }
     void update(const_iterator itIn, const mapped_type& v)
     {
         // Using map::erase() with empty range instead of map::find() to get a non-const iterator,
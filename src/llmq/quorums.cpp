@@ -12,6 +12,7 @@
 
 #include <masternode/activemasternode.h>
 #include <chainparams.h>
+#include <memaccounting.h>
 #include <masternode/masternode-sync.h>
 #include <net.h>
 #include <net_processing.h>
@@ -26,6 +27,10 @@ namespace llmq
 
 static const std::string DB_QUORUM_SK_SHARE = "q_Qsk";
 static const std::string DB_QUORUM_QUORUM_VVEC = "q_Qqvvec";
+static const std::string DB_QUORUM_PUBKEY_SHARES = "q_Qpks";
+
+// The number of members which are asked for the data of a quorum at the same time
+static const size_t QUORUM_DATA_RECOVERY_PARALLEL_REQUESTS = 3;
 
 CQuorumManager* quorumManager;
 
@@ -100,6 +105,15 @@ CBLSPublicKey CQuorum::GetPubKeyShare(size_t memberIdx) const
     if (quorumVvec == nullptr || memberIdx >= members.size() || !qc.validMembers[memberIdx]) {
         return CBLSPublicKey();
     }
+    if (fPubKeySharesTable.load(std::memory_order_acquire)) {
+        return vecPubKeySharesTable[memberIdx];
+    }
+    if (memberIdx < vecStoredPubKeyShares.size()) {
+        const CBLSPublicKey& pubKeyShare = vecStoredPubKeyShares[memberIdx].Get();
+        if (pubKeyShare.IsValid()) {
+            return pubKeyShare;
+        }
+    }
     auto& m = members[memberIdx];
     return blsCache.BuildPubKeyShare(m->proTxHash, quorumVvec, CBLSId(m->proTxHash));
 }
@@ -149,6 +163,70 @@ bool CQuorum::ReadContributions(CEvoDB& evoDb)
     return true;
 }
 
+void CQuorum::WritePubKeyShares(CEvoDB& evoDb) const
+{
+    if (quorumVvec == nullptr) {
+        return;
+    }
+
+    std::vector<CBLSPublicKey> pubKeyShares;
+    pubKeyShares.reserve(members.size());
+    for (size_t i = 0; i < members.size(); i++) {
+        // invalid members get an invalid (all-zero) key
+        pubKeyShares.emplace_back(GetPubKeyShare(i));
+    }
+    // The vvec hash is stored with the shares, so that shares which were computed from another vvec are never used
+    evoDb.GetRawDB().Write(std::make_pair(DB_QUORUM_PUBKEY_SHARES, MakeQuorumKey(*this)), std::make_pair(qc.quorumVvecHash, pubKeyShares));
+}
+
+void CQuorum::BuildPubKeySharesTable() const
+{
+    std::unique_lock<std::mutex> l(cs_pubKeySharesTable);
+    if (fPubKeySharesTable) {
+        return;
+    }
+    std::vector<CBLSPublicKey> pubKeyShares;
+    pubKeyShares.reserve(members.size());
+    for (size_t i = 0; i < members.size(); i++) {
+        pubKeyShares.emplace_back(GetPubKeyShare(i));
+    }
+    vecPubKeySharesTable = std::move(pubKeyShares);
+    fPubKeySharesTable.store(true, std::memory_order_release);
+}
+
+bool CQuorum::ReadPubKeyShares(CEvoDB& evoDb)
+{
+    std::pair<uint256, std::vector<CBLSLazyPublicKey>> stored;
+    if (!evoDb.Read(std::make_pair(DB_QUORUM_PUBKEY_SHARES, MakeQuorumKey(*this)), stored)) {
+        return false;
+    }
+    if (stored.first != qc.quorumVvecHash || stored.second.size() != members.size()) {
+        return false;
+    }
+    vecStoredPubKeyShares = std::move(stored.second);
+    return true;
+}
+
+bool CQuorum::HasStoredPubKeyShares() const
+{
+    return !vecStoredPubKeyShares.empty();
+}
+
+size_t CQuorum::DynamicMemoryUsage() const
+{
+    size_t ret = memusage::DynamicUsage(members) + memusage::DynamicUsage(qc.signers) + memusage::DynamicUsage(qc.validMembers);
+    if (quorumVvec) {
+        ret += memusage::DynamicUsage(quorumVvec) + memusage::DynamicUsage(*quorumVvec);
+    }
+    ret += memusage::DynamicUsage(vecStoredPubKeyShares);
+    {
+        std::unique_lock<std::mutex> l(cs_pubKeySharesTable);
+        ret += memusage::DynamicUsage(vecPubKeySharesTable);
+    }
+    ret += blsCache.DynamicMemoryUsage();
+    return ret;
+}
+
 CQuorumManager::CQuorumManager(CEvoDB& _evoDb, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager) :
     evoDb(_evoDb),
     blsWorker(_blsWorker),
@@ -157,13 +235,33 @@ CQuorumManager::CQuorumManager(CEvoDB& _evoDb, CBLSWorker& _blsWorker, CDKGSessi
     CLLMQUtils::InitQuorumsCache(mapQuorumsCache);
     CLLMQUtils::InitQuorumsCache(scanQuorumsCache);
     quorumThreadInterrupt.reset();
+    g_memory_accounting.Register("quorums", this, [this]() { return DynamicMemoryUsage(); });
 }
 
 CQuorumManager::~CQuorumManager()
 {
+    g_memory_accounting.Unregister("quorums", this);
     Stop();
 }
 
+size_t CQuorumManager::DynamicMemoryUsage() const
+{
+    LOCK(quorumsCacheCs);
+    size_t ret = 0;
+    for (const auto& p : mapQuorumsCache) {
+        ret += p.second.DynamicMemoryUsage([](const CQuorumPtr& quorum) {
+            return memusage::DynamicUsage(quorum) + quorum->DynamicMemoryUsage();
+        });
+    }
+    // the scanned quorums are shared with mapQuorumsCache
+    for (const auto& p : scanQuorumsCache) {
+        ret += p.second.DynamicMemoryUsage([](const std::vector<CQuorumCPtr>& vecQuorums) {
+            return memusage::DynamicUsage(vecQuorums);
+        });
+    }
+    return ret;
+}
+
 void CQuorumManager::Start()
 {
     int workerCount = std::thread::hardware_concurrency() / 2;
@@ -236,6 +334,11 @@ void CQuorumManager::TriggerQuorumDataRecoveryThreads(const CBlockIndex* pIndex)
 
 void CQuorumManager::UpdatedBlockTip(const CBlockIndex* pindexNew, bool fInitialDownload) const
 {
+    if (!fInitialDownload) {
+        // have all active quorums ready before signing sessions or InstantSend/ChainLocks verification need them
+        StartActiveQuorumsBuilder(pindexNew);
+    }
+
     if (!masternodeSync.IsBlockchainSynced()) {
         return;
     }
@@ -287,7 +390,6 @@ void CQuorumManager::EnsureQuorumConnections(Consensus::LLMQType llmqType, const
 
 CQuorumPtr CQuorumManager::BuildQuorumFromCommitment(const Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum) const
 {
-    AssertLockHeld(quorumsCacheCs);
     assert(pindexQuorum);
 
     CFinalCommitment qc;
@@ -303,27 +405,17 @@ CQuorumPtr CQuorumManager::BuildQuorumFromCommitment(const Consensus::LLMQType l
 
     quorum->Init(qc, pindexQuorum, minedBlockHash, members);
 
-    bool hasValidVvec = false;
     if (quorum->ReadContributions(evoDb)) {
-        hasValidVvec = true;
+        // only reads the serialized keys, they are deserialized one by one when first needed
+        quorum->ReadPubKeyShares(evoDb);
     } else {
         if (BuildQuorumContributions(qc, quorum)) {
             quorum->WriteContributions(evoDb);
-            hasValidVvec = true;
         } else {
             LogPrint(BCLog::LLMQ, "CQuorumManager::%s -- quorum.ReadContributions and BuildQuorumContributions for block %s failed\n", __func__, qc.quorumHash.ToString());
         }
     }
 
-    if (hasValidVvec) {
-        // pre-populate caches in the background
-        // recovering public key shares is quite expensive and would result in serious lags for the first few signing
-        // sessions if the shares would be calculated on-demand
-        StartCachePopulatorThread(quorum);
-    }
-
-    mapQuorumsCache[llmqType].insert(quorumHash, quorum);
-
     return quorum;
 }
 
@@ -496,13 +588,81 @@ CQuorumCPtr CQuorumManager::GetQuorum(Consensus::LLMQType llmqType, const CBlock
         return nullptr;
     }
 
-    LOCK(quorumsCacheCs);
-    CQuorumPtr pQuorum;
-    if (mapQuorumsCache[llmqType].get(quorumHash, pQuorum)) {
-        return pQuorum;
+    {
+        LOCK(quorumsCacheCs);
+        CQuorumPtr pQuorum;
+        if (mapQuorumsCache[llmqType].get(quorumHash, pQuorum)) {
+            return pQuorum;
+        }
+    }
+
+    // Build it without holding quorumsCacheCs, so that multiple quorums can be built at the same time
+    CQuorumPtr pQuorum = BuildQuorumFromCommitment(llmqType, pindexQuorum);
+    if (pQuorum == nullptr) {
+        return nullptr;
     }
 
-    return BuildQuorumFromCommitment(llmqType, pindexQuorum);
+    {
+        LOCK(quorumsCacheCs);
+        CQuorumPtr pExisting;
+        if (mapQuorumsCache[llmqType].get(quorumHash, pExisting)) {
+            // some other thread built the same quorum in the meantime
+            return pExisting;
+        }
+        mapQuorumsCache[llmqType].insert(quorumHash, pQuorum);
+    }
+
+    if (pQuorum->quorumVvec != nullptr) {
+        // pre-populate caches in the background
+        // recovering public key shares is quite expensive and would result in serious lags for the first few signing
+        // sessions if the shares would be calculated on-demand. If they were stored by a previous run, this only
+        // decodes them
+        StartCachePopulatorThread(pQuorum);
+    }
+
+    return pQuorum;
+}
+
+void CQuorumManager::StartActiveQuorumsBuilder(const CBlockIndex* pindex) const
+{
+    if (fActiveQuorumsBuilderRunning.exchange(true)) {
+        // the tip moves on faster than quorums can be built, the next block will catch up
+        return;
+    }
+
+    std::vector<std::pair<Consensus::LLMQType, const CBlockIndex*>> vecToBuild;
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        // the quorums used for signing, plus the one which is about to become inactive
+        for (const auto* pindexQuorum : quorumBlockProcessor->GetMinedCommitmentsUntilBlock(p.first, pindex, p.second.signingActiveQuorumCount + 1)) {
+            LOCK(quorumsCacheCs);
+            if (!mapQuorumsCache[p.first].exists(pindexQuorum->GetBlockHash())) {
+                vecToBuild.emplace_back(p.first, pindexQuorum);
+            }
+        }
+    }
+
+    if (vecToBuild.empty()) {
+        fActiveQuorumsBuilderRunning = false;
+        return;
+    }
+
+    LogPrint(BCLog::LLMQ, "CQuorumManager::%s -- building %d quorums\n", __func__, vecToBuild.size());
+
+    // Build one quorum per job, so that quorums of all types are built in parallel. The last job to finish resets
+    // the running flag
+    auto remaining = std::make_shared<std::atomic<size_t>>(vecToBuild.size());
+    auto t = std::make_shared<cxxtimer::Timer>(true);
+    for (const auto& p : vecToBuild) {
+        workerPool.push([this, p, remaining, t](int threadId) {
+            if (!quorumThreadInterrupt) {
+                GetQuorum(p.first, p.second);
+            }
+            if (--(*remaining) == 0) {
+                LogPrint(BCLog::LLMQ, "CQuorumManager::StartActiveQuorumsBuilder -- done. time=%d\n", t->count());
+                fActiveQuorumsBuilderRunning = false;
+            }
+        });
+    }
 }
 
 size_t CQuorumManager::GetQuorumRecoveryStartOffset(const CQuorumCPtr pQuorum, const CBlockIndex* pIndex) const
@@ -524,6 +684,25 @@ size_t CQuorumManager::GetQuorumRecoveryStartOffset(const CQuorumCPtr pQuorum, c
     return nIndex % pQuorum->qc.validMembers.size();
 }
 
+// The requests to other members for data of the quorum which is available now don't need to be processed anymore
+static void CancelQuorumDataRequests(const CQuorumCPtr& pQuorum)
+{
+    LOCK(cs_data_requests);
+    for (auto& p : mapQuorumDataRequests) {
+        auto& request = p.second;
+        if (!p.first.second || request.IsProcessed() || request.GetLLMQType() != pQuorum->params.type || request.GetQuorumHash() != pQuorum->qc.quorumHash) {
+            continue;
+        }
+        if ((request.GetDataMask() & CQuorumDataRequest::QUORUM_VERIFICATION_VECTOR) && pQuorum->quorumVvec == nullptr) {
+            continue;
+        }
+        if ((request.GetDataMask() & CQuorumDataRequest::ENCRYPTED_CONTRIBUTIONS) && !pQuorum->skShare.IsValid()) {
+            continue;
+        }
+        request.SetCancelled();
+    }
+}
+
 void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand, CDataStream& vRecv)
 {
     auto strFunc = __func__;
@@ -647,6 +826,10 @@ void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand,
                 return;
             }
             it->second.SetProcessed();
+            if (it->second.IsCancelled()) {
+                errorHandler("Cancelled", 0); // Don't bump score because we asked for it
+                return;
+            }
         }
 
         if (request.GetError() != CQuorumDataRequest::Errors::NONE) {
@@ -694,10 +877,9 @@ void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand,
             std::vector<CBLSIESEncryptedObject<CBLSSecretKey>> vecEncrypted;
             vRecv >> vecEncrypted;
 
-            BLSSecretKeyVector vecSecretKeys;
-            vecSecretKeys.resize(vecEncrypted.size());
-            for (size_t i = 0; i < vecEncrypted.size(); ++i) {
-                if (!vecEncrypted[i].Decrypt(memberIdx, *activeMasternodeInfo.blsKeyOperator, vecSecretKeys[i], PROTOCOL_VERSION)) {
+            BLSSecretKeyVector vecSecretKeys = blsWorker.DecryptContributionShares(vecEncrypted, memberIdx, *activeMasternodeInfo.blsKeyOperator);
+            for (const auto& sk : vecSecretKeys) {
+                if (!sk.IsValid()) {
                     errorHandler("Failed to decrypt");
                     return;
                 }
@@ -710,6 +892,7 @@ void CQuorumManager::ProcessMessage(CNode* pFrom, const std::string& strCommand,
             }
         }
         pQuorum->WriteContributions(evoDb);
+        CancelQuorumDataRequests(pQuorum);
         return;
     }
 }
@@ -725,11 +908,19 @@ void CQuorumManager::StartCachePopulatorThread(const CQuorumCPtr pQuorum) const
 
     // when then later some other thread tries to get keys, it will be much faster
     workerPool.push([pQuorum, t, this](int threadId) {
-        for (size_t i = 0; i < pQuorum->members.size() && !quorumThreadInterrupt; i++) {
+        size_t i = 0;
+        for (; i < pQuorum->members.size() && !quorumThreadInterrupt; i++) {
             if (pQuorum->qc.validMembers[i]) {
                 pQuorum->GetPubKeyShare(i);
             }
         }
+        if (i == pQuorum->members.size()) {
+            // all shares are cached now, so this is cheap
+            if (!pQuorum->HasStoredPubKeyShares()) {
+                pQuorum->WritePubKeyShares(evoDb);
+            }
+            pQuorum->BuildPubKeySharesTable();
+        }
         LogPrint(BCLog::LLMQ, "CQuorumManager::StartCachePopulatorThread -- done. time=%d\n", t.count());
     });
 }
@@ -745,16 +936,23 @@ void CQuorumManager::StartQuorumDataRecoveryThread(const CQuorumCPtr pQuorum, co
     workerPool.push([pQuorum, pIndex, nDataMaskIn, this](int threadId) {
         size_t nTries{0};
         uint16_t nDataMask{nDataMaskIn};
-        int64_t nTimeLastSuccess{0};
-        uint256* pCurrentMemberHash{nullptr};
         std::vector<uint256> vecMemberHashes;
         const size_t nMyStartOffset{GetQuorumRecoveryStartOffset(pQuorum, pIndex)};
         const int64_t nRequestTimeout{10};
 
-        auto printLog = [&](const std::string& strMessage) {
-            const std::string strMember{pCurrentMemberHash == nullptr ? "nullptr" : pCurrentMemberHash->ToString()};
-            LogPrint(BCLog::LLMQ, "CQuorumManager::StartQuorumDataRecoveryThread -- %s - for llmqType %d, quorumHash %s, nDataMask (%d/%d), pCurrentMemberHash %s, nTries %d\n",
-                strMessage, pQuorum->qc.llmqType, pQuorum->qc.quorumHash.ToString(), nDataMask, nDataMaskIn, strMember, nTries);
+        // The members which are asked at the same time, with the time they were connected to or asked at
+        struct RecoveryAttempt
+        {
+            uint256 proTxHash;
+            int64_t nTime;
+            bool fRequested{false};
+        };
+        std::vector<RecoveryAttempt> vecAttempts;
+
+        auto printLog = [&](const std::string& strMessage, const uint256* pMemberHash = nullptr) {
+            const std::string strMember{pMemberHash == nullptr ? "nullptr" : pMemberHash->ToString()};
+            LogPrint(BCLog::LLMQ, "CQuorumManager::StartQuorumDataRecoveryThread -- %s - for llmqType %d, quorumHash %s, nDataMask (%d/%d), pMemberHash %s, nTries %d, nAttempts %d\n",
+                strMessage, pQuorum->qc.llmqType, pQuorum->qc.quorumHash.ToString(), nDataMask, nDataMaskIn, strMember, nTries, vecAttempts.size());
         };
         printLog("Start");
 
@@ -794,58 +992,88 @@ void CQuorumManager::StartQuorumDataRecoveryThread(const CQuorumCPtr pQuorum, co
                 break;
             }
 
-            if ((GetAdjustedTime() - nTimeLastSuccess) > nRequestTimeout) {
-                if (nTries >= vecMemberHashes.size()) {
-                    printLog("All tried but failed");
-                    break;
+            // Give up on the members which didn't connect or answer in time, the next ones are asked instead
+            for (auto it = vecAttempts.begin(); it != vecAttempts.end();) {
+                if ((GetAdjustedTime() - it->nTime) > nRequestTimeout) {
+                    printLog("Timeout", &it->proTxHash);
+                    it = vecAttempts.erase(it);
+                } else {
+                    ++it;
                 }
+            }
+
+            bool fSlept{false};
+            while (vecAttempts.size() < QUORUM_DATA_RECOVERY_PARALLEL_REQUESTS && nTries < vecMemberHashes.size() && !quorumThreadInterrupt) {
                 // Access the member list of the quorum with the calculated offset applied to balance the load equally
-                pCurrentMemberHash = &vecMemberHashes[(nMyStartOffset + nTries++) % vecMemberHashes.size()];
+                const uint256& proTxHash = vecMemberHashes[(nMyStartOffset + nTries++) % vecMemberHashes.size()];
                 {
                     LOCK(cs_data_requests);
-                    auto it = mapQuorumDataRequests.find(std::make_pair(*pCurrentMemberHash, true));
+                    auto it = mapQuorumDataRequests.find(std::make_pair(proTxHash, true));
                     if (it != mapQuorumDataRequests.end() && !it->second.IsExpired()) {
-                        printLog("Already asked");
+                        printLog("Already asked", &proTxHash);
                         continue;
                     }
                 }
-                // Sleep a bit depending on the start offset to balance out multiple requests to same masternode
-                quorumThreadInterrupt.sleep_for(std::chrono::milliseconds(nMyStartOffset * 100));
-                nTimeLastSuccess = GetAdjustedTime();
-                g_connman->AddPendingMasternode(*pCurrentMemberHash);
-                printLog("Connect");
+                if (!fSlept) {
+                    // Sleep a bit depending on the start offset to balance out multiple requests to same masternode
+                    quorumThreadInterrupt.sleep_for(std::chrono::milliseconds(nMyStartOffset * 100));
+                    fSlept = true;
+                }
+                vecAttempts.push_back({proTxHash, GetAdjustedTime()});
+                g_connman->AddPendingMasternode(proTxHash);
+                printLog("Connect", &proTxHash);
+            }
+
+            if (vecAttempts.empty()) {
+                printLog("All tried but failed");
+                break;
             }
 
             g_connman->ForEachNode([&](CNode* pNode) {
 
-                if (pCurrentMemberHash == nullptr || pNode->verifiedProRegTxHash != *pCurrentMemberHash) {
+                auto it = std::find_if(vecAttempts.begin(), vecAttempts.end(), [&](const RecoveryAttempt& attempt) {
+                    return attempt.proTxHash == pNode->verifiedProRegTxHash;
+                });
+                if (pNode->verifiedProRegTxHash.IsNull() || it == vecAttempts.end()) {
+                    return;
+                }
+
+                if (!it->fRequested && quorumManager->RequestQuorumData(pNode, pQuorum->qc.llmqType, pQuorum->pindexQuorum, nDataMask, activeMasternodeInfo.proTxHash)) {
+                    it->fRequested = true;
+                    it->nTime = GetAdjustedTime();
+                    printLog("Requested", &it->proTxHash);
                     return;
                 }
 
-                if (quorumManager->RequestQuorumData(pNode, pQuorum->qc.llmqType, pQuorum->pindexQuorum, nDataMask, activeMasternodeInfo.proTxHash)) {
-                    nTimeLastSuccess = GetAdjustedTime();
-                    printLog("Requested");
+                LOCK(cs_data_requests);
+                auto jt = mapQuorumDataRequests.find(std::make_pair(pNode->verifiedProRegTxHash, true));
+                if (jt == mapQuorumDataRequests.end()) {
+                    printLog("Failed", &it->proTxHash);
+                    pNode->fDisconnect = true;
+                    vecAttempts.erase(it);
+                } else if (jt->second.IsProcessed()) {
+                    // answered, but without the data or with invalid data if it's still missing
+                    printLog("Processed", &it->proTxHash);
+                    pNode->fDisconnect = true;
+                    vecAttempts.erase(it);
                 } else {
-                    LOCK(cs_data_requests);
-                    auto it = mapQuorumDataRequests.find(std::make_pair(pNode->verifiedProRegTxHash, true));
-                    if (it == mapQuorumDataRequests.end()) {
-                        printLog("Failed");
-                        pNode->fDisconnect = true;
-                        pCurrentMemberHash = nullptr;
-                        return;
-                    } else if (it->second.IsProcessed()) {
-                        printLog("Processed");
-                        pNode->fDisconnect = true;
-                        pCurrentMemberHash = nullptr;
-                        return;
-                    } else {
-                        printLog("Waiting");
-                        return;
-                    }
+                    printLog("Waiting", &it->proTxHash);
                 }
             });
             quorumThreadInterrupt.sleep_for(std::chrono::seconds(1));
         }
+
+        {
+            // Drop the responses of the members which are still asked, they would only be processed for nothing now
+            LOCK(cs_data_requests);
+            for (const auto& attempt : vecAttempts) {
+                auto it = mapQuorumDataRequests.find(std::make_pair(attempt.proTxHash, true));
+                if (attempt.fRequested && it != mapQuorumDataRequests.end() && !it->second.IsProcessed() &&
+                    it->second.GetLLMQType() == pQuorum->params.type && it->second.GetQuorumHash() == pQuorum->qc.quorumHash) {
+                    it->second.SetCancelled();
+                }
+            }
+        }
         pQuorum->fQuorumDataRecoveryThreadRunning = false;
         printLog("Done");
     });
@@ -20,6 +20,9 @@
 
 #include <ctpl.h>
 
+#include <atomic>
+#include <mutex>
+
 class CNode;
 
 namespace llmq
@@ -61,6 +64,7 @@ private:
 
     int64_t nTime;
     bool fProcessed;
+    bool fCancelled{false};
 
     static const int64_t EXPIRATION_TIMEOUT{300};
 
@@ -116,6 +120,15 @@ public:
     {
         fProcessed = true;
     }
+    bool IsCancelled() const
+    {
+        return fCancelled;
+    }
+    // The data was received from another member in the meantime, the response is dropped
+    void SetCancelled()
+    {
+        fCancelled = true;
+    }
 
     bool operator==(const CQuorumDataRequest& other)
     {
@@ -163,6 +176,15 @@ private:
     // the public key shares are ready when needed later
     mutable CBLSWorkerCache blsCache;
     mutable std::atomic<bool> fQuorumDataRecoveryThreadRunning{false};
+    // Public key shares of all members as stored in the database by a previous run. Each one is only deserialized when
+    // it's needed. Empty if they weren't stored yet, in which case they're recovered through blsCache
+    std::vector<CBLSLazyPublicKey> vecStoredPubKeyShares;
+    // Decoded public key shares of all members, built once by the cache populator when all of them are known. Every
+    // sig share is verified against one of these, so the table saves the lookups through blsCache and
+    // vecStoredPubKeyShares (and their locks) for each verification. Never modified after fPubKeySharesTable is set
+    mutable std::mutex cs_pubKeySharesTable;
+    mutable std::vector<CBLSPublicKey> vecPubKeySharesTable;
+    mutable std::atomic<bool> fPubKeySharesTable{false};
 
 public:
     CQuorum(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker);
@@ -179,9 +201,18 @@ public:
     CBLSPublicKey GetPubKeyShare(size_t memberIdx) const;
     const CBLSSecretKey& GetSkShare() const;
 
+    // Estimates the memory used by the quorum, not counting the members which are shared with the masternode lists
+    size_t DynamicMemoryUsage() const;
+
 private:
     void WriteContributions(CEvoDB& evoDb);
     bool ReadContributions(CEvoDB& evoDb);
+    // Stores the public key shares of all members, so that they don't have to be recovered again after a restart
+    void WritePubKeyShares(CEvoDB& evoDb) const;
+    bool ReadPubKeyShares(CEvoDB& evoDb);
+    bool HasStoredPubKeyShares() const;
+    // Fills vecPubKeySharesTable, must only be called once all shares can be built
+    void BuildPubKeySharesTable() const;
 };
 
 /**
@@ -203,6 +234,7 @@ private:
 
     mutable ctpl::thread_pool workerPool;
     mutable CThreadInterrupt quorumThreadInterrupt;
+    mutable std::atomic<bool> fActiveQuorumsBuilderRunning{false};
 
 public:
     CQuorumManager(CEvoDB& _evoDb, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager);
@@ -228,6 +260,8 @@ public:
     // this one is cs_main-free
     std::vector<CQuorumCPtr> ScanQuorums(Consensus::LLMQType llmqType, const CBlockIndex* pindexStart, size_t nCountRequested) const;
 
+    size_t DynamicMemoryUsage() const;
+
 private:
     // all private methods here are cs_main-free
     void EnsureQuorumConnections(Consensus::LLMQType llmqType, const CBlockIndex *pindexNew) const;
@@ -242,6 +276,8 @@ private:
     size_t GetQuorumRecoveryStartOffset(const CQuorumCPtr pQuorum, const CBlockIndex* pIndex) const;
 
     void StartCachePopulatorThread(const CQuorumCPtr pQuorum) const;
+    /// Builds all quorums which are active at pindex and not cached yet in the background, one job per quorum
+    void StartActiveQuorumsBuilder(const CBlockIndex* pindex) const;
     void StartQuorumDataRecoveryThread(const CQuorumCPtr pQuorum, const CBlockIndex* pIndex, uint16_t nDataMask) const;
 };
 
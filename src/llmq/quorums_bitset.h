@@ -0,0 +1,325 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LLMQ_QUORUMS_BITSET_H
+#define BITCOIN_LLMQ_QUORUMS_BITSET_H
+
+#include <memusage.h>
+#include <serialize.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+
+namespace llmq
+{
+
+/**
+ * A bitset over the members of a quorum, packed into 64 bit words so that merging, intersecting and counting
+ * inventories of large quorums are done a word at a time instead of bit by bit.
+ * Bits beyond size() are always kept cleared.
+ */
+class CQuorumBitSet
+{
+private:
+    static const size_t WORD_BITS = 64;
+
+    size_t nBits{0};
+    std::vector<uint64_t> words;
+
+    static size_t WordsFor(size_t n) { return (n + WORD_BITS - 1) / WORD_BITS; }
+
+    static int PopCount(uint64_t x)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(x);
+#else
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+
+    /** Index of the lowest set bit, x must not be 0 */
+    static int LowestBit(uint64_t x)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(x);
+#else
+        int n = 0;
+        while (!(x & 1)) {
+            x >>= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    void ClearTail()
+    {
+        if (nBits % WORD_BITS) {
+            words.back() &= ((uint64_t)1 << (nBits % WORD_BITS)) - 1;
+        }
+    }
+
+public:
+    CQuorumBitSet() = default;
+    explicit CQuorumBitSet(size_t size, bool v = false) { assign(size, v); }
+    explicit CQuorumBitSet(const std::vector<bool>& vec)
+    {
+        assign(vec.size(), false);
+        for (size_t i = 0; i < vec.size(); i++) {
+            if (vec[i]) {
+                set(i);
+            }
+        }
+    }
+
+    size_t size() const { return nBits; }
+    bool empty() const { return nBits == 0; }
+
+    void assign(size_t size, bool v)
+    {
+        nBits = size;
+        words.assign(WordsFor(size), v ? ~(uint64_t)0 : 0);
+        ClearTail();
+    }
+
+    /** Grows or shrinks the bitset, new bits are cleared */
+    void resize(size_t size)
+    {
+        nBits = size;
+        words.resize(WordsFor(size), 0);
+        ClearTail();
+    }
+
+    bool test(size_t pos) const
+    {
+        assert(pos < nBits);
+        return (words[pos / WORD_BITS] >> (pos % WORD_BITS)) & 1;
+    }
+    bool operator[](size_t pos) const { return test(pos); }
+
+    void set(size_t pos, bool v = true)
+    {
+        assert(pos < nBits);
+        uint64_t m = (uint64_t)1 << (pos % WORD_BITS);
+        if (v) {
+            words[pos / WORD_BITS] |= m;
+        } else {
+            words[pos / WORD_BITS] &= ~m;
+        }
+    }
+    void reset(size_t pos) { set(pos, false); }
+    void SetAll(bool v) { assign(nBits, v); }
+
+    size_t Count() const
+    {
+        size_t n = 0;
+        for (uint64_t w : words) {
+            n += PopCount(w);
+        }
+        return n;
+    }
+
+    bool Any() const
+    {
+        for (uint64_t w : words) {
+            if (w) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Returns the index of the first set bit at or after pos, or size() if there is none */
+    size_t FindNext(size_t pos) const
+    {
+        if (pos >= nBits) {
+            return nBits;
+        }
+        size_t i = pos / WORD_BITS;
+        uint64_t w = words[i] & (~(uint64_t)0 << (pos % WORD_BITS));
+        while (!w) {
+            if (++i == words.size()) {
+                return nBits;
+            }
+            w = words[i];
+        }
+        return i * WORD_BITS + LowestBit(w);
+    }
+
+    /** Sets all bits which are set in other. Bits of other beyond size() are ignored */
+    CQuorumBitSet& operator|=(const CQuorumBitSet& other)
+    {
+        size_t n = std::min(words.size(), other.words.size());
+        for (size_t i = 0; i < n; i++) {
+            words[i] |= other.words[i];
+        }
+        ClearTail();
+        return *this;
+    }
+
+    /** Clears all bits which are not set in other */
+    CQuorumBitSet& operator&=(const CQuorumBitSet& other)
+    {
+        size_t n = std::min(words.size(), other.words.size());
+        for (size_t i = 0; i < n; i++) {
+            words[i] &= other.words[i];
+        }
+        for (size_t i = n; i < words.size(); i++) {
+            words[i] = 0;
+        }
+        return *this;
+    }
+
+    /** Number of bits set in both bitsets */
+    size_t CountAnd(const CQuorumBitSet& other) const
+    {
+        size_t n = std::min(words.size(), other.words.size());
+        size_t ret = 0;
+        for (size_t i = 0; i < n; i++) {
+            ret += PopCount(words[i] & other.words[i]);
+        }
+        return ret;
+    }
+
+    bool operator==(const CQuorumBitSet& other) const { return nBits == other.nBits && words == other.words; }
+    bool operator!=(const CQuorumBitSet& other) const { return !(*this == other); }
+
+    std::vector<bool> ToVector() const
+    {
+        std::vector<bool> ret(nBits, false);
+        for (size_t i = FindNext(0); i < nBits; i = FindNext(i + 1)) {
+            ret[i] = true;
+        }
+        return ret;
+    }
+
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(words); }
+
+    // Serialization compatible with CFixedBitSet, CFixedVarIntsBitSet and CAutoBitSet
+
+    size_t GetFixedSerializeSize() const { return (nBits + 7) / 8; }
+
+    size_t GetVarIntsSerializeSize() const
+    {
+        size_t ret = 1; // stopper
+        int64_t last = -1;
+        for (size_t i = FindNext(0); i < nBits; i = FindNext(i + 1)) {
+            ret += GetSizeOfVarInt<VarIntMode::DEFAULT, uint32_t>((uint32_t)(i - last));
+            last = i;
+        }
+        return ret;
+    }
+
+    template<typename Stream>
+    void SerializeFixed(Stream& s) const
+    {
+        std::vector<unsigned char> vBytes(GetFixedSerializeSize());
+        for (size_t p = 0; p < vBytes.size(); p++) {
+            vBytes[p] = (unsigned char)(words[p / 8] >> ((p % 8) * 8));
+        }
+        s.write((char*)vBytes.data(), vBytes.size());
+    }
+
+    template<typename Stream>
+    void UnserializeFixed(Stream& s, size_t size)
+    {
+        assign(size, false);
+        std::vector<unsigned char> vBytes(GetFixedSerializeSize());
+        s.read((char*)vBytes.data(), vBytes.size());
+        if (vBytes.size() * 8 != size) {
+            size_t rem = vBytes.size() * 8 - size;
+            uint8_t m = ~(uint8_t)(0xff >> rem);
+            if (vBytes[vBytes.size() - 1] & m) {
+                throw std::ios_base::failure("Out-of-range bits set");
+            }
+        }
+        for (size_t p = 0; p < vBytes.size(); p++) {
+            words[p / 8] |= (uint64_t)vBytes[p] << ((p % 8) * 8);
+        }
+    }
+
+    template<typename Stream>
+    void SerializeVarInts(Stream& s) const
+    {
+        int64_t last = -1;
+        for (size_t i = FindNext(0); i < nBits; i = FindNext(i + 1)) {
+            WriteVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s, (uint32_t)(i - last));
+            last = i;
+        }
+        WriteVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s, 0); // stopper
+    }
+
+    template<typename Stream>
+    void UnserializeVarInts(Stream& s, size_t size)
+    {
+        assign(size, false);
+        int64_t last = -1;
+        while (true) {
+            uint32_t offset = ReadVarInt<Stream, VarIntMode::DEFAULT, uint32_t>(s);
+            if (offset == 0) {
+                break;
+            }
+            int64_t idx = last + offset;
+            if (idx >= (int64_t)size) {
+                throw std::ios_base::failure("out of bounds index");
+            }
+            set((size_t)idx);
+            last = idx;
+        }
+    }
+};
+
+/**
+ * Serializes a CQuorumBitSet in the same format as CAutoBitSet, picking whichever of the fixed or the VarInts
+ * encoding is smaller
+ */
+class CQuorumAutoBitSet
+{
+protected:
+    CQuorumBitSet& bitset;
+    size_t size;
+
+public:
+    CQuorumAutoBitSet(CQuorumBitSet& bitsetIn, size_t sizeIn) : bitset(bitsetIn), size(sizeIn) {}
+
+    template<typename Stream>
+    void Serialize(Stream& s) const
+    {
+        assert(bitset.size() == size);
+
+        if (bitset.GetFixedSerializeSize() < bitset.GetVarIntsSerializeSize()) {
+            ser_writedata8(s, 0);
+            bitset.SerializeFixed(s);
+        } else {
+            ser_writedata8(s, 1);
+            bitset.SerializeVarInts(s);
+        }
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s)
+    {
+        uint8_t isVarInts = ser_readdata8(s);
+        if (isVarInts != 0 && isVarInts != 1) {
+            throw std::ios_base::failure("invalid value for isVarInts byte");
+        }
+
+        if (!isVarInts) {
+            bitset.UnserializeFixed(s, size);
+        } else {
+            bitset.UnserializeVarInts(s, size);
+        }
+    }
+};
+
+#define QUORUMAUTOBITSET(obj, size) llmq::CQuorumAutoBitSet(REF(obj), (size))
+
+} // namespace llmq
+
+#endif // BITCOIN_LLMQ_QUORUMS_BITSET_H
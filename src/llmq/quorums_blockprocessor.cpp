@@ -161,6 +161,14 @@ bool CQuorumBlockProcessor::ProcessBlock(const CBlock& block, const CBlockIndex*
 
     auto blockHash = block.GetHash();
 
+    if (!fJustCheck) {
+        // must happen before ProcessCommitment writes the commitments of this block to the DB
+        LOCK(minedCommitmentsCs);
+        if (!fMinedCommitmentsLoaded) {
+            LoadMinedCommitmentHeights();
+        }
+    }
+
     for (auto& p : qcs) {
         auto& qc = p.second;
         if (!ProcessCommitment(pindex->nHeight, blockHash, qc, state, fJustCheck)) {
@@ -168,6 +176,11 @@ bool CQuorumBlockProcessor::ProcessBlock(const CBlock& block, const CBlockIndex*
         }
     }
 
+    if (!fJustCheck) {
+        UpdateActiveCommitmentHashes(pindex, qcs);
+        UpdateMinedCommitmentHeights(pindex, qcs);
+    }
+
     evoDb.Write(DB_BEST_BLOCK_UPGRADE, blockHash);
 
     return true;
@@ -271,11 +284,48 @@ bool CQuorumBlockProcessor::UndoBlock(const CBlock& block, const CBlockIndex* pi
         AddMinableCommitment(qc);
     }
 
+    {
+        // the commitments that got inactive with this block are not known anymore, rebuild from the DB when needed
+        LOCK(activeCommitmentsCs);
+        if (activeCommitmentsBlock == pindex) {
+            activeCommitmentsBlock = nullptr;
+            activeCommitmentHashes.clear();
+        }
+    }
+
     evoDb.Write(DB_BEST_BLOCK_UPGRADE, pindex->pprev->GetBlockHash());
 
     return true;
 }
 
+void CQuorumBlockProcessor::AddSnapshotCommitments(const CBlockIndex* pindexBase, const std::vector<std::pair<CFinalCommitment, const CBlockIndex*>>& commitments)
+{
+    AssertLockHeld(cs_main);
+
+    for (const auto& p : commitments) {
+        const auto& qc = p.first;
+        auto quorumIndex = LookupBlockIndex(qc.quorumHash);
+        assert(quorumIndex);
+        evoDb.Write(std::make_pair(DB_MINED_COMMITMENT, std::make_pair(qc.llmqType, qc.quorumHash)), std::make_pair(qc, p.second->GetBlockHash()));
+        evoDb.Write(BuildInversedHeightKey((Consensus::LLMQType)qc.llmqType, p.second->nHeight), quorumIndex->nHeight);
+        LOCK(minableCommitmentsCs);
+        mapHasMinedCommitmentCache[qc.llmqType].erase(qc.quorumHash);
+    }
+    {
+        LOCK(activeCommitmentsCs);
+        activeCommitmentsBlock = nullptr;
+        activeCommitmentHashes.clear();
+    }
+    {
+        LOCK(minedCommitmentsCs);
+        fMinedCommitmentsLoaded = false;
+        minedCommitmentHeights.clear();
+    }
+
+    // There is nothing to upgrade for the blocks before the snapshot
+    evoDb.Write(DB_BEST_BLOCK_UPGRADE, pindexBase->GetBlockHash());
+}
+
 // TODO remove this with 0.15.0
 bool CQuorumBlockProcessor::UpgradeDB()
 {
@@ -324,6 +374,12 @@ bool CQuorumBlockProcessor::UpgradeDB()
         }
     }
 
+    {
+        LOCK(minedCommitmentsCs);
+        fMinedCommitmentsLoaded = false;
+        minedCommitmentHeights.clear();
+    }
+
     LogPrintf("CQuorumBlockProcessor::%s -- Upgrade done...\n", __func__);
     return true;
 }
@@ -433,45 +489,157 @@ bool CQuorumBlockProcessor::GetMinedCommitment(Consensus::LLMQType llmqType, con
 // The returned quorums are in reversed order, so the most recent one is at index 0
 std::vector<const CBlockIndex*> CQuorumBlockProcessor::GetMinedCommitmentsUntilBlock(Consensus::LLMQType llmqType, const CBlockIndex* pindex, size_t maxCount)
 {
-    LOCK(evoDb.cs);
+    LOCK(minedCommitmentsCs);
+    if (!fMinedCommitmentsLoaded) {
+        LoadMinedCommitmentHeights();
+    }
 
+    std::vector<const CBlockIndex*> ret;
+    auto it = minedCommitmentHeights.find(llmqType);
+    if (it == minedCommitmentHeights.end()) {
+        return ret;
+    }
+    const auto& v = it->second;
+
+    // the first one mined after pindex
+    auto end = std::upper_bound(v.begin(), v.end(), std::make_pair(pindex->nHeight, std::numeric_limits<int>::max()));
+    size_t nCount = std::min(maxCount, (size_t)(end - v.begin()));
+    ret.reserve(nCount);
+    for (auto jt = std::make_reverse_iterator(end); ret.size() < nCount; ++jt) {
+        auto quorumIndex = pindex->GetAncestor(jt->second);
+        assert(quorumIndex);
+        ret.emplace_back(quorumIndex);
+    }
+
+    return ret;
+}
+
+void CQuorumBlockProcessor::LoadMinedCommitmentHeights()
+{
+    AssertLockHeld(minedCommitmentsCs);
+
+    minedCommitmentHeights.clear();
+
+    LOCK(evoDb.cs);
     auto dbIt = evoDb.GetCurTransaction().NewIteratorUniquePtr();
 
-    auto firstKey = BuildInversedHeightKey(llmqType, pindex->nHeight);
-    auto lastKey = BuildInversedHeightKey(llmqType, 0);
+    size_t nCount = 0;
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        auto& v = minedCommitmentHeights[p.first];
 
-    dbIt->Seek(firstKey);
+        // the most recent one has the lowest key
+        auto firstKey = std::make_tuple(DB_MINED_COMMITMENT_BY_INVERSED_HEIGHT, p.first, (uint32_t)0);
+        dbIt->Seek(firstKey);
 
-    std::vector<const CBlockIndex*> ret;
-    ret.reserve(maxCount);
+        while (dbIt->Valid()) {
+            decltype(firstKey) curKey;
+            int quorumHeight;
+            if (!dbIt->GetKey(curKey) || std::get<0>(curKey) != DB_MINED_COMMITMENT_BY_INVERSED_HEIGHT || std::get<1>(curKey) != p.first) {
+                break;
+            }
+            if (!dbIt->GetValue(quorumHeight)) {
+                break;
+            }
+            int nMinedHeight = (int)(std::numeric_limits<uint32_t>::max() - be32toh(std::get<2>(curKey)));
+            v.emplace_back(nMinedHeight, quorumHeight);
 
-    while (dbIt->Valid() && ret.size() < maxCount) {
-        decltype(firstKey) curKey;
-        int quorumHeight;
-        if (!dbIt->GetKey(curKey) || curKey >= lastKey) {
-            break;
+            dbIt->Next();
         }
-        if (std::get<0>(curKey) != DB_MINED_COMMITMENT_BY_INVERSED_HEIGHT || std::get<1>(curKey) != llmqType) {
-            break;
+        std::reverse(v.begin(), v.end());
+        nCount += v.size();
+    }
+    fMinedCommitmentsLoaded = true;
+
+    LogPrint(BCLog::LLMQ, "CQuorumBlockProcessor::%s -- loaded %d mined commitments\n", __func__, nCount);
+}
+
+size_t CQuorumBlockProcessor::PruneMinedCommitments(int nKeepHeight)
+{
+    AssertLockHeld(cs_main);
+
+    auto& db = evoDb.GetRawDB();
+    CDBBatch batch(db);
+    size_t nCount = 0;
+    {
+        std::unique_ptr<CDBIterator> dbIt(db.NewIterator());
+        for (const auto& p : Params().GetConsensus().llmqs) {
+            // the keys are ordered by descending mined height, so this is the most recent one to remove
+            auto firstKey = BuildInversedHeightKey(p.first, nKeepHeight - 1);
+            dbIt->Seek(firstKey);
+
+            while (dbIt->Valid()) {
+                decltype(firstKey) curKey;
+                int quorumHeight;
+                if (!dbIt->GetKey(curKey) || std::get<0>(curKey) != DB_MINED_COMMITMENT_BY_INVERSED_HEIGHT || std::get<1>(curKey) != p.first) {
+                    break;
+                }
+                if (!dbIt->GetValue(quorumHeight)) {
+                    break;
+                }
+                // it was mined on the active chain below the tip, so its quorum block is on it too
+                auto quorumIndex = chainActive[quorumHeight];
+                if (quorumIndex != nullptr) {
+                    batch.Erase(std::make_pair(DB_MINED_COMMITMENT, std::make_pair(p.first, quorumIndex->GetBlockHash())));
+                }
+                batch.Erase(curKey);
+                nCount++;
+
+                dbIt->Next();
+            }
         }
+    }
+    db.WriteBatch(batch);
 
-        uint32_t nMinedHeight = std::numeric_limits<uint32_t>::max() - be32toh(std::get<2>(curKey));
-        if (nMinedHeight > pindex->nHeight) {
-            break;
+    {
+        LOCK(minedCommitmentsCs);
+        for (auto& p : minedCommitmentHeights) {
+            auto& v = p.second;
+            v.erase(v.begin(), std::lower_bound(v.begin(), v.end(), std::make_pair(nKeepHeight, std::numeric_limits<int>::min())));
         }
+    }
+    {
+        LOCK(minableCommitmentsCs);
+        for (auto& p : mapHasMinedCommitmentCache) {
+            p.second.clear();
+        }
+    }
 
-        if (!dbIt->GetValue(quorumHeight)) {
-            break;
+    if (nCount != 0) {
+        // the removed keys of each type form one range of the height index
+        for (const auto& p : Params().GetConsensus().llmqs) {
+            db.CompactRange(BuildInversedHeightKey(p.first, nKeepHeight - 1), BuildInversedHeightKey(p.first, 0));
         }
+    }
 
-        auto quorumIndex = pindex->GetAncestor(quorumHeight);
-        assert(quorumIndex);
-        ret.emplace_back(quorumIndex);
+    LogPrint(BCLog::LLMQ, "CQuorumBlockProcessor::%s -- removed %d commitments mined below height %d\n", __func__, nCount, nKeepHeight);
+    return nCount;
+}
 
-        dbIt->Next();
+void CQuorumBlockProcessor::UpdateMinedCommitmentHeights(const CBlockIndex* pindex, const std::map<Consensus::LLMQType, CFinalCommitment>& qcs)
+{
+    AssertLockHeld(cs_main);
+
+    LOCK(minedCommitmentsCs);
+    if (!fMinedCommitmentsLoaded) {
+        LoadMinedCommitmentHeights();
+        return;
     }
 
-    return ret;
+    for (auto& p : minedCommitmentHeights) {
+        auto& v = p.second;
+        // left over from disconnected blocks or blocks which failed to connect
+        while (!v.empty() && v.back().first >= pindex->nHeight) {
+            v.pop_back();
+        }
+
+        auto it = qcs.find(p.first);
+        if (it == qcs.end() || it->second.IsNull()) {
+            continue;
+        }
+        auto quorumIndex = LookupBlockIndex(it->second.quorumHash);
+        assert(quorumIndex);
+        v.emplace_back(pindex->nHeight, quorumIndex->nHeight);
+    }
 }
 
 // The returned quorums are in reversed order, so the most recent one is at index 0
@@ -491,6 +659,64 @@ std::map<Consensus::LLMQType, std::vector<const CBlockIndex*>> CQuorumBlockProce
     return ret;
 }
 
+bool CQuorumBlockProcessor::GetMinedAndActiveCommitmentHashesUntilBlock(const CBlockIndex* pindex, std::map<Consensus::LLMQType, std::vector<uint256>>& ret)
+{
+    {
+        LOCK(activeCommitmentsCs);
+        if (activeCommitmentsBlock != nullptr && activeCommitmentsBlock == pindex) {
+            ret = activeCommitmentHashes;
+            return true;
+        }
+    }
+
+    std::map<Consensus::LLMQType, std::vector<uint256>> hashes;
+    for (const auto& p : GetMinedAndActiveCommitmentsUntilBlock(pindex)) {
+        auto& v = hashes[p.first];
+        v.reserve(p.second.size());
+        for (const auto& p2 : p.second) {
+            CFinalCommitment qc;
+            uint256 minedBlockHash;
+            if (!GetMinedCommitment(p.first, p2->GetBlockHash(), qc, minedBlockHash)) {
+                return false;
+            }
+            v.emplace_back(::SerializeHash(qc));
+        }
+    }
+
+    LOCK(activeCommitmentsCs);
+    activeCommitmentsBlock = pindex;
+    activeCommitmentHashes = hashes;
+    ret = std::move(hashes);
+    return true;
+}
+
+void CQuorumBlockProcessor::UpdateActiveCommitmentHashes(const CBlockIndex* pindex, const std::map<Consensus::LLMQType, CFinalCommitment>& qcs)
+{
+    LOCK(activeCommitmentsCs);
+
+    if (activeCommitmentsBlock == nullptr || activeCommitmentsBlock != pindex->pprev) {
+        // we don't know the state of the parent, so this will be rebuilt from the DB on the next request
+        activeCommitmentsBlock = nullptr;
+        activeCommitmentHashes.clear();
+        return;
+    }
+
+    for (const auto& p : qcs) {
+        const auto& qc = p.second;
+        if (qc.IsNull()) {
+            continue;
+        }
+        const auto& params = Params().GetConsensus().llmqs.at(p.first);
+        // most recent first, the oldest one gets inactive when there are too many
+        auto& v = activeCommitmentHashes[p.first];
+        v.insert(v.begin(), ::SerializeHash(qc));
+        if (v.size() > (size_t)params.signingActiveQuorumCount) {
+            v.resize(params.signingActiveQuorumCount);
+        }
+    }
+    activeCommitmentsBlock = pindex;
+}
+
 bool CQuorumBlockProcessor::HasMinableCommitment(const uint256& hash)
 {
     LOCK(minableCommitmentsCs);
@@ -35,6 +35,21 @@ private:
 
     std::map<Consensus::LLMQType, unordered_lru_cache<uint256, bool, StaticSaltedHasher>> mapHasMinedCommitmentCache;
 
+    // Hashes of the mined and active commitments as of activeCommitmentsBlock, in the same order as returned by
+    // GetMinedAndActiveCommitmentsUntilBlock. ProcessBlock moves this forward by one block, so that the DB only needs
+    // to be consulted after reorgs or restarts
+    CCriticalSection activeCommitmentsCs;
+    const CBlockIndex* activeCommitmentsBlock GUARDED_BY(activeCommitmentsCs){nullptr};
+    std::map<Consensus::LLMQType, std::vector<uint256>> activeCommitmentHashes GUARDED_BY(activeCommitmentsCs);
+
+    // The (mined height, quorum height) pairs of the "q_mcih" DB entries, ordered by the mined height, so that
+    // GetMinedCommitmentsUntilBlock doesn't need a DB cursor. Loaded from the DB on first use. UndoBlock leaves the
+    // entries of the disconnected block in place as the undo might be rolled back (e.g. by VerifyDB), the queries
+    // never look above the height of the block they are for and ProcessBlock drops them before adding its own
+    CCriticalSection minedCommitmentsCs;
+    bool fMinedCommitmentsLoaded GUARDED_BY(minedCommitmentsCs){false};
+    std::map<Consensus::LLMQType, std::vector<std::pair<int, int>>> minedCommitmentHeights GUARDED_BY(minedCommitmentsCs);
+
 public:
     explicit CQuorumBlockProcessor(CEvoDB& _evoDb);
 
@@ -54,8 +69,18 @@ public:
     bool HasMinedCommitment(Consensus::LLMQType llmqType, const uint256& quorumHash);
     bool GetMinedCommitment(Consensus::LLMQType llmqType, const uint256& quorumHash, CFinalCommitment& ret, uint256& retMinedBlockHash);
 
+    /**
+     * Store the active commitments of a UTXO snapshot of pindexBase, with the blocks they were mined in. The blocks
+     * before pindexBase were never processed. The caller must hold an evoDb transaction.
+     */
+    void AddSnapshotCommitments(const CBlockIndex* pindexBase, const std::vector<std::pair<CFinalCommitment, const CBlockIndex*>>& commitments);
+
     std::vector<const CBlockIndex*> GetMinedCommitmentsUntilBlock(Consensus::LLMQType llmqType, const CBlockIndex* pindex, size_t maxCount);
     std::map<Consensus::LLMQType, std::vector<const CBlockIndex*>> GetMinedAndActiveCommitmentsUntilBlock(const CBlockIndex* pindex);
+    bool GetMinedAndActiveCommitmentHashesUntilBlock(const CBlockIndex* pindex, std::map<Consensus::LLMQType, std::vector<uint256>>& ret);
+
+    // Removes the commitments mined below nKeepHeight from the committed DB, returns how many were removed
+    size_t PruneMinedCommitments(int nKeepHeight);
 
 private:
     static bool GetCommitmentsFromBlock(const CBlock& block, const CBlockIndex* pindex, std::map<Consensus::LLMQType, CFinalCommitment>& ret, CValidationState& state);
@@ -63,6 +88,9 @@ private:
     static bool IsMiningPhase(Consensus::LLMQType llmqType, int nHeight);
     bool IsCommitmentRequired(Consensus::LLMQType llmqType, int nHeight);
     static uint256 GetQuorumBlockHash(Consensus::LLMQType llmqType, int nHeight);
+    void UpdateActiveCommitmentHashes(const CBlockIndex* pindex, const std::map<Consensus::LLMQType, CFinalCommitment>& qcs);
+    void LoadMinedCommitmentHeights() EXCLUSIVE_LOCKS_REQUIRED(minedCommitmentsCs);
+    void UpdateMinedCommitmentHeights(const CBlockIndex* pindex, const std::map<Consensus::LLMQType, CFinalCommitment>& qcs);
 };
 
 extern CQuorumBlockProcessor* quorumBlockProcessor;
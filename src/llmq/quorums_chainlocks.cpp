@@ -12,6 +12,7 @@
 #include <scheduler.h>
 #include <spork.h>
 #include <txmempool.h>
+#include <utiltrace.h>
 #include <validation.h>
 
 namespace llmq
@@ -128,7 +129,7 @@ void CChainLocksHandler::ProcessNewChainLock(const NodeId from, const llmq::CCha
     }
 
     const uint256 requestId = ::SerializeHash(std::make_pair(CLSIG_REQUESTID_PREFIX, clsig.nHeight));
-    if (!quorumSigningManager->VerifyRecoveredSig(Params().GetConsensus().llmqTypeChainLocks, clsig.nHeight, requestId, clsig.blockHash, clsig.sig)) {
+    if (!quorumSigningManager->VerifyRecoveredSig(Params().GetConsensus().llmqTypeChainLocks, clsig.nHeight, requestId, clsig.blockHash, clsig.sig.Get())) {
         LogPrint(BCLog::CHAINLOCKS, "CChainLocksHandler::%s -- invalid CLSIG (%s), peer=%d\n", __func__, clsig.ToString(), from);
         if (from != -1) {
             LOCK(cs_main);
@@ -160,10 +161,12 @@ void CChainLocksHandler::ProcessNewChainLock(const NodeId from, const llmq::CCha
 
             bestChainLockWithKnownBlock = bestChainLock;
             bestChainLockBlockIndex = pindex;
+            UpdateLockedTip();
         }
         // else if (pindex == nullptr)
         // Note: make sure to still relay clsig further.
     }
+    TRACE4(chainlocks, clsig_accepted, clsig.blockHash.begin(), clsig.nHeight, from, pindex != nullptr);
 
     // Note: do not hold cs while calling RelayInv
     AssertLockNotHeld(cs);
@@ -203,6 +206,7 @@ void CChainLocksHandler::AcceptedBlockHeader(const CBlockIndex* pindexNew)
         // block processing logic will handle this when the block arrives
         bestChainLockWithKnownBlock = bestChainLock;
         bestChainLockBlockIndex = pindexNew;
+        UpdateLockedTip();
     }
 }
 
@@ -246,6 +250,7 @@ void CChainLocksHandler::CheckActiveState()
         bestChainLock = bestChainLockWithKnownBlock = CChainLockSig();
         bestChainLockBlockIndex = lastNotifyChainLockBlockIndex = nullptr;
     }
+    UpdateLockedTip();
 }
 
 void CChainLocksHandler::TrySignChainTip()
@@ -292,7 +297,7 @@ void CChainLocksHandler::TrySignChainTip()
             return;
         }
 
-        if (InternalHasConflictingChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+        if (HasConflictingChainLock(pindex->nHeight, pindex->GetBlockHash())) {
             // don't sign if another conflicting CLSIG is already present. EnforceBestChainLock will later enforce
             // the correct chain.
             return;
@@ -326,21 +331,12 @@ void CChainLocksHandler::TrySignChainTip()
                 continue;
             }
 
-            for (auto& txid : *txids) {
-                int64_t txAge = 0;
-                {
-                    LOCK(cs);
-                    auto it = txFirstSeenTime.find(txid);
-                    if (it != txFirstSeenTime.end()) {
-                        txAge = GetAdjustedTime() - it->second;
-                    }
-                }
-
-                if (txAge < WAIT_FOR_ISLOCK_TIMEOUT && !quorumInstantSendManager->IsLocked(txid)) {
-                    LogPrint(BCLog::CHAINLOCKS, "CChainLocksHandler::%s -- not signing block %s due to TX %s not being islocked and not old enough. age=%d\n", __func__,
-                              pindexWalk->GetBlockHash().ToString(), txid.ToString(), txAge);
-                    return;
-                }
+            uint256 unsafeTxid;
+            int64_t txAge;
+            if (!IsBlockSafe(pindexWalk->GetBlockHash(), *txids, unsafeTxid, txAge)) {
+                LogPrint(BCLog::CHAINLOCKS, "CChainLocksHandler::%s -- not signing block %s due to TX %s not being islocked and not old enough. age=%d\n", __func__,
+                          pindexWalk->GetBlockHash().ToString(), unsafeTxid.ToString(), txAge);
+                return;
             }
 
             pindexWalk = pindexWalk->pprev;
@@ -374,6 +370,14 @@ void CChainLocksHandler::TransactionAddedToMempool(const CTransactionRef& tx, in
     txFirstSeenTime.emplace(tx->GetHash(), nAcceptTime);
 }
 
+void CChainLocksHandler::TransactionLocked(const uint256& txid)
+{
+    LOCK(cs);
+    for (auto& p : blockSafety) {
+        p.second.unsafeTxs.erase(txid);
+    }
+}
+
 void CChainLocksHandler::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted)
 {
     if (!masternodeSync.IsBlockchainSynced()) {
@@ -384,6 +388,16 @@ void CChainLocksHandler::BlockConnected(const std::shared_ptr<const CBlock>& pbl
     // We need this information later when we try to sign a new tip, so that we can determine if all included TXs are
     // safe.
 
+    // Most TXs are islocked before they get mined, so sort these out right away instead of when trying to sign
+    std::vector<uint256> lockedTxids;
+    if (IsInstantSendEnabled()) {
+        for (const auto& tx : pblock->vtx) {
+            if (!tx->IsCoinBase() && !tx->vin.empty() && quorumInstantSendManager->IsLocked(tx->GetHash())) {
+                lockedTxids.emplace_back(tx->GetHash());
+            }
+        }
+    }
+
     LOCK(cs);
 
     auto it = blockTxs.find(pindex->GetBlockHash());
@@ -405,12 +419,17 @@ void CChainLocksHandler::BlockConnected(const std::shared_ptr<const CBlock>& pbl
         txFirstSeenTime.emplace(tx->GetHash(), curTime);
     }
 
+    auto& info = GetBlockSafety(pindex->GetBlockHash(), txids, curTime);
+    for (const auto& txid : lockedTxids) {
+        info.unsafeTxs.erase(txid);
+    }
 }
 
 void CChainLocksHandler::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected)
 {
     LOCK(cs);
     blockTxs.erase(pindexDisconnected->GetBlockHash());
+    blockSafety.erase(pindexDisconnected->GetBlockHash());
 }
 
 CChainLocksHandler::BlockTxs::mapped_type CChainLocksHandler::GetBlockTxs(const uint256& blockHash)
@@ -462,6 +481,78 @@ CChainLocksHandler::BlockTxs::mapped_type CChainLocksHandler::GetBlockTxs(const
     return ret;
 }
 
+CChainLocksHandler::BlockSafetyInfo& CChainLocksHandler::GetBlockSafety(const uint256& blockHash, const std::unordered_set<uint256, StaticSaltedHasher>& txids, int64_t nTime)
+{
+    AssertLockHeld(cs);
+
+    auto res = blockSafety.emplace(blockHash, BlockSafetyInfo());
+    auto& info = res.first->second;
+    if (!res.second) {
+        return info;
+    }
+
+    for (const auto& txid : txids) {
+        int64_t nFirstSeenTime = nTime;
+        auto it = txFirstSeenTime.find(txid);
+        if (it != txFirstSeenTime.end()) {
+            nFirstSeenTime = it->second;
+        }
+        if (nTime - nFirstSeenTime < WAIT_FOR_ISLOCK_TIMEOUT) {
+            info.unsafeTxs.emplace(txid, nFirstSeenTime);
+            info.nAllAgedTime = std::max(info.nAllAgedTime, nFirstSeenTime + WAIT_FOR_ISLOCK_TIMEOUT);
+        }
+    }
+    return info;
+}
+
+bool CChainLocksHandler::IsBlockSafe(const uint256& blockHash, const std::unordered_set<uint256, StaticSaltedHasher>& txids, uint256& unsafeTxidRet, int64_t& txAgeRet)
+{
+    AssertLockNotHeld(cs);
+
+    int64_t nTime = GetAdjustedTime();
+    std::vector<std::pair<uint256, int64_t>> toCheck;
+    {
+        LOCK(cs);
+        auto& info = GetBlockSafety(blockHash, txids, nTime);
+        if (nTime >= info.nAllAgedTime) {
+            info.unsafeTxs.clear();
+        }
+        for (auto it = info.unsafeTxs.begin(); it != info.unsafeTxs.end(); ) {
+            if (nTime - it->second >= WAIT_FOR_ISLOCK_TIMEOUT) {
+                it = info.unsafeTxs.erase(it);
+            } else {
+                toCheck.emplace_back(*it);
+                ++it;
+            }
+        }
+    }
+    if (toCheck.empty()) {
+        return true;
+    }
+
+    // TransactionLocked() is not called for islocks which arrived before their TX, so ask the islock manager for the rest
+    std::vector<uint256> lockedTxids;
+    bool fSafe = true;
+    for (const auto& p : toCheck) {
+        if (!quorumInstantSendManager->IsLocked(p.first)) {
+            unsafeTxidRet = p.first;
+            txAgeRet = nTime - p.second;
+            fSafe = false;
+            break;
+        }
+        lockedTxids.emplace_back(p.first);
+    }
+
+    LOCK(cs);
+    auto it = blockSafety.find(blockHash);
+    if (it != blockSafety.end()) {
+        for (const auto& txid : lockedTxids) {
+            it->second.unsafeTxs.erase(txid);
+        }
+    }
+    return fSafe;
+}
+
 bool CChainLocksHandler::IsTxSafeForMining(const uint256& txid)
 {
     if (!RejectConflictingBlocks()) {
@@ -593,68 +684,44 @@ void CChainLocksHandler::HandleNewRecoveredSig(const llmq::CRecoveredSig& recove
 
         clsig.nHeight = lastSignedHeight;
         clsig.blockHash = lastSignedMsgHash;
-        clsig.sig = recoveredSig.sig.Get();
+        clsig.sig = recoveredSig.sig;
     }
     ProcessNewChainLock(-1, clsig, ::SerializeHash(clsig));
 }
 
-bool CChainLocksHandler::HasChainLock(int nHeight, const uint256& blockHash)
+void CChainLocksHandler::UpdateLockedTip()
 {
-    LOCK(cs);
-    return InternalHasChainLock(nHeight, blockHash);
+    AssertLockHeld(cs);
+    lockedTip = isEnforced ? bestChainLockBlockIndex : nullptr;
 }
 
-bool CChainLocksHandler::InternalHasChainLock(int nHeight, const uint256& blockHash)
+bool CChainLocksHandler::HasChainLock(int nHeight, const uint256& blockHash)
 {
-    AssertLockHeld(cs);
-
-    if (!isEnforced) {
+    const CBlockIndex* pindexLocked = lockedTip;
+    if (!pindexLocked || nHeight > pindexLocked->nHeight) {
         return false;
     }
 
-    if (!bestChainLockBlockIndex) {
-        return false;
+    if (nHeight == pindexLocked->nHeight) {
+        return blockHash == pindexLocked->GetBlockHash();
     }
 
-    if (nHeight > bestChainLockBlockIndex->nHeight) {
-        return false;
-    }
-
-    if (nHeight == bestChainLockBlockIndex->nHeight) {
-        return blockHash == bestChainLockBlockIndex->GetBlockHash();
-    }
-
-    auto pAncestor = bestChainLockBlockIndex->GetAncestor(nHeight);
+    auto pAncestor = pindexLocked->GetAncestor(nHeight);
     return pAncestor && pAncestor->GetBlockHash() == blockHash;
 }
 
 bool CChainLocksHandler::HasConflictingChainLock(int nHeight, const uint256& blockHash)
 {
-    LOCK(cs);
-    return InternalHasConflictingChainLock(nHeight, blockHash);
-}
-
-bool CChainLocksHandler::InternalHasConflictingChainLock(int nHeight, const uint256& blockHash)
-{
-    AssertLockHeld(cs);
-
-    if (!isEnforced) {
-        return false;
-    }
-
-    if (!bestChainLockBlockIndex) {
-        return false;
-    }
-
-    if (nHeight > bestChainLockBlockIndex->nHeight) {
+    const CBlockIndex* pindexLocked = lockedTip;
+    if (!pindexLocked || nHeight > pindexLocked->nHeight) {
         return false;
     }
 
-    if (nHeight == bestChainLockBlockIndex->nHeight) {
-        return blockHash != bestChainLockBlockIndex->GetBlockHash();
+    if (nHeight == pindexLocked->nHeight) {
+        return blockHash != pindexLocked->GetBlockHash();
     }
 
-    auto pAncestor = bestChainLockBlockIndex->GetAncestor(nHeight);
+    auto pAncestor = pindexLocked->GetAncestor(nHeight);
     assert(pAncestor);
     return pAncestor->GetBlockHash() != blockHash;
 }
@@ -686,12 +753,14 @@ void CChainLocksHandler::Cleanup()
 
     for (auto it = blockTxs.begin(); it != blockTxs.end(); ) {
         auto pindex = LookupBlockIndex(it->first);
-        if (InternalHasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+        if (HasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
             for (auto& txid : *it->second) {
                 txFirstSeenTime.erase(txid);
             }
+            blockSafety.erase(it->first);
             it = blockTxs.erase(it);
-        } else if (InternalHasConflictingChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+        } else if (HasConflictingChainLock(pindex->nHeight, pindex->GetBlockHash())) {
+            blockSafety.erase(it->first);
             it = blockTxs.erase(it);
         } else {
             ++it;
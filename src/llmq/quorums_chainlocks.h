@@ -29,7 +29,8 @@ class CChainLockSig
 public:
     int32_t nHeight{-1};
     uint256 blockHash;
-    CBLSSignature sig;
+    // Only decoded when the CLSIG is verified, not for the ones we've seen already
+    CBLSLazySignature sig;
 
 public:
     ADD_SERIALIZE_METHODS
@@ -69,6 +70,13 @@ private:
     const CBlockIndex* bestChainLockBlockIndex{nullptr};
     const CBlockIndex* lastNotifyChainLockBlockIndex{nullptr};
 
+    /**
+     * bestChainLockBlockIndex while ChainLocks are enforced and nullptr otherwise, updated together with them under cs.
+     * HasChainLock and HasConflictingChainLock only read this, so they don't need cs. Block indexes are never freed
+     * while running, and pprev/pskip of an index don't change once it's in mapBlockIndex.
+     */
+    std::atomic<const CBlockIndex*> lockedTip{nullptr};
+
     int32_t lastSignedHeight{-1};
     uint256 lastSignedRequestId;
     uint256 lastSignedMsgHash;
@@ -78,6 +86,19 @@ private:
     BlockTxs blockTxs;
     std::unordered_map<uint256, int64_t> txFirstSeenTime;
 
+    /**
+     * Per block state of the "all TXs are islocked or old enough" check done before signing. TXs are dropped from
+     * unsafeTxs once they are found to be islocked or old enough, so that the check at a new tip only has to look at
+     * the (usually few) TXs which weren't safe the last time.
+     */
+    struct BlockSafetyInfo {
+        // TXs which were neither islocked nor old enough the last time we looked, with their first seen time
+        std::unordered_map<uint256, int64_t, StaticSaltedHasher> unsafeTxs;
+        // from this time on, all of unsafeTxs are old enough, no matter if they got islocked or not
+        int64_t nAllAgedTime{0};
+    };
+    std::unordered_map<uint256, BlockSafetyInfo, StaticSaltedHasher> blockSafety;
+
     std::map<uint256, int64_t> seenChainLocks;
 
     int64_t lastCleanupTime{0};
@@ -98,6 +119,7 @@ public:
     void AcceptedBlockHeader(const CBlockIndex* pindexNew);
     void UpdatedBlockTip(const CBlockIndex* pindexNew);
     void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime);
+    void TransactionLocked(const uint256& txid);
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted);
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected);
     void CheckActiveState();
@@ -105,6 +127,7 @@ public:
     void EnforceBestChainLock();
     virtual void HandleNewRecoveredSig(const CRecoveredSig& recoveredSig);
 
+    // these don't lock cs and may be called with or without it
     bool HasChainLock(int nHeight, const uint256& blockHash);
     bool HasConflictingChainLock(int nHeight, const uint256& blockHash);
 
@@ -112,10 +135,11 @@ public:
 
 private:
     // these require locks to be held already
-    bool InternalHasChainLock(int nHeight, const uint256& blockHash);
-    bool InternalHasConflictingChainLock(int nHeight, const uint256& blockHash);
+    void UpdateLockedTip();
 
     BlockTxs::mapped_type GetBlockTxs(const uint256& blockHash);
+    BlockSafetyInfo& GetBlockSafety(const uint256& blockHash, const std::unordered_set<uint256, StaticSaltedHasher>& txids, int64_t nTime);
+    bool IsBlockSafe(const uint256& blockHash, const std::unordered_set<uint256, StaticSaltedHasher>& txids, uint256& unsafeTxidRet, int64_t& txAgeRet);
 
     void Cleanup();
 };
@@ -4,7 +4,12 @@
 
 #include <llmq/quorums_commitment.h>
 
+#include <bls/bls_sigcache.h>
 #include <chainparams.h>
+#include <hash.h>
+#include <saltedhasher.h>
+#include <sync.h>
+#include <unordered_lru_cache.h>
 #include <validation.h>
 
 #include <evo/specialtx.h>
@@ -12,6 +17,21 @@
 namespace llmq
 {
 
+namespace {
+// Commitments which passed Verify() with checkSigs, by the hash of the commitment and of the quorum block. The members
+// only depend on the quorum block, so a commitment relayed via P2P is not verified again when it's mined
+CCriticalSection cs_verifiedCommitments;
+unordered_lru_cache<uint256, bool, StaticSaltedHasher, 1000> verifiedCommitments;
+
+uint256 VerifiedCommitmentKey(const CFinalCommitment& qc, const CBlockIndex* pQuorumIndex)
+{
+    CHashWriter hw(SER_GETHASH, 0);
+    hw << qc;
+    hw << pQuorumIndex->GetBlockHash();
+    return hw.GetHash();
+}
+} // namespace
+
 CFinalCommitment::CFinalCommitment(const Consensus::LLMQParams& params, const uint256& _quorumHash) :
         llmqType(params.type),
         quorumHash(_quorumHash),
@@ -26,6 +46,16 @@ CFinalCommitment::CFinalCommitment(const Consensus::LLMQParams& params, const ui
 
 bool CFinalCommitment::Verify(const CBlockIndex* pQuorumIndex, bool checkSigs) const
 {
+    uint256 verifiedKey;
+    if (checkSigs) {
+        verifiedKey = VerifiedCommitmentKey(*this, pQuorumIndex);
+        bool fVerified;
+        LOCK(cs_verifiedCommitments);
+        if (verifiedCommitments.get(verifiedKey, fVerified)) {
+            return true;
+        }
+    }
+
     if (nVersion == 0 || nVersion > CURRENT_VERSION) {
         return false;
     }
@@ -56,11 +86,11 @@ bool CFinalCommitment::Verify(const CBlockIndex* pQuorumIndex, bool checkSigs) c
         LogPrintfFinalCommitment("invalid quorumVvecHash\n");
         return false;
     }
-    if (!membersSig.IsValid()) {
+    if (!membersSig.Get().IsValid()) {
         LogPrintfFinalCommitment("invalid membersSig\n");
         return false;
     }
-    if (!quorumSig.IsValid()) {
+    if (!quorumSig.Get().IsValid()) {
         LogPrintfFinalCommitment("invalid vvecSig\n");
         return false;
     }
@@ -89,15 +119,19 @@ bool CFinalCommitment::Verify(const CBlockIndex* pQuorumIndex, bool checkSigs) c
             memberPubKeys.emplace_back(members[i]->pdmnState->pubKeyOperator.Get());
         }
 
-        if (!membersSig.VerifySecureAggregated(memberPubKeys, commitmentHash)) {
+        // Commitments are verified when they're received and again when they're mined, the cache saves the second time
+        if (!BLSCachedVerifySecureAggregated(membersSig.Get(), memberPubKeys, commitmentHash)) {
             LogPrintfFinalCommitment("invalid aggregated members signature\n");
             return false;
         }
 
-        if (!quorumSig.VerifyInsecure(quorumPublicKey, commitmentHash)) {
+        if (!BLSCachedVerifyInsecure(quorumSig.Get(), quorumPublicKey, commitmentHash)) {
             LogPrintfFinalCommitment("invalid quorum signature\n");
             return false;
         }
+
+        LOCK(cs_verifiedCommitments);
+        verifiedCommitments.insert(verifiedKey, true);
     }
 
     return true;
@@ -131,7 +165,7 @@ bool CFinalCommitment::VerifySizes(const Consensus::LLMQParams& params) const
     return true;
 }
 
-bool CheckLLMQCommitment(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state)
+bool CheckLLMQCommitment(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigChecks* pSigChecks)
 {
     CFinalCommitmentTxPayload qcTx;
     if (!GetTxPayload(tx, qcTx)) {
@@ -172,6 +206,12 @@ bool CheckLLMQCommitment(const CTransaction& tx, const CBlockIndex* pindexPrev,
         return state.DoS(100, false, REJECT_INVALID, "bad-qc-invalid");
     }
 
+    if (pSigChecks) {
+        pSigChecks->AddPrefetch([commitment = qcTx.commitment, pindexQuorum](std::string& strError) {
+            return commitment.Verify(pindexQuorum, true);
+        });
+    }
+
     return true;
 }
 
@@ -15,6 +15,8 @@
 
 #include <univalue.h>
 
+class CSpecialTxSigChecks;
+
 namespace llmq
 {
 
@@ -36,8 +38,10 @@ public:
     CBLSPublicKey quorumPublicKey;
     uint256 quorumVvecHash;
 
-    CBLSSignature quorumSig; // recovered threshold sig of blockHash+validMembers+pubKeyHash+vvecHash
-    CBLSSignature membersSig; // aggregated member sig of blockHash+validMembers+pubKeyHash+vvecHash
+    // The signatures are only decoded when the commitment is verified, commitments we already have (e.g. relayed by
+    // several peers) are dropped before that
+    CBLSLazySignature quorumSig; // recovered threshold sig of blockHash+validMembers+pubKeyHash+vvecHash
+    CBLSLazySignature membersSig; // aggregated member sig of blockHash+validMembers+pubKeyHash+vvecHash
 
 public:
     CFinalCommitment() = default;
@@ -82,8 +86,8 @@ public:
         }
         if (quorumPublicKey.IsValid() ||
             !quorumVvecHash.IsNull() ||
-            membersSig.IsValid() ||
-            quorumSig.IsValid()) {
+            membersSig.Get().IsValid() ||
+            quorumSig.Get().IsValid()) {
             return false;
         }
         return true;
@@ -101,8 +105,8 @@ public:
         obj.pushKV("validMembers", CLLMQUtils::ToHexStr(validMembers));
         obj.pushKV("quorumPublicKey", quorumPublicKey.ToString());
         obj.pushKV("quorumVvecHash", quorumVvecHash.ToString());
-        obj.pushKV("quorumSig", quorumSig.ToString());
-        obj.pushKV("membersSig", membersSig.ToString());
+        obj.pushKV("quorumSig", quorumSig.Get().ToString());
+        obj.pushKV("membersSig", membersSig.Get().ToString());
     }
 };
 
@@ -139,7 +143,9 @@ public:
     }
 };
 
-bool CheckLLMQCommitment(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state);
+// The signatures of the commitment are verified on pSigChecks, if set. That only warms up the BLS signature cache for
+// CQuorumBlockProcessor, which verifies them when it processes the commitment.
+bool CheckLLMQCommitment(const CTransaction& tx, const CBlockIndex* pindexPrev, CValidationState& state, CSpecialTxSigChecks* pSigChecks = nullptr);
 
 } // namespace llmq
 
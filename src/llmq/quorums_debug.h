@@ -6,13 +6,13 @@
 #define BITCOIN_LLMQ_QUORUMS_DEBUG_H
 
 #include <consensus/params.h>
+#include <streams.h>
 #include <sync.h>
 #include <univalue.h>
 
 #include <functional>
 #include <set>
 
-class CDataStream;
 class CInv;
 class CScheduler;
 
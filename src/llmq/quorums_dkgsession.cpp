@@ -89,6 +89,17 @@ CDKGMember::CDKGMember(CDeterministicMNCPtr _dmn, size_t _idx) :
 
 }
 
+CDKGSession::~CDKGSession()
+{
+    // background verifications reference the jobs, so they must finish before the jobs go away
+    LOCK(cs_pending);
+    for (auto& job : contributionVerificationJobs) {
+        if (job.result.valid()) {
+            job.result.wait();
+        }
+    }
+}
+
 bool CDKGSession::Init(const CBlockIndex* _pindexQuorum, const std::vector<CDeterministicMNCPtr>& mns, const uint256& _myProTxHash)
 {
     pindexQuorum = _pindexQuorum;
@@ -257,8 +268,9 @@ bool CDKGSession::PreVerifyMessage(const CDKGContribution& qc, bool& retBan) con
     return true;
 }
 
-void CDKGSession::ReceiveMessage(const CDKGContribution& qc, bool& retBan)
+void CDKGSession::ReceiveMessage(const std::shared_ptr<const CDKGContribution>& pqc, bool& retBan)
 {
+    const auto& qc = *pqc;
     LOCK(cs_pending);
 
     CDKGLogger logger(*this, __func__);
@@ -270,6 +282,11 @@ void CDKGSession::ReceiveMessage(const CDKGContribution& qc, bool& retBan)
     cxxtimer::Timer t1(true);
     logger.Batch("received contribution from %s", qc.proTxHash.ToString());
 
+    const uint256 hash = ::SerializeHash(qc);
+
+    // collect whatever finished verifying in the background in the meantime
+    FinishContributionVerifications(false);
+
     {
         // relay, no matter if further verification fails
         // This ensures the whole quorum sees the bad behavior
@@ -277,11 +294,11 @@ void CDKGSession::ReceiveMessage(const CDKGContribution& qc, bool& retBan)
 
         if (member->contributions.size() >= 2) {
             // only relay up to 2 contributions, that's enough to let the other members know about his bad behavior
+            decryptedContributions.erase(hash);
             return;
         }
 
-        const uint256 hash = ::SerializeHash(qc);
-        contributions.emplace(hash, qc);
+        contributions.emplace(hash, pqc);
         member->contributions.emplace(hash);
 
         CInv inv(MSG_QUORUM_CONTRIB, hash);
@@ -297,6 +314,7 @@ void CDKGSession::ReceiveMessage(const CDKGContribution& qc, bool& retBan)
             // so others know about his bad behavior
             MarkBadMember(member->idx);
             logger.Batch("%s did send multiple contributions", member->dmn->proTxHash.ToString());
+            decryptedContributions.erase(hash);
             return;
         }
     }
@@ -323,7 +341,16 @@ void CDKGSession::ReceiveMessage(const CDKGContribution& qc, bool& retBan)
 
     bool complain = false;
     CBLSSecretKey skContribution;
-    if (!qc.contributions->Decrypt(myIdx, *activeMasternodeInfo.blsKeyOperator, skContribution, PROTOCOL_VERSION)) {
+    bool decrypted;
+    auto it = decryptedContributions.find(hash);
+    if (it != decryptedContributions.end()) {
+        skContribution = it->second;
+        decrypted = skContribution.IsValid();
+        decryptedContributions.erase(it);
+    } else {
+        decrypted = qc.contributions->Decrypt(myIdx, *activeMasternodeInfo.blsKeyOperator, skContribution, PROTOCOL_VERSION);
+    }
+    if (!decrypted) {
         logger.Batch("contribution from %s could not be decrypted", member->dmn->proTxHash.ToString());
         complain = true;
     } else if (member->idx != myIdx && ShouldSimulateError("complain-lie")) {
@@ -342,76 +369,143 @@ void CDKGSession::ReceiveMessage(const CDKGContribution& qc, bool& retBan)
 
     logger.Batch("decrypted our contribution share. time=%d", t2.count());
 
-    bool verifyPending = false;
     receivedSkContributions[member->idx] = skContribution;
     vecEncryptedContributions[member->idx] = qc.contributions;
     pendingContributionVerifications.emplace_back(member->idx);
     if (pendingContributionVerifications.size() >= 32) {
-        verifyPending = true;
+        StartContributionVerification();
     }
+}
 
-    if (verifyPending) {
-        VerifyPendingContributions();
+// Decrypts our shares of a batch of contributions in parallel on the BLS worker pool before ReceiveMessage is called
+// for them. ReceiveMessage then only has to pick up the already decrypted share instead of doing the (expensive)
+// decryption one by one.
+void CDKGSession::DecryptContributions(const std::vector<std::pair<NodeId, std::shared_ptr<CDKGContribution>>>& msgs)
+{
+    if (!AreWeMember()) {
+        return;
+    }
+
+    std::vector<uint256> hashes;
+    std::vector<std::shared_ptr<CBLSIESMultiRecipientObjects<CBLSSecretKey>>> encryptedContributions;
+    hashes.reserve(msgs.size());
+    encryptedContributions.reserve(msgs.size());
+    {
+        LOCK(invCs);
+        for (const auto& p : msgs) {
+            auto member = GetMember(p.second->proTxHash);
+            if (!member->contributions.empty()) {
+                // ReceiveMessage won't need the share anyway
+                continue;
+            }
+            hashes.emplace_back(::SerializeHash(*p.second));
+            encryptedContributions.emplace_back(p.second->contributions);
+        }
+    }
+    if (encryptedContributions.empty()) {
+        return;
+    }
+
+    auto skContributions = blsWorker.DecryptContributionShares(encryptedContributions, myIdx, *activeMasternodeInfo.blsKeyOperator);
+
+    LOCK(cs_pending);
+    for (size_t i = 0; i < hashes.size(); i++) {
+        decryptedContributions.emplace(hashes[i], skContributions[i]);
     }
 }
 
-// Verifies all pending secret key contributions in one batch
+// Starts verification of all pending secret key contributions in one batch on the BLS worker pool
 // This is done by aggregating the verification vectors belonging to the secret key contributions
 // The resulting aggregated vvec is then used to recover a public key share
 // The public key share must match the public key belonging to the aggregated secret key contributions
 // See CBLSWorker::VerifyContributionShares for more details.
-void CDKGSession::VerifyPendingContributions()
+// The results are applied by FinishContributionVerifications, so that further contributions can be received while
+// the batch is being verified.
+void CDKGSession::StartContributionVerification()
 {
     AssertLockHeld(cs_pending);
 
-    CDKGLogger logger(*this, __func__);
-
-    cxxtimer::Timer t1(true);
-
     std::vector<size_t> pend = std::move(pendingContributionVerifications);
+    pendingContributionVerifications.clear();
     if (pend.empty()) {
         return;
     }
 
-    std::vector<size_t> memberIndexes;
-    std::vector<BLSVerificationVectorPtr> vvecs;
-    BLSSecretKeyVector skContributions;
-
+    ContributionVerificationJob job;
     for (const auto& idx : pend) {
         auto& m = members[idx];
         if (m->bad || m->weComplain) {
             continue;
         }
-        memberIndexes.emplace_back(idx);
-        vvecs.emplace_back(receivedVvecs[idx]);
-        skContributions.emplace_back(receivedSkContributions[idx]);
+        job.memberIndexes.emplace_back(idx);
+        job.vvecs.emplace_back(receivedVvecs[idx]);
+        job.skContributions.emplace_back(receivedSkContributions[idx]);
         // Write here to definitely store one contribution for each member no matter if
         // our share is valid or not, could be that others are still correct
         dkgManager.WriteEncryptedContributions(params.type, pindexQuorum, m->dmn->proTxHash, *vecEncryptedContributions[idx]);
     }
-
-    auto result = blsWorker.VerifyContributionShares(myId, vvecs, skContributions);
-    if (result.size() != memberIndexes.size()) {
-        logger.Batch("VerifyContributionShares returned result of size %d but size %d was expected, something is wrong", result.size(), memberIndexes.size());
+    if (job.memberIndexes.empty()) {
         return;
     }
 
-    for (size_t i = 0; i < memberIndexes.size(); i++) {
-        if (!result[i]) {
-            auto& m = members[memberIndexes[i]];
-            logger.Batch("invalid contribution from %s. will complain later", m->dmn->proTxHash.ToString());
-            m->weComplain = true;
-            quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, m->idx, [&](CDKGDebugMemberStatus& status) {
-                status.weComplain = true;
-                return true;
-            });
-        } else {
-            size_t memberIdx = memberIndexes[i];
-            dkgManager.WriteVerifiedSkContribution(params.type, pindexQuorum, members[memberIdx]->dmn->proTxHash, skContributions[i]);
+    // the verifier references the vectors of the job, so start it only after the job got its final place in the list
+    contributionVerificationJobs.emplace_back(std::move(job));
+    auto& j = contributionVerificationJobs.back();
+    j.result = blsWorker.AsyncVerifyContributionShares(myId, j.vvecs, j.skContributions, true, true);
+}
+
+void CDKGSession::FinishContributionVerifications(bool fWait)
+{
+    AssertLockHeld(cs_pending);
+
+    CDKGLogger logger(*this, __func__);
+
+    for (auto it = contributionVerificationJobs.begin(); it != contributionVerificationJobs.end(); ) {
+        auto& job = *it;
+        if (!fWait && job.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
         }
+
+        auto result = job.result.get();
+        if (result.size() != job.memberIndexes.size()) {
+            logger.Batch("VerifyContributionShares returned result of size %d but size %d was expected, something is wrong", result.size(), job.memberIndexes.size());
+            it = contributionVerificationJobs.erase(it);
+            continue;
+        }
+
+        for (size_t i = 0; i < job.memberIndexes.size(); i++) {
+            auto& m = members[job.memberIndexes[i]];
+            if (!result[i]) {
+                logger.Batch("invalid contribution from %s. will complain later", m->dmn->proTxHash.ToString());
+                m->weComplain = true;
+                quorumDKGDebugManager->UpdateLocalMemberStatus(params.type, m->idx, [&](CDKGDebugMemberStatus& status) {
+                    status.weComplain = true;
+                    return true;
+                });
+            } else {
+                dkgManager.WriteVerifiedSkContribution(params.type, pindexQuorum, m->dmn->proTxHash, job.skContributions[i]);
+            }
+        }
+
+        logger.Batch("verified %d pending contributions", job.memberIndexes.size());
+        it = contributionVerificationJobs.erase(it);
     }
+}
+
+// Verifies all pending secret key contributions and waits for the verifications which are still running
+void CDKGSession::VerifyPendingContributions()
+{
+    AssertLockHeld(cs_pending);
+
+    CDKGLogger logger(*this, __func__);
+
+    cxxtimer::Timer t1(true);
+
+    StartContributionVerification();
+    FinishContributionVerifications(true);
 
-    logger.Batch("verified %d pending contributions. time=%d", pend.size(), t1.count());
+    logger.Batch("finished verification of pending contributions. time=%d", t1.count());
 }
 
 void CDKGSession::VerifyAndComplain(CDKGPendingMessages& pendingMessages)
@@ -579,8 +673,9 @@ bool CDKGSession::PreVerifyMessage(const CDKGComplaint& qc, bool& retBan) const
     return true;
 }
 
-void CDKGSession::ReceiveMessage(const CDKGComplaint& qc, bool& retBan)
+void CDKGSession::ReceiveMessage(const std::shared_ptr<const CDKGComplaint>& pqc, bool& retBan)
 {
+    const auto& qc = *pqc;
     CDKGLogger logger(*this, __func__);
 
     retBan = false;
@@ -598,7 +693,7 @@ void CDKGSession::ReceiveMessage(const CDKGComplaint& qc, bool& retBan)
         }
 
         const uint256 hash = ::SerializeHash(qc);
-        complaints.emplace(hash, qc);
+        complaints.emplace(hash, pqc);
         member->complaints.emplace(hash);
 
         CInv inv(MSG_QUORUM_COMPLAINT, hash);
@@ -674,7 +769,7 @@ void CDKGSession::VerifyAndJustify(CDKGPendingMessages& pendingMessages)
             continue;
         }
 
-        auto& qc = complaints.at(*m->complaints.begin());
+        auto& qc = *complaints.at(*m->complaints.begin());
         if (qc.complainForMembers[myIdx]) {
             justifyFor.emplace(qc.proTxHash);
         }
@@ -793,8 +888,9 @@ bool CDKGSession::PreVerifyMessage(const CDKGJustification& qj, bool& retBan) co
     return true;
 }
 
-void CDKGSession::ReceiveMessage(const CDKGJustification& qj, bool& retBan)
+void CDKGSession::ReceiveMessage(const std::shared_ptr<const CDKGJustification>& pqj, bool& retBan)
 {
+    const auto& qj = *pqj;
     CDKGLogger logger(*this, __func__);
 
     retBan = false;
@@ -812,7 +908,7 @@ void CDKGSession::ReceiveMessage(const CDKGJustification& qj, bool& retBan)
         }
 
         const uint256 hash = ::SerializeHash(qj);
-        justifications.emplace(hash, qj);
+        justifications.emplace(hash, pqj);
         member->justifications.emplace(hash);
 
         // we always relay, even if further verification fails
@@ -1115,8 +1211,9 @@ bool CDKGSession::PreVerifyMessage(const CDKGPrematureCommitment& qc, bool& retB
     return true;
 }
 
-void CDKGSession::ReceiveMessage(const CDKGPrematureCommitment& qc, bool& retBan)
+void CDKGSession::ReceiveMessage(const std::shared_ptr<const CDKGPrematureCommitment>& pqc, bool& retBan)
 {
+    const auto& qc = *pqc;
     CDKGLogger logger(*this, __func__);
 
     retBan = false;
@@ -1133,7 +1230,7 @@ void CDKGSession::ReceiveMessage(const CDKGPrematureCommitment& qc, bool& retBan
 
         // keep track of ALL commitments but only relay valid ones (or if we couldn't build the vvec)
         // relaying is done further down
-        prematureCommitments.emplace(hash, qc);
+        prematureCommitments.emplace(hash, pqc);
         member->prematureCommitments.emplace(hash);
     }
 
@@ -1212,7 +1309,7 @@ std::vector<CFinalCommitment> CDKGSession::FinalizeCommitments()
     std::map<Key, std::vector<CDKGPrematureCommitment>> commitmentsMap;
 
     for (const auto& p : prematureCommitments) {
-        auto& qc = p.second;
+        auto& qc = *p.second;
         if (!validCommitments.count(p.first)) {
             continue;
         }
@@ -1271,14 +1368,16 @@ std::vector<CFinalCommitment> CDKGSession::FinalizeCommitments()
         }
 
         cxxtimer::Timer t1(true);
-        fqc.membersSig = CBLSSignature::AggregateSecure(aggSigs, aggPks, commitmentHash);
+        fqc.membersSig.Set(CBLSSignature::AggregateSecure(aggSigs, aggPks, commitmentHash));
         t1.stop();
 
         cxxtimer::Timer t2(true);
-        if (!fqc.quorumSig.Recover(thresholdSigs, signerIds)) {
+        CBLSSignature quorumSig;
+        if (!quorumSig.Recover(thresholdSigs, signerIds)) {
             logger.Batch("failed to recover quorum sig");
             continue;
         }
+        fqc.quorumSig.Set(quorumSig);
         t2.stop();
 
         cxxtimer::Timer t3(true);
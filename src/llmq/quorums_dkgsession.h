@@ -16,6 +16,9 @@
 
 #include <llmq/quorums_utils.h>
 
+#include <future>
+#include <list>
+
 class UniValue;
 
 namespace llmq
@@ -273,14 +276,28 @@ private:
     // we expect to only receive a single vvec and contribution per member, but we must also be able to relay
     // conflicting messages as otherwise an attacker might be able to broadcast conflicting (valid+invalid) messages
     // and thus split the quorum. Such members are later removed from the quorum.
+    // The messages are shared with the batch they were received in and with getdata serving, so each is only kept once.
     mutable CCriticalSection invCs;
-    std::map<uint256, CDKGContribution> contributions;
-    std::map<uint256, CDKGComplaint> complaints;
-    std::map<uint256, CDKGJustification> justifications;
-    std::map<uint256, CDKGPrematureCommitment> prematureCommitments;
+    std::map<uint256, std::shared_ptr<const CDKGContribution>> contributions;
+    std::map<uint256, std::shared_ptr<const CDKGComplaint>> complaints;
+    std::map<uint256, std::shared_ptr<const CDKGJustification>> justifications;
+    std::map<uint256, std::shared_ptr<const CDKGPrematureCommitment>> prematureCommitments;
+
+    // A batch of secret key contributions which is being verified on the BLS worker pool while further contributions
+    // are received. The verifier only keeps references to the vectors, so these must stay alive until it's done.
+    struct ContributionVerificationJob {
+        std::vector<size_t> memberIndexes;
+        std::vector<BLSVerificationVectorPtr> vvecs;
+        BLSSecretKeyVector skContributions;
+        std::future<std::vector<bool>> result;
+    };
 
     mutable CCriticalSection cs_pending;
-    std::vector<size_t> pendingContributionVerifications;
+    std::vector<size_t> pendingContributionVerifications GUARDED_BY(cs_pending);
+    std::list<ContributionVerificationJob> contributionVerificationJobs GUARDED_BY(cs_pending);
+    // our shares of received contributions, decrypted in advance by DecryptContributions and indexed by msg hash.
+    // Shares which could not be decrypted are stored as invalid keys
+    std::map<uint256, CBLSSecretKey> decryptedContributions GUARDED_BY(cs_pending);
 
     // filled by ReceivePrematureCommitment and used by FinalizeCommitments
     std::set<uint256> validCommitments;
@@ -288,6 +305,7 @@ private:
 public:
     CDKGSession(const Consensus::LLMQParams& _params, CBLSWorker& _blsWorker, CDKGSessionManager& _dkgManager) :
         params(_params), blsWorker(_blsWorker), cache(_blsWorker), dkgManager(_dkgManager) {}
+    ~CDKGSession();
 
     bool Init(const CBlockIndex* pindexQuorum, const std::vector<CDeterministicMNCPtr>& mns, const uint256& _myProTxHash);
 
@@ -310,7 +328,8 @@ public:
     void Contribute(CDKGPendingMessages& pendingMessages);
     void SendContributions(CDKGPendingMessages& pendingMessages);
     bool PreVerifyMessage(const CDKGContribution& qc, bool& retBan) const;
-    void ReceiveMessage(const CDKGContribution& qc, bool& retBan);
+    void DecryptContributions(const std::vector<std::pair<NodeId, std::shared_ptr<CDKGContribution>>>& msgs);
+    void ReceiveMessage(const std::shared_ptr<const CDKGContribution>& pqc, bool& retBan);
     void VerifyPendingContributions();
 
     // Phase 2: complaint
@@ -318,19 +337,19 @@ public:
     void VerifyConnectionAndMinProtoVersions();
     void SendComplaint(CDKGPendingMessages& pendingMessages);
     bool PreVerifyMessage(const CDKGComplaint& qc, bool& retBan) const;
-    void ReceiveMessage(const CDKGComplaint& qc, bool& retBan);
+    void ReceiveMessage(const std::shared_ptr<const CDKGComplaint>& pqc, bool& retBan);
 
     // Phase 3: justification
     void VerifyAndJustify(CDKGPendingMessages& pendingMessages);
     void SendJustification(CDKGPendingMessages& pendingMessages, const std::set<uint256>& forMembers);
     bool PreVerifyMessage(const CDKGJustification& qj, bool& retBan) const;
-    void ReceiveMessage(const CDKGJustification& qj, bool& retBan);
+    void ReceiveMessage(const std::shared_ptr<const CDKGJustification>& pqj, bool& retBan);
 
     // Phase 4: commit
     void VerifyAndCommit(CDKGPendingMessages& pendingMessages);
     void SendCommitment(CDKGPendingMessages& pendingMessages);
     bool PreVerifyMessage(const CDKGPrematureCommitment& qc, bool& retBan) const;
-    void ReceiveMessage(const CDKGPrematureCommitment& qc, bool& retBan);
+    void ReceiveMessage(const std::shared_ptr<const CDKGPrematureCommitment>& pqc, bool& retBan);
 
     // Phase 5: aggregate/finalize
     std::vector<CFinalCommitment> FinalizeCommitments();
@@ -340,6 +359,9 @@ public:
 
     void RelayInvToParticipants(const CInv& inv) const;
 
+    void StartContributionVerification();
+    void FinishContributionVerifications(bool fWait);
+
 public:
     CDKGMember* GetMember(const uint256& proTxHash) const;
 
@@ -12,6 +12,9 @@
 #include <chainparams.h>
 #include <net_processing.h>
 #include <spork.h>
+#include <utiltrace.h>
+
+#include <algorithm>
 
 namespace llmq
 {
@@ -41,15 +44,26 @@ void CDKGPendingMessages::PushPendingMessage(NodeId from, CDataStream& vRecv)
     if (messagesPerNode[from] >= maxMessagesPerNode) {
         // TODO ban?
         LogPrint(BCLog::LLMQ_DKG, "CDKGPendingMessages::%s -- too many messages, peer=%d\n", __func__, from);
+        droppedCount++;
         return;
     }
     messagesPerNode[from]++;
 
-    if (!seenMessages.emplace(hash).second) {
+    if (seenMessages.count(hash)) {
         LogPrint(BCLog::LLMQ_DKG, "CDKGPendingMessages::%s -- already seen %s, peer=%d\n", __func__, hash.ToString(), from);
+        duplicateCount++;
+        return;
+    }
+
+    if (pendingBytes + pm->size() > MAX_PENDING_BYTES) {
+        // don't mark it as seen, so that we can still request it again once the queue has been drained
+        LogPrint(BCLog::LLMQ_DKG, "CDKGPendingMessages::%s -- pending messages too large, dropping %s, peer=%d\n", __func__, hash.ToString(), from);
+        droppedCount++;
         return;
     }
 
+    seenMessages.emplace(hash);
+    pendingBytes += pm->size();
     pendingMessages.emplace_back(std::make_pair(from, std::move(pm)));
 }
 
@@ -59,6 +73,7 @@ std::list<CDKGPendingMessages::BinaryMessage> CDKGPendingMessages::PopPendingMes
 
     std::list<BinaryMessage> ret;
     while (!pendingMessages.empty() && ret.size() < maxCount) {
+        pendingBytes -= pendingMessages.front().second->size();
         ret.emplace_back(std::move(pendingMessages.front()));
         pendingMessages.pop_front();
     }
@@ -78,6 +93,17 @@ void CDKGPendingMessages::Clear()
     pendingMessages.clear();
     messagesPerNode.clear();
     seenMessages.clear();
+    pendingBytes = 0;
+}
+
+void CDKGPendingMessages::AddStats(CDKGMessageStats& stats) const
+{
+    LOCK(cs);
+    stats.nPendingMessages += pendingMessages.size();
+    stats.nPendingBytes += pendingBytes;
+    stats.nSeenMessages += seenMessages.size();
+    stats.nDuplicates += duplicateCount;
+    stats.nDropped += droppedCount;
 }
 
 //////
@@ -319,8 +345,10 @@ void CDKGSessionHandler::HandlePhase(QuorumPhase curPhase,
     LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - starting, curPhase=%d, nextPhase=%d\n", __func__, params.name, curPhase, nextPhase);
 
     SleepBeforePhase(curPhase, expectedQuorumHash, randomSleepFactor, runWhileWaiting);
+    TRACE3(llmq, dkg_phase_start, (int)params.type, (int)curPhase, expectedQuorumHash.begin());
     startPhaseFunc();
     WaitForNextPhase(curPhase, nextPhase, expectedQuorumHash, runWhileWaiting);
+    TRACE3(llmq, dkg_phase_done, (int)params.type, (int)curPhase, expectedQuorumHash.begin());
 
     LogPrint(BCLog::LLMQ_DKG, "CDKGSessionManager::%s -- %s - done, curPhase=%d, nextPhase=%d\n", __func__, params.name, curPhase, nextPhase);
 }
@@ -420,6 +448,18 @@ std::set<NodeId> BatchVerifyMessageSigs(CDKGSession& session, const std::vector<
     return ret;
 }
 
+// Gives the session a chance to do expensive work for the whole batch at once, before the messages are processed one
+// by one. Only contributions need this, we decrypt our shares of them in parallel
+template<typename Message>
+static void PrepareMessageBatch(CDKGSession& session, const std::vector<std::pair<NodeId, std::shared_ptr<Message>>>& msgs)
+{
+}
+
+static void PrepareMessageBatch(CDKGSession& session, const std::vector<std::pair<NodeId, std::shared_ptr<CDKGContribution>>>& msgs)
+{
+    session.DecryptContributions(msgs);
+}
+
 template<typename Message, int MessageType>
 bool ProcessPendingMessageBatch(CDKGSession& session, CDKGPendingMessages& pendingMessages, size_t maxCount)
 {
@@ -466,15 +506,20 @@ bool ProcessPendingMessageBatch(CDKGSession& session, CDKGPendingMessages& pendi
             LogPrint(BCLog::LLMQ_DKG, "%s -- failed to verify signature, peer=%d\n", __func__, nodeId);
             Misbehaving(nodeId, 100);
         }
+        preverifiedMessages.erase(std::remove_if(preverifiedMessages.begin(), preverifiedMessages.end(), [&](const std::pair<NodeId, std::shared_ptr<Message>>& p) {
+            return badNodes.count(p.first) != 0;
+        }), preverifiedMessages.end());
     }
 
+    PrepareMessageBatch(session, preverifiedMessages);
+
     for (const auto& p : preverifiedMessages) {
         const NodeId &nodeId = p.first;
         if (badNodes.count(nodeId)) {
             continue;
         }
         bool ban = false;
-        session.ReceiveMessage(*p.second, ban);
+        session.ReceiveMessage(p.second, ban);
         if (ban) {
             LogPrint(BCLog::LLMQ_DKG, "%s -- banning node after ReceiveMessage failed, peer=%d\n", __func__, nodeId);
             LOCK(cs_main);
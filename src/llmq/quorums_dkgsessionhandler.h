@@ -14,6 +14,16 @@
 namespace llmq
 {
 
+struct CDKGMessageStats {
+    size_t nPendingMessages{0};
+    size_t nPendingBytes{0};
+    size_t nSeenMessages{0};
+    uint64_t nDuplicates{0};
+    uint64_t nDropped{0};
+    // messages accepted by the current sessions, these are shared with getdata serving
+    size_t nSessionMessages{0};
+};
+
 enum QuorumPhase {
     QuorumPhase_None = -1,
     QuorumPhase_Initialized = 1,
@@ -31,13 +41,16 @@ enum QuorumPhase {
  * main handler thread, we push them into a CDKGPendingMessages object and later pop+deserialize them in the DKG phase
  * handler thread.
  *
- * Each message type has it's own instance of this class.
+ * Each message type has it's own instance of this class. The queue is bounded by the number of messages per node and
+ * by the total size of all queued messages.
  */
 class CDKGPendingMessages
 {
 public:
     typedef std::pair<NodeId, std::shared_ptr<CDataStream>> BinaryMessage;
 
+    static const size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+
 private:
     mutable CCriticalSection cs;
     int invType;
@@ -46,6 +59,10 @@ private:
     std::map<NodeId, size_t> messagesPerNode;
     std::set<uint256> seenMessages;
 
+    size_t pendingBytes{0};
+    uint64_t duplicateCount{0};
+    uint64_t droppedCount{0};
+
 public:
     explicit CDKGPendingMessages(size_t _maxMessagesPerNode, int _invType);
 
@@ -54,6 +71,8 @@ public:
     bool HasSeen(const uint256& hash) const;
     void Clear();
 
+    void AddStats(CDKGMessageStats& stats) const;
+
     template<typename Message>
     void PushPendingMessage(NodeId from, Message& msg)
     {
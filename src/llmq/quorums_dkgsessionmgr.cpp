@@ -8,6 +8,8 @@
 #include <llmq/quorums_utils.h>
 
 #include <chainparams.h>
+#include <memaccounting.h>
+#include <memusage.h>
 #include <net_processing.h>
 #include <spork.h>
 
@@ -29,9 +31,13 @@ CDKGSessionManager::CDKGSessionManager(CDBWrapper& _llmqDb, CBLSWorker& _blsWork
                 std::forward_as_tuple(qt.first),
                 std::forward_as_tuple(qt.second, blsWorker, *this));
     }
+    g_memory_accounting.Register("dkg", this, [this]() { return DynamicMemoryUsage(); });
 }
 
-CDKGSessionManager::~CDKGSessionManager() = default;
+CDKGSessionManager::~CDKGSessionManager()
+{
+    g_memory_accounting.Unregister("dkg", this);
+}
 
 void CDKGSessionManager::StartThreads()
 {
@@ -115,7 +121,7 @@ bool CDKGSessionManager::AlreadyHave(const CInv& inv) const
     return false;
 }
 
-bool CDKGSessionManager::GetContribution(const uint256& hash, CDKGContribution& ret) const
+bool CDKGSessionManager::GetContribution(const uint256& hash, std::shared_ptr<const CDKGContribution>& ret) const
 {
     if (!IsQuorumDKGEnabled())
         return false;
@@ -135,7 +141,38 @@ bool CDKGSessionManager::GetContribution(const uint256& hash, CDKGContribution&
     return false;
 }
 
-bool CDKGSessionManager::GetComplaint(const uint256& hash, CDKGComplaint& ret) const
+CDKGMessageStats CDKGSessionManager::GetMessageStats() const
+{
+    CDKGMessageStats stats;
+    for (const auto& p : dkgSessionHandlers) {
+        auto& dkgType = p.second;
+        dkgType.pendingContributions.AddStats(stats);
+        dkgType.pendingComplaints.AddStats(stats);
+        dkgType.pendingJustifications.AddStats(stats);
+        dkgType.pendingPrematureCommitments.AddStats(stats);
+
+        LOCK2(dkgType.cs, dkgType.curSession->invCs);
+        const auto& session = *dkgType.curSession;
+        stats.nSessionMessages += session.contributions.size() + session.complaints.size() +
+                                  session.justifications.size() + session.prematureCommitments.size();
+    }
+    return stats;
+}
+
+size_t CDKGSessionManager::DynamicMemoryUsage()
+{
+    size_t ret = GetMessageStats().nPendingBytes;
+    LOCK(contributionsCacheCs);
+    ret += memusage::DynamicUsage(contributionsCache);
+    for (const auto& p : contributionsCache) {
+        if (p.second.vvec) {
+            ret += memusage::DynamicUsage(p.second.vvec) + memusage::DynamicUsage(*p.second.vvec);
+        }
+    }
+    return ret;
+}
+
+bool CDKGSessionManager::GetComplaint(const uint256& hash, std::shared_ptr<const CDKGComplaint>& ret) const
 {
     if (!IsQuorumDKGEnabled())
         return false;
@@ -155,7 +192,7 @@ bool CDKGSessionManager::GetComplaint(const uint256& hash, CDKGComplaint& ret) c
     return false;
 }
 
-bool CDKGSessionManager::GetJustification(const uint256& hash, CDKGJustification& ret) const
+bool CDKGSessionManager::GetJustification(const uint256& hash, std::shared_ptr<const CDKGJustification>& ret) const
 {
     if (!IsQuorumDKGEnabled())
         return false;
@@ -175,7 +212,7 @@ bool CDKGSessionManager::GetJustification(const uint256& hash, CDKGJustification
     return false;
 }
 
-bool CDKGSessionManager::GetPrematureCommitment(const uint256& hash, CDKGPrematureCommitment& ret) const
+bool CDKGSessionManager::GetPrematureCommitment(const uint256& hash, std::shared_ptr<const CDKGPrematureCommitment>& ret) const
 {
     if (!IsQuorumDKGEnabled())
         return false;
@@ -275,6 +312,15 @@ bool CDKGSessionManager::GetEncryptedContributions(Consensus::LLMQType llmqType,
     return true;
 }
 
+size_t CDKGSessionManager::PruneContributions(int nKeepHeight)
+{
+    size_t nCount = 0;
+    for (const auto& strPrefix : {DB_VVEC, DB_SKCONTRIB, DB_ENC_CONTRIB}) {
+        nCount += CLLMQUtils::PruneQuorumEntries(llmqDb, strPrefix, nKeepHeight);
+    }
+    return nCount;
+}
+
 void CDKGSessionManager::CleanupCache()
 {
     LOCK(contributionsCacheCs);
@@ -56,10 +56,13 @@ public:
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
     bool AlreadyHave(const CInv& inv) const;
-    bool GetContribution(const uint256& hash, CDKGContribution& ret) const;
-    bool GetComplaint(const uint256& hash, CDKGComplaint& ret) const;
-    bool GetJustification(const uint256& hash, CDKGJustification& ret) const;
-    bool GetPrematureCommitment(const uint256& hash, CDKGPrematureCommitment& ret) const;
+    bool GetContribution(const uint256& hash, std::shared_ptr<const CDKGContribution>& ret) const;
+    bool GetComplaint(const uint256& hash, std::shared_ptr<const CDKGComplaint>& ret) const;
+    bool GetJustification(const uint256& hash, std::shared_ptr<const CDKGJustification>& ret) const;
+    bool GetPrematureCommitment(const uint256& hash, std::shared_ptr<const CDKGPrematureCommitment>& ret) const;
+    CDKGMessageStats GetMessageStats() const;
+    // The contributions cache and the raw pending messages, the messages accepted by the sessions are not counted
+    size_t DynamicMemoryUsage();
 
     // Contributions are written while in the DKG
     void WriteVerifiedVvecContribution(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const uint256& proTxHash, const BLSVerificationVectorPtr& vvec);
@@ -69,6 +72,8 @@ public:
     void WriteEncryptedContributions(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const uint256& proTxHash, const CBLSIESMultiRecipientObjects<CBLSSecretKey>& contributions);
     /// Read encrypted (unverified) DKG contributions for the member with the given proTxHash from the llmqDb
     bool GetEncryptedContributions(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const std::vector<bool>& validMembers, const uint256& proTxHash, std::vector<CBLSIESEncryptedObject<CBLSSecretKey>>& vecRet);
+    /// Removes the contributions of the quorums below nKeepHeight from the llmqDb, returns how many were removed
+    size_t PruneContributions(int nKeepHeight);
 
 private:
     void CleanupCache();
@@ -13,9 +13,12 @@
 #include <llmq/quorums_instantsend.h>
 #include <llmq/quorums_signing.h>
 #include <llmq/quorums_signing_shares.h>
+#include <llmq/quorums_signing_stats.h>
 #include <llmq/quorums_utils.h>
 
+#include <bls/bls_worker.h>
 #include <dbwrapper.h>
+#include <util.h>
 
 namespace llmq
 {
@@ -24,7 +27,7 @@ CBLSWorker* blsWorker;
 
 CDBWrapper* llmqDb;
 
-void InitLLMQSystem(CEvoDB& evoDb, bool unitTests, bool fWipe)
+void InitLLMQSystem(CEvoDB& evoDb, size_t nInstantSendCacheSize, bool unitTests, bool fWipe)
 {
     llmqDb = new CDBWrapper(unitTests ? "" : (GetDataDir() / "llmq"), 8 << 20, unitTests, fWipe);
     blsWorker = new CBLSWorker();
@@ -33,10 +36,11 @@ void InitLLMQSystem(CEvoDB& evoDb, bool unitTests, bool fWipe)
     quorumBlockProcessor = new CQuorumBlockProcessor(evoDb);
     quorumDKGSessionManager = new CDKGSessionManager(*llmqDb, *blsWorker);
     quorumManager = new CQuorumManager(evoDb, *blsWorker, *quorumDKGSessionManager);
+    quorumSigningStats = new CSigningStats();
     quorumSigSharesManager = new CSigSharesManager();
     quorumSigningManager = new CSigningManager(*llmqDb, unitTests);
     chainLocksHandler = new CChainLocksHandler();
-    quorumInstantSendManager = new CInstantSendManager(*llmqDb);
+    quorumInstantSendManager = new CInstantSendManager(*llmqDb, nInstantSendCacheSize);
 }
 
 void DestroyLLMQSystem()
@@ -49,6 +53,8 @@ void DestroyLLMQSystem()
     quorumSigningManager = nullptr;
     delete quorumSigSharesManager;
     quorumSigSharesManager = nullptr;
+    delete quorumSigningStats;
+    quorumSigningStats = nullptr;
     delete quorumManager;
     quorumManager = nullptr;
     delete quorumDKGSessionManager;
@@ -68,7 +74,7 @@ void DestroyLLMQSystem()
 void StartLLMQSystem()
 {
     if (blsWorker) {
-        blsWorker->Start();
+        blsWorker->Start(gArgs.GetArg("-blsworkerthreads", DEFAULT_BLS_WORKER_THREADS));
     }
     if (quorumDKGSessionManager) {
         quorumDKGSessionManager->StartThreads();
@@ -78,7 +84,7 @@ void StartLLMQSystem()
     }
     if (quorumSigSharesManager) {
         quorumSigSharesManager->RegisterAsRecoveredSigsListener();
-        quorumSigSharesManager->StartWorkerThread();
+        quorumSigSharesManager->StartWorkerThread(gArgs.GetArg("-sigsharesworkerthreads", DEFAULT_SIGSHARES_WORKER_THREADS));
     }
     if (chainLocksHandler) {
         chainLocksHandler->Start();
@@ -5,14 +5,19 @@
 #ifndef BITCOIN_LLMQ_QUORUMS_INIT_H
 #define BITCOIN_LLMQ_QUORUMS_INIT_H
 
+#include <cstddef>
+
+class CBLSWorker;
 class CDBWrapper;
 class CEvoDB;
 
 namespace llmq
 {
 
+extern CBLSWorker* blsWorker;
+
 // Init/destroy LLMQ globals
-void InitLLMQSystem(CEvoDB& evoDb, bool unitTests, bool fWipe = false);
+void InitLLMQSystem(CEvoDB& evoDb, size_t nInstantSendCacheSize, bool unitTests, bool fWipe = false);
 void DestroyLLMQSystem();
 
 // Manage scheduled tasks, threads, listeners etc.
@@ -8,10 +8,13 @@
 
 #include <bls/bls_batchverifier.h>
 #include <chainparams.h>
+#include <memaccounting.h>
+#include <memusage.h>
 #include <txmempool.h>
 #include <masternode/masternode-sync.h>
 #include <net_processing.h>
 #include <spork.h>
+#include <utiltrace.h>
 #include <validation.h>
 
 #include <cxxtimer.hpp>
@@ -47,8 +50,20 @@ uint256 CInstantSendLock::GetRequestId() const
 
 ////////////////
 
-CInstantSendDb::CInstantSendDb(CDBWrapper& _db) : db(_db)
+CInstantSendDb::CInstantSendDb(CDBWrapper& _db, size_t _nCacheSizeBytes) :
+    db(_db),
+    nCacheSizeBytes(_nCacheSizeBytes),
+    islockCache(GetCacheEntries(_nCacheSizeBytes)),
+    txidCache(GetCacheEntries(_nCacheSizeBytes))
 {
+    LoadLockedOutpoints();
+}
+
+size_t CInstantSendDb::GetCacheEntries(size_t nCacheSizeBytes)
+{
+    // The LRU caches only truncate back to their max size once they grew to twice of it, so plan for the worst case
+    size_t nEntryBytes = ISLOCK_CACHE_ENTRY_BYTES + HASH_CACHE_ENTRY_BYTES;
+    return std::max<size_t>(1, nCacheSizeBytes / (2 * nEntryBytes));
 }
 
 void CInstantSendDb::Upgrade()
@@ -83,24 +98,69 @@ void CInstantSendDb::Upgrade()
         }
         batch.Write(DB_VERSION, CInstantSendDb::CURRENT_VERSION);
         db.WriteBatch(batch);
+        LoadLockedOutpoints();
     }
 }
 
-void CInstantSendDb::WriteNewInstantSendLock(const uint256& hash, const CInstantSendLock& islock)
+void CInstantSendDb::LoadLockedOutpoints()
+{
+    lockedOutpoints.clear();
+
+    auto it = std::unique_ptr<CDBIterator>(db.NewIterator());
+    auto firstKey = std::make_tuple(std::string(DB_ISLOCK_BY_HASH), uint256());
+    it->Seek(firstKey);
+
+    CInstantSendLock islock;
+    while (it->Valid()) {
+        decltype(firstKey) curKey;
+        if (!it->GetKey(curKey) || std::get<0>(curKey) != DB_ISLOCK_BY_HASH) {
+            break;
+        }
+        if (it->GetValue(islock)) {
+            AddLockedOutpoints(std::get<1>(curKey), islock);
+        }
+        it->Next();
+    }
+}
+
+void CInstantSendDb::AddLockedOutpoints(const uint256& hash, const CInstantSendLock& islock)
+{
+    for (const auto& in : islock.inputs) {
+        lockedOutpoints[in] = LockedOutpoint{hash, islock.txid};
+    }
+}
+
+void CInstantSendDb::RemoveLockedOutpoints(const CInstantSendLock& islock)
+{
+    // mirror what happens to DB_HASH_BY_OUTPOINT, which is erased no matter which islock it points to
+    for (const auto& in : islock.inputs) {
+        lockedOutpoints.erase(in);
+    }
+}
+
+void CInstantSendDb::WriteNewInstantSendLocks(const std::vector<std::tuple<uint256, CInstantSendLockPtr, int>>& islocks)
 {
     CDBBatch batch(db);
-    batch.Write(std::make_tuple(std::string(DB_ISLOCK_BY_HASH), hash), islock);
-    batch.Write(std::make_tuple(std::string(DB_HASH_BY_TXID), islock.txid), hash);
-    for (auto& in : islock.inputs) {
-        batch.Write(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), in), hash);
+    for (const auto& t : islocks) {
+        const auto& hash = std::get<0>(t);
+        const auto& islock = *std::get<1>(t);
+        batch.Write(std::make_tuple(std::string(DB_ISLOCK_BY_HASH), hash), islock);
+        batch.Write(std::make_tuple(std::string(DB_HASH_BY_TXID), islock.txid), hash);
+        for (auto& in : islock.inputs) {
+            batch.Write(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), in), hash);
+        }
+        if (std::get<2>(t) != -1) {
+            WriteInstantSendLockMined(batch, hash, std::get<2>(t));
+        }
     }
     db.WriteBatch(batch);
 
-    auto p = std::make_shared<CInstantSendLock>(islock);
-    islockCache.insert(hash, p);
-    txidCache.insert(islock.txid, hash);
-    for (auto& in : islock.inputs) {
-        outpointCache.insert(in, hash);
+    for (const auto& t : islocks) {
+        const auto& hash = std::get<0>(t);
+        const auto& islock = std::get<1>(t);
+        islockCache.insert(hash, islock);
+        txidCache.insert(islock->txid, hash);
+        AddLockedOutpoints(hash, *islock);
     }
 }
 
@@ -118,13 +178,11 @@ void CInstantSendDb::RemoveInstantSendLock(CDBBatch& batch, const uint256& hash,
     for (auto& in : islock->inputs) {
         batch.Erase(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), in));
     }
+    RemoveLockedOutpoints(*islock);
 
     if (!keep_cache) {
         islockCache.erase(hash);
         txidCache.erase(islock->txid);
-        for (auto& in : islock->inputs) {
-            outpointCache.erase(in);
-        }
     }
 }
 
@@ -300,8 +358,12 @@ CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByHash(const uint256& hash
     }
 
     CInstantSendLockPtr ret;
-    if (use_cache && islockCache.get(hash, ret)) {
-        return ret;
+    if (use_cache) {
+        if (islockCache.get(hash, ret)) {
+            islockCacheHits++;
+            return ret;
+        }
+        islockCacheMisses++;
     }
 
     ret = std::make_shared<CInstantSendLock>();
@@ -316,13 +378,41 @@ CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByHash(const uint256& hash
 uint256 CInstantSendDb::GetInstantSendLockHashByTxid(const uint256& txid) const
 {
     uint256 islockHash;
-    if (!txidCache.get(txid, islockHash)) {
+    if (txidCache.get(txid, islockHash)) {
+        txidCacheHits++;
+    } else {
+        txidCacheMisses++;
         db.Read(std::make_tuple(std::string(DB_HASH_BY_TXID), txid), islockHash);
         txidCache.insert(txid, islockHash);
     }
     return islockHash;
 }
 
+void CInstantSendDb::CacheInstantSendLockHashesByTxid(const std::vector<uint256>& txids) const
+{
+    std::vector<uint256> vMissing;
+    std::vector<std::tuple<std::string, uint256>> keys;
+    for (const uint256& txid : txids) {
+        uint256 islockHash;
+        if (!txidCache.get(txid, islockHash)) {
+            vMissing.emplace_back(txid);
+            keys.emplace_back(std::string(DB_HASH_BY_TXID), txid);
+        }
+    }
+    if (keys.empty()) {
+        return;
+    }
+    txidCacheMisses += keys.size();
+
+    std::vector<uint256> islockHashes;
+    std::vector<bool> found;
+    db.ReadMulti(keys, islockHashes, found);
+    for (size_t i = 0; i < vMissing.size(); i++) {
+        // Misses are cached as well, like in GetInstantSendLockHashByTxid
+        txidCache.insert(vMissing[i], found[i] ? islockHashes[i] : uint256());
+    }
+}
+
 CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByTxid(const uint256& txid) const
 {
     return GetInstantSendLockByHash(GetInstantSendLockHashByTxid(txid));
@@ -330,12 +420,51 @@ CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByTxid(const uint256& txid
 
 CInstantSendLockPtr CInstantSendDb::GetInstantSendLockByInput(const COutPoint& outpoint) const
 {
-    uint256 islockHash;
-    if (!outpointCache.get(outpoint, islockHash)) {
-        db.Read(std::make_tuple(std::string(DB_HASH_BY_OUTPOINT), outpoint), islockHash);
-        outpointCache.insert(outpoint, islockHash);
+    auto it = lockedOutpoints.find(outpoint);
+    if (it == lockedOutpoints.end()) {
+        return nullptr;
     }
-    return GetInstantSendLockByHash(islockHash);
+    return GetInstantSendLockByHash(it->second.islockHash);
+}
+
+uint256 CInstantSendDb::GetConflictingLockHash(const CTransaction& tx) const
+{
+    if (lockedOutpoints.empty()) {
+        return uint256();
+    }
+    const uint256& txid = tx.GetHash();
+    for (const auto& in : tx.vin) {
+        auto it = lockedOutpoints.find(in.prevout);
+        if (it != lockedOutpoints.end() && it->second.txid != txid) {
+            return it->second.islockHash;
+        }
+    }
+    return uint256();
+}
+
+CInstantSendDbCacheStats CInstantSendDb::GetCacheStats() const
+{
+    CInstantSendDbCacheStats stats;
+    stats.nCacheSizeBytes = nCacheSizeBytes;
+    stats.islocks.nHits = islockCacheHits;
+    stats.islocks.nMisses = islockCacheMisses;
+    stats.islocks.nEntries = islockCache.size();
+    stats.islocks.nMaxEntries = islockCache.max_size();
+    stats.txids.nHits = txidCacheHits;
+    stats.txids.nMisses = txidCacheMisses;
+    stats.txids.nEntries = txidCache.size();
+    stats.txids.nMaxEntries = txidCache.max_size();
+    stats.nLockedOutpoints = lockedOutpoints.size();
+    return stats;
+}
+
+size_t CInstantSendDb::DynamicMemoryUsage() const
+{
+    size_t ret = islockCache.DynamicMemoryUsage([](const CInstantSendLockPtr& islock) {
+        return islock ? memusage::DynamicUsage(islock) + memusage::DynamicUsage(islock->inputs) : 0;
+    });
+    ret += txidCache.DynamicMemoryUsage([](const uint256&) { return 0; });
+    return ret + memusage::DynamicUsage(lockedOutpoints);
 }
 
 std::vector<uint256> CInstantSendDb::GetInstantSendLocksByParent(const uint256& parent) const
@@ -407,13 +536,17 @@ std::vector<uint256> CInstantSendDb::RemoveChainedInstantSendLocks(const uint256
 
 ////////////////
 
-CInstantSendManager::CInstantSendManager(CDBWrapper& _llmqDb) :
-    db(_llmqDb)
+CInstantSendManager::CInstantSendManager(CDBWrapper& _llmqDb, size_t nCacheSizeBytes) :
+    db(_llmqDb, nCacheSizeBytes)
 {
     workInterrupt.reset();
+    g_memory_accounting.Register("instantsend", this, [this]() { return DynamicMemoryUsage(); });
 }
 
-CInstantSendManager::~CInstantSendManager() = default;
+CInstantSendManager::~CInstantSendManager()
+{
+    g_memory_accounting.Unregister("instantsend", this);
+}
 
 void CInstantSendManager::Start()
 {
@@ -457,6 +590,64 @@ void CInstantSendManager::ProcessTx(const CTransaction& tx, bool fRetroactive, c
         return;
     }
 
+    std::vector<CSigningRequest> vecRequests;
+    if (!PrepareTx(tx, fRetroactive, llmqType, params, vecRequests)) {
+        return;
+    }
+    quorumSigningManager->AsyncSignIfMember(llmqType, vecRequests, fRetroactive);
+
+    // We might have received all input locks before we got the corresponding TX. In this case, we have to sign the
+    // islock now instead of waiting for the input locks.
+    TrySignInstantSendLock(tx);
+}
+
+void CInstantSendManager::ProcessTxs(const std::vector<CTransactionRef>& txs, bool fRetroactive, const Consensus::Params& params)
+{
+    if (!fMasternodeMode || !IsInstantSendEnabled() || !masternodeSync.IsBlockchainSynced()) {
+        return;
+    }
+
+    auto llmqType = params.llmqTypeInstantSend;
+    if (llmqType == Consensus::LLMQ_NONE || txs.empty()) {
+        return;
+    }
+
+    // Look up the islocks of all TXs and of all their parents in one go, the checks of the single TXs below then
+    // only hit the cache
+    {
+        std::vector<uint256> txids;
+        for (const auto& tx : txs) {
+            txids.emplace_back(tx->GetHash());
+            for (const auto& in : tx->vin) {
+                txids.emplace_back(in.prevout.hash);
+            }
+        }
+        LOCK(cs);
+        db.CacheInstantSendLockHashesByTxid(txids);
+    }
+
+    std::vector<CSigningRequest> vecRequests;
+    std::vector<CTransactionRef> vecPrepared;
+    for (const auto& tx : txs) {
+        if (PrepareTx(*tx, fRetroactive, llmqType, params, vecRequests)) {
+            vecPrepared.emplace_back(tx);
+        }
+    }
+    if (vecPrepared.empty()) {
+        return;
+    }
+
+    LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- trying to vote on %d inputs of %d TXs\n", __func__,
+             vecRequests.size(), vecPrepared.size());
+    quorumSigningManager->AsyncSignIfMember(llmqType, vecRequests, fRetroactive);
+
+    for (const auto& tx : vecPrepared) {
+        TrySignInstantSendLock(*tx);
+    }
+}
+
+bool CInstantSendManager::PrepareTx(const CTransaction& tx, bool fRetroactive, Consensus::LLMQType llmqType, const Consensus::Params& params, std::vector<CSigningRequest>& vecRequests)
+{
     // In case the islock was received before the TX, filtered announcement might have missed this islock because
     // we were unable to check for filter matches deep inside the TX. Now we have the TX, so we should retry.
     uint256 islockHash;
@@ -472,7 +663,7 @@ void CInstantSendManager::ProcessTx(const CTransaction& tx, bool fRetroactive, c
     if (!CheckCanLock(tx, true, params)) {
         LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: CheckCanLock returned false\n", __func__,
                   tx.GetHash().ToString());
-        return;
+        return false;
     }
 
     auto conflictingLock = GetConflictingLock(tx);
@@ -480,23 +671,19 @@ void CInstantSendManager::ProcessTx(const CTransaction& tx, bool fRetroactive, c
         auto conflictingLockHash = ::SerializeHash(*conflictingLock);
         LogPrintf("CInstantSendManager::%s -- txid=%s: conflicts with islock %s, txid=%s\n", __func__,
                   tx.GetHash().ToString(), conflictingLockHash.ToString(), conflictingLock->txid.ToString());
-        return;
+        return false;
     }
 
     // Only sign for inlocks or islocks if mempool IS signing is enabled.
     // However, if we are processing a tx because it was included in a block we should
     // sign even if mempool IS signing is disabled. This allows a ChainLock to happen on this
     // block after we retroactively locked all transactions.
-    if (!IsInstantSendMempoolSigningEnabled() && !fRetroactive) return;
+    if (!IsInstantSendMempoolSigningEnabled() && !fRetroactive) return false;
 
-    if (!TrySignInputLocks(tx, fRetroactive, llmqType)) return;
-
-    // We might have received all input locks before we got the corresponding TX. In this case, we have to sign the
-    // islock now instead of waiting for the input locks.
-    TrySignInstantSendLock(tx);
+    return TrySignInputLocks(tx, fRetroactive, llmqType, vecRequests);
 }
 
-bool CInstantSendManager::TrySignInputLocks(const CTransaction& tx, bool fRetroactive, Consensus::LLMQType llmqType)
+bool CInstantSendManager::TrySignInputLocks(const CTransaction& tx, bool fRetroactive, Consensus::LLMQType llmqType, std::vector<CSigningRequest>& vecRequests)
 {
     std::vector<uint256> ids;
     ids.reserve(tx.vin.size());
@@ -529,22 +716,15 @@ bool CInstantSendManager::TrySignInputLocks(const CTransaction& tx, bool fRetroa
         return true;
     }
 
-    LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: trying to vote on %d inputs\n", __func__,
-             tx.GetHash().ToString(), tx.vin.size());
+    LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: trying to vote on %d inputs. fRetroactive=%d\n", __func__,
+             tx.GetHash().ToString(), tx.vin.size(), fRetroactive);
 
-    for (size_t i = 0; i < tx.vin.size(); i++) {
-        auto& in = tx.vin[i];
-        auto& id = ids[i];
-        {
-            LOCK(cs);
-            inputRequestIds.emplace(id);
-        }
-        LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: trying to vote on input %s with id %s. fRetroactive=%d\n", __func__,
-                 tx.GetHash().ToString(), in.prevout.ToStringShort(), id.ToString(), fRetroactive);
-        if (quorumSigningManager->AsyncSignIfMember(llmqType, id, tx.GetHash(), {}, fRetroactive)) {
-            LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s: voted on input %s with id %s\n", __func__,
-                     tx.GetHash().ToString(), in.prevout.ToStringShort(), id.ToString());
-        }
+    {
+        LOCK(cs);
+        inputRequestIds.insert(ids.begin(), ids.end());
+    }
+    for (const auto& id : ids) {
+        vecRequests.emplace_back(CSigningRequest{id, tx.GetHash(), uint256()});
     }
 
     return true;
@@ -557,6 +737,17 @@ bool CInstantSendManager::CheckCanLock(const CTransaction& tx, bool printDebug,
         return false;
     }
 
+    if (IsInstantSendEnabled()) {
+        // Find out whether the parents are locked in one go, IsLocked() below then only hits the cache
+        std::vector<uint256> parents;
+        parents.reserve(tx.vin.size());
+        for (const auto& in : tx.vin) {
+            parents.emplace_back(in.prevout.hash);
+        }
+        LOCK(cs);
+        db.CacheInstantSendLockHashesByTxid(parents);
+    }
+
     for (const auto& in : tx.vin) {
         CAmount v = 0;
         if (!CheckCanLock(in.prevout, printDebug, tx.GetHash(), &v, params)) {
@@ -913,6 +1104,8 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
             verifyCount, alreadyVerified, verifyTimer.count(), batchVerifier.GetUniqueSourceCount());
 
     std::unordered_set<uint256> badISLocks;
+    std::vector<std::tuple<NodeId, uint256, CInstantSendLockPtr>> verifiedISLocks;
+    verifiedISLocks.reserve(pend.size());
 
     if (ban && !batchVerifier.badSources.empty()) {
         LOCK(cs_main);
@@ -934,7 +1127,15 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
             continue;
         }
 
-        ProcessInstantSendLock(nodeId, hash, islock);
+        verifiedISLocks.emplace_back(nodeId, hash, islock);
+    }
+
+    ProcessInstantSendLocks(verifiedISLocks);
+
+    for (const auto& p : verifiedISLocks) {
+        auto nodeId = std::get<0>(p);
+        auto& hash = std::get<1>(p);
+        auto& islock = std::get<2>(p);
 
         // See comment further on top. We pass a reconstructed recovered sig to the signing manager to avoid
         // double-verification of the sig.
@@ -955,84 +1156,140 @@ std::unordered_set<uint256> CInstantSendManager::ProcessPendingInstantSendLocks(
 
 void CInstantSendManager::ProcessInstantSendLock(NodeId from, const uint256& hash, const CInstantSendLockPtr& islock)
 {
+    ProcessInstantSendLocks({std::make_tuple(from, hash, islock)});
+}
+
+// Processes a batch of verified islocks. This is done in stages, so that cs_main and cs are only taken once per stage
+// for the whole batch and all islocks are written to the db in a single batch.
+void CInstantSendManager::ProcessInstantSendLocks(const std::vector<std::tuple<NodeId, uint256, CInstantSendLockPtr>>& islocks)
+{
+    struct Entry {
+        NodeId from;
+        uint256 hash;
+        CInstantSendLockPtr islock;
+        CTransactionRef tx;
+        uint256 hashBlock;
+        const CBlockIndex* pindexMined{nullptr};
+    };
+    std::vector<Entry> entries;
+    entries.reserve(islocks.size());
+
     {
         LOCK(cs);
+        for (const auto& p : islocks) {
+            Entry entry;
+            std::tie(entry.from, entry.hash, entry.islock) = p;
 
-        LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s, islock=%s: processsing islock, peer=%d\n", __func__,
-                 islock->txid.ToString(), hash.ToString(), from);
+            LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txid=%s, islock=%s: processsing islock, peer=%d\n", __func__,
+                     entry.islock->txid.ToString(), entry.hash.ToString(), entry.from);
 
-        creatingInstantSendLocks.erase(islock->GetRequestId());
-        txToCreatingInstantSendLocks.erase(islock->txid);
+            creatingInstantSendLocks.erase(entry.islock->GetRequestId());
+            txToCreatingInstantSendLocks.erase(entry.islock->txid);
 
-        if (db.KnownInstantSendLock(hash)) {
-            return;
+            if (db.KnownInstantSendLock(entry.hash)) {
+                continue;
+            }
+            entries.emplace_back(std::move(entry));
         }
     }
+    if (entries.empty()) {
+        return;
+    }
 
-    CTransactionRef tx;
-    uint256 hashBlock;
-    const CBlockIndex* pindexMined{nullptr};
-    // we ignore failure here as we must be able to propagate the lock even if we don't have the TX locally
-    if (GetTransaction(islock->txid, tx, Params().GetConsensus(), hashBlock) && !hashBlock.IsNull()) {
-        {
-            LOCK(cs_main);
-            pindexMined = LookupBlockIndex(hashBlock);
+    bool anyMined = false;
+    for (auto& entry : entries) {
+        // we ignore failure here as we must be able to propagate the lock even if we don't have the TX locally
+        if (!GetTransaction(entry.islock->txid, entry.tx, Params().GetConsensus(), entry.hashBlock)) {
+            entry.tx = nullptr;
+            entry.hashBlock.SetNull();
         }
+        anyMined |= !entry.hashBlock.IsNull();
+    }
+    if (anyMined) {
+        LOCK(cs_main);
+        for (auto& entry : entries) {
+            if (!entry.hashBlock.IsNull()) {
+                entry.pindexMined = LookupBlockIndex(entry.hashBlock);
+            }
+        }
+    }
 
-        // Let's see if the TX that was locked by this islock is already mined in a ChainLocked block. If yes,
-        // we can simply ignore the islock, as the ChainLock implies locking of all TXs in that chain
-        if (pindexMined != nullptr && llmq::chainLocksHandler->HasChainLock(pindexMined->nHeight, pindexMined->GetBlockHash())) {
+    // Let's see if the TX that was locked by this islock is already mined in a ChainLocked block. If yes,
+    // we can simply ignore the islock, as the ChainLock implies locking of all TXs in that chain
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+        if (entry.pindexMined != nullptr && llmq::chainLocksHandler->HasChainLock(entry.pindexMined->nHeight, entry.pindexMined->GetBlockHash())) {
             LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- txlock=%s, islock=%s: dropping islock as it already got a ChainLock in block %s, peer=%d\n", __func__,
-                     islock->txid.ToString(), hash.ToString(), hashBlock.ToString(), from);
-            return;
+                     entry.islock->txid.ToString(), entry.hash.ToString(), entry.hashBlock.ToString(), entry.from);
+            return true;
         }
+        return false;
+    }), entries.end());
+    if (entries.empty()) {
+        return;
     }
 
     {
         LOCK(cs);
-        CInstantSendLockPtr otherIsLock = db.GetInstantSendLockByTxid(islock->txid);
-        if (otherIsLock != nullptr) {
-            LogPrintf("CInstantSendManager::%s -- txid=%s, islock=%s: duplicate islock, other islock=%s, peer=%d\n", __func__,
-                     islock->txid.ToString(), hash.ToString(), ::SerializeHash(*otherIsLock).ToString(), from);
-        }
-        for (auto& in : islock->inputs) {
-            otherIsLock = db.GetInstantSendLockByInput(in);
+        std::vector<std::tuple<uint256, CInstantSendLockPtr, int>> toWrite;
+        toWrite.reserve(entries.size());
+        for (const auto& entry : entries) {
+            const auto& islock = entry.islock;
+            CInstantSendLockPtr otherIsLock = db.GetInstantSendLockByTxid(islock->txid);
             if (otherIsLock != nullptr) {
-                LogPrintf("CInstantSendManager::%s -- txid=%s, islock=%s: conflicting input in islock. input=%s, other islock=%s, peer=%d\n", __func__,
-                         islock->txid.ToString(), hash.ToString(), in.ToStringShort(), ::SerializeHash(*otherIsLock).ToString(), from);
+                LogPrintf("CInstantSendManager::%s -- txid=%s, islock=%s: duplicate islock, other islock=%s, peer=%d\n", __func__,
+                         islock->txid.ToString(), entry.hash.ToString(), ::SerializeHash(*otherIsLock).ToString(), entry.from);
+            }
+            for (auto& in : islock->inputs) {
+                otherIsLock = db.GetInstantSendLockByInput(in);
+                if (otherIsLock != nullptr) {
+                    LogPrintf("CInstantSendManager::%s -- txid=%s, islock=%s: conflicting input in islock. input=%s, other islock=%s, peer=%d\n", __func__,
+                             islock->txid.ToString(), entry.hash.ToString(), in.ToStringShort(), ::SerializeHash(*otherIsLock).ToString(), entry.from);
+                }
             }
+            toWrite.emplace_back(entry.hash, islock, entry.pindexMined ? entry.pindexMined->nHeight : -1);
         }
 
-        db.WriteNewInstantSendLock(hash, *islock);
-        if (pindexMined) {
-            db.WriteInstantSendLockMined(hash, pindexMined->nHeight);
-        }
+        db.WriteNewInstantSendLocks(toWrite);
 
-        // This will also add children TXs to pendingRetryTxs
-        RemoveNonLockedTx(islock->txid, true);
+        for (const auto& entry : entries) {
+            if (!entry.pindexMined && entry.tx != nullptr) {
+                if (recentlyLockedTxs.size() < MAX_RECENTLY_LOCKED_TXS) {
+                    recentlyLockedTxs.emplace_back(entry.tx);
+                } else {
+                    recentlyLockedTxs[recentlyLockedTxsIt] = entry.tx;
+                    recentlyLockedTxsIt = (recentlyLockedTxsIt + 1) % MAX_RECENTLY_LOCKED_TXS;
+                }
+            }
 
-        // We don't need the recovered sigs for the inputs anymore. This prevents unnecessary propagation of these sigs.
-        // We only need the ISLOCK from now on to detect conflicts
-        TruncateRecoveredSigsForInputs(*islock);
-    }
+            // This will also add children TXs to pendingRetryTxs
+            RemoveNonLockedTx(entry.islock->txid, true);
 
-    CInv inv(MSG_ISLOCK, hash);
-    if (tx != nullptr) {
-        g_connman->RelayInvFiltered(inv, *tx, LLMQS_PROTO_VERSION);
-    } else {
-        // we don't have the TX yet, so we only filter based on txid. Later when that TX arrives, we will re-announce
-        // with the TX taken into account.
-        g_connman->RelayInvFiltered(inv, islock->txid, LLMQS_PROTO_VERSION);
+            // We don't need the recovered sigs for the inputs anymore. This prevents unnecessary propagation of these sigs.
+            // We only need the ISLOCK from now on to detect conflicts
+            TruncateRecoveredSigsForInputs(*entry.islock);
+        }
     }
 
-    ResolveBlockConflicts(hash, *islock);
-    RemoveMempoolConflictsForLock(hash, *islock);
+    for (const auto& entry : entries) {
+        CInv inv(MSG_ISLOCK, entry.hash);
+        if (entry.tx != nullptr) {
+            g_connman->RelayInvFiltered(inv, entry.tx, LLMQS_PROTO_VERSION);
+        } else {
+            // we don't have the TX yet, so we only filter based on txid. Later when that TX arrives, we will re-announce
+            // with the TX taken into account.
+            g_connman->RelayInvFiltered(inv, entry.islock->txid, LLMQS_PROTO_VERSION);
+        }
 
-    if (tx != nullptr) {
-        LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- notify about an in-time lock for tx %s\n", __func__, tx->GetHash().ToString());
-        GetMainSignals().NotifyTransactionLock(tx, islock);
-        // bump mempool counter to make sure newly locked txes are picked up by getblocktemplate
-        mempool.AddTransactionsUpdated(1);
+        ResolveBlockConflicts(entry.hash, *entry.islock);
+        RemoveMempoolConflictsForLock(entry.hash, *entry.islock);
+        TRACE4(instantsend, islock_processed, entry.islock->txid.begin(), entry.hash.begin(), entry.from, entry.tx != nullptr);
+
+        if (entry.tx != nullptr) {
+            LogPrint(BCLog::INSTANTSEND, "CInstantSendManager::%s -- notify about an in-time lock for tx %s\n", __func__, entry.tx->GetHash().ToString());
+            GetMainSignals().NotifyTransactionLock(entry.tx, entry.islock);
+            // bump mempool counter to make sure newly locked txes are picked up by getblocktemplate
+            mempool.AddTransactionsUpdated(1);
+        }
     }
 }
 
@@ -1097,14 +1354,17 @@ void CInstantSendManager::BlockConnected(const std::shared_ptr<const CBlock>& pb
     }
 
     if (masternodeSync.IsBlockchainSynced()) {
+        const bool fChainLocked = chainLocksHandler->HasChainLock(pindex->nHeight, pindex->GetBlockHash());
+        // Not yet locked TXs, which we try to lock retroactively in one batch
+        std::vector<CTransactionRef> vecNonLocked;
         for (const auto& tx : pblock->vtx) {
             if (tx->IsCoinBase() || tx->vin.empty()) {
                 // coinbase and TXs with no inputs can't be locked
                 continue;
             }
 
-            if (!IsLocked(tx->GetHash()) && !chainLocksHandler->HasChainLock(pindex->nHeight, pindex->GetBlockHash())) {
-                ProcessTx(*tx, true, Params().GetConsensus());
+            if (!IsLocked(tx->GetHash()) && !fChainLocked) {
+                vecNonLocked.emplace_back(tx);
                 // TX is not locked, so make sure it is tracked
                 LOCK(cs);
                 AddNonLockedTx(tx, pindex);
@@ -1114,6 +1374,7 @@ void CInstantSendManager::BlockConnected(const std::shared_ptr<const CBlock>& pb
                 RemoveNonLockedTx(tx->GetHash(), true);
             }
         }
+        ProcessTxs(vecNonLocked, true, Params().GetConsensus());
     }
 
     LOCK(cs);
@@ -1576,17 +1837,25 @@ CInstantSendLockPtr CInstantSendManager::GetConflictingLock(const CTransaction&
     }
 
     LOCK(cs);
-    for (const auto& in : tx.vin) {
-        auto otherIsLock = db.GetInstantSendLockByInput(in.prevout);
-        if (!otherIsLock) {
-            continue;
-        }
+    uint256 islockHash = db.GetConflictingLockHash(tx);
+    if (islockHash.IsNull()) {
+        return nullptr;
+    }
+    return db.GetInstantSendLockByHash(islockHash);
+}
 
-        if (otherIsLock->txid != tx.GetHash()) {
-            return otherIsLock;
+void CInstantSendManager::GetTxsForCompactBlocks(std::vector<std::pair<uint256, CTransactionRef>>& vtx) const
+{
+    LOCK(cs);
+    vtx.reserve(vtx.size() + recentlyLockedTxs.size() + nonLockedTxs.size());
+    for (const auto& tx : recentlyLockedTxs) {
+        vtx.emplace_back(tx->GetHash(), tx);
+    }
+    for (const auto& p : nonLockedTxs) {
+        if (p.second.tx != nullptr) {
+            vtx.emplace_back(p.first, p.second.tx);
         }
     }
-    return nullptr;
 }
 
 size_t CInstantSendManager::GetInstantSendLockCount() const
@@ -1594,6 +1863,33 @@ size_t CInstantSendManager::GetInstantSendLockCount() const
     return db.GetInstantSendLockCount();
 }
 
+CInstantSendDbCacheStats CInstantSendManager::GetCacheStats() const
+{
+    LOCK(cs);
+    return db.GetCacheStats();
+}
+
+size_t CInstantSendManager::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    size_t ret = db.DynamicMemoryUsage();
+    ret += memusage::DynamicUsage(inputRequestIds) + memusage::DynamicUsage(creatingInstantSendLocks) +
+           memusage::DynamicUsage(txToCreatingInstantSendLocks) + memusage::DynamicUsage(pendingInstantSendLocks);
+    for (const auto& p : creatingInstantSendLocks) {
+        ret += memusage::DynamicUsage(p.second.inputs);
+    }
+    for (const auto& p : pendingInstantSendLocks) {
+        ret += memusage::DynamicUsage(p.second.second) + memusage::DynamicUsage(p.second.second->inputs);
+    }
+    ret += memusage::DynamicUsage(nonLockedTxs) + memusage::DynamicUsage(nonLockedTxsByOutpoints);
+    for (const auto& p : nonLockedTxs) {
+        // the transactions themselves are shared with the mempool
+        ret += memusage::DynamicUsage(p.second.children);
+    }
+    ret += memusage::DynamicUsage(pendingRetryTxs) + memusage::DynamicUsage(recentlyLockedTxs);
+    return ret;
+}
+
 void CInstantSendManager::WorkThreadMain()
 {
     while (!workInterrupt) {
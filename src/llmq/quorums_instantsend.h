@@ -40,26 +40,74 @@ public:
 
 typedef std::shared_ptr<CInstantSendLock> CInstantSendLockPtr;
 
+/** Default for -iscachesize, in MiB */
+static const int64_t DEFAULT_INSTANTSEND_CACHE_SIZE = 16;
+
+struct CInstantSendCacheStats {
+    uint64_t nHits{0};
+    uint64_t nMisses{0};
+    size_t nEntries{0};
+    size_t nMaxEntries{0};
+};
+
+struct CInstantSendDbCacheStats {
+    size_t nCacheSizeBytes{0};
+    CInstantSendCacheStats islocks;
+    CInstantSendCacheStats txids;
+    size_t nLockedOutpoints{0};
+};
+
 class CInstantSendDb
 {
 private:
     static const int CURRENT_VERSION = 1;
 
+    /**
+     * Rough memory usage of a single cache entry, including the hash map node. An islock is usually referenced by
+     * one txid entry, which is what the cache budget is split by.
+     */
+    static const size_t ISLOCK_CACHE_ENTRY_BYTES = 400;
+    static const size_t HASH_CACHE_ENTRY_BYTES = 128;
+
     CDBWrapper& db;
 
-    mutable unordered_lru_cache<uint256, CInstantSendLockPtr, StaticSaltedHasher, 10000> islockCache;
-    mutable unordered_lru_cache<uint256, uint256, StaticSaltedHasher, 10000> txidCache;
-    mutable unordered_lru_cache<COutPoint, uint256, SaltedOutpointHasher, 10000> outpointCache;
+    const size_t nCacheSizeBytes;
+    mutable unordered_lru_cache<uint256, CInstantSendLockPtr, StaticSaltedHasher> islockCache;
+    mutable unordered_lru_cache<uint256, uint256, StaticSaltedHasher> txidCache;
+
+    mutable uint64_t islockCacheHits{0};
+    mutable uint64_t islockCacheMisses{0};
+    mutable uint64_t txidCacheHits{0};
+    mutable uint64_t txidCacheMisses{0};
+
+    // Number of islocks the caches can hold within nCacheSizeBytes
+    static size_t GetCacheEntries(size_t nCacheSizeBytes);
+
+    struct LockedOutpoint {
+        uint256 islockHash;
+        uint256 txid;
+    };
+    /**
+     * All inputs of the islocks we currently hold in DB_ISLOCK_BY_HASH, mapped to the islock that locks them. Unlike
+     * the caches above this is complete, so conflict checks never have to go to the database. It only grows with the
+     * number of not yet confirmed islocks, as confirmed ones are removed from the db.
+     */
+    std::unordered_map<COutPoint, LockedOutpoint, SaltedOutpointHasher> lockedOutpoints;
+
+    void LoadLockedOutpoints();
+    void AddLockedOutpoints(const uint256& hash, const CInstantSendLock& islock);
+    void RemoveLockedOutpoints(const CInstantSendLock& islock);
 
     void WriteInstantSendLockMined(CDBBatch& batch, const uint256& hash, int nHeight);
     void RemoveInstantSendLockMined(CDBBatch& batch, const uint256& hash, int nHeight);
 
 public:
-    explicit CInstantSendDb(CDBWrapper& _db);
+    CInstantSendDb(CDBWrapper& _db, size_t _nCacheSizeBytes);
 
     void Upgrade();
 
-    void WriteNewInstantSendLock(const uint256& hash, const CInstantSendLock& islock);
+    // Writes all given locks in one batch. The int is the height of the block the TX was mined in or -1 if it's not mined
+    void WriteNewInstantSendLocks(const std::vector<std::tuple<uint256, CInstantSendLockPtr, int>>& islocks);
     void RemoveInstantSendLock(CDBBatch& batch, const uint256& hash, CInstantSendLockPtr islock, bool keep_cache = true);
 
     void WriteInstantSendLockMined(const uint256& hash, int nHeight);
@@ -73,11 +121,18 @@ public:
 
     CInstantSendLockPtr GetInstantSendLockByHash(const uint256& hash, bool use_cache = true) const;
     uint256 GetInstantSendLockHashByTxid(const uint256& txid) const;
+    /** Read the islock hashes of the txids that aren't cached yet in one pass over the database */
+    void CacheInstantSendLockHashesByTxid(const std::vector<uint256>& txids) const;
     CInstantSendLockPtr GetInstantSendLockByTxid(const uint256& txid) const;
     CInstantSendLockPtr GetInstantSendLockByInput(const COutPoint& outpoint) const;
+    /** Returns the hash of an islock which locks one of the inputs of tx but not tx itself, or a null hash */
+    uint256 GetConflictingLockHash(const CTransaction& tx) const;
 
     std::vector<uint256> GetInstantSendLocksByParent(const uint256& parent) const;
     std::vector<uint256> RemoveChainedInstantSendLocks(const uint256& islockHash, const uint256& txid, int nHeight);
+
+    CInstantSendDbCacheStats GetCacheStats() const;
+    size_t DynamicMemoryUsage() const;
 };
 
 class CInstantSendManager : public CRecoveredSigsListener
@@ -121,8 +176,16 @@ private:
 
     std::unordered_set<uint256, StaticSaltedHasher> pendingRetryTxs;
 
+    /**
+     * Ring buffer of the most recent unmined TXs that got an islock. Used for compact block reconstruction, as a
+     * locked TX is expected to be mined soon even if it dropped out of the mempool in the meantime.
+     */
+    static const size_t MAX_RECENTLY_LOCKED_TXS = 1000;
+    std::vector<CTransactionRef> recentlyLockedTxs;
+    size_t recentlyLockedTxsIt{0};
+
 public:
-    explicit CInstantSendManager(CDBWrapper& _llmqDb);
+    CInstantSendManager(CDBWrapper& _llmqDb, size_t nCacheSizeBytes);
     ~CInstantSendManager();
 
     void Start();
@@ -131,6 +194,9 @@ public:
 
 public:
     void ProcessTx(const CTransaction& tx, bool fRetroactive, const Consensus::Params& params);
+    // Same as ProcessTx for all TXs of a block, with the islock lookups and the input lock signing requests of all
+    // TXs done in one batch
+    void ProcessTxs(const std::vector<CTransactionRef>& txs, bool fRetroactive, const Consensus::Params& params);
     bool CheckCanLock(const CTransaction& tx, bool printDebug, const Consensus::Params& params) const;
     bool CheckCanLock(const COutPoint& outpoint, bool printDebug, const uint256& txHash, CAmount* retValue, const Consensus::Params& params) const;
     bool IsLocked(const uint256& txHash) const;
@@ -141,7 +207,10 @@ public:
     void HandleNewInputLockRecoveredSig(const CRecoveredSig& recoveredSig, const uint256& txid);
     void HandleNewInstantSendLockRecoveredSig(const CRecoveredSig& recoveredSig);
 
-    bool TrySignInputLocks(const CTransaction& tx, bool allowResigning, Consensus::LLMQType llmqType);
+    // Checks whether tx can be locked and appends the signing requests for its input locks to vecRequests. Returns
+    // true if tx is or is going to be voted on, and TrySignInstantSendLock should be tried once the requests are sent
+    bool PrepareTx(const CTransaction& tx, bool fRetroactive, Consensus::LLMQType llmqType, const Consensus::Params& params, std::vector<CSigningRequest>& vecRequests);
+    bool TrySignInputLocks(const CTransaction& tx, bool allowResigning, Consensus::LLMQType llmqType, std::vector<CSigningRequest>& vecRequests);
     void TrySignInstantSendLock(const CTransaction& tx);
 
     void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
@@ -150,6 +219,7 @@ public:
     bool ProcessPendingInstantSendLocks();
     std::unordered_set<uint256> ProcessPendingInstantSendLocks(int signOffset, const std::unordered_map<uint256, std::pair<NodeId, CInstantSendLockPtr>, StaticSaltedHasher>& pend, bool ban);
     void ProcessInstantSendLock(NodeId from, const uint256& hash, const CInstantSendLockPtr& islock);
+    void ProcessInstantSendLocks(const std::vector<std::tuple<NodeId, uint256, CInstantSendLockPtr>>& islocks);
 
     void TransactionAddedToMempool(const CTransactionRef& tx);
     void TransactionRemovedFromMempool(const CTransactionRef& tx);
@@ -178,6 +248,11 @@ public:
     bool GetInstantSendLockHashByTxid(const uint256& txid, uint256& ret) const;
 
     size_t GetInstantSendLockCount() const;
+    CInstantSendDbCacheStats GetCacheStats() const;
+    size_t DynamicMemoryUsage() const;
+
+    /** Append the TXs known to InstantSend (recently locked or waiting for a lock) in <hash, reference> form */
+    void GetTxsForCompactBlocks(std::vector<std::pair<uint256, CTransactionRef>>& vtx) const;
 
     void WorkThreadMain();
 };
@@ -2,19 +2,26 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <llmq/quorums_init.h>
 #include <llmq/quorums_signing.h>
 #include <llmq/quorums_utils.h>
 #include <llmq/quorums_signing_shares.h>
+#include <llmq/quorums_signing_stats.h>
 
 #include <masternode/activemasternode.h>
 #include <bls/bls_batchverifier.h>
+#include <bls/bls_sigcache.h>
 #include <cxxtimer.hpp>
+#include <hash.h>
 #include <net_processing.h>
+#include <random.h>
 #include <netmessagemaker.h>
 #include <scheduler.h>
 #include <validation.h>
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <unordered_set>
 
 namespace llmq
@@ -34,20 +41,151 @@ UniValue CRecoveredSig::ToJson() const
     return ret;
 }
 
-CRecoveredSigsDb::CRecoveredSigsDb(CDBWrapper& _db) :
-    db(_db)
+CRecoveredSigsFilter::CRecoveredSigsFilter(size_t _nMaxElements, double fpRate) :
+    k0(GetRand(std::numeric_limits<uint64_t>::max())),
+    k1(GetRand(std::numeric_limits<uint64_t>::max())),
+    nMaxElements(_nMaxElements)
 {
-    if (Params().NetworkIDString() == CBaseChainParams::TESTNET) {
-        // TODO this can be completely removed after some time (when we're pretty sure the conversion has been run on most testnet MNs)
-        if (db.Exists(std::string("rs_upgraded"))) {
-            return;
+    // see CRollingBloomFilter for the math
+    double logFpRate = log(fpRate);
+    nHashFuncs = std::max(1, std::min((int)round(logFpRate / log(0.5)), 50));
+    nBits = (uint64_t)ceil(-1.0 * nHashFuncs * nMaxElements / log(1.0 - exp(logFpRate / nHashFuncs)));
+    data.resize((nBits + 63) / 64);
+    nBits = data.size() * 64;
+}
+
+// A single SipHash per key, the bit positions are derived from it by double hashing
+void CRecoveredSigsFilter::insert(KeyType keyType, const uint256& key, Consensus::LLMQType llmqType)
+{
+    uint64_t h = SipHashUint256Extra(k0, k1, key, ((uint32_t)keyType << 8) | (uint8_t)llmqType);
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    for (int n = 0; n < nHashFuncs; n++) {
+        uint64_t pos = ((uint64_t)h1 + (uint64_t)n * h2) % nBits;
+        data[pos >> 6] |= (uint64_t)1 << (pos & 63);
+    }
+    nElements++;
+}
+
+bool CRecoveredSigsFilter::contains(KeyType keyType, const uint256& key, Consensus::LLMQType llmqType) const
+{
+    uint64_t h = SipHashUint256Extra(k0, k1, key, ((uint32_t)keyType << 8) | (uint8_t)llmqType);
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    for (int n = 0; n < nHashFuncs; n++) {
+        uint64_t pos = ((uint64_t)h1 + (uint64_t)n * h2) % nBits;
+        if (!((data[pos >> 6] >> (pos & 63)) & 1)) {
+            return false;
         }
+    }
+    return true;
+}
 
+CRecoveredSigsDb::CRecoveredSigsDb(CDBWrapper& _db) :
+    db(_db)
+{
+    // TODO this can be completely removed after some time (when we're pretty sure the conversion has been run on most testnet MNs)
+    if (Params().NetworkIDString() == CBaseChainParams::TESTNET && !db.Exists(std::string("rs_upgraded"))) {
         ConvertInvalidTimeKeys();
         AddVoteTimeKeys();
 
         db.Write(std::string("rs_upgraded"), (uint8_t)1);
     }
+
+    RebuildFilter();
+}
+
+bool CRecoveredSigsDb::IsFilterFull()
+{
+    LOCK(cs);
+    return filter->IsFull();
+}
+
+// Fills a new filter from all recovered sigs in the db and replaces the old filter with it. Sigs written while this is
+// running are added to both filters
+void CRecoveredSigsDb::RebuildFilter()
+{
+    {
+        LOCK(cs);
+        size_t nMaxElements = RECOVERED_SIGS_FILTER_MIN_ELEMENTS;
+        if (filter) {
+            nMaxElements = std::max(nMaxElements, filter->GetElementCount() * 2);
+        }
+        rebuildingFilter = std::make_unique<CRecoveredSigsFilter>(nMaxElements, RECOVERED_SIGS_FILTER_FP_RATE);
+    }
+
+    struct Entry {
+        CRecoveredSigsFilter::KeyType keyType;
+        uint256 key;
+        Consensus::LLMQType llmqType;
+    };
+    std::vector<Entry> entries;
+    size_t cnt = 0;
+    auto flush = [&]() {
+        LOCK(cs);
+        for (const auto& e : entries) {
+            rebuildingFilter->insert(e.keyType, e.key, e.llmqType);
+        }
+        cnt += entries.size();
+        entries.clear();
+    };
+
+    // the iterator must be created after rebuildingFilter, so that it sees everything that was not added to it
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
+
+    // this also visits the ("rs_r", llmqType, id, msgHash) keys, which just add the same id again
+    auto startId = std::make_tuple(std::string("rs_r"), (Consensus::LLMQType)0, uint256());
+    pcursor->Seek(startId);
+    while (pcursor->Valid()) {
+        decltype(startId) k;
+        if (!pcursor->GetKey(k) || std::get<0>(k) != "rs_r") {
+            break;
+        }
+        entries.push_back({CRecoveredSigsFilter::KEY_ID, std::get<2>(k), std::get<1>(k)});
+        if (entries.size() >= 10000) {
+            flush();
+        }
+        pcursor->Next();
+    }
+
+    for (const auto& p : {std::make_pair(std::string("rs_s"), CRecoveredSigsFilter::KEY_SIGN_HASH),
+                          std::make_pair(std::string("rs_h"), CRecoveredSigsFilter::KEY_HASH)}) {
+        auto start = std::make_tuple(p.first, uint256());
+        pcursor->Seek(start);
+        while (pcursor->Valid()) {
+            decltype(start) k;
+            if (!pcursor->GetKey(k) || std::get<0>(k) != p.first) {
+                break;
+            }
+            entries.push_back({p.second, std::get<1>(k), Consensus::LLMQ_NONE});
+            if (entries.size() >= 10000) {
+                flush();
+            }
+            pcursor->Next();
+        }
+    }
+    pcursor.reset();
+    flush();
+
+    {
+        LOCK(cs);
+        filter = std::move(rebuildingFilter);
+    }
+
+    LogPrint(BCLog::LLMQ, "CRecoveredSigsDb::%s -- added %d entries to filter\n", __func__, cnt);
+}
+
+void CRecoveredSigsDb::AddToFilter(const CRecoveredSig& recSig, const uint256& signHash)
+{
+    AssertLockHeld(cs);
+
+    for (auto* f : {filter.get(), rebuildingFilter.get()}) {
+        if (f) {
+            f->insert(CRecoveredSigsFilter::KEY_ID, recSig.id, (Consensus::LLMQType)recSig.llmqType);
+            f->insert(CRecoveredSigsFilter::KEY_SIGN_HASH, signHash);
+            f->insert(CRecoveredSigsFilter::KEY_HASH, recSig.GetHash());
+        }
+    }
 }
 
 // This converts time values in "rs_t" from host endiannes to big endiannes, which is required to have proper ordering of the keys
@@ -125,6 +263,13 @@ void CRecoveredSigsDb::AddVoteTimeKeys()
 
 bool CRecoveredSigsDb::HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
+    {
+        LOCK(cs);
+        if (!filter->contains(CRecoveredSigsFilter::KEY_ID, id, llmqType)) {
+            return false;
+        }
+    }
+
     auto k = std::make_tuple(std::string("rs_r"), llmqType, id, msgHash);
     return db.Exists(k);
 }
@@ -138,6 +283,9 @@ bool CRecoveredSigsDb::HasRecoveredSigForId(Consensus::LLMQType llmqType, const
         if (hasSigForIdCache.get(cacheKey, ret)) {
             return ret;
         }
+        if (!filter->contains(CRecoveredSigsFilter::KEY_ID, id, llmqType)) {
+            return false;
+        }
     }
 
 
@@ -157,6 +305,9 @@ bool CRecoveredSigsDb::HasRecoveredSigForSession(const uint256& signHash)
         if (hasSigForSessionCache.get(signHash, ret)) {
             return ret;
         }
+        if (!filter->contains(CRecoveredSigsFilter::KEY_SIGN_HASH, signHash)) {
+            return false;
+        }
     }
 
     auto k = std::make_tuple(std::string("rs_s"), signHash);
@@ -175,6 +326,9 @@ bool CRecoveredSigsDb::HasRecoveredSigForHash(const uint256& hash)
         if (hasSigForHashCache.get(hash, ret)) {
             return ret;
         }
+        if (!filter->contains(CRecoveredSigsFilter::KEY_HASH, hash)) {
+            return false;
+        }
     }
 
     auto k = std::make_tuple(std::string("rs_h"), hash);
@@ -249,6 +403,7 @@ void CRecoveredSigsDb::WriteRecoveredSig(const llmq::CRecoveredSig& recSig)
 
     {
         LOCK(cs);
+        AddToFilter(recSig, signHash);
         hasSigForIdCache.insert(std::make_pair((Consensus::LLMQType)recSig.llmqType, recSig.id), true);
         hasSigForSessionCache.insert(signHash, true);
         hasSigForHashCache.insert(recSig.GetHash(), true);
@@ -314,12 +469,26 @@ void CRecoveredSigsDb::TruncateRecoveredSig(Consensus::LLMQType llmqType, const
     db.WriteBatch(batch);
 }
 
+// Returns the end of the last bucket that is completely older than maxAge
+static uint32_t GetCleanupEndTime(int64_t maxAge)
+{
+    uint32_t endTime = (uint32_t)(GetAdjustedTime() - maxAge);
+    return endTime - (endTime % RECOVERED_SIGS_CLEANUP_BUCKET);
+}
+
+// Old recovered sigs are only removed once a whole bucket of them has expired. Cleanup then removes all of them in one
+// go and compacts the range of the removed "rs_t" keys, instead of iterating and deleting a few entries every time it
+// is called while new recovered sigs are written.
 void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
 {
+    uint32_t endTime = GetCleanupEndTime(maxAge);
+    if (endTime <= recSigsCleanedUntil) {
+        return;
+    }
+
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
 
     auto start = std::make_tuple(std::string("rs_t"), (uint32_t)0, (Consensus::LLMQType)0, uint256());
-    uint32_t endTime = (uint32_t)(GetAdjustedTime() - maxAge);
     pcursor->Seek(start);
 
     std::vector<std::pair<Consensus::LLMQType, uint256>> toDelete;
@@ -342,6 +511,8 @@ void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
     }
     pcursor.reset();
 
+    recSigsCleanedUntil = endTime;
+
     if (toDelete.empty()) {
         return;
     }
@@ -364,6 +535,7 @@ void CRecoveredSigsDb::CleanupOldRecoveredSigs(int64_t maxAge)
     }
 
     db.WriteBatch(batch);
+    db.CompactRange(start, std::make_tuple(std::string("rs_t"), (uint32_t)htobe32(endTime), (Consensus::LLMQType)0, uint256()));
 
     LogPrint(BCLog::LLMQ, "CRecoveredSigsDb::%d -- deleted %d entries\n", __func__, toDelete.size());
 }
@@ -392,12 +564,17 @@ void CRecoveredSigsDb::WriteVoteForId(Consensus::LLMQType llmqType, const uint25
     db.WriteBatch(batch);
 }
 
+// Same as CleanupOldRecoveredSigs, votes are removed in whole buckets
 void CRecoveredSigsDb::CleanupOldVotes(int64_t maxAge)
 {
+    uint32_t endTime = GetCleanupEndTime(maxAge);
+    if (endTime <= votesCleanedUntil) {
+        return;
+    }
+
     std::unique_ptr<CDBIterator> pcursor(db.NewIterator());
 
     auto start = std::make_tuple(std::string("rs_vt"), (uint32_t)0, (Consensus::LLMQType)0, uint256());
-    uint32_t endTime = (uint32_t)(GetAdjustedTime() - maxAge);
     pcursor->Seek(start);
 
     CDBBatch batch(db);
@@ -424,11 +601,14 @@ void CRecoveredSigsDb::CleanupOldVotes(int64_t maxAge)
     }
     pcursor.reset();
 
+    votesCleanedUntil = endTime;
+
     if (cnt == 0) {
         return;
     }
 
     db.WriteBatch(batch);
+    db.CompactRange(start, std::make_tuple(std::string("rs_vt"), (uint32_t)htobe32(endTime), (Consensus::LLMQType)0, uint256()));
 
     LogPrint(BCLog::LLMQ, "CRecoveredSigsDb::%d -- deleted %d entries\n", __func__, cnt);
 }
@@ -733,9 +913,13 @@ void CSigningManager::ProcessRecoveredSig(const std::shared_ptr<const CRecovered
         });
     }
 
+    auto signHash = CLLMQUtils::BuildSignHash(*recoveredSig);
+    quorumSigningStats->AddStage(llmqType, signHash, SigStage::RECOVERED);
+
     for (auto& l : listeners) {
         l->HandleNewRecoveredSig(*recoveredSig);
     }
+    quorumSigningStats->AddStage(llmqType, signHash, SigStage::PROCESSED);
 
     GetMainSignals().NotifyRecoveredSig(recoveredSig);
 }
@@ -762,6 +946,10 @@ void CSigningManager::Cleanup()
 
     db.CleanupOldRecoveredSigs(maxAge);
     db.CleanupOldVotes(maxAge);
+    if (db.IsFilterFull()) {
+        // this also drops the sigs which were removed in the meantime
+        db.RebuildFilter();
+    }
 
     lastCleanupTime = GetTimeMillis();
 }
@@ -840,11 +1028,86 @@ bool CSigningManager::AsyncSignIfMember(Consensus::LLMQType llmqType, const uint
         // make us re-announce all known shares (other nodes might have run into a timeout)
         quorumSigSharesManager->ForceReAnnouncement(quorum, llmqType, id, msgHash);
     }
+    quorumSigningStats->AddStage(llmqType, CLLMQUtils::BuildSignHash(llmqType, quorum->qc.quorumHash, id, msgHash), SigStage::REQUESTED);
     quorumSigSharesManager->AsyncSign(quorum, id, msgHash);
 
     return true;
 }
 
+std::vector<bool> CSigningManager::AsyncSignIfMember(Consensus::LLMQType llmqType, const std::vector<CSigningRequest>& vecRequests, bool allowReSign)
+{
+    std::vector<bool> ret(vecRequests.size(), false);
+    if (!fMasternodeMode || activeMasternodeInfo.proTxHash.IsNull()) {
+        return ret;
+    }
+
+    std::vector<CQuorumCPtr> quorums(vecRequests.size());
+    std::vector<uint256> selectionHashes;
+    std::vector<size_t> vecSelected;
+    for (size_t i = 0; i < vecRequests.size(); i++) {
+        if (vecRequests[i].quorumHash.IsNull()) {
+            selectionHashes.emplace_back(vecRequests[i].id);
+            vecSelected.emplace_back(i);
+        } else {
+            quorums[i] = quorumManager->GetQuorum(llmqType, vecRequests[i].quorumHash);
+        }
+    }
+    if (!selectionHashes.empty()) {
+        auto selected = SelectQuorumsForSigning(llmqType, selectionHashes);
+        for (size_t i = 0; i < vecSelected.size(); i++) {
+            quorums[vecSelected[i]] = selected[i];
+        }
+    }
+
+    std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>> vecSigns;
+    {
+        LOCK(cs);
+        for (size_t i = 0; i < vecRequests.size(); i++) {
+            const auto& id = vecRequests[i].id;
+            const auto& msgHash = vecRequests[i].msgHash;
+            if (!quorums[i]) {
+                LogPrint(BCLog::LLMQ, "CSigningManager::%s -- failed to select quorum. id=%s, msgHash=%s\n", __func__, id.ToString(), msgHash.ToString());
+                continue;
+            }
+            if (!quorums[i]->IsValidMember(activeMasternodeInfo.proTxHash)) {
+                continue;
+            }
+            uint256 prevMsgHash;
+            bool hasVoted = db.GetVoteForId(llmqType, id, prevMsgHash);
+            if (hasVoted) {
+                if (msgHash != prevMsgHash) {
+                    LogPrintf("CSigningManager::%s -- already voted for id=%s and msgHash=%s. Not voting on conflicting msgHash=%s\n", __func__,
+                            id.ToString(), prevMsgHash.ToString(), msgHash.ToString());
+                    continue;
+                } else if (!allowReSign) {
+                    continue;
+                }
+            }
+            ret[i] = true;
+            if (db.HasRecoveredSigForId(llmqType, id)) {
+                // no need to sign it if we already have a recovered sig
+                continue;
+            }
+            if (!hasVoted) {
+                db.WriteVoteForId(llmqType, id, msgHash);
+            }
+            vecSigns.emplace_back(quorums[i], id, msgHash);
+        }
+    }
+
+    for (const auto& sign : vecSigns) {
+        const auto& quorum = std::get<0>(sign);
+        if (allowReSign) {
+            // make us re-announce all known shares (other nodes might have run into a timeout)
+            quorumSigSharesManager->ForceReAnnouncement(quorum, llmqType, std::get<1>(sign), std::get<2>(sign));
+        }
+        quorumSigningStats->AddStage(llmqType, CLLMQUtils::BuildSignHash(llmqType, quorum->qc.quorumHash, std::get<1>(sign), std::get<2>(sign)), SigStage::REQUESTED);
+    }
+    quorumSigSharesManager->AsyncSign(vecSigns);
+
+    return ret;
+}
+
 bool CSigningManager::HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash)
 {
     return db.HasRecoveredSig(llmqType, id, msgHash);
@@ -896,6 +1159,12 @@ bool CSigningManager::GetVoteForId(Consensus::LLMQType llmqType, const uint256&
 
 CQuorumCPtr CSigningManager::SelectQuorumForSigning(Consensus::LLMQType llmqType, const uint256& selectionHash, int signHeight, int signOffset)
 {
+    return SelectQuorumsForSigning(llmqType, std::vector<uint256>{selectionHash}, signHeight, signOffset).front();
+}
+
+std::vector<CQuorumCPtr> CSigningManager::SelectQuorumsForSigning(Consensus::LLMQType llmqType, const std::vector<uint256>& selectionHashes, int signHeight, int signOffset)
+{
+    std::vector<CQuorumCPtr> ret(selectionHashes.size());
     auto& llmqParams = Params().GetConsensus().llmqs.at(llmqType);
     size_t poolSize = (size_t)llmqParams.signingActiveQuorumCount;
 
@@ -907,27 +1176,32 @@ CQuorumCPtr CSigningManager::SelectQuorumForSigning(Consensus::LLMQType llmqType
         }
         int startBlockHeight = signHeight - signOffset;
         if (startBlockHeight > chainActive.Height() || startBlockHeight < 0) {
-            return {};
+            return ret;
         }
         pindexStart = chainActive[startBlockHeight];
     }
 
     auto quorums = quorumManager->ScanQuorums(llmqType, pindexStart, poolSize);
     if (quorums.empty()) {
-        return nullptr;
+        return ret;
     }
 
-    std::vector<std::pair<uint256, size_t>> scores;
-    scores.reserve(quorums.size());
-    for (size_t i = 0; i < quorums.size(); i++) {
-        CHashWriter h(SER_NETWORK, 0);
-        h << llmqType;
-        h << quorums[i]->qc.quorumHash;
-        h << selectionHash;
-        scores.emplace_back(h.GetHash(), i);
+    for (size_t j = 0; j < selectionHashes.size(); j++) {
+        // the quorum with the lowest score wins
+        uint256 bestScore;
+        for (size_t i = 0; i < quorums.size(); i++) {
+            CHashWriter h(SER_NETWORK, 0);
+            h << llmqType;
+            h << quorums[i]->qc.quorumHash;
+            h << selectionHashes[j];
+            uint256 score = h.GetHash();
+            if (!ret[j] || score < bestScore) {
+                bestScore = score;
+                ret[j] = quorums[i];
+            }
+        }
     }
-    std::sort(scores.begin(), scores.end());
-    return quorums[scores.front().second];
+    return ret;
 }
 
 bool CSigningManager::VerifyRecoveredSig(Consensus::LLMQType llmqType, int signedAtHeight, const uint256& id, const uint256& msgHash, const CBLSSignature& sig, const int signOffset)
@@ -938,7 +1212,58 @@ bool CSigningManager::VerifyRecoveredSig(Consensus::LLMQType llmqType, int signe
     }
 
     uint256 signHash = CLLMQUtils::BuildSignHash(llmqType, quorum->qc.quorumHash, id, msgHash);
-    return sig.VerifyInsecure(quorum->qc.quorumPublicKey, signHash);
+    return BLSCachedVerifyInsecure(sig, quorum->qc.quorumPublicKey, signHash);
+}
+
+std::vector<bool> CSigningManager::VerifyRecoveredSigs(Consensus::LLMQType llmqType, const std::vector<CRecoveredSigVerifyRequest>& vecRequests, const int signOffset)
+{
+    std::vector<bool> ret(vecRequests.size(), false);
+
+    std::map<int, std::vector<size_t>> mapByHeight;
+    for (size_t i = 0; i < vecRequests.size(); i++) {
+        mapByHeight[vecRequests[i].signHeight].emplace_back(i);
+    }
+
+    // These signatures come from RPC callers, which could craft invalid ones that cancel each other out in a plain
+    // aggregate. So they are verified through the randomized batches of the BLS workers instead of CBLSBatchVerifier
+    BLSSignatureVector sigs;
+    BLSPublicKeyVector pubKeys;
+    std::vector<uint256> signHashes;
+    std::vector<size_t> vecIndexes;
+    for (const auto& p : mapByHeight) {
+        std::vector<uint256> selectionHashes;
+        selectionHashes.reserve(p.second.size());
+        for (size_t i : p.second) {
+            selectionHashes.emplace_back(vecRequests[i].id);
+        }
+        auto quorums = SelectQuorumsForSigning(llmqType, selectionHashes, p.first, signOffset);
+        for (size_t j = 0; j < quorums.size(); j++) {
+            const auto& req = vecRequests[p.second[j]];
+            if (!quorums[j] || !req.sig.IsValid()) {
+                continue;
+            }
+            uint256 signHash = CLLMQUtils::BuildSignHash(llmqType, quorums[j]->qc.quorumHash, req.id, req.msgHash);
+            if (BLSSignatureCacheContains(quorums[j]->qc.quorumPublicKey, signHash, req.sig)) {
+                ret[p.second[j]] = true;
+                continue;
+            }
+            sigs.emplace_back(req.sig);
+            pubKeys.emplace_back(quorums[j]->qc.quorumPublicKey);
+            signHashes.emplace_back(signHash);
+            vecIndexes.emplace_back(p.second[j]);
+        }
+    }
+
+    if (!sigs.empty()) {
+        auto valid = blsWorker->VerifySignatures(sigs, pubKeys, signHashes);
+        for (size_t i = 0; i < valid.size(); i++) {
+            if (valid[i]) {
+                BLSSignatureCacheAdd(pubKeys[i], signHashes[i], sigs[i]);
+                ret[vecIndexes[i]] = true;
+            }
+        }
+    }
+    return ret;
 }
 
 } // namespace llmq
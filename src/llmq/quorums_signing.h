@@ -12,6 +12,7 @@
 #include <univalue.h>
 #include <unordered_lru_cache.h>
 
+#include <memory>
 #include <unordered_map>
 
 typedef int64_t NodeId;
@@ -20,6 +21,11 @@ namespace llmq
 {
 // Keep recovered signatures for a week. This is a "-maxrecsigsage" option default.
 static const int64_t DEFAULT_MAX_RECOVERED_SIGS_AGE = 60 * 60 * 24 * 7;
+// Old recovered sigs and votes are deleted in whole buckets of this many seconds
+static const uint32_t RECOVERED_SIGS_CLEANUP_BUCKET = 60 * 60;
+// The recovered sigs filter starts with room for this many entries (3 per recovered sig) and is rebuilt when it's full
+static const size_t RECOVERED_SIGS_FILTER_MIN_ELEMENTS = 1000000;
+static const double RECOVERED_SIGS_FILTER_FP_RATE = 0.001;
 
 
 class CRecoveredSig
@@ -65,6 +71,40 @@ public:
     UniValue ToJson() const;
 };
 
+/**
+ * Bloom filter over the ids, sign hashes and object hashes of all recovered sigs in the db. Entries are never removed,
+ * so if the filter doesn't contain a key, the db doesn't either and no db lookup is needed. Removed sigs only cause
+ * false positives until the filter is rebuilt.
+ */
+class CRecoveredSigsFilter
+{
+public:
+    enum KeyType : uint32_t {
+        KEY_ID = 1,
+        KEY_SIGN_HASH = 2,
+        KEY_HASH = 3,
+    };
+
+private:
+    uint64_t k0;
+    uint64_t k1;
+    std::vector<uint64_t> data;
+    uint64_t nBits;
+    int nHashFuncs;
+    size_t nMaxElements;
+    size_t nElements{0};
+
+public:
+    CRecoveredSigsFilter(size_t _nMaxElements, double fpRate);
+
+    // llmqType is only used for KEY_ID, as ids are only unique per LLMQ type
+    void insert(KeyType keyType, const uint256& key, Consensus::LLMQType llmqType = Consensus::LLMQ_NONE);
+    bool contains(KeyType keyType, const uint256& key, Consensus::LLMQType llmqType = Consensus::LLMQ_NONE) const;
+
+    size_t GetElementCount() const { return nElements; }
+    bool IsFull() const { return nElements >= nMaxElements; }
+};
+
 class CRecoveredSigsDb
 {
 private:
@@ -75,6 +115,14 @@ private:
     unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForSessionCache;
     unordered_lru_cache<uint256, bool, StaticSaltedHasher, 30000> hasSigForHashCache;
 
+    // end of the last bucket that was cleaned up, everything before it is already gone
+    uint32_t recSigsCleanedUntil{0};
+    uint32_t votesCleanedUntil{0};
+
+    // in front of all HasRecoveredSig* db lookups. While it's rebuilt, new sigs are added to the new filter as well
+    std::unique_ptr<CRecoveredSigsFilter> filter;
+    std::unique_ptr<CRecoveredSigsFilter> rebuildingFilter;
+
 public:
     explicit CRecoveredSigsDb(CDBWrapper& _db);
 
@@ -93,6 +141,9 @@ public:
 
     void CleanupOldRecoveredSigs(int64_t maxAge);
 
+    bool IsFilterFull();
+    void RebuildFilter();
+
     // votes are removed when the recovered sig is written to the db
     bool HasVotedOnId(Consensus::LLMQType llmqType, const uint256& id);
     bool GetVoteForId(Consensus::LLMQType llmqType, const uint256& id, uint256& msgHashRet);
@@ -103,6 +154,7 @@ public:
 private:
     bool ReadRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, CRecoveredSig& ret);
     void RemoveRecoveredSig(CDBBatch& batch, Consensus::LLMQType llmqType, const uint256& id, bool deleteHashKey, bool deleteTimeKey);
+    void AddToFilter(const CRecoveredSig& recSig, const uint256& signHash);
 };
 
 class CRecoveredSigsListener
@@ -113,6 +165,21 @@ public:
     virtual void HandleNewRecoveredSig(const CRecoveredSig& recoveredSig) = 0;
 };
 
+struct CSigningRequest {
+    uint256 id;
+    uint256 msgHash;
+    // null to select the quorum from the id
+    uint256 quorumHash;
+};
+
+struct CRecoveredSigVerifyRequest {
+    // -1 for the chain tip
+    int signHeight{-1};
+    uint256 id;
+    uint256 msgHash;
+    CBLSSignature sig;
+};
+
 class CSigningManager
 {
     friend class CSigSharesManager;
@@ -174,6 +241,9 @@ public:
     void UnregisterRecoveredSigsListener(CRecoveredSigsListener* l);
 
     bool AsyncSignIfMember(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash, const uint256& quorumHash = uint256(), bool allowReSign = false);
+    // Same as above for many requests, with one quorum selection for all requests without a quorum hash and one pass
+    // over the votes. Returns one entry per request
+    std::vector<bool> AsyncSignIfMember(Consensus::LLMQType llmqType, const std::vector<CSigningRequest>& vecRequests, bool allowReSign = false);
     bool HasRecoveredSig(Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
     bool HasRecoveredSigForId(Consensus::LLMQType llmqType, const uint256& id);
     bool HasRecoveredSigForSession(const uint256& signHash);
@@ -185,9 +255,14 @@ public:
 
     static std::vector<CQuorumCPtr> GetActiveQuorumSet(Consensus::LLMQType llmqType, int signHeight);
     static CQuorumCPtr SelectQuorumForSigning(Consensus::LLMQType llmqType, const uint256& selectionHash, int signHeight = -1 /*chain tip*/, int signOffset = SIGN_HEIGHT_OFFSET);
+    // Selects the quorum of each selection hash from the same active quorum set. Entries are null if there is none
+    static std::vector<CQuorumCPtr> SelectQuorumsForSigning(Consensus::LLMQType llmqType, const std::vector<uint256>& selectionHashes, int signHeight = -1 /*chain tip*/, int signOffset = SIGN_HEIGHT_OFFSET);
 
     // Verifies a recovered sig that was signed while the chain tip was at signedAtTip
     static bool VerifyRecoveredSig(Consensus::LLMQType llmqType, int signedAtHeight, const uint256& id, const uint256& msgHash, const CBLSSignature& sig, int signOffset = SIGN_HEIGHT_OFFSET);
+    // Same as above for many signatures at once. The requests signed at the same height share one quorum selection and
+    // all signatures are verified in one randomized batch by the BLS workers. Returns one entry per request
+    static std::vector<bool> VerifyRecoveredSigs(Consensus::LLMQType llmqType, const std::vector<CRecoveredSigVerifyRequest>& vecRequests, int signOffset = SIGN_HEIGHT_OFFSET);
 };
 
 extern CSigningManager* quorumSigningManager;
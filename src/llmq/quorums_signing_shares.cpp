@@ -2,16 +2,20 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <llmq/quorums_init.h>
 #include <llmq/quorums_signing.h>
 #include <llmq/quorums_signing_shares.h>
+#include <llmq/quorums_signing_stats.h>
 #include <llmq/quorums_utils.h>
 
 #include <masternode/activemasternode.h>
-#include <bls/bls_batchverifier.h>
+#include <bls/bls_worker.h>
 #include <init.h>
+#include <memaccounting.h>
 #include <net_processing.h>
 #include <netmessagemaker.h>
 #include <spork.h>
+#include <utiltrace.h>
 #include <validation.h>
 
 #include <cxxtimer.hpp>
@@ -35,27 +39,19 @@ std::string CSigSesAnn::ToString() const
 
 void CSigSharesInv::Merge(const CSigSharesInv& inv2)
 {
-    for (size_t i = 0; i < inv.size(); i++) {
-        if (inv2.inv[i]) {
-            inv[i] = inv2.inv[i];
-        }
-    }
+    inv |= inv2.inv;
 }
 
 size_t CSigSharesInv::CountSet() const
 {
-    return (size_t)std::count(inv.begin(), inv.end(), true);
+    return inv.Count();
 }
 
 std::string CSigSharesInv::ToString() const
 {
     std::string str = "(";
     bool first = true;
-    for (size_t i = 0; i < inv.size(); i++) {
-        if (!inv[i]) {
-            continue;
-        }
-
+    for (size_t i = inv.FindNext(0); i < inv.size(); i = inv.FindNext(i + 1)) {
         if (!first) {
             str += ",";
         }
@@ -68,7 +64,7 @@ std::string CSigSharesInv::ToString() const
 
 void CSigSharesInv::Init(size_t size)
 {
-    inv.resize(size, false);
+    inv.resize(size);
 }
 
 bool CSigSharesInv::IsSet(uint16_t quorumMember) const
@@ -80,14 +76,12 @@ bool CSigSharesInv::IsSet(uint16_t quorumMember) const
 void CSigSharesInv::Set(uint16_t quorumMember, bool v)
 {
     assert(quorumMember < inv.size());
-    inv[quorumMember] = v;
+    inv.set(quorumMember, v);
 }
 
 void CSigSharesInv::SetAll(bool v)
 {
-    for (size_t i = 0; i < inv.size(); i++) {
-        inv[i] = v;
-    }
+    inv.SetAll(v);
 }
 
 std::string CBatchedSigShares::ToInvString() const
@@ -96,7 +90,7 @@ std::string CBatchedSigShares::ToInvString() const
     // we use 400 here no matter what the real size is. We don't really care about that size as we just want to call ToString()
     inv.Init(400);
     for (size_t i = 0; i < sigShares.size(); i++) {
-        inv.inv[sigShares[i].first] = true;
+        inv.Set(sigShares[i].first, true);
     }
     return inv.ToString();
 }
@@ -182,20 +176,67 @@ void CSigSharesNodeState::RemoveSession(const uint256& signHash)
 
 //////////////////////
 
+const int64_t CRecoveryLatencyHistogram::BUCKET_LIMITS[BUCKET_COUNT - 1] = {50, 100, 200, 500, 1000, 2000, 5000, 10000};
+
+void CRecoveryLatencyHistogram::Add(int64_t ms)
+{
+    size_t i = 0;
+    while (i < BUCKET_COUNT - 1 && ms > BUCKET_LIMITS[i]) {
+        i++;
+    }
+    counts[i]++;
+    count++;
+    sumMs += ms;
+    maxMs = std::max(maxMs, ms);
+}
+
 CSigSharesManager::CSigSharesManager()
 {
     workInterrupt.reset();
+    g_memory_accounting.Register("sigshares", this, [this]() { return DynamicMemoryUsage(); });
 }
 
-CSigSharesManager::~CSigSharesManager() = default;
+CSigSharesManager::~CSigSharesManager()
+{
+    g_memory_accounting.Unregister("sigshares", this);
+}
+
+size_t CSigSharesManager::DynamicMemoryUsage()
+{
+    LOCK(cs);
+    size_t ret = sigShares.DynamicMemoryUsage() + memusage::DynamicUsage(signedSessions) +
+                 memusage::DynamicUsage(timeSeenForSessions) + memusage::DynamicUsage(timeFirstSeenForSessions) +
+                 memusage::DynamicUsage(nodeStates) + sigSharesRequested.DynamicMemoryUsage() +
+                 sigSharesQueuedToAnnounce.DynamicMemoryUsage() + memusage::DynamicUsage(pendingSigns);
+    for (const auto& p : nodeStates) {
+        const CSigSharesNodeState& nodeState = p.second;
+        ret += memusage::DynamicUsage(nodeState.sessions) + memusage::DynamicUsage(nodeState.sessionByRecvId);
+        for (const auto& p2 : nodeState.sessions) {
+            const auto& session = p2.second;
+            ret += session.announced.inv.DynamicMemoryUsage() + session.requested.inv.DynamicMemoryUsage() +
+                   session.knows.inv.DynamicMemoryUsage();
+        }
+        ret += nodeState.pendingIncomingSigShares.DynamicMemoryUsage() + nodeState.requestedSigShares.DynamicMemoryUsage();
+    }
+    return ret;
+}
 
-void CSigSharesManager::StartWorkerThread()
+void CSigSharesManager::StartWorkerThread(int _workerCount)
 {
     // can't start new thread if we have one running already
     if (workThread.joinable()) {
         assert(false);
     }
 
+    if (_workerCount <= 0) {
+        _workerCount = std::max(1, std::min((int)std::thread::hardware_concurrency() / 2, 4));
+    }
+    workerCount = (size_t)std::min(_workerCount, MAX_SIGSHARES_WORKER_THREADS);
+    if (workerCount > 1) {
+        workerPool.resize(workerCount);
+        RenameThreadPool(workerPool, "dash-sigsh-work");
+    }
+
     workThread = std::thread(&TraceThread<std::function<void()> >,
         "sigshares",
         std::function<void()>(std::bind(&CSigSharesManager::WorkThreadMain, this)));
@@ -211,6 +252,34 @@ void CSigSharesManager::StopWorkerThread()
     if (workThread.joinable()) {
         workThread.join();
     }
+    workerPool.clear_queue();
+    workerPool.stop(true);
+}
+
+size_t CSigSharesManager::GetShard(const uint256& signHash) const
+{
+    return (size_t)(signHash.GetCheapHash() % workerCount);
+}
+
+void CSigSharesManager::RunSharded(size_t shardCount, const std::function<void(size_t)>& f)
+{
+    if (shardCount <= 1) {
+        if (shardCount == 1) {
+            f(0);
+        }
+        return;
+    }
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(shardCount);
+    for (size_t i = 0; i < shardCount; i++) {
+        futures.emplace_back(workerPool.push([&f, i](int threadId) {
+            f(i);
+        }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
 }
 
 void CSigSharesManager::RegisterAsRecoveredSigsListener()
@@ -639,7 +708,9 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
     std::unordered_map<NodeId, std::vector<CSigShare>> sigSharesByNodes;
     std::unordered_map<std::pair<Consensus::LLMQType, uint256>, CQuorumCPtr, StaticSaltedHasher> quorums;
 
-    const size_t nMaxBatchSize{32};
+    // Randomized batch verification on the BLS workers makes large batches from many sessions and quorums cheap, and
+    // bisecting failed batches keeps a few invalid shares from forcing per-share verification of everything else
+    const size_t nMaxBatchSize{128};
     CollectPendingSigSharesToVerify(nMaxBatchSize, sigSharesByNodes, quorums);
     if (sigSharesByNodes.empty()) {
         return false;
@@ -647,7 +718,10 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
 
     // It's ok to perform insecure batched verification here as we verify against the quorum public key shares,
     // which are not craftable by individual entities, making the rogue public key attack impossible
-    CBLSBatchVerifier<NodeId, SigShareKey> batchVerifier(false, true);
+    BLSSignatureVector sigs;
+    BLSPublicKeyVector pubKeys;
+    std::vector<uint256> msgHashes;
+    std::vector<NodeId> sources;
 
     cxxtimer::Timer prepareTimer(true);
     size_t verifyCount = 0;
@@ -678,23 +752,35 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
                 assert(false);
             }
 
-            batchVerifier.PushMessage(nodeId, sigShare.GetKey(), sigShare.GetSignHash(), sigShare.sigShare.Get(), pubKeyShare);
+            sigs.emplace_back(sigShare.sigShare.Get());
+            pubKeys.emplace_back(pubKeyShare);
+            msgHashes.emplace_back(sigShare.GetSignHash());
+            sources.emplace_back(nodeId);
             verifyCount++;
         }
     }
     prepareTimer.stop();
 
     cxxtimer::Timer verifyTimer(true);
-    batchVerifier.Verify();
+    std::set<NodeId> badSources;
+    if (!sigs.empty()) {
+        auto valid = blsWorker->VerifySignatures(sigs, pubKeys, msgHashes);
+        for (size_t i = 0; i < valid.size(); i++) {
+            if (!valid[i]) {
+                badSources.emplace(sources[i]);
+            }
+        }
+    }
     verifyTimer.stop();
 
     LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- verified sig shares. count=%d, pt=%d, vt=%d, nodes=%d\n", __func__, verifyCount, prepareTimer.count(), verifyTimer.count(), sigSharesByNodes.size());
 
+    std::vector<std::vector<CSigShare>> shards(workerCount);
     for (auto& p : sigSharesByNodes) {
         auto nodeId = p.first;
         auto& v = p.second;
 
-        if (batchVerifier.badSources.count(nodeId)) {
+        if (badSources.count(nodeId)) {
             LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- invalid sig shares from other node, banning peer=%d\n",
                      __func__, nodeId);
             // this will also cause re-requesting of the shares that were sent by this node
@@ -702,9 +788,19 @@ bool CSigSharesManager::ProcessPendingSigShares(CConnman& connman)
             continue;
         }
 
-        ProcessPendingSigShares(v, quorums, connman);
+        for (auto& sigShare : v) {
+            shards[GetShard(sigShare.GetSignHash())].emplace_back(std::move(sigShare));
+        }
     }
 
+    // Most of the time in here goes into recovering signatures once enough shares arrived, which is independent
+    // between sessions
+    RunSharded(shards.size(), [&](size_t shard) {
+        if (!shards[shard].empty()) {
+            ProcessPendingSigShares(shards[shard], quorums, connman);
+        }
+    });
+
     return sigSharesByNodes.size() >= nMaxBatchSize;
 }
 
@@ -749,12 +845,14 @@ void CSigSharesManager::ProcessSigShare(const CSigShare& sigShare, CConnman& con
         if (!sigShares.Add(sigShare.GetKey(), sigShare)) {
             return;
         }
+        quorumSigningStats->AddStage(llmqType, sigShare.GetSignHash(), SigStage::FIRST_SHARE);
         if (!CLLMQUtils::IsAllMembersConnectedEnabled(llmqType)) {
             sigSharesQueuedToAnnounce.Add(sigShare.GetKey(), true);
         }
 
         // Update the time we've seen the last sigShare
         timeSeenForSessions[sigShare.GetSignHash()] = GetAdjustedTime();
+        timeFirstSeenForSessions.emplace(sigShare.GetSignHash(), GetTimeMillis());
 
         if (!quorumNodes.empty()) {
             // don't announce and wait for other nodes to request this share and directly send it to them
@@ -769,7 +867,9 @@ void CSigSharesManager::ProcessSigShare(const CSigShare& sigShare, CConnman& con
         }
 
         size_t sigShareCount = sigShares.CountForSignHash(sigShare.GetSignHash());
+        TRACE4(llmq, sigshare_received, (int)llmqType, sigShare.GetSignHash().begin(), sigShare.quorumMember, sigShareCount);
         if (sigShareCount >= quorum->params.threshold) {
+            quorumSigningStats->AddStage(llmqType, sigShare.GetSignHash(), SigStage::THRESHOLD);
             canTryRecovery = true;
         }
     }
@@ -821,6 +921,7 @@ void CSigSharesManager::TryRecoverSig(const CQuorumCPtr& quorum, const uint256&
 
     LogPrint(BCLog::LLMQ_SIGS, "CSigSharesManager::%s -- recovered signature. id=%s, msgHash=%s, time=%d\n", __func__,
               id.ToString(), msgHash.ToString(), t.count());
+    TRACE4(llmq, sig_recovered, (int)quorum->params.type, id.begin(), msgHash.begin(), t.count<std::chrono::microseconds>());
 
     std::shared_ptr<CRecoveredSig> rs = std::make_shared<CRecoveredSig>();
     rs->llmqType = quorum->params.type;
@@ -911,14 +1012,12 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
                 continue;
             }
 
-            for (size_t i = 0; i < session.announced.inv.size(); i++) {
-                if (!session.announced.inv[i]) {
-                    continue;
-                }
+            auto& announced = session.announced.inv;
+            for (size_t i = announced.FindNext(0); i < announced.size(); i = announced.FindNext(i + 1)) {
                 auto k = std::make_pair(signHash, (uint16_t) i);
                 if (sigShares.Has(k)) {
                     // we already have it
-                    session.announced.inv[i] = false;
+                    announced.reset(i);
                     continue;
                 }
                 if (nodeState.requestedSigShares.Size() >= maxRequestsForNode) {
@@ -953,10 +1052,10 @@ void CSigSharesManager::CollectSigSharesToRequest(std::unordered_map<NodeId, std
                     const auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)session.llmqType);
                     inv.Init((size_t)params.size);
                 }
-                inv.inv[k.second] = true;
+                inv.Set(k.second, true);
 
                 // dont't request it again from this node
-                session.announced.inv[i] = false;
+                announced.reset(i);
             }
         }
     }
@@ -990,17 +1089,14 @@ void CSigSharesManager::CollectSigSharesToSend(std::unordered_map<NodeId, std::u
 
             CBatchedSigShares batchedSigShares;
 
-            for (size_t i = 0; i < session.requested.inv.size(); i++) {
-                if (!session.requested.inv[i]) {
-                    continue;
-                }
-                session.requested.inv[i] = false;
+            auto& requested = session.requested.inv;
+            for (size_t i = requested.FindNext(0); i < requested.size(); i = requested.FindNext(i + 1)) {
+                requested.reset(i);
 
                 auto k = std::make_pair(signHash, (uint16_t)i);
                 const CSigShare* sigShare = sigShares.Get(k);
                 if (!sigShare) {
                     // he requested something we don'have
-                    session.requested.inv[i] = false;
                     continue;
                 }
 
@@ -1095,7 +1191,7 @@ void CSigSharesManager::CollectSigSharesToAnnounce(std::unordered_map<NodeId, st
 
             auto& session = nodeState.GetOrCreateSessionFromShare(*sigShare);
 
-            if (session.knows.inv[quorumMember]) {
+            if (session.knows.IsSet(quorumMember)) {
                 // he already knows that one
                 continue;
             }
@@ -1105,8 +1201,8 @@ void CSigSharesManager::CollectSigSharesToAnnounce(std::unordered_map<NodeId, st
                 const auto& params = Params().GetConsensus().llmqs.at((Consensus::LLMQType)sigShare->llmqType);
                 inv.Init((size_t)params.size);
             }
-            inv.inv[quorumMember] = true;
-            session.knows.inv[quorumMember] = true;
+            inv.Set(quorumMember, true);
+            session.knows.Set(quorumMember, true);
         }
     });
 
@@ -1277,12 +1373,41 @@ bool CSigSharesManager::SendMessages()
         }
     }
 
+    UpdateSendInterval(vNodesCopy);
+
     // looped through all nodes, release them
     g_connman->ReleaseNodeVector(vNodesCopy);
 
     return didSend;
 }
 
+void CSigSharesManager::UpdateSendInterval(const std::vector<CNode*>& vNodes)
+{
+    std::vector<int64_t> rtts;
+    {
+        LOCK(cs);
+        for (auto& pnode : vNodes) {
+            auto it = nodeStates.find(pnode->GetId());
+            if (it == nodeStates.end() || it->second.sessions.empty()) {
+                continue;
+            }
+            int64_t minPing = pnode->nMinPingUsecTime;
+            if (minPing != std::numeric_limits<int64_t>::max()) {
+                rtts.emplace_back(minPing / 1000);
+            }
+        }
+    }
+    if (rtts.empty()) {
+        // no sessions right now, keep what we had so that the next session starts with the last known cadence
+        return;
+    }
+
+    std::nth_element(rtts.begin(), rtts.begin() + rtts.size() / 2, rtts.end());
+    int64_t rtt = rtts[rtts.size() / 2];
+    medianPeerRtt = rtt;
+    sendInterval = std::max(MIN_SEND_INTERVAL, std::min(MAX_SEND_INTERVAL, rtt / 4));
+}
+
 bool CSigSharesManager::GetSessionInfoByRecvId(NodeId nodeId, uint32_t sessionId, CSigSharesNodeState::SessionInfo& retInfo)
 {
     LOCK(cs);
@@ -1451,6 +1576,7 @@ void CSigSharesManager::RemoveSigSharesForSession(const uint256& signHash)
     sigShares.EraseAllForSignHash(signHash);
     signedSessions.erase(signHash);
     timeSeenForSessions.erase(signHash);
+    timeFirstSeenForSessions.erase(signHash);
 }
 
 void CSigSharesManager::RemoveBannedNodeStates()
@@ -1518,7 +1644,7 @@ void CSigSharesManager::WorkThreadMain()
         fMoreWork |= ProcessPendingSigShares(*g_connman);
         SignPendingSigShares();
 
-        if (GetTimeMillis() - lastSendTime > 100) {
+        if (GetTimeMillis() - lastSendTime > sendInterval) {
             SendMessages();
             lastSendTime = GetTimeMillis();
         }
@@ -1527,7 +1653,7 @@ void CSigSharesManager::WorkThreadMain()
         quorumSigningManager->Cleanup();
 
         // TODO Wakeup when pending signing is needed?
-        if (!fMoreWork && !workInterrupt.sleep_for(std::chrono::milliseconds(100))) {
+        if (!fMoreWork && !workInterrupt.sleep_for(std::chrono::milliseconds(sendInterval.load()))) {
             return;
         }
     }
@@ -1539,6 +1665,15 @@ void CSigSharesManager::AsyncSign(const CQuorumCPtr& quorum, const uint256& id,
     pendingSigns.emplace_back(quorum, id, msgHash);
 }
 
+void CSigSharesManager::AsyncSign(const std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>>& vecSigns)
+{
+    LOCK(cs);
+    pendingSigns.reserve(pendingSigns.size() + vecSigns.size());
+    for (const auto& sign : vecSigns) {
+        pendingSigns.emplace_back(sign);
+    }
+}
+
 void CSigSharesManager::SignPendingSigShares()
 {
     std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>> v;
@@ -1547,23 +1682,37 @@ void CSigSharesManager::SignPendingSigShares()
         v = std::move(pendingSigns);
     }
 
-    for (auto& t : v) {
-        const CQuorumCPtr pQuorum = std::get<0>(t);
-        CSigShare sigShare = CreateSigShare(pQuorum, std::get<1>(t), std::get<2>(t));
+    std::vector<std::vector<size_t>> shards(std::min(workerCount, v.size()));
+    for (size_t i = 0; i < v.size(); i++) {
+        const auto& pQuorum = std::get<0>(v[i]);
+        auto signHash = CLLMQUtils::BuildSignHash(pQuorum->params.type, pQuorum->qc.quorumHash, std::get<1>(v[i]), std::get<2>(v[i]));
+        shards[GetShard(signHash) % shards.size()].emplace_back(i);
+    }
 
-        if (sigShare.sigShare.Get().IsValid()) {
+    RunSharded(shards.size(), [&](size_t shard) {
+        for (size_t i : shards[shard]) {
+            SignAndProcessSigShare(std::get<0>(v[i]), std::get<1>(v[i]), std::get<2>(v[i]));
+        }
+    });
+}
 
-            ProcessSigShare(sigShare, *g_connman, pQuorum);
+void CSigSharesManager::SignAndProcessSigShare(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash)
+{
+    CSigShare sigShare = CreateSigShare(quorum, id, msgHash);
+    if (!sigShare.sigShare.Get().IsValid()) {
+        return;
+    }
+    quorumSigningStats->AddStage(quorum->params.type, sigShare.GetSignHash(), SigStage::SIGNED);
 
-            if (CLLMQUtils::IsAllMembersConnectedEnabled(pQuorum->params.type)) {
-                LOCK(cs);
-                auto& session = signedSessions[sigShare.GetSignHash()];
-                session.sigShare = sigShare;
-                session.quorum = pQuorum;
-                session.nextAttemptTime = 0;
-                session.attempt = 0;
-            }
-        }
+    ProcessSigShare(sigShare, *g_connman, quorum);
+
+    if (CLLMQUtils::IsAllMembersConnectedEnabled(quorum->params.type)) {
+        LOCK(cs);
+        auto& session = signedSessions[sigShare.GetSignHash()];
+        session.sigShare = sigShare;
+        session.quorum = quorum;
+        session.nextAttemptTime = 0;
+        session.attempt = 0;
     }
 }
 
@@ -1642,7 +1791,18 @@ void CSigSharesManager::ForceReAnnouncement(const CQuorumCPtr& quorum, Consensus
 void CSigSharesManager::HandleNewRecoveredSig(const llmq::CRecoveredSig& recoveredSig)
 {
     LOCK(cs);
-    RemoveSigSharesForSession(CLLMQUtils::BuildSignHash(recoveredSig));
+    auto signHash = CLLMQUtils::BuildSignHash(recoveredSig);
+    auto it = timeFirstSeenForSessions.find(signHash);
+    if (it != timeFirstSeenForSessions.end()) {
+        recoveryLatencies[(Consensus::LLMQType)recoveredSig.llmqType].Add(GetTimeMillis() - it->second);
+    }
+    RemoveSigSharesForSession(signHash);
+}
+
+std::map<Consensus::LLMQType, CRecoveryLatencyHistogram> CSigSharesManager::GetRecoveryLatencies()
+{
+    LOCK(cs);
+    return recoveryLatencies;
 }
 
 } // namespace llmq
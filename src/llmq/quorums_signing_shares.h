@@ -7,6 +7,7 @@
 
 #include <bls/bls.h>
 #include <chainparams.h>
+#include <memusage.h>
 #include <net.h>
 #include <random.h>
 #include <saltedhasher.h>
@@ -16,7 +17,13 @@
 #include <uint256.h>
 
 #include <llmq/quorums.h>
+#include <llmq/quorums_bitset.h>
 
+#include <ctpl.h>
+
+#include <array>
+#include <atomic>
+#include <map>
 #include <thread>
 #include <mutex>
 #include <unordered_map>
@@ -27,6 +34,10 @@ class CScheduler;
 
 namespace llmq
 {
+//! -sigsharesworkerthreads default, 0 means to pick a number based on the available cores
+static const int DEFAULT_SIGSHARES_WORKER_THREADS = 0;
+static const int MAX_SIGSHARES_WORKER_THREADS = 8;
+
 // <signHash, quorumMember>
 typedef std::pair<uint256, uint16_t> SigShareKey;
 
@@ -101,7 +112,7 @@ class CSigSharesInv
 {
 public:
     uint32_t sessionId{(uint32_t)-1};
-    std::vector<bool> inv;
+    CQuorumBitSet inv;
 
 public:
     ADD_SERIALIZE_METHODS
@@ -113,7 +124,7 @@ public:
 
         READWRITE(VARINT(sessionId));
         READWRITE(COMPACTSIZE(invSize));
-        READWRITE(AUTOBITSET(inv, (size_t)invSize));
+        READWRITE(QUORUMAUTOBITSET(inv, (size_t)invSize));
     }
 
     void Init(size_t size);
@@ -241,6 +252,15 @@ public:
         return internalMap.empty();
     }
 
+    size_t DynamicMemoryUsage() const
+    {
+        size_t ret = memusage::DynamicUsage(internalMap);
+        for (const auto& p : internalMap) {
+            ret += memusage::DynamicUsage(p.second);
+        }
+        return ret;
+    }
+
     const std::unordered_map<uint16_t, T>* GetAllForSignHash(const uint256& signHash)
     {
         auto it = internalMap.find(signHash);
@@ -352,6 +372,23 @@ public:
     int attempt{0};
 };
 
+/**
+ * Histogram of the time between the first sig share we have seen for a signing session and the recovered signature
+ * becoming known (recovered by us or received from others).
+ */
+struct CRecoveryLatencyHistogram {
+    static const size_t BUCKET_COUNT = 9;
+    // upper bounds in milliseconds of all but the last bucket, the last one takes everything above
+    static const int64_t BUCKET_LIMITS[BUCKET_COUNT - 1];
+
+    std::array<uint64_t, BUCKET_COUNT> counts{};
+    uint64_t count{0};
+    int64_t sumMs{0};
+    int64_t maxMs{0};
+
+    void Add(int64_t ms);
+};
+
 class CSigSharesManager : public CRecoveredSigsListener
 {
     static const int64_t SESSION_NEW_SHARES_TIMEOUT = 60;
@@ -364,6 +401,12 @@ class CSigSharesManager : public CRecoveredSigsListener
     // 400 is the maximum quorum size, so this is also the maximum number of sigs we need to support
     const size_t MAX_MSGS_TOTAL_BATCHED_SIGS = 400;
 
+    // Outgoing messages are collected and sent in rounds. The interval between rounds follows the latency of the
+    // peers we have sessions with (a quarter of their median RTT), so that batching never adds much to the time it
+    // takes for shares to travel
+    static const int64_t MIN_SEND_INTERVAL = 10;
+    static const int64_t MAX_SEND_INTERVAL = 100;
+
     const int64_t EXP_SEND_FOR_RECOVERY_TIMEOUT = 2000;
     const int64_t MAX_SEND_FOR_RECOVERY_TIMEOUT = 10000;
     const size_t MAX_MSGS_SIG_SHARES = 32;
@@ -374,11 +417,22 @@ private:
     std::thread workThread;
     CThreadInterrupt workInterrupt;
 
+    // Verified sig shares and our own signing requests are handed to these workers, sharded by signHash so that all
+    // shares of a session are processed by the same worker
+    ctpl::thread_pool workerPool;
+    size_t workerCount{1};
+
     SigShareMap<CSigShare> sigShares;
     std::unordered_map<uint256, CSignedSession, StaticSaltedHasher> signedSessions;
 
     // stores time of last receivedSigShare. Used to detect timeouts
     std::unordered_map<uint256, int64_t, StaticSaltedHasher> timeSeenForSessions;
+    // time in milliseconds of the first sig share of each session, used to measure recovery latency
+    std::unordered_map<uint256, int64_t, StaticSaltedHasher> timeFirstSeenForSessions;
+    std::map<Consensus::LLMQType, CRecoveryLatencyHistogram> recoveryLatencies;
+
+    std::atomic<int64_t> sendInterval{MAX_SEND_INTERVAL};
+    std::atomic<int64_t> medianPeerRtt{-1};
 
     std::unordered_map<NodeId, CSigSharesNodeState> nodeStates;
     SigShareMap<std::pair<NodeId, int64_t>> sigSharesRequested;
@@ -396,7 +450,7 @@ public:
     CSigSharesManager();
     ~CSigSharesManager();
 
-    void StartWorkerThread();
+    void StartWorkerThread(int _workerCount = DEFAULT_SIGSHARES_WORKER_THREADS);
     void StopWorkerThread();
     void RegisterAsRecoveredSigsListener();
     void UnregisterAsRecoveredSigsListener();
@@ -406,6 +460,7 @@ public:
     void ProcessMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv);
 
     void AsyncSign(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
+    void AsyncSign(const std::vector<std::tuple<const CQuorumCPtr, uint256, uint256>>& vecSigns);
     CSigShare CreateSigShare(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
     void ForceReAnnouncement(const CQuorumCPtr& quorum, Consensus::LLMQType llmqType, const uint256& id, const uint256& msgHash);
 
@@ -413,6 +468,12 @@ public:
 
     static CDeterministicMNCPtr SelectMemberForRecovery(const CQuorumCPtr& quorum, const uint256& id, int attempt);
 
+    std::map<Consensus::LLMQType, CRecoveryLatencyHistogram> GetRecoveryLatencies();
+    size_t DynamicMemoryUsage();
+    int64_t GetSendInterval() const { return sendInterval; }
+    // median of the minimum ping time in milliseconds of the nodes we share sessions with, -1 if unknown
+    int64_t GetMedianPeerRtt() const { return medianPeerRtt; }
+
 private:
     // all of these return false when the currently processed message should be aborted (as each message actually contains multiple messages)
     bool ProcessMessageSigSesAnn(CNode* pfrom, const CSigSesAnn& ann);
@@ -434,6 +495,7 @@ private:
             CConnman& connman);
 
     void ProcessSigShare(const CSigShare& sigShare, CConnman& connman, const CQuorumCPtr& quorum);
+    void SignAndProcessSigShare(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
     void TryRecoverSig(const CQuorumCPtr& quorum, const uint256& id, const uint256& msgHash);
 
 private:
@@ -447,12 +509,17 @@ private:
     void BanNode(NodeId nodeId);
 
     bool SendMessages();
+    void UpdateSendInterval(const std::vector<CNode*>& vNodes);
     void CollectSigSharesToRequest(std::unordered_map<NodeId, std::unordered_map<uint256, CSigSharesInv, StaticSaltedHasher>>& sigSharesToRequest);
     void CollectSigSharesToSend(std::unordered_map<NodeId, std::unordered_map<uint256, CBatchedSigShares, StaticSaltedHasher>>& sigSharesToSend);
     void CollectSigSharesToSendConcentrated(std::unordered_map<NodeId, std::vector<CSigShare>>& sigSharesToSend, const std::vector<CNode*>& vNodes);
     void CollectSigSharesToAnnounce(std::unordered_map<NodeId, std::unordered_map<uint256, CSigSharesInv, StaticSaltedHasher>>& sigSharesToAnnounce);
     void SignPendingSigShares();
     void WorkThreadMain();
+
+    size_t GetShard(const uint256& signHash) const;
+    // Runs f(shard) for all shards in [0, shardCount) in parallel and waits for all of them to finish
+    void RunSharded(size_t shardCount, const std::function<void(size_t)>& f);
 };
 
 extern CSigSharesManager* quorumSigSharesManager;
@@ -0,0 +1,125 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <llmq/quorums_signing_stats.h>
+
+#include <llmq/quorums_utils.h>
+#include <statsd_client.h>
+#include <tinyformat.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace llmq
+{
+
+CSigningStats* quorumSigningStats = nullptr;
+
+const int64_t CSigningStats::MAX_TRACE_AGE;
+const size_t CSigningStats::WINDOW_SIZE;
+const size_t CSigningStats::STAGE_COUNT;
+
+const char* SigStageToString(SigStage stage)
+{
+    switch (stage) {
+    case SigStage::REQUESTED: return "requested";
+    case SigStage::SIGNED: return "signed";
+    case SigStage::FIRST_SHARE: return "firstShare";
+    case SigStage::THRESHOLD: return "threshold";
+    case SigStage::RECOVERED: return "recovered";
+    case SigStage::PROCESSED: return "processed";
+    default: return "unknown";
+    }
+}
+
+void CSigningStats::AddStage(Consensus::LLMQType llmqType, const uint256& signHash, SigStage stage, int64_t nTimeMicros)
+{
+    LOCK(cs);
+    Cleanup(nTimeMicros);
+
+    auto it = traces.emplace(signHash, Trace{llmqType, {}}).first;
+    int64_t& t = it->second.times[(size_t)stage];
+    if (t != 0) {
+        // only the first time a stage is reached counts, e.g. for re-signing
+        return;
+    }
+    t = nTimeMicros;
+    if (stage == SigStage::PROCESSED) {
+        FinishTrace(it->second);
+        traces.erase(it);
+    }
+}
+
+void CSigningStats::FinishTrace(const Trace& trace)
+{
+    AssertLockHeld(cs);
+
+    auto& window = windows[trace.llmqType];
+    auto addLatency = [&](size_t i, const std::string& name, int64_t nMicros) {
+        auto& latencies = window.latencies[i];
+        latencies.emplace_back(nMicros / 1000);
+        if (latencies.size() > WINDOW_SIZE) latencies.pop_front();
+        statsClient.histogram(strprintf("llmq.%s.sigs.%s", GetLLMQParams(trace.llmqType).name, name), nMicros / 1000.0);
+    };
+
+    int64_t nTimePrev = 0;
+    int64_t nTimeFirst = 0;
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        if (trace.times[i] == 0) continue;
+        if (nTimePrev != 0) {
+            addLatency(i, SigStageToString((SigStage)i), trace.times[i] - nTimePrev);
+        } else {
+            nTimeFirst = trace.times[i];
+        }
+        nTimePrev = trace.times[i];
+    }
+    addLatency(STAGE_COUNT, "total", nTimePrev - nTimeFirst);
+}
+
+void CSigningStats::Cleanup(int64_t nTimeMicros)
+{
+    AssertLockHeld(cs);
+
+    if (nTimeMicros - lastCleanupTime < 60 * 1000 * 1000) {
+        return;
+    }
+    lastCleanupTime = nTimeMicros;
+
+    for (auto it = traces.begin(); it != traces.end(); ) {
+        int64_t nTimeLast = *std::max_element(it->second.times.begin(), it->second.times.end());
+        if (nTimeMicros - nTimeLast > MAX_TRACE_AGE) {
+            it = traces.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::map<Consensus::LLMQType, std::array<CSigLatencyStats, CSigningStats::STAGE_COUNT + 1>> CSigningStats::GetStats()
+{
+    std::map<Consensus::LLMQType, std::array<CSigLatencyStats, STAGE_COUNT + 1>> ret;
+
+    LOCK(cs);
+    for (const auto& p : windows) {
+        auto& stats = ret[p.first];
+        for (size_t i = 0; i < STAGE_COUNT + 1; i++) {
+            std::vector<int64_t> v(p.second.latencies[i].begin(), p.second.latencies[i].end());
+            if (v.empty()) continue;
+            std::sort(v.begin(), v.end());
+            // nearest rank
+            stats[i].count = v.size();
+            stats[i].p50 = v[(v.size() * 50 + 99) / 100 - 1];
+            stats[i].p99 = v[(v.size() * 99 + 99) / 100 - 1];
+        }
+    }
+    return ret;
+}
+
+size_t CSigningStats::GetTraceCount()
+{
+    LOCK(cs);
+    return traces.size();
+}
+
+} // namespace llmq
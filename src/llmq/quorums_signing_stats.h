@@ -0,0 +1,89 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LLMQ_QUORUMS_SIGNING_STATS_H
+#define BITCOIN_LLMQ_QUORUMS_SIGNING_STATS_H
+
+#include <consensus/params.h>
+#include <saltedhasher.h>
+#include <sync.h>
+#include <uint256.h>
+#include <utiltime.h>
+
+#include <array>
+#include <deque>
+#include <map>
+#include <unordered_map>
+
+namespace llmq
+{
+
+/** The stages a signing session goes through, in order. Not all of them are seen by every node, e.g. only members
+ *  request and sign shares and only the recovering member reaches the threshold of shares.
+ */
+enum class SigStage : uint8_t {
+    REQUESTED,   // a member was asked to sign (AsyncSignIfMember)
+    SIGNED,      // our own sig share was created
+    FIRST_SHARE, // the first sig share of the session was processed, ours or one we received
+    THRESHOLD,   // enough sig shares to recover the signature
+    RECOVERED,   // the recovered signature was accepted, recovered by us or received
+    PROCESSED,   // all listeners (InstantSend, ChainLocks...) handled the recovered signature
+    COUNT
+};
+
+const char* SigStageToString(SigStage stage);
+
+struct CSigLatencyStats {
+    size_t count{0};
+    int64_t p50{0};
+    int64_t p99{0};
+};
+
+/**
+ * Traces signing sessions by signHash. When a session is processed, the time each stage took since the previous
+ * stage that was seen is sent to statsd as histograms and kept for the last sessions of each LLMQ type.
+ */
+class CSigningStats
+{
+public:
+    // sessions which never get processed are dropped after this
+    static const int64_t MAX_TRACE_AGE = 10 * 60 * 1000 * 1000LL;
+    // latencies kept per LLMQ type and stage to compute percentiles
+    static const size_t WINDOW_SIZE = 1000;
+    static const size_t STAGE_COUNT = (size_t)SigStage::COUNT;
+
+private:
+    struct Trace {
+        Consensus::LLMQType llmqType;
+        // in microseconds, 0 when a stage wasn't seen (yet)
+        std::array<int64_t, STAGE_COUNT> times{};
+    };
+
+    // latencies in milliseconds, the last entry is the total time of the sessions
+    struct Window {
+        std::array<std::deque<int64_t>, STAGE_COUNT + 1> latencies;
+    };
+
+    CCriticalSection cs;
+    std::unordered_map<uint256, Trace, StaticSaltedHasher> traces;
+    std::map<Consensus::LLMQType, Window> windows;
+    int64_t lastCleanupTime{0};
+
+public:
+    void AddStage(Consensus::LLMQType llmqType, const uint256& signHash, SigStage stage, int64_t nTimeMicros = GetTimeMicros());
+
+    /** Latencies of every stage and, as the last entry, of the whole sessions, by LLMQ type */
+    std::map<Consensus::LLMQType, std::array<CSigLatencyStats, STAGE_COUNT + 1>> GetStats();
+    size_t GetTraceCount();
+
+private:
+    void FinishTrace(const Trace& trace);
+    void Cleanup(int64_t nTimeMicros);
+};
+
+extern CSigningStats* quorumSigningStats;
+
+} // namespace llmq
+
+#endif // BITCOIN_LLMQ_QUORUMS_SIGNING_STATS_H
@@ -6,6 +6,7 @@
 #include <llmq/quorums_utils.h>
 
 #include <chainparams.h>
+#include <dbwrapper.h>
 #include <random.h>
 #include <spork.h>
 #include <validation.h>
@@ -15,6 +16,8 @@
 namespace llmq
 {
 
+static const std::string DB_QUORUM_MEMBERS = "q_Qmembers";
+
 CCriticalSection cs_llmq_vbc;
 VersionBitsCache llmq_versionbitscache;
 
@@ -39,13 +42,77 @@ std::vector<CDeterministicMNCPtr> CLLMQUtils::GetAllQuorumMembers(Consensus::LLM
 
     auto& params = Params().GetConsensus().llmqs.at(llmqType);
     auto allMns = deterministicMNManager->GetListForBlock(pindexQuorum);
-    auto modifier = ::SerializeHash(std::make_pair(llmqType, pindexQuorum->GetBlockHash()));
-    quorumMembers = allMns.CalculateQuorum(params.size, modifier);
+
+    // Members scored by a previous run are stored by their proTxHashes, the entries themselves are always taken from
+    // the MN list of the quorum block. Members only depend on the quorum block, so reorgs don't invalidate them
+    auto dbKey = std::make_tuple(DB_QUORUM_MEMBERS, llmqType, pindexQuorum->GetBlockHash());
+    std::vector<uint256> vecProTxHashes;
+    if (evoDb && evoDb->Read(dbKey, vecProTxHashes)) {
+        for (const auto& proTxHash : vecProTxHashes) {
+            auto dmn = allMns.GetMN(proTxHash);
+            if (!dmn) {
+                quorumMembers.clear();
+                break;
+            }
+            quorumMembers.emplace_back(dmn);
+        }
+    }
+
+    if (quorumMembers.empty()) {
+        auto modifier = ::SerializeHash(std::make_pair(llmqType, pindexQuorum->GetBlockHash()));
+        quorumMembers = allMns.CalculateQuorum(params.size, modifier);
+        if (evoDb && !quorumMembers.empty()) {
+            vecProTxHashes.clear();
+            for (const auto& dmn : quorumMembers) {
+                vecProTxHashes.emplace_back(dmn->proTxHash);
+            }
+            evoDb->GetRawDB().Write(dbKey, vecProTxHashes);
+        }
+    }
+
     LOCK(cs_members);
     mapQuorumMembers[llmqType].insert(pindexQuorum->GetBlockHash(), quorumMembers);
     return quorumMembers;
 }
 
+size_t CLLMQUtils::PruneQuorumMembers(int nKeepHeight)
+{
+    if (!evoDb) {
+        return 0;
+    }
+    return PruneQuorumEntries(evoDb->GetRawDB(), DB_QUORUM_MEMBERS, nKeepHeight);
+}
+
+size_t CLLMQUtils::PruneQuorumEntries(CDBWrapper& db, const std::string& strPrefix, int nKeepHeight)
+{
+    AssertLockHeld(cs_main);
+
+    CDBBatch batch(db);
+    size_t nCount = 0;
+    std::unique_ptr<CDBIterator> dbIt(db.NewIterator());
+    for (const auto& p : Params().GetConsensus().llmqs) {
+        // the keys of a type are ordered by the quorum hash, so all of them need to be looked at
+        auto firstKey = std::make_tuple(strPrefix, p.first, uint256());
+        dbIt->Seek(firstKey);
+
+        while (dbIt->Valid()) {
+            // only the leading part of longer keys is deserialized
+            decltype(firstKey) curKey;
+            if (!dbIt->GetKey(curKey) || std::get<0>(curKey) != strPrefix || std::get<1>(curKey) != p.first) {
+                break;
+            }
+            auto pindexQuorum = LookupBlockIndex(std::get<2>(curKey));
+            if (pindexQuorum == nullptr || pindexQuorum->nHeight < nKeepHeight) {
+                batch.Erase(dbIt->GetKey());
+                nCount++;
+            }
+            dbIt->Next();
+        }
+    }
+    db.WriteBatch(batch);
+    return nCount;
+}
+
 uint256 CLLMQUtils::BuildCommitmentHash(Consensus::LLMQType llmqType, const uint256& blockHash, const std::vector<bool>& validMembers, const CBLSPublicKey& pubKey, const uint256& vvecHash)
 {
     CHashWriter hw(SER_NETWORK, 0);
@@ -198,27 +265,65 @@ std::set<size_t> CLLMQUtils::CalcDeterministicWatchConnections(Consensus::LLMQTy
     return result;
 }
 
+// The connections of a masternode to a quorum only depend on the quorum and on whether all members connect to each other
+struct QuorumConnectionSets {
+    bool fAllMembersConnected;
+    bool fMember;
+    std::set<uint256> connections;
+    std::set<uint256> relayMembers;
+};
+
 bool CLLMQUtils::EnsureQuorumConnections(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum, const uint256& myProTxHash)
 {
-    auto members = GetAllQuorumMembers(llmqType, pindexQuorum);
-    bool isMember = std::find_if(members.begin(), members.end(), [&](const CDeterministicMNCPtr& dmn) { return dmn->proTxHash == myProTxHash; }) != members.end();
+    // This is called for all active quorums of all types at every block, so the sets are only computed once per quorum
+    static CCriticalSection cs_connectionSets;
+    static std::map<Consensus::LLMQType, unordered_lru_cache<uint256, std::shared_ptr<const QuorumConnectionSets>, StaticSaltedHasher>> mapConnectionSets;
 
-    if (!isMember && !CLLMQUtils::IsWatchQuorumsEnabled()) {
-        return false;
+    bool fAllMembersConnected = IsAllMembersConnectedEnabled(llmqType);
+    uint256 cacheKey = ::SerializeHash(std::make_pair(pindexQuorum->GetBlockHash(), myProTxHash));
+    std::shared_ptr<const QuorumConnectionSets> sets;
+    {
+        LOCK(cs_connectionSets);
+        if (mapConnectionSets.empty()) {
+            for (const auto& p : Params().GetConsensus().llmqs) {
+                mapConnectionSets.emplace(std::piecewise_construct, std::forward_as_tuple(p.first),
+                                          std::forward_as_tuple(p.second.keepOldConnections + 1));
+            }
+        }
+        if (mapConnectionSets.at(llmqType).get(cacheKey, sets) && sets->fAllMembersConnected != fAllMembersConnected) {
+            sets = nullptr;
+        }
     }
 
-    std::set<uint256> connections;
-    std::set<uint256> relayMembers;
-    if (isMember) {
-        connections = CLLMQUtils::GetQuorumConnections(llmqType, pindexQuorum, myProTxHash, true);
-        relayMembers = CLLMQUtils::GetQuorumRelayMembers(llmqType, pindexQuorum, myProTxHash, true);
-    } else {
-        auto cindexes = CLLMQUtils::CalcDeterministicWatchConnections(llmqType, pindexQuorum, members.size(), 1);
-        for (auto idx : cindexes) {
-            connections.emplace(members[idx]->proTxHash);
+    if (!sets) {
+        auto members = GetAllQuorumMembers(llmqType, pindexQuorum);
+        auto newSets = std::make_shared<QuorumConnectionSets>();
+        newSets->fAllMembersConnected = fAllMembersConnected;
+        newSets->fMember = std::find_if(members.begin(), members.end(), [&](const CDeterministicMNCPtr& dmn) { return dmn->proTxHash == myProTxHash; }) != members.end();
+        if (newSets->fMember) {
+            newSets->connections = CLLMQUtils::GetQuorumConnections(llmqType, pindexQuorum, myProTxHash, true);
+            newSets->relayMembers = CLLMQUtils::GetQuorumRelayMembers(llmqType, pindexQuorum, myProTxHash, true);
+        } else if (!members.empty()) {
+            auto cindexes = CLLMQUtils::CalcDeterministicWatchConnections(llmqType, pindexQuorum, members.size(), 1);
+            for (auto idx : cindexes) {
+                newSets->connections.emplace(members[idx]->proTxHash);
+            }
+            newSets->relayMembers = newSets->connections;
         }
-        relayMembers = connections;
+        // members are only empty while the quorum type isn't enabled, which may still change
+        if (!members.empty()) {
+            LOCK(cs_connectionSets);
+            mapConnectionSets.at(llmqType).insert(cacheKey, newSets);
+        }
+        sets = newSets;
     }
+
+    if (!sets->fMember && !CLLMQUtils::IsWatchQuorumsEnabled()) {
+        return false;
+    }
+
+    const auto& connections = sets->connections;
+    const auto& relayMembers = sets->relayMembers;
     if (!connections.empty()) {
         if (!g_connman->HasMasternodeQuorumNodes(llmqType, pindexQuorum->GetBlockHash()) && LogAcceptCategory(BCLog::LLMQ)) {
             auto mnList = deterministicMNManager->GetListAtChainTip();
@@ -12,6 +12,7 @@
 #include <vector>
 #include <random.h>
 
+class CDBWrapper;
 class VersionBitsCache;
 
 namespace llmq
@@ -35,6 +36,10 @@ class CLLMQUtils
 public:
     // includes members which failed DKG
     static std::vector<CDeterministicMNCPtr> GetAllQuorumMembers(Consensus::LLMQType llmqType, const CBlockIndex* pindexQuorum);
+    // Removes the stored members of the quorums below nKeepHeight, returns how many were removed
+    static size_t PruneQuorumMembers(int nKeepHeight);
+    // Removes the entries of db with (strPrefix, llmqType, quorumHash, ...) keys whose quorum is below nKeepHeight
+    static size_t PruneQuorumEntries(CDBWrapper& db, const std::string& strPrefix, int nKeepHeight);
 
     static uint256 BuildCommitmentHash(Consensus::LLMQType llmqType, const uint256& blockHash, const std::vector<bool>& validMembers, const CBLSPublicKey& pubKey, const uint256& vvecHash);
     static uint256 BuildSignHash(Consensus::LLMQType llmqType, const uint256& quorumHash, const uint256& id, const uint256& msgHash);
@@ -7,8 +7,14 @@
 #include <util.h>
 #include <utilstrencodings.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <thread>
 
 const char * const DEFAULT_DEBUGLOGFILE = "debug.log";
 
@@ -19,6 +25,7 @@ bool fLogTimestamps = DEFAULT_LOGTIMESTAMPS;
 bool fLogTimeMicros = DEFAULT_LOGTIMEMICROS;
 bool fLogThreadNames = DEFAULT_LOGTHREADNAMES;
 bool fLogIPs = DEFAULT_LOGIPS;
+bool fLogJSON = DEFAULT_LOGJSON;
 std::atomic<bool> fReopenDebugLog(false);
 
 /** Log categories bitfield. */
@@ -224,75 +231,110 @@ std::string ListActiveLogCategoriesString()
     return ret;
 }
 
-/**
- * fStartedNewLine is a state variable held by the calling context that will
- * suppress printing of the timestamp when multiple calls are made that don't
- * end in a newline. Initialize it to true, and hold it, in the calling context.
- */
-static std::string LogTimestampStr(const std::string &str, std::atomic_bool *fStartedNewLine)
+static std::string LogCategoryName(uint64_t category)
 {
-    std::string strStamped;
-
-    if (!fLogTimestamps)
-        return str;
-
-    if (*fStartedNewLine) {
-        int64_t nTimeMicros = GetTimeMicros();
-        strStamped = FormatISO8601DateTime(nTimeMicros/1000000);
-        if (fLogTimeMicros) {
-            strStamped.pop_back();
-            strStamped += strprintf(".%06dZ", nTimeMicros%1000000);
-        }
-        int64_t mocktime = GetMockTime();
-        if (mocktime) {
-            strStamped += " (mocktime: " + FormatISO8601DateTime(mocktime) + ")";
+    for (unsigned int i = 0; i < ARRAYLEN(LogCategories); i++) {
+        if (LogCategories[i].flag != BCLog::NONE && LogCategories[i].flag != BCLog::ALL && (LogCategories[i].flag & category)) {
+            return LogCategories[i].category;
         }
-        strStamped += ' ' + str;
-    } else
-        strStamped = str;
-
-    return strStamped;
+    }
+    return "";
 }
 
-/**
- * fStartedNewLine is a state variable held by the calling context that will
- * suppress printing of the thread name when multiple calls are made that don't
- * end in a newline. Initialize it to true, and hold/manage it, in the calling context.
- */
-static std::string LogThreadNameStr(const std::string &str, std::atomic_bool *fStartedNewLine)
+/** A message passed to LogPrintStr, with what's needed to format it later */
+struct CLogRecord
 {
-    std::string strThreadLogged;
-
-    if (!fLogThreadNames)
-        return str;
-
-    std::string strThreadName = GetThreadName();
-
-    if (*fStartedNewLine)
-        strThreadLogged = strprintf("%16s | %s", strThreadName.c_str(), str.c_str());
-    else
-        strThreadLogged = str;
+    uint64_t nSeq{0};
+    int64_t nTimeMicros{0};
+    int64_t nMockTime{0};
+    uint64_t category{BCLog::NONE};
+    // false if the previous message didn't end in a newline, the timestamp and thread name are suppressed then
+    bool fStartedNewLine{true};
+    std::string strThreadName;
+    std::string str;
+};
 
-    return strThreadLogged;
+static std::string LogTimeStr(const CLogRecord& record)
+{
+    std::string strTime = FormatISO8601DateTime(record.nTimeMicros / 1000000);
+    if (fLogTimeMicros) {
+        strTime.pop_back();
+        strTime += strprintf(".%06dZ", record.nTimeMicros % 1000000);
+    }
+    return strTime;
 }
 
-int LogPrintStr(const std::string &str)
+static void JSONEscape(const std::string& str, std::string& strOut)
 {
-    int ret = 0; // Returns total number of characters written
-    static std::atomic_bool fStartedNewLine(true);
+    for (unsigned char c : str) {
+        switch (c) {
+        case '"': strOut += "\\\""; break;
+        case '\\': strOut += "\\\\"; break;
+        case '\n': strOut += "\\n"; break;
+        case '\r': strOut += "\\r"; break;
+        case '\t': strOut += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                strOut += strprintf("\\u%04x", c);
+            } else {
+                strOut += c;
+            }
+        }
+    }
+}
 
-    std::string strThreadLogged = LogThreadNameStr(str, &fStartedNewLine);
-    std::string strTimestamped = LogTimestampStr(strThreadLogged, &fStartedNewLine);
+/** Appends the line(s) of the record to strOut, e.g. with the timestamp and the thread name */
+static void FormatLogRecord(const CLogRecord& record, std::string& strOut)
+{
+    if (fLogJSON) {
+        // one object per message, also for the parts of a line logged by several calls
+        strOut += "{";
+        if (fLogTimestamps) {
+            strOut += "\"time\":\"" + LogTimeStr(record) + "\",";
+            if (record.nMockTime) {
+                strOut += "\"mocktime\":\"" + FormatISO8601DateTime(record.nMockTime) + "\",";
+            }
+        }
+        if (fLogThreadNames) {
+            strOut += "\"thread\":\"";
+            JSONEscape(record.strThreadName, strOut);
+            strOut += "\",";
+        }
+        if (record.category != BCLog::NONE) {
+            strOut += "\"category\":\"" + LogCategoryName(record.category) + "\",";
+        }
+        strOut += "\"msg\":\"";
+        bool fNewLine = !record.str.empty() && record.str.back() == '\n';
+        JSONEscape(fNewLine ? record.str.substr(0, record.str.size() - 1) : record.str, strOut);
+        strOut += "\"}\n";
+        return;
+    }
 
-    if (!str.empty() && str[str.size()-1] == '\n')
-        fStartedNewLine = true;
-    else
-        fStartedNewLine = false;
+    if (!record.fStartedNewLine) {
+        strOut += record.str;
+        return;
+    }
+    if (fLogTimestamps) {
+        strOut += LogTimeStr(record);
+        if (record.nMockTime) {
+            strOut += " (mocktime: " + FormatISO8601DateTime(record.nMockTime) + ")";
+        }
+        strOut += ' ';
+    }
+    if (fLogThreadNames) {
+        strOut += strprintf("%16s | ", record.strThreadName);
+    }
+    strOut += record.str;
+}
 
+/** Writes formatted log lines to the console or the debug log, returns the number of characters written */
+static int WriteLogStr(const std::string& str)
+{
+    int ret = 0;
     if (fPrintToConsole)
     {
         // print to console
-        ret = fwrite(strTimestamped.data(), 1, strTimestamped.size(), stdout);
+        ret = fwrite(str.data(), 1, str.size(), stdout);
         fflush(stdout);
     }
     else if (fPrintToDebugLog)
@@ -303,8 +345,8 @@ int LogPrintStr(const std::string &str)
         // buffer if we haven't opened the log yet
         if (fileout == nullptr) {
             assert(vMsgsBeforeOpenLog);
-            ret = strTimestamped.length();
-            vMsgsBeforeOpenLog->push_back(strTimestamped);
+            ret = str.length();
+            vMsgsBeforeOpenLog->push_back(str);
         }
         else
         {
@@ -316,12 +358,268 @@ int LogPrintStr(const std::string &str)
                     setbuf(fileout, nullptr); // unbuffered
             }
 
-            ret = FileWriteStr(strTimestamped, fileout);
+            ret = FileWriteStr(str, fileout);
         }
     }
     return ret;
 }
 
+/**
+ * The messages of one thread on their way to the writer thread of CAsyncLogger. Only the owning thread pushes and
+ * only the writer pops, so the two indexes are all the synchronization needed.
+ */
+class CLogRing
+{
+public:
+    static const size_t SIZE = 512;
+
+    // set when the owning thread exited, the writer drops the ring once it's empty
+    std::atomic<bool> fOrphaned{false};
+
+    bool TryPush(CLogRecord&& record)
+    {
+        size_t nTail = m_tail.load(std::memory_order_relaxed);
+        if (nTail - m_head.load(std::memory_order_acquire) == SIZE) {
+            return false;
+        }
+        m_records[nTail % SIZE] = std::move(record);
+        m_tail.store(nTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(CLogRecord& recordRet)
+    {
+        size_t nHead = m_head.load(std::memory_order_relaxed);
+        if (nHead == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        recordRet = std::move(m_records[nHead % SIZE]);
+        m_head.store(nHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<CLogRecord, SIZE> m_records;
+    std::atomic<size_t> m_head{0};
+    std::atomic<size_t> m_tail{0};
+};
+
+/**
+ * Writes the log on a background thread. Each logging thread queues its messages in a CLogRing of its own, the
+ * writer collects them, restores their order and writes them with one call per batch.
+ */
+class CAsyncLogger
+{
+public:
+    explicit CAsyncLogger(bool fDropOnOverflowIn) :
+        fDropOnOverflow(fDropOnOverflowIn),
+        writerThread(&CAsyncLogger::Loop, this)
+    {
+    }
+
+    //! Returns false if the logger was stopped, the caller has to write the message itself then
+    bool Push(CLogRecord&& record)
+    {
+        CLogRing* pring = GetThreadRing();
+        if (pring == nullptr) {
+            return false;
+        }
+        while (!pring->TryPush(std::move(record))) {
+            if (fDropOnOverflow) {
+                nDropped++;
+                return true;
+            }
+            // wait for the writer rather than losing the message
+            Wake();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (fStopped) {
+                return false;
+            }
+        }
+        if (pring->size() == CLogRing::SIZE / 2) {
+            Wake();
+        }
+        return true;
+    }
+
+    void Stop()
+    {
+        {
+            std::unique_lock<std::mutex> l(mutex);
+            fStop = true;
+        }
+        cond.notify_one();
+        writerThread.join();
+        // whatever came in between the last round and the threads noticing the stop
+        std::unique_lock<std::mutex> l(mutex);
+        WriteQueued(vRings);
+    }
+
+private:
+    struct ThreadRing
+    {
+        const CAsyncLogger* owner{nullptr};
+        std::shared_ptr<CLogRing> ring;
+        ~ThreadRing()
+        {
+            if (ring) {
+                ring->fOrphaned = true;
+            }
+        }
+    };
+
+    const bool fDropOnOverflow;
+    std::atomic<uint64_t> nDropped{0};
+    std::atomic<bool> fStopped{false};
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool fStop{false};
+    bool fWake{false};
+    std::vector<std::shared_ptr<CLogRing>> vRings;
+    std::thread writerThread;
+
+    CLogRing* GetThreadRing()
+    {
+        static thread_local ThreadRing threadRing;
+        if (threadRing.owner != this) {
+            std::unique_lock<std::mutex> l(mutex);
+            if (fStop) {
+                return nullptr;
+            }
+            threadRing.owner = this;
+            threadRing.ring = std::make_shared<CLogRing>();
+            vRings.emplace_back(threadRing.ring);
+        }
+        return fStopped ? nullptr : threadRing.ring.get();
+    }
+
+    void Wake()
+    {
+        {
+            std::unique_lock<std::mutex> l(mutex);
+            fWake = true;
+        }
+        cond.notify_one();
+    }
+
+    void Loop()
+    {
+        RenameThread("dash-logger");
+        while (true) {
+            std::vector<std::shared_ptr<CLogRing>> vCurRings;
+            bool fStopNow;
+            {
+                std::unique_lock<std::mutex> l(mutex);
+                cond.wait_for(l, std::chrono::milliseconds(100), [&]() { return fStop || fWake; });
+                fWake = false;
+                fStopNow = fStop;
+                // forget the rings of exited threads, after this round emptied them
+                vRings.erase(std::remove_if(vRings.begin(), vRings.end(), [](const std::shared_ptr<CLogRing>& ring) {
+                    return ring->fOrphaned && ring->size() == 0;
+                }), vRings.end());
+                vCurRings = vRings;
+            }
+            if (fStopNow) {
+                // the threads still logging write themselves from now on
+                fStopped = true;
+            }
+
+            WriteQueued(vCurRings);
+
+            if (fStopNow) {
+                break;
+            }
+        }
+    }
+
+    void WriteQueued(const std::vector<std::shared_ptr<CLogRing>>& vCurRings)
+    {
+        std::vector<CLogRecord> vRecords;
+        for (const auto& ring : vCurRings) {
+            CLogRecord record;
+            while (ring->TryPop(record)) {
+                vRecords.emplace_back(std::move(record));
+            }
+        }
+        // the sequence numbers restore the order of the messages of different threads
+        std::sort(vRecords.begin(), vRecords.end(), [](const CLogRecord& a, const CLogRecord& b) { return a.nSeq < b.nSeq; });
+
+        std::string strBatch;
+        uint64_t nDroppedNow = nDropped.exchange(0);
+        if (nDroppedNow != 0) {
+            CLogRecord record;
+            record.nTimeMicros = GetTimeMicros();
+            record.str = strprintf("CAsyncLogger -- dropped %d log messages\n", nDroppedNow);
+            FormatLogRecord(record, strBatch);
+        }
+        for (const auto& record : vRecords) {
+            FormatLogRecord(record, strBatch);
+        }
+        if (!strBatch.empty()) {
+            WriteLogStr(strBatch);
+        }
+    }
+};
+
+static std::atomic<uint64_t> nLogSeq{0};
+static std::mutex mutexAsyncLogger;
+// leaked like mutexDebugLog, the log can be written to until the very end
+static std::atomic<CAsyncLogger*> asyncLogger{nullptr};
+
+void StartAsyncLogging(bool fDropOnOverflow)
+{
+    std::lock_guard<std::mutex> l(mutexAsyncLogger);
+    if (asyncLogger == nullptr) {
+        asyncLogger = new CAsyncLogger(fDropOnOverflow);
+    }
+}
+
+void StopAsyncLogging()
+{
+    std::lock_guard<std::mutex> l(mutexAsyncLogger);
+    CAsyncLogger* logger = asyncLogger.exchange(nullptr);
+    if (logger != nullptr) {
+        // threads which still see the logger find it stopped and write themselves, so it's never deleted
+        logger->Stop();
+    }
+}
+
+int LogPrintStr(const std::string &str, uint64_t category)
+{
+    static std::atomic_bool fStartedNewLine(true);
+
+    CLogRecord record;
+    record.nSeq = nLogSeq++;
+    record.nTimeMicros = GetTimeMicros();
+    record.nMockTime = GetMockTime();
+    record.category = category;
+    record.fStartedNewLine = fStartedNewLine;
+    if (fLogThreadNames) {
+        record.strThreadName = GetThreadName();
+    }
+    record.str = str;
+
+    if (!str.empty() && str[str.size()-1] == '\n')
+        fStartedNewLine = true;
+    else
+        fStartedNewLine = false;
+
+    CAsyncLogger* logger = asyncLogger;
+    if (logger != nullptr && logger->Push(std::move(record))) {
+        return str.size();
+    }
+
+    std::string strFormatted;
+    FormatLogRecord(record, strFormatted);
+    return WriteLogStr(strFormatted);
+}
+
 void ShrinkDebugFile()
 {
     // Amount of debug.log to save at end when shrinking (must fit in memory)
@@ -18,6 +18,9 @@ static const bool DEFAULT_LOGTIMEMICROS  = false;
 static const bool DEFAULT_LOGIPS         = false;
 static const bool DEFAULT_LOGTIMESTAMPS  = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
+static const bool DEFAULT_LOGJSON        = false;
+static const bool DEFAULT_ASYNCLOGGING   = false;
+static const bool DEFAULT_LOGDROPONOVERFLOW = false;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 extern bool fPrintToConsole;
@@ -27,6 +30,7 @@ extern bool fLogTimestamps;
 extern bool fLogTimeMicros;
 extern bool fLogThreadNames;
 extern bool fLogIPs;
+extern bool fLogJSON;
 extern std::atomic<bool> fReopenDebugLog;
 
 extern std::atomic<uint64_t> logCategories;
@@ -100,8 +104,16 @@ std::vector<CLogCategoryActive> ListActiveLogCategories();
 /** Return true if str parses as a log category and set the flags in f */
 bool GetLogCategory(uint64_t *f, const std::string *str);
 
-/** Send a string to the log output */
-int LogPrintStr(const std::string &str);
+/** Send a string to the log output, category is the one of LogPrint or NONE for LogPrintf */
+int LogPrintStr(const std::string &str, uint64_t category = BCLog::NONE);
+
+/**
+ * Moves the writing of the log to a background thread, LogPrintStr only queues the messages then. Messages which
+ * don't fit into the queue of their thread are dropped if fDropOnOverflow is set, else the thread waits for the writer.
+ */
+void StartAsyncLogging(bool fDropOnOverflow);
+/** Writes the queued messages, the log is written by the logging threads again afterwards */
+void StopAsyncLogging();
 
 /** Formats a string without throwing exceptions. Instead, it'll return an error string instead of formatted string. */
 template<typename... Args>
@@ -134,7 +146,7 @@ template<typename T, typename... Args> static inline void MarkUsed(const T& t, c
 #define LogPrintf(...) do { MarkUsed(__VA_ARGS__); } while(0)
 #define LogPrint(category, ...) do { MarkUsed(__VA_ARGS__); } while(0)
 #else
-#define LogPrintf(...) do { \
+#define LogPrintCategory(category, ...) do { \
     if (fPrintToConsole || fPrintToDebugLog) { \
         std::string _log_msg_; /* Unlikely name to avoid shadowing variables */ \
         try { \
@@ -143,13 +155,15 @@ template<typename T, typename... Args> static inline void MarkUsed(const T& t, c
             /* Original format string will have newline so don't add one here */ \
             _log_msg_ = "Error \"" + std::string(e.what()) + "\" while formatting log message: " + FormatStringFromLogArgs(__VA_ARGS__); \
         } \
-        LogPrintStr(_log_msg_); \
+        LogPrintStr(_log_msg_, (category)); \
     } \
 } while(0)
 
+#define LogPrintf(...) LogPrintCategory(BCLog::NONE, __VA_ARGS__)
+
 #define LogPrint(category, ...) do { \
     if (LogAcceptCategory((category))) { \
-        LogPrintf(__VA_ARGS__); \
+        LogPrintCategory((category), __VA_ARGS__); \
     } \
 } while(0)
 #endif // USE_COVERAGE
@@ -84,7 +84,7 @@ std::string CMasternodeSync::GetSyncStatus() const
     }
 }
 
-void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) const
+void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
 {
     if (strCommand == NetMsgType::SYNCSTATUSCOUNT) { //Sync status count
 
@@ -96,6 +96,11 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, const std::string& strCommand
         vRecv >> nItemID >> nCount;
 
         LogPrintf("SYNCSTATUSCOUNT -- got inventory count: nItemID=%d  nCount=%d  peer=%d\n", nItemID, nCount, pfrom->GetId());
+
+        // The peer is done with the objects or the votes of an object we asked for, ask for more on the next tick
+        if (nCurrentAsset == MASTERNODE_SYNC_GOVERNANCE && (nItemID == MASTERNODE_SYNC_GOVOBJ || nItemID == MASTERNODE_SYNC_GOVOBJ_VOTE)) {
+            fTickRequested = true;
+        }
     }
 }
 
@@ -116,12 +121,13 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
         return;
     }
 
-    if(GetTime() - nTimeLastProcess < MASTERNODE_SYNC_TICK_SECONDS) {
+    if(GetTime() - nTimeLastProcess < MASTERNODE_SYNC_TICK_SECONDS && !fTickRequested) {
         // too early, nothing to do here
         return;
     }
 
     nTimeLastProcess = GetTime();
+    fTickRequested = false;
 
     // gradually request the rest of the votes after sync finished
     if(IsSynced()) {
@@ -138,6 +144,21 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
 
     std::vector<CNode*> vNodesCopy = connman.CopyNodeVector(CConnman::FullyConnectedOnly);
 
+    // Peers we already requested the governance objects from, each of them is asked for the votes of a different
+    // part of the objects first
+    const int nSyncPeers = std::max(1, std::min((int)gArgs.GetArg("-mnsyncpeers", DEFAULT_MNSYNC_PEERS), MAX_MNSYNC_PEERS));
+    std::vector<NodeId> vecGovSyncPeers;
+    size_t nNewGovSyncPeers = 0;
+    if (nCurrentAsset == MASTERNODE_SYNC_GOVERNANCE) {
+        for (const auto& pnode : vNodesCopy) {
+            if (!pnode->CanRelay() || (fMasternodeMode && pnode->fInbound)) continue;
+            if (pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
+            if (netfulfilledman.HasFulfilledRequest(pnode->addr, "governance-sync")) {
+                vecGovSyncPeers.push_back(pnode->GetId());
+            }
+        }
+    }
+
     for (auto& pnode : vNodesCopy)
     {
         CNetMsgMaker msgMaker(pnode->GetSendVersion());
@@ -240,18 +261,26 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
 
                 // only request obj sync once from each peer, then request votes on per-obj basis
                 if(netfulfilledman.HasFulfilledRequest(pnode->addr, "governance-sync")) {
-                    int nObjsLeftToAsk = governance.RequestGovernanceObjectVotes(pnode, connman);
+                    int nPartition = 0;
+                    int nPartitions = 1;
+                    auto itPeer = std::find(vecGovSyncPeers.begin(), vecGovSyncPeers.end(), pnode->GetId());
+                    if (nSyncPeers > 1 && itPeer != vecGovSyncPeers.end()) {
+                        nPartition = int(itPeer - vecGovSyncPeers.begin());
+                        nPartitions = int(vecGovSyncPeers.size());
+                    }
+                    int nObjsLeftToAsk = governance.RequestGovernanceObjectVotes(pnode, connman, nPartition, nPartitions);
                     static int64_t nTimeNoObjectsLeft = 0;
                     // check for data
                     if(nObjsLeftToAsk == 0) {
-                        static int nLastTick = 0;
+                        static int64_t nTimeLastVotesCheck = 0;
                         static int nLastVotes = 0;
                         if(nTimeNoObjectsLeft == 0) {
                             // asked all objects for votes for the first time
                             nTimeNoObjectsLeft = GetTime();
                         }
-                        // make sure the condition below is checked only once per tick
-                        if(nLastTick == nTick) continue;
+                        // make sure the condition below is checked only once per MASTERNODE_SYNC_TICK_SECONDS,
+                        // ticks requested by peers come more often
+                        if(GetTime() - nTimeLastVotesCheck < MASTERNODE_SYNC_TICK_SECONDS) continue;
                         if(GetTime() - nTimeNoObjectsLeft > MASTERNODE_SYNC_TIMEOUT_SECONDS &&
                             governance.GetVoteCount() - nLastVotes < std::max(int(0.0001 * nLastVotes), MASTERNODE_SYNC_TICK_SECONDS)
                         ) {
@@ -266,7 +295,7 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
                             connman.ReleaseNodeVector(vNodesCopy);
                             return;
                         }
-                        nLastTick = nTick;
+                        nTimeLastVotesCheck = GetTime();
                         nLastVotes = governance.GetVoteCount();
                     }
                     continue;
@@ -278,6 +307,9 @@ void CMasternodeSync::ProcessTick(CConnman& connman)
 
                 SendGovernanceSyncRequest(pnode, connman);
 
+                // ask up to -mnsyncpeers peers at once
+                if (vecGovSyncPeers.size() + ++nNewGovSyncPeers < (size_t)nSyncPeers) continue;
+
                 connman.ReleaseNodeVector(vNodesCopy);
                 return; //this will cause each peer to get one request each six seconds for the various assets we need
             }
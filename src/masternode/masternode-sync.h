@@ -7,6 +7,8 @@
 #include <chain.h>
 #include <net.h>
 
+#include <atomic>
+
 class CMasternodeSync;
 
 static const int MASTERNODE_SYNC_BLOCKCHAIN      = 1;
@@ -19,6 +21,10 @@ static const int MASTERNODE_SYNC_TICK_SECONDS    = 6;
 static const int MASTERNODE_SYNC_TIMEOUT_SECONDS = 30; // our blocks are 2.5 minutes so 30 seconds should be fine
 static const int MASTERNODE_SYNC_RESET_SECONDS = 600; // Reset fReachedBestHeader in CMasternodeSync::Reset if UpdateBlockTip hasn't been called for this seconds
 
+/** Default for -mnsyncpeers, the number of peers governance objects and votes are synced from in parallel */
+static const int DEFAULT_MNSYNC_PEERS = 4;
+static const int MAX_MNSYNC_PEERS = 16;
+
 extern CMasternodeSync masternodeSync;
 
 //
@@ -42,6 +48,8 @@ private:
     bool fReachedBestHeader{false};
     /// Last time UpdateBlockTip has been called
     int64_t nTimeLastUpdateBlockTip{0};
+    /// Set when a peer answered a sync request, so the next tick doesn't wait for MASTERNODE_SYNC_TICK_SECONDS
+    std::atomic<bool> fTickRequested{false};
 
 public:
     CMasternodeSync() { Reset(true, false); }
@@ -61,7 +69,7 @@ public:
     void Reset(bool fForce = false, bool fNotifyReset = true);
     void SwitchToNextAsset(CConnman& connman);
 
-    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) const;
+    void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv);
     void ProcessTick(CConnman& connman);
 
     void AcceptedBlockHeader(const CBlockIndex *pindexNew);
@@ -0,0 +1,33 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memaccounting.h>
+
+CMemoryAccounting g_memory_accounting;
+
+void CMemoryAccounting::Register(const std::string& strName, const void* owner, UsageFunc func)
+{
+    LOCK(cs);
+    mapEntries[strName] = Entry{owner, std::move(func)};
+}
+
+void CMemoryAccounting::Unregister(const std::string& strName, const void* owner)
+{
+    LOCK(cs);
+    auto it = mapEntries.find(strName);
+    if (it != mapEntries.end() && it->second.owner == owner) {
+        mapEntries.erase(it);
+    }
+}
+
+std::vector<std::pair<std::string, size_t>> CMemoryAccounting::GetUsages() const
+{
+    LOCK(cs);
+    std::vector<std::pair<std::string, size_t>> ret;
+    ret.reserve(mapEntries.size());
+    for (const auto& p : mapEntries) {
+        ret.emplace_back(p.first, p.second.func());
+    }
+    return ret;
+}
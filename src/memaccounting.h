@@ -0,0 +1,54 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MEMACCOUNTING_H
+#define BITCOIN_MEMACCOUNTING_H
+
+#include <sync.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Registry of the subsystems which can estimate the heap memory their caches and maps use, so that getmemoryinfo
+ * and the stats can report all of them without knowing each one.
+ *
+ * A subsystem registers a function returning its current usage in bytes under a unique name, usually from its
+ * constructor, and unregisters it again before it is destroyed. The functions are called with the registry's lock
+ * held, so they must only take the locks of their own subsystem and must not be slow: they are called for each
+ * getmemoryinfo call and each stats period.
+ */
+class CMemoryAccounting
+{
+public:
+    typedef std::function<size_t()> UsageFunc;
+
+private:
+    struct Entry {
+        const void* owner;
+        UsageFunc func;
+    };
+
+    mutable CCriticalSection cs;
+    std::map<std::string, Entry> mapEntries GUARDED_BY(cs);
+
+public:
+    /**
+     * Register func under strName, replacing a previous registration of the name. owner identifies the
+     * registration for Unregister, so that the destructor of a replaced object doesn't remove its successor.
+     */
+    void Register(const std::string& strName, const void* owner, UsageFunc func);
+    /** Remove the registration of strName if it was made by owner */
+    void Unregister(const std::string& strName, const void* owner);
+
+    /** The current usage of each registered subsystem, sorted by name */
+    std::vector<std::pair<std::string, size_t>> GetUsages() const;
+};
+
+extern CMemoryAccounting g_memory_accounting;
+
+#endif // BITCOIN_MEMACCOUNTING_H
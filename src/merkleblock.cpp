@@ -10,8 +10,10 @@
 #include <utilstrencodings.h>
 
 
-CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter* filter, const std::set<uint256>* txids)
+CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter* filter, const std::set<uint256>* txids, const CBloomBlockElements* elements)
 {
+    assert(!elements || elements->vtx.size() == block.vtx.size());
+
     header = block.GetBlockHeader();
 
     std::vector<bool> vMatch;
@@ -37,7 +39,7 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter* filter, const std:
 
         if (txids && txids->count(hash)) {
             vMatch.push_back(true);
-        } else if (isAllowedType && filter && filter->IsRelevantAndUpdate(*block.vtx[i])) {
+        } else if (isAllowedType && filter && (elements ? filter->IsRelevantAndUpdate(tx, elements->vtx[i]) : filter->IsRelevantAndUpdate(tx))) {
             vMatch.push_back(true);
             vMatchedTxn.emplace_back(i, hash);
         } else {
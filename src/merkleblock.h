@@ -150,10 +150,16 @@ public:
      * Note that this will call IsRelevantAndUpdate on the filter for each transaction,
      * thus the filter will likely be modified.
      */
-    CMerkleBlock(const CBlock& block, CBloomFilter& filter) : CMerkleBlock(block, &filter, nullptr) { }
+    CMerkleBlock(const CBlock& block, CBloomFilter& filter) : CMerkleBlock(block, &filter, nullptr, nullptr) { }
+
+    /**
+     * Same as above, with the data elements of the transactions taken from elements, which must have been created
+     * from the same block. This is what makes serving the block to many filtered peers cheap.
+     */
+    CMerkleBlock(const CBlock& block, CBloomFilter& filter, const CBloomBlockElements& elements) : CMerkleBlock(block, &filter, nullptr, &elements) { }
 
     // Create from a CBlock, matching the txids in the set
-    CMerkleBlock(const CBlock& block, const std::set<uint256>& txids) : CMerkleBlock(block, nullptr, &txids) { }
+    CMerkleBlock(const CBlock& block, const std::set<uint256>& txids) : CMerkleBlock(block, nullptr, &txids, nullptr) { }
 
     CMerkleBlock() {}
 
@@ -167,7 +173,7 @@ public:
 
 private:
     // Combined constructor to consolidate code
-    CMerkleBlock(const CBlock& block, CBloomFilter* filter, const std::set<uint256>* txids);
+    CMerkleBlock(const CBlock& block, CBloomFilter* filter, const std::set<uint256>* txids, const CBloomBlockElements* elements);
 };
 
 #endif // BITCOIN_MERKLEBLOCK_H
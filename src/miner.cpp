@@ -66,11 +66,13 @@ int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParam
 BlockAssembler::Options::Options() {
     blockMinFeeRate = CFeeRate(DEFAULT_BLOCK_MIN_TX_FEE);
     nBlockMaxSize = DEFAULT_BLOCK_MAX_SIZE;
+    fFastValidityCheck = DEFAULT_BLOCKTEMPLATE_FASTCHECK;
 }
 
 BlockAssembler::BlockAssembler(const CChainParams& params, const Options& options) : chainparams(params)
 {
     blockMinFeeRate = options.blockMinFeeRate;
+    fFastValidityCheck = options.fFastValidityCheck;
     // Limit size to between 1K and MaxBlockSize()-1K for sanity:
     nBlockMaxSize = std::max((unsigned int)1000, std::min((unsigned int)(MaxBlockSize(fDIP0001ActiveAtTip) - 1000), (unsigned int)options.nBlockMaxSize));
 }
@@ -89,6 +91,7 @@ static BlockAssembler::Options DefaultOptions(const CChainParams& params)
     } else {
         options.blockMinFeeRate = CFeeRate(DEFAULT_BLOCK_MIN_TX_FEE);
     }
+    options.fFastValidityCheck = gArgs.GetBoolArg("-blocktemplatefastcheck", DEFAULT_BLOCKTEMPLATE_FASTCHECK);
     return options;
 }
 
@@ -228,13 +231,27 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     pblocktemplate->nPrevBits = pindexPrev->nBits;
     pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(*pblock->vtx[0]);
 
+    int64_t nTime2 = GetTimeMicros();
+
+    // All non-coinbase TXs are either mined quorum commitments, which were verified when they were received, or come
+    // from the mempool and were fully validated against the current tip when they were accepted. The fast check thus
+    // only needs to look at block-level rules and at the coinbase, which is the only thing that was created here.
     CValidationState state;
-    if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
+    if (fFastValidityCheck) {
+        if (!TestBlockTemplateValidity(state, chainparams, *pblock, pindexPrev, nFees)) {
+            throw std::runtime_error(strprintf("%s: TestBlockTemplateValidity failed: %s", __func__, FormatStateMessage(state)));
+        }
+    } else if (!TestBlockValidity(state, chainparams, *pblock, pindexPrev, false, false)) {
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
-    int64_t nTime2 = GetTimeMicros();
+    int64_t nTime3 = GetTimeMicros();
+
+    pblocktemplate->nTimePackages = nTime1 - nTimeStart;
+    pblocktemplate->nTimeCoinbase = nTime2 - nTime1;
+    pblocktemplate->nTimeValidity = nTime3 - nTime2;
+    pblocktemplate->fFastValidityCheck = fFastValidityCheck;
 
-    LogPrint(BCLog::BENCHMARK, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCHMARK, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), coinbase: %.2fms, validity (%s): %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), fFastValidityCheck ? "fast" : "full", 0.001 * (nTime3 - nTime2), 0.001 * (nTime3 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
@@ -505,3 +522,102 @@ void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned
     pblock->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
     pblock->hashMerkleRoot = BlockMerkleRoot(*pblock);
 }
+
+std::unique_ptr<CBlockTemplateCache> g_block_template_cache;
+
+void CBlockTemplateCache::ThreadMain()
+{
+    RenameThread("dash-blocktmpl");
+
+    int64_t nLastBuildTime = 0;
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fDirty) {
+                cond.wait(lock);
+            }
+            // a new tip makes the current template useless, everything else is batched up
+            while (!fTipChanged) {
+                int64_t nWait = nLastBuildTime + BLOCKTEMPLATE_PRECOMPUTE_INTERVAL - GetTimeMillis();
+                if (nWait <= 0) {
+                    break;
+                }
+                cond.wait_for(lock, boost::chrono::milliseconds(nWait));
+            }
+            fDirty = false;
+            fTipChanged = false;
+        }
+        nLastBuildTime = GetTimeMillis();
+        Build();
+        boost::this_thread::interruption_point();
+    }
+}
+
+void CBlockTemplateCache::Build()
+{
+    // getblocktemplate needs governance data to build superblocks, it refuses to work or falls back to building its
+    // own template until we're synced
+    if (!masternodeSync.IsSynced()) {
+        return;
+    }
+
+    Entry entry;
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    {
+        LOCK(cs_main);
+        if (IsInitialBlockDownload()) {
+            return;
+        }
+        entry.pindexPrev = chainActive.Tip();
+        entry.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+        entry.nTime = GetTime();
+        try {
+            pblocktemplate = BlockAssembler(Params()).CreateNewBlock(CScript() << OP_TRUE);
+        } catch (const std::exception& e) {
+            LogPrintf("CBlockTemplateCache::%s -- %s\n", __func__, e.what());
+            return;
+        }
+    }
+    if (!pblocktemplate) {
+        return;
+    }
+    entry.pblocktemplate = std::move(pblocktemplate);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    current = std::move(entry);
+}
+
+bool CBlockTemplateCache::Get(const CBlockIndex* pindexPrev, Entry& ret)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (!current.pblocktemplate || current.pindexPrev != pindexPrev) {
+        return false;
+    }
+    ret = current;
+    return true;
+}
+
+void CBlockTemplateCache::MarkDirty(bool fTip)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fDirty = true;
+    fTipChanged |= fTip;
+    cond.notify_one();
+}
+
+void CBlockTemplateCache::UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload)
+{
+    if (!fInitialDownload) {
+        MarkDirty(true);
+    }
+}
+
+void CBlockTemplateCache::TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime)
+{
+    MarkDirty(false);
+}
+
+void CBlockTemplateCache::TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason)
+{
+    MarkDirty(false);
+}
@@ -9,11 +9,14 @@
 #include <primitives/block.h>
 #include <txmempool.h>
 #include <validation.h>
+#include <validationinterface.h>
 
 #include <stdint.h>
 #include <memory>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 class CBlockIndex;
 class CChainParams;
@@ -23,6 +26,10 @@ class CScript;
 namespace Consensus { struct Params; };
 
 static const bool DEFAULT_PRINTPRIORITY = false;
+static const bool DEFAULT_BLOCKTEMPLATE_PRECOMPUTE = false;
+static const bool DEFAULT_BLOCKTEMPLATE_FASTCHECK = false;
+/** Minimum time in milliseconds between two template rebuilds caused by mempool changes */
+static const int64_t BLOCKTEMPLATE_PRECOMPUTE_INTERVAL = 250;
 
 struct CBlockTemplate
 {
@@ -32,6 +39,12 @@ struct CBlockTemplate
     uint32_t nPrevBits; // nBits of previous block (for subsidy calculation)
     std::vector<CTxOut> voutMasternodePayments; // masternode payment
     std::vector<CTxOut> voutSuperblockPayments; // superblock payment
+
+    // Time spent in the different phases of CreateNewBlock, in microseconds
+    int64_t nTimePackages{0};
+    int64_t nTimeCoinbase{0};
+    int64_t nTimeValidity{0};
+    bool fFastValidityCheck{false};
 };
 
 // Container for tracking updates to ancestor feerate as we include (parent)
@@ -135,6 +148,7 @@ private:
     // Configuration parameters for the block size
     unsigned int nBlockMaxSize;
     CFeeRate blockMinFeeRate;
+    bool fFastValidityCheck;
 
     // Information on the current status of the block
     uint64_t nBlockSize;
@@ -153,6 +167,8 @@ public:
         Options();
         size_t nBlockMaxSize;
         CFeeRate blockMinFeeRate;
+        /** Use TestBlockTemplateValidity instead of TestBlockValidity */
+        bool fFastValidityCheck;
     };
 
     explicit BlockAssembler(const CChainParams& params);
@@ -199,4 +215,43 @@ private:
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
 
+/**
+ * Keeps a getblocktemplate template on top of the current tip ready, so that polling miners don't have to wait for
+ * CreateNewBlock. Tip changes and mempool updates only mark the template as dirty, ThreadMain() then rebuilds it right
+ * away for a new tip and at most every BLOCKTEMPLATE_PRECOMPUTE_INTERVAL for mempool changes.
+ */
+class CBlockTemplateCache final : public CValidationInterface
+{
+public:
+    struct Entry {
+        std::shared_ptr<const CBlockTemplate> pblocktemplate;
+        const CBlockIndex* pindexPrev{nullptr};
+        // mempool.GetTransactionsUpdated() and GetTime() from right before the template was built
+        unsigned int nTransactionsUpdated{0};
+        int64_t nTime{0};
+    };
+
+    void ThreadMain();
+
+    /** Get the most recent template built on top of pindexPrev */
+    bool Get(const CBlockIndex* pindexPrev, Entry& ret);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindexNew, const CBlockIndex* pindexFork, bool fInitialDownload) override;
+    void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime) override;
+    void TransactionRemovedFromMempool(const CTransactionRef& tx, MemPoolRemovalReason reason) override;
+
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fDirty{true};
+    bool fTipChanged{true};
+    Entry current;
+
+    void MarkDirty(bool fTip);
+    void Build();
+};
+
+extern std::unique_ptr<CBlockTemplateCache> g_block_template_cache;
+
 #endif // BITCOIN_MINER_H
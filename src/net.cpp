@@ -21,6 +21,7 @@
 #include <scheduler.h>
 #include <ui_interface.h>
 #include <utilstrencodings.h>
+#include <utiltrace.h>
 #include <validation.h>
 
 #include <masternode/masternode-meta.h>
@@ -34,6 +35,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_POLL
@@ -105,6 +107,11 @@ static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 50;
 static const uint64_t SELECT_TIMEOUT_MILLISECONDS = 500;
 #endif
 
+#ifndef WIN32
+// Number of queued messages handed to sendmsg() at once, well below IOV_MAX on all supported platforms
+static const size_t MAX_SEND_IOVECS = 64;
+#endif
+
 const static std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 constexpr const CConnman::CFullyConnectedOnly CConnman::FullyConnectedOnly;
@@ -123,6 +130,9 @@ std::map<CNetAddr, LocalServiceInfo> mapLocalHost GUARDED_BY(cs_mapLocalHost);
 static bool vfLimited[NET_MAX] GUARDED_BY(cs_mapLocalHost) = {};
 std::string strSubVersion;
 
+CNetBufferPool<CSerializeData> g_recv_buffer_pool;
+CNetBufferPool<std::vector<unsigned char>> g_send_buffer_pool;
+
 void CConnman::AddOneShot(const std::string& strDest)
 {
     LOCK(cs_vOneShots);
@@ -575,6 +585,7 @@ void CConnman::ClearBanned()
     {
         LOCK(cs_setBanned);
         setBanned.clear();
+        banIndex.Clear();
         setBannedIsDirty = true;
     }
     DumpBanlist(); //store banlist to disk
@@ -585,15 +596,7 @@ void CConnman::ClearBanned()
 bool CConnman::IsBanned(CNetAddr ip)
 {
     LOCK(cs_setBanned);
-    for (const auto& it : setBanned) {
-        CSubNet subNet = it.first;
-        CBanEntry banEntry = it.second;
-
-        if (subNet.Match(ip) && GetTime() < banEntry.nBanUntil) {
-            return true;
-        }
-    }
-    return false;
+    return banIndex.IsBanned(ip, GetTime());
 }
 
 bool CConnman::IsBanned(CSubNet subnet)
@@ -616,6 +619,10 @@ void CConnman::Ban(const CNetAddr& addr, const BanReason &banReason, int64_t ban
 }
 
 void CConnman::Ban(const CSubNet& subNet, const BanReason &banReason, int64_t bantimeoffset, bool sinceUnixEpoch) {
+    Ban(std::vector<CSubNet>{subNet}, banReason, bantimeoffset, sinceUnixEpoch);
+}
+
+void CConnman::Ban(const std::vector<CSubNet>& vSubNets, const BanReason &banReason, int64_t bantimeoffset, bool sinceUnixEpoch) {
     CBanEntry banEntry(GetTime());
     banEntry.banReason = banReason;
     if (bantimeoffset <= 0)
@@ -625,21 +632,37 @@ void CConnman::Ban(const CSubNet& subNet, const BanReason &banReason, int64_t ba
     }
     banEntry.nBanUntil = (sinceUnixEpoch ? 0 : GetTime() )+bantimeoffset;
 
+    // the subnets which are banned for longer now, to disconnect their nodes
+    CBanIndex newBans;
     {
         LOCK(cs_setBanned);
-        if (setBanned[subNet].nBanUntil < banEntry.nBanUntil) {
-            setBanned[subNet] = banEntry;
+        for (const CSubNet& subNet : vSubNets) {
+            auto it = setBanned.find(subNet);
+            if (it == setBanned.end()) {
+                if (banEntry.nBanUntil <= 0) {
+                    continue;
+                }
+                setBanned.emplace(subNet, banEntry);
+            } else if (it->second.nBanUntil < banEntry.nBanUntil) {
+                banIndex.Erase(subNet, it->second.nBanUntil);
+                it->second = banEntry;
+            } else {
+                continue;
+            }
+            banIndex.Insert(subNet, banEntry.nBanUntil);
+            newBans.Insert(subNet, banEntry.nBanUntil);
             setBannedIsDirty = true;
         }
-        else
-            return;
     }
+    if (newBans.size() == 0)
+        return;
     if(clientInterface)
         clientInterface->BannedListChanged();
     {
         LOCK(cs_vNodes);
         for (CNode* pnode : vNodes) {
-            if (subNet.Match(static_cast<CNetAddr>(pnode->addr)))
+            // all of newBans end at nBanUntil, so this matches them even when it is in the past
+            if (newBans.IsBanned(static_cast<CNetAddr>(pnode->addr), banEntry.nBanUntil - 1))
                 pnode->fDisconnect = true;
         }
     }
@@ -655,8 +678,11 @@ bool CConnman::Unban(const CNetAddr &addr) {
 bool CConnman::Unban(const CSubNet &subNet) {
     {
         LOCK(cs_setBanned);
-        if (!setBanned.erase(subNet))
+        auto it = setBanned.find(subNet);
+        if (it == setBanned.end())
             return false;
+        banIndex.Erase(subNet, it->second.nBanUntil);
+        setBanned.erase(it);
         setBannedIsDirty = true;
     }
     if(clientInterface)
@@ -677,6 +703,10 @@ void CConnman::SetBanned(const banmap_t &banMap)
 {
     LOCK(cs_setBanned);
     setBanned = banMap;
+    banIndex.Clear();
+    for (const auto& p : setBanned) {
+        banIndex.Insert(p.first, p.second.nBanUntil);
+    }
     setBannedIsDirty = true;
 }
 
@@ -686,20 +716,14 @@ void CConnman::SweepBanned()
     bool notifyUI = false;
     {
         LOCK(cs_setBanned);
-        banmap_t::iterator it = setBanned.begin();
-        while(it != setBanned.end())
-        {
-            CSubNet subNet = (*it).first;
-            CBanEntry banEntry = (*it).second;
-            if(now > banEntry.nBanUntil)
-            {
-                setBanned.erase(it++);
-                setBannedIsDirty = true;
-                notifyUI = true;
-                LogPrint(BCLog::NET, "%s: Removed banned node ip/subnet from banlist.dat: %s\n", __func__, subNet.ToString());
-            }
-            else
-                ++it;
+        // only the expired bans are visited, the index has them ordered by their expiry time
+        for (const auto& p : banIndex.GetExpired(now)) {
+            const CSubNet& subNet = p.second;
+            banIndex.Erase(subNet, p.first);
+            setBanned.erase(subNet);
+            setBannedIsDirty = true;
+            notifyUI = true;
+            LogPrint(BCLog::NET, "%s: Removed banned node ip/subnet from banlist.dat: %s\n", __func__, subNet.ToString());
         }
     }
     // update UI
@@ -795,6 +819,11 @@ void CNode::copyStats(CNodeStats &stats)
         X(mapRecvBytesPerMsgCmd);
         X(nRecvBytes);
     }
+    {
+        LOCK(cs_msgProcessing);
+        X(nProcessingTimeMicros);
+        X(mapProcessingPerMsgCmd);
+    }
     X(fWhitelisted);
 
     // It is common for nodes with good ping times to suddenly become lagged,
@@ -872,6 +901,8 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
             i->second += msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE;
             statsClient.count("bandwidth.message." + std::string(msg.hdr.pchCommand) + ".bytesReceived", msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE, 1.0f);
 
+            TRACE3(net, inbound_message, GetId(), msg.hdr.pchCommand, msg.hdr.nMessageSize);
+
             msg.nTime = nTimeMicros;
             complete = true;
         }
@@ -945,7 +976,11 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
 
     if (vRecv.size() < nDataPos + nCopy) {
         // Allocate up to 256 KiB ahead, but never more than the total message size.
-        vRecv.resize(std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024));
+        unsigned int nNewSize = std::min(hdr.nMessageSize, nDataPos + nCopy + 256 * 1024);
+        if (nDataPos == 0) {
+            vRecv = CDataStream(g_recv_buffer_pool.Get(nNewSize), vRecv.GetType(), vRecv.GetVersion());
+        }
+        vRecv.resize(nNewSize);
     }
 
     hasher.Write((const unsigned char*)pch, nCopy);
@@ -955,6 +990,11 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     return nCopy;
 }
 
+CNetMessage::~CNetMessage()
+{
+    g_recv_buffer_pool.Put(vRecv.ReleaseBuffer());
+}
+
 const uint256& CNetMessage::GetMessageHash() const
 {
     assert(complete());
@@ -969,27 +1009,54 @@ size_t CConnman::SocketSendData(CNode *pnode) EXCLUSIVE_LOCKS_REQUIRED(pnode->cs
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert(it->size() > pnode->nSendOffset);
+        size_t nToSend = 0;
         int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            nToSend = it->size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(it->data()) + pnode->nSendOffset, nToSend, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            // Hand as many queued messages (headers and payloads are separate entries) to the kernel
+            // as possible with a single call
+            struct iovec iov[MAX_SEND_IOVECS];
+            size_t nIov = 0;
+            size_t nOffset = pnode->nSendOffset;
+            for (auto itIov = it; itIov != pnode->vSendMsg.end() && nIov < MAX_SEND_IOVECS; ++itIov, ++nIov) {
+                iov[nIov].iov_base = const_cast<unsigned char*>(itIov->data()) + nOffset;
+                iov[nIov].iov_len = itIov->size() - nOffset;
+                nToSend += iov[nIov].iov_len;
+                nOffset = 0;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // Drop the messages that went out completely
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                size_t nRemaining = it->size() - pnode->nSendOffset;
+                if (nLeft < nRemaining) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nRemaining;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+                pnode->nSendSize -= it->size();
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            if ((size_t)nBytes < nToSend) {
+                // could not send everything; stop sending more
                 pnode->fCanSendData = false;
                 break;
             }
@@ -1013,6 +1080,9 @@ size_t CConnman::SocketSendData(CNode *pnode) EXCLUSIVE_LOCKS_REQUIRED(pnode->cs
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
     }
+    for (auto itSent = pnode->vSendMsg.begin(); itSent != it; ++itSent) {
+        g_send_buffer_pool.Put(std::move(*itSent));
+    }
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
     pnode->nSendMsgSize = pnode->vSendMsg.size();
     return nSentSize;
@@ -1350,6 +1420,10 @@ void CConnman::DisconnectNodes()
 
                 // remove from vNodes
                 it = vNodes.erase(it);
+                {
+                    LOCK(pnode->cs_mnauth);
+                    EraseVerifiedMasternodeNode(pnode);
+                }
 
                 // release outbound grant (if any)
                 pnode->grantOutbound.Release();
@@ -1585,7 +1659,17 @@ void CConnman::SocketEventsKqueue(std::set<SOCKET> &recv_set, std::set<SOCKET> &
 #endif
 
 #ifdef USE_EPOLL
-void CConnman::SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, bool fOnlyPoll)
+// Node sockets are registered with their CNode* as epoll data, so that events can be mapped to nodes without any
+// lookups. All other sockets (listen sockets, wakeup pipe) carry the fd shifted left by one and with the lowest bit set,
+// which can't clash with a CNode* as these are always at least 2-byte aligned.
+static_assert(alignof(CNode) >= 2, "lowest bit of CNode pointers is used to tag epoll data");
+
+static uint64_t EpollDataFromSocket(SOCKET hSocket)
+{
+    return ((uint64_t)hSocket << 1) | 1;
+}
+
+void CConnman::SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, std::vector<NodeSocketEvents> &node_events, bool fOnlyPoll)
 {
     const size_t maxEvents = 64;
     epoll_event events[maxEvents];
@@ -1593,19 +1677,29 @@ void CConnman::SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &s
     wakeupSelectNeeded = true;
     int n = epoll_wait(epollfd, events, maxEvents, fOnlyPoll ? 0 : SELECT_TIMEOUT_MILLISECONDS);
     wakeupSelectNeeded = false;
+    if (n > 0) {
+        node_events.reserve(n);
+    }
     for (int i = 0; i < n; i++) {
         auto& e = events[i];
-        if((e.events & EPOLLERR) || (e.events & EPOLLHUP)) {
-            error_set.insert((SOCKET)e.data.fd);
+        bool fError = (e.events & EPOLLERR) || (e.events & EPOLLHUP);
+        bool fRecv = !fError && (e.events & EPOLLIN);
+        bool fSend = !fError && (e.events & EPOLLOUT);
+
+        if (!(e.data.u64 & 1)) {
+            node_events.push_back(NodeSocketEvents{(CNode*)(uintptr_t)e.data.u64, fRecv, fSend, fError});
             continue;
         }
 
-        if (e.events & EPOLLIN) {
-            recv_set.insert((SOCKET)e.data.fd);
+        SOCKET hSocket = (SOCKET)(e.data.u64 >> 1);
+        if (fError) {
+            error_set.insert(hSocket);
         }
-
-        if (e.events & EPOLLOUT) {
-            send_set.insert((SOCKET)e.data.fd);
+        if (fRecv) {
+            recv_set.insert(hSocket);
+        }
+        if (fSend) {
+            send_set.insert(hSocket);
         }
     }
 }
@@ -1735,7 +1829,7 @@ void CConnman::SocketEventsSelect(std::set<SOCKET> &recv_set, std::set<SOCKET> &
     }
 }
 
-void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, bool fOnlyPoll)
+void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, std::vector<NodeSocketEvents> &node_events, bool fOnlyPoll)
 {
     switch (socketEventsMode) {
 #ifdef USE_KQUEUE
@@ -1745,7 +1839,7 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
 #endif
 #ifdef USE_EPOLL
         case SOCKETEVENTS_EPOLL:
-            SocketEventsEpoll(recv_set, send_set, error_set, fOnlyPoll);
+            SocketEventsEpoll(recv_set, send_set, error_set, node_events, fOnlyPoll);
             break;
 #endif
 #ifdef USE_POLL
@@ -1763,6 +1857,7 @@ void CConnman::SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_s
 
 void CConnman::SocketHandler()
 {
+    int64_t nStartTime = GetTimeMicros();
     bool fOnlyPoll = false;
     {
         // check if we have work to do and thus should avoid waiting for events
@@ -1782,7 +1877,9 @@ void CConnman::SocketHandler()
     }
 
     std::set<SOCKET> recv_set, send_set, error_set;
-    SocketEvents(recv_set, send_set, error_set, fOnlyPoll);
+    std::vector<NodeSocketEvents> node_events;
+    SocketEvents(recv_set, send_set, error_set, node_events, fOnlyPoll);
+    int64_t nWaitEndTime = GetTimeMicros();
 
 #ifdef USE_WAKEUP_PIPE
     // drain the wakeup pipe
@@ -1848,6 +1945,30 @@ void CConnman::SocketHandler()
             assert(jt.first->second == it->second);
             it->second->fCanSendData = true;
         }
+        for (const auto& e : node_events) {
+            CNode* pnode = e.pnode;
+            {
+                // The socket might have been closed after the events were fetched. The CNode itself stays alive
+                // until the next DisconnectNodes() call on this thread.
+                LOCK(pnode->cs_hSocket);
+                if (pnode->hSocket == INVALID_SOCKET) {
+                    continue;
+                }
+            }
+            if (e.fError) {
+                pnode->AddRef();
+                vErrorNodes.emplace_back(pnode);
+                continue;
+            }
+            if (e.fRecv) {
+                mapReceivableNodes.emplace(pnode->GetId(), pnode);
+                pnode->fHasRecvData = true;
+            }
+            if (e.fSend) {
+                mapSendableNodes.emplace(pnode->GetId(), pnode);
+                pnode->fCanSendData = true;
+            }
+        }
 
         // collect nodes that have a receivable socket
         // also clean up mapReceivableNodes from nodes that were receivable in the last iteration but aren't anymore
@@ -1946,6 +2067,10 @@ void CConnman::SocketHandler()
             }
         }
     }
+
+    int64_t nEndTime = GetTimeMicros();
+    statsClient.timing("network.socketHandler.waitTime_us", nWaitEndTime - nStartTime, 0.01f);
+    statsClient.timing("network.socketHandler.processTime_us", nEndTime - nWaitEndTime, 0.01f);
 }
 
 size_t CConnman::SocketRecvData(CNode *pnode)
@@ -2040,9 +2165,9 @@ void CConnman::WakeMessageHandler()
 {
     {
         std::lock_guard<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = true;
+        std::fill(vMsgProcWake.begin(), vMsgProcWake.end(), true);
     }
-    condMsgProc.notify_one();
+    condMsgProc.notify_all();
 }
 
 void CConnman::WakeSelect()
@@ -2219,23 +2344,41 @@ void CConnman::ThreadDNSAddressSeed()
 
     LogPrintf("Loading addresses from DNS seeds (could take a while)\n");
 
-    for (const std::string &seed : vSeeds) {
+    ServiceFlags requiredServiceBits = GetDesirableServiceFlags(NODE_NONE);
+    unsigned int nMaxIPs = 256; // Limits number of IPs learned from a DNS seed
+
+    // Query all seeds at once, so that a slow or unreachable seed doesn't delay the others
+    std::vector<std::vector<CNetAddr>> vSeedIPs(vSeeds.size());
+    std::vector<char> vSeedResolved(vSeeds.size(), false);
+    if (!HaveNameProxy()) {
+        std::vector<std::thread> vLookupThreads;
+        for (size_t i = 0; i < vSeeds.size(); i++) {
+            std::string host = strprintf("x%x.%s", requiredServiceBits, vSeeds[i]);
+            vLookupThreads.emplace_back([&vSeedIPs, &vSeedResolved, i, host, nMaxIPs] {
+                vSeedResolved[i] = LookupHost(host.c_str(), vSeedIPs[i], nMaxIPs, true);
+            });
+        }
+        for (std::thread& thread : vLookupThreads) {
+            thread.join();
+        }
+    }
+
+    for (size_t i = 0; i < vSeeds.size(); i++) {
+        const std::string& seed = vSeeds[i];
         if (interruptNet) {
             return;
         }
         if (HaveNameProxy()) {
             AddOneShot(seed);
         } else {
-            std::vector<CNetAddr> vIPs;
+            const std::vector<CNetAddr>& vIPs = vSeedIPs[i];
             std::vector<CAddress> vAdd;
-            ServiceFlags requiredServiceBits = GetDesirableServiceFlags(NODE_NONE);
             std::string host = strprintf("x%x.%s", requiredServiceBits, seed);
             CNetAddr resolveSource;
             if (!resolveSource.SetInternal(host)) {
                 continue;
             }
-            unsigned int nMaxIPs = 256; // Limits number of IPs learned from a DNS seed
-            if (LookupHost(host.c_str(), vIPs, nMaxIPs, true))
+            if (vSeedResolved[i])
             {
                 for (const CNetAddr& ip : vIPs)
                 {
@@ -2298,7 +2441,7 @@ void CConnman::ProcessOneShot()
     CAddress addr;
     CSemaphoreGrant grant(*semOutbound, true);
     if (grant) {
-        OpenNetworkConnection(addr, false, &grant, strDest.c_str(), true);
+        QueueOpenNetworkConnection(addr, false, &grant, strDest.c_str(), true);
     }
 }
 
@@ -2372,6 +2515,10 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
         if (!interruptNet.sleep_for(std::chrono::milliseconds(500)))
             return;
 
+        // Don't queue more attempts than the connection workers can handle at once
+        if (GetPendingConnectionCount() >= (size_t)nMaxConnectAttempts)
+            continue;
+
         CSemaphoreGrant grant(*semOutbound);
         if (interruptNet)
             return;
@@ -2410,6 +2557,9 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                     nOutbound++;
                 }
             }
+            // Attempts still in flight will take up outbound slots and network groups as well
+            nOutbound += GetPendingConnectionCount();
+            GetPendingConnectionGroups(setConnected);
         }
 
         std::set<uint256> setConnectedMasternodes;
@@ -2522,7 +2672,7 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                 }
             }
 
-            OpenNetworkConnection(addrConnect, (int)setConnected.size() >= std::min(nMaxConnections - 1, 2), &grant, nullptr, false, fFeeler);
+            QueueOpenNetworkConnection(addrConnect, (int)setConnected.size() >= std::min(nMaxConnections - 1, 2), &grant, nullptr, false, fFeeler);
         }
     }
 }
@@ -2631,6 +2781,10 @@ void CConnman::ThreadOpenMasternodeConnections()
         if (!fNetworkActive || !masternodeSync.IsBlockchainSynced())
             continue;
 
+        // Don't queue more attempts than the connection workers can handle at once
+        if (GetPendingConnectionCount() >= (size_t)nMaxConnectAttempts)
+            continue;
+
         std::set<CService> connectedNodes;
         std::map<uint256, bool> connectedProRegTxHashes;
         ForEachNode([&](const CNode* pnode) {
@@ -2647,7 +2801,7 @@ void CConnman::ThreadOpenMasternodeConnections()
 
         int64_t nANow = GetAdjustedTime();
 
-        // NOTE: Process only one pending masternode at a time
+        // NOTE: Pick only one pending masternode at a time, the connection attempts themselves run in parallel
 
         CDeterministicMNCPtr connectToDmn;
         bool isProbe = false;
@@ -2733,19 +2887,89 @@ void CConnman::ThreadOpenMasternodeConnections()
 
         mmetaman.GetMetaInfo(connectToDmn->proTxHash)->SetLastOutboundAttempt(nANow);
 
-        OpenMasternodeConnection(CAddress(connectToDmn->pdmnState->addr, NODE_NETWORK), isProbe);
-        // should be in the list now if connection was opened
-        bool connected = ForNode(connectToDmn->pdmnState->addr, CConnman::AllNodes, [&](CNode* pnode) {
-            if (pnode->fDisconnect) {
-                return false;
+        QueueOpenNetworkConnection(CAddress(connectToDmn->pdmnState->addr, NODE_NETWORK), false, nullptr, nullptr, false, false, true, isProbe, [this, connectToDmn]() {
+            // should be in the list now if connection was opened
+            bool connected = ForNode(connectToDmn->pdmnState->addr, CConnman::AllNodes, [&](CNode* pnode) {
+                if (pnode->fDisconnect) {
+                    return false;
+                }
+                return true;
+            });
+            if (!connected) {
+                LogPrint(BCLog::NET_NETCONN, "CConnman::ThreadOpenMasternodeConnections -- connection failed for masternode  %s, service=%s\n", connectToDmn->proTxHash.ToString(), connectToDmn->pdmnState->addr.ToString(false));
+                // reset last outbound success
+                mmetaman.GetMetaInfo(connectToDmn->proTxHash)->SetLastOutboundSuccess(0);
             }
-            return true;
         });
-        if (!connected) {
-            LogPrint(BCLog::NET_NETCONN, "CConnman::%s -- connection failed for masternode  %s, service=%s\n", __func__, connectToDmn->proTxHash.ToString(), connectToDmn->pdmnState->addr.ToString(false));
-            // reset last outbound success
-            mmetaman.GetMetaInfo(connectToDmn->proTxHash)->SetLastOutboundSuccess(0);
+    }
+}
+
+bool CConnman::QueueOpenNetworkConnection(const CAddress& addrConnect, bool fCountFailure, CSemaphoreGrant* grantOutbound, const char* pszDest, bool fOneShot, bool fFeeler, bool masternode_connection, bool masternode_probe_connection, std::function<void()> onDone)
+{
+    auto conn = MakeUnique<PendingConnection>();
+    conn->addrConnect = addrConnect;
+    conn->fCountFailure = fCountFailure;
+    if (grantOutbound) {
+        grantOutbound->MoveTo(conn->grantOutbound);
+    }
+    conn->strDest = pszDest ? pszDest : "";
+    conn->fOneShot = fOneShot;
+    conn->fFeeler = fFeeler;
+    conn->masternode_connection = masternode_connection;
+    conn->masternode_probe_connection = masternode_probe_connection;
+    conn->onDone = std::move(onDone);
+
+    const std::string strKey = pszDest ? conn->strDest : addrConnect.ToStringIPPort();
+    {
+        std::lock_guard<std::mutex> lock(mutexPendingConnections);
+        if (!mapConnectingAddrs.emplace(strKey, addrConnect).second) {
+            return false;
         }
+        vPendingConnections.emplace_back(std::move(conn));
+    }
+    condPendingConnections.notify_one();
+    return true;
+}
+
+size_t CConnman::GetPendingConnectionCount()
+{
+    std::lock_guard<std::mutex> lock(mutexPendingConnections);
+    return mapConnectingAddrs.size();
+}
+
+void CConnman::GetPendingConnectionGroups(std::set<std::vector<unsigned char>>& setGroups)
+{
+    std::lock_guard<std::mutex> lock(mutexPendingConnections);
+    for (const auto& p : mapConnectingAddrs) {
+        if (p.second.IsValid()) {
+            setGroups.insert(p.second.GetGroup());
+        }
+    }
+}
+
+void CConnman::ThreadOpenConnectionWorker()
+{
+    while (!interruptNet) {
+        std::unique_ptr<PendingConnection> conn;
+        {
+            std::unique_lock<std::mutex> lock(mutexPendingConnections);
+            condPendingConnections.wait(lock, [this] { return interruptNet || !vPendingConnections.empty(); });
+            if (interruptNet) {
+                return;
+            }
+            conn = std::move(vPendingConnections.front());
+            vPendingConnections.pop_front();
+        }
+
+        const char* pszDest = conn->strDest.empty() ? nullptr : conn->strDest.c_str();
+        OpenNetworkConnection(conn->addrConnect, conn->fCountFailure, conn->grantOutbound ? &conn->grantOutbound : nullptr, pszDest,
+                              conn->fOneShot, conn->fFeeler, conn->manual_connection, conn->masternode_connection, conn->masternode_probe_connection);
+        if (conn->onDone) {
+            conn->onDone();
+        }
+
+        std::lock_guard<std::mutex> lock(mutexPendingConnections);
+        mapConnectingAddrs.erase(pszDest ? conn->strDest : conn->addrConnect.ToStringIPPort());
     }
 }
 
@@ -2823,7 +3047,7 @@ void CConnman::OpenMasternodeConnection(const CAddress &addrConnect, bool probe)
     OpenNetworkConnection(addrConnect, false, nullptr, nullptr, false, false, false, true, probe);
 }
 
-void CConnman::ThreadMessageHandler()
+void CConnman::ThreadMessageHandler(int nWorker)
 {
     int64_t nLastSendMessagesTimeMasternodes = 0;
 
@@ -2833,6 +3057,9 @@ void CConnman::ThreadMessageHandler()
 
         bool fMoreWork = false;
 
+        // Hand out invs queued by RelayInv before sending messages
+        FlushRelayInvQueue();
+
         bool fSkipSendMessagesForMasternodes = true;
         if (GetTimeMillis() - nLastSendMessagesTimeMasternodes >= 100) {
             fSkipSendMessagesForMasternodes = false;
@@ -2843,6 +3070,8 @@ void CConnman::ThreadMessageHandler()
         {
             if (pnode->fDisconnect)
                 continue;
+            if (pnode->GetId() % nMsgHandlerThreads != nWorker)
+                continue;
 
             // Receive messages
             bool fMoreNodeWork = m_msgproc->ProcessMessages(pnode, flagInterruptMsgProc);
@@ -2863,9 +3092,9 @@ void CConnman::ThreadMessageHandler()
 
         std::unique_lock<std::mutex> lock(mutexMsgProc);
         if (!fMoreWork) {
-            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this] { return fMsgProcWake; });
+            condMsgProc.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100), [this, nWorker] { return vMsgProcWake[nWorker]; });
         }
-        fMsgProcWake = false;
+        vMsgProcWake[nWorker] = false;
     }
 }
 
@@ -2951,7 +3180,7 @@ bool CConnman::BindListenPort(const CService &addrBind, std::string& strError, b
 #ifdef USE_EPOLL
     if (socketEventsMode == SOCKETEVENTS_EPOLL) {
         epoll_event event;
-        event.data.fd = hListenSocket;
+        event.data.u64 = EpollDataFromSocket(hListenSocket);
         event.events = EPOLLIN;
         if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket, &event) != 0) {
             strError = strprintf(_("Error: failed to add socket to epollfd (epoll_ctl returned error %s)"), NetworkErrorString(WSAGetLastError()));
@@ -3198,7 +3427,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
 
     {
         std::unique_lock<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = false;
+        vMsgProcWake.assign(nMsgHandlerThreads, false);
     }
 
 #ifdef USE_WAKEUP_PIPE
@@ -3230,7 +3459,7 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         if (socketEventsMode == SOCKETEVENTS_EPOLL) {
             epoll_event event;
             event.events = EPOLLIN;
-            event.data.fd = wakeupPipe[0];
+            event.data.u64 = EpollDataFromSocket(wakeupPipe[0]);
             int r = epoll_ctl(epollfd, EPOLL_CTL_ADD, wakeupPipe[0], &event);
             if (r != 0) {
                 LogPrint(BCLog::NET, "%s -- epoll_ctl(%d, %d, %d, ...) failed. error: %s\n", __func__,
@@ -3264,14 +3493,23 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
     if (connOptions.m_use_addrman_outgoing || !connOptions.m_specified_outgoing.empty())
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
 
+    // Make the outbound connection attempts queued by the threads above and below
+    for (int i = 0; i < nMaxConnectAttempts; i++) {
+        threadOpenConnectionWorkers.emplace_back(&TraceThread<std::function<void()> >, strprintf("opencon.%d", i), std::function<void()>(std::bind(&CConnman::ThreadOpenConnectionWorker, this)));
+    }
+
     // Initiate masternode connections
     threadOpenMasternodeConnections = std::thread(&TraceThread<std::function<void()> >, "mncon", std::function<void()>(std::bind(&CConnman::ThreadOpenMasternodeConnections, this)));
 
     // Process messages
-    threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nMsgHandlerThreads; i++) {
+        // Keep the historic thread name for the first (and by default only) handler
+        std::string strName = i == 0 ? "msghand" : strprintf("msghand.%d", i);
+        threadMessageHandlers.emplace_back(&TraceThread<std::function<void()> >, strName, std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this, i)));
+    }
 
     // Dump network addresses
-    scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000, "dumpdata");
 
     return true;
 }
@@ -3309,6 +3547,11 @@ void CConnman::Interrupt()
 
     interruptNet();
     InterruptSocks5(true);
+    {
+        // wake up connection workers waiting for work, they check interruptNet under this lock
+        std::lock_guard<std::mutex> lock(mutexPendingConnections);
+    }
+    condPendingConnections.notify_all();
 
     if (semOutbound) {
         for (int i=0; i<(nMaxOutbound + nMaxFeeler); i++) {
@@ -3325,14 +3568,28 @@ void CConnman::Interrupt()
 
 void CConnman::Stop()
 {
-    if (threadMessageHandler.joinable())
-        threadMessageHandler.join();
+    for (std::thread& thread : threadMessageHandlers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadMessageHandlers.clear();
     if (threadOpenMasternodeConnections.joinable())
         threadOpenMasternodeConnections.join();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
     if (threadOpenAddedConnections.joinable())
         threadOpenAddedConnections.join();
+    for (std::thread& thread : threadOpenConnectionWorkers) {
+        if (thread.joinable())
+            thread.join();
+    }
+    threadOpenConnectionWorkers.clear();
+    {
+        // Attempts that never got to a worker release their grants here
+        std::lock_guard<std::mutex> lock(mutexPendingConnections);
+        vPendingConnections.clear();
+        mapConnectingAddrs.clear();
+    }
     if (threadDNSAddressSeed.joinable())
         threadDNSAddressSeed.join();
     if (threadSocketHandler.joinable())
@@ -3377,6 +3634,7 @@ void CConnman::Stop()
         DeleteNode(pnode);
     }
     vNodes.clear();
+    mapVerifiedMasternodeNodes.clear();
     mapSocketToNode.clear();
     mapReceivableNodes.clear();
     {
@@ -3496,7 +3754,7 @@ void CConnman::SetMasternodeQuorumNodes(Consensus::LLMQType llmqType, const uint
 {
     LOCK(cs_vPendingMasternodes);
     auto it = masternodeQuorumNodes.emplace(std::make_pair(llmqType, quorumHash), proTxHashes);
-    if (!it.second) {
+    if (!it.second && it.first->second != proTxHashes) {
         it.first->second = proTxHashes;
     }
 }
@@ -3507,6 +3765,11 @@ void CConnman::SetMasternodeQuorumRelayMembers(Consensus::LLMQType llmqType, con
         LOCK(cs_vPendingMasternodes);
         auto it = masternodeQuorumRelayMembers.emplace(std::make_pair(llmqType, quorumHash), proTxHashes);
         if (!it.second) {
+            if (it.first->second == proTxHashes) {
+                // This is called for all active quorums at every block, usually without a change. Connections made
+                // since the last change were already told about it in MNAUTH
+                return;
+            }
             it.first->second = proTxHashes;
         }
     }
@@ -3691,15 +3954,75 @@ void CConnman::RelayTransaction(const CTransaction& tx)
     RelayInv(inv);
 }
 
-void CConnman::RelayInv(CInv &inv, const int minProtoVersion) {
+// Invs of higher priority are handed to the peers first when the relay queue is flushed, so that they end up in front
+// of others in the next inv message
+static int GetRelayInvPriority(int nInvType)
+{
+    switch (nInvType) {
+        case MSG_CLSIG:
+        case MSG_ISLOCK:
+        case MSG_SPORK:
+            return 2;
+        case MSG_QUORUM_FINAL_COMMITMENT:
+        case MSG_QUORUM_RECOVERED_SIG:
+        case MSG_DSTX:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+void CConnman::QueueRelayInv(CQueuedRelayInv&& queuedInv)
+{
+    bool fWasEmpty;
+    {
+        LOCK(cs_relayInvQueue);
+        fWasEmpty = vRelayInvQueue.empty();
+        vRelayInvQueue.emplace_back(std::move(queuedInv));
+    }
+    if (fWasEmpty) {
+        WakeMessageHandler();
+    }
+}
+
+void CConnman::FlushRelayInvQueue()
+{
+    std::vector<CQueuedRelayInv> vQueue;
+    {
+        LOCK(cs_relayInvQueue);
+        if (vRelayInvQueue.empty()) {
+            return;
+        }
+        vQueue.swap(vRelayInvQueue);
+    }
+
+    std::stable_sort(vQueue.begin(), vQueue.end(), [](const CQueuedRelayInv& a, const CQueuedRelayInv& b) {
+        return GetRelayInvPriority(a.inv.type) > GetRelayInvPriority(b.inv.type);
+    });
+
     LOCK(cs_vNodes);
     for (const auto& pnode : vNodes) {
-        if (pnode->nVersion < minProtoVersion || !pnode->CanRelay())
+        if (!pnode->CanRelay())
             continue;
-        pnode->PushInventory(inv);
+        LOCK2(pnode->cs_inventory, pnode->cs_filter);
+        for (const auto& queuedInv : vQueue) {
+            if (pnode->nVersion < queuedInv.minProtoVersion)
+                continue;
+            if (pnode->pfilter) {
+                if (queuedInv.relatedTx && !pnode->pfilter->IsRelevantAndUpdate(*queuedInv.relatedTx))
+                    continue;
+                if (!queuedInv.relatedTxHash.IsNull() && !pnode->pfilter->contains(queuedInv.relatedTxHash))
+                    continue;
+            }
+            pnode->PushInventory(queuedInv.inv);
+        }
     }
 }
 
+void CConnman::RelayInv(CInv &inv, const int minProtoVersion) {
+    QueueRelayInv({inv, minProtoVersion, nullptr, uint256()});
+}
+
 void CConnman::RelayInvFiltered(CInv &inv, const CTransaction& relatedTx, const int minProtoVersion)
 {
     LOCK(cs_vNodes);
@@ -3715,18 +4038,14 @@ void CConnman::RelayInvFiltered(CInv &inv, const CTransaction& relatedTx, const
     }
 }
 
+void CConnman::RelayInvFiltered(CInv &inv, const CTransactionRef& relatedTx, const int minProtoVersion)
+{
+    QueueRelayInv({inv, minProtoVersion, relatedTx, uint256()});
+}
+
 void CConnman::RelayInvFiltered(CInv &inv, const uint256& relatedTxHash, const int minProtoVersion)
 {
-    LOCK(cs_vNodes);
-    for (const auto& pnode : vNodes) {
-        if (pnode->nVersion < minProtoVersion || !pnode->CanRelay())
-            continue;
-        {
-            LOCK(pnode->cs_filter);
-            if(pnode->pfilter && !pnode->pfilter->contains(relatedTxHash)) continue;
-        }
-        pnode->PushInventory(inv);
-    }
+    QueueRelayInv({inv, minProtoVersion, nullptr, relatedTxHash});
 }
 
 void CConnman::RecordBytesRecv(uint64_t bytes)
@@ -3829,6 +4148,33 @@ uint64_t CConnman::GetOutboundTargetBytesLeft()
     return (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit) ? 0 : nMaxOutboundLimit - nMaxOutboundTotalBytesSentInCycle;
 }
 
+void CNode::RecordMsgProcessing(const std::string& strCommand, int64_t nMicros)
+{
+    LOCK(cs_msgProcessing);
+    nProcessingTimeMicros += nMicros;
+    mapProcessingPerMsgCmd[strCommand].Add(nMicros);
+}
+
+void CConnman::RecordMsgProcessing(CNode* pnode, const std::string& strCommand, int64_t nMicros)
+{
+    // Unknown commands are accounted together, so that a peer can't grow the maps without limit
+    static const std::set<std::string> setKnownCommands = [] {
+        const std::vector<std::string>& vecCommands = getAllNetMessageTypes();
+        return std::set<std::string>(vecCommands.begin(), vecCommands.end());
+    }();
+    const std::string& strKey = setKnownCommands.count(strCommand) ? strCommand : NET_MESSAGE_COMMAND_OTHER;
+
+    pnode->RecordMsgProcessing(strKey, nMicros);
+    LOCK(cs_msgProcessing);
+    mapProcessingPerMsgCmd[strKey].Add(nMicros);
+}
+
+mapMsgCmdProcessing CConnman::GetMsgProcessingStats()
+{
+    LOCK(cs_msgProcessing);
+    return mapProcessingPerMsgCmd;
+}
+
 uint64_t CConnman::GetTotalBytesRecv()
 {
     LOCK(cs_totalBytesRecv);
@@ -3952,6 +4298,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",  SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
     statsClient.count("bandwidth.message." + SanitizeString(msg.command.c_str()) + ".bytesSent", nTotalSize, 1.0f);
     statsClient.inc("message.sent." + SanitizeString(msg.command.c_str()), 1.0f);
+    TRACE3(net, outbound_message, pnode->GetId(), msg.command.c_str(), nMessageSize);
 
     std::vector<unsigned char> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
@@ -3975,6 +4322,8 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         pnode->vSendMsg.push_back(std::move(serializedHeader));
         if (nMessageSize)
             pnode->vSendMsg.push_back(std::move(msg.data));
+        else
+            g_send_buffer_pool.Put(std::move(msg.data));
         pnode->nSendMsgSize = pnode->vSendMsg.size();
 
         {
@@ -4028,6 +4377,29 @@ bool CConnman::IsMasternodeOrDisconnectRequested(const CService& addr) {
     });
 }
 
+void CConnman::SetMasternodeVerified(CNode* pnode, const uint256& proRegTxHash, const uint256& pubKeyHash)
+{
+    LOCK2(cs_vNodes, pnode->cs_mnauth);
+    if (!pnode->verifiedProRegTxHash.IsNull()) {
+        EraseVerifiedMasternodeNode(pnode);
+    }
+    pnode->verifiedProRegTxHash = proRegTxHash;
+    pnode->verifiedPubKeyHash = pubKeyHash;
+    mapVerifiedMasternodeNodes.emplace(proRegTxHash, pnode);
+}
+
+void CConnman::EraseVerifiedMasternodeNode(CNode* pnode)
+{
+    AssertLockHeld(cs_vNodes);
+    auto range = mapVerifiedMasternodeNodes.equal_range(pnode->verifiedProRegTxHash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == pnode) {
+            mapVerifiedMasternodeNodes.erase(it);
+            return;
+        }
+    }
+}
+
 int64_t CConnman::PoissonNextSendInbound(int64_t now, int average_interval_seconds)
 {
     if (m_next_send_inv_to_incoming < now) {
@@ -4115,7 +4487,7 @@ void CConnman::RegisterEvents(CNode *pnode)
     epoll_event e;
     // We're using edge-triggered mode, so it's important that we drain sockets even if no signals come in
     e.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLERR | EPOLLHUP;
-    e.data.fd = pnode->hSocket;
+    e.data.u64 = (uint64_t)(uintptr_t)pnode;
 
     int r = epoll_ctl(epollfd, EPOLL_CTL_ADD, pnode->hSocket, &e);
     if (r != 0) {
@@ -8,13 +8,16 @@
 
 #include <addrdb.h>
 #include <addrman.h>
+#include <banindex.h>
 #include <bloom.h>
 #include <compat.h>
 #include <fs.h>
 #include <hash.h>
 #include <limitedmap.h>
 #include <netaddress.h>
+#include <netbufferpool.h>
 #include <policy/feerate.h>
+#include <primitives/transaction.h>
 #include <protocol.h>
 #include <random.h>
 #include <saltedhasher.h>
@@ -31,6 +34,7 @@
 #include <thread>
 #include <memory>
 #include <condition_variable>
+#include <functional>
 #include <unordered_set>
 #include <queue>
 
@@ -90,6 +94,14 @@ static const uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
 static const bool DEFAULT_BLOCKSONLY = false;
 /** -peertimeout default */
 static const int64_t DEFAULT_PEER_CONNECT_TIMEOUT = 60;
+/** -msghandlerthreads default */
+static const int DEFAULT_MSG_HANDLER_THREADS = 1;
+/** Maximum number of message handler threads */
+static const int MAX_MSG_HANDLER_THREADS = 16;
+/** -maxconnectattempts default */
+static const int DEFAULT_MAX_CONNECT_ATTEMPTS = 4;
+/** Maximum value for -maxconnectattempts */
+static const int MAX_CONNECT_ATTEMPTS_LIMIT = 32;
 
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
@@ -121,6 +133,10 @@ struct AddedNodeInfo
 class CNodeStats;
 class CClientUIInterface;
 
+/** Pools for the payload buffers of received (CNetMessage) and sent (CSerializedNetMsg) messages */
+extern CNetBufferPool<CSerializeData> g_recv_buffer_pool;
+extern CNetBufferPool<std::vector<unsigned char>> g_send_buffer_pool;
+
 struct CSerializedNetMsg
 {
     CSerializedNetMsg() = default;
@@ -135,6 +151,23 @@ struct CSerializedNetMsg
 };
 
 class NetEventsInterface;
+
+/** How many messages of a command were processed and how long their handler ran */
+struct CMsgProcessingStats
+{
+    uint64_t nCount{0};
+    int64_t nTimeMicros{0};
+    int64_t nMaxTimeMicros{0};
+
+    void Add(int64_t nMicros)
+    {
+        nCount++;
+        nTimeMicros += nMicros;
+        nMaxTimeMicros = std::max(nMaxTimeMicros, nMicros);
+    }
+};
+typedef std::map<std::string, CMsgProcessingStats> mapMsgCmdProcessing; //command, processing stats
+
 class CConnman
 {
 friend class CNode;
@@ -176,6 +209,8 @@ public:
         std::vector<std::string> m_specified_outgoing;
         std::vector<std::string> m_added_nodes;
         SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
+        int nMsgHandlerThreads = DEFAULT_MSG_HANDLER_THREADS;
+        int nMaxConnectAttempts = DEFAULT_MAX_CONNECT_ATTEMPTS;
     };
 
     void Init(const Options& connOptions) {
@@ -202,6 +237,8 @@ public:
             vAddedNodes = connOptions.m_added_nodes;
         }
         socketEventsMode = connOptions.socketEventsMode;
+        nMsgHandlerThreads = std::max(1, std::min(connOptions.nMsgHandlerThreads, MAX_MSG_HANDLER_THREADS));
+        nMaxConnectAttempts = std::max(1, std::min(connOptions.nMaxConnectAttempts, MAX_CONNECT_ATTEMPTS_LIMIT));
     }
 
     CConnman(uint64_t seed0, uint64_t seed1);
@@ -255,6 +292,22 @@ public:
 
     bool IsMasternodeOrDisconnectRequested(const CService& addr);
 
+    /** Records that pnode authenticated as the masternode proRegTxHash, whose operator key has the hash pubKeyHash */
+    void SetMasternodeVerified(CNode* pnode, const uint256& proRegTxHash, const uint256& pubKeyHash);
+
+    /** Calls func for the fully connected nodes which authenticated as the masternode proRegTxHash */
+    template<typename Callable>
+    void ForEachVerifiedMasternodeNode(const uint256& proRegTxHash, Callable&& func)
+    {
+        LOCK(cs_vNodes);
+        auto range = mapVerifiedMasternodeNodes.equal_range(proRegTxHash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (FullyConnectedOnly(it->second)) {
+                func(it->second);
+            }
+        }
+    }
+
     void PushMessage(CNode* pnode, CSerializedNetMsg&& msg);
 
     template<typename Condition, typename Callable>
@@ -362,10 +415,16 @@ public:
     void ReleaseNodeVector(const std::vector<CNode*>& vecNodes);
 
     void RelayTransaction(const CTransaction& tx);
+    // RelayInv and the RelayInvFiltered overloads taking a CTransactionRef or a hash only queue the inv. Queued invs are
+    // handed to all peers in a single pass by the message handler thread, right before it sends messages to peers.
     void RelayInv(CInv &inv, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
+    // This overload pushes the inv to all peers immediately, prefer the CTransactionRef one if a ref is at hand
     void RelayInvFiltered(CInv &inv, const CTransaction &relatedTx, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
+    void RelayInvFiltered(CInv &inv, const CTransactionRef &relatedTx, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
     // This overload will not update node filters,  so use it only for the cases when other messages will update related transaction data in filters
     void RelayInvFiltered(CInv &inv, const uint256 &relatedTxHash, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
+    /** Push all queued invs to the peers, highest priority inv types first */
+    void FlushRelayInvQueue();
 
     // Addrman functions
     size_t GetAddressCount() const;
@@ -390,6 +449,8 @@ public:
     // new code.
     void Ban(const CNetAddr& netAddr, const BanReason& reason, int64_t bantimeoffset = 0, bool sinceUnixEpoch = false);
     void Ban(const CSubNet& subNet, const BanReason& reason, int64_t bantimeoffset = 0, bool sinceUnixEpoch = false);
+    // Ban all the subnets at once, with a single notification and banlist.dat write for the whole batch
+    void Ban(const std::vector<CSubNet>& vSubNets, const BanReason& reason, int64_t bantimeoffset = 0, bool sinceUnixEpoch = false);
     void ClearBanned(); // needed for unit testing
     bool IsBanned(CNetAddr ip);
     bool IsBanned(CSubNet subnet);
@@ -459,6 +520,11 @@ public:
     uint64_t GetTotalBytesRecv();
     uint64_t GetTotalBytesSent();
 
+    /** Account the time spent in the handler of a message, globally and for the peer it came from */
+    void RecordMsgProcessing(CNode* pnode, const std::string& strCommand, int64_t nMicros);
+    /** The processing stats of all peers since startup, including the disconnected ones */
+    mapMsgCmdProcessing GetMsgProcessingStats();
+
     void SetBestHeight(int height);
     int GetBestHeight() const;
 
@@ -491,28 +557,67 @@ private:
     void AddOneShot(const std::string& strDest);
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
-    void ThreadMessageHandler();
+    void ThreadMessageHandler(int nWorker);
     void AcceptConnection(const ListenSocket& hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
     void CalculateNumConnectionsChangedStats();
     void InactivityCheck(CNode *pnode);
+    /** Readiness of a single node socket as reported by the socket events backend */
+    struct NodeSocketEvents {
+        CNode* pnode;
+        bool fRecv;
+        bool fSend;
+        bool fError;
+    };
+
     bool GenerateSelectSet(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set);
 #ifdef USE_KQUEUE
     void SocketEventsKqueue(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, bool fOnlyPoll);
 #endif
 #ifdef USE_EPOLL
-    void SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, bool fOnlyPoll);
+    void SocketEventsEpoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, std::vector<NodeSocketEvents> &node_events, bool fOnlyPoll);
 #endif
 #ifdef USE_POLL
     void SocketEventsPoll(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, bool fOnlyPoll);
 #endif
     void SocketEventsSelect(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, bool fOnlyPoll);
-    void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, bool fOnlyPoll);
+    /**
+     * Wait for socket events. Backends which can tell the node straight from the event (epoll) report node sockets
+     * through node_events and only put the remaining sockets (listen sockets, wakeup pipe) into the sets.
+     */
+    void SocketEvents(std::set<SOCKET> &recv_set, std::set<SOCKET> &send_set, std::set<SOCKET> &error_set, std::vector<NodeSocketEvents> &node_events, bool fOnlyPoll);
     void SocketHandler();
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
     void ThreadOpenMasternodeConnections();
+    void ThreadOpenConnectionWorker();
+
+    /** An outbound connection attempt handed to the connection workers, see OpenNetworkConnection for the fields */
+    struct PendingConnection {
+        CAddress addrConnect;
+        bool fCountFailure{false};
+        CSemaphoreGrant grantOutbound;
+        std::string strDest;
+        bool fOneShot{false};
+        bool fFeeler{false};
+        bool manual_connection{false};
+        bool masternode_connection{false};
+        bool masternode_probe_connection{false};
+        /** Called by the worker after the attempt, whether it succeeded or not */
+        std::function<void()> onDone;
+    };
+
+    /**
+     * Hand a connection attempt to the connection workers instead of connecting synchronously, so that a slow or
+     * unreachable peer doesn't hold up the following attempts. The grant, if any, is moved into the attempt.
+     * Returns false if an attempt to the same destination is already in flight.
+     */
+    bool QueueOpenNetworkConnection(const CAddress& addrConnect, bool fCountFailure, CSemaphoreGrant* grantOutbound, const char* pszDest, bool fOneShot = false, bool fFeeler = false, bool masternode_connection = false, bool masternode_probe_connection = false, std::function<void()> onDone = {});
+    /** Number of queued or running connection attempts */
+    size_t GetPendingConnectionCount();
+    /** Add the network groups of all queued or running connection attempts to setGroups */
+    void GetPendingConnectionGroups(std::set<std::vector<unsigned char>>& setGroups);
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad) const;
 
@@ -557,6 +662,10 @@ private:
     uint64_t nTotalBytesRecv GUARDED_BY(cs_totalBytesRecv);
     uint64_t nTotalBytesSent GUARDED_BY(cs_totalBytesSent);
 
+    // Message processing totals
+    CCriticalSection cs_msgProcessing;
+    mapMsgCmdProcessing mapProcessingPerMsgCmd GUARDED_BY(cs_msgProcessing);
+
     // outbound limit & stats
     uint64_t nMaxOutboundTotalBytesSentInCycle GUARDED_BY(cs_totalBytesSent);
     uint64_t nMaxOutboundCycleStartTime GUARDED_BY(cs_totalBytesSent);
@@ -576,6 +685,8 @@ private:
     std::vector<ListenSocket> vhListenSocket;
     std::atomic<bool> fNetworkActive;
     banmap_t setBanned GUARDED_BY(cs_setBanned);
+    // Index of setBanned for the IsBanned(CNetAddr) lookups and the sweeps
+    CBanIndex banIndex GUARDED_BY(cs_setBanned);
     CCriticalSection cs_setBanned;
     bool setBannedIsDirty GUARDED_BY(cs_setBanned);
     bool fAddressesInitialized;
@@ -590,10 +701,25 @@ private:
     std::set<uint256> masternodePendingProbes;
     mutable CCriticalSection cs_vPendingMasternodes;
     std::vector<CNode*> vNodes;
+    // the nodes of vNodes by their verifiedProRegTxHash, protected by cs_vNodes
+    std::unordered_multimap<uint256, CNode*, StaticSaltedHasher> mapVerifiedMasternodeNodes;
+    // requires cs_vNodes and pnode->cs_mnauth
+    void EraseVerifiedMasternodeNode(CNode* pnode);
     std::list<CNode*> vNodesDisconnected;
     std::unordered_map<SOCKET, CNode*> mapSocketToNode;
     mutable CCriticalSection cs_vNodes;
     std::atomic<NodeId> nLastNodeId;
+
+    /** An inv waiting for the next FlushRelayInvQueue(), optionally filtered by the peers' bloom filters */
+    struct CQueuedRelayInv {
+        CInv inv;
+        int minProtoVersion;
+        CTransactionRef relatedTx;
+        uint256 relatedTxHash;
+    };
+    std::vector<CQueuedRelayInv> vRelayInvQueue GUARDED_BY(cs_relayInvQueue);
+    CCriticalSection cs_relayInvQueue;
+    void QueueRelayInv(CQueuedRelayInv&& queuedInv);
     unsigned int nPrevNodeCount;
 
     /** Services this instance offers */
@@ -613,13 +739,25 @@ private:
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake;
+    /** flags for waking the message processors, one per message handler thread. */
+    std::vector<bool> vMsgProcWake;
+    /** Peers are spread over this many message handler threads by their id, so that each peer's
+     *  messages are always processed in order by the same thread. */
+    int nMsgHandlerThreads{DEFAULT_MSG_HANDLER_THREADS};
 
     std::condition_variable condMsgProc;
     std::mutex mutexMsgProc;
     std::atomic<bool> flagInterruptMsgProc;
 
+    /** Connection attempts waiting for a connection worker */
+    std::deque<std::unique_ptr<PendingConnection>> vPendingConnections;
+    /** Destinations of all queued and running connection attempts, to not connect to the same one twice */
+    std::map<std::string, CAddress> mapConnectingAddrs;
+    std::condition_variable condPendingConnections;
+    std::mutex mutexPendingConnections;
+    /** Number of connection workers, which is the maximum number of connection attempts in flight */
+    int nMaxConnectAttempts{DEFAULT_MAX_CONNECT_ATTEMPTS};
+
     CThreadInterrupt interruptNet;
 
 #ifdef USE_WAKEUP_PIPE
@@ -648,7 +786,8 @@ private:
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
     std::thread threadOpenMasternodeConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
+    std::vector<std::thread> threadOpenConnectionWorkers;
 
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
@@ -764,6 +903,8 @@ public:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    int64_t nProcessingTimeMicros;
+    mapMsgCmdProcessing mapProcessingPerMsgCmd;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
@@ -791,7 +932,7 @@ private:
 public:
     bool in_data;                   // parsing header (false) or data (true)
 
-    CDataStream hdrbuf;             // partially received header
+    CPooledDataStream hdrbuf;       // partially received header
     CMessageHeader hdr;             // complete header
     unsigned int nHdrPos;
 
@@ -808,6 +949,12 @@ public:
         nTime = 0;
     }
 
+    CNetMessage(CNetMessage&&) = default;
+    CNetMessage& operator=(CNetMessage&&) = default;
+
+    // Gives the payload buffer back to g_recv_buffer_pool
+    ~CNetMessage();
+
     bool complete() const
     {
         if (!in_data)
@@ -907,6 +1054,8 @@ public:
 
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // the signature of its MNAUTH is being verified, its following messages wait for the result
+    std::atomic_bool fPendingMNAuth{false};
 
     std::atomic_bool fHasRecvData;
     std::atomic_bool fCanSendData;
@@ -915,6 +1064,9 @@ protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd GUARDED_BY(cs_vRecv);
+    CCriticalSection cs_msgProcessing;
+    int64_t nProcessingTimeMicros GUARDED_BY(cs_msgProcessing){0};
+    mapMsgCmdProcessing mapProcessingPerMsgCmd GUARDED_BY(cs_msgProcessing);
 
 public:
     uint256 hashContinue;
@@ -946,6 +1098,11 @@ public:
     std::vector<uint256> vBlockHashesToAnnounce;
     // Used for BIP35 mempool sending, also protected by cs_inventory
     bool fSendMempool;
+    // TXs of the BIP35 mempool request being answered and the position of the next one to announce,
+    // also protected by cs_inventory
+    bool fMempoolReqInProgress{false};
+    std::vector<CTransactionRef> vMempoolReqTxs;
+    size_t nMempoolReqPos{0};
 
     // Block and TXN accept times
     std::atomic<int64_t> nLastBlockTime;
@@ -1118,6 +1275,9 @@ public:
 
     void copyStats(CNodeStats &stats);
 
+    /** Account the time spent in the handler of a message of this peer */
+    void RecordMsgProcessing(const std::string& strCommand, int64_t nMicros);
+
     ServiceFlags GetLocalServices() const
     {
         return nLocalServices;
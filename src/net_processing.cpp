@@ -10,11 +10,15 @@
 #include <blockencodings.h>
 #include <chainparams.h>
 #include <consensus/validation.h>
+#include <executor.h>
 #include <hash.h>
+#include <headerscache.h>
+#include <index/blockfilterindex.h>
 #include <init.h>
 #include <merkleblock.h>
 #include <netmessagemaker.h>
 #include <netbase.h>
+#include <objectrequest.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <primitives/block.h>
@@ -25,12 +29,18 @@
 #include <tinyformat.h>
 #include <txdb.h>
 #include <txmempool.h>
+#include <txorphanage.h>
 #include <ui_interface.h>
+#include <unordered_lru_cache.h>
 #include <util.h>
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
 
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <thread>
 
 #include <spork.h>
 #include <governance/governance.h>
@@ -104,18 +114,34 @@ static constexpr int STALE_RELAY_AGE_LIMIT = 30 * 24 * 60 * 60;
 /// Age after which a block is considered historical for purposes of rate
 /// limiting block relay. Set to one week, denominated in seconds.
 static constexpr int HISTORICAL_BLOCK_AGE = 7 * 24 * 60 * 60;
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Interval between compact filter checkpoints. See BIP 157. */
+static constexpr int CFCHECKPT_INTERVAL = 1000;
+/** Serialized size of a block header, which starts a BLOCK message */
+static constexpr size_t BLOCK_HEADER_SIZE = 80;
+/** Bounds of the adaptive number of blocks in flight from one peer, see GetAdaptiveBlockDownloadWindow */
+static constexpr int MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 4;
+static constexpr int MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 128;
+/** How long (in microseconds) a peer should be kept busy by its in-flight blocks, on top of its ping time */
+static constexpr int64_t BLOCK_DOWNLOAD_QUEUE_TIME = 1000000;
+/** Number of received blocks before the throughput estimate of a peer is used */
+static constexpr int BLOCK_DOWNLOAD_MIN_SAMPLES = 4;
+/** A block which holds the download window is given to a faster peer once it's in flight for this many times as long
+ *  as the faster peer would take for it, and at least BLOCK_REASSIGN_MIN_TIME microseconds */
+static constexpr int BLOCK_REASSIGN_FACTOR = 4;
+static constexpr int64_t BLOCK_REASSIGN_MIN_TIME = 500000;
+
+/** Share of -maxorphantxsize the orphans of a single peer may take */
+static constexpr unsigned int ORPHAN_TX_PEER_SHARE_DIVISOR = 4;
+/** Number of orphans ProcessOrphanTx accepts or rejects in one call before it lets the other peers be processed */
+static constexpr int ORPHAN_TX_PROCESS_BATCH = 8;
 
-struct COrphanTx {
-    // When modifying, adapt the copy of this definition in tests/DoS_tests.
-    CTransactionRef tx;
-    NodeId fromPeer;
-    int64_t nTimeExpire;
-    size_t nTxSize;
-};
 static CCriticalSection g_cs_orphans;
-std::map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(g_cs_orphans);
+CTxOrphanage g_orphanage GUARDED_BY(g_cs_orphans);
 
-size_t nMapOrphanTransactionsSize = 0;
 void EraseOrphansFor(NodeId peer);
 
 
@@ -131,6 +157,9 @@ static const unsigned int INVENTORY_BROADCAST_INTERVAL = 5;
  *  Limits the impact of low-fee transaction floods.
  *  We have 4 times smaller block times in Dash, so we need to push 4 times more invs per 1MB. */
 static constexpr unsigned int INVENTORY_BROADCAST_MAX_PER_1MB_BLOCK = 4 * 7 * INVENTORY_BROADCAST_INTERVAL;
+/** Maximum number of mempool TXs checked against the peer's filter per SendMessages call when answering a BIP35
+ *  mempool request. Large mempools are announced over multiple calls instead of all at once. */
+static const unsigned int MAX_MEMPOOL_REQ_TXS_PER_SEND = 1000;
 
 // Internal stuff
 namespace {
@@ -173,9 +202,13 @@ namespace {
         const CBlockIndex* pindex;                               //!< Optional.
         bool fValidatedHeaders;                                  //!< Whether this block has validated headers at the time of request.
         std::unique_ptr<PartiallyDownloadedBlock> partialBlock;  //!< Optional, used for CMPCTBLOCK downloads
+        int64_t nTimeRequested;                                  //!< In microseconds
     };
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight GUARDED_BY(cs_main);
 
+    /** Blocks which were received and wait in the block processing queue, they aren't requested again */
+    std::set<uint256> setBlocksQueuedForProcessing GUARDED_BY(cs_main);
+
     /** Stack of nodes which we have set to announce using compact blocks */
     std::list<NodeId> lNodesAnnouncingHeaderAndIDs GUARDED_BY(cs_main);
 
@@ -199,20 +232,32 @@ namespace {
 
     std::atomic<int64_t> nTimeBestReceived(0); // Used only to inform the wallet of when we last received a block
 
-    struct IteratorComparator
-    {
-        template<typename I>
-        bool operator()(const I& a, const I& b) const
-        {
-            return &(*a) < &(*b);
-        }
-    };
-    std::map<COutPoint, std::set<std::map<uint256, COrphanTx>::iterator, IteratorComparator>> mapOrphanTransactionsByPrev GUARDED_BY(g_cs_orphans);
-
     static size_t vExtraTxnForCompactIt GUARDED_BY(g_cs_orphans) = 0;
     static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUARDED_BY(g_cs_orphans);
 } // namespace
 
+/**
+ * Number of blocks to keep in flight from a peer which delivers nBytesPerSecond, so that it has enough requests queued
+ * to stay busy for its ping time plus BLOCK_DOWNLOAD_QUEUE_TIME. Slow peers get less of the download window, fast
+ * ones more than MAX_BLOCKS_IN_TRANSIT_PER_PEER.
+ */
+int GetAdaptiveBlockDownloadWindow(int64_t nBytesPerSecond, int64_t nAvgBlockBytes, int64_t nPingMicros)
+{
+    if (nBytesPerSecond <= 0 || nAvgBlockBytes <= 0) {
+        return MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER;
+    }
+    if (nPingMicros < 0 || nPingMicros == std::numeric_limits<int64_t>::max()) {
+        // not measured yet
+        nPingMicros = 0;
+    }
+    nPingMicros = std::min(nPingMicros, 10 * BLOCK_DOWNLOAD_QUEUE_TIME);
+    double nBlocks = (double)nBytesPerSecond * (nPingMicros + BLOCK_DOWNLOAD_QUEUE_TIME) / 1000000 / nAvgBlockBytes;
+    if (nBlocks >= MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER) {
+        return MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER;
+    }
+    return std::max(MIN_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER, (int)std::ceil(nBlocks));
+}
+
 namespace {
 struct CBlockReject {
     unsigned char chRejectCode;
@@ -260,6 +305,23 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+
+    //! Throughput model of the block downloads from this peer, which sizes its in-flight window
+    struct BlockDownloadStats {
+        //! Moving averages, -1 until the first sample
+        int64_t nBytesPerSecond{-1};
+        int64_t nAvgBlockBytes{-1};
+        int nSamples{0};
+        //! When the last requested block was received from this peer (in microseconds)
+        int64_t nLastReceived{0};
+        uint64_t nBlocksReceived{0};
+        uint64_t nBytesReceived{0};
+        //! Blocks requested from this peer which were given to faster peers
+        uint64_t nReassigned{0};
+        //! The last result of GetBlockDownloadWindow
+        int nWindow{MAX_BLOCKS_IN_TRANSIT_PER_PEER};
+    };
+    BlockDownloadStats m_block_download;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -304,14 +366,18 @@ struct CNodeState {
     //! Time of last new block announcement
     int64_t m_last_block_announcement;
 
+    //! Moving average of how late (in microseconds) this peer announces new blocks compared to the first peer that
+    //! announced them, -1 until the first sample
+    int64_t m_block_announce_delay;
+
     /*
      * State associated with objects download.
      *
      * Tx download algorithm:
      *
-     *   When inv comes in, queue up (process_time, inv) inside the peer's
-     *   CNodeState (m_object_process_time) as long as m_object_announced for the peer
-     *   isn't too big (MAX_PEER_OBJECT_ANNOUNCEMENTS).
+     *   When inv comes in, add it to g_object_requests as a queued announcement
+     *   with a process_time, as long as the peer hasn't announced too many
+     *   objects (MAX_PEER_OBJECT_ANNOUNCEMENTS).
      *
      *   The process_time for a objects is set to nNow for outbound peers,
      *   nNow + 2 seconds for inbound peers. This is the time at which we'll
@@ -322,45 +388,33 @@ struct CNodeState {
      *   objects (InvBlock).
      *
      *   When we call SendMessages() for a given peer,
-     *   we will loop over the objects in m_object_process_time, looking
+     *   we will loop over the queued announcements of the peer, looking
      *   at the objects whose process_time <= nNow. We'll request each
      *   such objects that we don't have already and that hasn't been
      *   requested from another peer recently, up until we hit the
-     *   MAX_PEER_OBJECT_IN_FLIGHT limit for the peer. Then we'll update
-     *   g_already_asked_for for each requested inv, storing the time of the
-     *   GETDATA request. We use g_already_asked_for to coordinate objects
-     *   requests amongst our peers.
+     *   MAX_PEER_OBJECT_IN_FLIGHT limit for the peer. The announcement is then
+     *   in flight, with the time of the GETDATA request, and the requests in
+     *   flight coordinate the objects requests amongst our peers.
      *
      *   For objects that we still need but we have already recently
-     *   requested from some other peer, we'll reinsert (process_time, inv)
-     *   back into the peer's m_object_process_time at the point in the future at
-     *   which the most recent GETDATA request would time out (ie
-     *   GetObjectInterval + the request time stored in g_already_asked_for).
+     *   requested from some other peer, we'll requeue the announcement
+     *   at the point in the future at which the most recent GETDATA request
+     *   would time out (ie GetObjectInterval + the latest request time in flight).
      *   We add an additional delay for inbound peers, again to prefer
      *   attempting download from outbound peers first.
      *   We also add an extra small random delay up to 2 seconds
      *   to avoid biasing some peers over others. (e.g., due to fixed ordering
      *   of peer processing in ThreadMessageHandler).
+     *   When the peer we wait for answers with NOTFOUND or disconnects, its
+     *   request is gone and the others may request the object right away.
      *
-     *   When we receive a objects from a peer, we remove the inv from the
-     *   peer's m_object_in_flight set and from their recently announced set
-     *   (m_object_announced).  We also clear g_already_asked_for for that entry, so
-     *   that if somehow the objects is not accepted but also not added to
-     *   the reject filter, then we will eventually redownload from other
-     *   peers.
+     *   When we receive a objects from a peer, we remove all announcements
+     *   of it from g_object_requests and add it to g_erased_object_requests,
+     *   so that if somehow the objects is not accepted but also not added to
+     *   the reject filter, we don't request it again until it drops out of
+     *   g_erased_object_requests.
      */
     struct ObjectDownloadState {
-        /* Track when to attempt download of announced objects (process
-         * time in micros -> inv)
-         */
-        std::multimap<std::chrono::microseconds, CInv> m_object_process_time;
-
-        //! Store all the objects a peer has recently announced
-        std::set<CInv> m_object_announced;
-
-        //! Store objects which were requested by us, with timestamp
-        std::map<CInv, std::chrono::microseconds> m_object_in_flight;
-
         //! Periodically check for stuck getdata requests
         std::chrono::microseconds m_check_expiry_timer{0};
     };
@@ -389,11 +443,12 @@ struct CNodeState {
         fSupportsDesiredCmpctVersion = false;
         m_chain_sync = { 0, nullptr, false, false };
         m_last_block_announcement = 0;
+        m_block_announce_delay = -1;
     }
 };
 
-// Keeps track of the time (in microseconds) when transactions were requested last time
-unordered_limitedmap<uint256, std::chrono::microseconds, StaticSaltedHasher> g_already_asked_for(MAX_INV_SZ, MAX_INV_SZ * 2);
+// The announced objects of all peers, queued or requested
+CObjectRequestTracker g_object_requests GUARDED_BY(cs_main);
 unordered_limitedmap<uint256, std::chrono::microseconds, StaticSaltedHasher> g_erased_object_requests(MAX_INV_SZ, MAX_INV_SZ * 2);
 
 /** Map maintaining per-node state. */
@@ -451,9 +506,31 @@ void PushNodeVersion(CNode *pnode, CConnman* connman, int64_t nTime)
     }
 }
 
+// Adds a sample to the throughput model of the peer which delivered a block it was asked for. The transfer is taken
+// to start when it was requested or when the peer's previous block arrived, whichever is later, as the peer sends
+// the requested blocks one after the other.
+void UpdateBlockDownloadStats(CNodeState* state, const QueuedBlock& queuedBlock, size_t nBytes) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    auto& stats = state->m_block_download;
+    int64_t nNow = GetTimeMicros();
+    int64_t nDuration = std::max<int64_t>(nNow - std::max(queuedBlock.nTimeRequested, stats.nLastReceived), 1000);
+    int64_t nBytesPerSecond = (int64_t)nBytes * 1000000 / nDuration;
+    if (stats.nSamples == 0) {
+        stats.nBytesPerSecond = nBytesPerSecond;
+        stats.nAvgBlockBytes = nBytes;
+    } else {
+        stats.nBytesPerSecond = (stats.nBytesPerSecond * 7 + nBytesPerSecond) / 8;
+        stats.nAvgBlockBytes = (stats.nAvgBlockBytes * 7 + (int64_t)nBytes) / 8;
+    }
+    stats.nSamples++;
+    stats.nLastReceived = nNow;
+    stats.nBlocksReceived++;
+    stats.nBytesReceived += nBytes;
+}
+
 // Returns a bool indicating whether we requested this block.
 // Also used if a block was /not/ received and timed out or started with another peer
-bool MarkBlockAsReceived(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+// nodeFrom and nBytes are the peer which sent the block and its size, if it was received in full
+bool MarkBlockAsReceived(const uint256& hash, NodeId nodeFrom = -1, size_t nBytes = 0) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
     if (itInFlight != mapBlocksInFlight.end()) {
         CNodeState *state = State(itInFlight->second.first);
@@ -467,6 +544,9 @@ bool MarkBlockAsReceived(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
             // First block on the queue was received, update the start download time for the next one
             state->nDownloadingSince = std::max(state->nDownloadingSince, GetTimeMicros());
         }
+        if (nBytes != 0 && itInFlight->second.first == nodeFrom) {
+            UpdateBlockDownloadStats(state, *itInFlight->second.second, nBytes);
+        }
         state->vBlocksInFlight.erase(itInFlight->second.second);
         state->nBlocksInFlight--;
         state->nStallingSince = 0;
@@ -495,7 +575,7 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex *
     MarkBlockAsReceived(hash);
 
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
-            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr)});
+            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr), GetTimeMicros()});
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += it->fValidatedHeaders;
     if (state->nBlocksInFlight == 1) {
@@ -511,6 +591,33 @@ bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlockIndex *
     return true;
 }
 
+// The number of blocks to keep in flight from a peer, fixed until its throughput is known
+int GetBlockDownloadWindow(const CNode* pnode, const CNodeState* state) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    const auto& stats = state->m_block_download;
+    if (stats.nSamples < BLOCK_DOWNLOAD_MIN_SAMPLES || !gArgs.GetBoolArg("-adaptiveblockdownload", DEFAULT_ADAPTIVE_BLOCK_DOWNLOAD)) {
+        return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    }
+    return GetAdaptiveBlockDownloadWindow(stats.nBytesPerSecond, stats.nAvgBlockBytes, pnode->nMinPingUsecTime);
+}
+
+// Whether a block which holds the download window, in flight from stateStaller for some time already, should be
+// requested from the faster peer of state instead
+bool ShouldReassignBlock(const CNodeState* state, const CNodeState* stateStaller, const QueuedBlock& queuedBlock, int64_t nNow) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
+    const auto& stats = state->m_block_download;
+    const auto& statsStaller = stateStaller->m_block_download;
+    if (stats.nSamples < BLOCK_DOWNLOAD_MIN_SAMPLES || stats.nBytesPerSecond <= 0 || queuedBlock.partialBlock) {
+        return false;
+    }
+    if (statsStaller.nSamples >= BLOCK_DOWNLOAD_MIN_SAMPLES && statsStaller.nBytesPerSecond >= stats.nBytesPerSecond) {
+        return false;
+    }
+    if (!gArgs.GetBoolArg("-adaptiveblockdownload", DEFAULT_ADAPTIVE_BLOCK_DOWNLOAD)) {
+        return false;
+    }
+    int64_t nExpected = stats.nAvgBlockBytes * 1000000 / stats.nBytesPerSecond;
+    return nNow - queuedBlock.nTimeRequested > std::max(BLOCK_REASSIGN_MIN_TIME, BLOCK_REASSIGN_FACTOR * nExpected);
+}
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
@@ -528,6 +635,45 @@ void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
 }
 
 /** Update tracking information about which blocks a peer is assumed to have. */
+/** When we first heard of the most recent new blocks (in microseconds) and which peers announced them since then */
+struct BlockFirstSeen {
+    int64_t nTime;
+    std::set<NodeId> setAnnouncedBy;
+};
+static std::map<uint256, BlockFirstSeen> mapBlocksFirstSeen GUARDED_BY(cs_main);
+static const size_t MAX_BLOCKS_FIRST_SEEN = 16;
+
+/** Update the block announcement delay of a peer which just announced a block */
+static void UpdateBlockAnnounceDelay(CNodeState* state, NodeId nodeid, const uint256& hash, const CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    int64_t nNow = GetTimeMicros();
+    auto it = mapBlocksFirstSeen.find(hash);
+    if (it == mapBlocksFirstSeen.end()) {
+        // Only measure blocks which were new to us, not the ones of a headers sync
+        if (IsInitialBlockDownload() || (pindex && pindex->nChainWork < chainActive.Tip()->nChainWork)) {
+            return;
+        }
+        if (mapBlocksFirstSeen.size() >= MAX_BLOCKS_FIRST_SEEN) {
+            auto itOldest = std::min_element(mapBlocksFirstSeen.begin(), mapBlocksFirstSeen.end(), [](const std::pair<const uint256, BlockFirstSeen>& a, const std::pair<const uint256, BlockFirstSeen>& b) {
+                return a.second.nTime < b.second.nTime;
+            });
+            mapBlocksFirstSeen.erase(itOldest);
+        }
+        it = mapBlocksFirstSeen.emplace(hash, BlockFirstSeen{nNow, {}}).first;
+    }
+    if (!it->second.setAnnouncedBy.emplace(nodeid).second) {
+        // Only the first announcement of a block by a peer counts
+        return;
+    }
+
+    int64_t nDelay = nNow - it->second.nTime;
+    if (state->m_block_announce_delay < 0) {
+        state->m_block_announce_delay = nDelay;
+    } else {
+        state->m_block_announce_delay = (state->m_block_announce_delay * 7 + nDelay) / 8;
+    }
+}
+
 void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
     assert(state != nullptr);
@@ -535,6 +681,7 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256 &hash) EXCLUSIVE_LOCKS
     ProcessBlockAvailability(nodeid);
 
     const CBlockIndex* pindex = LookupBlockIndex(hash);
+    UpdateBlockAnnounceDelay(state, nodeid, hash, pindex);
     if (pindex && pindex->nChainWork > 0) {
         // An actually better block was announced.
         if (state->pindexBestKnownBlock == nullptr || pindex->nChainWork >= state->pindexBestKnownBlock->nChainWork) {
@@ -568,18 +715,44 @@ void MaybeSetPeerAsAnnouncingHeaderAndIDs(NodeId nodeid, CConnman* connman)
                 return;
             }
         }
-        connman->ForNode(nodeid, [connman](CNode* pfrom){
+        const bool fPreferMasternodes = gArgs.GetBoolArg("-cmpctblockprefermasternodes", DEFAULT_CMPCTBLOCK_PREFER_MASTERNODES);
+        connman->ForNode(nodeid, [connman, fPreferMasternodes](CNode* pfrom){
             AssertLockHeld(cs_main);
             uint64_t nCMPCTBLOCKVersion = 1;
             if (lNodesAnnouncingHeaderAndIDs.size() >= 3) {
                 // As per BIP152, we only get 3 of our peers to announce
                 // blocks using compact encodings.
-                connman->ForNode(lNodesAnnouncingHeaderAndIDs.front(), [connman, nCMPCTBLOCKVersion](CNode* pnodeStop){
+                auto itStop = lNodesAnnouncingHeaderAndIDs.begin();
+                if (fPreferMasternodes) {
+                    // Replace a regular peer before any masternode, and among those the one announcing blocks the
+                    // latest. Regular peers never replace masternodes, so that quorum members see new tips first.
+                    bool fStopIsMasternode = true;
+                    int64_t nStopDelay = -1;
+                    for (auto it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); ++it) {
+                        bool fIsMasternode = false;
+                        connman->ForNode(*it, [&fIsMasternode](CNode* pnode) {
+                            fIsMasternode = !pnode->verifiedProRegTxHash.IsNull();
+                            return true;
+                        });
+                        const CNodeState* state = State(*it);
+                        int64_t nDelay = state ? state->m_block_announce_delay : -1;
+                        if (it == lNodesAnnouncingHeaderAndIDs.begin() || (fStopIsMasternode && !fIsMasternode) ||
+                                (fStopIsMasternode == fIsMasternode && nDelay > nStopDelay)) {
+                            itStop = it;
+                            fStopIsMasternode = fIsMasternode;
+                            nStopDelay = nDelay;
+                        }
+                    }
+                    if (fStopIsMasternode && pfrom->verifiedProRegTxHash.IsNull()) {
+                        return true;
+                    }
+                }
+                connman->ForNode(*itStop, [connman, nCMPCTBLOCKVersion](CNode* pnodeStop){
                     AssertLockHeld(cs_main);
                     connman->PushMessage(pnodeStop, CNetMsgMaker(pnodeStop->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/false, nCMPCTBLOCKVersion));
                     return true;
                 });
-                lNodesAnnouncingHeaderAndIDs.pop_front();
+                lNodesAnnouncingHeaderAndIDs.erase(itStop);
             }
             connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(NetMsgType::SENDCMPCT, /*fAnnounceUsingCMPCTBLOCK=*/true, nCMPCTBLOCKVersion));
             lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
@@ -650,6 +823,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    const CBlockIndex* pindexWaitingFor = nullptr;
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -674,12 +848,27 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
             if (pindex->nStatus & BLOCK_HAVE_DATA || chainActive.Contains(pindex)) {
                 if (pindex->nChainTx)
                     state->pindexLastCommonBlock = pindex;
+            } else if (setBlocksQueuedForProcessing.count(pindex->GetBlockHash())) {
+                // Received already, waiting to be processed.
             } else if (mapBlocksInFlight.count(pindex->GetBlockHash()) == 0) {
                 // The block is not already downloaded, and not yet in flight.
                 if (pindex->nHeight > nWindowEnd) {
                     // We reached the end of the window.
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
+                        // Unless the block we're waiting for takes much longer than this peer would take for it,
+                        // then ask this peer for it instead of waiting for the staller.
+                        if (pindexWaitingFor != nullptr) {
+                            CNodeState* stateStaller = State(waitingfor);
+                            const QueuedBlock& queuedBlock = *mapBlocksInFlight[pindexWaitingFor->GetBlockHash()].second;
+                            if (ShouldReassignBlock(state, stateStaller, queuedBlock, GetTimeMicros())) {
+                                LogPrint(BCLog::NET, "Reassigning block %s (%d) from peer=%d to peer=%d\n", pindexWaitingFor->GetBlockHash().ToString(),
+                                    pindexWaitingFor->nHeight, waitingfor, nodeid);
+                                stateStaller->m_block_download.nReassigned++;
+                                vBlocks.push_back(pindexWaitingFor);
+                                return;
+                            }
+                        }
                         nodeStaller = waitingfor;
                     }
                     return;
@@ -691,54 +880,29 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                pindexWaitingFor = pindex;
             }
         }
     }
 }
 } // namespace
 
-void EraseObjectRequest(CNodeState* nodestate, const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    AssertLockHeld(cs_main);
-    LogPrint(BCLog::NET, "%s -- inv=(%s)\n", __func__, inv.ToString());
-    g_already_asked_for.erase(inv.hash);
-    g_erased_object_requests.insert(std::make_pair(inv.hash, GetTime<std::chrono::microseconds>()));
-
-    if (nodestate) {
-        nodestate->m_object_download.m_object_announced.erase(inv);
-        nodestate->m_object_download.m_object_in_flight.erase(inv);
-    }
-}
-
 void EraseObjectRequest(NodeId nodeId, const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
-    auto* state = State(nodeId);
-    if (!state) {
+    if (!State(nodeId)) {
         return;
     }
-    EraseObjectRequest(state, inv);
+    LogPrint(BCLog::NET, "%s -- inv=(%s)\n", __func__, inv.ToString());
+    g_erased_object_requests.insert(std::make_pair(inv.hash, GetTime<std::chrono::microseconds>()));
+    // the announcements of the other peers would be skipped because of g_erased_object_requests anyway
+    g_object_requests.ForgetHash(inv.hash);
 }
 
 std::chrono::microseconds GetObjectRequestTime(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
-    auto it = g_already_asked_for.find(hash);
-    if (it != g_already_asked_for.end()) {
-        return it->second;
-    }
-    return {};
-}
-
-void UpdateObjectRequestTime(const uint256& hash, std::chrono::microseconds request_time) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    AssertLockHeld(cs_main);
-    auto it = g_already_asked_for.find(hash);
-    if (it == g_already_asked_for.end()) {
-        g_already_asked_for.insert(std::make_pair(hash, request_time));
-    } else {
-        g_already_asked_for.update(it, request_time);
-    }
+    return g_object_requests.GetLastRequestTime(hash);
 }
 
 std::chrono::microseconds GetObjectInterval(int invType)
@@ -790,42 +954,30 @@ std::chrono::microseconds CalculateObjectGetDataTime(const CInv& inv, std::chron
     return process_time;
 }
 
-void RequestObject(CNodeState* state, const CInv& inv, std::chrono::microseconds current_time, bool fForce = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+void RequestObject(NodeId nodeId, const CInv& inv, std::chrono::microseconds current_time, bool fForce) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 {
     AssertLockHeld(cs_main);
-    CNodeState::ObjectDownloadState& peer_download_state = state->m_object_download;
-    if (peer_download_state.m_object_announced.size() >= MAX_PEER_OBJECT_ANNOUNCEMENTS ||
-            peer_download_state.m_object_process_time.size() >= MAX_PEER_OBJECT_ANNOUNCEMENTS ||
-            peer_download_state.m_object_announced.count(inv)) {
-        // Too many queued announcements from this peer, or we already have
-        // this announcement
+    auto* state = State(nodeId);
+    if (!state) {
         return;
     }
-    peer_download_state.m_object_announced.insert(inv);
-
-    // Calculate the time to try requesting this transaction. Use
-    // fPreferredDownload as a proxy for outbound peers.
-    std::chrono::microseconds process_time = CalculateObjectGetDataTime(inv, current_time, !state->fPreferredDownload);
-
-    peer_download_state.m_object_process_time.emplace(process_time, inv);
-
     if (fForce) {
         // make sure this object is actually requested ASAP
         g_erased_object_requests.erase(inv.hash);
-        g_already_asked_for.erase(inv.hash);
+        g_object_requests.ResetRequestTime(inv.hash);
     }
 
-    LogPrint(BCLog::NET, "%s -- inv=(%s), current_time=%d, process_time=%d, delta=%d\n", __func__, inv.ToString(), current_time.count(), process_time.count(), (process_time - current_time).count());
-}
+    // Calculate the time to try requesting this transaction. Use
+    // fPreferredDownload as a proxy for outbound peers.
+    std::chrono::microseconds process_time = CalculateObjectGetDataTime(inv, current_time, !state->fPreferredDownload);
 
-void RequestObject(NodeId nodeId, const CInv& inv, std::chrono::microseconds current_time, bool fForce) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    AssertLockHeld(cs_main);
-    auto* state = State(nodeId);
-    if (!state) {
+    if (!g_object_requests.ReceivedInv(nodeId, inv, process_time, MAX_PEER_OBJECT_ANNOUNCEMENTS)) {
+        // Too many queued announcements from this peer, or we already have
+        // this announcement
         return;
     }
-    RequestObject(state, inv, current_time, fForce);
+
+    LogPrint(BCLog::NET, "%s -- inv=(%s), current_time=%d, process_time=%d, delta=%d\n", __func__, inv.ToString(), current_time.count(), process_time.count(), (process_time - current_time).count());
 }
 
 size_t GetRequestedObjectCount(NodeId nodeId)
@@ -835,7 +987,7 @@ size_t GetRequestedObjectCount(NodeId nodeId)
     if (!state) {
         return 0;
     }
-    return state->m_object_download.m_object_process_time.size();
+    return g_object_requests.CountQueued(nodeId);
 }
 
 // This function is used for testing the stale tip eviction logic, see
@@ -888,6 +1040,7 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
     assert(nPeersWithValidatedDownloads >= 0);
     g_outbound_peers_with_protect_from_disconnect -= state->m_chain_sync.m_protect;
     assert(g_outbound_peers_with_protect_from_disconnect >= 0);
+    g_object_requests.DisconnectedPeer(nodeid);
 
     mapNodeState.erase(nodeid);
 
@@ -897,6 +1050,7 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
         assert(nPreferredDownload == 0);
         assert(nPeersWithValidatedDownloads == 0);
         assert(g_outbound_peers_with_protect_from_disconnect == 0);
+        assert(g_object_requests.Size() == 0);
     }
     LogPrint(BCLog::NET, "Cleared nodestate for peer=%d\n", nodeid);
 }
@@ -909,6 +1063,12 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     stats.nMisbehavior = state->nMisbehavior;
     stats.nSyncHeight = state->pindexBestKnownBlock ? state->pindexBestKnownBlock->nHeight : -1;
     stats.nCommonHeight = state->pindexLastCommonBlock ? state->pindexLastCommonBlock->nHeight : -1;
+    stats.nBlockAnnounceDelay = state->m_block_announce_delay;
+    stats.nBlockDownloadBytesPerSecond = state->m_block_download.nBytesPerSecond;
+    stats.nBlocksDownloaded = state->m_block_download.nBlocksReceived;
+    stats.nBlockBytesDownloaded = state->m_block_download.nBytesReceived;
+    stats.nBlocksReassigned = state->m_block_download.nReassigned;
+    stats.nBlockDownloadWindow = state->m_block_download.nWindow;
     for (const QueuedBlock& queue : state->vBlocksInFlight) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
@@ -916,9 +1076,46 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     return true;
 }
 
+static CCompactBlockReconstructionStats compactBlockReconstructionStats GUARDED_BY(cs_main);
+
+CCompactBlockReconstructionStats GetCompactBlockReconstructionStats()
+{
+    LOCK(cs_main);
+    return compactBlockReconstructionStats;
+}
+
+static void UpdateCompactBlockReconstructionStats(const PartiallyDownloadedBlock& partialBlock, bool fRoundTrip) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    auto& stats = compactBlockReconstructionStats;
+    stats.nBlocks++;
+    if (fRoundTrip) {
+        stats.nRoundTrips++;
+    } else {
+        stats.nReconstructed++;
+        if (partialBlock.GetDashCount() != 0) {
+            stats.nRoundTripsSaved++;
+        }
+    }
+    stats.nTxPrefilled += partialBlock.GetPrefilledCount();
+    stats.nTxMempool += partialBlock.GetMempoolCount() - partialBlock.GetExtraCount() - partialBlock.GetDashCount();
+    stats.nTxExtra += partialBlock.GetExtraCount();
+    stats.nTxDash += partialBlock.GetDashCount();
+}
+
+/** Transactions known to InstantSend and CoinJoin, to be used in addition to the mempool for compact blocks */
+static std::vector<std::pair<uint256, CTransactionRef>> GetDashTxnForCompact()
+{
+    std::vector<std::pair<uint256, CTransactionRef>> vtx;
+    CCoinJoin::GetDSTXTransactions(vtx);
+    if (llmq::quorumInstantSendManager) {
+        llmq::quorumInstantSendManager->GetTxsForCompactBlocks(vtx);
+    }
+    return vtx;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
-// mapOrphanTransactions
+// g_orphanage
 //
 
 void AddToCompactExtraTransactions(const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
@@ -935,7 +1132,7 @@ void AddToCompactExtraTransactions(const CTransactionRef& tx) EXCLUSIVE_LOCKS_RE
 bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
 {
     const uint256& hash = tx->GetHash();
-    if (mapOrphanTransactions.count(hash))
+    if (g_orphanage.HaveTx(hash))
         return false;
 
     // Ignore big transactions, to avoid a
@@ -952,62 +1149,52 @@ bool AddOrphanTx(const CTransactionRef& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRE
         return false;
     }
 
-    auto ret = mapOrphanTransactions.emplace(hash, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, sz});
-    assert(ret.second);
-    for (const CTxIn& txin : tx->vin) {
-        mapOrphanTransactionsByPrev[txin.prevout].insert(ret.first);
-    }
+    bool ret = g_orphanage.AddTx(tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME, sz);
+    assert(ret);
 
     AddToCompactExtraTransactions(tx);
 
-    nMapOrphanTransactionsSize += sz;
-
-    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u)\n", hash.ToString(),
-             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
+    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u peersz %u)\n", hash.ToString(),
+             g_orphanage.Size(), g_orphanage.PrevoutCount(), g_orphanage.PeerCount(peer));
     statsClient.inc("transactions.orphans.add", 1.0f);
-    statsClient.gauge("transactions.orphans", mapOrphanTransactions.size());
+    statsClient.gauge("transactions.orphans", g_orphanage.Size());
     return true;
 }
 
-int static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
+static void UpdateOrphanStats(int nErased) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
 {
-    std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
-    if (it == mapOrphanTransactions.end())
-        return 0;
-    for (const CTxIn& txin : it->second.tx->vin)
-    {
-        auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
-        if (itPrev == mapOrphanTransactionsByPrev.end())
-            continue;
-        itPrev->second.erase(it);
-        if (itPrev->second.empty())
-            mapOrphanTransactionsByPrev.erase(itPrev);
-    }
-    assert(nMapOrphanTransactionsSize >= it->second.nTxSize);
-    nMapOrphanTransactionsSize -= it->second.nTxSize;
-    mapOrphanTransactions.erase(it);
-    statsClient.inc("transactions.orphans.remove", 1.0f);
-    statsClient.gauge("transactions.orphans", mapOrphanTransactions.size());
-    return 1;
+    if (nErased > 0) {
+        statsClient.inc("transactions.orphans.remove", (float)nErased);
+        statsClient.gauge("transactions.orphans", g_orphanage.Size());
+    }
+}
+
+int static EraseOrphanTx(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
+{
+    int nErased = g_orphanage.EraseTx(hash);
+    UpdateOrphanStats(nErased);
+    return nErased;
 }
 
 void EraseOrphansFor(NodeId peer)
 {
     LOCK(g_cs_orphans);
-    int nErased = 0;
-    std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-    while (iter != mapOrphanTransactions.end())
-    {
-        std::map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer)
-        {
-            nErased += EraseOrphanTx(maybeErase->second.tx->GetHash());
-        }
-    }
+    int nErased = g_orphanage.EraseForPeer(peer);
+    UpdateOrphanStats(nErased);
     if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx from peer=%d\n", nErased, peer);
 }
 
 
+/** Evict random orphans of the peer until they take at most nMaxPeerSize bytes, so that a single peer can't push
+ *  the orphans of all others out of the pool */
+unsigned int LimitOrphanTxPeerSize(NodeId peer, unsigned int nMaxPeerSize)
+{
+    LOCK(g_cs_orphans);
+    int nEvicted = g_orphanage.LimitPeerSize(peer, nMaxPeerSize);
+    UpdateOrphanStats(nEvicted);
+    return nEvicted;
+}
+
 unsigned int LimitOrphanTxSize(unsigned int nMaxOrphansSize)
 {
     LOCK(g_cs_orphans);
@@ -1017,32 +1204,16 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphansSize)
     int64_t nNow = GetTime();
     if (nNextSweep <= nNow) {
         // Sweep out expired orphan pool entries:
-        int nErased = 0;
         int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-        while (iter != mapOrphanTransactions.end())
-        {
-            std::map<uint256, COrphanTx>::iterator maybeErase = iter++;
-            if (maybeErase->second.nTimeExpire <= nNow) {
-                nErased += EraseOrphanTx(maybeErase->second.tx->GetHash());
-            } else {
-                nMinExpTime = std::min(maybeErase->second.nTimeExpire, nMinExpTime);
-            }
-        }
+        int nErased = g_orphanage.EraseExpired(nNow, nMinExpTime);
+        UpdateOrphanStats(nErased);
         // Sweep again 5 minutes after the next entry that expires in order to batch the linear scan.
         nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
         if (nErased > 0) LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n", nErased);
     }
-    while (!mapOrphanTransactions.empty() && nMapOrphanTransactionsSize > nMaxOrphansSize)
-    {
-        // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
-        EraseOrphanTx(it->first);
-        ++nEvicted;
-    }
+    // Evict random orphans:
+    nEvicted = g_orphanage.LimitSize(nMaxOrphansSize);
+    UpdateOrphanStats(nEvicted);
     return nEvicted;
 }
 
@@ -1091,6 +1262,314 @@ bool IsBanned(NodeId pnode)
 
 
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// LLMQ message lane
+//
+
+namespace {
+/** Maximum number of LLMQ messages waiting to be processed, the message handler waits when it's full */
+static const size_t MAX_LLMQ_MESSAGE_QUEUE_SIZE = 10000;
+
+/**
+ * LLMQ signing, ChainLock and InstantSend messages are processed on their own thread, in the order
+ * they were received, so that they aren't held up behind block and transaction processing of the
+ * message handler. Queued messages hold a reference to their node.
+ */
+class CLLMQMessageQueue
+{
+private:
+    struct QueuedMessage {
+        CNode* pfrom;
+        std::string strCommand;
+        CDataStream vRecv;
+        int64_t nTimeQueued;
+    };
+
+    std::mutex cs;
+    std::condition_variable condQueue;
+    std::condition_variable condSpace;
+    std::deque<QueuedMessage> queue;
+    bool fStopped{true};
+    std::thread thread;
+
+    static void ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+    {
+        try {
+            if (strCommand == NetMsgType::QSIGREC) {
+                llmq::quorumSigningManager->ProcessMessage(pfrom, strCommand, vRecv);
+            } else if (strCommand == NetMsgType::CLSIG) {
+                llmq::chainLocksHandler->ProcessMessage(pfrom, strCommand, vRecv);
+            } else if (strCommand == NetMsgType::ISLOCK) {
+                llmq::quorumInstantSendManager->ProcessMessage(pfrom, strCommand, vRecv);
+            } else {
+                llmq::quorumSigSharesManager->ProcessMessage(pfrom, strCommand, vRecv);
+            }
+        } catch (const std::exception& e) {
+            LogPrint(BCLog::NET, "CLLMQMessageQueue::%s(%s) -- Exception '%s' caught, peer=%d\n", __func__, SanitizeString(strCommand), e.what(), pfrom->GetId());
+        }
+    }
+
+    void Thread()
+    {
+        RenameThread("dash-llmqmsg");
+        while (true) {
+            std::unique_lock<std::mutex> lock(cs);
+            condQueue.wait(lock, [this] { return fStopped || !queue.empty(); });
+            if (fStopped) {
+                return;
+            }
+            QueuedMessage msg(std::move(queue.front()));
+            queue.pop_front();
+            size_t nDepth = queue.size();
+            lock.unlock();
+            condSpace.notify_one();
+
+            statsClient.gauge("llmq.messageQueue.depth", nDepth, 0.1f);
+            statsClient.timing("llmq.messageQueue.waitTime", GetTimeMillis() - msg.nTimeQueued, 0.1f);
+            if (!msg.pfrom->fDisconnect) {
+                ProcessMessage(msg.pfrom, msg.strCommand, msg.vRecv);
+            }
+            msg.pfrom->Release();
+        }
+    }
+
+public:
+    static bool IsLaneMessage(const std::string& strCommand)
+    {
+        return strCommand == NetMsgType::QSIGSHARE || strCommand == NetMsgType::QSIGSESANN || strCommand == NetMsgType::QSIGSHARESINV ||
+               strCommand == NetMsgType::QGETSIGSHARES || strCommand == NetMsgType::QBSIGSHARES || strCommand == NetMsgType::QSIGREC ||
+               strCommand == NetMsgType::CLSIG || strCommand == NetMsgType::ISLOCK;
+    }
+
+    void Start()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (!fStopped) {
+            return;
+        }
+        fStopped = false;
+        thread = std::thread(&CLLMQMessageQueue::Thread, this);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStopped = true;
+        }
+        condQueue.notify_all();
+        condSpace.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        std::lock_guard<std::mutex> lock(cs);
+        for (QueuedMessage& msg : queue) {
+            msg.pfrom->Release();
+        }
+        queue.clear();
+    }
+
+    /** Queue a message for the LLMQ thread, returns false if it's not running and the caller has to process it itself */
+    bool Push(CNode* pfrom, const std::string& strCommand, CDataStream&& vRecv)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        condSpace.wait(lock, [this] { return fStopped || queue.size() < MAX_LLMQ_MESSAGE_QUEUE_SIZE; });
+        if (fStopped) {
+            return false;
+        }
+        pfrom->AddRef();
+        queue.push_back(QueuedMessage{pfrom, strCommand, std::move(vRecv), GetTimeMillis()});
+        lock.unlock();
+        condQueue.notify_one();
+        return true;
+    }
+};
+
+CLLMQMessageQueue llmqMessageQueue;
+} // anon namespace
+
+void PeerLogicValidation::StopLLMQMessageThread()
+{
+    llmqMessageQueue.Stop();
+}
+
+//
+// Block processing lane
+//
+
+namespace {
+/** Maximum number of received blocks waiting in the block processing queue, the message handler waits when it's full */
+static const size_t MAX_BLOCK_PROCESSING_QUEUE_SIZE = 64;
+
+/**
+ * During initial block download, the blocks we requested are deserialized and checked with CheckBlock on the
+ * executor, out of order, while they wait in this queue. Its thread hands them to ProcessNewBlock lowest height
+ * first, once their checks are done, so connecting them only does the contextual work and the message handler
+ * doesn't wait for it. Queued blocks hold a reference to their node.
+ */
+class CBlockProcessingQueue
+{
+private:
+    struct PendingBlock {
+        CNode* pfrom;
+        uint256 hash;
+        CDataStream vRecv;
+        //! Set by the checking task, nullptr if the block couldn't be deserialized
+        std::shared_ptr<CBlock> pblock;
+        std::string strError;
+        bool fChecked{false};
+
+        PendingBlock(CNode* pfromIn, const uint256& hashIn, CDataStream&& vRecvIn) : pfrom(pfromIn), hash(hashIn), vRecv(std::move(vRecvIn)) {}
+    };
+
+    // Shared with the checking tasks, which may finish after Stop()
+    struct State {
+        std::mutex cs;
+        std::condition_variable condQueue;
+        std::condition_variable condSpace;
+        //! By height
+        std::multimap<int, std::shared_ptr<PendingBlock>> queue;
+        bool fStopped{true};
+    };
+
+    const std::shared_ptr<State> state{std::make_shared<State>()};
+    std::thread thread;
+
+    static void CheckPendingBlock(const std::shared_ptr<State>& state, const std::shared_ptr<PendingBlock>& entry)
+    {
+        auto pblock = std::make_shared<CBlock>();
+        std::string strError;
+        try {
+            entry->vRecv >> *pblock;
+            // The result is kept in pblock->fChecked, a failing block is checked again by ProcessNewBlock, which
+            // reports it
+            CValidationState dummy;
+            CheckBlock(*pblock, dummy, Params().GetConsensus());
+        } catch (const std::exception& e) {
+            pblock.reset();
+            strError = e.what();
+        }
+        std::lock_guard<std::mutex> lock(state->cs);
+        entry->vRecv.clear();
+        entry->pblock = std::move(pblock);
+        entry->strError = std::move(strError);
+        entry->fChecked = true;
+        state->condQueue.notify_one();
+    }
+
+    static void ProcessPendingBlock(PendingBlock& entry)
+    {
+        bool fNewBlock = false;
+        if (entry.pblock) {
+            try {
+                // We requested it, like forceProcessing in the BLOCK handler
+                ProcessNewBlock(Params(), entry.pblock, true, &fNewBlock);
+            } catch (const std::exception& e) {
+                LogPrintf("CBlockProcessingQueue::%s -- Exception '%s' caught, block %s peer=%d\n", __func__, e.what(), entry.hash.ToString(), entry.pfrom->GetId());
+            }
+        } else {
+            LogPrint(BCLog::NET, "CBlockProcessingQueue::%s -- failed to deserialize block %s peer=%d: %s\n", __func__, entry.hash.ToString(), entry.pfrom->GetId(), entry.strError);
+        }
+        if (fNewBlock) {
+            entry.pfrom->nLastBlockTime = GetTime();
+        }
+        LOCK(cs_main);
+        if (!fNewBlock) {
+            mapBlockSource.erase(entry.hash);
+        }
+        setBlocksQueuedForProcessing.erase(entry.hash);
+    }
+
+    void Thread()
+    {
+        RenameThread("dash-blockproc");
+        while (true) {
+            std::unique_lock<std::mutex> lock(state->cs);
+            // The lowest block is processed first, even when higher ones were checked before it
+            state->condQueue.wait(lock, [this] { return state->fStopped || (!state->queue.empty() && state->queue.begin()->second->fChecked); });
+            if (state->fStopped) {
+                return;
+            }
+            auto entry = std::move(state->queue.begin()->second);
+            state->queue.erase(state->queue.begin());
+            size_t nDepth = state->queue.size();
+            lock.unlock();
+            state->condSpace.notify_one();
+
+            statsClient.gauge("blocks.processingQueue.depth", nDepth, 0.1f);
+            ProcessPendingBlock(*entry);
+            entry->pfrom->Release();
+        }
+    }
+
+public:
+    void Start()
+    {
+        std::lock_guard<std::mutex> lock(state->cs);
+        if (!state->fStopped) {
+            return;
+        }
+        state->fStopped = false;
+        thread = std::thread(&CBlockProcessingQueue::Thread, this);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(state->cs);
+            state->fStopped = true;
+        }
+        state->condQueue.notify_all();
+        state->condSpace.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        std::vector<uint256> vDropped;
+        {
+            std::lock_guard<std::mutex> lock(state->cs);
+            for (auto& p : state->queue) {
+                vDropped.emplace_back(p.second->hash);
+                p.second->pfrom->Release();
+            }
+            state->queue.clear();
+        }
+        LOCK(cs_main);
+        for (const uint256& hash : vDropped) {
+            setBlocksQueuedForProcessing.erase(hash);
+            mapBlockSource.erase(hash);
+        }
+    }
+
+    /**
+     * Queue a requested block at nHeight and start its checks, which takes vRecv. Returns false if the queue isn't
+     * running and the caller has to process the block itself.
+     */
+    bool Push(CNode* pfrom, const uint256& hash, int nHeight, CDataStream& vRecv)
+    {
+        std::unique_lock<std::mutex> lock(state->cs);
+        state->condSpace.wait(lock, [this] { return state->fStopped || state->queue.size() < MAX_BLOCK_PROCESSING_QUEUE_SIZE; });
+        if (state->fStopped) {
+            return false;
+        }
+        pfrom->AddRef();
+        auto entry = std::make_shared<PendingBlock>(pfrom, hash, std::move(vRecv));
+        state->queue.emplace(nHeight, entry);
+        lock.unlock();
+        auto s = state;
+        GetExecutor().Push(ExecutorPriority::CONSENSUS, [s, entry](int) { CheckPendingBlock(s, entry); });
+        return true;
+    }
+};
+
+CBlockProcessingQueue blockProcessingQueue;
+} // anon namespace
+
+void PeerLogicValidation::StopBlockProcessingThread()
+{
+    blockProcessingQueue.Stop();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // blockchain -> download logic notification
@@ -1121,7 +1600,16 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
     // combine them in one function and schedule at the quicker (peer-eviction)
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
-    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000, "stalecheck");
+
+    llmqMessageQueue.Start();
+    blockProcessingQueue.Start();
+}
+
+PeerLogicValidation::~PeerLogicValidation()
+{
+    StopLLMQMessageThread();
+    StopBlockProcessingThread();
 }
 
 /**
@@ -1131,39 +1619,16 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
 void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     LOCK2(cs_main, g_cs_orphans);
 
-    std::vector<uint256> vOrphanErase;
+    // Which orphan pool entries we should reprocess and potentially try to accept into mempool again?
     std::set<uint256> orphanWorkSet;
-
     for (const CTransactionRef& ptx : pblock->vtx) {
-        const CTransaction& tx = *ptx;
-
-        // Which orphan pool entries we should reprocess and potentially try to accept into mempool again?
-        for (size_t i = 0; i < tx.vin.size(); i++) {
-            auto itByPrev = mapOrphanTransactionsByPrev.find(COutPoint(tx.GetHash(), (uint32_t)i));
-            if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
-            for (const auto& elem : itByPrev->second) {
-                orphanWorkSet.insert(elem->first);
-            }
-        }
-
-        // Which orphan pool entries must we evict?
-        for (const auto& txin : tx.vin) {
-            auto itByPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
-            if (itByPrev == mapOrphanTransactionsByPrev.end()) continue;
-            for (auto mi = itByPrev->second.begin(); mi != itByPrev->second.end(); ++mi) {
-                const CTransaction& orphanTx = *(*mi)->second.tx;
-                const uint256& orphanHash = orphanTx.GetHash();
-                vOrphanErase.push_back(orphanHash);
-            }
-        }
+        g_orphanage.AddChildrenToWorkSet(*ptx, orphanWorkSet);
     }
 
     // Erase orphan transactions included or precluded by this block
-    if (vOrphanErase.size()) {
-        int nErased = 0;
-        for (uint256 &orphanHash : vOrphanErase) {
-            nErased += EraseOrphanTx(orphanHash);
-        }
+    int nErased = g_orphanage.EraseForBlock(*pblock);
+    UpdateOrphanStats(nErased);
+    if (nErased > 0) {
         LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx included or conflicted by block\n", nErased);
     }
 
@@ -1181,6 +1646,17 @@ static std::shared_ptr<const CBlock> most_recent_block GUARDED_BY(cs_most_recent
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs> most_recent_compact_block GUARDED_BY(cs_most_recent_block);
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
 
+/** Number of serialized blocks kept by the raw block relay path */
+static const size_t MAX_RECENT_RAW_BLOCKS = 8;
+/** Serialized blocks recently served to peers, so repeated requests for the same blocks don't hit the disk */
+static CCriticalSection cs_recent_raw_blocks;
+static unordered_lru_cache<uint256, std::shared_ptr<const std::vector<unsigned char>>, StaticSaltedHasher, MAX_RECENT_RAW_BLOCKS, MAX_RECENT_RAW_BLOCKS> recent_raw_blocks GUARDED_BY(cs_recent_raw_blocks);
+/** Number of blocks for which the bloom filter data elements are kept */
+static const size_t MAX_RECENT_BLOOM_ELEMENTS = 8;
+/** Data elements of blocks recently served filtered, so SPV peers syncing the same blocks share the work of extracting them */
+static CCriticalSection cs_recent_bloom_elements;
+static unordered_lru_cache<uint256, std::shared_ptr<const CBloomBlockElements>, StaticSaltedHasher, MAX_RECENT_BLOOM_ELEMENTS, MAX_RECENT_BLOOM_ELEMENTS> recent_bloom_elements GUARDED_BY(cs_recent_bloom_elements);
+
 /**
  * Maintain state about the best-seen block and fast-announce a compact block
  * to compatible peers.
@@ -1328,7 +1804,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 
             {
                 LOCK(g_cs_orphans);
-                if (mapOrphanTransactions.count(inv.hash)) return true;
+                if (g_orphanage.HaveTx(inv.hash)) return true;
             }
 
             // When we receive an islock for a previously rejected transaction, we have to
@@ -1502,6 +1978,26 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
         std::shared_ptr<const CBlock> pblock;
         if (a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (inv.type == MSG_BLOCK) {
+            // Fast-path: the network format of a block matches the on-disk format, so hand the
+            // serialized bytes to the peer without deserializing and reserializing them
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::BLOCK;
+            std::shared_ptr<const std::vector<unsigned char>> raw_block;
+            {
+                LOCK(cs_recent_raw_blocks);
+                recent_raw_blocks.get(pindex->GetBlockHash(), raw_block);
+            }
+            if (raw_block) {
+                msg.data = *raw_block;
+            } else {
+                if (!ReadRawBlockFromDisk(msg.data, pindex, chainparams.MessageStart()))
+                    assert(!"cannot load block from disk");
+                LOCK(cs_recent_raw_blocks);
+                recent_raw_blocks.insert(pindex->GetBlockHash(), std::make_shared<const std::vector<unsigned char>>(msg.data));
+            }
+            connman->PushMessage(pfrom, std::move(msg));
+            // Don't set pblock as we've sent the block
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1515,11 +2011,28 @@ void static ProcessGetBlockData(CNode* pfrom, const CChainParams& chainparams, c
             else if (inv.type == MSG_FILTERED_BLOCK) {
                 bool sendMerkleBlock = false;
                 CMerkleBlock merkleBlock;
+                bool fHasFilter;
+                {
+                    LOCK(pfrom->cs_filter);
+                    fHasFilter = pfrom->pfilter != nullptr;
+                }
+                std::shared_ptr<const CBloomBlockElements> elements;
+                if (fHasFilter) {
+                    {
+                        LOCK(cs_recent_bloom_elements);
+                        recent_bloom_elements.get(pindex->GetBlockHash(), elements);
+                    }
+                    if (!elements) {
+                        elements = std::make_shared<const CBloomBlockElements>(*pblock);
+                        LOCK(cs_recent_bloom_elements);
+                        recent_bloom_elements.insert(pindex->GetBlockHash(), elements);
+                    }
+                }
                 {
                     LOCK(pfrom->cs_filter);
                     if (pfrom->pfilter) {
                         sendMerkleBlock = true;
-                        merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
+                        merkleBlock = elements ? CMerkleBlock(*pblock, *pfrom->pfilter, *elements) : CMerkleBlock(*pblock, *pfrom->pfilter);
                     }
                 }
                 if (sendMerkleBlock) {
@@ -1683,30 +2196,30 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
             }
 
             if (!push && (inv.type == MSG_QUORUM_CONTRIB)) {
-                llmq::CDKGContribution o;
+                std::shared_ptr<const llmq::CDKGContribution> o;
                 if (llmq::quorumDKGSessionManager->GetContribution(inv.hash, o)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QCONTRIB, o));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QCONTRIB, *o));
                     push = true;
                 }
             }
             if (!push && (inv.type == MSG_QUORUM_COMPLAINT)) {
-                llmq::CDKGComplaint o;
+                std::shared_ptr<const llmq::CDKGComplaint> o;
                 if (llmq::quorumDKGSessionManager->GetComplaint(inv.hash, o)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QCOMPLAINT, o));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QCOMPLAINT, *o));
                     push = true;
                 }
             }
             if (!push && (inv.type == MSG_QUORUM_JUSTIFICATION)) {
-                llmq::CDKGJustification o;
+                std::shared_ptr<const llmq::CDKGJustification> o;
                 if (llmq::quorumDKGSessionManager->GetJustification(inv.hash, o)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QJUSTIFICATION, o));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QJUSTIFICATION, *o));
                     push = true;
                 }
             }
             if (!push && (inv.type == MSG_QUORUM_PREMATURE_COMMITMENT)) {
-                llmq::CDKGPrematureCommitment o;
+                std::shared_ptr<const llmq::CDKGPrematureCommitment> o;
                 if (llmq::quorumDKGSessionManager->GetPrematureCommitment(inv.hash, o)) {
-                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QPCOMMITMENT, o));
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::QPCOMMITMENT, *o));
                     push = true;
                 }
             }
@@ -1783,6 +2296,180 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCKTXN, resp));
 }
 
+/**
+ * Validates a request for block filters (getcfilters, getcfheaders or getcfcheckpt) and finds the stop block.
+ * Peers sending invalid requests are disconnected.
+ *
+ * @param[in]   pfrom           The peer that we received the request from
+ * @param[in]   chain_params    Chain parameters
+ * @param[in]   filter_type     The filter type the request is for. Must be basic filters.
+ * @param[in]   start_height    The start height for the request
+ * @param[in]   stop_hash       The stop_hash for the request
+ * @param[in]   max_height_diff The maximum number of items permitted to request, as specified in BIP 157
+ * @param[out]  stop_index      The CBlockIndex for the stop_hash block, if the request can be serviced.
+ * @return                      True if the request can be serviced.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, const CChainParams& chain_params,
+                                      BlockFilterType filter_type, uint32_t start_height,
+                                      const uint256& stop_hash, uint32_t max_height_diff,
+                                      const CBlockIndex*& stop_index)
+{
+    const bool supported_filter_type =
+        (filter_type == BlockFilterType::BASIC_FILTER &&
+         (pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) &&
+         g_blockfilterindex);
+    if (!supported_filter_type) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n",
+                 pfrom->GetId(), static_cast<uint8_t>(filter_type));
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        stop_index = LookupBlockIndex(stop_hash);
+
+        // Check that the stop block exists and the peer would be allowed to fetch it.
+        if (!stop_index || !BlockRequestAllowed(stop_index, chain_params.GetConsensus())) {
+            LogPrint(BCLog::NET, "peer %d requested invalid block hash: %s\n",
+                     pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with "
+                 "start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Handle a cfilters request. The filters are read from the block filter index, which is updated in the background,
+ * so requests for blocks it did not reach yet are ignored.
+ */
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params, CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, start_height, stop_hash,
+                                   MAX_GETCFILTERS_SIZE, stop_index)) {
+        return;
+    }
+
+    std::vector<BlockFilter> filters;
+    if (!g_blockfilterindex->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const auto& filter : filters) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+/** Handle a cfheaders request, see ProcessGetCFilters */
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params, CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, start_height, stop_hash,
+                                   MAX_GETCFHEADERS_SIZE, stop_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block = stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!g_blockfilterindex->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!g_blockfilterindex->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(filter_type), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS,
+                         filter_type_ser,
+                         stop_index->GetBlockHash(),
+                         prev_header,
+                         filter_hashes));
+}
+
+/** Handle a getcfcheckpt request, see ProcessGetCFilters */
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv, const CChainParams& chain_params, CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> stop_hash;
+
+    const BlockFilterType filter_type = static_cast<BlockFilterType>(filter_type_ser);
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, chain_params, filter_type, /*start_height=*/0, stop_hash,
+                                   /*max_height_diff=*/std::numeric_limits<uint32_t>::max(),
+                                   stop_index)) {
+        return;
+    }
+
+    std::vector<uint256> headers(stop_index->nHeight / CFCHECKPT_INTERVAL);
+
+    // Populate headers.
+    const CBlockIndex* block_index = stop_index;
+    for (int i = headers.size() - 1; i >= 0; i--) {
+        int height = (i + 1) * CFCHECKPT_INTERVAL;
+        block_index = block_index->GetAncestor(height);
+
+        if (!g_blockfilterindex->LookupFilterHeader(block_index, headers[i])) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(filter_type), block_index->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT,
+                         filter_type_ser,
+                         stop_index->GetBlockHash(),
+                         headers));
+}
+
 bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, bool punish_duplicate_invalid)
 {
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1795,6 +2482,8 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
 
     bool received_new_header = false;
     const CBlockIndex *pindexLast = nullptr;
+    // Hash all headers once up front and outside of cs_main, the hashes are reused by ProcessNewBlockHeaders
+    const std::vector<uint256> header_hashes = GetBlockHeaderHashesParallel(headers);
     {
         LOCK(cs_main);
         CNodeState *nodestate = State(pfrom->GetId());
@@ -1811,14 +2500,14 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
             nodestate->nUnconnectingHeaders++;
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), uint256()));
             LogPrint(BCLog::NET, "received header %s: missing prev block %s, sending getheaders (%d) to end (peer=%d, nUnconnectingHeaders=%d)\n",
-                    headers[0].GetHash().ToString(),
+                    header_hashes[0].ToString(),
                     headers[0].hashPrevBlock.ToString(),
                     pindexBestHeader->nHeight,
                     pfrom->GetId(), nodestate->nUnconnectingHeaders);
             // Set hashLastUnknownBlock for this peer, so that if we
             // eventually get the headers - even from a different peer -
             // we can use this peer to download.
-            UpdateBlockAvailability(pfrom->GetId(), headers.back().GetHash());
+            UpdateBlockAvailability(pfrom->GetId(), header_hashes.back());
 
             if (nodestate->nUnconnectingHeaders % MAX_UNCONNECTING_HEADERS == 0) {
                 Misbehaving(pfrom->GetId(), 20);
@@ -1827,12 +2516,12 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         }
 
         uint256 hashLastBlock;
-        for (const CBlockHeader& header : headers) {
-            if (!hashLastBlock.IsNull() && header.hashPrevBlock != hashLastBlock) {
+        for (size_t i = 0; i < headers.size(); ++i) {
+            if (!hashLastBlock.IsNull() && headers[i].hashPrevBlock != hashLastBlock) {
                 Misbehaving(pfrom->GetId(), 20, "non-continuous headers sequence");
                 return false;
             }
-            hashLastBlock = header.GetHash();
+            hashLastBlock = header_hashes[i];
         }
 
         // If we don't have the last header, then they'll have given us
@@ -1844,7 +2533,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
 
     CValidationState state;
     CBlockHeader first_invalid_header;
-    if (!ProcessNewBlockHeaders(headers, state, chainparams, &pindexLast, &first_invalid_header)) {
+    if (!ProcessNewBlockHeaders(headers, state, chainparams, &pindexLast, &first_invalid_header, &header_hashes)) {
         int nDoS;
         if (state.IsInvalid(nDoS)) {
             LOCK(cs_main);
@@ -1924,10 +2613,12 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         if (fCanDirectFetch && pindexLast->IsValid(BLOCK_VALID_TREE) && chainActive.Tip()->nChainWork <= pindexLast->nChainWork) {
             std::vector<const CBlockIndex*> vToFetch;
             const CBlockIndex *pindexWalk = pindexLast;
+            const int nWindow = GetBlockDownloadWindow(pfrom, nodestate);
             // Calculate all the blocks we'd need to switch to pindexLast, up to a limit.
-            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            while (pindexWalk && !chainActive.Contains(pindexWalk) && vToFetch.size() <= (size_t)std::max(nWindow, MAX_BLOCKS_IN_TRANSIT_PER_PEER)) {
                 if (!(pindexWalk->nStatus & BLOCK_HAVE_DATA) &&
-                        !mapBlocksInFlight.count(pindexWalk->GetBlockHash())) {
+                        !mapBlocksInFlight.count(pindexWalk->GetBlockHash()) &&
+                        !setBlocksQueuedForProcessing.count(pindexWalk->GetBlockHash())) {
                     // We don't have this block, and it's not yet in flight.
                     vToFetch.push_back(pindexWalk);
                 }
@@ -1945,7 +2636,7 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
                 std::vector<CInv> vGetData;
                 // Download as much as possible, from earliest to latest.
                 for (const CBlockIndex *pindex : reverse_iterate(vToFetch)) {
-                    if (nodestate->nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                    if (nodestate->nBlocksInFlight >= nWindow) {
                         // Can't download any more from this peer
                         break;
                     }
@@ -2007,17 +2698,19 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
     AssertLockHeld(cs_main);
     AssertLockHeld(g_cs_orphans);
     std::set<NodeId> setMisbehaving;
-    bool done = false;
-    while (!done && !orphan_work_set.empty()) {
+    // A chain of orphans, like the ones of CoinJoin and InstantSend bursts, is processed in batches instead of one
+    // orphan per call
+    int nProcessed = 0;
+    while (nProcessed < ORPHAN_TX_PROCESS_BATCH && !orphan_work_set.empty()) {
         const uint256 orphanHash = *orphan_work_set.begin();
         orphan_work_set.erase(orphan_work_set.begin());
 
-        auto orphan_it = mapOrphanTransactions.find(orphanHash);
-        if (orphan_it == mapOrphanTransactions.end()) continue;
+        const COrphanTx* orphan = g_orphanage.GetTx(orphanHash);
+        if (orphan == nullptr) continue;
 
-        const CTransactionRef porphanTx = orphan_it->second.tx;
+        const CTransactionRef porphanTx = orphan->tx;
         const CTransaction& orphanTx = *porphanTx;
-        NodeId fromPeer = orphan_it->second.fromPeer;
+        NodeId fromPeer = orphan->fromPeer;
         bool fMissingInputs2 = false;
         // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
         // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
@@ -2029,16 +2722,9 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
                 false /* bypass_limits */, 0 /* nAbsurdFee */)) {
             LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
             connman->RelayTransaction(orphanTx);
-            for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(orphanHash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
+            g_orphanage.AddChildrenToWorkSet(orphanTx, orphan_work_set);
             EraseOrphanTx(orphanHash);
-            done = true;
+            nProcessed++;
         } else if (!fMissingInputs2) {
             int nDos = 0;
             if (stateDummy.IsInvalid(nDos) && nDos > 0) {
@@ -2055,7 +2741,7 @@ void static ProcessOrphanTx(CConnman* connman, std::set<uint256>& orphan_work_se
                 recentRejects->insert(orphanHash);
             }
             EraseOrphanTx(orphanHash);
-            done = true;
+            nProcessed++;
         }
         mempool.check(pcoinsTip.get());
     }
@@ -2410,6 +3096,12 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
     }
 
+    // LLMQ signing traffic makes up most of the messages on masternodes. Its handlers only take their
+    // own locks, so process it on the LLMQ message thread instead of walking the dispatch chain below.
+    if (CLLMQMessageQueue::IsLaneMessage(strCommand) && llmqMessageQueue.Push(pfrom, strCommand, std::move(vRecv))) {
+        return true;
+    }
+
     if (strCommand == NetMsgType::ADDR) {
         std::vector<CAddress> vAddr;
         vRecv >> vAddr;
@@ -2572,7 +3264,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 } else if (!fAlreadyHave) {
                     bool allowWhileInIBD = allowWhileInIBDObjs.count(inv.type);
                     if (allowWhileInIBD || (!fImporting && !fReindex && !IsInitialBlockDownload())) {
-                        RequestObject(State(pfrom->GetId()), inv, current_time);
+                        RequestObject(pfrom->GetId(), inv, current_time);
                     }
                 }
             }
@@ -2720,6 +3412,21 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         return true;
     }
 
+    if (strCommand == NetMsgType::GETCFILTERS) {
+        ProcessGetCFilters(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFHEADERS) {
+        ProcessGetCFHeaders(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
+    if (strCommand == NetMsgType::GETCFCHECKPT) {
+        ProcessGetCFCheckPt(pfrom, vRecv, chainparams, connman);
+        return true;
+    }
+
     if (strCommand == NetMsgType::GETHEADERS) {
         CBlockLocator locator;
         uint256 hashStop;
@@ -2760,10 +3467,29 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 pindex = chainActive.Next(pindex);
         }
 
+        LogPrint(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), pfrom->GetId());
+        if (pindex && chainActive.Contains(pindex) && g_headers_cache.Sync(chainActive)) {
+            // Slice the range out of the serialized headers of the active chain
+            int nStart = pindex->nHeight;
+            int nEnd = std::min(chainActive.Height(), nStart + (int)MAX_HEADERS_RESULTS - 1);
+            const CBlockIndex* pindexStop = hashStop.IsNull() ? nullptr : LookupBlockIndex(hashStop);
+            if (pindexStop && pindexStop->nHeight >= nStart && pindexStop->nHeight < nEnd && chainActive.Contains(pindexStop)) {
+                nEnd = pindexStop->nHeight;
+            }
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::HEADERS;
+            msg.data = g_send_buffer_pool.Get(9 + (nEnd - nStart + 1) * (CHeadersCache::HEADER_SIZE + 1));
+            CVectorWriter writer(SER_NETWORK, PROTOCOL_VERSION, msg.data, 0);
+            g_headers_cache.WriteHeadersMessage(writer, nStart, nEnd - nStart + 1);
+            // See below for why this is reset rather than maxed
+            nodestate->pindexBestHeaderSent = chainActive[nEnd];
+            connman->PushMessage(pfrom, std::move(msg));
+            return true;
+        }
+
         // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
         std::vector<CBlock> vHeaders;
         int nLimit = MAX_HEADERS_RESULTS;
-        LogPrint(BCLog::NET, "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.IsNull() ? "end" : hashStop.ToString(), pfrom->GetId());
         for (; pindex; pindex = chainActive.Next(pindex))
         {
             vHeaders.push_back(pindex->GetBlockHeader());
@@ -2885,14 +3611,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             mempool.check(pcoinsTip.get());
             connman->RelayTransaction(tx);
 
-            for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                auto it_by_prev = mapOrphanTransactionsByPrev.find(COutPoint(inv.hash, i));
-                if (it_by_prev != mapOrphanTransactionsByPrev.end()) {
-                    for (const auto& elem : it_by_prev->second) {
-                        pfrom->orphan_work_set.insert(elem->first);
-                    }
-                }
-            }
+            g_orphanage.AddChildrenToWorkSet(tx, pfrom->orphan_work_set);
 
             pfrom->nLastTXTime = GetTime();
 
@@ -2919,17 +3638,18 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 for (const CTxIn& txin : tx.vin) {
                     CInv _inv(MSG_TX, txin.prevout.hash);
                     pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) RequestObject(State(pfrom->GetId()), _inv, current_time);
+                    if (!AlreadyHave(_inv)) RequestObject(pfrom->GetId(), _inv, current_time);
                     // We don't know if the previous tx was a regular or a mixing one, try both
                     CInv _inv2(MSG_DSTX, txin.prevout.hash);
                     pfrom->AddInventoryKnown(_inv2);
-                    if (!AlreadyHave(_inv2)) RequestObject(State(pfrom->GetId()), _inv2, current_time);
+                    if (!AlreadyHave(_inv2)) RequestObject(pfrom->GetId(), _inv2, current_time);
                 }
                 AddOrphanTx(ptx, pfrom->GetId());
 
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+                // DoS prevention: do not allow g_orphanage to grow unbounded, nor a single peer to take all of it
                 unsigned int nMaxOrphanTxSize = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000000;
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTxSize);
+                unsigned int nEvicted = LimitOrphanTxPeerSize(pfrom->GetId(), nMaxOrphanTxSize / ORPHAN_TX_PEER_SHARE_DIVISOR);
+                nEvicted += LimitOrphanTxSize(nMaxOrphanTxSize);
                 if (nEvicted > 0) {
                     LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
                 }
@@ -3039,6 +3759,9 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         bool fBlockReconstructed = false;
 
+        // Collected before taking cs_main, so that the InstantSend and CoinJoin locks are not taken while holding it
+        const std::vector<std::pair<uint256, CTransactionRef>> vDashTxnForCompact = GetDashTxnForCompact();
+
         {
         LOCK2(cs_main, g_cs_orphans);
         // If AcceptBlockHeader returned true, it set pindex
@@ -3092,12 +3815,14 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 }
 
                 PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
-                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact, vDashTxnForCompact);
                 if (status == READ_STATUS_INVALID) {
                     MarkBlockAsReceived(pindex->GetBlockHash()); // Reset in-flight state in case of whitelist
                     Misbehaving(pfrom->GetId(), 100, strprintf("Peer %d sent us invalid compact block", pfrom->GetId()));
                     return true;
                 } else if (status == READ_STATUS_FAILED) {
+                    compactBlockReconstructionStats.nBlocks++;
+                    compactBlockReconstructionStats.nFailed++;
                     // Duplicate txindexes, the block is now in-flight, so just request it
                     std::vector<CInv> vInv(1);
                     vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
@@ -3110,6 +3835,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     if (!partialBlock.IsTxAvailable(i))
                         req.indexes.push_back(i);
                 }
+                UpdateCompactBlockReconstructionStats(partialBlock, !req.indexes.empty());
                 if (req.indexes.empty()) {
                     // Dirty hack to jump to BLOCKTXN code (TODO: move message handling into their own functions)
                     BlockTransactions txn;
@@ -3127,7 +3853,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 // Optimistically try to reconstruct anyway since we might be
                 // able to without any round trips.
                 PartiallyDownloadedBlock tempBlock(&mempool);
-                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact, vDashTxnForCompact);
                 if (status != READ_STATUS_OK) {
                     // TODO: don't ignore failures
                     return true;
@@ -3135,6 +3861,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 std::vector<CTransactionRef> dummy;
                 status = tempBlock.FillBlock(*pblock, dummy);
                 if (status == READ_STATUS_OK) {
+                    UpdateCompactBlockReconstructionStats(tempBlock, false);
                     fBlockReconstructed = true;
                 }
             }
@@ -3303,18 +4030,48 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
     if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
+        const size_t nBlockBytes = vRecv.size();
+        bool forceProcessing = false;
+
+        // During initial block download the blocks we requested are checked on the executor and connected by the
+        // block processing thread
+        if (IsInitialBlockDownload() && nBlockBytes >= BLOCK_HEADER_SIZE) {
+            CBlockHeader header;
+            CDataStream(vRecv.begin(), vRecv.begin() + BLOCK_HEADER_SIZE, vRecv.GetType(), vRecv.GetVersion()) >> header;
+            const uint256 hash(header.GetHash());
+            int nHeight = -1;
+            {
+                LOCK(cs_main);
+                const CBlockIndex* pindex = LookupBlockIndex(hash);
+                if (pindex != nullptr && mapBlocksInFlight.count(hash)) {
+                    nHeight = pindex->nHeight;
+                    MarkBlockAsReceived(hash, pfrom->GetId(), nBlockBytes);
+                    mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
+                    setBlocksQueuedForProcessing.emplace(hash);
+                }
+            }
+            if (nHeight >= 0) {
+                LogPrint(BCLog::NET, "received block %s peer=%d, queued\n", hash.ToString(), pfrom->GetId());
+                if (blockProcessingQueue.Push(pfrom, hash, nHeight, vRecv)) {
+                    return true;
+                }
+                LOCK(cs_main);
+                setBlocksQueuedForProcessing.erase(hash);
+                forceProcessing = true;
+            }
+        }
+
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
         vRecv >> *pblock;
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
 
-        bool forceProcessing = false;
         const uint256 hash(pblock->GetHash());
         {
             LOCK(cs_main);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
-            forceProcessing |= MarkBlockAsReceived(hash);
+            forceProcessing |= MarkBlockAsReceived(hash, pfrom->GetId(), nBlockBytes);
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
             mapBlockSource.emplace(hash, std::make_pair(pfrom->GetId(), true));
@@ -3511,10 +4268,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         LOCK(cs_main);
 
-        CSimplifiedMNListDiff mnListDiff;
+        CSimplifiedMNListDiffCache::Payload payload;
         std::string strError;
-        if (BuildSimplifiedMNListDiff(cmd.baseBlockHash, cmd.blockHash, mnListDiff, strError)) {
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, mnListDiff));
+        if (mnListDiffCache.GetSerializedDiff(cmd.baseBlockHash, cmd.blockHash, pfrom->GetSendVersion(), payload, strError)) {
+            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNLISTDIFF, MakeSpan(*payload)));
         } else {
             strError = strprintf("getmnlistdiff failed for baseBlockHash=%s, blockHash=%s. error=%s", cmd.baseBlockHash.ToString(), cmd.blockHash.ToString(), strError);
             Misbehaving(pfrom->GetId(), 1, strError);
@@ -3542,14 +4299,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 if (inv.IsKnownType()) {
                     // If we receive a NOTFOUND message for a txid we requested, erase
                     // it from our data structures for this peer.
-                    auto in_flight_it = state->m_object_download.m_object_in_flight.find(inv);
-                    if (in_flight_it == state->m_object_download.m_object_in_flight.end()) {
-                        // Skip any further work if this is a spurious NOTFOUND
-                        // message.
-                        continue;
-                    }
-                    state->m_object_download.m_object_in_flight.erase(in_flight_it);
-                    state->m_object_download.m_object_announced.erase(inv);
+                    // Spurious NOTFOUND messages don't change anything
+                    g_object_requests.ForgetRequest(pfrom->GetId(), inv);
                 }
             }
         }
@@ -3659,6 +4410,10 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     if (pfrom->fPauseSend)
         return false;
 
+    // The messages after MNAUTH may depend on the peer being verified as a masternode
+    if (pfrom->fPendingMNAuth)
+        return false;
+
     std::list<CNetMessage> msgs;
     {
         LOCK(pfrom->cs_vProcessMsg);
@@ -3706,6 +4461,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
 
     // Process message
     bool fRet = false;
+    const int64_t nProcessingStart = GetTimeMicros();
     try
     {
         fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc, m_enable_bip61);
@@ -3741,6 +4497,8 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     } catch (...) {
         PrintExceptionContinue(std::current_exception(), "ProcessMessages()");
     }
+    // Includes the messages whose handler threw, they can be just as expensive
+    connman->RecordMsgProcessing(pfrom, strCommand, GetTimeMicros() - nProcessingStart);
 
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->GetId());
@@ -4222,18 +4980,26 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                 }
             };
 
-            // Respond to BIP35 mempool requests
-            if (fSendTrickle && pto->fSendMempool) {
-                auto vtxinfo = mempool.infoAll();
+            // Respond to BIP35 mempool requests. The TXs are taken once when the request is first served and then
+            // checked against the peer's filter and announced in chunks over the following calls.
+            if (fSendTrickle && pto->fSendMempool && !pto->fMempoolReqInProgress) {
                 pto->fSendMempool = false;
-
+                pto->fMempoolReqInProgress = true;
+                pto->vMempoolReqTxs = mempool.GetAllTxs();
+                pto->nMempoolReqPos = 0;
+                // Allow getdata for all of them, even though the invs only go out over the next calls
+                pto->timeLastMempoolReq = GetTime();
+            }
+            if (pto->fMempoolReqInProgress) {
                 LOCK(pto->cs_filter);
 
                 // Send invs for txes and corresponding IS-locks
-                for (const auto& txinfo : vtxinfo) {
-                    const uint256& hash = txinfo.tx->GetHash();
+                size_t nEnd = std::min(pto->vMempoolReqTxs.size(), pto->nMempoolReqPos + MAX_MEMPOOL_REQ_TXS_PER_SEND);
+                for (; pto->nMempoolReqPos < nEnd; pto->nMempoolReqPos++) {
+                    const CTransactionRef& tx = pto->vMempoolReqTxs[pto->nMempoolReqPos];
+                    const uint256& hash = tx->GetHash();
                     pto->setInventoryTxToSend.erase(hash);
-                    if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
+                    if (pto->pfilter && !pto->pfilter->IsRelevantAndUpdate(*tx)) continue;
 
                     int nInvType = CCoinJoin::GetDSTX(hash) ? MSG_DSTX : MSG_TX;
                     queueAndMaybePushInv(CInv(nInvType, hash));
@@ -4243,14 +5009,19 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                     queueAndMaybePushInv(CInv(MSG_ISLOCK, islockHash));
                 }
 
-                // Send an inv for the best ChainLock we have
-                const auto& clsig = llmq::chainLocksHandler->GetBestChainLock();
-                if (!clsig.IsNull()) {
-                    uint256 chainlockHash = ::SerializeHash(clsig);
-                    queueAndMaybePushInv(CInv(MSG_CLSIG, chainlockHash));
-                }
+                if (pto->nMempoolReqPos == pto->vMempoolReqTxs.size()) {
+                    // Send an inv for the best ChainLock we have
+                    const auto& clsig = llmq::chainLocksHandler->GetBestChainLock();
+                    if (!clsig.IsNull()) {
+                        uint256 chainlockHash = ::SerializeHash(clsig);
+                        queueAndMaybePushInv(CInv(MSG_CLSIG, chainlockHash));
+                    }
 
-                pto->timeLastMempoolReq = GetTime();
+                    pto->fMempoolReqInProgress = false;
+                    pto->vMempoolReqTxs.clear();
+                    pto->vMempoolReqTxs.shrink_to_fit();
+                    pto->nMempoolReqPos = 0;
+                }
             }
 
             // Determine transactions to relay
@@ -4387,10 +5158,12 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && pto->CanRelay() && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        const int nBlockDownloadWindow = GetBlockDownloadWindow(pto, &state);
+        state.m_block_download.nWindow = nBlockDownloadWindow;
+        if (!pto->fClient && pto->CanRelay() && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < nBlockDownloadWindow) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            FindNextBlocksToDownload(pto->GetId(), nBlockDownloadWindow - state.nBlocksInFlight, vToDownload, staller, consensusParams);
             for (const CBlockIndex *pindex : vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), pindex);
@@ -4415,14 +5188,8 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Eventually we should consider disconnecting peers, but this is
         // conservative.
         if (state.m_object_download.m_check_expiry_timer <= current_time) {
-            for (auto it=state.m_object_download.m_object_in_flight.begin(); it != state.m_object_download.m_object_in_flight.end();) {
-                if (it->second <= current_time - GetObjectExpiryInterval(it->first.type)) {
-                    LogPrint(BCLog::NET, "timeout of inflight object %s from peer=%d\n", it->first.ToString(), pto->GetId());
-                    state.m_object_download.m_object_announced.erase(it->first);
-                    state.m_object_download.m_object_in_flight.erase(it++);
-                } else {
-                    ++it;
-                }
+            for (const CInv& inv : g_object_requests.ExpireRequests(pto->GetId(), current_time, GetObjectExpiryInterval)) {
+                LogPrint(BCLog::NET, "timeout of inflight object %s from peer=%d\n", inv.ToString(), pto->GetId());
             }
             // On average, we do this check every GetObjectExpiryInterval. Randomize
             // so that we're not doing this for all peers at the same time.
@@ -4430,16 +5197,11 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         }
 
         // DASH this code also handles non-TXs (Dash specific messages)
-        auto& object_process_time = state.m_object_download.m_object_process_time;
-        while (!object_process_time.empty() && object_process_time.begin()->first <= current_time && state.m_object_download.m_object_in_flight.size() < MAX_PEER_OBJECT_IN_FLIGHT) {
-            const CInv inv = object_process_time.begin()->second;
-            // Erase this entry from object_process_time (it may be added back for
-            // processing at a later time, see below)
-            object_process_time.erase(object_process_time.begin());
+        CInv inv;
+        while (g_object_requests.CountInFlight(pto->GetId()) < MAX_PEER_OBJECT_IN_FLIGHT && g_object_requests.GetNextDue(pto->GetId(), current_time, inv)) {
             if (g_erased_object_requests.count(inv.hash)) {
                 LogPrint(BCLog::NET, "%s -- GETDATA skipping inv=(%s), peer=%d\n", __func__, inv.ToString(), pto->GetId());
-                state.m_object_download.m_object_announced.erase(inv);
-                state.m_object_download.m_object_in_flight.erase(inv);
+                g_object_requests.ForgetAnnouncement(pto->GetId(), inv);
                 continue;
             }
             if (!AlreadyHave(inv)) {
@@ -4453,21 +5215,19 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
                         connman->PushMessage(pto, msgMaker.Make(NetMsgType::GETDATA, vGetData));
                         vGetData.clear();
                     }
-                    UpdateObjectRequestTime(inv.hash, current_time);
-                    state.m_object_download.m_object_in_flight.emplace(inv, current_time);
+                    g_object_requests.RequestedObject(pto->GetId(), inv, current_time);
                 } else {
                     // This object is in flight from someone else; queue
                     // up processing to happen after the download times out
                     // (with a slight delay for inbound peers, to prefer
                     // requests to outbound peers).
                     const auto next_process_time = CalculateObjectGetDataTime(inv, current_time, !state.fPreferredDownload);
-                    object_process_time.emplace(next_process_time, inv);
+                    g_object_requests.Requeue(pto->GetId(), inv, next_process_time);
                     LogPrint(BCLog::NET, "%s -- GETDATA re-queue inv=(%s), next_process_time=%d, delta=%d, peer=%d\n", __func__, inv.ToString(), next_process_time.count(), (next_process_time - current_time).count(), pto->GetId());
                 }
             } else {
                 // We have already seen this object, no need to download.
-                state.m_object_download.m_object_announced.erase(inv);
-                state.m_object_download.m_object_in_flight.erase(inv);
+                g_object_requests.ForgetAnnouncement(pto->GetId(), inv);
                 LogPrint(BCLog::NET, "%s -- GETDATA already seen inv=(%s), peer=%d\n", __func__, inv.ToString(), pto->GetId());
             }
         }
@@ -4488,8 +5248,7 @@ public:
     CNetProcessingCleanup() {}
     ~CNetProcessingCleanup() {
         // orphan transactions
-        mapOrphanTransactions.clear();
-        mapOrphanTransactionsByPrev.clear();
-        nMapOrphanTransactionsSize = 0;
+        LOCK(g_cs_orphans);
+        g_orphanage.Clear();
     }
 } instance_of_cnetprocessingcleanup;
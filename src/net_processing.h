@@ -18,6 +18,10 @@ extern CCriticalSection cs_main;
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE = 10; // this allows around 100 TXs of max size (and many more of normal size)
 /** Default number of orphan+recently-replaced txn to keep around for block reconstruction */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
+/** Default for -cmpctblockprefermasternodes, whether verified masternode peers are preferred as high-bandwidth compact block peers */
+static const bool DEFAULT_CMPCTBLOCK_PREFER_MASTERNODES = false;
+/** Default for -adaptiveblockdownload, whether the number of blocks in flight from a peer follows its measured throughput */
+static const bool DEFAULT_ADAPTIVE_BLOCK_DOWNLOAD = true;
 /** Default for BIP61 (sending reject messages) */
 static constexpr bool DEFAULT_ENABLE_BIP61 = true;
 
@@ -27,6 +31,12 @@ private:
 
 public:
     explicit PeerLogicValidation(CConnman* connmanIn, CScheduler &scheduler, bool enable_bip61);
+    ~PeerLogicValidation();
+
+    /** Stop processing queued LLMQ messages, has to happen before the nodes are deleted */
+    void StopLLMQMessageThread();
+    /** Stop processing the blocks queued during initial block download, has to happen before the LLMQ system is stopped */
+    void StopBlockProcessingThread();
 
     /**
      * Overridden from CValidationInterface.
@@ -83,10 +93,40 @@ struct CNodeStateStats {
     int nSyncHeight = -1;
     int nCommonHeight = -1;
     std::vector<int> vHeightInFlight;
+    //! Average delay (in microseconds) of this peer's new block announcements behind the first one we saw, -1 if unknown
+    int64_t nBlockAnnounceDelay = -1;
+    //! Moving average of the download speed of the blocks requested from this peer, -1 if unknown
+    int64_t nBlockDownloadBytesPerSecond = -1;
+    uint64_t nBlocksDownloaded = 0;
+    uint64_t nBlockBytesDownloaded = 0;
+    //! Blocks requested from this peer which were requested from faster peers instead
+    uint64_t nBlocksReassigned = 0;
+    //! Number of blocks this peer may have in flight
+    int nBlockDownloadWindow = 0;
 };
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
+
+struct CCompactBlockReconstructionStats {
+    /** Compact blocks for which a reconstruction was attempted */
+    uint64_t nBlocks = 0;
+    /** Blocks reconstructed without any further round trip */
+    uint64_t nReconstructed = 0;
+    /** Blocks for which missing transactions had to be requested via getblocktxn */
+    uint64_t nRoundTrips = 0;
+    /** Blocks for which the compact block couldn't be used and the full block was requested */
+    uint64_t nFailed = 0;
+    /** Blocks reconstructed without round trip only thanks to transactions known to InstantSend or CoinJoin */
+    uint64_t nRoundTripsSaved = 0;
+    /** Transactions taken from the given source, added up over all blocks */
+    uint64_t nTxPrefilled = 0;
+    uint64_t nTxMempool = 0;
+    uint64_t nTxExtra = 0;
+    uint64_t nTxDash = 0;
+};
+
+CCompactBlockReconstructionStats GetCompactBlockReconstructionStats();
 bool IsBanned(NodeId nodeid);
 
 // Upstream moved this into net_processing.cpp (13417), however since we use Misbehaving in a number of dash specific
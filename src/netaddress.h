@@ -156,6 +156,7 @@ class CNetAddr
         }
 
         friend class CSubNet;
+        friend class CBanIndex;
 };
 
 class CSubNet
@@ -185,6 +186,8 @@ class CSubNet
         friend bool operator!=(const CSubNet& a, const CSubNet& b) { return !(a == b); }
         friend bool operator<(const CSubNet& a, const CSubNet& b);
 
+        friend class CBanIndex;
+
         ADD_SERIALIZE_METHODS;
 
         template <typename Stream, typename Operation>
@@ -0,0 +1,138 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NETBUFFERPOOL_H
+#define BITCOIN_NETBUFFERPOOL_H
+
+#include <sync.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct CNetBufferPoolStats {
+    uint64_t nHits;
+    uint64_t nMisses;
+    size_t nPooledBuffers;
+    size_t nPooledBytes;
+};
+
+/**
+ * A pool of reusable message buffers, grouped into power of two size classes.
+ *
+ * Buffers are handed out empty but with at least the requested capacity, and are put back once the message they
+ * held has been processed or sent. This avoids a malloc/free pair per network message on the hot paths. Every size
+ * class only keeps a limited number of buffers (roughly MAX_CLASS_BYTES worth of them), everything above that as well
+ * as buffers that are too small or too large to be worth pooling is simply freed.
+ *
+ * Buffer can be any std::vector like type providing capacity(), reserve() and clear(). This class is thread safe.
+ */
+template <typename Buffer>
+class CNetBufferPool
+{
+public:
+    static const size_t MIN_CLASS_SHIFT = 8;  // 256 bytes
+    static const size_t MAX_CLASS_SHIFT = 21; // 2 MiB
+    static const size_t MAX_CLASS_BYTES = 1024 * 1024;
+    static const size_t MAX_CLASS_BUFFERS = 64;
+
+private:
+    static const size_t NUM_CLASSES = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+
+    mutable CCriticalSection cs;
+    std::array<std::vector<Buffer>, NUM_CLASSES> vFree GUARDED_BY(cs);
+    size_t nPooledBytes GUARDED_BY(cs){0};
+
+    std::atomic<uint64_t> nHits{0};
+    std::atomic<uint64_t> nMisses{0};
+
+    static size_t ClassSize(size_t nClass)
+    {
+        return (size_t)1 << (nClass + MIN_CLASS_SHIFT);
+    }
+
+    static size_t MaxClassBuffers(size_t nClass)
+    {
+        size_t nMax = MAX_CLASS_BYTES / ClassSize(nClass);
+        if (nMax > MAX_CLASS_BUFFERS) {
+            nMax = MAX_CLASS_BUFFERS;
+        }
+        return nMax != 0 ? nMax : 1;
+    }
+
+public:
+    /** Get an empty buffer with a capacity of at least nMinCapacity bytes */
+    Buffer Get(size_t nMinCapacity)
+    {
+        size_t nClass = 0;
+        while (nClass < NUM_CLASSES && ClassSize(nClass) < nMinCapacity) {
+            nClass++;
+        }
+
+        Buffer buf;
+        if (nClass == NUM_CLASSES) {
+            nMisses++;
+            buf.reserve(nMinCapacity);
+            return buf;
+        }
+
+        {
+            LOCK(cs);
+            auto& v = vFree[nClass];
+            if (!v.empty()) {
+                buf = std::move(v.back());
+                v.pop_back();
+                nPooledBytes -= buf.capacity();
+            }
+        }
+
+        if (buf.capacity() != 0) {
+            nHits++;
+        } else {
+            nMisses++;
+            buf.reserve(ClassSize(nClass));
+        }
+        return buf;
+    }
+
+    /** Return a buffer to the pool. The buffer is left empty */
+    void Put(Buffer&& buf)
+    {
+        // Put the buffer into the largest class it can serve, so that Get() never has to check the capacity
+        const size_t nCapacity = buf.capacity();
+        if (nCapacity < ClassSize(0) || nCapacity >= 2 * ClassSize(NUM_CLASSES - 1)) {
+            return;
+        }
+        size_t nClass = NUM_CLASSES - 1;
+        while (ClassSize(nClass) > nCapacity) {
+            nClass--;
+        }
+
+        buf.clear();
+        LOCK(cs);
+        auto& v = vFree[nClass];
+        if (v.size() < MaxClassBuffers(nClass)) {
+            nPooledBytes += nCapacity;
+            v.emplace_back(std::move(buf));
+        }
+    }
+
+    CNetBufferPoolStats GetStats() const
+    {
+        CNetBufferPoolStats stats;
+        stats.nHits = nHits;
+        stats.nMisses = nMisses;
+        LOCK(cs);
+        stats.nPooledBuffers = 0;
+        for (const auto& v : vFree) {
+            stats.nPooledBuffers += v.size();
+        }
+        stats.nPooledBytes = nPooledBytes;
+        return stats;
+    }
+};
+
+#endif // BITCOIN_NETBUFFERPOOL_H
@@ -13,7 +13,13 @@ void CNetFulfilledRequestManager::AddFulfilledRequest(const CService& addr, cons
 {
     LOCK(cs_mapFulfilledRequests);
     CService addrSquashed = Params().AllowMultiplePorts() ? addr : CService(addr, 0);
-    mapFulfilledRequests[addrSquashed][strRequest] = GetTime() + Params().FulfilledRequestExpireTime();
+    int64_t nExpireTime = GetTime() + Params().FulfilledRequestExpireTime();
+    auto res = mapFulfilledRequests[addrSquashed].emplace(strRequest, nExpireTime);
+    if (!res.second) {
+        setExpiryQueue.erase(std::make_tuple(res.first->second, addrSquashed, strRequest));
+        res.first->second = nExpireTime;
+    }
+    setExpiryQueue.emplace(nExpireTime, addrSquashed, strRequest);
 }
 
 bool CNetFulfilledRequestManager::HasFulfilledRequest(const CService& addr, const std::string& strRequest)
@@ -34,7 +40,14 @@ void CNetFulfilledRequestManager::RemoveFulfilledRequest(const CService& addr, c
     fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addrSquashed);
 
     if (it != mapFulfilledRequests.end()) {
-        it->second.erase(strRequest);
+        auto it_entry = it->second.find(strRequest);
+        if (it_entry != it->second.end()) {
+            setExpiryQueue.erase(std::make_tuple(it_entry->second, addrSquashed, strRequest));
+            it->second.erase(it_entry);
+        }
+        if (it->second.empty()) {
+            mapFulfilledRequests.erase(it);
+        }
     }
 }
 
@@ -45,7 +58,10 @@ void CNetFulfilledRequestManager::RemoveAllFulfilledRequests(const CService& add
     fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addrSquashed);
 
     if (it != mapFulfilledRequests.end()) {
-        mapFulfilledRequests.erase(it++);
+        for (const auto& entry : it->second) {
+            setExpiryQueue.erase(std::make_tuple(entry.second, addrSquashed, entry.first));
+        }
+        mapFulfilledRequests.erase(it);
     }
 }
 
@@ -54,21 +70,27 @@ void CNetFulfilledRequestManager::CheckAndRemove()
     LOCK(cs_mapFulfilledRequests);
 
     int64_t now = GetTime();
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.begin();
-
-    while(it != mapFulfilledRequests.end()) {
-        fulfilledreqmapentry_t::iterator it_entry = it->second.begin();
-        while(it_entry != it->second.end()) {
-            if(now > it_entry->second) {
-                it->second.erase(it_entry++);
-            } else {
-                ++it_entry;
+    auto it = setExpiryQueue.begin();
+    while (it != setExpiryQueue.end() && std::get<0>(*it) < now) {
+        const CService& addr = std::get<1>(*it);
+        auto it_addr = mapFulfilledRequests.find(addr);
+        if (it_addr != mapFulfilledRequests.end()) {
+            it_addr->second.erase(std::get<2>(*it));
+            if (it_addr->second.empty()) {
+                mapFulfilledRequests.erase(it_addr);
             }
         }
-        if(it->second.size() == 0) {
-            mapFulfilledRequests.erase(it++);
-        } else {
-            ++it;
+        it = setExpiryQueue.erase(it);
+    }
+}
+
+void CNetFulfilledRequestManager::RebuildExpiryQueue()
+{
+    AssertLockHeld(cs_mapFulfilledRequests);
+    setExpiryQueue.clear();
+    for (const auto& p : mapFulfilledRequests) {
+        for (const auto& entry : p.second) {
+            setExpiryQueue.emplace(entry.second, p.first, entry.first);
         }
     }
 }
@@ -77,6 +99,7 @@ void CNetFulfilledRequestManager::Clear()
 {
     LOCK(cs_mapFulfilledRequests);
     mapFulfilledRequests.clear();
+    setExpiryQueue.clear();
 }
 
 std::string CNetFulfilledRequestManager::ToString() const
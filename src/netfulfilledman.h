@@ -9,6 +9,9 @@
 #include <serialize.h>
 #include <sync.h>
 
+#include <set>
+#include <tuple>
+
 class CNetFulfilledRequestManager;
 extern CNetFulfilledRequestManager netfulfilledman;
 
@@ -22,9 +25,13 @@ private:
 
     //keep track of what node has/was asked for and when
     fulfilledreqmap_t mapFulfilledRequests;
+    // <expiry time, addr, request> of all entries in mapFulfilledRequests, so that CheckAndRemove only touches the
+    // expired ones
+    std::set<std::tuple<int64_t, CService, std::string>> setExpiryQueue;
     CCriticalSection cs_mapFulfilledRequests;
 
     void RemoveFulfilledRequest(const CService& addr, const std::string& strRequest);
+    void RebuildExpiryQueue();
 
 public:
     CNetFulfilledRequestManager() {}
@@ -35,6 +42,9 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action) {
         LOCK(cs_mapFulfilledRequests);
         READWRITE(mapFulfilledRequests);
+        if (ser_action.ForRead()) {
+            RebuildExpiryQueue();
+        }
     }
 
     void AddFulfilledRequest(const CService& addr, const std::string& strRequest);
@@ -9,16 +9,54 @@
 #include <coins.h>
 #include <chain.h>
 #include <hash.h>
+#include <init.h>
 #include <serialize.h>
+#include <streams.h>
+#include <txdb.h>
 #include <validation.h>
 #include <uint256.h>
 // #include <util/system.h>
 #include <util.h>
 
+#include <ctpl.h>
+
+#include <future>
 #include <map>
+#include <mutex>
 
 #include <boost/thread.hpp>
 
+static const int MAX_UTXO_SCAN_THREADS = 8;
+//! GetUTXOStatsParallel() splits the database into this many ranges of txids, by their first byte
+static const int UTXO_SCAN_RANGES = 16;
+
+uint64_t GetBogoSize(const CScript& scriptPubKey)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + scriptPubKey.size() /* scriptPubKey */;
+}
+
+static void TxOutSer(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    muhash.Insert((const unsigned char*)ss.data(), ss.size());
+}
+
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    TxOutSer(ss, outpoint, coin);
+    muhash.Remove((const unsigned char*)ss.data(), ss.size());
+}
+
 
 static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
@@ -32,47 +70,173 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash,
         ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
         stats.nTransactionOutputs++;
         stats.nTotalAmount += output.second.out.nValue;
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
+        stats.nBogoSize += GetBogoSize(output.second.out.scriptPubKey);
     }
     ss << VARINT(0u);
 }
 
+CCoinsStatsHasher::CCoinsStatsHasher(const uint256& hashBlock) :
+    m_hasher(SER_GETHASH, PROTOCOL_VERSION)
+{
+    m_stats.hashBlock = hashBlock;
+    m_hasher << hashBlock;
+}
+
+bool CCoinsStatsHasher::Add(const COutPoint& outpoint, Coin&& coin)
+{
+    if (!m_outputs.empty() && outpoint.hash != m_prev_hash) {
+        // Coin keys start with the txid, so all outputs of a transaction are next to each other
+        if (outpoint.hash < m_prev_hash) {
+            return false;
+        }
+        ApplyStats(m_stats, m_hasher, m_prev_hash, m_outputs);
+        m_outputs.clear();
+    }
+    m_prev_hash = outpoint.hash;
+    return m_outputs.emplace(outpoint.n, std::move(coin)).second;
+}
+
+void CCoinsStatsHasher::Finish(CCoinsStats& stats)
+{
+    if (!m_outputs.empty()) {
+        ApplyStats(m_stats, m_hasher, m_prev_hash, m_outputs);
+        m_outputs.clear();
+    }
+    m_stats.hashSerialized = m_hasher.GetHash();
+    stats = m_stats;
+}
+
 //! Calculate statistics about the unspent transaction output set
 bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 {
     std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
     assert(pcursor);
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
-    }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
+    CCoinsStatsHasher hasher(pcursor->GetBestBlock());
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         COutPoint key;
         Coin coin;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hash != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
-            }
-            prevkey = key.hash;
-            outputs[key.n] = std::move(coin);
+            hasher.Add(key, std::move(coin));
         } else {
             return error("%s: unable to read value", __func__);
         }
         pcursor->Next();
     }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
+    hasher.Finish(stats);
+    {
+        LOCK(cs_main);
+        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
+    }
+    stats.nDiskSize = view->EstimateSize();
+    return true;
+}
+
+/** Threads that scan the coin database for GetUTXOStatsParallel(), started on first use */
+static ctpl::thread_pool& GetUTXOScanPool()
+{
+    static std::once_flag init;
+    static std::unique_ptr<ctpl::thread_pool> pool;
+    std::call_once(init, [] {
+        pool.reset(new ctpl::thread_pool(std::max(1, std::min(GetNumCores(), MAX_UTXO_SCAN_THREADS))));
+        RenameThreadPool(*pool, "dash-utxoscan");
+    });
+    return *pool;
+}
+
+namespace {
+
+struct RangeStats {
+    CCoinsStats stats;
+    MuHash3072 muhash;
+    bool fOk{false};
+};
+
+} // namespace
+
+/** Scan the coins whose txid starts with a byte in [nBegin, nEnd) */
+static void ScanUTXORange(const CCoinsViewDB* view, const CDBSnapshot& snapshot, int nBegin, int nEnd, bool fMuHash, RangeStats& result)
+{
+    uint256 start;
+    *start.begin() = nBegin;
+    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor(snapshot, start));
+    result.stats.hashBlock = pcursor->GetBestBlock();
+
+    uint256 prevTxid;
+    while (pcursor->Valid()) {
+        if (ShutdownRequested()) {
+            return;
+        }
+        COutPoint key;
+        Coin coin;
+        if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+            error("%s: unable to read value", __func__);
+            return;
+        }
+        if (*key.hash.begin() >= nEnd) {
+            break;
+        }
+        if (result.stats.nTransactionOutputs == 0 || key.hash != prevTxid) {
+            result.stats.nTransactions++;
+            prevTxid = key.hash;
+        }
+        result.stats.nTransactionOutputs++;
+        result.stats.nTotalAmount += coin.out.nValue;
+        result.stats.nBogoSize += GetBogoSize(coin.out.scriptPubKey);
+        if (fMuHash) {
+            ApplyCoinHash(result.muhash, key, coin);
+        }
+        pcursor->Next();
+    }
+    result.fOk = true;
+}
+
+bool GetUTXOStatsParallel(CCoinsViewDB* view, CCoinsStats& stats, bool fMuHash)
+{
+    std::unique_ptr<CDBSnapshot> snapshot;
+    {
+        // Flushes (including the background writes of the coins) only start while holding cs_main
+        LOCK(cs_main);
+        snapshot = view->NewSnapshot();
+    }
+
+    std::vector<RangeStats> results(UTXO_SCAN_RANGES);
+    std::vector<std::future<void> > futures;
+    futures.reserve(UTXO_SCAN_RANGES);
+    for (int i = 0; i < UTXO_SCAN_RANGES; i++) {
+        futures.emplace_back(GetUTXOScanPool().push([&, i](int) {
+            ScanUTXORange(view, *snapshot, i * 256 / UTXO_SCAN_RANGES, (i + 1) * 256 / UTXO_SCAN_RANGES, fMuHash, results[i]);
+        }));
+    }
+    // Wait for all of them before anything is rethrown, they reference our locals
+    for (auto& future : futures) {
+        future.wait();
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    stats = CCoinsStats();
+    stats.hashBlock = results[0].stats.hashBlock;
+    MuHash3072 muhash;
+    for (const auto& result : results) {
+        if (!result.fOk || result.stats.hashBlock.IsNull()) {
+            return false;
+        }
+        stats.nTransactions += result.stats.nTransactions;
+        stats.nTransactionOutputs += result.stats.nTransactionOutputs;
+        stats.nTotalAmount += result.stats.nTotalAmount;
+        stats.nBogoSize += result.stats.nBogoSize;
+        muhash *= result.muhash;
+    }
+    if (fMuHash) {
+        muhash.Finalize(stats.hashMuHash);
+    }
+    {
+        LOCK(cs_main);
+        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
     }
-    stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
     return true;
 }
@@ -7,11 +7,16 @@
 #define BITCOIN_NODE_COINSTATS_H
 
 #include <amount.h>
+#include <coins.h>
+#include <crypto/muhash.h>
+#include <hash.h>
 #include <uint256.h>
 
 #include <cstdint>
+#include <map>
 
 class CCoinsView;
+class CCoinsViewDB;
 
 struct CCoinsStats
 {
@@ -21,13 +26,48 @@ struct CCoinsStats
     uint64_t nTransactionOutputs;
     uint64_t nBogoSize;
     uint256 hashSerialized;
+    //! MuHash3072 of the coins, see ApplyCoinHash()
+    uint256 hashMuHash;
     uint64_t nDiskSize;
     CAmount nTotalAmount;
 
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
 };
 
+/**
+ * Calculates the statistics of GetUTXOStats() (except the height and disk size) from coins that are added one by one,
+ * in the order of the coin database. Used to verify UTXO snapshots before they are written to the chainstate.
+ */
+class CCoinsStatsHasher
+{
+public:
+    explicit CCoinsStatsHasher(const uint256& hashBlock);
+
+    /** Returns false if the coin is out of the order of the coin database or was added already */
+    bool Add(const COutPoint& outpoint, Coin&& coin);
+    void Finish(CCoinsStats& stats);
+
+private:
+    CHashWriter m_hasher;
+    CCoinsStats m_stats;
+    uint256 m_prev_hash;
+    std::map<uint32_t, Coin> m_outputs;
+};
+
 //! Calculate statistics about the unspent transaction output set
 bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats);
 
+/**
+ * Calculate the statistics of GetUTXOStats() but hashSerialized, scanning parts of the database concurrently. As
+ * the parts are hashed with MuHash3072 (if fMuHash), their hashes can simply be combined into hashMuHash.
+ */
+bool GetUTXOStatsParallel(CCoinsViewDB* view, CCoinsStats& stats, bool fMuHash);
+
+//! The share of a coin in nBogoSize
+uint64_t GetBogoSize(const CScript& scriptPubKey);
+
+//! Add a coin to (or remove it from) a MuHash3072 of the UTXO set, it hashes outpoint, height, coinbase flag and output
+void ApplyCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+void RemoveCoinHash(MuHash3072& muhash, const COutPoint& outpoint, const Coin& coin);
+
 #endif // BITCOIN_NODE_COINSTATS_H
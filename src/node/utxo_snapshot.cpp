@@ -0,0 +1,366 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <node/utxo_snapshot.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/merkle.h>
+#include <evo/cbtx.h>
+#include <evo/evodb.h>
+#include <evo/simplifiedmns.h>
+#include <evo/specialtx.h>
+#include <llmq/quorums_blockprocessor.h>
+#include <node/coinstats.h>
+#include <txdb.h>
+#include <util.h>
+#include <validation.h>
+
+#include <map>
+#include <set>
+
+#include <boost/thread.hpp>
+
+// Collect the lists of the base block, of the quorums of all active commitments and of the DKGs in progress, which is
+// everything the MN list and quorum code looks up when continuing from the base block
+static bool GetSnapshotEvoData(const CBlockIndex* pindexBase, std::vector<SnapshotMNList>& vMNLists, std::vector<SnapshotCommitment>& vCommitments, std::string& strError)
+{
+    AssertLockHeld(cs_main);
+
+    const auto& consensusParams = Params().GetConsensus();
+    if (pindexBase->nHeight < consensusParams.DIP0008Height) {
+        strError = "Snapshots need the quorum commitments of DIP8 to be active";
+        return false;
+    }
+
+    std::map<int, const CBlockIndex*> mapBlocks{{pindexBase->nHeight, pindexBase}};
+    for (const auto& p : llmq::quorumBlockProcessor->GetMinedAndActiveCommitmentsUntilBlock(pindexBase)) {
+        for (const CBlockIndex* pindexQuorum : p.second) {
+            llmq::CFinalCommitment qc;
+            uint256 minedBlockHash;
+            if (!llmq::quorumBlockProcessor->GetMinedCommitment(p.first, pindexQuorum->GetBlockHash(), qc, minedBlockHash)) {
+                strError = strprintf("Failed to read the commitment of quorum %s", pindexQuorum->GetBlockHash().ToString());
+                return false;
+            }
+            vCommitments.emplace_back(std::move(qc), minedBlockHash);
+            mapBlocks.emplace(pindexQuorum->nHeight, pindexQuorum);
+        }
+        const auto& params = consensusParams.llmqs.at(p.first);
+        const CBlockIndex* pindexDKG = pindexBase->GetAncestor(pindexBase->nHeight - pindexBase->nHeight % params.dkgInterval);
+        mapBlocks.emplace(pindexDKG->nHeight, pindexDKG);
+    }
+
+    for (const auto& p : mapBlocks) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, p.second, consensusParams)) {
+            strError = strprintf("Failed to read block %s", p.second->GetBlockHash().ToString());
+            return false;
+        }
+        SnapshotMNList entry;
+        entry.merkleBlock = CMerkleBlock(block, std::set<uint256>{block.vtx[0]->GetHash()});
+        entry.cbTx = block.vtx[0];
+        entry.mnList.mnList = deterministicMNManager->GetListForBlock(p.second);
+        vMNLists.emplace_back(std::move(entry));
+    }
+    return true;
+}
+
+static bool CheckSnapshotEvoData(const CBlockIndex* pindexBase, const std::vector<SnapshotMNList>& vMNLists, const std::vector<SnapshotCommitment>& vCommitments, std::string& strError)
+{
+    AssertLockHeld(cs_main);
+
+    const auto& consensusParams = Params().GetConsensus();
+    std::set<uint256> setListBlocks;
+    CCbTx cbTxBase;
+    for (const auto& entry : vMNLists) {
+        const CBlockIndex* pindex = LookupBlockIndex(entry.merkleBlock.header.GetHash());
+        if (!pindex || pindexBase->GetAncestor(pindex->nHeight) != pindex) {
+            strError = strprintf("MN list of block %s which is not an ancestor of the base block", entry.merkleBlock.header.GetHash().ToString());
+            return false;
+        }
+
+        CPartialMerkleTree txn(entry.merkleBlock.txn);
+        std::vector<uint256> vMatch;
+        std::vector<unsigned int> vIndex;
+        CCbTx cbTx;
+        if (!entry.cbTx || txn.ExtractMatches(vMatch, vIndex) != pindex->hashMerkleRoot ||
+            vIndex != std::vector<unsigned int>{0} || vMatch[0] != entry.cbTx->GetHash() ||
+            !entry.cbTx->IsCoinBase() || !GetTxPayload(*entry.cbTx, cbTx)) {
+            strError = strprintf("Invalid coinbase of block %s", pindex->GetBlockHash().ToString());
+            return false;
+        }
+
+        const auto& mnList = entry.mnList.mnList;
+        bool fMutated = false;
+        if (mnList.GetBlockHash() != pindex->GetBlockHash() || mnList.GetHeight() != pindex->nHeight ||
+            CSimplifiedMNList(mnList).CalcMerkleRoot(&fMutated) != cbTx.merkleRootMNList || fMutated) {
+            strError = strprintf("MN list of block %s doesn't match its coinbase", pindex->GetBlockHash().ToString());
+            return false;
+        }
+        setListBlocks.emplace(pindex->GetBlockHash());
+        if (pindex == pindexBase) {
+            cbTxBase = cbTx;
+        }
+    }
+    if (!setListBlocks.count(pindexBase->GetBlockHash())) {
+        strError = "MN list of the base block is missing";
+        return false;
+    }
+    if (cbTxBase.nVersion < 2) {
+        strError = "Coinbase of the base block has no quorum merkle root";
+        return false;
+    }
+
+    // The coinbase of the base block commits to exactly the commitments that are active after it
+    std::map<Consensus::LLMQType, size_t> mapCounts;
+    std::vector<uint256> vHashes;
+    for (const auto& p : vCommitments) {
+        const auto& qc = p.first;
+        auto itParams = consensusParams.llmqs.find((Consensus::LLMQType)qc.llmqType);
+        const CBlockIndex* pindexQuorum = LookupBlockIndex(qc.quorumHash);
+        const CBlockIndex* pindexMined = LookupBlockIndex(p.second);
+        if (itParams == consensusParams.llmqs.end() || !pindexQuorum || !pindexMined ||
+            pindexBase->GetAncestor(pindexMined->nHeight) != pindexMined || pindexMined->GetAncestor(pindexQuorum->nHeight) != pindexQuorum ||
+            ++mapCounts[itParams->first] > (size_t)itParams->second.signingActiveQuorumCount) {
+            strError = strprintf("Invalid commitment of quorum %s", qc.quorumHash.ToString());
+            return false;
+        }
+        if (!setListBlocks.count(qc.quorumHash)) {
+            strError = strprintf("MN list of quorum %s is missing", qc.quorumHash.ToString());
+            return false;
+        }
+        vHashes.emplace_back(::SerializeHash(qc));
+    }
+    std::sort(vHashes.begin(), vHashes.end());
+    bool fMutated = false;
+    if (ComputeMerkleRoot(vHashes, &fMutated) != cbTxBase.merkleRootQuorums || fMutated) {
+        strError = "Quorum commitments don't match the coinbase of the base block";
+        return false;
+    }
+    return true;
+}
+
+// Read the coin chunks that follow the evodb data, hashing the coins and passing those of each chunk to the callback
+template <typename Callback>
+static bool ReadSnapshotCoins(CAutoFile& file, CCoinsStatsHasher& hasher, Callback&& callback, std::string& strError)
+{
+    SnapshotCoinsChunk chunk;
+    std::vector<std::pair<COutPoint, Coin>> vCoins;
+    do {
+        boost::this_thread::interruption_point();
+        file >> chunk;
+        vCoins.clear();
+        for (auto& tx : chunk.vTxs) {
+            for (auto& p : tx.second) {
+                COutPoint outpoint(tx.first, p.first);
+                if (p.second.IsSpent() || !hasher.Add(outpoint, Coin(p.second))) {
+                    strError = strprintf("Invalid or misordered coin %s", outpoint.ToString());
+                    return false;
+                }
+                vCoins.emplace_back(outpoint, std::move(p.second));
+            }
+        }
+        if (!callback(vCoins)) {
+            strError = "Failed to write to the coin database";
+            return false;
+        }
+    } while (!chunk.vTxs.empty());
+    return true;
+}
+
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, CCoinsStats& stats, std::string& strError)
+{
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    std::vector<SnapshotMNList> vMNLists;
+    std::vector<SnapshotCommitment> vCommitments;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        if (!pcoinsdbview->WaitForWrite()) {
+            strError = "Failed to write the coin database";
+            return false;
+        }
+        pcursor.reset(pcoinsdbview->Cursor());
+        const CBlockIndex* pindexBase = LookupBlockIndex(pcursor->GetBestBlock());
+        assert(pindexBase);
+        if (!GetSnapshotEvoData(pindexBase, vMNLists, vCommitments, strError)) {
+            return false;
+        }
+        metadata.baseBlockHash = pindexBase->GetBlockHash();
+        metadata.nBaseHeight = pindexBase->nHeight;
+    }
+
+    CAutoFile file(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull()) {
+        strError = strprintf("Failed to create %s", path.string());
+        return false;
+    }
+
+    try {
+        file << metadata;
+        file << vMNLists;
+        file << vCommitments;
+
+        CCoinsStatsHasher hasher(metadata.baseBlockHash);
+        SnapshotCoinsChunk chunk;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                strError = "Failed to read the coin database";
+                return false;
+            }
+            if (chunk.vTxs.empty() || chunk.vTxs.back().first != key.hash) {
+                if (chunk.vTxs.size() == SNAPSHOT_CHUNK_TXS) {
+                    file << chunk;
+                    chunk.vTxs.clear();
+                }
+                chunk.vTxs.emplace_back(key.hash, std::vector<std::pair<uint32_t, Coin>>());
+            }
+            chunk.vTxs.back().second.emplace_back(key.n, coin);
+            hasher.Add(key, std::move(coin));
+            pcursor->Next();
+        }
+        if (!chunk.vTxs.empty()) {
+            file << chunk;
+        }
+        file << SnapshotCoinsChunk();
+        hasher.Finish(stats);
+        stats.nHeight = metadata.nBaseHeight;
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to write %s: %s", path.string(), e.what());
+        return false;
+    }
+    if (fflush(file.Get()) != 0 || !FileCommit(file.Get())) {
+        strError = strprintf("Failed to write %s", path.string());
+        return false;
+    }
+    return true;
+}
+
+bool LoadUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, CCoinsStats& stats, std::string& strError)
+{
+    CBlockIndex* pindexBase;
+    std::vector<SnapshotMNList> vMNLists;
+    std::vector<SnapshotCommitment> vCommitments;
+
+    const auto fNoWrite = [](const std::vector<std::pair<COutPoint, Coin>>&) { return true; };
+
+    // First pass, nothing is written until the whole file is known to be good
+    try {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            strError = strprintf("Failed to open %s", path.string());
+            return false;
+        }
+        file >> metadata;
+        file >> vMNLists;
+        file >> vCommitments;
+
+        {
+            LOCK(cs_main);
+            if (chainActive.Height() != 0) {
+                strError = "Snapshots can only be loaded before any block is connected";
+                return false;
+            }
+            pindexBase = LookupBlockIndex(metadata.baseBlockHash);
+            if (!pindexBase || pindexBase->nHeight != metadata.nBaseHeight) {
+                strError = strprintf("The headers until the base block %s need to be synced first", metadata.baseBlockHash.ToString());
+                return false;
+            }
+            if (!Params().Assumeutxo().count(pindexBase->nHeight)) {
+                strError = strprintf("No snapshot is known for height %d", pindexBase->nHeight);
+                return false;
+            }
+            if (!CheckSnapshotEvoData(pindexBase, vMNLists, vCommitments, strError)) {
+                return false;
+            }
+        }
+
+        CCoinsStatsHasher hasher(metadata.baseBlockHash);
+        if (!ReadSnapshotCoins(file, hasher, fNoWrite, strError)) {
+            return false;
+        }
+        hasher.Finish(stats);
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to read %s: %s", path.string(), e.what());
+        return false;
+    }
+    const AssumeutxoData& assumeutxo = Params().Assumeutxo().at(pindexBase->nHeight);
+    if (stats.hashSerialized != assumeutxo.hashSerialized) {
+        strError = strprintf("Snapshot hash %s doesn't match the expected %s", stats.hashSerialized.ToString(), assumeutxo.hashSerialized.ToString());
+        return false;
+    }
+
+    // Second pass, the node must not connect blocks until the snapshot is its chainstate
+    LOCK(cs_main);
+    if (chainActive.Height() != 0) {
+        strError = "Snapshots can only be loaded before any block is connected";
+        return false;
+    }
+    FlushStateToDisk();
+    try {
+        CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            strError = strprintf("Failed to open %s", path.string());
+            return false;
+        }
+        SnapshotMetadata metadata2;
+        file >> metadata2;
+        file >> vMNLists;
+        file >> vCommitments;
+        if (metadata2.baseBlockHash != metadata.baseBlockHash || !CheckSnapshotEvoData(pindexBase, vMNLists, vCommitments, strError)) {
+            strError = "The snapshot changed while it was loaded";
+            return false;
+        }
+
+        LogPrintf("%s: loading snapshot of block %s\n", __func__, metadata.baseBlockHash.ToString());
+        CCoinsStatsHasher hasher(metadata.baseBlockHash);
+        const auto fWrite = [&](const std::vector<std::pair<COutPoint, Coin>>& vCoins) {
+            return vCoins.empty() || pcoinsdbview->WriteSnapshotCoins(vCoins, metadata.baseBlockHash, false);
+        };
+        if (!ReadSnapshotCoins(file, hasher, fWrite, strError)) {
+            strError += ", restart with -reindex-chainstate";
+            return false;
+        }
+        hasher.Finish(stats);
+        if (stats.hashSerialized != assumeutxo.hashSerialized) {
+            strError = "The snapshot changed while it was loaded, restart with -reindex-chainstate";
+            return false;
+        }
+        stats.nHeight = pindexBase->nHeight;
+    } catch (const std::exception& e) {
+        strError = strprintf("Failed to read %s: %s, restart with -reindex-chainstate", path.string(), e.what());
+        return false;
+    }
+    if (!pcoinsdbview->WriteSnapshotCoins({}, metadata.baseBlockHash, true)) {
+        strError = "Failed to write to the coin database, restart with -reindex-chainstate";
+        return false;
+    }
+
+    std::vector<std::pair<llmq::CFinalCommitment, const CBlockIndex*>> vMinedCommitments;
+    for (const auto& p : vCommitments) {
+        vMinedCommitments.emplace_back(p.first, LookupBlockIndex(p.second));
+    }
+    {
+        auto dbTx = evoDb->BeginTransaction();
+        for (const auto& entry : vMNLists) {
+            deterministicMNManager->AddSnapshotList(entry.mnList.mnList);
+        }
+        llmq::quorumBlockProcessor->AddSnapshotCommitments(pindexBase, vMinedCommitments);
+        evoDb->WriteBestBlock(pindexBase->GetBlockHash());
+        dbTx->Commit();
+    }
+    if (!evoDb->CommitRootTransaction()) {
+        strError = "Failed to write to the evo database, restart with -reindex-chainstate";
+        return false;
+    }
+
+    if (!ActivateSnapshotChainstate(pindexBase, assumeutxo.nChainTx)) {
+        strError = "Failed to activate the snapshot, restart with -reindex-chainstate";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_NODE_UTXO_SNAPSHOT_H
+#define BITCOIN_NODE_UTXO_SNAPSHOT_H
+
+#include <coins.h>
+#include <evo/deterministicmns.h>
+#include <fs.h>
+#include <llmq/quorums_commitment.h>
+#include <merkleblock.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <tinyformat.h>
+#include <uint256.h>
+
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct CCoinsStats;
+
+/** Maximum number of transactions whose coins are stored in one chunk of a UTXO snapshot */
+static const unsigned int SNAPSHOT_CHUNK_TXS = 10000;
+
+static const unsigned char SNAPSHOT_MAGIC_BYTES[5] = {'d', 'u', 't', 'x', 'o'};
+
+/**
+ * Header of a UTXO snapshot file as written by dumptxoutset.
+ *
+ * It is followed by the MN lists and the active quorum commitments that the evodb needs to continue from the base
+ * block, then by the coins of all unspent outputs in the order of the coin database. The coins are grouped by
+ * transaction and written in chunks of up to SNAPSHOT_CHUNK_TXS transactions, an empty chunk ends the file.
+ */
+class SnapshotMetadata
+{
+public:
+    static const uint16_t CURRENT_VERSION = 1;
+
+    uint16_t nVersion{CURRENT_VERSION};
+    uint256 baseBlockHash;
+    int nBaseHeight{-1};
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write((const char*)SNAPSHOT_MAGIC_BYTES, sizeof(SNAPSHOT_MAGIC_BYTES));
+        s << nVersion;
+        s << baseBlockHash;
+        s << nBaseHeight;
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        unsigned char magic[sizeof(SNAPSHOT_MAGIC_BYTES)];
+        s.read((char*)magic, sizeof(magic));
+        if (memcmp(magic, SNAPSHOT_MAGIC_BYTES, sizeof(magic)) != 0) {
+            throw std::ios_base::failure("not a UTXO snapshot");
+        }
+        s >> nVersion;
+        if (nVersion != CURRENT_VERSION) {
+            throw std::ios_base::failure(strprintf("unsupported UTXO snapshot version %d", nVersion));
+        }
+        s >> baseBlockHash;
+        s >> nBaseHeight;
+    }
+};
+
+/**
+ * A MN list of a UTXO snapshot, along with the coinbase of its block and the proof that the coinbase is part of the
+ * block. The coinbase commits to the list with merkleRootMNList.
+ */
+class SnapshotMNList
+{
+public:
+    CMerkleBlock merkleBlock;
+    CTransactionRef cbTx;
+    CDeterministicMNListCompactSnapshot mnList;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(merkleBlock);
+        READWRITE(cbTx);
+        READWRITE(mnList);
+    }
+};
+
+/** An active quorum commitment of a UTXO snapshot and the hash of the block it was mined in */
+typedef std::pair<llmq::CFinalCommitment, uint256> SnapshotCommitment;
+
+/** The coins of up to SNAPSHOT_CHUNK_TXS transactions of a UTXO snapshot, the outputs of each are stored by index */
+class SnapshotCoinsChunk
+{
+public:
+    std::vector<std::pair<uint256, std::vector<std::pair<uint32_t, Coin>>>> vTxs;
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        WriteCompactSize(s, vTxs.size());
+        for (const auto& tx : vTxs) {
+            s << tx.first;
+            WriteCompactSize(s, tx.second.size());
+            for (const auto& p : tx.second) {
+                s << VARINT(p.first);
+                s << p.second;
+            }
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        vTxs.clear();
+        size_t nTxs = ReadCompactSize(s);
+        if (nTxs > SNAPSHOT_CHUNK_TXS) {
+            throw std::ios_base::failure("UTXO snapshot chunk too large");
+        }
+        vTxs.resize(nTxs);
+        for (auto& tx : vTxs) {
+            s >> tx.first;
+            size_t nCoins = ReadCompactSize(s);
+            for (size_t i = 0; i < nCoins; i++) {
+                uint32_t n;
+                Coin coin;
+                s >> VARINT(n);
+                s >> coin;
+                tx.second.emplace_back(n, std::move(coin));
+            }
+        }
+    }
+};
+
+/**
+ * Flush the chainstate and write a UTXO snapshot of the tip to path. The coins are read from a database snapshot
+ * after cs_main was released, so the node keeps connecting blocks meanwhile. Fills in the statistics of the written
+ * coins, hashSerialized and the nChainTx of the base block are what Params().Assumeutxo() needs to accept the file.
+ */
+bool DumpUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, CCoinsStats& stats, std::string& strError);
+
+/**
+ * Load a UTXO snapshot into the chainstate of a node that has connected nothing but the genesis block, the headers
+ * until the base block must be known. The file is read twice: first to check the coins against Params().Assumeutxo()
+ * and the MN lists and commitments against the merkle roots of the coinbases, then to write everything while
+ * holding cs_main. Afterwards the node continues from the base block, the blocks before it are never downloaded.
+ */
+bool LoadUTXOSnapshot(const fs::path& path, SnapshotMetadata& metadata, CCoinsStats& stats, std::string& strError);
+
+#endif // BITCOIN_NODE_UTXO_SNAPSHOT_H
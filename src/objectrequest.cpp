@@ -0,0 +1,154 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <objectrequest.h>
+
+#include <assert.h>
+
+bool CObjectRequestTracker::ReceivedInv(NodeId peer, const CInv& inv, std::chrono::microseconds process_time, size_t nMaxPerPeer)
+{
+    PeerInfo& info = mapPeerInfo[peer];
+    if (info.nAnnounced >= nMaxPerPeer) {
+        return false;
+    }
+    if (!announcements.insert(Announcement{inv, peer, process_time, false, false}).second) {
+        return false;
+    }
+    info.nAnnounced++;
+    return true;
+}
+
+bool CObjectRequestTracker::GetNextDue(NodeId peer, std::chrono::microseconds now, CInv& inv) const
+{
+    const auto& index = announcements.get<by_peer_time>();
+    auto it = index.lower_bound(std::make_tuple(peer, false, std::chrono::microseconds::min()));
+    if (it == index.end() || it->peer != peer || it->fInFlight || it->time > now) {
+        return false;
+    }
+    inv = it->inv;
+    return true;
+}
+
+void CObjectRequestTracker::RequestedObject(NodeId peer, const CInv& inv, std::chrono::microseconds now)
+{
+    auto it = announcements.find(std::make_pair(peer, inv));
+    assert(it != announcements.end() && !it->fInFlight);
+    announcements.modify(it, [&](Announcement& a) {
+        a.time = now;
+        a.fInFlight = true;
+        a.fHoldsBack = true;
+    });
+    mapPeerInfo[peer].nInFlight++;
+}
+
+void CObjectRequestTracker::Requeue(NodeId peer, const CInv& inv, std::chrono::microseconds process_time)
+{
+    auto it = announcements.find(std::make_pair(peer, inv));
+    assert(it != announcements.end() && !it->fInFlight);
+    announcements.modify(it, [&](Announcement& a) { a.time = process_time; });
+}
+
+std::chrono::microseconds CObjectRequestTracker::GetLastRequestTime(const uint256& hash) const
+{
+    const auto& index = announcements.get<by_hash>();
+    auto it = index.upper_bound(std::make_tuple(hash, true, std::chrono::microseconds::max()));
+    if (it == index.begin() || !(--it)->fHoldsBack || it->inv.hash != hash) {
+        return std::chrono::microseconds{0};
+    }
+    return it->time;
+}
+
+void CObjectRequestTracker::ResetRequestTime(const uint256& hash)
+{
+    auto& index = announcements.get<by_hash>();
+    auto it = index.lower_bound(std::make_tuple(hash, true, std::chrono::microseconds::min()));
+    while (it != index.end() && it->inv.hash == hash) {
+        // moves it in front of the range which is left
+        index.modify(it++, [](Announcement& a) { a.fHoldsBack = false; });
+    }
+}
+
+void CObjectRequestTracker::Erase(AnnouncementMap::iterator it)
+{
+    auto infoIt = mapPeerInfo.find(it->peer);
+    assert(infoIt != mapPeerInfo.end());
+    PeerInfo& info = infoIt->second;
+    info.nAnnounced--;
+    if (it->fInFlight) {
+        info.nInFlight--;
+    }
+    if (info.nAnnounced == 0) {
+        mapPeerInfo.erase(infoIt);
+    }
+    announcements.erase(it);
+}
+
+bool CObjectRequestTracker::ForgetAnnouncement(NodeId peer, const CInv& inv)
+{
+    auto it = announcements.find(std::make_pair(peer, inv));
+    if (it == announcements.end()) {
+        return false;
+    }
+    bool fInFlight = it->fInFlight;
+    Erase(it);
+    return fInFlight;
+}
+
+bool CObjectRequestTracker::ForgetRequest(NodeId peer, const CInv& inv)
+{
+    auto it = announcements.find(std::make_pair(peer, inv));
+    if (it == announcements.end() || !it->fInFlight) {
+        return false;
+    }
+    Erase(it);
+    return true;
+}
+
+void CObjectRequestTracker::ForgetHash(const uint256& hash)
+{
+    auto& index = announcements.get<by_hash>();
+    auto it = index.lower_bound(std::make_tuple(hash, false, std::chrono::microseconds::min()));
+    while (it != index.end() && it->inv.hash == hash) {
+        Erase(announcements.project<by_peer>(it++));
+    }
+}
+
+std::vector<CInv> CObjectRequestTracker::ExpireRequests(NodeId peer, std::chrono::microseconds now, const std::function<std::chrono::microseconds(int)>& getExpiryInterval)
+{
+    std::vector<CInv> result;
+    auto& index = announcements.get<by_peer_time>();
+    auto it = index.lower_bound(std::make_tuple(peer, true, std::chrono::microseconds::min()));
+    // the requests are sorted by their time, but their expiry intervals differ by type
+    while (it != index.end() && it->peer == peer) {
+        assert(it->fInFlight);
+        if (it->time <= now - getExpiryInterval(it->inv.type)) {
+            result.emplace_back(it->inv);
+            Erase(announcements.project<by_peer>(it++));
+        } else {
+            ++it;
+        }
+    }
+    return result;
+}
+
+void CObjectRequestTracker::DisconnectedPeer(NodeId peer)
+{
+    auto& index = announcements.get<by_peer>();
+    auto it = index.lower_bound(std::make_pair(peer, CInv()));
+    while (it != index.end() && it->peer == peer) {
+        Erase(it++);
+    }
+}
+
+size_t CObjectRequestTracker::CountAnnounced(NodeId peer) const
+{
+    auto it = mapPeerInfo.find(peer);
+    return it != mapPeerInfo.end() ? it->second.nAnnounced : 0;
+}
+
+size_t CObjectRequestTracker::CountInFlight(NodeId peer) const
+{
+    auto it = mapPeerInfo.find(peer);
+    return it != mapPeerInfo.end() ? it->second.nInFlight : 0;
+}
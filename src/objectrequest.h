@@ -0,0 +1,115 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_OBJECTREQUEST_H
+#define BITCOIN_OBJECTREQUEST_H
+
+#include <net.h>
+#include <protocol.h>
+#include <uint256.h>
+
+#include <chrono>
+#include <functional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+/**
+ * The objects (transactions, DSTXs, ISLOCKs, governance objects, sigs, ...) which peers announced to us and which we
+ * may request from them, for all peers at once.
+ *
+ * Every announcement is either queued, waiting for its process time, or in flight since the time it was requested.
+ * They are indexed by (peer, inv) for the lookups, by (peer, in flight, time) to find the due announcements and the
+ * expired requests of a peer without looking at the others, and by (hash, other peers wait for it, time) to find the
+ * latest request of an object in a single lookup and to drop all announcements of it once it was received.
+ *
+ * The time at which an object was last requested is taken from its requests in flight, so when a peer answers with
+ * NOTFOUND or disconnects, the other peers which announced the object don't have to wait for the request to time
+ * out. Not thread safe, the caller has to synchronize the access.
+ */
+class CObjectRequestTracker
+{
+public:
+    /** Add a queued announcement, false if the peer announced it already or has nMaxPerPeer announcements */
+    bool ReceivedInv(NodeId peer, const CInv& inv, std::chrono::microseconds process_time, size_t nMaxPerPeer);
+
+    /** The queued announcement of the peer with the earliest process time, if that is not after now */
+    bool GetNextDue(NodeId peer, std::chrono::microseconds now, CInv& inv) const;
+    /** Mark the queued announcement as in flight since now */
+    void RequestedObject(NodeId peer, const CInv& inv, std::chrono::microseconds now);
+    /** Queue the announcement again for a later process time */
+    void Requeue(NodeId peer, const CInv& inv, std::chrono::microseconds process_time);
+
+    /** Time of the latest request of the hash which other peers wait for, 0 if there is none */
+    std::chrono::microseconds GetLastRequestTime(const uint256& hash) const;
+    /** Let the announcements of the hash be requested without waiting for the requests in flight */
+    void ResetRequestTime(const uint256& hash);
+
+    /** Remove the announcement, true if it was in flight */
+    bool ForgetAnnouncement(NodeId peer, const CInv& inv);
+    /** Remove the announcement only if it is in flight, e.g. for a NOTFOUND, true if it was */
+    bool ForgetRequest(NodeId peer, const CInv& inv);
+    /** Remove all announcements of the hash, from all peers */
+    void ForgetHash(const uint256& hash);
+    /** Remove the requests of the peer which were sent at or before now minus the expiry interval of their type */
+    std::vector<CInv> ExpireRequests(NodeId peer, std::chrono::microseconds now, const std::function<std::chrono::microseconds(int)>& getExpiryInterval);
+    void DisconnectedPeer(NodeId peer);
+
+    size_t CountAnnounced(NodeId peer) const;
+    size_t CountInFlight(NodeId peer) const;
+    size_t CountQueued(NodeId peer) const { return CountAnnounced(peer) - CountInFlight(peer); }
+    size_t Size() const { return announcements.size(); }
+
+private:
+    struct Announcement {
+        CInv inv;
+        NodeId peer;
+        // the process time while queued, the request time while in flight
+        std::chrono::microseconds time;
+        bool fInFlight;
+        // whether this is a request the other peers wait for, see ResetRequestTime
+        bool fHoldsBack;
+    };
+
+    struct ByPeerKey {
+        typedef std::pair<NodeId, CInv> result_type;
+        result_type operator()(const Announcement& a) const { return result_type(a.peer, a.inv); }
+    };
+    struct ByPeerTimeKey {
+        typedef std::tuple<NodeId, bool, std::chrono::microseconds> result_type;
+        result_type operator()(const Announcement& a) const { return result_type(a.peer, a.fInFlight, a.time); }
+    };
+    struct ByHashKey {
+        typedef std::tuple<uint256, bool, std::chrono::microseconds> result_type;
+        result_type operator()(const Announcement& a) const { return result_type(a.inv.hash, a.fHoldsBack, a.time); }
+    };
+
+    struct by_peer {};
+    struct by_peer_time {};
+    struct by_hash {};
+
+    typedef boost::multi_index_container<
+        Announcement,
+        boost::multi_index::indexed_by<
+            boost::multi_index::ordered_unique<boost::multi_index::tag<by_peer>, ByPeerKey>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_peer_time>, ByPeerTimeKey>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_hash>, ByHashKey>
+        >
+    > AnnouncementMap;
+
+    struct PeerInfo {
+        size_t nAnnounced{0};
+        size_t nInFlight{0};
+    };
+
+    AnnouncementMap announcements;
+    std::unordered_map<NodeId, PeerInfo> mapPeerInfo;
+
+    void Erase(AnnouncementMap::iterator it);
+};
+
+#endif // BITCOIN_OBJECTREQUEST_H
@@ -14,6 +14,76 @@
 
 static constexpr double INF_FEERATE = 1e99;
 
+/** Fee estimate files written by this version or later use the compact format */
+static constexpr int FEE_ESTIMATES_COMPACT_VERSION = 170002;
+
+/**
+ * Write a vector of doubles as alternating runs of zeros and non-zero values. Most of the confirmation averages of
+ * the high feerate buckets are zero, so this about halves the size of the estimates file.
+ */
+static void WriteCompactDoubles(CDataStream& s, const std::vector<double>& vals)
+{
+    WriteCompactSize(s, vals.size());
+    size_t i = 0;
+    while (i < vals.size()) {
+        size_t nZeros = 0;
+        while (i + nZeros < vals.size() && vals[i + nZeros] == 0) {
+            nZeros++;
+        }
+        size_t nValues = 0;
+        while (i + nZeros + nValues < vals.size() && vals[i + nZeros + nValues] != 0) {
+            nValues++;
+        }
+        WriteCompactSize(s, nZeros);
+        WriteCompactSize(s, nValues);
+        for (size_t j = i + nZeros; j < i + nZeros + nValues; j++) {
+            s << vals[j];
+        }
+        i += nZeros + nValues;
+    }
+}
+
+static void ReadCompactDoubles(CDataStream& s, std::vector<double>& vals, size_t nMaxSize)
+{
+    size_t nSize = ReadCompactSize(s);
+    if (nSize > nMaxSize) {
+        throw std::runtime_error("Corrupt estimates file. Too many values");
+    }
+    vals.assign(nSize, 0);
+    size_t i = 0;
+    while (i < nSize) {
+        size_t nZeros = ReadCompactSize(s);
+        size_t nValues = ReadCompactSize(s);
+        if (nZeros + nValues == 0 || nZeros > nSize - i || nValues > nSize - i - nZeros) {
+            throw std::runtime_error("Corrupt estimates file. Invalid run of values");
+        }
+        i += nZeros;
+        for (size_t j = 0; j < nValues; j++) {
+            s >> vals[i++];
+        }
+    }
+}
+
+static void WriteCompactDoubles(CDataStream& s, const std::vector<std::vector<double>>& vals)
+{
+    WriteCompactSize(s, vals.size());
+    for (const auto& v : vals) {
+        WriteCompactDoubles(s, v);
+    }
+}
+
+static void ReadCompactDoubles(CDataStream& s, std::vector<std::vector<double>>& vals, size_t nMaxRows, size_t nMaxSize)
+{
+    size_t nRows = ReadCompactSize(s);
+    if (nRows > nMaxRows) {
+        throw std::runtime_error("Corrupt estimates file. Too many rows");
+    }
+    vals.resize(nRows);
+    for (auto& v : vals) {
+        ReadCompactDoubles(s, v, nMaxSize);
+    }
+}
+
 std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon) {
     static const std::map<FeeEstimateHorizon, std::string> horizon_strings = {
         {FeeEstimateHorizon::SHORT_HALFLIFE, "short"},
@@ -110,6 +180,9 @@ private:
 
     void resizeInMemoryCounters(size_t newbuckets);
 
+    /** Sanity check data read from a file, throws if it's not usable */
+    void CheckRead(size_t numBuckets);
+
 public:
     /**
      * Create new TxConfirmStats. This is called by BlockPolicyEstimator's
@@ -161,14 +234,16 @@ public:
     /** Return the max number of confirms we're tracking */
     unsigned int GetMaxConfirms() const { return scale * confAvg.size(); }
 
-    /** Write state of estimation data to a file*/
-    void Write(CAutoFile& fileout) const;
+    /** Write state of estimation data in the compact format */
+    void Write(CDataStream& s) const;
 
     /**
      * Read saved state of estimation data from a file and replace all internal data structures and
      * variables with this state.
      */
     void Read(CAutoFile& filein, int nFileVersion, size_t numBuckets);
+    /** Same as Read(), for the compact format */
+    void ReadCompact(CDataStream& s, size_t numBuckets);
 };
 
 
@@ -393,42 +468,60 @@ double TxConfirmStats::EstimateMedianVal(int confTarget, double sufficientTxVal,
     return median;
 }
 
-void TxConfirmStats::Write(CAutoFile& fileout) const
+void TxConfirmStats::Write(CDataStream& s) const
 {
-    fileout << decay;
-    fileout << scale;
-    fileout << avg;
-    fileout << txCtAvg;
-    fileout << confAvg;
-    fileout << failAvg;
+    s << decay;
+    s << scale;
+    WriteCompactDoubles(s, avg);
+    WriteCompactDoubles(s, txCtAvg);
+    WriteCompactDoubles(s, confAvg);
+    WriteCompactDoubles(s, failAvg);
 }
 
 void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets)
 {
-    // Read data file and do some very basic sanity checking
+    // The current version will store the decay with each individual TxConfirmStats and also keep a scale factor
+    filein >> decay;
+    filein >> scale;
+    filein >> avg;
+    filein >> txCtAvg;
+    filein >> confAvg;
+    filein >> failAvg;
+    CheckRead(numBuckets);
+}
+
+void TxConfirmStats::ReadCompact(CDataStream& s, size_t numBuckets)
+{
+    // Bound allocations by what CheckRead() would accept anyway
+    s >> decay;
+    s >> scale;
+    ReadCompactDoubles(s, avg, numBuckets);
+    ReadCompactDoubles(s, txCtAvg, numBuckets);
+    ReadCompactDoubles(s, confAvg, 6 * 24 * 7, numBuckets);
+    ReadCompactDoubles(s, failAvg, 6 * 24 * 7, numBuckets);
+    CheckRead(numBuckets);
+}
+
+void TxConfirmStats::CheckRead(size_t numBuckets)
+{
+    // Do some very basic sanity checking
     // buckets and bucketMap are not updated yet, so don't access them
     // If there is a read failure, we'll just discard this entire object anyway
     size_t maxConfirms, maxPeriods;
 
-    // The current version will store the decay with each individual TxConfirmStats and also keep a scale factor
-    filein >> decay;
     if (decay <= 0 || decay >= 1) {
         throw std::runtime_error("Corrupt estimates file. Decay must be between 0 and 1 (non-inclusive)");
     }
-    filein >> scale;
     if (scale == 0) {
         throw std::runtime_error("Corrupt estimates file. Scale must be non-zero");
     }
 
-    filein >> avg;
     if (avg.size() != numBuckets) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in feerate average bucket count");
     }
-    filein >> txCtAvg;
     if (txCtAvg.size() != numBuckets) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in tx count bucket count");
     }
-    filein >> confAvg;
     maxPeriods = confAvg.size();
     maxConfirms = scale * maxPeriods;
 
@@ -441,7 +534,6 @@ void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets
         }
     }
 
-    filein >> failAvg;
     if (maxPeriods != failAvg.size()) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in confirms tracked for failures");
     }
@@ -509,9 +601,18 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
 // tracked. Txs that were part of a block have already been removed in
 // processBlockTx to ensure they are never double tracked, but it is
 // of no harm to try to remove them again.
-bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
+void CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
 {
-    LOCK(cs_feeEstimator);
+    Event ev;
+    ev.type = Event::TX_REMOVED;
+    ev.fFlag = inBlock;
+    ev.tx.hash = hash;
+    PushEvent(std::move(ev));
+}
+
+bool CBlockPolicyEstimator::removeTxInternal(const uint256& hash, bool inBlock)
+{
+    AssertLockHeld(cs_feeEstimator);
     std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
     if (pos != mapMemPoolTxs.end()) {
         feeStats->removeTx(pos->second.blockHeight, nBestSeenHeight, pos->second.bucketIndex, inBlock);
@@ -546,11 +647,97 @@ CBlockPolicyEstimator::~CBlockPolicyEstimator()
 {
 }
 
-void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate)
+CBlockPolicyEstimator::TxInfo CBlockPolicyEstimator::MakeTxInfo(const CTxMemPoolEntry& entry)
+{
+    TxInfo tx;
+    tx.hash = entry.GetTx().GetHash();
+    tx.nHeight = entry.GetHeight();
+    // Feerates are stored and reported as BTC-per-kb:
+    tx.feeRate = (double)CFeeRate(entry.GetFee(), entry.GetTxSize()).GetFeePerK();
+    return tx;
+}
+
+void CBlockPolicyEstimator::PushEvent(Event&& ev)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(queueMutex);
+        vQueue.emplace_back(std::move(ev));
+        if (fAsync) {
+            queueCond.notify_one();
+            return;
+        }
+    }
+    ProcessQueue();
+}
+
+void CBlockPolicyEstimator::ProcessQueue() const
 {
+    // Only the stats are mutated, which is invisible to callers as they always process the queue before reading them
+    CBlockPolicyEstimator* self = const_cast<CBlockPolicyEstimator*>(this);
+
+    // Holding cs_feeEstimator while taking the events keeps them in order when called from multiple threads
     LOCK(cs_feeEstimator);
-    unsigned int txHeight = entry.GetHeight();
-    uint256 hash = entry.GetTx().GetHash();
+    std::vector<Event> vEvents;
+    {
+        boost::unique_lock<boost::mutex> lock(self->queueMutex);
+        vEvents.swap(self->vQueue);
+    }
+    for (const Event& ev : vEvents) {
+        switch (ev.type) {
+        case Event::TX_ADDED:
+            self->processTransactionInternal(ev.tx, ev.fFlag);
+            break;
+        case Event::TX_REMOVED:
+            self->removeTxInternal(ev.tx.hash, ev.fFlag);
+            break;
+        case Event::BLOCK:
+            self->processBlockInternal(ev.nBlockHeight, ev.vBlockTxs);
+            break;
+        }
+    }
+}
+
+void CBlockPolicyEstimator::ThreadMain()
+{
+    RenameThread("dash-feeest");
+
+    {
+        boost::unique_lock<boost::mutex> lock(queueMutex);
+        fAsync = true;
+    }
+    try {
+        while (true) {
+            {
+                boost::unique_lock<boost::mutex> lock(queueMutex);
+                while (vQueue.empty()) {
+                    queueCond.wait(lock);
+                }
+            }
+            ProcessQueue();
+            boost::this_thread::interruption_point();
+        }
+    } catch (const boost::thread_interrupted&) {
+        // Whatever is queued from now on is processed right away again
+        boost::unique_lock<boost::mutex> lock(queueMutex);
+        fAsync = false;
+        throw;
+    }
+}
+
+void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate)
+{
+    Event ev;
+    ev.type = Event::TX_ADDED;
+    ev.fFlag = validFeeEstimate;
+    ev.tx = MakeTxInfo(entry);
+    PushEvent(std::move(ev));
+}
+
+void CBlockPolicyEstimator::processTransactionInternal(const TxInfo& tx, bool validFeeEstimate)
+{
+    AssertLockHeld(cs_feeEstimator);
+    unsigned int txHeight = tx.nHeight;
+    const uint256& hash = tx.hash;
     if (mapMemPoolTxs.count(hash)) {
         LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy error mempool tx %s already being tracked\n", hash.ToString());
         return;
@@ -572,21 +759,18 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     }
     trackedTxs++;
 
-    // Feerates are stored and reported as BTC-per-kb:
-    CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
-
     mapMemPoolTxs[hash].blockHeight = txHeight;
-    unsigned int bucketIndex = feeStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
+    unsigned int bucketIndex = feeStats->NewTx(txHeight, tx.feeRate);
     mapMemPoolTxs[hash].bucketIndex = bucketIndex;
-    unsigned int bucketIndex2 = shortStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
+    unsigned int bucketIndex2 = shortStats->NewTx(txHeight, tx.feeRate);
     assert(bucketIndex == bucketIndex2);
-    unsigned int bucketIndex3 = longStats->NewTx(txHeight, (double)feeRate.GetFeePerK());
+    unsigned int bucketIndex3 = longStats->NewTx(txHeight, tx.feeRate);
     assert(bucketIndex == bucketIndex3);
 }
 
-bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
+bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const TxInfo& tx)
 {
-    if (!removeTx(entry->GetTx().GetHash(), true)) {
+    if (!removeTxInternal(tx.hash, true)) {
         // This transaction wasn't being tracked for fee estimation
         return false;
     }
@@ -594,7 +778,7 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
     // possible block has confirmation count of 1
-    int blocksToConfirm = nBlockHeight - entry->GetHeight();
+    int blocksToConfirm = nBlockHeight - tx.nHeight;
     if (blocksToConfirm <= 0) {
         // This can't happen because we don't process transactions from a block with a height
         // lower than our greatest seen height
@@ -602,19 +786,29 @@ bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
         return false;
     }
 
-    // Feerates are stored and reported as BTC-per-kb:
-    CFeeRate feeRate(entry->GetFee(), entry->GetTxSize());
-
-    feeStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
-    shortStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
-    longStats->Record(blocksToConfirm, (double)feeRate.GetFeePerK());
+    feeStats->Record(blocksToConfirm, tx.feeRate);
+    shortStats->Record(blocksToConfirm, tx.feeRate);
+    longStats->Record(blocksToConfirm, tx.feeRate);
     return true;
 }
 
 void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
                                          std::vector<const CTxMemPoolEntry*>& entries)
 {
-    LOCK(cs_feeEstimator);
+    // The entries are gone once the block's TXs were removed from the mempool, so copy what's needed
+    Event ev;
+    ev.type = Event::BLOCK;
+    ev.nBlockHeight = nBlockHeight;
+    ev.vBlockTxs.reserve(entries.size());
+    for (const CTxMemPoolEntry* entry : entries) {
+        ev.vBlockTxs.emplace_back(MakeTxInfo(*entry));
+    }
+    PushEvent(std::move(ev));
+}
+
+void CBlockPolicyEstimator::processBlockInternal(unsigned int nBlockHeight, const std::vector<TxInfo>& txs)
+{
+    AssertLockHeld(cs_feeEstimator);
     if (nBlockHeight <= nBestSeenHeight) {
         // Ignore side chains and re-orgs; assuming they are random
         // they don't affect the estimate.
@@ -641,8 +835,8 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
 
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
-    for (const auto& entry : entries) {
-        if (processBlockTx(nBlockHeight, entry))
+    for (const auto& tx : txs) {
+        if (processBlockTx(nBlockHeight, tx))
             countedTxs++;
     }
 
@@ -653,7 +847,7 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
 
 
     LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy estimates updated by %u of %u block txs, since last block %u of %u tracked, mempool map size %u, max target %u from %s\n",
-             countedTxs, entries.size(), trackedTxs, trackedTxs + untrackedTxs, mapMemPoolTxs.size(),
+             countedTxs, txs.size(), trackedTxs, trackedTxs + untrackedTxs, mapMemPoolTxs.size(),
              MaxUsableEstimate(), HistoricalBlockSpan() > BlockSpan() ? "historical" : "current");
 
     trackedTxs = 0;
@@ -692,6 +886,7 @@ CFeeRate CBlockPolicyEstimator::estimateRawFee(int confTarget, double successThr
     }
     }
 
+    ProcessQueue();
     LOCK(cs_feeEstimator);
     // Return failure if trying to analyze a target we're not tracking
     if (confTarget <= 0 || (unsigned int)confTarget > stats->GetMaxConfirms())
@@ -818,6 +1013,7 @@ double CBlockPolicyEstimator::estimateConservativeFee(unsigned int doubleTarget,
  */
 CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation *feeCalc, bool conservative) const
 {
+    ProcessQueue();
     LOCK(cs_feeEstimator);
 
     if (feeCalc) {
@@ -898,20 +1094,26 @@ CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, FeeCalculation
 bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 {
     try {
+        ProcessQueue();
         LOCK(cs_feeEstimator);
-        fileout << 140100; // version required to read: 0.14.1 or later
+        fileout << FEE_ESTIMATES_COMPACT_VERSION; // version required to read
         fileout << CLIENT_VERSION; // version that wrote the file
-        fileout << nBestSeenHeight;
+
+        // Everything else is prefixed with its size, so that Read() can get it with a single read
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << nBestSeenHeight;
         if (BlockSpan() > HistoricalBlockSpan()/2) {
-            fileout << firstRecordedHeight << nBestSeenHeight;
+            ss << firstRecordedHeight << nBestSeenHeight;
         }
         else {
-            fileout << historicalFirst << historicalBest;
+            ss << historicalFirst << historicalBest;
         }
-        fileout << buckets;
-        feeStats->Write(fileout);
-        shortStats->Write(fileout);
-        longStats->Write(fileout);
+        WriteCompactDoubles(ss, buckets);
+        feeStats->Write(ss);
+        shortStats->Write(ss);
+        longStats->Write(ss);
+        WriteCompactSize(fileout, ss.size());
+        fileout.write(ss.data(), ss.size());
     }
     catch (const std::exception&) {
         LogPrintf("CBlockPolicyEstimator::Write(): unable to write policy estimator data (non-fatal)\n");
@@ -923,6 +1125,7 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 bool CBlockPolicyEstimator::Read(CAutoFile& filein)
 {
     try {
+        ProcessQueue();
         LOCK(cs_feeEstimator);
         int nVersionRequired, nVersionThatWrote;
         unsigned int nFileBestSeenHeight, nFileHistoricalFirst, nFileHistoricalBest;
@@ -932,18 +1135,36 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
 
         // Read fee estimates file into temporary variables so existing data
         // structures aren't corrupted if there is an exception.
-        filein >> nFileBestSeenHeight;
+        const bool fCompact = nVersionRequired >= FEE_ESTIMATES_COMPACT_VERSION;
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        if (fCompact) {
+            // Read everything at once and parse it from memory
+            std::vector<char> vData(ReadCompactSize(filein));
+            filein.read(vData.data(), vData.size());
+            ss = CDataStream(vData, SER_DISK, CLIENT_VERSION);
+            ss >> nFileBestSeenHeight;
+        } else {
+            filein >> nFileBestSeenHeight;
+        }
 
         if (nVersionRequired < 140100) {
             LogPrintf("%s: incompatible old fee estimation data (non-fatal). Version: %d\n", __func__, nVersionRequired);
         } else { // New format introduced in 140100
             unsigned int nFileHistoricalFirst, nFileHistoricalBest;
-            filein >> nFileHistoricalFirst >> nFileHistoricalBest;
+            if (fCompact) {
+                ss >> nFileHistoricalFirst >> nFileHistoricalBest;
+            } else {
+                filein >> nFileHistoricalFirst >> nFileHistoricalBest;
+            }
             if (nFileHistoricalFirst > nFileHistoricalBest || nFileHistoricalBest > nFileBestSeenHeight) {
                 throw std::runtime_error("Corrupt estimates file. Historical block range for estimates is invalid");
             }
             std::vector<double> fileBuckets;
-            filein >> fileBuckets;
+            if (fCompact) {
+                ReadCompactDoubles(ss, fileBuckets, 1000);
+            } else {
+                filein >> fileBuckets;
+            }
             size_t numBuckets = fileBuckets.size();
             if (numBuckets <= 1 || numBuckets > 1000)
                 throw std::runtime_error("Corrupt estimates file. Must have between 2 and 1000 feerate buckets");
@@ -951,9 +1172,15 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             std::unique_ptr<TxConfirmStats> fileFeeStats(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
             std::unique_ptr<TxConfirmStats> fileShortStats(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
             std::unique_ptr<TxConfirmStats> fileLongStats(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
-            fileFeeStats->Read(filein, nVersionThatWrote, numBuckets);
-            fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
-            fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
+            if (fCompact) {
+                fileFeeStats->ReadCompact(ss, numBuckets);
+                fileShortStats->ReadCompact(ss, numBuckets);
+                fileLongStats->ReadCompact(ss, numBuckets);
+            } else {
+                fileFeeStats->Read(filein, nVersionThatWrote, numBuckets);
+                fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
+                fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
+            }
 
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
@@ -982,12 +1209,13 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
 
 void CBlockPolicyEstimator::FlushUnconfirmed() {
     int64_t startclear = GetTimeMicros();
+    ProcessQueue();
     LOCK(cs_feeEstimator);
     size_t num_entries = mapMemPoolTxs.size();
     // Remove every entry in mapMemPoolTxs
     while (!mapMemPoolTxs.empty()) {
         auto mi = mapMemPoolTxs.begin();
-        removeTx(mi->first, false); // this calls erase() on mapMemPoolTxs
+        removeTxInternal(mi->first, false); // this calls erase() on mapMemPoolTxs
     }
     int64_t endclear = GetTimeMicros();
     LogPrint(BCLog::ESTIMATEFEE, "Recorded %u unconfirmed txs from mempool in %ld micros\n", num_entries, endclear - startclear);
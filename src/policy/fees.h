@@ -16,6 +16,9 @@
 #include <string>
 #include <vector>
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
 class CAutoFile;
 class CFeeRate;
 class CTxMemPoolEntry;
@@ -134,6 +137,11 @@ struct FeeCalculation
  *  We want to be able to estimate feerates that are needed on tx's to be included in
  * a certain number of blocks.  Every time a block is added to the best chain, this class records
  * stats on the transactions included in that block
+ *
+ * The mempool notifies the estimator about every added and removed transaction and every block while holding its
+ * lock. While ThreadMain() is running, these notifications only queue up the little data the estimator needs and
+ * the stats are updated in the background. Everything reading the stats processes the pending events first, so the
+ * results are the same as if they had been processed right away.
  */
 class CBlockPolicyEstimator
 {
@@ -199,7 +207,10 @@ public:
     void processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate);
 
     /** Remove a transaction from the mempool tracking stats*/
-    bool removeTx(uint256 hash, bool inBlock);
+    void removeTx(uint256 hash, bool inBlock);
+
+    /** Process the events queued by the functions above in the background until interrupted */
+    void ThreadMain();
 
     /** DEPRECATED. Return a feerate estimate */
     CFeeRate estimateFee(int confTarget) const;
@@ -217,10 +228,10 @@ public:
      */
     CFeeRate estimateRawFee(int confTarget, double successThreshold, FeeEstimateHorizon horizon, EstimationResult *result = nullptr) const;
 
-    /** Write estimation data to a file */
+    /** Write estimation data to a file, always in the compact format */
     bool Write(CAutoFile& fileout) const;
 
-    /** Read estimation data from a file */
+    /** Read estimation data from a file, in either the compact or the old format */
     bool Read(CAutoFile& filein);
 
     /** Empty mempool transactions on shutdown to record failure to confirm for txs still in mempool */
@@ -258,8 +269,41 @@ private:
 
     mutable CCriticalSection cs_feeEstimator;
 
+    /** What the estimator needs to know about a mempool entry */
+    struct TxInfo
+    {
+        uint256 hash;
+        unsigned int nHeight;
+        double feeRate; //!< per kB
+    };
+    static TxInfo MakeTxInfo(const CTxMemPoolEntry& entry);
+
+    struct Event
+    {
+        enum Type { TX_ADDED, TX_REMOVED, BLOCK } type;
+        bool fFlag; //!< validFeeEstimate for TX_ADDED, inBlock for TX_REMOVED
+        unsigned int nBlockHeight;
+        TxInfo tx;
+        std::vector<TxInfo> vBlockTxs;
+    };
+
+    boost::mutex queueMutex;
+    boost::condition_variable queueCond;
+    std::vector<Event> vQueue;
+    bool fAsync{false}; //!< Whether ThreadMain() is running, protected by queueMutex
+
+    /** Queue the event, or process it right away if ThreadMain() isn't running */
+    void PushEvent(Event&& ev);
+    /** Process all queued events. Const as it's called by the estimation functions,
+     *  the data they return is unaffected by whether events are processed or only queued */
+    void ProcessQueue() const;
+
+    void processBlockInternal(unsigned int nBlockHeight, const std::vector<TxInfo>& txs);
+    void processTransactionInternal(const TxInfo& tx, bool validFeeEstimate);
+    bool removeTxInternal(const uint256& hash, bool inBlock);
+
     /** Process a transaction confirmed in a block*/
-    bool processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry);
+    bool processBlockTx(unsigned int nBlockHeight, const TxInfo& tx);
 
     /** Helper for estimateSmartFee */
     double estimateCombinedFee(unsigned int confTarget, double successThreshold, bool checkShorterHorizon, EstimationResult *result) const;
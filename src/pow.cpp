@@ -98,7 +98,10 @@ unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const Consens
             bnPastTargetAvg = bnTarget;
         } else {
             // NOTE: that's not an average really...
-            bnPastTargetAvg = (bnPastTargetAvg * nCountBlocks + bnTarget) / (nCountBlocks + 1);
+            // (bnPastTargetAvg * nCountBlocks + bnTarget) / (nCountBlocks + 1), without the slow generic division
+            bnPastTargetAvg *= nCountBlocks;
+            bnPastTargetAvg += bnTarget;
+            bnPastTargetAvg.DivideBy(nCountBlocks + 1);
         }
 
         if(nCountBlocks != nPastBlocks) {
@@ -120,7 +123,7 @@ unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const Consens
 
     // Retarget
     bnNew *= nActualTimespan;
-    bnNew /= nTargetTimespan;
+    bnNew.DivideBy(nTargetTimespan);
 
     if (bnNew > bnPowLimit) {
         bnNew = bnPowLimit;
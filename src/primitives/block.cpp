@@ -19,6 +19,26 @@ uint256 CBlockHeader::GetHash() const
     return HashX11((const char *)vch.data(), (const char *)vch.data() + vch.size());
 }
 
+std::vector<uint256> GetBlockHeaderHashes(const std::vector<CBlockHeader>& headers)
+{
+    std::vector<uint256> hashes(headers.size());
+    GetBlockHeaderHashes(headers.data(), headers.size(), hashes.data());
+    return hashes;
+}
+
+void GetBlockHeaderHashes(const CBlockHeader* headers, size_t count, uint256* hashesOut)
+{
+    static const size_t HEADER_SIZE = 80;
+    std::vector<unsigned char> vch;
+    vch.reserve(count * HEADER_SIZE);
+    CVectorWriter ss(SER_GETHASH, PROTOCOL_VERSION, vch, 0);
+    for (size_t i = 0; i < count; i++) {
+        ss << headers[i];
+    }
+
+    HashX11Batch(hashesOut, vch.data(), HEADER_SIZE, count);
+}
+
 std::string CBlock::ToString() const
 {
     std::stringstream s;
@@ -68,6 +68,12 @@ public:
     }
 };
 
+/** Compute the hashes of a batch of headers, serializing them into a single buffer
+ *  and hashing them with HashX11Batch instead of one allocation and X11 call per header. */
+std::vector<uint256> GetBlockHeaderHashes(const std::vector<CBlockHeader>& headers);
+/** The same for count headers, the hashes are written to hashesOut */
+void GetBlockHeaderHashes(const CBlockHeader* headers, size_t count, uint256* hashesOut);
+
 
 class CBlock : public CBlockHeader
 {
@@ -94,9 +100,19 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITEAS(CBlockHeader, *this);
+        SerializationOpTransactions(s, ser_action);
+    }
+
+    template <typename Stream>
+    inline void SerializationOpTransactions(Stream& s, CSerActionSerialize ser_action) {
         READWRITE(vtx);
     }
 
+    template <typename Stream>
+    inline void SerializationOpTransactions(Stream& s, CSerActionUnserialize ser_action) {
+        UnserializeTransactions(s, vtx);
+    }
+
     void SetNull()
     {
         CBlockHeader::SetNull();
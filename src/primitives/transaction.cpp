@@ -90,10 +90,35 @@ uint256 CTransaction::ComputeHash() const
     return SerializeHash(*this);
 }
 
+unsigned int CTransaction::ComputeTotalSize() const
+{
+    // the template, the overload for CSizeComputer returns nTotalSize
+    CSizeComputer s(SER_NETWORK, PROTOCOL_VERSION);
+    Serialize<CSizeComputer>(s);
+    return s.size();
+}
+
 /* For backward compatibility, the hash is initialized to 0. TODO: remove the need for this default constructor entirely. */
-CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nType(TRANSACTION_NORMAL), nLockTime(0), hash() {}
-CTransaction::CTransaction(const CMutableTransaction &tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(tx.vExtraPayload), hash(ComputeHash()) {}
-CTransaction::CTransaction(CMutableTransaction &&tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(tx.vExtraPayload), hash(ComputeHash()) {}
+CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nType(TRANSACTION_NORMAL), nLockTime(0), hash(), nTotalSize(ComputeTotalSize()) {}
+CTransaction::CTransaction(const CMutableTransaction &tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(tx.vExtraPayload), hash(ComputeHash()), nTotalSize(ComputeTotalSize()) {}
+CTransaction::CTransaction(CMutableTransaction &&tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(tx.vExtraPayload), hash(ComputeHash()), nTotalSize(ComputeTotalSize()) {}
+CTransaction::CTransaction(CMutableTransaction &&tx, const uint256& hashIn) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nType(tx.nType), nLockTime(tx.nLockTime), vExtraPayload(std::move(tx.vExtraPayload)), hash(hashIn), nTotalSize(ComputeTotalSize()) {}
+
+std::vector<CTransactionRef> MakeTransactionRefs(std::vector<CMutableTransaction>&& vMtx)
+{
+    CHash256Batch batch;
+    for (const auto& mtx : vMtx) {
+        batch.Add(mtx);
+    }
+    auto vHashes = batch.Finalize();
+
+    std::vector<CTransactionRef> vtx;
+    vtx.reserve(vMtx.size());
+    for (size_t i = 0; i < vMtx.size(); i++) {
+        vtx.emplace_back(std::make_shared<const CTransaction>(std::move(vMtx[i]), vHashes[i]));
+    }
+    return vtx;
+}
 
 CAmount CTransaction::GetValueOut() const
 {
@@ -108,7 +133,7 @@ CAmount CTransaction::GetValueOut() const
 
 unsigned int CTransaction::GetTotalSize() const
 {
-    return ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
+    return nTotalSize;
 }
 
 std::string CTransaction::ToString() const
@@ -219,8 +219,11 @@ public:
 private:
     /** Memory only. */
     const uint256 hash;
+    /** Memory only, the size of the serialization (which is the same for all types and versions). */
+    const unsigned int nTotalSize;
 
     uint256 ComputeHash() const;
+    unsigned int ComputeTotalSize() const;
 
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
@@ -229,6 +232,8 @@ public:
     /** Convert a CMutableTransaction into a CTransaction. */
     CTransaction(const CMutableTransaction &tx);
     CTransaction(CMutableTransaction &&tx);
+    /** Convert a CMutableTransaction whose hash was computed already, hashIn must be tx.GetHash(). */
+    CTransaction(CMutableTransaction &&tx, const uint256& hashIn);
 
     template <typename Stream>
     inline void Serialize(Stream& s) const {
@@ -241,6 +246,12 @@ public:
             s << vExtraPayload;
     }
 
+    /** GetSerializeSize() without another serialization pass. */
+    void Serialize(CSizeComputer& s) const
+    {
+        s.seek(nTotalSize);
+    }
+
     /** This deserializing constructor is provided instead of an Unserialize method.
      *  Unserialize is not possible, since it would require overwriting const fields. */
     template <typename Stream>
@@ -343,6 +354,22 @@ typedef std::shared_ptr<const CTransaction> CTransactionRef;
 static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
 template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
 
+/** Convert many CMutableTransactions into CTransactionRefs, computing their hashes in one batch with CHash256Batch. */
+std::vector<CTransactionRef> MakeTransactionRefs(std::vector<CMutableTransaction>&& vMtx);
+
+/** Unserialize a vector of transactions like `s >> vtx` does, but hash all of them in one batch. */
+template <typename Stream>
+void UnserializeTransactions(Stream& s, std::vector<CTransactionRef>& vtx)
+{
+    unsigned int nSize = ReadCompactSize(s);
+    // nSize isn't trusted for the allocation, vMtx grows while the transactions are read
+    std::vector<CMutableTransaction> vMtx;
+    for (unsigned int i = 0; i < nSize; i++) {
+        vMtx.emplace_back(deserialize, s);
+    }
+    vtx = MakeTransactionRefs(std::move(vMtx));
+}
+
 /** Implementation of BIP69
  * https://github.com/bitcoin/bips/blob/master/bip-0069.mediawiki
  */
@@ -11,6 +11,9 @@
 #include <QTimer>
 #include <QWidget>
 
+class MasternodeFilterProxyModel;
+class MasternodeTableModel;
+
 #define MASTERNODELIST_UPDATE_SECONDS 3
 #define MASTERNODELIST_FILTER_COOLDOWN_SECONDS 3
 
@@ -35,21 +38,6 @@ public:
     explicit MasternodeList(QWidget* parent = 0);
     ~MasternodeList();
 
-    enum {
-        COLUMN_SERVICE,
-        COLUMN_STATUS,
-        COLUMN_POSE,
-        COLUMN_REGISTERED,
-        COLUMN_LAST_PAYMENT,
-        COLUMN_NEXT_PAYMENT,
-        COLUMN_PAYOUT_ADDRESS,
-        COLUMN_OPERATOR_REWARD,
-        COLUMN_COLLATERAL_ADDRESS,
-        COLUMN_OWNER_ADDRESS,
-        COLUMN_VOTING_ADDRESS,
-        COLUMN_PROTX_HASH,
-    };
-
     void setClientModel(ClientModel* clientModel);
     void setWalletModel(WalletModel* walletModel);
 
@@ -63,8 +51,10 @@ private:
     Ui::MasternodeList* ui;
     ClientModel* clientModel;
     WalletModel* walletModel;
+    MasternodeTableModel* masternodeModel;
+    MasternodeFilterProxyModel* proxyModel;
 
-    // Protects tableWidgetMasternodesDIP3
+    // Protects masternodeModel and proxyModel
     CCriticalSection cs_dip3list;
 
     QString strCurrentFilterDIP3;
@@ -0,0 +1,241 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qt/masternodetablemodel.h>
+
+#include <coins.h>
+#include <interfaces/node.h>
+#include <key_io.h>
+#include <script/standard.h>
+
+#include <QByteArray>
+
+MasternodeTableModel::MasternodeTableModel(interfaces::Node& node, QObject* parent) :
+    QAbstractTableModel(parent),
+    m_node(node)
+{
+    columns << tr("Service") << tr("Status") << tr("PoSe Score") << tr("Registered") << tr("Last Paid")
+            << tr("Next Payment") << tr("Payout Address") << tr("Operator Reward") << tr("Collateral Address")
+            << tr("Owner Address") << tr("Voting Address");
+}
+
+void MasternodeTableModel::setMasternodeList(const CDeterministicMNList& mnList)
+{
+    // Removed masternodes, from the end so that the positions of the remaining ones don't change while removing
+    for (size_t i = rows.size(); i-- > 0;) {
+        if (!mnList.HasMN(rows[i].dmn->proTxHash)) {
+            beginRemoveRows(QModelIndex(), i, i);
+            mapRows.erase(rows[i].dmn->proTxHash);
+            mapCollateralAddresses.erase(rows[i].dmn->proTxHash);
+            rows.erase(rows.begin() + i);
+            endRemoveRows();
+        }
+    }
+    for (size_t i = 0; i < rows.size(); i++) {
+        mapRows[rows[i].dmn->proTxHash] = i;
+    }
+
+    // Changed masternodes get a new object in the list, the unchanged ones still share theirs with the previous list
+    std::vector<CDeterministicMNCPtr> vecAdded;
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        auto it = mapRows.find(dmn->proTxHash);
+        if (it == mapRows.end()) {
+            vecAdded.emplace_back(dmn);
+            return;
+        }
+        Row& row = rows[it->second];
+        if (row.dmn != dmn) {
+            row.dmn = dmn;
+            row.fFormatted = false;
+            Q_EMIT dataChanged(index(it->second, 0), index(it->second, ColumnCount - 1));
+        }
+    });
+
+    if (!vecAdded.empty()) {
+        beginInsertRows(QModelIndex(), rows.size(), rows.size() + vecAdded.size() - 1);
+        for (const auto& dmn : vecAdded) {
+            mapRows.emplace(dmn->proTxHash, rows.size());
+            rows.emplace_back();
+            rows.back().dmn = dmn;
+        }
+        endInsertRows();
+    }
+
+    // The collateral addresses of the new masternodes (and of those for which the lookup failed before)
+    for (const auto& row : rows) {
+        if (mapCollateralAddresses.count(row.dmn->proTxHash)) {
+            continue;
+        }
+        CTxDestination collateralDest;
+        Coin coin;
+        if (m_node.getUnspentOutput(row.dmn->collateralOutpoint, coin) && ExtractDestination(coin.out.scriptPubKey, collateralDest)) {
+            mapCollateralAddresses.emplace(row.dmn->proTxHash, QString::fromStdString(EncodeDestination(collateralDest)));
+            Q_EMIT dataChanged(index(mapRows[row.dmn->proTxHash], CollateralAddress), index(mapRows[row.dmn->proTxHash], CollateralAddress));
+        }
+    }
+
+    // The projected payments move with every block
+    std::map<uint256, int> nextPayments;
+    auto projectedPayees = mnList.GetProjectedMNPayees(mnList.GetValidMNsCount());
+    for (size_t i = 0; i < projectedPayees.size(); i++) {
+        nextPayments.emplace(projectedPayees[i]->proTxHash, mnList.GetHeight() + (int)i + 1);
+    }
+    bool fNextPaymentsChanged = false;
+    for (auto& row : rows) {
+        auto it = nextPayments.find(row.dmn->proTxHash);
+        int nNextPayment = it != nextPayments.end() ? it->second : 0;
+        if (row.nNextPayment != nNextPayment) {
+            row.nNextPayment = nNextPayment;
+            fNextPaymentsChanged = true;
+        }
+    }
+    if (fNextPaymentsChanged && !rows.empty()) {
+        Q_EMIT dataChanged(index(0, NextPayment), index(rows.size() - 1, NextPayment));
+    }
+}
+
+int MasternodeTableModel::rowCount(const QModelIndex& parent) const
+{
+    Q_UNUSED(parent);
+    return rows.size();
+}
+
+int MasternodeTableModel::columnCount(const QModelIndex& parent) const
+{
+    Q_UNUSED(parent);
+    return ColumnCount;
+}
+
+void MasternodeTableModel::formatRow(const Row& row) const
+{
+    const auto& dmn = row.dmn;
+    row.strService = QString::fromStdString(dmn->pdmnState->addr.ToString());
+
+    CTxDestination payeeDest;
+    row.strPayee = tr("UNKNOWN");
+    if (ExtractDestination(dmn->pdmnState->scriptPayout, payeeDest)) {
+        row.strPayee = QString::fromStdString(EncodeDestination(payeeDest));
+    }
+
+    row.strOperatorReward = tr("NONE");
+    if (dmn->nOperatorReward) {
+        row.strOperatorReward = QString::number(dmn->nOperatorReward / 100.0, 'f', 2) + "% ";
+
+        if (dmn->pdmnState->scriptOperatorPayout != CScript()) {
+            CTxDestination operatorDest;
+            if (ExtractDestination(dmn->pdmnState->scriptOperatorPayout, operatorDest)) {
+                row.strOperatorReward += tr("to %1").arg(QString::fromStdString(EncodeDestination(operatorDest)));
+            } else {
+                row.strOperatorReward += tr("to UNKNOWN");
+            }
+        } else {
+            row.strOperatorReward += tr("but not claimed");
+        }
+    }
+
+    row.strOwner = QString::fromStdString(EncodeDestination(dmn->pdmnState->keyIDOwner));
+    row.strVoting = QString::fromStdString(EncodeDestination(dmn->pdmnState->keyIDVoting));
+    row.fFormatted = true;
+}
+
+QVariant MasternodeTableModel::displayData(const Row& row, int column) const
+{
+    const auto& dmn = row.dmn;
+    switch (column) {
+    case Service:
+        return row.strService;
+    case Status:
+        return CDeterministicMNList::IsMNValid(dmn) ? tr("ENABLED") : (CDeterministicMNList::IsMNPoSeBanned(dmn) ? tr("POSE_BANNED") : tr("UNKNOWN"));
+    case PoSeScore:
+        return QString::number(dmn->pdmnState->nPoSePenalty);
+    case Registered:
+        return QString::number(dmn->pdmnState->nRegisteredHeight);
+    case LastPayment:
+        return QString::number(dmn->pdmnState->nLastPaidHeight);
+    case NextPayment:
+        return row.nNextPayment ? QString::number(row.nNextPayment) : QString("UNKNOWN");
+    case PayoutAddress:
+        return row.strPayee;
+    case OperatorReward:
+        return row.strOperatorReward;
+    case CollateralAddress: {
+        auto it = mapCollateralAddresses.find(dmn->proTxHash);
+        return it != mapCollateralAddresses.end() ? it->second : tr("UNKNOWN");
+    }
+    case OwnerAddress:
+        return row.strOwner;
+    case VotingAddress:
+        return row.strVoting;
+    }
+    return QVariant();
+}
+
+QVariant MasternodeTableModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= (int)rows.size()) {
+        return QVariant();
+    }
+
+    const Row& row = rows[index.row()];
+    if (!row.fFormatted) {
+        formatRow(row);
+    }
+
+    if (role == Qt::DisplayRole) {
+        return displayData(row, index.column());
+    } else if (role == SortRole) {
+        switch (index.column()) {
+        case Service: {
+            auto addr_key = row.dmn->pdmnState->addr.GetKey();
+            return QByteArray(reinterpret_cast<const char*>(addr_key.data()), addr_key.size());
+        }
+        case PoSeScore:
+            return row.dmn->pdmnState->nPoSePenalty;
+        case Registered:
+            return row.dmn->pdmnState->nRegisteredHeight;
+        case LastPayment:
+            return row.dmn->pdmnState->nLastPaidHeight;
+        case NextPayment:
+            return row.nNextPayment;
+        case OperatorReward:
+            return row.dmn->nOperatorReward;
+        default:
+            return displayData(row, index.column());
+        }
+    } else if (role == ProTxHashRole) {
+        return QString::fromStdString(row.dmn->proTxHash.ToString());
+    }
+    return QVariant();
+}
+
+QVariant MasternodeTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section < columns.size()) {
+        return columns[section];
+    }
+    return QVariant();
+}
+
+void MasternodeFilterProxyModel::setProTxHashFilter(bool fEnabled, const std::set<uint256>& setProTxHashesIn)
+{
+    if (fProTxHashFilter == fEnabled && setProTxHashes == setProTxHashesIn) {
+        return;
+    }
+    fProTxHashFilter = fEnabled;
+    setProTxHashes = setProTxHashesIn;
+    invalidateFilter();
+}
+
+bool MasternodeFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const
+{
+    if (fProTxHashFilter) {
+        QModelIndex idx = sourceModel()->index(sourceRow, 0, sourceParent);
+        uint256 proTxHash;
+        proTxHash.SetHex(sourceModel()->data(idx, MasternodeTableModel::ProTxHashRole).toString().toStdString());
+        if (!setProTxHashes.count(proTxHash)) {
+            return false;
+        }
+    }
+    return QSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent);
+}
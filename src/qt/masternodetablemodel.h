@@ -0,0 +1,107 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_QT_MASTERNODETABLEMODEL_H
+#define BITCOIN_QT_MASTERNODETABLEMODEL_H
+
+#include <evo/deterministicmns.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include <QAbstractTableModel>
+#include <QSortFilterProxyModel>
+#include <QStringList>
+
+namespace interfaces {
+    class Node;
+}
+
+/**
+   Qt model of the deterministic masternode list. Updates only touch the rows of the masternodes which were added,
+   removed or changed since the previous list, the strings of a row are formatted when they are first shown.
+ */
+class MasternodeTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit MasternodeTableModel(interfaces::Node& node, QObject* parent = 0);
+
+    enum ColumnIndex {
+        Service = 0,
+        Status,
+        PoSeScore,
+        Registered,
+        LastPayment,
+        NextPayment,
+        PayoutAddress,
+        OperatorReward,
+        CollateralAddress,
+        OwnerAddress,
+        VotingAddress,
+        ColumnCount
+    };
+
+    enum RoleIndex {
+        /** Value to sort the column by */
+        SortRole = Qt::UserRole,
+        /** proTxHash of the row as hex string */
+        ProTxHashRole
+    };
+
+    /** Apply the changes to the previous list */
+    void setMasternodeList(const CDeterministicMNList& mnList);
+
+    /** @name Methods overridden from QAbstractTableModel
+        @{*/
+    int rowCount(const QModelIndex& parent) const;
+    int columnCount(const QModelIndex& parent) const;
+    QVariant data(const QModelIndex& index, int role) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+    /*@}*/
+
+private:
+    struct Row {
+        CDeterministicMNCPtr dmn;
+        int nNextPayment{0};
+        // Formatted on first use and cleared when the masternode changes
+        mutable bool fFormatted{false};
+        mutable QString strService;
+        mutable QString strPayee;
+        mutable QString strOperatorReward;
+        mutable QString strOwner;
+        mutable QString strVoting;
+    };
+
+    interfaces::Node& m_node;
+    QStringList columns;
+    std::vector<Row> rows;
+    std::map<uint256, size_t> mapRows;
+    // The collateral of a masternode never changes, so its address is only looked up once
+    std::map<uint256, QString> mapCollateralAddresses;
+
+    void formatRow(const Row& row) const;
+    QVariant displayData(const Row& row, int column) const;
+};
+
+/** Filters the masternode list by the text of any column and optionally by a set of masternodes */
+class MasternodeFilterProxyModel : public QSortFilterProxyModel
+{
+public:
+    explicit MasternodeFilterProxyModel(QObject* parent = 0) : QSortFilterProxyModel(parent) {}
+
+    /** Only show the masternodes with the given proTxHashes, fEnabled = false shows all of them again */
+    void setProTxHashFilter(bool fEnabled, const std::set<uint256>& setProTxHashesIn);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const;
+
+private:
+    bool fProTxHashFilter{false};
+    std::set<uint256> setProTxHashes;
+};
+
+#endif // BITCOIN_QT_MASTERNODETABLEMODEL_H
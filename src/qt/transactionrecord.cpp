@@ -142,13 +142,13 @@ QList<TransactionRecord> TransactionRecord::decomposeTransaction(interfaces::Wal
                     if (wtx.tx->vout.size() == 2) {
                         CAmount nAmount0 = wtx.tx->vout[0].nValue;
                         CAmount nAmount1 = wtx.tx->vout[1].nValue;
-                        // <case1>, see CCoinJoinClientSession::MakeCollateralAmounts
+                        // <case1>, see CCoinJoinClientManager::MakeCollateralAmounts
                         fMakeCollateral = (nAmount0 == coinJoinOptions.getMaxCollateralAmount() && !coinJoinOptions.isDenominated(nAmount1) && nAmount1 >= coinJoinOptions.getMinCollateralAmount()) ||
                                           (nAmount1 == coinJoinOptions.getMaxCollateralAmount() && !coinJoinOptions.isDenominated(nAmount0) && nAmount0 >= coinJoinOptions.getMinCollateralAmount()) ||
-                        // <case2>, see CCoinJoinClientSession::MakeCollateralAmounts
+                        // <case2>, see CCoinJoinClientManager::MakeCollateralAmounts
                                           (nAmount0 == nAmount1 && coinJoinOptions.isCollateralAmount(nAmount0));
                     } else if (wtx.tx->vout.size() == 1) {
-                        // <case3>, see CCoinJoinClientSession::MakeCollateralAmounts
+                        // <case3>, see CCoinJoinClientManager::MakeCollateralAmounts
                         fMakeCollateral = coinJoinOptions.isCollateralAmount(wtx.tx->vout[0].nValue);
                     }
                     if (fMakeCollateral) {
@@ -23,6 +23,18 @@
 #include <QDebug>
 #include <QIcon>
 #include <QList>
+#include <QTimer>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+/** How long notified transaction changes are collected before the GUI applies them together */
+static const int TRANSACTION_BATCH_DELAY_MS = 100;
+/** Above this many new records a batch is merged into the model at once instead of row by row */
+static const int TRANSACTION_BULK_INSERT_THRESHOLD = 100;
+/** Number of new transactions of one batch which still get a notification balloon */
+static const int TRANSACTION_MAX_NOTIFICATIONS = 10;
 
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
@@ -51,6 +63,14 @@ struct TxLessThan
     }
 };
 
+// A change notified by the wallet, waiting to be applied by the GUI thread
+struct PendingTransactionChange
+{
+    uint256 hash;
+    int status;
+    bool showTransaction;
+};
+
 // Private implementation
 class TransactionTablePriv
 {
@@ -62,6 +82,13 @@ public:
 
     TransactionTableModel *parent;
 
+    /* Changes notified by the wallet which weren't applied yet. While fHoldPending is set (during a rescan)
+     * they are only collected.
+     */
+    CCriticalSection cs_pending;
+    std::vector<PendingTransactionChange> vPending;
+    bool fHoldPending{false};
+
     /* Local cache of wallet.
      * As it is in the same order as the CWallet, by definition
      * this is sorted by sha256.
@@ -169,6 +196,84 @@ public:
         }
     }
 
+    /* Apply a batch of changes. Multiple changes of the same transaction are coalesced into the last one, the status
+       updates result in a single dataChanged and many new transactions are merged into the model at once.
+     */
+    void updateWalletBatch(interfaces::Wallet& wallet, const std::vector<PendingTransactionChange>& vChanges)
+    {
+        std::vector<PendingTransactionChange> vCoalesced;
+        std::map<uint256, size_t> mapPositions;
+        for (const auto& change : vChanges) {
+            auto it = mapPositions.find(change.hash);
+            if (it == mapPositions.end()) {
+                mapPositions.emplace(change.hash, vCoalesced.size());
+                vCoalesced.push_back(change);
+            } else {
+                vCoalesced[it->second] = change;
+            }
+        }
+
+        std::vector<uint256> vAdded;
+        std::vector<uint256> vDeleted;
+        int nUpdatedMin = cachedWallet.size();
+        int nUpdatedMax = -1;
+        for (const auto& change : vCoalesced) {
+            QList<TransactionRecord>::iterator lower = qLowerBound(
+                cachedWallet.begin(), cachedWallet.end(), change.hash, TxLessThan());
+            QList<TransactionRecord>::iterator upper = qUpperBound(
+                cachedWallet.begin(), cachedWallet.end(), change.hash, TxLessThan());
+            bool inModel = (lower != upper);
+            if (inModel && (change.status == CT_DELETED || !change.showTransaction)) {
+                vDeleted.push_back(change.hash);
+            } else if (!inModel && change.status != CT_DELETED && change.showTransaction) {
+                vAdded.push_back(change.hash);
+            } else if (inModel) {
+                for (auto it = lower; it != upper; ++it) {
+                    it->status.needsUpdate = true;
+                }
+                nUpdatedMin = std::min(nUpdatedMin, (int)(lower - cachedWallet.begin()));
+                nUpdatedMax = std::max(nUpdatedMax, (int)(upper - cachedWallet.begin()) - 1);
+            }
+        }
+
+        if (nUpdatedMax >= nUpdatedMin) {
+            Q_EMIT parent->dataChanged(parent->index(nUpdatedMin, TransactionTableModel::Status), parent->index(nUpdatedMax, TransactionTableModel::Status));
+        }
+
+        for (const auto& hash : vDeleted) {
+            updateWallet(wallet, hash, CT_DELETED, false);
+        }
+
+        // Only the last few new transactions are announced, the others are added without balloons
+        size_t nQuiet = vAdded.size() > (size_t)TRANSACTION_MAX_NOTIFICATIONS ? vAdded.size() - TRANSACTION_MAX_NOTIFICATIONS : 0;
+        QList<TransactionRecord> toInsert;
+        for (size_t i = 0; i < nQuiet; i++) {
+            interfaces::WalletTx wtx = wallet.getWalletTx(vAdded[i]);
+            if (wtx.tx) {
+                toInsert.append(TransactionRecord::decomposeTransaction(wallet, wtx));
+            }
+        }
+        if (toInsert.size() > TRANSACTION_BULK_INSERT_THRESHOLD) {
+            // The records of a transaction stay in their order, which is all the model requires within one hash
+            std::stable_sort(toInsert.begin(), toInsert.end(), TxLessThan());
+            QList<TransactionRecord> merged;
+            merged.reserve(cachedWallet.size() + toInsert.size());
+            std::merge(cachedWallet.begin(), cachedWallet.end(), toInsert.begin(), toInsert.end(), std::back_inserter(merged), TxLessThan());
+            parent->beginResetModel();
+            cachedWallet.swap(merged);
+            parent->endResetModel();
+        } else if (nQuiet > 0) {
+            parent->fProcessingQueuedTransactions = true;
+            for (size_t i = 0; i < nQuiet; i++) {
+                updateWallet(wallet, vAdded[i], CT_NEW, true);
+            }
+        }
+        parent->fProcessingQueuedTransactions = false;
+        for (size_t i = nQuiet; i < vAdded.size(); i++) {
+            updateWallet(wallet, vAdded[i], CT_NEW, true);
+        }
+    }
+
     void updateAddressBook(interfaces::Wallet& wallet, const QString& address, const QString& label, bool isMine, const QString& purpose, int status)
     {
         std::string address2 = address.toStdString();
@@ -233,6 +338,11 @@ TransactionTableModel::TransactionTableModel(WalletModel *parent):
         fProcessingQueuedTransactions(false),
         cachedChainLockHeight(-1)
 {
+    pendingTimer = new QTimer(this);
+    pendingTimer->setSingleShot(true);
+    pendingTimer->setInterval(TRANSACTION_BATCH_DELAY_MS);
+    connect(pendingTimer, SIGNAL(timeout()), this, SLOT(processPendingTransactions()));
+
     columns << QString() << QString() << tr("Date") << tr("Type") << tr("Address / Label") << BitcoinUnits::getAmountColumnTitle(walletModel->getOptionsModel()->getDisplayUnit());
     priv->refreshWallet(walletModel->wallet());
 
@@ -262,6 +372,38 @@ void TransactionTableModel::updateTransaction(const QString &hash, int status, b
     priv->updateWallet(walletModel->wallet(), updated, status, showTransaction);
 }
 
+void TransactionTableModel::enqueueTransactionChange(const uint256& hash, int status, bool showTransaction)
+{
+    LOCK(priv->cs_pending);
+    priv->vPending.push_back({hash, status, showTransaction});
+    // The first change of a batch starts the timer, the following ones only join it
+    if (priv->vPending.size() == 1 && !priv->fHoldPending) {
+        QMetaObject::invokeMethod(pendingTimer, "start", Qt::QueuedConnection);
+    }
+}
+
+void TransactionTableModel::holdTransactionChanges(bool fHold)
+{
+    LOCK(priv->cs_pending);
+    priv->fHoldPending = fHold;
+    if (!fHold && !priv->vPending.empty()) {
+        QMetaObject::invokeMethod(pendingTimer, "start", Qt::QueuedConnection);
+    }
+}
+
+void TransactionTableModel::processPendingTransactions()
+{
+    std::vector<PendingTransactionChange> vChanges;
+    {
+        LOCK(priv->cs_pending);
+        if (priv->fHoldPending) {
+            return;
+        }
+        vChanges.swap(priv->vPending);
+    }
+    priv->updateWalletBatch(walletModel->wallet(), vChanges);
+}
+
 void TransactionTableModel::updateAddressBook(const QString& address, const QString& label, bool isMine,
                                               const QString& purpose, int status)
 {
@@ -740,46 +882,13 @@ void TransactionTableModel::updateDisplayUnit()
     Q_EMIT dataChanged(index(0, Amount), index(priv->size()-1, Amount));
 }
 
-// queue notifications to show a non freezing progress dialog e.g. for rescan
-struct TransactionNotification
-{
-public:
-    TransactionNotification() {}
-    TransactionNotification(uint256 _hash, ChangeType _status, bool _showTransaction):
-        hash(_hash), status(_status), showTransaction(_showTransaction) {}
-
-    void invoke(QObject *ttm)
-    {
-        QString strHash = QString::fromStdString(hash.GetHex());
-        qDebug() << "NotifyTransactionChanged: " + strHash + " status= " + QString::number(status);
-        QMetaObject::invokeMethod(ttm, "updateTransaction", Qt::QueuedConnection,
-                                  Q_ARG(QString, strHash),
-                                  Q_ARG(int, status),
-                                  Q_ARG(bool, showTransaction));
-    }
-private:
-    uint256 hash;
-    ChangeType status;
-    bool showTransaction;
-};
-
-static bool fQueueNotifications = false;
-static std::vector< TransactionNotification > vQueueNotifications;
-
 static void NotifyTransactionChanged(TransactionTableModel *ttm, const uint256 &hash, ChangeType status)
 {
-    // Find transaction in wallet
     // Determine whether to show transaction or not (determine this here so that no relocking is needed in GUI thread)
     bool showTransaction = TransactionRecord::showTransaction();
+    qDebug() << "NotifyTransactionChanged: " + QString::fromStdString(hash.GetHex()) + " status= " + QString::number(status);
 
-    TransactionNotification notification(hash, status, showTransaction);
-
-    if (fQueueNotifications)
-    {
-        vQueueNotifications.push_back(notification);
-        return;
-    }
-    notification.invoke(ttm);
+    ttm->enqueueTransactionChange(hash, status, showTransaction);
 }
 
 static void NotifyAddressBookChanged(TransactionTableModel *ttm, const CTxDestination &address, const std::string &label, bool isMine, const std::string &purpose, ChangeType status)
@@ -792,24 +901,13 @@ static void NotifyAddressBookChanged(TransactionTableModel *ttm, const CTxDestin
                               Q_ARG(int, (int)status));
 }
 
+// hold the changes back during e.g. a rescan to show a non freezing progress dialog
 static void ShowProgress(TransactionTableModel *ttm, const std::string &title, int nProgress)
 {
-    if (nProgress == 0)
-        fQueueNotifications = true;
-
-    if (nProgress == 100)
-    {
-        fQueueNotifications = false;
-        if (vQueueNotifications.size() > 10) // prevent balloon spam, show maximum 10 balloons
-            QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, true));
-        for (unsigned int i = 0; i < vQueueNotifications.size(); ++i)
-        {
-            if (vQueueNotifications.size() - i <= 10)
-                QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, false));
-
-            vQueueNotifications[i].invoke(ttm);
-        }
-        std::vector<TransactionNotification >().swap(vQueueNotifications); // clear
+    if (nProgress == 0) {
+        ttm->holdTransactionChanges(true);
+    } else if (nProgress == 100) {
+        ttm->holdTransactionChanges(false);
     }
 }
 
@@ -19,6 +19,11 @@ class Handler;
 class TransactionRecord;
 class TransactionTablePriv;
 class WalletModel;
+class uint256;
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
 
 /** UI model for the transaction table of a wallet.
  */
@@ -86,6 +91,12 @@ public:
     void updateChainLockHeight(int chainLockHeight);
     int getChainLockHeight() const;
 
+    /** Queue a change of a wallet transaction, can be called from any thread. The queued changes are applied together
+        by the GUI thread shortly after the first one arrived. */
+    void enqueueTransactionChange(const uint256& hash, int status, bool showTransaction);
+    /** Only collect the changes until called again with false, e.g. during a rescan */
+    void holdTransactionChanges(bool fHold);
+
 private:
     WalletModel *walletModel;
     std::unique_ptr<interfaces::Handler> m_handler_transaction_changed;
@@ -95,6 +106,7 @@ private:
     TransactionTablePriv *priv;
     bool fProcessingQueuedTransactions;
     int cachedChainLockHeight;
+    QTimer* pendingTimer;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
@@ -123,6 +135,8 @@ public Q_SLOTS:
     void updateAmountColumnTitle();
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
+    /** Apply the queued transaction changes */
+    void processPendingTransactions();
 
     friend class TransactionTablePriv;
 };
@@ -0,0 +1,252 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <replica.h>
+
+#include <chainparamsbase.h>
+#include <tinyformat.h>
+#include <util.h>
+
+#include <set>
+#include <vector>
+
+#include <leveldb/db.h>
+#include <leveldb/env.h>
+
+bool fReadOnlyReplica = false;
+
+/** Attempts of snapshotting a database the primary replaced files of meanwhile */
+static const int REPLICA_SNAPSHOT_TRIES = 5;
+
+namespace {
+
+class CReplicaEnv : public leveldb::EnvWrapper
+{
+private:
+    /** Whether path is a hard link which may be shared with the primary */
+    static bool IsShared(const std::string& path)
+    {
+        boost::system::error_code ec;
+        return fs::hard_link_count(path, ec) > 1 && !ec;
+    }
+
+public:
+    CReplicaEnv() : leveldb::EnvWrapper(leveldb::Env::Default()) {}
+
+    leveldb::Status NewWritableFile(const std::string& f, leveldb::WritableFile** r) override
+    {
+        if (IsShared(f)) {
+            // a new file of ours with the number of a table of the primary we don't use
+            leveldb::Status s = target()->DeleteFile(f);
+            if (!s.ok()) {
+                return s;
+            }
+        }
+        return target()->NewWritableFile(f, r);
+    }
+
+    leveldb::Status NewAppendableFile(const std::string& f, leveldb::WritableFile** r) override
+    {
+        if (IsShared(f)) {
+            // copy on write
+            boost::system::error_code ec;
+            fs::copy_file(f, f + ".tmp", fs::copy_option::overwrite_if_exists, ec);
+            if (!ec) {
+                fs::rename(f + ".tmp", f, ec);
+            }
+            if (ec) {
+                return leveldb::Status::IOError(f, ec.message());
+            }
+        }
+        return target()->NewAppendableFile(f, r);
+    }
+};
+
+} // namespace
+
+leveldb::Env* GetReplicaEnv()
+{
+    static CReplicaEnv env;
+    return &env;
+}
+
+fs::path GetReplicaSourceDir()
+{
+    return fs::system_complete(gArgs.GetArg("-readonlyreplica", "")) / BaseParams().DataDir();
+}
+
+/** The LevelDB databases below dir, recognized by their CURRENT file, relative to dir */
+static void FindDatabases(const fs::path& dir, const fs::path& rel, int nDepth, std::vector<fs::path>& vRet)
+{
+    for (fs::directory_iterator it(dir); it != fs::directory_iterator(); ++it) {
+        if (!fs::is_directory(it->status())) {
+            continue;
+        }
+        fs::path name = it->path().filename();
+        if (fs::exists(it->path() / "CURRENT")) {
+            vRet.emplace_back(rel / name);
+        } else if (nDepth > 0) {
+            FindDatabases(it->path(), rel / name, nDepth - 1, vRet);
+        }
+    }
+}
+
+static bool ReadCurrentManifest(const fs::path& dir, std::string& strManifest)
+{
+    FILE* file = fsbridge::fopen(dir / "CURRENT", "rb");
+    if (!file) {
+        return false;
+    }
+    char buf[256];
+    size_t n = fread(buf, 1, sizeof(buf), file);
+    fclose(file);
+    strManifest.assign(buf, n);
+    while (!strManifest.empty() && (strManifest.back() == '\n' || strManifest.back() == '\r')) {
+        strManifest.pop_back();
+    }
+    return !strManifest.empty() && strManifest.find('/') == std::string::npos;
+}
+
+/** Link or copy the files of src with one of the extensions which dst doesn't have yet */
+static bool CopyDatabaseFiles(const fs::path& src, const fs::path& dst, const std::set<std::string>& setExt, bool fLink, std::string& strError)
+{
+    for (fs::directory_iterator it(src); it != fs::directory_iterator(); ++it) {
+        const fs::path& path = it->path();
+        if (!setExt.count(path.extension().string()) || fs::exists(dst / path.filename())) {
+            continue;
+        }
+        boost::system::error_code ec;
+        if (fLink) {
+            fs::create_hard_link(path, dst / path.filename(), ec);
+        } else {
+            fs::copy_file(path, dst / path.filename(), ec);
+        }
+        if (ec) {
+            if (!fs::exists(path)) {
+                // deleted by the primary meanwhile
+                return false;
+            }
+            strError = strprintf("Unable to %s %s to %s (%s)%s", fLink ? "link" : "copy", path.string(), dst.string(), ec.message(),
+                fLink ? ", the datadirs must be on the same filesystem" : "");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Snapshot a single database while the primary may be writing to it.
+ * The logs are copied before the manifest, so that they hold the writes up to some point after the state of the
+ * manifest, or it already covers them: any cut off at the end of the logs leaves a consistent earlier state. The
+ * tables are linked before and after the manifest is copied, as it may refer to tables which were written in
+ * between. It may also refer to tables the primary deleted before we got to them, which is found out by opening
+ * the snapshot.
+ * Returns false with an empty strError if the primary changed the database meanwhile.
+ */
+static bool TrySnapshotDatabase(const fs::path& src, const fs::path& dst, std::string& strError)
+{
+    static const std::set<std::string> setTables{".ldb", ".sst"};
+    static const std::set<std::string> setLogs{".log"};
+
+    fs::remove_all(dst);
+    fs::create_directories(dst);
+
+    if (!CopyDatabaseFiles(src, dst, setTables, true, strError) || !CopyDatabaseFiles(src, dst, setLogs, false, strError)) {
+        return false;
+    }
+
+    std::string strManifest;
+    if (!ReadCurrentManifest(src, strManifest)) {
+        strError = strprintf("Unable to read %s", (src / "CURRENT").string());
+        return false;
+    }
+    boost::system::error_code ec;
+    fs::copy_file(src / strManifest, dst / strManifest, ec);
+    if (ec) {
+        if (!fs::exists(src / strManifest)) {
+            return false;
+        }
+        strError = strprintf("Unable to copy %s (%s)", (src / strManifest).string(), ec.message());
+        return false;
+    }
+    FILE* file = fsbridge::fopen(dst / "CURRENT", "wb");
+    if (!file || fprintf(file, "%s\n", strManifest.c_str()) < 0 || fclose(file) != 0) {
+        strError = strprintf("Unable to write %s", (dst / "CURRENT").string());
+        return false;
+    }
+
+    if (!CopyDatabaseFiles(src, dst, setTables, true, strError)) {
+        return false;
+    }
+
+    leveldb::Options options;
+    options.env = GetReplicaEnv();
+    leveldb::DB* pdb = nullptr;
+    leveldb::Status status = leveldb::DB::Open(options, dst.string(), &pdb);
+    delete pdb;
+    if (!status.ok()) {
+        LogPrintf("Replica: snapshot of %s is incomplete (%s), retrying\n", src.string(), status.ToString());
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotReplicaDatabases(std::string& strError)
+{
+    const fs::path source = GetReplicaSourceDir();
+    const fs::path dest = GetDataDir();
+    if (!fs::is_directory(source)) {
+        strError = strprintf("The datadir %s of the primary doesn't exist", source.string());
+        return false;
+    }
+    if (fs::equivalent(source, dest)) {
+        strError = "-readonlyreplica needs a datadir of its own";
+        return false;
+    }
+
+    try {
+        std::vector<fs::path> vDatabases;
+        FindDatabases(source, fs::path(), 2, vDatabases);
+        for (const auto& rel : vDatabases) {
+            bool fDone = false;
+            for (int i = 0; i < REPLICA_SNAPSHOT_TRIES && !fDone; i++) {
+                strError.clear();
+                fDone = TrySnapshotDatabase(source / rel, dest / rel, strError);
+                if (!fDone && !strError.empty()) {
+                    return false;
+                }
+            }
+            if (!fDone) {
+                strError = strprintf("The primary kept replacing the files of %s", (source / rel).string());
+                return false;
+            }
+            LogPrintf("Replica: snapshotted %s\n", (source / rel).string());
+        }
+    } catch (const fs::filesystem_error& e) {
+        strError = e.what();
+        return false;
+    }
+    return true;
+}
+
+bool IsReplicaRPCCommand(const std::string& strMethod)
+{
+    static const std::set<std::string> setCommands = {
+        // control and util
+        "help", "stop", "uptime", "getmemoryinfo", "logging", "validateaddress", "verifymessage",
+        "createmultisig", "estimatesmartfee",
+        // blockchain
+        "getbestblockhash", "getblock", "getblockchaininfo", "getblockcount", "getblockhash", "getblockhashes",
+        "getblockheader", "getblockheaders", "getblockstats", "getchaintips", "getchaintxstats", "getdifficulty",
+        "getmerkleblocks", "getspecialtxes", "gettxout", "gettxoutproof", "gettxoutsetinfo", "verifytxoutproof",
+        "getbestchainlock", "getbackgroundverifyinfo",
+        // rawtransactions
+        "getrawtransaction", "decoderawtransaction", "decodescript", "createrawtransaction",
+        // addressindex
+        "getaddressbalance", "getaddressdeltas", "getaddresstxids", "getaddressutxos", "getspentinfo",
+        // evo
+        "protx", "masternodelist", "getsuperblockbudget",
+    };
+    return setCommands.count(strMethod) != 0;
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_REPLICA_H
+#define BITCOIN_REPLICA_H
+
+#include <fs.h>
+
+#include <string>
+
+namespace leveldb {
+class Env;
+}
+
+/** True if we're serving the chain of another node's datadir with -readonlyreplica */
+extern bool fReadOnlyReplica;
+
+/** The network specific datadir of the primary node */
+fs::path GetReplicaSourceDir();
+
+/**
+ * Replace the databases of our datadir with a point in time view of the ones of the primary. LevelDB can't be opened
+ * by a second process, so the immutable table files are hard linked and only the small manifest, CURRENT and log
+ * files are copied, the primary can go on writing and compacting its own files meanwhile. Fails if the datadirs
+ * are on different filesystems.
+ */
+bool SnapshotReplicaDatabases(std::string& strError);
+
+/**
+ * The LevelDB environment of the replica's databases. Their tables are hard links to the primary's until LevelDB
+ * reuses a file number for a table of its own, the link is broken then instead of truncating the primary's file.
+ */
+leveldb::Env* GetReplicaEnv();
+
+/** Whether an RPC method only reads and may be called on a replica */
+bool IsReplicaRPCCommand(const std::string& strMethod);
+
+#endif // BITCOIN_REPLICA_H
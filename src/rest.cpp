@@ -7,7 +7,13 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <headerscache.h>
+#include <evo/deterministicmns.h>
+#include <evo/simplifiedmns.h>
 #include <httpserver.h>
+#include <llmq/quorums.h>
+#include <llmq/quorums_chainlocks.h>
+#include <llmq/quorums_commitment.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <rpc/blockchain.h>
@@ -146,6 +152,8 @@ static bool rest_headers(HTTPRequest* req,
 
     std::vector<const CBlockIndex *> headers;
     headers.reserve(count);
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    bool fFromCache = false;
     {
         LOCK(cs_main);
         const CBlockIndex* pindex = LookupBlockIndex(hash);
@@ -155,11 +163,17 @@ static bool rest_headers(HTTPRequest* req,
                 break;
             pindex = chainActive.Next(pindex);
         }
+        // The headers are consecutive heights of the active chain, so they can be copied in one go
+        if (!headers.empty() && rf != RetFormat::JSON && g_headers_cache.Sync(chainActive)) {
+            g_headers_cache.WriteHeaders(ssHeader, headers.front()->nHeight, headers.size());
+            fFromCache = true;
+        }
     }
 
-    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
-    for (const CBlockIndex *pindex : headers) {
-        ssHeader << pindex->GetBlockHeader();
+    if (!fFromCache) {
+        for (const CBlockIndex *pindex : headers) {
+            ssHeader << pindex->GetBlockHeader();
+        }
     }
 
     switch (rf) {
@@ -573,6 +587,204 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     }
 }
 
+/**
+ * Reply "not modified" if the client already has the result identified by strTag (If-None-Match), otherwise
+ * set it as the ETag of the reply. The results of the masternode and quorum endpoints never change for the
+ * same blocks, so their tags are made of the block hashes and the format.
+ */
+static bool CheckETag(HTTPRequest* req, const std::string& strTag, RetFormat rf)
+{
+    std::string strETag = "\"" + strTag;
+    for (unsigned int i = 0; i < ARRAYLEN(rf_names); i++) {
+        if (rf_names[i].rf == rf) {
+            strETag += std::string(".") + rf_names[i].name;
+        }
+    }
+    strETag += "\"";
+
+    req->WriteHeader("ETag", strETag);
+    std::pair<bool, std::string> ifNoneMatch = req->GetHeader("if-none-match");
+    if (ifNoneMatch.first && (ifNoneMatch.second == "*" || ifNoneMatch.second.find(strETag) != std::string::npos)) {
+        req->WriteReply(HTTP_NOT_MODIFIED);
+        return true;
+    }
+    return false;
+}
+
+/** Reply with a serialized object in the requested format, toJSON is only called for json */
+template <typename T>
+static bool RESTWriteObject(HTTPRequest* req, RetFormat rf, const T& obj, const std::function<UniValue()>& toJSON)
+{
+    switch (rf) {
+    case RetFormat::BINARY: {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << obj;
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ss.str());
+        return true;
+    }
+
+    case RetFormat::HEX: {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << obj;
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(ss.begin(), ss.end()) + "\n");
+        return true;
+    }
+
+    case RetFormat::JSON: {
+        std::string strJSON = toJSON().write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+static bool rest_mnlist(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    const CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        pblockindex = LookupBlockIndex(hash);
+    }
+    if (!pblockindex)
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+    if (CheckETag(req, hash.ToString(), rf))
+        return true;
+
+    if (deterministicMNManager->IsListPruned(pblockindex))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
+
+    const CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(pblockindex);
+    return RESTWriteObject(req, rf, mnList, [&] {
+        UniValue ret(UniValue::VOBJ);
+        ret.pushKV("blockHash", mnList.GetBlockHash().ToString());
+        ret.pushKV("height", mnList.GetHeight());
+        UniValue arr(UniValue::VARR);
+        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+            UniValue obj;
+            dmn->ToJson(obj);
+            arr.push_back(obj);
+        });
+        ret.pushKV("mns", arr);
+        return ret;
+    });
+}
+
+static bool rest_mnlistdiff(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No base block specified. Use /rest/mnlistdiff/<basehash>/<hash>.<ext>.");
+
+    uint256 baseBlockHash, blockHash;
+    if (!ParseHashStr(path[0], baseBlockHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[0]);
+    if (!ParseHashStr(path[1], blockHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    if (CheckETag(req, baseBlockHash.ToString() + "-" + blockHash.ToString(), rf))
+        return true;
+
+    CSimplifiedMNListDiff mnListDiff;
+    std::string strError;
+    {
+        LOCK(cs_main);
+        if (!BuildSimplifiedMNListDiff(baseBlockHash, blockHash, mnListDiff, strError))
+            return RESTERR(req, HTTP_NOT_FOUND, strError);
+    }
+
+    return RESTWriteObject(req, rf, mnListDiff, [&] {
+        UniValue ret;
+        mnListDiff.ToJson(ret);
+        return ret;
+    });
+}
+
+static bool rest_quorum(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "No LLMQ type specified. Use /rest/quorum/<llmqtype>/<quorumhash>.<ext>.");
+
+    int32_t nType;
+    if (!ParseInt32(path[0], &nType) || !Params().GetConsensus().llmqs.count((Consensus::LLMQType)nType))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid LLMQ type: " + path[0]);
+    uint256 quorumHash;
+    if (!ParseHashStr(path[1], quorumHash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    llmq::CQuorumCPtr quorum;
+    {
+        LOCK(cs_main);
+        quorum = llmq::quorumManager->GetQuorum((Consensus::LLMQType)nType, quorumHash);
+    }
+    if (!quorum)
+        return RESTERR(req, HTTP_NOT_FOUND, "quorum not found");
+
+    // A quorum can only be mined once, in a block it is identified by
+    if (CheckETag(req, strprintf("%d-%s-%s", nType, quorumHash.ToString(), quorum->minedBlockHash.ToString()), rf))
+        return true;
+
+    return RESTWriteObject(req, rf, quorum->qc, [&] {
+        UniValue ret;
+        quorum->qc.ToJson(ret);
+        ret.pushKV("height", quorum->pindexQuorum->nHeight);
+        ret.pushKV("minedBlock", quorum->minedBlockHash.ToString());
+        return ret;
+    });
+}
+
+static bool rest_chainlock(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    const llmq::CChainLockSig clsig = llmq::chainLocksHandler->GetBestChainLock();
+    if (clsig.IsNull())
+        return RESTERR(req, HTTP_NOT_FOUND, "Unable to find any chainlock");
+
+    if (CheckETag(req, clsig.blockHash.ToString(), rf))
+        return true;
+
+    return RESTWriteObject(req, rf, clsig, [&] {
+        UniValue ret(UniValue::VOBJ);
+        ret.pushKV("blockhash", clsig.blockHash.ToString());
+        ret.pushKV("height", clsig.nHeight);
+        ret.pushKV("signature", clsig.sig.Get().ToString());
+        return ret;
+    });
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -585,12 +797,16 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/mnlist/", rest_mnlist},
+      {"/rest/mnlistdiff/", rest_mnlistdiff},
+      {"/rest/quorum/", rest_quorum},
+      {"/rest/chainlock", rest_chainlock},
 };
 
 bool StartREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
-        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+        RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler, HTTP_PRIORITY_LOW);
     return true;
 }
 
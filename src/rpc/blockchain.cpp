@@ -11,21 +11,28 @@
 #include <checkpoints.h>
 #include <coins.h>
 #include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
 #include <core_io.h>
 #include <consensus/validation.h>
 #include <validation.h>
 // #include <rpc/index/txindex.h>
 #include <policy/feerate.h>
 #include <policy/policy.h>
+#include <executor.h>
 #include <primitives/transaction.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
+#include <rpc/util.h>
 #include <streams.h>
 #include <sync.h>
 #include <txdb.h>
 #include <txmempool.h>
+#include <unordered_lru_cache.h>
 #include <util.h>
 #include <utilstrencodings.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
+#include <index/coinstatsindex.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
@@ -118,7 +125,83 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+//! Blocks with fewer transactions are decoded on the calling thread only
+static const size_t MIN_PARALLEL_BLOCK_TXS = 32;
+//! Number of transactions decoded at a time when the block is streamed and not cached
+static const size_t STREAMED_BLOCK_TXS_BATCH = 1024;
+
+typedef std::shared_ptr<const std::vector<UniValue>> BlockTxsJSONPtr;
+
+/** TxToUniv of the transactions [nBegin, nEnd) of the block, on the executor for larger ranges */
+static std::vector<UniValue> DecodeBlockTxs(const CBlock& block, size_t nBegin, size_t nEnd)
+{
+    std::vector<UniValue> ret(nEnd - nBegin, UniValue(UniValue::VOBJ));
+    auto decode = [&](size_t i) {
+        TxToUniv(*block.vtx[nBegin + i], uint256(), ret[i], true);
+    };
+    if (ret.size() < MIN_PARALLEL_BLOCK_TXS) {
+        for (size_t i = 0; i < ret.size(); i++) {
+            decode(i);
+        }
+        return ret;
+    }
+
+    // ParallelFor must not throw, so pass any error on to the caller
+    std::mutex cs_error;
+    std::exception_ptr error;
+    GetExecutor().ParallelFor(ExecutorPriority::RPC, ret.size(), [&](size_t i) {
+        try {
+            decode(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(cs_error);
+            error = std::current_exception();
+        }
+    });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return ret;
+}
+
+static size_t GetBlockCacheSize()
+{
+    static const size_t nCacheSize = (size_t)std::max<int64_t>(0, gArgs.GetArg("-rpcblockcache", DEFAULT_RPC_BLOCK_CACHE));
+    return nCacheSize;
+}
+
+/** The decoded transactions of the whole block, from the -rpcblockcache if enabled */
+static BlockTxsJSONPtr GetBlockTxsJSON(const CBlock& block, const uint256& blockHash)
+{
+    const size_t nCacheSize = GetBlockCacheSize();
+    static std::mutex cs_cache;
+    static unordered_lru_cache<uint256, BlockTxsJSONPtr, StaticSaltedHasher> cache(std::max<size_t>(nCacheSize, 1));
+
+    BlockTxsJSONPtr ret;
+    if (nCacheSize != 0) {
+        std::lock_guard<std::mutex> lock(cs_cache);
+        if (cache.get(blockHash, ret)) {
+            return ret;
+        }
+    }
+    ret = std::make_shared<const std::vector<UniValue>>(DecodeBlockTxs(block, 0, block.vtx.size()));
+    if (nCacheSize != 0) {
+        std::lock_guard<std::mutex> lock(cs_cache);
+        cache.insert(blockHash, ret);
+    }
+    return ret;
+}
+
+/** Adds the lock status, which can change and is thus never cached */
+static UniValue blockTxToJSON(const CTransaction& tx, const UniValue& decodedTx, bool chainLock)
+{
+    UniValue objTx(decodedTx);
+    bool fLocked = llmq::quorumInstantSendManager->IsLocked(tx.GetHash());
+    objTx.pushKV("instantlock", fLocked || chainLock);
+    objTx.pushKV("instantlock_internal", fLocked);
+    return objTx;
+}
+
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails, JSONStreamWriter* writer)
 {
     AssertLockHeld(cs_main);
     UniValue result(UniValue::VOBJ);
@@ -134,20 +217,20 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.pushKV("versionHex", strprintf("%08x", block.nVersion));
     result.pushKV("merkleroot", block.hashMerkleRoot.GetHex());
     bool chainLock = llmq::chainLocksHandler->HasChainLock(blockindex->nHeight, blockindex->GetBlockHash());
+    // Decoding the transactions doesn't need to be repeated when streaming, unless the block is cached anyway
+    BlockTxsJSONPtr decodedTxs;
+    if (txDetails && (!writer || GetBlockCacheSize() != 0)) {
+        decodedTxs = GetBlockTxsJSON(block, blockindex->GetBlockHash());
+    }
     UniValue txs(UniValue::VARR);
-    for(const auto& tx : block.vtx)
-    {
-        if(txDetails)
-        {
-            UniValue objTx(UniValue::VOBJ);
-            TxToUniv(*tx, uint256(), objTx, true);
-            bool fLocked = llmq::quorumInstantSendManager->IsLocked(tx->GetHash());
-            objTx.pushKV("instantlock", fLocked || chainLock);
-            objTx.pushKV("instantlock_internal", fLocked);
-            txs.push_back(objTx);
+    if (!writer) {
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            if (!txDetails) {
+                txs.push_back(block.vtx[i]->GetHash().GetHex());
+            } else {
+                txs.push_back(blockTxToJSON(*block.vtx[i], (*decodedTxs)[i], chainLock));
+            }
         }
-        else
-            txs.push_back(tx->GetHash().GetHex());
     }
     result.pushKV("tx", txs);
     if (!block.vtx[0]->vExtraPayload.empty()) {
@@ -174,7 +257,41 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
 
     result.pushKV("chainlock", chainLock);
 
-    return result;
+    if (!writer) {
+        return result;
+    }
+
+    // Same members, but only one transaction is kept in memory at a time
+    writer->BeginObject();
+    const std::vector<std::string>& keys = result.getKeys();
+    const std::vector<UniValue>& values = result.getValues();
+    for (size_t i = 0; i < keys.size(); i++) {
+        writer->Key(keys[i]);
+        if (keys[i] != "tx") {
+            writer->Value(values[i]);
+            continue;
+        }
+        JSONResultBuilder txsBuilder(writer, UniValue::VARR);
+        for (size_t nBegin = 0; nBegin < block.vtx.size(); nBegin += STREAMED_BLOCK_TXS_BATCH) {
+            size_t nEnd = std::min(block.vtx.size(), nBegin + STREAMED_BLOCK_TXS_BATCH);
+            if (!txDetails) {
+                for (size_t i = nBegin; i < nEnd; i++) {
+                    txsBuilder.push_back(block.vtx[i]->GetHash().GetHex());
+                }
+                continue;
+            }
+            std::vector<UniValue> batch;
+            if (!decodedTxs) {
+                batch = DecodeBlockTxs(block, nBegin, nEnd);
+            }
+            for (size_t i = nBegin; i < nEnd; i++) {
+                txsBuilder.push_back(blockTxToJSON(*block.vtx[i], decodedTxs ? (*decodedTxs)[i] : batch[i - nBegin], chainLock));
+            }
+        }
+        txsBuilder.Finish();
+    }
+    writer->EndObject();
+    return NullUniValue;
 }
 
 UniValue getblockcount(const JSONRPCRequest& request)
@@ -236,7 +353,7 @@ UniValue getbestchainlock(const JSONRPCRequest& request)
     }
     result.pushKV("blockhash", clsig.blockHash.GetHex());
     result.pushKV("height", clsig.nHeight);
-    result.pushKV("signature", clsig.sig.ToString());
+    result.pushKV("signature", clsig.sig.Get().ToString());
 
     LOCK(cs_main);
     result.pushKV("known_block", mapBlockIndex.count(clsig.blockHash) > 0);
@@ -435,34 +552,30 @@ std::string EntryDescriptionString()
            "    \"instantlock\" : true|false  (boolean) True if this transaction was locked via InstantSend\n";
 }
 
-void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCKS_REQUIRED(::mempool.cs)
+static void entryToJSON(UniValue &info, const CTxMemPoolSnapshotEntry &e)
 {
-    AssertLockHeld(mempool.cs);
-
     UniValue fees(UniValue::VOBJ);
-    fees.pushKV("base", ValueFromAmount(e.GetFee()));
-    fees.pushKV("modified", ValueFromAmount(e.GetModifiedFee()));
-    fees.pushKV("ancestor", ValueFromAmount(e.GetModFeesWithAncestors()));
-    fees.pushKV("descendant", ValueFromAmount(e.GetModFeesWithDescendants()));
+    fees.pushKV("base", ValueFromAmount(e.nFee));
+    fees.pushKV("modified", ValueFromAmount(e.nModifiedFee));
+    fees.pushKV("ancestor", ValueFromAmount(e.nModFeesWithAncestors));
+    fees.pushKV("descendant", ValueFromAmount(e.nModFeesWithDescendants));
     info.pushKV("fees", fees);
 
-    info.pushKV("size", (int)e.GetTxSize());
-    info.pushKV("fee", ValueFromAmount(e.GetFee()));
-    info.pushKV("modifiedfee", ValueFromAmount(e.GetModifiedFee()));
-    info.pushKV("time", e.GetTime());
-    info.pushKV("height", (int)e.GetHeight());
-    info.pushKV("descendantcount", e.GetCountWithDescendants());
-    info.pushKV("descendantsize", e.GetSizeWithDescendants());
-    info.pushKV("descendantfees", e.GetModFeesWithDescendants());
-    info.pushKV("ancestorcount", e.GetCountWithAncestors());
-    info.pushKV("ancestorsize", e.GetSizeWithAncestors());
-    info.pushKV("ancestorfees", e.GetModFeesWithAncestors());
-    const CTransaction& tx = e.GetTx();
+    info.pushKV("size", (int)e.nTxSize);
+    info.pushKV("fee", ValueFromAmount(e.nFee));
+    info.pushKV("modifiedfee", ValueFromAmount(e.nModifiedFee));
+    info.pushKV("time", e.nTime);
+    info.pushKV("height", (int)e.nHeight);
+    info.pushKV("descendantcount", e.nCountWithDescendants);
+    info.pushKV("descendantsize", e.nSizeWithDescendants);
+    info.pushKV("descendantfees", e.nModFeesWithDescendants);
+    info.pushKV("ancestorcount", e.nCountWithAncestors);
+    info.pushKV("ancestorsize", e.nSizeWithAncestors);
+    info.pushKV("ancestorfees", e.nModFeesWithAncestors);
     std::set<std::string> setDepends;
-    for (const CTxIn& txin : tx.vin)
+    for (const uint256& hash : e.vDepends)
     {
-        if (mempool.exists(txin.prevout.hash))
-            setDepends.insert(txin.prevout.hash.ToString());
+        setDepends.insert(hash.ToString());
     }
 
     UniValue depends(UniValue::VARR);
@@ -474,22 +587,48 @@ void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCKS_REQUI
     info.pushKV("depends", depends);
 
     UniValue spent(UniValue::VARR);
-    const CTxMemPool::txiter &it = mempool.mapTx.find(tx.GetHash());
-    const CTxMemPool::setEntries &setChildren = mempool.GetMemPoolChildren(it);
-    for (const CTxMemPool::txiter &childiter : setChildren) {
-        spent.push_back(childiter->GetTx().GetHash().ToString());
+    for (const uint256& hash : e.vSpentBy) {
+        spent.push_back(hash.ToString());
     }
 
     info.pushKV("spentby", spent);
-    info.pushKV("instantlock", llmq::quorumInstantSendManager->IsLocked(tx.GetHash()));
+    info.pushKV("instantlock", llmq::quorumInstantSendManager->IsLocked(e.tx->GetHash()));
+}
+
+void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCKS_REQUIRED(::mempool.cs)
+{
+    AssertLockHeld(mempool.cs);
+
+    CTxMemPoolSnapshotEntry snapshotEntry;
+    mempool.GetSnapshotEntry(e, snapshotEntry);
+    entryToJSON(info, snapshotEntry);
 }
 
-UniValue mempoolToJSON(bool fVerbose)
+UniValue mempoolToJSON(bool fVerbose, JSONStreamWriter* writer)
 {
+    CTxMemPoolSnapshotPtr snapshot = mempool.GetSnapshot();
+    if (snapshot) {
+        // Served without locking the mempool, see -mempoolsnapshotinterval
+        if (fVerbose) {
+            JSONResultBuilder o(writer, UniValue::VOBJ);
+            for (const CTxMemPoolSnapshotEntry& e : snapshot->vEntries) {
+                UniValue info(UniValue::VOBJ);
+                entryToJSON(info, e);
+                o.pushKV(e.tx->GetHash().ToString(), info);
+            }
+            return o.Finish();
+        }
+        JSONResultBuilder a(writer, UniValue::VARR);
+        for (const CTxMemPoolSnapshotEntry& e : snapshot->vEntries) {
+            a.push_back(e.tx->GetHash().ToString());
+        }
+        return a.Finish();
+    }
+
     if (fVerbose)
     {
         LOCK(mempool.cs);
-        UniValue o(UniValue::VOBJ);
+        JSONResultBuilder o(writer, UniValue::VOBJ);
         for (const CTxMemPoolEntry& e : mempool.mapTx)
         {
             const uint256& hash = e.GetTx().GetHash();
@@ -497,18 +636,18 @@ UniValue mempoolToJSON(bool fVerbose)
             entryToJSON(info, e);
             o.pushKV(hash.ToString(), info);
         }
-        return o;
+        return o.Finish();
     }
     else
     {
         std::vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
 
-        UniValue a(UniValue::VARR);
+        JSONResultBuilder a(writer, UniValue::VARR);
         for (const uint256& hash : vtxid)
             a.push_back(hash.ToString());
 
-        return a;
+        return a.Finish();
     }
 }
 
@@ -541,7 +680,7 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    return mempoolToJSON(fVerbose, request.resultWriter);
 }
 
 UniValue getmempoolancestors(const JSONRPCRequest& request)
@@ -692,6 +831,17 @@ UniValue getmempoolentry(const JSONRPCRequest& request)
 
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
+    CTxMemPoolSnapshotPtr snapshot = mempool.GetSnapshot();
+    if (snapshot) {
+        const CTxMemPoolSnapshotEntry* e = snapshot->Get(hash);
+        if (!e) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
+        }
+        UniValue info(UniValue::VOBJ);
+        entryToJSON(info, *e);
+        return info;
+    }
+
     LOCK(mempool.cs);
 
     CTxMemPool::txiter it = mempool.mapTx.find(hash);
@@ -813,6 +963,10 @@ UniValue getblockheader(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
     }
 
+    if (WriteBinaryResult(request, pblockindex->GetBlockHeader())) {
+        return NullUniValue;
+    }
+
     if (!fVerbose)
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
@@ -1082,6 +1236,19 @@ UniValue getblock(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
     }
 
+    if (request.binaryResult) {
+        // Sent as it is stored, without deserializing it
+        std::vector<unsigned char> vchBlock;
+        if (IsBlockPruned(pblockindex)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+        }
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex, Params().MessageStart())) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+        }
+        request.binaryResult->assign(vchBlock.begin(), vchBlock.end());
+        return NullUniValue;
+    }
+
     const CBlock block = GetBlockChecked(pblockindex);
 
     if (verbosity <= 0)
@@ -1092,7 +1259,7 @@ UniValue getblock(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
+    return blockToJSON(block, pblockindex, verbosity >= 2, request.resultWriter);
 }
 
 UniValue pruneblockchain(const JSONRPCRequest& request)
@@ -1144,45 +1311,129 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
     return uint64_t(height);
 }
 
+/** Look up a block of the active chain by hash or height, cs_main must be held */
+static const CBlockIndex* ParseHashOrHeight(const UniValue& param)
+{
+    if (param.isNum()) {
+        const int height = param.get_int();
+        const int current_tip = chainActive.Height();
+        if (height < 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d is negative", height));
+        }
+        if (height > current_tip) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Target block height %d after current tip %d", height, current_tip));
+        }
+        return chainActive[height];
+    }
+
+    const uint256 hash = ParseHashV(param, "hash_or_height");
+    const CBlockIndex* pindex = LookupBlockIndex(hash);
+    if (!pindex) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    }
+    if (!chainActive.Contains(pindex)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block is not in chain %s", Params().NetworkIDString()));
+    }
+    return pindex;
+}
+
 UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 3)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" hash_or_height use_index )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time without -coinstatsindex.\n"
+            "\nArguments:\n"
+            "1. \"hash_type\"      (string, optional, default=hash_serialized_2) Which UTXO set hash should be calculated.\n"
+            "                      Options: 'hash_serialized_2' (the legacy algorithm), 'muhash', 'none'. 'muhash' and\n"
+            "                      'none' scan the UTXO set on several threads, or are answered by coinstatsindex.\n"
+            "2. hash_or_height     (string or numeric, optional) The block hash or height of the target block, only\n"
+            "                      available with coinstatsindex and a hash_type other than 'hash_serialized_2'\n"
+            "3. use_index          (boolean, optional, default=true) Use coinstatsindex, if available\n"
             "\nResult:\n"
             "{\n"
-            "  \"height\":n,     (numeric) The current block height (index)\n"
-            "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
-            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs\n"
+            "  \"height\":n,     (numeric) The block height (index) of the returned statistics\n"
+            "  \"bestblock\": \"hex\",   (string) The hash of the block at which these statistics are calculated\n"
+            "  \"transactions\": n,      (numeric) The number of transactions with unspent outputs (not available when coinstatsindex is used)\n"
             "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
-            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
-            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash (only present if 'hash_serialized_2' hash_type is chosen)\n"
+            "  \"muhash\": \"hash\",       (string) The MuHash of the UTXO set (only present if 'muhash' hash_type is chosen)\n"
+            "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk (not available when coinstatsindex is used)\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "\"none\"")
+            + HelpExampleCli("gettxoutsetinfo", "\"muhash\" 1000")
             + HelpExampleRpc("gettxoutsetinfo", "")
+            + HelpExampleRpc("gettxoutsetinfo", "\"muhash\", 1000")
         );
 
-    UniValue ret(UniValue::VOBJ);
+    std::string hash_type = "hash_serialized_2";
+    if (!request.params[0].isNull()) {
+        hash_type = request.params[0].get_str();
+        if (hash_type != "hash_serialized_2" && hash_type != "muhash" && hash_type != "none") {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("%s is not a valid hash_type", hash_type));
+        }
+    }
+    const bool use_index = request.params[2].isNull() || request.params[2].get_bool();
+    // The index only keeps the MuHash of the UTXO set
+    const bool fIndex = use_index && g_coinstatsindex && hash_type != "hash_serialized_2";
+
+    const CBlockIndex* pindex = nullptr;
+    if (!request.params[1].isNull()) {
+        if (!fIndex) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Querying specific block heights requires coinstatsindex and a hash_type other than hash_serialized_2");
+        }
+        LOCK(cs_main);
+        pindex = ParseHashOrHeight(request.params[1]);
+    }
 
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview.get(), stats)) {
-        ret.pushKV("height", (int64_t)stats.nHeight);
-        ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    if (fIndex) {
+        if (!pindex) {
+            if (!g_coinstatsindex->IsSynced()) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "coinstatsindex is still syncing, set use_index to false to scan the UTXO set");
+            }
+            // The last indexed block, which lags behind the tip only if a block was connected right now
+            LOCK(cs_main);
+            pindex = chainActive[std::min(chainActive.Height(), g_coinstatsindex->GetIndexedHeight())];
+        }
+        if (!pindex || !g_coinstatsindex->LookupStats(pindex, stats)) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to find the block in coinstatsindex");
+        }
+    } else {
+        FlushStateToDisk();
+        bool fOk;
+        if (hash_type == "hash_serialized_2") {
+            fOk = GetUTXOStats(pcoinsdbview.get(), stats);
+        } else {
+            fOk = GetUTXOStatsParallel(pcoinsdbview.get(), stats, hash_type == "muhash");
+        }
+        if (!fOk) {
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        }
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("height", (int64_t)stats.nHeight);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    if (!fIndex) {
         ret.pushKV("transactions", (int64_t)stats.nTransactions);
-        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
-        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    }
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    if (hash_type == "hash_serialized_2") {
         ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+    } else if (hash_type == "muhash") {
+        ret.pushKV("muhash", stats.hashMuHash.GetHex());
+    }
+    if (!fIndex) {
         ret.pushKV("disk_size", stats.nDiskSize);
-        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
-    } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
     return ret;
 }
 
@@ -1293,6 +1544,53 @@ UniValue verifychain(const JSONRPCRequest& request)
     return CVerifyDB().VerifyDB(Params(), pcoinsTip.get(), nCheckLevel, nCheckDepth);
 }
 
+UniValue getbackgroundverifyinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getbackgroundverifyinfo\n"
+            "\nReturns the progress of the background verification of the blocks below the ones checked at startup (see -backgroundcheckblocks).\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"started\": true|false,     (boolean) Whether a background verification was started\n"
+            "  \"running\": true|false,     (boolean) Whether it is still running\n"
+            "  \"checklevel\": n,           (numeric) How thorough the verification is\n"
+            "  \"startheight\": n,          (numeric) The highest block being verified\n"
+            "  \"stopheight\": n,           (numeric) The lowest block being verified\n"
+            "  \"blocks\": n,               (numeric) The number of blocks to verify\n"
+            "  \"verified\": n,             (numeric) The number of blocks verified so far\n"
+            "  \"failedheight\": n,         (numeric, optional) The height of the corrupted block found\n"
+            "  \"error\": \"xxxx\",          (string, optional) What is wrong with it\n"
+            "  \"starttime\": xxxxx,        (numeric) When the verification started in seconds since epoch (Jan 1 1970 GMT)\n"
+            "  \"endtime\": xxxxx,          (numeric, optional) When it ended in seconds since epoch (Jan 1 1970 GMT)\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getbackgroundverifyinfo", "")
+            + HelpExampleRpc("getbackgroundverifyinfo", "")
+        );
+
+    BackgroundVerifyStatus status = GetBackgroundVerifyStatus();
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("started", status.fStarted);
+    ret.pushKV("running", status.fRunning);
+    if (status.fStarted) {
+        ret.pushKV("checklevel", status.nCheckLevel);
+        ret.pushKV("startheight", status.nStartHeight);
+        ret.pushKV("stopheight", status.nStopHeight);
+        ret.pushKV("blocks", status.nBlocks);
+        ret.pushKV("verified", status.nVerified);
+        if (status.nFailedHeight != -1) {
+            ret.pushKV("failedheight", status.nFailedHeight);
+            ret.pushKV("error", status.strError);
+        }
+        ret.pushKV("starttime", status.nStartTime);
+        if (!status.fRunning) {
+            ret.pushKV("endtime", status.nEndTime);
+        }
+    }
+    return ret;
+}
+
 /** Implementation of IsSuperMajority with better feedback */
 static UniValue SoftForkMajorityDesc(int version, CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
@@ -1628,6 +1926,24 @@ UniValue mempoolInfoToJSON()
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
     ret.pushKV("instantsendlocks", (int64_t)llmq::quorumInstantSendManager->GetInstantSendLockCount());
 
+    auto isCacheStats = llmq::quorumInstantSendManager->GetCacheStats();
+    auto cacheStatsToJSON = [](const llmq::CInstantSendCacheStats& stats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("entries", (int64_t)stats.nEntries);
+        obj.pushKV("maxentries", (int64_t)stats.nMaxEntries);
+        obj.pushKV("hits", (int64_t)stats.nHits);
+        obj.pushKV("misses", (int64_t)stats.nMisses);
+        uint64_t nLookups = stats.nHits + stats.nMisses;
+        obj.pushKV("hitrate", nLookups != 0 ? (double)stats.nHits / nLookups : 0.0);
+        return obj;
+    };
+    UniValue isCache(UniValue::VOBJ);
+    isCache.pushKV("size", (int64_t)isCacheStats.nCacheSizeBytes);
+    isCache.pushKV("islocks", cacheStatsToJSON(isCacheStats.islocks));
+    isCache.pushKV("txids", cacheStatsToJSON(isCacheStats.txids));
+    isCache.pushKV("lockedoutpoints", (int64_t)isCacheStats.nLockedOutpoints);
+    ret.pushKV("instantsendcache", isCache);
+
     return ret;
 }
 
@@ -1646,6 +1962,18 @@ UniValue getmempoolinfo(const JSONRPCRequest& request)
             "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee rate in " + CURRENCY_UNIT + "/kB for tx to be accepted. Is the maximum of minrelaytxfee and minimum mempool fee\n"
             "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay fee for transactions\n"
             "  \"instantsendlocks\": xxxxx,   (numeric) Number of unconfirmed instant send locks\n"
+            "  \"instantsendcache\": {         (json object) InstantSend lock caches, limited by -iscachesize\n"
+            "    \"size\": xxxxx,             (numeric) Memory budget of the caches in bytes\n"
+            "    \"islocks\": {               (json object) Cache of islocks by hash, \"txids\" looks the same\n"
+            "      \"entries\": xxxxx,        (numeric) Current number of entries\n"
+            "      \"maxentries\": xxxxx,     (numeric) Number of entries the cache is truncated to\n"
+            "      \"hits\": xxxxx,           (numeric) Number of lookups answered from the cache\n"
+            "      \"misses\": xxxxx,         (numeric) Number of lookups that had to go to the database\n"
+            "      \"hitrate\": x.xxx         (numeric) hits / (hits + misses)\n"
+            "    },\n"
+            "    \"txids\": {...},\n"
+            "    \"lockedoutpoints\": xxxxx    (numeric) Number of inputs locked by not yet confirmed islocks, kept in memory\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
@@ -2221,6 +2549,167 @@ UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the UTXO set of the tip to a file, along with the MN lists and quorum commitments needed to continue\n"
+            "from it. The file can be loaded with loadtxoutset if its height and hash are known to the chain params.\n"
+            "\nArguments:\n"
+            "1. \"path\"      (string, required) Path of the file, relative to the data directory if not absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,            (numeric) The number of unspent transaction outputs written\n"
+            "  \"base_hash\": \"hash\",          (string) The hash of the block the snapshot was made at\n"
+            "  \"base_height\": n,              (numeric) The height of that block\n"
+            "  \"hash_serialized_2\": \"hash\",  (string) The serialized hash of the UTXO set, as in gettxoutsetinfo\n"
+            "  \"nchaintx\": n,                 (numeric) The number of transactions until and including the block\n"
+            "  \"path\": \"path\"                (string) The absolute path of the file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary file first, a partial snapshot must never be mistaken for a complete one
+    const fs::path temppath = path.string() + ".incomplete";
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    }
+
+    SnapshotMetadata metadata;
+    CCoinsStats stats;
+    std::string strError;
+    if (!DumpUTXOSnapshot(temppath, metadata, stats, strError)) {
+        fs::remove(temppath);
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+    fs::rename(temppath, path);
+
+    unsigned int nChainTx;
+    {
+        LOCK(cs_main);
+        nChainTx = LookupBlockIndex(metadata.baseBlockHash)->nChainTx;
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_written", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("base_hash", metadata.baseBlockHash.GetHex());
+    ret.pushKV("base_height", metadata.nBaseHeight);
+    ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+    ret.pushKV("nchaintx", (int64_t)nChainTx);
+    ret.pushKV("path", path.string());
+    return ret;
+}
+
+UniValue loadtxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nLoads a UTXO set written by dumptxoutset, so that the node continues from its block instead of downloading\n"
+            "and connecting all blocks before it. Only works on a node that has synced the headers but not connected\n"
+            "any block yet, and only for snapshots whose hash is known to the chain params. The blocks before the snapshot\n"
+            "are never downloaded, so the node can't serve them and indexes only cover the blocks after it.\n"
+            "Note this call may take some time, the node doesn't process blocks meanwhile.\n"
+            "\nArguments:\n"
+            "1. \"path\"      (string, required) Path of the file, relative to the data directory if not absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_loaded\": n,           (numeric) The number of unspent transaction outputs loaded\n"
+            "  \"tip_hash\": \"hash\",          (string) The hash of the new tip\n"
+            "  \"base_height\": n,            (numeric) The height of the new tip\n"
+            "  \"path\": \"path\"              (string) The absolute path of the file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    const fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+
+    SnapshotMetadata metadata;
+    CCoinsStats stats;
+    std::string strError;
+    if (!LoadUTXOSnapshot(path, metadata, stats, strError)) {
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("coins_loaded", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("tip_hash", metadata.baseBlockHash.GetHex());
+    ret.pushKV("base_height", metadata.nBaseHeight);
+    ret.pushKV("path", path.string());
+    return ret;
+}
+
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 157 content filter for a particular block.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"     (string, required) The hash of the block\n"
+            "2. \"filtertype\"    (string, optional, default=basic) The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : (string) the hex-encoded filter data\n"
+            "  \"header\" : (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+    }
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    if (!g_blockfilterindex || g_blockfilterindex->GetFilterType() != filtertype) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    bool block_in_chain;
+    {
+        LOCK(cs_main);
+        block_index = LookupBlockIndex(block_hash);
+        if (!block_index) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_in_chain = chainActive.Contains(block_index);
+    }
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!g_blockfilterindex->LookupFilter(block_index, filter) ||
+        !g_blockfilterindex->LookupFilterHeader(block_index, filter_header)) {
+        // Only the active chain is indexed, and the index is updated in the background
+        if (!block_in_chain) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Filter not found. Block is not in the active chain.");
+        }
+        throw JSONRPCError(RPC_MISC_ERROR, "Filter not found. Block filters are still in the process of being indexed.");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("filter", HexStr(filter.GetEncodedFilter()));
+    ret.pushKV("header", filter_header.GetHex());
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
@@ -2233,6 +2722,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblock",               &getblock,               {"blockhash","verbosity|verbose"} },
     { "blockchain",         "getblockhashes",         &getblockhashes,         {"high","low"} },
     { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash", "filtertype"} },
     { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
     { "blockchain",         "getblockheaders",        &getblockheaders,        {"blockhash","count","verbose"} },
     { "blockchain",         "getmerkleblocks",        &getmerkleblocks,        {"filter","blockhash","count"} },
@@ -2245,10 +2735,13 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
     { "blockchain",         "getspecialtxes",         &getspecialtxes,         {"blockhash", "type", "count", "skip", "verbosity"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"hash_type", "hash_or_height", "use_index"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           {"path"} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
+    { "blockchain",         "getbackgroundverifyinfo", &getbackgroundverifyinfo, {} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
 
@@ -7,8 +7,12 @@
 
 class CBlock;
 class CBlockIndex;
+class JSONStreamWriter;
 class UniValue;
 
+/** Default for -rpcblockcache, the number of blocks whose decoded transactions getblock keeps (0 to disable) */
+static const unsigned int DEFAULT_RPC_BLOCK_CACHE = 0;
+
 /**
  * Get the difficulty of the net wrt to the given block index, or the chain tip if
  * not provided.
@@ -21,14 +25,14 @@ double GetDifficulty(const CBlockIndex* blockindex);
 /** Callback for when block tip changed. */
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
-/** Block description to JSON */
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+/** Block description to JSON, written to writer (and null returned) if given */
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false, JSONStreamWriter* writer = nullptr);
 
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
 
-/** Mempool to JSON */
-UniValue mempoolToJSON(bool fVerbose = false);
+/** Mempool to JSON, written to writer (and null returned) if given */
+UniValue mempoolToJSON(bool fVerbose = false, JSONStreamWriter* writer = nullptr);
 
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
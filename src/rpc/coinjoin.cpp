@@ -121,9 +121,16 @@ UniValue getcoinjoininfo(const JSONRPCRequest& request)
                 "\nResult (for masternodes):\n"
                 "{\n"
                 "  \"queue_size\": xxx,                 (numeric) How many queues there are currently on the network\n"
-                "  \"denomination\": xxx,               (numeric) The denomination of the mixing session in " + CURRENCY_UNIT + "\n"
-                "  \"state\": \"...\",                    (string) Current state of the mixing session\n"
-                "  \"entries_count\": xxx,              (numeric) The number of entries in the mixing session\n"
+                "  \"denomination\": xxx,               (numeric) The denomination of the first mixing session in " + CURRENCY_UNIT + "\n"
+                "  \"state\": \"...\",                    (string) Current state of the first mixing session\n"
+                "  \"entries_count\": xxx,              (numeric) The number of entries in the first mixing session\n"
+                "  \"sessions\": [                      (array of json objects) The mixing sessions in progress\n"
+                "    {\n"
+                "      \"denomination\": xxx,           (numeric) The denomination of the mixing session in " + CURRENCY_UNIT + "\n"
+                "      \"state\": \"...\",                (string) Current state of the mixing session\n"
+                "      \"entries_count\": xxx,          (numeric) The number of entries in the mixing session\n"
+                "    }\n"
+                "  ]\n"
                 "}\n"
                 "\nExamples:\n"
                 + HelpExampleCli("getcoinjoininfo", "")
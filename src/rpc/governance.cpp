@@ -14,6 +14,7 @@
 #include <validation.h>
 #include <masternode/masternode-sync.h>
 #include <messagesigner.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
 #include <util.h>
 #include <utilmoneystr.h>
@@ -671,9 +672,9 @@ UniValue gobject_vote_alias(const JSONRPCRequest& request)
 }
 #endif
 
-UniValue ListObjects(const std::string& strCachedSignal, const std::string& strType, int nStartTime)
+UniValue ListObjects(const std::string& strCachedSignal, const std::string& strType, int nStartTime, JSONStreamWriter* writer = nullptr)
 {
-    UniValue objResult(UniValue::VOBJ);
+    JSONResultBuilder objResult(writer, UniValue::VOBJ);
 
     // GET MATCHING GOVERNANCE OBJECTS
 
@@ -723,7 +724,7 @@ UniValue ListObjects(const std::string& strCachedSignal, const std::string& strT
         objResult.pushKV(pGovObj->GetHash().ToString(), bObj);
     }
 
-    return objResult;
+    return objResult.Finish();
 }
 
 void gobject_list_help()
@@ -756,7 +757,7 @@ UniValue gobject_list(const JSONRPCRequest& request)
     if (strType != "proposals" && strType != "triggers" && strType != "all")
         return "Invalid type, should be 'proposals', 'triggers' or 'all'";
 
-    return ListObjects(strCachedSignal, strType, 0);
+    return ListObjects(strCachedSignal, strType, 0, request.resultWriter);
 }
 
 void gobject_diff_help()
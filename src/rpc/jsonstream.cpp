@@ -0,0 +1,154 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <rpc/jsonstream.h>
+
+#include <assert.h>
+
+JSONStreamWriter::JSONStreamWriter(Sink sink, size_t nChunkSize) :
+    m_sink(std::move(sink)),
+    m_chunk_size(nChunkSize)
+{
+    m_buffer.reserve(m_chunk_size);
+}
+
+void JSONStreamWriter::BeginElement()
+{
+    if (m_expects_value) {
+        m_expects_value = false;
+        return;
+    }
+    if (!m_containers.empty()) {
+        if (!m_containers.back()) {
+            m_buffer += ',';
+        }
+        m_containers.back() = false;
+    }
+}
+
+void JSONStreamWriter::MaybeFlush()
+{
+    if (m_buffer.size() >= m_chunk_size) {
+        Flush();
+    }
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    BeginElement();
+    m_buffer += '[';
+    m_containers.push_back(true);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!m_containers.empty() && !m_expects_value);
+    m_buffer += ']';
+    m_containers.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    BeginElement();
+    m_buffer += '{';
+    m_containers.push_back(true);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!m_containers.empty() && !m_expects_value);
+    m_buffer += '}';
+    m_containers.pop_back();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!m_containers.empty() && !m_expects_value);
+    BeginElement();
+    // Let UniValue take care of the escaping
+    m_buffer += UniValue(key).write();
+    m_buffer += ':';
+    m_expects_value = true;
+}
+
+void JSONStreamWriter::Value(const UniValue& val)
+{
+    BeginElement();
+    m_buffer += val.write();
+    MaybeFlush();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (m_buffer.empty()) {
+        return;
+    }
+    m_sink(m_buffer);
+    m_buffer.clear();
+    m_flushed = true;
+}
+
+std::string JSONStreamWriter::TakeBuffer()
+{
+    std::string ret;
+    ret.swap(m_buffer);
+    return ret;
+}
+
+JSONResultBuilder::JSONResultBuilder(JSONStreamWriter* writer, UniValue::VType type) :
+    m_writer(writer),
+    m_value(type)
+{
+    assert(type == UniValue::VARR || type == UniValue::VOBJ);
+}
+
+void JSONResultBuilder::Start()
+{
+    if (m_started) {
+        return;
+    }
+    if (m_value.isArray()) {
+        m_writer->BeginArray();
+    } else {
+        m_writer->BeginObject();
+    }
+    m_started = true;
+}
+
+void JSONResultBuilder::push_back(const UniValue& val)
+{
+    if (!m_writer) {
+        m_value.push_back(val);
+        return;
+    }
+    Start();
+    m_writer->Value(val);
+}
+
+void JSONResultBuilder::pushKV(const std::string& key, const UniValue& val)
+{
+    if (!m_writer) {
+        m_value.pushKV(key, val);
+        return;
+    }
+    Start();
+    m_writer->Key(key);
+    m_writer->Value(val);
+}
+
+UniValue JSONResultBuilder::Finish()
+{
+    if (!m_writer) {
+        return m_value;
+    }
+    Start();
+    if (m_value.isArray()) {
+        m_writer->EndArray();
+    } else {
+        m_writer->EndObject();
+    }
+    return NullUniValue;
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RPC_JSONSTREAM_H
+#define BITCOIN_RPC_JSONSTREAM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <univalue.h>
+
+/** Amount of buffered output after which JSONStreamWriter hands a chunk to its sink */
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document piece by piece, so that large documents never have to be kept in memory as a whole.
+ *
+ * The output is compact, i.e. the same as UniValue::write() without indentation. It is buffered and passed to the
+ * sink whenever more than nChunkSize bytes were collected, the rest stays buffered until Flush() or TakeBuffer().
+ * Containers are opened and closed explicitly, values can still be written as (small) UniValue trees.
+ */
+class JSONStreamWriter
+{
+public:
+    typedef std::function<void(const std::string&)> Sink;
+
+    explicit JSONStreamWriter(Sink sink, size_t nChunkSize = JSON_STREAM_CHUNK_SIZE);
+
+    void BeginArray();
+    void EndArray();
+    void BeginObject();
+    void EndObject();
+    /** Write the key of the next member of the current object, must be followed by a value */
+    void Key(const std::string& key);
+    void Value(const UniValue& val);
+
+    /** Pass all buffered output to the sink */
+    void Flush();
+    /** Give up the buffered output instead of passing it to the sink */
+    std::string TakeBuffer();
+
+    /** Whether any output was passed to the sink yet */
+    bool IsFlushed() const { return m_flushed; }
+    /** Number of currently open containers */
+    size_t GetDepth() const { return m_containers.size(); }
+    /** Whether a key was written that has no value yet */
+    bool ExpectsValue() const { return m_expects_value; }
+
+private:
+    const Sink m_sink;
+    const size_t m_chunk_size;
+    std::string m_buffer;
+    /** Whether the open containers are still empty, innermost last */
+    std::vector<bool> m_containers;
+    bool m_expects_value{false};
+    bool m_flushed{false};
+
+    /** Emit the separator needed before the next key or array element */
+    void BeginElement();
+    void MaybeFlush();
+};
+
+/**
+ * Collects the elements of an array or object result of an RPC handler. If a JSONStreamWriter is given, the elements
+ * are written to it right away instead of being kept in a UniValue, see JSONRPCRequest::resultWriter.
+ *
+ * The container is only opened once the first element is added or Finish() is called, so that handlers can still
+ * throw errors until then.
+ */
+class JSONResultBuilder
+{
+public:
+    JSONResultBuilder(JSONStreamWriter* writer, UniValue::VType type);
+
+    void push_back(const UniValue& val);
+    void pushKV(const std::string& key, const UniValue& val);
+
+    /** Close the container and return the result, which is null if it was written to the stream */
+    UniValue Finish();
+
+private:
+    JSONStreamWriter* const m_writer;
+    UniValue m_value;
+    bool m_started{false};
+
+    void Start();
+};
+
+#endif // BITCOIN_RPC_JSONSTREAM_H
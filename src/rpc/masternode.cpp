@@ -5,6 +5,7 @@
 #include <masternode/activemasternode.h>
 #include <base58.h>
 #include <clientversion.h>
+#include <ctpl.h>
 #include <init.h>
 #include <netbase.h>
 #include <validation.h>
@@ -310,6 +311,57 @@ void masternode_winners_help()
         );
 }
 
+static const int MAX_PAYEE_QUERY_THREADS = 8;
+// ranges of at least this many blocks are looked up in parallel
+static const size_t MIN_PARALLEL_PAYEE_QUERY = 64;
+
+/** Threads that look up the payees of large block ranges, started on first use */
+static ctpl::thread_pool& GetPayeeQueryPool()
+{
+    static std::once_flag init;
+    static std::unique_ptr<ctpl::thread_pool> pool;
+    std::call_once(init, [] {
+        pool.reset(new ctpl::thread_pool(std::max(1, std::min(GetNumCores(), MAX_PAYEE_QUERY_THREADS))));
+        RenameThreadPool(*pool, "dash-payeeq");
+    });
+    return *pool;
+}
+
+/** The payees of the blocks from nStartHeight up to the tip */
+static std::vector<CDeterministicMNCPtr> GetPayees(const CBlockIndex* pindexTip, int nStartHeight)
+{
+    std::vector<CDeterministicMNCPtr> vecPayees(std::max(pindexTip->nHeight - nStartHeight + 1, 0));
+    auto lookup = [&](size_t i) {
+        vecPayees[i] = deterministicMNManager->GetMNPayee(pindexTip->GetAncestor(nStartHeight + (int)i - 1));
+    };
+
+    if (vecPayees.size() < MIN_PARALLEL_PAYEE_QUERY) {
+        for (size_t i = 0; i < vecPayees.size(); i++) {
+            lookup(i);
+        }
+        return vecPayees;
+    }
+
+    const size_t nTasks = GetPayeeQueryPool().size();
+    std::vector<std::future<void> > futures;
+    futures.reserve(nTasks);
+    for (size_t nTask = 0; nTask < nTasks; nTask++) {
+        futures.emplace_back(GetPayeeQueryPool().push([&, nTask](int) {
+            for (size_t i = nTask; i < vecPayees.size(); i += nTasks) {
+                lookup(i);
+            }
+        }));
+    }
+    // Wait for all of them before anything is rethrown, they reference our locals
+    for (auto& future : futures) {
+        future.wait();
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    return vecPayees;
+}
+
 UniValue masternode_winners(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 3)
@@ -338,9 +390,9 @@ UniValue masternode_winners(const JSONRPCRequest& request)
     int nChainTipHeight = pindexTip->nHeight;
     int nStartHeight = std::max(nChainTipHeight - nCount, 1);
 
+    std::vector<CDeterministicMNCPtr> vecPayees = GetPayees(pindexTip, nStartHeight);
     for (int h = nStartHeight; h <= nChainTipHeight; h++) {
-        auto payee = deterministicMNManager->GetListForBlock(pindexTip->GetAncestor(h - 1)).GetMNPayee();
-        std::string strPayments = GetRequiredPaymentsString(h, payee);
+        std::string strPayments = GetRequiredPaymentsString(h, vecPayees[h - nStartHeight]);
         if (strFilter != "" && strPayments.find(strFilter) == std::string::npos) continue;
         obj.pushKV(strprintf("%d", h), strPayments);
     }
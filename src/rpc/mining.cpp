@@ -527,7 +527,19 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
-    if (pindexPrev != chainActive.Tip() ||
+    CBlockTemplateCache::Entry precomputed;
+    bool fNewTemplate = false;
+    if (g_block_template_cache && g_block_template_cache->Get(chainActive.Tip(), precomputed)) {
+        // Rebuilt in the background whenever the tip or the mempool changes, so there is no need to wait for
+        // CreateNewBlock here. The template is copied as nTime and nNonce are updated below
+        if (pindexPrev != chainActive.Tip() || precomputed.nTransactionsUpdated > nTransactionsUpdatedLast) {
+            pblocktemplate.reset(new CBlockTemplate(*precomputed.pblocktemplate));
+            nTransactionsUpdatedLast = precomputed.nTransactionsUpdated;
+            nStart = precomputed.nTime;
+            pindexPrev = chainActive.Tip();
+            fNewTemplate = true;
+        }
+    } else if (pindexPrev != chainActive.Tip() ||
         (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5))
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
@@ -546,6 +558,13 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
         // Need to update only after we know CreateNewBlock succeeded
         pindexPrev = pindexPrevNew;
+        fNewTemplate = true;
+    }
+    if (fNewTemplate) {
+        LogPrint(BCLog::BENCHMARK, "getblocktemplate: new %s template, packages: %.2fms, coinbase: %.2fms, validity (%s): %.2fms\n",
+                 precomputed.pblocktemplate ? "precomputed" : "on-demand",
+                 0.001 * pblocktemplate->nTimePackages, 0.001 * pblocktemplate->nTimeCoinbase,
+                 pblocktemplate->fFastValidityCheck ? "fast" : "full", 0.001 * pblocktemplate->nTimeValidity);
     }
     CBlock* pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus();
@@ -8,16 +8,22 @@
 #include <clientversion.h>
 #include <consensus/consensus.h>
 #include <core_io.h>
+#include <ctpl.h>
+#include <evo/deterministicmns.h>
 #include <evo/mnauth.h>
 #include <init.h>
 #include <httpserver.h>
 #include <key_io.h>
+#include <memaccounting.h>
 #include <net.h>
 #include <netbase.h>
 #include <rpc/blockchain.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
+#include <sync.h>
 #include <timedata.h>
+#include <txdb.h>
 #include <txmempool.h>
 #include <util.h>
 #include <utilstrencodings.h>
@@ -29,10 +35,15 @@
 #endif
 #include <warnings.h>
 
+#include <llmq/quorums_dkgsessionmgr.h>
 #include <masternode/masternode-sync.h>
 #include <spork.h>
 
+#include <future>
+#include <mutex>
+#include <queue>
 #include <stdint.h>
+#include <tuple>
 #ifdef HAVE_MALLOC_INFO
 #include <malloc.h>
 #endif
@@ -450,9 +461,7 @@ UniValue mnauth(const JSONRPCRequest& request)
     }
 
     bool fSuccess = g_connman->ForNode(nodeId, CConnman::AllNodes, [&](CNode* pNode){
-        LOCK(pNode->cs_mnauth);
-        pNode->verifiedProRegTxHash = proTxHash;
-        pNode->verifiedPubKeyHash = publicKey.GetHash();
+        g_connman->SetMasternodeVerified(pNode, proTxHash, publicKey.GetHash());
         return true;
     });
 
@@ -529,6 +538,139 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/** Order of the results of getaddressdeltas, the order of the address index within each address */
+static bool deltaSort(const std::pair<CAddressIndexKey, CAmount>& a, const std::pair<CAddressIndexKey, CAmount>& b) {
+    return std::tie(a.first.blockHeight, a.first.txindex, a.first.txhash, a.first.index, a.first.spending, a.first.type, a.first.hashBytes) <
+           std::tie(b.first.blockHeight, b.first.txindex, b.first.txhash, b.first.index, b.first.spending, b.first.type, b.first.hashBytes);
+}
+
+/** Order of the results of getaddressutxos, refines heightSort so that pages don't overlap */
+static bool utxoSort(const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a, const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+    return std::tie(a.second.blockHeight, a.first.txhash, a.first.index, a.first.type, a.first.hashBytes) <
+           std::tie(b.second.blockHeight, b.first.txhash, b.first.index, b.first.type, b.first.hashBytes);
+}
+
+static const int MAX_ADDRESS_QUERY_THREADS = 8;
+
+/** Threads that scan the address index for requests with several addresses, started on first use */
+static ctpl::thread_pool& GetAddressQueryPool()
+{
+    static std::once_flag init;
+    static std::unique_ptr<ctpl::thread_pool> pool;
+    std::call_once(init, [] {
+        pool.reset(new ctpl::thread_pool(std::max(1, std::min(GetNumCores(), MAX_ADDRESS_QUERY_THREADS))));
+        RenameThreadPool(*pool, "dash-addrq");
+    });
+    return *pool;
+}
+
+/**
+ * Call query(address, snapshot, result) for every address, concurrently if there are several. All queries read the
+ * block tree database as of the same snapshot, so the results are consistent even if blocks are connected meanwhile.
+ * Returns the results in the order of the addresses, exceptions thrown by a query are rethrown.
+ */
+template <typename T, typename Query>
+static std::vector<T> QueryAddresses(const std::vector<std::pair<uint160, int> >& addresses, Query query)
+{
+    std::vector<T> results(addresses.size());
+    const CDBSnapshot snapshot(*pblocktree);
+    if (addresses.size() == 1) {
+        query(addresses[0], snapshot, results[0]);
+        return results;
+    }
+
+    std::vector<std::future<void> > futures;
+    futures.reserve(addresses.size());
+    for (size_t i = 0; i < addresses.size(); i++) {
+        futures.emplace_back(GetAddressQueryPool().push([&, i](int) {
+            query(addresses[i], snapshot, results[i]);
+        }));
+    }
+    // Wait for all of them before anything is rethrown, they reference our locals
+    for (auto& future : futures) {
+        future.wait();
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    return results;
+}
+
+/** k-way merge of streams that are each sorted by comp, stops after limit entries if limit is not 0 */
+template <typename T, typename Compare>
+static std::vector<T> MergeSorted(const std::vector<std::vector<T> >& streams, Compare comp, size_t limit)
+{
+    // Positions (stream, index) of the next entry of every stream, the smallest entry on top
+    typedef std::pair<size_t, size_t> Pos;
+    auto greater = [&](const Pos& a, const Pos& b) {
+        return comp(streams[b.first][b.second], streams[a.first][a.second]);
+    };
+    std::priority_queue<Pos, std::vector<Pos>, decltype(greater)> heap(greater);
+    size_t total = 0;
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (!streams[i].empty()) {
+            heap.emplace(i, 0);
+            total += streams[i].size();
+        }
+    }
+
+    std::vector<T> merged;
+    merged.reserve(limit ? std::min(limit, total) : total);
+    while (!heap.empty() && (!limit || merged.size() < limit)) {
+        Pos pos = heap.top();
+        heap.pop();
+        merged.push_back(streams[pos.first][pos.second]);
+        if (++pos.second < streams[pos.first].size()) {
+            heap.push(pos);
+        }
+    }
+    return merged;
+}
+
+/** Read the "limit" and "cursor" of paged address index queries, returns false if the results are not paged */
+template <typename Cursor>
+static bool getPagingFromParams(const UniValue& params, size_t& limit, bool& fHaveCursor, Cursor& cursor)
+{
+    limit = 0;
+    fHaveCursor = false;
+    if (!params[0].isObject()) {
+        return false;
+    }
+    const UniValue& limitValue = find_value(params[0].get_obj(), "limit");
+    const UniValue& cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (limitValue.isNull() && cursorValue.isNull()) {
+        return false;
+    }
+    if (!limitValue.isNull()) {
+        if (!limitValue.isNum() || limitValue.get_int() <= 0) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "limit is expected to be a positive number");
+        }
+        limit = limitValue.get_int();
+    }
+    if (!cursorValue.isNull()) {
+        if (!cursorValue.isStr() || !IsHex(cursorValue.get_str())) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "cursor is expected to be a hex string");
+        }
+        std::vector<unsigned char> data(ParseHex(cursorValue.get_str()));
+        CDataStream ss(data, SER_NETWORK, PROTOCOL_VERSION);
+        try {
+            ss >> cursor;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        fHaveCursor = true;
+    }
+    return true;
+}
+
+template <typename Cursor>
+static UniValue encodeCursor(const Cursor& cursor)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << cursor;
+    return HexStr(ss.begin(), ss.end());
+}
+
 UniValue getaddressmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -568,7 +710,10 @@ UniValue getaddressmempool(const JSONRPCRequest& request)
 
     std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > indexes;
 
-    if (!mempool.getAddressIndex(addresses, indexes)) {
+    CTxMemPoolSnapshotPtr snapshot = mempool.GetSnapshot();
+    if (snapshot) {
+        snapshot->getAddressIndex(addresses, indexes);
+    } else if (!mempool.getAddressIndex(addresses, indexes)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
     }
 
@@ -613,6 +758,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\" (number, optional) Return at most this many outputs and a cursor to the next ones\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous call, to get the next outputs\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -625,6 +772,11 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
             "    \"height\"  (number) The block height\n"
             "  }\n"
             "]\n"
+            "\nResult (if limit or cursor is given):\n"
+            "{\n"
+            "  \"utxos\": [...]  (array) The outputs as above\n"
+            "  \"cursor\": \"xxxx\"  (string) The cursor to pass to get the next outputs, null if there are none\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -636,16 +788,31 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    size_t limit;
+    bool fHaveCursor;
+    std::pair<CAddressUnspentKey, int> cursor;
+    const bool fPaged = getPagingFromParams(request.params, limit, fHaveCursor, cursor);
+    const std::pair<CAddressUnspentKey, CAddressUnspentValue> cursorEntry(cursor.first, CAddressUnspentValue(0, CScript(), cursor.second));
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+    typedef std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > UnspentOutputs;
+    std::vector<UnspentOutputs> streams = QueryAddresses<UnspentOutputs>(addresses, [&](const std::pair<uint160, int>& address, const CDBSnapshot& snapshot, UnspentOutputs& outputs) {
+        if (!GetAddressUnspent(address.first, address.second, outputs, &snapshot)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+        if (fHaveCursor) {
+            outputs.erase(std::remove_if(outputs.begin(), outputs.end(), [&](const UnspentOutputs::value_type& output) {
+                return !utxoSort(cursorEntry, output);
+            }), outputs.end());
+        }
+        std::sort(outputs.begin(), outputs.end(), utxoSort);
+    });
+    // Fetch one more to know whether there is a next page
+    UnspentOutputs unspentOutputs = MergeSorted(streams, utxoSort, limit ? limit + 1 : 0);
+    const bool fMore = limit && unspentOutputs.size() > limit;
+    if (fMore) {
+        unspentOutputs.resize(limit);
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
-
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
@@ -664,6 +831,12 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         result.push_back(output);
     }
 
+    if (fPaged) {
+        UniValue page(UniValue::VOBJ);
+        page.pushKV("utxos", result);
+        page.pushKV("cursor", fMore ? encodeCursor(std::make_pair(unspentOutputs.back().first, unspentOutputs.back().second.blockHeight)) : NullUniValue);
+        return page;
+    }
     return result;
 }
 
@@ -682,6 +855,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return at most this many deltas and a cursor to the next ones\n"
+            "  \"cursor\" (string, optional) The cursor returned by the previous call, to get the next deltas\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -694,6 +869,11 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (if limit or cursor is given):\n"
+            "{\n"
+            "  \"deltas\": [...]  (array) The deltas as above\n"
+            "  \"cursor\": \"xxxx\"  (string) The cursor to pass to get the next deltas, null if there are none\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
@@ -720,18 +900,35 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    size_t limit;
+    bool fHaveCursor;
+    CAddressIndexKey cursor;
+    const bool fPaged = getPagingFromParams(request.params, limit, fHaveCursor, cursor);
+    const std::pair<CAddressIndexKey, CAmount> cursorEntry(cursor, 0);
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    // Entries are sorted by height within an address, so the scans can start at the height of the cursor
+    int nStart = start > 0 && end > 0 ? start : 0;
+    if (fHaveCursor) {
+        nStart = std::max(nStart, std::max(1, cursor.blockHeight));
+    }
+    const int nEnd = start > 0 && end > 0 ? end : 0;
+
+    typedef std::vector<std::pair<CAddressIndexKey, CAmount> > AddressDeltas;
+    std::vector<AddressDeltas> streams = QueryAddresses<AddressDeltas>(addresses, [&](const std::pair<uint160, int>& address, const CDBSnapshot& snapshot, AddressDeltas& deltas) {
+        if (!GetAddressIndex(address.first, address.second, deltas, nStart, nEnd, &snapshot)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
+        if (fHaveCursor) {
+            deltas.erase(std::remove_if(deltas.begin(), deltas.end(), [&](const AddressDeltas::value_type& delta) {
+                return !deltaSort(cursorEntry, delta);
+            }), deltas.end());
+        }
+    });
+    // Fetch one more to know whether there is a next page
+    AddressDeltas addressIndex = MergeSorted(streams, deltaSort, limit ? limit + 1 : 0);
+    const bool fMore = limit && addressIndex.size() > limit;
+    if (fMore) {
+        addressIndex.resize(limit);
     }
 
     UniValue result(UniValue::VARR);
@@ -752,6 +949,12 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         result.push_back(delta);
     }
 
+    if (fPaged) {
+        UniValue page(UniValue::VOBJ);
+        page.pushKV("deltas", result);
+        page.pushKV("cursor", fMore ? encodeCursor(addressIndex.back().first) : NullUniValue);
+        return page;
+    }
     return result;
 }
 
@@ -787,14 +990,6 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     int nHeight;
     {
         LOCK(cs_main);
@@ -806,17 +1001,44 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
     CAmount balance_immature = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    struct AddressBalance {
+        CAmount balance{0};
+        CAmount balance_immature{0};
+        CAmount received{0};
+    };
+    std::vector<AddressBalance> balances = QueryAddresses<AddressBalance>(addresses, [&](const std::pair<uint160, int>& address, const CDBSnapshot& snapshot, AddressBalance& result) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        CAddressIndexSummary summary;
+        const bool fSummary = GetAddressSummary(address.first, address.second, summary);
+        // With a summary only the entries that can still be immature need to be read
+        const int nStart = fSummary ? std::max(1, nHeight - COINBASE_MATURITY + 1) : 0;
+        if (!GetAddressIndex(address.first, address.second, addressIndex, nStart, 0, &snapshot)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        if (it->first.txindex == 0 && nHeight - it->first.blockHeight < COINBASE_MATURITY) {
-            balance_immature += it->second;
-        } else {
-            balance_spendable += it->second;
+
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+            if (!fSummary) {
+                if (it->second > 0) {
+                    result.received += it->second;
+                }
+                result.balance += it->second;
+            }
+            if (it->first.txindex == 0 && nHeight - it->first.blockHeight < COINBASE_MATURITY) {
+                result.balance_immature += it->second;
+            }
+        }
+        if (fSummary) {
+            result.balance = summary.balance;
+            result.received = summary.received;
         }
-        balance += it->second;
+    });
+
+    for (const AddressBalance& address_balance : balances) {
+        balance += address_balance.balance;
+        balance_immature += address_balance.balance_immature;
+        received += address_balance.received;
     }
+    balance_spendable = balance - balance_immature;
 
     UniValue result(UniValue::VOBJ);
     result.pushKV("balance", balance);
@@ -871,22 +1093,19 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    const int nStart = start > 0 && end > 0 ? start : 0;
+    const int nEnd = start > 0 && end > 0 ? end : 0;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    typedef std::vector<std::pair<CAddressIndexKey, CAmount> > AddressDeltas;
+    std::vector<AddressDeltas> streams = QueryAddresses<AddressDeltas>(addresses, [&](const std::pair<uint160, int>& address, const CDBSnapshot& snapshot, AddressDeltas& deltas) {
+        if (!GetAddressIndex(address.first, address.second, deltas, nStart, nEnd, &snapshot)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-    }
+    });
+    AddressDeltas addressIndex = MergeSorted(streams, deltaSort, 0);
 
     std::set<std::pair<int, std::string> > txids;
-    UniValue result(UniValue::VARR);
+    JSONResultBuilder result(request.resultWriter, UniValue::VARR);
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
         int height = it->first.blockHeight;
@@ -907,8 +1126,7 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
-    return result;
-
+    return result.Finish();
 }
 
 UniValue getspentinfo(const JSONRPCRequest& request)
@@ -971,6 +1189,50 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCMNListCacheInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    if (!deterministicMNManager) {
+        return obj;
+    }
+    CDeterministicMNListCacheStats stats = deterministicMNManager->GetListCacheStats();
+    obj.pushKV("lookups", stats.nLookups);
+    obj.pushKV("snapshot_loads", stats.nSnapshotLoads);
+    obj.pushKV("checkpoint_hits", stats.nCheckpointHits);
+    obj.pushKV("diffs_applied", stats.nDiffsApplied);
+    obj.pushKV("cached_lists", uint64_t(stats.nCachedLists));
+    obj.pushKV("checkpoints", uint64_t(stats.nCheckpoints));
+    return obj;
+}
+
+static UniValue RPCDKGMessagesInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    if (!llmq::quorumDKGSessionManager) {
+        return obj;
+    }
+    llmq::CDKGMessageStats stats = llmq::quorumDKGSessionManager->GetMessageStats();
+    obj.pushKV("pending", uint64_t(stats.nPendingMessages));
+    obj.pushKV("pending_bytes", uint64_t(stats.nPendingBytes));
+    obj.pushKV("seen", uint64_t(stats.nSeenMessages));
+    obj.pushKV("duplicates", stats.nDuplicates);
+    obj.pushKV("dropped", stats.nDropped);
+    obj.pushKV("session", uint64_t(stats.nSessionMessages));
+    return obj;
+}
+
+static UniValue RPCSubsystemUsageInfo()
+{
+    UniValue obj(UniValue::VOBJ);
+    uint64_t nTotal = 0;
+    for (const auto& p : g_memory_accounting.GetUsages()) {
+        obj.pushKV(p.first, uint64_t(p.second));
+        nTotal += p.second;
+    }
+    obj.pushKV("total", nTotal);
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -1012,6 +1274,28 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"mnlists\": {              (json object) Information about the masternode list caches\n"
+            "    \"lookups\": xxxxx,         (numeric) Number of masternode lists requested\n"
+            "    \"snapshot_loads\": xxxxx,  (numeric) Number of lookups that had to start from a snapshot on disk\n"
+            "    \"checkpoint_hits\": xxxxx, (numeric) Number of lookups that could start from a cached checkpoint\n"
+            "    \"diffs_applied\": xxxxx,   (numeric) Total number of list diffs applied by all lookups\n"
+            "    \"cached_lists\": xxxxx,    (numeric) Number of lists in the regular cache\n"
+            "    \"checkpoints\": xxxxx,     (numeric) Number of cached checkpoint lists of historic blocks\n"
+            "  },\n"
+            "  \"dkgmessages\": {          (json object) Information about the stored LLMQ DKG messages\n"
+            "    \"pending\": xxxxx,         (numeric) Number of messages waiting to be processed\n"
+            "    \"pending_bytes\": xxxxx,   (numeric) Size of the messages waiting to be processed\n"
+            "    \"seen\": xxxxx,            (numeric) Number of distinct messages seen in the current sessions\n"
+            "    \"duplicates\": xxxxx,      (numeric) Number of received messages that were already seen\n"
+            "    \"dropped\": xxxxx,         (numeric) Number of messages dropped because a limit was reached\n"
+            "    \"session\": xxxxx,         (numeric) Number of messages held by the current sessions\n"
+            "  },\n"
+            "  \"usage\": {                (json object) Estimated heap memory used by the caches and maps of each subsystem\n"
+            "    \"name\": xxxxx,            (numeric) Estimated number of bytes used by the subsystem, e.g. \"mempool\", \"mnlists\",\n"
+            "                              \"quorums\", \"sigshares\", \"instantsend\", \"dkg\", \"governance\" or \"coinjoin\"\n"
+            "    ...\n"
+            "    \"total\": xxxxx,           (numeric) Sum of all subsystems\n"
             "  }\n"
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
@@ -1025,6 +1309,9 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("mnlists", RPCMNListCacheInfo());
+        obj.pushKV("dkgmessages", RPCDKGMessagesInfo());
+        obj.pushKV("usage", RPCSubsystemUsageInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
@@ -1037,6 +1324,81 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+            "getlockstats ( count reset )\n"
+            "Returns the wait and hold times of locks recorded with -lockprofile, per call site and sorted by\n"
+            "the total time spent waiting for the lock. Hold times are sampled, durations are in microseconds\n"
+            "and percentiles are rounded up to the next power of 2.\n"
+            "\nArguments:\n"
+            "1. count      (numeric, optional, default=50) The number of call sites to return, 0 for all\n"
+            "2. reset      (boolean, optional, default=false) Clear the recorded times after returning them\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",          (string) The lock, as passed to LOCK\n"
+            "    \"location\": \"xxxx\",      (string) The file and line of the call site\n"
+            "    \"contentions\": n,        (numeric) Number of acquisitions which had to wait for another thread\n"
+            "    \"wait_total\": n,         (numeric) Total time spent waiting\n"
+            "    \"wait_p50\": n,           (numeric) Median wait of the contended acquisitions\n"
+            "    \"wait_p99\": n,           (numeric) 99th percentile wait of the contended acquisitions\n"
+            "    \"wait_max\": n,           (numeric) Longest wait\n"
+            "    \"hold_samples\": n,       (numeric) Number of acquisitions whose hold time was measured\n"
+            "    \"hold_avg\": n,           (numeric) Average hold time of the samples\n"
+            "    \"hold_p50\": n,           (numeric) Median hold time of the samples\n"
+            "    \"hold_p99\": n,           (numeric) 99th percentile hold time of the samples\n"
+            "    \"hold_max\": n,           (numeric) Longest hold time of the samples\n"
+            "  },...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "10 true")
+            + HelpExampleRpc("getlockstats", "10")
+        );
+
+    if (!g_lock_profile) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Lock profiling is disabled, start with -lockprofile");
+    }
+
+    int nCount = request.params[0].isNull() ? 50 : request.params[0].get_int();
+    if (nCount < 0) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "count must not be negative");
+    }
+    bool fReset = request.params[1].isNull() ? false : request.params[1].get_bool();
+
+    std::vector<LockProfileStats> vecStats = GetLockProfileStats();
+    if (fReset) {
+        ResetLockProfileStats();
+    }
+    std::sort(vecStats.begin(), vecStats.end(), [](const LockProfileStats& a, const LockProfileStats& b) {
+        return a.nWaitMicros != b.nWaitMicros ? a.nWaitMicros > b.nWaitMicros : a.nHoldMicros > b.nHoldMicros;
+    });
+    if (nCount != 0 && vecStats.size() > (size_t)nCount) {
+        vecStats.resize(nCount);
+    }
+
+    UniValue ret(UniValue::VARR);
+    for (const LockProfileStats& stats : vecStats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("name", stats.strName);
+        obj.pushKV("location", strprintf("%s:%d", stats.strFile, stats.nLine));
+        obj.pushKV("contentions", (int64_t)stats.nContentions);
+        obj.pushKV("wait_total", stats.nWaitMicros);
+        obj.pushKV("wait_p50", LockProfileStats::GetPercentile(stats.waitHistogram, 50));
+        obj.pushKV("wait_p99", LockProfileStats::GetPercentile(stats.waitHistogram, 99));
+        obj.pushKV("wait_max", stats.nMaxWaitMicros);
+        obj.pushKV("hold_samples", (int64_t)stats.nHoldSamples);
+        obj.pushKV("hold_avg", stats.nHoldSamples ? stats.nHoldMicros / (int64_t)stats.nHoldSamples : 0);
+        obj.pushKV("hold_p50", LockProfileStats::GetPercentile(stats.holdHistogram, 50));
+        obj.pushKV("hold_p99", LockProfileStats::GetPercentile(stats.holdHistogram, 99));
+        obj.pushKV("hold_max", stats.nMaxHoldMicros);
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
 uint64_t getCategoryMask(UniValue cats) {
     cats = cats.get_array();
     uint64_t mask = 0;
@@ -1155,6 +1517,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "debug",                  &debug,                  {} },
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getlockstats",           &getlockstats,           {"count", "reset"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
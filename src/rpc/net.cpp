@@ -66,6 +66,25 @@ UniValue ping(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+static UniValue MsgProcessingToJSON(const mapMsgCmdProcessing& mapProcessing, int64_t nTotalMicros)
+{
+    UniValue ret(UniValue::VOBJ);
+    for (const auto& p : mapProcessing) {
+        const CMsgProcessingStats& stats = p.second;
+        if (stats.nCount == 0) {
+            continue;
+        }
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", (int64_t)stats.nCount);
+        obj.pushKV("time", stats.nTimeMicros);
+        obj.pushKV("avg_time", stats.nTimeMicros / (int64_t)stats.nCount);
+        obj.pushKV("max_time", stats.nMaxTimeMicros);
+        obj.pushKV("time_share", nTotalMicros > 0 ? (double)stats.nTimeMicros / nTotalMicros : 0.0);
+        ret.pushKV(p.first, obj);
+    }
+    return ret;
+}
+
 UniValue getpeerinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -105,10 +124,18 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"banscore\": n,             (numeric) The ban score\n"
             "    \"synced_headers\": n,       (numeric) The last header we have in common with this peer\n"
             "    \"synced_blocks\": n,        (numeric) The last block we have in common with this peer\n"
+            "    \"blockannouncedelay\": n,   (numeric) Average time in seconds this peer announced new blocks after the first peer did (if any)\n"
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"blockdownload\": {\n"
+            "       \"window\": n,            (numeric) The number of blocks we may have in flight from this peer\n"
+            "       \"bytespersec\": n,       (numeric) Average download speed of the blocks requested from this peer (if known)\n"
+            "       \"blocks\": n,            (numeric) The number of requested blocks received from this peer\n"
+            "       \"bytes\": n,             (numeric) The total size of those blocks\n"
+            "       \"reassigned\": n,        (numeric) The number of blocks requested from faster peers instead\n"
+            "    },\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"bytessent_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes sent aggregated by message type\n"
@@ -117,6 +144,11 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"bytesrecv_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
+            "    },\n"
+            "    \"processing_time\": n,    (numeric) The total time in microseconds spent processing messages of this peer\n"
+            "    \"processing_per_msg\": {\n"
+            "       \"addr\": {...},          (json object) The processing stats aggregated by message type, see getnetmsgstats\n"
+            "       ...\n"
             "    }\n"
             "  }\n"
             "  ,...\n"
@@ -177,11 +209,23 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             obj.pushKV("banscore", statestats.nMisbehavior);
             obj.pushKV("synced_headers", statestats.nSyncHeight);
             obj.pushKV("synced_blocks", statestats.nCommonHeight);
+            if (statestats.nBlockAnnounceDelay >= 0) {
+                obj.pushKV("blockannouncedelay", statestats.nBlockAnnounceDelay / 1e6);
+            }
             UniValue heights(UniValue::VARR);
             for (int height : statestats.vHeightInFlight) {
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            UniValue blockDownload(UniValue::VOBJ);
+            blockDownload.pushKV("window", statestats.nBlockDownloadWindow);
+            if (statestats.nBlockDownloadBytesPerSecond >= 0) {
+                blockDownload.pushKV("bytespersec", statestats.nBlockDownloadBytesPerSecond);
+            }
+            blockDownload.pushKV("blocks", statestats.nBlocksDownloaded);
+            blockDownload.pushKV("bytes", statestats.nBlockBytesDownloaded);
+            blockDownload.pushKV("reassigned", statestats.nBlocksReassigned);
+            obj.pushKV("blockdownload", blockDownload);
         }
         obj.pushKV("whitelisted", stats.fWhitelisted);
 
@@ -199,6 +243,9 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.pushKV("bytesrecv_per_msg", recvPerMsgCmd);
 
+        obj.pushKV("processing_time", stats.nProcessingTimeMicros);
+        obj.pushKV("processing_per_msg", MsgProcessingToJSON(stats.mapProcessingPerMsgCmd, stats.nProcessingTimeMicros));
+
         ret.push_back(obj);
     }
 
@@ -408,6 +455,91 @@ UniValue getnettotals(const JSONRPCRequest& request)
     return obj;
 }
 
+UniValue getnetmsgstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            "getnetmsgstats\n"
+            "\nReturns how many messages of each type were processed since startup and how long their\n"
+            "handlers ran, summed over all peers including the disconnected ones. Times are in microseconds.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"total_time\": n,         (numeric) Total time spent processing messages\n"
+            "  \"messages\": {\n"
+            "    \"addr\": {\n"
+            "      \"count\": n,          (numeric) Number of messages processed\n"
+            "      \"time\": n,           (numeric) Total processing time\n"
+            "      \"avg_time\": n,       (numeric) Average processing time of a message\n"
+            "      \"max_time\": n,       (numeric) Longest processing time of a message\n"
+            "      \"time_share\": x.xxx, (numeric) Share of the total processing time\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getnetmsgstats", "")
+            + HelpExampleRpc("getnetmsgstats", "")
+       );
+    if(!g_connman)
+        throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+    const mapMsgCmdProcessing mapProcessing = g_connman->GetMsgProcessingStats();
+    int64_t nTotalMicros = 0;
+    for (const auto& p : mapProcessing) {
+        nTotalMicros += p.second.nTimeMicros;
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("total_time", nTotalMicros);
+    obj.pushKV("messages", MsgProcessingToJSON(mapProcessing, nTotalMicros));
+    return obj;
+}
+
+UniValue getblockreconstructionstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            "getblockreconstructionstats\n"
+            "\nReturns statistics about the reconstruction of blocks received as compact blocks.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": n,              (numeric) Number of compact blocks for which a reconstruction was attempted\n"
+            "  \"reconstructed\": n,       (numeric) Number of blocks reconstructed without any further round trip\n"
+            "  \"roundtrips\": n,          (numeric) Number of blocks for which missing transactions had to be requested\n"
+            "  \"failed\": n,              (numeric) Number of blocks for which the full block had to be requested\n"
+            "  \"roundtrips_saved\": n,    (numeric) Number of blocks reconstructed without round trip only thanks to\n"
+            "                              transactions known to InstantSend or CoinJoin\n"
+            "  \"txn\":                    (json object) Number of transactions taken from each source\n"
+            "  {\n"
+            "    \"prefilled\": n,         (numeric) Prefilled by the peer\n"
+            "    \"mempool\": n,           (numeric) Found in the mempool\n"
+            "    \"extra\": n,             (numeric) Found in orphans and recently replaced transactions\n"
+            "    \"instantsend_coinjoin\": n, (numeric) Found in InstantSend and CoinJoin (DSTX) transactions\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockreconstructionstats", "")
+            + HelpExampleRpc("getblockreconstructionstats", "")
+       );
+
+    const CCompactBlockReconstructionStats stats = GetCompactBlockReconstructionStats();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("blocks", stats.nBlocks);
+    obj.pushKV("reconstructed", stats.nReconstructed);
+    obj.pushKV("roundtrips", stats.nRoundTrips);
+    obj.pushKV("failed", stats.nFailed);
+    obj.pushKV("roundtrips_saved", stats.nRoundTripsSaved);
+
+    UniValue txn(UniValue::VOBJ);
+    txn.pushKV("prefilled", stats.nTxPrefilled);
+    txn.pushKV("mempool", stats.nTxMempool);
+    txn.pushKV("extra", stats.nTxExtra);
+    txn.pushKV("instantsend_coinjoin", stats.nTxDash);
+    obj.pushKV("txn", txn);
+    return obj;
+}
+
 static UniValue GetNetworksInfo()
 {
     UniValue networks(UniValue::VARR);
@@ -429,6 +561,16 @@ static UniValue GetNetworksInfo()
     return networks;
 }
 
+static UniValue BufferPoolStatsToJSON(const CNetBufferPoolStats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("hits", stats.nHits);
+    obj.pushKV("misses", stats.nMisses);
+    obj.pushKV("buffers", (uint64_t)stats.nPooledBuffers);
+    obj.pushKV("bytes", (uint64_t)stats.nPooledBytes);
+    return obj;
+}
+
 UniValue getnetworkinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -447,6 +589,14 @@ UniValue getnetworkinfo(const JSONRPCRequest& request)
             "  \"connections\": xxxxx,                  (numeric) the number of connections\n"
             "  \"networkactive\": true|false,           (bool) whether p2p networking is enabled\n"
             "  \"socketevents\": \"xxx/\",              (string) the socket events mode, either kqueue, epoll, poll or select\n"
+            "  \"bufferpools\": {                       (json object) reuse statistics of the message buffer pools\n"
+            "    \"recv\"|\"send\": {                   (json object) pool for received or sent message payloads\n"
+            "      \"hits\": xxxxx,                     (numeric) number of buffers taken from the pool\n"
+            "      \"misses\": xxxxx,                   (numeric) number of buffers that had to be allocated\n"
+            "      \"buffers\": xxxxx,                  (numeric) number of buffers currently kept in the pool\n"
+            "      \"bytes\": xxxxx                     (numeric) total capacity of the buffers currently kept in the pool\n"
+            "    }\n"
+            "  },\n"
             "  \"networks\": [                          (array) information per network\n"
             "  {\n"
             "    \"name\": \"xxx\",                     (string) network (ipv4, ipv6 or onion)\n"
@@ -506,6 +656,10 @@ UniValue getnetworkinfo(const JSONRPCRequest& request)
         }
         obj.pushKV("socketevents", strSocketEvents);
     }
+    UniValue bufferPools(UniValue::VOBJ);
+    bufferPools.pushKV("recv", BufferPoolStatsToJSON(g_recv_buffer_pool.GetStats()));
+    bufferPools.pushKV("send", BufferPoolStatsToJSON(g_send_buffer_pool.GetStats()));
+    obj.pushKV("bufferpools", bufferPools);
     obj.pushKV("networks",      GetNetworksInfo());
     obj.pushKV("relayfee",      ValueFromAmount(::minRelayTxFee.GetFeePerK()));
     obj.pushKV("incrementalfee", ValueFromAmount(::incrementalRelayFee.GetFeePerK()));
@@ -538,6 +692,8 @@ UniValue setban(const JSONRPCRequest& request)
                             "\nAttempts to add or remove an IP/Subnet from the banned list.\n"
                             "\nArguments:\n"
                             "1. \"subnet\"       (string, required) The IP/Subnet (see getpeerinfo for nodes IP) with an optional netmask (default is /32 = single IP)\n"
+                            "                    For 'add' this can also be a json array of IPs/Subnets to import them at once, the ones which are\n"
+                            "                    already banned are skipped.\n"
                             "2. \"command\"      (string, required) 'add' to add an IP/Subnet to the list, 'remove' to remove an IP/Subnet from the list\n"
                             "3. \"bantime\"      (numeric, optional) time in seconds how long (or until when if [absolute] is set) the IP is banned (0 or empty means using the default time of 24h which can also be overwritten by the -bantime startup argument)\n"
                             "4. \"absolute\"     (boolean, optional) If set, the bantime must be an absolute timestamp in seconds since epoch (Jan 1 1970 GMT)\n"
@@ -549,6 +705,30 @@ UniValue setban(const JSONRPCRequest& request)
     if(!g_connman)
         throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
 
+    int64_t banTime = 0; //use standard bantime if not specified
+    if (!request.params[2].isNull())
+        banTime = request.params[2].get_int64();
+
+    bool absolute = false;
+    if (request.params[3].isTrue())
+        absolute = true;
+
+    if (request.params[0].isArray()) {
+        if (strCommand != "add")
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Error: Only 'add' accepts multiple IPs/Subnets");
+
+        std::vector<CSubNet> vSubNets;
+        for (const UniValue& entry : request.params[0].get_array().getValues()) {
+            CSubNet subNet;
+            LookupSubNet(entry.get_str().c_str(), subNet);
+            if (!subNet.IsValid())
+                throw JSONRPCError(RPC_CLIENT_INVALID_IP_OR_SUBNET, strprintf("Error: Invalid IP/Subnet %s", entry.get_str()));
+            vSubNets.emplace_back(subNet);
+        }
+        g_connman->Ban(vSubNets, BanReasonManuallyAdded, banTime, absolute);
+        return NullUniValue;
+    }
+
     CSubNet subNet;
     CNetAddr netAddr;
     bool isSubnet = false;
@@ -572,14 +752,6 @@ UniValue setban(const JSONRPCRequest& request)
         if (isSubnet ? g_connman->IsBanned(subNet) : g_connman->IsBanned(netAddr))
             throw JSONRPCError(RPC_CLIENT_NODE_ALREADY_ADDED, "Error: IP/Subnet already banned");
 
-        int64_t banTime = 0; //use standard bantime if not specified
-        if (!request.params[2].isNull())
-            banTime = request.params[2].get_int64();
-
-        bool absolute = false;
-        if (request.params[3].isTrue())
-            absolute = true;
-
         isSubnet ? g_connman->Ban(subNet, BanReasonManuallyAdded, banTime, absolute) : g_connman->Ban(netAddr, BanReasonManuallyAdded, banTime, absolute);
     }
     else if(strCommand == "remove")
@@ -671,7 +843,9 @@ static const CRPCCommand commands[] =
     { "network",            "disconnectnode",         &disconnectnode,         {"address", "nodeid"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       {"node"} },
     { "network",            "getnettotals",           &getnettotals,           {} },
+    { "network",            "getnetmsgstats",         &getnetmsgstats,         {} },
     { "network",            "getnetworkinfo",         &getnetworkinfo,         {} },
+    { "network",            "getblockreconstructionstats", &getblockreconstructionstats, {} },
     { "network",            "setban",                 &setban,                 {"subnet", "command", "bantime", "absolute"} },
     { "network",            "listbanned",             &listbanned,             {} },
     { "network",            "clearbanned",            &clearbanned,            {} },
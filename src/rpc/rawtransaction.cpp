@@ -8,6 +8,7 @@
 #include <coins.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <index/blocktreeindex.h>
 #include <init.h>
 #include <keystore.h>
 #include <validation.h>
@@ -19,6 +20,7 @@
 #include <primitives/transaction.h>
 #include <rpc/rawtransaction.h>
 #include <rpc/server.h>
+#include <rpc/util.h>
 #include <script/script.h>
 #include <script/script_error.h>
 #include <script/sign.h>
@@ -54,23 +56,20 @@ void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry)
 
     uint256 txid = tx.GetHash();
 
-    // Add spent information if spentindex is enabled
+    // Add spent information if spentindex is enabled, the inputs and outputs are looked up in one batch
     CSpentIndexTxInfo txSpentInfo;
-    for (const auto& txin : tx.vin) {
+    if (fSpentIndex) {
+        std::vector<CSpentIndexKey> spentKeys;
+        spentKeys.reserve(tx.vin.size() + tx.vout.size());
         if (!tx.IsCoinBase()) {
-            CSpentIndexValue spentInfo;
-            CSpentIndexKey spentKey(txin.prevout.hash, txin.prevout.n);
-            if (GetSpentIndex(spentKey, spentInfo)) {
-                txSpentInfo.mSpentInfo.emplace(spentKey, spentInfo);
+            for (const auto& txin : tx.vin) {
+                spentKeys.emplace_back(txin.prevout.hash, txin.prevout.n);
             }
         }
-    }
-    for (unsigned int i = 0; i < tx.vout.size(); i++) {
-        CSpentIndexValue spentInfo;
-        CSpentIndexKey spentKey(txid, i);
-        if (GetSpentIndex(spentKey, spentInfo)) {
-            txSpentInfo.mSpentInfo.emplace(spentKey, spentInfo);
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            spentKeys.emplace_back(txid, i);
         }
+        GetSpentIndex(spentKeys, txSpentInfo);
     }
 
     TxToUniv(tx, uint256(), entry, true, &txSpentInfo);
@@ -218,13 +217,21 @@ UniValue getrawtransaction(const JSONRPCRequest& request)
             }
             errmsg = "No such transaction found in the provided block";
         } else {
-            errmsg = fTxIndex
-              ? "No such mempool or blockchain transaction"
-              : "No such mempool transaction. Use -txindex to enable blockchain transaction queries";
+            if (!fTxIndex) {
+                errmsg = "No such mempool transaction. Use -txindex to enable blockchain transaction queries";
+            } else if (g_blocktreeindexbuilder && g_blocktreeindexbuilder->IsBuilding("txindex")) {
+                errmsg = "No such mempool or blockchain transaction. The transaction index is still being built";
+            } else {
+                errmsg = "No such mempool or blockchain transaction";
+            }
         }
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, errmsg + ". Use gettransaction for wallet transactions.");
     }
 
+    if (WriteBinaryResult(request, *tx)) {
+        return NullUniValue;
+    }
+
     if (!fVerbose) {
         return EncodeHexTx(*tx);
     }
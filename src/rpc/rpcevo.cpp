@@ -7,7 +7,9 @@
 #include <core_io.h>
 #include <init.h>
 #include <messagesigner.h>
+#include <rpc/jsonstream.h>
 #include <rpc/server.h>
+#include <rpc/util.h>
 #include <txmempool.h>
 #include <utilmoneystr.h>
 #include <validation.h>
@@ -27,6 +29,8 @@
 
 #include <bls/bls.h>
 
+#include <llmq/quorums_commitment.h>
+
 #include <masternode/masternode-meta.h>
 
 #ifdef ENABLE_WALLET
@@ -872,15 +876,20 @@ UniValue protx_revoke(const JSONRPCRequest& request)
 void protx_list_help()
 {
     throw std::runtime_error(
-            "protx list (\"type\" \"detailed\" \"height\")\n"
+            "protx list (\"type\" \"detailed\" \"height\" \"count\" \"skip\")\n"
+            "protx list address \"address\" (\"detailed\" \"height\" \"count\" \"skip\")\n"
             "\nLists all ProTxs in your wallet or on-chain, depending on the given type.\n"
             "If \"type\" is not specified, it defaults to \"registered\".\n"
             "If \"detailed\" is not specified, it defaults to \"false\" and only the hashes of the ProTx will be returned.\n"
             "If \"height\" is not specified, it defaults to the current chain-tip.\n"
+            "If \"count\" is specified and not 0, at most \"count\" ProTxs are returned, after skipping the first \"skip\" ones.\n"
+            "The order only depends on the masternode list, so pass a \"height\" when paging through the ProTxs.\n"
             "\nAvailable types:\n"
             "  registered   - List all ProTx which are registered at the given chain height.\n"
             "                 This will also include ProTx which failed PoSe verfication.\n"
             "  valid        - List only ProTx which are active/valid at the given chain height.\n"
+            "  address      - List the ProTx which use the given address as payout, operator payout, owner or voting\n"
+            "                 address at the given chain height. This will also include ProTx which failed PoSe verfication.\n"
 #ifdef ENABLE_WALLET
             "  wallet       - List only ProTx which are found in your wallet at the given chain height.\n"
             "                 This will also include ProTx which failed PoSe verfication.\n"
@@ -960,6 +969,68 @@ UniValue BuildDMNListEntry(CWallet* pwallet, const CDeterministicMNCPtr& dmn, bo
     return o;
 }
 
+// The ProTxs of one page of "protx list"
+class CProTxListPage
+{
+public:
+    CProTxListPage(const JSONRPCRequest& request, size_t firstParam, JSONResultBuilder& _ret) : ret(_ret)
+    {
+        if (request.params.size() > firstParam + 4) {
+            protx_list_help();
+        }
+
+        detailed = !request.params[firstParam].isNull() ? ParseBoolV(request.params[firstParam], "detailed") : false;
+
+        height = !request.params[firstParam + 1].isNull() ? ParseInt32V(request.params[firstParam + 1], "height") : chainActive.Height();
+        if (height < 1 || height > chainActive.Height()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid height specified");
+        }
+
+        if (!request.params[firstParam + 2].isNull()) {
+            count = ParseInt32V(request.params[firstParam + 2], "count");
+            if (count < 0) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid count specified");
+            }
+        }
+        if (!request.params[firstParam + 3].isNull()) {
+            skip = ParseInt32V(request.params[firstParam + 3], "skip");
+            if (skip < 0) {
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid skip specified");
+            }
+        }
+    }
+
+    CDeterministicMNList GetMNList() const
+    {
+        if (deterministicMNManager->IsListPruned(chainActive[height])) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Masternode list not available (pruned data)");
+        }
+        return deterministicMNManager->GetListForBlock(chainActive[height]);
+    }
+
+    void Push(CWallet* pwallet, const CDeterministicMNCPtr& dmn)
+    {
+        // only the entries of the page are built, which is the expensive part
+        if (skip > 0) {
+            skip--;
+            return;
+        }
+        if (count != 0 && pushed >= count) {
+            return;
+        }
+        ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
+        pushed++;
+    }
+
+private:
+    JSONResultBuilder& ret;
+    bool detailed{false};
+    int height;
+    int count{0};
+    int skip{0};
+    int pushed{0};
+};
+
 UniValue protx_list(const JSONRPCRequest& request)
 {
     if (request.fHelp) {
@@ -978,7 +1049,7 @@ UniValue protx_list(const JSONRPCRequest& request)
         type = request.params[1].get_str();
     }
 
-    UniValue ret(UniValue::VARR);
+    JSONResultBuilder ret(request.resultWriter, UniValue::VARR);
 
     LOCK(cs_main);
 
@@ -989,16 +1060,7 @@ UniValue protx_list(const JSONRPCRequest& request)
 #ifdef ENABLE_WALLET
         LOCK2(cs_main, pwallet->cs_wallet);
 
-        if (request.params.size() > 4) {
-            protx_list_help();
-        }
-
-        bool detailed = !request.params[2].isNull() ? ParseBoolV(request.params[2], "detailed") : false;
-
-        int height = !request.params[3].isNull() ? ParseInt32V(request.params[3], "height") : chainActive.Height();
-        if (height < 1 || height > chainActive.Height()) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid height specified");
-        }
+        CProTxListPage page(request, 2, ret);
 
         std::vector<COutPoint> vOutpts;
         pwallet->ListProTxCoins(vOutpts);
@@ -1007,41 +1069,62 @@ UniValue protx_list(const JSONRPCRequest& request)
             setOutpts.emplace(outpt);
         }
 
-        CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(chainActive[height]);
+        CDeterministicMNList mnList = page.GetMNList();
         mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
             if (setOutpts.count(dmn->collateralOutpoint) ||
                 CheckWalletOwnsKey(pwallet, dmn->pdmnState->keyIDOwner) ||
                 CheckWalletOwnsKey(pwallet, dmn->pdmnState->keyIDVoting) ||
                 CheckWalletOwnsScript(pwallet, dmn->pdmnState->scriptPayout) ||
                 CheckWalletOwnsScript(pwallet, dmn->pdmnState->scriptOperatorPayout)) {
-                ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
+                page.Push(pwallet, dmn);
             }
         });
 #endif
     } else if (type == "valid" || type == "registered") {
-        if (request.params.size() > 4) {
-            protx_list_help();
-        }
-
-        LOCK(cs_main);
-
-        bool detailed = !request.params[2].isNull() ? ParseBoolV(request.params[2], "detailed") : false;
-
-        int height = !request.params[3].isNull() ? ParseInt32V(request.params[3], "height") : chainActive.Height();
-        if (height < 1 || height > chainActive.Height()) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid height specified");
-        }
+        CProTxListPage page(request, 2, ret);
 
-        CDeterministicMNList mnList = deterministicMNManager->GetListForBlock(chainActive[height]);
+        CDeterministicMNList mnList = page.GetMNList();
         bool onlyValid = type == "valid";
         mnList.ForEachMN(onlyValid, [&](const CDeterministicMNCPtr& dmn) {
-            ret.push_back(BuildDMNListEntry(pwallet, dmn, detailed));
+            page.Push(pwallet, dmn);
         });
+    } else if (type == "address") {
+        if (request.params[2].isNull()) {
+            protx_list_help();
+        }
+        CTxDestination dest = DecodeDestination(request.params[2].get_str());
+        if (!IsValidDestination(dest)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("invalid address: %s", request.params[2].get_str()));
+        }
+        CProTxListPage page(request, 3, ret);
+
+        // looked up through the indexes of the list instead of checking all MNs
+        CDeterministicMNList mnList = page.GetMNList();
+        std::map<uint256, CDeterministicMNCPtr> mapMNs;
+        CScript script = GetScriptForDestination(dest);
+        for (const auto& dmn : mnList.GetMNsByPayoutScript(script)) {
+            mapMNs.emplace(dmn->proTxHash, dmn);
+        }
+        for (const auto& dmn : mnList.GetMNsByOperatorPayoutScript(script)) {
+            mapMNs.emplace(dmn->proTxHash, dmn);
+        }
+        if (auto keyID = boost::get<CKeyID>(&dest)) {
+            for (const auto& dmn : mnList.GetMNsByVotingKey(*keyID)) {
+                mapMNs.emplace(dmn->proTxHash, dmn);
+            }
+            auto dmn = mnList.GetUniquePropertyMN(*keyID);
+            if (dmn && dmn->pdmnState->keyIDOwner == *keyID) {
+                mapMNs.emplace(dmn->proTxHash, dmn);
+            }
+        }
+        for (const auto& p : mapMNs) {
+            page.Push(pwallet, p.second);
+        }
     } else {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid type specified");
     }
 
-    return ret;
+    return ret.Finish();
 }
 
 void protx_info_help()
@@ -1122,6 +1205,10 @@ UniValue protx_diff(const JSONRPCRequest& request)
         throw std::runtime_error(strError);
     }
 
+    if (WriteBinaryResult(request, mnListDiff)) {
+        return NullUniValue;
+    }
+
     UniValue ret;
     mnListDiff.ToJson(ret);
     return ret;
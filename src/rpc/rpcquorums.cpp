@@ -14,11 +14,47 @@
 #include <llmq/quorums_dkgsession.h>
 #include <llmq/quorums_signing.h>
 #include <llmq/quorums_signing_shares.h>
+#include <llmq/quorums_signing_stats.h>
 
 namespace llmq {
 extern const std::string CLSIG_REQUESTID_PREFIX;
 }
 
+// Maximum number of requests passed to one of the batch commands
+static const size_t MAX_QUORUM_BATCH_SIZE = 10000;
+
+// The requests of the batch commands, which dash-cli passes as a JSON string
+static UniValue ParseBatchRequests(const UniValue& param)
+{
+    UniValue requests(UniValue::VARR);
+    if (param.isStr()) {
+        if (!requests.read(param.get_str()) || !requests.isArray()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "requests must be a JSON array");
+        }
+    } else {
+        requests = param.get_array();
+    }
+    if (requests.size() > MAX_QUORUM_BATCH_SIZE) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("too many requests, the maximum is %d", MAX_QUORUM_BATCH_SIZE));
+    }
+    for (size_t i = 0; i < requests.size(); i++) {
+        if (!requests[i].isObject()) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("request %d is not an object", i));
+        }
+    }
+    return requests;
+}
+
+static CBLSSignature ParseBatchSignature(const UniValue& request)
+{
+    CBLSSignature sig;
+    const UniValue& sigVal = find_value(request.get_obj(), "signature");
+    if (!sigVal.isStr() || !sig.SetHexStr(sigVal.get_str())) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid signature format");
+    }
+    return sig;
+}
+
 void quorum_list_help()
 {
     throw std::runtime_error(
@@ -344,6 +380,144 @@ void quorum_getrecsig_help()
     );
 }
 
+// Verifies the signatures against the current active set first and those which fail against the last active set,
+// like the single signature commands do
+static std::vector<bool> VerifyRecoveredSigsOfActiveSets(Consensus::LLMQType llmqType, const std::vector<llmq::CRecoveredSigVerifyRequest>& vecRequests)
+{
+    std::vector<bool> ret = llmq::CSigningManager::VerifyRecoveredSigs(llmqType, vecRequests, 0);
+
+    std::vector<llmq::CRecoveredSigVerifyRequest> vecRetry;
+    std::vector<size_t> vecRetryIndexes;
+    for (size_t i = 0; i < ret.size(); i++) {
+        if (!ret[i]) {
+            vecRetry.emplace_back(vecRequests[i]);
+            vecRetryIndexes.emplace_back(i);
+        }
+    }
+    if (!vecRetry.empty()) {
+        int signOffset{Params().GetConsensus().llmqs.at(llmqType).dkgInterval};
+        auto retried = llmq::CSigningManager::VerifyRecoveredSigs(llmqType, vecRetry, signOffset);
+        for (size_t i = 0; i < retried.size(); i++) {
+            ret[vecRetryIndexes[i]] = retried[i];
+        }
+    }
+    return ret;
+}
+
+void quorum_signbatch_help()
+{
+    throw std::runtime_error(
+            "quorum signbatch llmqType [{\"id\":\"hash\",\"msgHash\":\"hash\",\"quorumHash\":\"hash\"},...]\n"
+            "Threshold-sign many messages at once and submit the signature shares to the network.\n"
+            "The quorums of all requests without a quorum hash are selected from the same active set.\n"
+            "\nArguments:\n"
+            "1. llmqType              (int, required) LLMQ type.\n"
+            "2. requests              (array, required) The requests, at most " + std::to_string(MAX_QUORUM_BATCH_SIZE) + ". \"quorumHash\" is optional.\n"
+            "\nResult:\n"
+            "[ true|false, ... ]     (array) For each request, whether a signature share will be created\n"
+    );
+}
+
+void quorum_verifybatch_help()
+{
+    throw std::runtime_error(
+            "quorum verifybatch llmqType [{\"id\":\"hash\",\"msgHash\":\"hash\",\"signature\":\"sig\"},...] ( signHeight )\n"
+            "Test if many quorum signatures are valid, verifying all of them in one batch.\n"
+            "\nArguments:\n"
+            "1. llmqType              (int, required) LLMQ type.\n"
+            "2. requests              (array, required) The requests, at most " + std::to_string(MAX_QUORUM_BATCH_SIZE) + ".\n"
+            "3. signHeight            (int, optional) The height at which the messages were signed.\n"
+            "\nResult:\n"
+            "[ true|false, ... ]     (array) For each request, whether the signature is valid\n"
+    );
+}
+
+void quorum_getrecsigbatch_help()
+{
+    throw std::runtime_error(
+            "quorum getrecsigbatch llmqType [{\"id\":\"hash\",\"msgHash\":\"hash\"},...]\n"
+            "Get many recovered signatures at once\n"
+            "\nArguments:\n"
+            "1. llmqType              (int, required) LLMQ type.\n"
+            "2. requests              (array, required) The requests, at most " + std::to_string(MAX_QUORUM_BATCH_SIZE) + ".\n"
+            "\nResult:\n"
+            "[ {...}|null, ... ]     (array) For each request, the recovered signature or null if there is none\n"
+    );
+}
+
+UniValue quorum_sigs_batch_cmd(const JSONRPCRequest& request)
+{
+    auto cmd = request.params[0].get_str();
+    if (request.fHelp || request.params.size() < 3 || request.params.size() > (cmd == "verifybatch" ? 4 : 3)) {
+        if (cmd == "signbatch") {
+            quorum_signbatch_help();
+        } else if (cmd == "verifybatch") {
+            quorum_verifybatch_help();
+        } else if (cmd == "getrecsigbatch") {
+            quorum_getrecsigbatch_help();
+        } else {
+            // shouldn't happen as it's already handled by the caller
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid cmd");
+        }
+    }
+
+    Consensus::LLMQType llmqType = (Consensus::LLMQType)ParseInt32V(request.params[1], "llmqType");
+    if (!Params().GetConsensus().llmqs.count(llmqType)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid LLMQ type");
+    }
+
+    UniValue requests = ParseBatchRequests(request.params[2]);
+    UniValue ret(UniValue::VARR);
+
+    if (cmd == "signbatch") {
+        std::vector<llmq::CSigningRequest> vecRequests(requests.size());
+        for (size_t i = 0; i < requests.size(); i++) {
+            const UniValue& obj = requests[i].get_obj();
+            vecRequests[i].id = ParseHashO(obj, "id");
+            vecRequests[i].msgHash = ParseHashO(obj, "msgHash");
+            const UniValue& quorumHash = find_value(obj, "quorumHash");
+            if (!quorumHash.isNull() && !quorumHash.get_str().empty()) {
+                vecRequests[i].quorumHash = ParseHashV(quorumHash, "quorumHash");
+            }
+        }
+        for (bool fSigning : llmq::quorumSigningManager->AsyncSignIfMember(llmqType, vecRequests)) {
+            ret.push_back(fSigning);
+        }
+    } else if (cmd == "verifybatch") {
+        int signHeight{-1};
+        if (!request.params[3].isNull()) {
+            signHeight = ParseInt32V(request.params[3], "signHeight");
+        }
+        std::vector<llmq::CRecoveredSigVerifyRequest> vecRequests(requests.size());
+        for (size_t i = 0; i < requests.size(); i++) {
+            const UniValue& obj = requests[i].get_obj();
+            vecRequests[i].signHeight = signHeight;
+            vecRequests[i].id = ParseHashO(obj, "id");
+            vecRequests[i].msgHash = ParseHashO(obj, "msgHash");
+            vecRequests[i].sig = ParseBatchSignature(requests[i]);
+        }
+        for (bool fValid : VerifyRecoveredSigsOfActiveSets(llmqType, vecRequests)) {
+            ret.push_back(fValid);
+        }
+    } else if (cmd == "getrecsigbatch") {
+        for (size_t i = 0; i < requests.size(); i++) {
+            const UniValue& obj = requests[i].get_obj();
+            uint256 id = ParseHashO(obj, "id");
+            uint256 msgHash = ParseHashO(obj, "msgHash");
+            llmq::CRecoveredSig recSig;
+            if (llmq::quorumSigningManager->GetRecoveredSigForId(llmqType, id, recSig) && recSig.msgHash == msgHash) {
+                ret.push_back(recSig.ToJson());
+            } else {
+                ret.push_back(NullUniValue);
+            }
+        }
+    } else {
+        // shouldn't happen as it's already handled by the caller
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid cmd");
+    }
+    return ret;
+}
+
 void quorum_isconflicting_help()
 {
     throw std::runtime_error(
@@ -517,6 +691,117 @@ UniValue quorum_selectquorum(const JSONRPCRequest& request)
     return ret;
 }
 
+void quorum_sigsharestats_help()
+{
+    throw std::runtime_error(
+            "quorum sigsharestats\n"
+            "Return the current sig share send cadence and histograms of the signing session recovery latency\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"sendInterval\": n,           (numeric) Milliseconds between two rounds of sending sig share messages\n"
+            "  \"medianPeerRtt\": n,          (numeric) Median minimum ping in milliseconds of the peers we share sessions with, -1 if unknown\n"
+            "  \"recoveryLatency\": {         (json object) Time from the first sig share of a session until it got recovered, per LLMQ type\n"
+            "    \"name\": {                  (json object) LLMQ type name\n"
+            "      \"count\": n,              (numeric) Number of recovered sessions\n"
+            "      \"avg\": n,                (numeric) Average latency in milliseconds\n"
+            "      \"max\": n,                (numeric) Maximum latency in milliseconds\n"
+            "      \"buckets\": {             (json object) Number of sessions per latency bucket, keyed by the upper bound in milliseconds\n"
+            "        \"50\": n,\n"
+            "        ...\n"
+            "        \"inf\": n\n"
+            "      }\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+    );
+}
+
+UniValue quorum_sigsharestats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        quorum_sigsharestats_help();
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("sendInterval", llmq::quorumSigSharesManager->GetSendInterval());
+    ret.pushKV("medianPeerRtt", llmq::quorumSigSharesManager->GetMedianPeerRtt());
+
+    UniValue latencies(UniValue::VOBJ);
+    for (const auto& p : llmq::quorumSigSharesManager->GetRecoveryLatencies()) {
+        const auto& h = p.second;
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", (int64_t)h.count);
+        obj.pushKV("avg", h.count != 0 ? h.sumMs / (int64_t)h.count : 0);
+        obj.pushKV("max", h.maxMs);
+        UniValue buckets(UniValue::VOBJ);
+        for (size_t i = 0; i < llmq::CRecoveryLatencyHistogram::BUCKET_COUNT; i++) {
+            std::string key = i < llmq::CRecoveryLatencyHistogram::BUCKET_COUNT - 1 ? std::to_string(llmq::CRecoveryLatencyHistogram::BUCKET_LIMITS[i]) : "inf";
+            buckets.pushKV(key, (int64_t)h.counts[i]);
+        }
+        obj.pushKV("buckets", buckets);
+        latencies.pushKV(llmq::GetLLMQParams(p.first).name, obj);
+    }
+    ret.pushKV("recoveryLatency", latencies);
+
+    return ret;
+}
+
+void quorum_sigstats_help()
+{
+    throw std::runtime_error(
+            "quorum sigstats\n"
+            "Return the latencies of the stages of the last signing sessions, per LLMQ type.\n"
+            "Each stage is measured from the previous stage this node has seen. Only members request and sign,\n"
+            "and only nodes which recover a signature themselves reach the threshold.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                   (json object) LLMQ type name\n"
+            "    \"stages\": {               (json object) Latencies per stage\n"
+            "      \"stage\": {              (json object) One of signed, firstShare, threshold, recovered or processed\n"
+            "        \"count\": n,           (numeric) Number of sessions which reached the stage\n"
+            "        \"p50\": n,             (numeric) Median latency in milliseconds\n"
+            "        \"p99\": n              (numeric) 99th percentile latency in milliseconds\n"
+            "      }, ...\n"
+            "    },\n"
+            "    \"total\": {                (json object) Latencies from the first until the last stage\n"
+            "      \"count\": n,\n"
+            "      \"p50\": n,\n"
+            "      \"p99\": n\n"
+            "    }\n"
+            "  }, ...\n"
+            "}\n"
+    );
+}
+
+UniValue quorum_sigstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        quorum_sigstats_help();
+    }
+
+    auto statsToJson = [](const llmq::CSigLatencyStats& stats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", (int64_t)stats.count);
+        obj.pushKV("p50", stats.p50);
+        obj.pushKV("p99", stats.p99);
+        return obj;
+    };
+
+    UniValue ret(UniValue::VOBJ);
+    for (const auto& p : llmq::quorumSigningStats->GetStats()) {
+        UniValue stages(UniValue::VOBJ);
+        for (size_t i = 0; i < llmq::CSigningStats::STAGE_COUNT; i++) {
+            if (p.second[i].count == 0) continue;
+            stages.pushKV(llmq::SigStageToString((llmq::SigStage)i), statsToJson(p.second[i]));
+        }
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("stages", stages);
+        obj.pushKV("total", statsToJson(p.second[llmq::CSigningStats::STAGE_COUNT]));
+        ret.pushKV(llmq::GetLLMQParams(p.first).name, obj);
+    }
+    return ret;
+}
+
 void quorum_dkgsimerror_help()
 {
     throw std::runtime_error(
@@ -619,7 +904,12 @@ UniValue quorum_getdata(const JSONRPCRequest& request)
             "  hasrecsig         - Test if a valid recovered signature is present\n"
             "  getrecsig         - Get a recovered signature\n"
             "  isconflicting     - Test if a conflict exists\n"
+            "  signbatch         - Threshold-sign many messages at once\n"
+            "  verifybatch       - Test if many quorum signatures are valid\n"
+            "  getrecsigbatch    - Get many recovered signatures at once\n"
             "  selectquorum      - Return the quorum that would/should sign a request\n"
+            "  sigsharestats     - Return sig share send cadence and recovery latency histograms\n"
+            "  sigstats          - Return latency percentiles of the stages of signing sessions\n"
             "  getdata           - Request quorum data from other masternodes in the quorum\n"
     );
 }
@@ -645,8 +935,14 @@ UniValue quorum(const JSONRPCRequest& request)
         return quorum_memberof(request);
     } else if (command == "sign" || command == "verify" || command == "hasrecsig" || command == "getrecsig" || command == "isconflicting") {
         return quorum_sigs_cmd(request);
+    } else if (command == "signbatch" || command == "verifybatch" || command == "getrecsigbatch") {
+        return quorum_sigs_batch_cmd(request);
     } else if (command == "selectquorum") {
         return quorum_selectquorum(request);
+    } else if (command == "sigsharestats") {
+        return quorum_sigsharestats(request);
+    } else if (command == "sigstats") {
+        return quorum_sigstats(request);
     } else if (command == "dkgsimerror") {
         return quorum_dkgsimerror(request);
     } else if (command == "getdata") {
@@ -755,12 +1051,68 @@ UniValue verifyislock(const JSONRPCRequest& request)
            llmq::quorumSigningManager->VerifyRecoveredSig(llmqType, signHeight, id, txid, sig, signOffset);
 }
 
+void verifyislockbatch_help()
+{
+    throw std::runtime_error(
+            "verifyislockbatch [{\"id\":\"hash\",\"txid\":\"hash\",\"signature\":\"sig\"},...] ( maxHeight )\n"
+            "Test if many quorum signatures are valid for InstantSend Locks, verifying all of them in one batch\n"
+            "\nArguments:\n"
+            "1. requests              (array, required) The InstantSend Locks, at most " + std::to_string(MAX_QUORUM_BATCH_SIZE) + ".\n"
+            "2. maxHeight             (int, optional) The maximum height to search quorums from.\n"
+            "\nResult:\n"
+            "[ true|false, ... ]     (array) For each request, whether the signature is valid\n"
+    );
+}
+
+UniValue verifyislockbatch(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        verifyislockbatch_help();
+    }
+
+    UniValue requests = ParseBatchRequests(request.params[0]);
+
+    int maxHeight{-1};
+    if (!request.params[1].isNull()) {
+        maxHeight = ParseInt32V(request.params[1], "maxHeight");
+    }
+
+    std::vector<llmq::CRecoveredSigVerifyRequest> vecRequests(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        const UniValue& obj = requests[i].get_obj();
+        vecRequests[i].id = ParseHashO(obj, "id");
+        vecRequests[i].msgHash = ParseHashO(obj, "txid");
+        vecRequests[i].sig = ParseBatchSignature(requests[i]);
+    }
+
+    {
+        LOCK(cs_main);
+        for (auto& req : vecRequests) {
+            // Same as verifyislock, the height the TX was mined at if that's not above maxHeight
+            CTransactionRef tx;
+            uint256 hash_block;
+            const CBlockIndex* pindexMined{nullptr};
+            if (GetTransaction(req.msgHash, tx, Params().GetConsensus(), hash_block, true) && !hash_block.IsNull()) {
+                pindexMined = LookupBlockIndex(hash_block);
+            }
+            req.signHeight = (pindexMined == nullptr || pindexMined->nHeight > maxHeight) ? maxHeight : pindexMined->nHeight;
+        }
+    }
+
+    UniValue ret(UniValue::VARR);
+    for (bool fValid : VerifyRecoveredSigsOfActiveSets(Params().GetConsensus().llmqTypeInstantSend, vecRequests)) {
+        ret.push_back(fValid);
+    }
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)
   //  --------------------- ------------------------  -----------------------
     { "evo",                "quorum",                 &quorum,                 {}  },
     { "evo",                "verifychainlock",        &verifychainlock,        {"blockHash", "signature", "blockHeight"} },
     { "evo",                "verifyislock",           &verifyislock,           {"id", "txid", "signature", "maxHeight"}  },
+    { "evo",                "verifyislockbatch",      &verifyislockbatch,      {"requests", "maxHeight"}  },
 };
 
 void RegisterQuorumsRPCCommands(CRPCTable &tableRPC)
@@ -6,10 +6,12 @@
 
 #include <rpc/server.h>
 
+#include <ctpl.h>
 #include <fs.h>
 #include <init.h>
 #include <key_io.h>
 #include <random.h>
+#include <replica.h>
 #include <sync.h>
 #include <ui_interface.h>
 #include <util.h>
@@ -22,7 +24,10 @@
 #include <boost/algorithm/string/split.hpp>
 
 #include <algorithm>
+#include <future>
 #include <memory> // for unique_ptr
+#include <mutex>
+#include <set>
 #include <unordered_map>
 
 static CCriticalSection cs_rpcWarmup;
@@ -271,7 +276,10 @@ void CRPCTable::InitPlatformRestrictions()
         {"getbestchainlock", {}},
         {"quorum", {"sign", Params().GetConsensus().llmqTypePlatform}},
         {"quorum", {"verify"}},
+        {"quorum", {"signbatch", Params().GetConsensus().llmqTypePlatform}},
+        {"quorum", {"verifybatch"}},
         {"verifyislock", {}},
+        {"verifyislockbatch", {}},
     };
 }
 
@@ -493,11 +501,80 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
+// batches of at least this many calls are run in parallel if they only read state
+static const size_t MIN_PARALLEL_RPC_BATCH = 4;
+static const int MAX_RPC_BATCH_THREADS = 8;
+
+/** Calls which don't change any state, a batch of them gives the same replies in whichever order they run */
+static const std::set<std::string> setParallelRPCMethods = {
+    "decoderawtransaction", "decodescript", "getaddressbalance", "getaddressdeltas", "getaddressmempool",
+    "getaddresstxids", "getaddressutxos", "getbestblockhash", "getblock", "getblockcount", "getblockhash",
+    "getblockheader", "getblockheaders", "getblockstats", "getmempoolentry", "getrawtransaction",
+    "getspentinfo", "gettxout", "gettxoutproof",
+};
+
+/** Threads that run the calls of large JSON-RPC batches, started on first use */
+static ctpl::thread_pool& GetRPCBatchPool()
+{
+    static std::once_flag init;
+    static std::unique_ptr<ctpl::thread_pool> pool;
+    std::call_once(init, [] {
+        pool.reset(new ctpl::thread_pool(std::max(1, std::min(GetNumCores(), MAX_RPC_BATCH_THREADS))));
+        RenameThreadPool(*pool, "dash-rpcbatch");
+    });
+    return *pool;
+}
+
+/** Whether all calls of a batch are independent of each other, see setParallelRPCMethods */
+static bool IsParallelRPCBatch(const UniValue& vReq)
+{
+    if (vReq.size() < MIN_PARALLEL_RPC_BATCH) {
+        return false;
+    }
+    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++) {
+        if (!vReq[reqIdx].isObject()) {
+            return false;
+        }
+        const UniValue& method = find_value(vReq[reqIdx].get_obj(), "method");
+        if (!method.isStr() || !setParallelRPCMethods.count(method.get_str())) {
+            return false;
+        }
+    }
+    return true;
+}
+
 std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
 {
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    if (!IsParallelRPCBatch(vReq)) {
+        for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
+            ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+
+        return ret.write() + "\n";
+    }
+
+    // Explorers ask for many transactions or blocks at once, their lookups are spread over the batch threads
+    std::vector<UniValue> vecReplies(vReq.size());
+    const size_t nTasks = std::min((size_t)GetRPCBatchPool().size(), vecReplies.size());
+    std::vector<std::future<void> > futures;
+    futures.reserve(nTasks);
+    for (size_t nTask = 0; nTask < nTasks; nTask++) {
+        futures.emplace_back(GetRPCBatchPool().push([&, nTask](int) {
+            for (size_t i = nTask; i < vecReplies.size(); i += nTasks) {
+                vecReplies[i] = JSONRPCExecOne(jreq, vReq[i]);
+            }
+        }));
+    }
+    // Wait for all of them before anything is rethrown, they reference our locals
+    for (auto& future : futures) {
+        future.wait();
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    for (UniValue& reply : vecReplies) {
+        ret.push_back(std::move(reply));
+    }
 
     return ret.write() + "\n";
 }
@@ -566,6 +643,11 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     if (!pcmd)
         throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
 
+    // A replica serves the chain of another node, it can't change it
+    if (fReadOnlyReplica && !IsReplicaRPCCommand(request.strMethod)) {
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, strprintf("Method \"%s\" is not available on a read-only replica", request.strMethod));
+    }
+
     // Before executing the RPC Command, filter commands from platform rpc user
     if (fMasternodeMode && request.authUser == gArgs.GetArg("-platform-user", defaultPlatformUser)) {
 
@@ -17,6 +17,8 @@
 
 #include <univalue.h>
 
+class JSONStreamWriter;
+
 class CRPCCommand;
 
 namespace RPCServer
@@ -44,8 +46,20 @@ public:
     std::string URI;
     std::string authUser;
     std::string peerAddr;
+    /**
+     * Set by the HTTP server for single requests. Handlers with large results may write the result to it instead of
+     * returning it (through JSONResultBuilder), in which case they return null. Errors have to be thrown before
+     * anything was written.
+     */
+    JSONStreamWriter* resultWriter;
+    /**
+     * Set by the HTTP server for single requests whose client accepts application/octet-stream. Handlers of blocks,
+     * transactions and other serialized objects may write the object in its network serialization to it instead of
+     * returning a result (through WriteBinaryResult), in which case they return null and it is sent as is.
+     */
+    std::string* binaryResult;
 
-    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false) {}
+    JSONRPCRequest() : id(NullUniValue), params(NullUniValue), fHelp(false), resultWriter(nullptr), binaryResult(nullptr) {}
     void parse(const UniValue& valRequest);
 };
 
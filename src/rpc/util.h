@@ -6,9 +6,12 @@
 #define BITCOIN_RPC_UTIL_H
 
 #include <pubkey.h>
+#include <rpc/server.h>
 #include <script/standard.h>
+#include <streams.h>
 #include <univalue.h>
 #include <utilstrencodings.h>
+#include <version.h>
 
 #include <boost/variant/static_visitor.hpp>
 
@@ -25,4 +28,17 @@ CScript CreateMultisigRedeemscript(const int required, const std::vector<CPubKey
 
 UniValue DescribeAddress(const CTxDestination& dest);
 
+/** Write obj as the binary result of a request, see JSONRPCRequest::binaryResult. Returns false if the client expects JSON. */
+template <typename T>
+bool WriteBinaryResult(const JSONRPCRequest& request, const T& obj)
+{
+    if (!request.binaryResult) {
+        return false;
+    }
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << obj;
+    request.binaryResult->assign(ss.begin(), ss.end());
+    return true;
+}
+
 #endif // BITCOIN_RPC_UTIL_H
@@ -6,12 +6,15 @@
 
 #include <random.h>
 #include <reverselock.h>
+#include <util.h>
+#include <utiltime.h>
 
 #include <assert.h>
 #include <boost/bind.hpp>
+#include <exception>
 #include <utility>
 
-CScheduler::CScheduler() : nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
+CScheduler::CScheduler() : nWarnMicros(DEFAULT_SCHEDULER_WARN_MS * 1000), nThreadsServicingQueue(0), stopRequested(false), stopWhenEmpty(false)
 {
 }
 
@@ -49,38 +52,52 @@ void CScheduler::serviceQueue()
                 // Wait until there is something to do.
                 newTaskScheduled.wait(lock);
             }
+            if (shouldStop())
+                continue;
 
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
+            // Tasks of a queue which is running on another thread have to wait for it
+            auto it = NextRunnableTask();
+            if (it == taskQueue.end()) {
+                newTaskScheduled.wait(lock);
+                continue;
+            }
 
+            // Wait until either there is a new task, a queue became runnable
+            // again, or until the time of the task. Then look again, as
+            // another thread may have serviced the task in the meantime:
+            if (it->first > boost::chrono::system_clock::now()) {
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
-                // Keep waiting until timeout
-            }
+                newTaskScheduled.timed_wait(lock, toPosixTime(it->first));
 #else
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
-                boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
-                    break; // Exit loop after timeout, it means we reached the time of the event
-            }
+                // Some boost versions have a conflicting overload of wait_until that returns void.
+                // Explicitly use a template here to avoid hitting that overload.
+                newTaskScheduled.wait_until<>(lock, it->first);
 #endif
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
                 continue;
+            }
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            Task task = std::move(it->second);
+            taskQueue.erase(it);
+            if (!task.strQueue.empty()) {
+                setRunningQueues.emplace(task.strQueue);
+            }
 
+            std::exception_ptr eptr;
+            int64_t nStart = GetTimeMicros();
             {
                 // Unlock before calling f, so it can reschedule itself or another task
                 // without deadlocking:
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                try {
+                    task.f();
+                } catch (...) {
+                    eptr = std::current_exception();
+                }
+            }
+            FinishTask(task.strQueue, GetTimeMicros() - nStart);
+            if (eptr) {
+                std::rethrow_exception(eptr);
             }
         } catch (...) {
             --nThreadsServicingQueue;
@@ -103,29 +120,55 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+CScheduler::TaskQueue::iterator CScheduler::NextRunnableTask()
+{
+    auto it = taskQueue.begin();
+    while (it != taskQueue.end() && setRunningQueues.count(it->second.strQueue)) {
+        ++it;
+    }
+    return it;
+}
+
+void CScheduler::FinishTask(const std::string& strQueue, int64_t nMicros)
+{
+    auto& stats = mapQueueStats[strQueue];
+    stats.nTasks++;
+    stats.nTotalMicros += nMicros;
+    stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+    if (nWarnMicros > 0 && nMicros > nWarnMicros) {
+        LogPrintf("CScheduler: task of queue \"%s\" took %dms\n", strQueue, nMicros / 1000);
+    }
+    if (!strQueue.empty()) {
+        setRunningQueues.erase(strQueue);
+        // the next task of the queue may be waited for by any of the threads
+        newTaskScheduled.notify_all();
+    }
+}
+
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, const std::string& strQueue)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue.insert(std::make_pair(t, Task{f, strQueue}));
     }
-    newTaskScheduled.notify_one();
+    // With named queues not every thread can run the new task, so wake all of them
+    newTaskScheduled.notify_all();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& strQueue)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds), strQueue);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& strQueue)
 {
     f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds, strQueue), deltaMilliSeconds, strQueue);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& strQueue)
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds, strQueue), deltaMilliSeconds, strQueue);
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
@@ -145,6 +188,22 @@ bool CScheduler::AreThreadsServicingQueue() const {
     return nThreadsServicingQueue;
 }
 
+void CScheduler::SetWarnTime(int64_t nMillis)
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    nWarnMicros = nMillis * 1000;
+}
+
+std::map<std::string, CSchedulerQueueStats> CScheduler::GetQueueStats() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    auto result = mapQueueStats;
+    for (const auto& p : taskQueue) {
+        result[p.second.strQueue].nPending++;
+    }
+    return result;
+}
+
 
 void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
     {
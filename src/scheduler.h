@@ -13,6 +13,8 @@
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
 #include <map>
+#include <set>
+#include <string>
 
 #include <sync.h>
 
@@ -33,6 +35,26 @@
 // delete t;
 // delete s; // Must be done after thread is interrupted/joined.
 //
+// When more than one thread runs serviceQueue, tasks can run in parallel.
+// Tasks scheduled with the same queue name never do, they run one after
+// the other in the order of their times:
+//
+// s->scheduleEvery(doMaintenance, 1000, "maintenance");
+//
+
+//! Number of threads servicing the queue of the main scheduler
+static const int DEFAULT_SCHEDULER_THREADS = 4;
+static const int MAX_SCHEDULER_THREADS = 16;
+//! Tasks which run longer than this are logged
+static const int64_t DEFAULT_SCHEDULER_WARN_MS = 1000;
+
+struct CSchedulerQueueStats
+{
+    size_t nPending{0};
+    uint64_t nTasks{0};
+    int64_t nTotalMicros{0};
+    int64_t nMaxMicros{0};
+};
 
 class CScheduler
 {
@@ -42,18 +64,19 @@ public:
 
     typedef std::function<void(void)> Function;
 
-    // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    // Call func at/after time t. Tasks with the same non-empty strQueue
+    // are never run at the same time
+    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now(), const std::string& strQueue = "");
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds, const std::string& strQueue = "");
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds, const std::string& strQueue = "");
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -74,14 +97,36 @@ public:
     // Returns true if there are threads actively running in serviceQueue()
     bool AreThreadsServicingQueue() const;
 
+    // Tasks which take longer than nMillis are logged, 0 disables it
+    void SetWarnTime(int64_t nMillis);
+
+    // Returns the number of pending and run tasks and their runtime for each
+    // queue. Tasks without a queue are reported under ""
+    std::map<std::string, CSchedulerQueueStats> GetQueueStats() const;
+
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task
+    {
+        Function f;
+        std::string strQueue;
+    };
+    typedef std::multimap<boost::chrono::system_clock::time_point, Task> TaskQueue;
+
+    TaskQueue taskQueue;
+    // Queues with a task running on one of the threads
+    std::set<std::string> setRunningQueues;
+    std::map<std::string, CSchedulerQueueStats> mapQueueStats;
+    int64_t nWarnMicros;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
     bool shouldStop() const { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+    // The first task whose queue isn't running, requires newTaskMutex
+    TaskQueue::iterator NextRunnableTask();
+    // Records the runtime of a task and makes its queue runnable again, requires newTaskMutex
+    void FinishTask(const std::string& strQueue, int64_t nMicros);
 };
 
 /**
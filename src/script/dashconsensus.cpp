@@ -5,11 +5,19 @@
 
 #include <script/dashconsensus.h>
 
+#include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <pubkey.h>
 #include <script/interpreter.h>
 #include <version.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
 namespace {
 
 /** A class that deserializes a single CTransaction one time. */
@@ -68,8 +76,74 @@ struct ECCryptoClosure
 };
 
 ECCryptoClosure instance_of_eccryptoclosure;
+
+/** An input to verify, the transaction data belongs to the caller */
+struct InputCheck
+{
+    const CTransaction* tx;
+    const PrecomputedTransactionData* txdata;
+    unsigned int nIn;
+    const dashconsensus_spent_output* spentOutput;
+};
+
+bool VerifyInput(const InputCheck& check, unsigned int flags)
+{
+    const CScript scriptPubKey(check.spentOutput->scriptPubKey, check.spentOutput->scriptPubKey + check.spentOutput->scriptPubKeyLen);
+    CAmount am(0);
+    return VerifyScript(check.tx->vin[check.nIn].scriptSig, scriptPubKey, flags, TransactionSignatureChecker(check.tx, check.nIn, am, *check.txdata), nullptr);
+}
+
+/**
+ * Verify the inputs with up to nThreads threads, the calling one included. Returns the position of the first input
+ * which failed, or checks.size() if all of them are valid. Inputs behind a failed one aren't verified anymore.
+ */
+size_t VerifyInputs(const std::vector<InputCheck>& checks, unsigned int flags, unsigned int nThreads)
+{
+    std::atomic<size_t> nNext{0};
+    std::atomic<size_t> nFirstFailed{checks.size()};
+    auto worker = [&]() {
+        while (true) {
+            size_t i = nNext++;
+            if (i >= nFirstFailed.load()) {
+                return;
+            }
+            if (!VerifyInput(checks[i], flags)) {
+                size_t nCur = nFirstFailed.load();
+                while (i < nCur && !nFirstFailed.compare_exchange_weak(nCur, i)) {}
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    size_t nExtraThreads = std::min<size_t>(nThreads, checks.size());
+    for (size_t i = 1; i < nExtraThreads; i++) {
+        try {
+            threads.emplace_back(worker);
+        } catch (const std::system_error&) {
+            // Continue with the threads we got
+            break;
+        }
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return nFirstFailed.load();
+}
 } // namespace
 
+struct dashconsensus_tx_context
+{
+    const CTransaction tx;
+    PrecomputedTransactionData txdata;
+
+    template <typename Stream>
+    explicit dashconsensus_tx_context(Stream& s) : tx(deserialize, s), txdata(tx)
+    {
+        txdata.sighashCache = std::make_shared<SighashCache>(tx.vin.size());
+    }
+};
+
 /** Check that all specified flags are part of the libconsensus interface. */
 static bool verify_flags(unsigned int flags)
 {
@@ -102,6 +176,133 @@ int dashconsensus_verify_script(const unsigned char *scriptPubKey, unsigned int
     }
 }
 
+int dashconsensus_verify_tx(const unsigned char *txTo, unsigned int txToLen,
+                                    const dashconsensus_spent_output *spentOutputs, unsigned int spentOutputsLen,
+                                    unsigned int flags, unsigned int nThreads,
+                                    unsigned int* nFailedIn, dashconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, dashconsensus_ERR_INVALID_FLAGS);
+    }
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
+        CTransaction tx(deserialize, stream);
+        if (GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) != txToLen)
+            return set_error(err, dashconsensus_ERR_TX_SIZE_MISMATCH);
+        if (tx.vin.size() != spentOutputsLen)
+            return set_error(err, dashconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+        set_error(err, dashconsensus_ERR_OK);
+
+        PrecomputedTransactionData txdata(tx);
+        std::vector<InputCheck> checks;
+        checks.reserve(tx.vin.size());
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            checks.push_back({&tx, &txdata, i, &spentOutputs[i]});
+        }
+        size_t nFailed = VerifyInputs(checks, flags, nThreads);
+        if (nFailed == checks.size()) {
+            return 1;
+        }
+        if (nFailedIn)
+            *nFailedIn = nFailed;
+        return 0;
+    } catch (const std::exception&) {
+        return set_error(err, dashconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+    }
+}
+
+int dashconsensus_verify_block(const unsigned char *block, unsigned int blockLen,
+                                    const dashconsensus_spent_output *spentOutputs, unsigned int spentOutputsLen,
+                                    unsigned int flags, unsigned int nThreads,
+                                    unsigned int* nFailedTx, unsigned int* nFailedIn, dashconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, dashconsensus_ERR_INVALID_FLAGS);
+    }
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, block, blockLen);
+        CBlock blk;
+        stream >> blk;
+        if (GetSerializeSize(blk, SER_NETWORK, PROTOCOL_VERSION) != blockLen)
+            return set_error(err, dashconsensus_ERR_TX_SIZE_MISMATCH);
+
+        size_t nInputs = 0;
+        for (size_t i = 1; i < blk.vtx.size(); i++) {
+            nInputs += blk.vtx[i]->vin.size();
+        }
+        if (nInputs != spentOutputsLen)
+            return set_error(err, dashconsensus_ERR_SPENT_OUTPUTS_MISMATCH);
+
+        set_error(err, dashconsensus_ERR_OK);
+
+        std::vector<PrecomputedTransactionData> vTxData;
+        vTxData.reserve(blk.vtx.size());
+        std::vector<InputCheck> checks;
+        std::vector<unsigned int> vCheckTx;
+        checks.reserve(nInputs);
+        vCheckTx.reserve(nInputs);
+        for (size_t i = 1; i < blk.vtx.size(); i++) {
+            const CTransaction& tx = *blk.vtx[i];
+            vTxData.emplace_back(tx);
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                checks.push_back({&tx, &vTxData.back(), j, &spentOutputs[checks.size()]});
+                vCheckTx.push_back(i);
+            }
+        }
+        size_t nFailed = VerifyInputs(checks, flags, nThreads);
+        if (nFailed == checks.size()) {
+            return 1;
+        }
+        if (nFailedTx)
+            *nFailedTx = vCheckTx[nFailed];
+        if (nFailedIn)
+            *nFailedIn = checks[nFailed].nIn;
+        return 0;
+    } catch (const std::exception&) {
+        return set_error(err, dashconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+    }
+}
+
+dashconsensus_tx_context* dashconsensus_tx_context_create(const unsigned char *txTo, unsigned int txToLen,
+                                    dashconsensus_error* err)
+{
+    try {
+        TxInputStream stream(SER_NETWORK, PROTOCOL_VERSION, txTo, txToLen);
+        std::unique_ptr<dashconsensus_tx_context> context(new dashconsensus_tx_context(stream));
+        if (GetSerializeSize(context->tx, SER_NETWORK, PROTOCOL_VERSION) != txToLen) {
+            set_error(err, dashconsensus_ERR_TX_SIZE_MISMATCH);
+            return nullptr;
+        }
+        set_error(err, dashconsensus_ERR_OK);
+        return context.release();
+    } catch (const std::exception&) {
+        set_error(err, dashconsensus_ERR_TX_DESERIALIZE); // Error deserializing
+        return nullptr;
+    }
+}
+
+void dashconsensus_tx_context_destroy(dashconsensus_tx_context* context)
+{
+    delete context;
+}
+
+int dashconsensus_verify_script_with_context(const unsigned char *scriptPubKey, unsigned int scriptPubKeyLen,
+                                    const dashconsensus_tx_context* context,
+                                    unsigned int nIn, unsigned int flags, dashconsensus_error* err)
+{
+    if (!verify_flags(flags)) {
+        return set_error(err, dashconsensus_ERR_INVALID_FLAGS);
+    }
+    if (nIn >= context->tx.vin.size())
+        return set_error(err, dashconsensus_ERR_TX_INDEX);
+
+    set_error(err, dashconsensus_ERR_OK);
+
+    const dashconsensus_spent_output spentOutput{scriptPubKey, scriptPubKeyLen};
+    return VerifyInput({&context->tx, &context->txdata, nIn, &spentOutput}, flags);
+}
+
 unsigned int dashconsensus_version()
 {
     // Just use the API version for now
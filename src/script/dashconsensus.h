@@ -33,7 +33,7 @@
 extern "C" {
 #endif
 
-#define BITCOINCONSENSUS_API_VER 0
+#define BITCOINCONSENSUS_API_VER 1
 
 typedef enum dashconsensus_error_t
 {
@@ -42,6 +42,7 @@ typedef enum dashconsensus_error_t
     dashconsensus_ERR_TX_SIZE_MISMATCH,
     dashconsensus_ERR_TX_DESERIALIZE,
     dashconsensus_ERR_INVALID_FLAGS,
+    dashconsensus_ERR_SPENT_OUTPUTS_MISMATCH,
 } dashconsensus_error;
 
 /** Script verification flags */
@@ -66,6 +67,58 @@ EXPORT_SYMBOL int dashconsensus_verify_script(const unsigned char *scriptPubKey,
                                     const unsigned char *txTo        , unsigned int txToLen,
                                     unsigned int nIn, unsigned int flags, dashconsensus_error* err);
 
+/// An output spent by an input, in the order of the inputs
+typedef struct dashconsensus_spent_output
+{
+    const unsigned char* scriptPubKey;
+    unsigned int scriptPubKeyLen;
+} dashconsensus_spent_output;
+
+/// Returns 1 if all inputs of the serialized transaction pointed to by txTo
+/// correctly spend the spentOutputsLen outputs pointed to by spentOutputs
+/// (one per input) under the additional constraints specified by flags.
+/// With nThreads > 1 the inputs are verified by that many threads.
+/// If not nullptr, nFailedIn is set to the first input which failed.
+/// If not nullptr, err will contain an error/success code for the operation
+EXPORT_SYMBOL int dashconsensus_verify_tx(const unsigned char *txTo, unsigned int txToLen,
+                                    const dashconsensus_spent_output *spentOutputs, unsigned int spentOutputsLen,
+                                    unsigned int flags, unsigned int nThreads,
+                                    unsigned int* nFailedIn, dashconsensus_error* err);
+
+/// Returns 1 if all inputs of all transactions of the serialized block pointed
+/// to by block correctly spend the outputs pointed to by spentOutputs. These are
+/// the outputs spent by the inputs of all transactions but the coinbase, in the
+/// order of the transactions and their inputs.
+/// Only the scripts are verified, not the rest of the block.
+/// With nThreads > 1 the inputs are verified by that many threads.
+/// If not nullptr, nFailedTx and nFailedIn are set to the transaction and input
+/// which failed, the first one in block order.
+/// If not nullptr, err will contain an error/success code for the operation
+EXPORT_SYMBOL int dashconsensus_verify_block(const unsigned char *block, unsigned int blockLen,
+                                    const dashconsensus_spent_output *spentOutputs, unsigned int spentOutputsLen,
+                                    unsigned int flags, unsigned int nThreads,
+                                    unsigned int* nFailedTx, unsigned int* nFailedIn, dashconsensus_error* err);
+
+/// A deserialized transaction together with its precomputed signature hash
+/// data. The signature hashes computed while verifying its inputs are kept, so
+/// verifying inputs again, e.g. with different flags, doesn't recompute them.
+/// A context can be used by multiple threads at the same time.
+typedef struct dashconsensus_tx_context dashconsensus_tx_context;
+
+/// Returns a new context for the serialized transaction pointed to by txTo,
+/// or nullptr if it can't be deserialized. Free it with
+/// dashconsensus_tx_context_destroy.
+/// If not nullptr, err will contain an error/success code for the operation
+EXPORT_SYMBOL dashconsensus_tx_context* dashconsensus_tx_context_create(const unsigned char *txTo, unsigned int txToLen,
+                                    dashconsensus_error* err);
+
+EXPORT_SYMBOL void dashconsensus_tx_context_destroy(dashconsensus_tx_context* context);
+
+/// Same as dashconsensus_verify_script, with the transaction taken from context
+EXPORT_SYMBOL int dashconsensus_verify_script_with_context(const unsigned char *scriptPubKey, unsigned int scriptPubKeyLen,
+                                    const dashconsensus_tx_context* context,
+                                    unsigned int nIn, unsigned int flags, dashconsensus_error* err);
+
 EXPORT_SYMBOL unsigned int dashconsensus_version();
 
 #ifdef __cplusplus
@@ -1007,11 +1007,13 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
 
                     bool fSuccess = false;
                     if (vchSig.size()) {
-                        valtype vchHash(32);
+                        uint256 hash;
                         CSHA256()
                             .Write(vchMessage.data(), vchMessage.size())
-                            .Finalize(vchHash.data());
-                        fSuccess = checker.VerifySignature(vchSig, CPubKey(vchPubKey), uint256(vchHash));
+                            .Finalize(hash.begin());
+                        // Goes through the same VerifySignature as CheckSig, so data signatures are kept in the
+                        // signature cache of CachingTransactionSignatureChecker as well, keyed by the message hash
+                        fSuccess = checker.VerifySignature(vchSig, CPubKey(vchPubKey), hash);
                     }
 
                     if (!fSuccess && (flags & SCRIPT_VERIFY_NULLFAIL) && vchSig.size()) {
@@ -1412,6 +1414,33 @@ PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
     hashOutputs = GetOutputsHash(txTo);
 }
 
+bool SighashCache::Get(unsigned int nIn, int nHashType, const CScript& scriptCode, uint256& sighashRet) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (nIn >= m_entries.size()) {
+        return false;
+    }
+    const Entry& entry = m_entries[nIn];
+    if (!entry.fSet || entry.nHashType != nHashType || entry.scriptCode != scriptCode) {
+        return false;
+    }
+    sighashRet = entry.sighash;
+    return true;
+}
+
+void SighashCache::Set(unsigned int nIn, int nHashType, const CScript& scriptCode, const uint256& sighash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (nIn >= m_entries.size()) {
+        return;
+    }
+    Entry& entry = m_entries[nIn];
+    entry.fSet = true;
+    entry.nHashType = nHashType;
+    entry.scriptCode = scriptCode;
+    entry.sighash = sighash;
+}
+
 uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
 {
     assert(nIn < txTo.vin.size());
@@ -1426,13 +1455,23 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
         }
     }
 
+    SighashCache* sighashCache = cache ? cache->sighashCache.get() : nullptr;
+    uint256 sighash;
+    if (sighashCache && sighashCache->Get(nIn, nHashType, scriptCode, sighash)) {
+        return sighash;
+    }
+
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
-    return ss.GetHash();
+    sighash = ss.GetHash();
+    if (sighashCache) {
+        sighashCache->Set(nIn, nHashType, scriptCode, sighash);
+    }
+    return sighash;
 }
 
 bool BaseSignatureChecker::VerifySignature(const std::vector<uint8_t>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
@@ -6,9 +6,12 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include <script/script.h>
 #include <script/script_error.h>
 #include <primitives/transaction.h>
 
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <stdint.h>
 #include <string>
@@ -102,9 +105,35 @@ enum
 
 bool CheckSignatureEncoding(const std::vector<unsigned char> &vchSig, unsigned int flags, ScriptError* serror);
 
+/**
+ * Signature hashes computed for the inputs of a single transaction. Only the last one per input is kept, which
+ * covers everything but multisig inputs with signatures of different hash types. This class is thread safe.
+ */
+class SighashCache
+{
+private:
+    struct Entry {
+        bool fSet{false};
+        int nHashType;
+        CScript scriptCode;
+        uint256 sighash;
+    };
+
+    mutable std::mutex m_mutex;
+    std::vector<Entry> m_entries;
+
+public:
+    explicit SighashCache(size_t nInputs) : m_entries(nInputs) {}
+
+    bool Get(unsigned int nIn, int nHashType, const CScript& scriptCode, uint256& sighashRet) const;
+    void Set(unsigned int nIn, int nHashType, const CScript& scriptCode, const uint256& sighash);
+};
+
 struct PrecomputedTransactionData
 {
     uint256 hashPrevouts, hashSequence, hashOutputs;
+    /** Optional, shared by all copies so that signature hashes are reused when the transaction is verified again */
+    std::shared_ptr<SighashCache> sighashCache;
 
     explicit PrecomputedTransactionData(const CTransaction& tx);
 };
@@ -40,6 +40,10 @@ public:
     }
 };
 
+/**
+ * Caches the valid signatures of CheckSig and of OP_CHECKDATASIG(VERIFY), which both verify through
+ * VerifySignature. A data signature is cached under the SHA256 of its message in place of the signature hash.
+ */
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
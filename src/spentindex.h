@@ -375,5 +375,41 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/** Totals of the address index entries of an address, kept up to date next to the entries */
+struct CAddressIndexSummary {
+    CAmount balance;
+    CAmount received;
+    uint32_t txCount;
+    int firstHeight;
+    int lastHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(txCount);
+        READWRITE(firstHeight);
+        READWRITE(lastHeight);
+    }
+
+    CAddressIndexSummary() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+        firstHeight = -1;
+        lastHeight = -1;
+    }
+
+    bool IsNull() const {
+        return txCount == 0;
+    }
+};
+
 
 #endif // BITCOIN_SPENTINDEX_H
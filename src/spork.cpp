@@ -28,26 +28,26 @@ std::vector<CSporkDef> sporkDefs = {
 
 CSporkManager sporkManager;
 
-CSporkManager::CSporkManager()
+CSporkManager::CSporkManager() :
+    vecSporkValues(sporkDefs.size()),
+    vecSporksActive(sporkDefs.size())
 {
-    for (auto& sporkDef : sporkDefs) {
+    for (size_t i = 0; i < sporkDefs.size(); i++) {
+        auto& sporkDef = sporkDefs[i];
         sporkDefsById.emplace(sporkDef.sporkId, &sporkDef);
         sporkDefsByName.emplace(sporkDef.name, &sporkDef);
+        sporkIndexById.emplace(sporkDef.sporkId, i);
+        vecSporkValues[i] = sporkDef.defaultValue;
+        vecSporksActive[i] = false;
     }
 }
 
 bool CSporkManager::SporkValueIsActive(SporkId nSporkID, int64_t &nActiveValueRet) const
 {
-    LOCK(cs);
+    AssertLockHeld(cs);
 
     if (!mapSporksActive.count(nSporkID)) return false;
 
-    auto it = mapSporksCachedValues.find(nSporkID);
-    if (it != mapSporksCachedValues.end()) {
-        nActiveValueRet = it->second;
-        return true;
-    }
-
     // calc how many values we have and how many signers vote for every value
     std::unordered_map<int64_t, int> mapValueCounts;
     for (const auto& pair: mapSporksActive.at(nSporkID)) {
@@ -56,7 +56,6 @@ bool CSporkManager::SporkValueIsActive(SporkId nSporkID, int64_t &nActiveValueRe
             // nMinSporkKeys is always more than the half of the max spork keys number,
             // so there is only one such value and we can stop here
             nActiveValueRet = pair.second.nValue;
-            mapSporksCachedValues[nSporkID] = nActiveValueRet;
             return true;
         }
     }
@@ -64,11 +63,54 @@ bool CSporkManager::SporkValueIsActive(SporkId nSporkID, int64_t &nActiveValueRe
     return false;
 }
 
+void CSporkManager::UpdateSporkValue(SporkId nSporkID)
+{
+    AssertLockHeld(cs);
+
+    auto it = sporkIndexById.find(nSporkID);
+    if (it == sporkIndexById.end()) return;
+
+    int64_t nSporkValue = -1;
+    if (!SporkValueIsActive(nSporkID, nSporkValue)) {
+        nSporkValue = sporkDefs[it->second].defaultValue;
+    }
+    // The active flag is reset after the value is published, see IsSporkActive
+    vecSporkValues[it->second] = nSporkValue;
+    vecSporksActive[it->second] = false;
+}
+
+void CSporkManager::UpdateSporkValues()
+{
+    AssertLockHeld(cs);
+
+    for (const auto& sporkDef : sporkDefs) {
+        UpdateSporkValue(sporkDef.sporkId);
+    }
+}
+
+bool CSporkManager::GetVerifiedSigner(const CSporkMessage& spork, const uint256& hash, CKeyID& keyIDSignerRet)
+{
+    {
+        LOCK(cs);
+        if (mapVerifiedSporks.get(hash, keyIDSignerRet)) {
+            return true;
+        }
+    }
+    // The hash covers the signature, so a message with the same hash has the same signer
+    if (!spork.GetSignerKeyID(keyIDSignerRet)) {
+        return false;
+    }
+    LOCK(cs);
+    mapVerifiedSporks.insert(hash, keyIDSignerRet);
+    return true;
+}
+
 void CSporkManager::Clear()
 {
     LOCK(cs);
     mapSporksActive.clear();
     mapSporksByHash.clear();
+    UpdateSporkValues();
     // sporkPubKeyID and sporkPrivKey should be set in init.cpp,
     // we should not alter them here.
 }
@@ -79,12 +121,34 @@ void CSporkManager::CheckAndRemove()
     bool fSporkAddressIsSet = !setSporkPubKeyIDs.empty();
     assert(fSporkAddressIsSet);
 
+    // Recover the signer of each message once instead of checking its signature against every spork key, the
+    // active messages below are looked up in mapVerifiedSporks then
+    auto itByHash = mapSporksByHash.begin();
+    while (itByHash != mapSporksByHash.end()) {
+        CKeyID keyIDSigner;
+        if (!mapVerifiedSporks.get(itByHash->first, keyIDSigner)) {
+            if (!itByHash->second.GetSignerKeyID(keyIDSigner)) {
+                mapSporksByHash.erase(itByHash++);
+                continue;
+            }
+            mapVerifiedSporks.insert(itByHash->first, keyIDSigner);
+        }
+        if (!setSporkPubKeyIDs.count(keyIDSigner)) {
+            mapSporksByHash.erase(itByHash++);
+            continue;
+        }
+        ++itByHash;
+    }
+
     auto itActive = mapSporksActive.begin();
     while (itActive != mapSporksActive.end()) {
         auto itSignerPair = itActive->second.begin();
         while (itSignerPair != itActive->second.end()) {
+            CKeyID keyIDSigner;
             bool fHasValidSig = setSporkPubKeyIDs.find(itSignerPair->first) != setSporkPubKeyIDs.end() &&
-                                itSignerPair->second.CheckSignature(itSignerPair->first);
+                                (mapVerifiedSporks.get(itSignerPair->second.GetHash(), keyIDSigner) ?
+                                    keyIDSigner == itSignerPair->first :
+                                    itSignerPair->second.CheckSignature(itSignerPair->first));
             if (!fHasValidSig) {
                 mapSporksByHash.erase(itSignerPair->second.GetHash());
                 itActive->second.erase(itSignerPair++);
@@ -99,21 +163,7 @@ void CSporkManager::CheckAndRemove()
         ++itActive;
     }
 
-    auto itByHash = mapSporksByHash.begin();
-    while (itByHash != mapSporksByHash.end()) {
-        bool found = false;
-        for (const auto& signer: setSporkPubKeyIDs) {
-            if (itByHash->second.CheckSignature(signer)) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            mapSporksByHash.erase(itByHash++);
-            continue;
-        }
-        ++itByHash;
-    }
+    UpdateSporkValues();
 }
 
 void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, CConnman& connman)
@@ -143,7 +193,7 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
 
         CKeyID keyIDSigner;
 
-        if (!spork.GetSignerKeyID(keyIDSigner) || !setSporkPubKeyIDs.count(keyIDSigner)) {
+        if (!GetVerifiedSigner(spork, hash, keyIDSigner) || !setSporkPubKeyIDs.count(keyIDSigner)) {
             LOCK(cs_main);
             LogPrint(BCLog::SPORK, "CSporkManager::ProcessSpork -- ERROR: invalid signature\n");
             Misbehaving(pfrom->GetId(), 100);
@@ -173,9 +223,7 @@ void CSporkManager::ProcessSpork(CNode* pfrom, const std::string& strCommand, CD
             LOCK(cs); // make sure to not lock this together with cs_main
             mapSporksByHash[hash] = spork;
             mapSporksActive[spork.nSporkID][keyIDSigner] = spork;
-            // Clear cached values on new spork being processed
-            mapSporksCachedActive.erase(spork.nSporkID);
-            mapSporksCachedValues.erase(spork.nSporkID);
+            UpdateSporkValue(spork.nSporkID);
         }
         spork.Relay(connman);
 
@@ -211,9 +259,8 @@ bool CSporkManager::UpdateSpork(SporkId nSporkID, int64_t nValue, CConnman& conn
         LOCK(cs);
         mapSporksByHash[spork.GetHash()] = spork;
         mapSporksActive[nSporkID][keyIDSigner] = spork;
-        // Clear cached values on new spork being processed
-        mapSporksCachedActive.erase(spork.nSporkID);
-        mapSporksCachedValues.erase(spork.nSporkID);
+        mapVerifiedSporks.insert(spork.GetHash(), keyIDSigner);
+        UpdateSporkValue(nSporkID);
     }
 
     spork.Relay(connman);
@@ -222,35 +269,35 @@ bool CSporkManager::UpdateSpork(SporkId nSporkID, int64_t nValue, CConnman& conn
 
 bool CSporkManager::IsSporkActive(SporkId nSporkID) const
 {
-    LOCK(cs);
-    // If nSporkID is cached, and the cached value is true, then return early true
-    auto it = mapSporksCachedActive.find(nSporkID);
-    if (it != mapSporksCachedActive.end() && it->second) {
+    auto it = sporkIndexById.find(nSporkID);
+    if (it == sporkIndexById.end()) {
+        return GetSporkValue(nSporkID) < GetAdjustedTime();
+    }
+
+    // If the spork is cached as active, then return early true
+    if (vecSporksActive[it->second]) {
         return true;
     }
 
-    int64_t nSporkValue = GetSporkValue(nSporkID);
     // Get time is somewhat costly it looks like
+    int64_t nSporkValue = vecSporkValues[it->second];
     bool ret = nSporkValue < GetAdjustedTime();
-    // Only cache true values
+    // Only cache true values, and only if the value wasn't republished meanwhile (otherwise the flag could be set
+    // after UpdateSporkValue reset it)
     if (ret) {
-        mapSporksCachedActive[nSporkID] = ret;
+        vecSporksActive[it->second] = true;
+        if (vecSporkValues[it->second] != nSporkValue) {
+            vecSporksActive[it->second] = false;
+        }
     }
     return ret;
 }
 
 int64_t CSporkManager::GetSporkValue(SporkId nSporkID) const
 {
-    LOCK(cs);
-
-    int64_t nSporkValue = -1;
-    if (SporkValueIsActive(nSporkID, nSporkValue)) {
-        return nSporkValue;
-    }
-
-    auto it = sporkDefsById.find(nSporkID);
-    if (it != sporkDefsById.end()) {
-        return it->second->defaultValue;
+    auto it = sporkIndexById.find(nSporkID);
+    if (it != sporkIndexById.end()) {
+        return vecSporkValues[it->second];
     }
 
     LogPrint(BCLog::SPORK, "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
@@ -305,12 +352,14 @@ bool CSporkManager::SetSporkAddress(const std::string& strAddress) {
 
 bool CSporkManager::SetMinSporkKeys(int minSporkKeys)
 {
+    LOCK(cs);
     int maxKeysNumber = setSporkPubKeyIDs.size();
     if ((minSporkKeys <= maxKeysNumber / 2) || (minSporkKeys > maxKeysNumber)) {
         LogPrintf("CSporkManager::SetMinSporkKeys -- Invalid min spork signers number: %d\n", minSporkKeys);
         return false;
     }
     nMinSporkKeys = minSporkKeys;
+    UpdateSporkValues();
     return true;
 }
 
@@ -7,9 +7,12 @@
 
 #include <hash.h>
 #include <net.h>
+#include <saltedhasher.h>
+#include <unordered_lru_cache.h>
 #include <utilstrencodings.h>
 #include <key.h>
 
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -152,19 +155,29 @@ class CSporkManager
 {
 private:
     static const std::string SERIALIZATION_VERSION_STRING;
+    static const size_t VERIFIED_SPORKS_CACHE_SIZE = 1000;
 
     std::unordered_map<SporkId, CSporkDef*> sporkDefsById;
     std::unordered_map<std::string, CSporkDef*> sporkDefsByName;
+    // Index of a spork in sporkDefs and the snapshot below, never changes after construction
+    std::unordered_map<SporkId, size_t> sporkIndexById;
 
-    mutable std::unordered_map<SporkId, bool> mapSporksCachedActive;
-    mutable std::unordered_map<SporkId, int64_t> mapSporksCachedValues;
+    /**
+     * Snapshot of the current values of all sporks, republished under cs whenever the messages of a spork change
+     * and read without locking by IsSporkActive and GetSporkValue. Sporks that are active are cached once seen,
+     * as GetAdjustedTime is not free.
+     */
+    std::vector<std::atomic<int64_t>> vecSporkValues;
+    mutable std::vector<std::atomic<bool>> vecSporksActive;
 
     mutable CCriticalSection cs;
     std::unordered_map<uint256, CSporkMessage> mapSporksByHash;
     std::unordered_map<SporkId, std::map<CKeyID, CSporkMessage> > mapSporksActive;
+    // Signers of the spork messages whose signatures were checked already, by message hash
+    unordered_lru_cache<uint256, CKeyID, StaticSaltedHasher, VERIFIED_SPORKS_CACHE_SIZE> mapVerifiedSporks;
 
     std::set<CKeyID> setSporkPubKeyIDs;
-    int nMinSporkKeys;
+    int nMinSporkKeys{0};
     CKey sporkPrivKey;
 
     /**
@@ -173,6 +186,13 @@ private:
      */
     bool SporkValueIsActive(SporkId nSporkID, int64_t& nActiveValueRet) const;
 
+    /** Republish the value of a spork (or of all sporks) after its messages changed */
+    void UpdateSporkValue(SporkId nSporkID);
+    void UpdateSporkValues();
+
+    /** Get the signer of a spork message, recovering it from the signature only if it isn't cached */
+    bool GetVerifiedSigner(const CSporkMessage& spork, const uint256& hash, CKeyID& keyIDSignerRet);
+
 public:
 
     CSporkManager();
@@ -198,6 +218,9 @@ public:
         READWRITE(mapSporksByHash);
         READWRITE(mapSporksActive);
         // we don't serialize private key to prevent its leakage
+        if (ser_action.ForRead()) {
+            UpdateSporkValues();
+        }
     }
 
     /**
@@ -235,7 +258,8 @@ public:
 
     /**
      * IsSporkActive returns a bool for time-based sporks, and should be used
-     * to determine whether the spork can be considered active or not.
+     * to determine whether the spork can be considered active or not. It
+     * doesn't lock cs, so it can be called often from any thread.
      *
      * For value-based sporks such as SPORK_5_INSTANTSEND_MAX_VALUE, the spork
      * value should not be considered a timestamp, but an integer value
@@ -247,6 +271,7 @@ public:
     /**
      * GetSporkValue returns the spork value given a Spork ID. If no active spork
      * message has yet been received by the node, it returns the default value.
+     * Like IsSporkActive, it doesn't lock cs.
      */
     int64_t GetSporkValue(SporkId nSporkID) const;
 
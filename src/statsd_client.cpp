@@ -35,6 +35,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <random.h>
 #include <util.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include <math.h>
 #include <time.h>
 #include <stdlib.h>
@@ -63,6 +71,23 @@ inline bool should_send(float sample_rate)
     return sample_rate > p;
 }
 
+/* The metrics recorded between two flushes, see _StatsdClientData::shards */
+struct _StatsdSamples {
+    std::vector<double> values;
+    // All samples that were recorded, values only keeps up to STATSD_MAX_SAMPLES_PER_KEY of them
+    uint64_t total{0};
+    float sample_rate{1.0};
+};
+
+struct _StatsdShard {
+    std::mutex cs;
+    // Counters are summed, already scaled by their sample rate
+    std::unordered_map<std::string, double> counters;
+    // The last value of a gauge wins, by sequence number as they are recorded on different shards
+    std::unordered_map<std::string, std::pair<uint64_t, std::string>> gauges;
+    std::map<std::pair<std::string, std::string>, _StatsdSamples> samples;
+};
+
 struct _StatsdClientData {
     SOCKET  sock;
     struct  sockaddr_in server;
@@ -71,9 +96,20 @@ struct _StatsdClientData {
     std::string  host;
     std::string  nodename;
     short   port;
-    bool    init;
+    std::atomic<bool> init;
 
     char    errmsg[1024];
+
+    // Callers record on the shard of their thread, so that they hardly ever wait for each other
+    static const int NUM_SHARDS = 16;
+    _StatsdShard shards[NUM_SHARDS];
+    std::atomic<uint64_t> gauge_seq{0};
+
+    std::once_flag thread_started;
+    std::thread thread;
+    std::mutex cs_thread;
+    std::condition_variable cv_thread;
+    std::atomic<bool> stop{false};
 };
 
 StatsdClient::StatsdClient(const std::string& host, int port, const std::string& ns)
@@ -85,6 +121,7 @@ StatsdClient::StatsdClient(const std::string& host, int port, const std::string&
 
 StatsdClient::~StatsdClient()
 {
+    stop();
     // close socket
     CloseSocket(d->sock);
     delete d;
@@ -100,10 +137,15 @@ void StatsdClient::config(const std::string& host, int port, const std::string&
     CloseSocket(d->sock);
 }
 
-int StatsdClient::init()
+static bool IsEnabled()
 {
     static bool fEnabled = gArgs.GetBoolArg("-statsenabled", DEFAULT_STATSD_ENABLE);
-    if (!fEnabled) return -3;
+    return fEnabled;
+}
+
+int StatsdClient::init()
+{
+    if (!IsEnabled()) return -3;
 
     if ( d->init ) return 0;
 
@@ -144,6 +186,25 @@ void StatsdClient::cleanup(std::string& key)
     }
 }
 
+std::string StatsdClient::formatKey(const std::string& key)
+{
+    std::string ret = key;
+    // partition stats by node name if set
+    if (!d->nodename.empty())
+        ret = ret + "." + d->nodename;
+
+    cleanup(ret);
+    return d->ns + ret;
+}
+
+static std::string FormatValue(double value)
+{
+    if (value == floor(value) && fabs(value) < 1e15) {
+        return strprintf("%d", (int64_t)value);
+    }
+    return strprintf("%f", value);
+}
+
 int StatsdClient::dec(const std::string& key, float sample_rate)
 {
     return count(key, -1, sample_rate);
@@ -174,58 +235,166 @@ int StatsdClient::timing(const std::string& key, size_t ms, float sample_rate)
     return send(key, ms, "ms", sample_rate);
 }
 
+int StatsdClient::histogram(const std::string& key, double value, float sample_rate)
+{
+    return sendDouble(key, value, "h", sample_rate);
+}
+
+int StatsdClient::distribution(const std::string& key, double value, float sample_rate)
+{
+    return sendDouble(key, value, "d", sample_rate);
+}
+
 int StatsdClient::send(std::string key, size_t value, const std::string& type, float sample_rate)
 {
+    // values are signed, dec() passes -1
+    return record(key, (double)(int64_t)value, type, sample_rate);
+}
+
+int StatsdClient::sendDouble(std::string key, double value, const std::string& type, float sample_rate)
+{
+    return record(key, value, type, sample_rate);
+}
+
+int StatsdClient::record(const std::string& key, double value, const std::string& type, float sample_rate)
+{
+    if (!IsEnabled()) return -3;
+    // nothing would send the metrics anymore
+    if (d->stop) return 0;
+
     if (!should_send(sample_rate)) {
         return 0;
     }
 
-    // partition stats by node name if set
-    if (!d->nodename.empty())
-        key = key + "." + d->nodename;
+    if (type != "c" && type != "g" && type != "ms" && type != "h" && type != "d") {
+        int ret = init();
+        if ( ret ) return ret;
 
-    cleanup(key);
-
-    char buf[256];
-    if ( fequal( sample_rate, 1.0 ) )
-    {
-        snprintf(buf, sizeof(buf), "%s%s:%zd|%s",
-                d->ns.c_str(), key.c_str(), value, type.c_str());
-    }
-    else
-    {
-        snprintf(buf, sizeof(buf), "%s%s:%zd|%s|@%.2f",
-                d->ns.c_str(), key.c_str(), value, type.c_str(), sample_rate);
+        std::string message = formatKey(key) + ":" + FormatValue(value) + "|" + type;
+        if ( !fequal( sample_rate, 1.0 ) ) {
+            message += strprintf("|@%.2f", sample_rate);
+        }
+        return send(message);
     }
 
-    return send(buf);
+    std::call_once(d->thread_started, [this] {
+        d->thread = std::thread(&StatsdClient::flushThread, this);
+    });
+
+    _StatsdShard& shard = d->shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % _StatsdClientData::NUM_SHARDS];
+    std::lock_guard<std::mutex> lock(shard.cs);
+    if (type == "c") {
+        shard.counters[key] += value / sample_rate;
+    } else if (type == "g") {
+        shard.gauges[key] = std::make_pair(d->gauge_seq++, FormatValue(value));
+    } else {
+        _StatsdSamples& samples = shard.samples[std::make_pair(key, type)];
+        samples.sample_rate = sample_rate;
+        ++samples.total;
+        if (samples.values.size() < STATSD_MAX_SAMPLES_PER_KEY) {
+            samples.values.push_back(value);
+        } else {
+            // reservoir sampling, every sample is kept with the same probability
+            uint64_t pos = insecure_rand.randrange(samples.total);
+            if (pos < samples.values.size()) {
+                samples.values[pos] = value;
+            }
+        }
+    }
+    return 0;
 }
 
-int StatsdClient::sendDouble(std::string key, double value, const std::string& type, float sample_rate)
+void StatsdClient::flush()
 {
-    if (!should_send(sample_rate)) {
-        return 0;
+    std::unordered_map<std::string, double> counters;
+    std::unordered_map<std::string, std::pair<uint64_t, std::string>> gauges;
+    std::map<std::pair<std::string, std::string>, _StatsdSamples> samples;
+    for (auto& shard : d->shards) {
+        std::unordered_map<std::string, double> shard_counters;
+        std::unordered_map<std::string, std::pair<uint64_t, std::string>> shard_gauges;
+        std::map<std::pair<std::string, std::string>, _StatsdSamples> shard_samples;
+        {
+            std::lock_guard<std::mutex> lock(shard.cs);
+            shard_counters.swap(shard.counters);
+            shard_gauges.swap(shard.gauges);
+            shard_samples.swap(shard.samples);
+        }
+        for (const auto& p : shard_counters) {
+            counters[p.first] += p.second;
+        }
+        for (auto& p : shard_gauges) {
+            auto& gauge = gauges[p.first];
+            if (gauge.second.empty() || gauge.first < p.second.first) {
+                gauge = std::move(p.second);
+            }
+        }
+        for (auto& p : shard_samples) {
+            _StatsdSamples& merged = samples[p.first];
+            merged.values.insert(merged.values.end(), p.second.values.begin(), p.second.values.end());
+            merged.total += p.second.total;
+            merged.sample_rate = p.second.sample_rate;
+        }
     }
+    if (counters.empty() && gauges.empty() && samples.empty()) return;
+
+    if (init()) return;
+
+    std::string packet;
+    auto add_line = [&](const std::string& line) {
+        if (!packet.empty() && packet.size() + 1 + line.size() > STATSD_MAX_PACKET_SIZE) {
+            send(packet);
+            packet.clear();
+        }
+        if (!packet.empty()) packet += '\n';
+        packet += line;
+    };
+    for (const auto& p : counters) {
+        add_line(strprintf("%s:%d|c", formatKey(p.first), (int64_t)llround(p.second)));
+    }
+    for (const auto& p : gauges) {
+        add_line(strprintf("%s:%s|g", formatKey(p.first), p.second.second));
+    }
+    for (const auto& p : samples) {
+        const std::string key = formatKey(p.first.first);
+        // let the server scale the counts of the samples that were dropped
+        double sample_rate = p.second.sample_rate * p.second.values.size() / p.second.total;
+        std::string suffix = "|" + p.first.second;
+        if ( !fequal( sample_rate, 1.0 ) ) {
+            suffix += strprintf("|@%.4f", sample_rate);
+        }
+        for (double value : p.second.values) {
+            add_line(key + ":" + FormatValue(value) + suffix);
+        }
+    }
+    if (!packet.empty()) send(packet);
+}
 
-    // partition stats by node name if set
-    if (!d->nodename.empty())
-        key = key + "." + d->nodename;
-
-    cleanup(key);
+void StatsdClient::flushThread()
+{
+    RenameThread("dash-statsd");
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(d->cs_thread);
+            d->cv_thread.wait_for(lock, std::chrono::milliseconds(STATSD_FLUSH_INTERVAL_MS), [this] { return d->stop.load(); });
+        }
+        // the metrics recorded before stop() are sent too
+        bool fStop = d->stop;
+        flush();
+        if (fStop) break;
+    }
+}
 
-    char buf[256];
-    if ( fequal( sample_rate, 1.0 ) )
+void StatsdClient::stop()
+{
     {
-        snprintf(buf, sizeof(buf), "%s%s:%f|%s",
-                d->ns.c_str(), key.c_str(), value, type.c_str());
+        std::lock_guard<std::mutex> lock(d->cs_thread);
+        d->stop = true;
     }
-    else
-    {
-        snprintf(buf, sizeof(buf), "%s%s:%f|%s|@%.2f",
-                d->ns.c_str(), key.c_str(), value, type.c_str(), sample_rate);
+    d->cv_thread.notify_all();
+    if (d->thread.joinable()) {
+        d->thread.join();
     }
-
-    return send(buf);
 }
 
 int StatsdClient::send(const std::string& message)
@@ -14,6 +14,13 @@ static const int DEFAULT_STATSD_PERIOD = 60;
 static const int MIN_STATSD_PERIOD = 5;
 static const int MAX_STATSD_PERIOD = 60 * 60;
 
+// Metrics are aggregated in memory and sent in batches every STATSD_FLUSH_INTERVAL_MS, in packets of up to
+// STATSD_MAX_PACKET_SIZE bytes so that they are never fragmented on typical networks.
+static const int STATSD_FLUSH_INTERVAL_MS = 1000;
+static const size_t STATSD_MAX_PACKET_SIZE = 1432;
+// Samples of a timing or histogram kept per key between two flushes, more are sampled down
+static const size_t STATSD_MAX_SAMPLES_PER_KEY = 1000;
+
 namespace statsd {
 
 struct _StatsdClientData;
@@ -35,16 +42,26 @@ class StatsdClient {
         int gauge(const std::string& key, size_t value, float sample_rate = 1.0);
         int gaugeDouble(const std::string& key, double value, float sample_rate = 1.0);
         int timing(const std::string& key, size_t ms, float sample_rate = 1.0);
+        /* DogStatsD extensions, the server computes percentiles of the samples */
+        int histogram(const std::string& key, double value, float sample_rate = 1.0);
+        int distribution(const std::string& key, double value, float sample_rate = 1.0);
+
+    public:
+        /* Send all aggregated metrics now */
+        void flush();
+        /* Stop the background thread after sending the metrics that were aggregated so far */
+        void stop();
 
     public:
         /**
          * (Low Level Api) manually send a message
          * which might be composed of several lines.
+         * It is sent right away, bypassing the aggregation.
          */
         int send(const std::string& message);
 
-        /* (Low Level Api) manually send a message
-         * type = "c", "g" or "ms"
+        /* (Low Level Api) aggregate a metric
+         * type = "c", "g", "ms", "h" or "d", other types are sent right away
          */
         int send(std::string key, size_t value,
                 const std::string& type, float sample_rate);
@@ -54,6 +71,9 @@ class StatsdClient {
     protected:
         int init();
         void cleanup(std::string& key);
+        int record(const std::string& key, double value, const std::string& type, float sample_rate);
+        std::string formatKey(const std::string& key);
+        void flushThread();
 
     protected:
         struct _StatsdClientData* d;
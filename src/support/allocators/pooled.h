@@ -0,0 +1,167 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOLED_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOLED_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace pooled_allocator_detail {
+
+static const size_t MIN_CLASS_SHIFT = 6;  // 64 bytes
+static const size_t MAX_CLASS_SHIFT = 16; // 64 KiB
+static const size_t NUM_CLASSES = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+// Every thread keeps at most this many bytes of free blocks per size class, and never more than MAX_CLASS_BLOCKS blocks
+static const size_t MAX_CLASS_BYTES = 256 * 1024;
+static const size_t MAX_CLASS_BLOCKS = 64;
+
+struct FreeBlock
+{
+    FreeBlock* next;
+};
+
+// Trivially destructible, so that it can still be used by buffers which are freed after the thread local cleanup ran,
+// e.g. by static objects which are destroyed after the thread locals of the main thread
+struct ThreadPool
+{
+    FreeBlock* vFree[NUM_CLASSES];
+    size_t vCount[NUM_CLASSES];
+    bool fCleanupRegistered;
+    bool fDestroyed;
+};
+
+inline ThreadPool& GetThreadPool()
+{
+    static thread_local ThreadPool pool;
+    return pool;
+}
+
+struct ThreadPoolCleanup
+{
+    ~ThreadPoolCleanup()
+    {
+        ThreadPool& pool = GetThreadPool();
+        for (size_t i = 0; i < NUM_CLASSES; i++) {
+            while (pool.vFree[i]) {
+                FreeBlock* block = pool.vFree[i];
+                pool.vFree[i] = block->next;
+                ::operator delete(block);
+            }
+            pool.vCount[i] = 0;
+        }
+        pool.fDestroyed = true;
+    }
+};
+
+inline void RegisterThreadPoolCleanup()
+{
+    static thread_local ThreadPoolCleanup cleanup;
+    (void)cleanup;
+    GetThreadPool().fCleanupRegistered = true;
+}
+
+inline size_t ClassSize(size_t nClass)
+{
+    return (size_t)1 << (nClass + MIN_CLASS_SHIFT);
+}
+
+//! NUM_CLASSES if nBytes is too large to be pooled
+inline size_t SizeClass(size_t nBytes)
+{
+    size_t nClass = 0;
+    while (nClass < NUM_CLASSES && ClassSize(nClass) < nBytes) {
+        nClass++;
+    }
+    return nClass;
+}
+
+inline void* Allocate(size_t nBytes)
+{
+    size_t nClass = SizeClass(nBytes);
+    if (nClass == NUM_CLASSES) {
+        return ::operator new(nBytes);
+    }
+    ThreadPool& pool = GetThreadPool();
+    if (pool.vFree[nClass]) {
+        FreeBlock* block = pool.vFree[nClass];
+        pool.vFree[nClass] = block->next;
+        pool.vCount[nClass]--;
+        return block;
+    }
+    return ::operator new(ClassSize(nClass));
+}
+
+inline void Deallocate(void* p, size_t nBytes)
+{
+    size_t nClass = SizeClass(nBytes);
+    if (nClass == NUM_CLASSES) {
+        ::operator delete(p);
+        return;
+    }
+    ThreadPool& pool = GetThreadPool();
+    if (pool.fDestroyed || pool.vCount[nClass] >= MAX_CLASS_BLOCKS || (pool.vCount[nClass] + 1) * ClassSize(nClass) > MAX_CLASS_BYTES) {
+        ::operator delete(p);
+        return;
+    }
+    if (!pool.fCleanupRegistered) {
+        RegisterThreadPoolCleanup();
+    }
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = pool.vFree[nClass];
+    pool.vFree[nClass] = block;
+    pool.vCount[nClass]++;
+}
+
+} // namespace pooled_allocator_detail
+
+//
+// Allocator which keeps the freed blocks in power of two size classes in a pool of the thread which freed them and hands
+// them out again for the next allocations of that size class, without going through malloc. Blocks of more than
+// 64 KiB aren't pooled. Memory is NOT cleared when freed, so this must not be used for secrets.
+//
+// Blocks can be freed by another thread than the one which allocated them, they then go to the pool of that thread.
+//
+template <typename T>
+struct pooled_allocator : public std::allocator<T> {
+    // MSVC8 default copy constructor is broken
+    typedef std::allocator<T> base;
+    typedef typename base::size_type size_type;
+    typedef typename base::difference_type difference_type;
+    typedef typename base::pointer pointer;
+    typedef typename base::const_pointer const_pointer;
+    typedef typename base::reference reference;
+    typedef typename base::const_reference const_reference;
+    typedef typename base::value_type value_type;
+    pooled_allocator() noexcept {}
+    pooled_allocator(const pooled_allocator& a) noexcept : base(a) {}
+    template <typename U>
+    pooled_allocator(const pooled_allocator<U>& a) noexcept : base(a)
+    {
+    }
+    ~pooled_allocator() noexcept {}
+    template <typename _Other>
+    struct rebind {
+        typedef pooled_allocator<_Other> other;
+    };
+
+    T* allocate(std::size_t n, const void* hint = 0)
+    {
+        return static_cast<T*>(pooled_allocator_detail::Allocate(sizeof(T) * n));
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        if (p != nullptr) {
+            pooled_allocator_detail::Deallocate(p, sizeof(T) * n);
+        }
+    }
+};
+
+// Byte-vector with pooled and uncleared memory, for the serialization buffers of data which isn't secret.
+typedef std::vector<char, pooled_allocator<char> > CPooledSerializeData;
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOLED_H
@@ -9,9 +9,14 @@
 
 #include <stdio.h>
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
+#include <tuple>
+#include <unordered_map>
 
 #ifdef DEBUG_LOCKCONTENTION
 #if !defined(HAVE_THREAD_LOCAL)
@@ -23,6 +28,191 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+//
+// Lock profiling (-lockprofile).
+// Contended acquisitions are timed while they wait for the lock, one in
+// LOCK_PROFILE_SAMPLE_RATE acquisitions also has the time it holds the lock
+// measured. Threads record into their own shard, so the profiler doesn't add
+// contention of its own, the shards are merged when the profile is read.
+//
+
+std::atomic<bool> g_lock_profile{DEFAULT_LOCK_PROFILE};
+
+namespace {
+
+// The name and location are string literals of the LOCK macros, so their addresses identify the call site
+typedef std::tuple<const char*, const char*, int> LockProfileSite;
+
+struct LockProfileSiteHasher
+{
+    size_t operator()(const LockProfileSite& site) const
+    {
+        return std::hash<const void*>()(std::get<0>(site)) ^ std::hash<const void*>()(std::get<1>(site)) ^ std::hash<int>()(std::get<2>(site));
+    }
+};
+
+struct LockProfileShard
+{
+    std::mutex mutex;
+    std::unordered_map<LockProfileSite, LockProfileStats, LockProfileSiteHasher> mapSites;
+};
+
+static const int LOCK_PROFILE_SHARDS = 16;
+
+LockProfileShard* GetLockProfileShards()
+{
+    // Never destroyed, locks are still taken by the destructors of other globals
+    static LockProfileShard* shards = new LockProfileShard[LOCK_PROFILE_SHARDS];
+    return shards;
+}
+
+int64_t LockProfileMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void AddToHistogram(LockProfileStats::Histogram& histogram, int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nBucket < LOCK_PROFILE_BUCKETS - 1 && nMicros >= ((int64_t)1 << nBucket)) {
+        nBucket++;
+    }
+    histogram[nBucket]++;
+}
+
+void MergeHistogram(LockProfileStats::Histogram& histogram, const LockProfileStats::Histogram& other)
+{
+    for (int i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+        histogram[i] += other[i];
+    }
+}
+
+void RecordLockProfile(const char* pszName, const char* pszFile, int nLine, int64_t nWait, int64_t nHold)
+{
+    static thread_local const size_t nShard = std::hash<std::thread::id>()(std::this_thread::get_id()) % LOCK_PROFILE_SHARDS;
+    LockProfileShard& shard = GetLockProfileShards()[nShard];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.mapSites.find(LockProfileSite(pszName, pszFile, nLine));
+    if (it == shard.mapSites.end()) {
+        it = shard.mapSites.emplace(LockProfileSite(pszName, pszFile, nLine), LockProfileStats()).first;
+        it->second.strName = pszName;
+        it->second.strFile = pszFile;
+        it->second.nLine = nLine;
+    }
+    LockProfileStats& stats = it->second;
+    if (nWait >= 0) {
+        stats.nContentions++;
+        stats.nWaitMicros += nWait;
+        stats.nMaxWaitMicros = std::max(stats.nMaxWaitMicros, nWait);
+        AddToHistogram(stats.waitHistogram, nWait);
+    }
+    if (nHold >= 0) {
+        stats.nHoldSamples++;
+        stats.nHoldMicros += nHold;
+        stats.nMaxHoldMicros = std::max(stats.nMaxHoldMicros, nHold);
+        AddToHistogram(stats.holdHistogram, nHold);
+    }
+}
+
+} // namespace
+
+void CCriticalBlock::EnterProfiled(const char* pszName, const char* pszFile, int nLine)
+{
+    int64_t nWait = -1;
+    if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
+        PrintLockContention(pszName, pszFile, nLine);
+#endif
+        int64_t nWaitStart = LockProfileMicros();
+        lock.lock();
+        nWait = LockProfileMicros() - nWaitStart;
+    }
+    StartProfile(pszName, pszFile, nLine, nWait);
+}
+
+void CCriticalBlock::StartProfile(const char* pszName, const char* pszFile, int nLine, int64_t nWait)
+{
+    static thread_local unsigned int nAcquisitions = 0;
+    const bool fSampleHold = (++nAcquisitions % LOCK_PROFILE_SAMPLE_RATE) == 0;
+    if (nWait < 0 && !fSampleHold) {
+        return;
+    }
+    pszProfileName = pszName;
+    pszProfileFile = pszFile;
+    nProfileLine = nLine;
+    nProfileWait = nWait;
+    nProfileStart = fSampleHold ? LockProfileMicros() : 0;
+}
+
+void CCriticalBlock::LeaveProfiled()
+{
+    const int64_t nHold = nProfileStart != 0 ? LockProfileMicros() - nProfileStart : -1;
+    RecordLockProfile(pszProfileName, pszProfileFile, nProfileLine, nProfileWait, nHold);
+    pszProfileFile = nullptr;
+}
+
+int64_t LockProfileStats::GetPercentile(const Histogram& histogram, double dPercentile)
+{
+    uint64_t nTotal = 0;
+    for (uint64_t nCount : histogram) {
+        nTotal += nCount;
+    }
+    if (nTotal == 0) {
+        return 0;
+    }
+    const double dTarget = nTotal * dPercentile / 100;
+    uint64_t nSeen = 0;
+    for (int i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+        nSeen += histogram[i];
+        if (nSeen > 0 && nSeen >= dTarget) {
+            return (int64_t)1 << i;
+        }
+    }
+    return (int64_t)1 << (LOCK_PROFILE_BUCKETS - 1);
+}
+
+std::vector<LockProfileStats> GetLockProfileStats()
+{
+    std::unordered_map<LockProfileSite, LockProfileStats, LockProfileSiteHasher> mapMerged;
+    LockProfileShard* shards = GetLockProfileShards();
+    for (int i = 0; i < LOCK_PROFILE_SHARDS; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        for (const auto& p : shards[i].mapSites) {
+            auto it = mapMerged.find(p.first);
+            if (it == mapMerged.end()) {
+                mapMerged.emplace(p.first, p.second);
+                continue;
+            }
+            LockProfileStats& stats = it->second;
+            stats.nContentions += p.second.nContentions;
+            stats.nWaitMicros += p.second.nWaitMicros;
+            stats.nMaxWaitMicros = std::max(stats.nMaxWaitMicros, p.second.nMaxWaitMicros);
+            MergeHistogram(stats.waitHistogram, p.second.waitHistogram);
+            stats.nHoldSamples += p.second.nHoldSamples;
+            stats.nHoldMicros += p.second.nHoldMicros;
+            stats.nMaxHoldMicros = std::max(stats.nMaxHoldMicros, p.second.nMaxHoldMicros);
+            MergeHistogram(stats.holdHistogram, p.second.holdHistogram);
+        }
+    }
+
+    std::vector<LockProfileStats> vecStats;
+    vecStats.reserve(mapMerged.size());
+    for (auto& p : mapMerged) {
+        vecStats.emplace_back(std::move(p.second));
+    }
+    return vecStats;
+}
+
+void ResetLockProfileStats()
+{
+    LockProfileShard* shards = GetLockProfileShards();
+    for (int i = 0; i < LOCK_PROFILE_SHARDS; i++) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        shards[i].mapSites.clear();
+    }
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
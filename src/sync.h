@@ -8,9 +8,14 @@
 
 #include <threadsafety.h>
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
+#include <stdint.h>
+#include <string>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 
 /////////////////////////////////////////////////
@@ -112,15 +117,71 @@ typedef std::unique_lock<std::mutex> WaitableLock;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Default for -lockprofile */
+static const bool DEFAULT_LOCK_PROFILE = false;
+/** One in this many acquisitions of a lock has its hold time measured while profiling */
+static const int LOCK_PROFILE_SAMPLE_RATE = 16;
+/** Number of buckets of the histograms of LockProfileStats, bucket i counts durations below 2^i microseconds */
+static const int LOCK_PROFILE_BUCKETS = 32;
+
+/** Whether the wait and hold times of locks are recorded (-lockprofile) */
+extern std::atomic<bool> g_lock_profile;
+
+/** Wait and hold times of the acquisitions of a lock at one call site */
+struct LockProfileStats
+{
+    typedef std::array<uint64_t, LOCK_PROFILE_BUCKETS> Histogram;
+
+    std::string strName;
+    std::string strFile;
+    int nLine{0};
+
+    // Acquisitions which had to wait for another thread to release the lock
+    uint64_t nContentions{0};
+    int64_t nWaitMicros{0};
+    int64_t nMaxWaitMicros{0};
+    Histogram waitHistogram{};
+
+    // Sampled acquisitions whose hold time was measured
+    uint64_t nHoldSamples{0};
+    int64_t nHoldMicros{0};
+    int64_t nMaxHoldMicros{0};
+    Histogram holdHistogram{};
+
+    /** Upper bound in microseconds of a percentile (0-100) of the durations in a histogram, 0 if it is empty */
+    static int64_t GetPercentile(const Histogram& histogram, double dPercentile);
+};
+
+/** The profiles of all call sites which were recorded since startup or the last reset */
+std::vector<LockProfileStats> GetLockProfileStats();
+void ResetLockProfileStats();
+
 /** Wrapper around std::unique_lock<CCriticalSection> */
 class SCOPED_LOCKABLE CCriticalBlock
 {
 private:
     std::unique_lock<CCriticalSection> lock;
 
+    // Call site of a profiled acquisition, nullptr if it isn't profiled
+    const char* pszProfileName{nullptr};
+    const char* pszProfileFile{nullptr};
+    int nProfileLine{0};
+    // Time spent waiting for the lock, -1 if it wasn't contended
+    int64_t nProfileWait{-1};
+    // When the lock was acquired, 0 if its hold time isn't sampled
+    int64_t nProfileStart{0};
+
+    void EnterProfiled(const char* pszName, const char* pszFile, int nLine);
+    void StartProfile(const char* pszName, const char* pszFile, int nLine, int64_t nWait);
+    void LeaveProfiled();
+
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (g_lock_profile.load(std::memory_order_relaxed)) {
+            EnterProfiled(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -137,6 +198,8 @@ private:
         lock.try_lock();
         if (!lock.owns_lock())
             LeaveCritical();
+        else if (g_lock_profile.load(std::memory_order_relaxed))
+            StartProfile(pszName, pszFile, nLine, -1);
         return lock.owns_lock();
     }
 
@@ -162,8 +225,11 @@ public:
 
     ~CCriticalBlock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+            if (pszProfileFile)
+                LeaveProfiled();
             LeaveCritical();
+        }
     }
 
     operator bool()
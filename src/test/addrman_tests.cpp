@@ -687,4 +687,31 @@ BOOST_AUTO_TEST_CASE(addrman_evictionworks)
 }
 
 
+BOOST_AUTO_TEST_CASE(addrman_occupiedpositions)
+{
+    CAddrManOccupiedPositions positions(16);
+    BOOST_CHECK_EQUAL(positions.size(), 0U);
+
+    positions.Set(3, true);
+    positions.Set(7, true);
+    positions.Set(11, true);
+    // setting an occupied position again doesn't add it twice
+    positions.Set(7, true);
+    BOOST_CHECK_EQUAL(positions.size(), 3U);
+    BOOST_CHECK(positions.IsOccupied(3) && positions.IsOccupied(7) && positions.IsOccupied(11));
+    BOOST_CHECK(!positions.IsOccupied(0));
+
+    // removing a position from the middle keeps the others
+    positions.Set(3, false);
+    positions.Set(0, false);
+    BOOST_CHECK_EQUAL(positions.size(), 2U);
+    BOOST_CHECK(!positions.IsOccupied(3));
+    std::set<int> remaining{positions[0], positions[1]};
+    BOOST_CHECK(remaining == std::set<int>({7, 11}));
+
+    positions.Clear();
+    BOOST_CHECK_EQUAL(positions.size(), 0U);
+    BOOST_CHECK(!positions.IsOccupied(7) && !positions.IsOccupied(11));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
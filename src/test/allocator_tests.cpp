@@ -4,10 +4,14 @@
 
 #include <util.h>
 
+#include <streams.h>
+#include <support/allocators/pool.h>
+#include <support/allocators/pooled.h>
 #include <support/allocators/secure.h>
 #include <test/test_dash.h>
 
 #include <memory>
+#include <unordered_map>
 
 #include <boost/test/unit_test.hpp>
 
@@ -233,4 +237,87 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0);
+
+    // Blocks are rounded up to the alignment and carved out of the same chunk
+    char* a = static_cast<char*>(resource.Allocate(10, 8));
+    char* b = static_cast<char*>(resource.Allocate(16, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1);
+    BOOST_CHECK(b == a + 16);
+
+    // Freed blocks are reused for allocations of the same size class
+    resource.Deallocate(a, 10, 8);
+    BOOST_CHECK(resource.Allocate(16, 8) == a);
+    resource.Deallocate(b, 16, 8);
+
+    // Allocations too large for the free lists don't touch the chunks
+    void* large = resource.Allocate(100, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1);
+    resource.Deallocate(large, 100, 8);
+
+    // A full chunk makes room for a new one
+    for (int i = 0; i < 1024 / 64; i++) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_tests)
+{
+    typedef PoolAllocator<std::pair<const int, int>, 64, 8> Allocator;
+    Allocator::ResourceType resource(4096);
+    {
+        std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Allocator> map(0, std::hash<int>(), std::equal_to<int>(), &resource);
+        for (int i = 0; i < 1000; i++) {
+            map[i] = i;
+        }
+        size_t nChunks = resource.NumAllocatedChunks();
+        BOOST_CHECK(nChunks > 0);
+
+        // Erased nodes are recycled instead of growing the pool
+        for (int i = 0; i < 1000; i++) {
+            map.erase(i);
+            map[i + 1000] = i;
+        }
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), nChunks);
+        BOOST_CHECK_EQUAL(map.size(), 1000);
+        BOOST_CHECK_EQUAL(map[1999], 999);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pooled_allocator_tests)
+{
+    // A freed buffer is handed out again for the next allocation of its size class
+    const char* p;
+    {
+        CPooledSerializeData buf(100);
+        p = buf.data();
+    }
+    {
+        CPooledSerializeData buf(120);
+        BOOST_CHECK(buf.data() == p);
+        CPooledSerializeData buf2(120);
+        BOOST_CHECK(buf2.data() != p);
+    }
+
+    // Streams with pooled buffers serialize the same as the zeroing ones
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    CPooledDataStream ssPooled(SER_DISK, CLIENT_VERSION);
+    for (int i = 0; i < 1000; i++) {
+        ss << std::make_pair('c', i);
+        ssPooled << std::make_pair('c', i);
+    }
+    BOOST_CHECK(std::equal(ss.begin(), ss.end(), ssPooled.begin(), ssPooled.end()));
+    std::pair<char, int> entry;
+    for (int i = 0; i < 1000; i++) {
+        ssPooled >> entry;
+        BOOST_CHECK_EQUAL(entry.second, i);
+    }
+    BOOST_CHECK(ssPooled.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
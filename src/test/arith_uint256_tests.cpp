@@ -366,6 +366,14 @@ BOOST_AUTO_TEST_CASE( divide )
     BOOST_CHECK(R2L / MaxL == ZeroL);
     BOOST_CHECK(MaxL / R2L == 1);
     BOOST_CHECK_THROW(R2L / ZeroL, uint_error);
+
+    for (uint32_t b32 : {1U, 2U, 25U, 3600U, 0x80000000U, 0xffffffffU}) {
+        BOOST_CHECK(arith_uint256(R1L).DivideBy(b32) == R1L / b32);
+        BOOST_CHECK(arith_uint256(R2L).DivideBy(b32) == R2L / b32);
+        BOOST_CHECK(arith_uint256(MaxL).DivideBy(b32) == MaxL / b32);
+    }
+    BOOST_CHECK(arith_uint256(5).DivideBy(7) == ZeroL);
+    BOOST_CHECK_THROW(arith_uint256(R1L).DivideBy(0), uint_error);
 }
 
 
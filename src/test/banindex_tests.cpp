@@ -0,0 +1,114 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <banindex.h>
+#include <netbase.h>
+
+#include <test/test_dash.h>
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(banindex_tests, BasicTestingSetup)
+
+static CSubNet ParseSubNet(const std::string& str)
+{
+    CSubNet subNet;
+    LookupSubNet(str.c_str(), subNet);
+    return subNet;
+}
+
+// A random address in 10.0.0.0/14, so that the random subnets overlap a lot
+static CNetAddr RandomAddr()
+{
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = htonl(0x0a000000 | (InsecureRand32() & 0x3ffff));
+    return CNetAddr(ipv4Addr);
+}
+
+static CNetAddr ParseAddr(const std::string& str)
+{
+    CNetAddr addr;
+    LookupHost(str.c_str(), addr, false);
+    return addr;
+}
+
+BOOST_AUTO_TEST_CASE(banindex_match)
+{
+    CBanIndex index;
+    index.Insert(ParseSubNet("1.2.3.4"), 100);
+    index.Insert(ParseSubNet("10.0.0.0/8"), 200);
+    index.Insert(ParseSubNet("192.168.0.0/255.0.255.0"), 300); // not a prefix
+    index.Insert(ParseSubNet("2001:db8::/32"), 400);
+    BOOST_CHECK_EQUAL(index.size(), 4U);
+
+    BOOST_CHECK(index.IsBanned(ParseAddr("1.2.3.4"), 99));
+    BOOST_CHECK(!index.IsBanned(ParseAddr("1.2.3.4"), 100));
+    BOOST_CHECK(!index.IsBanned(ParseAddr("1.2.3.5"), 0));
+    BOOST_CHECK(index.IsBanned(ParseAddr("10.255.1.2"), 150));
+    BOOST_CHECK(!index.IsBanned(ParseAddr("11.0.0.1"), 0));
+    BOOST_CHECK(index.IsBanned(ParseAddr("192.1.0.7"), 0));
+    BOOST_CHECK(!index.IsBanned(ParseAddr("192.168.1.7"), 0));
+    BOOST_CHECK(index.IsBanned(ParseAddr("2001:db8:1::1"), 0));
+    BOOST_CHECK(!index.IsBanned(ParseAddr("2001:db9::1"), 0));
+    // an IPv6 address with the bytes of a banned IPv4 address is a different network
+    BOOST_CHECK(!index.IsBanned(ParseAddr("::1.2.3.4"), 0));
+
+    auto expired = index.GetExpired(250);
+    BOOST_REQUIRE_EQUAL(expired.size(), 2U);
+    BOOST_CHECK(expired[0].first == 100 && expired[0].second == ParseSubNet("1.2.3.4"));
+    BOOST_CHECK(expired[1].first == 200 && expired[1].second == ParseSubNet("10.0.0.0/8"));
+
+    index.Erase(ParseSubNet("10.0.0.0/8"), 200);
+    index.Erase(ParseSubNet("192.168.0.0/255.0.255.0"), 300);
+    BOOST_CHECK(!index.IsBanned(ParseAddr("10.255.1.2"), 0));
+    BOOST_CHECK(!index.IsBanned(ParseAddr("192.1.0.7"), 0));
+    BOOST_CHECK(index.IsBanned(ParseAddr("1.2.3.4"), 0));
+    BOOST_CHECK_EQUAL(index.size(), 2U);
+
+    index.Clear();
+    BOOST_CHECK(!index.IsBanned(ParseAddr("1.2.3.4"), 0));
+    BOOST_CHECK(index.GetExpired(1000).empty());
+}
+
+BOOST_AUTO_TEST_CASE(banindex_random)
+{
+    // compare with matching all subnets, with enough erases to rebuild the trie
+    CBanIndex index;
+    std::map<CSubNet, int64_t> expected;
+    for (int i = 0; i < 5000; i++) {
+        CSubNet subNet(RandomAddr(), 16 + InsecureRandRange(17));
+        int64_t nBanUntil = 1 + InsecureRandRange(1000);
+        auto it = expected.find(subNet);
+        if (it != expected.end()) {
+            index.Erase(subNet, it->second);
+            expected.erase(it);
+            if (InsecureRandBool()) {
+                continue;
+            }
+        }
+        index.Insert(subNet, nBanUntil);
+        expected.emplace(subNet, nBanUntil);
+    }
+    BOOST_CHECK_EQUAL(index.size(), expected.size());
+
+    for (int i = 0; i < 1000; i++) {
+        CNetAddr addr = RandomAddr();
+        int64_t nNow = InsecureRandRange(1000);
+        bool fBanned = false;
+        for (const auto& p : expected) {
+            fBanned |= nNow < p.second && p.first.Match(addr);
+        }
+        BOOST_CHECK_EQUAL(index.IsBanned(addr, nNow), fBanned);
+    }
+
+    size_t nExpired = 0;
+    for (const auto& p : expected) {
+        nExpired += p.second < 500;
+    }
+    BOOST_CHECK_EQUAL(index.GetExpired(500).size(), nExpired);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilter.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/blockfilterindex.h>
+#include <test/test_dash.h>
+#include <undo.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilter_index_tests)
+
+static void CheckFilterLookups(BlockFilterIndex& filter_index, const CBlockIndex* block_index,
+                               uint256& last_header)
+{
+    CBlock block;
+    BOOST_REQUIRE(ReadBlockFromDisk(block, block_index, Params().GetConsensus()));
+    CBlockUndo block_undo;
+    if (block_index->nHeight > 0) {
+        BOOST_REQUIRE(UndoReadFromDisk(block_undo, block_index));
+    }
+    BlockFilter expected_filter(BlockFilterType::BASIC_FILTER, block, block_undo);
+
+    BlockFilter filter;
+    uint256 filter_header;
+    std::vector<BlockFilter> filters;
+    std::vector<uint256> filter_hashes;
+
+    BOOST_CHECK(filter_index.LookupFilter(block_index, filter));
+    BOOST_CHECK(filter_index.LookupFilterHeader(block_index, filter_header));
+    BOOST_CHECK(filter_index.LookupFilterRange(block_index->nHeight, block_index, filters));
+    BOOST_CHECK(filter_index.LookupFilterHashRange(block_index->nHeight, block_index, filter_hashes));
+
+    BOOST_CHECK_EQUAL(filters.size(), 1);
+    BOOST_CHECK_EQUAL(filter_hashes.size(), 1);
+
+    BOOST_CHECK(filter.GetHash() == expected_filter.GetHash());
+    BOOST_CHECK(filter.GetBlockHash() == block_index->GetBlockHash());
+    BOOST_CHECK(filter_header == expected_filter.ComputeHeader(last_header));
+    BOOST_CHECK(filters[0].GetHash() == expected_filter.GetHash());
+    BOOST_CHECK(filter_hashes[0] == expected_filter.GetHash());
+
+    last_header = filter_header;
+}
+
+BOOST_FIXTURE_TEST_CASE(blockfilter_index_initial_sync, TestChain100Setup)
+{
+    BlockFilterIndex filter_index(BlockFilterType::BASIC_FILTER, 1 << 20, true, true);
+
+    // Nothing is indexed before the first sync
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    BlockFilter filter;
+    BOOST_CHECK(!filter_index.IsSynced());
+    BOOST_CHECK(!filter_index.LookupFilter(tip, filter));
+
+    BOOST_REQUIRE(filter_index.Sync());
+    BOOST_CHECK(filter_index.IsSynced());
+
+    // Check that filter index has all blocks that were in the chain before it started.
+    uint256 last_header;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* block_index = chainActive.Genesis(); block_index; block_index = chainActive.Next(block_index)) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+    }
+
+    // Ranges over the whole chain
+    std::vector<BlockFilter> filters;
+    std::vector<uint256> filter_hashes;
+    BOOST_CHECK(filter_index.LookupFilterRange(0, tip, filters));
+    BOOST_CHECK(filter_index.LookupFilterHashRange(0, tip, filter_hashes));
+    BOOST_CHECK_EQUAL(filters.size(), tip->nHeight + 1);
+    BOOST_CHECK_EQUAL(filter_hashes.size(), tip->nHeight + 1);
+    BOOST_CHECK(!filter_index.LookupFilterRange(tip->nHeight + 1, tip, filters));
+
+    // Disconnect the last 3 blocks and build a competing chain of 4 blocks with a different coinbase script
+    std::vector<const CBlockIndex*> stale_blocks;
+    {
+        LOCK(cs_main);
+        CBlockIndex* fork = chainActive[tip->nHeight - 3];
+        for (const CBlockIndex* pindex = tip; pindex != fork; pindex = pindex->pprev) {
+            stale_blocks.emplace_back(pindex);
+        }
+        CValidationState state;
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), chainActive[fork->nHeight + 1]));
+    }
+    CScript other_script = CScript() << OP_TRUE;
+    for (int i = 0; i < 4; i++) {
+        CreateAndProcessBlock({}, other_script);
+    }
+    SyncWithValidationInterfaceQueue();
+
+    // New blocks are only served once the index caught up, blocks that were disconnected not at all
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    BOOST_CHECK(!filter_index.LookupFilter(tip, filter));
+    BOOST_REQUIRE(filter_index.Sync());
+    for (const CBlockIndex* pindex : stale_blocks) {
+        BOOST_CHECK(!filter_index.LookupFilter(pindex, filter));
+    }
+
+    last_header.SetNull();
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* block_index = chainActive.Genesis(); block_index; block_index = chainActive.Next(block_index)) {
+            CheckFilterLookups(filter_index, block_index, last_header);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
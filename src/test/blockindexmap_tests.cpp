@@ -0,0 +1,55 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockindexmap.h>
+
+#include <test/test_dash.h>
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockindexmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockindexmap_insert_find)
+{
+    CBlockIndexMap map;
+    std::map<uint256, CBlockIndex*> expected;
+    // enough entries for the table to grow a few times
+    for (int i = 0; i < 10000; i++) {
+        CBlockIndex* pindex = map.NewIndex();
+        pindex->nHeight = i;
+        auto inserted = map.emplace(InsecureRand256(), pindex);
+        BOOST_CHECK(inserted.second);
+        pindex->phashBlock = &inserted.first->first;
+        expected.emplace(inserted.first->first, pindex);
+    }
+    BOOST_CHECK_EQUAL(map.size(), expected.size());
+
+    for (const auto& p : expected) {
+        auto it = map.find(p.first);
+        BOOST_CHECK(it != map.end() && it->second == p.second);
+        // the hashes didn't move
+        BOOST_CHECK(p.second->GetBlockHash() == p.first);
+        // duplicates aren't inserted
+        BOOST_CHECK(!map.insert(std::make_pair(p.first, nullptr)).second);
+    }
+
+    // iterated in insertion order
+    int nHeight = 0;
+    for (const auto& entry : map) {
+        BOOST_CHECK_EQUAL(entry.second->nHeight, nHeight++);
+    }
+
+    const uint256 hashMissing = InsecureRand256();
+    BOOST_CHECK_EQUAL(map.count(hashMissing), 0U);
+    BOOST_CHECK(map[hashMissing] == nullptr);
+    BOOST_CHECK_EQUAL(map.count(hashMissing), 1U);
+
+    map.clear();
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(expected.begin()->first) == map.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,159 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <index/blocktreeindex.h>
+#include <test/test_dash.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blocktree_index_tests)
+
+BOOST_FIXTURE_TEST_CASE(blocktree_index_toggle_txindex, TestChain100Setup)
+{
+    const bool fTxIndexBefore = fTxIndex;
+    uint256 txid;
+    {
+        LOCK(cs_main);
+        CBlock block;
+        BOOST_REQUIRE(ReadBlockFromDisk(block, chainActive[1], Params().GetConsensus()));
+        txid = block.vtx[0]->GetHash();
+    }
+    CDiskTxPos pos;
+
+    // Disabling the index erases it without a reindex
+    gArgs.ForceSetArg("-txindex", "0");
+    {
+        BlockTreeIndexBuilder builder(1 << 20, true, true);
+        std::string strError;
+        BOOST_REQUIRE(builder.Configure(strError));
+        BOOST_CHECK(!fTxIndex);
+        BOOST_CHECK(builder.HasPendingWork());
+        BOOST_CHECK(!builder.IsBuilding("txindex"));
+        builder.ThreadBuild();
+        BOOST_CHECK(!builder.HasPendingWork());
+    }
+    BOOST_CHECK(!pblocktree->ReadTxIndex(txid, pos));
+    bool fFlag = true;
+    BOOST_CHECK(pblocktree->ReadFlag("txindex", fFlag) && !fFlag);
+
+    // Enabling it again adds the entries of all blocks of the chain
+    gArgs.ForceSetArg("-txindex", "1");
+    {
+        BlockTreeIndexBuilder builder(1 << 20, true, true);
+        std::string strError;
+        BOOST_REQUIRE(builder.Configure(strError));
+        BOOST_CHECK(fTxIndex);
+        BOOST_CHECK(builder.IsBuilding("txindex"));
+        builder.ThreadBuild();
+        BOOST_CHECK(!builder.IsBuilding("txindex"));
+        BOOST_CHECK(!builder.HasPendingWork());
+    }
+    BOOST_CHECK(pblocktree->ReadTxIndex(txid, pos));
+    BOOST_CHECK(pblocktree->ReadFlag("txindex", fFlag) && fFlag);
+
+    // Nothing to do when the settings didn't change
+    {
+        BlockTreeIndexBuilder builder(1 << 20, true, true);
+        std::string strError;
+        BOOST_REQUIRE(builder.Configure(strError));
+        BOOST_CHECK(!builder.HasPendingWork());
+    }
+
+    gArgs.ForceSetArg("-txindex", fTxIndexBefore ? "1" : "0");
+    fTxIndex = fTxIndexBefore;
+}
+
+BOOST_FIXTURE_TEST_CASE(address_index_summary, TestingSetup)
+{
+    const uint160 addressHash = uint160(ParseHex("1234567890123456789012345678901234567890"));
+    const uint256 txid1 = uint256S("0x01");
+    const uint256 txid2 = uint256S("0x02");
+    const uint256 txid3 = uint256S("0x03");
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > block1 = {
+        {CAddressIndexKey(1, addressHash, 10, 0, txid1, 0, false), 50 * COIN},
+        {CAddressIndexKey(1, addressHash, 10, 1, txid2, 0, false), 5 * COIN},
+        {CAddressIndexKey(1, addressHash, 10, 1, txid2, 1, false), 2 * COIN},
+    };
+    std::vector<std::pair<CAddressIndexKey, CAmount> > block2 = {
+        {CAddressIndexKey(1, addressHash, 20, 1, txid3, 0, true), -5 * COIN},
+    };
+    BOOST_REQUIRE(pblocktree->WriteAddressIndex(block1));
+    BOOST_REQUIRE(pblocktree->WriteAddressIndex(block2));
+    // Writing entries again doesn't change the totals
+    BOOST_REQUIRE(pblocktree->WriteAddressIndex(block1));
+
+    CAddressIndexSummary summary;
+    BOOST_REQUIRE(pblocktree->ReadAddressSummary(addressHash, 1, summary));
+    BOOST_CHECK_EQUAL(summary.balance, 52 * COIN);
+    BOOST_CHECK_EQUAL(summary.received, 57 * COIN);
+    BOOST_CHECK_EQUAL(summary.txCount, 3);
+    BOOST_CHECK_EQUAL(summary.firstHeight, 10);
+    BOOST_CHECK_EQUAL(summary.lastHeight, 20);
+
+    // Range reads start at the first entry of the range
+    std::vector<std::pair<CAddressIndexKey, CAmount> > entries;
+    BOOST_REQUIRE(pblocktree->ReadAddressIndex(addressHash, 1, entries, 15));
+    BOOST_REQUIRE_EQUAL(entries.size(), 1);
+    BOOST_CHECK(entries[0].first.txhash == txid3);
+
+    // Disconnecting the last block moves the last height back
+    BOOST_REQUIRE(pblocktree->EraseAddressIndex(block2));
+    BOOST_REQUIRE(pblocktree->ReadAddressSummary(addressHash, 1, summary));
+    BOOST_CHECK_EQUAL(summary.balance, 57 * COIN);
+    BOOST_CHECK_EQUAL(summary.txCount, 2);
+    BOOST_CHECK_EQUAL(summary.lastHeight, 10);
+
+    BOOST_REQUIRE(pblocktree->EraseAddressIndex(block1));
+    BOOST_CHECK(!pblocktree->ReadAddressSummary(addressHash, 1, summary));
+}
+
+BOOST_FIXTURE_TEST_CASE(spent_index_batch, TestingSetup)
+{
+    const uint256 txid1 = uint256S("0x01");
+    const uint256 txid2 = uint256S("0x02");
+    const uint256 txid3 = uint256S("0x03");
+    const uint256 spender = uint256S("0xff");
+
+    // Output 256 is stored before output 1, the batch has to follow the order of the serialized keys
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > entries;
+    for (unsigned int n : {0, 1, 2, 256, 300}) {
+        entries.emplace_back(CSpentIndexKey(txid1, n), CSpentIndexValue(spender, n, 10, n * COIN, 1, uint160()));
+    }
+    entries.emplace_back(CSpentIndexKey(txid2, 5), CSpentIndexValue(spender, 1000, 11, COIN, 2, uint160()));
+    BOOST_REQUIRE(pblocktree->UpdateSpentIndex(entries));
+
+    std::vector<CSpentIndexKey> keys;
+    for (unsigned int n : {300, 0, 3, 1, 2, 256, 257, 0}) {
+        keys.emplace_back(txid1, n);
+    }
+    keys.emplace_back(txid2, 5);
+    keys.emplace_back(txid3, 0);
+    keys.emplace_back(txid3, 1);
+
+    CSpentIndexTxInfo info;
+    BOOST_REQUIRE(pblocktree->ReadSpentIndex(keys, info));
+    BOOST_CHECK_EQUAL(info.mSpentInfo.size(), entries.size());
+    for (auto& key : keys) {
+        CSpentIndexValue value;
+        bool fFound = pblocktree->ReadSpentIndex(key, value);
+        auto it = info.mSpentInfo.find(key);
+        BOOST_CHECK_EQUAL(it != info.mSpentInfo.end(), fFound);
+        if (fFound && it != info.mSpentInfo.end()) {
+            BOOST_CHECK(it->second.txid == value.txid);
+            BOOST_CHECK_EQUAL(it->second.inputIndex, value.inputIndex);
+            BOOST_CHECK_EQUAL(it->second.satoshis, value.satoshis);
+        }
+    }
+
+    for (auto& entry : entries) {
+        entry.second.SetNull();
+    }
+    BOOST_REQUIRE(pblocktree->UpdateSpentIndex(entries));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
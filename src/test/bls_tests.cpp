@@ -4,6 +4,8 @@
 
 #include <bls/bls.h>
 #include <bls/bls_batchverifier.h>
+#include <bls/bls_sigcache.h>
+#include <bls/bls_worker.h>
 #include <test/test_dash.h>
 
 #include <boost/test/unit_test.hpp>
@@ -154,4 +156,124 @@ BOOST_AUTO_TEST_CASE(batch_verifier_tests)
     Verify(msgs);
 }
 
+BOOST_AUTO_TEST_CASE(bls_sigcache_tests)
+{
+    CBLSSecretKey sk1, sk2;
+    sk1.MakeNewKey();
+    sk2.MakeNewKey();
+    uint256 msgHash1 = GetRandHash();
+    uint256 msgHash2 = GetRandHash();
+    CBLSSignature sig1 = sk1.Sign(msgHash1);
+    CBLSSignature sig2 = sk2.Sign(msgHash1);
+
+    BOOST_CHECK(!BLSSignatureCacheContains(sk1.GetPublicKey(), msgHash1, sig1));
+    BOOST_CHECK(BLSCachedVerifyInsecure(sig1, sk1.GetPublicKey(), msgHash1));
+    BOOST_CHECK(BLSSignatureCacheContains(sk1.GetPublicKey(), msgHash1, sig1));
+
+    // invalid signatures are never cached
+    BOOST_CHECK(!BLSCachedVerifyInsecure(sig1, sk1.GetPublicKey(), msgHash2));
+    BOOST_CHECK(!BLSCachedVerifyInsecure(sig1, sk2.GetPublicKey(), msgHash1));
+    BOOST_CHECK(!BLSSignatureCacheContains(sk1.GetPublicKey(), msgHash2, sig1));
+    BOOST_CHECK(!BLSSignatureCacheContains(sk2.GetPublicKey(), msgHash1, sig1));
+
+    // secure aggregations are cached for the set of public keys they were verified with
+    BLSPublicKeyVector pubKeys{sk1.GetPublicKey(), sk2.GetPublicKey()};
+    CBLSSignature aggSig = CBLSSignature::AggregateSecure({sig1, sig2}, pubKeys, msgHash1);
+    BOOST_CHECK(!BLSCachedVerifySecureAggregated(aggSig, {sk1.GetPublicKey()}, msgHash1));
+    BOOST_CHECK(BLSCachedVerifySecureAggregated(aggSig, pubKeys, msgHash1));
+    auto stats = GetBLSSignatureCacheStats();
+    BOOST_CHECK(BLSCachedVerifySecureAggregated(aggSig, pubKeys, msgHash1));
+    BOOST_CHECK_EQUAL(GetBLSSignatureCacheStats().nHits, stats.nHits + 1);
+
+    // messages of valid batches are cached and skipped by later batches
+    CBLSBatchVerifier<int, int> batchVerifier(false, true);
+    batchVerifier.PushMessage(1, 1, msgHash1, sig2, sk2.GetPublicKey());
+    batchVerifier.Verify();
+    BOOST_CHECK(batchVerifier.badMessages.empty());
+    BOOST_CHECK(BLSSignatureCacheContains(sk2.GetPublicKey(), msgHash1, sig2));
+
+    CBLSBatchVerifier<int, int> batchVerifier2(false, true);
+    batchVerifier2.PushMessage(1, 1, msgHash1, sig2, sk2.GetPublicKey());
+    batchVerifier2.PushMessage(2, 2, msgHash2, sig1, sk1.GetPublicKey());
+    batchVerifier2.Verify();
+    BOOST_CHECK(batchVerifier2.badSources == std::set<int>{2});
+    BOOST_CHECK(batchVerifier2.badMessages == std::set<int>{2});
+}
+
+BOOST_AUTO_TEST_CASE(randomized_batch_verification_tests)
+{
+    CBLSWorker worker;
+    worker.Start(2);
+
+    std::vector<Message> msgs;
+    for (uint32_t i = 0; i < 40; i++) {
+        // every 4 messages share a message hash, and a few invalid ones are spread over the whole range
+        AddMessage(msgs, i, i, i / 4, i % 13 != 5);
+    }
+
+    // two invalid signatures which cancel each other out when aggregated without randomization
+    CBLSSecretKey tmp;
+    tmp.MakeNewKey();
+    CBLSSignature offset = tmp.Sign(uint256());
+    msgs[20].sig.AggregateInsecure(offset);
+    msgs[20].valid = false;
+    msgs[30].sig.SubInsecure(offset);
+    msgs[30].valid = false;
+
+    BLSSignatureVector sigs;
+    BLSPublicKeyVector pubKeys;
+    std::vector<uint256> msgHashes;
+    for (const auto& m : msgs) {
+        sigs.emplace_back(m.sig);
+        pubKeys.emplace_back(m.pk);
+        msgHashes.emplace_back(m.msgHash);
+    }
+
+    for (bool parallel : {false, true}) {
+        auto result = worker.VerifySignatures(sigs, pubKeys, msgHashes, parallel);
+        BOOST_REQUIRE_EQUAL(result.size(), msgs.size());
+        for (size_t i = 0; i < msgs.size(); i++) {
+            BOOST_CHECK_EQUAL(result[i], msgs[i].valid);
+        }
+    }
+
+    // all valid
+    std::vector<bool> expected(4, true);
+    sigs.resize(4);
+    pubKeys.resize(4);
+    msgHashes.resize(4);
+    BOOST_CHECK(worker.VerifySignatures(sigs, pubKeys, msgHashes) == expected);
+
+    worker.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(decrypt_contribution_shares_tests)
+{
+    CBLSWorker worker;
+    worker.Start(2);
+
+    CBLSSecretKey sk;
+    sk.MakeNewKey();
+
+    // the shares of member 3 as sent in QDATA, the one at index 5 is truncated
+    BLSSecretKeyVector shares(10);
+    std::vector<CBLSIESEncryptedObject<CBLSSecretKey>> encryptedShares(shares.size());
+    for (size_t i = 0; i < shares.size(); i++) {
+        shares[i].MakeNewKey();
+        BOOST_REQUIRE(encryptedShares[i].Encrypt(3, sk.GetPublicKey(), shares[i], PROTOCOL_VERSION));
+    }
+    encryptedShares[5].data.resize(16);
+
+    auto decrypted = worker.DecryptContributionShares(encryptedShares, 3, sk);
+    BOOST_REQUIRE_EQUAL(decrypted.size(), shares.size());
+    for (size_t i = 0; i < shares.size(); i++) {
+        BOOST_CHECK_EQUAL(decrypted[i].IsValid(), i != 5);
+        if (i != 5) {
+            BOOST_CHECK(decrypted[i] == shares[i]);
+        }
+    }
+
+    worker.Stop();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,73 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinjoin/coinjoin.h>
+#include <timedata.h>
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(coinjoin_queue_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(queue_set_lookup)
+{
+    CCoinJoinQueueSet queues;
+    int64_t nNow = GetAdjustedTime();
+    COutPoint mn1(InsecureRand256(), 0);
+    COutPoint mn1b(mn1.hash, 1);
+    COutPoint mn2(InsecureRand256(), 0);
+
+    CCoinJoinQueue dsq1(1, mn1, nNow, false);
+    BOOST_CHECK(queues.Add(dsq1));
+    BOOST_CHECK(!queues.Add(dsq1));
+    BOOST_CHECK(queues.Has(dsq1.GetSignatureHash()));
+    BOOST_CHECK(queues.Add(CCoinJoinQueue(2, mn1, nNow, true)));
+    BOOST_CHECK(queues.Add(CCoinJoinQueue(1, mn2, nNow, false)));
+    BOOST_CHECK_EQUAL(queues.size(), 3U);
+
+    BOOST_CHECK(queues.HasFromMasternode(mn1, 1));
+    BOOST_CHECK(queues.HasFromMasternode(mn1, 1, false));
+    BOOST_CHECK(!queues.HasFromMasternode(mn1, 1, true));
+    BOOST_CHECK(queues.HasFromMasternode(mn1, 2, true));
+    // another output of the same collateral transaction is another masternode
+    BOOST_CHECK(!queues.HasFromMasternode(mn1b, 1));
+
+    queues.RemoveFromMasternode(mn1, 1);
+    BOOST_CHECK(!queues.HasFromMasternode(mn1, 1));
+    BOOST_CHECK(queues.HasFromMasternode(mn1, 2));
+    BOOST_CHECK(queues.HasFromMasternode(mn2, 1));
+    BOOST_CHECK_EQUAL(queues.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(queue_set_expiry_and_try)
+{
+    CCoinJoinQueueSet queues;
+    int64_t nNow = GetAdjustedTime();
+    CCoinJoinQueue dsqOld(1, COutPoint(InsecureRand256(), 0), nNow - COINJOIN_QUEUE_TIMEOUT - 1, false);
+    CCoinJoinQueue dsqFuture(1, COutPoint(InsecureRand256(), 0), nNow + COINJOIN_QUEUE_TIMEOUT + 1, false);
+    CCoinJoinQueue dsq1(1, COutPoint(InsecureRand256(), 0), nNow - 1, false);
+    CCoinJoinQueue dsq2(2, COutPoint(InsecureRand256(), 0), nNow - 2, false);
+    BOOST_CHECK(queues.Add(dsqOld));
+    BOOST_CHECK(queues.Add(dsq1));
+    BOOST_CHECK(queues.Add(dsqFuture));
+    BOOST_CHECK(queues.Add(dsq2));
+
+    // queues are tried in the order they arrived, skipping the ones out of bounds
+    CCoinJoinQueue dsqRet;
+    BOOST_CHECK(queues.TryNext(dsqRet));
+    BOOST_CHECK(dsqRet == dsq1);
+    BOOST_CHECK(dsqRet.fTried);
+    BOOST_CHECK(queues.TryNext(dsqRet));
+    BOOST_CHECK(dsqRet == dsq2);
+    BOOST_CHECK(!queues.TryNext(dsqRet));
+
+    queues.RemoveExpired(nNow);
+    BOOST_CHECK_EQUAL(queues.size(), 2U);
+    BOOST_CHECK(!queues.Has(dsqOld.GetSignatureHash()));
+    BOOST_CHECK(!queues.Has(dsqFuture.GetSignatureHash()));
+    BOOST_CHECK(queues.Has(dsq1.GetSignatureHash()));
+    BOOST_CHECK(queues.Has(dsq2.GetSignatureHash()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include <undo.h>
 #include <utilstrencodings.h>
 #include <test/test_dash.h>
+#include <txdb.h>
 #include <validation.h>
 #include <consensus/validation.h>
 
@@ -586,7 +587,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), &resource);
     InsertCoinsMapEntry(map, value, flags);
     view.BatchWrite(map, {});
 }
@@ -855,4 +857,184 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_prefetch)
+{
+    CCoinsViewTest base;
+    std::vector<COutPoint> outpoints;
+    {
+        CCoinsViewCacheTest cache(&base);
+        for (int i = 0; i < 200; i++) {
+            COutPoint outpoint(InsecureRand256(), i);
+            outpoints.push_back(outpoint);
+            if (i % 4 == 0) {
+                // Leave some of the outpoints out of the base view
+                continue;
+            }
+            Coin coin;
+            coin.out.nValue = i + 1;
+            coin.nHeight = i;
+            cache.AddCoin(outpoint, std::move(coin), false);
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    CCoinsViewCacheTest cache(&base);
+    BOOST_CHECK_EQUAL(cache.PrefetchCoins(outpoints, 4), 150);
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 150);
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        BOOST_CHECK_EQUAL(cache.HaveCoinInCache(outpoints[i]), i % 4 != 0);
+        if (i % 4 != 0) {
+            BOOST_CHECK_EQUAL(cache.AccessCoin(outpoints[i]).out.nValue, (CAmount)i + 1);
+        }
+    }
+
+    // Everything that exists is cached now, so nothing is fetched again
+    BOOST_CHECK_EQUAL(cache.PrefetchCoins(outpoints, 4), 0);
+    BOOST_CHECK_EQUAL(cache.PrefetchCoins({}, 4), 0);
+
+    // Flushing hands the memory of the cache back in one go
+    const size_t nChunkSize = CCoinsMapMemoryResource().ChunkSizeBytes();
+    BOOST_CHECK(cache.DynamicMemoryUsage() > nChunkSize);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0);
+    BOOST_CHECK(cache.DynamicMemoryUsage() < nChunkSize);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_async_db_write)
+{
+    CCoinsViewDB db(1 << 20, true);
+    db.SetAsyncWrite(true);
+
+    std::vector<COutPoint> outpoints;
+    uint256 hashBlock = InsecureRand256();
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < 100; i++) {
+            COutPoint outpoint(InsecureRand256(), i);
+            outpoints.push_back(outpoint);
+            Coin coin;
+            coin.out.nValue = i + 1;
+            coin.nHeight = i;
+            cache.AddCoin(outpoint, std::move(coin), false);
+        }
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // The coins are visible no matter whether the background write finished yet
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    for (size_t i = 0; i < outpoints.size(); i++) {
+        Coin coin;
+        BOOST_CHECK(db.GetCoin(outpoints[i], coin));
+        BOOST_CHECK_EQUAL(coin.out.nValue, (CAmount)i + 1);
+    }
+
+    BOOST_CHECK(db.WaitForWrite());
+    BOOST_CHECK_EQUAL(db.PendingMemoryUsage(), 0);
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.HaveCoin(outpoints[0]));
+
+    // Spending through a second flush is visible as well
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(!db.HaveCoin(outpoints[0]));
+    BOOST_CHECK(db.WaitForWrite());
+    BOOST_CHECK(!db.HaveCoin(outpoints[0]));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_prefetch_cache)
+{
+    CCoinsViewTest base;
+    CCoinsPrefetchCache prefetch(100);
+    COutPoint outpoint(InsecureRand256(), 0);
+    Coin coin;
+    coin.out.nValue = 42;
+    coin.nHeight = 1;
+
+    // Coins read before the cache was cleared are dropped
+    uint64_t nGeneration = prefetch.GetGeneration();
+    prefetch.Clear();
+    std::vector<std::pair<COutPoint, Coin>> vCoins;
+    vCoins.emplace_back(outpoint, coin);
+    prefetch.Add(std::move(vCoins), nGeneration);
+    BOOST_CHECK_EQUAL(prefetch.Size(), 0);
+
+    vCoins.clear();
+    vCoins.emplace_back(outpoint, coin);
+    prefetch.Add(std::move(vCoins), prefetch.GetGeneration());
+    BOOST_CHECK_EQUAL(prefetch.Size(), 1);
+
+    // A miss in the cache view is served from the prefetch cache, which hands the coin over
+    CCoinsViewCacheTest cache(&base);
+    cache.SetPrefetchCache(&prefetch);
+    BOOST_CHECK(cache.HaveCoin(outpoint));
+    BOOST_CHECK_EQUAL(cache.AccessCoin(outpoint).out.nValue, 42);
+    BOOST_CHECK_EQUAL(prefetch.Size(), 0);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(compact_undo_serialization)
+{
+    const int nHeight = 1000;
+    std::vector<CScript> vScripts;
+    for (int i = 0; i < 4; i++) {
+        vScripts.push_back(GetScriptForDestination(CKeyID(Hash160(ToByteVector(InsecureRand256())))));
+    }
+    vScripts.push_back(CScript() << OP_RETURN << ToByteVector(InsecureRand256()));
+
+    CBlockUndo blockundo;
+    for (int i = 0; i < 20; i++) {
+        CTxUndo txundo;
+        for (int j = 0, n = 1 + InsecureRandRange(5); j < n; j++) {
+            Coin coin;
+            coin.out.nValue = InsecureRandRange(100 * COIN);
+            coin.out.scriptPubKey = vScripts[InsecureRandRange(vScripts.size())];
+            coin.nHeight = InsecureRandRange(nHeight + 1);
+            coin.fCoinBase = InsecureRandBool();
+            txundo.vprevout.push_back(coin);
+        }
+        blockundo.vtxundo.push_back(txundo);
+    }
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << CompactBlockUndoSerializer(&blockundo, nHeight);
+    // Scripts are only stored once, so the compact format is smaller than the original one
+    BOOST_CHECK_LT(ss.size(), ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION));
+
+    CBlockUndo blockundo2;
+    CDataStream ss2(ss);
+    ss2 >> CompactBlockUndoDeserializer(&blockundo2, nHeight);
+    BOOST_CHECK(ss2.empty());
+    BOOST_CHECK_EQUAL(blockundo2.vtxundo.size(), blockundo.vtxundo.size());
+    for (size_t i = 0; i < blockundo.vtxundo.size(); i++) {
+        const auto& vprevout = blockundo.vtxundo[i].vprevout;
+        const auto& vprevout2 = blockundo2.vtxundo[i].vprevout;
+        BOOST_CHECK_EQUAL(vprevout2.size(), vprevout.size());
+        for (size_t j = 0; j < vprevout.size() && j < vprevout2.size(); j++) {
+            BOOST_CHECK(vprevout2[j].out == vprevout[j].out);
+            BOOST_CHECK_EQUAL(vprevout2[j].nHeight, vprevout[j].nHeight);
+            BOOST_CHECK_EQUAL(vprevout2[j].fCoinBase, vprevout[j].fCoinBase);
+        }
+    }
+
+    // Heights are relative to the block, which can only spend earlier coins
+    BOOST_CHECK_THROW(ss << CompactBlockUndoSerializer(&blockundo, 10), std::ios_base::failure);
+
+    // A reference to a script that wasn't stored yet
+    CDataStream ss3(SER_DISK, CLIENT_VERSION);
+    WriteCompactSize(ss3, 1);
+    WriteCompactSize(ss3, 1);
+    uint64_t nCode = 0, nScriptRef = 1, nAmount = 0;
+    ss3 << VARINT(nCode) << VARINT(nScriptRef) << VARINT(nAmount);
+    CBlockUndo blockundo3;
+    BOOST_CHECK_THROW(ss3 >> CompactBlockUndoDeserializer(&blockundo3, nHeight), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <index/coinstatsindex.h>
+#include <key.h>
+#include <node/coinstats.h>
+#include <script/interpreter.h>
+#include <test/test_dash.h>
+#include <txdb.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
+
+/** The index has the same statistics for the tip as a scan of the coin database */
+static void CheckTipStats(const CoinStatsIndex& coin_stats_index)
+{
+    FlushStateToDisk();
+    CCoinsStats stats_scan;
+    BOOST_REQUIRE(GetUTXOStatsParallel(pcoinsdbview.get(), stats_scan, true));
+
+    CCoinsStats stats_serial;
+    BOOST_REQUIRE(GetUTXOStats(pcoinsdbview.get(), stats_serial));
+    BOOST_CHECK_EQUAL(stats_scan.nTransactions, stats_serial.nTransactions);
+    BOOST_CHECK_EQUAL(stats_scan.nTransactionOutputs, stats_serial.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(stats_scan.nBogoSize, stats_serial.nBogoSize);
+    BOOST_CHECK_EQUAL(stats_scan.nTotalAmount, stats_serial.nTotalAmount);
+
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    BOOST_CHECK(stats_scan.hashBlock == tip->GetBlockHash());
+
+    CCoinsStats stats_index;
+    BOOST_REQUIRE(coin_stats_index.LookupStats(tip, stats_index));
+    BOOST_CHECK_EQUAL(stats_index.nHeight, tip->nHeight);
+    BOOST_CHECK(stats_index.hashMuHash == stats_scan.hashMuHash);
+    BOOST_CHECK_EQUAL(stats_index.nTransactionOutputs, stats_scan.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(stats_index.nBogoSize, stats_scan.nBogoSize);
+    BOOST_CHECK_EQUAL(stats_index.nTotalAmount, stats_scan.nTotalAmount);
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_initial_sync, TestChain100Setup)
+{
+    CoinStatsIndex coin_stats_index(1 << 20, true, true);
+
+    const CBlockIndex* tip;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+    }
+    CCoinsStats stats;
+    BOOST_CHECK(!coin_stats_index.LookupStats(tip, stats));
+
+    BOOST_REQUIRE(coin_stats_index.Sync());
+    BOOST_CHECK(coin_stats_index.IsSynced());
+    CheckTipStats(coin_stats_index);
+
+    // Every block of the chain can be looked up, the totals only grow as nothing but coinbases were mined
+    CCoinsStats prev_stats;
+    {
+        LOCK(cs_main);
+        for (const CBlockIndex* block_index = chainActive.Genesis(); block_index; block_index = chainActive.Next(block_index)) {
+            BOOST_REQUIRE(coin_stats_index.LookupStats(block_index, stats));
+            BOOST_CHECK(stats.hashBlock == block_index->GetBlockHash());
+            BOOST_CHECK(block_index->nHeight == 0 || stats.nTotalAmount > prev_stats.nTotalAmount);
+            prev_stats = stats;
+        }
+    }
+
+    // Spend a coinbase, so the index has to remove coins as well
+    const CScript coinbase_script = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction tx;
+    tx.nVersion = 1;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = coinbaseTxns[0].vout[0].nValue - 1000;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    std::vector<unsigned char> vchSig;
+    const uint256 sighash = SignatureHash(coinbase_script, tx, 0, SIGHASH_ALL, 0, SigVersion::BASE);
+    BOOST_REQUIRE(coinbaseKey.Sign(sighash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+    CreateAndProcessBlock({tx}, coinbase_script);
+    SyncWithValidationInterfaceQueue();
+    BOOST_REQUIRE(coin_stats_index.Sync());
+    CheckTipStats(coin_stats_index);
+
+    // Disconnect the last 3 blocks and build a competing chain of 4 blocks with a different coinbase script
+    std::vector<const CBlockIndex*> stale_blocks;
+    {
+        LOCK(cs_main);
+        tip = chainActive.Tip();
+        CBlockIndex* fork = chainActive[tip->nHeight - 3];
+        for (const CBlockIndex* pindex = tip; pindex != fork; pindex = pindex->pprev) {
+            stale_blocks.emplace_back(pindex);
+        }
+        CValidationState state;
+        BOOST_REQUIRE(InvalidateBlock(state, Params(), chainActive[fork->nHeight + 1]));
+    }
+    CScript other_script = CScript() << OP_TRUE;
+    for (int i = 0; i < 4; i++) {
+        CreateAndProcessBlock({}, other_script);
+    }
+    SyncWithValidationInterfaceQueue();
+
+    // The disconnected blocks are reverted and no longer served
+    BOOST_REQUIRE(coin_stats_index.Sync());
+    for (const CBlockIndex* pindex : stale_blocks) {
+        BOOST_CHECK(!coin_stats_index.LookupStats(pindex, stats));
+    }
+    CheckTipStats(coin_stats_index);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
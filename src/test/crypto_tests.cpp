@@ -12,10 +12,13 @@
 #include <crypto/sha512.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <crypto/muhash.h>
 #include <random.h>
+#include <streams.h>
 #include <utilstrencodings.h>
 #include <test/test_dash.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -661,6 +664,54 @@ BOOST_AUTO_TEST_CASE(poly1305_testvector)
                  "13000000000000000000000000000000");
 }
 
+BOOST_AUTO_TEST_CASE(chacha20_poly1305_multiblock)
+{
+    // Long inputs are processed 4 or 8 blocks at a time by the vectorized implementations, the results have to match
+    // those of the single block code, which is used for inputs of one block
+    std::vector<unsigned char> key(32);
+    for (int i = 0; i < 32; i++) {
+        key[i] = 0x80 + i;
+    }
+    std::vector<unsigned char> m(1000);
+    for (size_t i = 0; i < m.size(); i++) {
+        m[i] = (i * 7) & 0xff;
+    }
+
+    for (uint64_t seek : {(uint64_t)0, (uint64_t)0xfffffffa, (uint64_t)0xfffffffffffffff8}) {
+        for (size_t len : {64, 256, 512, 960, 1000}) {
+            ChaCha20 multi(key.data(), key.size());
+            multi.SetIV(0x0706050403020100ULL);
+            multi.Seek(seek);
+            ChaCha20 single = multi;
+
+            std::vector<unsigned char> out_multi(len), out_single(len);
+            multi.Crypt(m.data(), out_multi.data(), len);
+            for (size_t pos = 0; pos < len; pos += 64) {
+                single.Crypt(m.data() + pos, out_single.data() + pos, std::min<size_t>(64, len - pos));
+            }
+            BOOST_CHECK(out_multi == out_single);
+
+            // both continue at the same block
+            multi.Keystream(out_multi.data(), len);
+            for (size_t pos = 0; pos < len; pos += 64) {
+                single.Keystream(out_single.data() + pos, std::min<size_t>(64, len - pos));
+            }
+            BOOST_CHECK(out_multi == out_single);
+        }
+    }
+
+    unsigned char tag[POLY1305_TAGLEN];
+    poly1305_auth(tag, m.data(), 256, key.data());
+    BOOST_CHECK_EQUAL(HexStr(tag, tag + sizeof(tag)), "41c6408e09eaa01d4767c172ab706636");
+    poly1305_auth(tag, m.data(), 1000, key.data());
+    BOOST_CHECK_EQUAL(HexStr(tag, tag + sizeof(tag)), "2b6c89f2f82b8f89bcff581fdfcace4a");
+    // all limbs at their maximum
+    std::fill(m.begin(), m.end(), 0xff);
+    std::fill(key.begin(), key.end(), 0xff);
+    poly1305_auth(tag, m.data(), 1000, key.data());
+    BOOST_CHECK_EQUAL(HexStr(tag, tag + sizeof(tag)), "de9406b10e7023bcd692ff687f4cbc7f");
+}
+
 static void TestChaCha20Poly1305AEAD(bool must_succeed, unsigned int expected_aad_length, const std::string& hex_m, const std::string& hex_k1, const std::string& hex_k2, const std::string& hex_aad_keystream, const std::string& hex_encrypted_message, const std::string& hex_encrypted_message_seq_999)
 {
     // we need two sequence numbers, one for the payload cipher instance...
@@ -824,4 +875,114 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(sha256dmulti)
+{
+    for (int i = 0; i <= 40; ++i) {
+        // lengths around the padding boundaries and a few long messages, which end up alone in the lanes
+        std::vector<std::vector<unsigned char>> msgs(i);
+        std::vector<const unsigned char*> inputs;
+        std::vector<size_t> lengths;
+        for (auto& msg : msgs) {
+            msg.resize(InsecureRandBool() ? InsecureRandRange(130) : InsecureRandRange(3000));
+            for (auto& c : msg) {
+                c = InsecureRandBits(8);
+            }
+            inputs.emplace_back(msg.data());
+            lengths.emplace_back(msg.size());
+        }
+        std::vector<unsigned char> out1(32 * i), out2(32 * i);
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(msgs[j].data(), msgs[j].size()).Finalize(out1.data() + 32 * j);
+        }
+        SHA256DMulti(out2.data(), inputs.data(), lengths.data(), i);
+        BOOST_CHECK(out1 == out2);
+
+        CHash256Batch batch;
+        for (const auto& msg : msgs) {
+            batch.Add(msg);
+        }
+        auto hashes = batch.Finalize();
+        BOOST_REQUIRE_EQUAL(hashes.size(), msgs.size());
+        for (int j = 0; j < i; ++j) {
+            BOOST_CHECK(hashes[j] == SerializeHash(msgs[j]));
+        }
+    }
+}
+
+static MuHash3072 FromInt(unsigned char i) {
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(tmp, sizeof(tmp));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 out;
+
+    for (int iter = 0; iter < 10; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = InsecureRandBits(3);
+        }
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= FromInt(t & 3);
+                } else {
+                    acc *= FromInt(t & 3);
+                }
+            }
+            acc.Finalize(out);
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+
+        MuHash3072 x = FromInt(InsecureRandBits(4)); // x=X
+        MuHash3072 y = FromInt(InsecureRandBits(4)); // x=X, y=Y
+        MuHash3072 z; // x=X, y=Y, z=1
+        z *= x; // x=X, y=Y, z=X
+        z *= y; // x=X, y=Y, z=X*Y
+        y *= x; // x=X, y=Y*X, z=X*Y
+        z /= y; // x=X, y=Y*X, z=1
+        z.Finalize(out);
+
+        uint256 out2;
+        MuHash3072 a;
+        a.Finalize(out2);
+
+        BOOST_CHECK(out == out2);
+    }
+
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    acc.Finalize(out);
+    BOOST_CHECK(out == uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+
+    MuHash3072 acc2 = FromInt(0);
+    unsigned char tmp[32] = {1, 0};
+    acc2.Insert(tmp, sizeof(tmp));
+    unsigned char tmp2[32] = {2, 0};
+    acc2.Remove(tmp2, sizeof(tmp2));
+    acc2.Finalize(out);
+    BOOST_CHECK(out == uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+
+    // Serialization keeps numerator and denominator
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    MuHash3072 acc3 = FromInt(0);
+    acc3 *= FromInt(1);
+    acc3 /= FromInt(2);
+    ss << acc3;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 acc4;
+    ss >> acc4;
+    acc4.Finalize(out);
+    BOOST_CHECK(out == uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
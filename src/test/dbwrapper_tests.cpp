@@ -79,6 +79,48 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+// Test that a transaction committed without clearing stays readable until it's cleared
+BOOST_AUTO_TEST_CASE(dbwrapper_transaction_commit_without_clear)
+{
+    fs::path ph = SetDataDir("dbwrapper_transaction_commit_without_clear");
+    CDBWrapper dbw(ph, (1 << 20), true, false, false);
+
+    typedef CDBTransaction<CDBWrapper, CDBBatch> Transaction1;
+    typedef CDBTransaction<Transaction1, Transaction1> Transaction2;
+
+    char key = 'i';
+    uint256 in = InsecureRand256();
+    char key2 = 'j';
+    uint256 in2 = InsecureRand256();
+    uint256 res;
+
+    BOOST_CHECK(dbw.Write(key2, in2));
+
+    CDBBatch batch(dbw);
+    Transaction1 tx1(dbw, batch);
+    Transaction2 tx2(tx1, tx1);
+
+    tx2.Write(key, in);
+    tx2.Erase(key2);
+    tx2.Commit();
+    BOOST_CHECK(tx2.IsClean());
+
+    tx1.CommitWithoutClear();
+    BOOST_CHECK(!tx1.IsClean());
+    // nothing is on disk before the batch is written, but the transaction still knows about everything in it
+    BOOST_CHECK(!dbw.Read(key, res));
+    BOOST_CHECK(tx2.Read(key, res));
+    BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+    BOOST_CHECK(!tx2.Read(key2, res));
+
+    BOOST_CHECK(dbw.WriteBatch(batch));
+    tx1.Clear();
+    BOOST_CHECK(tx2.Read(key, res));
+    BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+    BOOST_CHECK(!tx2.Read(key2, res));
+    BOOST_CHECK(!dbw.Exists(key2));
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     // Perform tests both obfuscated and non-obfuscated.
@@ -120,6 +162,112 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 }
 
 // Test that we do not obfuscation if there is existing data.
+BOOST_AUTO_TEST_CASE(dbwrapper_snapshot)
+{
+    fs::path ph = SetDataDir(std::string("dbwrapper_snapshot"));
+    CDBWrapper dbw(ph, (1 << 20), true, false, true);
+
+    char key = 'j';
+    uint256 in = InsecureRand256();
+    BOOST_CHECK(dbw.Write(key, in));
+
+    const CDBSnapshot snapshot(dbw);
+
+    // Changes after the snapshot was taken are not visible through it
+    uint256 in2 = InsecureRand256();
+    BOOST_CHECK(dbw.Write(key, in2));
+    char key2 = 'k';
+    BOOST_CHECK(dbw.Write(key2, in2));
+
+    std::unique_ptr<CDBIterator> it(dbw.NewIterator(snapshot));
+    it->Seek(key);
+    char key_res;
+    uint256 val_res;
+    BOOST_REQUIRE(it->Valid());
+    BOOST_CHECK(it->GetKey(key_res) && it->GetValue(val_res));
+    BOOST_CHECK_EQUAL(key_res, key);
+    BOOST_CHECK_EQUAL(val_res.ToString(), in.ToString());
+    it->Next();
+    BOOST_CHECK(!it->Valid());
+
+    // ...but they are without the snapshot
+    it.reset(dbw.NewIterator());
+    it->Seek(key);
+    BOOST_CHECK(it->GetValue(val_res));
+    BOOST_CHECK_EQUAL(val_res.ToString(), in2.ToString());
+    it->Next();
+    BOOST_CHECK(it->Valid());
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_readmulti)
+{
+    fs::path ph = SetDataDir("dbwrapper_readmulti");
+    CDBWrapper dbw(ph, (1 << 20), true, false, true);
+    for (uint32_t i = 0; i < 100; i += 2) {
+        BOOST_CHECK(dbw.Write(std::make_pair('k', i), i * 3));
+    }
+    BOOST_CHECK(dbw.Write('z', std::string("not a number")));
+
+    // Unsorted, with duplicates, misses in between and past the last entry
+    std::vector<std::pair<char, uint32_t>> keys = {{'k', 50}, {'k', 3}, {'k', 98}, {'k', 50}, {'k', 0}, {'k', 99}, {'l', 1}};
+    std::vector<uint32_t> values;
+    std::vector<bool> found;
+    BOOST_CHECK_EQUAL(dbw.ReadMulti(keys, values, found), 5U);
+    BOOST_CHECK_EQUAL(values.size(), keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        uint32_t value;
+        BOOST_CHECK_EQUAL(found[i], dbw.Read(keys[i], value));
+        if (found[i]) {
+            BOOST_CHECK_EQUAL(values[i], value);
+        }
+    }
+
+    // Values that don't deserialize count as missing, like with Read()
+    std::vector<char> badKeys = {'z'};
+    std::vector<std::vector<uint256>> badValues;
+    BOOST_CHECK_EQUAL(dbw.ReadMulti(badKeys, badValues, found), 0U);
+    BOOST_CHECK(!found[0]);
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_tuning)
+{
+    std::string strError;
+    CDBTuning tuning;
+    BOOST_CHECK(ParseDBTuning("evodb:blocksize=32,compression=0,writebuffer=10,maxfilesize=4,bloombits=0", "evodb", tuning, strError));
+    BOOST_CHECK_EQUAL(tuning.nBlockSize, 32U * 1024);
+    BOOST_CHECK(!tuning.fCompression);
+    BOOST_CHECK_EQUAL(tuning.nWriteBufferPercent, 10);
+    BOOST_CHECK_EQUAL(tuning.nMaxFileSize, 4U * 1024 * 1024);
+    BOOST_CHECK_EQUAL(tuning.nBloomBits, 0);
+
+    // Arguments for other databases are checked, but not applied
+    CDBTuning other;
+    BOOST_CHECK(ParseDBTuning("evodb:blocksize=32", "chainstate", other, strError));
+    BOOST_CHECK_EQUAL(other.nBlockSize, CDBTuning().nBlockSize);
+    BOOST_CHECK(!ParseDBTuning("evodb:blocksize=0", "chainstate", other, strError));
+    BOOST_CHECK(!ParseDBTuning("evodb:writebuffer=50", "evodb", other, strError));
+    BOOST_CHECK(!ParseDBTuning("evodb:unknown=1", "evodb", other, strError));
+    BOOST_CHECK(!ParseDBTuning("evodb:blocksize", "evodb", other, strError));
+    BOOST_CHECK(!ParseDBTuning("blocksize=4", "evodb", other, strError));
+    // Nothing is applied if any setting is invalid
+    BOOST_CHECK(!ParseDBTuning("evodb:blocksize=8,bloombits=99", "evodb", other, strError));
+    BOOST_CHECK_EQUAL(other.nBlockSize, CDBTuning().nBlockSize);
+
+    // Workload defaults
+    BOOST_CHECK(GetDBTuning("evodb").fCompression);
+    BOOST_CHECK_EQUAL(GetDBTuning("index").nBlockSize, 16U * 1024);
+    BOOST_CHECK_EQUAL(GetDBTuning("chainstate").nBloomBits, 10);
+
+    // A database opened with a custom tuning works as usual
+    fs::path ph = SetDataDir("dbwrapper_tuning");
+    CDBWrapper dbw(ph, (1 << 20), true, false, false, tuning);
+    uint256 in = InsecureRand256();
+    uint256 res;
+    BOOST_CHECK(dbw.Write('k', in));
+    BOOST_CHECK(dbw.Read('k', res));
+    BOOST_CHECK(res == in);
+}
+
 BOOST_AUTO_TEST_CASE(existing_data_no_obfuscate)
 {
     // We're going to share this fs::path between two wrappers
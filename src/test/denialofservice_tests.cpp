@@ -11,6 +11,7 @@
 #include <pow.h>
 #include <script/sign.h>
 #include <serialize.h>
+#include <txorphanage.h>
 #include <util.h>
 #include <validation.h>
 
@@ -24,15 +25,11 @@
 extern bool AddOrphanTx(const CTransactionRef& tx, NodeId peer);
 extern void EraseOrphansFor(NodeId peer);
 extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
+extern int GetAdaptiveBlockDownloadWindow(int64_t nBytesPerSecond, int64_t nAvgBlockBytes, int64_t nPingMicros);
 // We don't need this, since we kept declaration in net_processing.h when backporting (#13417)
 // extern void Misbehaving(NodeId nodeid, int howmuch, const std::string& message="");
 
-struct COrphanTx {
-    CTransactionRef tx;
-    NodeId fromPeer;
-    int64_t nTimeExpire;
-};
-extern std::map<uint256, COrphanTx> mapOrphanTransactions;
+extern CTxOrphanage g_orphanage;
 
 CService ip(uint32_t i)
 {
@@ -323,14 +320,9 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
     peerLogic->FinalizeNode(dummyNode.GetId(), dummy);
 }
 
-CTransactionRef RandomOrphan()
+CTransactionRef RandomOrphan(const std::vector<CTransactionRef>& vecAdded)
 {
-    std::map<uint256, COrphanTx>::iterator it;
-    LOCK(cs_main);
-    it = mapOrphanTransactions.lower_bound(InsecureRand256());
-    if (it == mapOrphanTransactions.end())
-        it = mapOrphanTransactions.begin();
-    return it->second.tx;
+    return vecAdded[InsecureRandRange(vecAdded.size())];
 }
 
 BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
@@ -339,6 +331,7 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     key.MakeNewKey(true);
     CBasicKeyStore keystore;
     keystore.AddKey(key);
+    std::vector<CTransactionRef> vecAdded;
 
     // 50 orphan transactions:
     for (int i = 0; i < 50; i++)
@@ -352,13 +345,14 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         tx.vout[0].nValue = 1*CENT;
         tx.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
 
-        AddOrphanTx(MakeTransactionRef(tx), i);
+        vecAdded.emplace_back(MakeTransactionRef(tx));
+        BOOST_CHECK(AddOrphanTx(vecAdded.back(), i));
     }
 
     // ... and 50 that depend on other orphans:
     for (int i = 0; i < 50; i++)
     {
-        CTransactionRef txPrev = RandomOrphan();
+        CTransactionRef txPrev = RandomOrphan(vecAdded);
 
         CMutableTransaction tx;
         tx.vin.resize(1);
@@ -369,13 +363,16 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         tx.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
         SignSignature(keystore, *txPrev, tx, 0, SIGHASH_ALL);
 
-        AddOrphanTx(MakeTransactionRef(tx), i);
+        vecAdded.emplace_back(MakeTransactionRef(tx));
+        BOOST_CHECK(AddOrphanTx(vecAdded.back(), i));
     }
+    BOOST_CHECK_EQUAL(g_orphanage.Size(), 100U);
+    BOOST_CHECK_EQUAL(g_orphanage.PeerCount(0), 2U);
 
     // This really-big orphan should be ignored:
     for (int i = 0; i < 10; i++)
     {
-        CTransactionRef txPrev = RandomOrphan();
+        CTransactionRef txPrev = RandomOrphan(vecAdded);
 
         CMutableTransaction tx;
         tx.vout.resize(1);
@@ -400,18 +397,34 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     // Test EraseOrphansFor:
     for (NodeId i = 0; i < 3; i++)
     {
-        size_t sizeBefore = mapOrphanTransactions.size();
+        size_t sizeBefore = g_orphanage.Size();
         EraseOrphansFor(i);
-        BOOST_CHECK(mapOrphanTransactions.size() < sizeBefore);
+        BOOST_CHECK(g_orphanage.Size() < sizeBefore);
+        BOOST_CHECK_EQUAL(g_orphanage.PeerCount(i), 0U);
     }
 
     // Test LimitOrphanTxSize() function:
     LimitOrphanTxSize(40);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 40);
+    BOOST_CHECK(g_orphanage.Size() <= 40);
     LimitOrphanTxSize(10);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 10);
+    BOOST_CHECK(g_orphanage.Size() <= 10);
     LimitOrphanTxSize(0);
-    BOOST_CHECK(mapOrphanTransactions.empty());
+    BOOST_CHECK_EQUAL(g_orphanage.Size(), 0U);
+    BOOST_CHECK_EQUAL(g_orphanage.TotalTxSize(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(adaptive_block_download_window)
+{
+    // unknown throughput
+    BOOST_CHECK_EQUAL(GetAdaptiveBlockDownloadWindow(-1, -1, 0), 4);
+    // 1 MB/s with 100 kB blocks keeps 10 blocks in flight for the queue time, 10 more for a ping of 1 s
+    BOOST_CHECK_EQUAL(GetAdaptiveBlockDownloadWindow(1000000, 100000, 0), 10);
+    BOOST_CHECK_EQUAL(GetAdaptiveBlockDownloadWindow(1000000, 100000, 1000000), 20);
+    BOOST_CHECK_EQUAL(GetAdaptiveBlockDownloadWindow(1000000, 100000, std::numeric_limits<int64_t>::max()), 10);
+    BOOST_CHECK_EQUAL(GetAdaptiveBlockDownloadWindow(1000000, 30000, 0), 34);
+    // slow peers and fast ones are bounded
+    BOOST_CHECK_EQUAL(GetAdaptiveBlockDownloadWindow(100000, 100000, 0), 4);
+    BOOST_CHECK_EQUAL(GetAdaptiveBlockDownloadWindow(1000000000, 1000, 0), 128);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -19,6 +19,12 @@
 #include <evo/specialtx.h>
 #include <evo/providertx.h>
 #include <evo/deterministicmns.h>
+#include <evo/simplifiedmns.h>
+#include <llmq/quorums_commitment.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #include <boost/test/unit_test.hpp>
 
@@ -571,6 +577,47 @@ BOOST_FIXTURE_TEST_CASE(dip3_test_mempool_dual_proregtx, TestChainDIP3Setup)
     BOOST_CHECK(testPool.existsProviderTxConflict(tx_reg2));
 }
 
+BOOST_FIXTURE_TEST_CASE(dip3_mnlistdiff_cache, TestChainDIP3Setup)
+{
+    auto utxos = BuildSimpleUtxoMap(coinbaseTxns);
+
+    int port = 1;
+    for (size_t i = 0; i < 3; i++) {
+        CKey ownerKey;
+        CBLSSecretKey operatorKey;
+        auto tx = CreateProRegTx(utxos, port++, GenerateRandomAddress(), coinbaseKey, ownerKey, operatorKey);
+        CreateAndProcessBlock({tx}, coinbaseKey);
+        deterministicMNManager->UpdatedBlockTip(chainActive.Tip());
+    }
+
+    LOCK(cs_main);
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    for (int nVersion : {LLMQS_PROTO_VERSION - 1, PROTOCOL_VERSION}) {
+        for (const uint256& baseBlockHash : {uint256(), pindexTip->GetAncestor(pindexTip->nHeight - 3)->GetBlockHash()}) {
+            CSimplifiedMNListDiff mnListDiff;
+            std::string strError;
+            BOOST_REQUIRE(BuildSimplifiedMNListDiff(baseBlockHash, pindexTip->GetBlockHash(), mnListDiff, strError));
+            std::vector<unsigned char> vExpected;
+            CVectorWriter(SER_NETWORK, nVersion, vExpected, 0, mnListDiff);
+
+            CSimplifiedMNListDiffCache::Payload payload;
+            BOOST_REQUIRE(mnListDiffCache.GetSerializedDiff(baseBlockHash, pindexTip->GetBlockHash(), nVersion, payload, strError));
+            BOOST_CHECK(*payload == vExpected);
+
+            // the second request is served from the cache
+            CSimplifiedMNListDiffCache::Payload payload2;
+            BOOST_REQUIRE(mnListDiffCache.GetSerializedDiff(baseBlockHash, pindexTip->GetBlockHash(), nVersion, payload2, strError));
+            BOOST_CHECK(payload2 == payload);
+        }
+    }
+
+    // the blocks are still checked for cached diffs
+    CSimplifiedMNListDiffCache::Payload payload;
+    std::string strError;
+    BOOST_CHECK(!mnListDiffCache.GetSerializedDiff(pindexTip->GetBlockHash(), pindexTip->pprev->GetBlockHash(), PROTOCOL_VERSION, payload, strError));
+    BOOST_CHECK(!mnListDiffCache.GetSerializedDiff(uint256(), GetRandHash(), PROTOCOL_VERSION, payload, strError));
+}
+
 BOOST_FIXTURE_TEST_CASE(dip3_verify_db, TestChainDIP3Setup)
 {
     int nHeight = chainActive.Height();
@@ -648,4 +695,310 @@ BOOST_FIXTURE_TEST_CASE(dip3_verify_db, TestChainDIP3Setup)
     BOOST_ASSERT(CVerifyDB().VerifyDB(Params(), pcoinsTip.get(), 4, 2));
 }
 
+static CKeyID GetRandKeyID()
+{
+    std::vector<unsigned char> vch(20);
+    GetRandBytes(vch.data(), vch.size());
+    return CKeyID(uint160(vch));
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_compact_snapshot, BasicTestingSetup)
+{
+    CDeterministicMNList mnList(GetRandHash(), 1000, 0);
+    auto sharedPayout = GetScriptForDestination(GetRandKeyID());
+    for (uint64_t i = 0; i < 50; i++) {
+        // leave some gaps in the internalIds
+        auto dmn = std::make_shared<CDeterministicMN>(i * 3);
+        dmn->proTxHash = GetRandHash();
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), i);
+        dmn->nOperatorReward = i * 10;
+
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->nRegisteredHeight = 500 + i;
+        state->nLastPaidHeight = i % 2 ? 900 : 0;
+        state->nPoSePenalty = i % 5;
+        if (i % 7 == 0) {
+            state->BanIfNotBanned(950);
+        }
+        if (i % 3 != 0) {
+            state->UpdateConfirmedHash(dmn->proTxHash, GetRandHash());
+        }
+        if (i == 13) {
+            // doesn't match the one calculated from proTxHash and confirmedHash and must be stored as is
+            state->confirmedHashWithProRegTxHash = GetRandHash();
+        }
+        state->keyIDOwner = GetRandKeyID();
+        state->keyIDVoting = i % 2 ? state->keyIDOwner : GetRandKeyID();
+        CBLSSecretKey sk;
+        sk.MakeNewKey();
+        state->pubKeyOperator.Set(sk.GetPublicKey());
+        BOOST_CHECK(Lookup(strprintf("1.1.1.%d", i).c_str(), state->addr, 9999, false));
+        state->scriptPayout = i % 4 ? sharedPayout : GetScriptForDestination(GetRandKeyID());
+        if (i % 10 == 0) {
+            state->scriptOperatorPayout = sharedPayout;
+        }
+        dmn->pdmnState = state;
+        mnList.AddMN(dmn);
+    }
+
+    CDataStream ssLegacy(SER_DISK, CLIENT_VERSION);
+    ssLegacy << mnList;
+    CDataStream ssCompact(SER_DISK, CLIENT_VERSION);
+    ssCompact << CDeterministicMNListCompactSnapshot(mnList);
+    BOOST_CHECK_LT(ssCompact.size(), ssLegacy.size());
+
+    CDeterministicMNListCompactSnapshot loaded;
+    ssCompact >> loaded;
+    BOOST_CHECK(ssCompact.empty());
+    BOOST_CHECK(loaded.mnList.GetBlockHash() == mnList.GetBlockHash());
+    BOOST_CHECK_EQUAL(loaded.mnList.GetHeight(), mnList.GetHeight());
+    BOOST_CHECK_EQUAL(loaded.mnList.GetTotalRegisteredCount(), mnList.GetTotalRegisteredCount());
+    BOOST_CHECK_EQUAL(loaded.mnList.GetAllMNsCount(), mnList.GetAllMNsCount());
+    mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+        auto loadedDmn = loaded.mnList.GetMN(dmn->proTxHash);
+        BOOST_REQUIRE(loadedDmn != nullptr);
+        BOOST_CHECK(::SerializeHash(*loadedDmn) == ::SerializeHash(*dmn));
+    });
+
+    // unknown versions must not be loaded
+    CDataStream ssBadVersion(SER_DISK, CLIENT_VERSION);
+    ssBadVersion << CDeterministicMNListCompactSnapshot(mnList);
+    ssBadVersion[0] = CDeterministicMNListCompactSnapshot::CURRENT_VERSION + 1;
+    BOOST_CHECK_THROW(ssBadVersion >> loaded, std::ios_base::failure);
+}
+
+// The order in which GetMNPayee/GetProjectedMNPayees used to be calculated, by sorting all valid MNs
+static std::vector<uint256> SortByLastPaid(const CDeterministicMNList& mnList)
+{
+    std::vector<std::pair<int, uint256>> v;
+    mnList.ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) {
+        int height = dmn->pdmnState->nLastPaidHeight;
+        if (dmn->pdmnState->nPoSeRevivedHeight != -1 && dmn->pdmnState->nPoSeRevivedHeight > height) {
+            height = dmn->pdmnState->nPoSeRevivedHeight;
+        } else if (height == 0) {
+            height = dmn->pdmnState->nRegisteredHeight;
+        }
+        v.emplace_back(height, dmn->proTxHash);
+    });
+    std::sort(v.begin(), v.end());
+    std::vector<uint256> ret;
+    for (const auto& p : v) {
+        ret.emplace_back(p.second);
+    }
+    return ret;
+}
+
+static std::vector<uint256> GetProjectedHashes(const CDeterministicMNList& mnList, int nCount)
+{
+    std::vector<uint256> ret;
+    for (const auto& dmn : mnList.GetProjectedMNPayees(nCount)) {
+        ret.emplace_back(dmn->proTxHash);
+    }
+    return ret;
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_payment_queue, BasicTestingSetup)
+{
+    CDeterministicMNList mnList(GetRandHash(), 1000, 0);
+    BOOST_CHECK(mnList.GetMNPayee() == nullptr);
+
+    uint64_t nNextId = 0;
+    auto addMN = [&]() {
+        auto dmn = std::make_shared<CDeterministicMN>(nNextId++);
+        dmn->proTxHash = GetRandHash();
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->nRegisteredHeight = 900 + InsecureRandRange(100);
+        // many share the same heights, so that the proTxHash decides
+        state->nLastPaidHeight = InsecureRandBool() ? 0 : 950 + InsecureRandRange(10);
+        state->keyIDOwner = GetRandKeyID();
+        dmn->pdmnState = state;
+        mnList.AddMN(dmn);
+    };
+    for (int i = 0; i < 100; i++) {
+        addMN();
+    }
+
+    for (int nHeight = 1001; nHeight < 1300; nHeight++) {
+        CDeterministicMNList prevList = mnList;
+        std::vector<uint256> vPrevOrder = SortByLastPaid(prevList);
+
+        auto payee = mnList.GetMNPayee();
+        BOOST_REQUIRE(payee != nullptr);
+        BOOST_CHECK(payee->proTxHash == vPrevOrder.front());
+        auto newState = std::make_shared<CDeterministicMNState>(*payee->pdmnState);
+        newState->nLastPaidHeight = nHeight;
+        mnList.UpdateMN(payee, newState);
+
+        // some PoSe bans, revivals, removals and registrations
+        std::vector<CDeterministicMNCPtr> vMNs;
+        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) { vMNs.emplace_back(dmn); });
+        auto dmn = vMNs[InsecureRandRange(vMNs.size())];
+        newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+        switch (InsecureRandRange(4)) {
+        case 0:
+            newState->BanIfNotBanned(nHeight);
+            mnList.UpdateMN(dmn, newState);
+            break;
+        case 1:
+            if (newState->IsBanned()) {
+                newState->Revive(nHeight);
+                mnList.UpdateMN(dmn, newState);
+            }
+            break;
+        case 2:
+            mnList.RemoveMN(dmn->proTxHash);
+            break;
+        case 3:
+            addMN();
+            break;
+        }
+
+        std::vector<uint256> vOrder = SortByLastPaid(mnList);
+        BOOST_CHECK_EQUAL(mnList.GetValidMNsCount(), vOrder.size());
+        BOOST_CHECK(GetProjectedHashes(mnList, mnList.GetAllMNsCount() + 1) == vOrder);
+        vOrder.resize(std::min<size_t>(vOrder.size(), 10));
+        BOOST_CHECK(GetProjectedHashes(mnList, 10) == vOrder);
+
+        // the copy still has its own order
+        BOOST_CHECK(GetProjectedHashes(prevList, prevList.GetAllMNsCount()) == vPrevOrder);
+
+        // and the cached valid MNs are rebuilt for the changed list only, sorted by proTxHash
+        std::vector<uint256> vValid, vPrevValid;
+        mnList.ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) { vValid.emplace_back(dmn->proTxHash); });
+        prevList.ForEachMN(true, [&](const CDeterministicMNCPtr& dmn) { vPrevValid.emplace_back(dmn->proTxHash); });
+        std::vector<uint256> vSorted = SortByLastPaid(mnList);
+        std::sort(vSorted.begin(), vSorted.end());
+        std::sort(vPrevOrder.begin(), vPrevOrder.end());
+        BOOST_CHECK(vValid == vSorted);
+        BOOST_CHECK(vPrevValid == vPrevOrder);
+    }
+
+    // deserialized lists rebuild the queue
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << mnList;
+    CDeterministicMNList loaded;
+    ss >> loaded;
+    BOOST_CHECK(GetProjectedHashes(loaded, loaded.GetAllMNsCount()) == SortByLastPaid(mnList));
+}
+
+static std::vector<uint256> GetHashes(const std::vector<CDeterministicMNCPtr>& mns)
+{
+    std::vector<uint256> ret;
+    for (const auto& dmn : mns) {
+        ret.emplace_back(dmn->proTxHash);
+    }
+    return ret;
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_property_index, BasicTestingSetup)
+{
+    std::vector<CScript> vPayouts(5);
+    std::vector<CKeyID> vVotingKeys(5);
+    for (size_t i = 0; i < vPayouts.size(); i++) {
+        vPayouts[i] = GetScriptForDestination(GetRandKeyID());
+        vVotingKeys[i] = GetRandKeyID();
+    }
+
+    CDeterministicMNList mnList(GetRandHash(), 1000, 0);
+    for (int i = 0; i < 50; i++) {
+        auto dmn = std::make_shared<CDeterministicMN>(i);
+        dmn->proTxHash = GetRandHash();
+        dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+        auto state = std::make_shared<CDeterministicMNState>();
+        state->nRegisteredHeight = 900;
+        state->keyIDOwner = GetRandKeyID();
+        state->keyIDVoting = vVotingKeys[InsecureRandRange(vVotingKeys.size())];
+        state->scriptPayout = vPayouts[InsecureRandRange(vPayouts.size())];
+        if (InsecureRandBool()) {
+            state->scriptOperatorPayout = vPayouts[InsecureRandRange(vPayouts.size())];
+        }
+        dmn->pdmnState = state;
+        mnList.AddMN(dmn);
+    }
+
+    // change, remove and re-add some of them and then compare the index with a scan over all MNs
+    for (int i = 0; i < 100; i++) {
+        std::vector<CDeterministicMNCPtr> vMNs;
+        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) { vMNs.emplace_back(dmn); });
+        auto dmn = vMNs[InsecureRandRange(vMNs.size())];
+        auto newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+        switch (InsecureRandRange(4)) {
+        case 0:
+            newState->scriptPayout = vPayouts[InsecureRandRange(vPayouts.size())];
+            mnList.UpdateMN(dmn, newState);
+            break;
+        case 1:
+            newState->scriptOperatorPayout = InsecureRandBool() ? vPayouts[InsecureRandRange(vPayouts.size())] : CScript();
+            mnList.UpdateMN(dmn, newState);
+            break;
+        case 2:
+            newState->keyIDVoting = vVotingKeys[InsecureRandRange(vVotingKeys.size())];
+            mnList.UpdateMN(dmn, newState);
+            break;
+        case 3:
+            mnList.RemoveMN(dmn->proTxHash);
+            mnList.AddMN(dmn, false);
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < vPayouts.size(); i++) {
+        std::vector<uint256> vPayout, vOperatorPayout, vVoting;
+        mnList.ForEachMN(false, [&](const CDeterministicMNCPtr& dmn) {
+            if (dmn->pdmnState->scriptPayout == vPayouts[i]) vPayout.emplace_back(dmn->proTxHash);
+            if (dmn->pdmnState->scriptOperatorPayout == vPayouts[i]) vOperatorPayout.emplace_back(dmn->proTxHash);
+            if (dmn->pdmnState->keyIDVoting == vVotingKeys[i]) vVoting.emplace_back(dmn->proTxHash);
+        });
+        std::sort(vPayout.begin(), vPayout.end());
+        std::sort(vOperatorPayout.begin(), vOperatorPayout.end());
+        std::sort(vVoting.begin(), vVoting.end());
+        BOOST_CHECK(GetHashes(mnList.GetMNsByPayoutScript(vPayouts[i])) == vPayout);
+        BOOST_CHECK(GetHashes(mnList.GetMNsByOperatorPayoutScript(vPayouts[i])) == vOperatorPayout);
+        BOOST_CHECK(GetHashes(mnList.GetMNsByVotingKey(vVotingKeys[i])) == vVoting);
+    }
+    BOOST_CHECK(mnList.GetMNsByPayoutScript(GetScriptForDestination(GetRandKeyID())).empty());
+    BOOST_CHECK(mnList.GetMNsByOperatorPayoutScript(CScript()).empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(dip3_sig_checks, BasicTestingSetup)
+{
+    {
+        CSpecialTxSigChecks sigChecks;
+        std::atomic<int> nRun{0};
+        for (int i = 0; i < 100; i++) {
+            sigChecks.Add([&](std::string& strError) { nRun++; return true; });
+        }
+        // the result of a prefetch doesn't count
+        sigChecks.AddPrefetch([&](std::string& strError) { nRun++; strError = "prefetch"; return false; });
+        BOOST_CHECK_EQUAL(sigChecks.size(), 101U);
+        CValidationState state;
+        BOOST_CHECK(sigChecks.Wait(state));
+        BOOST_CHECK(state.IsValid());
+        BOOST_CHECK_EQUAL(nRun, 101);
+        BOOST_CHECK_EQUAL(sigChecks.size(), 0U);
+    }
+
+    {
+        // the first failing check in the order they were added is reported, like when they are run one by one
+        CSpecialTxSigChecks sigChecks;
+        for (int i = 0; i < 100; i++) {
+            sigChecks.Add([i](std::string& strError) {
+                if (i % 10 != 3) {
+                    return true;
+                }
+                // let the later ones finish first
+                std::this_thread::sleep_for(std::chrono::milliseconds(10 - i / 10));
+                strError = strprintf("sig %d", i);
+                return false;
+            });
+        }
+        sigChecks.Add([](std::string& strError) -> bool { throw std::runtime_error("throws"); });
+        CValidationState state;
+        BOOST_CHECK(!sigChecks.Wait(state));
+        BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-protx-sig");
+        BOOST_CHECK_EQUAL(state.GetDebugMessage(), "sig 3");
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
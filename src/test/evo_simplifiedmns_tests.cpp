@@ -5,8 +5,10 @@
 #include <test/test_dash.h>
 
 #include <bls/bls.h>
+#include <evo/deterministicmns.h>
 #include <evo/simplifiedmns.h>
 #include <netbase.h>
+#include <random.h>
 
 #include <boost/test/unit_test.hpp>
 
@@ -67,4 +69,83 @@ BOOST_AUTO_TEST_CASE(simplifiedmns_merkleroots)
 
     BOOST_CHECK(expectedMerkleRoot == calculatedMerkleRoot);
 }
+
+static CDeterministicMNCPtr CreateTestMN(uint64_t internalId)
+{
+    auto dmn = std::make_shared<CDeterministicMN>(internalId);
+    dmn->proTxHash = GetRandHash();
+    dmn->collateralOutpoint = COutPoint(GetRandHash(), 0);
+    auto dmnState = std::make_shared<CDeterministicMNState>();
+    dmnState->keyIDOwner.SetHex(strprintf("%040x", internalId + 1));
+    dmnState->keyIDVoting = dmnState->keyIDOwner;
+    dmnState->confirmedHash = GetRandHash();
+    dmn->pdmnState = dmnState;
+    return dmn;
+}
+
+static void CheckMerkleTree(CSimplifiedMNListMerkleTree& tree, const CDeterministicMNList& oldList, const CDeterministicMNList& newList)
+{
+    tree.ApplyDiff(oldList, newList, oldList.BuildDiff(newList));
+
+    bool mutated1, mutated2;
+    BOOST_CHECK_EQUAL(tree.GetLeafCount(), newList.GetAllMNsCount());
+    BOOST_CHECK(tree.GetMerkleRoot(&mutated1) == CSimplifiedMNList(newList).CalcMerkleRoot(&mutated2));
+    BOOST_CHECK(tree.GetMerkleRoot() == CSimplifiedMNListMerkleTree(newList).GetMerkleRoot());
+    BOOST_CHECK_EQUAL(mutated1, mutated2);
+}
+
+BOOST_AUTO_TEST_CASE(simplifiedmns_merkletree)
+{
+    CDeterministicMNList emptyList;
+    CSimplifiedMNListMerkleTree tree;
+    BOOST_CHECK(tree.GetMerkleRoot() == uint256());
+
+    uint64_t nextInternalId = 0;
+    CDeterministicMNList list1;
+    for (size_t i = 0; i < 15; i++) {
+        list1.AddMN(CreateTestMN(nextInternalId++));
+    }
+    CheckMerkleTree(tree, emptyList, list1);
+
+    // changes which are not part of the SML must not touch the tree
+    auto list2 = list1;
+    auto dmn = list2.GetMNByInternalId(3);
+    auto newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+    newState->nLastPaidHeight = 100;
+    list2.UpdateMN(dmn, newState);
+    uint256 root1 = tree.GetMerkleRoot();
+    CheckMerkleTree(tree, list1, list2);
+    BOOST_CHECK(tree.GetMerkleRoot() == root1);
+
+    // in-place updates of single leaves
+    auto list3 = list2;
+    for (uint64_t internalId : {0, 7, 14}) {
+        dmn = list3.GetMNByInternalId(internalId);
+        newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+        newState->keyIDVoting.SetHex(strprintf("%040x", 1000 + internalId));
+        list3.UpdateMN(dmn, newState);
+    }
+    dmn = list3.GetMNByInternalId(5);
+    newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+    newState->BanIfNotBanned(100);
+    list3.UpdateMN(dmn, newState);
+    CheckMerkleTree(tree, list2, list3);
+    BOOST_CHECK(tree.GetMerkleRoot() != root1);
+
+    // additions and removals shift the leaves
+    auto list4 = list3;
+    list4.RemoveMN(list4.GetMNByInternalId(2)->proTxHash);
+    list4.RemoveMN(list4.GetMNByInternalId(9)->proTxHash);
+    for (size_t i = 0; i < 4; i++) {
+        list4.AddMN(CreateTestMN(nextInternalId++));
+    }
+    dmn = list4.GetMNByInternalId(11);
+    newState = std::make_shared<CDeterministicMNState>(*dmn->pdmnState);
+    newState->confirmedHash = GetRandHash();
+    list4.UpdateMN(dmn, newState);
+    CheckMerkleTree(tree, list3, list4);
+
+    CheckMerkleTree(tree, list4, emptyList);
+    BOOST_CHECK(tree.GetMerkleRoot() == uint256());
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,246 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <checkqueue.h>
+#include <executor.h>
+
+#include <test/test_dash.h>
+
+#include <atomic>
+#include <chrono>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(executor_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(executor_priorities)
+{
+    CExecutor executor(1);
+
+    // keep the only worker busy until all tasks are queued
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    executor.Push(ExecutorPriority::BACKGROUND, [released](int) { released.wait(); });
+
+    std::mutex mutex;
+    std::vector<ExecutorPriority> order;
+    std::promise<void> done;
+    for (auto priority : {ExecutorPriority::BACKGROUND, ExecutorPriority::RPC, ExecutorPriority::CONSENSUS, ExecutorPriority::LLMQ}) {
+        executor.Push(priority, [&, priority](int) {
+            std::unique_lock<std::mutex> l(mutex);
+            order.emplace_back(priority);
+            if (order.size() == 4) {
+                done.set_value();
+            }
+        });
+    }
+    release.set_value();
+    done.get_future().wait();
+
+    std::vector<ExecutorPriority> expected{ExecutorPriority::CONSENSUS, ExecutorPriority::LLMQ, ExecutorPriority::RPC, ExecutorPriority::BACKGROUND};
+    BOOST_CHECK(order == expected);
+
+    executor.Stop();
+    auto stats = executor.GetStats();
+    BOOST_CHECK_EQUAL(stats[(size_t)ExecutorPriority::BACKGROUND].nTasks, 2U);
+    BOOST_CHECK_EQUAL(stats[(size_t)ExecutorPriority::RPC].nTasks, 1U);
+    BOOST_CHECK_EQUAL(stats[(size_t)ExecutorPriority::CONSENSUS].nTasks, 1U);
+    BOOST_CHECK_EQUAL(stats[(size_t)ExecutorPriority::LLMQ].nTasks, 1U);
+    for (const auto& s : stats) {
+        BOOST_CHECK_EQUAL(s.nPending, 0U);
+        BOOST_CHECK_EQUAL(s.nRunning, 0U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(executor_local_queues)
+{
+    // tasks pushed by a task go to the local queue of its worker and run newest first, with its priority
+    {
+        CExecutor executor(1);
+        std::mutex mutex;
+        std::vector<int> order;
+        std::promise<void> done;
+        executor.Push(ExecutorPriority::RPC, [&](int) {
+            for (int i = 0; i < 3; i++) {
+                executor.Push(ExecutorPriority::BACKGROUND, [&, i](int) {
+                    std::unique_lock<std::mutex> l(mutex);
+                    order.emplace_back(i);
+                    if (order.size() == 3) {
+                        done.set_value();
+                    }
+                });
+            }
+        });
+        done.get_future().wait();
+        BOOST_CHECK(order == std::vector<int>({2, 1, 0}));
+        executor.Stop();
+        BOOST_CHECK_EQUAL(executor.GetStats()[(size_t)ExecutorPriority::RPC].nTasks, 4U);
+        BOOST_CHECK_EQUAL(executor.GetStats()[(size_t)ExecutorPriority::BACKGROUND].nTasks, 0U);
+    }
+
+    // a recursive split of the work, the other workers steal the subtasks of the first one
+    {
+        CExecutor executor(4);
+        std::atomic<int> nSum{0};
+        std::atomic<int> nLeaves{0};
+        std::promise<void> done;
+        std::function<void(int, int)> split = [&](int nBegin, int nEnd) {
+            if (nEnd - nBegin == 1) {
+                nSum += nBegin;
+                if (++nLeaves == 1024) {
+                    done.set_value();
+                }
+                return;
+            }
+            int nMid = (nBegin + nEnd) / 2;
+            executor.Push(ExecutorPriority::LLMQ, [&, nBegin, nMid](int) { split(nBegin, nMid); });
+            executor.Push(ExecutorPriority::LLMQ, [&, nMid, nEnd](int) { split(nMid, nEnd); });
+        };
+        executor.Push(ExecutorPriority::LLMQ, [&](int) { split(0, 1024); });
+        done.get_future().wait();
+        BOOST_CHECK_EQUAL(nSum, 1023 * 1024 / 2);
+        executor.Stop();
+        BOOST_CHECK_EQUAL(executor.GetStats()[(size_t)ExecutorPriority::LLMQ].nTasks, 2047U);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(executor_stop)
+{
+    CExecutor executor(2);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> nRun{0};
+    for (int i = 0; i < 2; i++) {
+        executor.Push(ExecutorPriority::BACKGROUND, [&, released](int) { released.wait(); nRun++; });
+    }
+    for (int i = 0; i < 10; i++) {
+        executor.Push(ExecutorPriority::BACKGROUND, [&](int) { nRun++; });
+    }
+    while (executor.GetStats()[(size_t)ExecutorPriority::BACKGROUND].nRunning != 2) {
+        std::this_thread::yield();
+    }
+    std::thread stopper([&]() { executor.Stop(); });
+    while (!executor.IsStopped()) {
+        std::this_thread::yield();
+    }
+    release.set_value();
+    stopper.join();
+    // the running tasks were finished, the pending ones dropped
+    BOOST_CHECK_EQUAL(nRun, 2);
+
+    // nothing is accepted anymore
+    executor.Push(ExecutorPriority::BACKGROUND, [&](int) { nRun++; });
+    BOOST_CHECK_EQUAL(executor.GetStats()[(size_t)ExecutorPriority::BACKGROUND].nPending, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(executor_client)
+{
+    CExecutorClient client(ExecutorPriority::LLMQ);
+    client.Start();
+    BOOST_CHECK_EQUAL(client.size(), GetExecutor().size());
+    client.Start(3);
+    BOOST_CHECK_EQUAL(client.size(), 3);
+
+    auto f = client.push([](int, int a, int b) { return a + b; }, 1, 2);
+    BOOST_CHECK_EQUAL(f.get(), 3);
+
+    // Stop() waits for the running tasks
+    std::promise<void> started;
+    std::atomic<bool> fFinished{false};
+    auto f2 = client.push([&](int) {
+        started.set_value();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        fFinished = true;
+    });
+    started.get_future().wait();
+    client.Stop();
+    BOOST_CHECK(fFinished);
+    f2.get();
+
+    // the tasks of a stopped client are dropped
+    auto f3 = client.push([](int) { return 1; });
+    BOOST_CHECK_THROW(f3.get(), std::future_error);
+
+    client.Start();
+    auto f4 = client.push([](int) { return 4; });
+    BOOST_CHECK_EQUAL(f4.get(), 4);
+    client.Stop();
+}
+
+BOOST_AUTO_TEST_CASE(executor_parallel_for)
+{
+    CExecutor executor(3);
+    for (size_t nCount : {0, 1, 2, 1000}) {
+        std::vector<std::atomic<int>> vCalls(nCount);
+        executor.ParallelFor(ExecutorPriority::CONSENSUS, nCount, [&](size_t i) { vCalls[i]++; });
+        for (const auto& n : vCalls) {
+            BOOST_CHECK_EQUAL(n, 1);
+        }
+    }
+
+    // the calling thread does the work when the workers are busy, also when it's a task itself
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    for (int i = 0; i < 2; i++) {
+        executor.Push(ExecutorPriority::CONSENSUS, [released](int) { released.wait(); });
+    }
+    std::promise<size_t> done;
+    executor.Push(ExecutorPriority::CONSENSUS, [&](int) {
+        std::atomic<size_t> nSum{0};
+        executor.ParallelFor(ExecutorPriority::CONSENSUS, 100, [&](size_t i) { nSum += i; });
+        done.set_value(nSum);
+    });
+    BOOST_CHECK_EQUAL(done.get_future().get(), 99U * 100 / 2);
+    release.set_value();
+
+    // nothing is left for the workers after a stop
+    executor.Stop();
+    size_t nCalls = 0;
+    executor.ParallelFor(ExecutorPriority::CONSENSUS, 10, [&](size_t i) { nCalls++; });
+    BOOST_CHECK_EQUAL(nCalls, 10U);
+}
+
+struct CountingCheck
+{
+    static std::atomic<size_t> nCalls;
+    bool fOk{true};
+
+    bool operator()()
+    {
+        nCalls++;
+        return fOk;
+    }
+    void swap(CountingCheck& x) { std::swap(fOk, x.fOk); }
+};
+std::atomic<size_t> CountingCheck::nCalls{0};
+
+BOOST_AUTO_TEST_CASE(executor_checkqueue)
+{
+    CExecutor executor(3);
+    CCheckQueue<CountingCheck> queue(16);
+    queue.SetExecutor(&executor, 3);
+
+    for (size_t nChecks : {0, 1, 100, 10000}) {
+        for (bool fBad : {false, true}) {
+            CountingCheck::nCalls = 0;
+            CCheckQueueControl<CountingCheck> control(&queue);
+            size_t nLeft = nChecks;
+            while (nLeft) {
+                std::vector<CountingCheck> vChecks(std::min<size_t>(nLeft, 1 + InsecureRandRange(50)));
+                nLeft -= vChecks.size();
+                if (fBad && nLeft == 0) {
+                    vChecks.back().fOk = false;
+                }
+                control.Add(vChecks);
+            }
+            BOOST_CHECK_EQUAL(control.Wait(), !fBad || nChecks == 0);
+            if (!fBad) {
+                BOOST_CHECK_EQUAL(CountingCheck::nCalls, nChecks);
+            }
+        }
+    }
+    executor.Stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
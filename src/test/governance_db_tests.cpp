@@ -0,0 +1,84 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <governance/governance.h>
+#include <governance/governance-db.h>
+#include <utilstrencodings.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_db_tests, BasicTestingSetup)
+
+static CGovernanceVote MakeVote(const COutPoint& outpoint, const uint256& nParentHash, vote_outcome_enum_t eOutcome, int64_t nTime, vote_rec_t& voteRecord)
+{
+    CGovernanceVote vote(outpoint, nParentHash, VOTE_SIGNAL_FUNDING, eOutcome);
+    vote.SetTime(nTime);
+    voteRecord.mapInstances[VOTE_SIGNAL_FUNDING] = vote_instance_t(eOutcome, nTime, nTime);
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(governance_db_objects_and_votes)
+{
+    governanceDb.reset(new CGovernanceDb(1 << 20, true));
+    BOOST_CHECK(!governanceDb->HasData());
+
+    const int64_t nTime = GetTime();
+    CGovernanceObject govobj(uint256(), 1, nTime, uint256S("01"), HexStr(std::string("[[\"proposal\",{}]]")));
+    const uint256 nHash = govobj.GetHash();
+    governanceDb->WriteObject(govobj);
+
+    const COutPoint outpoint1(uint256S("aa"), 0);
+    const COutPoint outpoint2(uint256S("bb"), 1);
+    vote_rec_t voteRecord1, voteRecord2;
+    CGovernanceVote vote1 = MakeVote(outpoint1, nHash, VOTE_OUTCOME_YES, nTime, voteRecord1);
+    governanceDb->WriteVote(vote1, {}, voteRecord1);
+    // A newer vote of the same masternode replaces the first one
+    CGovernanceVote vote1b = MakeVote(outpoint1, nHash, VOTE_OUTCOME_NO, nTime + 1, voteRecord1);
+    governanceDb->WriteVote(vote1b, {vote1.GetHash()}, voteRecord1);
+    CGovernanceVote vote2 = MakeVote(outpoint2, nHash, VOTE_OUTCOME_YES, nTime, voteRecord2);
+    governanceDb->WriteVote(vote2, {}, voteRecord2);
+
+    // Objects come back with their current votes, the vote file is only read when it's used
+    std::map<uint256, CGovernanceObject> mapObjects;
+    BOOST_CHECK(governanceDb->ReadObjects(mapObjects));
+    BOOST_CHECK_EQUAL(mapObjects.size(), 1);
+    const CGovernanceObject& loaded = mapObjects.begin()->second;
+    BOOST_CHECK(loaded.GetHash() == nHash);
+    BOOST_CHECK_EQUAL(loaded.GetVoteHashes().size(), 2);
+    vote_rec_t voteRecord;
+    BOOST_CHECK(loaded.GetCurrentMNVotes(outpoint1, voteRecord));
+    BOOST_CHECK_EQUAL(voteRecord.mapInstances.at(VOTE_SIGNAL_FUNDING).eOutcome, VOTE_OUTCOME_NO);
+    BOOST_CHECK_EQUAL(loaded.GetNoCount(VOTE_SIGNAL_FUNDING), 1);
+    BOOST_CHECK_EQUAL(loaded.GetYesCount(VOTE_SIGNAL_FUNDING), 1);
+
+    const CGovernanceObjectVoteFile& fileVotes = loaded.GetVoteFile();
+    BOOST_CHECK_EQUAL(fileVotes.GetVoteCount(), 2);
+    BOOST_CHECK(!fileVotes.HasVote(vote1.GetHash()));
+    BOOST_CHECK(fileVotes.HasVote(vote1b.GetHash()));
+    BOOST_CHECK(fileVotes.HasVote(vote2.GetHash()));
+
+    governanceDb->EraseVotes(nHash, outpoint2, {vote2.GetHash()}, vote_rec_t());
+    BOOST_CHECK_EQUAL(governanceDb->ReadVoteHashes(nHash).size(), 1);
+    BOOST_CHECK(governanceDb->ReadObjects(mapObjects));
+    vote_rec_t voteRecordErased;
+    BOOST_CHECK(!mapObjects.begin()->second.GetCurrentMNVotes(outpoint2, voteRecordErased));
+    BOOST_CHECK_EQUAL(mapObjects.begin()->second.GetYesCount(VOTE_SIGNAL_FUNDING), 0);
+    BOOST_CHECK_EQUAL(mapObjects.begin()->second.GetAbsoluteNoCount(VOTE_SIGNAL_FUNDING), 1);
+
+    CGovernanceManager governanceTmp;
+    governanceDb->WriteRecords(governanceTmp, mapObjects);
+    BOOST_CHECK(governanceDb->HasData());
+    BOOST_CHECK(governanceDb->ReadManager(governanceTmp));
+
+    governanceDb->EraseObject(nHash);
+    BOOST_CHECK(governanceDb->ReadObjects(mapObjects));
+    BOOST_CHECK(mapObjects.empty());
+    BOOST_CHECK(governanceDb->ReadVoteHashes(nHash).empty());
+
+    governanceDb.reset();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
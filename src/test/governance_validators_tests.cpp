@@ -1,6 +1,8 @@
 // Copyright (c) 2014-2020 The Dash Core developers
 
+#include <governance/governance-object.h>
 #include <governance/governance-validators.h>
+#include <timedata.h>
 #include <utilstrencodings.h>
 
 #include <test/data/proposals_valid.json.h>
@@ -84,4 +86,33 @@ BOOST_AUTO_TEST_CASE(invalid_proposals_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(cached_proposal_validity_test)
+{
+    // the result cached on the object must match a fresh validation, also when asked for repeatedly
+    UniValue valid = read_json(std::string(json_tests::proposals_valid, json_tests::proposals_valid + sizeof(json_tests::proposals_valid)));
+    for (size_t i = 0; i < valid.size(); ++i) {
+        CGovernanceObject govobj(uint256(), 1, GetAdjustedTime(), uint256(), HexStr(valid[i].write()));
+        for (int j = 0; j < 2; j++) {
+            std::string strError;
+            BOOST_CHECK_MESSAGE(govobj.ValidateProposal(strError, false), strError);
+            // all of them are expired
+            BOOST_CHECK(!govobj.ValidateProposal(strError, true));
+            BOOST_CHECK_EQUAL(strError, "expired;");
+        }
+    }
+
+    UniValue invalid = read_json(std::string(json_tests::proposals_invalid, json_tests::proposals_invalid + sizeof(json_tests::proposals_invalid)));
+    for (size_t i = 0; i < invalid.size(); ++i) {
+        std::string strHexData = HexStr(invalid[i].write());
+        CProposalValidator validator(strHexData, true);
+        BOOST_CHECK(!validator.Validate(false));
+        CGovernanceObject govobj(uint256(), 1, GetAdjustedTime(), uint256(), strHexData);
+        for (int j = 0; j < 2; j++) {
+            std::string strError;
+            BOOST_CHECK(!govobj.ValidateProposal(strError, false));
+            BOOST_CHECK_EQUAL(strError, validator.GetErrorMessages());
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,7 +3,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <hash.h>
+#include <primitives/block.h>
 #include <utilstrencodings.h>
+#include <validation.h>
 #include <test/test_dash.h>
 
 #include <vector>
@@ -146,7 +148,47 @@ BOOST_AUTO_TEST_CASE(siphash)
         BOOST_CHECK_EQUAL(SipHashUint256Extra(k1, k2, x, n), sip288.Finalize());
     }*/
 
+    // Check the batch API against SipHashUint256, including counts which don't fill the 4-way implementation
+    for (size_t count = 0; count <= 11; count++) {
+        uint64_t k0 = InsecureRandBits(64);
+        uint64_t k1 = InsecureRandBits(64);
+        std::vector<uint256> vals(count);
+        std::vector<const uint256*> inputs;
+        for (auto& val : vals) {
+            val = InsecureRand256();
+            inputs.emplace_back(&val);
+        }
+        std::vector<uint64_t> out(count);
+        SipHashUint256Batch(k0, k1, inputs.data(), count, out.data());
+        for (size_t i = 0; i < count; i++) {
+            BOOST_CHECK_EQUAL(out[i], SipHashUint256(k0, k1, vals[i]));
+        }
+    }
+
     BOOST_CHECK_EQUAL(SipHashUint256(1, 2, ss.GetHash()), 0x79751e980c2a0a35ULL);
 }
 
+BOOST_AUTO_TEST_CASE(hashx11_batch)
+{
+    std::vector<CBlockHeader> headers(2 * HEADERS_PER_HASH_TASK + 17);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        headers[i].nVersion = 0x20000000;
+        headers[i].hashPrevBlock = InsecureRand256();
+        headers[i].hashMerkleRoot = InsecureRand256();
+        headers[i].nTime = InsecureRand32();
+        headers[i].nBits = 0x1e0ffff0;
+        headers[i].nNonce = InsecureRand32();
+    }
+
+    std::vector<uint256> hashes = GetBlockHeaderHashes(headers);
+    BOOST_CHECK_EQUAL(hashes.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); ++i) {
+        BOOST_CHECK(hashes[i] == headers[i].GetHash());
+    }
+    BOOST_CHECK(GetBlockHeaderHashes({}).empty());
+
+    BOOST_CHECK(GetBlockHeaderHashesParallel(headers) == hashes);
+    BOOST_CHECK(GetBlockHeaderHashesParallel({}).empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
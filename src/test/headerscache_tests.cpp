@@ -0,0 +1,101 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chain.h>
+#include <headerscache.h>
+#include <streams.h>
+#include <validation.h>
+#include <test/test_dash.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(headerscache_tests, BasicTestingSetup)
+
+static void BuildChain(std::vector<CBlockIndex>& vIndex, std::vector<uint256>& vHash, CBlockIndex* pprev, int nHeight)
+{
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        vHash[i] = InsecureRand256();
+        vIndex[i].phashBlock = &vHash[i];
+        vIndex[i].pprev = i ? &vIndex[i - 1] : pprev;
+        vIndex[i].nHeight = nHeight + i;
+        vIndex[i].nVersion = InsecureRand32();
+        vIndex[i].hashMerkleRoot = InsecureRand256();
+        vIndex[i].nTime = InsecureRand32();
+        vIndex[i].nBits = InsecureRand32();
+        vIndex[i].nNonce = InsecureRand32();
+        vIndex[i].BuildSkip();
+    }
+}
+
+/** Check that the cache holds the serialized headers of the whole chain and builds the same messages */
+static void CheckCache(const CHeadersCache& cache, const CChain& chain) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    BOOST_CHECK_EQUAL(cache.Size(), chain.Height() + 1);
+
+    CDataStream ssExpected(SER_NETWORK, PROTOCOL_VERSION);
+    for (int i = 0; i <= chain.Height(); i++) {
+        ssExpected << chain[i]->GetBlockHeader();
+    }
+    CDataStream ssCache(SER_NETWORK, PROTOCOL_VERSION);
+    cache.WriteHeaders(ssCache, 0, cache.Size());
+    BOOST_CHECK(ssCache.str() == ssExpected.str());
+
+    int nStart = InsecureRandRange(chain.Height() + 1);
+    int nCount = InsecureRandRange(chain.Height() + 2 - nStart);
+    std::vector<CBlock> vHeaders;
+    for (int i = nStart; i < nStart + nCount; i++) {
+        vHeaders.push_back(chain[i]->GetBlockHeader());
+    }
+    CDataStream ssMsgExpected(SER_NETWORK, PROTOCOL_VERSION);
+    ssMsgExpected << vHeaders;
+    CDataStream ssMsg(SER_NETWORK, PROTOCOL_VERSION);
+    cache.WriteHeadersMessage(ssMsg, nStart, nCount);
+    BOOST_CHECK(ssMsg.str() == ssMsgExpected.str());
+}
+
+BOOST_AUTO_TEST_CASE(headerscache_sync_reorg)
+{
+    LOCK(cs_main);
+
+    std::vector<CBlockIndex> vMain(300);
+    std::vector<uint256> vHashMain(vMain.size());
+    BuildChain(vMain, vHashMain, nullptr, 0);
+    // A fork off height 199, longer than the main chain
+    std::vector<CBlockIndex> vFork(150);
+    std::vector<uint256> vHashFork(vFork.size());
+    BuildChain(vFork, vHashFork, &vMain[199], 200);
+
+    CHeadersCache cache;
+    CChain chain;
+    BOOST_CHECK(!cache.Sync(chain));
+    cache.SetEnabled(true);
+    BOOST_CHECK(cache.Sync(chain));
+    BOOST_CHECK_EQUAL(cache.Size(), 0);
+
+    // Appended to while the tip advances
+    chain.SetTip(&vMain[99]);
+    BOOST_CHECK(cache.Sync(chain));
+    CheckCache(cache, chain);
+    chain.SetTip(&vMain.back());
+    BOOST_CHECK(cache.Sync(chain));
+    CheckCache(cache, chain);
+
+    // Truncated to the fork point and rebuilt after a reorg
+    chain.SetTip(&vFork.back());
+    BOOST_CHECK(cache.Sync(chain));
+    CheckCache(cache, chain);
+
+    // And shrunk when the chain is rewound
+    chain.SetTip(&vMain[150]);
+    BOOST_CHECK(cache.Sync(chain));
+    CheckCache(cache, chain);
+
+    cache.SetEnabled(false);
+    BOOST_CHECK(!cache.Sync(chain));
+    BOOST_CHECK_EQUAL(cache.Size(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,78 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <iblt.h>
+
+#include <clientversion.h>
+#include <streams.h>
+#include <uint256.h>
+
+#include <test/test_dash.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(iblt_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(iblt_reconcile)
+{
+    std::vector<uint256> vecCommon, vecOursOnly, vecTheirsOnly;
+    for (int i = 0; i < 1000; i++) {
+        vecCommon.push_back(InsecureRand256());
+    }
+    for (int i = 0; i < 30; i++) {
+        vecOursOnly.push_back(InsecureRand256());
+        vecTheirsOnly.push_back(InsecureRand256());
+    }
+
+    CInvertibleBloomLookupTable iblt(1000, InsecureRandBits(64));
+    for (const uint256& hash : vecCommon) {
+        iblt.Insert(hash);
+    }
+    for (const uint256& hash : vecOursOnly) {
+        iblt.Insert(hash);
+    }
+
+    // The table survives being sent to the peer
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << iblt;
+    BOOST_CHECK(ss.size() <= MAX_IBLT_SIZE);
+    CInvertibleBloomLookupTable ibltPeer;
+    ss >> ibltPeer;
+
+    for (const uint256& hash : vecCommon) {
+        ibltPeer.Erase(hash);
+    }
+    for (const uint256& hash : vecTheirsOnly) {
+        ibltPeer.Erase(hash);
+    }
+
+    std::set<uint64_t> setInserted, setErased;
+    BOOST_CHECK(ibltPeer.Decode(setInserted, setErased));
+    BOOST_CHECK_EQUAL(setInserted.size(), vecOursOnly.size());
+    BOOST_CHECK_EQUAL(setErased.size(), vecTheirsOnly.size());
+    for (const uint256& hash : vecOursOnly) {
+        BOOST_CHECK(setInserted.count(ibltPeer.GetShortId(hash)));
+    }
+    for (const uint256& hash : vecTheirsOnly) {
+        BOOST_CHECK(setErased.count(ibltPeer.GetShortId(hash)));
+    }
+
+    // A difference much larger than the table was made for can't be decoded
+    for (int i = 0; i < 5000; i++) {
+        ibltPeer.Erase(InsecureRand256());
+    }
+    BOOST_CHECK(!ibltPeer.Decode(setInserted, setErased));
+}
+
+BOOST_AUTO_TEST_CASE(iblt_invalid_size)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << uint64_t(0) << std::vector<unsigned char>();
+    CInvertibleBloomLookupTable iblt;
+    BOOST_CHECK_THROW(ss >> iblt, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,112 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <llmq/quorums_bitset.h>
+
+#include <random.h>
+#include <streams.h>
+#include <test/test_dash.h>
+#include <version.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace llmq;
+
+static std::vector<bool> RandomBits(size_t size, uint32_t oneIn)
+{
+    std::vector<bool> ret(size);
+    for (size_t i = 0; i < size; i++) {
+        ret[i] = InsecureRandRange(oneIn) == 0;
+    }
+    return ret;
+}
+
+BOOST_FIXTURE_TEST_SUITE(llmq_bitset_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(bitset_ops)
+{
+    for (size_t size : {0, 1, 50, 63, 64, 65, 128, 400}) {
+        std::vector<bool> a = RandomBits(size, 3);
+        std::vector<bool> b = RandomBits(size, 2);
+        CQuorumBitSet bsA(a), bsB(b);
+        BOOST_CHECK_EQUAL(bsA.size(), size);
+        BOOST_CHECK(bsA.ToVector() == a);
+        BOOST_CHECK_EQUAL(bsA.Count(), (size_t)std::count(a.begin(), a.end(), true));
+        BOOST_CHECK_EQUAL(bsA.Any(), bsA.Count() != 0);
+
+        size_t countAnd = 0;
+        std::vector<bool> vOr(size), vAnd(size);
+        for (size_t i = 0; i < size; i++) {
+            vOr[i] = a[i] || b[i];
+            vAnd[i] = a[i] && b[i];
+            countAnd += vAnd[i];
+        }
+        BOOST_CHECK_EQUAL(bsA.CountAnd(bsB), countAnd);
+        CQuorumBitSet bsOr = bsA;
+        bsOr |= bsB;
+        BOOST_CHECK(bsOr.ToVector() == vOr);
+        CQuorumBitSet bsAnd = bsA;
+        bsAnd &= bsB;
+        BOOST_CHECK(bsAnd.ToVector() == vAnd);
+
+        std::vector<size_t> setBits;
+        for (size_t i = bsA.FindNext(0); i < bsA.size(); i = bsA.FindNext(i + 1)) {
+            setBits.emplace_back(i);
+        }
+        std::vector<size_t> expected;
+        for (size_t i = 0; i < size; i++) {
+            if (a[i]) expected.emplace_back(i);
+        }
+        BOOST_CHECK(setBits == expected);
+
+        bsA.SetAll(true);
+        BOOST_CHECK_EQUAL(bsA.Count(), size);
+        bsA.resize(size + 10);
+        BOOST_CHECK_EQUAL(bsA.Count(), size);
+        bsA.SetAll(false);
+        BOOST_CHECK(!bsA.Any());
+    }
+
+    CQuorumBitSet bs(100);
+    bs.set(99);
+    bs.set(3);
+    BOOST_CHECK(bs.test(99) && bs[3] && !bs[4]);
+    BOOST_CHECK_EQUAL(bs.FindNext(4), 99U);
+    bs.reset(99);
+    BOOST_CHECK_EQUAL(bs.FindNext(4), 100U);
+}
+
+BOOST_AUTO_TEST_CASE(bitset_serialization)
+{
+    // must produce the same bytes as AUTOBITSET, for both the sparse (VarInts) and the dense (fixed) encoding
+    for (uint32_t oneIn : {1, 2, 50, 1000}) {
+        for (size_t size : {1, 7, 8, 9, 50, 64, 400}) {
+            std::vector<bool> vec = RandomBits(size, oneIn);
+            CQuorumBitSet bs(vec);
+
+            CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION), ss2(SER_NETWORK, PROTOCOL_VERSION);
+            ss1 << AUTOBITSET(vec, size);
+            ss2 << QUORUMAUTOBITSET(bs, size);
+            BOOST_CHECK(ss1.str() == ss2.str());
+
+            CQuorumBitSet bs2;
+            ss1 >> QUORUMAUTOBITSET(bs2, size);
+            BOOST_CHECK(bs2 == bs);
+            std::vector<bool> vec2;
+            ss2 >> AUTOBITSET(vec2, size);
+            BOOST_CHECK(vec2 == vec);
+        }
+    }
+
+    // bits beyond the size and out of range indexes are rejected
+    CQuorumBitSet bs;
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << (uint8_t)0 << (uint8_t)0x80;
+    BOOST_CHECK_THROW(ss >> QUORUMAUTOBITSET(bs, 7), std::ios_base::failure);
+    ss.clear();
+    ss << (uint8_t)1 << VARINT((uint32_t)8) << VARINT((uint32_t)0);
+    BOOST_CHECK_THROW(ss >> QUORUMAUTOBITSET(bs, 7), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
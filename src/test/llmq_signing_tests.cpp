@@ -0,0 +1,157 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/test_dash.h>
+
+#include <dbwrapper.h>
+#include <llmq/quorums_signing.h>
+#include <llmq/quorums_signing_shares.h>
+#include <llmq/quorums_signing_stats.h>
+#include <llmq/quorums_utils.h>
+#include <random.h>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace llmq;
+
+static CRecoveredSig MakeRecoveredSig()
+{
+    CRecoveredSig recSig;
+    recSig.llmqType = Consensus::LLMQ_50_60;
+    recSig.quorumHash = InsecureRand256();
+    recSig.id = InsecureRand256();
+    recSig.msgHash = InsecureRand256();
+    recSig.UpdateHash();
+    return recSig;
+}
+
+BOOST_FIXTURE_TEST_SUITE(llmq_signing_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(recsigs_filter)
+{
+    CRecoveredSigsFilter filter(1000, 0.01);
+
+    std::vector<uint256> keys;
+    for (size_t i = 0; i < 1000; i++) {
+        keys.emplace_back(InsecureRand256());
+        filter.insert(CRecoveredSigsFilter::KEY_HASH, keys.back());
+    }
+    BOOST_CHECK(filter.IsFull());
+
+    for (const auto& key : keys) {
+        BOOST_CHECK(filter.contains(CRecoveredSigsFilter::KEY_HASH, key));
+    }
+
+    // key types and LLMQ types are not mixed up
+    size_t falsePositives = 0;
+    for (const auto& key : keys) {
+        if (filter.contains(CRecoveredSigsFilter::KEY_SIGN_HASH, key) || filter.contains(CRecoveredSigsFilter::KEY_ID, key, Consensus::LLMQ_50_60)) {
+            falsePositives++;
+        }
+    }
+    for (size_t i = 0; i < 1000; i++) {
+        if (filter.contains(CRecoveredSigsFilter::KEY_HASH, InsecureRand256())) {
+            falsePositives++;
+        }
+    }
+    BOOST_CHECK(falsePositives < 100);
+}
+
+BOOST_AUTO_TEST_CASE(recsigs_db_filter)
+{
+    CDBWrapper dbw(GetDataDir() / "llmq_signing_tests", 1 << 20, true);
+    CRecoveredSigsDb db(dbw);
+
+    auto recSig = MakeRecoveredSig();
+    auto signHash = CLLMQUtils::BuildSignHash(recSig);
+    BOOST_CHECK(!db.HasRecoveredSigForId(recSig.llmqType, recSig.id));
+    BOOST_CHECK(!db.HasRecoveredSigForSession(signHash));
+    BOOST_CHECK(!db.HasRecoveredSigForHash(recSig.GetHash()));
+
+    db.WriteRecoveredSig(recSig);
+    BOOST_CHECK(db.HasRecoveredSig(recSig.llmqType, recSig.id, recSig.msgHash));
+    BOOST_CHECK(db.HasRecoveredSigForId(recSig.llmqType, recSig.id));
+    BOOST_CHECK(db.HasRecoveredSigForSession(signHash));
+    BOOST_CHECK(db.HasRecoveredSigForHash(recSig.GetHash()));
+
+    // the filter is rebuilt from what's in the db
+    auto recSig2 = MakeRecoveredSig();
+    db.WriteRecoveredSig(recSig2);
+    db.RemoveRecoveredSig(recSig.llmqType, recSig.id);
+    db.RebuildFilter();
+    BOOST_CHECK(!db.HasRecoveredSigForId(recSig.llmqType, recSig.id));
+    BOOST_CHECK(!db.HasRecoveredSigForHash(recSig.GetHash()));
+    BOOST_CHECK(db.HasRecoveredSigForId(recSig2.llmqType, recSig2.id));
+    BOOST_CHECK(db.HasRecoveredSigForSession(CLLMQUtils::BuildSignHash(recSig2)));
+    BOOST_CHECK(db.HasRecoveredSigForHash(recSig2.GetHash()));
+
+    // so is a new instance using the same db
+    CRecoveredSigsDb db2(dbw);
+    BOOST_CHECK(db2.HasRecoveredSigForHash(recSig2.GetHash()));
+    BOOST_CHECK(!db2.HasRecoveredSigForHash(recSig.GetHash()));
+}
+
+BOOST_AUTO_TEST_CASE(recovery_latency_histogram)
+{
+    CRecoveryLatencyHistogram h;
+    h.Add(0);
+    h.Add(50);
+    h.Add(51);
+    h.Add(10000);
+    h.Add(60000);
+
+    BOOST_CHECK_EQUAL(h.count, 5);
+    BOOST_CHECK_EQUAL(h.sumMs, 70101);
+    BOOST_CHECK_EQUAL(h.maxMs, 60000);
+    // bucket limits are inclusive upper bounds
+    BOOST_CHECK_EQUAL(h.counts[0], 2);
+    BOOST_CHECK_EQUAL(h.counts[1], 1);
+    BOOST_CHECK_EQUAL(h.counts[CRecoveryLatencyHistogram::BUCKET_COUNT - 2], 1);
+    BOOST_CHECK_EQUAL(h.counts[CRecoveryLatencyHistogram::BUCKET_COUNT - 1], 1);
+}
+
+BOOST_AUTO_TEST_CASE(signing_stats)
+{
+    CSigningStats stats;
+    const int64_t nTime = GetTimeMicros();
+
+    // a member sees all stages, each of them is measured from the previous one
+    for (int i = 0; i < 100; i++) {
+        uint256 signHash = InsecureRand256();
+        stats.AddStage(Consensus::LLMQ_50_60, signHash, SigStage::REQUESTED, nTime);
+        stats.AddStage(Consensus::LLMQ_50_60, signHash, SigStage::SIGNED, nTime + 1000);
+        // only the first time counts
+        stats.AddStage(Consensus::LLMQ_50_60, signHash, SigStage::REQUESTED, nTime + 1500);
+        stats.AddStage(Consensus::LLMQ_50_60, signHash, SigStage::FIRST_SHARE, nTime + 2000);
+        stats.AddStage(Consensus::LLMQ_50_60, signHash, SigStage::RECOVERED, nTime + (i + 3) * 1000);
+        BOOST_CHECK_EQUAL(stats.GetTraceCount(), 1);
+        stats.AddStage(Consensus::LLMQ_50_60, signHash, SigStage::PROCESSED, nTime + (i + 3) * 1000);
+    }
+    // a non-member only sees the recovered signature
+    uint256 signHash = InsecureRand256();
+    stats.AddStage(Consensus::LLMQ_400_60, signHash, SigStage::RECOVERED, nTime);
+    stats.AddStage(Consensus::LLMQ_400_60, signHash, SigStage::PROCESSED, nTime + 3000);
+    BOOST_CHECK_EQUAL(stats.GetTraceCount(), 0);
+
+    auto result = stats.GetStats();
+    BOOST_CHECK_EQUAL(result.size(), 2);
+    const auto& s = result.at(Consensus::LLMQ_50_60);
+    BOOST_CHECK_EQUAL(s[(size_t)SigStage::REQUESTED].count, 0);
+    BOOST_CHECK_EQUAL(s[(size_t)SigStage::SIGNED].count, 100);
+    BOOST_CHECK_EQUAL(s[(size_t)SigStage::SIGNED].p50, 1);
+    BOOST_CHECK_EQUAL(s[(size_t)SigStage::THRESHOLD].count, 0);
+    BOOST_CHECK_EQUAL(s[(size_t)SigStage::RECOVERED].p50, 50);
+    BOOST_CHECK_EQUAL(s[(size_t)SigStage::RECOVERED].p99, 99);
+    BOOST_CHECK_EQUAL(s[(size_t)SigStage::PROCESSED].p99, 0);
+    BOOST_CHECK_EQUAL(s[CSigningStats::STAGE_COUNT].count, 100);
+    BOOST_CHECK_EQUAL(s[CSigningStats::STAGE_COUNT].p50, 52);
+    BOOST_CHECK_EQUAL(result.at(Consensus::LLMQ_400_60)[(size_t)SigStage::PROCESSED].p50, 3);
+
+    // sessions which never finish are dropped eventually
+    stats.AddStage(Consensus::LLMQ_50_60, InsecureRand256(), SigStage::REQUESTED, nTime);
+    stats.AddStage(Consensus::LLMQ_50_60, InsecureRand256(), SigStage::REQUESTED, nTime + CSigningStats::MAX_TRACE_AGE + 60 * 1000 * 1000);
+    BOOST_CHECK_EQUAL(stats.GetTraceCount(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
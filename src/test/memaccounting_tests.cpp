@@ -0,0 +1,50 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memaccounting.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(memaccounting_tests, BasicTestingSetup)
+
+static size_t GetUsage(const CMemoryAccounting& accounting, const std::string& strName)
+{
+    for (const auto& p : accounting.GetUsages()) {
+        if (p.first == strName) {
+            return p.second;
+        }
+    }
+    return 0;
+}
+
+BOOST_AUTO_TEST_CASE(memaccounting_register)
+{
+    CMemoryAccounting accounting;
+    int a, b;
+    size_t nUsage = 100;
+    accounting.Register("b", &a, [&]() { return nUsage; });
+    accounting.Register("a", &a, []() { return 1; });
+    auto usages = accounting.GetUsages();
+    BOOST_REQUIRE_EQUAL(usages.size(), 2U);
+    BOOST_CHECK_EQUAL(usages[0].first, "a");
+    BOOST_CHECK_EQUAL(usages[1].second, 100U);
+
+    // The functions are called for each query
+    nUsage = 200;
+    BOOST_CHECK_EQUAL(GetUsage(accounting, "b"), 200U);
+
+    // A new owner replaces the registration and the old one can't remove it anymore
+    accounting.Register("b", &b, []() { return 300; });
+    BOOST_CHECK_EQUAL(GetUsage(accounting, "b"), 300U);
+    accounting.Unregister("b", &a);
+    BOOST_CHECK_EQUAL(GetUsage(accounting, "b"), 300U);
+    accounting.Unregister("b", &b);
+    BOOST_CHECK_EQUAL(accounting.GetUsages().size(), 1U);
+    accounting.Unregister("a", &a);
+    BOOST_CHECK(accounting.GetUsages().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -592,6 +592,53 @@ inline CTransactionRef make_tx(std::vector<CAmount>&& output_values, std::vector
 #define MK_INPUTS(txs...) std::vector<CTransactionRef>{txs}
 #define MK_INPUT_IDX(idxes...) std::vector<uint32_t>{idxes}
 
+BOOST_AUTO_TEST_CASE(MempoolBatchedTrimTest)
+{
+    // Batched and one-by-one eviction must pick the same TXs as long as evicting a package doesn't change the
+    // descendant score of any other package
+    CTxMemPool poolSingle, poolBatched;
+    TestMemPoolEntryHelper entry;
+
+    std::vector<CMutableTransaction> txs;
+    for (int i = 0; i < 10; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = 10 * COIN;
+        txs.emplace_back(tx);
+    }
+    // A low fee parent with a high fee child, both must be kept or evicted together
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].prevout = COutPoint(txs[0].GetHash(), 0);
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    txChild.vout[0].nValue = 10 * COIN;
+
+    size_t nLimit = 0;
+    for (CTxMemPool* pool : {&poolSingle, &poolBatched}) {
+        LOCK(pool->cs);
+        for (size_t i = 0; i < txs.size(); i++) {
+            pool->addUnchecked(txs[i].GetHash(), entry.Fee(i == 0 ? 100LL : 1000LL * i).FromTx(txs[i]));
+        }
+        pool->addUnchecked(txChild.GetHash(), entry.Fee(20000LL).FromTx(txChild));
+        nLimit = pool->DynamicMemoryUsage() / 2;
+    }
+
+    poolSingle.TrimToSize(nLimit);
+    poolBatched.TrimToSize(nLimit, nullptr, true);
+    BOOST_CHECK(poolBatched.DynamicMemoryUsage() <= nLimit);
+    BOOST_CHECK_EQUAL(poolSingle.size(), poolBatched.size());
+    for (const auto& tx : txs) {
+        BOOST_CHECK_EQUAL(poolSingle.exists(tx.GetHash()), poolBatched.exists(tx.GetHash()));
+    }
+    BOOST_CHECK(poolBatched.exists(txs[0].GetHash()));
+    BOOST_CHECK(poolBatched.exists(txChild.GetHash()));
+    BOOST_CHECK(!poolBatched.exists(txs[1].GetHash()));
+}
+
 BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
 {
     size_t ancestors, descendants;
@@ -751,4 +798,178 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 6ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAddressIndexTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CCoinsView coinsDummy;
+    CCoinsViewCache view(&coinsDummy);
+
+    const uint160 keyHash(std::vector<unsigned char>(20, 0x11));
+    const uint160 otherKeyHash(std::vector<unsigned char>(20, 0x22));
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < 3; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << i;
+        tx.vout.resize(2);
+        for (auto& out : tx.vout) {
+            out.scriptPubKey = CScript() << OP_DUP << OP_HASH160 << ToByteVector(keyHash) << OP_EQUALVERIFY << OP_CHECKSIG;
+            out.nValue = COIN;
+        }
+        txs.emplace_back(MakeTransactionRef(tx));
+    }
+
+    auto getDeltas = [&](const uint160& hash) {
+        std::vector<std::pair<uint160, int>> addresses{{hash, 1}};
+        std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>> results;
+        BOOST_CHECK(pool.getAddressIndex(addresses, results));
+        return results;
+    };
+
+    for (const auto& tx : txs) {
+        pool.addAddressIndex(entry.FromTx(*tx), view);
+    }
+    auto deltas = getDeltas(keyHash);
+    BOOST_CHECK_EQUAL(deltas.size(), 6U);
+    for (size_t i = 1; i < deltas.size(); i++) {
+        BOOST_CHECK(CMempoolAddressDeltaKeyCompare()(deltas[i - 1].first, deltas[i].first));
+    }
+    BOOST_CHECK(getDeltas(otherKeyHash).empty());
+
+    // Removing and re-adding a TX before the bucket is compacted must not duplicate its deltas
+    pool.removeAddressIndex(txs[0]->GetHash());
+    pool.addAddressIndex(entry.FromTx(*txs[0]), view);
+    deltas = getDeltas(keyHash);
+    BOOST_CHECK_EQUAL(deltas.size(), 6U);
+    BOOST_CHECK_EQUAL(std::count_if(deltas.begin(), deltas.end(), [&](const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& d) {
+        return d.first.txhash == txs[0]->GetHash();
+    }), 2);
+
+    // Removed TXs must not show up anymore, no matter whether their deltas were compacted away already
+    pool.removeAddressIndex(txs[0]->GetHash());
+    BOOST_CHECK_EQUAL(getDeltas(keyHash).size(), 4U);
+    pool.removeAddressIndex(txs[1]->GetHash());
+    deltas = getDeltas(keyHash);
+    BOOST_CHECK_EQUAL(deltas.size(), 2U);
+    for (const auto& delta : deltas) {
+        BOOST_CHECK(delta.first.txhash == txs[2]->GetHash());
+    }
+    pool.removeAddressIndex(txs[2]->GetHash());
+    BOOST_CHECK(getDeltas(keyHash).empty());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSnapshotTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(2);
+    for (auto& out : txParent.vout) {
+        out.scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        out.nValue = 10 * COIN;
+    }
+    // Spends both outputs of the parent, but must only depend on it once
+    CMutableTransaction txChild;
+    txChild.vin.resize(2);
+    for (int i = 0; i < 2; i++) {
+        txChild.vin[i].prevout = COutPoint(txParent.GetHash(), i);
+    }
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 19 * COIN;
+
+    BOOST_CHECK(pool.GetSnapshot() == nullptr);
+    {
+        LOCK(pool.cs);
+        pool.addUnchecked(txParent.GetHash(), entry.Fee(10000LL).FromTx(txParent));
+    }
+    pool.UpdateSnapshot();
+    CTxMemPoolSnapshotPtr snapshot1 = pool.GetSnapshot();
+    BOOST_REQUIRE(snapshot1 != nullptr);
+    BOOST_CHECK_EQUAL(snapshot1->vEntries.size(), 1U);
+
+    // Nothing changed, so the same snapshot is kept
+    pool.UpdateSnapshot();
+    BOOST_CHECK(pool.GetSnapshot() == snapshot1);
+
+    {
+        LOCK(pool.cs);
+        pool.addUnchecked(txChild.GetHash(), entry.Fee(20000LL).FromTx(txChild));
+    }
+    pool.UpdateSnapshot();
+    CTxMemPoolSnapshotPtr snapshot2 = pool.GetSnapshot();
+    BOOST_CHECK(snapshot2 != snapshot1);
+
+    // Published snapshots are never modified
+    BOOST_CHECK_EQUAL(snapshot1->vEntries.size(), 1U);
+    BOOST_CHECK(snapshot1->Get(txChild.GetHash()) == nullptr);
+    BOOST_CHECK(snapshot1->Get(txParent.GetHash())->vSpentBy.empty());
+
+    BOOST_CHECK_EQUAL(snapshot2->vEntries.size(), 2U);
+    const CTxMemPoolSnapshotEntry* parent = snapshot2->Get(txParent.GetHash());
+    const CTxMemPoolSnapshotEntry* child = snapshot2->Get(txChild.GetHash());
+    BOOST_REQUIRE(parent != nullptr && child != nullptr);
+    BOOST_CHECK(parent->vDepends.empty());
+    BOOST_CHECK(parent->vSpentBy == std::vector<uint256>{txChild.GetHash()});
+    BOOST_CHECK(child->vDepends == std::vector<uint256>{txParent.GetHash()});
+    BOOST_CHECK(child->vSpentBy.empty());
+    BOOST_CHECK_EQUAL(parent->nFee, 10000LL);
+    BOOST_CHECK_EQUAL(parent->nCountWithDescendants, 2U);
+    BOOST_CHECK_EQUAL(parent->nModFeesWithDescendants, 30000LL);
+    BOOST_CHECK_EQUAL(child->nCountWithAncestors, 2U);
+
+    pool.removeRecursive(txParent);
+    pool.UpdateSnapshot();
+    BOOST_CHECK(pool.GetSnapshot()->vEntries.empty());
+    BOOST_CHECK_EQUAL(snapshot2->vEntries.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolGetAllTxsTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+
+    // a few independent TXs with different feerates and a chain spending the first one
+    std::vector<CMutableTransaction> txs(6);
+    for (size_t i = 0; i < txs.size(); i++) {
+        txs[i].vin.resize(1);
+        if (i < 3) {
+            txs[i].vin[0].scriptSig = CScript() << OP_11 << (int64_t)i;
+        } else {
+            txs[i].vin[0].prevout = COutPoint(txs[i - (i == 3 ? 3 : 1)].GetHash(), 0);
+        }
+        txs[i].vout.resize(1);
+        txs[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txs[i].vout[0].nValue = COIN;
+        LOCK(pool.cs);
+        pool.addUnchecked(txs[i].GetHash(), entry.Fee(1000LL * (7 - i) * (i % 2 + 1)).FromTx(txs[i]));
+    }
+
+    auto getHashes = [](const std::vector<CTransactionRef>& v) {
+        std::vector<uint256> ret;
+        for (const auto& tx : v) {
+            ret.emplace_back(tx->GetHash());
+        }
+        return ret;
+    };
+    std::vector<CTransactionRef> vInfoTxs;
+    for (const auto& info : pool.infoAll()) {
+        vInfoTxs.emplace_back(info.tx);
+    }
+    std::vector<uint256> expected = getHashes(vInfoTxs);
+
+    // live mempool and snapshot give the same order
+    BOOST_CHECK(getHashes(pool.GetAllTxs()) == expected);
+    pool.UpdateSnapshot();
+    BOOST_CHECK(getHashes(pool.GetAllTxs()) == expected);
+
+    // parents always come first
+    BOOST_CHECK(std::find(expected.begin(), expected.end(), txs[0].GetHash()) < std::find(expected.begin(), expected.end(), txs[3].GetHash()));
+    BOOST_CHECK(std::find(expected.begin(), expected.end(), txs[4].GetHash()) < std::find(expected.begin(), expected.end(), txs[5].GetHash()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
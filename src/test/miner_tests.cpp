@@ -41,11 +41,12 @@ private:
 
 static CFeeRate blockMinFeeRate = CFeeRate(DEFAULT_BLOCK_MIN_TX_FEE);
 
-static BlockAssembler AssemblerForTest(const CChainParams& params) {
+static BlockAssembler AssemblerForTest(const CChainParams& params, bool fFastValidityCheck = false) {
     BlockAssembler::Options options;
 
     options.nBlockMaxSize = DEFAULT_BLOCK_MAX_SIZE;
     options.blockMinFeeRate = blockMinFeeRate;
+    options.fFastValidityCheck = fFastValidityCheck;
     return BlockAssembler(params, options);
 }
 
@@ -536,6 +537,13 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     BOOST_CHECK(pblocktemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey));
     BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 5);
 
+    // The fast validity check must accept the same template
+    std::unique_ptr<CBlockTemplate> pfasttemplate;
+    BOOST_CHECK(pfasttemplate = AssemblerForTest(chainparams, true).CreateNewBlock(scriptPubKey));
+    BOOST_CHECK(pfasttemplate->fFastValidityCheck);
+    BOOST_CHECK_EQUAL(pfasttemplate->block.vtx.size(), pblocktemplate->block.vtx.size());
+    BOOST_CHECK(*pfasttemplate->block.vtx[0] == *pblocktemplate->block.vtx[0]);
+
     CValidationState state;
     InvalidateBlock(state, chainparams, chainActive.Tip());
 
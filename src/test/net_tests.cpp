@@ -241,4 +241,105 @@ BOOST_AUTO_TEST_CASE(ipv4_peer_with_ipv6_addrMe_test)
     BOOST_CHECK(1);
 }
 
+BOOST_AUTO_TEST_CASE(net_buffer_pool)
+{
+    typedef CNetBufferPool<std::vector<unsigned char>> Pool;
+    Pool pool;
+
+    // empty pool: allocate, rounded up to the size class
+    std::vector<unsigned char> buf = pool.Get(1000);
+    BOOST_CHECK(buf.empty());
+    BOOST_CHECK_GE(buf.capacity(), 1024U);
+    buf.resize(1000);
+    const unsigned char* pData = buf.data();
+    pool.Put(std::move(buf));
+
+    CNetBufferPoolStats stats = pool.GetStats();
+    BOOST_CHECK_EQUAL(stats.nHits, 0U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 1U);
+    BOOST_CHECK_EQUAL(stats.nPooledBuffers, 1U);
+
+    // the same allocation is handed out again, and is empty
+    std::vector<unsigned char> buf2 = pool.Get(700);
+    BOOST_CHECK(buf2.empty());
+    BOOST_CHECK(buf2.data() == pData);
+    stats = pool.GetStats();
+    BOOST_CHECK_EQUAL(stats.nHits, 1U);
+    BOOST_CHECK_EQUAL(stats.nPooledBuffers, 0U);
+    BOOST_CHECK_EQUAL(stats.nPooledBytes, 0U);
+
+    // a buffer from a smaller class can't serve a larger request
+    pool.Put(std::move(buf2));
+    std::vector<unsigned char> buf3 = pool.Get(4096);
+    BOOST_CHECK_GE(buf3.capacity(), 4096U);
+    BOOST_CHECK_EQUAL(pool.GetStats().nMisses, 2U);
+    BOOST_CHECK_EQUAL(pool.GetStats().nPooledBuffers, 1U);
+
+    // tiny and huge buffers are not pooled
+    std::vector<unsigned char> tiny;
+    tiny.reserve(16);
+    pool.Put(std::move(tiny));
+    std::vector<unsigned char> huge;
+    huge.reserve(4 << Pool::MAX_CLASS_SHIFT);
+    pool.Put(std::move(huge));
+    BOOST_CHECK_EQUAL(pool.GetStats().nPooledBuffers, 1U);
+
+    // every size class keeps a limited number of buffers
+    for (size_t i = 0; i < Pool::MAX_CLASS_BUFFERS * 2; i++) {
+        std::vector<unsigned char> b;
+        b.reserve(256);
+        pool.Put(std::move(b));
+    }
+    BOOST_CHECK_EQUAL(pool.GetStats().nPooledBuffers, 1U + Pool::MAX_CLASS_BUFFERS);
+}
+
+BOOST_AUTO_TEST_CASE(cnetmessage_recv_buffer_pool)
+{
+    const CNetBufferPoolStats statsBefore = g_recv_buffer_pool.GetStats();
+
+    CDataStream hdr(SER_NETWORK, PROTOCOL_VERSION);
+    std::vector<char> payload(100, 'x');
+    hdr << CMessageHeader(Params().MessageStart(), "ping", payload.size());
+
+    for (int i = 0; i < 2; i++) {
+        CNetMessage msg(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
+        BOOST_CHECK_EQUAL(msg.readHeader(&hdr[0], hdr.size()), (int)hdr.size());
+        BOOST_CHECK_EQUAL(msg.readData(payload.data(), payload.size()), (int)payload.size());
+        BOOST_CHECK(msg.complete());
+        BOOST_CHECK_EQUAL(msg.vRecv.size(), payload.size());
+    }
+
+    // the payload buffer of the first message was reused by the second one
+    const CNetBufferPoolStats statsAfter = g_recv_buffer_pool.GetStats();
+    BOOST_CHECK_EQUAL(statsAfter.nHits + statsAfter.nMisses, statsBefore.nHits + statsBefore.nMisses + 2);
+    BOOST_CHECK_GE(statsAfter.nHits, statsBefore.nHits + 1);
+    BOOST_CHECK_GE(statsAfter.nPooledBuffers, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(net_msg_processing_stats)
+{
+    CConnman connman(0, 0);
+    CAddress addr(CService(CNetAddr(), 7777), NODE_NETWORK);
+    std::unique_ptr<CNode> pnode = MakeUnique<CNode>(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress{}, std::string{}, false);
+
+    connman.RecordMsgProcessing(pnode.get(), NetMsgType::INV, 10);
+    connman.RecordMsgProcessing(pnode.get(), NetMsgType::INV, 30);
+    // unknown commands are accounted together
+    connman.RecordMsgProcessing(pnode.get(), "junk1", 5);
+    connman.RecordMsgProcessing(pnode.get(), "junk2", 5);
+
+    mapMsgCmdProcessing mapProcessing = connman.GetMsgProcessingStats();
+    BOOST_CHECK_EQUAL(mapProcessing.size(), 2U);
+    BOOST_CHECK_EQUAL(mapProcessing[NetMsgType::INV].nCount, 2U);
+    BOOST_CHECK_EQUAL(mapProcessing[NetMsgType::INV].nTimeMicros, 40);
+    BOOST_CHECK_EQUAL(mapProcessing[NetMsgType::INV].nMaxTimeMicros, 30);
+    BOOST_CHECK_EQUAL(mapProcessing["*other*"].nCount, 2U);
+
+    CNodeStats stats;
+    pnode->copyStats(stats);
+    BOOST_CHECK_EQUAL(stats.nProcessingTimeMicros, 50);
+    BOOST_CHECK_EQUAL(stats.mapProcessingPerMsgCmd.size(), 2U);
+    BOOST_CHECK_EQUAL(stats.mapProcessingPerMsgCmd["*other*"].nTimeMicros, 10);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
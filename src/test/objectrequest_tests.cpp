@@ -0,0 +1,118 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <objectrequest.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(objectrequest_tests, BasicTestingSetup)
+
+static std::chrono::microseconds ExpiryInterval(int type)
+{
+    return std::chrono::seconds{type == MSG_TX ? 600 : 100};
+}
+
+BOOST_AUTO_TEST_CASE(objectrequest_due_order)
+{
+    CObjectRequestTracker tracker;
+    CInv inv1(MSG_TX, InsecureRand256()), inv2(MSG_TX, InsecureRand256()), inv3(MSG_ISLOCK, InsecureRand256());
+    const std::chrono::microseconds t{std::chrono::seconds{1000}};
+
+    BOOST_CHECK(tracker.ReceivedInv(1, inv1, t + std::chrono::seconds{2}, 10));
+    BOOST_CHECK(tracker.ReceivedInv(1, inv2, t, 10));
+    BOOST_CHECK(tracker.ReceivedInv(1, inv3, t + std::chrono::seconds{5}, 10));
+    // duplicates and announcements above the limit are refused
+    BOOST_CHECK(!tracker.ReceivedInv(1, inv1, t, 10));
+    BOOST_CHECK(!tracker.ReceivedInv(2, inv1, t, 0));
+    BOOST_CHECK_EQUAL(tracker.CountAnnounced(1), 3U);
+    BOOST_CHECK_EQUAL(tracker.CountAnnounced(2), 0U);
+
+    CInv inv;
+    BOOST_CHECK(!tracker.GetNextDue(1, t - std::chrono::seconds{1}, inv));
+    BOOST_CHECK(!tracker.GetNextDue(2, t + std::chrono::seconds{10}, inv));
+    BOOST_CHECK(tracker.GetNextDue(1, t + std::chrono::seconds{10}, inv));
+    BOOST_CHECK(inv.hash == inv2.hash);
+
+    tracker.RequestedObject(1, inv2, t);
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(1), 1U);
+    BOOST_CHECK_EQUAL(tracker.CountQueued(1), 2U);
+    BOOST_CHECK(tracker.GetNextDue(1, t + std::chrono::seconds{10}, inv));
+    BOOST_CHECK(inv.hash == inv1.hash);
+
+    // requeued behind inv3
+    tracker.Requeue(1, inv1, t + std::chrono::seconds{6});
+    BOOST_CHECK(tracker.GetNextDue(1, t + std::chrono::seconds{10}, inv));
+    BOOST_CHECK(inv.hash == inv3.hash);
+
+    // only requests are removed by ForgetRequest
+    BOOST_CHECK(!tracker.ForgetRequest(1, inv3));
+    BOOST_CHECK(tracker.ForgetRequest(1, inv2));
+    BOOST_CHECK(!tracker.ForgetRequest(1, inv2));
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(1), 0U);
+    BOOST_CHECK_EQUAL(tracker.Size(), 2U);
+
+    tracker.DisconnectedPeer(1);
+    BOOST_CHECK_EQUAL(tracker.Size(), 0U);
+    BOOST_CHECK_EQUAL(tracker.CountAnnounced(1), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(objectrequest_request_time)
+{
+    CObjectRequestTracker tracker;
+    CInv inv(MSG_TX, InsecureRand256());
+    const std::chrono::microseconds t{std::chrono::seconds{1000}};
+
+    for (NodeId peer = 0; peer < 3; peer++) {
+        BOOST_CHECK(tracker.ReceivedInv(peer, inv, t, 10));
+    }
+    BOOST_CHECK(tracker.GetLastRequestTime(inv.hash).count() == 0);
+
+    tracker.RequestedObject(0, inv, t);
+    tracker.RequestedObject(1, inv, t + std::chrono::seconds{60});
+    BOOST_CHECK(tracker.GetLastRequestTime(inv.hash) == t + std::chrono::seconds{60});
+
+    // the other peers don't wait for a request which was answered with NOTFOUND
+    BOOST_CHECK(tracker.ForgetRequest(1, inv));
+    BOOST_CHECK(tracker.GetLastRequestTime(inv.hash) == t);
+    tracker.ResetRequestTime(inv.hash);
+    BOOST_CHECK(tracker.GetLastRequestTime(inv.hash).count() == 0);
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(0), 1U);
+
+    // receiving the object drops it from all peers
+    tracker.ForgetHash(inv.hash);
+    BOOST_CHECK_EQUAL(tracker.Size(), 0U);
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(0), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(objectrequest_expiry)
+{
+    CObjectRequestTracker tracker;
+    CInv tx(MSG_TX, InsecureRand256()), islock(MSG_ISLOCK, InsecureRand256()), queued(MSG_TX, InsecureRand256());
+    const std::chrono::microseconds t{std::chrono::seconds{1000}};
+
+    BOOST_CHECK(tracker.ReceivedInv(1, tx, t, 10));
+    BOOST_CHECK(tracker.ReceivedInv(1, islock, t, 10));
+    BOOST_CHECK(tracker.ReceivedInv(1, queued, t, 10));
+    BOOST_CHECK(tracker.ReceivedInv(2, tx, t, 10));
+    tracker.RequestedObject(1, tx, t);
+    tracker.RequestedObject(1, islock, t);
+    tracker.RequestedObject(2, tx, t);
+
+    BOOST_CHECK(tracker.ExpireRequests(1, t + std::chrono::seconds{99}, ExpiryInterval).empty());
+    auto expired = tracker.ExpireRequests(1, t + std::chrono::seconds{100}, ExpiryInterval);
+    BOOST_REQUIRE_EQUAL(expired.size(), 1U);
+    BOOST_CHECK(expired[0].hash == islock.hash);
+    expired = tracker.ExpireRequests(1, t + std::chrono::seconds{600}, ExpiryInterval);
+    BOOST_REQUIRE_EQUAL(expired.size(), 1U);
+    BOOST_CHECK(expired[0].hash == tx.hash);
+
+    // queued announcements and the requests of other peers stay
+    BOOST_CHECK_EQUAL(tracker.CountQueued(1), 1U);
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(1), 0U);
+    BOOST_CHECK_EQUAL(tracker.CountInFlight(2), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
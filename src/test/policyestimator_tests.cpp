@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <clientversion.h>
 #include <policy/fees.h>
 #include <txmempool.h>
 #include <uint256.h>
@@ -10,6 +11,7 @@
 #include <test/test_dash.h>
 
 #include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(policyestimator_tests, BasicTestingSetup)
 
@@ -179,4 +181,62 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BlockPolicyEstimatesAsyncAndPersist)
+{
+    // Feed the same TXs and blocks into an estimator processing them right away and one processing them in the
+    // background, both must end up with the same estimates. Those must then survive a write/read cycle.
+    CBlockPolicyEstimator feeEstSync, feeEstAsync;
+    boost::thread worker(boost::bind(&CBlockPolicyEstimator::ThreadMain, &feeEstAsync));
+    CTxMemPool mpoolSync(&feeEstSync), mpoolAsync(&feeEstAsync);
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(128, 'X');
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 0LL;
+
+    for (int blocknum = 0; blocknum < 100; blocknum++) {
+        std::vector<CTransactionRef> block;
+        for (int j = 0; j < 10; j++) {
+            tx.vin[0].prevout.n = 100 * blocknum + j;
+            CTxMemPoolEntry e = entry.Fee(1000 * (j + 1)).Time(GetTime()).Height(blocknum).FromTx(tx);
+            // Lower fee TXs take longer to be mined
+            if (j >= blocknum % 10) {
+                block.push_back(e.GetSharedTx());
+            }
+            for (CTxMemPool* pool : {&mpoolSync, &mpoolAsync}) {
+                LOCK(pool->cs);
+                pool->addUnchecked(tx.GetHash(), e);
+            }
+        }
+        for (CTxMemPool* pool : {&mpoolSync, &mpoolAsync}) {
+            LOCK(pool->cs);
+            pool->removeForBlock(block, blocknum + 1);
+        }
+    }
+
+    for (int i = 1; i <= 24; i++) {
+        BOOST_CHECK(feeEstSync.estimateFee(i) == feeEstAsync.estimateFee(i));
+    }
+    worker.interrupt();
+    worker.join();
+
+    FILE* file = tmpfile();
+    BOOST_REQUIRE(file != nullptr);
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK(feeEstAsync.Write(fileout));
+    rewind(fileout.Get());
+    CBlockPolicyEstimator feeEstRead;
+    BOOST_CHECK(feeEstRead.Read(fileout));
+    for (int i = 1; i <= 24; i++) {
+        BOOST_CHECK(feeEstRead.estimateFee(i) == feeEstAsync.estimateFee(i));
+        for (auto horizon : {FeeEstimateHorizon::SHORT_HALFLIFE, FeeEstimateHorizon::MED_HALFLIFE, FeeEstimateHorizon::LONG_HALFLIFE}) {
+            if ((unsigned int)i <= feeEstAsync.HighestTargetTracked(horizon)) {
+                BOOST_CHECK(feeEstRead.estimateRawFee(i, 0.85, horizon) == feeEstAsync.estimateRawFee(i, 0.85, horizon));
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
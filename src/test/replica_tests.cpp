@@ -0,0 +1,76 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <dbwrapper.h>
+#include <replica.h>
+#include <test/test_dash.h>
+#include <util.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(replica_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(replica_snapshot)
+{
+    const fs::path primary = GetDataDir() / "primary";
+    const int N = 2000;
+    std::vector<uint256> values(N);
+    for (auto& v : values) {
+        v = InsecureRand256();
+    }
+
+    // the primary keeps its database open and writes on after the snapshot
+    CDBWrapper dbPrimary(primary / "testdb", 1 << 20);
+    for (int i = 0; i < N / 2; i++) {
+        BOOST_CHECK(dbPrimary.Write(i, values[i]));
+    }
+    dbPrimary.CompactFull();
+    for (int i = N / 2; i < N; i++) {
+        BOOST_CHECK(dbPrimary.Write(i, values[i], true));
+    }
+
+    gArgs.ForceSetArg("-readonlyreplica", primary.string());
+    std::string strError;
+    BOOST_REQUIRE_MESSAGE(SnapshotReplicaDatabases(strError), strError);
+    BOOST_CHECK(dbPrimary.Write(N, values[0], true));
+
+    fReadOnlyReplica = true;
+    {
+        // both the compacted tables and the log of the primary are seen, its later writes aren't
+        CDBWrapper dbReplica(GetDataDir() / "testdb", 1 << 20);
+        uint256 v;
+        for (int i = 0; i < N; i++) {
+            BOOST_CHECK(dbReplica.Read(i, v) && v == values[i]);
+        }
+        BOOST_CHECK(!dbReplica.Exists(N));
+
+        // and the replica's own writes and compactions don't reach the tables it shares with the primary
+        for (int i = 0; i < N; i++) {
+            BOOST_CHECK(dbReplica.Write(i, values[N - 1 - i]));
+        }
+        dbReplica.CompactFull();
+    }
+    fReadOnlyReplica = false;
+    uint256 v;
+    for (int i = 0; i < N; i++) {
+        BOOST_CHECK(dbPrimary.Read(i, v) && v == values[i]);
+    }
+    gArgs.ForceSetArg("-readonlyreplica", "");
+
+    // a replica of itself
+    gArgs.ForceSetArg("-readonlyreplica", GetDataDir().string());
+    BOOST_CHECK(!SnapshotReplicaDatabases(strError));
+    gArgs.ForceSetArg("-readonlyreplica", "");
+}
+
+BOOST_AUTO_TEST_CASE(replica_rpc_commands)
+{
+    BOOST_CHECK(IsReplicaRPCCommand("getblock"));
+    BOOST_CHECK(IsReplicaRPCCommand("getrawtransaction"));
+    BOOST_CHECK(!IsReplicaRPCCommand("sendrawtransaction"));
+    BOOST_CHECK(!IsReplicaRPCCommand("submitblock"));
+    BOOST_CHECK(!IsReplicaRPCCommand("invalidateblock"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
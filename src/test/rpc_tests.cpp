@@ -4,6 +4,7 @@
 
 #include <rpc/server.h>
 #include <rpc/client.h>
+#include <rpc/jsonstream.h>
 
 #include <core_io.h>
 #include <key_io.h>
@@ -311,6 +312,59 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+BOOST_AUTO_TEST_CASE(rpc_json_stream)
+{
+    UniValue expected(UniValue::VOBJ);
+    UniValue arr(UniValue::VARR);
+    std::string output;
+    // A tiny chunk size, so that every piece gets flushed right away
+    JSONStreamWriter writer([&](const std::string& chunk) {
+        BOOST_CHECK(!chunk.empty());
+        output += chunk;
+    }, 1);
+    writer.BeginObject();
+    writer.Key("result");
+    BOOST_CHECK(writer.ExpectsValue());
+    JSONResultBuilder builder(&writer, UniValue::VARR);
+    for (int i = 0; i < 3; i++) {
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("n", i);
+        obj.pushKV("s", "\"quoted\"");
+        builder.push_back(obj);
+        arr.push_back(obj);
+    }
+    BOOST_CHECK(builder.Finish().isNull());
+    BOOST_CHECK(!writer.ExpectsValue());
+    expected.pushKV("result", arr);
+    writer.Key("empty\n");
+    JSONResultBuilder(&writer, UniValue::VOBJ).Finish();
+    expected.pushKV("empty\n", UniValue(UniValue::VOBJ));
+    writer.Key("error");
+    writer.Value(NullUniValue);
+    expected.pushKV("error", NullUniValue);
+    writer.EndObject();
+    BOOST_CHECK_EQUAL(writer.GetDepth(), 0U);
+    writer.Flush();
+    BOOST_CHECK(writer.IsFlushed());
+    BOOST_CHECK_EQUAL(output, expected.write());
+
+    // Without a writer the result is collected
+    JSONResultBuilder collect(nullptr, UniValue::VARR);
+    collect.push_back(1);
+    BOOST_CHECK_EQUAL(collect.Finish().write(), "[1]");
+
+    // Small output stays buffered
+    bool fCalled = false;
+    JSONStreamWriter buffered([&](const std::string&) { fCalled = true; });
+    buffered.BeginArray();
+    buffered.Value("a");
+    buffered.Value(2);
+    buffered.EndArray();
+    BOOST_CHECK(!buffered.IsFlushed());
+    BOOST_CHECK_EQUAL(buffered.TakeBuffer(), "[\"a\",2]");
+    BOOST_CHECK(!fCalled);
+}
+
 #if ENABLE_MINER
 BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
 {
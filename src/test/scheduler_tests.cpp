@@ -7,6 +7,8 @@
 
 #include <test/test_dash.h>
 
+#include <atomic>
+
 #include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
@@ -154,4 +156,49 @@ BOOST_AUTO_TEST_CASE(singlethreadedscheduler_ordered)
     BOOST_CHECK_EQUAL(counter2, 100);
 }
 
+BOOST_AUTO_TEST_CASE(scheduler_named_queues)
+{
+    CScheduler scheduler;
+    boost::thread_group threads;
+    for (int i = 0; i < 5; ++i) {
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    }
+
+    // tasks of the same queue never run at the same time and run in the order of their times, even with more threads
+    // than queues. These counters are not atomic for that reason
+    int counter1 = 0;
+    int counter2 = 0;
+    std::atomic<int> running1{0};
+    std::atomic<int> counterOther{0};
+    for (int i = 0; i < 100; ++i) {
+        scheduler.scheduleFromNow([i, &counter1, &running1]() {
+            BOOST_CHECK_EQUAL(++running1, 1);
+            BOOST_CHECK_EQUAL(i, counter1++);
+            MicroSleep(100);
+            running1--;
+        }, i / 10, "queue1");
+        scheduler.scheduleFromNow([i, &counter2]() {
+            BOOST_CHECK_EQUAL(i, counter2++);
+        }, i / 10, "queue2");
+        scheduler.scheduleFromNow([&counterOther]() {
+            counterOther++;
+        }, i / 10);
+    }
+
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(counter1, 100);
+    BOOST_CHECK_EQUAL(counter2, 100);
+    BOOST_CHECK_EQUAL(counterOther, 100);
+
+    auto stats = scheduler.GetQueueStats();
+    BOOST_CHECK_EQUAL(stats["queue1"].nTasks, 100U);
+    BOOST_CHECK_EQUAL(stats["queue2"].nTasks, 100U);
+    BOOST_CHECK_EQUAL(stats[""].nTasks, 100U);
+    BOOST_CHECK_EQUAL(stats["queue1"].nPending, 0U);
+    BOOST_CHECK(stats["queue1"].nMaxMicros >= 100);
+    BOOST_CHECK(stats["queue1"].nTotalMicros >= 100 * 100);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,7 @@
 #include <core_io.h>
 #include <key.h>
 #include <keystore.h>
+#include <primitives/block.h>
 #include <script/script.h>
 #include <script/script_error.h>
 #include <script/sign.h>
@@ -176,6 +177,34 @@ void DoTest(const CScript& scriptPubKey, const CScript& scriptSig, int flags, co
     int libconsensus_flags = flags & dashconsensus_SCRIPT_FLAGS_VERIFY_ALL;
     if (libconsensus_flags == flags) {
         BOOST_CHECK_MESSAGE(dashconsensus_verify_script(scriptPubKey.data(), scriptPubKey.size(), (const unsigned char*)&stream[0], stream.size(), 0, libconsensus_flags, nullptr) == expect,message);
+
+        dashconsensus_spent_output spentOutput{scriptPubKey.data(), (unsigned int)scriptPubKey.size()};
+        BOOST_CHECK_MESSAGE(dashconsensus_verify_tx((const unsigned char*)&stream[0], stream.size(), &spentOutput, 1, libconsensus_flags, 1, nullptr, nullptr) == expect, message);
+
+        dashconsensus_tx_context* context = dashconsensus_tx_context_create((const unsigned char*)&stream[0], stream.size(), nullptr);
+        BOOST_CHECK(context != nullptr);
+        // The second call takes the signature hash from the context
+        for (int i = 0; i < 2; i++) {
+            BOOST_CHECK_MESSAGE(dashconsensus_verify_script_with_context(scriptPubKey.data(), scriptPubKey.size(), context, 0, libconsensus_flags, nullptr) == expect, message);
+        }
+        dashconsensus_tx_context_destroy(context);
+
+        // The spending transaction twice in a block, verified by two threads
+        CBlock block;
+        block.vtx.push_back(MakeTransactionRef(txCredit));
+        block.vtx.push_back(MakeTransactionRef(tx2));
+        block.vtx.push_back(MakeTransactionRef(tx2));
+        CDataStream blockStream(SER_NETWORK, PROTOCOL_VERSION);
+        blockStream << block;
+        dashconsensus_spent_output blockSpentOutputs[] = {spentOutput, spentOutput};
+        unsigned int nFailedTx = 0, nFailedIn = 0;
+        dashconsensus_error blockErr;
+        BOOST_CHECK_MESSAGE(dashconsensus_verify_block((const unsigned char*)&blockStream[0], blockStream.size(), blockSpentOutputs, 2, libconsensus_flags, 2, &nFailedTx, &nFailedIn, &blockErr) == expect, message);
+        BOOST_CHECK_EQUAL(blockErr, dashconsensus_ERR_OK);
+        if (!expect) {
+            BOOST_CHECK_EQUAL(nFailedTx, 1U);
+            BOOST_CHECK_EQUAL(nFailedIn, 0U);
+        }
     }
 #endif
 }
@@ -161,6 +161,36 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+BOOST_AUTO_TEST_CASE(sighash_cache)
+{
+    SeedInsecureRand(false);
+
+    for (int i = 0; i < 1000; i++) {
+        int nHashType = InsecureRand32();
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        CScript scriptCode, scriptCode2;
+        RandomScript(scriptCode);
+        RandomScript(scriptCode2);
+        int nIn = InsecureRandRange(txTo.vin.size());
+        const CTransaction tx(txTo);
+
+        PrecomputedTransactionData txdata(tx);
+        txdata.sighashCache = std::make_shared<SighashCache>(tx.vin.size());
+
+        uint256 sh = SignatureHash(scriptCode, tx, nIn, nHashType, 0, SigVersion::BASE);
+        // Miss, then a hit, both must match the uncached hash
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SigVersion::BASE, &txdata) == sh);
+        uint256 cached;
+        BOOST_CHECK(txdata.sighashCache->Get(nIn, nHashType, scriptCode, cached));
+        BOOST_CHECK(cached == sh);
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, 0, SigVersion::BASE, &txdata) == sh);
+        // A different script code or hash type must not be served from the cache
+        BOOST_CHECK(SignatureHash(scriptCode2, tx, nIn, nHashType, 0, SigVersion::BASE, &txdata) == SignatureHash(scriptCode2, tx, nIn, nHashType, 0, SigVersion::BASE));
+        BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType ^ 0x80, 0, SigVersion::BASE, &txdata) == SignatureHash(scriptCode, tx, nIn, nHashType ^ 0x80, 0, SigVersion::BASE));
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
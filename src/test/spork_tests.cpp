@@ -0,0 +1,73 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <spork.h>
+
+#include <clientversion.h>
+#include <key_io.h>
+#include <streams.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(spork_tests, TestingSetup)
+
+static void SetupSporkKey(CSporkManager& sporkManagerIn, const CKey& key, bool fPrivKey)
+{
+    BOOST_CHECK(sporkManagerIn.SetSporkAddress(EncodeDestination(key.GetPubKey().GetID())));
+    BOOST_CHECK(sporkManagerIn.SetMinSporkKeys(1));
+    if (fPrivKey) {
+        BOOST_CHECK(sporkManagerIn.SetPrivKey(EncodeSecret(key)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(spork_values)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CSporkManager sporkManagerTest;
+    SetupSporkKey(sporkManagerTest, key, true);
+
+    BOOST_CHECK_EQUAL(sporkManagerTest.GetSporkValue(SPORK_2_INSTANTSEND_ENABLED), 4070908800LL);
+    BOOST_CHECK(!sporkManagerTest.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED));
+
+    BOOST_CHECK(sporkManagerTest.UpdateSpork(SPORK_2_INSTANTSEND_ENABLED, 0, *g_connman));
+    BOOST_CHECK_EQUAL(sporkManagerTest.GetSporkValue(SPORK_2_INSTANTSEND_ENABLED), 0);
+    BOOST_CHECK(sporkManagerTest.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED));
+    // Other sporks keep their defaults
+    BOOST_CHECK(!sporkManagerTest.IsSporkActive(SPORK_19_CHAINLOCKS_ENABLED));
+
+    // The cached active state is dropped when the spork is turned off again
+    BOOST_CHECK(sporkManagerTest.UpdateSpork(SPORK_2_INSTANTSEND_ENABLED, 4070908800LL, *g_connman));
+    BOOST_CHECK(!sporkManagerTest.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED));
+    BOOST_CHECK(sporkManagerTest.UpdateSpork(SPORK_2_INSTANTSEND_ENABLED, 1, *g_connman));
+    BOOST_CHECK(sporkManagerTest.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED));
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << sporkManagerTest;
+
+    // A restored cache is only used with the same spork key
+    CDataStream ss2(ss);
+    CSporkManager sporkManagerLoaded;
+    SetupSporkKey(sporkManagerLoaded, key, false);
+    ss >> sporkManagerLoaded;
+    sporkManagerLoaded.CheckAndRemove();
+    BOOST_CHECK_EQUAL(sporkManagerLoaded.GetSporkValue(SPORK_2_INSTANTSEND_ENABLED), 1);
+    BOOST_CHECK(sporkManagerLoaded.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED));
+
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+    CSporkManager sporkManagerOther;
+    SetupSporkKey(sporkManagerOther, otherKey, false);
+    ss2 >> sporkManagerOther;
+    sporkManagerOther.CheckAndRemove();
+    BOOST_CHECK_EQUAL(sporkManagerOther.GetSporkValue(SPORK_2_INSTANTSEND_ENABLED), 4070908800LL);
+    BOOST_CHECK(!sporkManagerOther.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED));
+
+    sporkManagerTest.Clear();
+    BOOST_CHECK(!sporkManagerTest.IsSporkActive(SPORK_2_INSTANTSEND_ENABLED));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
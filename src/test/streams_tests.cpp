@@ -113,6 +113,28 @@ BOOST_AUTO_TEST_CASE(streams_vector_reader)
     BOOST_CHECK_THROW(reader >> d, std::ios_base::failure);
 }
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    const unsigned char bytes[] = {1, 255, 3, 4, 5, 6};
+
+    SpanReader reader(SER_NETWORK, INIT_PROTO_VERSION, Span<const unsigned char>(bytes, sizeof(bytes)), 1);
+    BOOST_CHECK_EQUAL(reader.size(), 5);
+    BOOST_CHECK_EQUAL(reader.tell(), 1);
+
+    signed char a;
+    reader >> a;
+    BOOST_CHECK_EQUAL(a, -1);
+
+    unsigned int b;
+    reader >> b;
+    BOOST_CHECK_EQUAL(b, 100992003); // 3,4,5,6 in little-endian base-256
+    BOOST_CHECK(reader.empty());
+
+    // Reading or seeking past the end of the span throws an error.
+    BOOST_CHECK_THROW(reader >> a, std::ios_base::failure);
+    BOOST_CHECK_THROW(SpanReader(SER_NETWORK, INIT_PROTO_VERSION, Span<const unsigned char>(bytes, sizeof(bytes)), 7), std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
 {
     CDataStream data(SER_NETWORK, INIT_PROTO_VERSION);
@@ -0,0 +1,75 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <sync.h>
+
+#include <test/test_dash.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <thread>
+
+BOOST_FIXTURE_TEST_SUITE(sync_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(lock_profile_percentiles)
+{
+    LockProfileStats::Histogram histogram{};
+    BOOST_CHECK_EQUAL(LockProfileStats::GetPercentile(histogram, 50), 0);
+
+    // 90 durations below 2us, 10 below 1024us
+    histogram[1] = 90;
+    histogram[10] = 10;
+    BOOST_CHECK_EQUAL(LockProfileStats::GetPercentile(histogram, 50), 2);
+    BOOST_CHECK_EQUAL(LockProfileStats::GetPercentile(histogram, 90), 2);
+    BOOST_CHECK_EQUAL(LockProfileStats::GetPercentile(histogram, 99), 1024);
+}
+
+BOOST_AUTO_TEST_CASE(lock_profile_contention)
+{
+    ResetLockProfileStats();
+    g_lock_profile = true;
+
+    CCriticalSection cs;
+    std::atomic<bool> fLocked{false};
+    std::thread holder([&] {
+        LOCK(cs);
+        fLocked = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    });
+    while (!fLocked) {
+        std::this_thread::yield();
+    }
+    const int nLine = __LINE__ + 1;
+    { LOCK(cs); }
+    holder.join();
+
+    // Uncontended acquisitions only have their hold time sampled
+    for (int i = 0; i < LOCK_PROFILE_SAMPLE_RATE * 4; i++) {
+        LOCK(cs);
+    }
+    g_lock_profile = false;
+
+    bool fFound = false;
+    uint64_t nHoldSamples = 0;
+    for (const LockProfileStats& stats : GetLockProfileStats()) {
+        if (stats.strName != "cs") continue;
+        nHoldSamples += stats.nHoldSamples;
+        if (stats.nLine == nLine) {
+            fFound = true;
+            BOOST_CHECK_EQUAL(stats.nContentions, 1);
+            BOOST_CHECK(stats.nWaitMicros > 0);
+            BOOST_CHECK_EQUAL(stats.nMaxWaitMicros, stats.nWaitMicros);
+        } else {
+            BOOST_CHECK_EQUAL(stats.nContentions, 0);
+        }
+    }
+    BOOST_CHECK(fFound);
+    BOOST_CHECK(nHoldSamples >= 4);
+
+    ResetLockProfileStats();
+    BOOST_CHECK(GetLockProfileStats().empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
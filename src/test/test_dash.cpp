@@ -7,7 +7,11 @@
 #include <chainparams.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <crypto/aes.h>
+#include <crypto/chacha20.h>
+#include <crypto/poly1305.h>
 #include <crypto/sha256.h>
+#include <hash.h>
 #include <validation.h>
 #include <miner.h>
 #include <net_processing.h>
@@ -17,6 +21,7 @@
 #include <rpc/server.h>
 #include <rpc/register.h>
 #include <script/sigcache.h>
+#include <bls/bls_sigcache.h>
 
 #include <coinjoin/coinjoin.h>
 #include <evo/specialtx.h>
@@ -56,12 +61,17 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     : m_path_root(fs::temp_directory_path() / "test_dash" / strprintf("%lu_%i", (unsigned long)GetTime(), (int)(InsecureRandRange(1 << 30))))
 {
     SHA256AutoDetect();
+    ChaCha20AutoDetect();
+    Poly1305AutoDetect();
+    SipHashAutoDetect();
+    AESAutoDetect();
     RandomInit();
     ECC_Start();
     BLSInit();
     SetupEnvironment();
     SetupNetworking();
     InitSignatureCache();
+    InitBLSSignatureCache();
     InitScriptExecutionCache();
     CCoinJoin::InitStandardDenominations();
     fPrintToDebugLog = false; // don't want to write to debug.log file
@@ -107,7 +117,7 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         connman = g_connman.get();
         pblocktree.reset(new CBlockTreeDB(1 << 20, true));
         pcoinsdbview.reset(new CCoinsViewDB(1 << 23, true));
-        llmq::InitLLMQSystem(*evoDb, true);
+        llmq::InitLLMQSystem(*evoDb, 1 << 20, true);
         pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
         if (!LoadGenesisBlock(chainparams)) {
             throw std::runtime_error("LoadGenesisBlock failed.");
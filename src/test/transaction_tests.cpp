@@ -249,6 +249,16 @@ BOOST_AUTO_TEST_CASE(basic_transaction_tests)
     CValidationState state;
     BOOST_CHECK_MESSAGE(CheckTransaction(tx, state) && state.IsValid(), "Simple deserialized transaction should be valid.");
 
+    // The cached size and the hash of a batch equal the ones computed from the serialization
+    CTransaction ctx(tx);
+    BOOST_CHECK_EQUAL(ctx.GetTotalSize(), vch.size());
+    BOOST_CHECK_EQUAL(::GetSerializeSize(ctx, SER_NETWORK, PROTOCOL_VERSION), vch.size());
+    BOOST_CHECK_EQUAL(::GetSerializeSize(CTransaction(), SER_NETWORK, PROTOCOL_VERSION), ::GetSerializeSize(CMutableTransaction(), SER_NETWORK, PROTOCOL_VERSION));
+    auto vtx = MakeTransactionRefs(std::vector<CMutableTransaction>{tx, CMutableTransaction()});
+    BOOST_CHECK(vtx[0]->GetHash() == Hash(vch.begin(), vch.end()));
+    BOOST_CHECK_EQUAL(vtx[0]->GetTotalSize(), vch.size());
+    BOOST_CHECK(vtx[1]->GetHash() == CMutableTransaction().GetHash());
+
     // Check that duplicate txins fail
     tx.vin.push_back(tx.vin[0]);
     BOOST_CHECK_MESSAGE(!CheckTransaction(tx, state) || !state.IsValid(), "Transaction with duplicate txins should be invalid.");
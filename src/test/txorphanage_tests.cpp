@@ -0,0 +1,136 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txorphanage.h>
+
+#include <test/test_dash.h>
+
+#include <set>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(txorphanage_tests, BasicTestingSetup)
+
+// A transaction spending the given outpoints (or a random one) with nOutputs outputs
+static CTransactionRef MakeTx(const std::vector<COutPoint>& vecPrevouts, size_t nOutputs = 1)
+{
+    CMutableTransaction tx;
+    if (vecPrevouts.empty()) {
+        tx.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    }
+    for (const auto& prevout : vecPrevouts) {
+        tx.vin.emplace_back(prevout);
+    }
+    tx.vout.resize(nOutputs);
+    for (auto& txout : tx.vout) {
+        txout.nValue = InsecureRandRange(1000000);
+    }
+    return MakeTransactionRef(tx);
+}
+
+BOOST_AUTO_TEST_CASE(txorphanage_accounting)
+{
+    CTxOrphanage orphanage;
+    std::vector<CTransactionRef> vecTxs;
+    for (int i = 0; i < 30; i++) {
+        vecTxs.emplace_back(MakeTx({}));
+        BOOST_CHECK(orphanage.AddTx(vecTxs.back(), i % 3, 1000, 100 + i));
+    }
+    BOOST_CHECK(!orphanage.AddTx(vecTxs[0], 1, 1000, 100));
+    BOOST_CHECK_EQUAL(orphanage.Size(), 30U);
+    BOOST_CHECK_EQUAL(orphanage.PeerCount(1), 10U);
+    BOOST_CHECK_EQUAL(orphanage.PeerTxSize(0), 10 * 100 + (0 + 3 + 6 + 9 + 12 + 15 + 18 + 21 + 24 + 27U));
+    BOOST_CHECK_EQUAL(orphanage.TotalTxSize(), 30 * 100 + 29 * 30 / 2U);
+
+    const COrphanTx* orphan = orphanage.GetTx(vecTxs[4]->GetHash());
+    BOOST_REQUIRE(orphan != nullptr);
+    BOOST_CHECK_EQUAL(orphan->fromPeer, 1);
+    BOOST_CHECK_EQUAL(orphan->nTxSize, 104U);
+
+    BOOST_CHECK_EQUAL(orphanage.EraseTx(vecTxs[4]->GetHash()), 1);
+    BOOST_CHECK_EQUAL(orphanage.EraseTx(vecTxs[4]->GetHash()), 0);
+    BOOST_CHECK(!orphanage.HaveTx(vecTxs[4]->GetHash()));
+    BOOST_CHECK_EQUAL(orphanage.PeerCount(1), 9U);
+
+    BOOST_CHECK_EQUAL(orphanage.EraseForPeer(1), 9);
+    BOOST_CHECK_EQUAL(orphanage.PeerCount(1), 0U);
+    BOOST_CHECK_EQUAL(orphanage.PeerTxSize(1), 0U);
+    BOOST_CHECK_EQUAL(orphanage.Size(), 20U);
+    BOOST_CHECK(orphanage.HaveTx(vecTxs[0]->GetHash()));
+    BOOST_CHECK(!orphanage.HaveTx(vecTxs[1]->GetHash()));
+
+    orphanage.Clear();
+    BOOST_CHECK_EQUAL(orphanage.Size(), 0U);
+    BOOST_CHECK_EQUAL(orphanage.TotalTxSize(), 0U);
+    BOOST_CHECK_EQUAL(orphanage.PeerCount(0), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(txorphanage_limits)
+{
+    CTxOrphanage orphanage;
+    for (int i = 0; i < 100; i++) {
+        // peer 0 floods the pool
+        NodeId peer = i < 80 ? 0 : 1 + i % 4;
+        orphanage.AddTx(MakeTx({}), peer, 1000 + i, 100);
+    }
+
+    // Only the flooding peer loses orphans
+    BOOST_CHECK_EQUAL(orphanage.LimitPeerSize(0, 2500), 55);
+    BOOST_CHECK_EQUAL(orphanage.PeerTxSize(0), 2500U);
+    BOOST_CHECK_EQUAL(orphanage.LimitPeerSize(1, 2500), 0);
+    BOOST_CHECK_EQUAL(orphanage.PeerCount(1), 5U);
+    BOOST_CHECK_EQUAL(orphanage.Size(), 45U);
+
+    int64_t nNextExpire = 2000;
+    BOOST_CHECK_EQUAL(orphanage.EraseExpired(999, nNextExpire), 0);
+    BOOST_CHECK(nNextExpire < 1080);
+    nNextExpire = 2000;
+    BOOST_CHECK_EQUAL(orphanage.EraseExpired(1084, nNextExpire), 25 + 5);
+    BOOST_CHECK_EQUAL(nNextExpire, 1085);
+
+    BOOST_CHECK_EQUAL(orphanage.LimitSize(1000), 5);
+    BOOST_CHECK_EQUAL(orphanage.TotalTxSize(), 1000U);
+    BOOST_CHECK_EQUAL(orphanage.LimitSize(0), 10);
+    BOOST_CHECK_EQUAL(orphanage.Size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(txorphanage_children)
+{
+    CTxOrphanage orphanage;
+    CTransactionRef parent = MakeTx({}, 3);
+    CTransactionRef child1 = MakeTx({COutPoint(parent->GetHash(), 0)});
+    CTransactionRef child2 = MakeTx({COutPoint(parent->GetHash(), 1), COutPoint(parent->GetHash(), 2)});
+    CTransactionRef grandchild = MakeTx({COutPoint(child1->GetHash(), 0), COutPoint(child2->GetHash(), 0)});
+    CTransactionRef other = MakeTx({});
+    for (const auto& tx : {child1, child2, grandchild, other}) {
+        orphanage.AddTx(tx, 0, 1000, 100);
+    }
+    BOOST_CHECK_EQUAL(orphanage.PrevoutCount(), 6U);
+
+    // All outputs of the parent at once
+    std::set<uint256> workSet;
+    orphanage.AddChildrenToWorkSet(*parent, workSet);
+    BOOST_CHECK(workSet == std::set<uint256>({child1->GetHash(), child2->GetHash()}));
+    workSet.clear();
+    orphanage.AddChildrenToWorkSet(*child1, workSet);
+    orphanage.AddChildrenToWorkSet(*child2, workSet);
+    BOOST_CHECK(workSet == std::set<uint256>({grandchild->GetHash()}));
+
+    // A block which includes child1 and double spends an input of child2
+    CBlock block;
+    block.vtx.emplace_back(child1);
+    block.vtx.emplace_back(MakeTx({COutPoint(parent->GetHash(), 2)}));
+    BOOST_CHECK_EQUAL(orphanage.EraseForBlock(block), 2);
+    BOOST_CHECK(!orphanage.HaveTx(child1->GetHash()));
+    BOOST_CHECK(!orphanage.HaveTx(child2->GetHash()));
+    BOOST_CHECK(orphanage.HaveTx(grandchild->GetHash()));
+    BOOST_CHECK_EQUAL(orphanage.PrevoutCount(), 3U);
+
+    workSet.clear();
+    orphanage.AddChildrenToWorkSet(*parent, workSet);
+    BOOST_CHECK(workSet.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -307,4 +307,79 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChain100Setup)
     // TODO: add tests for remaining script flags
 }
 
+BOOST_FIXTURE_TEST_CASE(checkinputs_parallel_test, TestChain100Setup)
+{
+    // Transactions with many inputs are checked on the script check threads, make sure the result
+    // (and the rejection reason) is the same as when checking serially.
+    {
+        LOCK(cs_main);
+        InitScriptExecutionCache();
+    }
+    BOOST_CHECK(nScriptCheckThreads > 0);
+
+    CScript p2pkh_scriptPubKey = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    CBasicKeyStore keystore;
+    keystore.AddKey(coinbaseKey);
+
+    const unsigned int nInputs = MIN_PARALLEL_SCRIPT_CHECK_INPUTS + 4;
+    CMutableTransaction split_tx;
+    split_tx.nVersion = 1;
+    split_tx.vin.resize(1);
+    split_tx.vin[0].prevout.hash = coinbaseTxns[0].GetHash();
+    split_tx.vin[0].prevout.n = 0;
+    split_tx.vout.resize(nInputs);
+    for (auto& out : split_tx.vout) {
+        out.nValue = CENT;
+        out.scriptPubKey = p2pkh_scriptPubKey;
+    }
+    BOOST_CHECK(SignSignature(keystore, coinbaseTxns[0], split_tx, 0, SIGHASH_ALL));
+    CreateAndProcessBlock({split_tx}, p2pkh_scriptPubKey);
+
+    CMutableTransaction spend_tx;
+    spend_tx.nVersion = 1;
+    spend_tx.vin.resize(nInputs);
+    for (unsigned int i = 0; i < nInputs; i++) {
+        spend_tx.vin[i].prevout.hash = split_tx.GetHash();
+        spend_tx.vin[i].prevout.n = i;
+    }
+    spend_tx.vout.resize(1);
+    spend_tx.vout[0].nValue = nInputs * CENT / 2;
+    spend_tx.vout[0].scriptPubKey = p2pkh_scriptPubKey;
+    for (unsigned int i = 0; i < nInputs; i++) {
+        BOOST_CHECK(SignSignature(keystore, split_tx, spend_tx, i, SIGHASH_ALL));
+    }
+
+    LOCK(cs_main);
+    {
+        CValidationState state;
+        PrecomputedTransactionData txdata(spend_tx);
+        BOOST_CHECK(CheckInputs(spend_tx, state, pcoinsTip.get(), true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, txdata, nullptr));
+    }
+
+    // Invalidate the signature of one input in the middle
+    CMutableTransaction bad_tx(spend_tx);
+    bad_tx.vin[nInputs / 2].scriptSig = spend_tx.vin[0].scriptSig;
+    {
+        CValidationState state;
+        PrecomputedTransactionData txdata(bad_tx);
+        BOOST_CHECK(!CheckInputs(bad_tx, state, pcoinsTip.get(), true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, txdata, nullptr));
+        BOOST_CHECK_EQUAL(state.GetRejectReason().find("mandatory-script-verify-flag-failed"), 0);
+    }
+
+    // RunScriptChecks gives the same results for a batch of checks, on the worker threads or not
+    for (const CMutableTransaction* pmtx : {&spend_tx, &bad_tx}) {
+        const CTransaction tx(*pmtx);
+        PrecomputedTransactionData txdata(tx);
+        for (unsigned int nChecks : {nInputs, 2u}) {
+            std::vector<CScriptCheck> vChecks;
+            for (unsigned int i = nInputs / 2 - nChecks / 2; i < nInputs / 2 - nChecks / 2 + nChecks; i++) {
+                CScriptCheck check(split_tx.vout[i], tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, false, &txdata);
+                vChecks.emplace_back();
+                check.swap(vChecks.back());
+            }
+            BOOST_CHECK_EQUAL(RunScriptChecks(vChecks), pmtx == &spend_tx);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
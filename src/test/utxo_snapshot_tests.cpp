@@ -0,0 +1,108 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <node/coinstats.h>
+#include <node/utxo_snapshot.h>
+#include <streams.h>
+#include <test/test_dash.h>
+#include <txdb.h>
+
+#include <algorithm>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(utxo_snapshot_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(utxo_snapshot_metadata)
+{
+    SnapshotMetadata metadata;
+    metadata.baseBlockHash = InsecureRand256();
+    metadata.nBaseHeight = 1234;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << metadata;
+    SnapshotMetadata metadata2;
+    ss >> metadata2;
+    BOOST_CHECK(metadata2.baseBlockHash == metadata.baseBlockHash);
+    BOOST_CHECK_EQUAL(metadata2.nBaseHeight, 1234);
+
+    ss << metadata;
+    ss[0] = 'x';
+    BOOST_CHECK_THROW(ss >> metadata2, std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(utxo_snapshot_coins)
+{
+    // The database sorts the coins, so they are written in random order
+    std::vector<std::pair<COutPoint, Coin>> vCoins;
+    for (int i = 0; i < 200; i++) {
+        const uint256 txid = InsecureRand256();
+        const uint32_t nOutputs = 1 + InsecureRandBits(2);
+        for (uint32_t n = 0; n < nOutputs; n++) {
+            CTxOut out(InsecureRandBits(30), CScript() << OP_TRUE << i);
+            vCoins.emplace_back(COutPoint(txid, n * 300), Coin(std::move(out), i, false));
+        }
+    }
+    std::shuffle(vCoins.begin(), vCoins.end(), FastRandomContext());
+
+    // Written as snapshot coins, the database yields the same stats as hashing them in the database's order
+    const uint256 hashBlock = Params().GenesisBlock().GetHash();
+    CCoinsViewDB db(1 << 20, true);
+    BOOST_CHECK(db.WriteSnapshotCoins(vCoins, hashBlock, false));
+    BOOST_CHECK(db.GetHeadBlocks().size() == 2);
+    BOOST_CHECK(db.WriteSnapshotCoins({}, hashBlock, true));
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+
+    CCoinsStats stats;
+    BOOST_CHECK(GetUTXOStats(&db, stats));
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, vCoins.size());
+
+    std::sort(vCoins.begin(), vCoins.end(), [](const std::pair<COutPoint, Coin>& a, const std::pair<COutPoint, Coin>& b) {
+        return a.first < b.first;
+    });
+    CCoinsStatsHasher hasher(hashBlock);
+    for (const auto& p : vCoins) {
+        BOOST_CHECK(hasher.Add(p.first, Coin(p.second)));
+    }
+    CCoinsStats stats2;
+    hasher.Finish(stats2);
+    BOOST_CHECK(stats2.hashSerialized == stats.hashSerialized);
+    BOOST_CHECK_EQUAL(stats2.nTransactions, stats.nTransactions);
+
+    // Out of order and duplicate coins are rejected
+    CCoinsStatsHasher hasher2(hashBlock);
+    BOOST_CHECK(hasher2.Add(vCoins[1].first, Coin(vCoins[1].second)));
+    BOOST_CHECK(!hasher2.Add(vCoins[1].first, Coin(vCoins[1].second)));
+    if (vCoins[0].first.hash != vCoins[1].first.hash) {
+        BOOST_CHECK(!hasher2.Add(vCoins[0].first, Coin(vCoins[0].second)));
+    }
+
+    // Chunks keep the coins of each transaction together
+    SnapshotCoinsChunk chunk;
+    for (const auto& p : vCoins) {
+        if (chunk.vTxs.empty() || chunk.vTxs.back().first != p.first.hash) {
+            chunk.vTxs.emplace_back(p.first.hash, std::vector<std::pair<uint32_t, Coin>>());
+        }
+        chunk.vTxs.back().second.emplace_back(p.first.n, p.second);
+    }
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << chunk;
+    SnapshotCoinsChunk chunk2;
+    ss >> chunk2;
+    BOOST_CHECK_EQUAL(chunk2.vTxs.size(), chunk.vTxs.size());
+    size_t nCoins = 0;
+    for (const auto& tx : chunk2.vTxs) {
+        for (const auto& p : tx.second) {
+            const auto& expected = vCoins[nCoins++];
+            BOOST_CHECK(COutPoint(tx.first, p.first) == expected.first);
+            BOOST_CHECK(p.second.out == expected.second.out);
+            BOOST_CHECK_EQUAL(p.second.nHeight, expected.second.nHeight);
+        }
+    }
+    BOOST_CHECK_EQUAL(nCoins, vCoins.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
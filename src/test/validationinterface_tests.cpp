@@ -0,0 +1,104 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <validationinterface.h>
+
+#include <test/test_dash.h>
+
+#include <chrono>
+#include <future>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
+
+namespace {
+
+class BlockingListener : public CValidationInterface
+{
+public:
+    std::shared_future<void> release;
+    std::atomic<int> nCalls{0};
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime) override
+    {
+        release.wait();
+        nCalls++;
+    }
+};
+
+class CountingListener : public CValidationInterface
+{
+public:
+    std::vector<int64_t> vecAcceptTimes;
+    std::promise<void> reached;
+    int64_t nReachAt{0};
+
+protected:
+    void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime) override
+    {
+        vecAcceptTimes.push_back(nAcceptTime);
+        if (nAcceptTime == nReachAt) {
+            reached.set_value();
+        }
+    }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(validationinterface_listener_queues)
+{
+    // A second thread for the listeners, so one of them can block
+    threadGroup.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+    std::promise<void> release;
+    BlockingListener blocking;
+    blocking.release = release.get_future().share();
+    CountingListener counting;
+    counting.nReachAt = 99;
+    RegisterValidationInterface(&blocking);
+    RegisterValidationInterface(&counting);
+
+    const CTransactionRef tx = MakeTransactionRef();
+    for (int64_t i = 0; i < 100; i++) {
+        GetMainSignals().TransactionAddedToMempool(tx, i);
+    }
+
+    // The blocked listener doesn't hold up the other one, whose callbacks arrive in order
+    BOOST_CHECK(counting.reached.get_future().wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(blocking.nCalls, 0);
+    BOOST_CHECK_EQUAL(counting.vecAcceptTimes.size(), 100);
+    for (int64_t i = 0; i < (int64_t)counting.vecAcceptTimes.size(); i++) {
+        BOOST_CHECK_EQUAL(counting.vecAcceptTimes[i], i);
+    }
+    BOOST_CHECK(GetMainSignals().CallbacksPending() >= 99);
+
+    bool fFoundStats = false;
+    for (const auto& stats : GetMainSignals().GetListenerStats()) {
+        if (stats.strName.find("CountingListener") != std::string::npos) {
+            fFoundStats = true;
+            BOOST_CHECK_EQUAL(stats.nPending, 0);
+            BOOST_CHECK_EQUAL(stats.nCallbacks, 100);
+            BOOST_CHECK(stats.nMaxLagMicros >= stats.nLastLagMicros);
+        }
+    }
+    BOOST_CHECK(fFoundStats);
+
+    release.set_value();
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(blocking.nCalls, 100);
+    BOOST_CHECK_EQUAL(GetMainSignals().CallbacksPending(), 0);
+
+    // Nothing is delivered to unregistered listeners
+    UnregisterValidationInterface(&counting);
+    GetMainSignals().TransactionAddedToMempool(tx, 100);
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(counting.vecAcceptTimes.size(), 100);
+    BOOST_CHECK_EQUAL(blocking.nCalls, 101);
+    UnregisterValidationInterface(&blocking);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,53 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chainparams.h>
+#include <test/test_dash.h>
+#include <utiltime.h>
+#include <validation.h>
+
+#include <boost/test/unit_test.hpp>
+
+static BackgroundVerifyStatus WaitForBackgroundVerify()
+{
+    for (int i = 0; i < 1000 && GetBackgroundVerifyStatus().fRunning; i++) {
+        MilliSleep(10);
+    }
+    StopBackgroundVerifyDB();
+    return GetBackgroundVerifyStatus();
+}
+
+BOOST_AUTO_TEST_SUITE(verifydb_tests)
+
+BOOST_FIXTURE_TEST_CASE(background_verify_chain, TestChain100Setup)
+{
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+
+    // the blocks below the 6 checked at startup, down to block 1
+    StartBackgroundVerifyDB(Params(), 3, 6, -1);
+    BackgroundVerifyStatus status = WaitForBackgroundVerify();
+    BOOST_CHECK(status.fStarted);
+    BOOST_CHECK(!status.fRunning);
+    BOOST_CHECK_EQUAL(status.nCheckLevel, MAX_BACKGROUND_CHECKLEVEL);
+    BOOST_CHECK_EQUAL(status.nStartHeight, nHeight - 6);
+    BOOST_CHECK_EQUAL(status.nStopHeight, 1);
+    BOOST_CHECK_EQUAL(status.nBlocks, nHeight - 6);
+    BOOST_CHECK_EQUAL(status.nVerified, status.nBlocks);
+    BOOST_CHECK_EQUAL(status.nFailedHeight, -1);
+
+    // a limited depth
+    StartBackgroundVerifyDB(Params(), 1, 10, 20);
+    status = WaitForBackgroundVerify();
+    BOOST_CHECK_EQUAL(status.nCheckLevel, 1);
+    BOOST_CHECK_EQUAL(status.nStartHeight, nHeight - 10);
+    BOOST_CHECK_EQUAL(status.nStopHeight, nHeight - 29);
+    BOOST_CHECK_EQUAL(status.nVerified, 20);
+    BOOST_CHECK_EQUAL(status.nFailedHeight, -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
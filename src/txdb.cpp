@@ -6,15 +6,20 @@
 #include <txdb.h>
 
 #include <chainparams.h>
+#include <compat/endian.h>
 #include <hash.h>
 #include <random.h>
 #include <pow.h>
 #include <uint256.h>
 #include <util.h>
+#include <utilmemory.h>
 #include <ui_interface.h>
 #include <init.h>
 
+#include <algorithm>
+#include <set>
 #include <stdint.h>
+#include <string.h>
 
 #include <boost/thread.hpp>
 
@@ -26,6 +31,7 @@ static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
+static const char DB_ADDRESSSUMMARY = 'A';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
@@ -62,15 +68,94 @@ CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(Get
 {
 }
 
+CCoinsViewDB::~CCoinsViewDB()
+{
+    WaitForWrite();
+}
+
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        LOCK(cs_pending);
+        if (pendingCoins) {
+            CCoinsMap::const_iterator it = pendingCoins->find(outpoint);
+            if (it != pendingCoins->end()) {
+                if (it->second.coin.IsSpent()) {
+                    return false;
+                }
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
+size_t CCoinsViewDB::GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins, std::vector<bool>& found) const {
+    coins.assign(outpoints.size(), Coin());
+    found.assign(outpoints.size(), false);
+    size_t nFound = 0;
+
+    std::vector<size_t> vRead;
+    {
+        LOCK(cs_pending);
+        for (size_t i = 0; i < outpoints.size(); i++) {
+            CCoinsMap::const_iterator it;
+            if (pendingCoins && (it = pendingCoins->find(outpoints[i])) != pendingCoins->end()) {
+                if (!it->second.coin.IsSpent()) {
+                    coins[i] = it->second.coin;
+                    found[i] = true;
+                    nFound++;
+                }
+            } else {
+                vRead.push_back(i);
+            }
+        }
+    }
+    if (vRead.empty()) {
+        return nFound;
+    }
+
+    std::vector<CoinEntry> keys;
+    keys.reserve(vRead.size());
+    for (size_t i : vRead) {
+        keys.emplace_back(&outpoints[i]);
+    }
+    std::vector<Coin> vCoins;
+    std::vector<bool> vFound;
+    nFound += db.ReadMulti(keys, vCoins, vFound);
+    for (size_t j = 0; j < vRead.size(); j++) {
+        if (vFound[j]) {
+            coins[vRead[j]] = std::move(vCoins[j]);
+            found[vRead[j]] = true;
+        }
+    }
+    return nFound;
+}
+
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    {
+        LOCK(cs_pending);
+        if (pendingCoins) {
+            CCoinsMap::const_iterator it = pendingCoins->find(outpoint);
+            if (it != pendingCoins->end()) {
+                return !it->second.coin.IsSpent();
+            }
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    {
+        LOCK(cs_pending);
+        if (pendingCoins) {
+            return hashPendingBlock;
+        }
+    }
+    return ReadBestBlock();
+}
+
+uint256 CCoinsViewDB::ReadBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -85,15 +170,8 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
     return vhashHeadBlocks;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
-    CDBBatch batch(db);
-    size_t count = 0;
-    size_t changed = 0;
-    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
-    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
-    assert(!hashBlock.IsNull());
-
-    uint256 old_tip = GetBestBlock();
+void CCoinsViewDB::WriteHeadBlocks(CDBBatch& batch, const uint256& hashBlock) const {
+    uint256 old_tip = ReadBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
@@ -103,12 +181,125 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
     }
 
-    // In the first batch, mark the database as being in the middle of a
+    // Mark the database as being in the middle of a
     // transition from old_tip to hashBlock.
     // A vector is used for future extensibility, as we may want to support
     // interrupting after partial writes from multiple independent reorgs.
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    // Only one write at a time, in whichever mode
+    if (!WaitForWrite()) {
+        return false;
+    }
+    if (!fAsyncWrite) {
+        return WriteCoins(mapCoins, hashBlock, true);
+    }
+    assert(!hashBlock.IsNull());
+
+    // Mark the transition right away, so that whatever the caller commits after this (e.g. evodb)
+    // is never ahead of what ReplayBlocks can recover the coins to
+    CDBBatch batch(db);
+    WriteHeadBlocks(batch, hashBlock);
+    if (!db.WriteBatch(batch, true)) {
+        return false;
+    }
+
+    auto resource = MakeUnique<CCoinsMapMemoryResource>();
+    auto coins = MakeUnique<CCoinsMap>(0, SaltedOutpointHasher(), CCoinsMap::key_equal(), resource.get());
+    size_t nUsage = 0;
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); it = mapCoins.erase(it)) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            nUsage += it->second.coin.DynamicMemoryUsage();
+            coins->emplace(it->first, std::move(it->second));
+        }
+    }
+    nUsage += memusage::DynamicUsage(*coins);
+    LogPrint(BCLog::COINDB, "Writing %u changed transaction outputs in the background\n", (unsigned int)coins->size());
+
+    {
+        LOCK(cs_pending);
+        pendingCoinsResource = std::move(resource);
+        pendingCoins = std::move(coins);
+        hashPendingBlock = hashBlock;
+        nPendingUsage = nUsage;
+    }
+    // The map is never modified while it's pending, so the writer doesn't need cs_pending to read it
+    std::lock_guard<std::mutex> lock(cs_writeThread);
+    writeThread = std::thread([this] {
+        RenameThread("dash-coinsflush");
+        bool fOk = false;
+        try {
+            fOk = WriteCoins(*pendingCoins, hashPendingBlock, false);
+        } catch (const std::exception& e) {
+            LogPrintf("CCoinsViewDB::BatchWrite: %s\n", e.what());
+        }
+        if (!fOk) {
+            LogPrintf("*** Failed to write to coin database in the background\n");
+        }
+        LOCK(cs_pending);
+        fWriteFailed |= !fOk;
+        pendingCoins.reset();
+        pendingCoinsResource.reset();
+        nPendingUsage = 0;
+    });
+    return true;
+}
+
+bool CCoinsViewDB::WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin>>& coins, const uint256& hashBlock, bool fFinal) {
+    if (!WaitForWrite()) {
+        return false;
+    }
+    CDBBatch batch(db);
+    if (fFinal) {
+        batch.Erase(DB_HEAD_BLOCKS);
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+    } else {
+        WriteHeadBlocks(batch, hashBlock);
+    }
+    for (const auto& p : coins) {
+        batch.Write(CoinEntry(&p.first), p.second);
+    }
+    LogPrint(BCLog::COINDB, "Writing %u snapshot coins\n", (unsigned int)coins.size());
+    return db.WriteBatch(batch, fFinal);
+}
+
+void CCoinsViewDB::SetAsyncWrite(bool fAsync) {
+    if (!fAsync) {
+        WaitForWrite();
+    }
+    fAsyncWrite = fAsync;
+}
+
+bool CCoinsViewDB::WaitForWrite() const {
+    {
+        std::lock_guard<std::mutex> lock(cs_writeThread);
+        if (writeThread.joinable()) {
+            writeThread.join();
+        }
+    }
+    LOCK(cs_pending);
+    return !fWriteFailed;
+}
+
+size_t CCoinsViewDB::PendingMemoryUsage() const {
+    LOCK(cs_pending);
+    return nPendingUsage;
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) {
+    CDBBatch batch(db);
+    size_t count = 0;
+    size_t changed = 0;
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
+    assert(!hashBlock.IsNull());
+
+    // In the first batch, mark the database as being in the middle of a
+    // transition to hashBlock.
+    WriteHeadBlocks(batch, hashBlock);
 
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -121,7 +312,9 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
         count++;
         CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase) {
+            mapCoins.erase(itOld);
+        }
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -176,19 +369,38 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
+    // Iterate over the database with everything written to it
+    WaitForWrite();
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+    i->CacheKey();
+    return i;
+}
+
+std::unique_ptr<CDBSnapshot> CCoinsViewDB::NewSnapshot() const
+{
+    WaitForWrite();
+    return std::unique_ptr<CDBSnapshot>(new CDBSnapshot(db));
+}
+
+CCoinsViewCursor *CCoinsViewDB::Cursor(const CDBSnapshot& snapshot, const uint256& start) const
+{
+    std::unique_ptr<CDBIterator> pcursor(db.NewIterator(snapshot));
+    uint256 hashBestChain;
+    char key;
+    pcursor->Seek(DB_BEST_BLOCK);
+    if (!pcursor->Valid() || !pcursor->GetKey(key) || key != DB_BEST_BLOCK || !pcursor->GetValue(hashBestChain)) {
+        hashBestChain.SetNull();
     }
+
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(pcursor.release(), hashBestChain);
+    COutPoint outpoint(start, 0);
+    i->pcursor->Seek(CoinEntry(&outpoint));
+    i->CacheKey();
     return i;
 }
 
@@ -220,6 +432,11 @@ bool CCoinsViewDBCursor::Valid() const
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
+    CacheKey();
+}
+
+void CCoinsViewDBCursor::CacheKey()
+{
     CoinEntry entry(&keyTmp.second);
     if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
         keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
@@ -277,6 +494,61 @@ bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return Read(std::make_pair(DB_SPENTINDEX, key), value);
 }
 
+/** Orders spent index keys like their serialized form, i.e. like they are stored in the database */
+static bool SpentIndexKeyDBLess(const CSpentIndexKey& a, const CSpentIndexKey& b)
+{
+    if (a.txid != b.txid) {
+        return a.txid < b.txid;
+    }
+    uint32_t na = htole32(a.outputIndex);
+    uint32_t nb = htole32(b.outputIndex);
+    return memcmp(&na, &nb, sizeof(na)) < 0;
+}
+
+bool CBlockTreeDB::ReadSpentIndex(std::vector<CSpentIndexKey> keys, CSpentIndexTxInfo& info) {
+    std::sort(keys.begin(), keys.end(), SpentIndexKeyDBLess);
+
+    std::unique_ptr<CDBIterator> pcursor;
+    std::pair<char, CSpentIndexKey> curKey;
+    bool fCur = false; // whether pcursor is at a spent index entry, which is in curKey
+    auto fnNext = [&]() {
+        fCur = pcursor->Valid() && pcursor->GetKey(curKey) && curKey.first == DB_SPENTINDEX;
+    };
+    for (size_t i = 0; i < keys.size(); i++) {
+        const CSpentIndexKey& key = keys[i];
+        bool fRun = (i > 0 && keys[i - 1].txid == key.txid) || (i + 1 < keys.size() && keys[i + 1].txid == key.txid);
+        if (!fRun) {
+            // A lone output of a transaction, a point read can skip most tables thanks to the bloom filters
+            CSpentIndexValue value;
+            if (Read(std::make_pair(DB_SPENTINDEX, key), value)) {
+                info.mSpentInfo.emplace(key, value);
+            }
+            continue;
+        }
+
+        // The outputs of one transaction are next to each other in the index, they are all read after a single seek
+        if (!fCur || curKey.second.txid != key.txid) {
+            if (!pcursor) {
+                pcursor.reset(NewIterator());
+            }
+            pcursor->Seek(std::make_pair(DB_SPENTINDEX, key));
+            fnNext();
+        }
+        while (fCur && curKey.second.txid == key.txid && SpentIndexKeyDBLess(curKey.second, key)) {
+            pcursor->Next();
+            fnNext();
+        }
+        if (fCur && curKey.second.txid == key.txid && curKey.second.outputIndex == key.outputIndex) {
+            CSpentIndexValue value;
+            if (!pcursor->GetValue(value)) {
+                return error("failed to get spent index value");
+            }
+            info.mSpentInfo.emplace(key, value);
+        }
+    }
+    return true;
+}
+
 bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
@@ -302,9 +574,10 @@ bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddres
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                           const CDBSnapshot* snapshot) {
 
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    std::unique_ptr<CDBIterator> pcursor(snapshot ? NewIterator(*snapshot) : NewIterator());
 
     pcursor->Seek(std::make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
 
@@ -327,27 +600,112 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
+CAddressIndexSummary& CBlockTreeDB::GetAddressSummary(AddressSummaryMap& summaries, unsigned int type, const uint160& addressHash) {
+    auto it = summaries.find(std::make_pair(type, addressHash));
+    if (it == summaries.end()) {
+        it = summaries.emplace(std::make_pair(type, addressHash), CAddressIndexSummary()).first;
+        ReadAddressSummary(addressHash, type, it->second);
+    }
+    return it->second;
+}
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    AddressSummaryMap summaries;
+    std::set<std::pair<uint160, uint256> > setCountedTxs;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        const auto key = std::make_pair(DB_ADDRESSINDEX, it->first);
+        // The background index builder may write entries again, only new ones count towards the summary
+        if (!Exists(key)) {
+            CAddressIndexSummary& summary = GetAddressSummary(summaries, it->first.type, it->first.hashBytes);
+            summary.balance += it->second;
+            if (it->second > 0) {
+                summary.received += it->second;
+            }
+            if (setCountedTxs.emplace(it->first.hashBytes, it->first.txhash).second) {
+                summary.txCount++;
+            }
+            if (summary.firstHeight < 0 || it->first.blockHeight < summary.firstHeight) {
+                summary.firstHeight = it->first.blockHeight;
+            }
+            summary.lastHeight = std::max(summary.lastHeight, it->first.blockHeight);
+        }
+        batch.Write(key, it->second);
+    }
+    for (const auto& p : summaries) {
+        batch.Write(std::make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(p.first.first, p.first.second)), p.second);
+    }
     return WriteBatch(batch);
 }
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(std::make_pair(DB_ADDRESSINDEX, it->first));
+    AddressSummaryMap summaries;
+    std::map<std::pair<unsigned int, uint160>, int> mapMinErasedHeight;
+    std::set<std::pair<uint160, uint256> > setCountedTxs;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        const auto key = std::make_pair(DB_ADDRESSINDEX, it->first);
+        if (Exists(key)) {
+            CAddressIndexSummary& summary = GetAddressSummary(summaries, it->first.type, it->first.hashBytes);
+            summary.balance -= it->second;
+            if (it->second > 0) {
+                summary.received -= it->second;
+            }
+            if (setCountedTxs.emplace(it->first.hashBytes, it->first.txhash).second && summary.txCount > 0) {
+                summary.txCount--;
+            }
+            auto itHeight = mapMinErasedHeight.emplace(std::make_pair(it->first.type, it->first.hashBytes), it->first.blockHeight).first;
+            itHeight->second = std::min(itHeight->second, it->first.blockHeight);
+        }
+        batch.Erase(key);
+    }
+
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    for (auto& p : summaries) {
+        const auto summaryKey = std::make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(p.first.first, p.first.second));
+        CAddressIndexSummary& summary = p.second;
+        if (summary.IsNull()) {
+            batch.Erase(summaryKey);
+            continue;
+        }
+        // Entries are only erased when their block gets disconnected, so they are the last ones of the address and
+        // the new last height is the one of the entry right before them
+        const int nMinErasedHeight = mapMinErasedHeight[p.first];
+        if (summary.lastHeight >= nMinErasedHeight) {
+            pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(p.first.first, p.first.second, nMinErasedHeight)));
+            if (pcursor->Valid()) {
+                pcursor->Prev();
+            } else {
+                pcursor->SeekToLast();
+            }
+            std::pair<char, CAddressIndexKey> key;
+            if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.type == p.first.first && key.second.hashBytes == p.first.second) {
+                summary.lastHeight = key.second.blockHeight;
+            } else {
+                summary.lastHeight = summary.firstHeight;
+            }
+        }
+        batch.Write(summaryKey, summary);
+    }
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadAddressSummary(const uint160& addressHash, int type, CAddressIndexSummary& summary) {
+    if (!Read(std::make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(type, addressHash)), summary)) {
+        summary.SetNull();
+        return false;
+    }
+    return true;
+}
+
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
+                                    int start, int end, const CDBSnapshot* snapshot) {
 
-    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    std::unique_ptr<CDBIterator> pcursor(snapshot ? NewIterator(*snapshot) : NewIterator());
 
-    if (start > 0 && end > 0) {
+    // Entries are sorted by height, so start right at the first one of the range
+    if (start > 0) {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
     } else {
         pcursor->Seek(std::make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
@@ -401,6 +759,46 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
+bool CBlockTreeDB::EraseIndex(const std::string& name, size_t nMaxEntries, bool& fDone) {
+    std::vector<char> prefixes;
+    if (name == "txindex") {
+        prefixes = {DB_TXINDEX};
+    } else if (name == "addressindex") {
+        prefixes = {DB_ADDRESSINDEX, DB_ADDRESSUNSPENTINDEX, DB_ADDRESSSUMMARY};
+    } else if (name == "timestampindex") {
+        prefixes = {DB_TIMESTAMPINDEX};
+    } else if (name == "spentindex") {
+        prefixes = {DB_SPENTINDEX};
+    } else {
+        return error("%s: unknown index %s", __func__, name);
+    }
+
+    CDBBatch batch(*this);
+    size_t nErased = 0;
+    std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    for (char prefix : prefixes) {
+        pcursor->Seek(prefix);
+        while (pcursor->Valid() && nErased < nMaxEntries) {
+            boost::this_thread::interruption_point();
+            char key;
+            if (!pcursor->GetKey(key) || key != prefix) {
+                break;
+            }
+            batch.Erase(pcursor->GetKey());
+            nErased++;
+            pcursor->Next();
+        }
+    }
+    fDone = nErased < nMaxEntries;
+
+    bool ret = WriteBatch(batch);
+    if (prefixes[0] == DB_TXINDEX) {
+        LOCK(cs);
+        mapHasTxIndexCache.clear();
+    }
+    return ret;
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -413,7 +811,7 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, bool fVerifyHashes)
 {
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
@@ -444,6 +842,10 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
                 if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, consensusParams))
                     return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
 
+                // The stored hash is trusted by default, only re-derive it from the header when asked to
+                if (fVerifyHashes && pindexNew->GetBlockHeader().GetHash() != pindexNew->GetBlockHash())
+                    return error("%s: stored block hash does not match header: %s", __func__, pindexNew->ToString());
+
                 pcursor->Next();
             } else {
                 return error("%s: failed to read value", __func__);
@@ -15,7 +15,9 @@
 
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -29,6 +31,8 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 300;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -asynccoinsflush default
+static const bool DEFAULT_ASYNC_COINS_FLUSH = true;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -39,6 +43,10 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
+//! Max memory allocated to the block filter index DB specific cache (MiB)
+static const int64_t nMaxBlockFilterIndexCache = 1024;
+//! Max memory allocated to the coin stats index DB specific cache, it is only read by lookups (MiB)
+static const int64_t nMaxCoinStatsIndexCache = 8;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -72,20 +80,70 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+    /**
+     * Coins handed to BatchWrite that the background thread is still writing, or nullptr. The map
+     * itself is only read while it's set, by the writer as well as by lookups holding cs_pending.
+     */
+    mutable CCriticalSection cs_pending;
+    std::unique_ptr<CCoinsMapMemoryResource> pendingCoinsResource;
+    std::unique_ptr<CCoinsMap> pendingCoins;
+    uint256 hashPendingBlock;
+    size_t nPendingUsage{0};
+    bool fWriteFailed{false};
+
+    bool fAsyncWrite{false};
+    mutable std::mutex cs_writeThread;
+    mutable std::thread writeThread;
+
+    uint256 ReadBestBlock() const;
+    void WriteHeadBlocks(CDBBatch& batch, const uint256& hashBlock) const;
+    bool WriteCoins(CCoinsMap& mapCoins, const uint256& hashBlock, bool fErase);
+
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CCoinsViewDB() override;
 
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
+    /** Look up many coins at once with CDBWrapper::ReadMulti, found[i] tells whether coins[i] was found */
+    size_t GetCoins(const std::vector<COutPoint>& outpoints, std::vector<Coin>& coins, std::vector<bool>& found) const;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    /** Writes of the coins database LevelDB delayed to let its compactions catch up */
+    CDBWriteStallStats GetWriteStallStats() const { return db.GetWriteStallStats(); }
+    /** A consistent view of everything written to the database, for cursors that are read by several threads */
+    std::unique_ptr<CDBSnapshot> NewSnapshot() const;
+    /**
+     * Cursor over the coins of snapshot, starting at the first coin whose txid is not lower than start. Its best
+     * block is the one of the snapshot, which is null if the snapshot was taken in the middle of a flush.
+     */
+    CCoinsViewCursor *Cursor(const CDBSnapshot& snapshot, const uint256& start) const;
+    /**
+     * Add coins of a UTXO snapshot whose base block is hashBlock. Until the last batch (fFinal) is written, the
+     * database is marked as being in transition to hashBlock, so an interrupted load can't be mistaken for a
+     * consistent chainstate.
+     */
+    bool WriteSnapshotCoins(const std::vector<std::pair<COutPoint, Coin>>& coins, const uint256& hashBlock, bool fFinal);
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    /**
+     * When enabled, BatchWrite only marks the database as being in transition to the new best block
+     * and moves the dirty coins aside, they are then written on a background thread while lookups
+     * keep seeing them. Only one such write is in flight at a time, a new BatchWrite waits for the
+     * previous one. A crash before it finishes is recovered by ReplayBlocks like any interrupted flush.
+     */
+    void SetAsyncWrite(bool fAsync);
+    //! Wait for the background write to finish, returns false if it (or an earlier one) failed
+    bool WaitForWrite() const;
+    //! Memory held by coins that are still being written in the background
+    size_t PendingMemoryUsage() const;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -107,6 +165,9 @@ private:
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
 
+    //! Cache the key of the record pcursor points to, if it is a coin
+    void CacheKey();
+
     friend class CCoinsViewDB;
 };
 
@@ -117,6 +178,9 @@ private:
     CCriticalSection cs;
     unordered_limitedmap<uint256, bool> mapHasTxIndexCache;
 
+    typedef std::map<std::pair<unsigned int, uint160>, CAddressIndexSummary> AddressSummaryMap;
+    CAddressIndexSummary& GetAddressSummary(AddressSummaryMap& summaries, unsigned int type, const uint160& addressHash);
+
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -132,20 +196,35 @@ public:
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    /** Adds the entries of all keys that are in the index to info, in one pass over the keys sorted */
+    bool ReadSpentIndex(std::vector<CSpentIndexKey> keys, CSpentIndexTxInfo& info);
     bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
-                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+                                 std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                 const CDBSnapshot* snapshot = nullptr);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                          int start = 0, int end = 0);
+                          int start = 0, int end = 0, const CDBSnapshot* snapshot = nullptr);
+    /** Read the totals of all address index entries of an address, which are updated with the entries */
+    bool ReadAddressSummary(const uint160& addressHash, int type, CAddressIndexSummary& summary);
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    /**
+     * Erase up to nMaxEntries entries of the txindex, addressindex, timestampindex or spentindex. fDone is set
+     * if no entries are left afterwards.
+     */
+    bool EraseIndex(const std::string& name, size_t nMaxEntries, bool& fDone);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Load all block index entries. The block hash is stored next to every entry, so X11 is not
+     * recomputed at startup unless fVerifyHashes is set, in which case every stored hash is
+     * checked against its header.
+     */
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, bool fVerifyHashes = false);
 };
 
 #endif // BITCOIN_TXDB_H
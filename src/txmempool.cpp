@@ -45,6 +45,18 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFe
     nSigOpCountWithAncestors = sigOpCount;
 }
 
+void CTxMemPoolEntry::SetTxData(std::shared_ptr<const PrecomputedTransactionData> _txData)
+{
+    txData = std::move(_txData);
+    if (txData) {
+        // Roughly, the signature hash cache keeps a script and a hash per input
+        nUsageSize += memusage::MallocUsage(sizeof(PrecomputedTransactionData));
+        if (txData->sighashCache) {
+            nUsageSize += memusage::MallocUsage(sizeof(SighashCache)) + memusage::MallocUsage(tx->vin.size() * (sizeof(CScript) + sizeof(uint256) + 2 * sizeof(int)));
+        }
+    }
+}
+
 void CTxMemPoolEntry::UpdateFeeDelta(int64_t newFeeDelta)
 {
     nModFeesWithDescendants += newFeeDelta - feeDelta;
@@ -62,39 +74,46 @@ void CTxMemPoolEntry::UpdateLockPoints(const LockPoints& lp)
 // descendants.
 void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
 {
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
+    const EpochGuard epoch(*this);
+    std::vector<txiter> stageEntries, vAllDescendants;
+    for (const CTxMemPoolEntry* child : updateIt->GetMemPoolChildrenConst()) {
+        if (!visited(*child)) {
+            stageEntries.emplace_back(mapTx.iterator_to(*child));
+        }
+    }
 
     while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
-        const setEntries &setChildren = GetMemPoolChildren(cit);
-        for (txiter childEntry : setChildren) {
+        const txiter cit = stageEntries.back();
+        stageEntries.pop_back();
+        vAllDescendants.emplace_back(cit);
+        for (const CTxMemPoolEntry* child : cit->GetMemPoolChildrenConst()) {
+            txiter childEntry = mapTx.iterator_to(*child);
             cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
             if (cacheIt != cachedDescendants.end()) {
                 // We've already calculated this one, just add the entries for this set
                 // but don't traverse again.
                 for (txiter cacheEntry : cacheIt->second) {
-                    setAllDescendants.insert(cacheEntry);
+                    if (!visited(*cacheEntry)) {
+                        vAllDescendants.emplace_back(cacheEntry);
+                    }
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
+            } else if (!visited(*child)) {
                 // Schedule for later processing
-                stageEntries.insert(childEntry);
+                stageEntries.emplace_back(childEntry);
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // vAllDescendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (txiter cit : setAllDescendants) {
+    for (txiter cit : vAllDescendants) {
         if (!setExclude.count(cit->GetTx().GetHash())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetModifiedFee();
             modifyCount++;
-            cachedDescendants[updateIt].insert(cit);
+            cachedDescendants[updateIt].emplace_back(cit);
             // Update ancestor state for each descendant
             mapTx.modify(cit, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCount()));
         }
@@ -152,7 +171,8 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
 
 bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */) const
 {
-    setEntries parentHashes;
+    const EpochGuard epoch(*this);
+    std::vector<txiter> parentHashes;
     const CTransaction &tx = entry.GetTx();
 
     if (fSearchForParents) {
@@ -161,8 +181,8 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         // iterate mapTx to find parents.
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
             txiter piter = mapTx.find(tx.vin[i].prevout.hash);
-            if (piter != mapTx.end()) {
-                parentHashes.insert(piter);
+            if (piter != mapTx.end() && !visited(*piter)) {
+                parentHashes.emplace_back(piter);
                 if (parentHashes.size() + 1 > limitAncestorCount) {
                     errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                     return false;
@@ -172,17 +192,19 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
     } else {
         // If we're not searching for parents, we require this to be an
         // entry in the mempool already.
-        txiter it = mapTx.iterator_to(entry);
-        parentHashes = GetMemPoolParents(it);
+        for (const CTxMemPoolEntry* parent : entry.GetMemPoolParentsConst()) {
+            visited(*parent);
+            parentHashes.emplace_back(mapTx.iterator_to(*parent));
+        }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
     while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+        txiter stageit = parentHashes.back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
+        parentHashes.pop_back();
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -196,11 +218,10 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
             return false;
         }
 
-        const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
-        for (const txiter &phash : setMemPoolParents) {
+        for (const CTxMemPoolEntry* parent : stageit->GetMemPoolParentsConst()) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (!visited(*parent)) {
+                parentHashes.emplace_back(mapTx.iterator_to(*parent));
             }
             if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
@@ -214,10 +235,9 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
 
 void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors)
 {
-    setEntries parentIters = GetMemPoolParents(it);
     // add or remove this tx as a child of each parent
-    for (txiter piter : parentIters) {
-        UpdateChild(piter, it, add);
+    for (const CTxMemPoolEntry* parent : it->GetMemPoolParentsConst()) {
+        UpdateChild(mapTx.iterator_to(*parent), it, add);
     }
     const int64_t updateCount = (add ? 1 : -1);
     const int64_t updateSize = updateCount * it->GetTxSize();
@@ -243,9 +263,8 @@ void CTxMemPool::UpdateEntryForAncestors(txiter it, const setEntries &setAncesto
 
 void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 {
-    const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
-    for (txiter updateIt : setMemPoolChildren) {
-        UpdateParent(updateIt, it, false);
+    for (const CTxMemPoolEntry* child : it->GetMemPoolChildrenConst()) {
+        UpdateParent(mapTx.iterator_to(*child), it, false);
     }
 }
 
@@ -258,7 +277,7 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // updateDescendants should be true whenever we're not recursively
         // removing a tx and all its descendants, eg when a transaction is
         // confirmed in a block.
-        // Here we only update statistics and not data in mapLinks (which
+        // Here we only update statistics and not the parent/child links (which
         // we need to preserve until we're finished with all operations that
         // need to traverse the mempool).
         for (txiter removeIt : entriesToRemove) {
@@ -283,16 +302,16 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
         // should be a bit faster.
         // However, if we happen to be in the middle of processing a reorg, then
         // the mempool can be in an inconsistent state.  In this case, the set
-        // of ancestors reachable via mapLinks will be the same as the set of
+        // of ancestors reachable via the parent links will be the same as the set of
         // ancestors whose packages include this transaction, because when we
         // add a new transaction to the mempool in addUnchecked(), we assume it
         // has no children, and in the case of a reorg where that assumption is
         // false, the in-mempool children aren't linked to the in-block tx's
         // until UpdateTransactionsFromBlock() is called.
         // So if we're being called during a reorg, ie before
-        // UpdateTransactionsFromBlock() has been called, then mapLinks[] will
+        // UpdateTransactionsFromBlock() has been called, then the parent links will
         // differ from the set of mempool parents we'd calculate by searching,
-        // and it's important that we use the mapLinks[] notion of ancestor
+        // and it's important that we use the parent links' notion of ancestor
         // transactions as the set of things to update for removal.
         CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
         // Note that UpdateAncestorsOf severs the child links that point to
@@ -356,6 +375,82 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n)
     nTransactionsUpdated += n;
 }
 
+void CTxMemPool::GetSnapshotEntry(const CTxMemPoolEntry& entry, CTxMemPoolSnapshotEntry& snapshotEntry) const
+{
+    AssertLockHeld(cs);
+    snapshotEntry.tx = entry.GetSharedTx();
+    snapshotEntry.nFee = entry.GetFee();
+    snapshotEntry.nModifiedFee = entry.GetModifiedFee();
+    snapshotEntry.nTxSize = entry.GetTxSize();
+    snapshotEntry.nTime = entry.GetTime();
+    snapshotEntry.nHeight = entry.GetHeight();
+    snapshotEntry.nCountWithDescendants = entry.GetCountWithDescendants();
+    snapshotEntry.nSizeWithDescendants = entry.GetSizeWithDescendants();
+    snapshotEntry.nModFeesWithDescendants = entry.GetModFeesWithDescendants();
+    snapshotEntry.nCountWithAncestors = entry.GetCountWithAncestors();
+    snapshotEntry.nSizeWithAncestors = entry.GetSizeWithAncestors();
+    snapshotEntry.nModFeesWithAncestors = entry.GetModFeesWithAncestors();
+
+    snapshotEntry.vDepends.clear();
+    for (const CTxIn& txin : entry.GetTx().vin) {
+        if (mapTx.count(txin.prevout.hash) &&
+            std::find(snapshotEntry.vDepends.begin(), snapshotEntry.vDepends.end(), txin.prevout.hash) == snapshotEntry.vDepends.end()) {
+            snapshotEntry.vDepends.emplace_back(txin.prevout.hash);
+        }
+    }
+    snapshotEntry.vSpentBy.clear();
+    snapshotEntry.vSpentBy.reserve(entry.GetMemPoolChildrenConst().size());
+    for (const CTxMemPoolEntry* child : entry.GetMemPoolChildrenConst()) {
+        snapshotEntry.vSpentBy.emplace_back(child->GetTx().GetHash());
+    }
+}
+
+void CTxMemPool::UpdateSnapshot()
+{
+    CTxMemPoolSnapshotPtr prev = GetSnapshot();
+    auto newSnapshot = std::make_shared<CTxMemPoolSnapshot>();
+    {
+        LOCK(cs);
+        if (prev && prev->nTransactionsUpdated == nTransactionsUpdated) {
+            return;
+        }
+        newSnapshot->nTime = GetTimeMillis();
+        newSnapshot->nTransactionsUpdated = nTransactionsUpdated;
+        newSnapshot->vEntries.resize(mapTx.size());
+        newSnapshot->mapIndex.reserve(mapTx.size());
+        size_t i = 0;
+        for (const CTxMemPoolEntry& entry : mapTx) {
+            GetSnapshotEntry(entry, newSnapshot->vEntries[i]);
+            newSnapshot->mapIndex.emplace(entry.GetTx().GetHash(), i);
+            i++;
+        }
+        for (const auto& p : mapAddress) {
+            const CAddressDeltaBucket& bucket = p.second;
+            auto& v = newSnapshot->mapAddressDeltas[p.first];
+            v.reserve(bucket.vDeltas.size() - bucket.nRemoved);
+            for (const auto& delta : bucket.vDeltas) {
+                if (bucket.nRemoved == 0 || !bucket.setRemoved.count(delta.first.txhash)) {
+                    v.emplace_back(delta);
+                }
+            }
+        }
+    }
+
+    // Sorting doesn't need the mempool anymore
+    for (auto it = newSnapshot->mapAddressDeltas.begin(); it != newSnapshot->mapAddressDeltas.end();) {
+        if (it->second.empty()) {
+            it = newSnapshot->mapAddressDeltas.erase(it);
+            continue;
+        }
+        std::sort(it->second.begin(), it->second.end(), [](const CTxMemPoolSnapshot::AddressDelta& a, const CTxMemPoolSnapshot::AddressDelta& b) {
+            return CMempoolAddressDeltaKeyCompare()(a.first, b.first);
+        });
+        ++it;
+    }
+
+    std::atomic_store(&snapshot, CTxMemPoolSnapshotPtr(std::move(newSnapshot)));
+}
+
 bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry, setEntries &setAncestors, bool validFeeEstimate)
 {
     NotifyEntryAdded(entry.GetSharedTx());
@@ -363,7 +458,6 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     // Used by AcceptToMemoryPool(), which DOES do
     // all the appropriate checks.
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
-    mapLinks.insert(make_pair(newit, TxLinks()));
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting
@@ -421,26 +515,26 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         if (!proTx.collateralOutpoint.hash.IsNull()) {
             mapProTxRefs.emplace(tx.GetHash(), proTx.collateralOutpoint.hash);
         }
-        mapProTxAddresses.emplace(proTx.addr, tx.GetHash());
-        mapProTxPubKeyIDs.emplace(proTx.keyIDOwner, tx.GetHash());
-        mapProTxBlsPubKeyHashes.emplace(proTx.pubKeyOperator.GetHash(), tx.GetHash());
+        proTxIndex.Add(proTx.addr, tx.GetHash());
+        proTxIndex.Add(proTx.keyIDOwner, tx.GetHash());
+        proTxIndex.Add(proTx.pubKeyOperator, tx.GetHash());
         if (!proTx.collateralOutpoint.hash.IsNull()) {
-            mapProTxCollaterals.emplace(proTx.collateralOutpoint, tx.GetHash());
+            proTxIndex.Add(proTx.collateralOutpoint, tx.GetHash());
         } else {
-            mapProTxCollaterals.emplace(COutPoint(tx.GetHash(), proTx.collateralOutpoint.n), tx.GetHash());
+            proTxIndex.Add(COutPoint(tx.GetHash(), proTx.collateralOutpoint.n), tx.GetHash());
         }
     } else if (tx.nType == TRANSACTION_PROVIDER_UPDATE_SERVICE) {
         CProUpServTx proTx;
         bool ok = GetTxPayload(tx, proTx);
         assert(ok);
         mapProTxRefs.emplace(proTx.proTxHash, tx.GetHash());
-        mapProTxAddresses.emplace(proTx.addr, tx.GetHash());
+        proTxIndex.Add(proTx.addr, tx.GetHash());
     } else if (tx.nType == TRANSACTION_PROVIDER_UPDATE_REGISTRAR) {
         CProUpRegTx proTx;
         bool ok = GetTxPayload(tx, proTx);
         assert(ok);
         mapProTxRefs.emplace(proTx.proTxHash, tx.GetHash());
-        mapProTxBlsPubKeyHashes.emplace(proTx.pubKeyOperator.GetHash(), tx.GetHash());
+        proTxIndex.Add(proTx.pubKeyOperator, tx.GetHash());
         auto dmn = deterministicMNManager->GetListAtChainTip().GetMN(proTx.proTxHash);
         assert(dmn);
         newit->validForProTxKey = ::SerializeHash(dmn->pdmnState->pubKeyOperator);
@@ -463,13 +557,34 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     return true;
 }
 
+void CTxMemPool::CompactAddressDeltas(CAddressDeltaBucket& bucket)
+{
+    auto& v = bucket.vDeltas;
+    v.erase(std::remove_if(v.begin(), v.end(), [&](const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& p) {
+        return bucket.setRemoved.count(p.first.txhash) != 0;
+    }), v.end());
+    bucket.setRemoved.clear();
+    bucket.nRemoved = 0;
+}
+
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    std::vector<std::pair<uint160, int>> inserted;
 
     uint256 txhash = tx.GetHash();
+    auto addDelta = [&](const CMempoolAddressDeltaKey& key, const CMempoolAddressDelta& delta) {
+        auto address = std::make_pair(key.addressBytes, key.type);
+        CAddressDeltaBucket& bucket = mapAddress[address];
+        if (bucket.setRemoved.count(txhash)) {
+            // The TX was in the mempool before, drop its old deltas first
+            CompactAddressDeltas(bucket);
+        }
+        bucket.vDeltas.emplace_back(key, delta);
+        inserted.emplace_back(address);
+    };
+
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
         const CTxIn input = tx.vin[j];
         const Coin& coin = view.AccessCoin(input.prevout);
@@ -478,20 +593,17 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(key, delta);
         } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23);
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(key, delta);
         } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1));
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, j, 1);
             CMempoolAddressDelta delta(entry.GetTime(), prevout.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(std::make_pair(key, delta));
-            inserted.push_back(key);
+            addDelta(key, delta);
         }
     }
 
@@ -500,36 +612,43 @@ void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewC
         if (out.scriptPubKey.IsPayToScriptHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
             CMempoolAddressDeltaKey key(2, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
             std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, uint160(hashBytes), txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKey()) {
             uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-            std::pair<addressDeltaMap::iterator,bool> ret;
             CMempoolAddressDeltaKey key(1, hashBytes, txhash, k, 0);
-            mapAddress.insert(std::make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            addDelta(key, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         }
     }
 
-    mapAddressInserted.insert(std::make_pair(txhash, inserted));
+    mapAddressInserted.emplace(txhash, std::move(inserted));
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
                                  std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results)
 {
     LOCK(cs);
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
+    for (const auto& address : addresses) {
+        addressDeltaMap::iterator bit = mapAddress.find(address);
+        if (bit == mapAddress.end()) {
+            continue;
         }
+        CAddressDeltaBucket& bucket = bit->second;
+        if (bucket.nRemoved != 0) {
+            CompactAddressDeltas(bucket);
+            if (bucket.vDeltas.empty()) {
+                mapAddress.erase(bit);
+                continue;
+            }
+        }
+        size_t nStart = results.size();
+        results.insert(results.end(), bucket.vDeltas.begin(), bucket.vDeltas.end());
+        std::sort(results.begin() + nStart, results.end(), [](const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& a, const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& b) {
+            return CMempoolAddressDeltaKeyCompare()(a.first, b.first);
+        });
     }
     return true;
 }
@@ -540,9 +659,22 @@ bool CTxMemPool::removeAddressIndex(const uint256 txhash)
     addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
 
     if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
+        for (const auto& address : it->second) {
+            addressDeltaMap::iterator bit = mapAddress.find(address);
+            if (bit != mapAddress.end()) {
+                bit->second.setRemoved.emplace(txhash);
+                bit->second.nRemoved++;
+            }
+        }
+        // Only compact after all deltas of the TX were accounted for, as it can have multiple deltas per address
+        for (const auto& address : it->second) {
+            addressDeltaMap::iterator bit = mapAddress.find(address);
+            if (bit != mapAddress.end() && bit->second.nRemoved * 2 >= bit->second.vDeltas.size()) {
+                CompactAddressDeltas(bit->second);
+                if (bit->second.vDeltas.empty()) {
+                    mapAddress.erase(bit);
+                }
+            }
         }
         mapAddressInserted.erase(it);
     }
@@ -555,7 +687,7 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
     LOCK(cs);
 
     const CTransaction& tx = entry.GetTx();
-    std::vector<CSpentIndexKey> inserted;
+    std::vector<COutPoint> inserted;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -579,15 +711,13 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
             addressType = 0;
         }
 
-        CSpentIndexKey key = CSpentIndexKey(input.prevout.hash, input.prevout.n);
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.nValue, addressType, addressHash);
 
-        mapSpent.insert(std::make_pair(key, value));
-        inserted.push_back(key);
-
+        mapSpent.emplace(input.prevout, value);
+        inserted.push_back(input.prevout);
     }
 
-    mapSpentInserted.insert(make_pair(txhash, inserted));
+    mapSpentInserted.emplace(txhash, std::move(inserted));
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
@@ -595,7 +725,7 @@ bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     LOCK(cs);
     mapSpentIndex::iterator it;
 
-    it = mapSpent.find(key);
+    it = mapSpent.find(COutPoint(key.txid, key.outputIndex));
     if (it != mapSpent.end()) {
         value = it->second;
         return true;
@@ -603,15 +733,25 @@ bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return false;
 }
 
+void CTxMemPool::getSpentIndex(const std::vector<CSpentIndexKey>& keys, CSpentIndexTxInfo& info)
+{
+    LOCK(cs);
+    for (const auto& key : keys) {
+        auto it = mapSpent.find(COutPoint(key.txid, key.outputIndex));
+        if (it != mapSpent.end()) {
+            info.mSpentInfo.emplace(key, it->second);
+        }
+    }
+}
+
 bool CTxMemPool::removeSpentIndex(const uint256 txhash)
 {
     LOCK(cs);
     mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
 
     if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
+        for (const COutPoint& outpoint : it->second) {
+            mapSpent.erase(outpoint);
         }
         mapSpentInserted.erase(it);
     }
@@ -654,25 +794,25 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
         if (!proTx.collateralOutpoint.IsNull()) {
             eraseProTxRef(it->GetTx().GetHash(), proTx.collateralOutpoint.hash);
         }
-        mapProTxAddresses.erase(proTx.addr);
-        mapProTxPubKeyIDs.erase(proTx.keyIDOwner);
-        mapProTxBlsPubKeyHashes.erase(proTx.pubKeyOperator.GetHash());
-        mapProTxCollaterals.erase(proTx.collateralOutpoint);
-        mapProTxCollaterals.erase(COutPoint(it->GetTx().GetHash(), proTx.collateralOutpoint.n));
+        proTxIndex.Remove(proTx.addr);
+        proTxIndex.Remove(proTx.keyIDOwner);
+        proTxIndex.Remove(proTx.pubKeyOperator);
+        proTxIndex.Remove(proTx.collateralOutpoint);
+        proTxIndex.Remove(COutPoint(it->GetTx().GetHash(), proTx.collateralOutpoint.n));
     } else if (it->GetTx().nType == TRANSACTION_PROVIDER_UPDATE_SERVICE) {
         CProUpServTx proTx;
         if (!GetTxPayload(it->GetTx(), proTx)) {
             assert(false);
         }
         eraseProTxRef(proTx.proTxHash, it->GetTx().GetHash());
-        mapProTxAddresses.erase(proTx.addr);
+        proTxIndex.Remove(proTx.addr);
     } else if (it->GetTx().nType == TRANSACTION_PROVIDER_UPDATE_REGISTRAR) {
         CProUpRegTx proTx;
         if (!GetTxPayload(it->GetTx(), proTx)) {
             assert(false);
         }
         eraseProTxRef(proTx.proTxHash, it->GetTx().GetHash());
-        mapProTxBlsPubKeyHashes.erase(proTx.pubKeyOperator.GetHash());
+        proTxIndex.Remove(proTx.pubKeyOperator);
     } else if (it->GetTx().nType == TRANSACTION_PROVIDER_UPDATE_REVOKE) {
         CProUpRevTx proTx;
         if (!GetTxPayload(it->GetTx(), proTx)) {
@@ -683,8 +823,7 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 
     totalTxSize -= it->GetTxSize();
     cachedInnerUsage -= it->DynamicMemoryUsage();
-    cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
-    mapLinks.erase(it);
+    cachedInnerUsage -= memusage::DynamicUsage(it->GetMemPoolParentsConst()) + memusage::DynamicUsage(it->GetMemPoolChildrenConst());
     mapTx.erase(it);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
@@ -700,22 +839,21 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants)
 {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+    std::vector<txiter> stage;
+    if (setDescendants.insert(entryit).second) {
+        stage.emplace_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
     while (!stage.empty()) {
-        txiter it = *stage.begin();
-        setDescendants.insert(it);
-        stage.erase(it);
-
-        const setEntries &setChildren = GetMemPoolChildren(it);
-        for (const txiter &childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+        txiter it = stage.back();
+        stage.pop_back();
+
+        for (const CTxMemPoolEntry* child : it->GetMemPoolChildrenConst()) {
+            txiter childiter = mapTx.iterator_to(*child);
+            if (setDescendants.insert(childiter).second) {
+                stage.emplace_back(childiter);
             }
         }
     }
@@ -826,8 +964,8 @@ void CTxMemPool::removeConflicts(const CTransaction &tx)
 
 void CTxMemPool::removeProTxPubKeyConflicts(const CTransaction &tx, const CKeyID &keyId)
 {
-    if (mapProTxPubKeyIDs.count(keyId)) {
-        uint256 conflictHash = mapProTxPubKeyIDs[keyId];
+    uint256 conflictHash;
+    if (proTxIndex.Get(keyId, conflictHash)) {
         if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
             removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
         }
@@ -836,8 +974,8 @@ void CTxMemPool::removeProTxPubKeyConflicts(const CTransaction &tx, const CKeyID
 
 void CTxMemPool::removeProTxPubKeyConflicts(const CTransaction &tx, const CBLSPublicKey &pubKey)
 {
-    if (mapProTxBlsPubKeyHashes.count(pubKey.GetHash())) {
-        uint256 conflictHash = mapProTxBlsPubKeyHashes[pubKey.GetHash()];
+    uint256 conflictHash;
+    if (proTxIndex.Get(pubKey, conflictHash)) {
         if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
             removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
         }
@@ -846,8 +984,8 @@ void CTxMemPool::removeProTxPubKeyConflicts(const CTransaction &tx, const CBLSPu
 
 void CTxMemPool::removeProTxCollateralConflicts(const CTransaction &tx, const COutPoint &collateralOutpoint)
 {
-    if (mapProTxCollaterals.count(collateralOutpoint)) {
-        uint256 conflictHash = mapProTxCollaterals[collateralOutpoint];
+    uint256 conflictHash;
+    if (proTxIndex.Get(collateralOutpoint, conflictHash)) {
         if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
             removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
         }
@@ -856,6 +994,12 @@ void CTxMemPool::removeProTxCollateralConflicts(const CTransaction &tx, const CO
 
 void CTxMemPool::removeProTxSpentCollateralConflicts(const CTransaction &tx)
 {
+    // Every conflict found below is removed through mapProTxRefs, so there is nothing to do without any refs. This is
+    // the common case and saves a MN list copy and a lookup per input for every TX of every block.
+    if (mapProTxRefs.empty()) {
+        return;
+    }
+
     // Remove TXs that refer to a MN for which the collateral was spent
     auto removeSpentCollateralConflict = [&](const uint256& proTxHash) {
         // Can't use equal_range here as every call to removeRecursive might invalidate iterators
@@ -877,10 +1021,10 @@ void CTxMemPool::removeProTxSpentCollateralConflicts(const CTransaction &tx)
     };
     auto mnList = deterministicMNManager->GetListAtChainTip();
     for (const auto& in : tx.vin) {
-        auto collateralIt = mapProTxCollaterals.find(in.prevout);
-        if (collateralIt != mapProTxCollaterals.end()) {
+        uint256 proRegTxHash;
+        if (proTxIndex.Get(in.prevout, proRegTxHash)) {
             // These are not yet mined ProRegTxs
-            removeSpentCollateralConflict(collateralIt->second);
+            removeSpentCollateralConflict(proRegTxHash);
         }
         auto dmn = mnList.GetMNByCollateral(in.prevout);
         if (dmn) {
@@ -919,8 +1063,8 @@ void CTxMemPool::removeProTxConflicts(const CTransaction &tx)
             return;
         }
 
-        if (mapProTxAddresses.count(proTx.addr)) {
-            uint256 conflictHash = mapProTxAddresses[proTx.addr];
+        uint256 conflictHash;
+        if (proTxIndex.Get(proTx.addr, conflictHash)) {
             if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
                 removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
             }
@@ -939,8 +1083,8 @@ void CTxMemPool::removeProTxConflicts(const CTransaction &tx)
             return;
         }
 
-        if (mapProTxAddresses.count(proTx.addr)) {
-            uint256 conflictHash = mapProTxAddresses[proTx.addr];
+        uint256 conflictHash;
+        if (proTxIndex.Get(proTx.addr, conflictHash)) {
             if (conflictHash != tx.GetHash() && mapTx.count(conflictHash)) {
                 removeRecursive(mapTx.find(conflictHash)->GetTx(), MemPoolRemovalReason::CONFLICT);
             }
@@ -1000,11 +1144,9 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
 
 void CTxMemPool::_clear()
 {
-    mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
-    mapProTxAddresses.clear();
-    mapProTxPubKeyIDs.clear();
+    proTxIndex.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
@@ -1051,10 +1193,9 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         checkTotal += it->GetTxSize();
         innerUsage += it->DynamicMemoryUsage();
         const CTransaction& tx = it->GetTx();
-        txlinksMap::const_iterator linksiter = mapLinks.find(it);
-        assert(linksiter != mapLinks.end());
-        const TxLinks &links = linksiter->second;
-        innerUsage += memusage::DynamicUsage(links.parents) + memusage::DynamicUsage(links.children);
+        const CTxMemPoolEntry::Links& parents = it->GetMemPoolParentsConst();
+        const CTxMemPoolEntry::Links& children = it->GetMemPoolChildrenConst();
+        innerUsage += memusage::DynamicUsage(parents) + memusage::DynamicUsage(children);
         bool fDependsWait = false;
         setEntries setParentCheck;
         int64_t parentSizes = 0;
@@ -1080,7 +1221,10 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             assert(it3->second == &tx);
             i++;
         }
-        assert(setParentCheck == GetMemPoolParents(it));
+        assert(setParentCheck.size() == parents.size());
+        for (const CTxMemPoolEntry* parent : parents) {
+            assert(setParentCheck.count(mapTx.iterator_to(*parent)));
+        }
         // Verify ancestor state is correct.
         setEntries setAncestors;
         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -1113,7 +1257,10 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
                 childSizes += childit->GetTxSize();
             }
         }
-        assert(setChildrenCheck == GetMemPoolChildren(it));
+        assert(setChildrenCheck.size() == children.size());
+        for (const CTxMemPoolEntry* child : children) {
+            assert(setChildrenCheck.count(mapTx.iterator_to(*child)));
+        }
         // Also check to make sure size is greater than sum with immediate children.
         // just a sanity check, not definitive that this calc is correct...
         assert(it->GetSizeWithDescendants() >= childSizes + it->GetTxSize());
@@ -1225,6 +1372,45 @@ std::vector<TxMempoolInfo> CTxMemPool::infoAll() const
     return ret;
 }
 
+std::vector<CTransactionRef> CTxMemPool::GetAllTxs() const
+{
+    std::vector<CTransactionRef> ret;
+
+    CTxMemPoolSnapshotPtr snapshotPtr = GetSnapshot();
+    if (snapshotPtr) {
+        // Same order as DepthAndScoreComparator, but sorted without holding the mempool lock
+        std::vector<const CTxMemPoolSnapshotEntry*> entries;
+        entries.reserve(snapshotPtr->vEntries.size());
+        for (const auto& entry : snapshotPtr->vEntries) {
+            entries.emplace_back(&entry);
+        }
+        std::sort(entries.begin(), entries.end(), [](const CTxMemPoolSnapshotEntry* a, const CTxMemPoolSnapshotEntry* b) {
+            if (a->nCountWithAncestors != b->nCountWithAncestors) {
+                return a->nCountWithAncestors < b->nCountWithAncestors;
+            }
+            double f1 = (double)a->nFee * b->nTxSize;
+            double f2 = (double)b->nFee * a->nTxSize;
+            if (f1 == f2) {
+                return b->tx->GetHash() < a->tx->GetHash();
+            }
+            return f1 > f2;
+        });
+        ret.reserve(entries.size());
+        for (const auto* entry : entries) {
+            ret.emplace_back(entry->tx);
+        }
+        return ret;
+    }
+
+    LOCK(cs);
+    auto iters = GetSortedDepthAndScore();
+    ret.reserve(iters.size());
+    for (auto it : iters) {
+        ret.emplace_back(it->GetSharedTx());
+    }
+    return ret;
+}
+
 CTransactionRef CTxMemPool::get(const uint256& hash) const
 {
     LOCK(cs);
@@ -1234,6 +1420,15 @@ CTransactionRef CTxMemPool::get(const uint256& hash) const
     return i->GetSharedTx();
 }
 
+std::shared_ptr<const PrecomputedTransactionData> CTxMemPool::GetTxData(const uint256& hash) const
+{
+    LOCK(cs);
+    indexed_transaction_set::const_iterator i = mapTx.find(hash);
+    if (i == mapTx.end())
+        return nullptr;
+    return i->GetTxData();
+}
+
 TxMempoolInfo CTxMemPool::info(const uint256& hash) const
 {
     LOCK(cs);
@@ -1265,10 +1460,10 @@ bool CTxMemPool::existsProviderTxConflict(const CTransaction &tx) const {
             LogPrint(BCLog::MEMPOOL, "%s: ERROR: Invalid transaction payload, tx: %s", __func__, tx.ToString()); /* Continued */
             return true; // i.e. can't decode payload == conflict
         }
-        if (mapProTxAddresses.count(proTx.addr) || mapProTxPubKeyIDs.count(proTx.keyIDOwner) || mapProTxBlsPubKeyHashes.count(proTx.pubKeyOperator.GetHash()))
+        if (proTxIndex.Contains(proTx.addr) || proTxIndex.Contains(proTx.keyIDOwner) || proTxIndex.Contains(proTx.pubKeyOperator))
             return true;
         if (!proTx.collateralOutpoint.hash.IsNull()) {
-            if (mapProTxCollaterals.count(proTx.collateralOutpoint)) {
+            if (proTxIndex.Contains(proTx.collateralOutpoint)) {
                 // there is another ProRegTx that refers to the same collateral
                 return true;
             }
@@ -1284,8 +1479,8 @@ bool CTxMemPool::existsProviderTxConflict(const CTransaction &tx) const {
             LogPrint(BCLog::MEMPOOL, "%s: ERROR: Invalid transaction payload, tx: %s", __func__, tx.ToString()); /* Continued */
             return true; // i.e. can't decode payload == conflict
         }
-        auto it = mapProTxAddresses.find(proTx.addr);
-        return it != mapProTxAddresses.end() && it->second != proTx.proTxHash;
+        uint256 conflictHash;
+        return proTxIndex.Get(proTx.addr, conflictHash) && conflictHash != proTx.proTxHash;
     } else if (tx.nType == TRANSACTION_PROVIDER_UPDATE_REGISTRAR) {
         CProUpRegTx proTx;
         if (!GetTxPayload(tx, proTx)) {
@@ -1306,8 +1501,8 @@ bool CTxMemPool::existsProviderTxConflict(const CTransaction &tx) const {
             }
         }
 
-        auto it = mapProTxBlsPubKeyHashes.find(proTx.pubKeyOperator.GetHash());
-        return it != mapProTxBlsPubKeyHashes.end() && it->second != proTx.proTxHash;
+        uint256 conflictHash;
+        return proTxIndex.Get(proTx.pubKeyOperator, conflictHash) && conflictHash != proTx.proTxHash;
     } else if (tx.nType == TRANSACTION_PROVIDER_UPDATE_REVOKE) {
         CProUpRevTx proTx;
         if (!GetTxPayload(tx, proTx)) {
@@ -1406,7 +1601,7 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -1447,40 +1642,52 @@ bool CTxMemPool::addUnchecked(const uint256&hash, const CTxMemPoolEntry &entry,
     return addUnchecked(hash, entry, setAncestors, validFeeEstimate);
 }
 
-void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+void CTxMemPool::UpdateLinks(CTxMemPoolEntry::Links& links, const CTxMemPoolEntry& link, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].children.insert(child).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].children.erase(child)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+    auto it = std::find(links.begin(), links.end(), &link);
+    if (add && it == links.end()) {
+        // Only a reallocation changes the memory usage, which is why it is not reduced again when removing links
+        cachedInnerUsage -= memusage::DynamicUsage(links);
+        links.emplace_back(&link);
+        cachedInnerUsage += memusage::DynamicUsage(links);
+    } else if (!add && it != links.end()) {
+        *it = links.back();
+        links.pop_back();
     }
 }
 
+void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
+{
+    UpdateLinks(entry->vChildren, *child, add);
+}
+
 void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
 {
-    setEntries s;
-    if (add && mapLinks[entry].parents.insert(parent).second) {
-        cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
-    } else if (!add && mapLinks[entry].parents.erase(parent)) {
-        cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
-    }
+    UpdateLinks(entry->vParents, *parent, add);
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolParents(txiter entry) const
+const CTxMemPoolEntry::Links& CTxMemPool::GetMemPoolParents(txiter entry) const
 {
     assert (entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.parents;
+    return entry->GetMemPoolParentsConst();
 }
 
-const CTxMemPool::setEntries & CTxMemPool::GetMemPoolChildren(txiter entry) const
+const CTxMemPoolEntry::Links& CTxMemPool::GetMemPoolChildren(txiter entry) const
 {
     assert (entry != mapTx.end());
-    txlinksMap::const_iterator it = mapLinks.find(entry);
-    assert(it != mapLinks.end());
-    return it->second.children;
+    return entry->GetMemPoolChildrenConst();
+}
+
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& _pool) : pool(_pool)
+{
+    assert(!pool.fEpochActive);
+    ++pool.nEpoch;
+    pool.fEpochActive = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    pool.fEpochActive = false;
 }
 
 CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const {
@@ -1515,25 +1722,47 @@ void CTxMemPool::trackPackageRemoved(const CFeeRate& rate) {
     }
 }
 
-void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining) {
+void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining, bool fBatched) {
     LOCK(cs);
 
     unsigned nTxnRemoved = 0;
     CFeeRate maxFeeRateRemoved(0);
     while (!mapTx.empty() && DynamicMemoryUsage() > sizelimit) {
-        indexed_transaction_set::index<descendant_score>::type::iterator it = mapTx.get<descendant_score>().begin();
+        const size_t nToFree = DynamicMemoryUsage() - sizelimit;
+        size_t nFreed = 0;
+        setEntries stage;
+        setEntries package;
+        for (auto it = mapTx.get<descendant_score>().begin(); it != mapTx.get<descendant_score>().end() && nFreed < nToFree; ++it) {
+            txiter pit = mapTx.project<0>(it);
+            if (stage.count(pit)) {
+                continue;
+            }
 
-        // We set the new mempool min fee to the feerate of the removed set, plus the
-        // "minimum reasonable fee rate" (ie some value under which we consider txn
-        // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
-        // equal to txn which were removed with no block in between.
-        CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
-        removed += incrementalRelayFee;
-        trackPackageRemoved(removed);
-        maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+            // We set the new mempool min fee to the feerate of the removed set, plus the
+            // "minimum reasonable fee rate" (ie some value under which we consider txn
+            // to have 0 fee). This way, we don't allow txn to enter mempool with feerate
+            // equal to txn which were removed with no block in between.
+            CFeeRate removed(it->GetModFeesWithDescendants(), it->GetSizeWithDescendants());
+            removed += incrementalRelayFee;
+            trackPackageRemoved(removed);
+            maxFeeRateRemoved = std::max(maxFeeRateRemoved, removed);
+
+            if (!fBatched) {
+                CalculateDescendants(pit, stage);
+                break;
+            }
 
-        setEntries stage;
-        CalculateDescendants(mapTx.project<0>(it), stage);
+            // Same as what DynamicMemoryUsage() loses once the TX is gone, apart from vTxHashes which doesn't shrink
+            package.clear();
+            CalculateDescendants(pit, package);
+            for (txiter descendant : package) {
+                if (stage.insert(descendant).second) {
+                    nFreed += memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) + descendant->DynamicMemoryUsage() +
+                              memusage::DynamicUsage(descendant->GetMemPoolParentsConst()) + memusage::DynamicUsage(descendant->GetMemPoolChildrenConst()) +
+                              descendant->GetTx().vin.size() * memusage::IncrementalDynamicUsage(mapNextTx);
+                }
+            }
+        }
         nTxnRemoved += stage.size();
 
         std::vector<CTransaction> txn;
@@ -1560,20 +1789,20 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
 
 uint64_t CTxMemPool::CalculateDescendantMaximum(txiter entry) const {
     // find parent with highest descendant count
+    const EpochGuard epoch(*this);
     std::vector<txiter> candidates;
-    setEntries counted;
     candidates.push_back(entry);
     uint64_t maximum = 0;
     while (candidates.size()) {
         txiter candidate = candidates.back();
         candidates.pop_back();
-        if (!counted.insert(candidate).second) continue;
-        const setEntries& parents = GetMemPoolParents(candidate);
+        if (visited(*candidate)) continue;
+        const CTxMemPoolEntry::Links& parents = candidate->GetMemPoolParentsConst();
         if (parents.size() == 0) {
             maximum = std::max(maximum, candidate->GetCountWithDescendants());
         } else {
-            for (txiter i : parents) {
-                candidates.push_back(i);
+            for (const CTxMemPoolEntry* parent : parents) {
+                candidates.push_back(mapTx.iterator_to(*parent));
             }
         }
     }
@@ -1591,3 +1820,34 @@ void CTxMemPool::GetTransactionAncestry(const uint256& txid, size_t& ancestors,
 }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedAddressHasher::SaltedAddressHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+CProTxMempoolIndex::KeyHasher::KeyHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+CProTxMempoolIndex::Key CProTxMempoolIndex::MakeKey(const CService& addr)
+{
+    // IP and port, 18 bytes
+    std::vector<unsigned char> vchKey = addr.GetKey();
+    Key key{Field::ADDRESS, 0, uint256()};
+    assert(vchKey.size() <= key.value.size());
+    memcpy(key.value.begin(), vchKey.data(), vchKey.size());
+    return key;
+}
+
+CProTxMempoolIndex::Key CProTxMempoolIndex::MakeKey(const CKeyID& keyID)
+{
+    Key key{Field::OWNER_KEY, 0, uint256()};
+    memcpy(key.value.begin(), keyID.begin(), keyID.size());
+    return key;
+}
+
+CProTxMempoolIndex::Key CProTxMempoolIndex::MakeKey(const CBLSPublicKey& pubKey)
+{
+    return Key{Field::OPERATOR_KEY, 0, pubKey.GetHash()};
+}
+
+CProTxMempoolIndex::Key CProTxMempoolIndex::MakeKey(const COutPoint& outpoint)
+{
+    return Key{Field::COLLATERAL, outpoint.n, outpoint.hash};
+}
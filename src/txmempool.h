@@ -9,6 +9,8 @@
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 #include <string>
@@ -20,8 +22,10 @@
 #include <indirectmap.h>
 #include <policy/feerate.h>
 #include <primitives/transaction.h>
+#include <script/interpreter.h>
 #include <sync.h>
 #include <random.h>
+#include <saltedhasher.h>
 #include <netaddress.h>
 #include <bls/bls.h>
 #include <pubkey.h>
@@ -68,6 +72,9 @@ class CTxMemPool;
 
 class CTxMemPoolEntry
 {
+public:
+    typedef std::vector<const CTxMemPoolEntry*> Links;
+
 private:
     CTransactionRef tx;
     CAmount nFee;              //!< Cached to avoid expensive parent-transaction lookups
@@ -79,6 +86,7 @@ private:
     unsigned int sigOpCount;   //!< Legacy sig ops plus P2SH sig op count
     int64_t feeDelta;          //!< Used for determining the priority of the transaction for mining in a block
     LockPoints lockPoints;     //!< Track the height and time at which tx was final
+    std::shared_ptr<const PrecomputedTransactionData> txData; //!< Kept from the script checks when the tx was accepted, may be null
 
     // Information about descendants of this transaction that are in the
     // mempool; if we remove this transaction we must remove all of these
@@ -93,6 +101,15 @@ private:
     CAmount nModFeesWithAncestors;
     unsigned int nSigOpCountWithAncestors;
 
+    // In-mempool direct parents and children, maintained by CTxMemPool. These are usually just a few entries, so
+    // plain vectors with linear lookups are cheaper than sets and there is no separate map to keep in sync.
+    mutable Links vParents;
+    mutable Links vChildren;
+    //! Last traversal which visited this entry, see CTxMemPool::visited
+    mutable uint64_t nEpoch{0};
+
+    friend class CTxMemPool;
+
 public:
     CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                     int64_t _nTime, unsigned int _entryHeight,
@@ -108,6 +125,9 @@ public:
     unsigned int GetSigOpCount() const { return sigOpCount; }
     int64_t GetModifiedFee() const { return nFee + feeDelta; }
     size_t DynamicMemoryUsage() const { return nUsageSize; }
+    const std::shared_ptr<const PrecomputedTransactionData>& GetTxData() const { return txData; }
+    //! Only to be called before the entry is added to the mempool, as it changes DynamicMemoryUsage()
+    void SetTxData(std::shared_ptr<const PrecomputedTransactionData> _txData);
     const LockPoints& GetLockPoints() const { return lockPoints; }
 
     // Adjusts the descendant state.
@@ -131,6 +151,9 @@ public:
     CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
     unsigned int GetSigOpCountWithAncestors() const { return nSigOpCountWithAncestors; }
 
+    const Links& GetMemPoolParentsConst() const { return vParents; }
+    const Links& GetMemPoolChildrenConst() const { return vChildren; }
+
     mutable size_t vTxHashesIdx; //!< Index in mempool's vTxHashes
 
     // If this is a proTx, this will be the hash of the key for which this ProTx was valid
@@ -372,6 +395,161 @@ public:
     }
 };
 
+/** Salted hasher for (address hash, address type) pairs as used by the address index */
+class SaltedAddressHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedAddressHasher();
+
+    size_t operator()(const std::pair<uint160, int>& address) const {
+        return CSipHasher(k0, k1).Write((uint64_t)address.second).Write(address.first.begin(), address.first.size()).Finalize();
+    }
+};
+
+/**
+ * Index of the fields which must be unique among the ProTxs in the mempool: service addresses, owner and operator
+ * keys and collaterals. All of them share a single hash map with a salted hasher, keys are tagged with the kind of
+ * field they were made from. Every field is owned by the hash of the first TX which claimed it.
+ */
+class CProTxMempoolIndex
+{
+private:
+    enum class Field : uint8_t {
+        ADDRESS,
+        OWNER_KEY,
+        OPERATOR_KEY,
+        COLLATERAL,
+    };
+
+    struct Key {
+        Field field;
+        uint32_t n;
+        uint256 value;
+
+        bool operator==(const Key& other) const
+        {
+            return field == other.field && n == other.n && value == other.value;
+        }
+    };
+
+    class KeyHasher
+    {
+    private:
+        /** Salt */
+        const uint64_t k0, k1;
+
+    public:
+        KeyHasher();
+
+        size_t operator()(const Key& key) const
+        {
+            return SipHashUint256Extra(k0, k1, key.value, key.n ^ ((uint32_t)key.field << 30));
+        }
+    };
+
+    std::unordered_map<Key, uint256, KeyHasher> mapIndex;
+
+    static Key MakeKey(const CService& addr);
+    static Key MakeKey(const CKeyID& keyID);
+    static Key MakeKey(const CBLSPublicKey& pubKey);
+    static Key MakeKey(const COutPoint& outpoint);
+
+public:
+    /** Claim field for txHash, unless another TX claimed it already */
+    template <typename T>
+    void Add(const T& field, const uint256& txHash)
+    {
+        mapIndex.emplace(MakeKey(field), txHash);
+    }
+
+    template <typename T>
+    void Remove(const T& field)
+    {
+        mapIndex.erase(MakeKey(field));
+    }
+
+    template <typename T>
+    bool Contains(const T& field) const
+    {
+        return mapIndex.count(MakeKey(field)) != 0;
+    }
+
+    /** Get the hash of the TX which claimed field */
+    template <typename T>
+    bool Get(const T& field, uint256& txHashRet) const
+    {
+        auto it = mapIndex.find(MakeKey(field));
+        if (it == mapIndex.end()) {
+            return false;
+        }
+        txHashRet = it->second;
+        return true;
+    }
+
+    size_t size() const { return mapIndex.size(); }
+    bool empty() const { return mapIndex.empty(); }
+    void clear() { mapIndex.clear(); }
+};
+
+/** Copy of everything the read-only RPCs report about a single mempool entry */
+struct CTxMemPoolSnapshotEntry
+{
+    CTransactionRef tx;
+    CAmount nFee;
+    CAmount nModifiedFee;
+    size_t nTxSize;
+    int64_t nTime;
+    unsigned int nHeight;
+    uint64_t nCountWithDescendants;
+    uint64_t nSizeWithDescendants;
+    CAmount nModFeesWithDescendants;
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+    std::vector<uint256> vDepends; //!< In-mempool TXs this one spends from
+    std::vector<uint256> vSpentBy; //!< In-mempool TXs spending from this one
+};
+
+/**
+ * An immutable copy of the mempool, published by CTxMemPool::UpdateSnapshot(). Read-only RPC and REST calls serve
+ * from the latest snapshot without taking the mempool lock, at the price of lagging behind the live mempool by up to
+ * -mempoolsnapshotinterval milliseconds. TXs themselves are shared with the mempool, only the entry state is copied.
+ */
+class CTxMemPoolSnapshot
+{
+public:
+    typedef std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> AddressDelta;
+
+    int64_t nTime{0}; //!< GetTimeMillis() when the snapshot was taken
+    unsigned int nTransactionsUpdated{0};
+    std::vector<CTxMemPoolSnapshotEntry> vEntries;
+    std::unordered_map<uint256, size_t, SaltedTxidHasher> mapIndex; //!< txid -> position in vEntries
+    std::unordered_map<std::pair<uint160, int>, std::vector<AddressDelta>, SaltedAddressHasher> mapAddressDeltas; //!< sorted by CMempoolAddressDeltaKeyCompare
+
+    /** Returns nullptr if the TX was not in the mempool when the snapshot was taken */
+    const CTxMemPoolSnapshotEntry* Get(const uint256& hash) const
+    {
+        auto it = mapIndex.find(hash);
+        return it != mapIndex.end() ? &vEntries[it->second] : nullptr;
+    }
+
+    /** Same as CTxMemPool::getAddressIndex() */
+    void getAddressIndex(const std::vector<std::pair<uint160, int>>& addresses, std::vector<AddressDelta>& results) const
+    {
+        for (const auto& address : addresses) {
+            auto it = mapAddressDeltas.find(address);
+            if (it != mapAddressDeltas.end()) {
+                results.insert(results.end(), it->second.begin(), it->second.end());
+            }
+        }
+    }
+};
+typedef std::shared_ptr<const CTxMemPoolSnapshot> CTxMemPoolSnapshotPtr;
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -398,8 +576,9 @@ public:
  *
  * In order for the feerate sort to remain correct, we must update transactions
  * in the mempool when new descendants arrive.  To facilitate this, we track
- * the set of in-mempool direct parents and direct children in mapLinks.  Within
- * each CTxMemPoolEntry, we track the size and fees of all descendants.
+ * the in-mempool direct parents and direct children in each CTxMemPoolEntry.
+ * Within each CTxMemPoolEntry, we also track the size and fees of all
+ * descendants.
  *
  * Usually when a new transaction is added to the mempool, it has no in-mempool
  * children (because any such children would be an orphan).  So in
@@ -431,7 +610,7 @@ public:
  * state, to account for in-mempool, out-of-block descendants for all the
  * in-block transactions by calling UpdateTransactionsFromBlock().  Note that
  * until this is called, the mempool state is not consistent, and in particular
- * mapLinks may not be correct (and therefore functions like
+ * the parent/child links may not be correct (and therefore functions like
  * CalculateMemPoolAncestors() and CalculateDescendants() that rely
  * on them to walk the mempool are not generally safe to use).
  *
@@ -453,6 +632,9 @@ private:
     uint64_t totalTxSize;      //!< sum of all mempool tx' byte sizes
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
 
+    mutable uint64_t nEpoch{0};      //!< Incremented for every graph traversal, see EpochGuard
+    mutable bool fEpochActive{false};
+
     mutable int64_t lastRollingFeeUpdate;
     mutable bool blockSinceLastRollingFeeBump;
     mutable double rollingMinimumFeeRate; //!< minimum fee to get into the pool, decreases exponentially
@@ -502,43 +684,73 @@ public:
     };
     typedef std::set<txiter, CompareIteratorByHash> setEntries;
 
-    const setEntries & GetMemPoolParents(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
-    const setEntries & GetMemPoolChildren(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    const CTxMemPoolEntry::Links& GetMemPoolParents(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    const CTxMemPoolEntry::Links& GetMemPoolChildren(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
     uint64_t CalculateDescendantMaximum(txiter entry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 private:
-    typedef std::map<txiter, setEntries, CompareIteratorByHash> cacheMap;
+    typedef std::map<txiter, std::vector<txiter>, CompareIteratorByHash> cacheMap;
+
+    /**
+     * Starts a new traversal of the mempool graph for as long as it is in scope. While it is, visited() tells whether
+     * an entry was already seen by the traversal, which avoids building a set of visited entries. Traversals can not be
+     * nested.
+     */
+    class EpochGuard
+    {
+    private:
+        const CTxMemPool& pool;
 
-    struct TxLinks {
-        setEntries parents;
-        setEntries children;
+    public:
+        explicit EpochGuard(const CTxMemPool& _pool);
+        ~EpochGuard();
     };
 
-    typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
-    txlinksMap mapLinks;
+    /** Mark entry as visited by the current traversal and return whether it already was */
+    bool visited(const CTxMemPoolEntry& entry) const EXCLUSIVE_LOCKS_REQUIRED(cs)
+    {
+        assert(fEpochActive);
+        bool ret = entry.nEpoch == nEpoch;
+        entry.nEpoch = nEpoch;
+        return ret;
+    }
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
+    /**
+     * All deltas of one address, in insertion order. Removing a TX only records its hash in setRemoved, the deltas
+     * themselves are dropped lazily once at least half of the bucket belongs to removed TXs, or when the bucket is
+     * queried or the same TX is added again.
+     */
+    struct CAddressDeltaBucket {
+        std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>> vDeltas;
+        std::unordered_set<uint256, StaticSaltedHasher> setRemoved;
+        size_t nRemoved{0}; //!< Number of entries in vDeltas belonging to TXs in setRemoved
+    };
+    static void CompactAddressDeltas(CAddressDeltaBucket& bucket);
+
+    typedef std::unordered_map<std::pair<uint160, int>, CAddressDeltaBucket, SaltedAddressHasher> addressDeltaMap;
     addressDeltaMap mapAddress;
 
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
+    // txhash -> (address hash, type) of every delta added for the TX
+    typedef std::unordered_map<uint256, std::vector<std::pair<uint160, int>>, SaltedTxidHasher> addressDeltaMapInserted;
     addressDeltaMapInserted mapAddressInserted;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    typedef std::unordered_map<COutPoint, CSpentIndexValue, SaltedOutpointHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
+    typedef std::unordered_map<uint256, std::vector<COutPoint>, SaltedTxidHasher> mapSpentIndexInserted;
     mapSpentIndexInserted mapSpentInserted;
 
-    std::multimap<uint256, uint256> mapProTxRefs; // proTxHash -> transaction (all TXs that refer to an existing proTx)
-    std::map<CService, uint256> mapProTxAddresses;
-    std::map<CKeyID, uint256> mapProTxPubKeyIDs;
-    std::map<uint256, uint256> mapProTxBlsPubKeyHashes;
-    std::map<COutPoint, uint256> mapProTxCollaterals;
+    std::unordered_multimap<uint256, uint256, SaltedTxidHasher> mapProTxRefs; // proTxHash -> transaction (all TXs that refer to an existing proTx)
+    CProTxMempoolIndex proTxIndex;
 
+    void UpdateLinks(CTxMemPoolEntry::Links& links, const CTxMemPoolEntry& link, bool add);
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
+    /** Only accessed through std::atomic_load/std::atomic_store, nullptr until the first UpdateSnapshot() */
+    CTxMemPoolSnapshotPtr snapshot;
+
 public:
     indirectmap<COutPoint, const CTransaction*> mapNextTx GUARDED_BY(cs);
     std::map<uint256, CAmount> mapDeltas;
@@ -567,12 +779,16 @@ public:
     bool addUnchecked(const uint256& hash, const CTxMemPoolEntry& entry, setEntries& setAncestors, bool validFeeEstimate = true) EXCLUSIVE_LOCKS_REQUIRED(cs);
 
     void addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
+    /** Append the mempool deltas of all given addresses to results. Deltas of the same address are sorted by TX
+     *  hash and index, the lock is only taken once for all addresses */
     bool getAddressIndex(std::vector<std::pair<uint160, int> > &addresses,
                          std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results);
     bool removeAddressIndex(const uint256 txhash);
 
     void addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
     bool getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    /** Adds the entries of all keys which are spent in the mempool to info */
+    void getSpentIndex(const std::vector<CSpentIndexKey>& keys, CSpentIndexTxInfo& info);
     bool removeSpentIndex(const uint256 txhash);
 
     void removeRecursive(const CTransaction &tx, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
@@ -593,6 +809,13 @@ public:
     bool isSpent(const COutPoint& outpoint) const;
     unsigned int GetTransactionsUpdated() const;
     void AddTransactionsUpdated(unsigned int n);
+
+    /** Fill a snapshot entry from the live entry */
+    void GetSnapshotEntry(const CTxMemPoolEntry& entry, CTxMemPoolSnapshotEntry& snapshotEntry) const EXCLUSIVE_LOCKS_REQUIRED(cs);
+    /** Publish a new snapshot, unless nothing changed since the last one */
+    void UpdateSnapshot();
+    /** Latest published snapshot, does not lock the mempool. Returns nullptr if snapshots are disabled */
+    CTxMemPoolSnapshotPtr GetSnapshot() const { return std::atomic_load(&snapshot); }
     /**
      * Check that none of this transactions inputs are in the mempool, and thus
      * the tx is not dependent on other mempool transactions to be included in a block.
@@ -633,7 +856,7 @@ public:
      *  limitDescendantSize = max size of descendants any ancestor can have
      *  errString = populated with error reason if any limits are hit
      *  fSearchForParents = whether to search a tx's vin for in-mempool parents, or
-     *    look up parents from mapLinks. Must be true for entries not in the mempool
+     *    look up parents from the entry's parent links. Must be true for entries not in the mempool
      */
     bool CalculateMemPoolAncestors(const CTxMemPoolEntry& entry, setEntries& setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string& errString, bool fSearchForParents = true) const EXCLUSIVE_LOCKS_REQUIRED(cs);
 
@@ -653,8 +876,11 @@ public:
     /** Remove transactions from the mempool until its dynamic size is <= sizelimit.
       *  pvNoSpendsRemaining, if set, will be populated with the list of outpoints
       *  which are not in mempool which no longer have any spends in this mempool.
+      *  If fBatched is set, all packages needed to get below sizelimit are picked in a single pass over the
+      *  descendant score index and removed at once, instead of removing one package at a time and picking the next
+      *  one with the descendant scores of the remaining transactions updated.
       */
-    void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining=nullptr);
+    void TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpendsRemaining=nullptr, bool fBatched=false);
 
     /** Expire all transaction (and their dependencies) in the mempool older than time. Return the number of removed transactions. */
     int Expire(int64_t time);
@@ -684,8 +910,12 @@ public:
     }
 
     CTransactionRef get(const uint256& hash) const;
+    /** Precomputed data of the TX's script checks, nullptr if it's not in the mempool or none was kept */
+    std::shared_ptr<const PrecomputedTransactionData> GetTxData(const uint256& hash) const;
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
+    /** The TXs of infoAll() in the same order. Served from the snapshot without locking the mempool if enabled */
+    std::vector<CTransactionRef> GetAllTxs() const;
 
     bool existsProviderTxConflict(const CTransaction &tx) const;
 
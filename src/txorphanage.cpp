@@ -0,0 +1,208 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txorphanage.h>
+
+#include <random.h>
+
+#include <algorithm>
+#include <assert.h>
+
+bool CTxOrphanage::AddTx(const CTransactionRef& tx, NodeId peer, int64_t nTimeExpire, size_t nTxSize)
+{
+    auto ret = mapOrphans.emplace(tx->GetHash(), COrphanTx{tx, peer, nTimeExpire, nTxSize, 0, 0});
+    if (!ret.second) {
+        return false;
+    }
+    COrphanTx* orphan = &ret.first->second;
+    orphan->nListPos = vecOrphans.size();
+    vecOrphans.emplace_back(orphan);
+
+    PeerInfo& peerInfo = mapPeers[peer];
+    orphan->nPeerListPos = peerInfo.vecOrphans.size();
+    peerInfo.vecOrphans.emplace_back(orphan);
+    peerInfo.nTxSize += nTxSize;
+    nTotalTxSize += nTxSize;
+
+    for (const CTxIn& txin : tx->vin) {
+        mapByPrev[txin.prevout].emplace(orphan);
+    }
+    return true;
+}
+
+void CTxOrphanage::EraseIt(OrphanMap::iterator it)
+{
+    COrphanTx* orphan = &it->second;
+    for (const CTxIn& txin : orphan->tx->vin) {
+        auto itPrev = mapByPrev.find(txin.prevout);
+        if (itPrev == mapByPrev.end()) {
+            continue;
+        }
+        itPrev->second.erase(orphan);
+        if (itPrev->second.empty()) {
+            mapByPrev.erase(itPrev);
+        }
+    }
+
+    // Move the last orphan into the freed positions
+    assert(vecOrphans[orphan->nListPos] == orphan);
+    vecOrphans[orphan->nListPos] = vecOrphans.back();
+    vecOrphans[orphan->nListPos]->nListPos = orphan->nListPos;
+    vecOrphans.pop_back();
+
+    auto itPeer = mapPeers.find(orphan->fromPeer);
+    assert(itPeer != mapPeers.end());
+    PeerInfo& peerInfo = itPeer->second;
+    assert(peerInfo.vecOrphans[orphan->nPeerListPos] == orphan);
+    peerInfo.vecOrphans[orphan->nPeerListPos] = peerInfo.vecOrphans.back();
+    peerInfo.vecOrphans[orphan->nPeerListPos]->nPeerListPos = orphan->nPeerListPos;
+    peerInfo.vecOrphans.pop_back();
+    assert(peerInfo.nTxSize >= orphan->nTxSize);
+    peerInfo.nTxSize -= orphan->nTxSize;
+    if (peerInfo.vecOrphans.empty()) {
+        mapPeers.erase(itPeer);
+    }
+
+    assert(nTotalTxSize >= orphan->nTxSize);
+    nTotalTxSize -= orphan->nTxSize;
+    mapOrphans.erase(it);
+}
+
+int CTxOrphanage::EraseTx(const uint256& hash)
+{
+    auto it = mapOrphans.find(hash);
+    if (it == mapOrphans.end()) {
+        return 0;
+    }
+    EraseIt(it);
+    return 1;
+}
+
+int CTxOrphanage::EraseForPeer(NodeId peer)
+{
+    auto itPeer = mapPeers.find(peer);
+    if (itPeer == mapPeers.end()) {
+        return 0;
+    }
+    // The peer info is removed together with its last orphan
+    std::vector<uint256> vecHashes;
+    vecHashes.reserve(itPeer->second.vecOrphans.size());
+    for (const COrphanTx* orphan : itPeer->second.vecOrphans) {
+        vecHashes.emplace_back(orphan->tx->GetHash());
+    }
+    int nErased = 0;
+    for (const uint256& hash : vecHashes) {
+        nErased += EraseTx(hash);
+    }
+    return nErased;
+}
+
+int CTxOrphanage::EraseForBlock(const CBlock& block)
+{
+    std::vector<uint256> vecErase;
+    for (const CTransactionRef& ptx : block.vtx) {
+        if (mapOrphans.count(ptx->GetHash())) {
+            vecErase.emplace_back(ptx->GetHash());
+        }
+        for (const CTxIn& txin : ptx->vin) {
+            auto itPrev = mapByPrev.find(txin.prevout);
+            if (itPrev == mapByPrev.end()) {
+                continue;
+            }
+            for (const COrphanTx* orphan : itPrev->second) {
+                vecErase.emplace_back(orphan->tx->GetHash());
+            }
+        }
+    }
+    int nErased = 0;
+    for (const uint256& hash : vecErase) {
+        nErased += EraseTx(hash);
+    }
+    return nErased;
+}
+
+int CTxOrphanage::EraseExpired(int64_t nNow, int64_t& nNextExpire)
+{
+    std::vector<uint256> vecErase;
+    for (const COrphanTx* orphan : vecOrphans) {
+        if (orphan->nTimeExpire <= nNow) {
+            vecErase.emplace_back(orphan->tx->GetHash());
+        } else {
+            nNextExpire = std::min(orphan->nTimeExpire, nNextExpire);
+        }
+    }
+    int nErased = 0;
+    for (const uint256& hash : vecErase) {
+        nErased += EraseTx(hash);
+    }
+    return nErased;
+}
+
+int CTxOrphanage::LimitSize(size_t nMaxSize)
+{
+    int nEvicted = 0;
+    while (!vecOrphans.empty() && nTotalTxSize > nMaxSize) {
+        const COrphanTx* orphan = vecOrphans[GetRand(vecOrphans.size())];
+        nEvicted += EraseTx(orphan->tx->GetHash());
+    }
+    return nEvicted;
+}
+
+int CTxOrphanage::LimitPeerSize(NodeId peer, size_t nMaxPeerSize)
+{
+    int nEvicted = 0;
+    auto itPeer = mapPeers.find(peer);
+    while (itPeer != mapPeers.end() && itPeer->second.nTxSize > nMaxPeerSize) {
+        const std::vector<COrphanTx*>& vecPeerOrphans = itPeer->second.vecOrphans;
+        const COrphanTx* orphan = vecPeerOrphans[GetRand(vecPeerOrphans.size())];
+        nEvicted += EraseTx(orphan->tx->GetHash());
+        // The last orphan of the peer removes its info
+        itPeer = mapPeers.find(peer);
+    }
+    return nEvicted;
+}
+
+void CTxOrphanage::AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const
+{
+    if (mapByPrev.empty()) {
+        return;
+    }
+    const uint256& hash = tx.GetHash();
+    for (uint32_t i = 0; i < tx.vout.size(); i++) {
+        auto itPrev = mapByPrev.find(COutPoint(hash, i));
+        if (itPrev == mapByPrev.end()) {
+            continue;
+        }
+        for (const COrphanTx* orphan : itPrev->second) {
+            orphan_work_set.emplace(orphan->tx->GetHash());
+        }
+    }
+}
+
+const COrphanTx* CTxOrphanage::GetTx(const uint256& hash) const
+{
+    auto it = mapOrphans.find(hash);
+    return it != mapOrphans.end() ? &it->second : nullptr;
+}
+
+size_t CTxOrphanage::PeerCount(NodeId peer) const
+{
+    auto it = mapPeers.find(peer);
+    return it != mapPeers.end() ? it->second.vecOrphans.size() : 0;
+}
+
+size_t CTxOrphanage::PeerTxSize(NodeId peer) const
+{
+    auto it = mapPeers.find(peer);
+    return it != mapPeers.end() ? it->second.nTxSize : 0;
+}
+
+void CTxOrphanage::Clear()
+{
+    mapByPrev.clear();
+    mapPeers.clear();
+    vecOrphans.clear();
+    mapOrphans.clear();
+    nTotalTxSize = 0;
+}
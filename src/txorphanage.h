@@ -0,0 +1,93 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXORPHANAGE_H
+#define BITCOIN_TXORPHANAGE_H
+
+#include <coins.h>
+#include <net.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <saltedhasher.h>
+#include <uint256.h>
+
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+struct COrphanTx {
+    CTransactionRef tx;
+    NodeId fromPeer;
+    int64_t nTimeExpire;
+    size_t nTxSize;
+    // Positions in CTxOrphanage::vecOrphans and in the vector of the peer
+    size_t nListPos;
+    size_t nPeerListPos;
+};
+
+/**
+ * The transactions which were received before their parents.
+ *
+ * The orphans are kept in a hash map, their positions in a vector so that a random one can be picked for eviction in
+ * constant time, and indexed by the outpoints they spend so that the children of a transaction are found without a
+ * scan. The count and size of the orphans of every peer are tracked, together with a vector of them, so that a peer
+ * can be held to its quota and its orphans dropped when it disconnects without looking at those of the other peers.
+ *
+ * Not thread safe, the caller has to synchronize the access.
+ */
+class CTxOrphanage
+{
+public:
+    typedef std::unordered_map<uint256, COrphanTx, StaticSaltedHasher> OrphanMap;
+
+private:
+    struct PeerInfo {
+        size_t nTxSize{0};
+        std::vector<COrphanTx*> vecOrphans;
+    };
+
+    OrphanMap mapOrphans;
+    // The pointers stay valid as the map doesn't move its elements on rehashing
+    std::vector<COrphanTx*> vecOrphans;
+    std::unordered_map<COutPoint, std::set<COrphanTx*>, SaltedOutpointHasher> mapByPrev;
+    std::map<NodeId, PeerInfo> mapPeers;
+    size_t nTotalTxSize{0};
+
+    void EraseIt(OrphanMap::iterator it);
+
+public:
+    /** Add the orphan, false if it is known already */
+    bool AddTx(const CTransactionRef& tx, NodeId peer, int64_t nTimeExpire, size_t nTxSize);
+    /** Remove the orphan, returns the number of removed orphans (0 or 1) */
+    int EraseTx(const uint256& hash);
+    /** Remove the orphans of the peer */
+    int EraseForPeer(NodeId peer);
+    /** Remove the orphans which are included in the block or which spend the same outputs as its transactions */
+    int EraseForBlock(const CBlock& block);
+    /** Remove the orphans which expired at nNow, nNextExpire is lowered to the earliest expiry of the remaining ones */
+    int EraseExpired(int64_t nNow, int64_t& nNextExpire);
+
+    /** Evict random orphans until the total size is at most nMaxSize */
+    int LimitSize(size_t nMaxSize);
+    /** Evict random orphans of the peer until their size is at most nMaxPeerSize */
+    int LimitPeerSize(NodeId peer, size_t nMaxPeerSize);
+
+    /** Add the orphans which spend any output of tx to orphan_work_set, all outputs at once */
+    void AddChildrenToWorkSet(const CTransaction& tx, std::set<uint256>& orphan_work_set) const;
+
+    bool HaveTx(const uint256& hash) const { return mapOrphans.count(hash) != 0; }
+    /** The orphan, nullptr if it is not known. Only valid until the orphan is removed. */
+    const COrphanTx* GetTx(const uint256& hash) const;
+
+    size_t Size() const { return mapOrphans.size(); }
+    size_t TotalTxSize() const { return nTotalTxSize; }
+    size_t PrevoutCount() const { return mapByPrev.size(); }
+    size_t PeerCount(NodeId peer) const;
+    size_t PeerTxSize(NodeId peer) const;
+
+    void Clear();
+};
+
+#endif // BITCOIN_TXORPHANAGE_H
@@ -12,6 +12,9 @@
 #include <primitives/transaction.h>
 #include <serialize.h>
 
+#include <map>
+#include <vector>
+
 /** Undo information for a CTxIn
  *
  *  Contains the prevout's CTxOut being spent, and its metadata as well
@@ -109,4 +112,94 @@ public:
     }
 };
 
+/**
+ * Compact serialization of the undo data of the block at nHeight, used instead of the one of CBlockUndo for blocks
+ * with BLOCK_UNDO_COMPACT (see -compactundo).
+ *
+ * It drops the dummy version of every coin, stores heights relative to the block and, instead of repeating a script,
+ * refers to the first coin of the block with the same script. The latter is common for consolidations and payouts.
+ * Every coin is stored as VARINT((nHeight - coin height) * 2 + coinbase), VARINT(script reference), the compressed
+ * amount and, if the reference is 0, the compressed script. Reference n is the n-th distinct script of the block.
+ */
+class CompactBlockUndoSerializer
+{
+    const CBlockUndo* blockundo;
+    int nHeight;
+
+public:
+    template<typename Stream>
+    void Serialize(Stream &s) const {
+        std::map<CScript, uint64_t> mapScripts;
+        WriteCompactSize(s, blockundo->vtxundo.size());
+        for (const CTxUndo& txundo : blockundo->vtxundo) {
+            WriteCompactSize(s, txundo.vprevout.size());
+            for (const Coin& coin : txundo.vprevout) {
+                if ((int)coin.nHeight > nHeight) {
+                    throw std::ios_base::failure("Undo coin from a later block");
+                }
+                ::Serialize(s, VARINT((uint64_t)(nHeight - coin.nHeight) * 2 + (coin.fCoinBase ? 1 : 0)));
+                auto it = mapScripts.find(coin.out.scriptPubKey);
+                const uint64_t nScriptRef = it == mapScripts.end() ? 0 : it->second;
+                ::Serialize(s, VARINT(nScriptRef));
+                ::Serialize(s, VARINT(CTxOutCompressor::CompressAmount(coin.out.nValue)));
+                if (nScriptRef == 0) {
+                    ::Serialize(s, CScriptCompressor(REF(coin.out.scriptPubKey)));
+                    mapScripts.emplace(coin.out.scriptPubKey, mapScripts.size() + 1);
+                }
+            }
+        }
+    }
+
+    CompactBlockUndoSerializer(const CBlockUndo* blockundoIn, int nHeightIn) : blockundo(blockundoIn), nHeight(nHeightIn) {}
+};
+
+class CompactBlockUndoDeserializer
+{
+    CBlockUndo* blockundo;
+    int nHeight;
+
+public:
+    template<typename Stream>
+    void Unserialize(Stream &s) {
+        std::vector<CScript> vScripts;
+        // Every transaction but the coinbase spends at least one input
+        uint64_t nTxs = ReadCompactSize(s);
+        if (nTxs > MAX_INPUTS_PER_BLOCK) {
+            throw std::ios_base::failure("Too many transaction undo records");
+        }
+        blockundo->vtxundo.assign(nTxs, CTxUndo());
+        for (CTxUndo& txundo : blockundo->vtxundo) {
+            uint64_t count = ReadCompactSize(s);
+            if (count > MAX_INPUTS_PER_BLOCK) {
+                throw std::ios_base::failure("Too many input undo records");
+            }
+            txundo.vprevout.resize(count);
+            for (Coin& coin : txundo.vprevout) {
+                uint64_t nCode = 0;
+                ::Unserialize(s, VARINT(nCode));
+                if (nCode / 2 > (uint64_t)nHeight) {
+                    throw std::ios_base::failure("Undo coin from a later block");
+                }
+                coin.nHeight = nHeight - nCode / 2;
+                coin.fCoinBase = nCode & 1;
+                uint64_t nScriptRef = 0;
+                ::Unserialize(s, VARINT(nScriptRef));
+                uint64_t nAmount = 0;
+                ::Unserialize(s, VARINT(nAmount));
+                coin.out.nValue = CTxOutCompressor::DecompressAmount(nAmount);
+                if (nScriptRef == 0) {
+                    ::Unserialize(s, CScriptCompressor(REF(coin.out.scriptPubKey)));
+                    vScripts.push_back(coin.out.scriptPubKey);
+                } else if (nScriptRef <= vScripts.size()) {
+                    coin.out.scriptPubKey = vScripts[nScriptRef - 1];
+                } else {
+                    throw std::ios_base::failure("Invalid undo script reference");
+                }
+            }
+        }
+    }
+
+    CompactBlockUndoDeserializer(CBlockUndo* blockundoIn, int nHeightIn) : blockundo(blockundoIn), nHeight(nHeightIn) {}
+};
+
 #endif // BITCOIN_UNDO_H
@@ -41,6 +41,16 @@ public:
                 push_back_u(codepoint);
         }
     }
+    // Write a run of 7-bit ASCII chars, appended at once unless in the middle of a UTF-8 sequence
+    void append_ascii(const char *begin, const char *end)
+    {
+        if (state == 0) {
+            str.append(begin, end);
+        } else {
+            for (; begin != end; ++begin)
+                push_back(*begin);
+        }
+    }
     // Write codepoint directly, possibly collating surrogate pairs
     void push_back_u(unsigned int codepoint_)
     {
@@ -10,30 +10,46 @@
 
 using namespace std;
 
-static string json_escape(const string& inS)
+static void json_escape(const string& inS, string& outS)
 {
-    string outS;
-    outS.reserve(inS.size() * 2);
-
-    for (unsigned int i = 0; i < inS.size(); i++) {
-        unsigned char ch = inS[i];
-        const char *escStr = escapes[ch];
-
-        if (escStr)
-            outS += escStr;
-        else
-            outS += ch;
+    // append runs of chars which need no escaping at once
+    const char* p = inS.data();
+    const char* end = p + inS.size();
+    while (p != end) {
+        const char* run = p;
+        while (p != end && !escapes[(unsigned char)*p])
+            p++;
+        outS.append(run, p);
+        if (p != end) {
+            outS += escapes[(unsigned char)*p];
+            p++;
+        }
     }
-
-    return outS;
 }
 
 string UniValue::write(unsigned int prettyIndent,
                        unsigned int indentLevel) const
 {
     string s;
-    s.reserve(1024);
+    s.reserve(estimateSize(prettyIndent));
+    writeValue(prettyIndent, indentLevel, s);
+    return s;
+}
 
+size_t UniValue::estimateSize(unsigned int prettyIndent) const
+{
+    // the unescaped size of the output, without indentation
+    size_t ret = val.size() + 2;
+    for (const auto& key : keys)
+        ret += key.size() + 4;
+    for (const auto& value : values)
+        ret += value.estimateSize(prettyIndent) + 1 + (prettyIndent ? 1 : 0);
+    return ret;
+}
+
+void UniValue::writeValue(unsigned int prettyIndent,
+                          unsigned int indentLevel, string& s) const
+{
     unsigned int modIndent = indentLevel;
     if (modIndent == 0)
         modIndent = 1;
@@ -49,7 +65,9 @@ string UniValue::write(unsigned int prettyIndent,
         writeArray(prettyIndent, modIndent, s);
         break;
     case VSTR:
-        s += "\"" + json_escape(val) + "\"";
+        s += '"';
+        json_escape(val, s);
+        s += '"';
         break;
     case VNUM:
         s += val;
@@ -58,8 +76,6 @@ string UniValue::write(unsigned int prettyIndent,
         s += (val == "1" ? "true" : "false");
         break;
     }
-
-    return s;
 }
 
 static void indentStr(unsigned int prettyIndent, unsigned int indentLevel, string& s)
@@ -76,7 +92,7 @@ void UniValue::writeArray(unsigned int prettyIndent, unsigned int indentLevel, s
     for (unsigned int i = 0; i < values.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += values[i].write(prettyIndent, indentLevel + 1);
+        values[i].writeValue(prettyIndent, indentLevel + 1, s);
         if (i != (values.size() - 1)) {
             s += ",";
         }
@@ -98,10 +114,12 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
     for (unsigned int i = 0; i < keys.size(); i++) {
         if (prettyIndent)
             indentStr(prettyIndent, indentLevel, s);
-        s += "\"" + json_escape(keys[i]) + "\":";
+        s += '"';
+        json_escape(keys[i], s);
+        s += "\":";
         if (prettyIndent)
             s += " ";
-        s += values.at(i).write(prettyIndent, indentLevel + 1);
+        values.at(i).writeValue(prettyIndent, indentLevel + 1, s);
         if (i != (values.size() - 1))
             s += ",";
         if (prettyIndent)
@@ -112,4 +130,3 @@ void UniValue::writeObject(unsigned int prettyIndent, unsigned int indentLevel,
         indentStr(prettyIndent, indentLevel - 1, s);
     s += "}";
 }
-
@@ -5,6 +5,8 @@
 #ifndef BITCOIN_UNORDERED_LRU_CACHE_H
 #define BITCOIN_UNORDERED_LRU_CACHE_H
 
+#include <memusage.h>
+
 #include <unordered_map>
 
 template<typename Key, typename Value, typename Hasher, size_t MaxSize = 0, size_t TruncateThreshold = 0>
@@ -28,6 +30,18 @@ public:
     }
 
     size_t max_size() const { return maxSize; }
+    size_t size() const { return cacheMap.size(); }
+
+    /** The memory used by the cache's map, plus valueUsage(value) for each value */
+    template<typename ValueUsage>
+    size_t DynamicMemoryUsage(ValueUsage&& valueUsage) const
+    {
+        size_t ret = memusage::DynamicUsage(cacheMap);
+        for (const auto& p : cacheMap) {
+            ret += valueUsage(p.second.first);
+        }
+        return ret;
+    }
 
     template<typename Value2>
     void _emplace(const Key& key, Value2&& v)
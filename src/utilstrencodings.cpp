@@ -82,6 +82,7 @@ std::vector<unsigned char> ParseHex(const char* psz)
 {
     // convert hex dump to vector
     std::vector<unsigned char> vch;
+    vch.reserve(strlen(psz) / 2);
     while (true)
     {
         while (isspace(*psz))
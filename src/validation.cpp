@@ -16,14 +16,18 @@
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
 #include <cuckoocache.h>
+#include <executor.h>
 #include <hash.h>
+#include <headerscache.h>
 #include <init.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <pow.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <replica.h>
 #include <reverse_iterator.h>
+#include <saltedhasher.h>
 #include <script/script.h>
 #include <script/sigcache.h>
 #include <script/standard.h>
@@ -33,9 +37,11 @@
 #include <txmempool.h>
 #include <ui_interface.h>
 #include <undo.h>
+#include <unordered_lru_cache.h>
 #include <util.h>
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
+#include <utiltrace.h>
 #include <validationinterface.h>
 #include <warnings.h>
 
@@ -43,18 +49,30 @@
 
 #include <evo/specialtx.h>
 #include <evo/deterministicmns.h>
+#include <evo/cbtx.h>
 
 #include <llmq/quorums_instantsend.h>
 #include <llmq/quorums_chainlocks.h>
 
 #include <statsd_client.h>
 
+#include <deque>
 #include <future>
 #include <sstream>
+#include <unordered_set>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
 
+#include <ctpl.h>
+
 #if defined(NDEBUG)
 # error "Dash Core cannot be compiled without assertions."
 #endif
@@ -167,7 +185,8 @@ public:
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
      */
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    // fCheckedHeader means that CheckBlockHeader was already called for the header
+    bool AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckedHeader = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
@@ -184,6 +203,8 @@ public:
     bool MarkConflictingBlock(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool ResetBlockFailureFlags(CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+    bool ActivateSnapshot(CBlockIndex* pindexBase, unsigned int nChainTx) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
     bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
     bool LoadGenesisBlock(const CChainParams& chainparams);
     bool AddGenesisBlock(const CChainParams& chainparams, const CBlock& block, CValidationState& state);
@@ -196,7 +217,7 @@ private:
     bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace);
     bool ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions &disconnectpool);
 
-    CBlockIndex* AddToBlockIndex(const CBlockHeader& block, enum BlockStatus nStatus = BLOCK_VALID_TREE) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    CBlockIndex* AddToBlockIndex(const CBlockHeader& block, const uint256& hash, enum BlockStatus nStatus = BLOCK_VALID_TREE) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
     CBlockIndex* InsertBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /**
@@ -233,11 +254,15 @@ bool fAddressIndex = false;
 bool fTimestampIndex = false;
 bool fSpentIndex = false;
 bool fHavePruned = false;
+bool fSnapshotChainstate = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fRequireStandard = true;
 unsigned int nBytesPerSigOp = DEFAULT_BYTES_PER_SIGOP;
 bool fCheckBlockIndex = false;
+int nCoinsPrefetchBlocks = DEFAULT_COINS_PREFETCH_BLOCKS;
+bool fMapBlockFiles = DEFAULT_MMAP_BLOCKS;
+bool fCompactUndo = DEFAULT_COMPACT_UNDO;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
@@ -511,7 +536,7 @@ static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
     }
 
     std::vector<COutPoint> vNoSpendsRemaining;
-    pool.TrimToSize(limit, &vNoSpendsRemaining);
+    pool.TrimToSize(limit, &vNoSpendsRemaining, gArgs.GetBoolArg("-mempoolbatchedeviction", DEFAULT_MEMPOOL_BATCHED_EVICTION));
     for (const COutPoint& removed : vNoSpendsRemaining)
         pcoinsTip->Uncache(removed);
 }
@@ -822,6 +847,8 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
+        // Keep the signature hashes, ConnectBlock reuses them once the TX is mined
+        txdata.sighashCache = std::make_shared<SighashCache>(tx.vin.size());
         if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, false, txdata))
             return false; // state filled in by CheckInputs
 
@@ -854,6 +881,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         bool validForFeeEstimation = (nFees !=0) && !bypass_limits && IsCurrentForFeeEstimation() && pool.HasNoInputsOf(tx);
 
         // Store transaction in memory
+        entry.SetTxData(std::make_shared<const PrecomputedTransactionData>(txdata));
         pool.addUnchecked(hash, entry, setAncestors, validForFeeEstimation);
         CAmount nValueOut = tx.GetValueOut();
         statsClient.count("transactions.sizeBytes", nSize, 1.0f);
@@ -877,6 +905,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             if (!pool.exists(hash))
                 return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
         }
+        TRACE4(mempool, added, hash.begin(), nSize, nFees, nSigOps);
     }
 
     if(!fDryRun)
@@ -900,7 +929,10 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
     std::vector<COutPoint> coins_to_uncache;
     bool res = AcceptToMemoryPoolWorker(chainparams, pool, state, tx, pfMissingInputs, nAcceptTime, bypass_limits, nAbsurdFee, coins_to_uncache, fDryRun);
     if (!res || fDryRun) {
-        if(!res) LogPrint(BCLog::MEMPOOL, "%s: %s %s (%s)\n", __func__, tx->GetHash().ToString(), state.GetRejectReason(), state.GetDebugMessage());
+        if(!res) {
+            LogPrint(BCLog::MEMPOOL, "%s: %s %s (%s)\n", __func__, tx->GetHash().ToString(), state.GetRejectReason(), state.GetDebugMessage());
+            TRACE3(mempool, rejected, tx->GetHash().begin(), state.GetRejectReason().c_str(), state.GetRejectCode());
+        }
         for (const COutPoint& hashTx : coins_to_uncache)
             pcoinsTip->Uncache(hashTx);
     }
@@ -942,25 +974,57 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return true;
 }
 
+bool GetSpentIndex(const std::vector<CSpentIndexKey>& keys, CSpentIndexTxInfo& info)
+{
+    if (!fSpentIndex)
+        return false;
+
+    mempool.getSpentIndex(keys, info);
+
+    std::vector<CSpentIndexKey> missing;
+    for (const auto& key : keys) {
+        if (!info.mSpentInfo.count(key)) {
+            missing.push_back(key);
+        }
+    }
+    return pblocktree->ReadSpentIndex(std::move(missing), info);
+}
+
 bool GetAddressIndex(uint160 addressHash, int type,
-                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end)
+                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex, int start, int end,
+                     const CDBSnapshot* snapshot)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end, snapshot))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool GetAddressSummary(uint160 addressHash, int type, CAddressIndexSummary& summary)
+{
+    if (!fAddressIndex)
+        return false;
+
+    // Databases created before summaries were added only have them for recent entries
+    bool fSummaries = false;
+    if (!pblocktree->ReadFlag("addresssummary", fSummaries) || !fSummaries)
+        return false;
+
+    pblocktree->ReadAddressSummary(addressHash, type, summary);
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CDBSnapshot* snapshot)
 {
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs, snapshot))
         return error("unable to get txids for address");
 
     return true;
@@ -1063,21 +1127,117 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
+namespace {
+/** A read-only memory mapping of a finalized block or undo file. Undo files can still grow when blocks stored
+ *  in them are connected late, the mapping only covers the size at the time the file was mapped. */
+class CBlockFileMapping
+{
+public:
+    const unsigned char* data{nullptr};
+    size_t size{0};
+
+    CBlockFileMapping(const unsigned char* _data, size_t _size) : data(_data), size(_size) {}
+    CBlockFileMapping(const CBlockFileMapping&) = delete;
+    CBlockFileMapping& operator=(const CBlockFileMapping&) = delete;
+    ~CBlockFileMapping()
+    {
+#ifndef WIN32
+        munmap(const_cast<unsigned char*>(data), size);
+#endif
+    }
+};
+
+/** Upper bound for simultaneously mapped block and undo files, to stay friendly to 32 bit address spaces */
+static const size_t MAX_MAPPED_BLOCK_FILES = 16;
+
+CCriticalSection cs_blockFileMappings;
+/** Keyed by file number and whether it is the undo (rev) file */
+std::map<std::pair<int, bool>, std::shared_ptr<const CBlockFileMapping>> mapBlockFileMappings GUARDED_BY(cs_blockFileMappings);
+} // anon namespace
+
+/** Get (and create if needed) the mapping for a block or (with fUndo) undo file. Returns nullptr if -mmapblocks is
+ *  off, the file is still being written to or mapping failed, in which case callers use regular file I/O. */
+static std::shared_ptr<const CBlockFileMapping> GetBlockFileMapping(int nFile, bool fUndo = false)
+{
+#ifndef WIN32
+    if (!fMapBlockFiles) {
+        return nullptr;
+    }
+    {
+        LOCK(cs_LastBlockFile);
+        if (nFile >= nLastBlockFile) {
+            return nullptr;
+        }
+    }
+
+    LOCK(cs_blockFileMappings);
+    auto it = mapBlockFileMappings.find(std::make_pair(nFile, fUndo));
+    if (it != mapBlockFileMappings.end()) {
+        return it->second;
+    }
+
+    fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), fUndo ? "rev" : "blk");
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (p == MAP_FAILED) {
+        LogPrintf("%s: failed to map %s, falling back to file access\n", __func__, path.string());
+        return nullptr;
+    }
+
+    if (mapBlockFileMappings.size() >= MAX_MAPPED_BLOCK_FILES) {
+        // Readers still holding on to the evicted mapping keep it alive until they are done
+        mapBlockFileMappings.erase(mapBlockFileMappings.begin());
+    }
+    auto mapping = std::make_shared<const CBlockFileMapping>((const unsigned char*)p, (size_t)st.st_size);
+    mapBlockFileMappings.emplace(std::make_pair(nFile, fUndo), mapping);
+    return mapping;
+#else
+    return nullptr;
+#endif
+}
+
+static void UnmapBlockFile(int nFile)
+{
+    LOCK(cs_blockFileMappings);
+    mapBlockFileMappings.erase(std::make_pair(nFile, false));
+    mapBlockFileMappings.erase(std::make_pair(nFile, true));
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    auto mapping = GetBlockFileMapping(pos.nFile);
+    if (mapping) {
+        // Deserialize straight from the mapped file
+        try {
+            SpanReader reader(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(mapping->data, mapping->size), pos.nPos);
+            reader >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -1103,6 +1263,78 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+{
+    CDiskBlockPos hpos = pos;
+    if (hpos.nPos < 8) {
+        return error("%s: invalid block position %s", __func__, pos.ToString());
+    }
+    hpos.nPos -= 8; // Seek back 8 bytes for meta header
+
+    CMessageHeader::MessageStartChars blk_start;
+    unsigned int blk_size;
+
+    auto mapping = GetBlockFileMapping(pos.nFile);
+    if (mapping) {
+        try {
+            SpanReader reader(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(mapping->data, mapping->size), hpos.nPos);
+            reader >> blk_start >> blk_size;
+            if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+                return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+                        HexStr(blk_start, blk_start + CMessageHeader::MESSAGE_START_SIZE),
+                        HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
+            }
+            if (blk_size > MAX_SIZE || blk_size > reader.size()) {
+                return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
+                        blk_size, MAX_SIZE);
+            }
+            const unsigned char* begin = mapping->data + reader.tell();
+            block.assign(begin, begin + blk_size);
+        } catch (const std::exception& e) {
+            return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+        }
+        return true;
+    }
+
+    CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+    }
+
+    try {
+        filein >> blk_start >> blk_size;
+
+        if (memcmp(blk_start, message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+            return error("%s: Block magic mismatch for %s: %s versus expected %s", __func__, pos.ToString(),
+                    HexStr(blk_start, blk_start + CMessageHeader::MESSAGE_START_SIZE),
+                    HexStr(message_start, message_start + CMessageHeader::MESSAGE_START_SIZE));
+        }
+
+        if (blk_size > MAX_SIZE) {
+            return error("%s: Block data is larger than maximum deserialization size for %s: %s versus %s", __func__, pos.ToString(),
+                    blk_size, MAX_SIZE);
+        }
+
+        block.resize(blk_size); // Zeroing of memory is intentional here
+        filein.read((char*)block.data(), blk_size);
+    } catch (const std::exception& e) {
+        return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
+    }
+
+    return true;
+}
+
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+{
+    CDiskBlockPos block_pos;
+    {
+        LOCK(cs_main);
+        block_pos = pindex->GetBlockPos();
+    }
+
+    return ReadRawBlockFromDisk(block, block_pos, message_start);
+}
+
 double ConvertBitsToDouble(unsigned int nBits)
 {
     int nShift = (nBits >> 24) & 0xff;
@@ -1432,8 +1664,7 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 
 bool CScriptCheck::operator()() {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
-    PrecomputedTransactionData txdata(*ptxTo);
-    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, txdata, cacheStore), &error);
+    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, *txdata, cacheStore), &error);
 }
 
 int GetSpendHeight(const CCoinsViewCache& inputs)
@@ -1470,6 +1701,8 @@ void InitScriptExecutionCache() {
  *
  * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
  */
+static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+
 bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, std::vector<CScriptCheck> *pvChecks)
 {
     boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
@@ -1503,6 +1736,29 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 return true;
             }
 
+            // Spread the scripts of large transactions (e.g. CoinJoin finals) over the script check
+            // threads when nobody collects the checks for us. Only when that fails the serial loop
+            // below runs again, to find the failing input and the exact reason to reject it for.
+            if (!pvChecks && nScriptCheckThreads && tx.vin.size() >= MIN_PARALLEL_SCRIPT_CHECK_INPUTS) {
+                std::vector<CScriptCheck> vChecks;
+                vChecks.reserve(tx.vin.size());
+                for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                    const Coin& coin = inputs.AccessCoin(tx.vin[i].prevout);
+                    assert(!coin.IsSpent());
+                    CScriptCheck check(coin.out, tx, i, flags, cacheSigStore, &txdata);
+                    vChecks.emplace_back();
+                    check.swap(vChecks.back());
+                }
+                CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+                control.Add(vChecks);
+                if (control.Wait()) {
+                    if (cacheFullScriptStore) {
+                        scriptExecutionCache.insert(hashCacheEntry);
+                    }
+                    return true;
+                }
+            }
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
                 const Coin& coin = inputs.AccessCoin(prevout);
@@ -1561,9 +1817,29 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
     return true;
 }
 
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks)
+{
+    if (!nScriptCheckThreads || vChecks.size() < MIN_PARALLEL_SCRIPT_CHECK_INPUTS) {
+        for (auto& check : vChecks) {
+            if (!check()) return false;
+        }
+        return true;
+    }
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
 namespace {
 
-bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+/** Upper bound for the undo data of recent blocks kept in memory, so reorgs of the tip don't need to read it back */
+static const size_t MAX_UNDO_CACHE_BLOCKS = 10;
+
+CCriticalSection cs_undoCache;
+unordered_lru_cache<uint256, std::shared_ptr<const CBlockUndo>, StaticSaltedHasher, MAX_UNDO_CACHE_BLOCKS> undoCache GUARDED_BY(cs_undoCache);
+
+/** Write the already serialized undo data of a block, the checksum covers the same bytes as the original format */
+bool UndoWriteToDisk(const CDataStream& ssUndo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
@@ -1571,7 +1847,7 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
         return error("%s: OpenUndoFile failed", __func__);
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, blockundo);
+    unsigned int nSize = ssUndo.size();
     fileout << messageStart << nSize;
 
     // Write undo data
@@ -1579,48 +1855,17 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     if (fileOutPos < 0)
         return error("%s: ftell failed", __func__);
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    fileout.write(ssUndo.data(), ssUndo.size());
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
-    hasher << blockundo;
+    hasher.write(ssUndo.data(), ssUndo.size());
     fileout << hasher.GetHash();
 
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
-{
-    CDiskBlockPos pos = pindex->GetUndoPos();
-    if (pos.IsNull()) {
-        return error("%s: no undo data available", __func__);
-    }
-
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Read block
-    uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
-    try {
-        verifier << pindex->pprev->GetBlockHash();
-        verifier >> blockundo;
-        filein >> hashChecksum;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
-    }
-
-    // Verify checksum
-    if (hashChecksum != verifier.GetHash())
-        return error("%s: Checksum mismatch", __func__);
-
-    return true;
-}
-
 /** Abort with a message */
 bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1641,6 +1886,92 @@ bool AbortNode(CValidationState& state, const std::string& strMessage, const std
 
 } // namespace
 
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull()) {
+        return error("%s: no undo data available", __func__);
+    }
+
+    const uint256 hashBlock = pindex->GetBlockHash();
+    {
+        LOCK(cs_undoCache);
+        std::shared_ptr<const CBlockUndo> cached;
+        if (undoCache.get(hashBlock, cached)) {
+            blockundo = *cached;
+            return true;
+        }
+    }
+    if (pos.nPos < 4) {
+        return error("%s: invalid undo position %s", __func__, pos.ToString());
+    }
+
+    // The size in the index header lets us checksum the raw bytes and deserialize without a CHashVerifier,
+    // straight from the mapping if the undo file is mapped and the record was written before it was mapped
+    unsigned int nSize = 0;
+    uint256 hashChecksum;
+    Span<const unsigned char> data;
+    std::vector<unsigned char> vData;
+    auto mapping = GetBlockFileMapping(pos.nFile, true);
+    if (mapping && pos.nPos <= mapping->size) {
+        try {
+            SpanReader reader(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(mapping->data, mapping->size), pos.nPos - 4);
+            reader >> nSize;
+            if ((uint64_t)nSize + sizeof(hashChecksum) <= reader.size()) {
+                data = Span<const unsigned char>(mapping->data + reader.tell(), nSize);
+                reader.seek(nSize);
+                reader >> hashChecksum;
+            }
+        } catch (const std::exception& e) {
+            return error("%s: Read from undo file failed: %s for %s", __func__, e.what(), pos.ToString());
+        }
+    }
+    if (data.size() == 0) {
+        // Open history file to read
+        CAutoFile filein(OpenUndoFile(CDiskBlockPos(pos.nFile, pos.nPos - 4), true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenUndoFile failed", __func__);
+
+        try {
+            filein >> nSize;
+            if (nSize > MAX_SIZE) {
+                return error("%s: Undo data is larger than maximum deserialization size for %s", __func__, pos.ToString());
+            }
+            vData.resize(nSize);
+            filein.read((char*)vData.data(), vData.size());
+            filein >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
+        data = Span<const unsigned char>(vData.data(), vData.size());
+    }
+
+    // Verify checksum
+    CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
+    hasher << pindex->pprev->GetBlockHash();
+    hasher.write((const char*)data.data(), data.size());
+    if (hashChecksum != hasher.GetHash())
+        return error("%s: Checksum mismatch", __func__);
+
+    // Read undo data
+    try {
+        SpanReader reader(SER_DISK, CLIENT_VERSION, data);
+        if (pindex->nStatus & BLOCK_UNDO_COMPACT) {
+            reader >> CompactBlockUndoDeserializer(&blockundo, pindex->nHeight);
+        } else {
+            reader >> blockundo;
+        }
+    }
+    catch (const std::exception& e) {
+        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    LOCK(cs_undoCache);
+    undoCache.insert(hashBlock, std::make_shared<const CBlockUndo>(blockundo));
+    return true;
+}
+
 /**
  * Restore the UTXO in a Coin at a given COutPoint
  * @param undo The Coin to be restored.
@@ -1884,33 +2215,125 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
 {
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull()) {
+        CDataStream ssUndo(SER_DISK, CLIENT_VERSION);
+        if (fCompactUndo) {
+            ssUndo << CompactBlockUndoSerializer(&blockundo, pindex->nHeight);
+        } else {
+            ssUndo << blockundo;
+        }
+
         CDiskBlockPos _pos;
-        if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
+        if (!FindUndoPos(state, pindex->nFile, _pos, ssUndo.size() + 40))
             return error("ConnectBlock(): FindUndoPos failed");
-        if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
+        if (!UndoWriteToDisk(ssUndo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
             return AbortNode(state, "Failed to write undo data");
 
         // update nUndoPos in block index
         pindex->nUndoPos = _pos.nPos;
         pindex->nStatus |= BLOCK_HAVE_UNDO;
+        if (fCompactUndo) {
+            pindex->nStatus |= BLOCK_UNDO_COMPACT;
+        }
         setDirtyBlockIndex.insert(pindex);
+
+        // Blocks at the tip are the ones likely to be disconnected again
+        if (!IsInitialBlockDownload()) {
+            LOCK(cs_undoCache);
+            undoCache.insert(pindex->GetBlockHash(), std::make_shared<const CBlockUndo>(blockundo));
+        }
     }
 
     return true;
 }
 
-static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex)
+void GetTxIndexDataForBlock(const CBlock& block, const CBlockIndex* pindex, std::vector<std::pair<uint256, CDiskTxPos> >& vPos)
 {
-    if (!fTxIndex) return true;
-
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
-    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
-    vPos.reserve(block.vtx.size());
+    vPos.reserve(vPos.size() + block.vtx.size());
     for (const CTransactionRef& tx : block.vtx)
     {
         vPos.push_back(std::make_pair(tx->GetHash(), pos));
         pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
     }
+}
+
+void AddInputIndexData(const CTransaction& tx, unsigned int i, size_t j, const CTxOut& prevout, int nHeight, bool fAddress, bool fSpent,
+                       std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& addressUnspentIndex,
+                       std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& spentIndex)
+{
+    const CTxIn& input = tx.vin[j];
+    const uint256 txhash = tx.GetHash();
+    uint160 hashBytes;
+    int addressType;
+
+    if (prevout.scriptPubKey.IsPayToScriptHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
+        addressType = 2;
+    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
+        hashBytes = uint160(std::vector<unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
+        addressType = 1;
+    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
+        hashBytes = Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1);
+        addressType = 1;
+    } else {
+        hashBytes.SetNull();
+        addressType = 0;
+    }
+
+    if (fAddress && addressType > 0) {
+        // record spending activity
+        addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, nHeight, i, txhash, j, true), prevout.nValue * -1));
+
+        // remove address from unspent index
+        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
+    }
+
+    if (fSpent) {
+        // add the spent index to determine the txid and input that spent an output
+        // and to find the amount and address from an input
+        spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, nHeight, prevout.nValue, addressType, hashBytes)));
+    }
+}
+
+void AddOutputIndexData(const CTransaction& tx, unsigned int i, unsigned int k, int nHeight,
+                        std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& addressUnspentIndex)
+{
+    const CTxOut &out = tx.vout[k];
+    const uint256 txhash = tx.GetHash();
+
+    if (out.scriptPubKey.IsPayToScriptHash()) {
+        std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
+
+        // record receiving activity
+        addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), nHeight, i, txhash, k, false), out.nValue));
+
+        // record unspent output
+        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight)));
+
+    } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
+        std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
+
+        // record receiving activity
+        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), nHeight, i, txhash, k, false), out.nValue));
+
+        // record unspent output
+        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight)));
+
+    } else if (out.scriptPubKey.IsPayToPublicKey()) {
+        uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
+        addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, nHeight, i, txhash, k, false), out.nValue));
+        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight)));
+    }
+}
+
+static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex)
+{
+    if (!fTxIndex) return true;
+
+    std::vector<std::pair<uint256, CDiskTxPos> > vPos;
+    GetTxIndexDataForBlock(block, pindex, vPos);
 
     if (!pblocktree->WriteTxIndex(vPos)) {
         return AbortNode(state, "Failed to write transaction index");
@@ -1919,13 +2342,123 @@ static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& stat
     return true;
 }
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
 void ThreadScriptCheck() {
     RenameThread("dash-scriptch");
     scriptcheckqueue.Thread();
 }
 
+void UseExecutorForScriptChecks(int nHelpers)
+{
+    scriptcheckqueue.SetExecutor(&GetExecutor(), nHelpers);
+}
+
+namespace {
+/** Upper bound for coins read ahead but not yet used by ConnectBlock */
+static const size_t MAX_PREFETCHED_COINS = 100000;
+/** Coins read from pcoinsdbview ahead of time, attached to pcoinsTip */
+CCoinsPrefetchCache coinsPrefetchCache(MAX_PREFETCHED_COINS);
+
+boost::mutex cs_coinsPrefetchQueue;
+boost::condition_variable condCoinsPrefetchQueue;
+std::deque<CDiskBlockPos> coinsPrefetchQueue;
+/** Last block queued for prefetching, protected by cs_main */
+const CBlockIndex* pindexLastCoinsPrefetch = nullptr;
+} // anon namespace
+
+/**
+ * Queue the blocks after the next one to connect for reading ahead their inputs. The next block
+ * itself is handled by ConnectTip, which prefetches its inputs right before connecting it.
+ */
+static void QueueCoinsPrefetch(const std::vector<CBlockIndex*>& vpindexToConnect) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    AssertLockHeld(cs_main);
+    if (nCoinsPrefetchBlocks <= 0 || vpindexToConnect.size() < 2) {
+        return;
+    }
+    pcoinsTip->SetPrefetchCache(&coinsPrefetchCache);
+
+    // Don't queue blocks again that were already queued by a previous call
+    const CBlockIndex* pindexTarget = vpindexToConnect.front();
+    int nSkipHeight = -1;
+    if (pindexLastCoinsPrefetch && pindexTarget->GetAncestor(pindexLastCoinsPrefetch->nHeight) == pindexLastCoinsPrefetch) {
+        nSkipHeight = pindexLastCoinsPrefetch->nHeight;
+    }
+
+    const int nMaxHeight = vpindexToConnect.back()->nHeight + nCoinsPrefetchBlocks;
+    boost::unique_lock<boost::mutex> lock(cs_coinsPrefetchQueue);
+    // vpindexToConnect is ordered from the last to the first block to connect
+    for (auto it = vpindexToConnect.rbegin() + 1; it != vpindexToConnect.rend() && (*it)->nHeight <= nMaxHeight; ++it) {
+        const CBlockIndex* pindex = *it;
+        if (pindex->nHeight <= nSkipHeight) {
+            continue;
+        }
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA)) {
+            break;
+        }
+        coinsPrefetchQueue.emplace_back(pindex->GetBlockPos());
+        pindexLastCoinsPrefetch = pindex;
+    }
+    condCoinsPrefetchQueue.notify_one();
+}
+
+void ThreadCoinsPrefetch()
+{
+    RenameThread("dash-coinsprefetch");
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+
+    while (true) {
+        CDiskBlockPos pos;
+        {
+            boost::unique_lock<boost::mutex> lock(cs_coinsPrefetchQueue);
+            while (coinsPrefetchQueue.empty()) {
+                condCoinsPrefetchQueue.wait(lock);
+            }
+            pos = coinsPrefetchQueue.front();
+            coinsPrefetchQueue.pop_front();
+        }
+
+        // Remember the generation before touching the database, so that results read while
+        // pcoinsTip is being flushed are discarded
+        const uint64_t nGeneration = coinsPrefetchCache.GetGeneration();
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pos, consensusParams)) {
+            continue;
+        }
+
+        std::set<uint256> blockTxids;
+        for (const auto& tx : block.vtx) {
+            blockTxids.emplace(tx->GetHash());
+        }
+        std::vector<COutPoint> vOutpoints;
+        for (const auto& tx : block.vtx) {
+            if (tx->IsCoinBase()) continue;
+            for (const CTxIn& txin : tx->vin) {
+                if (!blockTxids.count(txin.prevout.hash)) {
+                    vOutpoints.emplace_back(txin.prevout);
+                }
+            }
+        }
+        std::vector<std::pair<COutPoint, Coin>> vCoins;
+        try {
+            // All inputs of the block in one pass over the database
+            std::vector<Coin> coins;
+            std::vector<bool> found;
+            vCoins.reserve(pcoinsdbview->GetCoins(vOutpoints, coins, found));
+            for (size_t i = 0; i < vOutpoints.size(); i++) {
+                if (found[i]) {
+                    vCoins.emplace_back(vOutpoints[i], std::move(coins[i]));
+                }
+            }
+        } catch (const std::exception& e) {
+            // Leave it to ConnectBlock to run into (and handle) database errors
+            LogPrintf("%s: %s\n", __func__, e.what());
+            continue;
+        }
+        boost::this_thread::interruption_point();
+        coinsPrefetchCache.Add(std::move(vCoins), nGeneration);
+    }
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2037,6 +2570,8 @@ static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
+// The stages of the block ConnectTip is connecting, ConnectBlock and ProcessSpecialTxsInBlock fill in theirs
+static CBlockConnectTimings blockConnectTimings;
 static int64_t nBlocksTotal = 0;
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
@@ -2128,6 +2663,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     }
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
+    TRACE3(validation, connect_block_stage, pindex->nHeight, "sanity", nTime1 - nTimeStart);
     LogPrint(BCLog::BENCHMARK, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
@@ -2188,7 +2724,12 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     unsigned int flags = GetBlockScriptFlags(pindex, chainparams.GetConsensus());
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
+    TRACE3(validation, connect_block_stage, pindex->nHeight, "forks", nTime2 - nTime1);
     LogPrint(BCLog::BENCHMARK, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
+    blockConnectTimings.nHeight = pindex->nHeight;
+    blockConnectTimings.blockHash = pindex->GetBlockHash();
+    blockConnectTimings.nTxs = block.vtx.size();
+    blockConnectTimings.nChecks = nTime2 - nTimeStart;
 
     CBlockUndo blockundo;
 
@@ -2209,12 +2750,13 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     bool fDIP0001Active_context = pindex->nHeight >= Params().GetConsensus().DIP0001Height;
 
     // MUST process special txes before updating UTXO to ensure consistency between mempool and block processing
-    if (!ProcessSpecialTxsInBlock(block, pindex, state, view, fJustCheck, fScriptChecks)) {
+    if (!ProcessSpecialTxsInBlock(block, pindex, state, view, fJustCheck, fScriptChecks, &blockConnectTimings)) {
         return error("ConnectBlock(DASH): ProcessSpecialTxsInBlock for block %s failed with %s",
                      pindex->GetBlockHash().ToString(), FormatStateMessage(state));
     }
 
     int64_t nTime2_1 = GetTimeMicros(); nTimeProcessSpecial += nTime2_1 - nTime2;
+    TRACE3(validation, connect_block_stage, pindex->nHeight, "special_txs", nTime2_1 - nTime2);
     LogPrint(BCLog::BENCHMARK, "      - ProcessSpecialTxsInBlock: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2_1 - nTime2), nTimeProcessSpecial * MICRO, nTimeProcessSpecial * MILLI / nBlocksTotal);
 
     for (unsigned int i = 0; i < block.vtx.size(); i++)
@@ -2252,39 +2794,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             if (fAddressIndex || fSpentIndex)
             {
                 for (size_t j = 0; j < tx.vin.size(); j++) {
-                    const CTxIn input = tx.vin[j];
                     const Coin& coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CTxOut &prevout = coin.out;
-                    uint160 hashBytes;
-                    int addressType;
-
-                    if (prevout.scriptPubKey.IsPayToScriptHash()) {
-                        hashBytes = uint160(std::vector<unsigned char>(prevout.scriptPubKey.begin()+2, prevout.scriptPubKey.begin()+22));
-                        addressType = 2;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKeyHash()) {
-                        hashBytes = uint160(std::vector<unsigned char>(prevout.scriptPubKey.begin()+3, prevout.scriptPubKey.begin()+23));
-                        addressType = 1;
-                    } else if (prevout.scriptPubKey.IsPayToPublicKey()) {
-                        hashBytes = Hash160(prevout.scriptPubKey.begin()+1, prevout.scriptPubKey.end()-1);
-                        addressType = 1;
-                    } else {
-                        hashBytes.SetNull();
-                        addressType = 0;
-                    }
-
-                    if (fAddressIndex && addressType > 0) {
-                        // record spending activity
-                        addressIndex.push_back(std::make_pair(CAddressIndexKey(addressType, hashBytes, pindex->nHeight, i, txhash, j, true), prevout.nValue * -1));
-
-                        // remove address from unspent index
-                        addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(addressType, hashBytes, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                    }
-
-                    if (fSpentIndex) {
-                        // add the spent index to determine the txid and input that spent an output
-                        // and to find the amount and address from an input
-                        spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, prevout.nValue, addressType, hashBytes)));
-                    }
+                    AddInputIndexData(tx, i, j, coin.out, pindex->nHeight, fAddressIndex, fSpentIndex, addressIndex, addressUnspentIndex, spentIndex);
                 }
 
             }
@@ -2299,7 +2810,13 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
+        // Reuse the signature hashes computed when the TX was accepted to the mempool, if it was
+        std::shared_ptr<const PrecomputedTransactionData> mempoolTxData = mempool.GetTxData(tx.GetHash());
+        if (mempoolTxData) {
+            txdata.emplace_back(*mempoolTxData);
+        } else {
+            txdata.emplace_back(tx);
+        }
         if (!tx.IsCoinBase())
         {
 
@@ -2313,34 +2830,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
         if (fAddressIndex) {
             for (unsigned int k = 0; k < tx.vout.size(); k++) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(2, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(2, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    std::vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-
-                    // record receiving activity
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, uint160(hashBytes), pindex->nHeight, i, txhash, k, false), out.nValue));
-
-                    // record unspent output
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, uint160(hashBytes), txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-
-                } else if (out.scriptPubKey.IsPayToPublicKey()) {
-                    uint160 hashBytes(Hash160(out.scriptPubKey.begin()+1, out.scriptPubKey.end()-1));
-                    addressIndex.push_back(std::make_pair(CAddressIndexKey(1, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
-                    addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(1, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
-                } else {
-                    continue;
-                }
-
+                AddOutputIndexData(tx, i, k, pindex->nHeight, addressIndex, addressUnspentIndex);
             }
         }
 
@@ -2351,11 +2841,16 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
+    TRACE3(validation, connect_block_stage, pindex->nHeight, "connect_txs", nTime3 - nTime2_1);
+    blockConnectTimings.nInputs = nInputs;
+    blockConnectTimings.nConnect = nTime3 - nTime2_1;
     LogPrint(BCLog::BENCHMARK, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
 
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
+    TRACE3(validation, connect_block_stage, pindex->nHeight, "verify_scripts", nTime4 - nTime3);
+    blockConnectTimings.nScripts = nTime4 - nTime3;
     LogPrint(BCLog::BENCHMARK, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
 
 
@@ -2421,6 +2916,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     LogPrint(BCLog::BENCHMARK, "      - IsBlockPayeeValid: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5_4 - nTime5_3), nTimePayeeValid * MICRO, nTimePayeeValid * MILLI / nBlocksTotal);
 
     int64_t nTime5 = GetTimeMicros(); nTimeDashSpecific += nTime5 - nTime4;
+    TRACE3(validation, connect_block_stage, pindex->nHeight, "dash_specific", nTime5 - nTime4);
+    blockConnectTimings.nDashSpecific = nTime5 - nTime4;
     LogPrint(BCLog::BENCHMARK, "    - Dash specific: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeDashSpecific * MICRO, nTimeDashSpecific * MILLI / nBlocksTotal);
 
     // END DASH
@@ -2462,11 +2959,15 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime6 = GetTimeMicros(); nTimeIndex += nTime6 - nTime5;
+    TRACE3(validation, connect_block_stage, pindex->nHeight, "index", nTime6 - nTime5);
     LogPrint(BCLog::BENCHMARK, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime5), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
 
     evoDb->WriteBestBlock(pindex->GetBlockHash());
 
     int64_t nTime7 = GetTimeMicros(); nTimeCallbacks += nTime7 - nTime6;
+    TRACE3(validation, connect_block_stage, pindex->nHeight, "callbacks", nTime7 - nTime6);
+    TRACE5(validation, block_connected, pindex->phashBlock->begin(), pindex->nHeight, block.vtx.size(), nInputs, nTime7 - nTimeStart);
+    blockConnectTimings.nIndex = nTime7 - nTime5;
     LogPrint(BCLog::BENCHMARK, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime7 - nTime6), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
 
     boost::posix_time::ptime finish = boost::posix_time::microsec_clock::local_time();
@@ -2531,6 +3032,7 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         }
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
         int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        cacheSize += pcoinsdbview->PendingMemoryUsage();
         cacheSize += evoDb->GetMemoryUsage();
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
@@ -2588,6 +3090,15 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             if (!evoDb->CommitRootTransaction()) {
                 return AbortNode(state, "Failed to commit EvoDB");
             }
+            // Works on the committed data, so it has to come after the commit
+            if (fFlushForPrune) {
+                PruneSpecialTxData(chainActive.Tip());
+            }
+            // The coins may still be written in the background, which is fine for periodic flushes.
+            // Explicit flushes and pruning expect them on disk when we return.
+            if ((mode == FlushStateMode::ALWAYS || fFlushForPrune) && !pcoinsdbview->WaitForWrite()) {
+                return AbortNode(state, "Failed to write to coin database");
+            }
             nLastFlush = nNow;
         }
     }
@@ -2757,6 +3268,52 @@ static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
 
+// -blocktimingslog, guarded by cs_main
+static FILE* fileBlockTimings = nullptr;
+
+bool OpenBlockTimingsLog(const fs::path& path)
+{
+    LOCK(cs_main);
+    if (fileBlockTimings) {
+        fclose(fileBlockTimings);
+    }
+    fileBlockTimings = fsbridge::fopen(path, "a");
+    if (!fileBlockTimings) {
+        return false;
+    }
+    if (ftell(fileBlockTimings) == 0) {
+        fputs("height,hash,txs,inputs,load_us,prefetch_us,checks_us,specialtxs_us,quorums_us,mnlist_us,cbtx_merkle_us,"
+              "connect_us,scripts_us,dash_us,index_us,flush_us,chainstate_us,postconnect_us,total_us\n", fileBlockTimings);
+    }
+    return true;
+}
+
+void CloseBlockTimingsLog()
+{
+    LOCK(cs_main);
+    if (fileBlockTimings) {
+        fclose(fileBlockTimings);
+        fileBlockTimings = nullptr;
+    }
+}
+
+static void WriteBlockTimings(const CBlockConnectTimings& t)
+{
+    AssertLockHeld(cs_main);
+    if (!fileBlockTimings) {
+        return;
+    }
+    std::string strLine = strprintf("%d,%s,%u,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n",
+        t.nHeight, t.blockHash.ToString(), t.nTxs, t.nInputs, t.nLoad, t.nPrefetch, t.nChecks, t.nSpecialTxs, t.nQuorums,
+        t.nMNList, t.nCbTxMerkleRoots, t.nConnect, t.nScripts, t.nDashSpecific, t.nIndex, t.nFlush, t.nChainState,
+        t.nPostConnect, t.nTotal);
+    if (fwrite(strLine.data(), 1, strLine.size(), fileBlockTimings) != strLine.size() || fflush(fileBlockTimings) != 0) {
+        LogPrintf("%s: failed to write to the block timings log, closing it\n", __func__);
+        fclose(fileBlockTimings);
+        fileBlockTimings = nullptr;
+    }
+}
+
 struct PerBlockConnectTrace {
     CBlockIndex* pindex = nullptr;
     std::shared_ptr<const CBlock> pblock;
@@ -2832,6 +3389,7 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
 {
     boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
     assert(pindexNew->pprev == chainActive.Tip());
+    blockConnectTimings = CBlockConnectTimings();
     // Read block from disk.
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
@@ -2848,6 +3406,28 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCHMARK, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    blockConnectTimings.nLoad = nTime2 - nTime1;
+    if (nScriptCheckThreads > 0) {
+        // Look up the block's inputs in the coins database in parallel before ConnectBlock walks
+        // them one by one. Outputs created inside the block itself are not in the database.
+        std::set<uint256> blockTxids;
+        std::vector<COutPoint> prevouts;
+        for (const auto& tx : blockConnecting.vtx) {
+            blockTxids.emplace(tx->GetHash());
+        }
+        for (const auto& tx : blockConnecting.vtx) {
+            if (tx->IsCoinBase()) continue;
+            for (const CTxIn& txin : tx->vin) {
+                if (!blockTxids.count(txin.prevout.hash)) {
+                    prevouts.emplace_back(txin.prevout);
+                }
+            }
+        }
+        size_t nPrefetched = pcoinsTip->PrefetchCoins(prevouts, nScriptCheckThreads);
+        int64_t nTimePrefetch = GetTimeMicros();
+        LogPrint(BCLog::BENCHMARK, "  - Prefetch %u/%u inputs: %.2fms\n", nPrefetched, prevouts.size(), (nTimePrefetch - nTime2) * MILLI);
+        blockConnectTimings.nPrefetch = nTimePrefetch - nTime2;
+    }
     {
         auto dbTx = evoDb->BeginTransaction();
 
@@ -2882,6 +3462,11 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCHMARK, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCHMARK, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
+    blockConnectTimings.nFlush = nTime4 - nTime3;
+    blockConnectTimings.nChainState = nTime5 - nTime4;
+    blockConnectTimings.nPostConnect = nTime6 - nTime5;
+    blockConnectTimings.nTotal = nTime6 - nTime1;
+    WriteBlockTimings(blockConnectTimings);
 
     boost::posix_time::ptime finish = boost::posix_time::microsec_clock::local_time();
     boost::posix_time::time_duration diff = finish - start;
@@ -3005,6 +3590,10 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
         }
         nHeight = nTargetHeight;
 
+        if (nCoinsPrefetchBlocks > 0) {
+            QueueCoinsPrefetch(vpindexToConnect);
+        }
+
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
             if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
@@ -3217,6 +3806,86 @@ bool PreciousBlock(CValidationState& state, const CChainParams& params, CBlockIn
     return g_chainstate.PreciousBlock(state, params, pindex);
 }
 
+bool CChainState::ActivateSnapshot(CBlockIndex* pindexBase, unsigned int nChainTx)
+{
+    AssertLockHeld(cs_main);
+    assert(chainActive.Height() == 0);
+
+    std::vector<CBlockIndex*> vChain;
+    for (CBlockIndex* pindex = pindexBase; pindex->pprev; pindex = pindex->pprev) {
+        if (pindex->nStatus & (BLOCK_FAILED_MASK | BLOCK_CONFLICT_CHAINLOCK)) {
+            return error("%s: block %s is marked invalid", __func__, pindex->GetBlockHash().ToString());
+        }
+        vChain.push_back(pindex);
+    }
+    std::reverse(vChain.begin(), vChain.end());
+
+    // The blocks that were never downloaded are counted as one transaction each, the base block gets the rest of
+    // nChainTx so that the verification progress is estimated right. Once they have nTx set, the blocks look just
+    // like pruned ones.
+    std::deque<CBlockIndex*> queue;
+    for (CBlockIndex* pindex : vChain) {
+        if (pindex->nTx == 0) {
+            pindex->nTx = 1;
+            if (pindex == pindexBase && nChainTx > pindex->pprev->nChainTx + 1) {
+                pindex->nTx = nChainTx - pindex->pprev->nChainTx;
+            }
+        }
+        pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        pindex->RaiseValidity(BLOCK_VALID_SCRIPTS);
+        setDirtyBlockIndex.insert(pindex);
+
+        // Blocks of other branches that were received while their parents were missing are linked below
+        auto range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            CBlockIndex* pindexChild = range.first->second;
+            if (pindexBase->GetAncestor(pindexChild->nHeight) != pindexChild) {
+                queue.push_back(pindexChild);
+            }
+            range.first = mapBlocksUnlinked.erase(range.first);
+        }
+    }
+
+    chainActive.SetTip(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    while (!queue.empty()) {
+        CBlockIndex* pindex = queue.front();
+        queue.pop_front();
+        pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+        if (!setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip()) && !(pindex->nStatus & BLOCK_CONFLICT_CHAINLOCK)) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+        auto range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            queue.push_back(range.first->second);
+            range.first = mapBlocksUnlinked.erase(range.first);
+        }
+    }
+    PruneBlockIndexCandidates();
+    pcoinsTip->SetBestBlock(pindexBase->GetBlockHash());
+
+    fHavePruned = true;
+    fSnapshotChainstate = true;
+    FlushStateToDisk();
+    if (!pblocktree->WriteFlag("snapshotchainstate", true)) {
+        return error("%s: failed to write to the block tree database", __func__);
+    }
+    LogPrintf("%s: loaded chainstate snapshot of block %s at height %d\n", __func__, pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+
+    GetMainSignals().SynchronousUpdatedBlockTip(pindexBase, nullptr, IsInitialBlockDownload());
+    GetMainSignals().UpdatedBlockTip(pindexBase, nullptr, IsInitialBlockDownload());
+    uiInterface.NotifyBlockTip(IsInitialBlockDownload(), pindexBase);
+    return true;
+}
+
+bool ActivateSnapshotChainstate(CBlockIndex* pindexBase, unsigned int nChainTx) {
+    return g_chainstate.ActivateSnapshot(pindexBase, nChainTx);
+}
+
 bool CChainState::InvalidateBlock(CValidationState& state, const CChainParams& chainparams, CBlockIndex *pindex)
 {
     AssertLockHeld(cs_main);
@@ -3427,19 +4096,18 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex) {
     return g_chainstate.ResetBlockFailureFlags(pindex);
 }
 
-CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block, enum BlockStatus nStatus)
+CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block, const uint256& hash, enum BlockStatus nStatus)
 {
     assert(!(nStatus & BLOCK_FAILED_MASK)); // no failed blocks alowed
     AssertLockHeld(cs_main);
 
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator it = mapBlockIndex.find(hash);
     if (it != mapBlockIndex.end())
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = mapBlockIndex.NewIndex(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3608,16 +4276,16 @@ static bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos,
     return true;
 }
 
-static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
+static bool CheckBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW = true)
 {
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckProofOfWork(hash, block.nBits, consensusParams))
         return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
 
     // Check DevNet
     if (!consensusParams.hashDevnetGenesisBlock.IsNull() &&
             block.hashPrevBlock == consensusParams.hashGenesisBlock &&
-            block.GetHash() != consensusParams.hashDevnetGenesisBlock) {
+            hash != consensusParams.hashDevnetGenesisBlock) {
         return state.DoS(100, error("CheckBlockHeader(): wrong devnet genesis"),
                          REJECT_INVALID, "devnet-genesis");
     }
@@ -3636,7 +4304,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 
     // Check that the header is valid (particularly PoW).  This is mostly
     // redundant with the call in AcceptBlockHeader.
-    if (!CheckBlockHeader(block, state, consensusParams, fCheckPOW))
+    if (!CheckBlockHeader(block, block.GetHash(), state, consensusParams, fCheckPOW))
         return false;
 
     // Check the merkle root.
@@ -3817,11 +4485,10 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, const uint256& hash, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckedHeader)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
-    uint256 hash = block.GetHash();
     BlockMap::iterator miSelf = mapBlockIndex.find(hash);
     CBlockIndex *pindex = nullptr;
 
@@ -3839,7 +4506,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!fCheckedHeader && !CheckBlockHeader(block, hash, state, chainparams.GetConsensus()))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3880,13 +4547,13 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 
         if (llmq::chainLocksHandler->HasConflictingChainLock(pindexPrev->nHeight + 1, hash)) {
             if (pindex == nullptr) {
-                AddToBlockIndex(block, BLOCK_CONFLICT_CHAINLOCK);
+                AddToBlockIndex(block, hash, BLOCK_CONFLICT_CHAINLOCK);
             }
             return state.DoS(10, error("%s: header %s conflicts with chainlock", __func__, hash.ToString()), REJECT_INVALID, "bad-chainlock");
         }
     }
     if (pindex == nullptr)
-        pindex = AddToBlockIndex(block);
+        pindex = AddToBlockIndex(block, hash);
 
     if (ppindex)
         *ppindex = pindex;
@@ -3899,15 +4566,58 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
     return true;
 }
 
+std::vector<uint256> GetBlockHeaderHashesParallel(const std::vector<CBlockHeader>& headers)
+{
+    if (headers.size() <= HEADERS_PER_HASH_TASK) {
+        return GetBlockHeaderHashes(headers);
+    }
+
+    std::vector<uint256> hashes(headers.size());
+    size_t nTasks = (headers.size() + HEADERS_PER_HASH_TASK - 1) / HEADERS_PER_HASH_TASK;
+    GetExecutor().ParallelFor(ExecutorPriority::CONSENSUS, nTasks, [&](size_t nTask) {
+        size_t nBegin = nTask * HEADERS_PER_HASH_TASK;
+        size_t nCount = std::min(HEADERS_PER_HASH_TASK, headers.size() - nBegin);
+        GetBlockHeaderHashes(headers.data() + nBegin, nCount, hashes.data() + nBegin);
+    });
+    return hashes;
+}
+
 // Exposed wrapper for AcceptBlockHeader
-bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid, const std::vector<uint256>* header_hashes)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Hash all headers in parallel and outside of cs_main, unless the caller already did so
+    std::vector<uint256> computed_hashes;
+    if (header_hashes == nullptr) {
+        computed_hashes = GetBlockHeaderHashesParallel(headers);
+        header_hashes = &computed_hashes;
+    }
+    assert(header_hashes->size() == headers.size());
+
+    // The checks which don't depend on the chain (PoW) are done outside of cs_main too. A failing header is only
+    // reported once all headers before it were accepted, like when each header is checked by AcceptBlockHeader
+    size_t nFirstBadHeader = headers.size();
+    CValidationState badHeaderState;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (!CheckBlockHeader(headers[i], (*header_hashes)[i], badHeaderState, chainparams.GetConsensus())) {
+            nFirstBadHeader = i;
+            break;
+        }
+    }
+
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); ++i) {
+            const CBlockHeader& header = headers[i];
+            if (i == nFirstBadHeader) {
+                state = badHeaderState;
+                error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, (*header_hashes)[i].ToString(), FormatStateMessage(state));
+                if (first_invalid) *first_invalid = header;
+                return false;
+            }
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, (*header_hashes)[i], state, chainparams, &pindex, true)) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3952,7 +4662,7 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     CBlockIndex *pindexDummy = nullptr;
     CBlockIndex *&pindex = ppindex ? *ppindex : pindexDummy;
 
-    if (!AcceptBlockHeader(block, state, chainparams, &pindex))
+    if (!AcceptBlockHeader(block, block.GetHash(), state, chainparams, &pindex))
         return false;
 
     // Try to process all requested blocks that we don't have, but only
@@ -4095,6 +4805,42 @@ bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams,
     return true;
 }
 
+bool TestBlockTemplateValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, CAmount nFees)
+{
+    AssertLockHeld(cs_main);
+    assert(pindexPrev && pindexPrev == chainActive.Tip());
+
+    uint256 hash = block.GetHash();
+    if (llmq::chainLocksHandler->HasConflictingChainLock(pindexPrev->nHeight + 1, hash)) {
+        return state.DoS(10, error("%s: conflicting with chainlock", __func__), REJECT_INVALID, "bad-chainlock");
+    }
+
+    // NOTE: CheckBlockHeader is called by CheckBlock
+    if (!ContextualCheckBlockHeader(block, state, chainparams, pindexPrev, GetAdjustedTime()))
+        return error("%s: Consensus::ContextualCheckBlockHeader: %s", __func__, FormatStateMessage(state));
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), false, false))
+        return error("%s: Consensus::CheckBlock: %s", __func__, FormatStateMessage(state));
+    if (!ContextualCheckBlock(block, state, chainparams.GetConsensus(), pindexPrev))
+        return error("%s: Consensus::ContextualCheckBlock: %s", __func__, FormatStateMessage(state));
+
+    const int nHeight = pindexPrev->nHeight + 1;
+    if (nHeight >= chainparams.GetConsensus().DIP0003Height && !CheckCbTx(*block.vtx[0], pindexPrev, state)) {
+        return error("%s: CheckCbTx: %s", __func__, FormatStateMessage(state));
+    }
+
+    CAmount blockReward = nFees + GetBlockSubsidy(pindexPrev->nBits, pindexPrev->nHeight, chainparams.GetConsensus());
+    std::string strError = "";
+    if (!IsBlockValueValid(block, nHeight, blockReward, strError)) {
+        return state.DoS(0, error("%s: %s", __func__, strError), REJECT_INVALID, "bad-cb-amount");
+    }
+    if (!IsBlockPayeeValid(*block.vtx[0], nHeight, blockReward)) {
+        return state.DoS(0, error("%s: couldn't find masternode or superblock payments", __func__),
+                                REJECT_INVALID, "bad-cb-payee");
+    }
+
+    return true;
+}
+
 /**
  * BLOCK PRUNING CODE
  */
@@ -4121,6 +4867,7 @@ void PruneOneBlockFile(const int fileNumber)
         if (pindex->nFile == fileNumber) {
             pindex->nStatus &= ~BLOCK_HAVE_DATA;
             pindex->nStatus &= ~BLOCK_HAVE_UNDO;
+            pindex->nStatus &= ~BLOCK_UNDO_COMPACT;
             pindex->nFile = 0;
             pindex->nDataPos = 0;
             pindex->nUndoPos = 0;
@@ -4150,6 +4897,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        UnmapBlockFile(*it);
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -4274,6 +5022,11 @@ static FILE* OpenDiskFile(const CDiskBlockPos &pos, const char *prefix, bool fRe
 {
     if (pos.IsNull())
         return nullptr;
+    if (fReadOnlyReplica && !fReadOnly) {
+        // the block files belong to the primary
+        LogPrintf("Refusing to write to %s on a read-only replica\n", GetBlockPosFilename(pos, prefix).string());
+        return nullptr;
+    }
     fs::path path = GetBlockPosFilename(pos, prefix);
     fs::create_directories(path.parent_path());
     FILE* file = fsbridge::fopen(path, fReadOnly ? "rb": "rb+");
@@ -4320,7 +5073,7 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = mapBlockIndex.NewIndex();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -4329,7 +5082,7 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
 
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
+    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }, fCheckBlockIndex))
         return false;
 
     boost::this_thread::interruption_point();
@@ -4388,6 +5141,7 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
 {
     if (!g_chainstate.LoadBlockIndex(chainparams.GetConsensus(), *pblocktree))
         return false;
+    LogPrintf("%s: %u block index entries, %.1f MiB\n", __func__, mapBlockIndex.size(), mapBlockIndex.DynamicMemoryUsage() / 1048576.0);
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
@@ -4429,6 +5183,13 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams) EXCLUSIVE_LOCKS_RE
     if (fHavePruned)
         LogPrintf("LoadBlockIndexDB(): Block files have previously been pruned\n");
 
+    // The blocks before a UTXO snapshot were never downloaded, which is the same as having pruned them
+    pblocktree->ReadFlag("snapshotchainstate", fSnapshotChainstate);
+    if (fSnapshotChainstate) {
+        LogPrintf("LoadBlockIndexDB(): Chainstate was loaded from a UTXO snapshot\n");
+        fHavePruned = true;
+    }
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
@@ -4528,7 +5289,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone, false);
         if (pindex->nHeight <= chainActive.Height()-nCheckDepth)
             break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+        if ((fPruneMode || fSnapshotChainstate) && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
             // If pruning, only go back as far as we have data.
             LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
             break;
@@ -4593,6 +5354,183 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     return true;
 }
 
+namespace {
+
+/** The blocks of a background verification, handed out to the workers from the top down */
+struct BackgroundVerifyJob {
+    const CChainParams& chainparams;
+    int nCheckLevel;
+    std::vector<const CBlockIndex*> vBlocks;
+    std::atomic<size_t> nNext{0};
+    std::atomic<int> nVerified{0};
+    std::atomic<int> nWorkersLeft{0};
+
+    BackgroundVerifyJob(const CChainParams& chainparamsIn, int nCheckLevelIn) : chainparams(chainparamsIn), nCheckLevel(nCheckLevelIn) {}
+};
+
+} // namespace
+
+static CCriticalSection cs_backgroundVerify;
+static BackgroundVerifyStatus backgroundVerifyStatus GUARDED_BY(cs_backgroundVerify);
+static std::shared_ptr<BackgroundVerifyJob> backgroundVerifyJob GUARDED_BY(cs_backgroundVerify);
+static std::vector<std::future<void> > backgroundVerifyWorkers;
+static std::atomic<bool> fInterruptBackgroundVerify{false};
+
+/** Threads of the background verification, started on first use */
+static ctpl::thread_pool& GetBackgroundVerifyPool()
+{
+    static std::once_flag init;
+    static std::unique_ptr<ctpl::thread_pool> pool;
+    std::call_once(init, [] {
+        pool.reset(new ctpl::thread_pool(std::max(1, std::min(GetNumCores(), MAX_BACKGROUND_VERIFY_THREADS))));
+        RenameThreadPool(*pool, "dash-verifydb");
+    });
+    return *pool;
+}
+
+/** The checks of VerifyDB which don't depend on the coins, in the order of the check levels */
+static bool VerifyBlockInBackground(const BackgroundVerifyJob& job, const CBlockIndex* pindex, std::string& strError)
+{
+    CBlock block;
+    // check level 0: read from disk
+    if (!ReadBlockFromDisk(block, pindex, job.chainparams.GetConsensus())) {
+        strError = "ReadBlockFromDisk failed";
+        return false;
+    }
+    // check level 1: verify block validity
+    CValidationState state;
+    if (job.nCheckLevel >= 1 && !CheckBlock(block, state, job.chainparams.GetConsensus())) {
+        strError = strprintf("bad block (%s)", FormatStateMessage(state));
+        return false;
+    }
+    // check level 2: verify undo validity and that it matches the inputs of the block
+    if (job.nCheckLevel >= 2 && !pindex->GetUndoPos().IsNull()) {
+        CBlockUndo undo;
+        if (!UndoReadFromDisk(undo, pindex)) {
+            strError = "bad undo data";
+            return false;
+        }
+        if (undo.vtxundo.size() + 1 != block.vtx.size()) {
+            strError = "undo data doesn't match the transactions of the block";
+            return false;
+        }
+        for (size_t i = 1; i < block.vtx.size(); i++) {
+            if (undo.vtxundo[i - 1].vprevout.size() != block.vtx[i]->vin.size()) {
+                strError = strprintf("undo data doesn't match the inputs of tx %s", block.vtx[i]->GetHash().ToString());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void BackgroundVerifyWorker(const std::shared_ptr<BackgroundVerifyJob>& job)
+{
+    while (!fInterruptBackgroundVerify && !ShutdownRequested()) {
+        size_t i = job->nNext++;
+        if (i >= job->vBlocks.size()) {
+            break;
+        }
+        const CBlockIndex* pindex = job->vBlocks[i];
+        std::string strError;
+        if (!VerifyBlockInBackground(*job, pindex, strError)) {
+            fInterruptBackgroundVerify = true;
+            std::string strWarning = strprintf(_("Warning: Background verification found a corrupted block at height %d (%s). Restart with -reindex to rebuild the block database."),
+                pindex->nHeight, strError);
+            {
+                LOCK(cs_backgroundVerify);
+                if (backgroundVerifyStatus.nFailedHeight != -1) {
+                    break;
+                }
+                backgroundVerifyStatus.nFailedHeight = pindex->nHeight;
+                backgroundVerifyStatus.strError = strError;
+            }
+            LogPrintf("%s: *** %s at %d, hash=%s\n", __func__, strError, pindex->nHeight, pindex->GetBlockHash().ToString());
+            SetMiscWarning(strWarning);
+            AlertNotify(strWarning);
+            break;
+        }
+        job->nVerified++;
+    }
+
+    if (--job->nWorkersLeft == 0) {
+        LOCK(cs_backgroundVerify);
+        backgroundVerifyStatus.fRunning = false;
+        backgroundVerifyStatus.nVerified = job->nVerified;
+        backgroundVerifyStatus.nEndTime = GetTime();
+        backgroundVerifyJob.reset();
+        if (backgroundVerifyStatus.nFailedHeight == -1 && backgroundVerifyStatus.nVerified == backgroundVerifyStatus.nBlocks) {
+            LogPrintf("Background verification of %d blocks done in %ds\n", backgroundVerifyStatus.nVerified, backgroundVerifyStatus.nEndTime - backgroundVerifyStatus.nStartTime);
+        }
+    }
+}
+
+void StartBackgroundVerifyDB(const CChainParams& chainparams, int nCheckLevel, int nSkipDepth, int nCheckDepth)
+{
+    StopBackgroundVerifyDB();
+
+    auto job = std::make_shared<BackgroundVerifyJob>(chainparams, std::max(0, std::min(MAX_BACKGROUND_CHECKLEVEL, nCheckLevel)));
+    {
+        LOCK(cs_main);
+        if (nSkipDepth <= 0 || nSkipDepth >= chainActive.Height()) {
+            // VerifyDB checked the whole chain already
+            return;
+        }
+        for (const CBlockIndex* pindex = chainActive[chainActive.Height() - nSkipDepth]; pindex && pindex->pprev; pindex = pindex->pprev) {
+            if (nCheckDepth > 0 && (int)job->vBlocks.size() >= nCheckDepth) {
+                break;
+            }
+            if ((fPruneMode || fSnapshotChainstate) && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                break;
+            }
+            job->vBlocks.emplace_back(pindex);
+        }
+    }
+    if (job->vBlocks.empty()) {
+        return;
+    }
+
+    LogPrintf("Verifying %d blocks below height %d at level %d in the background\n", job->vBlocks.size(), job->vBlocks.front()->nHeight + 1, job->nCheckLevel);
+
+    auto& pool = GetBackgroundVerifyPool();
+    {
+        LOCK(cs_backgroundVerify);
+        backgroundVerifyStatus = BackgroundVerifyStatus();
+        backgroundVerifyStatus.fStarted = true;
+        backgroundVerifyStatus.fRunning = true;
+        backgroundVerifyStatus.nCheckLevel = job->nCheckLevel;
+        backgroundVerifyStatus.nStartHeight = job->vBlocks.front()->nHeight;
+        backgroundVerifyStatus.nStopHeight = job->vBlocks.back()->nHeight;
+        backgroundVerifyStatus.nBlocks = job->vBlocks.size();
+        backgroundVerifyStatus.nStartTime = GetTime();
+        backgroundVerifyJob = job;
+    }
+    fInterruptBackgroundVerify = false;
+    job->nWorkersLeft = pool.size();
+    for (int i = 0; i < pool.size(); i++) {
+        backgroundVerifyWorkers.emplace_back(pool.push([job](int) { BackgroundVerifyWorker(job); }));
+    }
+}
+
+void StopBackgroundVerifyDB()
+{
+    fInterruptBackgroundVerify = true;
+    for (auto& future : backgroundVerifyWorkers) {
+        future.wait();
+    }
+    backgroundVerifyWorkers.clear();
+}
+
+BackgroundVerifyStatus GetBackgroundVerifyStatus()
+{
+    LOCK(cs_backgroundVerify);
+    BackgroundVerifyStatus ret = backgroundVerifyStatus;
+    if (backgroundVerifyJob) {
+        ret.nVerified = backgroundVerifyJob->nVerified;
+    }
+    return ret;
+}
+
 /** Apply the effects of a block on the utxo cache, ignoring that it may already have been applied. */
 bool CChainState::RollforwardBlock(const CBlockIndex* pindex, CCoinsViewCache& inputs, const CChainParams& params)
 {
@@ -4714,6 +5652,9 @@ void UnloadBlockIndex()
     chainActive.SetTip(nullptr);
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
+    pindexLastCoinsPrefetch = nullptr;
+    coinsPrefetchCache.Clear();
+    g_headers_cache.Clear();
     mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -4725,11 +5666,10 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
+    // also frees the block index objects
     mapBlockIndex.clear();
     fHavePruned = false;
+    fSnapshotChainstate = false;
 
     g_chainstate.UnloadBlockIndex();
 }
@@ -4759,6 +5699,8 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         // Use the provided setting for -addressindex in the new database
         fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
         pblocktree->WriteFlag("addressindex", fAddressIndex);
+        // Address summaries are complete for all address index entries of the new database
+        pblocktree->WriteFlag("addresssummary", true);
 
         // Use the provided setting for -timestampindex in the new database
         fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -4776,7 +5718,7 @@ bool CChainState::AddGenesisBlock(const CChainParams& chainparams, const CBlock&
     CDiskBlockPos blockPos = SaveBlockToDisk(block, 0, chainparams, nullptr);
     if (blockPos.IsNull())
         return error("%s: writing genesis block to disk failed (%s)", __func__, FormatStateMessage(state));
-    CBlockIndex *pindex = AddToBlockIndex(block);
+    CBlockIndex *pindex = AddToBlockIndex(block, block.GetHash());
     ReceivedBlockTransactions(block, pindex, blockPos);
     return true;
 }
@@ -4942,6 +5884,238 @@ bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskB
     return nLoaded > 0;
 }
 
+namespace {
+/** Number of blocks read from disk and checked ahead of the one being stored by ReindexBlockFiles */
+static const size_t REINDEX_READAHEAD_BLOCKS = 64;
+/** Number of headers added to the block index per cs_main lock by ReindexBlockFiles */
+static const size_t REINDEX_HEADERS_PER_LOCK = 2000;
+
+struct CReindexBlock
+{
+    CBlockHeader header;
+    uint256 hash;
+    CDiskBlockPos pos;
+    //! Whether the header was added to the block index
+    bool fAccepted{false};
+};
+} // anon namespace
+
+/** Find the blocks of a blk?????.dat file and hash their headers, without reading the blocks themselves */
+static std::vector<CReindexBlock> ScanBlockFile(const CChainParams& chainparams, int nFile)
+{
+    std::vector<CReindexBlock> vBlocks;
+    const fs::path path = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk");
+    boost::system::error_code ec;
+    const uint64_t nFileSize = fs::file_size(path, ec);
+    CAutoFile file(OpenBlockFile(CDiskBlockPos(nFile, 0), true), SER_DISK, CLIENT_VERSION);
+    if (ec || file.IsNull()) {
+        return vBlocks;
+    }
+    const unsigned int nMaxBlockSize = MaxBlockSize();
+    const auto& messageStart = chainparams.MessageStart();
+    std::vector<unsigned char> vSearch;
+
+    uint64_t nPos = 0;
+    while (nPos + 8 + 80 <= nFileSize && !ShutdownRequested()) {
+        try {
+            if (fseek(file.Get(), nPos, SEEK_SET) != 0) {
+                break;
+            }
+            unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+            unsigned int nSize;
+            file >> buf >> nSize;
+            if (memcmp(buf, messageStart, CMessageHeader::MESSAGE_START_SIZE) == 0 && nSize >= 80 && nSize <= nMaxBlockSize && nPos + 8 + nSize <= nFileSize) {
+                CReindexBlock block;
+                file >> block.header;
+                block.hash = block.header.GetHash();
+                block.pos = CDiskBlockPos(nFile, nPos + 8);
+                vBlocks.emplace_back(std::move(block));
+                nPos += 8 + nSize;
+                continue;
+            }
+            // Not a block, look for the next message start like LoadExternalBlockFile (e.g. in the pre-allocated
+            // space at the end of the file)
+            vSearch.resize(std::min<uint64_t>(1 << 16, nFileSize - nPos - 1));
+            if (fseek(file.Get(), nPos + 1, SEEK_SET) != 0 || fread(vSearch.data(), 1, vSearch.size(), file.Get()) != vSearch.size()) {
+                break;
+            }
+            auto it = std::find(vSearch.begin(), vSearch.end(), messageStart[0]);
+            nPos += 1 + (it - vSearch.begin());
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s at %s\n", __func__, e.what(), CDiskBlockPos(nFile, nPos).ToString());
+            break;
+        }
+    }
+    return vBlocks;
+}
+
+bool ReindexBlockFiles(const CChainParams& chainparams)
+{
+    int64_t nStart = GetTimeMillis();
+
+    int nFiles = 0;
+    while (fs::exists(GetBlockPosFilename(CDiskBlockPos(nFiles, 0), "blk"))) {
+        nFiles++;
+    }
+
+    // Scan the files in parallel, hashing the headers on the way
+    std::vector<std::vector<CReindexBlock>> vFileBlocks(nFiles);
+    GetExecutor().ParallelFor(ExecutorPriority::CONSENSUS, nFiles, [&](size_t i) {
+        vFileBlocks[i] = ScanBlockFile(chainparams, i);
+    });
+    size_t nBlocks = 0;
+    for (const auto& v : vFileBlocks) {
+        nBlocks += v.size();
+    }
+    LogPrintf("Reindexing: found %u blocks in %d block files in %dms\n", nBlocks, nFiles, GetTimeMillis() - nStart);
+    boost::this_thread::interruption_point();
+
+    // Add the headers to the block index, parents first. Headers whose parent comes later wait for it.
+    int64_t nHeadersStart = GetTimeMillis();
+    size_t nHeaders = 0;
+    {
+        std::multimap<uint256, CReindexBlock*> mapUnknownParent;
+        std::unordered_set<uint256, StaticSaltedHasher> setSeen;
+        // requires cs_main
+        auto acceptHeader = [&](CReindexBlock& block) {
+            CValidationState state;
+            CBlockIndex* pindex = nullptr;
+            if (g_chainstate.AcceptBlockHeader(block.header, block.hash, state, chainparams, &pindex)) {
+                block.fAccepted = true;
+                nHeaders++;
+                return true;
+            }
+            LogPrint(BCLog::REINDEX, "%s: Invalid header %s at %s: %s\n", __func__, block.hash.ToString(), block.pos.ToString(), FormatStateMessage(state));
+            return false;
+        };
+        for (auto& vBlocks : vFileBlocks) {
+            for (size_t i = 0; i < vBlocks.size(); i += REINDEX_HEADERS_PER_LOCK) {
+                boost::this_thread::interruption_point();
+                LOCK(cs_main);
+                for (size_t j = i; j < std::min(vBlocks.size(), i + REINDEX_HEADERS_PER_LOCK); j++) {
+                    CReindexBlock& block = vBlocks[j];
+                    if (!setSeen.emplace(block.hash).second) {
+                        // The same block stored twice, the first copy is used
+                        continue;
+                    }
+                    if (block.hash != chainparams.GetConsensus().hashGenesisBlock && !LookupBlockIndex(block.header.hashPrevBlock)) {
+                        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, block.hash.ToString(),
+                                block.header.hashPrevBlock.ToString());
+                        mapUnknownParent.emplace(block.header.hashPrevBlock, &block);
+                        continue;
+                    }
+                    if (!acceptHeader(block)) {
+                        continue;
+                    }
+                    // Add the earlier encountered successors of this block
+                    std::deque<uint256> queue{block.hash};
+                    while (!queue.empty() && !mapUnknownParent.empty()) {
+                        auto range = mapUnknownParent.equal_range(queue.front());
+                        queue.pop_front();
+                        for (auto it = range.first; it != range.second; ) {
+                            if (acceptHeader(*it->second)) {
+                                queue.push_back(it->second->hash);
+                            }
+                            it = mapUnknownParent.erase(it);
+                        }
+                    }
+                }
+            }
+        }
+        if (!mapUnknownParent.empty()) {
+            LogPrintf("Reindexing: %u blocks have no known parent\n", mapUnknownParent.size());
+        }
+    }
+    LogPrintf("Reindexing: added %u headers to the block index in %dms\n", nHeaders, GetTimeMillis() - nHeadersStart);
+    NotifyHeaderTip();
+
+    // Store the blocks in the index in file order, which doesn't jump between files and its data is written in.
+    // All headers being known, nothing has to wait for its parent. The next blocks are read and checked on the
+    // executor meanwhile, CheckBlock keeps its result in fChecked.
+    std::vector<const CReindexBlock*> vToLoad;
+    vToLoad.reserve(nHeaders);
+    for (const auto& vBlocks : vFileBlocks) {
+        for (const auto& block : vBlocks) {
+            if (block.fAccepted) {
+                vToLoad.emplace_back(&block);
+            }
+        }
+    }
+
+    CExecutorClient readAhead(ExecutorPriority::CONSENSUS);
+    readAhead.Start();
+    auto readBlock = [&](const CReindexBlock* block) {
+        return readAhead.push([block, &chainparams](int) {
+            auto pblock = std::make_shared<CBlock>();
+            try {
+                CAutoFile filein(OpenBlockFile(block->pos, true), SER_DISK, CLIENT_VERSION);
+                if (filein.IsNull()) {
+                    return std::shared_ptr<CBlock>();
+                }
+                filein >> *pblock;
+            } catch (const std::exception& e) {
+                LogPrintf("ReindexBlockFiles: Deserialize or I/O error - %s at %s\n", e.what(), block->pos.ToString());
+                return std::shared_ptr<CBlock>();
+            }
+            CValidationState dummy;
+            CheckBlock(*pblock, dummy, chainparams.GetConsensus());
+            return pblock;
+        });
+    };
+
+    int nLoaded = 0;
+    std::deque<std::future<std::shared_ptr<CBlock>>> vPending;
+    size_t nNext = 0;
+    try {
+        for (size_t i = 0; i < vToLoad.size(); i++) {
+            boost::this_thread::interruption_point();
+            while (nNext < vToLoad.size() && nNext <= i + REINDEX_READAHEAD_BLOCKS) {
+                vPending.emplace_back(readBlock(vToLoad[nNext++]));
+            }
+            const CReindexBlock& block = *vToLoad[i];
+            std::shared_ptr<CBlock> pblock;
+            try {
+                pblock = vPending.front().get();
+            } catch (const std::future_error&) {
+                // dropped by a stopping executor
+            }
+            vPending.pop_front();
+            if (!pblock || pblock->GetHash() != block.hash) {
+                LogPrintf("%s: Failed to read block %s at %s\n", __func__, block.hash.ToString(), block.pos.ToString());
+                continue;
+            }
+            {
+                LOCK(cs_main);
+                CBlockIndex* pindex = LookupBlockIndex(block.hash);
+                if (!pindex || (pindex->nStatus & BLOCK_HAVE_DATA) == 0) {
+                    CValidationState state;
+                    if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, &block.pos, nullptr)) {
+                        nLoaded++;
+                    }
+                    if (state.IsError()) {
+                        break;
+                    }
+                }
+            }
+
+            // Activate the genesis block so normal node progress can continue
+            if (block.hash == chainparams.GetConsensus().hashGenesisBlock) {
+                CValidationState state;
+                if (!ActivateBestChain(state, chainparams)) {
+                    break;
+                }
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+    // The pending reads are dropped
+    readAhead.Stop();
+
+    LogPrintf("Reindexing: loaded %i blocks from %d block files in %dms\n", nLoaded, nFiles, GetTimeMillis() - nStart);
+    return nLoaded > 0;
+}
+
 void CChainState::CheckBlockIndex(const Consensus::Params& consensusParams)
 {
     if (!fCheckBlockIndex) {
@@ -5162,7 +6336,94 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
     return VersionBitsStateSinceHeight(chainActive.Tip(), params, pos, versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_CHUNKS = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+/** Number of TXs per chunk in mempool.dat, chunks are also the unit in which TXs are loaded */
+static const size_t MEMPOOL_DUMP_CHUNK_SIZE = 1000;
+
+namespace {
+struct MempoolDumpEntry {
+    CTransactionRef tx;
+    int64_t nTime;
+    int64_t nFeeDelta;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(tx);
+        READWRITE(nTime);
+        READWRITE(nFeeDelta);
+    }
+};
+} // namespace
+
+/**
+ * Verify the scripts of a chunk of TXs about to be loaded into the mempool on the script check threads. This doesn't
+ * decide anything, AcceptToMemoryPool still does all the checks one TX after the other, but it finds the signatures
+ * in the signature cache then. TXs of the chunk may spend each other, their inputs are looked up in the chunk itself
+ * before trying the mempool and the UTXO set.
+ */
+static void PreVerifyMempoolChunk(const std::vector<MempoolDumpEntry>& entries)
+{
+    if (nScriptCheckThreads == 0) {
+        return;
+    }
+
+    std::unordered_map<uint256, const CTransaction*, StaticSaltedHasher> mapChunkTxs;
+    for (const auto& entry : entries) {
+        mapChunkTxs.emplace(entry.tx->GetHash(), entry.tx.get());
+    }
+
+    // Checks keep pointers to their txdata
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(entries.size());
+    std::vector<CScriptCheck> vChecks;
+    {
+        LOCK(cs_main);
+        std::vector<CTxOut> vSpent;
+        for (const auto& entry : entries) {
+            const CTransaction& tx = *entry.tx;
+            vSpent.clear();
+            for (const CTxIn& txin : tx.vin) {
+                const CTransaction* parent = nullptr;
+                CTransactionRef mempoolParent;
+                auto it = mapChunkTxs.find(txin.prevout.hash);
+                if (it != mapChunkTxs.end()) {
+                    parent = it->second;
+                } else if ((mempoolParent = mempool.get(txin.prevout.hash))) {
+                    parent = mempoolParent.get();
+                }
+                if (parent) {
+                    if (txin.prevout.n >= parent->vout.size()) {
+                        break;
+                    }
+                    vSpent.emplace_back(parent->vout[txin.prevout.n]);
+                } else {
+                    const Coin& coin = pcoinsTip->AccessCoin(txin.prevout);
+                    if (coin.IsSpent()) {
+                        break;
+                    }
+                    vSpent.emplace_back(coin.out);
+                }
+            }
+            if (tx.IsCoinBase() || vSpent.size() != tx.vin.size()) {
+                // Leave it to AcceptToMemoryPool to reject it
+                continue;
+            }
+            txdata.emplace_back(tx);
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                CScriptCheck check(vSpent[i], tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true, &txdata.back());
+                vChecks.emplace_back();
+                check.swap(vChecks.back());
+            }
+        }
+    }
+
+    CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
 
 bool LoadMempool(void)
 {
@@ -5181,30 +6442,18 @@ bool LoadMempool(void)
     int64_t already_there = 0;
     int64_t nNow = GetTime();
 
-    try {
-        uint64_t version;
-        file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
-            return false;
-        }
-        uint64_t num;
-        file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            CAmount amountdelta = nFeeDelta;
+    auto loadChunk = [&](const std::vector<MempoolDumpEntry>& entries) {
+        PreVerifyMempoolChunk(entries);
+        for (const auto& entry : entries) {
+            const CTransactionRef& tx = entry.tx;
+            CAmount amountdelta = entry.nFeeDelta;
             if (amountdelta) {
                 mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
             CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
+            if (entry.nTime + nExpiryTimeout > nNow) {
                 LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
+                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, entry.nTime,
                                            false /* bypass_limits */, 0 /* nAbsurdFee */);
                 if (state.IsValid()) {
                     ++count;
@@ -5225,6 +6474,40 @@ bool LoadMempool(void)
             if (ShutdownRequested())
                 return false;
         }
+        return true;
+    };
+
+    try {
+        uint64_t version;
+        file >> version;
+        std::vector<MempoolDumpEntry> entries;
+        if (version == MEMPOOL_DUMP_VERSION_NO_CHUNKS) {
+            uint64_t num;
+            file >> num;
+            while (num) {
+                entries.resize(std::min<uint64_t>(num, MEMPOOL_DUMP_CHUNK_SIZE));
+                for (auto& entry : entries) {
+                    file >> entry;
+                }
+                num -= entries.size();
+                if (!loadChunk(entries)) {
+                    return false;
+                }
+            }
+        } else if (version == MEMPOOL_DUMP_VERSION) {
+            // A list of chunks, terminated by an empty one
+            while (true) {
+                file >> entries;
+                if (entries.empty()) {
+                    break;
+                }
+                if (!loadChunk(entries)) {
+                    return false;
+                }
+            }
+        } else {
+            return false;
+        }
         std::map<uint256, CAmount> mapDeltas;
         file >> mapDeltas;
 
@@ -5268,13 +6551,17 @@ bool DumpMempool(void)
         uint64_t version = MEMPOOL_DUMP_VERSION;
         file << version;
 
-        file << (uint64_t)vinfo.size();
-        for (const auto& i : vinfo) {
-            file << *(i.tx);
-            file << (int64_t)i.nTime;
-            file << (int64_t)i.nFeeDelta;
-            mapDeltas.erase(i.tx->GetHash());
+        std::vector<MempoolDumpEntry> entries;
+        entries.reserve(MEMPOOL_DUMP_CHUNK_SIZE);
+        for (size_t i = 0; i < vinfo.size(); i++) {
+            entries.push_back(MempoolDumpEntry{vinfo[i].tx, (int64_t)vinfo[i].nTime, (int64_t)vinfo[i].nFeeDelta});
+            mapDeltas.erase(vinfo[i].tx->GetHash());
+            if (entries.size() == MEMPOOL_DUMP_CHUNK_SIZE || i + 1 == vinfo.size()) {
+                file << entries;
+                entries.clear();
+            }
         }
+        file << entries; // empty chunk as terminator
 
         file << mapDeltas;
         if (!FileCommit(file.Get()))
@@ -5315,9 +6602,6 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
     }
 } instance_of_cmaincleanup;
@@ -12,6 +12,7 @@
 #endif
 
 #include <amount.h>
+#include <blockindexmap.h>
 #include <coins.h>
 #include <fs.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
@@ -35,6 +36,9 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
+class CDBSnapshot;
+struct CDiskTxPos;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
@@ -68,8 +72,12 @@ static const unsigned int DEFAULT_ANCESTOR_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 /** Default for -limitdescendantsize, maximum kilobytes of in-mempool descendants */
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
+/** Default for -mempoolbatchedeviction */
+static const bool DEFAULT_MEMPOOL_BATCHED_EVICTION = false;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
+/** Default for -mempoolsnapshotinterval, in milliseconds. 0 serves mempool RPCs from the live mempool */
+static const int64_t DEFAULT_MEMPOOL_SNAPSHOT_INTERVAL = 0;
 /** Maximum kilobytes for transactions to store for processing during reorg */
 static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
 /** The maximum size of a blk?????.dat file (since 0.8) */
@@ -83,6 +91,12 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Transactions with at least this many inputs have their scripts verified on the script check threads outside of ConnectBlock too */
+static const unsigned int MIN_PARALLEL_SCRIPT_CHECK_INPUTS = 16;
+/** Default for -coinsprefetch, the number of queued blocks whose inputs are read ahead */
+static const int DEFAULT_COINS_PREFETCH_BLOCKS = 8;
+/** Default for -parallelreindex, whether -reindex builds the header index from all block files before loading the blocks */
+static const bool DEFAULT_PARALLEL_REINDEX = true;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -123,6 +137,10 @@ static const bool DEFAULT_TXINDEX = true;
 static const bool DEFAULT_ADDRESSINDEX = false;
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_SPENTINDEX = false;
+/** Default for -mmapblocks */
+static const bool DEFAULT_MMAP_BLOCKS = false;
+/** Default for -compactundo */
+static const bool DEFAULT_COMPACT_UNDO = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -150,7 +168,7 @@ extern CCriticalSection cs_main;
 extern CBlockPolicyEstimator feeEstimator;
 extern CTxMemPool mempool;
 extern std::atomic_bool g_is_mempool_loaded;
-typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
+typedef CBlockIndexMap BlockMap;
 typedef std::unordered_multimap<uint256, CBlockIndex*, BlockHasher> PrevBlockMap;
 extern BlockMap& mapBlockIndex;
 extern PrevBlockMap& mapPrevBlockIndex;
@@ -171,6 +189,11 @@ extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
 extern bool fCheckBlockIndex;
+extern int nCoinsPrefetchBlocks;
+/** Whether finalized block files are memory mapped for reading (-mmapblocks) */
+extern bool fMapBlockFiles;
+/** Whether new undo data is written with the compact serialization (-compactundo) */
+extern bool fCompactUndo;
 extern bool fCheckpointsEnabled;
 extern size_t nCoinCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
@@ -200,6 +223,8 @@ static const uint64_t nMinDiskSpace = 52428800;
 /** Pruning-related variables and constants */
 /** True if any block files have ever been pruned. */
 extern bool fHavePruned;
+/** True if the chainstate was loaded from a UTXO snapshot, the blocks before it are missing like pruned ones. */
+extern bool fSnapshotChainstate;
 /** True if we're running in -prune mode. */
 extern bool fPruneMode;
 /** Number of MiB of block files that we're trying to stay below. */
@@ -211,6 +236,12 @@ static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+/** How many blocks below -checkblocks are verified in the background after startup, -1 for all of them */
+static const signed int DEFAULT_BACKGROUND_CHECKBLOCKS = 0;
+/** The highest check level of the background verification, the higher ones need the coins view of the tip */
+static const int MAX_BACKGROUND_CHECKLEVEL = 2;
+/** Maximum number of threads verifying blocks in the background */
+static const int MAX_BACKGROUND_VERIFY_THREADS = 4;
 
 // Require that user allocate at least 945MB for block & undo files (blk???.dat and rev???.dat)
 // At 2MB per block, 288 blocks = 576MB.
@@ -244,6 +275,12 @@ static const uint64_t MIN_DISK_SPACE_FOR_BLOCK_FILES = 945 * 1024 * 1024;
  */
 bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool* fNewBlock) LOCKS_EXCLUDED(cs_main);
 
+/** Number of headers hashed by one task of GetBlockHeaderHashesParallel */
+static const size_t HEADERS_PER_HASH_TASK = 64;
+
+/** Computes the hashes like GetBlockHeaderHashes, split over the shared executor for bigger batches */
+std::vector<uint256> GetBlockHeaderHashesParallel(const std::vector<CBlockHeader>& headers);
+
 /**
  * Process incoming block headers.
  *
@@ -255,8 +292,9 @@ bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<cons
  * @param[in]  chainparams The params for the chain we want to connect to
  * @param[out] ppindex If set, the pointer will be set to point to the last new block index object for the given headers
  * @param[out] first_invalid First header that fails validation, if one exists
+ * @param[in]  header_hashes If set, the precomputed hashes of the given headers (see GetBlockHeaderHashesParallel)
  */
-bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex = nullptr, CBlockHeader* first_invalid = nullptr) LOCKS_EXCLUDED(cs_main);
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& block, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex = nullptr, CBlockHeader* first_invalid = nullptr, const std::vector<uint256>* header_hashes = nullptr) LOCKS_EXCLUDED(cs_main);
 
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0, bool blocks_dir = false);
@@ -266,6 +304,12 @@ FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
+/**
+ * -reindex the blk?????.dat files: they are scanned in parallel for the headers of the blocks they contain, which are
+ * added to the block index first. The blocks are then stored in the index in file order, read ahead and checked on
+ * the executor.
+ */
+bool ReindexBlockFiles(const CChainParams& chainparams);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk,
@@ -277,6 +321,10 @@ bool LoadChainTip(const CChainParams& chainparams);
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run the script checks on up to nHelpers tasks of the shared executor, instead of ThreadScriptCheck threads */
+void UseExecutorForScriptChecks(int nHelpers);
+/** Run the thread reading the inputs of queued blocks from the coins database ahead of ConnectBlock */
+void ThreadCoinsPrefetch();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -409,18 +457,43 @@ public:
 
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+/** Looks up many keys at once, entries of the mempool take precedence over those of the index like with a single key */
+bool GetSpentIndex(const std::vector<CSpentIndexKey>& keys, CSpentIndexTxInfo& info);
 bool GetAddressIndex(uint160 addressHash, int type,
                      std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                     int start = 0, int end = 0);
+                     int start = 0, int end = 0, const CDBSnapshot* snapshot = nullptr);
 bool GetAddressUnspent(uint160 addressHash, int type,
-                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                       const CDBSnapshot* snapshot = nullptr);
+/** Get the totals of an address, returns false if they are not available and the entries need to be summed up instead */
+bool GetAddressSummary(uint160 addressHash, int type, CAddressIndexSummary& summary);
+/** Append the txindex entries of all transactions of a block */
+void GetTxIndexDataForBlock(const CBlock& block, const CBlockIndex* pindex, std::vector<std::pair<uint256, CDiskTxPos> >& vPos);
+/** Append the address and spent index entries of input j of tx (the i-th transaction of its block), which spends prevout */
+void AddInputIndexData(const CTransaction& tx, unsigned int i, size_t j, const CTxOut& prevout, int nHeight, bool fAddress, bool fSpent,
+                       std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                       std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& addressUnspentIndex,
+                       std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& spentIndex);
+/** Append the address index entries of output k of tx (the i-th transaction of its block) */
+void AddOutputIndexData(const CTransaction& tx, unsigned int i, unsigned int k, int nHeight,
+                        std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& addressUnspentIndex);
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
+/**
+ * Run script checks on the script check threads (inline without them or for less than
+ * MIN_PARALLEL_SCRIPT_CHECK_INPUTS checks), returns whether all of them passed
+ */
+bool RunScriptChecks(std::vector<CScriptCheck>& vChecks);
 
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the serialized bytes of a block without deserializing them, e.g. to relay them as-is */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -430,6 +503,14 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
 /** Check a block is completely valid from start to finish (only works on top of our current best block) */
 bool TestBlockValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, bool fCheckPOW = true, bool fCheckMerkleRoot = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Cheaper variant of TestBlockValidity for block templates which only contain the coinbase, mined quorum commitments
+ * and TXs taken from the current mempool. These TXs were fully validated (including scripts and special TX rules)
+ * when they entered the mempool, so only block-level rules and the coinbase/CbTx are re-checked here. nFees must be
+ * the sum of the fees of all non-coinbase TXs in the block.
+ */
+bool TestBlockTemplateValidity(CValidationState& state, const CChainParams& chainparams, const CBlock& block, CBlockIndex* pindexPrev, CAmount nFees) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** RAII wrapper for VerifyDB: Verify consistency of the block and coin databases */
 class CVerifyDB {
 public:
@@ -438,6 +519,34 @@ public:
     bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
 };
 
+/** Progress and outcome of the background block verification */
+struct BackgroundVerifyStatus {
+    bool fStarted{false};
+    bool fRunning{false};
+    int nCheckLevel{0};
+    /** The highest and the lowest height being verified */
+    int nStartHeight{-1};
+    int nStopHeight{-1};
+    int nBlocks{0};
+    int nVerified{0};
+    /** Height of the first bad block found, -1 if none was */
+    int nFailedHeight{-1};
+    std::string strError;
+    int64_t nStartTime{0};
+    int64_t nEndTime{0};
+};
+
+/**
+ * Verify the nCheckDepth blocks below the nSkipDepth ones VerifyDB checked at startup on a few threads, up to check
+ * level MAX_BACKGROUND_CHECKLEVEL: the blocks are read and checked, and their undo data is read and compared with the
+ * transactions of the block. nCheckDepth <= 0 verifies all blocks down to the genesis block. Bad blocks are reported
+ * through the warnings and -alertnotify.
+ */
+void StartBackgroundVerifyDB(const CChainParams& chainparams, int nCheckLevel, int nSkipDepth, int nCheckDepth);
+/** Interrupt the background verification and wait for its threads */
+void StopBackgroundVerifyDB();
+BackgroundVerifyStatus GetBackgroundVerifyStatus();
+
 /** Replay blocks that aren't fully applied to the database. */
 bool ReplayBlocks(const CChainParams& params, CCoinsView* view);
 
@@ -467,6 +576,13 @@ bool MarkConflictingBlock(CValidationState& state, const CChainParams& chainpara
 /** Remove invalidity status from a block and its descendants. */
 bool ResetBlockFailureFlags(CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
+/**
+ * Make pindexBase the tip after the coins and evodb entries of a UTXO snapshot were written, with nothing but the
+ * genesis block connected before. The blocks until pindexBase are treated as valid and pruned, nChainTx is the
+ * number of transactions until pindexBase from the chain params.
+ */
+bool ActivateSnapshotChainstate(CBlockIndex* pindexBase, unsigned int nChainTx) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain& chainActive;
 
@@ -516,6 +632,35 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Time spent in the stages of connecting the last block in ConnectTip, in microseconds (see -blocktimingslog) */
+struct CBlockConnectTimings
+{
+    int nHeight{0};
+    uint256 blockHash;
+    size_t nTxs{0};
+    int nInputs{0};
+
+    int64_t nLoad{0}; // reading the block from disk
+    int64_t nPrefetch{0}; // fetching the inputs from the coins database in parallel
+    int64_t nChecks{0}; // sanity and fork checks
+    int64_t nSpecialTxs{0}; // checking and processing the special txes themselves
+    int64_t nQuorums{0}; // CQuorumBlockProcessor::ProcessBlock
+    int64_t nMNList{0}; // CDeterministicMNManager::ProcessBlock
+    int64_t nCbTxMerkleRoots{0}; // CheckCbTxMerkleRoots
+    int64_t nConnect{0}; // spending the inputs, which includes fetching the ones that weren't prefetched
+    int64_t nScripts{0}; // waiting for the script checks
+    int64_t nDashSpecific{0}; // IS conflicts, subsidy and payee checks
+    int64_t nIndex{0}; // undo data and indexes
+    int64_t nFlush{0}; // flushing the coins view and committing the evo db transaction
+    int64_t nChainState{0}; // FlushStateToDisk
+    int64_t nPostConnect{0}; // mempool and tip updates
+    int64_t nTotal{0};
+};
+
+/** Append the timings of each block connected by ConnectTip to a CSV file at path, until CloseBlockTimingsLog() */
+bool OpenBlockTimingsLog(const fs::path& path);
+void CloseBlockTimingsLog();
+
 //! Check whether the block associated with this index entry is pruned or not.
 inline bool IsBlockPruned(const CBlockIndex* pblockindex)
 {
@@ -21,35 +21,92 @@
 #include <list>
 #include <atomic>
 #include <future>
+#include <typeinfo>
+#include <vector>
 
+#include <boost/core/demangle.hpp>
 #include <boost/signals2/signal.hpp>
 
+namespace {
+
+/** A registered listener with the queue of its background callbacks */
+struct ValidationListener {
+    CValidationInterface* const pinterface;
+    const std::string strName;
+    SingleThreadedSchedulerClient schedulerClient;
+    // Cleared when the listener is unregistered, its callbacks still in the queue are dropped then
+    std::atomic<bool> fActive{true};
+
+    std::atomic<uint64_t> nCallbacks{0};
+    std::atomic<int64_t> nLagMicros{0};
+    std::atomic<int64_t> nMaxLagMicros{0};
+    std::atomic<int64_t> nLastLagMicros{0};
+
+    ValidationListener(CValidationInterface* pinterfaceIn, CScheduler* pscheduler) :
+        pinterface(pinterfaceIn),
+        strName(boost::core::demangle(typeid(*pinterfaceIn).name())),
+        schedulerClient(pscheduler) {}
+
+    void RecordLag(int64_t nLag)
+    {
+        nCallbacks++;
+        nLagMicros += nLag;
+        nLastLagMicros = nLag;
+        int64_t nMax = nMaxLagMicros;
+        while (nLag > nMax && !nMaxLagMicros.compare_exchange_weak(nMax, nLag)) {}
+    }
+};
+
+} // namespace
+
 struct MainSignalsInstance {
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
+    // Callbacks which are called from the caller's thread
     boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> SynchronousUpdatedBlockTip;
-    boost::signals2::signal<void (const CTransactionRef &, int64_t)> TransactionAddedToMempool;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&)> BlockConnected;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex* pindexDisconnected)> BlockDisconnected;
-    boost::signals2::signal<void (const CTransactionRef &, MemPoolRemovalReason)> TransactionRemovedFromMempool;
-    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
     boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
     boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
     boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
     boost::signals2::signal<void (const CBlockIndex *)>AcceptedBlockHeader;
     boost::signals2::signal<void (const CBlockIndex *, bool)>NotifyHeaderTip;
-    boost::signals2::signal<void (const CTransactionRef& tx, const std::shared_ptr<const llmq::CInstantSendLock>& islock)>NotifyTransactionLock;
-    boost::signals2::signal<void (const CBlockIndex* pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)>NotifyChainLock;
-    boost::signals2::signal<void (const std::shared_ptr<const CGovernanceVote>& vote)>NotifyGovernanceVote;
-    boost::signals2::signal<void (const std::shared_ptr<const CGovernanceObject>& object)>NotifyGovernanceObject;
-    boost::signals2::signal<void (const CTransactionRef& currentTx, const CTransactionRef& previousTx)>NotifyInstantSendDoubleSpendAttempt;
     boost::signals2::signal<void (bool undo, const CDeterministicMNList& oldMNList, const CDeterministicMNListDiff& diff)>NotifyMasternodeListChanged;
-    boost::signals2::signal<void (const std::shared_ptr<const llmq::CRecoveredSig>& sig)>NotifyRecoveredSig;
-    // We are not allowed to assume the scheduler only runs in one thread,
-    // but must ensure all callbacks happen in-order, so we end up creating
-    // our own queue here :(
+
+    // Each listener has a queue of its own for the background callbacks, so a slow listener only delays itself.
+    // We are not allowed to assume the scheduler only runs in one thread, but must ensure the callbacks of a
+    // listener happen in-order, so we end up creating our own queues here :(
+    CScheduler* m_pscheduler;
+    // Used for the functions of CallFunctionInValidationInterfaceQueue, even if there are no listeners
     SingleThreadedSchedulerClient m_schedulerClient;
 
-    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+    CCriticalSection m_cs_listeners;
+    std::vector<std::shared_ptr<ValidationListener>> m_listeners GUARDED_BY(m_cs_listeners);
+    // All listeners that were ever registered, the queue of a listener is kept until all of its callbacks are done
+    std::vector<std::shared_ptr<ValidationListener>> m_all_listeners GUARDED_BY(m_cs_listeners);
+
+    explicit MainSignalsInstance(CScheduler *pscheduler) : m_pscheduler(pscheduler), m_schedulerClient(pscheduler) {}
+
+    /** Queue func(listener) for all registered listeners */
+    template <typename Function>
+    void Enqueue(const Function& func)
+    {
+        const int64_t nTime = GetTimeMicros();
+        LOCK(m_cs_listeners);
+        for (const auto& listener : m_listeners) {
+            listener->schedulerClient.AddToProcessQueue([listener, func, nTime] {
+                if (!listener->fActive) return;
+                listener->RecordLag(GetTimeMicros() - nTime);
+                func(listener->pinterface);
+            });
+        }
+    }
+
+    std::vector<SingleThreadedSchedulerClient*> GetSchedulerClients(bool fActiveOnly)
+    {
+        LOCK(m_cs_listeners);
+        std::vector<SingleThreadedSchedulerClient*> vecClients{&m_schedulerClient};
+        for (const auto& listener : (fActiveOnly ? m_listeners : m_all_listeners)) {
+            vecClients.emplace_back(&listener->schedulerClient);
+        }
+        return vecClients;
+    }
 };
 
 static CMainSignals g_signals;
@@ -65,13 +122,36 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 
 void CMainSignals::FlushBackgroundCallbacks() {
     if (m_internals) {
-        m_internals->m_schedulerClient.EmptyQueue();
+        for (auto* pclient : m_internals->GetSchedulerClients(false)) {
+            pclient->EmptyQueue();
+        }
     }
 }
 
 size_t CMainSignals::CallbacksPending() {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    size_t nPending = 0;
+    for (auto* pclient : m_internals->GetSchedulerClients(false)) {
+        nPending = std::max(nPending, pclient->CallbacksPending());
+    }
+    return nPending;
+}
+
+std::vector<CValidationInterfaceStats> CMainSignals::GetListenerStats() {
+    std::vector<CValidationInterfaceStats> vecStats;
+    if (!m_internals) return vecStats;
+    LOCK(m_internals->m_cs_listeners);
+    for (const auto& listener : m_internals->m_listeners) {
+        CValidationInterfaceStats stats;
+        stats.strName = listener->strName;
+        stats.nPending = listener->schedulerClient.CallbacksPending();
+        stats.nCallbacks = listener->nCallbacks;
+        stats.nLagMicros = listener->nLagMicros;
+        stats.nMaxLagMicros = listener->nMaxLagMicros;
+        stats.nLastLagMicros = listener->nLastLagMicros;
+        vecStats.emplace_back(std::move(stats));
+    }
+    return vecStats;
 }
 
 void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
@@ -90,45 +170,37 @@ CMainSignals& GetMainSignals()
 void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->AcceptedBlockHeader.connect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
     g_signals.m_internals->NotifyHeaderTip.connect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
-    g_signals.m_internals->UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.m_internals->SynchronousUpdatedBlockTip.connect(boost::bind(&CValidationInterface::SynchronousUpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1, _2));
-    g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyTransactionLock.connect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyChainLock.connect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1, _2));
-    g_signals.m_internals->TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
-    g_signals.m_internals->SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
     g_signals.m_internals->Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
     g_signals.m_internals->BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.m_internals->NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyGovernanceObject.connect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
-    g_signals.m_internals->NotifyGovernanceVote.connect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
-    g_signals.m_internals->NotifyInstantSendDoubleSpendAttempt.connect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyRecoveredSig.connect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
     g_signals.m_internals->NotifyMasternodeListChanged.connect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
+
+    auto listener = std::make_shared<ValidationListener>(pwalletIn, g_signals.m_internals->m_pscheduler);
+    LOCK(g_signals.m_internals->m_cs_listeners);
+    g_signals.m_internals->m_listeners.emplace_back(listener);
+    g_signals.m_internals->m_all_listeners.emplace_back(listener);
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.m_internals->BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.m_internals->Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.m_internals->SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.m_internals->NotifyChainLock.disconnect(boost::bind(&CValidationInterface::NotifyChainLock, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyTransactionLock.disconnect(boost::bind(&CValidationInterface::NotifyTransactionLock, pwalletIn, _1, _2));
-    g_signals.m_internals->TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1, _2));
-    g_signals.m_internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1, _2));
-    g_signals.m_internals->TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1, _2));
-    g_signals.m_internals->UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.m_internals->SynchronousUpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::SynchronousUpdatedBlockTip, pwalletIn, _1, _2, _3));
     g_signals.m_internals->NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
     g_signals.m_internals->NotifyHeaderTip.disconnect(boost::bind(&CValidationInterface::NotifyHeaderTip, pwalletIn, _1, _2));
     g_signals.m_internals->AcceptedBlockHeader.disconnect(boost::bind(&CValidationInterface::AcceptedBlockHeader, pwalletIn, _1));
-    g_signals.m_internals->NotifyGovernanceObject.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceObject, pwalletIn, _1));
-    g_signals.m_internals->NotifyGovernanceVote.disconnect(boost::bind(&CValidationInterface::NotifyGovernanceVote, pwalletIn, _1));
-    g_signals.m_internals->NotifyInstantSendDoubleSpendAttempt.disconnect(boost::bind(&CValidationInterface::NotifyInstantSendDoubleSpendAttempt, pwalletIn, _1, _2));
-    g_signals.m_internals->NotifyRecoveredSig.disconnect(boost::bind(&CValidationInterface::NotifyRecoveredSig, pwalletIn, _1));
     g_signals.m_internals->NotifyMasternodeListChanged.disconnect(boost::bind(&CValidationInterface::NotifyMasternodeListChanged, pwalletIn, _1, _2, _3));
+
+    LOCK(g_signals.m_internals->m_cs_listeners);
+    auto& listeners = g_signals.m_internals->m_listeners;
+    for (auto it = listeners.begin(); it != listeners.end(); ) {
+        if ((*it)->pinterface == pwalletIn) {
+            (*it)->fActive = false;
+            it = listeners.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 void UnregisterAllValidationInterfaces() {
@@ -137,27 +209,31 @@ void UnregisterAllValidationInterfaces() {
     }
     g_signals.m_internals->BlockChecked.disconnect_all_slots();
     g_signals.m_internals->Broadcast.disconnect_all_slots();
-    g_signals.m_internals->SetBestChain.disconnect_all_slots();
-    g_signals.m_internals->NotifyTransactionLock.disconnect_all_slots();
-    g_signals.m_internals->NotifyChainLock.disconnect_all_slots();
-    g_signals.m_internals->TransactionAddedToMempool.disconnect_all_slots();
-    g_signals.m_internals->BlockConnected.disconnect_all_slots();
-    g_signals.m_internals->BlockDisconnected.disconnect_all_slots();
-    g_signals.m_internals->TransactionRemovedFromMempool.disconnect_all_slots();
-    g_signals.m_internals->UpdatedBlockTip.disconnect_all_slots();
     g_signals.m_internals->SynchronousUpdatedBlockTip.disconnect_all_slots();
     g_signals.m_internals->NewPoWValidBlock.disconnect_all_slots();
     g_signals.m_internals->NotifyHeaderTip.disconnect_all_slots();
     g_signals.m_internals->AcceptedBlockHeader.disconnect_all_slots();
-    g_signals.m_internals->NotifyGovernanceObject.disconnect_all_slots();
-    g_signals.m_internals->NotifyGovernanceVote.disconnect_all_slots();
-    g_signals.m_internals->NotifyInstantSendDoubleSpendAttempt.disconnect_all_slots();
-    g_signals.m_internals->NotifyRecoveredSig.disconnect_all_slots();
     g_signals.m_internals->NotifyMasternodeListChanged.disconnect_all_slots();
+
+    LOCK(g_signals.m_internals->m_cs_listeners);
+    for (const auto& listener : g_signals.m_internals->m_listeners) {
+        listener->fActive = false;
+    }
+    g_signals.m_internals->m_listeners.clear();
 }
 
 void CallFunctionInValidationInterfaceQueue(std::function<void ()> func) {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    // Called once the queues of all listeners got through the callbacks generated prior to now
+    auto vecClients = g_signals.m_internals->GetSchedulerClients(true);
+    auto nRemaining = std::make_shared<std::atomic<size_t>>(vecClients.size());
+    auto pfunc = std::make_shared<std::function<void ()>>(std::move(func));
+    for (auto* pclient : vecClients) {
+        pclient->AddToProcessQueue([nRemaining, pfunc] {
+            if (--*nRemaining == 0) {
+                (*pfunc)();
+            }
+        });
+    }
 }
 
 void SyncWithValidationInterfaceQueue() {
@@ -172,8 +248,8 @@ void SyncWithValidationInterfaceQueue() {
 
 void CMainSignals::MempoolEntryRemoved(CTransactionRef ptx, MemPoolRemovalReason reason) {
     if (reason != MemPoolRemovalReason::BLOCK) {
-        m_internals->m_schedulerClient.AddToProcessQueue([ptx, reason, this] {
-            m_internals->TransactionRemovedFromMempool(ptx, reason);
+        m_internals->Enqueue([ptx, reason](CValidationInterface* pinterface) {
+            pinterface->TransactionRemovedFromMempool(ptx, reason);
         });
     }
 }
@@ -183,8 +259,8 @@ void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockInd
     // the chain actually updates. One way to ensure this is for the caller to invoke this signal
     // in the same critical section where the chain is updated
 
-    m_internals->m_schedulerClient.AddToProcessQueue([pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    m_internals->Enqueue([pindexNew, pindexFork, fInitialDownload](CValidationInterface* pinterface) {
+        pinterface->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     });
 }
 
@@ -193,26 +269,26 @@ void CMainSignals::SynchronousUpdatedBlockTip(const CBlockIndex *pindexNew, cons
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx, int64_t nAcceptTime) {
-    m_internals->m_schedulerClient.AddToProcessQueue([ptx, nAcceptTime, this] {
-        m_internals->TransactionAddedToMempool(ptx, nAcceptTime);
+    m_internals->Enqueue([ptx, nAcceptTime](CValidationInterface* pinterface) {
+        pinterface->TransactionAddedToMempool(ptx, nAcceptTime);
     });
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvtxConflicted, this] {
-        m_internals->BlockConnected(pblock, pindex, *pvtxConflicted);
+    m_internals->Enqueue([pblock, pindex, pvtxConflicted](CValidationInterface* pinterface) {
+        pinterface->BlockConnected(pblock, pindex, *pvtxConflicted);
     });
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex* pindexDisconnected) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindexDisconnected, this] {
-        m_internals->BlockDisconnected(pblock, pindexDisconnected);
+    m_internals->Enqueue([pblock, pindexDisconnected](CValidationInterface* pinterface) {
+        pinterface->BlockDisconnected(pblock, pindexDisconnected);
     });
 }
 
 void CMainSignals::SetBestChain(const CBlockLocator &locator) {
-    m_internals->m_schedulerClient.AddToProcessQueue([locator, this] {
-        m_internals->SetBestChain(locator);
+    m_internals->Enqueue([locator](CValidationInterface* pinterface) {
+        pinterface->SetBestChain(locator);
     });
 }
 
@@ -237,38 +313,38 @@ void CMainSignals::NotifyHeaderTip(const CBlockIndex *pindexNew, bool fInitialDo
 }
 
 void CMainSignals::NotifyTransactionLock(const CTransactionRef &tx, const std::shared_ptr<const llmq::CInstantSendLock>& islock) {
-    m_internals->m_schedulerClient.AddToProcessQueue([tx, islock, this] {
-        m_internals->NotifyTransactionLock(tx, islock);
+    m_internals->Enqueue([tx, islock](CValidationInterface* pinterface) {
+        pinterface->NotifyTransactionLock(tx, islock);
     });
 }
 
 void CMainSignals::NotifyChainLock(const CBlockIndex* pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pindex, clsig, this] {
-        m_internals->NotifyChainLock(pindex, clsig);
+    m_internals->Enqueue([pindex, clsig](CValidationInterface* pinterface) {
+        pinterface->NotifyChainLock(pindex, clsig);
     });
 }
 
 void CMainSignals::NotifyGovernanceVote(const std::shared_ptr<const CGovernanceVote>& vote) {
-    m_internals->m_schedulerClient.AddToProcessQueue([vote, this] {
-        m_internals->NotifyGovernanceVote(vote);
+    m_internals->Enqueue([vote](CValidationInterface* pinterface) {
+        pinterface->NotifyGovernanceVote(vote);
     });
 }
 
 void CMainSignals::NotifyGovernanceObject(const std::shared_ptr<const CGovernanceObject>& object) {
-    m_internals->m_schedulerClient.AddToProcessQueue([object, this] {
-        m_internals->NotifyGovernanceObject(object);
+    m_internals->Enqueue([object](CValidationInterface* pinterface) {
+        pinterface->NotifyGovernanceObject(object);
     });
 }
 
 void CMainSignals::NotifyInstantSendDoubleSpendAttempt(const CTransactionRef& currentTx, const CTransactionRef& previousTx) {
-    m_internals->m_schedulerClient.AddToProcessQueue([currentTx, previousTx, this] {
-        m_internals->NotifyInstantSendDoubleSpendAttempt(currentTx, previousTx);
+    m_internals->Enqueue([currentTx, previousTx](CValidationInterface* pinterface) {
+        pinterface->NotifyInstantSendDoubleSpendAttempt(currentTx, previousTx);
     });
 }
 
 void CMainSignals::NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig) {
-    m_internals->m_schedulerClient.AddToProcessQueue([sig, this] {
-        m_internals->NotifyRecoveredSig(sig);
+    m_internals->Enqueue([sig](CValidationInterface* pinterface) {
+        pinterface->NotifyRecoveredSig(sig);
     });
 }
 
@@ -10,6 +10,8 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 class CBlock;
 class CBlockIndex;
@@ -33,6 +35,10 @@ namespace llmq {
     class CRecoveredSig;
 } // namespace llmq
 
+/** Default for -validationthreads, the threads which run the background callbacks of the listeners */
+static const int DEFAULT_VALIDATION_INTERFACE_THREADS = 4;
+static const int MAX_VALIDATION_INTERFACE_THREADS = 16;
+
 // These functions dispatch to one or all registered wallets
 
 /** Register a wallet to receive updates from core */
@@ -75,7 +81,8 @@ void SyncWithValidationInterfaceQueue();
  * UpdatedBlockTip() callback may depend on an operation performed in
  * the BlockConnected() callback without worrying about explicit
  * synchronization. No ordering should be assumed across
- * ValidationInterface() subscribers.
+ * ValidationInterface() subscribers, each of them has a queue of its own
+ * and the callbacks of different subscribers may run in parallel.
  */
 class CValidationInterface {
 protected:
@@ -155,6 +162,18 @@ protected:
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
+    friend class CMainSignals;
+};
+
+/** The queue of the background callbacks of a listener */
+struct CValidationInterfaceStats {
+    std::string strName;
+    size_t nPending;
+    uint64_t nCallbacks;
+    // Time between queueing the callbacks and calling them
+    int64_t nLagMicros;
+    int64_t nMaxLagMicros;
+    int64_t nLastLagMicros;
 };
 
 struct MainSignalsInstance;
@@ -177,7 +196,9 @@ public:
     /** Call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
+    /** The largest number of background callbacks a listener still has to process */
     size_t CallbacksPending();
+    std::vector<CValidationInterfaceStats> GetListenerStats();
 
     /** Register with mempool to call TransactionRemovedFromMempool callbacks */
     void RegisterWithMempoolSignals(CTxMemPool& pool);
@@ -0,0 +1,498 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/leveldb.h>
+
+#include <support/cleanse.h>
+#include <sync.h>
+#include <util.h>
+
+#include <functional>
+
+#include <memenv.h>
+
+namespace {
+
+CCriticalSection cs_leveldb_wallets;
+//! The LevelDB directories of the open wallets
+std::set<std::string> g_leveldb_wallets GUARDED_BY(cs_leveldb_wallets);
+
+//! Number of records copied by a backup per LevelDB batch
+const int BACKUP_BATCH_RECORDS = 1000;
+
+leveldb::WriteOptions SyncOptions()
+{
+    leveldb::WriteOptions options;
+    options.sync = true;
+    return options;
+}
+
+//! Copy the records of source accepted by filter (all without one) to a new database at path
+bool CopyDatabase(leveldb::DB& source, const fs::path& path, const std::function<bool(const leveldb::Slice&, const leveldb::Slice&)>& filter)
+{
+    leveldb::Options options;
+    options.create_if_missing = true;
+    options.error_if_exists = true;
+    leveldb::DB* pdb;
+    leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
+    if (!status.ok()) {
+        LogPrintf("LevelDBDatabase: Can't create database %s: %s\n", path.string(), status.ToString());
+        return false;
+    }
+    std::unique_ptr<leveldb::DB> dest(pdb);
+
+    // The iterator reads from a snapshot, the source can be written meanwhile
+    std::unique_ptr<leveldb::Iterator> it(source.NewIterator(leveldb::ReadOptions()));
+    leveldb::WriteBatch batch;
+    int nRecords = 0;
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        if (filter && !filter(it->key(), it->value())) {
+            continue;
+        }
+        batch.Put(it->key(), it->value());
+        if (++nRecords % BACKUP_BATCH_RECORDS == 0) {
+            status = dest->Write(leveldb::WriteOptions(), &batch);
+            if (!status.ok()) break;
+            batch.Clear();
+        }
+    }
+    if (status.ok()) {
+        status = it->status();
+    }
+    if (status.ok()) {
+        status = dest->Write(SyncOptions(), &batch);
+    }
+    if (!status.ok()) {
+        LogPrintf("LevelDBDatabase: Error copying database to %s: %s\n", path.string(), status.ToString());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool IsLevelDBWallet(const fs::path& wallet_path)
+{
+    if (fs::is_directory(wallet_path / LEVELDB_WALLET_DIR)) {
+        return true;
+    }
+    // An existing BerkeleyDB wallet, either the data file itself or a directory with one
+    if (fs::is_regular_file(wallet_path) || fs::exists(wallet_path / "wallet.dat")) {
+        return false;
+    }
+    return gArgs.GetArg("-walletbackend", DEFAULT_WALLET_BACKEND) == "leveldb";
+}
+
+bool IsLevelDBWalletLoaded(const fs::path& wallet_path)
+{
+    LOCK(cs_leveldb_wallets);
+    return g_leveldb_wallets.count((wallet_path / LEVELDB_WALLET_DIR).string()) != 0;
+}
+
+LevelDBDatabase::LevelDBDatabase(const fs::path& wallet_path, bool mock) :
+    m_path(mock ? fs::path() : wallet_path / LEVELDB_WALLET_DIR)
+{
+    m_options.create_if_missing = true;
+    m_options.max_open_files = 64;
+    if (mock) {
+        m_env.reset(leveldb::NewMemEnv(leveldb::Env::Default()));
+        m_options.env = m_env.get();
+    } else {
+        LOCK(cs_leveldb_wallets);
+        auto inserted = g_leveldb_wallets.emplace(m_path.string());
+        assert(inserted.second);
+    }
+}
+
+LevelDBDatabase::~LevelDBDatabase()
+{
+    m_db.reset();
+    if (!m_path.empty()) {
+        LOCK(cs_leveldb_wallets);
+        size_t erased = g_leveldb_wallets.erase(m_path.string());
+        assert(erased == 1);
+    }
+}
+
+leveldb::DB& LevelDBDatabase::GetDB()
+{
+    LOCK(m_cs_open);
+    if (!m_db) {
+        const std::string strPath = m_path.empty() ? "wallet" : m_path.string();
+        if (!m_path.empty()) {
+            TryCreateDirectories(m_path);
+        }
+        leveldb::DB* pdb;
+        leveldb::Status status = leveldb::DB::Open(m_options, strPath, &pdb);
+        if (!status.ok()) {
+            throw std::runtime_error(strprintf("LevelDBDatabase: Can't open database %s: %s", strPath, status.ToString()));
+        }
+        m_db.reset(pdb);
+    }
+    return *m_db;
+}
+
+bool LevelDBDatabase::Sync()
+{
+    // Writing an empty batch syncs the log with all previous writes
+    leveldb::WriteBatch batch;
+    leveldb::Status status = GetDB().Write(SyncOptions(), &batch);
+    if (!status.ok()) {
+        LogPrintf("LevelDBDatabase: Error syncing database %s: %s\n", m_path.string(), status.ToString());
+        return false;
+    }
+    return true;
+}
+
+bool LevelDBDatabase::Rewrite(const char* pszSkip)
+{
+    leveldb::DB& db = GetDB();
+    leveldb::WriteBatch batch;
+    if (pszSkip) {
+        const leveldb::Slice skip(pszSkip);
+        std::unique_ptr<leveldb::Iterator> it(db.NewIterator(leveldb::ReadOptions()));
+        for (it->Seek(skip); it->Valid() && it->key().starts_with(skip); it->Next()) {
+            batch.Delete(it->key());
+        }
+        if (!it->status().ok()) {
+            LogPrintf("LevelDBDatabase::Rewrite: Error reading %s: %s\n", m_path.string(), it->status().ToString());
+            return false;
+        }
+    }
+    // Update version:
+    CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+    ssKey << std::string("version");
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << CLIENT_VERSION;
+    batch.Put(leveldb::Slice(ssKey.data(), ssKey.size()), leveldb::Slice(ssValue.data(), ssValue.size()));
+
+    leveldb::Status status = db.Write(SyncOptions(), &batch);
+    if (!status.ok()) {
+        LogPrintf("LevelDBDatabase::Rewrite: Failed to rewrite %s: %s\n", m_path.string(), status.ToString());
+        return false;
+    }
+    // Compacting writes the log to new table files and deletes the old ones, so that no erased (e.g. unencrypted)
+    // data is left behind
+    LogPrintf("LevelDBDatabase::Rewrite: Compacting %s...\n", m_path.string());
+    db.CompactRange(nullptr, nullptr);
+    return true;
+}
+
+bool LevelDBDatabase::Backup(const std::string& strDest)
+{
+    if (m_path.empty()) {
+        return false;
+    }
+    const fs::path pathDest = fs::path(strDest) / LEVELDB_WALLET_DIR;
+    try {
+        if (fs::exists(pathDest) && fs::equivalent(m_path, pathDest)) {
+            LogPrintf("cannot backup to wallet source file %s\n", pathDest.string());
+            return false;
+        }
+        if (IsLevelDBWalletLoaded(strDest)) {
+            LogPrintf("cannot backup to loaded wallet %s\n", strDest);
+            return false;
+        }
+        fs::remove_all(pathDest);
+        TryCreateDirectories(pathDest);
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("error copying %s to %s - %s\n", m_path.string(), pathDest.string(), e.what());
+        return false;
+    }
+
+    if (!CopyDatabase(GetDB(), pathDest, nullptr)) {
+        return false;
+    }
+    LogPrintf("copied %s to %s\n", m_path.string(), pathDest.string());
+    return true;
+}
+
+bool LevelDBDatabase::Recover(const fs::path& wallet_path, void *callbackDataIn, bool (*recoverKVcallback)(void* callbackData, CDataStream ssKey, CDataStream ssValue), std::string& out_backup_filename)
+{
+    // Recovery procedure:
+    // move the database to wallet.leveldb.timestamp.bak
+    // let LevelDB repair it to get as much data as possible
+    // copy the salvaged data to a fresh database
+    const fs::path path = wallet_path / LEVELDB_WALLET_DIR;
+    out_backup_filename = strprintf("%s.%d.bak", LEVELDB_WALLET_DIR, GetTime());
+    const fs::path pathBackup = wallet_path / out_backup_filename;
+    try {
+        fs::rename(path, pathBackup);
+        LogPrintf("Renamed %s to %s\n", path.string(), pathBackup.string());
+    } catch (const fs::filesystem_error& e) {
+        LogPrintf("Failed to rename %s to %s - %s\n", path.string(), pathBackup.string(), e.what());
+        return false;
+    }
+
+    leveldb::Options options;
+    leveldb::Status status = leveldb::RepairDB(pathBackup.string(), options);
+    if (!status.ok()) {
+        LogPrintf("LevelDBDatabase::Recover: Repair of %s failed: %s\n", pathBackup.string(), status.ToString());
+        return false;
+    }
+    leveldb::DB* pdb;
+    status = leveldb::DB::Open(options, pathBackup.string(), &pdb);
+    if (!status.ok()) {
+        LogPrintf("LevelDBDatabase::Recover: Can't open %s: %s\n", pathBackup.string(), status.ToString());
+        return false;
+    }
+    std::unique_ptr<leveldb::DB> db(pdb);
+
+    int nRecords = 0;
+    bool fSuccess = CopyDatabase(*db, path, [&](const leveldb::Slice& key, const leveldb::Slice& value) {
+        nRecords++;
+        if (!recoverKVcallback) {
+            return true;
+        }
+        CDataStream ssKey(key.data(), key.data() + key.size(), SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(value.data(), value.data() + value.size(), SER_DISK, CLIENT_VERSION);
+        return (*recoverKVcallback)(callbackDataIn, ssKey, ssValue);
+    });
+    LogPrintf("LevelDBDatabase::Recover: found %u records\n", nRecords);
+    return fSuccess && nRecords > 0;
+}
+
+void LevelDBDatabase::Flush(bool shutdown)
+{
+    if (!m_db) {
+        return;
+    }
+    Sync();
+    if (shutdown) {
+        LOCK(m_cs_open);
+        m_db.reset();
+    }
+}
+
+bool LevelDBDatabase::PeriodicFlush()
+{
+    if (!m_db) {
+        return true;
+    }
+    LogPrint(BCLog::DB, "Flushing %s\n", m_path.string());
+    return Sync();
+}
+
+std::unique_ptr<DatabaseBatch> LevelDBDatabase::MakeBatch(const char* pszMode, bool fFlushOnClose)
+{
+    return MakeUnique<LevelDBBatch>(*this, pszMode, fFlushOnClose);
+}
+
+bool LevelDBDatabase::VerifyEnvironment(const fs::path& wallet_path, std::string& errorStr)
+{
+    LogPrintf("Using LevelDB version %d.%d\n", leveldb::kMajorVersion, leveldb::kMinorVersion);
+    LogPrintf("Using wallet %s\n", (wallet_path / LEVELDB_WALLET_DIR).string());
+
+    TryCreateDirectories(wallet_path);
+    if (!LockDirectory(wallet_path, ".walletlock")) {
+        LogPrintf("Cannot obtain a lock on wallet directory %s. Another instance of bitcoin may be using it.\n", wallet_path.string());
+        errorStr = strprintf(_("Error initializing wallet database environment %s!"), wallet_path.string());
+        return false;
+    }
+    return true;
+}
+
+LevelDBBatch::LevelDBBatch(LevelDBDatabase& database, const char* pszMode, bool fFlushOnCloseIn) :
+    m_database(database),
+    fReadOnly(!strchr(pszMode, '+') && !strchr(pszMode, 'w')),
+    fFlushOnClose(fFlushOnCloseIn)
+{
+    // Open the database right away, so that errors are thrown here
+    m_database.GetDB();
+
+    if (strchr(pszMode, 'c') != nullptr && !Exists(std::string("version"))) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << std::string("version");
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue << CLIENT_VERSION;
+        leveldb::WriteBatch batch;
+        batch.Put(leveldb::Slice(ssKey.data(), ssKey.size()), leveldb::Slice(ssValue.data(), ssValue.size()));
+        Apply(batch);
+    }
+}
+
+leveldb::Status LevelDBBatch::Get(const std::string& strKey, std::string& strValue)
+{
+    if (m_txn) {
+        if (m_txn_erases.count(strKey)) {
+            return leveldb::Status::NotFound(strKey);
+        }
+        auto it = m_txn_writes.find(strKey);
+        if (it != m_txn_writes.end()) {
+            strValue = it->second;
+            return leveldb::Status::OK();
+        }
+    }
+    return m_database.GetDB().Get(leveldb::ReadOptions(), strKey, &strValue);
+}
+
+bool LevelDBBatch::Apply(leveldb::WriteBatch& batch)
+{
+    leveldb::Status status = m_database.GetDB().Write(leveldb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        LogPrintf("LevelDBBatch: Error writing to %s: %s\n", m_database.m_path.string(), status.ToString());
+        return false;
+    }
+    fWritten = true;
+    return true;
+}
+
+bool LevelDBBatch::ReadKey(CDataStream&& ssKey, CDataStream& ssValue)
+{
+    std::string strValue;
+    leveldb::Status status = Get(std::string(ssKey.begin(), ssKey.end()), strValue);
+    if (!status.ok()) {
+        if (!status.IsNotFound()) {
+            LogPrintf("LevelDBBatch: Error reading from %s: %s\n", m_database.m_path.string(), status.ToString());
+        }
+        return false;
+    }
+    ssValue.SetType(SER_DISK);
+    ssValue.clear();
+    ssValue.write(strValue.data(), strValue.size());
+
+    // Clear memory in case it was a private key
+    memory_cleanse(&strValue[0], strValue.size());
+    return true;
+}
+
+bool LevelDBBatch::WriteKey(CDataStream&& ssKey, CDataStream&& ssValue, bool fOverwrite)
+{
+    if (fReadOnly)
+        assert(!"Write called on database in read-only mode");
+
+    std::string strKey(ssKey.begin(), ssKey.end());
+    if (!fOverwrite) {
+        std::string strValue;
+        if (Get(strKey, strValue).ok()) {
+            return false;
+        }
+    }
+    const leveldb::Slice value(ssValue.data(), ssValue.size());
+    if (m_txn) {
+        m_txn->Put(strKey, value);
+        m_txn_erases.erase(strKey);
+        m_txn_writes[strKey] = value.ToString();
+        return true;
+    }
+    leveldb::WriteBatch batch;
+    batch.Put(strKey, value);
+    return Apply(batch);
+}
+
+bool LevelDBBatch::EraseKey(CDataStream&& ssKey)
+{
+    if (fReadOnly)
+        assert(!"Erase called on database in read-only mode");
+
+    std::string strKey(ssKey.begin(), ssKey.end());
+    if (m_txn) {
+        m_txn->Delete(strKey);
+        m_txn_writes.erase(strKey);
+        m_txn_erases.insert(strKey);
+        return true;
+    }
+    leveldb::WriteBatch batch;
+    batch.Delete(strKey);
+    return Apply(batch);
+}
+
+bool LevelDBBatch::HasKey(CDataStream&& ssKey)
+{
+    std::string strValue;
+    return Get(std::string(ssKey.begin(), ssKey.end()), strValue).ok();
+}
+
+bool LevelDBBatch::StartCursor(const CDataStream& ssSeekKey)
+{
+    assert(!m_cursor);
+    m_cursor.reset(m_database.GetDB().NewIterator(leveldb::ReadOptions()));
+    m_cursor_seek_key.assign(ssSeekKey.begin(), ssSeekKey.end());
+    fCursorStarted = false;
+    return true;
+}
+
+bool LevelDBBatch::ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& fComplete)
+{
+    fComplete = false;
+    if (!m_cursor)
+        return false;
+
+    if (!fCursorStarted) {
+        if (m_cursor_seek_key.empty()) {
+            m_cursor->SeekToFirst();
+        } else {
+            m_cursor->Seek(m_cursor_seek_key);
+        }
+        fCursorStarted = true;
+    } else {
+        m_cursor->Next();
+    }
+    if (!m_cursor->Valid()) {
+        // The end is reached if there was no error
+        fComplete = m_cursor->status().ok();
+        return false;
+    }
+
+    // Convert to streams
+    ssKey.SetType(SER_DISK);
+    ssKey.clear();
+    ssKey.write(m_cursor->key().data(), m_cursor->key().size());
+    ssValue.SetType(SER_DISK);
+    ssValue.clear();
+    ssValue.write(m_cursor->value().data(), m_cursor->value().size());
+    return true;
+}
+
+void LevelDBBatch::CloseCursor()
+{
+    m_cursor.reset();
+}
+
+bool LevelDBBatch::TxnBegin()
+{
+    if (m_txn)
+        return false;
+    m_txn = MakeUnique<leveldb::WriteBatch>();
+    return true;
+}
+
+bool LevelDBBatch::TxnCommit()
+{
+    if (!m_txn)
+        return false;
+    std::unique_ptr<leveldb::WriteBatch> batch = std::move(m_txn);
+    m_txn_writes.clear();
+    m_txn_erases.clear();
+    return Apply(*batch);
+}
+
+bool LevelDBBatch::TxnAbort()
+{
+    if (!m_txn)
+        return false;
+    m_txn.reset();
+    m_txn_writes.clear();
+    m_txn_erases.clear();
+    return true;
+}
+
+void LevelDBBatch::Flush()
+{
+    if (m_txn || !fWritten)
+        return;
+
+    // Sync the log to disk
+    if (m_database.Sync()) {
+        fWritten = false;
+    }
+}
+
+void LevelDBBatch::Close()
+{
+    CloseCursor();
+    TxnAbort();
+    if (fFlushOnClose)
+        Flush();
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2021 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_WALLET_LEVELDB_H
+#define BITCOIN_WALLET_LEVELDB_H
+
+#include <sync.h>
+#include <wallet/db.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <leveldb/db.h>
+#include <leveldb/env.h>
+#include <leveldb/write_batch.h>
+
+/** Name of the LevelDB directory inside of the directory of a LevelDB wallet */
+static const std::string LEVELDB_WALLET_DIR = "wallet.leveldb";
+
+/** Whether the wallet at wallet_path uses LevelDB, i.e. it exists as such or it is new and -walletbackend=leveldb */
+bool IsLevelDBWallet(const fs::path& wallet_path);
+
+/** Return whether a LevelDB wallet database is currently loaded. */
+bool IsLevelDBWalletLoaded(const fs::path& wallet_path);
+
+/**
+ * A wallet database stored in LevelDB. Changes are appended to the log of LevelDB, which is synced to disk by the
+ * flushes, so they are never rewritten in full. Batches don't share any lock, reads of different batches (and
+ * wallets) happen concurrently and transactions are written as a single LevelDB batch.
+ */
+class LevelDBDatabase : public WalletDatabase
+{
+    friend class LevelDBBatch;
+
+private:
+    /** The LevelDB directory, empty for a mock database */
+    const fs::path m_path;
+    // Guards opening and closing the database, it is used without a lock
+    CCriticalSection m_cs_open;
+    std::unique_ptr<leveldb::Env> m_env;
+    std::unique_ptr<leveldb::DB> m_db;
+    leveldb::Options m_options;
+
+    /** Open the database if it isn't open yet, throws if that fails */
+    leveldb::DB& GetDB();
+    /** Sync the log of the database to disk */
+    bool Sync();
+
+public:
+    /** Create DB handle to real database, or to a temporary in-memory one with mock */
+    explicit LevelDBDatabase(const fs::path& wallet_path, bool mock = false);
+    ~LevelDBDatabase() override;
+
+    /** Return object for accessing temporary in-memory database. */
+    static std::unique_ptr<LevelDBDatabase> CreateMock()
+    {
+        return MakeUnique<LevelDBDatabase>("", true /* mock */);
+    }
+
+    /** Erase the records starting with pszSkip and compact the database so no removed data is left on disk */
+    bool Rewrite(const char* pszSkip=nullptr) override;
+    /** Copy the database to a new LevelDB wallet at strDest, which can be loaded as a wallet directory */
+    bool Backup(const std::string& strDest) override;
+    void Flush(bool shutdown) override;
+    bool PeriodicFlush() override;
+    void ReloadDbEnv() override {}
+    std::unique_ptr<DatabaseBatch> MakeBatch(const char* pszMode = "r+", bool fFlushOnClose = true) override;
+
+    /* verifies the database environment */
+    static bool VerifyEnvironment(const fs::path& wallet_path, std::string& errorStr);
+    /** Let LevelDB repair a copy of the database and copy the records accepted by recoverKVcallback to a new one */
+    static bool Recover(const fs::path& wallet_path, void *callbackDataIn, bool (*recoverKVcallback)(void* callbackData, CDataStream ssKey, CDataStream ssValue), std::string& out_backup_filename);
+};
+
+/** RAII class that provides access to a LevelDB wallet database */
+class LevelDBBatch : public DatabaseBatch
+{
+private:
+    LevelDBDatabase& m_database;
+    const bool fReadOnly;
+    const bool fFlushOnClose;
+    // Whether anything was written since the last flush
+    bool fWritten{false};
+
+    std::unique_ptr<leveldb::Iterator> m_cursor;
+    // Key of the first record of the cursor
+    std::string m_cursor_seek_key;
+    bool fCursorStarted{false};
+
+    /** Changes of the active transaction, they are seen by the reads of this batch until it is committed */
+    std::unique_ptr<leveldb::WriteBatch> m_txn;
+    std::map<std::string, std::string> m_txn_writes;
+    std::set<std::string> m_txn_erases;
+
+    bool ReadKey(CDataStream&& ssKey, CDataStream& ssValue) override;
+    bool WriteKey(CDataStream&& ssKey, CDataStream&& ssValue, bool fOverwrite) override;
+    bool EraseKey(CDataStream&& ssKey) override;
+    bool HasKey(CDataStream&& ssKey) override;
+
+    /** Read the value of a key, including the changes of the active transaction */
+    leveldb::Status Get(const std::string& strKey, std::string& strValue);
+    /** Write changes to the database, outside of a transaction */
+    bool Apply(leveldb::WriteBatch& batch);
+
+public:
+    explicit LevelDBBatch(LevelDBDatabase& database, const char* pszMode = "r+", bool fFlushOnCloseIn = true);
+    ~LevelDBBatch() override { Close(); }
+
+    void Flush() override;
+    void Close() override;
+
+    using DatabaseBatch::StartCursor;
+    bool StartCursor(const CDataStream& ssSeekKey) override;
+    bool ReadAtCursor(CDataStream& ssKey, CDataStream& ssValue, bool& fComplete) override;
+    void CloseCursor() override;
+
+    bool TxnBegin() override;
+    bool TxnCommit() override;
+    bool TxnAbort() override;
+};
+
+#endif // BITCOIN_WALLET_LEVELDB_H
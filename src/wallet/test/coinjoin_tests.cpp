@@ -5,6 +5,7 @@
 #include <test/test_dash.h>
 
 #include <amount.h>
+#include <coinjoin/coinjoin-client-options.h>
 #include <coinjoin/coinjoin-util.h>
 #include <coinjoin/coinjoin.h>
 #include <consensus/validation.h>
@@ -192,4 +193,26 @@ BOOST_FIXTURE_TEST_CASE(CTransactionBuilderTest, CTransactionBuilderTestSetup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(coinjoin_rounds_cache_tests, CTransactionBuilderTestSetup)
+{
+    const int nRoundsMax = MAX_COINJOIN_ROUNDS + CCoinJoinClientOptions::GetRandomRounds();
+    const COutPoint outpoint(uint256S("01"), 0);
+    const COutPoint outpoint2(uint256S("01"), 1);
+    LOCK(wallet->cs_wallet);
+
+    // Stored rounds are used as they are, unless they were computed with another maximum
+    wallet->LoadCoinJoinRounds(outpoint, 2, nRoundsMax);
+    wallet->LoadCoinJoinRounds(outpoint2, 2, nRoundsMax + 1);
+    BOOST_CHECK_EQUAL(wallet->GetRealOutpointCoinJoinRounds(outpoint), 2);
+    BOOST_CHECK_EQUAL(wallet->GetRealOutpointCoinJoinRounds(outpoint2), -1); // no such tx
+
+    // A mature coinbase output is not denominated
+    const COutPoint coinbaseOutpoint(coinbaseTxns[0].GetHash(), 0);
+    BOOST_CHECK_EQUAL(wallet->GetRealOutpointCoinJoinRounds(coinbaseOutpoint), -2);
+
+    // Importing keys or removing transactions forgets all rounds
+    wallet->MarkDirty();
+    BOOST_CHECK_EQUAL(wallet->GetRealOutpointCoinJoinRounds(outpoint), -1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
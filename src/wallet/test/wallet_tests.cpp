@@ -4,6 +4,7 @@
 
 #include <wallet/wallet.h>
 
+#include <future>
 #include <iostream>
 #include <memory>
 #include <set>
@@ -11,12 +12,14 @@
 #include <utility>
 #include <vector>
 
+#include <coinjoin/coinjoin.h>
 #include <consensus/validation.h>
 #include <key_io.h>
 #include <rpc/server.h>
 #include <test/test_dash.h>
 #include <validation.h>
 #include <wallet/coincontrol.h>
+#include <wallet/leveldb.h>
 #include <wallet/test/wallet_test_fixture.h>
 
 #include <boost/test/unit_test.hpp>
@@ -208,7 +211,7 @@ static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64
     CBlockIndex* block = nullptr;
     if (blockTime > 0) {
         LOCK(cs_main);
-        auto inserted = mapBlockIndex.emplace(GetRandHash(), new CBlockIndex);
+        auto inserted = mapBlockIndex.emplace(GetRandHash(), mapBlockIndex.NewIndex());
         assert(inserted.second);
         const uint256& hash = inserted.first->first;
         block = inserted.first->second;
@@ -270,6 +273,51 @@ BOOST_AUTO_TEST_CASE(LoadReceiveRequests)
     BOOST_CHECK_EQUAL(values[1], "val_rr1");
 }
 
+BOOST_AUTO_TEST_CASE(hd_keypool_topup)
+{
+    gArgs.ForceSetArg("-keypool", "10");
+    auto wallet = MakeUnique<CWallet>(WalletLocation(), WalletDatabase::CreateMock());
+    bool firstRun;
+    wallet->LoadWallet(firstRun);
+    LOCK(wallet->cs_wallet);
+    wallet->GenerateNewHDChain("", "");
+    BOOST_CHECK(wallet->IsHDEnabled());
+    BOOST_CHECK_EQUAL(wallet->GetKeyPoolSize(), 20);
+
+    // Enough keys to be derived in parallel
+    BOOST_CHECK(wallet->TopUpKeyPool(200));
+    BOOST_CHECK_EQUAL(wallet->GetKeyPoolSize(), 400);
+
+    CHDChain hdChain;
+    BOOST_CHECK(wallet->GetHDChain(hdChain));
+    CHDAccount acc;
+    BOOST_CHECK(hdChain.GetAccount(0, acc));
+    BOOST_CHECK_EQUAL(acc.nExternalChainCounter, 200);
+    BOOST_CHECK_EQUAL(acc.nInternalChainCounter, 200);
+
+    // Every key is the one derived at its index on its own
+    for (bool fInternal : {false, true}) {
+        for (uint32_t i = 0; i < 200; i++) {
+            CExtKey childKey;
+            hdChain.DeriveChildExtKey(0, fInternal, i, childKey);
+            CPubKey pubkey;
+            BOOST_CHECK(wallet->GetPubKey(childKey.key.GetPubKey().GetID(), pubkey));
+            BOOST_CHECK(pubkey == childKey.key.GetPubKey());
+        }
+    }
+    CExtKey nextKey;
+    hdChain.DeriveChildExtKey(0, false, 200, nextKey);
+    BOOST_CHECK(!wallet->HaveKey(nextKey.key.GetPubKey().GetID()));
+
+    // Keys of the pool are handed out in order
+    CPubKey firstKey;
+    BOOST_CHECK(wallet->GetKeyFromPool(firstKey, false));
+    CExtKey childKey0;
+    hdChain.DeriveChildExtKey(0, false, 0, childKey0);
+    BOOST_CHECK(firstKey == childKey0.key.GetPubKey());
+    gArgs.ForceSetArg("-keypool", std::to_string(DEFAULT_KEYPOOL_SIZE));
+}
+
 class ListCoinsTestingSetup : public TestChain100Setup
 {
 public:
@@ -369,6 +417,151 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2);
 }
 
+// Check that the incrementally updated balances match the ones calculated from scratch
+BOOST_FIXTURE_TEST_CASE(incremental_balances, ListCoinsTestingSetup)
+{
+    auto checkBalances = [&]() {
+        const CAmount nBalance = wallet->GetBalance();
+        const CAmount nImmatureBalance = wallet->GetImmatureBalance();
+        const CAmount nUnconfirmedBalance = wallet->GetUnconfirmedBalance();
+        wallet->MarkDirty();
+        BOOST_CHECK_EQUAL(nBalance, wallet->GetBalance());
+        BOOST_CHECK_EQUAL(nImmatureBalance, wallet->GetImmatureBalance());
+        BOOST_CHECK_EQUAL(nUnconfirmedBalance, wallet->GetUnconfirmedBalance());
+    };
+
+    BOOST_CHECK_EQUAL(wallet->GetBalance(), 500 * COIN);
+    checkBalances();
+
+    // Spends the mature coinbase, the new block lets the next one mature
+    const CAmount nImmatureBalance = wallet->GetImmatureBalance();
+    const CWalletTx& wtx = AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    const CAmount nFee = wtx.GetDebit(ISMINE_ALL) - wtx.tx->GetValueOut();
+    BOOST_CHECK_EQUAL(wallet->GetBalance(), 999 * COIN - nFee);
+    BOOST_CHECK_EQUAL(wallet->GetImmatureBalance(), nImmatureBalance - 500 * COIN);
+    checkBalances();
+}
+
+// Check that InstantSend locks and ChainLocks which arrive together are processed together
+BOOST_FIXTURE_TEST_CASE(lock_event_batching, ListCoinsTestingSetup)
+{
+    const CWalletTx& wtx = AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    const CTransactionRef txOther = MakeTransactionRef(CMutableTransaction());
+
+    int nISLockNotifications = 0;
+    int nTxNotifications = 0;
+    std::vector<int> vecChainLockHeights;
+    auto conn1 = wallet->NotifyISLockReceived.connect([&]() { nISLockNotifications++; });
+    auto conn2 = wallet->NotifyTransactionChanged.connect([&](CWallet*, const uint256& hash, ChangeType) {
+        BOOST_CHECK(hash == wtx.GetHash());
+        nTxNotifications++;
+    });
+    auto conn3 = wallet->NotifyChainLockReceived.connect([&](int nHeight) { vecChainLockHeights.push_back(nHeight); });
+
+    const CBlockIndex* pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    // Hold the validation interface queue until all events arrived
+    std::promise<void> promise;
+    std::shared_future<void> future = promise.get_future().share();
+    CallFunctionInValidationInterfaceQueue([future] { future.wait(); });
+    wallet->NotifyTransactionLock(wtx.tx, nullptr);
+    wallet->NotifyTransactionLock(txOther, nullptr);
+    wallet->NotifyChainLock(pindexTip->pprev, nullptr);
+    wallet->NotifyChainLock(pindexTip, nullptr);
+    promise.set_value();
+    SyncWithValidationInterfaceQueue();
+
+    BOOST_CHECK_EQUAL(nISLockNotifications, 1);
+    BOOST_CHECK_EQUAL(nTxNotifications, 1);
+    BOOST_CHECK_EQUAL(vecChainLockHeights.size(), 1);
+    BOOST_CHECK_EQUAL(vecChainLockHeights[0], pindexTip->nHeight);
+
+    conn1.disconnect();
+    conn2.disconnect();
+    conn3.disconnect();
+
+    // Events of a wallet that is gone before they are processed are dropped
+    wallet->NotifyTransactionLock(wtx.tx, nullptr);
+    wallet.reset();
+    SyncWithValidationInterfaceQueue();
+}
+
+static CAmount GetAvailableCoinsAmount(CWallet& wallet, CoinType nCoinType, size_t& nCountRet)
+{
+    LOCK2(cs_main, wallet.cs_wallet);
+    std::vector<COutput> available;
+    CCoinControl coin_control;
+    coin_control.nCoinType = nCoinType;
+    wallet.AvailableCoins(available, true, &coin_control);
+    nCountRet = available.size();
+    CAmount nTotal = 0;
+    for (const auto& out : available) {
+        nTotal += out.tx->tx->vout[out.i].nValue;
+    }
+    return nTotal;
+}
+
+// Check that the coins found through the indexed wallet UTXOs and the cached balances are up to date
+BOOST_FIXTURE_TEST_CASE(wallet_utxo_index, ListCoinsTestingSetup)
+{
+    const CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    const CAmount nDenom = CCoinJoin::GetStandardDenominations()[1];
+    const CAmount nCollateral = CCoinJoin::GetCollateralAmount();
+    size_t nCount;
+
+    BOOST_CHECK_EQUAL(wallet->GetBalance(), 500 * COIN);
+    BOOST_CHECK_EQUAL(GetAvailableCoinsAmount(*wallet, CoinType::ONLY_READY_TO_MIX, nCount), 0);
+    BOOST_CHECK_EQUAL(GetAvailableCoinsAmount(*wallet, CoinType::ONLY_COINJOIN_COLLATERAL, nCount), 0);
+
+    // Send a denominated and a collateral amount to ourselves, only the fees are gone
+    AddTx(CRecipient{scriptPubKey, nDenom, false /* subtract fee */});
+    AddTx(CRecipient{scriptPubKey, nCollateral, false /* subtract fee */});
+    const CAmount nBalance = GetAvailableCoinsAmount(*wallet, CoinType::ALL_COINS, nCount);
+    BOOST_CHECK_EQUAL(nCount, 3);
+    BOOST_CHECK(nBalance < 500 * COIN && nBalance > 499 * COIN);
+    BOOST_CHECK_EQUAL(wallet->GetBalance(), nBalance);
+    BOOST_CHECK_EQUAL(wallet->GetAvailableBalance(), nBalance);
+
+    BOOST_CHECK_EQUAL(GetAvailableCoinsAmount(*wallet, CoinType::ONLY_READY_TO_MIX, nCount), nDenom);
+    BOOST_CHECK_EQUAL(nCount, 1);
+    BOOST_CHECK_EQUAL(GetAvailableCoinsAmount(*wallet, CoinType::ONLY_FULLY_MIXED, nCount), 0);
+    BOOST_CHECK_EQUAL(GetAvailableCoinsAmount(*wallet, CoinType::ONLY_COINJOIN_COLLATERAL, nCount), nCollateral);
+    BOOST_CHECK_EQUAL(nCount, 1);
+    BOOST_CHECK_EQUAL(GetAvailableCoinsAmount(*wallet, CoinType::ONLY_NONDENOMINATED, nCount), nBalance - nDenom - nCollateral);
+    BOOST_CHECK_EQUAL(nCount, 1);
+    BOOST_CHECK_EQUAL(wallet->CountInputsWithAmount(nDenom), 1);
+    BOOST_CHECK_EQUAL(wallet->CountInputsWithAmount(CCoinJoin::GetStandardDenominations()[0]), 0);
+
+    // The denominated coin is found in its denomination bucket only
+    std::vector<CTxDSIn> vecTxDSIn;
+    BOOST_CHECK(wallet->SelectTxDSInsByDenomination(CCoinJoin::AmountToDenomination(nDenom), MAX_MONEY, vecTxDSIn));
+    BOOST_CHECK_EQUAL(vecTxDSIn.size(), 1);
+    BOOST_CHECK(!wallet->SelectTxDSInsByDenomination(CCoinJoin::AmountToDenomination(CCoinJoin::GetStandardDenominations()[0]), MAX_MONEY, vecTxDSIn));
+    std::set<CAmount> setAmounts;
+    BOOST_CHECK(wallet->SelectDenominatedAmounts(MAX_MONEY, setAmounts));
+    BOOST_CHECK(setAmounts == std::set<CAmount>{nDenom});
+    BOOST_CHECK(!wallet->SelectDenominatedAmounts(nDenom - 1, setAmounts));
+    BOOST_CHECK(setAmounts.empty());
+
+    // Spending the denominated coin removes it from the index and from the balance
+    CCoinControl coin_control;
+    coin_control.nCoinType = CoinType::ONLY_READY_TO_MIX;
+    CTransactionRef tx;
+    CReserveKey reservekey(wallet.get());
+    CAmount nFee;
+    int nChangePos = -1;
+    std::string strError;
+    BOOST_CHECK(wallet->CreateTransaction({CRecipient{GetScriptForRawPubKey({}), nDenom, true /* subtract fee */}}, tx, reservekey, nFee, nChangePos, strError, coin_control));
+    CValidationState state;
+    BOOST_CHECK(wallet->CommitTransaction(tx, {}, {}, {}, reservekey, nullptr, state));
+    BOOST_CHECK_EQUAL(GetAvailableCoinsAmount(*wallet, CoinType::ONLY_READY_TO_MIX, nCount), 0);
+    BOOST_CHECK_EQUAL(wallet->CountInputsWithAmount(nDenom), 0);
+    BOOST_CHECK_EQUAL(wallet->GetBalance(), nBalance - nDenom);
+}
+
 class CreateTransactionTestSetup : public TestChain100Setup
 {
 public:
@@ -861,4 +1054,64 @@ BOOST_FIXTURE_TEST_CASE(select_coins_grouped_by_addresses, ListCoinsTestingSetup
     vecTally.clear();
 }
 
+BOOST_AUTO_TEST_CASE(leveldb_wallet_batch)
+{
+    std::unique_ptr<LevelDBDatabase> database = LevelDBDatabase::CreateMock();
+    std::unique_ptr<DatabaseBatch> batch = database->MakeBatch();
+
+    BOOST_CHECK(batch->Write(std::make_pair(std::string("name"), std::string("a")), std::string("alice")));
+    BOOST_CHECK(!batch->Write(std::make_pair(std::string("name"), std::string("a")), std::string("bob"), false));
+    BOOST_CHECK(batch->Write(std::make_pair(std::string("name"), std::string("b")), std::string("bob")));
+    BOOST_CHECK(batch->Write(std::make_pair(std::string("purpose"), std::string("a")), std::string("send")));
+
+    // Changes of a transaction are seen by the batch, but only saved when it is committed
+    BOOST_CHECK(batch->TxnBegin());
+    BOOST_CHECK(batch->Erase(std::make_pair(std::string("name"), std::string("a"))));
+    BOOST_CHECK(!batch->Exists(std::make_pair(std::string("name"), std::string("a"))));
+    BOOST_CHECK(batch->TxnAbort());
+    std::string strValue;
+    BOOST_CHECK(batch->Read(std::make_pair(std::string("name"), std::string("a")), strValue));
+    BOOST_CHECK_EQUAL(strValue, "alice");
+
+    BOOST_CHECK(batch->TxnBegin());
+    BOOST_CHECK(batch->Write(std::make_pair(std::string("name"), std::string("c")), std::string("carol")));
+    BOOST_CHECK(batch->Read(std::make_pair(std::string("name"), std::string("c")), strValue));
+    BOOST_CHECK_EQUAL(strValue, "carol");
+    BOOST_CHECK(batch->TxnCommit());
+
+    // A second batch sees the committed records, the cursor reads them in the order of their keys from the seek key
+    std::unique_ptr<DatabaseBatch> batch2 = database->MakeBatch("r");
+    CDataStream ssSeekKey(SER_DISK, CLIENT_VERSION);
+    ssSeekKey << std::make_pair(std::string("name"), std::string("b"));
+    BOOST_CHECK(batch2->StartCursor(ssSeekKey));
+    std::vector<std::string> vecNames;
+    while (true) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        bool fComplete = false;
+        BOOST_CHECK(batch2->ReadAtCursor(ssKey, ssValue, fComplete));
+        if (fComplete) {
+            break;
+        }
+        std::string strType;
+        ssKey >> strType;
+        if (strType != "name") {
+            break;
+        }
+        ssValue >> strValue;
+        vecNames.push_back(strValue);
+    }
+    batch2->CloseCursor();
+    BOOST_CHECK(vecNames == std::vector<std::string>({"bob", "carol"}));
+    BOOST_CHECK(!batch2->Write(std::string("readonly"), 1));
+
+    // Rewriting with a prefix drops the matching records
+    batch.reset();
+    batch2.reset();
+    BOOST_CHECK(database->Rewrite("\x07purpose"));
+    batch = database->MakeBatch();
+    BOOST_CHECK(!batch->Exists(std::make_pair(std::string("purpose"), std::string("a"))));
+    BOOST_CHECK(batch->Exists(std::make_pair(std::string("name"), std::string("a"))));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include <wallet/coinselection.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <ctpl.h>
 #include <fs.h>
 #include <init.h>
 #include <key.h>
@@ -28,6 +29,7 @@
 #include <txmempool.h>
 #include <utilmoneystr.h>
 #include <wallet/fees.h>
+#include <wallet/leveldb.h>
 
 #include <coinjoin/coinjoin-client.h>
 #include <coinjoin/coinjoin-client-options.h>
@@ -40,6 +42,7 @@
 #include <llmq/quorums_chainlocks.h>
 
 #include <assert.h>
+#include <deque>
 #include <future>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -198,8 +201,9 @@ CPubKey CWallet::GenerateNewKey(WalletBatch &batch, uint32_t nAccountIndex, bool
     CPubKey pubkey;
     // use HD key derivation if HD was enabled during wallet creation
     if (IsHDEnabled()) {
-        DeriveNewChildKey(batch, metadata, secret, nAccountIndex, fInternal);
-        pubkey = secret.GetPubKey();
+        std::vector<CPubKey> vecPubKeys;
+        DeriveNewChildKeys(batch, metadata, nAccountIndex, fInternal, 1, vecPubKeys);
+        pubkey = vecPubKeys.front();
     } else {
         secret.MakeNewKey(fCompressed);
 
@@ -222,8 +226,47 @@ CPubKey CWallet::GenerateNewKey(WalletBatch &batch, uint32_t nAccountIndex, bool
     return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(WalletBatch &batch, const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal)
+/** Child keys are derived by up to MAX_KEY_DERIVATION_THREADS threads once there are MIN_PARALLEL_KEY_DERIVATION of them */
+static const int MAX_KEY_DERIVATION_THREADS = 4;
+static const size_t MIN_PARALLEL_KEY_DERIVATION = 64;
+
+/** Derive the public keys of the children nChildIndex..nChildIndex+nCount-1 of the key of a chain */
+static std::vector<CExtPubKey> DeriveChildExtPubKeys(const CExtKey& changeKey, uint32_t nChildIndex, size_t nCount)
+{
+    std::vector<CExtPubKey> vecExtPubKeys(nCount);
+    auto derive = [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            CExtKey childKey;
+            changeKey.Derive(childKey, nChildIndex + i);
+            vecExtPubKeys[i] = childKey.Neuter();
+            assert(childKey.key.VerifyPubKey(vecExtPubKeys[i].pubkey));
+        }
+    };
+
+    int nThreads = std::max(1, std::min(GetNumCores(), MAX_KEY_DERIVATION_THREADS));
+    if (nThreads == 1 || nCount < MIN_PARALLEL_KEY_DERIVATION) {
+        derive(0, nCount);
+        return vecExtPubKeys;
+    }
+
+    // every thread derives a contiguous range of the keys
+    ctpl::thread_pool pool(nThreads);
+    std::vector<std::future<void>> vecFutures;
+    size_t nChunkSize = (nCount + nThreads - 1) / nThreads;
+    for (size_t nBegin = 0; nBegin < nCount; nBegin += nChunkSize) {
+        size_t nEnd = std::min(nBegin + nChunkSize, nCount);
+        vecFutures.emplace_back(pool.push([&derive, nBegin, nEnd](int) { derive(nBegin, nEnd); }));
+    }
+    for (auto& future : vecFutures) {
+        future.get();
+    }
+    return vecExtPubKeys;
+}
+
+void CWallet::DeriveNewChildKeys(WalletBatch &batch, const CKeyMetadata& metadata, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vecPubKeysRet)
 {
+    vecPubKeysRet.clear();
+
     CHDChain hdChainTmp;
     if (!GetHDChain(hdChainTmp)) {
         throw std::runtime_error(std::string(__func__) + ": GetHDChain failed");
@@ -239,22 +282,24 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, const CKeyMetadata& metadata
     if (!hdChainTmp.GetAccount(nAccountIndex, acc))
         throw std::runtime_error(std::string(__func__) + ": Wrong HD account!");
 
-    // derive child key at next index, skip keys already known to the wallet
-    CExtKey childKey;
+    // the hardened part of the path is only derived once for all keys
+    CExtKey changeKey;
+    hdChainTmp.DeriveChangeExtKey(nAccountIndex, fInternal, changeKey);
+
+    // derive child keys at the next indexes, skip keys already known to the wallet
+    // and derive as many more as were skipped
+    std::vector<CExtPubKey> vecNewExtPubKeys;
     uint32_t nChildIndex = fInternal ? acc.nInternalChainCounter : acc.nExternalChainCounter;
-    do {
-        hdChainTmp.DeriveChildExtKey(nAccountIndex, fInternal, nChildIndex, childKey);
+    while (vecNewExtPubKeys.size() < nCount) {
+        size_t nMissing = nCount - vecNewExtPubKeys.size();
+        for (const CExtPubKey& extPubKey : DeriveChildExtPubKeys(changeKey, nChildIndex, nMissing)) {
+            if (!HaveKey(extPubKey.pubkey.GetID())) {
+                vecNewExtPubKeys.push_back(extPubKey);
+            }
+        }
         // increment childkey index
-        nChildIndex++;
-    } while (HaveKey(childKey.key.GetPubKey().GetID()));
-    secretRet = childKey.key;
-
-    CPubKey pubkey = secretRet.GetPubKey();
-    assert(secretRet.VerifyPubKey(pubkey));
-
-    // store metadata
-    mapKeyMetadata[pubkey.GetID()] = metadata;
-    UpdateTimeFirstKey(metadata.nCreateTime);
+        nChildIndex += nMissing;
+    }
 
     // update the chain model in the database
     CHDChain hdChainCurrent;
@@ -279,8 +324,14 @@ void CWallet::DeriveNewChildKey(WalletBatch &batch, const CKeyMetadata& metadata
             throw std::runtime_error(std::string(__func__) + ": SetHDChain failed");
     }
 
-    if (!AddHDPubKey(batch, childKey.Neuter(), fInternal))
-        throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+    for (const CExtPubKey& extPubKey : vecNewExtPubKeys) {
+        // store metadata
+        mapKeyMetadata[extPubKey.pubkey.GetID()] = metadata;
+        if (!AddHDPubKey(batch, extPubKey, fInternal))
+            throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+        vecPubKeysRet.push_back(extPubKey.pubkey);
+    }
+    UpdateTimeFirstKey(metadata.nCreateTime);
 }
 
 bool CWallet::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
@@ -782,7 +833,7 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
-    setWalletUTXO.erase(outpoint);
+    EraseWalletUTXO(outpoint);
 
     setLockedCoins.erase(outpoint);
 
@@ -804,6 +855,50 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+bool CWallet::AddWalletUTXO(const COutPoint& outpoint, const CAmount nValue)
+{
+    AssertLockHeld(cs_wallet);
+    if (!setWalletUTXO.insert(outpoint).second) return false;
+    MarkTxBalancesDirty(outpoint.hash);
+
+    if (CCoinJoin::IsDenominatedAmount(nValue)) {
+        setWalletUTXODenominated.insert(outpoint);
+        mapWalletUTXOByDenomination[nValue].insert(outpoint);
+    } else if (CCoinJoin::IsCollateralAmount(nValue)) {
+        setWalletUTXOCollateral.insert(outpoint);
+    }
+    return true;
+}
+
+void CWallet::EraseWalletUTXO(const COutPoint& outpoint)
+{
+    AssertLockHeld(cs_wallet);
+    if (setWalletUTXO.erase(outpoint) == 0) return;
+    MarkTxBalancesDirty(outpoint.hash);
+
+    if (setWalletUTXODenominated.erase(outpoint) != 0) {
+        for (auto& p : mapWalletUTXOByDenomination) {
+            p.second.erase(outpoint);
+        }
+    }
+    setWalletUTXOCollateral.erase(outpoint);
+}
+
+void CWallet::AddSpentWalletUTXOs(const CWalletTx& wtx)
+{
+    AssertLockHeld(cs_wallet);
+    if (wtx.IsCoinBase()) return;
+
+    for (const CTxIn& txin : wtx.tx->vin) {
+        auto it = mapWallet.find(txin.prevout.hash);
+        if (it == mapWallet.end()) continue;
+        const CTxOut& txout = it->second.tx->vout[txin.prevout.n];
+        if (IsMine(txout) && !IsSpent(txin.prevout.hash, txin.prevout.n)) {
+            AddWalletUTXO(txin.prevout, txout.nValue);
+        }
+    }
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -1098,8 +1193,12 @@ void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
+        // All balances are calculated again
+        fBalancesCached = false;
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        // Keys were imported or transactions removed
+        ClearCoinJoinRoundsCache();
     }
 
     fAnonymizableTallyCached = false;
@@ -1127,10 +1226,16 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
         AddToSpends(hash);
 
+        // The CoinJoin rounds of the transactions spending this one were computed without it
+        auto itSpends = mapTxSpends.lower_bound(COutPoint(hash, 0));
+        if (itSpends != mapTxSpends.end() && itSpends->first.hash == hash) {
+            ClearCoinJoinRoundsCache();
+        }
+
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for(unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                setWalletUTXO.insert(COutPoint(hash, i));
+                AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i].nValue);
                 if (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1167,7 +1272,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         auto mnList = deterministicMNManager->GetListAtChainTip();
         for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
             if (IsMine(wtx.tx->vout[i]) && !IsSpent(hash, i)) {
-                bool new_utxo = setWalletUTXO.insert(COutPoint(hash, i)).second;
+                bool new_utxo = AddWalletUTXO(COutPoint(hash, i), wtx.tx->vout[i].nValue);
                 if (new_utxo && (deterministicMNManager->IsProTxWithCollateral(wtx.tx, i) || mnList.HasMNByCollateral(COutPoint(hash, i)))) {
                     LockCoin(COutPoint(hash, i));
                 }
@@ -1203,6 +1308,15 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
 
+    if (fInsertedNew && CCoinJoinClientOptions::IsEnabled()) {
+        // Store the rounds of new denominated outputs right away, the ones of their inputs are known in most cases
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); ++i) {
+            if (CCoinJoin::IsDenominatedAmount(wtx.tx->vout[i].nValue) && IsMine(wtx.tx->vout[i])) {
+                GetRealOutpointCoinJoinRounds(COutPoint(hash, i));
+            }
+        }
+    }
+
     return true;
 }
 
@@ -1374,6 +1488,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
                     it->second.MarkDirty();
                 }
             }
+            AddSpentWalletUTXOs(wtx);
         }
     }
 
@@ -1438,6 +1553,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
                     it->second.MarkDirty();
                 }
             }
+            AddSpentWalletUTXOs(wtx);
         }
     }
 
@@ -1638,6 +1754,7 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
     if (wtx == nullptr || wtx->tx == nullptr) {
         // no such tx in this wallet
         *nRoundsRef = -1;
+        WriteCoinJoinRounds(outpoint, *nRoundsRef);
         LogPrint(BCLog::COINJOIN, "%s FAILED    %-70s %3d\n", __func__, outpoint.ToStringShort(), -1);
         return *nRoundsRef;
     }
@@ -1646,6 +1763,7 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
     if (outpoint.n >= wtx->tx->vout.size()) {
         // should never actually hit this
         *nRoundsRef = -4;
+        WriteCoinJoinRounds(outpoint, *nRoundsRef);
         LogPrint(BCLog::COINJOIN, "%s FAILED    %-70s %3d\n", __func__, outpoint.ToStringShort(), -4);
         return *nRoundsRef;
     }
@@ -1654,6 +1772,7 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
 
     if (CCoinJoin::IsCollateralAmount(txOutRef->nValue)) {
         *nRoundsRef = -3;
+        WriteCoinJoinRounds(outpoint, *nRoundsRef);
         LogPrint(BCLog::COINJOIN, "%s UPDATED   %-70s %3d\n", __func__, outpoint.ToStringShort(), *nRoundsRef);
         return *nRoundsRef;
     }
@@ -1661,6 +1780,7 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
     // make sure the final output is non-denominate
     if (!CCoinJoin::IsDenominatedAmount(txOutRef->nValue)) { //NOT DENOM
         *nRoundsRef = -2;
+        WriteCoinJoinRounds(outpoint, *nRoundsRef);
         LogPrint(BCLog::COINJOIN, "%s UPDATED   %-70s %3d\n", __func__, outpoint.ToStringShort(), *nRoundsRef);
         return *nRoundsRef;
     }
@@ -1669,6 +1789,7 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
         if (!CCoinJoin::IsDenominatedAmount(out.nValue)) {
             // this one is denominated but there is another non-denominated output found in the same tx
             *nRoundsRef = 0;
+            WriteCoinJoinRounds(outpoint, *nRoundsRef);
             LogPrint(BCLog::COINJOIN, "%s UPDATED   %-70s %3d\n", __func__, outpoint.ToStringShort(), *nRoundsRef);
             return *nRoundsRef;
         }
@@ -1690,10 +1811,42 @@ int CWallet::GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRound
     *nRoundsRef = fDenomFound
             ? (nShortest >= nRoundsMax - 1 ? nRoundsMax : nShortest + 1) // good, we a +1 to the shortest one but only nRoundsMax rounds max allowed
             : 0;            // too bad, we are the fist one in that chain
+    WriteCoinJoinRounds(outpoint, *nRoundsRef);
     LogPrint(BCLog::COINJOIN, "%s UPDATED   %-70s %3d\n", __func__, outpoint.ToStringShort(), *nRoundsRef);
     return *nRoundsRef;
 }
 
+void CWallet::LoadCoinJoinRounds(const COutPoint& outpoint, int nRounds, int nRoundsMax)
+{
+    AssertLockHeld(cs_wallet);
+    // Rounds computed with a different maximum are recomputed (and overwritten) when they are needed
+    if (nRoundsMax != MAX_COINJOIN_ROUNDS + CCoinJoinClientOptions::GetRandomRounds()) return;
+    mapOutpointRoundsCache.emplace(outpoint, nRounds);
+}
+
+void CWallet::WriteCoinJoinRounds(const COutPoint& outpoint, int nRounds) const
+{
+    AssertLockHeld(cs_wallet);
+    // Do not flush the wallet here for performance reasons
+    WalletBatch batch(*database, "r+", false);
+    batch.WriteCoinJoinRounds(outpoint, nRounds, MAX_COINJOIN_ROUNDS + CCoinJoinClientOptions::GetRandomRounds());
+}
+
+void CWallet::ClearCoinJoinRoundsCache()
+{
+    AssertLockHeld(cs_wallet);
+    if (mapOutpointRoundsCache.empty()) return;
+
+    // All stored rounds were loaded into the cache
+    WalletBatch batch(*database, "r+", false);
+    for (const auto& p : mapOutpointRoundsCache) {
+        batch.EraseCoinJoinRounds(p.first);
+    }
+    mapOutpointRoundsCache.clear();
+    // The anonymized balances depend on the rounds
+    fBalancesCached = false;
+}
+
 // respect current settings
 int CWallet::GetCappedOutpointCoinJoinRounds(const COutPoint& outpoint) const
 {
@@ -2189,6 +2342,68 @@ int64_t CWallet::RescanFromTime(int64_t startTime, const WalletRescanReserver& r
  * the main chain after to the addition of any new keys you want to detect
  * transactions for.
  */
+/** Blocks are read and filtered ahead of the one that is scanned, by up to MAX_RESCAN_THREADS threads */
+static const int MAX_RESCAN_THREADS = 4;
+static const int RESCAN_READ_AHEAD_BLOCKS = 32;
+
+namespace {
+
+/**
+ * The keys, scripts and watch-only scripts of a wallet, to find the outputs of a block which might be ours
+ * without locking the wallet. An output that matches is not necessarily IsMine (all keys of a multisig script
+ * are needed for that), but every output that is IsMine matches.
+ */
+struct RescanScriptFilter
+{
+    std::set<CKeyID> setKeyIds;
+    std::set<CScriptID> setScriptIds;
+    std::set<CScript> setWatchOnly;
+    // The number of keys and scripts of the wallet the filter was created from, it's outdated when there are more
+    size_t nKeyStoreSize{0};
+
+    bool Matches(const CScript& scriptPubKey) const
+    {
+        if (setWatchOnly.count(scriptPubKey)) return true;
+
+        std::vector<std::vector<unsigned char>> vSolutions;
+        txnouttype whichType;
+        if (!Solver(scriptPubKey, whichType, vSolutions)) return false;
+
+        switch (whichType) {
+        case TX_PUBKEY:
+            return setKeyIds.count(CPubKey(vSolutions[0]).GetID()) != 0;
+        case TX_PUBKEYHASH:
+            return setKeyIds.count(CKeyID(uint160(vSolutions[0]))) != 0;
+        case TX_SCRIPTHASH:
+            return setScriptIds.count(CScriptID(uint160(vSolutions[0]))) != 0;
+        case TX_MULTISIG:
+            for (size_t i = 1; i + 1 < vSolutions.size(); i++) {
+                if (setKeyIds.count(CPubKey(vSolutions[i]).GetID())) return true;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+};
+
+struct RescanBlock
+{
+    bool fRead{false};
+    CBlock block;
+    // Whether a transaction has outputs that match the filter, as of the filter
+    std::vector<bool> vOutputsMatch;
+    std::shared_ptr<const RescanScriptFilter> filter;
+};
+
+} // namespace
+
+size_t CWallet::GetKeyStoreSize() const
+{
+    LOCK2(cs_wallet, cs_KeyStore);
+    return mapKeys.size() + mapCryptedKeys.size() + mapHdPubKeys.size() + mapScripts.size() + setWatchOnly.size();
+}
+
 CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlockIndex* pindexStop, const WalletRescanReserver &reserver, bool fUpdate)
 {
     int64_t nNow = GetTime();
@@ -2221,6 +2436,27 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
             }
         }
         double progress_current = progress_begin;
+
+        auto MakeFilter = [this]() {
+            auto filter = std::make_shared<RescanScriptFilter>();
+            LOCK2(cs_wallet, cs_KeyStore);
+            filter->setKeyIds = GetKeys();
+            for (const auto& p : mapHdPubKeys) {
+                filter->setKeyIds.insert(p.first);
+            }
+            filter->setScriptIds = GetCScripts();
+            filter->setWatchOnly = setWatchOnly;
+            filter->nKeyStoreSize = GetKeyStoreSize();
+            return std::shared_ptr<const RescanScriptFilter>(filter);
+        };
+        std::shared_ptr<const RescanScriptFilter> filter = MakeFilter();
+
+        const Consensus::Params& consensusParams = chainParams.GetConsensus();
+        // The pool waits for the blocks that are still being read when it goes out of scope
+        ctpl::thread_pool pool(std::max(1, std::min(GetNumCores(), MAX_RESCAN_THREADS)));
+        std::deque<std::pair<CBlockIndex*, std::future<RescanBlock>>> queueBlocks;
+        CBlockIndex* pindexReadAhead = pindex;
+
         while (pindex && !fAbortRescan && !ShutdownRequested())
         {
             m_scanning_progress = (progress_current - progress_begin) / (progress_end - progress_begin);
@@ -2232,8 +2468,39 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, progress_current);
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            if (!queueBlocks.empty() && queueBlocks.front().first != pindex) {
+                // The chain was reorganized, the blocks read ahead are not the next ones anymore
+                queueBlocks.clear();
+            }
+            if (queueBlocks.empty()) {
+                pindexReadAhead = pindex;
+            }
+            // Keep the worker threads busy with the blocks after this one
+            while (pindexReadAhead && (int)queueBlocks.size() < RESCAN_READ_AHEAD_BLOCKS) {
+                queueBlocks.emplace_back(pindexReadAhead, pool.push([pindexReadAhead, filter, &consensusParams](int) {
+                    RescanBlock res;
+                    res.filter = filter;
+                    res.fRead = ReadBlockFromDisk(res.block, pindexReadAhead, consensusParams);
+                    if (res.fRead) {
+                        res.vOutputsMatch.reserve(res.block.vtx.size());
+                        for (const auto& ptx : res.block.vtx) {
+                            res.vOutputsMatch.push_back(std::any_of(ptx->vout.begin(), ptx->vout.end(), [&](const CTxOut& txout) {
+                                return filter->Matches(txout.scriptPubKey);
+                            }));
+                        }
+                    }
+                    return res;
+                }));
+                if (pindexReadAhead == pindexStop) {
+                    pindexReadAhead = nullptr;
+                } else {
+                    LOCK(cs_main);
+                    pindexReadAhead = chainActive.Next(pindexReadAhead);
+                }
+            }
+            RescanBlock res = queueBlocks.front().second.get();
+            queueBlocks.pop_front();
+            if (res.fRead) {
                 LOCK2(cs_main, cs_wallet);
                 if (pindex && !chainActive.Contains(pindex)) {
                     // Abort scan if current block is no longer active, to prevent
@@ -2241,8 +2508,25 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                     ret = pindex;
                     break;
                 }
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                // Keys might have been added (from the keypool) by the blocks before, outputs to them didn't match then
+                const bool fFilterOutdated = res.filter->nKeyStoreSize != GetKeyStoreSize();
+                for (size_t posInBlock = 0; posInBlock < res.block.vtx.size(); ++posInBlock) {
+                    const CTransactionRef& ptx = res.block.vtx[posInBlock];
+                    // Only transactions which can involve the wallet have to be looked at closer, these are the ones
+                    // with outputs that can be ours, the ones spending our outputs or conflicting with our
+                    // transactions and our transactions themselves
+                    bool fInvolvesWallet = fFilterOutdated ? IsMine(*ptx) : res.vOutputsMatch[posInBlock];
+                    fInvolvesWallet = fInvolvesWallet || mapWallet.count(ptx->GetHash()) ||
+                                      std::any_of(ptx->vin.begin(), ptx->vin.end(), [&](const CTxIn& txin) {
+                                          return mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout);
+                                      });
+                    if (fInvolvesWallet) {
+                        AddToWalletIfInvolvingMe(ptx, pindex, posInBlock, fUpdate);
+                    }
+                }
+                if (GetKeyStoreSize() != filter->nKeyStoreSize) {
+                    // The blocks which are read already are checked against the wallet directly
+                    filter = MakeFilter();
                 }
             } else {
                 ret = pindex;
@@ -2334,6 +2618,26 @@ std::set<uint256> CWalletTx::GetConflicts() const
     return result;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fAnonymizedCreditCached = false;
+    fDenomUnconfCreditCached = false;
+    fDenomConfCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+
+    if (pwallet) {
+        pwallet->MarkTxBalancesDirty(GetHash());
+    }
+}
+
 CAmount CWalletTx::GetDebit(const isminefilter& filter) const
 {
     if (tx->vin.empty())
@@ -2692,11 +2996,145 @@ std::unordered_set<const CWalletTx*, WalletTxHasher> CWallet::GetSpendableTXs()
     return ret;
 }
 
+CWallet::Balances& CWallet::Balances::operator+=(const Balances& other)
+{
+    nBalance += other.nBalance;
+    nUnconfirmedBalance += other.nUnconfirmedBalance;
+    nImmatureBalance += other.nImmatureBalance;
+    nWatchOnlyBalance += other.nWatchOnlyBalance;
+    nUnconfirmedWatchOnlyBalance += other.nUnconfirmedWatchOnlyBalance;
+    nImmatureWatchOnlyBalance += other.nImmatureWatchOnlyBalance;
+    nAnonymizedBalance += other.nAnonymizedBalance;
+    nDenominatedBalance += other.nDenominatedBalance;
+    nDenominatedUnconfirmedBalance += other.nDenominatedUnconfirmedBalance;
+    return *this;
+}
+
+CWallet::Balances& CWallet::Balances::operator-=(const Balances& other)
+{
+    nBalance -= other.nBalance;
+    nUnconfirmedBalance -= other.nUnconfirmedBalance;
+    nImmatureBalance -= other.nImmatureBalance;
+    nWatchOnlyBalance -= other.nWatchOnlyBalance;
+    nUnconfirmedWatchOnlyBalance -= other.nUnconfirmedWatchOnlyBalance;
+    nImmatureWatchOnlyBalance -= other.nImmatureWatchOnlyBalance;
+    nAnonymizedBalance -= other.nAnonymizedBalance;
+    nDenominatedBalance -= other.nDenominatedBalance;
+    nDenominatedUnconfirmedBalance -= other.nDenominatedUnconfirmedBalance;
+    return *this;
+}
+
+void CWallet::MarkTxBalancesDirty(const uint256& hash) const
+{
+    // nothing to do if all of them are calculated again anyway
+    if (fBalancesCached) {
+        setBalancesDirtyTxs.insert(hash);
+    }
+}
+
+bool CWallet::HasWalletUTXO(const uint256& hash) const
+{
+    AssertLockHeld(cs_wallet);
+    auto it = setWalletUTXO.lower_bound(COutPoint(hash, 0));
+    return it != setWalletUTXO.end() && it->hash == hash;
+}
+
+void CWallet::AddTxBalances(const CWalletTx& wtx) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    Balances balances;
+    const int nDepth = wtx.GetDepthInMainChain();
+    const bool fTrusted = wtx.IsTrusted();
+    const bool fUnconfirmed = !fTrusted && nDepth == 0 && !wtx.IsLockedByInstantSend() && wtx.InMempool();
+    if (fTrusted) {
+        balances.nBalance = wtx.GetAvailableCredit(true, ISMINE_SPENDABLE);
+        balances.nWatchOnlyBalance = wtx.GetAvailableCredit(true, ISMINE_WATCH_ONLY);
+    }
+    if (fUnconfirmed) {
+        balances.nUnconfirmedBalance = wtx.GetAvailableCredit();
+        balances.nUnconfirmedWatchOnlyBalance = wtx.GetAvailableCredit(true, ISMINE_WATCH_ONLY);
+    }
+    balances.nImmatureBalance = wtx.GetImmatureCredit();
+    balances.nImmatureWatchOnlyBalance = wtx.GetImmatureWatchOnlyCredit();
+    if (cachedBalances.fCoinJoinEnabled) {
+        balances.nAnonymizedBalance = wtx.GetAnonymizedCredit();
+        balances.nDenominatedBalance = wtx.GetDenominatedCredit(false);
+        balances.nDenominatedUnconfirmedBalance = wtx.GetDenominatedCredit(true);
+    }
+
+    const uint256& hash = wtx.GetHash();
+    cachedBalances += balances;
+    mapTxBalances[hash] = balances;
+    // Confirmed transactions only change with a notification for them, the others can change with every block or
+    // mempool update
+    if (nDepth < 1 || !CheckFinalTx(*wtx.tx) || (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0)) {
+        setBalancesVolatileTxs.insert(hash);
+    }
+}
+
+const CWallet::CachedBalances& CWallet::GetCachedBalances() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    const unsigned int nMempoolTransactionsUpdated = mempool.GetTransactionsUpdated();
+    const bool fCoinJoinEnabled = CCoinJoinClientOptions::IsEnabled();
+    const int nCoinJoinRounds = CCoinJoinClientOptions::GetRounds();
+
+    if (!fBalancesCached || cachedBalances.fCoinJoinEnabled != fCoinJoinEnabled || cachedBalances.nCoinJoinRounds != nCoinJoinRounds) {
+        cachedBalances = CachedBalances();
+        cachedBalances.fCoinJoinEnabled = fCoinJoinEnabled;
+        cachedBalances.nCoinJoinRounds = nCoinJoinRounds;
+        mapTxBalances.clear();
+        setBalancesDirtyTxs.clear();
+        setBalancesVolatileTxs.clear();
+        for (auto pcoin : GetSpendableTXs()) {
+            AddTxBalances(*pcoin);
+        }
+        fBalancesCached = true;
+    } else if (cachedBalances.pindexTip != chainActive.Tip() || cachedBalances.nMempoolTransactionsUpdated != nMempoolTransactionsUpdated) {
+        // Whether the outputs of a transaction are spent depends on the transactions that spend them
+        for (const uint256& hash : setBalancesVolatileTxs) {
+            setBalancesDirtyTxs.insert(hash);
+            auto it = mapWallet.find(hash);
+            if (it == mapWallet.end()) continue;
+            for (const CTxIn& txin : it->second.tx->vin) {
+                setBalancesDirtyTxs.insert(txin.prevout.hash);
+            }
+        }
+    }
+    cachedBalances.pindexTip = chainActive.Tip();
+    cachedBalances.nMempoolTransactionsUpdated = nMempoolTransactionsUpdated;
+
+    std::set<uint256> setDirtyTxs;
+    std::swap(setDirtyTxs, setBalancesDirtyTxs);
+    for (const uint256& hash : setDirtyTxs) {
+        auto it = mapTxBalances.find(hash);
+        if (it != mapTxBalances.end()) {
+            cachedBalances -= it->second;
+            mapTxBalances.erase(it);
+        }
+        setBalancesVolatileTxs.erase(hash);
+
+        auto jt = mapWallet.find(hash);
+        if (jt != mapWallet.end() && HasWalletUTXO(hash)) {
+            AddTxBalances(jt->second);
+        }
+    }
+    return cachedBalances;
+}
+
 CAmount CWallet::GetBalance(const isminefilter& filter, const int min_depth, const bool fAddLocked) const
 {
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
+        if (min_depth == 0 && !fAddLocked) {
+            if (filter == ISMINE_SPENDABLE) return GetCachedBalances().nBalance;
+            if (filter == ISMINE_WATCH_ONLY) return GetCachedBalances().nWatchOnlyBalance;
+        }
         for (auto pcoin : GetSpendableTXs()) {
             if (pcoin->IsTrusted() && ((pcoin->GetDepthInMainChain() >= min_depth) || (fAddLocked && pcoin->IsLockedByInstantSend()))) {
                 nTotal += pcoin->GetAvailableCredit(true, filter);
@@ -2737,8 +3175,19 @@ CAmount CWallet::GetAnonymizedBalance(const CCoinControl* coinControl) const
 
     LOCK2(cs_main, cs_wallet);
 
-    for (auto pcoin : GetSpendableTXs()) {
-        nTotal += pcoin->GetAnonymizedCredit(coinControl);
+    if (coinControl == nullptr) return GetCachedBalances().nAnonymizedBalance;
+
+    for (const auto& outpoint : setWalletUTXODenominated) {
+        if (coinControl->HasSelected() && !coinControl->IsSelected(outpoint)) continue;
+
+        const auto it = mapWallet.find(outpoint.hash);
+        if (it == mapWallet.end()) continue;
+        // Exclude coinbase and conflicted txes
+        if (it->second.IsCoinBase() || it->second.GetDepthInMainChain() < 0) continue;
+
+        if (IsFullyMixed(outpoint)) {
+            nTotal += GetCredit(it->second.tx->vout[outpoint.n], ISMINE_SPENDABLE);
+        }
     }
 
     return nTotal;
@@ -2754,9 +3203,7 @@ float CWallet::GetAverageAnonymizedRounds() const
     int nCount = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (const auto& outpoint : setWalletUTXO) {
-        if(!IsDenominated(outpoint)) continue;
-
+    for (const auto& outpoint : setWalletUTXODenominated) {
         nTotal += GetCappedOutpointCoinJoinRounds(outpoint);
         nCount++;
     }
@@ -2775,12 +3222,11 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
     CAmount nTotal = 0;
 
     LOCK2(cs_main, cs_wallet);
-    for (const auto& outpoint : setWalletUTXO) {
+    for (const auto& outpoint : setWalletUTXODenominated) {
         const auto it = mapWallet.find(outpoint.hash);
         if (it == mapWallet.end()) continue;
 
         CAmount nValue = it->second.tx->vout[outpoint.n].nValue;
-        if (!CCoinJoin::IsDenominatedAmount(nValue)) continue;
         if (it->second.GetDepthInMainChain() < 0) continue;
 
         int nRounds = GetCappedOutpointCoinJoinRounds(outpoint);
@@ -2794,65 +3240,32 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 {
     if (!CCoinJoinClientOptions::IsEnabled()) return 0;
 
-    CAmount nTotal = 0;
-
     LOCK2(cs_main, cs_wallet);
-
-    for (auto pcoin : GetSpendableTXs()) {
-        nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-    }
-
-    return nTotal;
+    return unconfirmed ? GetCachedBalances().nDenominatedUnconfirmedBalance : GetCachedBalances().nDenominatedBalance;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto pcoin : GetSpendableTXs()) {
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nUnconfirmedBalance;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto pcoin : GetSpendableTXs()) {
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nImmatureBalance;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto pcoin : GetSpendableTXs()) {
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && !pcoin->IsLockedByInstantSend() && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit(true, ISMINE_WATCH_ONLY);
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nUnconfirmedWatchOnlyBalance;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto pcoin : GetSpendableTXs()) {
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetCachedBalances().nImmatureWatchOnlyBalance;
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -2923,88 +3336,120 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
 
     CAmount nTotal = 0;
 
-    for (auto pcoin : GetSpendableTXs()) {
-        const uint256& wtxid = pcoin->GetHash();
-
-        if (!CheckFinalTx(*pcoin->tx))
-            continue;
-
-        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-            continue;
+    // Only go through the unspent outputs of the requested type if they are indexed
+    const std::set<COutPoint>* pSetUTXO = &setWalletUTXO;
+    if (nCoinType == CoinType::ONLY_FULLY_MIXED || nCoinType == CoinType::ONLY_READY_TO_MIX) {
+        pSetUTXO = &setWalletUTXODenominated;
+        // or the ones of a single denomination
+        if (nMinimumAmount == nMaximumAmount && CCoinJoin::IsDenominatedAmount(nMinimumAmount)) {
+            static const std::set<COutPoint> setEmpty;
+            const auto it = mapWalletUTXOByDenomination.find(nMinimumAmount);
+            pSetUTXO = it != mapWalletUTXOByDenomination.end() ? &it->second : &setEmpty;
+        }
+    } else if (nCoinType == CoinType::ONLY_COINJOIN_COLLATERAL) {
+        pSetUTXO = &setWalletUTXOCollateral;
+    }
+
+    const CWalletTx* pcoin = nullptr;
+    bool fSkipTx = false;
+    int nDepth = 0;
+    bool safeTx = false;
+
+    for (const auto& outpoint : *pSetUTXO) {
+        const uint256& wtxid = outpoint.hash;
+        const unsigned int i = outpoint.n;
+
+        // The outpoints are sorted, the checks of a transaction are done for its first unspent output only
+        if (pcoin == nullptr || pcoin->GetHash() != wtxid) {
+            const auto it = mapWallet.find(wtxid);
+            if (it == mapWallet.end()) {
+                pcoin = nullptr;
+                continue;
+            }
+            pcoin = &it->second;
+            fSkipTx = true;
 
-        int nDepth = pcoin->GetDepthInMainChain();
+            if (!CheckFinalTx(*pcoin->tx))
+                continue;
 
-        // We should not consider coins which aren't at least in our mempool
-        // It's possible for these to be conflicted via ancestors which we may never be able to detect
-        if (nDepth == 0 && !pcoin->InMempool())
-            continue;
+            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+                continue;
 
-        bool safeTx = pcoin->IsTrusted();
+            nDepth = pcoin->GetDepthInMainChain();
 
-        if (fOnlySafe && !safeTx) {
-            continue;
-        }
+            // We should not consider coins which aren't at least in our mempool
+            // It's possible for these to be conflicted via ancestors which we may never be able to detect
+            if (nDepth == 0 && !pcoin->InMempool())
+                continue;
 
-        if (nDepth < nMinDepth || nDepth > nMaxDepth)
-            continue;
+            safeTx = pcoin->IsTrusted();
 
-        for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-            bool found = false;
-            if (nCoinType == CoinType::ONLY_FULLY_MIXED) {
-                if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
-                found = IsFullyMixed(COutPoint(wtxid, i));
-            } else if(nCoinType == CoinType::ONLY_READY_TO_MIX) {
-                if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
-                found = !IsFullyMixed(COutPoint(wtxid, i));
-            } else if(nCoinType == CoinType::ONLY_NONDENOMINATED) {
-                if (CCoinJoin::IsCollateralAmount(pcoin->tx->vout[i].nValue)) continue; // do not use collateral amounts
-                found = !CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
-            } else if(nCoinType == CoinType::ONLY_MASTERNODE_COLLATERAL) {
-                found = pcoin->tx->vout[i].nValue == 1000*COIN;
-            } else if(nCoinType == CoinType::ONLY_COINJOIN_COLLATERAL) {
-                found = CCoinJoin::IsCollateralAmount(pcoin->tx->vout[i].nValue);
-            } else {
-                found = true;
+            if (fOnlySafe && !safeTx) {
+                continue;
             }
-            if(!found) continue;
 
-            if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
+            if (nDepth < nMinDepth || nDepth > nMaxDepth)
                 continue;
 
-            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
-                continue;
+            fSkipTx = false;
+        }
+        if (fSkipTx) continue;
+
+        bool found = false;
+        if (nCoinType == CoinType::ONLY_FULLY_MIXED) {
+            if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
+            found = IsFullyMixed(outpoint);
+        } else if(nCoinType == CoinType::ONLY_READY_TO_MIX) {
+            if (!CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
+            found = !IsFullyMixed(outpoint);
+        } else if(nCoinType == CoinType::ONLY_NONDENOMINATED) {
+            if (CCoinJoin::IsCollateralAmount(pcoin->tx->vout[i].nValue)) continue; // do not use collateral amounts
+            found = !CCoinJoin::IsDenominatedAmount(pcoin->tx->vout[i].nValue);
+        } else if(nCoinType == CoinType::ONLY_MASTERNODE_COLLATERAL) {
+            found = pcoin->tx->vout[i].nValue == 1000*COIN;
+        } else if(nCoinType == CoinType::ONLY_COINJOIN_COLLATERAL) {
+            found = CCoinJoin::IsCollateralAmount(pcoin->tx->vout[i].nValue);
+        } else {
+            found = true;
+        }
+        if(!found) continue;
 
-            if (IsLockedCoin(wtxid, i) && nCoinType != CoinType::ONLY_MASTERNODE_COLLATERAL)
-                continue;
+        if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
+            continue;
 
-            if (IsSpent(wtxid, i))
-                continue;
+        if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(outpoint))
+            continue;
 
-            isminetype mine = IsMine(pcoin->tx->vout[i]);
+        if (IsLockedCoin(wtxid, i) && nCoinType != CoinType::ONLY_MASTERNODE_COLLATERAL)
+            continue;
 
-            if (mine == ISMINE_NO) {
-                continue;
-            }
+        if (IsSpent(wtxid, i))
+            continue;
 
-            bool fSpendableIn = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO);
-            bool fSolvableIn = (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO;
+        isminetype mine = IsMine(pcoin->tx->vout[i]);
 
-            vCoins.push_back(COutput(pcoin, i, nDepth, fSpendableIn, fSolvableIn, safeTx));
+        if (mine == ISMINE_NO) {
+            continue;
+        }
 
-            // Checks the sum amount of all UTXO's.
-            if (nMinimumSumAmount != MAX_MONEY) {
-                nTotal += pcoin->tx->vout[i].nValue;
+        bool fSpendableIn = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO);
+        bool fSolvableIn = (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO;
 
-                if (nTotal >= nMinimumSumAmount) {
-                    return;
-                }
-            }
+        vCoins.push_back(COutput(pcoin, i, nDepth, fSpendableIn, fSolvableIn, safeTx));
 
-            // Checks the maximum number of UTXO's.
-            if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+        // Checks the sum amount of all UTXO's.
+        if (nMinimumSumAmount != MAX_MONEY) {
+            nTotal += pcoin->tx->vout[i].nValue;
+
+            if (nTotal >= nMinimumSumAmount) {
                 return;
             }
         }
+
+        // Checks the maximum number of UTXO's.
+        if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+            return;
+        }
     }
 }
 
@@ -3088,27 +3533,24 @@ void CWallet::InitCoinJoinSalt()
     }
 }
 
-struct CompareByPriority
+CoinSelectionPool::Entry::Entry(const COutput& output) :
+    coin(output.tx->tx, output.i),
+    fSpendable(output.fSpendable),
+    nDepth(output.nDepth),
+    fFromMe(output.tx->IsFromMe(ISMINE_ALL)),
+    fLockedByIS(output.tx->IsLockedByInstantSend())
 {
-    bool operator()(const COutput& t1,
-                    const COutput& t2) const
-    {
-        return t1.Priority() > t2.Priority();
-    }
-};
+    mempool.GetTransactionAncestry(output.tx->GetHash(), ancestors, descendants);
+}
 
-bool CWallet::OutputEligibleForSpending(const COutput& output, const CoinEligibilityFilter& eligibility_filter) const
+bool CoinSelectionPool::Entry::IsEligible(const CoinEligibilityFilter& eligibility_filter) const
 {
-    if (!output.fSpendable)
+    if (!fSpendable)
         return false;
 
-    bool fLockedByIS = output.tx->IsLockedByInstantSend();
-
-    if ((output.nDepth < (output.tx->IsFromMe(ISMINE_ALL) ? eligibility_filter.conf_mine : eligibility_filter.conf_theirs)) && !fLockedByIS)
+    if ((nDepth < (fFromMe ? eligibility_filter.conf_mine : eligibility_filter.conf_theirs)) && !fLockedByIS)
         return false;
 
-    size_t ancestors, descendants;
-    mempool.GetTransactionAncestry(output.tx->GetHash(), ancestors, descendants);
     if (ancestors > eligibility_filter.max_ancestors || descendants > eligibility_filter.max_descendants) {
         return false;
     }
@@ -3116,53 +3558,84 @@ bool CWallet::OutputEligibleForSpending(const COutput& output, const CoinEligibi
     return true;
 }
 
+bool CWallet::OutputEligibleForSpending(const COutput& output, const CoinEligibilityFilter& eligibility_filter) const
+{
+    return CoinSelectionPool::Entry(output).IsEligible(eligibility_filter);
+}
+
+void CWallet::MakeCoinSelectionPool(const std::vector<COutput>& vCoins, const CoinSelectionParams& coin_selection_params, CoinSelectionPool& poolRet) const
+{
+    poolRet.vEntries.clear();
+    poolRet.vEntries.reserve(vCoins.size());
+    poolRet.use_bnb = coin_selection_params.use_bnb;
+
+    if (!coin_selection_params.use_bnb) {
+        for (const COutput &output : vCoins) {
+            poolRet.vEntries.emplace_back(output);
+        }
+        return;
+    }
+
+    // Get long term estimate
+    FeeCalculation feeCalc;
+    CCoinControl temp;
+    temp.m_confirm_target = 1008;
+    CFeeRate long_term_feerate = GetMinimumFeeRate(temp, ::mempool, ::feeEstimator, &feeCalc);
+
+    // Calculate cost of change
+    poolRet.cost_of_change = GetDiscardRate(::feeEstimator).GetFee(coin_selection_params.change_spend_size) + coin_selection_params.effective_fee.GetFee(coin_selection_params.change_output_size);
+
+    // Calculate the fees for things that aren't inputs
+    poolRet.not_input_fees = coin_selection_params.effective_fee.GetFee(coin_selection_params.tx_noinputs_size);
+
+    // Add to the pool and calculate effective value
+    for (const COutput &output : vCoins)
+    {
+        CAmount nFee = output.nInputBytes < 0 ? 0 : coin_selection_params.effective_fee.GetFee(output.nInputBytes);
+        // Only include outputs that are positive effective value (i.e. not dust)
+        if (output.tx->tx->vout[output.i].nValue - nFee <= 0)
+            continue;
+
+        poolRet.vEntries.emplace_back(output);
+        CInputCoin& coin = poolRet.vEntries.back().coin;
+        coin.effective_value = coin.txout.nValue - nFee;
+        coin.fee = nFee;
+        coin.long_term_fee = output.nInputBytes < 0 ? 0 : long_term_feerate.GetFee(output.nInputBytes);
+    }
+    std::stable_sort(poolRet.vEntries.begin(), poolRet.vEntries.end(), [](const CoinSelectionPool::Entry& a, const CoinSelectionPool::Entry& b) {
+        return a.coin.effective_value > b.coin.effective_value;
+    });
+}
+
 bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, std::vector<COutput> vCoins,
                                  std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CoinSelectionParams& coin_selection_params, bool& bnb_used, CoinType nCoinType) const
+{
+    CoinSelectionPool pool;
+    MakeCoinSelectionPool(vCoins, coin_selection_params, pool);
+    return SelectCoinsMinConf(nTargetValue, eligibility_filter, pool, setCoinsRet, nValueRet, bnb_used, nCoinType);
+}
+
+bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, const CoinSelectionPool& pool,
+                                 std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, bool& bnb_used, CoinType nCoinType) const
 {
     setCoinsRet.clear();
     nValueRet = 0;
 
+    // Filter by the min conf specs and add to utxo_pool
     std::vector<CInputCoin> utxo_pool;
-    if (coin_selection_params.use_bnb) {
-
-        // Get long term estimate
-        FeeCalculation feeCalc;
-        CCoinControl temp;
-        temp.m_confirm_target = 1008;
-        CFeeRate long_term_feerate = GetMinimumFeeRate(temp, ::mempool, ::feeEstimator, &feeCalc);
-
-        // Calculate cost of change
-        CAmount cost_of_change = GetDiscardRate(::feeEstimator).GetFee(coin_selection_params.change_spend_size) + coin_selection_params.effective_fee.GetFee(coin_selection_params.change_output_size);
+    utxo_pool.reserve(pool.vEntries.size());
+    for (const CoinSelectionPool::Entry& entry : pool.vEntries)
+    {
+        if (!entry.IsEligible(eligibility_filter))
+            continue;
 
-        // Filter by the min conf specs and add to utxo_pool and calculate effective value
-        for (const COutput &output : vCoins)
-        {
-            if (!OutputEligibleForSpending(output, eligibility_filter))
-                continue;
+        utxo_pool.push_back(entry.coin);
+    }
 
-            CInputCoin coin(output.tx->tx, output.i);
-            coin.effective_value = coin.txout.nValue - (output.nInputBytes < 0 ? 0 : coin_selection_params.effective_fee.GetFee(output.nInputBytes));
-            // Only include outputs that are positive effective value (i.e. not dust)
-            if (coin.effective_value > 0) {
-                coin.fee = output.nInputBytes < 0 ? 0 : coin_selection_params.effective_fee.GetFee(output.nInputBytes);
-                coin.long_term_fee = output.nInputBytes < 0 ? 0 : long_term_feerate.GetFee(output.nInputBytes);
-                utxo_pool.push_back(coin);
-            }
-        }
-        // Calculate the fees for things that aren't inputs
-        CAmount not_input_fees = coin_selection_params.effective_fee.GetFee(coin_selection_params.tx_noinputs_size);
+    if (pool.use_bnb) {
         bnb_used = true;
-        return SelectCoinsBnB(utxo_pool, nTargetValue, cost_of_change, setCoinsRet, nValueRet, not_input_fees);
+        return SelectCoinsBnB(utxo_pool, nTargetValue, pool.cost_of_change, setCoinsRet, nValueRet, pool.not_input_fees);
     } else {
-        // Filter by the min conf specs and add to utxo_pool
-        for (const COutput &output : vCoins)
-        {
-            if (!OutputEligibleForSpending(output, eligibility_filter))
-                continue;
-
-            CInputCoin coin = CInputCoin(output.tx->tx, output.i);
-            utxo_pool.push_back(coin);
-        }
         bnb_used = false;
         return KnapsackSolver(nTargetValue, utxo_pool, setCoinsRet, nValueRet, nCoinType == CoinType::ONLY_FULLY_MIXED, maxTxFee);
     }
@@ -3241,14 +3714,20 @@ bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAm
     size_t max_descendants = (size_t)std::max<int64_t>(1, gArgs.GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT));
     bool fRejectLongChains = gArgs.GetBoolArg("-walletrejectlongchains", DEFAULT_WALLET_REJECT_LONG_CHAINS);
 
+    // the effective values and eligibility of the coins are the same for all attempts
+    CoinSelectionPool pool;
+    if (nTargetValue > nValueFromPresetInputs) {
+        MakeCoinSelectionPool(vCoins, coin_selection_params, pool);
+    }
+
     bool res = nTargetValue <= nValueFromPresetInputs ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(1, 6, 0), vCoins, setCoinsRet, nValueRet, coin_selection_params, bnb_used, nCoinType) ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(1, 1, 0), vCoins, setCoinsRet, nValueRet, coin_selection_params, bnb_used, nCoinType) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, 2), vCoins, setCoinsRet, nValueRet, coin_selection_params, bnb_used, nCoinType)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, std::min((size_t)4, max_ancestors/3), std::min((size_t)4, max_descendants/3)), vCoins, setCoinsRet, nValueRet, coin_selection_params, bnb_used, nCoinType)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, max_ancestors/2, max_descendants/2), vCoins, setCoinsRet, nValueRet, coin_selection_params, bnb_used, nCoinType)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, max_ancestors-1, max_descendants-1), vCoins, setCoinsRet, nValueRet, coin_selection_params, bnb_used, nCoinType)) ||
-        (bSpendZeroConfChange && !fRejectLongChains && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, std::numeric_limits<uint64_t>::max()), vCoins, setCoinsRet, nValueRet, coin_selection_params, bnb_used, nCoinType));
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(1, 6, 0), pool, setCoinsRet, nValueRet, bnb_used, nCoinType) ||
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(1, 1, 0), pool, setCoinsRet, nValueRet, bnb_used, nCoinType) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, 2), pool, setCoinsRet, nValueRet, bnb_used, nCoinType)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, std::min((size_t)4, max_ancestors/3), std::min((size_t)4, max_descendants/3)), pool, setCoinsRet, nValueRet, bnb_used, nCoinType)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, max_ancestors/2, max_descendants/2), pool, setCoinsRet, nValueRet, bnb_used, nCoinType)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, max_ancestors-1, max_descendants-1), pool, setCoinsRet, nValueRet, bnb_used, nCoinType)) ||
+        (bSpendZeroConfChange && !fRejectLongChains && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, CoinEligibilityFilter(0, 1, std::numeric_limits<uint64_t>::max()), pool, setCoinsRet, nValueRet, bnb_used, nCoinType));
 
     // because SelectCoinsMinConf clears the setCoinsRet, we now add the possible inputs to the coinset
     setCoinsRet.insert(setPresetCoins.begin(), setPresetCoins.end());
@@ -3336,7 +3815,7 @@ bool CWallet::SelectTxDSInsByDenomination(int nDenom, CAmount nValueMax, std::ve
 
     CCoinControl coin_control;
     coin_control.nCoinType = CoinType::ONLY_READY_TO_MIX;
-    AvailableCoins(vCoins, true, &coin_control);
+    AvailableCoins(vCoins, true, &coin_control, nDenomAmount, nDenomAmount);
     LogPrint(BCLog::COINJOIN, "CWallet::%s -- vCoins.size(): %d\n", __func__, vCoins.size());
 
     Shuffle(vCoins.rbegin(), vCoins.rend(), FastRandomContext());
@@ -3389,52 +3868,55 @@ bool CWallet::SelectCoinsGroupedByAddresses(std::vector<CompactTallyItem>& vecTa
 
     // Tally
     std::map<CTxDestination, CompactTallyItem> mapTally;
-    std::set<uint256> setWalletTxesCounted;
+    const CWalletTx* pwtx = nullptr;
+    bool fSkipTx = false;
     for (const auto& outpoint : setWalletUTXO) {
+        // The outpoints are sorted, the checks of a transaction are done for its first unspent output only
+        if (pwtx == nullptr || pwtx->GetHash() != outpoint.hash) {
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) {
+                pwtx = nullptr;
+                continue;
+            }
+            pwtx = &(*it).second;
+            fSkipTx = (pwtx->IsCoinBase() && pwtx->GetBlocksToMaturity() > 0) ||
+                      (fSkipUnconfirmed && !pwtx->IsTrusted()) ||
+                      pwtx->GetDepthInMainChain() < 0;
+        }
+        if (fSkipTx) continue;
 
-        if (!setWalletTxesCounted.emplace(outpoint.hash).second) continue;
-
-        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
-        if (it == mapWallet.end()) continue;
-
-        const CWalletTx& wtx = (*it).second;
-
-        if(wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
-        if(fSkipUnconfirmed && !wtx.IsTrusted()) continue;
-        if (wtx.GetDepthInMainChain() < 0) continue;
-
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
-            CTxDestination txdest;
-            if (!ExtractDestination(wtx.tx->vout[i].scriptPubKey, txdest)) continue;
+        const CWalletTx& wtx = *pwtx;
+        const unsigned int i = outpoint.n;
+        CTxDestination txdest;
+        if (!ExtractDestination(wtx.tx->vout[i].scriptPubKey, txdest)) continue;
 
-            isminefilter mine = ::IsMine(*this, txdest);
-            if(!(mine & filter)) continue;
+        isminefilter mine = ::IsMine(*this, txdest);
+        if(!(mine & filter)) continue;
 
-            auto itTallyItem = mapTally.find(txdest);
-            if (nMaxOupointsPerAddress != -1 && itTallyItem != mapTally.end() && itTallyItem->second.vecInputCoins.size() >= nMaxOupointsPerAddress) continue;
+        auto itTallyItem = mapTally.find(txdest);
+        if (nMaxOupointsPerAddress != -1 && itTallyItem != mapTally.end() && itTallyItem->second.vecInputCoins.size() >= nMaxOupointsPerAddress) continue;
 
-            if(IsSpent(outpoint.hash, i) || IsLockedCoin(outpoint.hash, i)) continue;
+        if(IsSpent(outpoint.hash, i) || IsLockedCoin(outpoint.hash, i)) continue;
 
-            if(fSkipDenominated && CCoinJoin::IsDenominatedAmount(wtx.tx->vout[i].nValue)) continue;
+        if(fSkipDenominated && CCoinJoin::IsDenominatedAmount(wtx.tx->vout[i].nValue)) continue;
 
-            if(fAnonymizable) {
-                // ignore collaterals
-                if(CCoinJoin::IsCollateralAmount(wtx.tx->vout[i].nValue)) continue;
-                if(fMasternodeMode && wtx.tx->vout[i].nValue == 1000*COIN) continue;
-                // ignore outputs that are 10 times smaller then the smallest denomination
-                // otherwise they will just lead to higher fee / lower priority
-                if(wtx.tx->vout[i].nValue <= nSmallestDenom/10) continue;
-                // ignore mixed
-                if (IsFullyMixed(COutPoint(outpoint.hash, i))) continue;
-            }
+        if(fAnonymizable) {
+            // ignore collaterals
+            if(CCoinJoin::IsCollateralAmount(wtx.tx->vout[i].nValue)) continue;
+            if(fMasternodeMode && wtx.tx->vout[i].nValue == 1000*COIN) continue;
+            // ignore outputs that are 10 times smaller then the smallest denomination
+            // otherwise they will just lead to higher fee / lower priority
+            if(wtx.tx->vout[i].nValue <= nSmallestDenom/10) continue;
+            // ignore mixed
+            if (IsFullyMixed(COutPoint(outpoint.hash, i))) continue;
+        }
 
-            if (itTallyItem == mapTally.end()) {
-                itTallyItem = mapTally.emplace(txdest, CompactTallyItem()).first;
-                itTallyItem->second.txdest = txdest;
-            }
-            itTallyItem->second.nAmount += wtx.tx->vout[i].nValue;
-            itTallyItem->second.vecInputCoins.emplace_back(wtx.tx, i);
+        if (itTallyItem == mapTally.end()) {
+            itTallyItem = mapTally.emplace(txdest, CompactTallyItem()).first;
+            itTallyItem->second.txdest = txdest;
         }
+        itTallyItem->second.nAmount += wtx.tx->vout[i].nValue;
+        itTallyItem->second.vecInputCoins.emplace_back(wtx.tx, i);
     }
 
     // construct resulting vector
@@ -3478,14 +3960,15 @@ bool CWallet::SelectDenominatedAmounts(CAmount nValueMax, std::set<CAmount>& set
     std::vector<COutput> vCoins;
     CCoinControl coin_control;
     coin_control.nCoinType = CoinType::ONLY_READY_TO_MIX;
-    AvailableCoins(vCoins, true, &coin_control);
-    // larger denoms first
-    std::sort(vCoins.rbegin(), vCoins.rend(), CompareByPriority());
 
-    for (const auto& out : vCoins) {
-        CAmount nValue = out.tx->tx->vout[out.i].nValue;
-        if (nValueTotal + nValue <= nValueMax) {
-            nValueTotal += nValue;
+    // larger denoms first, only as many coins of each denomination are looked up as still fit
+    for (auto it = mapWalletUTXOByDenomination.rbegin(); it != mapWalletUTXOByDenomination.rend(); ++it) {
+        CAmount nValue = it->first;
+        if (nValueTotal + nValue > nValueMax) continue;
+        uint64_t nMaxCount = (nValueMax - nValueTotal) / nValue;
+        AvailableCoins(vCoins, true, &coin_control, nValue, nValue, MAX_MONEY, nMaxCount);
+        if (!vCoins.empty()) {
+            nValueTotal += nValue * vCoins.size();
             setAmountsRet.emplace(nValue);
         }
     }
@@ -3499,7 +3982,13 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount) const
 
     LOCK2(cs_main, cs_wallet);
 
-    for (const auto& outpoint : setWalletUTXO) {
+    const std::set<COutPoint>* pSetUTXO = &setWalletUTXO;
+    if (CCoinJoin::IsDenominatedAmount(nInputAmount)) {
+        const auto it = mapWalletUTXOByDenomination.find(nInputAmount);
+        if (it == mapWalletUTXOByDenomination.end()) return 0;
+        pSetUTXO = &it->second;
+    }
+    for (const auto& outpoint : *pSetUTXO) {
         const auto it = mapWallet.find(outpoint.hash);
         if (it == mapWallet.end()) continue;
         if (it->second.tx->vout[outpoint.n].nValue != nInputAmount) continue;
@@ -4088,7 +4577,7 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
         for (auto& pair : mapWallet) {
             for(unsigned int i = 0; i < pair.second.tx->vout.size(); ++i) {
                 if (IsMine(pair.second.tx->vout[i]) && !IsSpent(pair.first, i)) {
-                    setWalletUTXO.insert(COutPoint(pair.first, i));
+                    AddWalletUTXO(COutPoint(pair.first, i), pair.second.tx->vout[i].nValue);
                 }
             }
         }
@@ -4320,19 +4809,11 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         } else {
             nTargetSize *= 2;
         }
-        bool fInternal = false;
         WalletBatch batch(*database);
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            if (i < missingInternal) {
-                fInternal = true;
-            }
-
+        auto addToKeyPool = [&](const CPubKey& pubkey, bool fInternal) {
             assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
             int64_t index = ++m_max_keypool_index;
 
-            // TODO: implement keypools for all accounts?
-            CPubKey pubkey(GenerateNewKey(batch, 0, fInternal));
             if (!batch.WritePool(index, CKeyPool(pubkey, fInternal))) {
                 throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
             }
@@ -4344,15 +4825,43 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             }
 
             m_pool_key_to_index[pubkey.GetID()] = index;
-            if (missingInternal + missingExternal > 0) {
-                LogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n",
-                          missingInternal + missingExternal, missingInternal,
-                          setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size());
-            }
 
             double dProgress = 100.f * index / (nTargetSize + 1);
             std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
             uiInterface.InitMessage(strMsg);
+        };
+
+        if (IsHDEnabled()) {
+            // derive the missing keys of each chain at once and write all of them in one database transaction
+            if (!batch.TxnBegin()) {
+                throw std::runtime_error(std::string(__func__) + ": TxnBegin failed");
+            }
+            CKeyMetadata metadata(GetTime());
+            for (bool fInternal : {false, true}) {
+                int64_t nMissing = fInternal ? missingInternal : missingExternal;
+                if (nMissing == 0) {
+                    continue;
+                }
+                // TODO: implement keypools for all accounts?
+                std::vector<CPubKey> vecPubKeys;
+                DeriveNewChildKeys(batch, metadata, 0, fInternal, nMissing, vecPubKeys);
+                for (const CPubKey& pubkey : vecPubKeys) {
+                    addToKeyPool(pubkey, fInternal);
+                }
+            }
+            if (!batch.TxnCommit()) {
+                throw std::runtime_error(std::string(__func__) + ": TxnCommit failed");
+            }
+        } else {
+            for (int64_t i = missingExternal; i--;) {
+                addToKeyPool(GenerateNewKey(batch, 0, false), false);
+            }
+        }
+
+        if (missingInternal + missingExternal > 0) {
+            LogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n",
+                      missingInternal + missingExternal, missingInternal,
+                      setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size());
         }
     }
     return true;
@@ -4723,6 +5232,10 @@ void CWallet::UnlockCoin(const COutPoint& output)
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
+    for (const COutPoint& output : setLockedCoins) {
+        std::map<uint256, CWalletTx>::iterator it = mapWallet.find(output.hash);
+        if (it != mapWallet.end()) it->second.MarkDirty(); // recalculate all credits for this tx
+    }
     setLockedCoins.clear();
 }
 
@@ -5158,7 +5671,7 @@ std::shared_ptr<CWallet> CWallet::CreateWalletFromFile(const WalletLocation& loc
         //We can't rescan beyond non-pruned blocks, stop and throw an error
         //this might happen if a user uses an old wallet within a pruned node
         // or if he ran -disablewallet for a longer time, then decided to re-enable
-        if (fPruneMode)
+        if (fPruneMode || fSnapshotChainstate)
         {
             CBlockIndex *block = chainActive.Tip();
             while (block && block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA) && block->pprev->nTx > 0 && pindexRescan != block)
@@ -5321,6 +5834,22 @@ bool CWallet::AutoBackupWallet(const fs::path& wallet_path, std::string& strBack
             nWalletBackups = -2;
             return false;
         }
+    } else if (IsLevelDBWallet(wallet_path)) {
+        // ... LevelDB wallet, which can be copied while it is open
+        fs::path backupFile = backupsDir / (strWalletName + dateTimeStr);
+        backupFile.make_preferred();
+        if (fs::exists(backupFile))
+        {
+            strBackupWarningRet = _("Failed to create backup, file already exists! This could happen if you restarted wallet in less than 60 seconds. You can continue if you are ok with this.");
+            LogPrintf("%s\n", strBackupWarningRet);
+            return false;
+        }
+        if (fs::exists(wallet_path / LEVELDB_WALLET_DIR) && !database->Backup(backupFile.string())) {
+            strBackupWarningRet = strprintf(_("Failed to create backup %s!"), backupFile.string());
+            LogPrintf("%s\n", strBackupWarningRet);
+            nWalletBackups = -1;
+            return false;
+        }
     } else {
         // ... strWalletName file
         std::string strSourceFile;
@@ -5356,8 +5885,8 @@ bool CWallet::AutoBackupWallet(const fs::path& wallet_path, std::string& strBack
     fs::path currentFile;
     for (fs::directory_iterator dir_iter(backupsDir); dir_iter != end_iter; ++dir_iter)
     {
-        // Only check regular files
-        if ( fs::is_regular_file(dir_iter->status()))
+        // Only check regular files and the directories of LevelDB wallets
+        if (fs::is_regular_file(dir_iter->status()) || fs::is_directory(dir_iter->path() / LEVELDB_WALLET_DIR))
         {
             currentFile = dir_iter->path().filename();
             // Only add the backups for the current wallet, e.g. wallet.dat.*
@@ -5376,7 +5905,7 @@ bool CWallet::AutoBackupWallet(const fs::path& wallet_path, std::string& strBack
         {
             // More than nWalletBackups backups: delete oldest one(s)
             try {
-                fs::remove(file.second);
+                fs::remove_all(file.second);
                 LogPrintf("Old backup deleted: %s\n", file.second);
             } catch(fs::filesystem_error &error) {
                 strBackupWarningRet = strprintf(_("Failed to delete backup, error: %s"), error.what());
@@ -5389,28 +5918,76 @@ bool CWallet::AutoBackupWallet(const fs::path& wallet_path, std::string& strBack
     return true;
 }
 
-void CWallet::NotifyTransactionLock(const CTransactionRef &tx, const std::shared_ptr<const llmq::CInstantSendLock>& islock)
+void CWallet::ScheduleLockEvents()
 {
-    LOCK(cs_wallet);
-    // Only notify UI if this transaction is in this wallet
-    uint256 txHash = tx->GetHash();
-    std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txHash);
-    if (mi != mapWallet.end()){
-        NotifyTransactionChanged(this, txHash, CT_UPDATED);
-        NotifyISLockReceived();
-        // notify an external script
-        std::string strCmd = gArgs.GetArg("-instantsendnotify", "");
-        if (!strCmd.empty()) {
-            boost::replace_all(strCmd, "%s", txHash.GetHex());
-            std::thread t(runCommand, strCmd);
-            t.detach(); // thread runs free
+    AssertLockHeld(lockEventQueue->cs);
+    if (lockEventQueue->fScheduled) return;
+
+    lockEventQueue->fScheduled = true;
+    std::shared_ptr<LockEventQueue> queue = lockEventQueue;
+    CallFunctionInValidationInterfaceQueue([queue] {
+        // Keeps the wallet from being deleted while its events are processed
+        LOCK(queue->cs);
+        queue->fScheduled = false;
+        std::vector<CTransactionRef> vecLockedTxs;
+        std::swap(vecLockedTxs, queue->vecLockedTxs);
+        const CBlockIndex* pindexChainLock = queue->pindexChainLock;
+        queue->pindexChainLock = nullptr;
+        if (queue->pwallet != nullptr) {
+            queue->pwallet->ProcessLockEvents(vecLockedTxs, pindexChainLock);
+        }
+    });
+}
+
+void CWallet::ProcessLockEvents(const std::vector<CTransactionRef>& vecLockedTxs, const CBlockIndex* pindexChainLock)
+{
+    std::vector<uint256> vecWalletTxHashes;
+    {
+        LOCK(cs_wallet);
+        // Only notify UI if this transaction is in this wallet
+        for (const auto& tx : vecLockedTxs) {
+            const uint256& txHash = tx->GetHash();
+            if (mapWallet.count(txHash)) {
+                // the transaction is trusted now
+                MarkTxBalancesDirty(txHash);
+                vecWalletTxHashes.push_back(txHash);
+            }
         }
     }
+
+    if (!vecWalletTxHashes.empty()) {
+        const std::string strCmd = gArgs.GetArg("-instantsendnotify", "");
+        for (const uint256& txHash : vecWalletTxHashes) {
+            NotifyTransactionChanged(this, txHash, CT_UPDATED);
+            // notify an external script
+            if (!strCmd.empty()) {
+                std::string strTxCmd = strCmd;
+                boost::replace_all(strTxCmd, "%s", txHash.GetHex());
+                std::thread t(runCommand, strTxCmd);
+                t.detach(); // thread runs free
+            }
+        }
+        NotifyISLockReceived();
+    }
+
+    // ChainLocks don't change the balances, only confirmed transactions can be chainlocked and they are trusted already
+    if (pindexChainLock != nullptr) {
+        NotifyChainLockReceived(pindexChainLock->nHeight);
+    }
+}
+
+void CWallet::NotifyTransactionLock(const CTransactionRef &tx, const std::shared_ptr<const llmq::CInstantSendLock>& islock)
+{
+    LOCK(lockEventQueue->cs);
+    lockEventQueue->vecLockedTxs.push_back(tx);
+    ScheduleLockEvents();
 }
 
 void CWallet::NotifyChainLock(const CBlockIndex* pindexChainLock, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
 {
-    NotifyChainLockReceived(pindexChainLock->nHeight);
+    LOCK(lockEventQueue->cs);
+    lockEventQueue->pindexChainLock = pindexChainLock;
+    ScheduleLockEvents();
 }
 
 bool CWallet::LoadGovernanceObject(const CGovernanceObject& obj)
@@ -442,21 +442,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fAnonymizedCreditCached = false;
-        fDenomUnconfCreditCached = false;
-        fDenomConfCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -705,6 +691,34 @@ struct CoinEligibilityFilter
     CoinEligibilityFilter(int conf_mine, int conf_theirs, uint64_t max_ancestors, uint64_t max_descendants) : conf_mine(conf_mine), conf_theirs(conf_theirs), max_ancestors(max_ancestors), max_descendants(max_descendants) {}
 };
 
+/**
+ * The coins that SelectCoinsMinConf chooses from, prepared once for all the eligibility filters that SelectCoins
+ * tries: their CInputCoins and everything that is needed to check their eligibility. With BnB the effective values
+ * and fees of the coins are calculated, coins with no positive effective value are left out and the rest is sorted
+ * by descending effective value, so that the pool of each filter is already sorted.
+ */
+struct CoinSelectionPool
+{
+    struct Entry
+    {
+        CInputCoin coin;
+        bool fSpendable;
+        int nDepth;
+        bool fFromMe;
+        bool fLockedByIS;
+        size_t ancestors;
+        size_t descendants;
+
+        explicit Entry(const COutput& output);
+        bool IsEligible(const CoinEligibilityFilter& eligibility_filter) const;
+    };
+
+    std::vector<Entry> vEntries;
+    bool use_bnb{false};
+    CAmount cost_of_change{0};
+    CAmount not_input_fees{0};
+};
+
 class WalletRescanReserver; //forward declarations for ScanForWalletTransactions/RescanFromTime
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
@@ -757,7 +771,83 @@ private:
     void AddToSpends(const uint256& wtxid);
 
     std::set<COutPoint> setWalletUTXO;
+    // The outpoints of setWalletUTXO with denominated and with collateral amounts, so that coins of these types
+    // can be found without going through all unspent outputs
+    std::set<COutPoint> setWalletUTXODenominated;
+    std::set<COutPoint> setWalletUTXOCollateral;
+    // The outpoints of setWalletUTXODenominated by denominated amount
+    std::map<CAmount, std::set<COutPoint>> mapWalletUTXOByDenomination;
+    bool AddWalletUTXO(const COutPoint& outpoint, const CAmount nValue) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    void EraseWalletUTXO(const COutPoint& outpoint) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /* Add our outputs that a transaction spends back to the wallet UTXOs if it no longer spends them (e.g. because it was abandoned or conflicted) */
+    void AddSpentWalletUTXOs(const CWalletTx& wtx) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
     mutable std::map<COutPoint, int> mapOutpointRoundsCache;
+    void WriteCoinJoinRounds(const COutPoint& outpoint, int nRounds) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /* Forget the CoinJoin rounds of all outpoints, they have to be computed again when the transactions or keys that they depend on might have changed */
+    void ClearCoinJoinRoundsCache() EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /**
+     * The balances which are shown all the time. They are kept up to date incrementally: the part of every
+     * transaction with unspent outputs is stored, and only the transactions that were marked dirty since
+     * (CWalletTx::MarkDirty) are calculated again, as well as the ones whose part depends on the chain or the
+     * mempool (unconfirmed, immature or non-final ones, and the ones they spend) when the tip or the mempool
+     * changed. All of them are calculated again when fBalancesCached was reset (CWallet::MarkDirty) or when the
+     * CoinJoin settings changed.
+     */
+    struct Balances
+    {
+        CAmount nBalance{0};
+        CAmount nUnconfirmedBalance{0};
+        CAmount nImmatureBalance{0};
+        CAmount nWatchOnlyBalance{0};
+        CAmount nUnconfirmedWatchOnlyBalance{0};
+        CAmount nImmatureWatchOnlyBalance{0};
+        CAmount nAnonymizedBalance{0};
+        CAmount nDenominatedBalance{0};
+        CAmount nDenominatedUnconfirmedBalance{0};
+
+        Balances& operator+=(const Balances& other);
+        Balances& operator-=(const Balances& other);
+    };
+    struct CachedBalances : public Balances
+    {
+        const CBlockIndex* pindexTip{nullptr};
+        unsigned int nMempoolTransactionsUpdated{0};
+        bool fCoinJoinEnabled{false};
+        int nCoinJoinRounds{0};
+    };
+    mutable bool fBalancesCached = false;
+    mutable CachedBalances cachedBalances;
+    // The part of each transaction in cachedBalances
+    mutable std::map<uint256, Balances> mapTxBalances;
+    // Transactions of which the part has to be calculated again
+    mutable std::set<uint256> setBalancesDirtyTxs;
+    // Transactions of which the part depends on the chain or the mempool
+    mutable std::set<uint256> setBalancesVolatileTxs;
+    const CachedBalances& GetCachedBalances() const EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_wallet);
+    void AddTxBalances(const CWalletTx& wtx) const EXCLUSIVE_LOCKS_REQUIRED(cs_main, cs_wallet);
+    bool HasWalletUTXO(const uint256& hash) const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+
+    /**
+     * InstantSend locks and ChainLocks which were received but not processed yet. The validation interface callbacks
+     * only add them here, the first one also adds ProcessLockEvents to the validation interface queue, so that all
+     * of them which arrived in the meantime are processed together with cs_wallet locked only once. The queue is
+     * shared with the callback, which does nothing once the wallet is gone.
+     */
+    struct LockEventQueue
+    {
+        CCriticalSection cs;
+        CWallet* pwallet GUARDED_BY(cs);
+        std::vector<CTransactionRef> vecLockedTxs GUARDED_BY(cs);
+        // Only the most recent ChainLock is of interest
+        const CBlockIndex* pindexChainLock GUARDED_BY(cs){nullptr};
+        bool fScheduled GUARDED_BY(cs){false};
+
+        explicit LockEventQueue(CWallet* pwalletIn) : pwallet(pwalletIn) {}
+    };
+    const std::shared_ptr<LockEventQueue> lockEventQueue{std::make_shared<LockEventQueue>(this)};
+    void ScheduleLockEvents() EXCLUSIVE_LOCKS_REQUIRED(lockEventQueue->cs);
+    void ProcessLockEvents(const std::vector<CTransactionRef>& vecLockedTxs, const CBlockIndex* pindexChainLock);
 
     /* Mark a transaction (and its in-wallet descendants) as conflicting with a particular block. */
     void MarkConflicted(const uint256& hashBlock, const uint256& hashTx);
@@ -768,8 +858,8 @@ private:
      * Should be called with pindexBlock and posInBlock if this is for a transaction that is included in a block. */
     void SyncTransaction(const CTransactionRef& tx, const CBlockIndex *pindex = nullptr, int posInBlock = 0) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
-    /* HD derive new child key (on internal or external chain) */
-    void DeriveNewChildKey(WalletBatch &batch, const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
+    /* HD derive nCount new child keys (on internal or external chain), in parallel if there are many of them */
+    void DeriveNewChildKeys(WalletBatch &batch, const CKeyMetadata& metadata, uint32_t nAccountIndex, bool fInternal, size_t nCount, std::vector<CPubKey>& vecPubKeysRet) EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool;
@@ -799,6 +889,9 @@ private:
     // the next block comes in
     uint256 hashPrevBestCoinbase;
 
+    /** The number of keys and scripts of the wallet, which grows when they are added */
+    size_t GetKeyStoreSize() const;
+
     // A helper function which loops through wallet UTXOs
     std::unordered_set<const CWalletTx*, WalletTxHasher> GetSpendableTXs() const EXCLUSIVE_LOCKS_REQUIRED(cs_wallet);
 
@@ -868,6 +961,10 @@ public:
 
     ~CWallet()
     {
+        {
+            LOCK(lockEventQueue->cs);
+            lockEventQueue->pwallet = nullptr;
+        }
         delete encrypted_batch;
         encrypted_batch = nullptr;
     }
@@ -917,6 +1014,8 @@ public:
      * assembled
      */
     bool SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, std::vector<COutput> vCoins, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CoinSelectionParams& coin_selection_params, bool& bnb_used, CoinType nCoinType = CoinType::ALL_COINS) const;
+    void MakeCoinSelectionPool(const std::vector<COutput>& vCoins, const CoinSelectionParams& coin_selection_params, CoinSelectionPool& poolRet) const;
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, const CoinEligibilityFilter& eligibility_filter, const CoinSelectionPool& pool, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, bool& bnb_used, CoinType nCoinType = CoinType::ALL_COINS) const;
 
     // Coin selection
     bool SelectTxDSInsByDenomination(int nDenom, CAmount nValueMax, std::vector<CTxDSIn>& vecTxDSInRet);
@@ -927,8 +1026,10 @@ public:
     bool HasCollateralInputs(bool fOnlyConfirmed = true) const;
     int  CountInputsWithAmount(CAmount nInputAmount) const;
 
-    // get the CoinJoin chain depth for a given input
+    // get the CoinJoin chain depth for a given input, the results are stored in the wallet database
     int GetRealOutpointCoinJoinRounds(const COutPoint& outpoint, int nRounds = 0) const;
+    //! Adds the CoinJoin rounds of an outpoint to the cache, used by LoadWallet
+    void LoadCoinJoinRounds(const COutPoint& outpoint, int nRounds, int nRoundsMax);
     // respect current settings
     int GetCappedOutpointCoinJoinRounds(const COutPoint& outpoint) const;
 
@@ -1026,6 +1127,8 @@ public:
     bool GetLabelDestination(CTxDestination &dest, const std::string& label, bool bForceNew = false);
 
     void MarkDirty();
+    /** The part of a transaction in the cached balances has to be calculated again, called by CWalletTx::MarkDirty */
+    void MarkTxBalancesDirty(const uint256& hash) const;
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
     void TransactionAddedToMempool(const CTransactionRef& tx, int64_t nAcceptTime) override;
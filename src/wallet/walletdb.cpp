@@ -16,10 +16,15 @@
 #include <sync.h>
 #include <util.h>
 #include <utiltime.h>
+#include <wallet/leveldb.h>
 #include <wallet/wallet.h>
 #include <validation.h>
 
 #include <atomic>
+#include <deque>
+#include <future>
+
+#include <ctpl.h>
 
 #include <boost/thread.hpp>
 
@@ -129,8 +134,8 @@ bool WalletBatch::WriteBestBlock(const CBlockLocator& locator)
 
 bool WalletBatch::ReadBestBlock(CBlockLocator& locator)
 {
-    if (m_batch.Read(std::string("bestblock"), locator) && !locator.vHave.empty()) return true;
-    return m_batch.Read(std::string("bestblock_nomerkle"), locator);
+    if (m_batch->Read(std::string("bestblock"), locator) && !locator.vHave.empty()) return true;
+    return m_batch->Read(std::string("bestblock_nomerkle"), locator);
 }
 
 bool WalletBatch::WriteOrderPosNext(int64_t nOrderPosNext)
@@ -140,7 +145,7 @@ bool WalletBatch::WriteOrderPosNext(int64_t nOrderPosNext)
 
 bool WalletBatch::ReadPool(int64_t nPool, CKeyPool& keypool)
 {
-    return m_batch.Read(std::make_pair(std::string("pool"), nPool), keypool);
+    return m_batch->Read(std::make_pair(std::string("pool"), nPool), keypool);
 }
 
 bool WalletBatch::WritePool(int64_t nPool, const CKeyPool& keypool)
@@ -161,7 +166,7 @@ bool WalletBatch::WriteMinVersion(int nVersion)
 bool WalletBatch::ReadAccount(const std::string& strAccount, CAccount& account)
 {
     account.SetNull();
-    return m_batch.Read(std::make_pair(std::string("acc"), strAccount), account);
+    return m_batch->Read(std::make_pair(std::string("acc"), strAccount), account);
 }
 
 bool WalletBatch::WriteAccount(const std::string& strAccount, const CAccount& account)
@@ -182,7 +187,7 @@ bool WalletBatch::WriteAccountingEntry(const uint64_t nAccEntryNum, const CAccou
 bool WalletBatch::ReadCoinJoinSalt(uint256& salt, bool fLegacy)
 {
     // TODO: Remove legacy checks after few major releases
-    return m_batch.Read(std::string(fLegacy ? "ps_salt" : "cj_salt"), salt);
+    return m_batch->Read(std::string(fLegacy ? "ps_salt" : "cj_salt"), salt);
 }
 
 bool WalletBatch::WriteCoinJoinSalt(const uint256& salt)
@@ -190,6 +195,16 @@ bool WalletBatch::WriteCoinJoinSalt(const uint256& salt)
     return WriteIC(std::string("cj_salt"), salt);
 }
 
+bool WalletBatch::WriteCoinJoinRounds(const COutPoint& outpoint, int nRounds, int nRoundsMax)
+{
+    return WriteIC(std::make_pair(std::string("cj_rounds"), outpoint), std::make_pair(nRounds, nRoundsMax));
+}
+
+bool WalletBatch::EraseCoinJoinRounds(const COutPoint& outpoint)
+{
+    return EraseIC(std::make_pair(std::string("cj_rounds"), outpoint));
+}
+
 bool WalletBatch::WriteGovernanceObject(const CGovernanceObject& obj)
 {
     return WriteIC(std::make_pair(std::string("gobject"), obj.GetHash()), obj, false);
@@ -211,24 +226,22 @@ void WalletBatch::ListAccountCreditDebit(const std::string& strAccount, std::lis
 {
     bool fAllAccounts = (strAccount == "*");
 
-    Dbc* pcursor = m_batch.GetCursor();
-    if (!pcursor)
+    CDataStream ssSeekKey(SER_DISK, CLIENT_VERSION);
+    ssSeekKey << std::make_pair(std::string("acentry"), std::make_pair((fAllAccounts ? std::string("") : strAccount), uint64_t(0)));
+    if (!m_batch->StartCursor(ssSeekKey))
         throw std::runtime_error(std::string(__func__) + ": cannot create DB cursor");
-    bool setRange = true;
     while (true)
     {
         // Read next record
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        if (setRange)
-            ssKey << std::make_pair(std::string("acentry"), std::make_pair((fAllAccounts ? std::string("") : strAccount), uint64_t(0)));
         CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        int ret = m_batch.ReadAtCursor(pcursor, ssKey, ssValue, setRange);
-        setRange = false;
-        if (ret == DB_NOTFOUND)
+        bool fComplete;
+        bool ret = m_batch->ReadAtCursor(ssKey, ssValue, fComplete);
+        if (fComplete)
             break;
-        else if (ret != 0)
+        else if (!ret)
         {
-            pcursor->close();
+            m_batch->CloseCursor();
             throw std::runtime_error(std::string(__func__) + ": error scanning DB");
         }
 
@@ -247,7 +260,7 @@ void WalletBatch::ListAccountCreditDebit(const std::string& strAccount, std::lis
         entries.push_back(acentry);
     }
 
-    pcursor->close();
+    m_batch->CloseCursor();
 }
 
 class CWalletScanState {
@@ -271,15 +284,128 @@ public:
     }
 };
 
-bool
-ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
-             CWalletScanState &wss, std::string& strType, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+/** Decode a "tx" record, this doesn't use the wallet so it can be done on any thread */
+static bool DecodeTxRecord(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgradedRet, std::string& strErr)
+{
+    uint256 hash;
+    ssKey >> hash;
+    ssValue >> wtx;
+    CValidationState state;
+    if (!(CheckTransaction(*wtx.tx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+        return false;
+
+    fUpgradedRet = false;
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        fUpgradedRet = true;
+    }
+    return true;
+}
+
+static void LoadTxRecord(CWallet* pwallet, const CWalletTx& wtx, bool fUpgraded, CWalletScanState& wss) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    if (fUpgraded)
+        wss.vWalletUpgrade.push_back(wtx.GetHash());
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+
+    pwallet->LoadToWallet(wtx);
+}
+
+/** Decode a "key" or "wkey" record, this doesn't use the wallet so it can be done on any thread */
+static bool DecodeKeyRecord(const std::string& strType, CDataStream& ssKey, CDataStream& ssValue, CPubKey& vchPubKey, CKey& key, std::string& strErr)
+{
+    ssKey >> vchPubKey;
+    if (!vchPubKey.IsValid())
+    {
+        strErr = "Error reading wallet database: CPubKey corrupt";
+        return false;
+    }
+    CPrivKey pkey;
+    uint256 hash;
+
+    if (strType == "key")
+    {
+        ssValue >> pkey;
+    } else {
+        CWalletKey wkey;
+        ssValue >> wkey;
+        pkey = wkey.vchPrivKey;
+    }
+
+    // Old wallets store keys as "key" [pubkey] => [privkey]
+    // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
+    // using EC operations as a checksum.
+    // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
+    // remaining backwards-compatible.
+    try
+    {
+        ssValue >> hash;
+    }
+    catch (...) {}
+
+    bool fSkipCheck = false;
+
+    if (!hash.IsNull())
+    {
+        // hash pubkey/privkey to accelerate wallet load
+        std::vector<unsigned char> vchKey;
+        vchKey.reserve(vchPubKey.size() + pkey.size());
+        vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
+        vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
+
+        if (Hash(vchKey.begin(), vchKey.end()) != hash)
+        {
+            strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
+            return false;
+        }
+
+        fSkipCheck = true;
+    }
+
+    if (!key.Load(pkey, vchPubKey, fSkipCheck))
+    {
+        strErr = "Error reading wallet database: CPrivKey corrupt";
+        return false;
+    }
+    return true;
+}
+
+static bool LoadKeyRecord(CWallet* pwallet, const std::string& strType, const CPubKey& vchPubKey, const CKey& key, CWalletScanState& wss, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    if (strType == "key")
+        wss.nKeys++;
+
+    if (!pwallet->LoadKey(key, vchPubKey))
+    {
+        strErr = "Error reading wallet database: LoadKey failed";
+        return false;
+    }
+    return true;
+}
+
+/** Load a record of which the type was already read from ssKey */
+static bool
+ReadValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
+          CWalletScanState &wss, const std::string& strType, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
 {
     try {
-        // Unserialize
-        // Taking advantage of the fact that pair serialization
-        // is just the two items serialized one after the other
-        ssKey >> strType;
         if (strType == "name")
         {
             std::string strAddress;
@@ -294,38 +420,11 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "tx")
         {
-            uint256 hash;
-            ssKey >> hash;
             CWalletTx wtx(nullptr /* pwallet */, MakeTransactionRef());
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(*wtx.tx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            bool fUpgraded;
+            if (!DecodeTxRecord(ssKey, ssValue, wtx, fUpgraded, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->LoadToWallet(wtx);
+            LoadTxRecord(pwallet, wtx, fUpgraded, wss);
         }
         else if (strType == "acentry")
         {
@@ -358,66 +457,11 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         else if (strType == "key" || strType == "wkey")
         {
             CPubKey vchPubKey;
-            ssKey >> vchPubKey;
-            if (!vchPubKey.IsValid())
-            {
-                strErr = "Error reading wallet database: CPubKey corrupt";
-                return false;
-            }
             CKey key;
-            CPrivKey pkey;
-            uint256 hash;
-
-            if (strType == "key")
-            {
-                wss.nKeys++;
-                ssValue >> pkey;
-            } else {
-                CWalletKey wkey;
-                ssValue >> wkey;
-                pkey = wkey.vchPrivKey;
-            }
-
-            // Old wallets store keys as "key" [pubkey] => [privkey]
-            // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
-            // using EC operations as a checksum.
-            // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
-            // remaining backwards-compatible.
-            try
-            {
-                ssValue >> hash;
-            }
-            catch (...) {}
-
-            bool fSkipCheck = false;
-
-            if (!hash.IsNull())
-            {
-                // hash pubkey/privkey to accelerate wallet load
-                std::vector<unsigned char> vchKey;
-                vchKey.reserve(vchPubKey.size() + pkey.size());
-                vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
-                vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
-
-                if (Hash(vchKey.begin(), vchKey.end()) != hash)
-                {
-                    strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
-                    return false;
-                }
-
-                fSkipCheck = true;
-            }
-
-            if (!key.Load(pkey, vchPubKey, fSkipCheck))
-            {
-                strErr = "Error reading wallet database: CPrivKey corrupt";
+            if (!DecodeKeyRecord(strType, ssKey, ssValue, vchPubKey, key, strErr))
                 return false;
-            }
-            if (!pwallet->LoadKey(key, vchPubKey))
-            {
-                strErr = "Error reading wallet database: LoadKey failed";
+            if (!LoadKeyRecord(pwallet, strType, vchPubKey, key, wss, strErr))
                 return false;
-            }
         }
         else if (strType == "mkey")
         {
@@ -579,6 +623,12 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
                 strErr = "Invalid governance object: LoadGovernanceObject";
                 return false;
             }
+        } else if (strType == "cj_rounds") {
+            COutPoint outpoint;
+            std::pair<int, int> value;
+            ssKey >> outpoint;
+            ssValue >> value;
+            pwallet->LoadCoinJoinRounds(outpoint, value.first, value.second);
         }
         else if (strType != "bestblock" && strType != "bestblock_nomerkle"){
             wss.m_unknown_records++;
@@ -590,6 +640,59 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
     return true;
 }
 
+bool
+ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
+             CWalletScanState &wss, std::string& strType, std::string& strErr) EXCLUSIVE_LOCKS_REQUIRED(pwallet->cs_wallet)
+{
+    try {
+        // Unserialize
+        // Taking advantage of the fact that pair serialization
+        // is just the two items serialized one after the other
+        ssKey >> strType;
+    } catch (...)
+    {
+        return false;
+    }
+    return ReadValue(pwallet, ssKey, ssValue, wss, strType, strErr);
+}
+
+/** Transactions and keys are decoded on up to MAX_WALLET_LOAD_THREADS threads, in chunks of WALLET_LOAD_CHUNK_SIZE records */
+static const int MAX_WALLET_LOAD_THREADS = 4;
+static const size_t WALLET_LOAD_CHUNK_SIZE = 1000;
+
+namespace {
+/** A "tx", "key" or "wkey" record, which is decoded on a worker thread before it's loaded */
+struct DecodedWalletRecord
+{
+    CDataStream ssKey;
+    CDataStream ssValue;
+    std::string strType;
+
+    bool fOk{false};
+    std::string strErr;
+    CWalletTx wtx{nullptr /* pwallet */, MakeTransactionRef()};
+    bool fUpgraded{false};
+    CPubKey vchPubKey;
+    CKey key;
+
+    DecodedWalletRecord(CDataStream&& ssKeyIn, CDataStream&& ssValueIn, const std::string& strTypeIn) :
+        ssKey(std::move(ssKeyIn)), ssValue(std::move(ssValueIn)), strType(strTypeIn) {}
+
+    void Decode()
+    {
+        try {
+            if (strType == "tx") {
+                fOk = DecodeTxRecord(ssKey, ssValue, wtx, fUpgraded, strErr);
+            } else {
+                fOk = DecodeKeyRecord(strType, ssKey, ssValue, vchPubKey, key, strErr);
+            }
+        } catch (...) {
+            fOk = false;
+        }
+    }
+};
+} // namespace
+
 bool WalletBatch::IsKeyType(const std::string& strType)
 {
     return (strType== "key" || strType == "wkey" ||
@@ -606,7 +709,7 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
     LOCK2(cs_main, pwallet->cs_wallet);
     try {
         int nMinVersion = 0;
-        if (m_batch.Read((std::string)"minversion", nMinVersion))
+        if (m_batch->Read((std::string)"minversion", nMinVersion))
         {
             if (nMinVersion > FEATURE_LATEST)
                 return DBErrors::TOO_NEW;
@@ -614,30 +717,15 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
         }
 
         // Get cursor
-        Dbc* pcursor = m_batch.GetCursor();
-        if (!pcursor)
+        if (!m_batch->StartCursor())
         {
             LogPrintf("Error getting wallet database cursor\n");
             return DBErrors::CORRUPT;
         }
 
-        while (true)
-        {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = m_batch.ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0)
-            {
-                LogPrintf("Error reading next record from wallet database\n");
-                return DBErrors::CORRUPT;
-            }
-
-            // Try to be tolerant of single corrupt records:
-            std::string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
+        // Try to be tolerant of single corrupt records:
+        auto checkRecord = [&](bool fOk, const std::string& strType, const std::string& strErr) {
+            if (!fOk)
             {
                 // losing keys is considered a catastrophic error, anything else
                 // we assume the user can live with:
@@ -654,8 +742,88 @@ DBErrors WalletBatch::LoadWallet(CWallet* pwallet)
             }
             if (!strErr.empty())
                 LogPrintf("%s\n", strErr);
+        };
+
+        // Transactions and keys are decoded on the worker threads while the following records are read, they
+        // are loaded in the order of the database like all other records, which are loaded on this thread
+        typedef std::vector<DecodedWalletRecord> RecordChunk;
+        int nThreads = std::max(1, std::min(GetNumCores(), MAX_WALLET_LOAD_THREADS));
+        ctpl::thread_pool pool(nThreads);
+        std::deque<std::pair<std::shared_ptr<RecordChunk>, std::future<void>>> queueChunks;
+        auto chunk = std::make_shared<RecordChunk>();
+
+        auto decodeChunk = [&]() {
+            if (chunk->empty())
+                return;
+            auto chunkDecode = chunk;
+            queueChunks.emplace_back(chunk, pool.push([chunkDecode](int) {
+                for (DecodedWalletRecord& record : *chunkDecode) {
+                    record.Decode();
+                }
+            }));
+            chunk = std::make_shared<RecordChunk>();
+        };
+        auto loadChunk = [&]() {
+            queueChunks.front().second.get();
+            for (DecodedWalletRecord& record : *queueChunks.front().first) {
+                bool fOk = record.fOk;
+                if (fOk && record.strType == "tx") {
+                    LoadTxRecord(pwallet, record.wtx, record.fUpgraded, wss);
+                } else if (fOk) {
+                    fOk = LoadKeyRecord(pwallet, record.strType, record.vchPubKey, record.key, wss, record.strErr);
+                }
+                checkRecord(fOk, record.strType, record.strErr);
+            }
+            queueChunks.pop_front();
+        };
+        auto loadDecodedRecords = [&]() {
+            decodeChunk();
+            while (!queueChunks.empty()) {
+                loadChunk();
+            }
+        };
+
+        while (true)
+        {
+            // Read next record
+            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            bool fComplete;
+            bool ret = m_batch->ReadAtCursor(ssKey, ssValue, fComplete);
+            if (fComplete)
+                break;
+            else if (!ret)
+            {
+                m_batch->CloseCursor();
+                LogPrintf("Error reading next record from wallet database\n");
+                return DBErrors::CORRUPT;
+            }
+
+            std::string strType, strErr;
+            try {
+                ssKey >> strType;
+            } catch (...) {
+                checkRecord(false, strType, strErr);
+                continue;
+            }
+
+            if (strType == "tx" || strType == "key" || strType == "wkey") {
+                chunk->emplace_back(std::move(ssKey), std::move(ssValue), strType);
+                if (chunk->size() >= WALLET_LOAD_CHUNK_SIZE) {
+                    decodeChunk();
+                    // don't read too far ahead of the records that are loaded
+                    if (queueChunks.size() > (size_t)nThreads * 2) {
+                        loadChunk();
+                    }
+                }
+                continue;
+            }
+
+            loadDecodedRecords();
+            checkRecord(ReadValue(pwallet, ssKey, ssValue, wss, strType, strErr), strType, strErr);
         }
-        pcursor->close();
+        loadDecodedRecords();
+        m_batch->CloseCursor();
 
         // Store initial external keypool size since we mostly use external keys in mixing
         pwallet->nKeysLeftSinceAutoBackup = pwallet->KeypoolCountExternalKeys();
@@ -714,15 +882,14 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
 
     try {
         int nMinVersion = 0;
-        if (m_batch.Read((std::string)"minversion", nMinVersion))
+        if (m_batch->Read((std::string)"minversion", nMinVersion))
         {
             if (nMinVersion > FEATURE_LATEST)
                 return DBErrors::TOO_NEW;
         }
 
         // Get cursor
-        Dbc* pcursor = m_batch.GetCursor();
-        if (!pcursor)
+        if (!m_batch->StartCursor())
         {
             LogPrintf("Error getting wallet database cursor\n");
             return DBErrors::CORRUPT;
@@ -733,11 +900,13 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
             CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = m_batch.ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
+            bool fComplete;
+            bool ret = m_batch->ReadAtCursor(ssKey, ssValue, fComplete);
+            if (fComplete)
                 break;
-            else if (ret != 0)
+            else if (!ret)
             {
+                m_batch->CloseCursor();
                 LogPrintf("Error reading next record from wallet database\n");
                 return DBErrors::CORRUPT;
             }
@@ -755,7 +924,7 @@ DBErrors WalletBatch::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CW
                 vWtx.push_back(wtx);
             }
         }
-        pcursor->close();
+        m_batch->CloseCursor();
     }
     catch (const boost::thread_interrupted&) {
         throw;
@@ -843,7 +1012,7 @@ void MaybeCompactWalletDB()
         }
 
         if (dbh.nLastFlushed != nUpdateCounter && GetTime() - dbh.nLastWalletUpdate >= 2) {
-            if (BerkeleyBatch::PeriodicFlush(dbh)) {
+            if (dbh.PeriodicFlush()) {
                 dbh.nLastFlushed = nUpdateCounter;
             }
         }
@@ -857,6 +1026,9 @@ void MaybeCompactWalletDB()
 //
 bool WalletBatch::Recover(const fs::path& wallet_path, void *callbackDataIn, bool (*recoverKVcallback)(void* callbackData, CDataStream ssKey, CDataStream ssValue), std::string& out_backup_filename)
 {
+    if (IsLevelDBWallet(wallet_path)) {
+        return LevelDBDatabase::Recover(wallet_path, callbackDataIn, recoverKVcallback, out_backup_filename);
+    }
     return BerkeleyBatch::Recover(wallet_path, callbackDataIn, recoverKVcallback, out_backup_filename);
 }
 
@@ -892,11 +1064,18 @@ bool WalletBatch::RecoverKeysOnlyFilter(void *callbackData, CDataStream ssKey, C
 
 bool WalletBatch::VerifyEnvironment(const fs::path& wallet_path, std::string& errorStr)
 {
+    if (IsLevelDBWallet(wallet_path)) {
+        return LevelDBDatabase::VerifyEnvironment(wallet_path, errorStr);
+    }
     return BerkeleyBatch::VerifyEnvironment(wallet_path, errorStr);
 }
 
 bool WalletBatch::VerifyDatabaseFile(const fs::path& wallet_path, std::string& warningStr, std::string& errorStr)
 {
+    if (IsLevelDBWallet(wallet_path)) {
+        // LevelDB recovers from its log by itself when the database is opened
+        return true;
+    }
     return BerkeleyBatch::VerifyDatabaseFile(wallet_path, warningStr, errorStr, WalletBatch::Recover);
 }
 
@@ -935,25 +1114,25 @@ bool WalletBatch::WriteHDPubKey(const CHDPubKey& hdPubKey, const CKeyMetadata& k
 
 bool WalletBatch::TxnBegin()
 {
-    return m_batch.TxnBegin();
+    return m_batch->TxnBegin();
 }
 
 bool WalletBatch::TxnCommit()
 {
-    return m_batch.TxnCommit();
+    return m_batch->TxnCommit();
 }
 
 bool WalletBatch::TxnAbort()
 {
-    return m_batch.TxnAbort();
+    return m_batch->TxnAbort();
 }
 
 bool WalletBatch::ReadVersion(int& nVersion)
 {
-    return m_batch.ReadVersion(nVersion);
+    return m_batch->ReadVersion(nVersion);
 }
 
 bool WalletBatch::WriteVersion(int nVersion)
 {
-    return m_batch.WriteVersion(nVersion);
+    return m_batch->WriteVersion(nVersion);
 }
@@ -22,11 +22,14 @@
  *
  * - WalletBatch is an abstract modifier object for the wallet database, and encapsulates a database
  *   batch update as well as methods to act on the database. It should be agnostic to the database implementation.
+ * - WalletDatabase represents a wallet database and DatabaseBatch is a low-level database batch update, they
+ *   are implemented by the storage engines.
  *
  * The following classes are implementation specific:
  * - BerkeleyEnvironment is an environment in which the database exists.
  * - BerkeleyDatabase represents a wallet database.
  * - BerkeleyBatch is a low-level database batch update.
+ * - LevelDBDatabase and LevelDBBatch are their counterparts for wallets stored in LevelDB.
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
@@ -37,15 +40,13 @@ struct CBlockLocator;
 class CGovernanceObject;
 class CKeyPool;
 class CMasterKey;
+class COutPoint;
 class CScript;
 class CWallet;
 class CWalletTx;
 class uint160;
 class uint256;
 
-/** Backend-agnostic database type. */
-using WalletDatabase = BerkeleyDatabase;
-
 /** Error statuses for the wallet database */
 enum class DBErrors
 {
@@ -100,7 +101,7 @@ private:
     template <typename K, typename T>
     bool WriteIC(const K& key, const T& value, bool fOverwrite = true)
     {
-        if (!m_batch.Write(key, value, fOverwrite)) {
+        if (!m_batch->Write(key, value, fOverwrite)) {
             return false;
         }
         m_database.IncrementUpdateCounter();
@@ -110,7 +111,7 @@ private:
     template <typename K>
     bool EraseIC(const K& key)
     {
-        if (!m_batch.Erase(key)) {
+        if (!m_batch->Erase(key)) {
             return false;
         }
         m_database.IncrementUpdateCounter();
@@ -119,7 +120,7 @@ private:
 
 public:
     explicit WalletBatch(WalletDatabase& database, const char* pszMode = "r+", bool _fFlushOnClose = true) :
-        m_batch(database, pszMode, _fFlushOnClose),
+        m_batch(database.MakeBatch(pszMode, _fFlushOnClose)),
         m_database(database)
     {
     }
@@ -167,6 +168,10 @@ public:
     bool ReadCoinJoinSalt(uint256& salt, bool fLegacy = false);
     bool WriteCoinJoinSalt(const uint256& salt);
 
+    /** Write the CoinJoin rounds of an outpoint, computed with at most nRoundsMax rounds */
+    bool WriteCoinJoinRounds(const COutPoint& outpoint, int nRounds, int nRoundsMax);
+    bool EraseCoinJoinRounds(const COutPoint& outpoint);
+
     /** Write a CGovernanceObject to the database */
     bool WriteGovernanceObject(const CGovernanceObject& obj);
 
@@ -211,7 +216,7 @@ public:
     //! Write wallet version
     bool WriteVersion(int nVersion);
 private:
-    BerkeleyBatch m_batch;
+    std::unique_ptr<DatabaseBatch> m_batch;
     WalletDatabase& m_database;
 };
 
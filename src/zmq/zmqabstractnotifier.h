@@ -7,6 +7,9 @@
 
 #include <zmq/zmqconfig.h>
 
+#include <memory>
+#include <vector>
+
 class CBlockIndex;
 class CGovernanceObject;
 class CGovernanceVote;
@@ -20,10 +23,16 @@ namespace llmq {
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
+/** A serialized message body, which is handed to ZMQ without being copied and shared by all notifiers that send it */
+typedef std::shared_ptr<const std::vector<unsigned char>> CZMQSharedBuffer;
+
+/** Default for -zmqpub<type>hwm, the number of messages queued for each subscriber before new ones are dropped */
+static const int DEFAULT_ZMQ_SNDHWM = 1000;
+
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(nullptr) { }
+    CZMQAbstractNotifier() : psocket(nullptr), outbound_message_high_water_mark(DEFAULT_ZMQ_SNDHWM) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -36,12 +45,19 @@ public:
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    int GetOutboundMessageHighWaterMark() const { return outbound_message_high_water_mark; }
+    void SetOutboundMessageHighWaterMark(const int sndhwm) {
+        if (sndhwm >= 0) {
+            outbound_message_high_water_mark = sndhwm;
+        }
+    }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
-    virtual bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig);
+    // rawBlock is the serialized block of pindex if it is at hand, it is null otherwise
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const CZMQSharedBuffer& rawBlock);
+    virtual bool NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig, const CZMQSharedBuffer& rawBlock);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransactionRef& transaction, const std::shared_ptr<const llmq::CInstantSendLock>& islock);
     virtual bool NotifyGovernanceVote(const std::shared_ptr<const CGovernanceVote>& vote);
@@ -53,6 +69,7 @@ protected:
     void *psocket;
     std::string type;
     std::string address;
+    int outbound_message_high_water_mark; // aka SNDHWM
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
@@ -31,6 +31,7 @@ CZMQNotificationInterface::~CZMQNotificationInterface()
 
 std::list<const CZMQAbstractNotifier*> CZMQNotificationInterface::GetActiveNotifiers() const
 {
+    LOCK(cs_notifiers);
     std::list<const CZMQAbstractNotifier*> result;
     for (const auto* n : notifiers) {
         result.push_back(n);
@@ -73,6 +74,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
             CZMQAbstractNotifier *notifier = factory();
             notifier->SetType(entry.first);
             notifier->SetAddress(address);
+            notifier->SetOutboundMessageHighWaterMark(static_cast<int>(gArgs.GetArg(arg + "hwm", DEFAULT_ZMQ_SNDHWM)));
             notifiers.push_back(notifier);
         }
     }
@@ -81,6 +83,14 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     {
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
+        notificationInterface->nMaxQueueSize = std::max<int64_t>(1, gArgs.GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE));
+        notificationInterface->fBlockWhenFull = gArgs.GetBoolArg("-zmqqueueblock", DEFAULT_ZMQ_QUEUE_BLOCK);
+        for (const auto* notifier : notifiers) {
+            const std::string& type = notifier->GetType();
+            if (type == "pubrawblock" || type == "pubrawchainlock" || type == "pubrawchainlocksig") {
+                notificationInterface->fRawBlockNotifiers = true;
+            }
+        }
 
         if (!notificationInterface->Initialize())
         {
@@ -126,6 +136,12 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    {
+        std::unique_lock<std::mutex> lock(cs_queue);
+        fRunning = true;
+    }
+    threadZMQ = std::thread(&TraceThread<std::function<void()> >, "zmq", std::function<void()>(std::bind(&CZMQNotificationInterface::ThreadZMQ, this)));
+
     return true;
 }
 
@@ -133,8 +149,21 @@ bool CZMQNotificationInterface::Initialize()
 void CZMQNotificationInterface::Shutdown()
 {
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
+    {
+        // Notifications still in the queue are dropped
+        std::unique_lock<std::mutex> lock(cs_queue);
+        fRunning = false;
+        queue.clear();
+    }
+    condQueue.notify_all();
+    condQueueFull.notify_all();
+    if (threadZMQ.joinable()) {
+        threadZMQ.join();
+    }
+
     if (pcontext)
     {
+        LOCK(cs_notifiers);
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -147,155 +176,193 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+void CZMQNotificationInterface::Enqueue(std::function<void()>&& func)
 {
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+    std::unique_lock<std::mutex> lock(cs_queue);
+    if (queue.size() >= nMaxQueueSize && fRunning) {
+        if (!fBlockWhenFull) {
+            // Subscribers can't tell from the sequence numbers, these never got one
+            if (nDropped++ == 0) {
+                LogPrintf("zmq: Notification queue is full (%u), dropping notifications\n", nMaxQueueSize);
+            }
+            return;
+        }
+        condQueueFull.wait(lock, [this] { return queue.size() < nMaxQueueSize || !fRunning; });
+    }
+    if (!fRunning) {
         return;
+    }
+    queue.emplace_back(GetTimeMicros(), std::move(func));
+    condQueue.notify_one();
+}
 
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
-        {
-            i++;
-        }
-        else
+void CZMQNotificationInterface::ThreadZMQ()
+{
+    while (true) {
+        std::function<void()> func;
         {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+            std::unique_lock<std::mutex> lock(cs_queue);
+            condQueue.wait(lock, [this] { return !queue.empty() || !fRunning; });
+            if (!fRunning) {
+                return;
+            }
+            func = std::move(queue.front().second);
+            queue.pop_front();
         }
+        condQueueFull.notify_one();
+        func();
     }
 }
 
-void CZMQNotificationInterface::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
+void CZMQNotificationInterface::GetQueueStats(size_t& nSize, int64_t& nLagMicros, uint64_t& nDropped) const
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyChainLock(pindex, clsig))
-        {
-            i++;
-        }
-        else
-        {
+    std::unique_lock<std::mutex> lock(cs_queue);
+    nSize = queue.size();
+    nLagMicros = queue.empty() ? 0 : GetTimeMicros() - queue.front().first;
+    nDropped = this->nDropped;
+}
+
+CZMQSharedBuffer CZMQNotificationInterface::GetRawBlock(const CBlockIndex* pindex)
+{
+    if (!fRawBlockNotifiers) {
+        return nullptr;
+    }
+    if (m_last_connected_block && m_last_connected_index == pindex) {
+        // Serialize it once for all notifiers that publish it, they share the buffer
+        CPooledDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << *m_last_connected_block;
+        m_raw_block = std::make_shared<const std::vector<unsigned char>>(ss.begin(), ss.end());
+        m_raw_block_index = pindex;
+        m_last_connected_block.reset();
+        m_last_connected_index = nullptr;
+    }
+    if (m_raw_block && m_raw_block_index == pindex) {
+        return m_raw_block;
+    }
+    return nullptr;
+}
+
+template <typename Function>
+void CZMQNotificationInterface::TryForEachAndRemoveFailed(const Function& func)
+{
+    LOCK(cs_notifiers);
+    for (auto it = notifiers.begin(); it != notifiers.end();) {
+        CZMQAbstractNotifier* notifier = *it;
+        if (func(notifier)) {
+            ++it;
+        } else {
             notifier->Shutdown();
-            i = notifiers.erase(i);
+            it = notifiers.erase(it);
         }
     }
 }
 
-void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime)
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    Enqueue([this, pindexNew] {
+        const CZMQSharedBuffer rawBlock = GetRawBlock(pindexNew);
+        TryForEachAndRemoveFailed([pindexNew, &rawBlock](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyBlock(pindexNew, rawBlock);
+        });
+    });
+}
+
+void CZMQNotificationInterface::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
+{
+    Enqueue([this, pindex, clsig] {
+        // Usually the tip is locked, which was published already and is reused from then
+        const CZMQSharedBuffer rawBlock = GetRawBlock(pindex);
+        TryForEachAndRemoveFailed([pindex, &clsig, &rawBlock](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyChainLock(pindex, clsig, rawBlock);
+        });
+    });
+}
+
+void CZMQNotificationInterface::NotifyTransaction(const CTransactionRef& ptx)
 {
-    // Used by BlockConnected and BlockDisconnected as well, because they're
-    // all the same external callback.
     const CTransaction& tx = *ptx;
+    TryForEachAndRemoveFailed([&tx](CZMQAbstractNotifier* notifier) {
+        return notifier->NotifyTransaction(tx);
+    });
+}
 
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx, int64_t nAcceptTime)
+{
+    Enqueue([this, ptx] {
+        NotifyTransaction(ptx);
+    });
 }
 
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
 {
-    for (const CTransactionRef& ptx : pblock->vtx) {
-        // Do a normal notify for each transaction added in the block
-        TransactionAddedToMempool(ptx, 0);
-    }
+    Enqueue([this, pblock, pindexConnected] {
+        if (fRawBlockNotifiers) {
+            // Keep the block so it is serialized from memory instead of being read from disk when it becomes the tip
+            m_last_connected_block = pblock;
+            m_last_connected_index = pindexConnected;
+        }
+
+        for (const CTransactionRef& ptx : pblock->vtx) {
+            // Do a normal notify for each transaction added in the block
+            NotifyTransaction(ptx);
+        }
+    });
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexDisconnected)
 {
-    for (const CTransactionRef& ptx : pblock->vtx) {
-        // Do a normal notify for each transaction removed in block disconnection
-        TransactionAddedToMempool(ptx, 0);
-    }
+    Enqueue([this, pblock] {
+        for (const CTransactionRef& ptx : pblock->vtx) {
+            // Do a normal notify for each transaction removed in block disconnection
+            NotifyTransaction(ptx);
+        }
+    });
 }
 
 void CZMQNotificationInterface::NotifyTransactionLock(const CTransactionRef& tx, const std::shared_ptr<const llmq::CInstantSendLock>& islock)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransactionLock(tx, islock))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    Enqueue([this, tx, islock] {
+        TryForEachAndRemoveFailed([&tx, &islock](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyTransactionLock(tx, islock);
+        });
+    });
 }
 
 void CZMQNotificationInterface::NotifyGovernanceVote(const std::shared_ptr<const CGovernanceVote> &vote)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i != notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyGovernanceVote(vote))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    Enqueue([this, vote] {
+        TryForEachAndRemoveFailed([&vote](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyGovernanceVote(vote);
+        });
+    });
 }
 
 void CZMQNotificationInterface::NotifyGovernanceObject(const std::shared_ptr<const CGovernanceObject> &object)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i != notifiers.end(); )
-    {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyGovernanceObject(object))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
-    }
+    Enqueue([this, object] {
+        TryForEachAndRemoveFailed([&object](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyGovernanceObject(object);
+        });
+    });
 }
 
 void CZMQNotificationInterface::NotifyInstantSendDoubleSpendAttempt(const CTransactionRef& currentTx, const CTransactionRef& previousTx)
 {
-    for (auto it = notifiers.begin(); it != notifiers.end();) {
-        CZMQAbstractNotifier *notifier = *it;
-        if (notifier->NotifyInstantSendDoubleSpendAttempt(currentTx, previousTx)) {
-            ++it;
-        } else {
-            notifier->Shutdown();
-            it = notifiers.erase(it);
-        }
-    }
+    Enqueue([this, currentTx, previousTx] {
+        TryForEachAndRemoveFailed([&currentTx, &previousTx](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyInstantSendDoubleSpendAttempt(currentTx, previousTx);
+        });
+    });
 }
 
 void CZMQNotificationInterface::NotifyRecoveredSig(const std::shared_ptr<const llmq::CRecoveredSig>& sig)
 {
-    for (auto it = notifiers.begin(); it != notifiers.end();) {
-        CZMQAbstractNotifier *notifier = *it;
-        if (notifier->NotifyRecoveredSig(sig)) {
-            ++it;
-        } else {
-            notifier->Shutdown();
-            it = notifiers.erase(it);
-        }
-    }
+    Enqueue([this, sig] {
+        TryForEachAndRemoveFailed([&sig](CZMQAbstractNotifier* notifier) {
+            return notifier->NotifyRecoveredSig(sig);
+        });
+    });
 }
-
-CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
@@ -5,14 +5,32 @@
 #ifndef BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
+#include <sync.h>
 #include <validationinterface.h>
-#include <string>
-#include <map>
+#include <zmq/zmqabstractnotifier.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+/** Default for -zmqqueuesize, the number of notifications waiting to be published */
+static const unsigned int DEFAULT_ZMQ_QUEUE_SIZE = 10000;
+/** Default for -zmqqueueblock, whether the callbacks wait for space in a full queue instead of dropping notifications */
+static const bool DEFAULT_ZMQ_QUEUE_BLOCK = false;
+
+/**
+ * Publishes the notifications of the validation interface on a thread of its own. The callbacks only queue them, so
+ * the scheduler thread (which is shared with the wallet and the LLMQ listeners) is never held up by ZMQ.
+ */
 class CZMQNotificationInterface final : public CValidationInterface
 {
 public:
@@ -20,6 +38,9 @@ public:
 
     std::list<const CZMQAbstractNotifier*> GetActiveNotifiers() const;
 
+    /** Number of queued notifications, how long the oldest one waits already and how many were dropped in total */
+    void GetQueueStats(size_t& nSize, int64_t& nLagMicros, uint64_t& nDropped) const;
+
     static CZMQNotificationInterface* Create();
 
 protected:
@@ -41,8 +62,39 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    /** Queue a notification, which is published by ThreadZMQ */
+    void Enqueue(std::function<void()>&& func);
+    void ThreadZMQ();
+
+    template <typename Function>
+    void TryForEachAndRemoveFailed(const Function& func);
+    void NotifyTransaction(const CTransactionRef& ptx);
+
+    /** The serialized block of pindex, from the last connected block if it's that one, null if it's not at hand */
+    CZMQSharedBuffer GetRawBlock(const CBlockIndex* pindex);
+
     void *pcontext;
+    mutable CCriticalSection cs_notifiers;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    mutable std::mutex cs_queue;
+    std::condition_variable condQueue;
+    std::condition_variable condQueueFull;
+    // Notifications with the time they were queued at
+    std::deque<std::pair<int64_t, std::function<void()>>> queue;
+    size_t nMaxQueueSize{DEFAULT_ZMQ_QUEUE_SIZE};
+    bool fBlockWhenFull{DEFAULT_ZMQ_QUEUE_BLOCK};
+    bool fRunning{false};
+    std::atomic<uint64_t> nDropped{0};
+    std::thread threadZMQ;
+
+    // Whether any notifier publishes raw blocks, only then the last connected block is kept
+    bool fRawBlockNotifiers{false};
+    // These are only used by the notifications, which are all published in order by ThreadZMQ
+    std::shared_ptr<const CBlock> m_last_connected_block;
+    const CBlockIndex* m_last_connected_index{nullptr};
+    const CBlockIndex* m_raw_block_index{nullptr};
+    CZMQSharedBuffer m_raw_block;
 };
 
 extern CZMQNotificationInterface* g_zmq_notification_interface;
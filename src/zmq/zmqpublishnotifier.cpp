@@ -30,6 +30,62 @@ static const char *MSG_RAWGOBJ       = "rawgovernanceobject";
 static const char *MSG_RAWISCON      = "rawinstantsenddoublespend";
 static const char *MSG_RAWRECSIG     = "rawrecoveredsig";
 
+// Internal function to send one part of a multipart message, closes msg
+static int zmq_send_part(void *sock, zmq_msg_t* msg, bool more)
+{
+    // Never block the caller (the validation thread) on a slow subscriber
+    int rc = zmq_msg_send(msg, sock, ZMQ_DONTWAIT | (more ? ZMQ_SNDMORE : 0));
+    if (rc == -1)
+    {
+        zmqError("Unable to send ZMQ msg");
+        zmq_msg_close(msg);
+        return -1;
+    }
+    zmq_msg_close(msg);
+    return 0;
+}
+
+// Internal function to send one part of a multipart message, copies the data
+static int zmq_send_copied_part(void *sock, const void* data, size_t size, bool more)
+{
+    zmq_msg_t msg;
+
+    int rc = zmq_msg_init_size(&msg, size);
+    if (rc != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
+    }
+
+    void *buf = zmq_msg_data(&msg);
+    memcpy(buf, data, size);
+
+    return zmq_send_part(sock, &msg, more);
+}
+
+static void zmq_free_shared_buffer(void* /*data*/, void* hint)
+{
+    delete static_cast<CZMQSharedBuffer*>(hint);
+}
+
+// Internal function to send one part of a multipart message, the data is referenced by the message instead of being copied
+static int zmq_send_shared_part(void *sock, const CZMQSharedBuffer& data, bool more)
+{
+    zmq_msg_t msg;
+
+    // The message holds a reference to the buffer until ZMQ is done with it, which may be after this returned
+    CZMQSharedBuffer* hint = new CZMQSharedBuffer(data);
+    int rc = zmq_msg_init_data(&msg, const_cast<unsigned char*>(data->data()), data->size(), zmq_free_shared_buffer, hint);
+    if (rc != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        delete hint;
+        return -1;
+    }
+
+    return zmq_send_part(sock, &msg, more);
+}
+
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 {
@@ -38,32 +94,15 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 
     while (1)
     {
-        zmq_msg_t msg;
-
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
-        {
-            zmqError("Unable to initialize ZMQ msg");
-            va_end(args);
-            return -1;
-        }
-
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
-
+        const void* part = data;
         data = va_arg(args, const void*);
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1)
+        if (zmq_send_copied_part(sock, part, size, data != nullptr) == -1)
         {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
             va_end(args);
             return -1;
         }
 
-        zmq_msg_close(&msg);
-
         if (!data)
             break;
 
@@ -73,6 +112,24 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+// The serialized block of pindex, read from disk if the caller doesn't have it already
+static CZMQSharedBuffer GetRawBlock(const CBlockIndex* pindex, const CZMQSharedBuffer& rawBlock)
+{
+    if (rawBlock) {
+        return rawBlock;
+    }
+
+    auto block = std::make_shared<std::vector<unsigned char>>();
+    {
+        LOCK(cs_main);
+        if (!ReadRawBlockFromDisk(*block, pindex, Params().MessageStart())) {
+            zmqError("Can't read block from disk");
+            return nullptr;
+        }
+    }
+    return block;
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -89,7 +146,17 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        // Messages for a subscriber beyond the high water mark are dropped, a PUB socket never blocks
+        LogPrint(BCLog::ZMQ, "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, outbound_message_high_water_mark);
+
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &outbound_message_high_water_mark, sizeof(outbound_message_high_water_mark));
+        if (rc != 0) {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -104,6 +171,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
     else
     {
         LogPrint(BCLog::ZMQ, "zmq: Reusing socket for address %s\n", address);
+        LogPrint(BCLog::ZMQ, "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, i->second->outbound_message_high_water_mark);
 
         psocket = i->second->psocket;
         mapPublishNotifiers.insert(std::make_pair(address, this));
@@ -159,7 +227,25 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const CZMQSharedBuffer& data)
+{
+    assert(psocket);
+
+    /* send the same three parts as above, only the data isn't copied */
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nSequence);
+    if (zmq_send_copied_part(psocket, command, strlen(command), true) == -1 ||
+        zmq_send_shared_part(psocket, data, true) == -1 ||
+        zmq_send_copied_part(psocket, msgseq, sizeof(uint32_t), false) == -1)
+        return false;
+
+    /* increment memory only sequence number after sending */
+    nSequence++;
+
+    return true;
+}
+
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const CZMQSharedBuffer& /*rawBlock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashblock %s\n", hash.GetHex());
@@ -169,7 +255,7 @@ bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
     return SendMessage(MSG_HASHBLOCK, data, 32);
 }
 
-bool CZMQPublishHashChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
+bool CZMQPublishHashChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig, const CZMQSharedBuffer& /*rawBlock*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish hashchainlock %s\n", hash.GetHex());
@@ -241,67 +327,44 @@ bool CZMQPublishHashRecoveredSigNotifier::NotifyRecoveredSig(const std::shared_p
     return SendMessage(MSG_HASHRECSIG, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const CZMQSharedBuffer& rawBlock)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
+    CZMQSharedBuffer block = GetRawBlock(pindex, rawBlock);
+    if (!block) {
+        return false;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWBLOCK, block);
 }
 
-bool CZMQPublishRawChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
+bool CZMQPublishRawChainLockNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig, const CZMQSharedBuffer& rawBlock)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawchainlock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
+    CZMQSharedBuffer block = GetRawBlock(pindex, rawBlock);
+    if (!block) {
+        return false;
     }
 
-    return SendMessage(MSG_RAWCHAINLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWCHAINLOCK, block);
 }
 
-bool CZMQPublishRawChainLockSigNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig)
+bool CZMQPublishRawChainLockSigNotifier::NotifyChainLock(const CBlockIndex *pindex, const std::shared_ptr<const llmq::CChainLockSig>& clsig, const CZMQSharedBuffer& rawBlock)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawchainlocksig %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
-        ss << *clsig;
+    CZMQSharedBuffer block = GetRawBlock(pindex, rawBlock);
+    if (!block) {
+        return false;
     }
 
+    CPooledDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.reserve(block->size() + ::GetSerializeSize(*clsig, SER_NETWORK, PROTOCOL_VERSION));
+    ss.write((const char*)block->data(), block->size());
+    ss << *clsig;
+
     return SendMessage(MSG_RAWCLSIG, &(*ss.begin()), ss.size());
 }
 
@@ -309,7 +372,7 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
 {
     uint256 hash = transaction.GetHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtx %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CPooledDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
@@ -318,7 +381,7 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
 {
     uint256 hash = transaction->GetHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtxlock %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CPooledDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *transaction;
     return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
 }
@@ -327,7 +390,7 @@ bool CZMQPublishRawTransactionLockSigNotifier::NotifyTransactionLock(const CTran
 {
     uint256 hash = transaction->GetHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish rawtxlocksig %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CPooledDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *transaction;
     ss << *islock;
     return SendMessage(MSG_RAWTXLOCKSIG, &(*ss.begin()), ss.size());
@@ -337,7 +400,7 @@ bool CZMQPublishRawGovernanceVoteNotifier::NotifyGovernanceVote(const std::share
 {
     uint256 nHash = vote->GetHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish rawgovernanceobject: hash = %s, vote = %d\n", nHash.ToString(), vote->ToString());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CPooledDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *vote;
     return SendMessage(MSG_RAWGVOTE, &(*ss.begin()), ss.size());
 }
@@ -346,7 +409,7 @@ bool CZMQPublishRawGovernanceObjectNotifier::NotifyGovernanceObject(const std::s
 {
     uint256 nHash = govobj->GetHash();
     LogPrint(BCLog::ZMQ, "zmq: Publish rawgovernanceobject: hash = %s, type = %d\n", nHash.ToString(), govobj->GetObjectType());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CPooledDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *govobj;
     return SendMessage(MSG_RAWGOBJ, &(*ss.begin()), ss.size());
 }
@@ -354,7 +417,7 @@ bool CZMQPublishRawGovernanceObjectNotifier::NotifyGovernanceObject(const std::s
 bool CZMQPublishRawInstantSendDoubleSpendNotifier::NotifyInstantSendDoubleSpendAttempt(const CTransactionRef& currentTx, const CTransactionRef& previousTx)
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawinstantsenddoublespend %s conflicts with %s\n", currentTx->GetHash().ToString(), previousTx->GetHash().ToString());
-    CDataStream ssCurrent(SER_NETWORK, PROTOCOL_VERSION), ssPrevious(SER_NETWORK, PROTOCOL_VERSION);
+    CPooledDataStream ssCurrent(SER_NETWORK, PROTOCOL_VERSION), ssPrevious(SER_NETWORK, PROTOCOL_VERSION);
     ssCurrent << *currentTx;
     ssPrevious << *previousTx;
     return SendMessage(MSG_RAWISCON, &(*ssCurrent.begin()), ssCurrent.size())
@@ -365,7 +428,7 @@ bool CZMQPublishRawRecoveredSigNotifier::NotifyRecoveredSig(const std::shared_pt
 {
     LogPrint(BCLog::ZMQ, "zmq: Publish rawrecoveredsig %s\n", sig->msgHash.ToString());
 
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    CPooledDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     ss << *sig;
 
     return SendMessage(MSG_RAWRECSIG, &(*ss.begin()), ss.size());
@@ -125,6 +125,14 @@ class LLMQSigningTest(DashTestFramework):
         assert(not node.quorum("verify", 100, id, msgHashConflict, recsig["sig"], recsig["quorumHash"]))
         assert_raises_rpc_error(-8, "quorum not found", node.quorum, "verify", 100, id, msgHash, recsig["sig"], hash_bad)
 
+        # Test the batch rpcs, invalid entries must not affect the valid ones
+        batch = [{"id": id, "msgHash": msgHash, "signature": recsig["sig"]},
+                 {"id": id, "msgHash": msgHashConflict, "signature": recsig["sig"]}]
+        assert_equal(node.quorum("verifybatch", 100, batch), [True, False])
+        assert_equal(node.quorum("verifybatch", 100, batch, height_bad), [False, False])
+        recsigs = node.quorum("getrecsigbatch", 100, [{"id": id, "msgHash": msgHash}, {"id": id, "msgHash": msgHashConflict}])
+        assert_equal(recsigs, [recsig, None])
+
         # Mine one more quorum, so that we have 2 active ones, nothing should change
         self.mine_quorum()
         assert_sigs_nochange(True, False, True, 3)
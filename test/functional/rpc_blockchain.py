@@ -51,7 +51,7 @@ class BlockchainTest(BitcoinTestFramework):
         self.num_nodes = 1
         self.setup_clean_chain = True
         self.stderr = sys.stdout
-        self.extra_args = [['-stopatheight=207', '-prune=1', '-txindex=0']]
+        self.extra_args = [['-stopatheight=207', '-prune=1', '-txindex=0', '-rpcblockcache=2']]
 
     def run_test(self):
         # Have to prepare the chain manually here.
@@ -65,6 +65,7 @@ class BlockchainTest(BitcoinTestFramework):
         self._test_getchaintxstats()
         self._test_gettxoutsetinfo()
         self._test_getblockheader()
+        self._test_getblock()
         self._test_getdifficulty()
         self._test_getnetworkhashps()
         self._test_stopatheight()
@@ -235,6 +236,17 @@ class BlockchainTest(BitcoinTestFramework):
         assert isinstance(int(header['versionHex'], 16), int)
         assert isinstance(header['difficulty'], Decimal)
 
+    def _test_getblock(self):
+        self.log.info("Test getblock with the decoded transactions cached")
+        node = self.nodes[0]
+        hashes = [node.getblockhash(h) for h in range(195, 201)]
+        for blockhash in hashes + hashes:
+            block = node.getblock(blockhash, 1)
+            block_verbose = node.getblock(blockhash, 2)
+            assert_equal([tx['txid'] for tx in block_verbose['tx']], block['tx'])
+            assert_equal(block_verbose['tx'][0], node.getblock(blockhash, 2)['tx'][0])
+            assert 'instantlock' in block_verbose['tx'][0]
+
     def _test_getdifficulty(self):
         difficulty = self.nodes[0].getdifficulty()
         # 1 hash in 2 should be valid, so difficulty should be 1/2**31
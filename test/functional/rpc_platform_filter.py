@@ -57,7 +57,8 @@ class HTTPBasicsTest(BitcoinTestFramework):
                        "getblockcount",
                        "getbestchainlock",
                        "quorum",
-                       "verifyislock"]
+                       "verifyislock",
+                       "verifyislockbatch"]
 
         help_output = self.nodes[0].help().split('\n')
         nonwhitelisted = set()
@@ -88,12 +89,16 @@ class HTTPBasicsTest(BitcoinTestFramework):
                                 "0000000000000000000000000000000000000000000000000000000000000001"],
                                 rpcuser_authpair_platform, 200)
         test_command("quorum", ["verify"], rpcuser_authpair_platform, 500)
+        test_command("quorum", ["signbatch", 100, []], rpcuser_authpair_platform, 200)
+        test_command("quorum", ["verifybatch"], rpcuser_authpair_platform, 500)
         test_command("verifyislock", [], rpcuser_authpair_platform, 500)
+        test_command("verifyislockbatch", [], rpcuser_authpair_platform, 500)
 
         self.log.info('Try using some invalid combinations for platform-user')
         test_command("quorum", [], rpcuser_authpair_platform, 403)
         test_command("quorum", ["sign"], rpcuser_authpair_platform, 403)
         test_command("quorum", ["sign", 102], rpcuser_authpair_platform, 403)
+        test_command("quorum", ["signbatch", 102, []], rpcuser_authpair_platform, 403)
         test_command("quorum", ["sign", "100"], rpcuser_authpair_platform, 403)
         test_command("quorum", ["dkgsimerror"], rpcuser_authpair_platform, 403)
 
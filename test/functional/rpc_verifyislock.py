@@ -5,7 +5,7 @@
 
 from test_framework.messages import CTransaction, FromHex, hash256, ser_compact_size, ser_string
 from test_framework.test_framework import DashTestFramework
-from test_framework.util import assert_raises_rpc_error, bytes_to_hex_str, satoshi_round, wait_until
+from test_framework.util import assert_equal, assert_raises_rpc_error, bytes_to_hex_str, satoshi_round, wait_until
 
 '''
 rpc_verifyislock.py
@@ -52,6 +52,12 @@ class RPCVerifyISLockTest(DashTestFramework):
         assert not node.verifyislock(request_id, txid, rec_sig, 1)
         # Mined, should ignore higher maxHeight
         assert(node.verifyislock(request_id, txid, rec_sig, node.getblockcount() + 100))
+        # Same for a batch, with an entry for the wrong txid
+        batch = [{"id": request_id, "txid": txid, "signature": rec_sig},
+                 {"id": request_id, "txid": request_id, "signature": rec_sig}]
+        assert_equal(node.verifyislockbatch(batch), [True, False])
+        assert_equal(node.verifyislockbatch(batch, 1), [False, False])
+        assert_equal(node.verifyislockbatch(batch, node.getblockcount() + 100), [True, False])
 
         # Mine one more quorum to have a full active set
         self.mine_quorum()